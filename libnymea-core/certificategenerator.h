@@ -38,7 +38,13 @@ namespace nymeaserver {
 class CertificateGenerator
 {
 public:
-    static void generate(const QString &certificateFilename, const QString &keyFilename);
+    enum KeyType {
+        KeyTypeRsa,
+        KeyTypeEc
+    };
+
+    // RSA 2048 by default, EC keys on the P-256 curve are generated in a fraction of the time
+    static void generate(const QString &certificateFilename, const QString &keyFilename, KeyType keyType = KeyTypeRsa);
 };
 
 }
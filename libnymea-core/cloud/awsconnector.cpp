@@ -43,6 +43,9 @@
 #include <QSslKey>
 #include <QMetaEnum>
 
+// Messages published while offline are held back up to this count, the oldest ones are dropped beyond
+static const int maxQueuedPublishes = 100;
+
 AWSConnector::AWSConnector(QObject *parent) : QObject(parent)
 {
     m_clientName = readSyncedNameCache();
@@ -205,7 +208,7 @@ void AWSConnector::fetchPairings()
     params.insert("timestamp", QDateTime::currentMSecsSinceEpoch());
     params.insert("id", ++m_transactionId);
     params.insert("command", "getUsers");
-    publish(QString("%1/device/users").arg(m_clientId), params);
+    publish(QString("%1/device/users").arg(m_clientId), params, true);
 }
 
 void AWSConnector::onPairingsRetrieved(const QVariantMap &pairings)
@@ -213,6 +216,7 @@ void AWSConnector::onPairingsRetrieved(const QVariantMap &pairings)
     if (m_setupInProgress) {
         m_setupInProgress = false;
         emit connected();
+        flushPublishQueue();
     }
 
     qCDebug(dcAWS) << pairings.value("users").toList().count() << "devices paired in cloud.";
@@ -225,6 +229,7 @@ void AWSConnector::onPairingsRetrieved(const QVariantMap &pairings)
 void AWSConnector::disconnectAWS()
 {
     m_shouldReconnect = false;
+    m_publishQueue.clear();
     if (isConnected()) {
         m_client->disconnectFromHost();
         qCDebug(dcAWS()) << "Disconnecting from AWS.";
@@ -258,11 +263,33 @@ void AWSConnector::pairDevice(const QString &idToken, const QString &userId)
     m_pairingRequests.insert(m_transactionId, userId);
 }
 
-quint16 AWSConnector::publish(const QString &topic, const QVariantMap &message)
+quint16 AWSConnector::publish(const QString &topic, const QVariantMap &message, bool supersedes)
 {
     if (!m_setupInProgress && !isConnected()) {
-        qCWarning(dcAWS()) << "Can't publish to AWS: Not connected.";
-        return -1;
+        if (!m_shouldReconnect) {
+            qCWarning(dcAWS()) << "Can't publish to AWS: Not connected.";
+            return -1;
+        }
+        // Requests which supersede earlier ones, like setting the name, are only sent once with the latest content
+        if (supersedes) {
+            for (int i = 0; i < m_publishQueue.count(); i++) {
+                if (m_publishQueue.at(i).topic == topic) {
+                    m_publishQueue.removeAt(i);
+                    break;
+                }
+            }
+        }
+        if (m_publishQueue.count() >= maxQueuedPublishes) {
+            qCWarning(dcAWS()) << "Too many messages waiting for the AWS connection. Dropping message to" << m_publishQueue.first().topic;
+            m_publishQueue.removeFirst();
+        }
+        qCDebug(dcAWS()) << "Not connected to AWS. Queueing message to" << topic;
+        QueuedPublish queuedPublish;
+        queuedPublish.topic = topic;
+        queuedPublish.message = message;
+        queuedPublish.supersedes = supersedes;
+        m_publishQueue.append(queuedPublish);
+        return 0;
     }
     QJsonDocument jsonDoc = QJsonDocument::fromVariant(message);
 
@@ -271,6 +298,19 @@ quint16 AWSConnector::publish(const QString &topic, const QVariantMap &message)
     return packetId;
 }
 
+void AWSConnector::flushPublishQueue()
+{
+    if (m_publishQueue.isEmpty()) {
+        return;
+    }
+    qCDebug(dcAWS()) << "Sending" << m_publishQueue.count() << "messages queued while disconnected";
+    QList<QueuedPublish> queue = m_publishQueue;
+    m_publishQueue.clear();
+    foreach (const QueuedPublish &queuedPublish, queue) {
+        publish(queuedPublish.topic, queuedPublish.message, queuedPublish.supersedes);
+    }
+}
+
 void AWSConnector::onDisconnected()
 {
     m_connectTimer.stop();
@@ -317,7 +357,7 @@ void AWSConnector::setName()
     params.insert("timestamp", QDateTime::currentMSecsSinceEpoch() / 1000);
     params.insert("command", "postName");
     params.insert("name", m_clientName);
-    publish(QString("%1/device/name").arg(m_clientId), params);
+    publish(QString("%1/device/name").arg(m_clientId), params, true);
 }
 
 void AWSConnector::subscribe(const QStringList &topics)
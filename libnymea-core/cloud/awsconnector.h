@@ -76,7 +76,8 @@ private slots:
 
 
 private:
-    quint16 publish(const QString &topic, const QVariantMap &message);
+    quint16 publish(const QString &topic, const QVariantMap &message, bool supersedes = false);
+    void flushPublishQueue();
     void subscribe(const QStringList &topics);
 
     void storeRegisteredFlag(bool registered);
@@ -112,6 +113,15 @@ private:
     QStringList m_subscriptionCache;
     QPair<QVariantMap, QDateTime> m_cachedTURNCredentials;
 
+    // Messages published while not connected, sent once the connection is set up again
+    class QueuedPublish {
+    public:
+        QString topic;
+        QVariantMap message;
+        bool supersedes = false;
+    };
+    QList<QueuedPublish> m_publishQueue;
+
 };
 
 #endif // AWSCONNECTOR_H
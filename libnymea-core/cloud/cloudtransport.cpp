@@ -46,13 +46,12 @@ CloudTransport::CloudTransport(const ServerConfiguration &config, QObject *paren
 void CloudTransport::sendData(const QUuid &clientId, const QByteArray &data)
 {
     qCDebug(dcCloudTraffic()) << "Sending data" << clientId << data;
-    foreach (const ConnectionContext &ctx, m_connections) {
-        if (ctx.clientId == clientId) {
-            ctx.proxyConnection->sendData(data);
-            return;
-        }
+    RemoteProxyConnection *proxyConnection = m_clientConnections.value(clientId);
+    if (!proxyConnection) {
+        qCWarning(dcCloud()) << "Error sending data. No such clientId";
+        return;
     }
-    qCWarning(dcCloud()) << "Error sending data. No such clientId";
+    proxyConnection->sendData(data);
 }
 
 void CloudTransport::sendData(const QList<QUuid> &clientIds, const QByteArray &data)
@@ -62,13 +61,29 @@ void CloudTransport::sendData(const QList<QUuid> &clientIds, const QByteArray &d
     }
 }
 
+bool CloudTransport::supportsBinaryData() const
+{
+    // The proxy tunnels the data as it is
+    return true;
+}
+
+void CloudTransport::sendBinaryData(const QUuid &clientId, const QByteArray &data)
+{
+    sendData(clientId, data);
+}
+
+void CloudTransport::sendBinaryData(const QList<QUuid> &clientIds, const QByteArray &data)
+{
+    foreach (const QUuid &clientId, clientIds) {
+        sendBinaryData(clientId, data);
+    }
+}
+
 void CloudTransport::terminateClientConnection(const QUuid &clientId)
 {
-    foreach (const ConnectionContext &ctx, m_connections) {
-        if (ctx.clientId == clientId) {
-            ctx.proxyConnection->disconnectServer();
-            return;
-        }
+    RemoteProxyConnection *proxyConnection = m_clientConnections.value(clientId);
+    if (proxyConnection) {
+        proxyConnection->disconnectServer();
     }
 }
 
@@ -117,6 +132,7 @@ void CloudTransport::transportConnected()
     ConnectionContext context = m_connections.value(proxyConnection);
 
     qCDebug(dcCloud()) << "The remote client connected successfully" << proxyConnection->tunnelPartnerName() << proxyConnection->tunnelPartnerUuid();
+    m_clientConnections.insert(context.clientId, proxyConnection);
     emit clientConnected(context.clientId);
 }
 
@@ -124,6 +140,7 @@ void CloudTransport::transportDisconnected()
 {
     RemoteProxyConnection *proxyConnection = qobject_cast<RemoteProxyConnection*>(sender());
     ConnectionContext context = m_connections.take(proxyConnection);
+    m_clientConnections.remove(context.clientId);
     proxyConnection->deleteLater();
 
     qCDebug(dcCloud()) << "The remote connection disconnected." << context.clientId;
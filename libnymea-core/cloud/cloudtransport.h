@@ -46,6 +46,10 @@ public:
     void sendData(const QUuid &clientId, const QByteArray &data) override;
     void sendData(const QList<QUuid> &clientIds, const QByteArray &data) override;
 
+    bool supportsBinaryData() const override;
+    void sendBinaryData(const QUuid &clientId, const QByteArray &data) override;
+    void sendBinaryData(const QList<QUuid> &clientIds, const QByteArray &data) override;
+
     void terminateClientConnection(const QUuid &clientId) override;
 
     bool startServer() override;
@@ -74,6 +78,8 @@ private:
         remoteproxyclient::RemoteProxyConnection* proxyConnection;
     };
     QHash<remoteproxyclient::RemoteProxyConnection*, ConnectionContext> m_connections;
+    // Tunnels of connected remote clients, for sending without scanning all connections
+    QHash<QUuid, remoteproxyclient::RemoteProxyConnection*> m_clientConnections;
 
 };
 
@@ -33,6 +33,9 @@
 #include "nymeasettings.h"
 #include "nymeacore.h"
 #include "nymeaconfiguration.h"
+#include "integrations/thingstatecache.h"
+#include "ruleengine/rulestore.h"
+#include "startuptrace.h"
 #include "version.h"
 
 #include <QDir>
@@ -45,23 +48,33 @@
 #include <QCryptographicHash>
 #include <QProcessEnvironment>
 #include <QHostInfo>
+#include <QtConcurrent/QtConcurrentRun>
+
+// Only the most recent part of each log file is added to the report, the temporary location is often in memory
+static const qint64 defaultMaxLogFileSize = 8 * 1024 * 1024;
 
 namespace nymeaserver {
 
 DebugReportGenerator::DebugReportGenerator(QObject *parent) : QObject(parent)
 {
-
+    connect(&m_logCopyWatcher, &QFutureWatcher<void>::finished, this, &DebugReportGenerator::verifyRunningProcessesFinished);
 }
 
 DebugReportGenerator::~DebugReportGenerator()
 {
+    m_logCopyWatcher.waitForFinished();
     // Clean up any leftover files
     cleanupReport();
 }
 
-QByteArray DebugReportGenerator::reportFileData() const
+QString DebugReportGenerator::reportFilePath() const
 {
-    return m_reportFileData;
+    return QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/" + m_reportFileName;
+}
+
+qint64 DebugReportGenerator::reportFileSize() const
+{
+    return m_reportFileSize;
 }
 
 QString DebugReportGenerator::reportFileName()
@@ -144,9 +157,39 @@ void DebugReportGenerator::copyFileToReportDirectory(const QString &fileName, co
     }
 }
 
+void DebugReportGenerator::copyLogFile(const QString &fileName, const QString &destination, qint64 maxSize)
+{
+    QFile sourceFile(fileName);
+    if (sourceFile.size() <= maxSize) {
+        if (!QFile::copy(fileName, destination)) {
+            qCWarning(dcDebugServer()) << "Could not copy file" << fileName << "to" << destination;
+        }
+        return;
+    }
+
+    QFile destinationFile(destination);
+    if (!sourceFile.open(QFile::ReadOnly) || !destinationFile.open(QFile::WriteOnly | QFile::Truncate)) {
+        qCWarning(dcDebugServer()) << "Could not copy file" << fileName << "to" << destination;
+        return;
+    }
+
+    // Start at the first complete line of the last maxSize bytes
+    sourceFile.seek(sourceFile.size() - maxSize);
+    sourceFile.readLine();
+    qint64 skipped = sourceFile.pos();
+    qCDebug(dcDebugServer()) << "Copy last" << sourceFile.size() - skipped << "bytes of file" << fileName << "-->" << destination;
+    destinationFile.write(QString("[... %1 bytes truncated ...]\n").arg(skipped).toUtf8());
+    while (!sourceFile.atEnd()) {
+        if (destinationFile.write(sourceFile.read(64 * 1024)) < 0) {
+            qCWarning(dcDebugServer()) << "Could not write file" << destination << destinationFile.errorString();
+            return;
+        }
+    }
+}
+
 void DebugReportGenerator::verifyRunningProcessesFinished()
 {
-    if (m_runningProcesses.isEmpty()) {
+    if (m_runningProcesses.isEmpty() && !m_logCopyWatcher.isRunning() && !m_compressProcess) {
         qCDebug(dcDebugServer()) << "All async processes are finished. Start compressing the file.";
         m_compressProcess = new QProcess(this);
         m_compressProcess->setProcessChannelMode(QProcess::MergedChannels);
@@ -178,6 +221,7 @@ void DebugReportGenerator::saveSystemInformation()
     stream << "User: " << qgetenv("USER") << endl;
     stream << "Command: " << QCoreApplication::arguments().join(' ') << endl;
     stream << "Qt runtime version: " << qVersion() << endl;
+    stream << "Startup duration: " << (StartupTrace::isFinished() ? QString("%1 ms").arg(StartupTrace::duration() / 1000) : QString("not finished")) << endl;
     stream << "" << endl;
 #if (QT_VERSION < QT_VERSION_CHECK(5, 6, 0))
     stream << "Hostname: " << QHostInfo::localHostName() << endl;
@@ -194,12 +238,28 @@ void DebugReportGenerator::saveSystemInformation()
 
 void DebugReportGenerator::saveLogFiles()
 {
+    qint64 maxSize = defaultMaxLogFileSize;
+    if (qEnvironmentVariableIntValue("NYMEA_DEBUG_REPORT_MAX_LOG_SIZE") > 0) {
+        maxSize = qEnvironmentVariableIntValue("NYMEA_DEBUG_REPORT_MAX_LOG_SIZE");
+    }
+
+    QStringList logFiles;
     QDir logDir("/var/log/");
-    QStringList syslogFiles = logDir.entryList(QStringList() << "syslog*" << "nymea.*", QDir::Files);
-    foreach (const QString &logFile, syslogFiles) {
-        copyFileToReportDirectory(logDir.path() + "/" + logFile, "logs");
+    foreach (const QString &logFile, logDir.entryList(QStringList() << "syslog*" << "nymea.*", QDir::Files)) {
+        logFiles.append(logDir.path() + "/" + logFile);
     }
 
+    // The startup trace of this run, can be opened in chrome://tracing
+    if (QFile::exists(StartupTrace::fileName())) {
+        logFiles.append(StartupTrace::fileName());
+    }
+
+    QString destination = m_reportDirectory.path() + "/logs";
+    m_logCopyWatcher.setFuture(QtConcurrent::run([logFiles, destination, maxSize](){
+        foreach (const QString &logFile, logFiles) {
+            copyLogFile(logFile, destination + "/" + QFileInfo(logFile).fileName(), maxSize);
+        }
+    }));
 }
 
 void DebugReportGenerator::saveConfigs()
@@ -208,10 +268,24 @@ void DebugReportGenerator::saveConfigs()
     copyFileToReportDirectory(NymeaSettings(NymeaSettings::SettingsRoleGlobal).fileName(), "config");
     copyFileToReportDirectory(NymeaSettings(NymeaSettings::SettingsRoleThings).fileName(), "config");
     copyFileToReportDirectory(NymeaSettings(NymeaSettings::SettingsRoleThingStates).fileName(), "config");
+    copyFileToReportDirectory(ThingStateCache::defaultFileName(), "config");
+    copyFileToReportDirectory(ThingStateCache::journalFileName(ThingStateCache::defaultFileName()), "config");
     copyFileToReportDirectory(NymeaSettings(NymeaSettings::SettingsRoleRules).fileName(), "config");
     copyFileToReportDirectory(NymeaSettings(NymeaSettings::SettingsRolePlugins).fileName(), "config");
     copyFileToReportDirectory(NymeaSettings(NymeaSettings::SettingsRoleTags).fileName(), "config");
     copyFileToReportDirectory(NymeaCore::instance()->configuration()->logDBName(), "config");
+
+    // The rule records are binary, add them as text
+    RuleStore ruleStore;
+    if (ruleStore.exists()) {
+        QFile rulesFile(m_reportDirectory.path() + "/config/rules.txt");
+        if (rulesFile.open(QIODevice::WriteOnly)) {
+            rulesFile.write(ruleStore.toText());
+            rulesFile.close();
+        } else {
+            qCWarning(dcDebugServer()) << "Could not open rules file" << rulesFile.fileName();
+        }
+    }
 }
 
 void DebugReportGenerator::saveEnv()
@@ -233,7 +307,7 @@ void DebugReportGenerator::saveEnv()
 
 void DebugReportGenerator::cleanupReport()
 {
-    QFile reportFile(QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/" + m_reportFileName);
+    QFile reportFile(reportFilePath());
     if (reportFile.exists()) {
         qCDebug(dcDebugServer()) << "Delete report file" << reportFile.fileName();
         if (!reportFile.remove()) {
@@ -327,16 +401,19 @@ void DebugReportGenerator::onCompressProcessFinished(int exitCode, QProcess::Exi
     }
 
     // Read the file
-    QFile reportFile(QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/" + m_reportFileName);
+    QFile reportFile(reportFilePath());
     if (!reportFile.open(QIODevice::ReadOnly)) {
         qCWarning(dcDebugServer()) << "Could not open report file name for reading" << reportFile.fileName();
         m_isReady = true;
         m_isValid = false;
         emit finished(false);
     } else {
-        m_reportFileData = reportFile.readAll();
-        m_md5Sum =  QString::fromUtf8(QCryptographicHash::hash(m_reportFileData, QCryptographicHash::Md5).toHex());
-        qCDebug(dcDebugServer()) << "File generated successfully" << reportFile.fileName() << m_reportFileData.size() << "B" << m_md5Sum;
+        // Hash the file from disk, the report gets streamed to the client and never held in memory
+        QCryptographicHash hash(QCryptographicHash::Md5);
+        hash.addData(&reportFile);
+        m_reportFileSize = reportFile.size();
+        m_md5Sum =  QString::fromUtf8(hash.result().toHex());
+        qCDebug(dcDebugServer()) << "File generated successfully" << reportFile.fileName() << m_reportFileSize << "B" << m_md5Sum;
         m_isReady = true;
         m_isValid = true;
         emit finished(true);
@@ -34,6 +34,7 @@
 #include <QDir>
 #include <QObject>
 #include <QProcess>
+#include <QFutureWatcher>
 
 namespace nymeaserver {
 
@@ -44,7 +45,8 @@ public:
     explicit DebugReportGenerator(QObject *parent = nullptr);
     ~DebugReportGenerator();
 
-    QByteArray reportFileData() const;
+    QString reportFilePath() const;
+    qint64 reportFileSize() const;
     QString reportFileName();
     QString md5Sum() const;
 
@@ -61,11 +63,14 @@ private:
 
     QProcess *m_compressProcess = nullptr;
     QList<QProcess *> m_runningProcesses;
+    // Log files are copied in a worker thread while the network processes run
+    QFutureWatcher<void> m_logCopyWatcher;
 
-    QByteArray m_reportFileData;
+    qint64 m_reportFileSize = 0;
     QString m_md5Sum;
 
     void copyFileToReportDirectory(const QString &fileName, const QString &subDirectory = QString());
+    static void copyLogFile(const QString &fileName, const QString &destination, qint64 maxSize);
     void verifyRunningProcessesFinished();
 
     void saveSystemInformation();
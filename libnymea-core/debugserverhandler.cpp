@@ -35,6 +35,16 @@
 #include "loggingcategories.h"
 #include "debugserverhandler.h"
 #include "nymeaconfiguration.h"
+#include "jsonrpc/jsonrpcserverimplementation.h"
+#include "integrations/thingstatecache.h"
+#include "ruleengine/rulestore.h"
+#include "integrations/pluginstatistics.h"
+#include "integrations/thingmanager.h"
+#include "zigbee/zigbeemanager.h"
+#include "eventqueue.h"
+#include "memoryprofiler.h"
+#include "federation/federationmanager.h"
+#include "replication/replicationprimary.h"
 #include "stdio.h"
 #include "version.h"
 
@@ -45,6 +55,7 @@
 #include <QXmlStreamWriter>
 #include <QCoreApplication>
 #include <QFileInfo>
+#include <QScopedPointer>
 #include <QWebSocket>
 #include <QPair>
 #include <QHostInfo>
@@ -52,8 +63,73 @@
 
 namespace nymeaserver {
 
+// Log lines for the live log websocket are queued here by the message handler and sent by the main thread.
+// Producers never block and never allocate beyond the message itself. If the writer can't keep up, lines get
+// dropped instead of slowing down whoever is logging.
+class LogMessageRingBuffer
+{
+public:
+    static const quint64 capacity = 4096;
+
+    LogMessageRingBuffer() {
+        for (quint64 i = 0; i < capacity; i++) {
+            m_slots[i].sequence.store(i);
+        }
+    }
+
+    // Called from any thread
+    bool push(const QString &message) {
+        quint64 position = m_enqueuePosition.load();
+        forever {
+            Slot &slot = m_slots[position % capacity];
+            qint64 difference = static_cast<qint64>(slot.sequence.loadAcquire()) - static_cast<qint64>(position);
+            if (difference == 0) {
+                if (m_enqueuePosition.testAndSetRelaxed(position, position + 1, position)) {
+                    slot.message = message;
+                    slot.sequence.storeRelease(position + 1);
+                    return true;
+                }
+            } else if (difference < 0) {
+                m_dropped.ref();
+                return false;
+            } else {
+                position = m_enqueuePosition.load();
+            }
+        }
+    }
+
+    // Only called from the main thread
+    bool pop(QString *message) {
+        quint64 position = m_dequeuePosition;
+        Slot &slot = m_slots[position % capacity];
+        if (static_cast<qint64>(slot.sequence.loadAcquire()) - static_cast<qint64>(position + 1) < 0) {
+            return false;
+        }
+        *message = slot.message;
+        slot.message.clear();
+        m_dequeuePosition = position + 1;
+        slot.sequence.storeRelease(position + capacity);
+        return true;
+    }
+
+    int takeDropped() {
+        return m_dropped.fetchAndStoreRelaxed(0);
+    }
+
+private:
+    struct Slot {
+        QAtomicInteger<quint64> sequence;
+        QString message;
+    };
+    Slot m_slots[capacity];
+    QAtomicInteger<quint64> m_enqueuePosition;
+    quint64 m_dequeuePosition = 0;
+    QAtomicInt m_dropped;
+};
+
+static LogMessageRingBuffer s_logMessages;
+
 QList<QWebSocket*> DebugServerHandler::s_websocketClients;
-QMutex DebugServerHandler::s_loggingMutex;
 
 DebugServerHandler::DebugServerHandler(QObject *parent) :
     QObject(parent)
@@ -72,38 +148,37 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
         // Fallback default debug page
         HttpReply *reply = HttpReply::createSuccessReply();
         reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
-        reply->setPayload(createDebugXmlDocument());
+        reply->setPayload(debugDocument());
         return reply;
     }
 
     // Check if this is a logdb requested
     if (requestPath.startsWith("/debug/logdb.sql")) {
         qCDebug(dcDebugServer()) << "Loading" << NymeaCore::instance()->configuration()->logDBName();
-        QFile logDatabaseFile(NymeaCore::instance()->configuration()->logDBName());
-        if (!logDatabaseFile.exists()) {
+        QScopedPointer<QFile> logDatabaseFile(new QFile(NymeaCore::instance()->configuration()->logDBName()));
+        if (!logDatabaseFile->exists()) {
             qCWarning(dcDebugServer()) << "Could not read log database file for debug download" << NymeaCore::instance()->configuration()->logDBName() << "file does not exist.";
             HttpReply *reply = HttpReply::createErrorReply(HttpReply::NotFound);
             reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
             //: The HTTP error message of the debug interface. The %1 represents the file name.
-            reply->setPayload(createErrorXmlDocument(HttpReply::NotFound, tr("Could not find file \"%1\".").arg(logDatabaseFile.fileName())));
+            reply->setPayload(createErrorXmlDocument(HttpReply::NotFound, tr("Could not find file \"%1\".").arg(logDatabaseFile->fileName())));
             return reply;
         }
 
-        if (!logDatabaseFile.open(QFile::ReadOnly)) {
+        if (!logDatabaseFile->open(QFile::ReadOnly)) {
             qCWarning(dcDebugServer()) << "Could not read log database file for debug download" << NymeaCore::instance()->configuration()->logDBName();
             HttpReply *reply = HttpReply::createErrorReply(HttpReply::Forbidden);
             reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
             //: The HTTP error message of the debug interface. The %1 represents the file name.
-            reply->setPayload(createErrorXmlDocument(HttpReply::NotFound, tr("Could not open file \"%1\".").arg(logDatabaseFile.fileName())));
+            reply->setPayload(createErrorXmlDocument(HttpReply::NotFound, tr("Could not open file \"%1\".").arg(logDatabaseFile->fileName())));
             return reply;
         }
 
-        QByteArray logDatabaseRawData = logDatabaseFile.readAll();
-        logDatabaseFile.close();
-
+        // The database can easily be bigger than the available memory, stream it from disk
         HttpReply *reply = HttpReply::createSuccessReply();
         reply->setHeader(HttpReply::ContentTypeHeader, "application/sql");
-        reply->setPayload(logDatabaseRawData);
+        qint64 logDatabaseSize = logDatabaseFile->size();
+        reply->setPayloadDevice(logDatabaseFile.take(), logDatabaseSize);
         return reply;
     }
 
@@ -112,8 +187,8 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
     if (requestPath.startsWith("/debug/syslog")) {
         QString syslogFileName = "/var/log/syslog";
         qCDebug(dcDebugServer()) << "Loading" << syslogFileName;
-        QFile syslogFile(syslogFileName);
-        if (!syslogFile.exists()) {
+        QScopedPointer<QFile> syslogFile(new QFile(syslogFileName));
+        if (!syslogFile->exists()) {
             qCWarning(dcDebugServer()) << "Could not read log database file for debug download" << syslogFileName << "file does not exist.";
             HttpReply *reply = HttpReply::createErrorReply(HttpReply::NotFound);
             reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
@@ -121,7 +196,7 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
             return reply;
         }
 
-        if (!syslogFile.open(QFile::ReadOnly)) {
+        if (!syslogFile->open(QFile::ReadOnly)) {
             qCWarning(dcDebugServer()) << "Could not read syslog file for debug download" << syslogFileName;
             HttpReply *reply = HttpReply::createErrorReply(HttpReply::Forbidden);
             reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
@@ -129,12 +204,11 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
             return reply;
         }
 
-        QByteArray syslogFileData = syslogFile.readAll();
-        syslogFile.close();
-
+        // Send what is in the file right now, the syslog keeps growing while we stream it
         HttpReply *reply = HttpReply::createSuccessReply();
         reply->setHeader(HttpReply::ContentTypeHeader, "text/plain");
-        reply->setPayload(syslogFileData);
+        qint64 syslogFileSize = syslogFile->size();
+        reply->setPayloadDevice(syslogFile.take(), syslogFileSize);
         return reply;
     }
 
@@ -170,31 +244,20 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
         }
 
         if (requestPath.startsWith("/debug/settings/rules")) {
-            QString settingsFileName = NymeaSettings(NymeaSettings::SettingsRoleRules).fileName();
-            qCDebug(dcDebugServer()) << "Loading" << settingsFileName;
-            QFile settingsFile(settingsFileName);
-            if (!settingsFile.exists()) {
-                qCWarning(dcDebugServer()) << "Could not read file for debug download" << settingsFileName << "file does not exist.";
+            RuleStore ruleStore;
+            qCDebug(dcDebugServer()) << "Loading" << ruleStore.path();
+            if (!ruleStore.exists()) {
+                qCWarning(dcDebugServer()) << "Could not read rules for debug download" << ruleStore.path() << "does not exist.";
                 HttpReply *reply = HttpReply::createErrorReply(HttpReply::NotFound);
                 reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
-                reply->setPayload(createErrorXmlDocument(HttpReply::NotFound, tr("Could not find file \"%1\".").arg(settingsFileName)));
+                reply->setPayload(createErrorXmlDocument(HttpReply::NotFound, tr("Could not find file \"%1\".").arg(ruleStore.path())));
                 return reply;
             }
 
-            if (!settingsFile.open(QFile::ReadOnly)) {
-                qCWarning(dcDebugServer()) << "Could not read file for debug download" << settingsFileName;
-                HttpReply *reply = HttpReply::createErrorReply(HttpReply::Forbidden);
-                reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
-                reply->setPayload(createErrorXmlDocument(HttpReply::NotFound, tr("Could not open file \"%1\".").arg(settingsFileName)));
-                return reply;
-            }
-
-            QByteArray settingsFileData = settingsFile.readAll();
-            settingsFile.close();
-
+            // The rule records are binary, serve them as text
             HttpReply *reply = HttpReply::createSuccessReply();
             reply->setHeader(HttpReply::ContentTypeHeader, "text/plain");
-            reply->setPayload(settingsFileData);
+            reply->setPayload(ruleStore.toText());
             return reply;
         }
 
@@ -228,31 +291,28 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
         }
 
         if (requestPath.startsWith("/debug/settings/thingstates")) {
-            QString settingsFileName = NymeaSettings(NymeaSettings::SettingsRoleThingStates).fileName();
-            qCDebug(dcDebugServer()) << "Loading" << settingsFileName;
-            QFile settingsFile(settingsFileName);
-            if (!settingsFile.exists()) {
-                qCWarning(dcDebugServer()) << "Could not read file for debug download" << settingsFileName << "file does not exist.";
+            ThingStateCache stateCache;
+            qCDebug(dcDebugServer()) << "Loading" << stateCache.fileName();
+            if (!QFile::exists(stateCache.fileName())) {
+                qCWarning(dcDebugServer()) << "Could not read file for debug download" << stateCache.fileName() << "file does not exist.";
                 HttpReply *reply = HttpReply::createErrorReply(HttpReply::NotFound);
                 reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
-                reply->setPayload(createErrorXmlDocument(HttpReply::NotFound, tr("Could not find file \"%1\".").arg(settingsFileName)));
+                reply->setPayload(createErrorXmlDocument(HttpReply::NotFound, tr("Could not find file \"%1\".").arg(stateCache.fileName())));
                 return reply;
             }
 
-            if (!settingsFile.open(QFile::ReadOnly)) {
-                qCWarning(dcDebugServer()) << "Could not read file for debug download" << settingsFileName;
+            if (!stateCache.open()) {
+                qCWarning(dcDebugServer()) << "Could not read file for debug download" << stateCache.fileName();
                 HttpReply *reply = HttpReply::createErrorReply(HttpReply::Forbidden);
                 reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
-                reply->setPayload(createErrorXmlDocument(HttpReply::NotFound, tr("Could not open file \"%1\".").arg(settingsFileName)));
+                reply->setPayload(createErrorXmlDocument(HttpReply::NotFound, tr("Could not open file \"%1\".").arg(stateCache.fileName())));
                 return reply;
             }
 
-            QByteArray settingsFileData = settingsFile.readAll();
-            settingsFile.close();
-
+            // The snapshot is binary, serve it in the text form of the former thingstates.conf
             HttpReply *reply = HttpReply::createSuccessReply();
             reply->setHeader(HttpReply::ContentTypeHeader, "text/plain");
-            reply->setPayload(settingsFileData);
+            reply->setPayload(stateCache.toText());
             return reply;
         }
 
@@ -472,6 +532,111 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
         }
     }
 
+    if (requestPath.startsWith("/debug/performance")) {
+        qCDebug(dcDebugServer()) << "Request performance counters";
+        HttpReply *reply = HttpReply::createSuccessReply();
+        reply->setHeader(HttpReply::ContentTypeHeader, "application/json; charset=\"utf-8\";");
+        reply->setPayload(QJsonDocument::fromVariant(NymeaCore::instance()->jsonRPCServer()->performanceCounters()).toJson(QJsonDocument::Indented));
+        return reply;
+    }
+
+    if (requestPath.startsWith("/debug/plugin-statistics")) {
+        qCDebug(dcDebugServer()) << "Request plugin statistics";
+        HttpReply *reply = HttpReply::createSuccessReply();
+        reply->setHeader(HttpReply::ContentTypeHeader, "application/json; charset=\"utf-8\";");
+        reply->setPayload(QJsonDocument::fromVariant(PluginStatistics::collect(NymeaCore::instance()->thingManager()->plugins())).toJson(QJsonDocument::Indented));
+        return reply;
+    }
+
+    if (requestPath.startsWith("/debug/event-queue")) {
+        qCDebug(dcDebugServer()) << "Request event queue statistics";
+        HttpReply *reply = HttpReply::createSuccessReply();
+        reply->setHeader(HttpReply::ContentTypeHeader, "application/json; charset=\"utf-8\";");
+        reply->setPayload(QJsonDocument::fromVariant(NymeaCore::instance()->eventQueue()->statistics()).toJson(QJsonDocument::Indented));
+        return reply;
+    }
+
+    if (requestPath.startsWith("/debug/memory/malloc-info")) {
+        qCDebug(dcDebugServer()) << "Request malloc info";
+        QByteArray mallocInfo = NymeaCore::instance()->memoryProfiler()->mallocInfo();
+        if (mallocInfo.isEmpty()) {
+            HttpReply *reply = HttpReply::createErrorReply(HttpReply::NotImplemented);
+            reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
+            reply->setPayload(createErrorXmlDocument(HttpReply::NotImplemented, tr("The memory allocator does not provide malloc info.")));
+            return reply;
+        }
+        HttpReply *reply = HttpReply::createSuccessReply();
+        reply->setHeader(HttpReply::ContentTypeHeader, "application/xml; charset=\"utf-8\";");
+        reply->setPayload(mallocInfo);
+        return reply;
+    }
+
+    if (requestPath.startsWith("/debug/memory/trim")) {
+        qCDebug(dcDebugServer()) << "Request heap trim";
+        if (!NymeaCore::instance()->memoryProfiler()->trim()) {
+            HttpReply *reply = HttpReply::createErrorReply(HttpReply::NotImplemented);
+            reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
+            reply->setPayload(createErrorXmlDocument(HttpReply::NotImplemented, tr("The memory allocator does not support trimming the heap.")));
+            return reply;
+        }
+        HttpReply *reply = HttpReply::createSuccessReply();
+        reply->setHeader(HttpReply::ContentTypeHeader, "application/json; charset=\"utf-8\";");
+        reply->setPayload(QJsonDocument::fromVariant(NymeaCore::instance()->memoryProfiler()->statistics()).toJson(QJsonDocument::Indented));
+        return reply;
+    }
+
+    if (requestPath.startsWith("/debug/memory/heap-profile")) {
+        qCDebug(dcDebugServer()) << "Request heap profile";
+        QString errorMessage;
+        QString profileFileName = NymeaCore::instance()->memoryProfiler()->dumpHeapProfile(&errorMessage);
+        QScopedPointer<QFile> profileFile(new QFile(profileFileName));
+        if (profileFileName.isEmpty() || !profileFile->open(QFile::ReadOnly)) {
+            qCWarning(dcDebugServer()) << "Could not write heap profile:" << errorMessage;
+            HttpReply *reply = HttpReply::createErrorReply(HttpReply::NotImplemented);
+            reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
+            reply->setPayload(createErrorXmlDocument(HttpReply::NotImplemented, errorMessage));
+            return reply;
+        }
+        HttpReply *reply = HttpReply::createSuccessReply();
+        reply->setHeader(HttpReply::ContentTypeHeader, "application/octet-stream");
+        reply->setRawHeader("Content-Disposition", QString("attachment; filename=\"%1\"").arg(QFileInfo(profileFileName).fileName()).toUtf8());
+        qint64 profileSize = profileFile->size();
+        reply->setPayloadDevice(profileFile.take(), profileSize);
+        return reply;
+    }
+
+    if (requestPath.startsWith("/debug/memory")) {
+        qCDebug(dcDebugServer()) << "Request memory statistics";
+        HttpReply *reply = HttpReply::createSuccessReply();
+        reply->setHeader(HttpReply::ContentTypeHeader, "application/json; charset=\"utf-8\";");
+        reply->setPayload(QJsonDocument::fromVariant(NymeaCore::instance()->memoryProfiler()->statistics()).toJson(QJsonDocument::Indented));
+        return reply;
+    }
+
+    if (requestPath.startsWith("/debug/federation")) {
+        qCDebug(dcDebugServer()) << "Request federation statistics";
+        HttpReply *reply = HttpReply::createSuccessReply();
+        reply->setHeader(HttpReply::ContentTypeHeader, "application/json; charset=\"utf-8\";");
+        reply->setPayload(QJsonDocument::fromVariant(NymeaCore::instance()->federationManager()->statistics()).toJson(QJsonDocument::Indented));
+        return reply;
+    }
+
+    if (requestPath.startsWith("/debug/replication")) {
+        qCDebug(dcDebugServer()) << "Request replication statistics";
+        HttpReply *reply = HttpReply::createSuccessReply();
+        reply->setHeader(HttpReply::ContentTypeHeader, "application/json; charset=\"utf-8\";");
+        reply->setPayload(QJsonDocument::fromVariant(NymeaCore::instance()->replicationPrimary()->statistics()).toJson(QJsonDocument::Indented));
+        return reply;
+    }
+
+    if (requestPath.startsWith("/debug/zigbee")) {
+        qCDebug(dcDebugServer()) << "Request Zigbee network dump";
+        HttpReply *reply = HttpReply::createSuccessReply();
+        reply->setHeader(HttpReply::ContentTypeHeader, "text/plain; charset=\"utf-8\";");
+        reply->setPayload(NymeaCore::instance()->zigbeeManager()->networkDump().toUtf8());
+        return reply;
+    }
+
     if (requestPath.startsWith("/debug/report")) {
 
         // The client can poll this url in order to get information about the current report generating process.
@@ -495,9 +660,16 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
 
             }
 
-            // Everything looks good, send the requested debug report
+            QFile *reportFile = new QFile(m_debugReportGenerator->reportFilePath());
+            if (!reportFile->open(QFile::ReadOnly)) {
+                qCWarning(dcDebugServer()) << "Could not open debug report file" << reportFile->fileName() << reportFile->errorString();
+                delete reportFile;
+                return HttpReply::createErrorReply(HttpReply::NotFound);
+            }
+
+            // Everything looks good, stream the requested debug report
             HttpReply *downloadReportReply = HttpReply::createSuccessReply();
-            downloadReportReply->setPayload(m_debugReportGenerator->reportFileData());
+            downloadReportReply->setPayloadDevice(reportFile, reportFile->size());
             downloadReportReply->setHeader(HttpReply::ContentTypeHeader, "application/tar+gzip;");
             return downloadReportReply;
         } else {
@@ -521,7 +693,7 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
                         // Success, the debug report is ready and valid
                         QVariantMap reportInformation;
                         reportInformation.insert("fileName", m_debugReportGenerator->reportFileName());
-                        reportInformation.insert("fileSize", m_debugReportGenerator->reportFileData().size());
+                        reportInformation.insert("fileSize", m_debugReportGenerator->reportFileSize());
                         reportInformation.insert("md5sum", m_debugReportGenerator->md5Sum());
 
                         HttpReply * httpReply = HttpReply::createSuccessReply();
@@ -573,9 +745,28 @@ void DebugServerHandler::logMessageHandler(QtMsgType type, const QMessageLogCont
         break;
     }
 
-    QMutexLocker locker(&s_loggingMutex);
+    s_logMessages.push(finalMessage);
+}
+
+void DebugServerHandler::forwardLogMessages()
+{
+    // Send everything queued since the last run as one websocket message
+    QString messages;
+    int dropped = s_logMessages.takeDropped();
+    if (dropped > 0) {
+        messages.append(QString(" W | DebugServer: %1 log messages dropped\n").arg(dropped));
+    }
+
+    QString message;
+    while (s_logMessages.pop(&message)) {
+        messages.append(message);
+    }
+
+    if (messages.isEmpty())
+        return;
+
     foreach (QWebSocket *client, s_websocketClients) {
-        client->sendTextMessage(finalMessage);
+        client->sendTextMessage(messages);
     }
 }
 
@@ -656,6 +847,13 @@ void DebugServerHandler::onWebsocketClientConnected()
         qCDebug(dcDebugServer()) << "Install debug message handler for live logs.";
         //QLoggingCategory::setFilterRules("*.debug=true");
         nymeaInstallMessageHandler(&logMessageHandler);
+
+        if (!m_logForwardTimer) {
+            m_logForwardTimer = new QTimer(this);
+            m_logForwardTimer->setInterval(100);
+            connect(m_logForwardTimer, &QTimer::timeout, this, &DebugServerHandler::forwardLogMessages);
+        }
+        m_logForwardTimer->start();
     }
 
     s_websocketClients.append(client);
@@ -675,6 +873,12 @@ void DebugServerHandler::onWebsocketClientDisconnected()
     if (s_websocketClients.isEmpty()) {
         qCDebug(dcDebugServer()) << "Uninstalling debug message handler for live logs.";
         nymeaUninstallMessageHandler(&logMessageHandler);
+        m_logForwardTimer->stop();
+
+        // Discard what is left for nobody
+        QString message;
+        while (s_logMessages.pop(&message)) { }
+        s_logMessages.takeDropped();
     }
 }
 
@@ -744,6 +948,40 @@ void DebugServerHandler::onDebugReportGeneratorTimeout()
     }
 }
 
+QByteArray DebugServerHandler::debugDocument()
+{
+    // The page only depends on the configuration and the available logging categories. Build it
+    // once for each state of those instead of running the whole writer on every request.
+    NymeaConfiguration *configuration = NymeaCore::instance()->configuration();
+    QStringList keyParts;
+    keyParts << configuration->serverName();
+    keyParts << configuration->locale().name();
+    keyParts << QString::fromUtf8(configuration->timeZone());
+    keyParts << configuration->serverUuid().toString();
+    keyParts << QSysInfo::machineHostName();
+    QStringList files;
+    files << configuration->logDBName();
+    files << NymeaSettings(NymeaSettings::SettingsRoleGlobal).fileName();
+    files << NymeaSettings(NymeaSettings::SettingsRoleThings).fileName();
+    files << RuleStore::defaultPath();
+    files << NymeaSettings(NymeaSettings::SettingsRolePlugins).fileName();
+    files << NymeaSettings(NymeaSettings::SettingsRoleTags).fileName();
+    files << NymeaSettings(NymeaSettings::SettingsRoleMqttPolicies).fileName();
+    files << ThingStateCache::defaultFileName();
+    foreach (const QString &file, files) {
+        keyParts << file + (QFile::exists(file) ? ":1" : ":0");
+    }
+    keyParts << NymeaCore::loggingFilters() << NymeaCore::loggingFiltersPlugins();
+    QString key = keyParts.join('\n');
+
+    if (m_debugDocument.isEmpty() || key != m_debugDocumentKey) {
+        qCDebug(dcDebugServer()) << "Building debug interface page";
+        m_debugDocument = createDebugXmlDocument();
+        m_debugDocumentKey = key;
+    }
+    return m_debugDocument;
+}
+
 QByteArray DebugServerHandler::createDebugXmlDocument()
 {
     QByteArray data;
@@ -1403,7 +1641,7 @@ QByteArray DebugServerHandler::createDebugXmlDocument()
 
     writer.writeStartElement("div");
     writer.writeAttribute("class", "download-path-column");
-    writer.writeTextElement("p", NymeaSettings(NymeaSettings::SettingsRoleThingStates).fileName());
+    writer.writeTextElement("p", ThingStateCache::defaultFileName());
     writer.writeEndElement(); // div download-path-column
 
     writer.writeStartElement("div");
@@ -1413,7 +1651,7 @@ QByteArray DebugServerHandler::createDebugXmlDocument()
     writer.writeStartElement("button");
     writer.writeAttribute("class", "button");
     writer.writeAttribute("type", "button");
-    if (!QFile::exists(NymeaSettings(NymeaSettings::SettingsRoleThingStates).fileName())) {
+    if (!QFile::exists(ThingStateCache::defaultFileName())) {
         writer.writeAttribute("disabled", "true");
     }
     writer.writeAttribute("onClick", "downloadFile('/debug/settings/thingstates', 'thingstates.conf')");
@@ -1429,7 +1667,7 @@ QByteArray DebugServerHandler::createDebugXmlDocument()
     writer.writeStartElement("button");
     writer.writeAttribute("class", "button");
     writer.writeAttribute("type", "button");
-    if (!QFile::exists(NymeaSettings(NymeaSettings::SettingsRoleThingStates).fileName())) {
+    if (!QFile::exists(ThingStateCache::defaultFileName())) {
         writer.writeAttribute("disabled", "true");
     }
     writer.writeAttribute("onClick", "showFile('/debug/settings/thingstates')");
@@ -1453,7 +1691,7 @@ QByteArray DebugServerHandler::createDebugXmlDocument()
 
     writer.writeStartElement("div");
     writer.writeAttribute("class", "download-path-column");
-    writer.writeTextElement("p", NymeaSettings(NymeaSettings::SettingsRoleRules).fileName());
+    writer.writeTextElement("p", RuleStore::defaultPath());
     writer.writeEndElement(); // div download-path-column
 
     writer.writeStartElement("div");
@@ -1463,10 +1701,10 @@ QByteArray DebugServerHandler::createDebugXmlDocument()
     writer.writeStartElement("button");
     writer.writeAttribute("class", "button");
     writer.writeAttribute("type", "button");
-    if (!QFile::exists(NymeaSettings(NymeaSettings::SettingsRoleRules).fileName())) {
+    if (!QFile::exists(RuleStore::defaultPath())) {
         writer.writeAttribute("disabled", "true");
     }
-    writer.writeAttribute("onClick", "downloadFile('/debug/settings/rules', 'rules.conf')");
+    writer.writeAttribute("onClick", "downloadFile('/debug/settings/rules', 'rules.txt')");
     writer.writeCharacters(tr("Download"));
     writer.writeEndElement(); // button
     writer.writeEndElement(); // form
@@ -1479,7 +1717,7 @@ QByteArray DebugServerHandler::createDebugXmlDocument()
     writer.writeStartElement("button");
     writer.writeAttribute("class", "button");
     writer.writeAttribute("type", "button");
-    if (!QFile::exists(NymeaSettings(NymeaSettings::SettingsRoleRules).fileName())) {
+    if (!QFile::exists(RuleStore::defaultPath())) {
         writer.writeAttribute("disabled", "true");
     }
     writer.writeAttribute("onClick", "showFile('/debug/settings/rules')");
@@ -36,7 +36,6 @@
 #include <QProcess>
 #include <QUrlQuery>
 #include <QWebSocketServer>
-#include <QMutex>
 
 #include "debugreportgenerator.h"
 #include "servers/httpreply.h"
@@ -54,9 +53,12 @@ public:
 private:
     static QList<QWebSocket*> s_websocketClients;
     static void logMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message);
-    static QMutex s_loggingMutex;
 
     QWebSocketServer *m_websocketServer = nullptr;
+    QTimer *m_logForwardTimer = nullptr;
+
+    QByteArray m_debugDocument;
+    QString m_debugDocumentKey;
 
     QProcess *m_pingProcess = nullptr;
     HttpReply *m_pingReply = nullptr;
@@ -75,6 +77,7 @@ private:
 
     HttpReply *processDebugFileRequest(const QString &requestPath);
 
+    QByteArray debugDocument();
     QByteArray createDebugXmlDocument();
     QByteArray createErrorXmlDocument(HttpReply::HttpStatusCode statusCode, const QString &errorMessage);
 
@@ -84,6 +87,7 @@ private slots:
     void onWebsocketClientConnected();
     void onWebsocketClientDisconnected();
     void onWebsocketClientError(QAbstractSocket::SocketError error);
+    void forwardLogMessages();
 
     void onPingProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
     void onDigProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
@@ -0,0 +1,229 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::EventQueue
+    \brief Decouples the events of things from their processing in the core.
+
+    \ingroup core
+    \inmodule core
+
+    Evaluating rules, logging and notifying clients about an event takes time. A plugin emitting many events
+    at once would keep the event loop busy until all of them are processed. The event queue delivers events in
+    time slices instead: Within an event loop iteration, events are delivered right away until the slice budget
+    (sliceBudget in the [EventQueue] section of nymead.conf, 10 ms by default) is used up. Events coming in after
+    that are queued and delivered in the following iterations, so other work, like client requests, is handled in
+    between.
+
+    While queued, a state change event is superseded by a newer one for the same state. Events of things a user
+    recently executed an action on are delivered before any other queued events, so feedback to the user's
+    actions doesn't wait behind an event storm of other things.
+
+    Events emitted while an event is being delivered, for example by actions executed by rules, are delivered
+    right away, within the delivery of the event causing them, like before.
+*/
+
+#include "eventqueue.h"
+#include "loggingcategories.h"
+
+#include <QTimer>
+
+Q_DECLARE_LOGGING_CATEGORY(dcCore)
+
+namespace nymeaserver {
+
+// How long the events of a thing are preferred after a user executed an action on it, in ms
+static const qint64 userActionWindow = 5000;
+// Queue depths at which a congestion is reported and considered over
+static const int congestionThreshold = 1000;
+static const int congestionRecovered = 100;
+
+EventQueue::EventQueue(int sliceBudget, QObject *parent):
+    QObject(parent),
+    m_sliceBudget(qMax(1, sliceBudget))
+{
+    m_clock.start();
+}
+
+void EventQueue::enqueue(const Event &event)
+{
+    m_enqueued++;
+
+    if (m_delivering > 0) {
+        deliver(event);
+        m_deliveredDirectly++;
+        return;
+    }
+
+    if (!m_sliceActive) {
+        startSlice();
+    }
+    if (m_events.isEmpty() && m_slice.elapsed() < m_sliceBudget) {
+        deliver(event);
+        m_deliveredDirectly++;
+        return;
+    }
+
+    if (event.isStateChangeEvent()) {
+        QPair<ThingId, EventTypeId> key(event.thingId(), event.eventTypeId());
+        quint64 superseded = m_stateEvents.value(key);
+        if (superseded > 0 && m_events.remove(superseded) > 0) {
+            m_coalesced++;
+        }
+    }
+
+    QueuedEvent queued;
+    queued.event = event;
+    queued.lane = isUserThing(event.thingId()) ? LaneUser : LaneNormal;
+    quint64 sequence = ++m_lastSequence;
+    m_events.insert(sequence, queued);
+    m_lanes[queued.lane].enqueue(sequence);
+    if (event.isStateChangeEvent()) {
+        m_stateEvents.insert(qMakePair(event.thingId(), event.eventTypeId()), sequence);
+    }
+
+    m_maxDepth = qMax(m_maxDepth, m_events.count());
+    if (!m_congested && m_events.count() >= congestionThreshold) {
+        m_congested = true;
+        qCWarning(dcCore()) << "Events are coming in faster than they can be processed." << m_events.count() << "events queued.";
+    }
+}
+
+int EventQueue::depth() const
+{
+    return m_events.count();
+}
+
+QVariantMap EventQueue::statistics() const
+{
+    QVariantMap statistics;
+    statistics.insert("depth", m_events.count());
+    statistics.insert("maxDepth", m_maxDepth);
+    statistics.insert("userLaneDepth", m_lanes[LaneUser].count());
+    statistics.insert("enqueued", m_enqueued);
+    statistics.insert("deliveredDirectly", m_deliveredDirectly);
+    statistics.insert("deliveredQueued", m_deliveredQueued);
+    statistics.insert("coalesced", m_coalesced);
+    statistics.insert("prioritized", m_prioritized);
+    statistics.insert("slices", m_slices);
+    statistics.insert("sliceBudget", m_sliceBudget);
+    statistics.insert("longestSlice", m_longestSlice);
+    return statistics;
+}
+
+void EventQueue::onActionExecuted(const Action &action, Thing::ThingError status)
+{
+    Q_UNUSED(status)
+    if (action.triggeredBy() != Action::TriggeredByUser) {
+        return;
+    }
+    m_userThings.insert(action.thingId(), m_clock.elapsed());
+
+    // Events of the thing queued already, like the state changes caused by the action, move ahead too
+    QQueue<quint64> &normal = m_lanes[LaneNormal];
+    for (int i = 0; i < normal.count(); i++) {
+        QHash<quint64, QueuedEvent>::iterator it = m_events.find(normal.at(i));
+        if (it != m_events.end() && it->lane == LaneNormal && it->event.thingId() == action.thingId()) {
+            it->lane = LaneUser;
+            m_lanes[LaneUser].enqueue(it.key());
+            m_prioritized++;
+        }
+    }
+}
+
+void EventQueue::processQueue()
+{
+    m_slice.restart();
+    m_slices++;
+
+    while (!m_events.isEmpty() && m_slice.elapsed() < m_sliceBudget) {
+        Lane lane = m_lanes[LaneUser].isEmpty() ? LaneNormal : LaneUser;
+        quint64 sequence = m_lanes[lane].dequeue();
+        QHash<quint64, QueuedEvent>::iterator it = m_events.find(sequence);
+        // Superseded, or moved to the other lane
+        if (it == m_events.end() || it->lane != lane) {
+            continue;
+        }
+        Event event = it->event;
+        m_events.erase(it);
+        if (event.isStateChangeEvent()) {
+            QPair<ThingId, EventTypeId> key(event.thingId(), event.eventTypeId());
+            if (m_stateEvents.value(key) == sequence) {
+                m_stateEvents.remove(key);
+            }
+        }
+        deliver(event);
+        m_deliveredQueued++;
+    }
+    m_longestSlice = qMax(m_longestSlice, m_slice.elapsed());
+
+    if (m_events.isEmpty()) {
+        // Drop what's left of superseded events
+        m_lanes[LaneUser].clear();
+        m_lanes[LaneNormal].clear();
+        m_stateEvents.clear();
+    }
+
+    if (m_congested && m_events.count() <= congestionRecovered) {
+        m_congested = false;
+        qCInfo(dcCore()) << "Event queue recovered. Longest slice:" << m_longestSlice << "ms, superseded state changes:" << m_coalesced;
+    }
+
+    // The slice continues until the next event loop iteration, queued events or not
+    QTimer::singleShot(0, this, [this](){
+        if (m_events.isEmpty()) {
+            m_sliceActive = false;
+        } else {
+            processQueue();
+        }
+    });
+}
+
+void EventQueue::deliver(const Event &event)
+{
+    m_delivering++;
+    emit eventReady(event);
+    m_delivering--;
+}
+
+void EventQueue::startSlice()
+{
+    m_sliceActive = true;
+    m_slice.start();
+    QTimer::singleShot(0, this, &EventQueue::processQueue);
+}
+
+bool EventQueue::isUserThing(const ThingId &thingId) const
+{
+    QHash<ThingId, qint64>::const_iterator it = m_userThings.constFind(thingId);
+    return it != m_userThings.constEnd() && m_clock.elapsed() - it.value() < userActionWindow;
+}
+
+}
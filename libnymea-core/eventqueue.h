@@ -0,0 +1,112 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef EVENTQUEUE_H
+#define EVENTQUEUE_H
+
+#include "types/event.h"
+#include "types/action.h"
+#include "integrations/thing.h"
+
+#include <QObject>
+#include <QQueue>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QVariantMap>
+
+namespace nymeaserver {
+
+class EventQueue : public QObject
+{
+    Q_OBJECT
+public:
+    explicit EventQueue(int sliceBudget, QObject *parent = nullptr);
+
+    void enqueue(const Event &event);
+
+    int depth() const;
+    QVariantMap statistics() const;
+
+signals:
+    void eventReady(const Event &event);
+
+public slots:
+    void onActionExecuted(const Action &action, Thing::ThingError status);
+
+private slots:
+    void processQueue();
+
+private:
+    enum Lane {
+        LaneUser = 0,
+        LaneNormal = 1
+    };
+    class QueuedEvent {
+    public:
+        Event event;
+        Lane lane = LaneNormal;
+    };
+
+    void deliver(const Event &event);
+    void startSlice();
+    bool isUserThing(const ThingId &thingId) const;
+
+    // Time budget per event loop iteration, in ms
+    int m_sliceBudget;
+    QElapsedTimer m_slice;
+    bool m_sliceActive = false;
+    int m_delivering = 0;
+
+    quint64 m_lastSequence = 0;
+    QQueue<quint64> m_lanes[2];
+    QHash<quint64, QueuedEvent> m_events;
+    // The queued state change event of a thing's state, superseded by a newer one
+    QHash<QPair<ThingId, EventTypeId>, quint64> m_stateEvents;
+
+    // Things a user executed actions on, with the time of the last one
+    QElapsedTimer m_clock;
+    QHash<ThingId, qint64> m_userThings;
+
+    bool m_congested = false;
+
+    // Metrics
+    quint64 m_enqueued = 0;
+    quint64 m_deliveredDirectly = 0;
+    quint64 m_deliveredQueued = 0;
+    quint64 m_coalesced = 0;
+    quint64 m_prioritized = 0;
+    quint64 m_slices = 0;
+    int m_maxDepth = 0;
+    qint64 m_longestSlice = 0;
+};
+
+}
+
+#endif // EVENTQUEUE_H
@@ -38,34 +38,73 @@
 #include <QDir>
 #include <QDebug>
 #include <QPluginLoader>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QPointer>
+#include <QtConcurrent/QtConcurrent>
 
 namespace nymeaserver {
 
-ExperienceManager::ExperienceManager(ThingManager *thingManager, JsonRPCServer *jsonRpcServer, QObject *parent) : QObject(parent),
+ExperienceManager::ExperienceManager(ThingManager *thingManager, JsonRPCServerImplementation *jsonRpcServer, QObject *parent) : QObject(parent),
     m_thingManager(thingManager),
     m_jsonRpcServer(jsonRpcServer)
 {
+    connect(&m_loadWatcher, &QFutureWatcher<void>::finished, this, &ExperienceManager::pluginLibrariesLoaded);
     staticMetaObject.invokeMethod(this, "loadPlugins", Qt::QueuedConnection);
 }
 
+ExperienceManager::~ExperienceManager()
+{
+    // The worker still uses the pending loaders
+    m_loadWatcher.waitForFinished();
+}
+
 void ExperienceManager::loadPlugins()
 {
-    foreach (const QString &path, pluginSearchDirs()) {
-        QDir dir(path);
-        qCDebug(dcExperiences) << "Loading experience plugins from:" << dir.absolutePath();
-        foreach (const QString &entry, dir.entryList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot)) {
-            QFileInfo fi(path + "/" + entry);
-            if (fi.isFile()) {
-                if (entry.startsWith("libnymea_experienceplugin") && entry.endsWith(".so")) {
-                    loadExperiencePlugin(path + "/" + entry);
-                }
-            } else if (fi.isDir()) {
-                if (QFileInfo::exists(path + "/" + entry + "/libnymea_experienceplugin" + entry + ".so")) {
-                    loadExperiencePlugin(path + "/" +  entry + "/libnymea_experienceplugin" + entry + ".so");
+    QPointer<ExperienceManager> guard(this);
+    foreach (const QString &file, pluginFiles()) {
+        // Reading the metadata does not load the library
+        QPluginLoader metaDataLoader(file);
+        QJsonArray namespaces = metaDataLoader.metaData().value("MetaData").toObject().value("namespaces").toArray();
+        if (namespaces.isEmpty()) {
+            QPluginLoader *loader = new QPluginLoader(file, this);
+            loader->setLoadHints(QLibrary::ResolveAllSymbolsHint);
+            m_pendingLoaders.append(loader);
+            continue;
+        }
+        foreach (const QJsonValue &namespaceValue, namespaces) {
+            QString name = namespaceValue.toObject().value("name").toString();
+            QString version = namespaceValue.toObject().value("version").toString();
+            qCDebug(dcExperiences()) << "Experience plugin" << file << "will be loaded on first use of namespace" << name;
+            m_jsonRpcServer->registerLazyExperience(name, version, [guard, file](){
+                if (guard) {
+                    guard->loadExperiencePlugin(file);
                 }
-            }
+            });
         }
     }
+
+    if (m_pendingLoaders.isEmpty()) {
+        return;
+    }
+
+    // Resolving the libraries is what takes time, do that in a worker thread while the rest of
+    // the startup continues. The plugin instances are created in the main thread once done.
+    QList<QPluginLoader*> loaders = m_pendingLoaders;
+    m_loadWatcher.setFuture(QtConcurrent::run([loaders](){
+        foreach (QPluginLoader *loader, loaders) {
+            loader->load();
+        }
+    }));
+}
+
+void ExperienceManager::pluginLibrariesLoaded()
+{
+    foreach (QPluginLoader *loader, m_pendingLoaders) {
+        initExperiencePlugin(loader);
+        loader->deleteLater();
+    }
+    m_pendingLoaders.clear();
 }
 
 QStringList ExperienceManager::pluginSearchDirs() const
@@ -85,22 +124,54 @@ QStringList ExperienceManager::pluginSearchDirs() const
     return searchDirs;
 }
 
+QStringList ExperienceManager::pluginFiles() const
+{
+    QStringList files;
+    foreach (const QString &path, pluginSearchDirs()) {
+        QDir dir(path);
+        qCDebug(dcExperiences) << "Loading experience plugins from:" << dir.absolutePath();
+        foreach (const QString &entry, dir.entryList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot)) {
+            QFileInfo fi(path + "/" + entry);
+            if (fi.isFile()) {
+                if (entry.startsWith("libnymea_experienceplugin") && entry.endsWith(".so")) {
+                    files.append(path + "/" + entry);
+                }
+            } else if (fi.isDir()) {
+                if (QFileInfo::exists(path + "/" + entry + "/libnymea_experienceplugin" + entry + ".so")) {
+                    files.append(path + "/" +  entry + "/libnymea_experienceplugin" + entry + ".so");
+                }
+            }
+        }
+    }
+    return files;
+}
+
 void ExperienceManager::loadExperiencePlugin(const QString &file)
 {
     QPluginLoader loader;
     loader.setFileName(file);
     loader.setLoadHints(QLibrary::ResolveAllSymbolsHint);
-    if (!loader.load()) {
-        qCWarning(dcExperiences()) << loader.errorString();
+    loader.load();
+    initExperiencePlugin(&loader);
+}
+
+void ExperienceManager::initExperiencePlugin(QPluginLoader *loader)
+{
+    if (m_loadedFiles.contains(loader->fileName())) {
+        return;
+    }
+    if (!loader->isLoaded()) {
+        qCWarning(dcExperiences()) << loader->errorString();
         return;
     }
-    ExperiencePlugin *plugin = qobject_cast<ExperiencePlugin*>(loader.instance());
+    ExperiencePlugin *plugin = qobject_cast<ExperiencePlugin*>(loader->instance());
     if (!plugin) {
-        qCWarning(dcExperiences()) << "Could not get plugin instance of" << loader.fileName();
-        loader.unload();
+        qCWarning(dcExperiences()) << "Could not get plugin instance of" << loader->fileName();
+        loader->unload();
         return;
     }
-    qCDebug(dcExperiences()) << "Loaded experience plugin:" << loader.fileName();
+    qCDebug(dcExperiences()) << "Loaded experience plugin:" << loader->fileName();
+    m_loadedFiles.insert(loader->fileName());
     m_plugins.append(plugin);
     plugin->setParent(this);
     plugin->initPlugin(m_thingManager, m_jsonRpcServer);
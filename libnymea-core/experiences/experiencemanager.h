@@ -32,18 +32,24 @@
 #define EXPERIENCEMANAGER_H
 
 #include <QObject>
+#include <QFutureWatcher>
+#include <QSet>
 
 class ExperiencePlugin;
 class JsonRPCServer;
 class ThingManager;
+class QPluginLoader;
 
 namespace nymeaserver {
 
+class JsonRPCServerImplementation;
+
 class ExperienceManager : public QObject
 {
     Q_OBJECT
 public:
-    explicit ExperienceManager(ThingManager *thingManager, JsonRPCServer *jsonRpcServer, QObject *parent = nullptr);
+    explicit ExperienceManager(ThingManager *thingManager, JsonRPCServerImplementation *jsonRpcServer, QObject *parent = nullptr);
+    ~ExperienceManager() override;
 
 signals:
 
@@ -51,18 +57,26 @@ public slots:
 
 private slots:
     void loadPlugins();
+    void pluginLibrariesLoaded();
 
 private:
     QStringList pluginSearchDirs() const;
+    QStringList pluginFiles() const;
 
 private:
     ThingManager *m_thingManager = nullptr;
-    JsonRPCServer *m_jsonRpcServer = nullptr;
+    JsonRPCServerImplementation *m_jsonRpcServer = nullptr;
 
     void loadExperiencePlugin(const QString &file);
+    void initExperiencePlugin(QPluginLoader *loader);
 
 private:
     QList<ExperiencePlugin*> m_plugins;
+    QSet<QString> m_loadedFiles;
+
+    // Plugins without declared namespaces, their libraries are loaded in a worker thread
+    QList<QPluginLoader*> m_pendingLoaders;
+    QFutureWatcher<void> m_loadWatcher;
 };
 
 }
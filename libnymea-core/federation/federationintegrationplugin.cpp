@@ -0,0 +1,437 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::FederationIntegrationPlugin
+    \brief Mirrors the things of a federation peer.
+
+    \ingroup core
+    \inmodule core
+
+    There is one such plugin per peer. Its thing classes are copies of the thing classes of the peer's things,
+    packed the way Integrations.GetThingClasses returns them. The ids of the thing classes are derived from the
+    peer's uuid and the original id, so they don't clash with the ones of plugins loaded here. The ids of
+    states, events and actions are kept, so values and actions can be passed on as they are.
+
+    Mirrored things are auto things. They carry the id of the thing on the peer as their only param.
+    Actions on them are executed by the peer. Thing classes of mirrored things are never mirrored themselves,
+    which keeps peers mirroring each other from looping.
+*/
+
+#include "federationintegrationplugin.h"
+#include "federationpeer.h"
+
+#include "integrations/thing.h"
+#include "integrations/thingdescriptor.h"
+#include "integrations/thingsetupinfo.h"
+#include "integrations/thingactioninfo.h"
+
+#include <QMetaEnum>
+#include <QJsonObject>
+#include <QRegExp>
+
+namespace nymeaserver {
+
+static const QUuid federationNamespace = QUuid("8bdf9c65-5979-4aee-b024-4eb5868410be");
+static const VendorId federationVendorId = VendorId("7eef15d4-dfaf-4113-a35a-6dd6f24004b0");
+
+// JSON-RPC basic type names to the type names in plugin metadata
+static QString metadataType(const QString &basicType)
+{
+    static const QHash<QString, QString> types = {
+        {"Uuid", "QUuid"}, {"String", "QString"}, {"StringList", "QStringList"}, {"Int", "int"}, {"Uint", "uint"},
+        {"Double", "double"}, {"Bool", "bool"}, {"Variant", "QVariant"}, {"Color", "QColor"}, {"Time", "QTime"},
+        {"Object", "QVariantMap"}
+    };
+    return types.value(basicType, "QVariant");
+}
+
+// JSON-RPC enum value names to plugin metadata ones, e.g. UnitDegreeCelsius to DegreeCelsius
+static QString metadataEnumValue(const QString &value, const QString &prefix)
+{
+    return value.startsWith(prefix) ? value.mid(prefix.length()) : value;
+}
+
+FederationIntegrationPlugin::FederationIntegrationPlugin(const QUuid &peerUuid, const QString &peerName, const QVariantList &thingClasses, QObject *parent):
+    IntegrationPlugin(parent),
+    m_peerUuid(peerUuid),
+    m_peerName(peerName)
+{
+    setMetaData(buildMetadata(thingClasses));
+}
+
+PluginId FederationIntegrationPlugin::pluginIdForPeer(const QUuid &peerUuid)
+{
+    return PluginId(QUuid::createUuidV5(federationNamespace, "plugin" + peerUuid.toString()));
+}
+
+bool FederationIntegrationPlugin::isMirroredThingClass(const QVariantMap &thingClass)
+{
+    return VendorId(thingClass.value("vendorId").toString()) == federationVendorId;
+}
+
+QList<ThingClassId> FederationIntegrationPlugin::remoteThingClassIds() const
+{
+    return m_remoteThingClassIds.values();
+}
+
+void FederationIntegrationPlugin::setPeer(FederationPeer *peer)
+{
+    // Called again on every reconnect
+    if (m_peer == peer) {
+        return;
+    }
+    m_peer = peer;
+    connect(peer, &FederationPeer::thingChanged, this, &FederationIntegrationPlugin::onThingChanged);
+    connect(peer, &FederationPeer::thingRemoved, this, &FederationIntegrationPlugin::onThingRemoved);
+    connect(peer, &FederationPeer::statesChanged, this, &FederationIntegrationPlugin::onStatesChanged);
+    connect(peer, &FederationPeer::eventTriggered, this, &FederationIntegrationPlugin::onEventTriggered);
+    connect(peer, &FederationPeer::synced, this, &FederationIntegrationPlugin::onSynced);
+    peer->addKnownThingClasses(remoteThingClassIds());
+
+    if (m_monitoring) {
+        foreach (const ThingId &remoteThingId, peer->thingIds()) {
+            onThingChanged(remoteThingId);
+        }
+    }
+}
+
+QVariantMap FederationIntegrationPlugin::statistics() const
+{
+    QVariantMap statistics;
+    statistics.insert("thingClasses", m_remoteThingClassIds.count());
+    statistics.insert("mirroredThings", m_mirrors.count());
+    statistics.insert("actions", m_actions);
+    statistics.insert("failedActions", m_failedActions);
+    return statistics;
+}
+
+void FederationIntegrationPlugin::startMonitoringAutoThings()
+{
+    // Mirrors are only added once the configured ones are set up
+    m_monitoring = true;
+    if (m_peer) {
+        foreach (const ThingId &remoteThingId, m_peer->thingIds()) {
+            onThingChanged(remoteThingId);
+        }
+    }
+}
+
+void FederationIntegrationPlugin::setupThing(ThingSetupInfo *info)
+{
+    ThingId remoteId = remoteIdOf(info->thing());
+    m_appearingMirrors.remove(remoteId);
+    m_mirrors.insert(remoteId, info->thing());
+
+    if (m_peer && !m_peer->thing(remoteId).thingClassId.isNull()) {
+        info->thing()->setStateValues(m_peer->thing(remoteId).states);
+    }
+    info->finish(Thing::ThingErrorNoError);
+}
+
+void FederationIntegrationPlugin::thingRemoved(Thing *thing)
+{
+    m_mirrors.remove(remoteIdOf(thing));
+}
+
+void FederationIntegrationPlugin::executeAction(ThingActionInfo *info)
+{
+    if (!m_peer || !m_peer->connected()) {
+        m_failedActions++;
+        info->finish(Thing::ThingErrorHardwareNotAvailable, tr("%1 is not connected.").arg(m_peerName));
+        return;
+    }
+
+    QVariantList params;
+    foreach (const Param &param, info->action().params()) {
+        QVariantMap paramMap;
+        paramMap.insert("paramTypeId", param.paramTypeId().toString());
+        paramMap.insert("value", param.value());
+        params.append(paramMap);
+    }
+    QVariantMap actionParams;
+    actionParams.insert("thingId", remoteIdOf(info->thing()).toString());
+    actionParams.insert("actionTypeId", info->action().actionTypeId().toString());
+    actionParams.insert("params", params);
+
+    m_actions++;
+    QPointer<ThingActionInfo> guard(info);
+    m_peer->call("Integrations.ExecuteAction", actionParams, [this, guard](bool success, const QVariantMap &reply){
+        if (!guard) {
+            return;
+        }
+        if (!success) {
+            m_failedActions++;
+            guard->finish(Thing::ThingErrorHardwareFailure, tr("%1 could not execute the action.").arg(m_peerName));
+            return;
+        }
+        bool ok = false;
+        QMetaEnum metaEnum = QMetaEnum::fromType<Thing::ThingError>();
+        Thing::ThingError error = static_cast<Thing::ThingError>(metaEnum.keyToValue(reply.value("thingError").toByteArray().constData(), &ok));
+        if (!ok) {
+            error = Thing::ThingErrorHardwareFailure;
+        }
+        if (error != Thing::ThingErrorNoError) {
+            m_failedActions++;
+        }
+        guard->finish(error, reply.value("displayMessage").toString());
+    });
+}
+
+void FederationIntegrationPlugin::onThingChanged(const ThingId &remoteThingId)
+{
+    FederationPeer::RemoteThing remoteThing = m_peer->thing(remoteThingId);
+    Thing *thing = m_mirrors.value(remoteThingId);
+    if (thing) {
+        if (thing->name() != remoteThing.name) {
+            thing->setName(remoteThing.name);
+        }
+        thing->setStateValues(remoteThing.states);
+        return;
+    }
+    if (!m_monitoring || m_appearingMirrors.contains(remoteThingId)) {
+        return;
+    }
+
+    ThingClassId thingClassId = mirroredThingClassId(m_peerUuid, remoteThing.thingClassId);
+    qCDebug(dcFederation()) << "Mirroring" << remoteThing.name << remoteThingId.toString() << "of" << m_peerName;
+    ThingDescriptor descriptor(thingClassId, remoteThing.name, m_peerName);
+    descriptor.setParams(ParamList() << Param(remoteThingIdParamTypeId(thingClassId), remoteThingId.toString()));
+    m_appearingMirrors.insert(remoteThingId);
+    emit autoThingsAppeared({descriptor});
+}
+
+void FederationIntegrationPlugin::onThingRemoved(const ThingId &remoteThingId)
+{
+    Thing *thing = m_mirrors.value(remoteThingId);
+    if (thing) {
+        qCDebug(dcFederation()) << "Removing the mirror of" << thing->name() << "as it has been removed from" << m_peerName;
+        emit autoThingDisappeared(thing->id());
+    }
+}
+
+void FederationIntegrationPlugin::onStatesChanged(const ThingId &remoteThingId, const QHash<StateTypeId, QVariant> &values)
+{
+    Thing *thing = m_mirrors.value(remoteThingId);
+    if (thing) {
+        thing->setStateValues(values);
+    }
+}
+
+void FederationIntegrationPlugin::onEventTriggered(const ThingId &remoteThingId, const EventTypeId &eventTypeId, const ParamList &params)
+{
+    Thing *thing = m_mirrors.value(remoteThingId);
+    if (thing) {
+        thing->emitEvent(eventTypeId, params);
+    }
+}
+
+void FederationIntegrationPlugin::onSynced(const QList<ThingId> &remoteThingIds)
+{
+    QSet<ThingId> existing = remoteThingIds.toSet();
+    foreach (const ThingId &remoteThingId, m_mirrors.keys()) {
+        if (!existing.contains(remoteThingId)) {
+            onThingRemoved(remoteThingId);
+        }
+    }
+}
+
+ThingClassId FederationIntegrationPlugin::mirroredThingClassId(const QUuid &peerUuid, const ThingClassId &remoteThingClassId)
+{
+    return ThingClassId(QUuid::createUuidV5(federationNamespace, peerUuid.toString() + remoteThingClassId.toString()));
+}
+
+ParamTypeId FederationIntegrationPlugin::remoteThingIdParamTypeId(const ThingClassId &thingClassId)
+{
+    return ParamTypeId(QUuid::createUuidV5(federationNamespace, "remoteThingId" + thingClassId.toString()));
+}
+
+QVariantMap FederationIntegrationPlugin::mirrorThingClass(const QVariantMap &thingClass) const
+{
+    ThingClassId thingClassId = mirroredThingClassId(m_peerUuid, ThingClassId(thingClass.value("id").toString()));
+
+    QVariantMap remoteThingIdParam;
+    remoteThingIdParam.insert("id", remoteThingIdParamTypeId(thingClassId).toString());
+    remoteThingIdParam.insert("name", "remoteThingId");
+    remoteThingIdParam.insert("displayName", tr("Thing ID on %1").arg(m_peerName));
+    remoteThingIdParam.insert("type", "QString");
+    remoteThingIdParam.insert("readOnly", true);
+
+    // States come with an event and, if writable, an action of the same id
+    QHash<QString, QVariantMap> actionTypes;
+    foreach (const QVariant &actionType, thingClass.value("actionTypes").toList()) {
+        actionTypes.insert(actionType.toMap().value("id").toString(), actionType.toMap());
+    }
+    QHash<QString, QVariantMap> eventTypes;
+    foreach (const QVariant &eventType, thingClass.value("eventTypes").toList()) {
+        eventTypes.insert(eventType.toMap().value("id").toString(), eventType.toMap());
+    }
+
+    QVariantList stateTypes;
+    foreach (const QVariant &stateTypeVariant, thingClass.value("stateTypes").toList()) {
+        QVariantMap remote = stateTypeVariant.toMap();
+        QString id = remote.value("id").toString();
+        QVariantMap stateType;
+        stateType.insert("id", id);
+        stateType.insert("name", remote.value("name"));
+        stateType.insert("displayName", remote.value("displayName"));
+        stateType.insert("displayNameEvent", eventTypes.take(id).value("displayName", remote.value("displayName")));
+        stateType.insert("type", metadataType(remote.value("type").toString()));
+        stateType.insert("defaultValue", remote.value("defaultValue"));
+        foreach (const QString &property, QStringList({"minValue", "maxValue", "possibleValues"})) {
+            if (remote.contains(property)) {
+                stateType.insert(property, remote.value(property));
+            }
+        }
+        QString unit = metadataEnumValue(remote.value("unit").toString(), "Unit");
+        if (!unit.isEmpty() && unit != "None") {
+            stateType.insert("unit", unit);
+        }
+        QString ioType = metadataEnumValue(remote.value("ioType").toString(), "IOType");
+        if (!ioType.isEmpty() && ioType != "None") {
+            ioType[0] = ioType.at(0).toLower();
+            stateType.insert("ioType", ioType);
+        }
+        if (actionTypes.contains(id)) {
+            stateType.insert("writable", true);
+            stateType.insert("displayNameAction", actionTypes.take(id).value("displayName"));
+        }
+        stateTypes.append(stateType);
+    }
+
+    QVariantList mirroredActionTypes;
+    foreach (const QVariant &actionTypeVariant, thingClass.value("actionTypes").toList()) {
+        QVariantMap remote = actionTypeVariant.toMap();
+        if (!actionTypes.contains(remote.value("id").toString())) {
+            continue;
+        }
+        QVariantMap actionType;
+        actionType.insert("id", remote.value("id"));
+        actionType.insert("name", remote.value("name"));
+        actionType.insert("displayName", remote.value("displayName"));
+        actionType.insert("paramTypes", mirrorParamTypes(remote.value("paramTypes").toList()));
+        mirroredActionTypes.append(actionType);
+    }
+
+    QVariantList mirroredEventTypes;
+    foreach (const QVariant &eventTypeVariant, thingClass.value("eventTypes").toList()) {
+        QVariantMap remote = eventTypeVariant.toMap();
+        if (!eventTypes.contains(remote.value("id").toString())) {
+            continue;
+        }
+        QVariantMap eventType;
+        eventType.insert("id", remote.value("id"));
+        eventType.insert("name", remote.value("name"));
+        eventType.insert("displayName", remote.value("displayName"));
+        eventType.insert("paramTypes", mirrorParamTypes(remote.value("paramTypes").toList()));
+        mirroredEventTypes.append(eventType);
+    }
+
+    QVariantMap mirrored;
+    mirrored.insert("id", thingClassId.toString());
+    mirrored.insert("name", thingClass.value("name"));
+    mirrored.insert("displayName", thingClass.value("displayName"));
+    mirrored.insert("createMethods", QVariantList({"auto"}));
+    mirrored.insert("interfaces", thingClass.value("interfaces"));
+    mirrored.insert("paramTypes", QVariantList({remoteThingIdParam}));
+    mirrored.insert("stateTypes", stateTypes);
+    mirrored.insert("actionTypes", mirroredActionTypes);
+    mirrored.insert("eventTypes", mirroredEventTypes);
+    return mirrored;
+}
+
+QVariantList FederationIntegrationPlugin::mirrorParamTypes(const QVariantList &paramTypes)
+{
+    QVariantList mirrored;
+    foreach (const QVariant &paramTypeVariant, paramTypes) {
+        QVariantMap remote = paramTypeVariant.toMap();
+        QVariantMap paramType;
+        paramType.insert("id", remote.value("id"));
+        paramType.insert("name", remote.value("name"));
+        paramType.insert("displayName", remote.value("displayName"));
+        paramType.insert("type", metadataType(remote.value("type").toString()));
+        foreach (const QString &property, QStringList({"defaultValue", "minValue", "maxValue", "allowedValues", "readOnly"})) {
+            if (remote.contains(property)) {
+                paramType.insert(property, remote.value(property));
+            }
+        }
+        QString inputType = metadataEnumValue(remote.value("inputType").toString(), "InputType");
+        if (!inputType.isEmpty() && inputType != "None") {
+            paramType.insert("inputType", inputType);
+        }
+        QString unit = metadataEnumValue(remote.value("unit").toString(), "Unit");
+        if (!unit.isEmpty() && unit != "None") {
+            paramType.insert("unit", unit);
+        }
+        mirrored.append(paramType);
+    }
+    return mirrored;
+}
+
+PluginMetadata FederationIntegrationPlugin::buildMetadata(const QVariantList &thingClasses)
+{
+    QVariantMap vendor;
+    vendor.insert("id", federationVendorId.toString());
+    vendor.insert("name", "nymeaFederation");
+    vendor.insert("displayName", tr("nymea federation"));
+
+    QVariantMap pluginMetadata;
+    pluginMetadata.insert("id", pluginIdForPeer(m_peerUuid).toString());
+    pluginMetadata.insert("name", "federation" + m_peerUuid.toString().remove(QRegExp("[{}-]")));
+    pluginMetadata.insert("displayName", tr("Things of %1").arg(m_peerName));
+
+    // A thing class the metadata can't be built for, e.g. because the peer runs a different version of
+    // nymea, is left out instead of the whole plugin
+    QVariantList mirroredThingClasses;
+    foreach (const QVariant &thingClassVariant, thingClasses) {
+        QVariantMap thingClass = thingClassVariant.toMap();
+        QVariantMap mirrored = mirrorThingClass(thingClass);
+        vendor.insert("thingClasses", QVariantList({mirrored}));
+        pluginMetadata.insert("vendors", QVariantList({vendor}));
+        PluginMetadata metadata(QJsonObject::fromVariantMap(pluginMetadata), true, false);
+        if (!metadata.isValid()) {
+            qCWarning(dcFederation()) << "Cannot mirror thing class" << thingClass.value("name").toString() << "of" << m_peerName << ":" << metadata.validationErrors();
+            continue;
+        }
+        mirroredThingClasses.append(mirrored);
+        m_remoteThingClassIds.insert(ThingClassId(mirrored.value("id").toString()), ThingClassId(thingClass.value("id").toString()));
+    }
+
+    vendor.insert("thingClasses", mirroredThingClasses);
+    pluginMetadata.insert("vendors", QVariantList({vendor}));
+    return PluginMetadata(QJsonObject::fromVariantMap(pluginMetadata), true, false);
+}
+
+ThingId FederationIntegrationPlugin::remoteIdOf(Thing *thing) const
+{
+    return ThingId(thing->paramValue(remoteThingIdParamTypeId(thing->thingClassId())).toString());
+}
+
+}
@@ -0,0 +1,101 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FEDERATIONINTEGRATIONPLUGIN_H
+#define FEDERATIONINTEGRATIONPLUGIN_H
+
+#include "integrations/integrationplugin.h"
+
+#include <QObject>
+#include <QPointer>
+#include <QUuid>
+#include <QSet>
+
+namespace nymeaserver {
+
+class FederationPeer;
+
+/* Mirrors the things of a federation peer. The thing classes are those of the peer's things,
+   with ids derived from the peer's uuid. Actions are executed by the peer. */
+class FederationIntegrationPlugin : public IntegrationPlugin
+{
+    Q_OBJECT
+public:
+    explicit FederationIntegrationPlugin(const QUuid &peerUuid, const QString &peerName, const QVariantList &thingClasses, QObject *parent = nullptr);
+
+    static PluginId pluginIdForPeer(const QUuid &peerUuid);
+    // Whether the thing class, packed like Integrations.GetThingClasses, is one of mirrored things
+    static bool isMirroredThingClass(const QVariantMap &thingClass);
+
+    // The ids of the peer's thing classes being mirrored
+    QList<ThingClassId> remoteThingClassIds() const;
+
+    void setPeer(FederationPeer *peer);
+
+    QVariantMap statistics() const;
+
+    void startMonitoringAutoThings() override;
+    void setupThing(ThingSetupInfo *info) override;
+    void thingRemoved(Thing *thing) override;
+    void executeAction(ThingActionInfo *info) override;
+
+private slots:
+    void onThingChanged(const ThingId &remoteThingId);
+    void onThingRemoved(const ThingId &remoteThingId);
+    void onStatesChanged(const ThingId &remoteThingId, const QHash<StateTypeId, QVariant> &values);
+    void onEventTriggered(const ThingId &remoteThingId, const EventTypeId &eventTypeId, const ParamList &params);
+    void onSynced(const QList<ThingId> &remoteThingIds);
+
+private:
+    static ThingClassId mirroredThingClassId(const QUuid &peerUuid, const ThingClassId &remoteThingClassId);
+    static ParamTypeId remoteThingIdParamTypeId(const ThingClassId &thingClassId);
+    QVariantMap mirrorThingClass(const QVariantMap &thingClass) const;
+    static QVariantList mirrorParamTypes(const QVariantList &paramTypes);
+    PluginMetadata buildMetadata(const QVariantList &thingClasses);
+
+    ThingId remoteIdOf(Thing *thing) const;
+
+    QUuid m_peerUuid;
+    QString m_peerName;
+    QPointer<FederationPeer> m_peer;
+    bool m_monitoring = false;
+
+    // Mirrored thing class id to the peer's one
+    QHash<ThingClassId, ThingClassId> m_remoteThingClassIds;
+    QHash<ThingId, Thing*> m_mirrors;
+    QSet<ThingId> m_appearingMirrors;
+
+    quint64 m_actions = 0;
+    quint64 m_failedActions = 0;
+};
+
+}
+
+#endif // FEDERATIONINTEGRATIONPLUGIN_H
@@ -0,0 +1,239 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::FederationManager
+    \brief Federates this nymea instance with others.
+
+    \ingroup core
+    \inmodule core
+
+    In federation mode, the things of other nymea instances, the peers, are mirrored in this one. Clients and
+    rules here can use them like any other thing, actions on them are executed by the instance owning them.
+    Each instance stays in charge of its own hardware, so instances can be placed close to their radios in
+    large installations and still be used through one of them.
+
+    The peers are configured in the Federation group of nymead.conf as a list of URLs, e.g.
+    \c {peers=nymeas://floor1.local:2222, nymeas://floor2.local:2222}. If the peers require
+    authentication, \c token holds the token of a user known to them. The certificates of the peers are
+    pinned on first contact in the FederationCertificates group. Peers may mirror each other.
+
+    The thing classes of a peer are cached, so its mirrored things are available right away on startup,
+    with their last known states, before the peer is connected.
+*/
+
+#include "federationmanager.h"
+#include "federationpeer.h"
+#include "federationintegrationplugin.h"
+#include "integrations/thingmanagerimplementation.h"
+#include "nymeaconfiguration.h"
+#include "nymeasettings.h"
+#include "loggingcategories.h"
+
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+
+NYMEA_LOGGING_CATEGORY(dcFederation, "Federation")
+
+namespace nymeaserver {
+
+FederationManager::FederationManager(NymeaConfiguration *configuration, ThingManagerImplementation *thingManager, QObject *parent):
+    QObject(parent),
+    m_thingManager(thingManager),
+    m_serverUuid(configuration->serverUuid())
+{
+    connect(thingManager, &ThingManagerImplementation::loaded, this, [this](){
+        m_thingsLoaded = true;
+    });
+
+    // The mirrors of known peers are set up along with the other things
+    loadCache();
+    foreach (const QUuid &uuid, m_cachedPeers.keys()) {
+        registerPlugin(uuid);
+    }
+
+    QByteArray token = configuration->federationToken();
+    foreach (const QString &peerUrl, configuration->federationPeers()) {
+        QUrl url(peerUrl.trimmed());
+        if (!url.isValid() || url.host().isEmpty() || (url.scheme() != "nymea" && url.scheme() != "nymeas")) {
+            qCWarning(dcFederation()) << "Invalid federation peer" << peerUrl << ". Expected a nymea:// or nymeas:// URL.";
+            continue;
+        }
+        FederationPeer *peer = new FederationPeer(url, token, this);
+        connect(peer, &FederationPeer::identified, this, &FederationManager::onIdentified);
+        connect(peer, &FederationPeer::thingClassesReceived, this, &FederationManager::onThingClassesReceived);
+        m_peers.append(peer);
+        peer->start();
+    }
+}
+
+QVariantMap FederationManager::statistics() const
+{
+    QVariantList peers;
+    foreach (FederationPeer *peer, m_peers) {
+        QVariantMap peerStatistics = peer->statistics();
+        FederationIntegrationPlugin *plugin = m_plugins.value(peer->uuid());
+        if (plugin) {
+            peerStatistics.unite(plugin->statistics());
+        }
+        peers.append(peerStatistics);
+    }
+    QVariantMap statistics;
+    statistics.insert("peers", peers);
+    statistics.insert("cachedPeers", m_cachedPeers.count());
+    return statistics;
+}
+
+void FederationManager::onIdentified(const QUuid &uuid, const QString &name)
+{
+    FederationPeer *peer = qobject_cast<FederationPeer*>(sender());
+    if (uuid == m_serverUuid) {
+        qCWarning(dcFederation()) << peer->url().toString() << "is this nymea instance. Not federating with it.";
+        peer->stop();
+        return;
+    }
+    foreach (FederationPeer *other, m_peers) {
+        if (other != peer && other->uuid() == uuid) {
+            qCWarning(dcFederation()) << peer->url().toString() << "is the same nymea instance as" << other->url().toString() << ". Not federating with it twice.";
+            peer->stop();
+            return;
+        }
+    }
+
+    if (m_cachedPeers.contains(uuid) && m_cachedPeers.value(uuid).name != name) {
+        m_cachedPeers[uuid].name = name;
+        storeCache(uuid);
+    }
+    FederationIntegrationPlugin *plugin = m_plugins.value(uuid);
+    if (plugin) {
+        plugin->setPeer(peer);
+    }
+}
+
+void FederationManager::onThingClassesReceived(const QVariantList &thingClasses)
+{
+    FederationPeer *peer = qobject_cast<FederationPeer*>(sender());
+    CachedPeer &cachedPeer = m_cachedPeers[peer->uuid()];
+    cachedPeer.name = peer->name();
+
+    QSet<QString> cachedIds;
+    foreach (const QVariant &thingClass, cachedPeer.thingClasses) {
+        cachedIds.insert(thingClass.toMap().value("id").toString());
+    }
+    int added = 0;
+    foreach (const QVariant &thingClass, thingClasses) {
+        QVariantMap thingClassMap = thingClass.toMap();
+        if (FederationIntegrationPlugin::isMirroredThingClass(thingClassMap) || cachedIds.contains(thingClassMap.value("id").toString())) {
+            continue;
+        }
+        cachedPeer.thingClasses.append(thingClassMap);
+        added++;
+    }
+    if (added == 0) {
+        return;
+    }
+    storeCache(peer->uuid());
+
+    if (m_plugins.contains(peer->uuid())) {
+        // Thing classes of a loaded plugin are fixed
+        qCInfo(dcFederation()) << peer->name() << "has" << added << "new thing classes. Their things will be mirrored after restarting nymea.";
+        return;
+    }
+
+    FederationIntegrationPlugin *plugin = registerPlugin(peer->uuid());
+    if (plugin) {
+        plugin->setPeer(peer);
+        if (m_thingsLoaded) {
+            plugin->startMonitoringAutoThings();
+        }
+    }
+}
+
+QString FederationManager::cachePath()
+{
+    return NymeaSettings::storagePath() + "/federation/";
+}
+
+void FederationManager::loadCache()
+{
+    QDir dir(cachePath());
+    foreach (const QString &fileName, dir.entryList({"*.json"}, QDir::Files)) {
+        QFile file(dir.absoluteFilePath(fileName));
+        if (!file.open(QFile::ReadOnly)) {
+            qCWarning(dcFederation()) << "Cannot open" << file.fileName() << file.errorString();
+            continue;
+        }
+        QVariantMap cache = QJsonDocument::fromJson(file.readAll()).toVariant().toMap();
+        QUuid uuid = cache.value("uuid").toUuid();
+        if (uuid.isNull()) {
+            qCWarning(dcFederation()) << "Ignoring invalid federation cache" << file.fileName();
+            continue;
+        }
+        CachedPeer cachedPeer;
+        cachedPeer.name = cache.value("name").toString();
+        cachedPeer.thingClasses = cache.value("thingClasses").toList();
+        m_cachedPeers.insert(uuid, cachedPeer);
+    }
+}
+
+void FederationManager::storeCache(const QUuid &uuid)
+{
+    QDir dir;
+    dir.mkpath(cachePath());
+    QFile file(cachePath() + uuid.toString().remove('{').remove('}') + ".json");
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        qCWarning(dcFederation()) << "Cannot write federation cache" << file.fileName() << file.errorString();
+        return;
+    }
+    CachedPeer cachedPeer = m_cachedPeers.value(uuid);
+    QVariantMap cache;
+    cache.insert("uuid", uuid.toString());
+    cache.insert("name", cachedPeer.name);
+    cache.insert("thingClasses", cachedPeer.thingClasses);
+    file.write(QJsonDocument::fromVariant(cache).toJson(QJsonDocument::Compact));
+}
+
+FederationIntegrationPlugin *FederationManager::registerPlugin(const QUuid &uuid)
+{
+    CachedPeer cachedPeer = m_cachedPeers.value(uuid);
+    FederationIntegrationPlugin *plugin = new FederationIntegrationPlugin(uuid, cachedPeer.name, cachedPeer.thingClasses);
+    if (!plugin->metadata().isValid()) {
+        qCWarning(dcFederation()) << "Cannot mirror the things of" << cachedPeer.name << plugin->metadata().validationErrors();
+        delete plugin;
+        return nullptr;
+    }
+    qCDebug(dcFederation()) << "Mirroring" << plugin->remoteThingClassIds().count() << "thing classes of" << cachedPeer.name;
+    m_thingManager->registerStaticPlugin(plugin);
+    m_plugins.insert(uuid, plugin);
+    return plugin;
+}
+
+}
@@ -0,0 +1,555 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::FederationPeer
+    \brief A connection to another nymea instance the things of which are mirrored here.
+
+    \ingroup core
+    \inmodule core
+
+    The peer is accessed through its regular JSON-RPC API. After JSONRPC.Hello, the connection switches to CBOR
+    encoding if the peer supports it. The things of the peer are fetched with Integrations.GetThings and kept
+    up to date by the Integrations notifications. After a reconnect, only what changed in the meantime is
+    fetched with Integrations.GetChanges, starting at the revision of the last sync.
+
+    For \c nymeas:// URLs, the certificate of the peer is trusted on first use and the connection is refused
+    if it changes later on.
+*/
+
+#include "federationpeer.h"
+#include "nymeasettings.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSslCertificate>
+#include <QCryptographicHash>
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+#include <QCborValue>
+#include <QCborStreamReader>
+#endif
+
+namespace nymeaserver {
+
+FederationPeer::FederationPeer(const QUrl &url, const QByteArray &token, QObject *parent):
+    QObject(parent),
+    m_url(url),
+    m_token(token)
+{
+    m_reconnectTimer.setSingleShot(true);
+    connect(&m_reconnectTimer, &QTimer::timeout, this, &FederationPeer::start);
+}
+
+QUrl FederationPeer::url() const
+{
+    return m_url;
+}
+
+QUuid FederationPeer::uuid() const
+{
+    return m_uuid;
+}
+
+QString FederationPeer::name() const
+{
+    return m_name;
+}
+
+bool FederationPeer::connected() const
+{
+    return m_connected;
+}
+
+void FederationPeer::addKnownThingClasses(const QList<ThingClassId> &thingClassIds)
+{
+    foreach (const ThingClassId &thingClassId, thingClassIds) {
+        m_knownThingClasses.insert(thingClassId);
+    }
+}
+
+QList<ThingId> FederationPeer::thingIds() const
+{
+    QList<ThingId> thingIds;
+    for (QHash<ThingId, RemoteThing>::const_iterator it = m_things.constBegin(); it != m_things.constEnd(); ++it) {
+        if (m_knownThingClasses.contains(it.value().thingClassId)) {
+            thingIds.append(it.key());
+        }
+    }
+    return thingIds;
+}
+
+FederationPeer::RemoteThing FederationPeer::thing(const ThingId &thingId) const
+{
+    return m_things.value(thingId);
+}
+
+void FederationPeer::call(const QString &method, const QVariantMap &params, ReplyHandler handler)
+{
+    if (!m_socket || m_socket->state() != QAbstractSocket::ConnectedState) {
+        if (handler) {
+            handler(false, QVariantMap());
+        }
+        return;
+    }
+
+    QVariantMap message;
+    message.insert("id", ++m_lastCallId);
+    message.insert("method", method);
+    if (!params.isEmpty()) {
+        message.insert("params", params);
+    }
+    if (!m_token.isEmpty()) {
+        message.insert("token", m_token);
+    }
+    if (handler) {
+        m_pendingCalls.insert(m_lastCallId, handler);
+    }
+    m_calls++;
+    send(message);
+}
+
+QVariantMap FederationPeer::statistics() const
+{
+    QVariantMap statistics;
+    statistics.insert("url", m_url.toString());
+    statistics.insert("uuid", m_uuid.toString());
+    statistics.insert("name", m_name);
+    statistics.insert("connected", m_connected);
+    statistics.insert("encoding", m_cbor ? "cbor" : "json");
+    statistics.insert("revision", m_revision);
+    statistics.insert("things", m_things.count());
+    statistics.insert("knownThingClasses", m_knownThingClasses.count());
+    statistics.insert("bytesReceived", m_bytesReceived);
+    statistics.insert("bytesSent", m_bytesSent);
+    statistics.insert("messagesReceived", m_messagesReceived);
+    statistics.insert("stateChanges", m_stateChanges);
+    statistics.insert("events", m_events);
+    statistics.insert("calls", m_calls);
+    statistics.insert("pendingCalls", m_pendingCalls.count());
+    statistics.insert("fullSyncs", m_fullSyncs);
+    statistics.insert("deltaSyncs", m_deltaSyncs);
+    statistics.insert("reconnects", m_reconnects);
+    return statistics;
+}
+
+void FederationPeer::start()
+{
+    m_running = true;
+    if (!m_socket) {
+        m_socket = new QSslSocket(this);
+        connect(m_socket, &QSslSocket::connected, this, [this](){
+            if (m_url.scheme() != "nymeas") {
+                onConnected();
+            }
+        });
+        connect(m_socket, &QSslSocket::encrypted, this, &FederationPeer::onConnected);
+        connect(m_socket, &QSslSocket::disconnected, this, &FederationPeer::onDisconnected);
+        connect(m_socket, &QSslSocket::readyRead, this, &FederationPeer::onReadyRead);
+        connect(m_socket, static_cast<void(QSslSocket::*)(const QList<QSslError> &)>(&QSslSocket::sslErrors), this, &FederationPeer::onSslErrors);
+        connect(m_socket, static_cast<void(QSslSocket::*)(QAbstractSocket::SocketError)>(&QSslSocket::error), this, [this](QAbstractSocket::SocketError error){
+            qCDebug(dcFederation()) << "Connection to" << m_url.toString() << "failed:" << error;
+            if (m_socket->state() == QAbstractSocket::UnconnectedState) {
+                onDisconnected();
+            }
+        });
+    }
+    if (m_socket->state() != QAbstractSocket::UnconnectedState) {
+        return;
+    }
+
+    qCDebug(dcFederation()) << "Connecting to" << m_url.toString();
+    if (m_url.scheme() == "nymeas") {
+        m_socket->connectToHostEncrypted(m_url.host(), static_cast<quint16>(m_url.port(2222)));
+    } else {
+        m_socket->connectToHost(m_url.host(), static_cast<quint16>(m_url.port(2222)));
+    }
+}
+
+void FederationPeer::stop()
+{
+    m_running = false;
+    m_reconnectTimer.stop();
+    if (m_socket) {
+        m_socket->abort();
+    }
+}
+
+void FederationPeer::onConnected()
+{
+    qCDebug(dcFederation()) << "Connected to" << m_url.toString();
+    m_reconnectDelay = 0;
+    hello();
+}
+
+void FederationPeer::onDisconnected()
+{
+    m_buffer.clear();
+    m_cbor = false;
+    bool wasConnected = m_connected;
+    m_connected = false;
+    failPendingCalls();
+
+    if (wasConnected) {
+        qCInfo(dcFederation()) << "Disconnected from" << m_name << m_url.toString();
+        emit connectedChanged(false);
+    }
+
+    if (m_running && !m_reconnectTimer.isActive()) {
+        m_reconnectDelay = qBound(1000, m_reconnectDelay * 2, 60000);
+        m_reconnects++;
+        m_reconnectTimer.start(m_reconnectDelay);
+    }
+}
+
+void FederationPeer::onReadyRead()
+{
+    QByteArray data = m_socket->readAll();
+    m_bytesReceived += static_cast<quint64>(data.size());
+    m_buffer.append(data);
+
+    // The encoding might change with any message, so the buffer is parsed one message at a time
+    while (m_socket->state() == QAbstractSocket::ConnectedState && !m_buffer.isEmpty()) {
+        QVariantMap message;
+        if (!m_cbor) {
+            int index = m_buffer.indexOf('\n');
+            if (index < 0) {
+                break;
+            }
+            QJsonParseError error;
+            QJsonDocument jsonDoc = QJsonDocument::fromJson(m_buffer.left(index), &error);
+            m_buffer.remove(0, index + 1);
+            if (error.error != QJsonParseError::NoError) {
+                qCWarning(dcFederation()) << "Failed to parse data from" << m_url.toString() << ":" << error.errorString();
+                continue;
+            }
+            message = jsonDoc.toVariant().toMap();
+        } else {
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+            QCborStreamReader reader(m_buffer);
+            QCborValue value = QCborValue::fromCbor(reader);
+            if (reader.lastError() == QCborError::EndOfFile) {
+                break;
+            }
+            if (reader.lastError() != QCborError::NoError) {
+                qCWarning(dcFederation()) << "Failed to parse CBOR data from" << m_url.toString() << ":" << reader.lastError().toString() << ". Reconnecting.";
+                m_socket->abort();
+                return;
+            }
+            m_buffer.remove(0, static_cast<int>(reader.currentOffset()));
+            message = value.toVariant().toMap();
+#endif
+        }
+        m_messagesReceived++;
+        processMessage(message);
+    }
+
+    if (m_buffer.size() > 16 * 1024 * 1024) {
+        qCWarning(dcFederation()) << "Buffer of" << m_url.toString() << "larger than 16MB without a complete message. Reconnecting.";
+        m_socket->abort();
+    }
+}
+
+void FederationPeer::onSslErrors(const QList<QSslError> &errors)
+{
+    // Peers usually use self signed certificates, pin the one seen first
+    QByteArray digest = m_socket->peerCertificate().digest(QCryptographicHash::Sha256).toHex();
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("FederationCertificates");
+    QString key = m_url.authority();
+    QByteArray pinned = settings.value(key).toByteArray();
+    if (pinned.isEmpty()) {
+        qCInfo(dcFederation()) << "Trusting the certificate of" << m_url.toString() << "with SHA-256 digest" << digest;
+        settings.setValue(key, digest);
+    } else if (pinned != digest) {
+        qCWarning(dcFederation()) << "The certificate of" << m_url.toString() << "changed. Refusing the connection. Remove" << key << "from the FederationCertificates in nymead.conf if this is expected." << errors;
+        settings.endGroup();
+        return;
+    }
+    settings.endGroup();
+    m_socket->ignoreSslErrors(errors);
+}
+
+void FederationPeer::send(const QVariantMap &message)
+{
+    QByteArray data;
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    if (m_cbor) {
+        data = QCborValue::fromJsonValue(QJsonObject::fromVariantMap(message)).toCbor();
+    }
+#endif
+    if (data.isEmpty()) {
+        data = QJsonDocument::fromVariant(message).toJson(QJsonDocument::Compact) + '\n';
+    }
+    m_bytesSent += static_cast<quint64>(data.size());
+    m_socket->write(data);
+}
+
+void FederationPeer::processMessage(const QVariantMap &message)
+{
+    if (message.contains("notification")) {
+        processNotification(message.value("notification").toString(), message.value("params").toMap());
+        return;
+    }
+
+    ReplyHandler handler = m_pendingCalls.take(message.value("id").toInt());
+    QString status = message.value("status").toString();
+    if (status == "unauthorized") {
+        qCWarning(dcFederation()) << m_url.toString() << "refused the token:" << message.value("error").toString();
+    } else if (status != "success") {
+        qCWarning(dcFederation()) << "Call to" << m_url.toString() << "failed:" << message.value("error").toString();
+    }
+    if (handler) {
+        handler(status == "success", message.value("params").toMap());
+    }
+}
+
+void FederationPeer::processNotification(const QString &notification, const QVariantMap &params)
+{
+    if (notification == "Integrations.StateChanged") {
+        QVariantMap state;
+        state.insert("stateTypeId", params.value("stateTypeId"));
+        state.insert("value", params.value("value"));
+        updateStates(ThingId(params.value("thingId").toString()), {state});
+
+    } else if (notification == "Integrations.StatesChanged") {
+        updateStates(ThingId(params.value("thingId").toString()), params.value("states").toList());
+
+    } else if (notification == "Integrations.EventTriggered") {
+        QVariantMap event = params.value("event").toMap();
+        ThingId thingId = ThingId(event.value("thingId").toString());
+        EventTypeId eventTypeId = EventTypeId(event.value("eventTypeId").toString());
+        QHash<ThingId, RemoteThing>::const_iterator it = m_things.constFind(thingId);
+        // State change events are emitted by the mirrored thing itself
+        if (it == m_things.constEnd() || !m_knownThingClasses.contains(it->thingClassId) || it->states.contains(StateTypeId(eventTypeId))) {
+            return;
+        }
+        ParamList eventParams;
+        foreach (const QVariant &paramVariant, event.value("params").toList()) {
+            QVariantMap param = paramVariant.toMap();
+            eventParams.append(Param(ParamTypeId(param.value("paramTypeId").toString()), param.value("value")));
+        }
+        m_events++;
+        emit eventTriggered(thingId, eventTypeId, eventParams);
+
+    } else if (notification == "Integrations.ThingAdded" || notification == "Integrations.ThingChanged") {
+        QList<ThingId> thingIds = updateThings({params.value("thing")});
+        fetchThingClasses(thingIds, [this, thingIds](){
+            announceThings(thingIds);
+        });
+
+    } else if (notification == "Integrations.ThingRemoved") {
+        ThingId thingId = ThingId(params.value("thingId").toString());
+        RemoteThing thing = m_things.take(thingId);
+        if (m_knownThingClasses.contains(thing.thingClassId)) {
+            emit thingRemoved(thingId);
+        }
+    }
+}
+
+void FederationPeer::hello()
+{
+    QVariantMap params;
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    params.insert("encoding", "EncodingCbor");
+#endif
+    params.insert("batchStates", true);
+    call("JSONRPC.Hello", params, [this](bool success, const QVariantMap &reply){
+        if (!success) {
+            m_socket->abort();
+            return;
+        }
+        m_uuid = reply.value("uuid").toUuid();
+        m_name = reply.value("name").toString();
+        m_cbor = reply.value("encoding").toString() == "EncodingCbor";
+        qCInfo(dcFederation()) << "Connected to" << m_name << m_uuid.toString() << "at" << m_url.toString() << (m_cbor ? "using CBOR" : "using JSON");
+
+        emit identified(m_uuid, m_name);
+        if (!m_running) {
+            return;
+        }
+        m_connected = true;
+        emit connectedChanged(true);
+
+        call("JSONRPC.SetNotificationStatus", {{"namespaces", QStringList({"Integrations"})}});
+        sync();
+    });
+}
+
+void FederationPeer::sync()
+{
+    if (m_revision > 0) {
+        call("Integrations.GetChanges", {{"sinceRevision", m_revision}}, [this](bool success, const QVariantMap &reply){
+            if (!success) {
+                // Unless the connection is gone, fall back to fetching everything
+                if (m_connected) {
+                    m_revision = 0;
+                    sync();
+                }
+                return;
+            }
+            bool full = reply.value("full").toBool();
+            if (full) {
+                m_fullSyncs++;
+                m_things.clear();
+            } else {
+                m_deltaSyncs++;
+            }
+            QList<ThingId> thingIds = updateThings(reply.value("things").toList());
+
+            QHash<ThingId, QVariantList> states;
+            foreach (const QVariant &stateVariant, reply.value("states").toList()) {
+                QVariantMap state = stateVariant.toMap();
+                states[ThingId(state.value("thingId").toString())].append(state);
+            }
+            for (QHash<ThingId, QVariantList>::const_iterator it = states.constBegin(); it != states.constEnd(); ++it) {
+                updateStates(it.key(), it.value());
+            }
+            foreach (const QVariant &thingId, reply.value("removedThingIds").toList()) {
+                RemoteThing thing = m_things.take(ThingId(thingId.toString()));
+                if (m_knownThingClasses.contains(thing.thingClassId)) {
+                    emit thingRemoved(ThingId(thingId.toString()));
+                }
+            }
+            m_revision = reply.value("revision").toULongLong();
+
+            fetchThingClasses(thingIds, [this, thingIds, full](){
+                announceThings(thingIds);
+                if (full) {
+                    emit synced(this->thingIds());
+                }
+            });
+        });
+        return;
+    }
+
+    call("Integrations.GetThings", QVariantMap(), [this](bool success, const QVariantMap &reply){
+        if (!success) {
+            return;
+        }
+        m_fullSyncs++;
+        m_things.clear();
+        QList<ThingId> thingIds = updateThings(reply.value("things").toList());
+        m_revision = reply.value("revision").toULongLong();
+        fetchThingClasses(thingIds, [this, thingIds](){
+            announceThings(thingIds);
+            emit synced(this->thingIds());
+        });
+    });
+}
+
+void FederationPeer::fetchThingClasses(const QList<ThingId> &thingIds, std::function<void ()> done)
+{
+    QList<ThingClassId> requestedThingClassIds;
+    QStringList thingClassIds;
+    foreach (const ThingId &thingId, thingIds) {
+        ThingClassId thingClassId = m_things.value(thingId).thingClassId;
+        if (!m_knownThingClasses.contains(thingClassId) && !m_requestedThingClasses.contains(thingClassId)) {
+            m_requestedThingClasses.insert(thingClassId);
+            requestedThingClassIds.append(thingClassId);
+            thingClassIds.append(thingClassId.toString());
+        }
+    }
+    if (thingClassIds.isEmpty()) {
+        done();
+        return;
+    }
+
+    thingClassIds.removeDuplicates();
+    call("Integrations.GetThingClasses", {{"thingClassIds", thingClassIds}}, [this, done, requestedThingClassIds](bool success, const QVariantMap &reply){
+        if (success) {
+            emit thingClassesReceived(reply.value("thingClasses").toList());
+        }
+        // Received classes are known by now. Anything else, e.g. because the call failed,
+        // has to be requested again with the next sync.
+        foreach (const ThingClassId &thingClassId, requestedThingClassIds) {
+            m_requestedThingClasses.remove(thingClassId);
+        }
+        done();
+    });
+}
+
+QList<ThingId> FederationPeer::updateThings(const QVariantList &things)
+{
+    QList<ThingId> thingIds;
+    foreach (const QVariant &thingVariant, things) {
+        QVariantMap thingMap = thingVariant.toMap();
+        ThingId thingId = ThingId(thingMap.value("id").toString());
+        RemoteThing &thing = m_things[thingId];
+        thing.thingClassId = ThingClassId(thingMap.value("thingClassId").toString());
+        thing.name = thingMap.value("name").toString();
+        foreach (const QVariant &stateVariant, thingMap.value("states").toList()) {
+            QVariantMap state = stateVariant.toMap();
+            thing.states.insert(StateTypeId(state.value("stateTypeId").toString()), state.value("value"));
+        }
+        thingIds.append(thingId);
+    }
+    return thingIds;
+}
+
+void FederationPeer::announceThings(const QList<ThingId> &thingIds)
+{
+    foreach (const ThingId &thingId, thingIds) {
+        QHash<ThingId, RemoteThing>::const_iterator it = m_things.constFind(thingId);
+        if (it != m_things.constEnd() && m_knownThingClasses.contains(it->thingClassId)) {
+            emit thingChanged(thingId);
+        }
+    }
+}
+
+void FederationPeer::updateStates(const ThingId &thingId, const QVariantList &states)
+{
+    QHash<ThingId, RemoteThing>::iterator it = m_things.find(thingId);
+    if (it == m_things.end()) {
+        return;
+    }
+    QHash<StateTypeId, QVariant> values;
+    foreach (const QVariant &stateVariant, states) {
+        QVariantMap state = stateVariant.toMap();
+        StateTypeId stateTypeId = StateTypeId(state.value("stateTypeId").toString());
+        it->states.insert(stateTypeId, state.value("value"));
+        values.insert(stateTypeId, state.value("value"));
+    }
+    m_stateChanges += static_cast<quint64>(values.count());
+    if (m_knownThingClasses.contains(it->thingClassId)) {
+        emit statesChanged(thingId, values);
+    }
+}
+
+void FederationPeer::failPendingCalls()
+{
+    QHash<int, ReplyHandler> pendingCalls = m_pendingCalls;
+    m_pendingCalls.clear();
+    foreach (const ReplyHandler &handler, pendingCalls) {
+        handler(false, QVariantMap());
+    }
+}
+
+}
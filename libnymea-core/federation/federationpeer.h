@@ -0,0 +1,154 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FEDERATIONPEER_H
+#define FEDERATIONPEER_H
+
+#include "typeutils.h"
+#include "types/param.h"
+
+#include <QObject>
+#include <QUrl>
+#include <QUuid>
+#include <QSslSocket>
+#include <QTimer>
+#include <QVariantMap>
+#include <QSet>
+#include <QLoggingCategory>
+
+#include <functional>
+
+Q_DECLARE_LOGGING_CATEGORY(dcFederation)
+
+namespace nymeaserver {
+
+class FederationPeer : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<void(bool success, const QVariantMap &params)> ReplyHandler;
+
+    class RemoteThing {
+    public:
+        ThingClassId thingClassId;
+        QString name;
+        QHash<StateTypeId, QVariant> states;
+    };
+
+    explicit FederationPeer(const QUrl &url, const QByteArray &token, QObject *parent = nullptr);
+
+    QUrl url() const;
+    QUuid uuid() const;
+    QString name() const;
+    bool connected() const;
+
+    // Things of these thing classes are announced, things of other classes are only tracked
+    void addKnownThingClasses(const QList<ThingClassId> &thingClassIds);
+
+    QList<ThingId> thingIds() const;
+    RemoteThing thing(const ThingId &thingId) const;
+
+    void call(const QString &method, const QVariantMap &params, ReplyHandler handler = nullptr);
+
+    QVariantMap statistics() const;
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void connectedChanged(bool connected);
+    // The peer introduced itself in JSONRPC.Hello
+    void identified(const QUuid &uuid, const QString &name);
+    // The peer has things of thing classes not known locally yet, packed like Integrations.GetThingClasses
+    void thingClassesReceived(const QVariantList &thingClasses);
+
+    void thingChanged(const ThingId &thingId);
+    void thingRemoved(const ThingId &thingId);
+    void statesChanged(const ThingId &thingId, const QHash<StateTypeId, QVariant> &values);
+    void eventTriggered(const ThingId &thingId, const EventTypeId &eventTypeId, const ParamList &params);
+    // A full sync finished, things not in the list are gone
+    void synced(const QList<ThingId> &thingIds);
+
+private slots:
+    void onConnected();
+    void onDisconnected();
+    void onReadyRead();
+    void onSslErrors(const QList<QSslError> &errors);
+
+private:
+    void send(const QVariantMap &message);
+    void processMessage(const QVariantMap &message);
+    void processNotification(const QString &notification, const QVariantMap &params);
+
+    void hello();
+    void sync();
+    void fetchThingClasses(const QList<ThingId> &thingIds, std::function<void()> done);
+    QList<ThingId> updateThings(const QVariantList &things);
+    void announceThings(const QList<ThingId> &thingIds);
+    void updateStates(const ThingId &thingId, const QVariantList &states);
+    void failPendingCalls();
+
+    QUrl m_url;
+    QByteArray m_token;
+    QSslSocket *m_socket = nullptr;
+    QTimer m_reconnectTimer;
+    int m_reconnectDelay = 0;
+    bool m_running = false;
+
+    QUuid m_uuid;
+    QString m_name;
+    bool m_connected = false;
+    bool m_cbor = false;
+    QByteArray m_buffer;
+
+    int m_lastCallId = 0;
+    QHash<int, ReplyHandler> m_pendingCalls;
+
+    QSet<ThingClassId> m_knownThingClasses;
+    QSet<ThingClassId> m_requestedThingClasses;
+    QHash<ThingId, RemoteThing> m_things;
+    quint64 m_revision = 0;
+
+    // Statistics
+    quint64 m_bytesReceived = 0;
+    quint64 m_bytesSent = 0;
+    quint64 m_messagesReceived = 0;
+    quint64 m_stateChanges = 0;
+    quint64 m_events = 0;
+    quint64 m_calls = 0;
+    quint64 m_fullSyncs = 0;
+    quint64 m_deltaSyncs = 0;
+    quint64 m_reconnects = 0;
+};
+
+}
+
+#endif // FEDERATIONPEER_H
@@ -79,11 +79,20 @@ void BluetoothLowEnergyDeviceImplementation::setEnabled(const bool &enabled)
         m_controller->disconnectFromDevice();
     } else {
         if (m_autoConnecting) {
-            m_controller->connectToDevice();
+            connectDevice();
         }
     }
 }
 
+void BluetoothLowEnergyDeviceImplementation::establishConnection()
+{
+    if (!m_enabled || m_controller->state() != QLowEnergyController::UnconnectedState)
+        return;
+
+    qCDebug(dcBluetooth()) << "Connecting to" << name() << address().toString();
+    m_controller->connectToDevice();
+}
+
 void BluetoothLowEnergyDeviceImplementation::onConnected()
 {
     setConnected(true);
@@ -124,7 +133,7 @@ void BluetoothLowEnergyDeviceImplementation::connectDevice()
     if (m_controller->state() != QLowEnergyController::UnconnectedState)
         return;
 
-    m_controller->connectToDevice();
+    emit connectionRequested();
 }
 
 void BluetoothLowEnergyDeviceImplementation::disconnectDevice()
@@ -79,6 +79,11 @@ private:
 
     // Methods called from BluetoothLowEnergyManager
     void setEnabled(const bool &enabled);
+    void establishConnection();
+
+signals:
+    // Connection attempts are scheduled by the BluetoothLowEnergyManager
+    void connectionRequested();
 
 private slots:
     void onConnected();
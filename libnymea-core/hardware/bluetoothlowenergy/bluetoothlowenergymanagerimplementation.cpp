@@ -33,6 +33,14 @@
 
 namespace nymeaserver {
 
+// Devices seen within this time by a running scan are reported to discoveries joining that scan
+static const int cachedDeviceMaxAge = 60;
+
+// Limits per adapter. Parallel connection attempts collide on the radio and most adapters
+// can't keep more than a few connections at the same time.
+static const int maxConnectingDevices = 1;
+static const int maxConnectedDevices = 8;
+
 BluetoothLowEnergyManagerImplementation::BluetoothLowEnergyManagerImplementation(PluginTimer *reconnectTimer, QObject *parent) :
     BluetoothLowEnergyManager(parent),
     m_reconnectTimer(reconnectTimer)
@@ -52,16 +60,20 @@ BluetoothLowEnergyManagerImplementation::BluetoothLowEnergyManagerImplementation
         localDevice.powerOn();
         localDevice.setHostMode(QBluetoothLocalDevice::HostDiscoverable);
         QBluetoothDeviceDiscoveryAgent *discoveryAgent = new QBluetoothDeviceDiscoveryAgent(hostInfo.address(), this);
+        // The scan keeps running until it isn't needed any more
+        discoveryAgent->setLowEnergyDiscoveryTimeout(0);
         connect(discoveryAgent, &QBluetoothDeviceDiscoveryAgent::deviceDiscovered, this, &BluetoothLowEnergyManagerImplementation::onDeviceDiscovered);
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+        connect(discoveryAgent, &QBluetoothDeviceDiscoveryAgent::deviceUpdated, this, [this](const QBluetoothDeviceInfo &deviceInfo, QBluetoothDeviceInfo::Fields updatedFields){
+            Q_UNUSED(updatedFields)
+            onDeviceDiscovered(deviceInfo);
+        });
+#endif
+        connect(discoveryAgent, &QBluetoothDeviceDiscoveryAgent::finished, this, &BluetoothLowEnergyManagerImplementation::onDiscoveryFinished);
         connect(discoveryAgent, SIGNAL(error(QBluetoothDeviceDiscoveryAgent::Error)), this, SLOT(onDiscoveryError(QBluetoothDeviceDiscoveryAgent::Error)));
         m_bluetoothDiscoveryAgents.append(discoveryAgent);
     }
 
-    // Discovery timer, interval depends on discovery call
-    m_timer = new QTimer(this);
-    m_timer->setSingleShot(true);
-    connect(m_timer, &QTimer::timeout, this, &BluetoothLowEnergyManagerImplementation::onDiscoveryTimeout);
-
     // Reconnect timer
     connect(m_reconnectTimer, &PluginTimer::timeout, this, &BluetoothLowEnergyManagerImplementation::onReconnectTimeout);
 
@@ -87,22 +99,6 @@ BluetoothDiscoveryReply *BluetoothLowEnergyManagerImplementation::discoverDevice
         return reply.data();
     }
 
-    if (!m_currentReply.isNull()) {
-        qCWarning(dcBluetooth()) << "resource busy. There is already a discovery running.";
-        reply->setError(BluetoothDiscoveryReplyImplementation::BluetoothDiscoveryReplyErrorBusy);
-        reply->setFinished();
-        return reply.data();
-    }
-
-    m_currentReply = reply;
-    m_discoveredDevices.clear();
-
-    // Start discovery on all adapters
-    qCDebug(dcBluetooth()) << "Start bluetooth discovery";
-    foreach (QBluetoothDeviceDiscoveryAgent *discoveryAgent, m_bluetoothDiscoveryAgents) {
-        discoveryAgent->start();
-    }
-
     // Prevent blocking the hardware resource from plugins
     int finalInterval = interval;
     if (finalInterval > 30000) {
@@ -115,7 +111,25 @@ BluetoothDiscoveryReply *BluetoothLowEnergyManagerImplementation::discoverDevice
         finalInterval = 5000;
     }
 
-    m_timer->start(finalInterval);
+    // Join the running scan if there is one, devices it has seen recently count for this discovery too
+    QList<QBluetoothDeviceInfo> discoveredDevices;
+    if (m_scanning) {
+        QDateTime oldestSeen = QDateTime::currentDateTime().addSecs(-cachedDeviceMaxAge);
+        foreach (const CachedDevice &cachedDevice, m_deviceCache) {
+            if (cachedDevice.lastSeen >= oldestSeen) {
+                discoveredDevices.append(cachedDevice.deviceInfo);
+            }
+        }
+        qCDebug(dcBluetooth()) << "Joining running bluetooth discovery with" << discoveredDevices.count() << "recently seen devices";
+    }
+    m_runningDiscoveries.insert(reply.data(), discoveredDevices);
+
+    BluetoothDiscoveryReplyImplementation *replyPtr = reply.data();
+    QTimer::singleShot(finalInterval, this, [this, replyPtr, reply](){
+        finishDiscovery(replyPtr, reply);
+    });
+
+    updateScanning();
     return reply.data();
 }
 
@@ -124,6 +138,8 @@ BluetoothLowEnergyDevice *BluetoothLowEnergyManagerImplementation::registerDevic
     QPointer<BluetoothLowEnergyDeviceImplementation> bluetoothDevice = new BluetoothLowEnergyDeviceImplementation(deviceInfo, addressType, this);
     qCDebug(dcBluetooth()) << "Register device" << bluetoothDevice->name() << bluetoothDevice->address().toString();
     m_devices.append(bluetoothDevice);
+    connect(bluetoothDevice, &BluetoothLowEnergyDeviceImplementation::connectionRequested, this, &BluetoothLowEnergyManagerImplementation::onConnectionRequested);
+    connect(bluetoothDevice, &BluetoothLowEnergyDeviceImplementation::stateChanged, this, &BluetoothLowEnergyManagerImplementation::onDeviceStateChanged);
     return bluetoothDevice.data();
 }
 
@@ -140,9 +156,44 @@ void BluetoothLowEnergyManagerImplementation::unregisterDevice(BluetoothLowEnerg
     foreach (QPointer<BluetoothLowEnergyDeviceImplementation> dPointer, m_devices) {
         if (devicePointer.data() == dPointer.data()) {
             m_devices.removeAll(dPointer);
+            m_connectionQueue.removeAll(dPointer);
+            m_connectingDevices.removeAll(dPointer);
             dPointer->deleteLater();
         }
     }
+    processConnectionQueue();
+}
+
+void BluetoothLowEnergyManagerImplementation::subscribeAdvertisements(QObject *subscriber)
+{
+    if (m_advertisementSubscribers.contains(subscriber))
+        return;
+
+    qCDebug(dcBluetooth()) << "Advertisement subscriber added" << subscriber;
+    m_advertisementSubscribers.append(subscriber);
+    connect(subscriber, &QObject::destroyed, this, [this, subscriber](){
+        unsubscribeAdvertisements(subscriber);
+    });
+    updateScanning();
+}
+
+void BluetoothLowEnergyManagerImplementation::unsubscribeAdvertisements(QObject *subscriber)
+{
+    if (!m_advertisementSubscribers.removeAll(subscriber))
+        return;
+
+    qCDebug(dcBluetooth()) << "Advertisement subscriber removed" << subscriber;
+    disconnect(subscriber, &QObject::destroyed, this, nullptr);
+    updateScanning();
+}
+
+QList<QBluetoothDeviceInfo> BluetoothLowEnergyManagerImplementation::cachedDevices() const
+{
+    QList<QBluetoothDeviceInfo> devices;
+    foreach (const CachedDevice &cachedDevice, m_deviceCache) {
+        devices.append(cachedDevice.deviceInfo);
+    }
+    return devices;
 }
 
 bool BluetoothLowEnergyManagerImplementation::available() const
@@ -176,6 +227,7 @@ void BluetoothLowEnergyManagerImplementation::setEnabled(bool enabled)
     if (success) {
         m_enabled = enabled;
         emit enabledChanged(m_enabled);
+        updateScanning();
     }
 }
 
@@ -189,44 +241,84 @@ void BluetoothLowEnergyManagerImplementation::onReconnectTimeout()
     }
 }
 
-void BluetoothLowEnergyManagerImplementation::onDiscoveryTimeout()
+void BluetoothLowEnergyManagerImplementation::updateScanning()
+{
+    bool scanningRequired = m_available && m_enabled && (!m_runningDiscoveries.isEmpty() || !m_advertisementSubscribers.isEmpty());
+    if (scanningRequired == m_scanning)
+        return;
+
+    m_scanning = scanningRequired;
+    if (m_scanning) {
+        qCDebug(dcBluetooth()) << "Start bluetooth discovery";
+        foreach (QBluetoothDeviceDiscoveryAgent *discoveryAgent, m_bluetoothDiscoveryAgents) {
+            discoveryAgent->start();
+        }
+    } else {
+        qCDebug(dcBluetooth()) << "Stop bluetooth discovery";
+        foreach (QBluetoothDeviceDiscoveryAgent *discoveryAgent, m_bluetoothDiscoveryAgents) {
+            discoveryAgent->stop();
+        }
+    }
+}
+
+void BluetoothLowEnergyManagerImplementation::finishDiscovery(BluetoothDiscoveryReplyImplementation *discovery, QPointer<BluetoothDiscoveryReplyImplementation> reply)
 {
-    // Stop discovery on all adapters
-    qCDebug(dcBluetooth()) << "Stop bluetooth discovery";
-    foreach (QBluetoothDeviceDiscoveryAgent *discoveryAgent, m_bluetoothDiscoveryAgents) {
-        discoveryAgent->stop();
+    QList<QBluetoothDeviceInfo> discoveredDevices = m_runningDiscoveries.take(discovery);
+    updateScanning();
+
+    // Forget devices which haven't been seen for a long time, addresses of many devices rotate
+    QDateTime oldestSeen = QDateTime::currentDateTime().addSecs(-10 * cachedDeviceMaxAge);
+    QHash<quint64, CachedDevice>::iterator it = m_deviceCache.begin();
+    while (it != m_deviceCache.end()) {
+        if (it->lastSeen < oldestSeen) {
+            it = m_deviceCache.erase(it);
+        } else {
+            ++it;
+        }
     }
 
-    qCDebug(dcBluetooth()) << "Discovery finished. Found" << m_discoveredDevices.count() << "bluetooth devices.";
+    qCDebug(dcBluetooth()) << "Discovery finished. Found" << discoveredDevices.count() << "bluetooth devices.";
 
-    if (m_currentReply.isNull()) {
+    if (reply.isNull()) {
         qCWarning(dcBluetooth()) << "Reply does not exist any more. Please don't delete the reply before it has finished.";
-        m_currentReply.clear();
         return;
     }
 
-    m_currentReply->setError(BluetoothDiscoveryReply::BluetoothDiscoveryReplyErrorNoError);
-    m_currentReply->setDiscoveredDevices(m_discoveredDevices);
-    m_currentReply->setFinished();
-
-    m_currentReply.clear();
+    reply->setError(BluetoothDiscoveryReply::BluetoothDiscoveryReplyErrorNoError);
+    reply->setDiscoveredDevices(discoveredDevices);
+    reply->setFinished();
 }
 
 void BluetoothLowEnergyManagerImplementation::onDeviceDiscovered(const QBluetoothDeviceInfo &deviceInfo)
 {
-    // Add the device to the list if not already added
-    bool alreadyAdded = false;
-    foreach (const QBluetoothDeviceInfo &device, m_discoveredDevices) {
-        if (device.address() == deviceInfo.address()) {
-            alreadyAdded = true;
-        }
-    }
-
     // Note: only show low energy devices
-    if (!alreadyAdded && deviceInfo.coreConfigurations() & QBluetoothDeviceInfo::LowEnergyCoreConfiguration) {
+    if (!(deviceInfo.coreConfigurations() & QBluetoothDeviceInfo::LowEnergyCoreConfiguration))
+        return;
+
+    quint64 address = deviceInfo.address().toUInt64();
+    if (!m_deviceCache.contains(address)) {
         qCDebug(dcBluetooth()) << "device discovered" << deviceInfo.name() << deviceInfo.address().toString();
-        m_discoveredDevices.append(deviceInfo);
     }
+    m_deviceCache[address].deviceInfo = deviceInfo;
+    m_deviceCache[address].lastSeen = QDateTime::currentDateTime();
+
+    // Add the device to all running discoveries which don't have it yet
+    foreach (BluetoothDiscoveryReplyImplementation *reply, m_runningDiscoveries.keys()) {
+        QList<QBluetoothDeviceInfo> &discoveredDevices = m_runningDiscoveries[reply];
+        bool alreadyAdded = false;
+        for (int i = 0; i < discoveredDevices.count(); i++) {
+            if (discoveredDevices.at(i).address() == deviceInfo.address()) {
+                discoveredDevices[i] = deviceInfo;
+                alreadyAdded = true;
+                break;
+            }
+        }
+        if (!alreadyAdded) {
+            discoveredDevices.append(deviceInfo);
+        }
+    }
+
+    emit advertisementReceived(deviceInfo);
 }
 
 void BluetoothLowEnergyManagerImplementation::onDiscoveryError(const QBluetoothDeviceDiscoveryAgent::Error &error)
@@ -235,6 +327,68 @@ void BluetoothLowEnergyManagerImplementation::onDiscoveryError(const QBluetoothD
     qCWarning(dcBluetooth()) << "Discovery error:" << error << discoveryAgent->errorString();
 }
 
+void BluetoothLowEnergyManagerImplementation::onDiscoveryFinished()
+{
+    // The stack may end a scan on its own, keep it going as long as someone needs it
+    if (m_scanning) {
+        QBluetoothDeviceDiscoveryAgent *discoveryAgent = static_cast<QBluetoothDeviceDiscoveryAgent *>(sender());
+        qCDebug(dcBluetooth()) << "Restarting bluetooth discovery";
+        discoveryAgent->start();
+    }
+}
+
+void BluetoothLowEnergyManagerImplementation::onConnectionRequested()
+{
+    QPointer<BluetoothLowEnergyDeviceImplementation> device = static_cast<BluetoothLowEnergyDeviceImplementation *>(sender());
+    if (m_connectionQueue.contains(device) || m_connectingDevices.contains(device))
+        return;
+
+    m_connectionQueue.append(device);
+    processConnectionQueue();
+}
+
+void BluetoothLowEnergyManagerImplementation::onDeviceStateChanged(const QLowEnergyController::ControllerState &state)
+{
+    // A connection attempt is done once the services are known or the connection failed
+    if (state != QLowEnergyController::DiscoveredState && state != QLowEnergyController::UnconnectedState)
+        return;
+
+    QPointer<BluetoothLowEnergyDeviceImplementation> device = static_cast<BluetoothLowEnergyDeviceImplementation *>(sender());
+    if (m_connectingDevices.removeAll(device) > 0 || state == QLowEnergyController::UnconnectedState) {
+        processConnectionQueue();
+    }
+}
+
+void BluetoothLowEnergyManagerImplementation::processConnectionQueue()
+{
+    m_connectionQueue.removeAll(nullptr);
+    m_connectingDevices.removeAll(nullptr);
+
+    while (!m_connectionQueue.isEmpty() && m_connectingDevices.count() < maxConnectingDevices) {
+        int connectedDevices = 0;
+        foreach (BluetoothLowEnergyDevice *device, m_devices) {
+            if (device && device->controller()->state() != QLowEnergyController::UnconnectedState) {
+                connectedDevices++;
+            }
+        }
+        if (connectedDevices >= maxConnectedDevices) {
+            qCDebug(dcBluetooth()) << "Maximum number of connections reached." << m_connectionQueue.count() << "devices waiting for a connection.";
+            return;
+        }
+
+        QPointer<BluetoothLowEnergyDeviceImplementation> device = m_connectionQueue.takeFirst();
+        if (device->controller()->state() != QLowEnergyController::UnconnectedState)
+            continue;
+
+        m_connectingDevices.append(device);
+        device->establishConnection();
+        if (device->controller()->state() == QLowEnergyController::UnconnectedState) {
+            // Did not start, e.g. because the device got disabled meanwhile
+            m_connectingDevices.removeAll(device);
+        }
+    }
+}
+
 bool BluetoothLowEnergyManagerImplementation::enable()
 {
     if (!available()) {
@@ -34,6 +34,7 @@
 #include <QTimer>
 #include <QObject>
 #include <QPointer>
+#include <QDateTime>
 #include <QBluetoothDeviceInfo>
 #include <QBluetoothLocalDevice>
 #include <QBluetoothDeviceDiscoveryAgent>
@@ -61,6 +62,10 @@ public:
     BluetoothLowEnergyDevice *registerDevice(const QBluetoothDeviceInfo &deviceInfo, const QLowEnergyController::RemoteAddressType &addressType = QLowEnergyController::RandomAddress) override;
     void unregisterDevice(BluetoothLowEnergyDevice *bluetoothDevice) override;
 
+    void subscribeAdvertisements(QObject *subscriber) override;
+    void unsubscribeAdvertisements(QObject *subscriber) override;
+    QList<QBluetoothDeviceInfo> cachedDevices() const override;
+
     bool available() const override;
     bool enabled() const override;
 
@@ -68,22 +73,40 @@ protected:
     void setEnabled(bool enabled) override;
 
 private:
+    class CachedDevice {
+    public:
+        QBluetoothDeviceInfo deviceInfo;
+        QDateTime lastSeen;
+    };
+
     PluginTimer *m_reconnectTimer = nullptr;
-    QTimer *m_timer = nullptr;
     QList<QPointer<BluetoothLowEnergyDeviceImplementation>> m_devices;
 
     bool m_available = false;
     bool m_enabled = false;
 
+    // One shared scan for all discoveries and advertisement subscribers
     QList<QBluetoothDeviceDiscoveryAgent *> m_bluetoothDiscoveryAgents;
-    QList<QBluetoothDeviceInfo> m_discoveredDevices;
-    QPointer<BluetoothDiscoveryReplyImplementation> m_currentReply;
+    bool m_scanning = false;
+    QHash<BluetoothDiscoveryReplyImplementation*, QList<QBluetoothDeviceInfo>> m_runningDiscoveries;
+    QList<QObject*> m_advertisementSubscribers;
+    QHash<quint64, CachedDevice> m_deviceCache;
+
+    // Connection attempts are serialized, one adapter can only establish one connection at a time
+    QList<QPointer<BluetoothLowEnergyDeviceImplementation>> m_connectionQueue;
+    QList<QPointer<BluetoothLowEnergyDeviceImplementation>> m_connectingDevices;
+
+    void updateScanning();
+    void finishDiscovery(BluetoothDiscoveryReplyImplementation *discovery, QPointer<BluetoothDiscoveryReplyImplementation> reply);
+    void processConnectionQueue();
 
 private slots:
     void onReconnectTimeout();
     void onDeviceDiscovered(const QBluetoothDeviceInfo &deviceInfo);
     void onDiscoveryError(const QBluetoothDeviceDiscoveryAgent::Error &error);
-    void onDiscoveryTimeout();
+    void onDiscoveryFinished();
+    void onConnectionRequested();
+    void onDeviceStateChanged(const QLowEnergyController::ControllerState &state);
 
 public slots:
     bool enable();
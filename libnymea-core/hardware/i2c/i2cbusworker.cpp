@@ -0,0 +1,208 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*!
+    \class nymeaserver::I2CBusWorker
+    \brief Serves all I2C devices of one I2C port in a dedicated thread.
+
+    \ingroup hardware
+    \inmodule core
+
+    Each reader is scheduled on a deadline queue driven by a monotonic clock. The thread sleeps until the
+    next deadline or until a write is queued, so idle buses don't cause any wakeups. Pending writes are
+    always processed before due reads. Due reads are ordered by slave address, so the I2C_SLAVE ioctl is
+    only issued when the address actually changes.
+
+    Readings and write results are delivered to the \l{I2CDevice} in its own thread using queued
+    signal emissions.
+*/
+
+#include "i2cbusworker.h"
+
+#include "hardware/i2c/i2cdevice.h"
+#include "loggingcategories.h"
+
+#include <QMutexLocker>
+#include <algorithm>
+
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+
+namespace nymeaserver {
+
+I2CBusWorker::I2CBusWorker(const QString &portName, int fileDescriptor, QObject *parent):
+    QThread(parent),
+    m_portName(portName),
+    m_fileDescriptor(fileDescriptor)
+{
+    m_clock.start();
+}
+
+I2CBusWorker::~I2CBusWorker()
+{
+    stop();
+}
+
+QString I2CBusWorker::portName() const
+{
+    return m_portName;
+}
+
+void I2CBusWorker::startReading(I2CDevice *i2cDevice, int interval)
+{
+    QMutexLocker locker(&m_mutex);
+
+    ReadingInfo readingInfo;
+    readingInfo.interval = qMax(interval, 1);
+    readingInfo.generation = ++m_generation;
+    m_readers.insert(i2cDevice, readingInfo);
+
+    // The first reading is due right away
+    m_schedule.push({m_clock.elapsed(), i2cDevice, readingInfo.generation});
+    m_wakeup.wakeOne();
+}
+
+void I2CBusWorker::stopReading(I2CDevice *i2cDevice)
+{
+    QMutexLocker locker(&m_mutex);
+    // Entries still in the schedule are dropped lazily as their generation doesn't match any more
+    m_readers.remove(i2cDevice);
+
+    QList<WritingInfo>::iterator it = m_writeQueue.begin();
+    while (it != m_writeQueue.end()) {
+        if (it->device == i2cDevice) {
+            it = m_writeQueue.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void I2CBusWorker::writeData(I2CDevice *i2cDevice, const QByteArray &data)
+{
+    QMutexLocker locker(&m_mutex);
+    WritingInfo info;
+    info.device = i2cDevice;
+    info.data = data;
+    m_writeQueue.append(info);
+    m_wakeup.wakeOne();
+}
+
+void I2CBusWorker::stop()
+{
+    m_mutex.lock();
+    m_stopping = true;
+    m_wakeup.wakeOne();
+    m_mutex.unlock();
+    wait();
+}
+
+void I2CBusWorker::run()
+{
+    QMutexLocker locker(&m_mutex);
+
+    while (!m_stopping) {
+        // Writes are never delayed by reads
+        while (!m_writeQueue.isEmpty()) {
+            WritingInfo info = m_writeQueue.takeFirst();
+            if (!selectAddress(info.device)) {
+                QMetaObject::invokeMethod(info.device, "dataWritten", Qt::QueuedConnection, Q_ARG(bool, false));
+                continue;
+            }
+            qCDebug(dcI2C()) << "Writing to I2C device" << info.device;
+            bool success = info.device->writeData(m_fileDescriptor, info.data);
+            QMetaObject::invokeMethod(info.device, "dataWritten", Qt::QueuedConnection, Q_ARG(bool, success));
+        }
+
+        // Drop schedule entries of readers which have been stopped or restarted in the meantime
+        while (!m_schedule.empty()) {
+            const ScheduledRead &next = m_schedule.top();
+            if (m_readers.contains(next.device) && m_readers.value(next.device).generation == next.generation) {
+                break;
+            }
+            m_schedule.pop();
+        }
+
+        if (m_schedule.empty()) {
+            m_wakeup.wait(&m_mutex);
+            continue;
+        }
+
+        qint64 now = m_clock.elapsed();
+        if (m_schedule.top().deadline > now) {
+            m_wakeup.wait(&m_mutex, static_cast<unsigned long>(m_schedule.top().deadline - now));
+            continue;
+        }
+
+        // Collect everything which is due and read it ordered by slave address
+        QList<ScheduledRead> dueReads;
+        while (!m_schedule.empty() && m_schedule.top().deadline <= now) {
+            ScheduledRead read = m_schedule.top();
+            m_schedule.pop();
+            if (m_readers.contains(read.device) && m_readers.value(read.device).generation == read.generation) {
+                dueReads.append(read);
+            }
+        }
+        std::stable_sort(dueReads.begin(), dueReads.end(), [](const ScheduledRead &a, const ScheduledRead &b) {
+            return a.device->address() < b.device->address();
+        });
+
+        foreach (ScheduledRead read, dueReads) {
+            if (selectAddress(read.device)) {
+                qCDebug(dcI2C()) << "Reading I2C device" << read.device;
+                QByteArray data = read.device->readData(m_fileDescriptor);
+                QMetaObject::invokeMethod(read.device, "readingAvailable", Qt::QueuedConnection, Q_ARG(QByteArray, data));
+            }
+
+            // Keep the cadence of the reader, but don't try to catch up on readings missed while the bus was busy
+            read.deadline += m_readers.value(read.device).interval;
+            now = m_clock.elapsed();
+            if (read.deadline <= now) {
+                read.deadline = now + m_readers.value(read.device).interval;
+            }
+            m_schedule.push(read);
+        }
+    }
+}
+
+bool I2CBusWorker::selectAddress(I2CDevice *i2cDevice)
+{
+    if (m_selectedAddress == i2cDevice->address()) {
+        return true;
+    }
+    if (ioctl(m_fileDescriptor, I2C_SLAVE, i2cDevice->address()) < 0) {
+        qCWarning(dcI2C()) << "Cannot select I2C slave address for I2C device" << i2cDevice;
+        m_selectedAddress = -1;
+        return false;
+    }
+    m_selectedAddress = i2cDevice->address();
+    return true;
+}
+
+}
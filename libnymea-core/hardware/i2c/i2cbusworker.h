@@ -0,0 +1,104 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#ifndef I2CBUSWORKER_H
+#define I2CBUSWORKER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+
+#include <queue>
+#include <vector>
+
+class I2CDevice;
+
+namespace nymeaserver {
+
+class I2CBusWorker : public QThread
+{
+    Q_OBJECT
+public:
+    explicit I2CBusWorker(const QString &portName, int fileDescriptor, QObject *parent = nullptr);
+    ~I2CBusWorker() override;
+
+    QString portName() const;
+
+    void startReading(I2CDevice *i2cDevice, int interval);
+    void stopReading(I2CDevice *i2cDevice);
+    void writeData(I2CDevice *i2cDevice, const QByteArray &data);
+
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    class ReadingInfo {
+    public:
+        int interval;
+        quint64 generation;
+    };
+    class WritingInfo {
+    public:
+        QByteArray data;
+        I2CDevice *device;
+    };
+    class ScheduledRead {
+    public:
+        qint64 deadline;
+        I2CDevice *device;
+        quint64 generation;
+        bool operator>(const ScheduledRead &other) const { return deadline > other.deadline; }
+    };
+
+    bool selectAddress(I2CDevice *i2cDevice);
+
+    QString m_portName;
+    int m_fileDescriptor = -1;
+    int m_selectedAddress = -1;
+
+    QMutex m_mutex;
+    QWaitCondition m_wakeup;
+    bool m_stopping = false;
+
+    // Monotonic clock all deadlines are relative to
+    QElapsedTimer m_clock;
+    quint64 m_generation = 0;
+    QHash<I2CDevice*, ReadingInfo> m_readers;
+    std::priority_queue<ScheduledRead, std::vector<ScheduledRead>, std::greater<ScheduledRead>> m_schedule;
+    QList<WritingInfo> m_writeQueue;
+};
+
+}
+
+#endif // I2CBUSWORKER_H
@@ -35,16 +35,14 @@
 
 #include <QObject>
 #include <QMutex>
-#include <QTimer>
 #include <QHash>
-#include <QFuture>
-#include <QFutureWatcher>
-#include <QDateTime>
 
 class QFile;
 
 namespace nymeaserver {
 
+class I2CBusWorker;
+
 class I2CManagerImplementation : public I2CManager
 {
     Q_OBJECT
@@ -62,31 +60,12 @@ public:
     bool writeData(I2CDevice *i2cDevice, const QByteArray &data) override;
     void close(I2CDevice *i2cDevice) override;
 
-private slots:
-    void nextCycle();
-
 private:
-    class ReadingInfo {
-    public:
-        int interval;
-        QDateTime lastReading;
-    };
-    class WritingInfo {
-    public:
-        QByteArray data;
-        I2CDevice *device;
-    };
-
     QMutex m_mutex;
-    QHash<I2CDevice*, ReadingInfo> m_readers;
     QHash<I2CDevice*, QFile*> m_openFiles;
 
-    QMutex m_writeQueueMutex;
-    QList<WritingInfo> m_writeQueue;
-
-    QFutureWatcher<void> m_watcher;
-
-    QTimer m_pollTimer;
+    // One worker thread per opened I2C port, shared by all devices on that port
+    QHash<QString, I2CBusWorker*> m_workers;
 
 };
 
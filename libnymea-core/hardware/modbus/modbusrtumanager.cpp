@@ -46,24 +46,6 @@ ModbusRtuManager::ModbusRtuManager(SerialPortMonitor *serialPortMonitor, QObject
     // Load uart configurations
     loadRtuMasters();
 
-    connect(m_serialPortMonitor, &SerialPortMonitor::serialPortAdded, this, [=](const QSerialPortInfo &serialPortInfo){
-        qCDebug(dcModbusRtu()) << "Serial port added. Verify modbus RTU masters...";
-
-        // Check if we have to reconnect any modbus RTU masters
-        foreach (ModbusRtuMaster *modbusMaster, m_modbusRtuMasters.values()) {
-            ModbusRtuMasterImpl *modbusMasterImpl = qobject_cast<ModbusRtuMasterImpl *>(modbusMaster);
-
-            // Try only to reconnect if the added serial port matches a disconnected modbus RTU master
-            if (!modbusMasterImpl->connected() && modbusMasterImpl->serialPort() == serialPortInfo.systemLocation()) {
-                if (!modbusMasterImpl->connectDevice()) {
-                    qCDebug(dcModbusRtu()) << "Reconnect" << modbusMaster << "failed.";
-                } else {
-                    qCDebug(dcModbusRtu()) << "Reconnected" << modbusMaster << "successfully.";
-                }
-            }
-        }
-    });
-
     // Try to connect the modbus rtu masters
     foreach (ModbusRtuMaster *modbusMaster, m_modbusRtuMasters.values()) {
         ModbusRtuMasterImpl *modbusMasterImpl = qobject_cast<ModbusRtuMasterImpl *>(modbusMaster);
@@ -158,6 +140,9 @@ ModbusRtuManager::ModbusRtuError ModbusRtuManager::reconfigureModbusRtuMaster(co
     modbusMaster->disconnectDevice();
 
     // Reconfigure
+    if (modbusMaster->serialPort() != serialPort) {
+        watchSerialPort(modbusMaster, serialPort);
+    }
     modbusMaster->setSerialPort(serialPort);
     modbusMaster->setBaudrate(baudrate);
     modbusMaster->setParity(parity);
@@ -258,6 +243,7 @@ void ModbusRtuManager::addModbusRtuMasterInternally(ModbusRtuMasterImpl *modbusR
     ModbusRtuMaster *modbusMaster = qobject_cast<ModbusRtuMaster *>(modbusRtuMaster);
     qCDebug(dcModbusRtu()) << "Adding" << modbusMaster;
     m_modbusRtuMasters.insert(modbusMaster->modbusUuid(), modbusMaster);
+    watchSerialPort(modbusRtuMaster, modbusRtuMaster->serialPort());
 
     connect(modbusMaster, &ModbusRtuMaster::connectedChanged, this, [=](bool connected){
         qCDebug(dcModbusRtu()) << modbusMaster << (connected ? "connected" : "disconnected");
@@ -267,4 +253,20 @@ void ModbusRtuManager::addModbusRtuMasterInternally(ModbusRtuMasterImpl *modbusR
     emit modbusRtuMasterAdded(modbusMaster);
 }
 
+void ModbusRtuManager::watchSerialPort(ModbusRtuMasterImpl *modbusRtuMaster, const QString &serialPort)
+{
+    // Reconnect as soon as the serial port of a disconnected master shows up again
+    m_serialPortMonitor->watchSerialPort(serialPort, modbusRtuMaster, [modbusRtuMaster](const SerialPort &port, bool available){
+        if (!available || modbusRtuMaster->connected() || modbusRtuMaster->serialPort() != port.systemLocation())
+            return;
+
+        qCDebug(dcModbusRtu()) << "Serial port" << port.systemLocation() << "added. Reconnecting" << qobject_cast<ModbusRtuMaster *>(modbusRtuMaster);
+        if (!modbusRtuMaster->connectDevice()) {
+            qCDebug(dcModbusRtu()) << "Reconnect" << qobject_cast<ModbusRtuMaster *>(modbusRtuMaster) << "failed.";
+        } else {
+            qCDebug(dcModbusRtu()) << "Reconnected" << qobject_cast<ModbusRtuMaster *>(modbusRtuMaster) << "successfully.";
+        }
+    });
+}
+
 }
@@ -87,6 +87,7 @@ private:
     void saveModbusRtuMaster(ModbusRtuMaster *modbusRtuMaster);
 
     void addModbusRtuMasterInternally(ModbusRtuMasterImpl *modbusRtuMaster);
+    void watchSerialPort(ModbusRtuMasterImpl *modbusRtuMaster, const QString &serialPort);
 
 };
 
@@ -31,10 +31,13 @@
 #include "modbusrtumasterimpl.h"
 #include "modbusrtureplyimpl.h"
 
+#ifdef WITH_QTSERIALBUS
+#include "modbusrturequestscheduler.h"
+#endif
+
 #include <QLoggingCategory>
 
 #ifdef WITH_QTSERIALBUS
-#include <QtSerialBus/QModbusReply>
 #include <QtSerialBus/QModbusDataUnit>
 #endif
 
@@ -63,6 +66,9 @@ ModbusRtuMasterImpl::ModbusRtuMasterImpl(const QUuid &modbusUuid, const QString
     m_modbus->setNumberOfRetries(m_numberOfRetries);
     m_modbus->setTimeout(m_timeout);
 
+    // All plugins share the bus, the scheduler merges their reads and takes turns between the slaves
+    m_scheduler = new ModbusRtuRequestScheduler(m_modbus, &m_statistics, this);
+
     connect(m_modbus, &QModbusTcpClient::stateChanged, this, [=](QModbusDevice::State state){
         qCDebug(dcModbusRtu()) << "Connection state changed" << m_modbusUuid.toString() << m_serialPort << state;
         if (state == QModbusDevice::ConnectedState) {
@@ -227,47 +233,18 @@ void ModbusRtuMasterImpl::setTimeout(int timeout)
 #endif
 }
 
+const ModbusRtuStatistics &ModbusRtuMasterImpl::statistics() const
+{
+    return m_statistics;
+}
+
 ModbusRtuReply *ModbusRtuMasterImpl::readCoil(int slaveAddress, int registerAddress, quint16 size)
 {
 #ifdef WITH_QTSERIALBUS
-    // Create the reply for the plugin
+    // Create the reply for the plugin, the scheduler sends the request once it is its turn on the bus
     ModbusRtuReplyImpl *reply = new ModbusRtuReplyImpl(slaveAddress, registerAddress, this);
     connect(reply, &ModbusRtuReplyImpl::finished, reply, &ModbusRtuReplyImpl::deleteLater);
-
-    // Create the actual modbus lib reply
-    QModbusDataUnit request = QModbusDataUnit(QModbusDataUnit::RegisterType::Coils, registerAddress, size);
-    QModbusReply *modbusReply = m_modbus->sendReadRequest(request, slaveAddress);
-
-    connect(modbusReply, &QModbusReply::finished, modbusReply, [=](){
-        modbusReply->deleteLater();
-
-        // Fill common reply data
-        reply->setFinished(true);
-        reply->setError(static_cast<ModbusRtuReply::Error>(modbusReply->error()));
-        reply->setErrorString(modbusReply->errorString());
-
-        // Check if the reply finished with an error
-        if (modbusReply->error() != QModbusDevice::NoError) {
-            qCWarning(dcModbusRtu()) << "Read coil request finished with error" << modbusReply->error() << modbusReply->errorString();
-            emit reply->errorOccurred(reply->error());
-            emit reply->finished();
-            return;
-        }
-
-        // Parse the data unit and set reply result
-        const QModbusDataUnit unit = modbusReply->result();
-        reply->setResult(unit.values());
-        emit reply->finished();
-    });
-
-    connect(modbusReply, &QModbusReply::errorOccurred, modbusReply, [=](QModbusDevice::Error error){
-        qCWarning(dcModbusRtu()) << "Read coil request finished with error" << error << modbusReply->errorString();
-        reply->setFinished(true);
-        reply->setError(static_cast<ModbusRtuReply::Error>(modbusReply->error()));
-        reply->setErrorString(modbusReply->errorString());
-        emit reply->errorOccurred(reply->error());
-        emit reply->finished();
-    });
+    m_scheduler->enqueueRead(reply, QModbusDataUnit::RegisterType::Coils, slaveAddress, registerAddress, size);
 
     return qobject_cast<ModbusRtuReply *>(reply);
 #else
@@ -283,44 +260,10 @@ ModbusRtuReply *ModbusRtuMasterImpl::readCoil(int slaveAddress, int registerAddr
 ModbusRtuReply *ModbusRtuMasterImpl::readDiscreteInput(int slaveAddress, int registerAddress, quint16 size)
 {
 #ifdef WITH_QTSERIALBUS
-    // Create the reply for the plugin
+    // Create the reply for the plugin, the scheduler sends the request once it is its turn on the bus
     ModbusRtuReplyImpl *reply = new ModbusRtuReplyImpl(slaveAddress, registerAddress, this);
     connect(reply, &ModbusRtuReplyImpl::finished, reply, &ModbusRtuReplyImpl::deleteLater);
-
-    // Create the actual modbus lib reply
-    QModbusDataUnit request = QModbusDataUnit(QModbusDataUnit::RegisterType::DiscreteInputs, registerAddress, size);
-    QModbusReply *modbusReply = m_modbus->sendReadRequest(request, slaveAddress);
-
-    connect(modbusReply, &QModbusReply::finished, modbusReply, [=](){
-        modbusReply->deleteLater();
-
-        // Fill common reply data
-        reply->setFinished(true);
-        reply->setError(static_cast<ModbusRtuReply::Error>(modbusReply->error()));
-        reply->setErrorString(modbusReply->errorString());
-
-        // Check if the reply finished with an error
-        if (modbusReply->error() != QModbusDevice::NoError) {
-            qCWarning(dcModbusRtu()) << "Read descrete inputs request finished with error" << modbusReply->error() << modbusReply->errorString();
-            emit reply->errorOccurred(reply->error());
-            emit reply->finished();
-            return;
-        }
-
-        // Parse the data unit and set reply result
-        const QModbusDataUnit unit = modbusReply->result();
-        reply->setResult(unit.values());
-        emit reply->finished();
-    });
-
-    connect(modbusReply, &QModbusReply::errorOccurred, modbusReply, [=](QModbusDevice::Error error){
-        qCWarning(dcModbusRtu()) << "Read descrete inputs request finished with error" << error << modbusReply->errorString();
-        reply->setFinished(true);
-        reply->setError(static_cast<ModbusRtuReply::Error>(modbusReply->error()));
-        reply->setErrorString(modbusReply->errorString());
-        emit reply->errorOccurred(reply->error());
-        emit reply->finished();
-    });
+    m_scheduler->enqueueRead(reply, QModbusDataUnit::RegisterType::DiscreteInputs, slaveAddress, registerAddress, size);
 
     return qobject_cast<ModbusRtuReply *>(reply);
 #else
@@ -336,44 +279,10 @@ ModbusRtuReply *ModbusRtuMasterImpl::readDiscreteInput(int slaveAddress, int reg
 ModbusRtuReply *ModbusRtuMasterImpl::readInputRegister(int slaveAddress, int registerAddress, quint16 size)
 {
 #ifdef WITH_QTSERIALBUS
-    // Create the reply for the plugin
+    // Create the reply for the plugin, the scheduler sends the request once it is its turn on the bus
     ModbusRtuReplyImpl *reply = new ModbusRtuReplyImpl(slaveAddress, registerAddress, this);
     connect(reply, &ModbusRtuReplyImpl::finished, reply, &ModbusRtuReplyImpl::deleteLater);
-
-    // Create the actual modbus lib reply
-    QModbusDataUnit request = QModbusDataUnit(QModbusDataUnit::RegisterType::InputRegisters, registerAddress, size);
-    QModbusReply *modbusReply = m_modbus->sendReadRequest(request, slaveAddress);
-
-    connect(modbusReply, &QModbusReply::finished, modbusReply, [=](){
-        modbusReply->deleteLater();
-
-        // Fill common reply data
-        reply->setFinished(true);
-        reply->setError(static_cast<ModbusRtuReply::Error>(modbusReply->error()));
-        reply->setErrorString(modbusReply->errorString());
-
-        // Check if the reply finished with an error
-        if (modbusReply->error() != QModbusDevice::NoError) {
-            qCWarning(dcModbusRtu()) << "Read input registers request finished with error" << modbusReply->error() << modbusReply->errorString();
-            emit reply->errorOccurred(reply->error());
-            emit reply->finished();
-            return;
-        }
-
-        // Parse the data unit and set reply result
-        const QModbusDataUnit unit = modbusReply->result();
-        reply->setResult(unit.values());
-        emit reply->finished();
-    });
-
-    connect(modbusReply, &QModbusReply::errorOccurred, modbusReply, [=](QModbusDevice::Error error){
-        qCWarning(dcModbusRtu()) << "Read input registers request finished with error" << error << modbusReply->errorString();
-        reply->setFinished(true);
-        reply->setError(static_cast<ModbusRtuReply::Error>(modbusReply->error()));
-        reply->setErrorString(modbusReply->errorString());
-        emit reply->errorOccurred(reply->error());
-        emit reply->finished();
-    });
+    m_scheduler->enqueueRead(reply, QModbusDataUnit::RegisterType::InputRegisters, slaveAddress, registerAddress, size);
 
     return qobject_cast<ModbusRtuReply *>(reply);
 #else
@@ -389,44 +298,10 @@ ModbusRtuReply *ModbusRtuMasterImpl::readInputRegister(int slaveAddress, int reg
 ModbusRtuReply *ModbusRtuMasterImpl::readHoldingRegister(int slaveAddress, int registerAddress, quint16 size)
 {
 #ifdef WITH_QTSERIALBUS
-    // Create the reply for the plugin
+    // Create the reply for the plugin, the scheduler sends the request once it is its turn on the bus
     ModbusRtuReplyImpl *reply = new ModbusRtuReplyImpl(slaveAddress, registerAddress, this);
     connect(reply, &ModbusRtuReplyImpl::finished, reply, &ModbusRtuReplyImpl::deleteLater);
-
-    // Create the actual modbus lib reply
-    QModbusDataUnit request = QModbusDataUnit(QModbusDataUnit::RegisterType::HoldingRegisters, registerAddress, size);
-    QModbusReply *modbusReply = m_modbus->sendReadRequest(request, slaveAddress);
-
-    connect(modbusReply, &QModbusReply::finished, modbusReply, [=](){
-        modbusReply->deleteLater();
-
-        // Fill common reply data
-        reply->setFinished(true);
-        reply->setError(static_cast<ModbusRtuReply::Error>(modbusReply->error()));
-        reply->setErrorString(modbusReply->errorString());
-
-        // Check if the reply finished with an error
-        if (modbusReply->error() != QModbusDevice::NoError) {
-            qCWarning(dcModbusRtu()) << "Read holding registers request finished with error" << modbusReply->error() << modbusReply->errorString();
-            emit reply->errorOccurred(reply->error());
-            emit reply->finished();
-            return;
-        }
-
-        // Parse the data unit and set reply result
-        const QModbusDataUnit unit = modbusReply->result();
-        reply->setResult(unit.values());
-        emit reply->finished();
-    });
-
-    connect(modbusReply, &QModbusReply::errorOccurred, modbusReply, [=](QModbusDevice::Error error){
-        qCWarning(dcModbusRtu()) << "Read holding registers request finished with error" << error << modbusReply->errorString();
-        reply->setFinished(true);
-        reply->setError(static_cast<ModbusRtuReply::Error>(modbusReply->error()));
-        reply->setErrorString(modbusReply->errorString());
-        emit reply->errorOccurred(reply->error());
-        emit reply->finished();
-    });
+    m_scheduler->enqueueRead(reply, QModbusDataUnit::RegisterType::HoldingRegisters, slaveAddress, registerAddress, size);
 
     return qobject_cast<ModbusRtuReply *>(reply);
 #else
@@ -442,46 +317,10 @@ ModbusRtuReply *ModbusRtuMasterImpl::readHoldingRegister(int slaveAddress, int r
 ModbusRtuReply *ModbusRtuMasterImpl::writeCoils(int slaveAddress, int registerAddress, const QVector<quint16> &values)
 {
 #ifdef WITH_QTSERIALBUS
-    // Create the reply for the plugin
+    // Create the reply for the plugin, the scheduler sends the request once it is its turn on the bus
     ModbusRtuReplyImpl *reply = new ModbusRtuReplyImpl(slaveAddress, registerAddress, this);
     connect(reply, &ModbusRtuReplyImpl::finished, reply, &ModbusRtuReplyImpl::deleteLater);
-
-    // Create the actual modbus lib reply
-    QModbusDataUnit request = QModbusDataUnit(QModbusDataUnit::RegisterType::Coils, registerAddress, values.length());
-    request.setValues(values);
-
-    QModbusReply *modbusReply = m_modbus->sendWriteRequest(request, slaveAddress);
-
-    connect(modbusReply, &QModbusReply::finished, modbusReply, [=](){
-        modbusReply->deleteLater();
-
-        // Fill common reply data
-        reply->setFinished(true);
-        reply->setError(static_cast<ModbusRtuReply::Error>(modbusReply->error()));
-        reply->setErrorString(modbusReply->errorString());
-
-        // Check if the reply finished with an error
-        if (modbusReply->error() != QModbusDevice::NoError) {
-            qCWarning(dcModbusRtu()) << "Read coil request finished with error" << modbusReply->error() << modbusReply->errorString();
-            emit reply->errorOccurred(reply->error());
-            emit reply->finished();
-            return;
-        }
-
-        // Parse the data unit and set reply result
-        const QModbusDataUnit unit = modbusReply->result();
-        reply->setResult(unit.values());
-        emit reply->finished();
-    });
-
-    connect(modbusReply, &QModbusReply::errorOccurred, modbusReply, [=](QModbusDevice::Error error){
-        qCWarning(dcModbusRtu()) << "Read coil request finished with error" << error << modbusReply->errorString();
-        reply->setFinished(true);
-        reply->setError(static_cast<ModbusRtuReply::Error>(modbusReply->error()));
-        reply->setErrorString(modbusReply->errorString());
-        emit reply->errorOccurred(reply->error());
-        emit reply->finished();
-    });
+    m_scheduler->enqueueWrite(reply, QModbusDataUnit::RegisterType::Coils, slaveAddress, registerAddress, values);
 
     return qobject_cast<ModbusRtuReply *>(reply);
 #else
@@ -498,46 +337,10 @@ ModbusRtuReply *ModbusRtuMasterImpl::writeCoils(int slaveAddress, int registerAd
 ModbusRtuReply *ModbusRtuMasterImpl::writeHoldingRegisters(int slaveAddress, int registerAddress, const QVector<quint16> &values)
 {
 #ifdef WITH_QTSERIALBUS
-    // Create the reply for the plugin
+    // Create the reply for the plugin, the scheduler sends the request once it is its turn on the bus
     ModbusRtuReplyImpl *reply = new ModbusRtuReplyImpl(slaveAddress, registerAddress, this);
     connect(reply, &ModbusRtuReplyImpl::finished, reply, &ModbusRtuReplyImpl::deleteLater);
-
-    // Create the actual modbus lib reply
-    QModbusDataUnit request = QModbusDataUnit(QModbusDataUnit::RegisterType::HoldingRegisters, registerAddress, values.length());
-    request.setValues(values);
-
-    QModbusReply *modbusReply = m_modbus->sendWriteRequest(request, slaveAddress);
-
-    connect(modbusReply, &QModbusReply::finished, modbusReply, [=](){
-        modbusReply->deleteLater();
-
-        // Fill common reply data
-        reply->setFinished(true);
-        reply->setError(static_cast<ModbusRtuReply::Error>(modbusReply->error()));
-        reply->setErrorString(modbusReply->errorString());
-
-        // Check if the reply finished with an error
-        if (modbusReply->error() != QModbusDevice::NoError) {
-            qCWarning(dcModbusRtu()) << "Read coil request finished with error" << modbusReply->error() << modbusReply->errorString();
-            emit reply->errorOccurred(reply->error());
-            emit reply->finished();
-            return;
-        }
-
-        // Parse the data unit and set reply result
-        const QModbusDataUnit unit = modbusReply->result();
-        reply->setResult(unit.values());
-        emit reply->finished();
-    });
-
-    connect(modbusReply, &QModbusReply::errorOccurred, modbusReply, [=](QModbusDevice::Error error){
-        qCWarning(dcModbusRtu()) << "Read coil request finished with error" << error << modbusReply->errorString();
-        reply->setFinished(true);
-        reply->setError(static_cast<ModbusRtuReply::Error>(modbusReply->error()));
-        reply->setErrorString(modbusReply->errorString());
-        emit reply->errorOccurred(reply->error());
-        emit reply->finished();
-    });
+    m_scheduler->enqueueWrite(reply, QModbusDataUnit::RegisterType::HoldingRegisters, slaveAddress, registerAddress, values);
 
     return qobject_cast<ModbusRtuReply *>(reply);
 #else
@@ -39,9 +39,12 @@
 #endif
 
 #include "hardware/modbus/modbusrtumaster.h"
+#include "modbusrtustatistics.h"
 
 namespace nymeaserver {
 
+class ModbusRtuRequestScheduler;
+
 class ModbusRtuMasterImpl : public ModbusRtuMaster
 {
     Q_OBJECT
@@ -86,12 +89,15 @@ public:
     ModbusRtuReply *writeCoils(int slaveAddress, int registerAddress, const QVector<quint16> &values) override;
     ModbusRtuReply *writeHoldingRegisters(int slaveAddress, int registerAddress, const QVector<quint16> &values) override;
 
+    const ModbusRtuStatistics &statistics() const;
+
 private:
     QUuid m_modbusUuid;
     bool m_connected = false;
 
 #ifdef WITH_QTSERIALBUS
     QModbusRtuSerialMaster *m_modbus = nullptr;
+    ModbusRtuRequestScheduler *m_scheduler = nullptr;
 #endif
 
     QString m_serialPort;
@@ -101,6 +107,8 @@ private:
     QSerialPort::StopBits m_stopBits;
     int m_numberOfRetries = 3;
     int m_timeout = 100;
+
+    ModbusRtuStatistics m_statistics;
 };
 
 }
@@ -0,0 +1,354 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+  \class nymeaserver::ModbusRtuRequestScheduler
+  \brief Schedules the requests of all plugins sharing one Modbus RTU bus.
+
+  \ingroup hardware
+  \inmodule core
+
+  Only one request is on the serial line at any time. Reads of the same slave and register type which overlap
+  or are adjacent are merged into one request while they are waiting, the result is split up again for the
+  individual replies. If the slave refuses a merged block, the parts are requested one by one.
+
+  Writes are sent before any pending read. Reads are served round robin between the slaves on the bus, so
+  a plugin polling many registers of one slave does not hold back the other ones.
+
+  Each finished request is counted in the \l{ModbusRtuStatistics} of the master, the bytes on the wire are
+  derived from the size of the request and response frames.
+*/
+
+#include "modbusrturequestscheduler.h"
+#include "modbusrtureplyimpl.h"
+
+#include <QSerialPort>
+#include <QLoggingCategory>
+#include <QtSerialBus/QModbusReply>
+
+Q_DECLARE_LOGGING_CATEGORY(dcModbusRtu)
+
+namespace nymeaserver {
+
+ModbusRtuRequestScheduler::ModbusRtuRequestScheduler(QModbusRtuSerialMaster *modbus, ModbusRtuStatistics *statistics, QObject *parent) :
+    QObject(parent),
+    m_modbus(modbus),
+    m_statistics(statistics)
+{
+    m_windowTimer = new QTimer(this);
+    m_windowTimer->setSingleShot(true);
+    m_windowTimer->setInterval(10);
+    connect(m_windowTimer, &QTimer::timeout, this, &ModbusRtuRequestScheduler::dispatchNext);
+}
+
+int ModbusRtuRequestScheduler::coalescingWindow() const
+{
+    return m_windowTimer->interval();
+}
+
+void ModbusRtuRequestScheduler::setCoalescingWindow(int coalescingWindow)
+{
+    m_windowTimer->setInterval(coalescingWindow);
+}
+
+void ModbusRtuRequestScheduler::enqueueRead(ModbusRtuReplyImpl *reply, QModbusDataUnit::RegisterType registerType, int slaveAddress, int registerAddress, quint16 size)
+{
+    ReplyPart part;
+    part.reply = reply;
+    part.registerAddress = registerAddress;
+    part.size = size;
+
+    // Merge with a waiting read if the blocks overlap or touch each other
+    QList<Request> &queue = m_readQueues[slaveAddress];
+    for (int i = 0; i < queue.count(); i++) {
+        Request &request = queue[i];
+        if (!request.mergeable || request.registerType != registerType)
+            continue;
+
+        if (registerAddress > request.registerAddress + request.size || request.registerAddress > registerAddress + size)
+            continue;
+
+        int start = qMin(request.registerAddress, registerAddress);
+        int end = qMax(request.registerAddress + request.size, registerAddress + size);
+        if (end - start > maximumSize(registerType))
+            continue;
+
+        request.registerAddress = start;
+        request.size = static_cast<quint16>(end - start);
+        request.parts.append(part);
+        m_statistics->requestCoalesced();
+        qCDebug(dcModbusRtu()) << "Merged read of slave" << slaveAddress << "register" << registerAddress << "size" << size << "into block" << start << "size" << request.size;
+        schedule();
+        return;
+    }
+
+    Request request;
+    request.registerType = registerType;
+    request.slaveAddress = slaveAddress;
+    request.registerAddress = registerAddress;
+    request.size = size;
+    request.parts.append(part);
+    queue.append(request);
+    schedule();
+}
+
+void ModbusRtuRequestScheduler::enqueueWrite(ModbusRtuReplyImpl *reply, QModbusDataUnit::RegisterType registerType, int slaveAddress, int registerAddress, const QVector<quint16> &values)
+{
+    ReplyPart part;
+    part.reply = reply;
+    part.registerAddress = registerAddress;
+    part.size = static_cast<quint16>(values.count());
+
+    Request request;
+    request.write = true;
+    request.mergeable = false;
+    request.registerType = registerType;
+    request.slaveAddress = slaveAddress;
+    request.registerAddress = registerAddress;
+    request.size = part.size;
+    request.values = values;
+    request.parts.append(part);
+    m_writeQueue.enqueue(request);
+    schedule();
+}
+
+int ModbusRtuRequestScheduler::maximumSize(QModbusDataUnit::RegisterType registerType)
+{
+    // Limits of the read functions given by the maximum PDU size
+    switch (registerType) {
+    case QModbusDataUnit::Coils:
+    case QModbusDataUnit::DiscreteInputs:
+        return 2000;
+    default:
+        return 125;
+    }
+}
+
+int ModbusRtuRequestScheduler::requestFrameSize(const Request &request)
+{
+    // Slave address, function code and CRC are 4 bytes, a read request adds the start address and the count
+    if (!request.write || request.size == 1)
+        return 8;
+
+    // Write multiple: start address, count, byte count and the values
+    if (request.registerType == QModbusDataUnit::Coils)
+        return 9 + (request.size + 7) / 8;
+
+    return 9 + 2 * request.size;
+}
+
+int ModbusRtuRequestScheduler::responseFrameSize(const Request &request)
+{
+    // Broadcasts are not answered
+    if (request.slaveAddress == 0)
+        return 0;
+
+    // Writes are confirmed with the start address and the count (or the value)
+    if (request.write)
+        return 8;
+
+    if (request.registerType == QModbusDataUnit::Coils || request.registerType == QModbusDataUnit::DiscreteInputs)
+        return 5 + (request.size + 7) / 8;
+
+    return 5 + 2 * request.size;
+}
+
+int ModbusRtuRequestScheduler::bitsPerCharacter() const
+{
+    int dataBits = m_modbus->connectionParameter(QModbusDevice::SerialDataBitsParameter).toInt();
+    int parity = m_modbus->connectionParameter(QModbusDevice::SerialParityParameter).toInt();
+    int stopBits = m_modbus->connectionParameter(QModbusDevice::SerialStopBitsParameter).toInt();
+    return 1 + dataBits + (parity != QSerialPort::NoParity ? 1 : 0) + (stopBits == QSerialPort::OneStop ? 1 : 2);
+}
+
+void ModbusRtuRequestScheduler::updateStatistics(const Request &request, QModbusReply *modbusReply)
+{
+    qint32 baudrate = m_modbus->connectionParameter(QModbusDevice::SerialBaudRateParameter).toInt();
+    qint64 responseTime = m_requestTimer.elapsed();
+
+    switch (modbusReply->error()) {
+    case QModbusDevice::NoError:
+        m_statistics->framesTransmitted(requestFrameSize(request), responseFrameSize(request), 2, baudrate, bitsPerCharacter());
+        m_statistics->requestFinished(request.slaveAddress, request.write, ModbusRtuStatistics::ResultSuccess, responseTime);
+        break;
+    case QModbusDevice::ProtocolError:
+        // Exception response: slave address, function code, exception code and CRC
+        m_statistics->framesTransmitted(requestFrameSize(request), 5, 2, baudrate, bitsPerCharacter());
+        m_statistics->requestFinished(request.slaveAddress, request.write, ModbusRtuStatistics::ResultException, responseTime);
+        break;
+    case QModbusDevice::TimeoutError: {
+        // The request has been sent again for each retry before giving up
+        int retries = m_modbus->numberOfRetries();
+        m_statistics->framesTransmitted(requestFrameSize(request) * (retries + 1), 0, retries + 1, baudrate, bitsPerCharacter());
+        m_statistics->requestRetried(static_cast<quint64>(retries));
+        m_statistics->requestFinished(request.slaveAddress, request.write, ModbusRtuStatistics::ResultTimeout);
+        break;
+    }
+    default:
+        m_statistics->requestFinished(request.slaveAddress, request.write, ModbusRtuStatistics::ResultFailed);
+        break;
+    }
+}
+
+void ModbusRtuRequestScheduler::schedule()
+{
+    // Requests arriving while the bus is busy get merged until it is their turn
+    if (m_busy || m_windowTimer->isActive())
+        return;
+
+    m_windowTimer->start();
+}
+
+bool ModbusRtuRequestScheduler::takeNextRequest(Request *request)
+{
+    if (!m_writeQueue.isEmpty()) {
+        *request = m_writeQueue.dequeue();
+        return true;
+    }
+
+    if (m_readQueues.isEmpty())
+        return false;
+
+    QMap<int, QList<Request>>::iterator it = m_readQueues.upperBound(m_lastSlaveAddress);
+    if (it == m_readQueues.end())
+        it = m_readQueues.begin();
+
+    *request = it.value().takeFirst();
+    m_lastSlaveAddress = it.key();
+    if (it.value().isEmpty())
+        m_readQueues.erase(it);
+
+    return true;
+}
+
+void ModbusRtuRequestScheduler::dispatchNext()
+{
+    Request request;
+    while (!m_busy && takeNextRequest(&request)) {
+        m_busy = sendRequest(request);
+    }
+}
+
+bool ModbusRtuRequestScheduler::sendRequest(const Request &request)
+{
+    QModbusDataUnit unit(request.registerType, request.registerAddress, request.size);
+    QModbusReply *modbusReply = nullptr;
+    if (request.write) {
+        unit.setValues(request.values);
+        modbusReply = m_modbus->sendWriteRequest(unit, request.slaveAddress);
+    } else {
+        modbusReply = m_modbus->sendReadRequest(unit, request.slaveAddress);
+    }
+
+    if (!modbusReply) {
+        qCWarning(dcModbusRtu()) << "Could not send request to slave" << request.slaveAddress << m_modbus->errorString();
+        m_statistics->requestFinished(request.slaveAddress, request.write, ModbusRtuStatistics::ResultFailed);
+        foreach (const ReplyPart &part, request.parts) {
+            finishPart(part, ModbusRtuReply::ConnectionError, m_modbus->errorString());
+        }
+        return false;
+    }
+
+    m_requestTimer.start();
+
+    // Broadcasts are finished right away
+    if (modbusReply->isFinished()) {
+        finishRequest(request, modbusReply);
+        return false;
+    }
+
+    connect(modbusReply, &QModbusReply::finished, this, [=](){
+        m_busy = false;
+        finishRequest(request, modbusReply);
+        dispatchNext();
+    });
+    return true;
+}
+
+void ModbusRtuRequestScheduler::finishRequest(const Request &request, QModbusReply *modbusReply)
+{
+    modbusReply->deleteLater();
+    updateStatistics(request, modbusReply);
+
+    if (modbusReply->error() == QModbusDevice::ProtocolError && request.parts.count() > 1) {
+        // The slave refused the merged block, e.g. because it spans unmapped registers. Ask for each part on its own.
+        qCDebug(dcModbusRtu()) << "Slave" << request.slaveAddress << "refused merged read of register" << request.registerAddress << "size" << request.size << "Requesting the" << request.parts.count() << "parts separately.";
+        m_statistics->requestRetried(static_cast<quint64>(request.parts.count()));
+        QList<Request> &queue = m_readQueues[request.slaveAddress];
+        for (int i = request.parts.count() - 1; i >= 0; i--) {
+            const ReplyPart &part = request.parts.at(i);
+            Request single = request;
+            single.mergeable = false;
+            single.registerAddress = part.registerAddress;
+            single.size = part.size;
+            single.parts = QList<ReplyPart>() << part;
+            queue.prepend(single);
+        }
+        return;
+    }
+
+    if (modbusReply->error() != QModbusDevice::NoError) {
+        qCWarning(dcModbusRtu()) << (request.write ? "Write" : "Read") << request.registerType << "request for slave" << request.slaveAddress
+                                 << "register" << request.registerAddress << "finished with error" << modbusReply->error() << modbusReply->errorString();
+        foreach (const ReplyPart &part, request.parts) {
+            finishPart(part, static_cast<ModbusRtuReply::Error>(modbusReply->error()), modbusReply->errorString());
+        }
+        return;
+    }
+
+    // Split up the result of merged reads
+    const QVector<quint16> values = modbusReply->result().values();
+    foreach (const ReplyPart &part, request.parts) {
+        if (request.write) {
+            finishPart(part, ModbusRtuReply::NoError, QString(), values);
+        } else {
+            finishPart(part, ModbusRtuReply::NoError, QString(), values.mid(part.registerAddress - request.registerAddress, part.size));
+        }
+    }
+}
+
+void ModbusRtuRequestScheduler::finishPart(const ReplyPart &part, ModbusRtuReply::Error error, const QString &errorString, const QVector<quint16> &result)
+{
+    // The plugin might not be interested any more
+    if (part.reply.isNull())
+        return;
+
+    ModbusRtuReplyImpl *reply = part.reply.data();
+    reply->setFinished(true);
+    reply->setError(error);
+    reply->setErrorString(errorString);
+    reply->setResult(result);
+    if (error != ModbusRtuReply::NoError) {
+        emit reply->errorOccurred(error);
+    }
+    emit reply->finished();
+}
+
+}
@@ -0,0 +1,110 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MODBUSRTUREQUESTSCHEDULER_H
+#define MODBUSRTUREQUESTSCHEDULER_H
+
+#include <QMap>
+#include <QQueue>
+#include <QTimer>
+#include <QObject>
+#include <QPointer>
+#include <QElapsedTimer>
+
+#include <QtSerialBus/QModbusDataUnit>
+#include <QtSerialBus/QModbusRtuSerialMaster>
+
+#include "hardware/modbus/modbusrtureply.h"
+#include "modbusrtustatistics.h"
+
+namespace nymeaserver {
+
+class ModbusRtuReplyImpl;
+
+class ModbusRtuRequestScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ModbusRtuRequestScheduler(QModbusRtuSerialMaster *modbus, ModbusRtuStatistics *statistics, QObject *parent = nullptr);
+
+    // Time to wait for more requests before sending the first one of an idle bus
+    int coalescingWindow() const;
+    void setCoalescingWindow(int coalescingWindow);
+
+    void enqueueRead(ModbusRtuReplyImpl *reply, QModbusDataUnit::RegisterType registerType, int slaveAddress, int registerAddress, quint16 size);
+    void enqueueWrite(ModbusRtuReplyImpl *reply, QModbusDataUnit::RegisterType registerType, int slaveAddress, int registerAddress, const QVector<quint16> &values);
+
+private:
+    struct ReplyPart {
+        QPointer<ModbusRtuReplyImpl> reply;
+        int registerAddress;
+        quint16 size;
+    };
+
+    struct Request {
+        bool write = false;
+        bool mergeable = true;
+        QModbusDataUnit::RegisterType registerType = QModbusDataUnit::Invalid;
+        int slaveAddress = 0;
+        int registerAddress = 0;
+        quint16 size = 0;
+        QVector<quint16> values;
+        QList<ReplyPart> parts;
+    };
+
+    QModbusRtuSerialMaster *m_modbus = nullptr;
+    ModbusRtuStatistics *m_statistics = nullptr;
+    QTimer *m_windowTimer = nullptr;
+    QElapsedTimer m_requestTimer;
+    bool m_busy = false;
+
+    // Writes go first, reads are queued per slave and served round robin
+    QQueue<Request> m_writeQueue;
+    QMap<int, QList<Request>> m_readQueues;
+    int m_lastSlaveAddress = -1;
+
+    static int maximumSize(QModbusDataUnit::RegisterType registerType);
+    static int requestFrameSize(const Request &request);
+    static int responseFrameSize(const Request &request);
+    int bitsPerCharacter() const;
+    void updateStatistics(const Request &request, QModbusReply *modbusReply);
+
+    void schedule();
+    bool takeNextRequest(Request *request);
+    void dispatchNext();
+    bool sendRequest(const Request &request);
+    void finishRequest(const Request &request, QModbusReply *modbusReply);
+    void finishPart(const ReplyPart &part, ModbusRtuReply::Error error, const QString &errorString, const QVector<quint16> &result = QVector<quint16>());
+
+};
+
+}
+
+#endif // MODBUSRTUREQUESTSCHEDULER_H
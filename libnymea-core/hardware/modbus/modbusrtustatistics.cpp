@@ -0,0 +1,145 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+  \class nymeaserver::ModbusRtuStatistics
+  \brief Keeps the traffic counters of a Modbus RTU master.
+
+  \ingroup hardware
+  \inmodule core
+
+  The statistics count the frames sent on the bus, retries, timeouts and errors, the bytes on the wire
+  and the time the line was occupied, estimated from the frame sizes and the serial configuration.
+  Response times are kept per slave, as a histogram in addition to the average and the maximum.
+*/
+
+#include "modbusrtustatistics.h"
+
+namespace nymeaserver {
+
+ModbusRtuStatistics::ModbusRtuStatistics()
+{
+    m_counters.since = QDateTime::currentDateTime();
+}
+
+/*! Returns the upper bounds of the response time histogram buckets in milliseconds. The histogram has one more
+    bucket for all response times above the last bound. */
+QVector<int> ModbusRtuStatistics::histogramBuckets()
+{
+    return QVector<int>() << 10 << 20 << 50 << 100 << 200 << 500 << 1000;
+}
+
+void ModbusRtuStatistics::requestCoalesced()
+{
+    m_counters.coalescedReads++;
+}
+
+void ModbusRtuStatistics::requestRetried(quint64 retries)
+{
+    m_counters.retries += retries;
+}
+
+void ModbusRtuStatistics::requestFinished(int slaveAddress, bool write, Result result, qint64 responseTime)
+{
+    m_counters.requests++;
+    if (write) {
+        m_counters.writeRequests++;
+    } else {
+        m_counters.readRequests++;
+    }
+
+    QVector<int> buckets = histogramBuckets();
+    SlaveCounters &slaveCounters = m_slaveCounters[slaveAddress];
+    if (slaveCounters.histogram.isEmpty())
+        slaveCounters.histogram.resize(buckets.count() + 1);
+
+    slaveCounters.requests++;
+    switch (result) {
+    case ResultTimeout:
+        m_counters.timeouts++;
+        slaveCounters.timeouts++;
+        return;
+    case ResultFailed:
+        // Not even sent, there is no response time
+        m_counters.errors++;
+        slaveCounters.errors++;
+        return;
+    case ResultException:
+        m_counters.errors++;
+        slaveCounters.errors++;
+        break;
+    case ResultSuccess:
+        break;
+    }
+
+    slaveCounters.responses++;
+    slaveCounters.responseTimeTotal += responseTime;
+    slaveCounters.responseTimeMax = qMax(slaveCounters.responseTimeMax, responseTime);
+
+    int bucket = 0;
+    while (bucket < buckets.count() && responseTime > buckets.at(bucket))
+        bucket++;
+
+    slaveCounters.histogram[bucket]++;
+}
+
+void ModbusRtuStatistics::framesTransmitted(int bytesSent, int bytesReceived, int frames, qint32 baudrate, int bitsPerCharacter)
+{
+    m_counters.bytesSent += static_cast<quint64>(bytesSent);
+    m_counters.bytesReceived += static_cast<quint64>(bytesReceived);
+    if (baudrate <= 0)
+        return;
+
+    // Frames are separated by at least 3.5 characters of silence, fixed to 1.75 ms above 19200 baud
+    double characterTime = 1e6 * bitsPerCharacter / baudrate;
+    double silentInterval = baudrate > 19200 ? 1750 : 3.5 * characterTime;
+    m_counters.wireTime += static_cast<qint64>((bytesSent + bytesReceived) * characterTime + frames * silentInterval);
+}
+
+ModbusRtuStatistics::Counters ModbusRtuStatistics::counters() const
+{
+    return m_counters;
+}
+
+QHash<int, ModbusRtuStatistics::SlaveCounters> ModbusRtuStatistics::slaveCounters() const
+{
+    return m_slaveCounters;
+}
+
+double ModbusRtuStatistics::busOccupancy() const
+{
+    qint64 elapsed = m_counters.since.msecsTo(QDateTime::currentDateTime()) * 1000;
+    if (elapsed <= 0)
+        return 0;
+
+    return qMin(100.0, m_counters.wireTime * 100.0 / elapsed);
+}
+
+}
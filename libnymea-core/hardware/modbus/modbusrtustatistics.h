@@ -0,0 +1,102 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MODBUSRTUSTATISTICS_H
+#define MODBUSRTUSTATISTICS_H
+
+#include <QHash>
+#include <QVector>
+#include <QDateTime>
+
+namespace nymeaserver {
+
+class ModbusRtuStatistics
+{
+public:
+    enum Result {
+        ResultSuccess,
+        ResultException,
+        ResultTimeout,
+        ResultFailed
+    };
+
+    class SlaveCounters {
+    public:
+        quint64 requests = 0;
+        quint64 errors = 0;
+        quint64 timeouts = 0;
+        quint64 responses = 0;
+        // Milliseconds from sending the request until the response arrived
+        qint64 responseTimeTotal = 0;
+        qint64 responseTimeMax = 0;
+        // One counter per histogramBuckets() entry, the last one counts everything above
+        QVector<quint64> histogram;
+    };
+
+    class Counters {
+    public:
+        QDateTime since;
+        quint64 requests = 0;
+        quint64 readRequests = 0;
+        quint64 writeRequests = 0;
+        quint64 coalescedReads = 0;
+        quint64 retries = 0;
+        quint64 timeouts = 0;
+        quint64 errors = 0;
+        quint64 bytesSent = 0;
+        quint64 bytesReceived = 0;
+        // Estimated microseconds the frames occupied the line, including the silent intervals between frames
+        qint64 wireTime = 0;
+    };
+
+    ModbusRtuStatistics();
+
+    // Upper bounds of the response time histogram buckets in milliseconds
+    static QVector<int> histogramBuckets();
+
+    void requestCoalesced();
+    void requestRetried(quint64 retries = 1);
+    void requestFinished(int slaveAddress, bool write, Result result, qint64 responseTime = 0);
+    void framesTransmitted(int bytesSent, int bytesReceived, int frames, qint32 baudrate, int bitsPerCharacter);
+
+    Counters counters() const;
+    QHash<int, SlaveCounters> slaveCounters() const;
+
+    // Percentage of the time since the statistics started the line was occupied by frames
+    double busOccupancy() const;
+
+private:
+    Counters m_counters;
+    QHash<int, SlaveCounters> m_slaveCounters;
+};
+
+}
+
+#endif // MODBUSRTUSTATISTICS_H
@@ -0,0 +1,116 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+  \class nymeaserver::CoapHardwareResourceImplementation
+  \brief Multiplexes the CoAP requests of all plugins over one socket.
+
+  \ingroup hardware
+  \inmodule core
+
+  The implementation owns a single \l{Coap} client bound to an ephemeral port on all interfaces.
+  Its response cache is enabled while the resource is enabled.
+*/
+
+#include "coaphardwareresourceimplementation.h"
+#include "loggingcategories.h"
+
+namespace nymeaserver {
+
+/*! Construct the hardware resource CoapHardwareResourceImplementation with the given \a parent. */
+CoapHardwareResourceImplementation::CoapHardwareResourceImplementation(QObject *parent) :
+    CoapHardwareResource(parent)
+{
+    // Responses are sent back to the source port, so any free port will do
+    m_coap = new Coap(this, 0);
+    connect(m_coap, &Coap::notificationReceived, this, &CoapHardwareResource::notificationReceived);
+
+    m_available = true;
+    qCDebug(dcHardware()) << "-->" << name() << "created successfully.";
+}
+
+CoapReply *CoapHardwareResourceImplementation::ping(const CoapRequest &request)
+{
+    return m_coap->ping(request);
+}
+
+CoapReply *CoapHardwareResourceImplementation::get(const CoapRequest &request)
+{
+    return m_coap->get(request);
+}
+
+CoapReply *CoapHardwareResourceImplementation::put(const CoapRequest &request, const QByteArray &data)
+{
+    return m_coap->put(request, data);
+}
+
+CoapReply *CoapHardwareResourceImplementation::post(const CoapRequest &request, const QByteArray &data)
+{
+    return m_coap->post(request, data);
+}
+
+CoapReply *CoapHardwareResourceImplementation::deleteResource(const CoapRequest &request)
+{
+    return m_coap->deleteResource(request);
+}
+
+CoapReply *CoapHardwareResourceImplementation::enableResourceNotifications(const CoapRequest &request)
+{
+    return m_coap->enableResourceNotifications(request);
+}
+
+CoapReply *CoapHardwareResourceImplementation::disableNotifications(const CoapRequest &request)
+{
+    return m_coap->disableNotifications(request);
+}
+
+bool CoapHardwareResourceImplementation::available() const
+{
+    return m_available;
+}
+
+bool CoapHardwareResourceImplementation::enabled() const
+{
+    return m_enabled;
+}
+
+void CoapHardwareResourceImplementation::setEnabled(bool enabled)
+{
+    if (m_enabled == enabled)
+        return;
+
+    // The client keeps working while disabled, only the shared response cache is dropped
+    m_coap->setResponseCacheEnabled(enabled);
+    m_enabled = enabled;
+    qCDebug(dcHardware()) << name() << (enabled ? "enabled" : "disabled");
+    emit enabledChanged(m_enabled);
+}
+
+}
@@ -0,0 +1,73 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef COAPHARDWARERESOURCEIMPLEMENTATION_H
+#define COAPHARDWARERESOURCEIMPLEMENTATION_H
+
+#include <QObject>
+
+#include "coap/coap.h"
+#include "coap/coaphardwareresource.h"
+
+namespace nymeaserver {
+
+class CoapHardwareResourceImplementation : public CoapHardwareResource
+{
+    Q_OBJECT
+
+public:
+    explicit CoapHardwareResourceImplementation(QObject *parent = nullptr);
+    ~CoapHardwareResourceImplementation() override = default;
+
+    CoapReply *ping(const CoapRequest &request) override;
+    CoapReply *get(const CoapRequest &request) override;
+    CoapReply *put(const CoapRequest &request, const QByteArray &data = QByteArray()) override;
+    CoapReply *post(const CoapRequest &request, const QByteArray &data = QByteArray()) override;
+    CoapReply *deleteResource(const CoapRequest &request) override;
+
+    CoapReply *enableResourceNotifications(const CoapRequest &request) override;
+    CoapReply *disableNotifications(const CoapRequest &request) override;
+
+    bool available() const override;
+    bool enabled() const override;
+
+protected:
+    void setEnabled(bool enabled) override;
+
+private:
+    Coap *m_coap = nullptr;
+    bool m_available = false;
+    bool m_enabled = false;
+
+};
+
+}
+
+#endif // COAPHARDWARERESOURCEIMPLEMENTATION_H
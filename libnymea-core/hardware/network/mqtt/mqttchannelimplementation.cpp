@@ -29,6 +29,7 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "mqttchannelimplementation.h"
+#include "mqttproviderimplementation.h"
 
 namespace nymeaserver {
 
@@ -72,4 +73,32 @@ void MqttChannelImplementation::publish(const QString &topic, const QByteArray &
     emit pluginPublished(topic, payload);
 }
 
+void MqttChannelImplementation::publish(const QList<QPair<QString, QByteArray> > &messages, bool retain)
+{
+    emit pluginPublishedBatch(messages, retain);
+}
+
+bool MqttChannelImplementation::addTopicFilter(const QString &topicFilter)
+{
+    if (m_topicFilters.contains(topicFilter))
+        return true;
+
+    if (!m_provider->addTopicFilter(this, topicFilter))
+        return false;
+
+    m_topicFilters.append(topicFilter);
+    return true;
+}
+
+void MqttChannelImplementation::removeTopicFilter(const QString &topicFilter)
+{
+    if (m_topicFilters.removeAll(topicFilter) > 0)
+        m_provider->removeTopicFilter(this, topicFilter);
+}
+
+QStringList MqttChannelImplementation::topicFilters() const
+{
+    return m_topicFilters;
+}
+
 }
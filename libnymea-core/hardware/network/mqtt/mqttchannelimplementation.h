@@ -35,6 +35,8 @@
 
 namespace nymeaserver {
 
+class MqttProviderImplementation;
+
 class MqttChannelImplementation : public MqttChannel
 {
     Q_OBJECT
@@ -49,9 +51,15 @@ public:
     QStringList topicPrefixList() const override;
 
     void publish(const QString &topic, const QByteArray &payload) override;
+    void publish(const QList<QPair<QString, QByteArray> > &messages, bool retain = false) override;
+
+    bool addTopicFilter(const QString &topicFilter) override;
+    void removeTopicFilter(const QString &topicFilter) override;
+    QStringList topicFilters() const override;
 
 signals:
     void pluginPublished(const QString &topic, const QByteArray &payload);
+    void pluginPublishedBatch(const QList<QPair<QString, QByteArray> > &messages, bool retain);
 
 private:
     QString m_clientId;
@@ -60,6 +68,8 @@ private:
     QHostAddress m_serverAddress;
     quint16 m_serverPort;
     QStringList m_topicPrefixList;
+    QStringList m_topicFilters;
+    MqttProviderImplementation *m_provider = nullptr;
 
     friend class MqttProviderImplementation;
 };
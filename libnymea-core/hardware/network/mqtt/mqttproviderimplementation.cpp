@@ -35,6 +35,8 @@
 #include <QtDebug>
 #include <QUuid>
 #include <QNetworkInterface>
+#include <QNetworkConfigurationManager>
+#include <QTimer>
 
 namespace nymeaserver {
 
@@ -45,6 +47,11 @@ MqttProviderImplementation::MqttProviderImplementation(MqttBroker *broker, QObje
     connect(broker, &MqttBroker::clientConnected, this, &MqttProviderImplementation::onClientConnected);
     connect(broker, &MqttBroker::clientDisconnected, this, &MqttProviderImplementation::onClientDisconnected);
     connect(broker, &MqttBroker::publishReceived, this, &MqttProviderImplementation::onPublishReceived);
+
+    QNetworkConfigurationManager *configManager = new QNetworkConfigurationManager(this);
+    connect(configManager, &QNetworkConfigurationManager::configurationAdded, this, &MqttProviderImplementation::onNetworkConfigurationChanged);
+    connect(configManager, &QNetworkConfigurationManager::configurationRemoved, this, &MqttProviderImplementation::onNetworkConfigurationChanged);
+    connect(configManager, &QNetworkConfigurationManager::configurationChanged, this, &MqttProviderImplementation::onNetworkConfigurationChanged);
 }
 
 MqttChannel *MqttProviderImplementation::createChannel(const QHostAddress &clientAddress, const QStringList &topicPrefixList)
@@ -52,7 +59,7 @@ MqttChannel *MqttProviderImplementation::createChannel(const QHostAddress &clien
     QString clientId;
     // Generate a clientId that hasn't been used yet.
     do {
-        clientId = QUuid::createUuid().toString().remove(QRegExp("[{}-]")).left(16);
+        clientId = generateId();
     } while (m_createdChannels.contains(clientId));
 
     return createChannel(clientId, clientAddress, topicPrefixList);
@@ -60,8 +67,8 @@ MqttChannel *MqttProviderImplementation::createChannel(const QHostAddress &clien
 
 MqttChannel *MqttProviderImplementation::createChannel(const QString &clientId, const QHostAddress &clientAddress, const QStringList &topicPrefixList)
 {
-    QString username = QUuid::createUuid().toString().remove(QRegExp("[{}-]")).left(16);
-    QString password = QUuid::createUuid().toString().remove(QRegExp("[{}-]")).left(16);
+    QString username = generateId();
+    QString password = generateId();
 
     return createChannel(clientId, username, password, clientAddress, topicPrefixList);
 }
@@ -79,6 +86,7 @@ MqttChannel *MqttProviderImplementation::createChannel(const QString &clientId,
     }
 
     MqttChannelImplementation* channel = new MqttChannelImplementation();
+    channel->m_provider = this;
     channel->m_clientId = clientId;
     channel->m_username = username;
     channel->m_password = password;
@@ -89,20 +97,9 @@ MqttChannel *MqttProviderImplementation::createChannel(const QString &clientId,
         channel->m_topicPrefixList.append(defaultTopicPrefix);
     }
 
-
-    foreach (const QNetworkInterface &interface, QNetworkInterface::allInterfaces()) {
-        foreach (const QNetworkAddressEntry &addressEntry, interface.addressEntries()) {
-            if (clientAddress.isInSubnet(addressEntry.ip(), addressEntry.prefixLength())) {
-                foreach (const ServerConfiguration &config, m_broker->configurations()) {
-                    if (config.address == QHostAddress("0.0.0.0") || clientAddress.isInSubnet(config.address, addressEntry.prefixLength())) {
-                        channel->m_serverAddress = addressEntry.ip();
-                        channel->m_serverPort = config.port;
-                        break;
-                    }
-                }
-            }
-        }
-    }
+    QPair<QHostAddress, quint16> endpoint = serverEndpoint(clientAddress);
+    channel->m_serverAddress = endpoint.first;
+    channel->m_serverPort = endpoint.second;
     if (channel->serverAddress().isNull()) {
         qCWarning(dcMqtt) << "Unable to find a matching MQTT server port for client address" << clientAddress.toString();
         delete channel;
@@ -111,6 +108,7 @@ MqttChannel *MqttProviderImplementation::createChannel(const QString &clientId,
     qCDebug(dcMqtt) << "Suitable MQTT server for" << clientAddress.toString() << "found at" << channel->m_serverAddress.toString() << "on port" << channel->m_serverPort;
 
     connect(channel, &MqttChannelImplementation::pluginPublished, this, &MqttProviderImplementation::onPluginPublished);
+    connect(channel, &MqttChannelImplementation::pluginPublishedBatch, this, &MqttProviderImplementation::onPluginPublishedBatch);
 
     m_createdChannels.insert(channel->clientId(), channel);
 
@@ -122,6 +120,7 @@ MqttChannel *MqttProviderImplementation::createChannel(const QString &clientId,
     foreach (const QString &topicPrefix, channel->m_topicPrefixList) {
         policy.allowedPublishTopicFilters.append(QString("%1/#").arg(topicPrefix));
         policy.allowedSubscribeTopicFilters.append(QString("%1/#").arg(topicPrefix));
+        m_topicPermissions.insert(QString("%1/#").arg(topicPrefix), channel->clientId());
     }
     m_broker->updatePolicy(policy);
 
@@ -136,6 +135,13 @@ void MqttProviderImplementation::releaseChannel(MqttChannel *channel)
     }
     m_createdChannels.take(channel->clientId());
     m_broker->removePolicy(channel->clientId());
+
+    foreach (const QString &topicPrefix, channel->topicPrefixList())
+        m_topicPermissions.remove(QString("%1/#").arg(topicPrefix), channel->clientId());
+
+    foreach (const QString &topicFilter, channel->topicFilters())
+        m_topicSubscriptions.remove(topicFilter, {channel, topicFilter});
+
     qCDebug(dcMqtt) << "Released MQTT channel for client ID" << channel->clientId();
     delete channel;
 }
@@ -202,6 +208,38 @@ void MqttProviderImplementation::setEnabled(bool enabled)
     qCWarning(dcMqtt) << "MQTT hardware resource cannot be disabled";
 }
 
+bool MqttProviderImplementation::addTopicFilter(MqttChannelImplementation *channel, const QString &topicFilter)
+{
+    if (!MqttTopicTrie<QString>::isValidTopicFilter(topicFilter)) {
+        qCWarning(dcMqtt()) << "Invalid topic filter" << topicFilter << "for MQTT channel" << channel->clientId();
+        return false;
+    }
+
+    // Wildcards in the filter are only covered by wildcards of the allowed prefixes
+    if (!m_topicPermissions.matches(topicFilter, channel->clientId())) {
+        qCWarning(dcMqtt()) << "Topic filter" << topicFilter << "is not within the allowed topic prefixes of MQTT channel" << channel->clientId();
+        return false;
+    }
+
+    m_topicSubscriptions.insert(topicFilter, {channel, topicFilter});
+
+    // Deliver the retained messages matching the new filter
+    QHash<QString, QByteArray> retainedMessages = m_broker->retainedMessages(topicFilter);
+    if (!retainedMessages.isEmpty()) {
+        QTimer::singleShot(0, channel, [channel, topicFilter, retainedMessages]() {
+            for (QHash<QString, QByteArray>::const_iterator it = retainedMessages.constBegin(); it != retainedMessages.constEnd(); ++it) {
+                emit channel->topicFilterMatched(channel, topicFilter, it.key(), it.value());
+            }
+        });
+    }
+    return true;
+}
+
+void MqttProviderImplementation::removeTopicFilter(MqttChannelImplementation *channel, const QString &topicFilter)
+{
+    m_topicSubscriptions.remove(topicFilter, {channel, topicFilter});
+}
+
 void MqttProviderImplementation::onClientConnected(const QString &clientId)
 {
     if (m_createdChannels.contains(clientId)) {
@@ -224,23 +262,85 @@ void MqttProviderImplementation::onPublishReceived(const QString &clientId, cons
         MqttChannel* channel = m_createdChannels.value(clientId);
         emit channel->publishReceived(channel, topic, payload);
     }
+
+    foreach (const TopicSubscription &subscription, m_topicSubscriptions.match(topic)) {
+        emit subscription.channel->topicFilterMatched(subscription.channel, subscription.topicFilter, topic, payload);
+    }
 }
 
 void MqttProviderImplementation::onPluginPublished(const QString &topic, const QByteArray &payload)
 {
     MqttChannelImplementation *channel = static_cast<MqttChannelImplementation*>(sender());
-    bool found = false;
-    foreach (const QString &topicPrefix, channel->topicPrefixList()) {
-        if (topicPrefix.startsWith(topicPrefix)) {
-            found = true;
-            break;
+    if (!m_topicPermissions.matches(topic, channel->clientId())) {
+        qCWarning(dcMqtt) << "Attempt to publish to MQTT channel for client" << channel->clientId() << "but topic is not within allowed topic prefix. Discarding message.";
+        return;
+    }
+    m_broker->publish(topic, payload);
+}
+
+void MqttProviderImplementation::onPluginPublishedBatch(const QList<QPair<QString, QByteArray> > &messages, bool retain)
+{
+    MqttChannelImplementation *channel = static_cast<MqttChannelImplementation*>(sender());
+    QList<QPair<QString, QByteArray> > allowedMessages;
+    allowedMessages.reserve(messages.count());
+    for (int i = 0; i < messages.count(); i++) {
+        if (!m_topicPermissions.matches(messages.at(i).first, channel->clientId())) {
+            qCWarning(dcMqtt) << "Attempt to publish to MQTT channel for client" << channel->clientId() << "but topic" << messages.at(i).first << "is not within allowed topic prefix. Discarding message.";
+            continue;
         }
+        allowedMessages.append(messages.at(i));
+    }
+    m_broker->publish(allowedMessages, retain);
+}
 
+void MqttProviderImplementation::onNetworkConfigurationChanged()
+{
+    m_addressEntriesValid = false;
+    m_serverEndpoints.clear();
+}
+
+QPair<QHostAddress, quint16> MqttProviderImplementation::serverEndpoint(const QHostAddress &clientAddress)
+{
+    QList<ServerConfiguration> configurations = m_broker->configurations();
+    if (configurations != m_endpointConfigurations) {
+        m_endpointConfigurations = configurations;
+        m_serverEndpoints.clear();
     }
-    if (!found) {
-        qCWarning(dcMqtt) << "Attempt to publish to MQTT channel for client" << channel->clientId() << "but topic is not within allowed topic prefix. Discarding message.";
+
+    if (!m_addressEntriesValid) {
+        m_addressEntries.clear();
+        foreach (const QNetworkInterface &interface, QNetworkInterface::allInterfaces()) {
+            m_addressEntries.append(interface.addressEntries());
+        }
+        m_addressEntriesValid = true;
     }
-    m_broker->publish(topic, payload);
+
+    if (m_serverEndpoints.contains(clientAddress)) {
+        return m_serverEndpoints.value(clientAddress);
+    }
+
+    QPair<QHostAddress, quint16> endpoint;
+    foreach (const QNetworkAddressEntry &addressEntry, m_addressEntries) {
+        if (clientAddress.isInSubnet(addressEntry.ip(), addressEntry.prefixLength())) {
+            foreach (const ServerConfiguration &config, configurations) {
+                if (config.address == QHostAddress("0.0.0.0") || clientAddress.isInSubnet(config.address, addressEntry.prefixLength())) {
+                    endpoint = qMakePair(addressEntry.ip(), static_cast<quint16>(config.port));
+                    break;
+                }
+            }
+        }
+    }
+
+    // Don't cache failed lookups, the client may be in a network that comes up later
+    if (!endpoint.first.isNull()) {
+        m_serverEndpoints.insert(clientAddress, endpoint);
+    }
+    return endpoint;
+}
+
+QString MqttProviderImplementation::generateId()
+{
+    return QString::fromLatin1(QUuid::createUuid().toRfc4122().toHex().left(16));
 }
 
 }
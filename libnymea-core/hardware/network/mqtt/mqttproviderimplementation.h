@@ -32,12 +32,18 @@
 #define MQTTPROVIDERIMPLEMENTATION_H
 
 #include <QObject>
+#include <QHostAddress>
+#include <QNetworkAddressEntry>
 
 #include "servers/mqttbroker.h"
 
 #include "network/mqtt/mqttprovider.h"
+#include "network/mqtt/mqtttopictrie.h"
+
 namespace nymeaserver {
 
+class MqttChannelImplementation;
+
 class MqttProviderImplementation : public MqttProvider
 {
     Q_OBJECT
@@ -55,16 +61,43 @@ public:
     bool enabled() const override;
     void setEnabled(bool enabled) override;
 
+    bool addTopicFilter(MqttChannelImplementation *channel, const QString &topicFilter);
+    void removeTopicFilter(MqttChannelImplementation *channel, const QString &topicFilter);
+
 private slots:
     void onClientConnected(const QString &clientId);
     void onClientDisconnected(const QString &clientId);
     void onPublishReceived(const QString &clientId, const QString &topic, const QByteArray &payload);
     void onPluginPublished(const QString &topic, const QByteArray &payload);
+    void onPluginPublishedBatch(const QList<QPair<QString, QByteArray> > &messages, bool retain);
+    void onNetworkConfigurationChanged();
 
 private:
     MqttBroker* m_broker = nullptr;
 
     QHash<QString, MqttChannel*> m_createdChannels;
+
+    struct TopicSubscription {
+        MqttChannel *channel;
+        QString topicFilter;
+        bool operator==(const TopicSubscription &other) const {
+            return channel == other.channel && topicFilter == other.topicFilter;
+        }
+    };
+
+    // Topic prefixes allowed for each channel (clientId) and topic filters registered by plugins
+    MqttTopicTrie<QString> m_topicPermissions;
+    MqttTopicTrie<TopicSubscription> m_topicSubscriptions;
+
+    // Enumerating the network interfaces is expensive, so the local address entries and the
+    // resulting server endpoints are cached until the network or the broker configuration changes
+    bool m_addressEntriesValid = false;
+    QList<QNetworkAddressEntry> m_addressEntries;
+    QList<ServerConfiguration> m_endpointConfigurations;
+    QHash<QHostAddress, QPair<QHostAddress, quint16> > m_serverEndpoints;    // client address | server address, port
+
+    QPair<QHostAddress, quint16> serverEndpoint(const QHostAddress &clientAddress);
+    static QString generateId();
 };
 
 }
@@ -38,10 +38,18 @@
   The network manager class is a reimplementation of the \l{http://doc-snapshot.qt-project.org/qt5-5.4/qnetworkaccessmanager.html}{QNetworkAccessManager}
   and allows plugins to send network requests and receive replies.
 
+  Requests of all plugins share the keep-alive connections, the DNS cache and the TLS session tickets of one
+  QNetworkAccessManager. HTTP/2 is allowed unless a request disables it explicitly. Responses are only taken from the
+  cache, honoring Cache-Control, for requests setting the QNetworkRequest::CacheLoadControlAttribute themselves.
+
 */
 
 #include "networkaccessmanagerimpl.h"
 #include "loggingcategories.h"
+#include "nymeasettings.h"
+
+#include <QNetworkDiskCache>
+#include <QSslConfiguration>
 
 namespace nymeaserver {
 
@@ -50,6 +58,12 @@ NetworkAccessManagerImpl::NetworkAccessManagerImpl(QNetworkAccessManager *networ
     NetworkAccessManager(parent),
     m_manager(networkManager)
 {
+    // The access manager takes the ownership of the cache. It is used by requests which opt in only, see prepareRequest()
+    QNetworkDiskCache *cache = new QNetworkDiskCache(m_manager);
+    cache->setCacheDirectory(NymeaSettings::storagePath() + "/networkcache/");
+    cache->setMaximumCacheSize(10 * 1024 * 1024);
+    m_manager->setCache(cache);
+
     m_available = true;
 
     qCDebug(dcHardware()) << "-->" << name() << "created successfully.";
@@ -57,70 +71,70 @@ NetworkAccessManagerImpl::NetworkAccessManagerImpl(QNetworkAccessManager *networ
 
 QNetworkReply *NetworkAccessManagerImpl::get(const QNetworkRequest &request)
 {
-    QNetworkReply *reply = m_manager->get(request);
+    QNetworkReply *reply = m_manager->get(prepareRequest(request));
     hookupTimeoutTimer(reply);
     return reply;
 }
 
 QNetworkReply *NetworkAccessManagerImpl::deleteResource(const QNetworkRequest &request)
 {
-    QNetworkReply *reply = m_manager->deleteResource(request);
+    QNetworkReply *reply = m_manager->deleteResource(prepareRequest(request));
     hookupTimeoutTimer(reply);
     return reply;
 }
 
 QNetworkReply *NetworkAccessManagerImpl::head(const QNetworkRequest &request)
 {
-    QNetworkReply *reply = m_manager->head(request);
+    QNetworkReply *reply = m_manager->head(prepareRequest(request));
     hookupTimeoutTimer(reply);
     return reply;
 }
 
 QNetworkReply *NetworkAccessManagerImpl::post(const QNetworkRequest &request, QIODevice *data)
 {
-    QNetworkReply *reply = m_manager->post(request, data);
+    QNetworkReply *reply = m_manager->post(prepareRequest(request), data);
     hookupTimeoutTimer(reply);
     return reply;
 }
 
 QNetworkReply *NetworkAccessManagerImpl::post(const QNetworkRequest &request, const QByteArray &data)
 {
-    QNetworkReply *reply = m_manager->post(request, data);
+    QNetworkReply *reply = m_manager->post(prepareRequest(request), data);
     hookupTimeoutTimer(reply);
     return reply;
 }
 
 QNetworkReply *NetworkAccessManagerImpl::post(const QNetworkRequest &request, QHttpMultiPart *multiPart)
 {
-    QNetworkReply *reply = m_manager->post(request, multiPart);
+    QNetworkReply *reply = m_manager->post(prepareRequest(request), multiPart);
     hookupTimeoutTimer(reply);
     return reply;
 }
 
 QNetworkReply *NetworkAccessManagerImpl::put(const QNetworkRequest &request, QIODevice *data)
 {
-    QNetworkReply  *reply = m_manager->put(request, data);
+    QNetworkReply  *reply = m_manager->put(prepareRequest(request), data);
     hookupTimeoutTimer(reply);
     return reply;
 }
 
 QNetworkReply *NetworkAccessManagerImpl::put(const QNetworkRequest &request, const QByteArray &data)
 {
-    QNetworkReply *reply = m_manager->put(request, data);
+    QNetworkReply *reply = m_manager->put(prepareRequest(request), data);
     hookupTimeoutTimer(reply);
     return reply;
 }
 
 QNetworkReply *NetworkAccessManagerImpl::put(const QNetworkRequest &request, QHttpMultiPart *multiPart)
 {
-    QNetworkReply *reply = m_manager->put(request, multiPart);
+    QNetworkReply *reply = m_manager->put(prepareRequest(request), multiPart);
     hookupTimeoutTimer(reply);
     return reply;
 }
 
 QNetworkReply *NetworkAccessManagerImpl::sendCustomRequest(const QNetworkRequest &request, const QByteArray &verb, QIODevice *data)
 {
-    QNetworkReply* reply = m_manager->sendCustomRequest(request, verb, data);
+    QNetworkReply* reply = m_manager->sendCustomRequest(prepareRequest(request), verb, data);
     hookupTimeoutTimer(reply);
     return reply;
 }
@@ -147,9 +161,67 @@ void NetworkAccessManagerImpl::setEnabled(bool enabled)
     m_enabled = enabled;
 }
 
+QNetworkRequest NetworkAccessManagerImpl::prepareRequest(const QNetworkRequest &request) const
+{
+    QNetworkRequest preparedRequest(request);
+
+    // Response caching is opt-in, plugins polling static resources set the cache load control themselves
+    if (!request.attribute(QNetworkRequest::CacheLoadControlAttribute).isValid()) {
+        preparedRequest.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+        preparedRequest.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+    }
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    // One multiplexed connection per host if the server supports HTTP/2, HTTP/1.1 otherwise
+    if (!request.attribute(QNetworkRequest::Http2AllowedAttribute).isValid()) {
+        preparedRequest.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+    }
+#endif
+
+    if (request.url().scheme() == "https") {
+        QSslConfiguration sslConfiguration = preparedRequest.sslConfiguration();
+        sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionTickets, false);
+        sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+        QByteArray sessionTicket = m_sslSessionTickets.value(sessionKey(request.url()));
+        if (!sessionTicket.isEmpty()) {
+            sslConfiguration.setSessionTicket(sessionTicket);
+        }
+        preparedRequest.setSslConfiguration(sslConfiguration);
+    }
+
+    return preparedRequest;
+}
+
+QString NetworkAccessManagerImpl::sessionKey(const QUrl &url)
+{
+    return url.host().toLower() + ":" + QString::number(url.port(443));
+}
+
 void NetworkAccessManagerImpl::hookupTimeoutTimer(QNetworkReply *reply)
 {
     connect(reply, &QNetworkReply::finished, this, &NetworkAccessManagerImpl::networkReplyFinished);
+    connect(reply, &QNetworkReply::encrypted, this, [=](){
+        QByteArray sessionTicket = reply->sslConfiguration().sessionTicket();
+        if (sessionTicket.isEmpty())
+            return;
+
+        QString key = sessionKey(reply->url());
+        if (m_sslSessionTickets.count() >= 256 && !m_sslSessionTickets.contains(key)) {
+            m_sslSessionTickets.clear();
+        }
+        m_sslSessionTickets.insert(key, sessionTicket);
+    });
+
+    // QNetworkAccessManager opens up to 6 connections per host and queues further requests internally.
+    // Keep track of requests per host so bursts of plugins polling the same server show up in the logs.
+    QString host = reply->url().host();
+    int pendingRequests = m_pendingRequests.value(host) + 1;
+    m_pendingRequests.insert(host, pendingRequests);
+    if (pendingRequests > 6) {
+        qCDebug(dcNetworkManager()) << "Request to" << host << "queued behind" << pendingRequests - 1 << "pending requests";
+    }
+    m_requestTimes[reply].start();
+
     QTimer *timer = new QTimer(this);
     connect(timer, &QTimer::timeout, this, &NetworkAccessManagerImpl::networkTimeout);
     timer->setSingleShot(true);
@@ -162,6 +234,18 @@ void NetworkAccessManagerImpl::networkReplyFinished()
     QNetworkReply *reply = static_cast<QNetworkReply*>(sender());
     QTimer *timer = m_timeoutTimers.take(reply);
     timer->stop();
+
+    QString host = reply->url().host();
+    int pendingRequests = m_pendingRequests.value(host) - 1;
+    if (pendingRequests > 0) {
+        m_pendingRequests.insert(host, pendingRequests);
+    } else {
+        m_pendingRequests.remove(host);
+    }
+    qint64 duration = m_requestTimes.take(reply).elapsed();
+    if (duration > 5000) {
+        qCDebug(dcNetworkManager()) << "Request to" << reply->url().toDisplayString(QUrl::RemoveUserInfo | QUrl::RemoveQuery) << "took" << duration << "ms," << pendingRequests << "requests still pending for this host";
+    }
     timer->deleteLater();
 }
 
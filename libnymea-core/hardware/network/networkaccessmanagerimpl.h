@@ -42,6 +42,7 @@
 #include <QDebug>
 #include <QUrl>
 #include <QTimer>
+#include <QElapsedTimer>
 
 namespace nymeaserver {
 
@@ -78,6 +79,14 @@ private:
 
     QNetworkAccessManager *m_manager;
     QHash<QNetworkReply*, QTimer*> m_timeoutTimers;
+    QHash<QNetworkReply*, QElapsedTimer> m_requestTimes;
+    QHash<QString, int> m_pendingRequests;
+
+    // TLS session tickets per host:port, for resuming sessions instead of full handshakes
+    QHash<QString, QByteArray> m_sslSessionTickets;
+
+    QNetworkRequest prepareRequest(const QNetworkRequest &request) const;
+    static QString sessionKey(const QUrl &url);
 
     void hookupTimeoutTimer(QNetworkReply* reply);
 
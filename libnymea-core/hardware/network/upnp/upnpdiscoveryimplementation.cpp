@@ -75,6 +75,7 @@ UpnpDiscoveryImplementation::UpnpDiscoveryImplementation(QNetworkAccessManager *
     connect(configManager, &QNetworkConfigurationManager::configurationRemoved, this, &UpnpDiscoveryImplementation::networkConfigurationChanged);
     connect(configManager, &QNetworkConfigurationManager::configurationChanged, this, &UpnpDiscoveryImplementation::networkConfigurationChanged);
 
+    updateLocalAddresses();
     m_available = true;
 
     qCDebug(dcUpnp()) << "-->" << name() << "created successfully.";
@@ -109,11 +110,26 @@ UpnpDiscoveryReply *UpnpDiscoveryImplementation::discoverDevices(const QString &
         return reply.data();
     }
 
+    // Serve the discovery from the cache if this search target has been searched recently
+    cleanUpSsdpCache();
+    qint64 lastSearchTimestamp = qMax(m_searchTimestamps.value(searchTarget), m_searchTimestamps.value("ssdp:all"));
+    if (QDateTime::currentMSecsSinceEpoch() - lastSearchTimestamp < m_searchCacheTime * 1000) {
+        QList<UpnpDeviceDescriptor> deviceDescriptors = cachedDeviceDescriptors(searchTarget);
+        qCDebug(dcUpnp) << "Serving discovery for" << searchTarget << "from the cache with" << deviceDescriptors.count() << "devices";
+        reply->setDeviceDescriptors(deviceDescriptors);
+        reply->setError(UpnpDiscoveryReplyImplementation::UpnpDiscoveryReplyErrorNoError);
+        reply->setFinished();
+        return reply.data();
+    }
+
     qCDebug(dcUpnp) << "Starging discovery for" << searchTarget << "(User agent:" << userAgent << ")";
 
-    // Looks good so far, lets start a request
+    // Looks good so far, lets start a request. Cached devices are still alive according to their max-age.
     UpnpDiscoveryRequest *request = new UpnpDiscoveryRequest(this, reply.data());
     connect(request, &UpnpDiscoveryRequest::discoveryTimeout, this, &UpnpDiscoveryImplementation::discoverTimeout);
+    foreach (const UpnpDeviceDescriptor &deviceDescriptor, cachedDeviceDescriptors(searchTarget)) {
+        request->addDeviceDescriptor(deviceDescriptor);
+    }
     request->discover(timeout);
     m_discoverRequests.append(request);
     return reply.data();
@@ -122,7 +138,12 @@ UpnpDiscoveryReply *UpnpDiscoveryImplementation::discoverDevices(const QString &
 void UpnpDiscoveryImplementation::requestDeviceInformation(const QNetworkRequest &networkRequest, const UpnpDeviceDescriptor &upnpDeviceDescriptor)
 {
     qCDebug(dcUpnp()) << "Requesting device information for" << networkRequest.url();
-    QNetworkReply *replay = m_networkAccessManager->get(networkRequest);
+
+    // The descriptions are cached along with the SSDP announcements, keep them out of the HTTP cache
+    QNetworkRequest request(networkRequest);
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+    QNetworkReply *replay = m_networkAccessManager->get(request);
     connect(replay, &QNetworkReply::finished, this, &UpnpDiscoveryImplementation::replyFinished);
     m_informationRequestList.insert(replay, upnpDeviceDescriptor);
 }
@@ -243,54 +264,199 @@ void UpnpDiscoveryImplementation::error(QAbstractSocket::SocketError error)
 
 void UpnpDiscoveryImplementation::readData()
 {
-    QByteArray data;
-    quint16 port;
-    QHostAddress hostAddress;
-    QUrl location;
+    // Process each datagram on its own, a burst of responses must not overwrite each other
+    while (m_socket && m_socket->hasPendingDatagrams()) {
+        QByteArray data;
+        quint16 port = 0;
+        QHostAddress hostAddress;
+        data.resize(static_cast<int>(m_socket->pendingDatagramSize()));
+        qint64 size = m_socket->readDatagram(data.data(), data.size(), &hostAddress, &port);
+        if (size < 0) {
+            qCWarning(dcUpnp()) << "Failed to read datagram:" << m_socket->errorString();
+            break;
+        }
 
-    // read the answere from the multicast
-    while (m_socket->hasPendingDatagrams()) {
-        data.resize(m_socket->pendingDatagramSize());
-        m_socket->readDatagram(data.data(), data.size(), &hostAddress, &port);
+        data.resize(static_cast<int>(size));
+        processDatagram(data, hostAddress, port);
     }
+}
 
-    if (data.contains("M-SEARCH") && !QNetworkInterface::allAddresses().contains(hostAddress)) {
-        qCDebug(dcUpnp()) << "UPnP discovery request received. Responding...";
-        respondToSearchRequest(hostAddress, port);
+void UpnpDiscoveryImplementation::processDatagram(const QByteArray &data, const QHostAddress &hostAddress, quint16 port)
+{
+    // The start line tells what this is, no need to look any further for most of the traffic
+    if (data.startsWith("M-SEARCH")) {
+        if (!m_localAddresses.contains(hostAddress)) {
+            qCDebug(dcUpnp()) << "UPnP discovery request received. Responding...";
+            respondToSearchRequest(hostAddress, port);
+        }
         return;
     }
 
-    if (data.contains("NOTIFY") && !QNetworkInterface::allAddresses().contains(hostAddress)) {
-        emit upnpNotify(data);
+    if (data.startsWith("NOTIFY")) {
+        if (!m_localAddresses.contains(hostAddress)) {
+            emit upnpNotify(data);
+
+            QString notificationType = QString::fromUtf8(headerValue(data, "NT"));
+            if (headerValue(data, "NTS") == "ssdp:byebye") {
+                removeFromSsdpCache(QString::fromUtf8(headerValue(data, "USN")));
+            } else {
+                updateSsdpCache(data, hostAddress, notificationType);
+            }
+        }
         return;
     }
 
-    // if the data contains the HTTP OK header...
-    if (data.contains("HTTP/1.1 200 OK")) {
-        const QStringList lines = QString(data).split("\r\n");
-        foreach (const QString& line, lines) {
-            int separatorIndex = line.indexOf(':');
-            QString key = line.left(separatorIndex).toUpper();
-            QString value = line.mid(separatorIndex+1).trimmed();
+    if (data.startsWith("HTTP/1.1 200 OK")) {
+        updateSsdpCache(data, hostAddress, QString::fromUtf8(headerValue(data, "ST")));
+    }
+}
 
-            // get location
-            if (key.contains("LOCATION") || key.contains("location") || key.contains("Location")) {
-                location = QUrl(value);
-            }
-        }
+void UpnpDiscoveryImplementation::updateSsdpCache(const QByteArray &data, const QHostAddress &hostAddress, const QString &target)
+{
+    QUrl location = QUrl(QString::fromUtf8(headerValue(data, "LOCATION")));
+    if (!location.isValid())
+        return;
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    SsdpCacheEntry &entry = m_ssdpCache[location];
+    if (entry.expiryTimestamp < now) {
+        // New or expired, the description has to be fetched (again)
+        entry.described = false;
+        entry.targets.clear();
+        entry.uuids.clear();
+        entry.deviceDescriptor = UpnpDeviceDescriptor();
+        entry.deviceDescriptor.setLocation(location);
+        entry.deviceDescriptor.setHostAddress(hostAddress);
+        entry.deviceDescriptor.setPort(location.port());
+    }
+
+    entry.expiryTimestamp = now + maxAge(data) * 1000;
+    if (!target.isEmpty())
+        entry.targets.insert(target);
 
-        UpnpDeviceDescriptor upnpDeviceDescriptor;
-        upnpDeviceDescriptor.setLocation(location);
-        upnpDeviceDescriptor.setHostAddress(hostAddress);
-        upnpDeviceDescriptor.setPort(location.port());
+    QString uuid = uuidFromUniqueServiceName(QString::fromUtf8(headerValue(data, "USN")));
+    if (!uuid.isEmpty())
+        entry.uuids.insert(uuid);
 
+    if (entry.described) {
         foreach (UpnpDiscoveryRequest *upnpDiscoveryRequest, m_discoverRequests) {
-            QNetworkRequest networkRequest = upnpDiscoveryRequest->createNetworkRequest(upnpDeviceDescriptor);
-            requestDeviceInformation(networkRequest, upnpDeviceDescriptor);
+            upnpDiscoveryRequest->addDeviceDescriptor(entry.deviceDescriptor);
+        }
+        return;
+    }
+
+    // Fetch each description only once, devices send several responses and notifications
+    foreach (const UpnpDeviceDescriptor &pendingDeviceDescriptor, m_informationRequestList) {
+        if (pendingDeviceDescriptor.location() == location) {
+            return;
+        }
+    }
+
+    QNetworkRequest networkRequest;
+    if (!m_discoverRequests.isEmpty()) {
+        networkRequest = m_discoverRequests.first()->createNetworkRequest(entry.deviceDescriptor);
+    } else {
+        networkRequest.setUrl(location);
+        networkRequest.setHeader(QNetworkRequest::ContentTypeHeader, QVariant("text/xml"));
+    }
+    requestDeviceInformation(networkRequest, entry.deviceDescriptor);
+}
+
+void UpnpDiscoveryImplementation::removeFromSsdpCache(const QString &uniqueServiceName)
+{
+    QString uuid = uuidFromUniqueServiceName(uniqueServiceName);
+    if (uuid.isEmpty())
+        return;
+
+    QMutableHashIterator<QUrl, SsdpCacheEntry> iterator(m_ssdpCache);
+    while (iterator.hasNext()) {
+        iterator.next();
+        if (iterator.value().uuids.contains(uuid) || iterator.value().deviceDescriptor.uuid() == uuid) {
+            qCDebug(dcUpnp()) << "Device" << iterator.key().toString() << "said goodbye. Removing it from the cache.";
+            iterator.remove();
+        }
+    }
+}
+
+void UpnpDiscoveryImplementation::cleanUpSsdpCache()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QMutableHashIterator<QUrl, SsdpCacheEntry> iterator(m_ssdpCache);
+    while (iterator.hasNext()) {
+        iterator.next();
+        if (iterator.value().expiryTimestamp < now) {
+            iterator.remove();
         }
     }
 }
 
+QList<UpnpDeviceDescriptor> UpnpDiscoveryImplementation::cachedDeviceDescriptors(const QString &searchTarget) const
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QList<UpnpDeviceDescriptor> deviceDescriptors;
+    foreach (const SsdpCacheEntry &entry, m_ssdpCache) {
+        if (!entry.described || entry.expiryTimestamp < now)
+            continue;
+
+        if (searchTarget != "ssdp:all" && !entry.targets.contains(searchTarget) && !entry.uuids.contains(searchTarget))
+            continue;
+
+        deviceDescriptors.append(entry.deviceDescriptor);
+    }
+
+    return deviceDescriptors;
+}
+
+int UpnpDiscoveryImplementation::maxAge(const QByteArray &data)
+{
+    // CACHE-CONTROL: max-age = 1800, the spec requires at least 1800 seconds
+    QByteArray cacheControl = headerValue(data, "CACHE-CONTROL").toLower();
+    int index = cacheControl.indexOf("max-age");
+    if (index < 0)
+        return 1800;
+
+    index = cacheControl.indexOf('=', index);
+    if (index < 0)
+        return 1800;
+
+    bool valid = false;
+    int maxAge = cacheControl.mid(index + 1).split(',').first().trimmed().toInt(&valid);
+    return valid && maxAge >= 0 ? maxAge : 1800;
+}
+
+QString UpnpDiscoveryImplementation::uuidFromUniqueServiceName(const QString &uniqueServiceName)
+{
+    // USN: uuid:device-UUID::urn:domain-name:device:deviceType:ver
+    return uniqueServiceName.section("::", 0, 0).trimmed();
+}
+
+QByteArray UpnpDiscoveryImplementation::headerValue(const QByteArray &data, const QByteArray &headerName)
+{
+    // Header names are case insensitive, the first line is the start line
+    int lineStart = data.indexOf("\r\n");
+    while (lineStart >= 0) {
+        lineStart += 2;
+        int lineEnd = data.indexOf("\r\n", lineStart);
+        if (lineEnd < 0)
+            lineEnd = data.length();
+
+        // Empty line, end of the headers
+        if (lineEnd == lineStart)
+            break;
+
+        int separatorIndex = data.indexOf(':', lineStart);
+        if (separatorIndex > lineStart && separatorIndex < lineEnd
+                && separatorIndex - lineStart == headerName.length()
+                && qstrnicmp(data.constData() + lineStart, headerName.constData(), static_cast<uint>(headerName.length())) == 0) {
+            return data.mid(separatorIndex + 1, lineEnd - separatorIndex - 1).trimmed();
+        }
+
+        lineStart = lineEnd < data.length() ? lineEnd : -1;
+    }
+
+    return QByteArray();
+}
+
 void UpnpDiscoveryImplementation::replyFinished()
 {
     QNetworkReply *reply = static_cast<QNetworkReply *>(sender());
@@ -354,6 +520,13 @@ void UpnpDiscoveryImplementation::replyFinished()
             }
         }
 
+        // The description is valid as long as the announcement
+        if (m_ssdpCache.contains(upnpDeviceDescriptor.location())) {
+            SsdpCacheEntry &entry = m_ssdpCache[upnpDeviceDescriptor.location()];
+            entry.deviceDescriptor = upnpDeviceDescriptor;
+            entry.described = true;
+        }
+
         qCDebug(dcUpnp()) << "Discovery result:" << upnpDeviceDescriptor.hostAddress().toString();
         qCDebug(dcUpnp()) << "Have" << m_discoverRequests.count() << "running discoveries";
         foreach (UpnpDiscoveryRequest *upnpDiscoveryRequest, m_discoverRequests) {
@@ -371,6 +544,7 @@ void UpnpDiscoveryImplementation::replyFinished()
 
 void UpnpDiscoveryImplementation::notificationTimeout()
 {
+    cleanUpSsdpCache();
     sendAliveMessage();
 }
 
@@ -477,6 +651,7 @@ void UpnpDiscoveryImplementation::discoverTimeout()
         qCDebug(dcUpnp()) << "Descovery finished. Found devices:";
         qCDebug(dcUpnp()) << discoveryRequest->deviceList();
         reply->setDeviceDescriptors(discoveryRequest->deviceList());
+        m_searchTimestamps[reply->searchTarget()] = QDateTime::currentMSecsSinceEpoch();
         reply->setError(UpnpDiscoveryReplyImplementation::UpnpDiscoveryReplyErrorNoError);
         reply->setFinished();
     }
@@ -488,12 +663,24 @@ void UpnpDiscoveryImplementation::discoverTimeout()
 void UpnpDiscoveryImplementation::networkConfigurationChanged(const QNetworkConfiguration &config)
 {
     Q_UNUSED(config)
+    updateLocalAddresses();
+
+    // Don't serve discoveries from the cache after network changes
+    m_searchTimestamps.clear();
     if (m_enabled) {
         disable();
         enable();
     }
 }
 
+void UpnpDiscoveryImplementation::updateLocalAddresses()
+{
+    m_localAddresses.clear();
+    foreach (const QHostAddress &address, QNetworkInterface::allAddresses()) {
+        m_localAddresses.insert(address);
+    }
+}
+
 bool UpnpDiscoveryImplementation::enable()
 {
     // Clean up
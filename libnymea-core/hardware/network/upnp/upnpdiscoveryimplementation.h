@@ -32,6 +32,7 @@
 #define UPNPDISCOVERYIMPLEMENTATION_H
 
 #include <QUrl>
+#include <QSet>
 #include <QTimer>
 #include <QUdpSocket>
 #include <QHostAddress>
@@ -71,16 +72,42 @@ private:
 
     QTimer *m_notificationTimer = nullptr;
 
+    // Own addresses, for ignoring our own multicast messages
+    QSet<QHostAddress> m_localAddresses;
+
     QNetworkAccessManager *m_networkAccessManager = nullptr;
 
     QList<UpnpDiscoveryRequest *> m_discoverRequests;
     QHash<QNetworkReply*, UpnpDeviceDescriptor> m_informationRequestList;
 
+    // SSDP cache, one entry per device description location, valid for the announced max-age
+    struct SsdpCacheEntry {
+        UpnpDeviceDescriptor deviceDescriptor;
+        bool described = false;
+        qint64 expiryTimestamp = 0;
+        QSet<QString> targets;
+        QSet<QString> uuids;
+    };
+    QHash<QUrl, SsdpCacheEntry> m_ssdpCache;
+    QHash<QString, qint64> m_searchTimestamps;
+    int m_searchCacheTime = 120;
+
     bool m_available = false;
     bool m_enabled = false;
 
     void requestDeviceInformation(const QNetworkRequest &networkRequest, const UpnpDeviceDescriptor &upnpDeviceDescriptor);
     void respondToSearchRequest(QHostAddress host, int port);
+    void updateLocalAddresses();
+    void processDatagram(const QByteArray &data, const QHostAddress &hostAddress, quint16 port);
+
+    void updateSsdpCache(const QByteArray &data, const QHostAddress &hostAddress, const QString &target);
+    void removeFromSsdpCache(const QString &uniqueServiceName);
+    void cleanUpSsdpCache();
+    QList<UpnpDeviceDescriptor> cachedDeviceDescriptors(const QString &searchTarget) const;
+
+    static QByteArray headerValue(const QByteArray &data, const QByteArray &headerName);
+    static int maxAge(const QByteArray &data);
+    static QString uuidFromUniqueServiceName(const QString &uniqueServiceName);
 
 protected:
     void setEnabled(bool enabled) override;
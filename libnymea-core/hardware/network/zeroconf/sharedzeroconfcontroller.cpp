@@ -0,0 +1,213 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+  \class nymeaserver::SharedZeroConfController
+  \brief Shares the platform ZeroConf service browsers between all plugins.
+
+  \ingroup hardware
+  \inmodule core
+
+  Plugins browsing for the same service type get their own \l{ZeroConfServiceBrowser}, but all of them are fed by one
+  browser of the platform backend. The entries found so far are cached, so a new browser knows them right away instead
+  of starting another round of mDNS queries. The platform browser is kept for a few minutes after its last user is gone.
+*/
+
+#include "sharedzeroconfcontroller.h"
+#include "loggingcategories.h"
+
+#include <QDateTime>
+
+namespace nymeaserver {
+
+SharedZeroConfServiceBrowser::SharedZeroConfServiceBrowser(const QString &serviceType, SharedZeroConfController *controller) :
+    ZeroConfServiceBrowser(serviceType, controller),
+    m_serviceType(serviceType),
+    m_controller(controller)
+{
+
+}
+
+SharedZeroConfServiceBrowser::~SharedZeroConfServiceBrowser()
+{
+    if (m_controller) {
+        m_controller->releaseBrowser(this);
+    }
+}
+
+QString SharedZeroConfServiceBrowser::serviceType() const
+{
+    return m_serviceType;
+}
+
+QList<ZeroConfServiceEntry> SharedZeroConfServiceBrowser::serviceEntries() const
+{
+    if (!m_controller)
+        return {};
+
+    return m_controller->serviceEntries(m_serviceType);
+}
+
+/*! Constructs a SharedZeroConfController forwarding to the given \a platformController with the given \a parent. */
+SharedZeroConfController::SharedZeroConfController(PlatformZeroConfController *platformController, QObject *parent) :
+    PlatformZeroConfController(parent),
+    m_platformController(platformController)
+{
+    connect(m_platformController, &PlatformZeroConfController::availableChanged, this, &PlatformZeroConfController::availableChanged);
+    connect(m_platformController, &PlatformZeroConfController::enabledChanged, this, &PlatformZeroConfController::enabledChanged);
+
+    m_cleanupTimer = new QTimer(this);
+    m_cleanupTimer->setInterval(60000);
+    connect(m_cleanupTimer, &QTimer::timeout, this, &SharedZeroConfController::onCleanupTimeout);
+}
+
+ZeroConfServiceBrowser *SharedZeroConfController::createServiceBrowser(const QString &serviceType)
+{
+    SharedZeroConfServiceBrowser *browser = new SharedZeroConfServiceBrowser(serviceType, this);
+
+    ServiceTypeBrowser &serviceTypeBrowser = m_serviceTypeBrowsers[serviceType];
+    serviceTypeBrowser.browsers.append(browser);
+    serviceTypeBrowser.releaseTimestamp = 0;
+
+    if (!serviceTypeBrowser.platformBrowser) {
+        qCDebug(dcHardware()) << "Creating ZeroConf browser for service type" << (serviceType.isEmpty() ? "all" : serviceType);
+        ZeroConfServiceBrowser *platformBrowser = m_platformController->createServiceBrowser(serviceType);
+        serviceTypeBrowser.platformBrowser = platformBrowser;
+
+        connect(platformBrowser, &ZeroConfServiceBrowser::serviceEntryAdded, this, [=](const ZeroConfServiceEntry &entry){
+            ServiceTypeBrowser &serviceTypeBrowser = m_serviceTypeBrowsers[serviceType];
+            serviceTypeBrowser.serviceEntries.removeAll(entry);
+            serviceTypeBrowser.serviceEntries.append(entry);
+            foreach (SharedZeroConfServiceBrowser *browser, serviceTypeBrowser.browsers) {
+                emit browser->serviceEntryAdded(entry);
+            }
+        });
+
+        connect(platformBrowser, &ZeroConfServiceBrowser::serviceEntryRemoved, this, [=](const ZeroConfServiceEntry &entry){
+            ServiceTypeBrowser &serviceTypeBrowser = m_serviceTypeBrowsers[serviceType];
+            serviceTypeBrowser.serviceEntries.removeAll(entry);
+            foreach (SharedZeroConfServiceBrowser *browser, serviceTypeBrowser.browsers) {
+                emit browser->serviceEntryRemoved(entry);
+            }
+        });
+
+        // Entries the platform browser knows already, e.g. from the backend cache
+        serviceTypeBrowser.serviceEntries = platformBrowser->serviceEntries();
+    } else {
+        qCDebug(dcHardware()) << "Sharing ZeroConf browser for service type" << (serviceType.isEmpty() ? "all" : serviceType)
+                              << "with" << serviceTypeBrowser.browsers.count() << "users and" << serviceTypeBrowser.serviceEntries.count() << "known entries";
+    }
+
+    // A browser of its own would report the known entries as they get found, do the same in the next event loop
+    QPointer<SharedZeroConfServiceBrowser> browserPointer(browser);
+    QList<ZeroConfServiceEntry> knownEntries = serviceTypeBrowser.serviceEntries;
+    if (!knownEntries.isEmpty()) {
+        QTimer::singleShot(0, this, [=](){
+            if (browserPointer.isNull())
+                return;
+
+            QList<ZeroConfServiceEntry> currentEntries = serviceEntries(serviceType);
+            foreach (const ZeroConfServiceEntry &entry, knownEntries) {
+                if (currentEntries.contains(entry)) {
+                    emit browserPointer->serviceEntryAdded(entry);
+                }
+            }
+        });
+    }
+
+    return browser;
+}
+
+ZeroConfServicePublisher *SharedZeroConfController::servicePublisher() const
+{
+    return m_platformController->servicePublisher();
+}
+
+bool SharedZeroConfController::available() const
+{
+    return m_platformController->available();
+}
+
+bool SharedZeroConfController::enabled() const
+{
+    return m_platformController->enabled();
+}
+
+void SharedZeroConfController::setEnabled(bool enabled)
+{
+    m_platformController->setEnabled(enabled);
+}
+
+QList<ZeroConfServiceEntry> SharedZeroConfController::serviceEntries(const QString &serviceType) const
+{
+    return m_serviceTypeBrowsers.value(serviceType).serviceEntries;
+}
+
+void SharedZeroConfController::releaseBrowser(SharedZeroConfServiceBrowser *browser)
+{
+    if (!m_serviceTypeBrowsers.contains(browser->serviceType()))
+        return;
+
+    ServiceTypeBrowser &serviceTypeBrowser = m_serviceTypeBrowsers[browser->serviceType()];
+    serviceTypeBrowser.browsers.removeAll(browser);
+    if (serviceTypeBrowser.browsers.isEmpty()) {
+        serviceTypeBrowser.releaseTimestamp = QDateTime::currentMSecsSinceEpoch();
+        if (!m_cleanupTimer->isActive()) {
+            m_cleanupTimer->start();
+        }
+    }
+}
+
+void SharedZeroConfController::onCleanupTimeout()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    bool unused = false;
+    QMutableHashIterator<QString, ServiceTypeBrowser> iterator(m_serviceTypeBrowsers);
+    while (iterator.hasNext()) {
+        iterator.next();
+        if (!iterator.value().browsers.isEmpty())
+            continue;
+
+        if (now - iterator.value().releaseTimestamp < m_browserTtl * 1000) {
+            unused = true;
+            continue;
+        }
+
+        qCDebug(dcHardware()) << "Removing unused ZeroConf browser for service type" << (iterator.key().isEmpty() ? "all" : iterator.key());
+        iterator.value().platformBrowser->deleteLater();
+        iterator.remove();
+    }
+
+    if (!unused) {
+        m_cleanupTimer->stop();
+    }
+}
+
+}
@@ -0,0 +1,105 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SHAREDZEROCONFCONTROLLER_H
+#define SHAREDZEROCONFCONTROLLER_H
+
+#include <QHash>
+#include <QTimer>
+#include <QObject>
+#include <QPointer>
+
+#include "platform/platformzeroconfcontroller.h"
+#include "network/zeroconf/zeroconfservicebrowser.h"
+
+namespace nymeaserver {
+
+class SharedZeroConfController;
+
+class SharedZeroConfServiceBrowser : public ZeroConfServiceBrowser
+{
+    Q_OBJECT
+
+public:
+    explicit SharedZeroConfServiceBrowser(const QString &serviceType, SharedZeroConfController *controller);
+    ~SharedZeroConfServiceBrowser() override;
+
+    QString serviceType() const;
+
+    QList<ZeroConfServiceEntry> serviceEntries() const override;
+
+private:
+    QString m_serviceType;
+    QPointer<SharedZeroConfController> m_controller;
+
+};
+
+class SharedZeroConfController : public PlatformZeroConfController
+{
+    Q_OBJECT
+
+    friend class SharedZeroConfServiceBrowser;
+
+public:
+    explicit SharedZeroConfController(PlatformZeroConfController *platformController, QObject *parent = nullptr);
+    ~SharedZeroConfController() override = default;
+
+    ZeroConfServiceBrowser *createServiceBrowser(const QString &serviceType = QString()) override;
+    ZeroConfServicePublisher *servicePublisher() const override;
+
+    bool available() const override;
+    bool enabled() const override;
+    void setEnabled(bool enabled) override;
+
+private:
+    // One platform browser per service type, shared by all plugins and kept for a while after the last one left
+    struct ServiceTypeBrowser {
+        ZeroConfServiceBrowser *platformBrowser = nullptr;
+        QList<SharedZeroConfServiceBrowser *> browsers;
+        QList<ZeroConfServiceEntry> serviceEntries;
+        qint64 releaseTimestamp = 0;
+    };
+
+    PlatformZeroConfController *m_platformController = nullptr;
+    QHash<QString, ServiceTypeBrowser> m_serviceTypeBrowsers;
+    QTimer *m_cleanupTimer = nullptr;
+    int m_browserTtl = 300;
+
+    QList<ZeroConfServiceEntry> serviceEntries(const QString &serviceType) const;
+    void releaseBrowser(SharedZeroConfServiceBrowser *browser);
+
+private slots:
+    void onCleanupTimeout();
+
+};
+
+}
+
+#endif // SHAREDZEROCONFCONTROLLER_H
@@ -30,15 +30,27 @@
 
 #include "plugintimermanagerimplementation.h"
 #include "loggingcategories.h"
-#include "nymeacore.h"
+
+#include <QMetaMethod>
+
+#include <cmath>
 
 namespace nymeaserver {
 
-PluginTimerImplementation::PluginTimerImplementation(int interval, QObject *parent) :
-    PluginTimer(parent),
+static const double s_goldenRatio = 0.6180339887498949;
+
+// Resolution of the timer wheel and its size. One revolution covers a minute, timers with longer
+// intervals stay in their bucket for more than one revolution.
+static const int s_slotLength = 100; // ms
+static const int s_slotsPerSecond = 1000 / s_slotLength;
+static const int s_wheelSize = 60 * s_slotsPerSecond;
+
+PluginTimerImplementation::PluginTimerImplementation(int interval, PluginTimerManagerImplementation *manager) :
+    PluginTimer(manager),
+    m_manager(manager),
     m_interval(interval)
 {
-    connect(NymeaCore::instance()->timeManager(), &TimeManager::tick, this, &PluginTimerImplementation::tick);
+    m_remainingSlots = intervalSlots();
 }
 
 int PluginTimerImplementation::interval() const
@@ -48,7 +60,9 @@ int PluginTimerImplementation::interval() const
 
 int PluginTimerImplementation::currentTick() const
 {
-    return m_currentTick;
+    qint64 remainingSlots = m_dueSlot >= 0 ? m_dueSlot - m_manager->clockSlot() : m_remainingSlots;
+    int tick = static_cast<int>((intervalSlots() - remainingSlots) / s_slotsPerSecond);
+    return qBound(0, tick, qMax(0, m_interval - 1));
 }
 
 bool PluginTimerImplementation::running() const
@@ -56,6 +70,21 @@ bool PluginTimerImplementation::running() const
     return m_running;
 }
 
+void PluginTimerImplementation::connectNotify(const QMetaMethod &signal)
+{
+    if (signal == QMetaMethod::fromSignal(&PluginTimer::currentTickChanged)) {
+        if (!m_manager->m_observedTimers.contains(this)) {
+            m_manager->m_observedTimers.append(this);
+            m_manager->scheduleWakeUp();
+        }
+    }
+}
+
+qint64 PluginTimerImplementation::intervalSlots() const
+{
+    return qMax(1, m_interval * s_slotsPerSecond);
+}
+
 void PluginTimerImplementation::setRunning(bool running)
 {
     if (m_running != running) {
@@ -80,24 +109,26 @@ void PluginTimerImplementation::setCurrentTick(int tick)
     }
 }
 
-void PluginTimerImplementation::tick()
+void PluginTimerImplementation::updateSchedule()
 {
-    if (m_paused)
-        return;
-
-    if (!m_running)
-        return;
-
-    setCurrentTick(m_currentTick += 1);
-
-    if (m_currentTick >= m_interval) {
-        emit timeout();
-        reset();
+    bool active = m_running && !m_paused;
+    if (active && m_dueSlot < 0) {
+        m_manager->schedule(this, m_manager->clockSlot() + m_remainingSlots);
+        m_manager->scheduleWakeUp();
+    } else if (!active && m_dueSlot >= 0) {
+        m_remainingSlots = qMax<qint64>(1, m_dueSlot - m_manager->clockSlot());
+        m_manager->unschedule(this);
     }
 }
 
 void PluginTimerImplementation::reset()
 {
+    m_remainingSlots = intervalSlots();
+    if (m_dueSlot >= 0) {
+        m_manager->unschedule(this);
+        m_manager->schedule(this, m_manager->clockSlot() + m_remainingSlots);
+        m_manager->scheduleWakeUp();
+    }
     setCurrentTick(0);
 }
 
@@ -105,28 +136,38 @@ void PluginTimerImplementation::start()
 {
     setPaused(false);
     setRunning(true);
+    updateSchedule();
 }
 
 void PluginTimerImplementation::stop()
 {
     setPaused(false);
     setRunning(false);
+    updateSchedule();
 }
 
 void PluginTimerImplementation::pause()
 {
     m_paused = true;
+    updateSchedule();
 }
 
 void PluginTimerImplementation::resume()
 {
     m_paused = false;
+    updateSchedule();
 }
 
 
 PluginTimerManagerImplementation::PluginTimerManagerImplementation(QObject *parent) :
     PluginTimerManager(parent)
 {
+    m_wheel.resize(s_wheelSize);
+    m_wheelTimer = new QTimer(this);
+    m_wheelTimer->setSingleShot(true);
+    connect(m_wheelTimer, &QTimer::timeout, this, &PluginTimerManagerImplementation::timeTick);
+    m_clock.start();
+
     m_available = true;
     qCDebug(dcHardware()) << "-->" << name() << "created successfully.";
 }
@@ -136,30 +177,22 @@ PluginTimer *PluginTimerManagerImplementation::registerTimer(int seconds)
     QPointer<PluginTimerImplementation> pluginTimer = new PluginTimerImplementation(seconds, this);
     qCDebug(dcHardware()) << "Register timer" << pluginTimer->interval();
 
-    // TODO: schedule timer for load balancing
-
-    //    // Get min/max timer interval
-    //    PluginTimer *shortestTimer = nullptr;
-    //    PluginTimer *longestTimer = nullptr;
-    //    foreach (PluginTimer *timer, m_timers) {
-    //        if (!shortestTimer && !longestTimer) {
-    //            shortestTimer = timer;
-    //            longestTimer = timer;
-    //            continue;
-    //        }
-
-    //        if (timer->interval() < shortestTimer->interval()) {
-    //            shortestTimer = timer;
-    //            continue;
-    //        }
-
-    //        if (timer->interval() > longestTimer->interval()) {
-    //            longestTimer = timer;
-    //            continue;
-    //        }
-    //    }
+    // Spread the timers over their interval instead of letting all timers with the same interval fire in the
+    // same second. The phases follow the golden ratio sequence, which keeps them evenly distributed no matter
+    // how many timers get registered. The sub-second dispatch offset spreads timers of different intervals.
+    int sameIntervalCount = 0;
+    foreach (const QPointer<PluginTimerImplementation> &timer, m_timers) {
+        if (!timer.isNull() && timer->interval() == seconds) {
+            sameIntervalCount++;
+        }
+    }
+    double phase = std::fmod(sameIntervalCount * s_goldenRatio, 1.0);
+    int dispatchOffset = static_cast<int>(std::fmod(m_timers.count() * s_goldenRatio, 1.0) * s_slotsPerSecond);
+    pluginTimer->m_remainingSlots = qMax<qint64>(1, static_cast<qint64>((1.0 - phase) * pluginTimer->intervalSlots()) + dispatchOffset);
+    pluginTimer->m_currentTick = pluginTimer->currentTick();
 
     m_timers.append(pluginTimer);
+    pluginTimer->updateSchedule();
     return pluginTimer.data();
 }
 
@@ -176,6 +209,8 @@ void PluginTimerManagerImplementation::unregisterTimer(PluginTimer *timer)
     foreach (QPointer<PluginTimerImplementation> tPointer, m_timers) {
         if (timerPointer.data() == tPointer.data()) {
             m_timers.removeAll(tPointer);
+            m_observedTimers.removeAll(tPointer);
+            unschedule(tPointer);
             tPointer->deleteLater();
         }
     }
@@ -191,6 +226,57 @@ bool PluginTimerManagerImplementation::enabled() const
     return m_enabled;
 }
 
+qint64 PluginTimerManagerImplementation::clockSlot() const
+{
+    qint64 now = m_enabled ? m_clock.elapsed() : m_disabledSince;
+    return (now - m_disabledTime) / s_slotLength;
+}
+
+void PluginTimerManagerImplementation::schedule(PluginTimerImplementation *timer, qint64 dueSlot)
+{
+    timer->m_dueSlot = qMax(dueSlot, m_processedSlot + 1);
+    m_wheel[timer->m_dueSlot % s_wheelSize].append(timer);
+}
+
+void PluginTimerManagerImplementation::unschedule(PluginTimerImplementation *timer)
+{
+    if (timer->m_dueSlot < 0) {
+        return;
+    }
+    m_wheel[timer->m_dueSlot % s_wheelSize].removeAll(timer);
+    timer->m_dueSlot = -1;
+}
+
+// Arms the wheel timer for the next slot holding a due timer, or the next full second if someone is
+// watching the ticks. Nothing wakes up in between, idle slots cost nothing.
+void PluginTimerManagerImplementation::scheduleWakeUp()
+{
+    if (!m_enabled) {
+        return;
+    }
+
+    qint64 wakeUpSlot = m_processedSlot + s_wheelSize;
+    if (!m_observedTimers.isEmpty()) {
+        wakeUpSlot = (m_processedSlot / s_slotsPerSecond + 1) * s_slotsPerSecond;
+    }
+    for (qint64 slot = m_processedSlot + 1; slot < wakeUpSlot; slot++) {
+        bool due = false;
+        foreach (const QPointer<PluginTimerImplementation> &timer, m_wheel.at(slot % s_wheelSize)) {
+            if (!timer.isNull() && timer->m_dueSlot == slot) {
+                due = true;
+                break;
+            }
+        }
+        if (due) {
+            wakeUpSlot = slot;
+            break;
+        }
+    }
+
+    qint64 wakeUpTime = wakeUpSlot * s_slotLength + m_disabledTime;
+    m_wheelTimer->start(static_cast<int>(qMax<qint64>(0, wakeUpTime - m_clock.elapsed())));
+}
+
 void PluginTimerManagerImplementation::timeTick()
 {
     // If timer resource is not enabled do nothing
@@ -198,9 +284,54 @@ void PluginTimerManagerImplementation::timeTick()
         return;
     }
 
-    foreach (PluginTimerImplementation *timer, m_timers) {
-        timer->tick();
+    // After a stall of more than a revolution every bucket gets visited once, missed timeouts are dropped
+    qint64 targetSlot = clockSlot();
+    if (targetSlot - m_processedSlot > s_wheelSize) {
+        m_processedSlot = targetSlot - s_wheelSize;
     }
+
+    while (m_processedSlot < targetSlot) {
+        m_processedSlot++;
+
+        QList<QPointer<PluginTimerImplementation> > due;
+        QList<QPointer<PluginTimerImplementation> > &bucket = m_wheel[m_processedSlot % s_wheelSize];
+        for (int i = bucket.count() - 1; i >= 0; i--) {
+            PluginTimerImplementation *timer = bucket.at(i);
+            if (!timer) {
+                bucket.removeAt(i);
+            } else if (timer->m_dueSlot <= m_processedSlot) {
+                bucket.removeAt(i);
+                due.prepend(timer);
+            }
+        }
+
+        foreach (const QPointer<PluginTimerImplementation> &timer, due) {
+            qint64 nextSlot = timer->m_dueSlot + timer->intervalSlots();
+            if (nextSlot <= m_processedSlot) {
+                nextSlot = m_processedSlot + timer->intervalSlots();
+            }
+            timer->m_dueSlot = -1;
+            schedule(timer, nextSlot);
+            timer->setCurrentTick(0);
+        }
+        foreach (const QPointer<PluginTimerImplementation> &timer, due) {
+            if (!timer.isNull() && timer->m_dueSlot >= 0) {
+                emit timer->timeout();
+            }
+        }
+
+        if (m_processedSlot % s_slotsPerSecond == 0) {
+            for (int i = m_observedTimers.count() - 1; i >= 0; i--) {
+                if (m_observedTimers.at(i).isNull()) {
+                    m_observedTimers.removeAt(i);
+                } else {
+                    m_observedTimers.at(i)->setCurrentTick(m_observedTimers.at(i)->currentTick());
+                }
+            }
+        }
+    }
+
+    scheduleWakeUp();
 }
 
 void PluginTimerManagerImplementation::setEnabled(bool enabled)
@@ -210,12 +341,18 @@ void PluginTimerManagerImplementation::setEnabled(bool enabled)
         return;
     }
 
+    // Freeze the clock while disabled so the timers continue where they stopped
+    if (enabled) {
+        m_disabledTime += m_clock.elapsed() - m_disabledSince;
+    } else {
+        m_disabledSince = m_clock.elapsed();
+        m_wheelTimer->stop();
+    }
+
     m_enabled = enabled;
     emit enabledChanged(enabled);
 
-    foreach (QPointer<PluginTimerImplementation> timer, m_timers) {
-        timer->setPaused(enabled);
-    }
+    scheduleWakeUp();
 }
 
 bool PluginTimerManagerImplementation::enable()
@@ -237,5 +374,3 @@ bool PluginTimerManagerImplementation::disable()
 }
 
 }
-
-
@@ -34,11 +34,15 @@
 #include <QTimer>
 #include <QObject>
 #include <QPointer>
+#include <QVector>
+#include <QElapsedTimer>
 
 #include "plugintimer.h"
 
 namespace nymeaserver {
 
+class PluginTimerManagerImplementation;
+
 class PluginTimerImplementation : public PluginTimer
 {
     Q_OBJECT
@@ -46,24 +50,36 @@ class PluginTimerImplementation : public PluginTimer
     friend class PluginTimerManagerImplementation;
 
 public:
-    explicit PluginTimerImplementation(int interval, QObject *parent = nullptr);
+    explicit PluginTimerImplementation(int interval, PluginTimerManagerImplementation *manager);
 
     int interval() const override;
     int currentTick() const override;
     bool running() const override;
 
+protected:
+    void connectNotify(const QMetaMethod &signal) override;
+
 private:
+    PluginTimerManagerImplementation *m_manager = nullptr;
+
     int m_interval;
     int m_currentTick = 0;
 
+    // Wheel slot of the next timeout while scheduled, -1 if paused or stopped
+    qint64 m_dueSlot = -1;
+    // Slots left until the next timeout while not scheduled
+    qint64 m_remainingSlots = 0;
+
     bool m_paused = false;
     bool m_running = true;
 
+    qint64 intervalSlots() const;
+
     void setRunning(bool running);
     void setPaused(bool paused);
     void setCurrentTick(int tick);
 
-    void tick();
+    void updateSchedule();
 
 public slots:
     void reset() override;
@@ -79,6 +95,7 @@ class PluginTimerManagerImplementation : public PluginTimerManager
     Q_OBJECT
 
     friend class HardwareManagerImplementation;
+    friend class PluginTimerImplementation;
 
 public:
     explicit PluginTimerManagerImplementation(QObject *parent = nullptr);
@@ -91,6 +108,22 @@ public:
 
 private:
     QList<QPointer<PluginTimerImplementation> > m_timers;
+    // Timers with someone listening to currentTickChanged(), updated once per second
+    QList<QPointer<PluginTimerImplementation> > m_observedTimers;
+
+    // Hashed timer wheel, a timer sits in the bucket of its due slot modulo the wheel size
+    QVector<QList<QPointer<PluginTimerImplementation> > > m_wheel;
+    QTimer *m_wheelTimer = nullptr;
+    QElapsedTimer m_clock;
+    qint64 m_processedSlot = 0;
+    // The clock stands still while the resource is disabled
+    qint64 m_disabledSince = 0;
+    qint64 m_disabledTime = 0;
+
+    qint64 clockSlot() const;
+    void schedule(PluginTimerImplementation *timer, qint64 dueSlot);
+    void unschedule(PluginTimerImplementation *timer);
+    void scheduleWakeUp();
     void timeTick();
 
 protected:
@@ -29,6 +29,35 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "radio433transmitter.h"
+#include "loggingcategories.h"
+
+#include <time.h>
+#include <sched.h>
+#include <errno.h>
+
+// Sleeping is only accurate to the scheduler latency, the last part before every edge is spent spinning
+static const qint64 spinNanoSeconds = 80000;
+
+static qint64 monotonicNanoSeconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<qint64>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+static void waitUntil(qint64 deadline)
+{
+    qint64 wakeup = deadline - spinNanoSeconds;
+    if (wakeup > monotonicNanoSeconds()) {
+        struct timespec time;
+        time.tv_sec = wakeup / 1000000000;
+        time.tv_nsec = wakeup % 1000000000;
+        // Absolute deadline, an interrupted or late sleep does not shift the following edges
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, nullptr) == EINTR) { }
+    }
+
+    while (monotonicNanoSeconds() < deadline) { }
+}
 
 namespace nymeaserver {
 
@@ -41,7 +70,7 @@ Radio433Trasmitter::~Radio433Trasmitter()
 {
     quit();
     wait();
-    deleteLater();
+    delete m_gpio;
 }
 
 bool Radio433Trasmitter::startTransmitter()
@@ -56,6 +85,13 @@ bool Radio433Trasmitter::available()
 
 void Radio433Trasmitter::run()
 {
+    // A preempted edge corrupts the whole frame, run with realtime priority if we are allowed to
+    struct sched_param param;
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+    if (sched_setscheduler(0, SCHED_FIFO, &param) < 0) {
+        qCDebug(dcHardware()) << "Could not enable realtime scheduling for the 433 MHz transmitter";
+    }
+
     QList<int> rawData;
 
     m_queueMutex.lock();
@@ -64,22 +100,39 @@ void Radio433Trasmitter::run()
         rawData = m_rawDataQueue.dequeue();
         m_queueMutex.unlock();
 
-        m_gpio->setValue(Gpio::ValueLow);
-        int flag=1;
+        m_allowSendingMutex.lock();
+        bool allowed = m_allowSending;
+        m_allowSendingMutex.unlock();
 
-        foreach (int delay, rawData) {
-            // 1 = High, 0 = Low
-            int value = flag %2;
-            m_gpio->setValue((Gpio::Value)value);
-            flag++;
-            usleep(delay);
+        if (allowed) {
+            transmit(rawData);
+        } else {
+            qCWarning(dcHardware()) << "433 MHz transmitter is blocked, dropping" << rawData.count() << "timings";
         }
 
-        m_gpio->setValue(Gpio::ValueLow);
+        m_queueMutex.lock();
     }
     m_queueMutex.unlock();
 }
 
+void Radio433Trasmitter::transmit(const QList<int> &timings)
+{
+    m_gpio->setValue(false);
+
+    // Every edge gets scheduled relative to the start of the frame instead of the previous edge,
+    // the time spent setting the value and waking up does not accumulate over the frame.
+    qint64 deadline = monotonicNanoSeconds();
+    bool value = true;
+    foreach (int delay, timings) {
+        m_gpio->setValue(value);
+        value = !value;
+        deadline += static_cast<qint64>(delay) * 1000;
+        waitUntil(deadline);
+    }
+
+    m_gpio->setValue(false);
+}
+
 void Radio433Trasmitter::allowSending(bool sending)
 {
     m_allowSendingMutex.lock();
@@ -89,9 +142,11 @@ void Radio433Trasmitter::allowSending(bool sending)
 
 bool Radio433Trasmitter::setUpGpio()
 {
-    m_gpio = new Gpio(m_gpioPin, this);
+    if (!m_gpio) {
+        m_gpio = new GpioChipLine("gpiochip0", m_gpioPin);
+    }
 
-    if(!m_gpio->exportGpio() || !m_gpio->setDirection(Gpio::DirectionOutput) || !m_gpio->setValue(Gpio::ValueLow)){
+    if(!m_gpio->requestOutput(false, "nymea-radio433")){
         m_available = false;
         return false;
     }
@@ -101,6 +156,11 @@ bool Radio433Trasmitter::setUpGpio()
 
 void Radio433Trasmitter::sendData(int delay, QList<int> rawData, int repetitions)
 {
+    if (!m_available) {
+        qCWarning(dcHardware()) << "433 MHz transmitter GPIO not available, dropping" << rawData.count() << "timings";
+        return;
+    }
+
     QList<int> timings;
     for (int i = 0; i < repetitions; i++) {
         foreach (int data, rawData) {
@@ -38,7 +38,7 @@
 #include <QDebug>
 
 #include "libnymea.h"
-#include "gpio.h"
+#include "hardware/gpiochipline.h"
 
 namespace nymeaserver {
 
@@ -55,24 +55,25 @@ public:
     void sendData(int delay, QList<int> rawData, int repetitions);
 
 protected:
-    void run();
+    void run() override;
 
 private:
     int m_gpioPin;
-    Gpio *m_gpio;
+    GpioChipLine *m_gpio = nullptr;
 
     QMutex m_mutex;
     bool m_enabled;
 
     QMutex m_allowSendingMutex;
-    bool m_allowSending;
+    bool m_allowSending = true;
 
     QMutex m_queueMutex;
     QQueue<QList<int> > m_rawDataQueue;
 
-    bool m_available;
+    bool m_available = false;
 
     bool setUpGpio();
+    void transmit(const QList<int> &timings);
 
 signals:
 
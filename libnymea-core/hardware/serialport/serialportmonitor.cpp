@@ -98,37 +98,32 @@ SerialPortMonitor::SerialPortMonitor(QObject *parent) : QObject(parent)
 
         QString actionString = QString::fromLatin1(udev_device_get_action(device));
         QString systemPath = QString::fromLatin1(udev_device_get_property_value(device,"DEVNAME"));
-        QString manufacturerString = QString::fromLatin1(udev_device_get_property_value(device,"ID_VENDOR_ENC"));
-        QString descriptionString = QString::fromLatin1(udev_device_get_property_value(device,"ID_MODEL_ENC"));
+        QString manufacturerString = udevProperty(device, "ID_VENDOR_FROM_DATABASE", "ID_VENDOR");
+        QString descriptionString = udevProperty(device, "ID_MODEL_FROM_DATABASE", "ID_MODEL");
         QString serialNumberString = QString::fromLatin1(udev_device_get_property_value(device, "ID_SERIAL_SHORT"));
 
+        // Like QSerialPortInfo, skip virtual terminals which have no parent device with a driver
+        udev_device *parentDevice = udev_device_get_parent(device);
+        bool hasDriver = parentDevice && udev_device_get_driver(parentDevice);
+
         // Clean udev device
         udev_device_unref(device);
 
         // Make sure we know the action
-        if (actionString.isEmpty())
+        if (actionString.isEmpty() || systemPath.isEmpty())
             return;
 
         if (actionString == "add") {
             qCDebug(dcSerialPortMonitor()) << "[+]" << systemPath << serialNumberString << manufacturerString << descriptionString;
-            if (!m_serialPorts.contains(systemPath)) {
-                // Get the serial port info and add it internally
-                foreach (const QSerialPortInfo &serialPortInfo, QSerialPortInfo::availablePorts()) {
-                    if (serialPortInfo.systemLocation() == systemPath) {
-                        addSerialPortInternally(SerialPort(serialPortInfo));
-                    }
-                }
-
+            // The event carries all information, no need to enumerate all ports again
+            if (hasDriver && !m_serialPorts.contains(systemPath)) {
+                addSerialPortInternally(SerialPort(systemPath, manufacturerString, descriptionString, serialNumberString));
             }
         }
 
         if (actionString == "remove") {
             qCDebug(dcSerialPortMonitor()) << "[-]" << systemPath << serialNumberString << manufacturerString << descriptionString;
-            if (m_serialPorts.contains(systemPath)) {
-                SerialPort serialPort = m_serialPorts.take(systemPath);
-                qCDebug(dcSerialPortMonitor()) << "Removed" << serialPort.systemLocation();
-                emit serialPortRemoved(serialPort);
-            }
+            removeSerialPortInternally(systemPath);
         }
     });
 
@@ -138,30 +133,16 @@ SerialPortMonitor::SerialPortMonitor(QObject *parent) : QObject(parent)
     }
     m_notifier->setEnabled(true);
 #else
-    m_timer = new QTimer(this);
-    m_timer->setInterval(5000);
-    m_timer->setSingleShot(false);
-    connect(m_timer, &QTimer::timeout, this, [=](){
-        QStringList availablePorts;
-        // Add a new adapter if not in the list already
-        foreach (const QSerialPortInfo &serialPortInfo, QSerialPortInfo::availablePorts()) {
-            availablePorts.append(serialPortInfo.systemLocation());
-            if (!m_serialPorts.keys().contains(serialPortInfo.systemLocation())) {
-                qCDebug(dcSerialPortMonitor()) << "[+]" << serialPortInfo.systemLocation() << serialPortInfo.manufacturer() << serialPortInfo.description();
-                addSerialPortInternally(SerialPort(serialPortInfo));
-            }
-        }
-        // Remove adapters no longer available
-        foreach (const QString &systemLocation, m_serialPorts.keys()) {
-            if (!availablePorts.contains(systemLocation)) {
-                SerialPort serialPortInfo = m_serialPorts.take(systemLocation);
-                qCDebug(dcSerialPortMonitor()) << "[-]" << serialPortInfo.systemLocation() << serialPortInfo.manufacturer() << serialPortInfo.description();
-                emit serialPortRemoved(serialPortInfo);
-            }
-        }
+    // Without udev, rescan only when device nodes appear or disappear in /dev
+    m_rescanTimer = new QTimer(this);
+    m_rescanTimer->setInterval(500);
+    m_rescanTimer->setSingleShot(true);
+    connect(m_rescanTimer, &QTimer::timeout, this, &SerialPortMonitor::rescan);
+
+    m_devWatcher = new QFileSystemWatcher(QStringList() << "/dev", this);
+    connect(m_devWatcher, &QFileSystemWatcher::directoryChanged, m_rescanTimer, [this](){
+        m_rescanTimer->start();
     });
-    m_timer->start();
-
 #endif
 }
 
@@ -172,18 +153,89 @@ SerialPorts SerialPortMonitor::serialPorts() const
 
 bool SerialPortMonitor::serialPortAvailable(const QString &systemLocation) const
 {
-    return m_serialPorts.keys().contains(systemLocation);
+    return m_serialPorts.contains(systemLocation);
+}
+
+SerialPort SerialPortMonitor::serialPort(const QString &systemLocation) const
+{
+    return m_serialPorts.value(systemLocation);
+}
+
+void SerialPortMonitor::watchSerialPort(const QString &systemLocation, QObject *context, SerialPortCallback callback)
+{
+    Watcher watcher;
+    watcher.context = context;
+    watcher.callback = callback;
+    m_watchers.insert(systemLocation, watcher);
 }
 
 void SerialPortMonitor::addSerialPortInternally(const SerialPort &serialPort)
 {
-    if (m_serialPorts.keys().contains(serialPort.systemLocation())) {
+    if (m_serialPorts.contains(serialPort.systemLocation())) {
         qCWarning(dcSerialPortMonitor()) << "Tried to add serial port but the port has alrady been added.";
         return;
     }
 
     m_serialPorts.insert(serialPort.systemLocation(), serialPort);
     emit serialPortAdded(serialPort);
+    notifyWatchers(serialPort, true);
+}
+
+void SerialPortMonitor::removeSerialPortInternally(const QString &systemLocation)
+{
+    if (!m_serialPorts.contains(systemLocation))
+        return;
+
+    SerialPort serialPort = m_serialPorts.take(systemLocation);
+    qCDebug(dcSerialPortMonitor()) << "Removed" << serialPort.systemLocation();
+    emit serialPortRemoved(serialPort);
+    notifyWatchers(serialPort, false);
 }
 
+void SerialPortMonitor::notifyWatchers(const SerialPort &serialPort, bool available)
+{
+    QMultiHash<QString, Watcher>::iterator it = m_watchers.find(serialPort.systemLocation());
+    while (it != m_watchers.end() && it.key() == serialPort.systemLocation()) {
+        if (it->context.isNull()) {
+            it = m_watchers.erase(it);
+            continue;
+        }
+        // Copy, the callback might add new watchers
+        SerialPortCallback callback = it->callback;
+        ++it;
+        callback(serialPort, available);
+    }
+}
+
+#ifdef WITH_UDEV
+QString SerialPortMonitor::udevProperty(udev_device *device, const char *property, const char *fallbackProperty)
+{
+    QString value = QString::fromLatin1(udev_device_get_property_value(device, property));
+    if (value.isEmpty()) {
+        value = QString::fromLatin1(udev_device_get_property_value(device, fallbackProperty)).replace('_', ' ');
+    }
+    return value;
+}
+#else
+void SerialPortMonitor::rescan()
+{
+    QStringList availablePorts;
+    // Add a new adapter if not in the list already
+    foreach (const QSerialPortInfo &serialPortInfo, QSerialPortInfo::availablePorts()) {
+        availablePorts.append(serialPortInfo.systemLocation());
+        if (!m_serialPorts.contains(serialPortInfo.systemLocation())) {
+            qCDebug(dcSerialPortMonitor()) << "[+]" << serialPortInfo.systemLocation() << serialPortInfo.manufacturer() << serialPortInfo.description();
+            addSerialPortInternally(SerialPort(serialPortInfo));
+        }
+    }
+    // Remove adapters no longer available
+    foreach (const QString &systemLocation, m_serialPorts.keys()) {
+        if (!availablePorts.contains(systemLocation)) {
+            qCDebug(dcSerialPortMonitor()) << "[-]" << systemLocation;
+            removeSerialPortInternally(systemLocation);
+        }
+    }
+}
+#endif
+
 }
@@ -33,19 +33,24 @@
 
 #include <QObject>
 #include <QHash>
+#include <QPointer>
 #include <QVariant>
 #include <QSerialPortInfo>
 
+#include <functional>
+
 #ifdef WITH_UDEV
 #include <QSocketNotifier>
 #include <libudev.h>
 #else
 #include <QTimer>
+#include <QFileSystemWatcher>
 #endif
 
 namespace nymeaserver {
 
-class SerialPort : public QSerialPortInfo {
+// Cached metadata of a serial port, port information is only read from the system when a port appears
+class SerialPort {
     Q_GADGET
     Q_PROPERTY(QString systemLocation READ systemLocation)
     Q_PROPERTY(QString manufacturer READ manufacturer)
@@ -82,9 +87,28 @@ public:
     };
     Q_ENUM(SerialPortStopBits)
 
-    SerialPort() : QSerialPortInfo() { };
-    explicit SerialPort(const QSerialPortInfo &other) : QSerialPortInfo(other) { };
+    SerialPort() = default;
+    explicit SerialPort(const QSerialPortInfo &other) :
+        m_systemLocation(other.systemLocation()),
+        m_manufacturer(other.manufacturer()),
+        m_description(other.description()),
+        m_serialNumber(other.serialNumber()) { };
+    SerialPort(const QString &systemLocation, const QString &manufacturer, const QString &description, const QString &serialNumber) :
+        m_systemLocation(systemLocation),
+        m_manufacturer(manufacturer),
+        m_description(description),
+        m_serialNumber(serialNumber) { };
+
+    inline QString systemLocation() const { return m_systemLocation; };
+    inline QString manufacturer() const { return m_manufacturer; };
+    inline QString description() const { return m_description; };
+    inline QString serialNumber() const { return m_serialNumber; };
 
+private:
+    QString m_systemLocation;
+    QString m_manufacturer;
+    QString m_description;
+    QString m_serialNumber;
 };
 
 class SerialPorts : public QList<SerialPort>
@@ -113,26 +137,46 @@ class SerialPortMonitor : public QObject
 {
     Q_OBJECT
 public:
+    typedef std::function<void(const SerialPort &serialPort, bool available)> SerialPortCallback;
+
     explicit SerialPortMonitor(QObject *parent = nullptr);
 
     SerialPorts serialPorts() const;
     bool serialPortAvailable(const QString &systemLocation) const;
+    SerialPort serialPort(const QString &systemLocation) const;
+
+    // Calls the callback whenever the port at systemLocation appears or disappears, as long as context exists
+    void watchSerialPort(const QString &systemLocation, QObject *context, SerialPortCallback callback);
 
 signals:
     void serialPortAdded(const SerialPort &serialPort);
     void serialPortRemoved(const SerialPort &serialPort);
 
 private:
+    class Watcher {
+    public:
+        QPointer<QObject> context;
+        SerialPortCallback callback;
+    };
+
     QHash<QString, SerialPort> m_serialPorts;
+    QMultiHash<QString, Watcher> m_watchers;
 
     void addSerialPortInternally(const SerialPort &serialPort);
+    void removeSerialPortInternally(const QString &systemLocation);
+    void notifyWatchers(const SerialPort &serialPort, bool available);
 
 #ifdef WITH_UDEV
     struct udev *m_udev = nullptr;
     struct udev_monitor *m_monitor = nullptr;
     QSocketNotifier *m_notifier = nullptr;
+
+    static QString udevProperty(udev_device *device, const char *property, const char *fallbackProperty);
 #else
-    QTimer *m_timer = nullptr;
+    QFileSystemWatcher *m_devWatcher = nullptr;
+    QTimer *m_rescanTimer = nullptr;
+
+    void rescan();
 #endif
 
 };
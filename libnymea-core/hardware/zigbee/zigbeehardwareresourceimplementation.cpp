@@ -50,6 +50,10 @@ ZigbeeHardwareResourceImplementation::ZigbeeHardwareResourceImplementation(Zigbe
     connect(m_zigbeeManager, &ZigbeeManager::nodeAdded, this, &ZigbeeHardwareResourceImplementation::onZigbeeNodeAdded);
     connect(m_zigbeeManager, &ZigbeeManager::nodeRemoved, this, &ZigbeeHardwareResourceImplementation::onZigbeeNodeRemoved);
     connect(m_zigbeeManager, &ZigbeeManager::availableChanged, this, &ZigbeeHardwareResourceImplementation::onZigbeeAvailableChanged);
+
+    m_reportTimer.setInterval(50);
+    m_reportTimer.setSingleShot(true);
+    connect(&m_reportTimer, &QTimer::timeout, this, &ZigbeeHardwareResourceImplementation::dispatchAttributeReports);
 }
 
 bool ZigbeeHardwareResourceImplementation::available() const
@@ -93,7 +97,7 @@ ZigbeeNode *ZigbeeHardwareResourceImplementation::claimNode(ZigbeeHandler *handl
         return nullptr;
     }
 
-    m_nodeHandlers[node] = handler;
+    setNodeHandler(node, handler);
     return node;
 }
 
@@ -231,7 +235,7 @@ void ZigbeeHardwareResourceImplementation::onZigbeeNodeAdded(const QUuid &networ
     foreach (ZigbeeHandler *tmp, m_handlers) {
         if (tmp->handleNode(node, networkUuid)) {
             handler = tmp;
-            m_nodeHandlers.insert(node, handler);
+            setNodeHandler(node, handler);
             qCDebug(dcZigbeeResource()) << "Node" << node << "taken by handler" << handler->name();
             break;
         }
@@ -246,10 +250,70 @@ void ZigbeeHardwareResourceImplementation::onZigbeeNodeRemoved(const QUuid &netw
 {
     qCDebug(dcZigbeeResource()) << node << "left the network" << m_zigbeeManager->zigbeeNetworks().value(networkUuid);
 
+    m_pendingReports.remove(node);
+    m_reportingNodes.remove(node);
+    disconnect(node, &ZigbeeNode::endpointClusterAttributeChanged, this, nullptr);
+
     ZigbeeHandler *handler = m_nodeHandlers.value(node);
     if (handler) {
         handler->handleRemoveNode(node, networkUuid);
     }
 }
 
+void ZigbeeHardwareResourceImplementation::dispatchAttributeReports()
+{
+    QHash<ZigbeeNode*, QList<ZigbeeHandler::AttributeReport>> pendingReports = m_pendingReports;
+    m_pendingReports.clear();
+
+    foreach (ZigbeeNode *node, pendingReports.keys()) {
+        ZigbeeHandler *handler = m_nodeHandlers.value(node);
+        if (handler) {
+            handler->handleAttributeReports(node, pendingReports.value(node));
+        }
+    }
+}
+
+void ZigbeeHardwareResourceImplementation::setNodeHandler(ZigbeeNode *node, ZigbeeHandler *handler)
+{
+    m_nodeHandlers[node] = handler;
+
+    if (m_reportingNodes.contains(node)) {
+        return;
+    }
+    m_reportingNodes.insert(node);
+    connect(node, &ZigbeeNode::endpointClusterAttributeChanged, this, [this, node](ZigbeeNodeEndpoint *endpoint, ZigbeeCluster *cluster, const ZigbeeClusterAttribute &attribute){
+        queueAttributeReport(node, endpoint, cluster, attribute);
+    });
+    connect(node, &ZigbeeNode::destroyed, this, [this, node](){
+        m_pendingReports.remove(node);
+        m_reportingNodes.remove(node);
+        m_nodeHandlers.remove(node);
+    });
+}
+
+void ZigbeeHardwareResourceImplementation::queueAttributeReport(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint, ZigbeeCluster *cluster, const ZigbeeClusterAttribute &attribute)
+{
+    QList<ZigbeeHandler::AttributeReport> &reports = m_pendingReports[node];
+
+    // Only the latest value of an attribute is of interest
+    for (int i = 0; i < reports.count(); i++) {
+        if (reports.at(i).endpointId == endpoint->endpointId()
+                && reports.at(i).clusterId == cluster->clusterId()
+                && reports.at(i).attribute.id() == attribute.id()) {
+            reports[i].attribute = attribute;
+            return;
+        }
+    }
+
+    ZigbeeHandler::AttributeReport report;
+    report.endpointId = endpoint->endpointId();
+    report.clusterId = cluster->clusterId();
+    report.attribute = attribute;
+    reports.append(report);
+
+    if (!m_reportTimer.isActive()) {
+        m_reportTimer.start();
+    }
+}
+
 }
@@ -32,9 +32,12 @@
 #define ZIGBEEHARDWARERESOURCEIMPLEMENTATION_H
 
 #include <QObject>
+#include <QTimer>
+#include <QSet>
 
 #include "zigbee/zigbeemanager.h"
 #include "hardware/zigbee/zigbeehardwareresource.h"
+#include "hardware/zigbee/zigbeehandler.h"
 
 namespace nymeaserver {
 
@@ -70,6 +73,7 @@ private slots:
     void onZigbeeNetworkChanged(ZigbeeNetwork *network);
     void onZigbeeNodeAdded(const QUuid &networkUuid, ZigbeeNode *node);
     void onZigbeeNodeRemoved(const QUuid &networkUuid, ZigbeeNode *node);
+    void dispatchAttributeReports();
 
 private:
     bool m_available = false;
@@ -81,6 +85,14 @@ private:
     bool m_thingsLoaded = false;
     QHash<ZigbeeNode*, ZigbeeHandler*> m_nodeHandlers;
 
+    // Attribute reports of handled nodes, collected and dispatched to the handlers in batches
+    QSet<ZigbeeNode*> m_reportingNodes;
+    QHash<ZigbeeNode*, QList<ZigbeeHandler::AttributeReport>> m_pendingReports;
+    QTimer m_reportTimer;
+
+    void setNodeHandler(ZigbeeNode *node, ZigbeeHandler *handler);
+    void queueAttributeReport(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint, ZigbeeCluster *cluster, const ZigbeeClusterAttribute &attribute);
+
 };
 
 }
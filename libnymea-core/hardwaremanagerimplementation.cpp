@@ -38,6 +38,8 @@
 #include "hardware/plugintimermanagerimplementation.h"
 #include "hardware/network/upnp/upnpdiscoveryimplementation.h"
 #include "hardware/network/networkaccessmanagerimpl.h"
+#include "hardware/network/coaphardwareresourceimplementation.h"
+#include "hardware/network/zeroconf/sharedzeroconfcontroller.h"
 #include "hardware/radio433/radio433brennenstuhl.h"
 #include "hardware/bluetoothlowenergy/bluetoothlowenergymanagerimplementation.h"
 #include "hardware/network/mqtt/mqttproviderimplementation.h"
@@ -81,6 +83,12 @@ HardwareManagerImplementation::HardwareManagerImplementation(Platform *platform,
 
     m_networkDeviceDiscovery = new NetworkDeviceDiscovery(this);
 
+    // CoAP client shared by all plugins
+    m_coapResource = new CoapHardwareResourceImplementation(this);
+
+    // ZeroConf browsers shared by all plugins
+    m_zeroConfController = new SharedZeroConfController(m_platform->zeroConfController(), this);
+
     // Enable all the resources
     setResourceEnabled(m_pluginTimerManager, true);
     setResourceEnabled(m_radio433, true);
@@ -97,6 +105,9 @@ HardwareManagerImplementation::HardwareManagerImplementation(Platform *platform,
     if (m_bluetoothLowEnergyManager->available())
         setResourceEnabled(m_bluetoothLowEnergyManager, true);
 
+    if (m_coapResource->available())
+        setResourceEnabled(m_coapResource, true);
+
     m_mqttProvider = new MqttProviderImplementation(mqttBroker, this);
     qCDebug(dcHardware()) << "Hardware manager initialized successfully";
 }
@@ -128,7 +139,7 @@ UpnpDiscovery *HardwareManagerImplementation::upnpDiscovery()
 
 PlatformZeroConfController *HardwareManagerImplementation::zeroConfController()
 {
-    return m_platform->zeroConfController();
+    return m_zeroConfController;
 }
 
 BluetoothLowEnergyManager *HardwareManagerImplementation::bluetoothLowEnergyManager()
@@ -161,6 +172,11 @@ NetworkDeviceDiscovery *HardwareManagerImplementation::networkDeviceDiscovery()
     return m_networkDeviceDiscovery;
 }
 
+CoapHardwareResource *HardwareManagerImplementation::coapResource()
+{
+    return m_coapResource;
+}
+
 void HardwareManagerImplementation::thingsLoaded()
 {
     m_zigbeeResource->thingsLoaded();
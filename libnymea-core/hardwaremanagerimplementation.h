@@ -45,6 +45,7 @@ class ZigbeeManager;
 class ZigbeeHardwareResourceImplementation;
 class ModbusRtuManager;
 class ModbusRtuHardwareResourceImplementation;
+class SharedZeroConfController;
 
 class HardwareManagerImplementation : public HardwareManager
 {
@@ -65,6 +66,7 @@ public:
     ZigbeeHardwareResource *zigbeeResource() override;
     ModbusRtuHardwareResource *modbusRtuResource() override;
     NetworkDeviceDiscovery *networkDeviceDiscovery() override;
+    CoapHardwareResource *coapResource() override;
 
 public slots:
     void thingsLoaded();
@@ -85,6 +87,8 @@ private:
     ZigbeeHardwareResourceImplementation *m_zigbeeResource = nullptr;
     ModbusRtuHardwareResourceImplementation *m_modbusRtuResource = nullptr;
     NetworkDeviceDiscovery *m_networkDeviceDiscovery = nullptr;
+    CoapHardwareResource *m_coapResource = nullptr;
+    SharedZeroConfController *m_zeroConfController = nullptr;
 
 };
 
@@ -0,0 +1,181 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class BrowserCache
+    \brief Keeps the browser items plugins returned for a thing, until they expire or the plugin invalidates them.
+
+    Listings and item details are cached per thing, item id and locale, for as long as the plugin allowed with
+    BrowseResult::setCacheTimeout() or BrowserItemResult::setCacheTimeout(). Invalidating an item drops its listing
+    and its details in all locales. When the cache is full, expired entries are dropped first, then the ones
+    expiring next.
+*/
+
+#include "browsercache.h"
+
+BrowserCache::BrowserCache(int maxEntries):
+    m_maxEntries(maxEntries)
+{
+    m_clock.start();
+}
+
+/*! Looks up a cached listing or details, depending on \a kind, and copies it to \a items. Returns false if
+    there is none or it expired. */
+bool BrowserCache::lookup(BrowserCache::Kind kind, const ThingId &thingId, const QString &itemId, const QLocale &locale, BrowserItems *items)
+{
+    QHash<ThingId, ThingEntries>::iterator thingIt = m_entries.find(thingId);
+    if (thingIt == m_entries.end()) {
+        return false;
+    }
+    ThingEntries::iterator it = thingIt->find(key(kind, itemId, locale));
+    if (it == thingIt->end()) {
+        return false;
+    }
+    if (it->expiry <= m_clock.elapsed()) {
+        thingIt->erase(it);
+        m_count--;
+        if (thingIt->isEmpty()) {
+            m_entries.erase(thingIt);
+        }
+        return false;
+    }
+    *items = it->items;
+    return true;
+}
+
+/*! Returns true if there is a listing or details, depending on \a kind, which did not expire yet. */
+bool BrowserCache::contains(BrowserCache::Kind kind, const ThingId &thingId, const QString &itemId, const QLocale &locale)
+{
+    BrowserItems items;
+    return lookup(kind, thingId, itemId, locale, &items);
+}
+
+/*! Caches \a items for \a timeout seconds. */
+void BrowserCache::insert(BrowserCache::Kind kind, const ThingId &thingId, const QString &itemId, const QLocale &locale, const BrowserItems &items, quint32 timeout)
+{
+    if (timeout == 0 || m_maxEntries <= 0) {
+        return;
+    }
+
+    ThingEntries &thingEntries = m_entries[thingId];
+    QString entryKey = key(kind, itemId, locale);
+    if (!thingEntries.contains(entryKey)) {
+        m_count++;
+    }
+    Entry &entry = thingEntries[entryKey];
+    entry.itemId = itemId;
+    entry.items = items;
+    entry.expiry = m_clock.elapsed() + static_cast<qint64>(timeout) * 1000;
+
+    if (m_count > m_maxEntries) {
+        evict();
+    }
+}
+
+/*! Drops the listing and details of \a itemId of the given thing, or everything cached for it if \a itemId is empty. */
+void BrowserCache::invalidate(const ThingId &thingId, const QString &itemId)
+{
+    QHash<ThingId, ThingEntries>::iterator thingIt = m_entries.find(thingId);
+    if (thingIt == m_entries.end()) {
+        return;
+    }
+
+    if (itemId.isEmpty()) {
+        m_count -= thingIt->count();
+        m_entries.erase(thingIt);
+        return;
+    }
+
+    ThingEntries::iterator it = thingIt->begin();
+    while (it != thingIt->end()) {
+        if (it->itemId == itemId) {
+            it = thingIt->erase(it);
+            m_count--;
+        } else {
+            ++it;
+        }
+    }
+    if (thingIt->isEmpty()) {
+        m_entries.erase(thingIt);
+    }
+}
+
+int BrowserCache::count() const
+{
+    return m_count;
+}
+
+QString BrowserCache::key(BrowserCache::Kind kind, const QString &itemId, const QLocale &locale)
+{
+    return QString::number(kind) + ':' + locale.name() + ':' + itemId;
+}
+
+void BrowserCache::evict()
+{
+    qint64 now = m_clock.elapsed();
+    QHash<ThingId, ThingEntries>::iterator thingIt = m_entries.begin();
+    while (thingIt != m_entries.end()) {
+        ThingEntries::iterator it = thingIt->begin();
+        while (it != thingIt->end()) {
+            if (it->expiry <= now) {
+                it = thingIt->erase(it);
+                m_count--;
+            } else {
+                ++it;
+            }
+        }
+        if (thingIt->isEmpty()) {
+            thingIt = m_entries.erase(thingIt);
+        } else {
+            ++thingIt;
+        }
+    }
+
+    while (m_count > m_maxEntries && !m_entries.isEmpty()) {
+        ThingId oldestThingId;
+        QString oldestKey;
+        qint64 oldestExpiry = 0;
+        for (thingIt = m_entries.begin(); thingIt != m_entries.end(); ++thingIt) {
+            for (ThingEntries::const_iterator it = thingIt->constBegin(); it != thingIt->constEnd(); ++it) {
+                if (oldestKey.isEmpty() || it->expiry < oldestExpiry) {
+                    oldestThingId = thingIt.key();
+                    oldestKey = it.key();
+                    oldestExpiry = it->expiry;
+                }
+            }
+        }
+        ThingEntries &thingEntries = m_entries[oldestThingId];
+        thingEntries.remove(oldestKey);
+        m_count--;
+        if (thingEntries.isEmpty()) {
+            m_entries.remove(oldestThingId);
+        }
+    }
+}
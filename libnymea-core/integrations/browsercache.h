@@ -0,0 +1,77 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BROWSERCACHE_H
+#define BROWSERCACHE_H
+
+#include "typeutils.h"
+#include "types/browseritem.h"
+
+#include <QHash>
+#include <QLocale>
+#include <QElapsedTimer>
+
+class BrowserCache
+{
+public:
+    enum Kind {
+        KindItems,
+        KindDetails
+    };
+
+    explicit BrowserCache(int maxEntries = 256);
+
+    bool lookup(Kind kind, const ThingId &thingId, const QString &itemId, const QLocale &locale, BrowserItems *items);
+    bool contains(Kind kind, const ThingId &thingId, const QString &itemId, const QLocale &locale);
+    void insert(Kind kind, const ThingId &thingId, const QString &itemId, const QLocale &locale, const BrowserItems &items, quint32 timeout);
+
+    void invalidate(const ThingId &thingId, const QString &itemId = QString());
+
+    int count() const;
+
+private:
+    class Entry {
+    public:
+        QString itemId;
+        BrowserItems items;
+        qint64 expiry = 0;
+    };
+    typedef QHash<QString, Entry> ThingEntries;
+
+    static QString key(Kind kind, const QString &itemId, const QLocale &locale);
+    void evict();
+
+    int m_maxEntries;
+    int m_count = 0;
+    QElapsedTimer m_clock;
+    QHash<ThingId, ThingEntries> m_entries;
+};
+
+#endif // BROWSERCACHE_H
@@ -0,0 +1,179 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "pluginhostprotocol.h"
+#include "loggingcategories.h"
+
+NYMEA_LOGGING_CATEGORY(dcPluginHost, "PluginHost")
+
+// Messages larger than this are taken for a broken stream
+static const quint32 maxMessageSize = 64 * 1024 * 1024;
+
+QByteArray PluginHostProtocol::encodeStateChange(quint32 handle, int stateIndex, const QVariant &value, const QVariant &minValue, const QVariant &maxValue)
+{
+    bool limits = minValue.isValid() || maxValue.isValid();
+    if (limits) {
+        return encode(handle, static_cast<quint16>(stateIndex), limits, value, minValue, maxValue);
+    }
+    return encode(handle, static_cast<quint16>(stateIndex), limits, value);
+}
+
+bool PluginHostProtocol::decodeStateChange(const QByteArray &record, quint32 *handle, int *stateIndex, QVariant *value, QVariant *minValue, QVariant *maxValue)
+{
+    QDataStream stream(record);
+    stream.setVersion(streamVersion);
+    quint16 index; bool limits;
+    stream >> *handle >> index >> limits >> *value;
+    if (limits) {
+        stream >> *minValue >> *maxValue;
+    }
+    *stateIndex = index;
+    return stream.status() == QDataStream::Ok;
+}
+
+QDataStream &operator<<(QDataStream &stream, const Param &param)
+{
+    stream << param.paramTypeId() << param.value();
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, Param &param)
+{
+    ParamTypeId paramTypeId; QVariant value;
+    stream >> paramTypeId >> value;
+    param = Param(paramTypeId, value);
+    return stream;
+}
+
+// The thing id is not transferred, states are always sent along with their thing
+QDataStream &operator<<(QDataStream &stream, const State &state)
+{
+    stream << state.stateTypeId() << state.value() << state.minValue() << state.maxValue();
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, State &state)
+{
+    StateTypeId stateTypeId; QVariant value; QVariant minValue; QVariant maxValue;
+    stream >> stateTypeId >> value >> minValue >> maxValue;
+    state = State(stateTypeId, state.thingId());
+    state.setValue(value);
+    state.setMinValue(minValue);
+    state.setMaxValue(maxValue);
+    return stream;
+}
+
+QDataStream &operator<<(QDataStream &stream, const ThingDescriptor &descriptor)
+{
+    stream << descriptor.id() << descriptor.thingClassId() << descriptor.thingId() << descriptor.title()
+           << descriptor.description() << descriptor.parentId() << descriptor.params();
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, ThingDescriptor &descriptor)
+{
+    ThingDescriptorId id; ThingClassId thingClassId; ThingId thingId; QString title; QString description; ThingId parentId; ParamList params;
+    stream >> id >> thingClassId >> thingId >> title >> description >> parentId >> params;
+    descriptor = ThingDescriptor(id, thingClassId, title, description, parentId);
+    descriptor.setThingId(thingId);
+    descriptor.setParams(params);
+    return stream;
+}
+
+// Extended properties, like those of media items, are not transferred
+QDataStream &operator<<(QDataStream &stream, const BrowserItem &item)
+{
+    stream << item.id() << item.displayName() << item.description() << item.browsable() << item.executable()
+           << item.disabled() << static_cast<qint32>(item.icon()) << item.thumbnail() << item.actionTypeIds();
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, BrowserItem &item)
+{
+    QString id; QString displayName; QString description; bool browsable; bool executable; bool disabled;
+    qint32 icon; QString thumbnail; QList<ActionTypeId> actionTypeIds;
+    stream >> id >> displayName >> description >> browsable >> executable >> disabled >> icon >> thumbnail >> actionTypeIds;
+    item = BrowserItem(id, displayName, browsable, executable);
+    item.setDescription(description);
+    item.setDisabled(disabled);
+    item.setIcon(static_cast<BrowserItem::BrowserIcon>(icon));
+    item.setThumbnail(thumbnail);
+    item.setActionTypeIds(actionTypeIds);
+    return stream;
+}
+
+/*!
+    \class PluginHostConnection
+    \brief Sends and receives the framed messages of the plugin host protocol on a local socket.
+
+    \ingroup core
+    \inmodule core
+*/
+PluginHostConnection::PluginHostConnection(QLocalSocket *socket, QObject *parent):
+    QObject(parent),
+    m_socket(socket)
+{
+    connect(m_socket, &QLocalSocket::readyRead, this, &PluginHostConnection::onReadyRead);
+    connect(m_socket, &QLocalSocket::disconnected, this, &PluginHostConnection::disconnected);
+}
+
+void PluginHostConnection::send(PluginHostProtocol::Message message, const QByteArray &payload)
+{
+    QByteArray frame;
+    frame.reserve(static_cast<int>(sizeof(quint32)) + 1 + payload.size());
+    QDataStream stream(&frame, QIODevice::WriteOnly);
+    stream << static_cast<quint32>(payload.size() + 1) << static_cast<quint8>(message);
+    frame.append(payload);
+    m_socket->write(frame);
+}
+
+void PluginHostConnection::onReadyRead()
+{
+    m_buffer.append(m_socket->readAll());
+    while (m_buffer.size() >= static_cast<int>(sizeof(quint32)) + 1) {
+        QDataStream stream(m_buffer);
+        quint32 length;
+        stream >> length;
+        if (length == 0 || length > maxMessageSize) {
+            qCWarning(dcPluginHost()) << "Invalid message of" << length << "bytes on the plugin host connection. Closing it.";
+            m_buffer.clear();
+            m_socket->abort();
+            return;
+        }
+        if (m_buffer.size() < static_cast<int>(sizeof(quint32) + length)) {
+            return;
+        }
+        quint8 message;
+        stream >> message;
+        QByteArray payload = m_buffer.mid(sizeof(quint32) + 1, static_cast<int>(length) - 1);
+        m_buffer.remove(0, static_cast<int>(sizeof(quint32) + length));
+        emit messageReceived(static_cast<PluginHostProtocol::Message>(message), payload);
+    }
+}
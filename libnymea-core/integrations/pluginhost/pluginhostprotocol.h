@@ -0,0 +1,152 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef PLUGINHOSTPROTOCOL_H
+#define PLUGINHOSTPROTOCOL_H
+
+#include "typeutils.h"
+#include "types/param.h"
+#include "types/state.h"
+#include "types/browseritem.h"
+#include "integrations/thingdescriptor.h"
+
+#include <QObject>
+#include <QDataStream>
+#include <QLocalSocket>
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(dcPluginHost)
+
+/* Messages exchanged between nymead and a nymea-pluginhost process running one integration plugin.
+
+   On the socket, each message is framed as a quint32 length, the message type and its payload. Payloads
+   are QDataStream encoded. Requests carry an id chosen by the core which is returned in the matching
+   reply. Things are referred to by a handle the core assigns when setting them up.
+*/
+class PluginHostProtocol
+{
+public:
+    enum Message: quint8 {
+        // Host -> core
+        MessageHello = 1,               // pluginId
+        MessageSetupFinished,           // requestId, status, displayMessage
+        MessageActionFinished,          // requestId, status, displayMessage
+        MessageDiscoveryFinished,       // requestId, status, displayMessage, thingDescriptors
+        MessagePairingFinished,         // requestId, status, displayMessage, oAuthUrl
+        MessageBrowseFinished,          // requestId, status, displayMessage, cacheTimeout, items
+        MessageBrowserItemFinished,     // requestId, status, displayMessage, cacheTimeout, item
+        MessageBrowserActionFinished,   // requestId, status, displayMessage
+        MessageBrowserItemActionFinished, // requestId, status, displayMessage
+        MessageStatesAvailable,         // No payload, state changes are waiting in the state channel
+        MessageStateChanged,            // A state change record which didn't fit into the state channel
+        MessageThingNameChanged,        // handle, name
+        MessageThingSettingChanged,     // handle, paramTypeId, value
+        MessageEventTriggered,          // handle, eventTypeId, params
+        MessageAutoThingsAppeared,      // thingDescriptors
+        MessageAutoThingDisappeared,    // thingId
+        MessageConfigValueChanged,      // paramTypeId, value
+        MessageBrowserItemsChanged,     // thingId, itemId
+
+        // Core -> host
+        MessageInit = 64,               // configuration, apiKeys
+        MessageSetConfigValue,          // paramTypeId, value
+        MessageStartMonitoringAutoThings,
+        MessageDiscoverThings,          // requestId, thingClassId, params
+        MessageStartPairing,            // requestId, pairing
+        MessageConfirmPairing,          // requestId, pairing, username, secret
+        MessageSetupThing,              // requestId, handle, thing
+        MessagePostSetupThing,          // handle
+        MessageThingRemoved,            // handle
+        MessageExecuteAction,           // requestId, handle, actionTypeId, params, triggeredBy
+        MessageBrowseThing,             // requestId, handle, itemId, locale
+        MessageBrowserItem,             // requestId, handle, itemId, locale
+        MessageExecuteBrowserItem,      // requestId, handle, itemId
+        MessageExecuteBrowserItemAction, // requestId, handle, itemId, actionTypeId, params
+        MessageAbort,                   // requestId
+        MessageSetThingName,            // handle, name
+        MessageSetThingSetting          // handle, paramTypeId, value
+    };
+
+    static const QDataStream::Version streamVersion = QDataStream::Qt_5_6;
+
+    template <typename... Args>
+    static QByteArray encode(const Args &... args)
+    {
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setVersion(streamVersion);
+        write(stream, args...);
+        return payload;
+    }
+
+    // A state change as it is sent through the state channel, minValue and maxValue are only sent when valid
+    static QByteArray encodeStateChange(quint32 handle, int stateIndex, const QVariant &value, const QVariant &minValue, const QVariant &maxValue);
+    static bool decodeStateChange(const QByteArray &record, quint32 *handle, int *stateIndex, QVariant *value, QVariant *minValue, QVariant *maxValue);
+
+private:
+    static void write(QDataStream &stream) { Q_UNUSED(stream) }
+    template <typename T, typename... Args>
+    static void write(QDataStream &stream, const T &value, const Args &... args)
+    {
+        stream << value;
+        write(stream, args...);
+    }
+};
+
+QDataStream &operator<<(QDataStream &stream, const Param &param);
+QDataStream &operator>>(QDataStream &stream, Param &param);
+QDataStream &operator<<(QDataStream &stream, const State &state);
+QDataStream &operator>>(QDataStream &stream, State &state);
+QDataStream &operator<<(QDataStream &stream, const ThingDescriptor &descriptor);
+QDataStream &operator>>(QDataStream &stream, ThingDescriptor &descriptor);
+QDataStream &operator<<(QDataStream &stream, const BrowserItem &item);
+QDataStream &operator>>(QDataStream &stream, BrowserItem &item);
+
+class PluginHostConnection: public QObject
+{
+    Q_OBJECT
+public:
+    explicit PluginHostConnection(QLocalSocket *socket, QObject *parent = nullptr);
+
+    void send(PluginHostProtocol::Message message, const QByteArray &payload = QByteArray());
+
+signals:
+    void messageReceived(PluginHostProtocol::Message message, const QByteArray &payload);
+    void disconnected();
+
+private slots:
+    void onReadyRead();
+
+private:
+    QLocalSocket *m_socket = nullptr;
+    QByteArray m_buffer;
+};
+
+#endif // PLUGINHOSTPROTOCOL_H
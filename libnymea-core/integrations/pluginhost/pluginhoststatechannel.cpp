@@ -0,0 +1,168 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "pluginhoststatechannel.h"
+
+#include <new>
+#include <cstring>
+
+PluginHostStateChannel::PluginHostStateChannel()
+{
+
+}
+
+PluginHostStateChannel::~PluginHostStateChannel()
+{
+    if (m_memory.isAttached()) {
+        m_memory.detach();
+    }
+}
+
+bool PluginHostStateChannel::create(const QString &key, quint32 capacity)
+{
+    // The capacity must be a power of two for the free running positions to wrap correctly
+    quint32 size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    m_memory.setKey(key);
+    // A segment left over by a crashed instance is released when the last process detaches from it
+    if (m_memory.attach()) {
+        m_memory.detach();
+    }
+    if (!m_memory.create(static_cast<int>(sizeof(Header) + size))) {
+        return false;
+    }
+
+    m_header = new (m_memory.data()) Header;
+    m_header->head.store(0);
+    m_header->tail.store(0);
+    m_header->wakeUpPending.store(0);
+    m_header->capacity = size;
+    m_data = static_cast<char*>(m_memory.data()) + sizeof(Header);
+    return true;
+}
+
+bool PluginHostStateChannel::attach(const QString &key)
+{
+    m_memory.setKey(key);
+    if (!m_memory.attach()) {
+        return false;
+    }
+    m_header = static_cast<Header*>(m_memory.data());
+    m_data = static_cast<char*>(m_memory.data()) + sizeof(Header);
+    return true;
+}
+
+bool PluginHostStateChannel::write(const QByteArray &record, bool *wakeUp)
+{
+    *wakeUp = false;
+    if (!m_header) {
+        return false;
+    }
+
+    quint32 size = static_cast<quint32>(record.size());
+    quint32 head = m_header->head.load(std::memory_order_relaxed);
+    quint32 tail = m_header->tail.load(std::memory_order_acquire);
+    if (m_header->capacity - (head - tail) < sizeof(quint32) + size) {
+        return false;
+    }
+
+    copyIn(head, reinterpret_cast<const char*>(&size), sizeof(quint32));
+    copyIn(head + sizeof(quint32), record.constData(), size);
+    m_header->head.store(head + sizeof(quint32) + size, std::memory_order_release);
+
+    *wakeUp = m_header->wakeUpPending.exchange(1) == 0;
+    return true;
+}
+
+bool PluginHostStateChannel::read(QByteArray *record)
+{
+    if (!m_header) {
+        return false;
+    }
+
+    quint32 tail = m_header->tail.load(std::memory_order_relaxed);
+    quint32 head = m_header->head.load(std::memory_order_acquire);
+    if (head == tail) {
+        return false;
+    }
+
+    quint32 size;
+    copyOut(tail, reinterpret_cast<char*>(&size), sizeof(quint32));
+    if (size > head - tail - sizeof(quint32)) {
+        // Corrupted, drop everything
+        m_header->tail.store(head, std::memory_order_release);
+        return false;
+    }
+    record->resize(static_cast<int>(size));
+    copyOut(tail + sizeof(quint32), record->data(), size);
+    m_header->tail.store(tail + sizeof(quint32) + size, std::memory_order_release);
+    return true;
+}
+
+void PluginHostStateChannel::clearWakeUp()
+{
+    if (m_header) {
+        m_header->wakeUpPending.store(0);
+    }
+}
+
+bool PluginHostStateChannel::isValid() const
+{
+    return m_header != nullptr;
+}
+
+QString PluginHostStateChannel::key() const
+{
+    return m_memory.key();
+}
+
+QString PluginHostStateChannel::errorString() const
+{
+    return m_memory.errorString();
+}
+
+void PluginHostStateChannel::copyIn(quint32 position, const char *data, quint32 size)
+{
+    quint32 offset = position & (m_header->capacity - 1);
+    quint32 first = qMin(size, m_header->capacity - offset);
+    std::memcpy(m_data + offset, data, first);
+    std::memcpy(m_data, data + first, size - first);
+}
+
+void PluginHostStateChannel::copyOut(quint32 position, char *data, quint32 size) const
+{
+    quint32 offset = position & (m_header->capacity - 1);
+    quint32 first = qMin(size, m_header->capacity - offset);
+    std::memcpy(data, m_data + offset, first);
+    std::memcpy(data + first, m_data, size - first);
+}
@@ -0,0 +1,78 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef PLUGINHOSTSTATECHANNEL_H
+#define PLUGINHOSTSTATECHANNEL_H
+
+#include <QSharedMemory>
+#include <QByteArray>
+
+#include <atomic>
+
+/* A single producer, single consumer ring buffer in shared memory carrying state changes from a plugin host
+   process to the core. Writing never blocks, if a record doesn't fit, the writer sends it on the socket instead.
+   The writer only wakes up the reader (with a socket message) when it hasn't been woken up since it last drained
+   the ring, so a burst of state changes costs one socket message. */
+class PluginHostStateChannel
+{
+public:
+    PluginHostStateChannel();
+    ~PluginHostStateChannel();
+
+    // Core side
+    bool create(const QString &key, quint32 capacity = 256 * 1024);
+    bool read(QByteArray *record);
+    void clearWakeUp();
+
+    // Host side
+    bool attach(const QString &key);
+    bool write(const QByteArray &record, bool *wakeUp);
+
+    bool isValid() const;
+    QString key() const;
+    QString errorString() const;
+
+private:
+    struct Header {
+        std::atomic<quint32> head;
+        std::atomic<quint32> tail;
+        std::atomic<quint32> wakeUpPending;
+        quint32 capacity;
+    };
+
+    void copyIn(quint32 position, const char *data, quint32 size);
+    void copyOut(quint32 position, char *data, quint32 size) const;
+
+    QSharedMemory m_memory;
+    Header *m_header = nullptr;
+    char *m_data = nullptr;
+};
+
+#endif // PLUGINHOSTSTATECHANNEL_H
@@ -0,0 +1,624 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "pluginhostintegrationplugin.h"
+#include "loggingcategories.h"
+
+#include <QCoreApplication>
+#include <QStandardPaths>
+#include <QLocalSocket>
+#include <QFileInfo>
+#include <QDir>
+#include <QUuid>
+
+typedef PluginHostProtocol P;
+
+/*!
+    \class PluginHostIntegrationPlugin
+    \brief Runs a C++ integration plugin in a nymea-pluginhost process.
+
+    \ingroup core
+    \inmodule core
+
+    Plugins listed in the PluginHost/plugins setting of nymead.conf (plugin names, or "*" for all of them) are not
+    loaded into nymead. Instead, this proxy starts a nymea-pluginhost process which loads
+    the plugin and is connected to it by a local socket. A crashing or hanging plugin takes down only its host,
+    which is restarted with an increasing delay and gets the things back which were set up before.
+
+    State changes, which make up most of the traffic, are passed through a ring buffer in shared memory. The host
+    only sends a message on the socket when the ring was empty before, so bursts of state changes are read in one go.
+
+    The PluginHost/command setting can hold a command the host is started with, for example to move each plugin
+    into a cgroup of its own or to change its priority: "systemd-run --scope --slice=nymea-%1 nice -n 10".
+    A "%1" in the command is replaced by the plugin name.
+*/
+
+PluginHostIntegrationPlugin::PluginHostIntegrationPlugin(const QString &pluginFile, const PluginMetadata &metadata, const QString &hostCommand, QObject *parent):
+    IntegrationPlugin(parent),
+    m_pluginFile(pluginFile),
+    m_hostCommand(hostCommand)
+{
+    setMetaData(metadata);
+
+    m_restartTimer.setSingleShot(true);
+    connect(&m_restartTimer, &QTimer::timeout, this, &PluginHostIntegrationPlugin::startHost);
+
+    connect(this, &IntegrationPlugin::configValueChanged, this, [this](const ParamTypeId &paramTypeId, const QVariant &value){
+        if (!m_applyingHostConfig) {
+            send(P::MessageSetConfigValue, P::encode(paramTypeId, value));
+        }
+    });
+}
+
+PluginHostIntegrationPlugin::~PluginHostIntegrationPlugin()
+{
+    m_stopping = true;
+    if (m_process) {
+        m_process->disconnect(this);
+        m_process->terminate();
+        if (!m_process->waitForFinished(3000)) {
+            qCWarning(dcPluginHost()) << "Plugin host for" << pluginName() << "did not quit. Killing it.";
+            m_process->kill();
+            m_process->waitForFinished(1000);
+        }
+    }
+}
+
+bool PluginHostIntegrationPlugin::isHosted(const PluginMetadata &metadata, const QStringList &hostedPlugins)
+{
+    return hostedPlugins.contains("*") || hostedPlugins.contains(metadata.pluginName());
+}
+
+qint64 PluginHostIntegrationPlugin::hostProcessId() const
+{
+    return m_process ? m_process->processId() : 0;
+}
+
+void PluginHostIntegrationPlugin::init()
+{
+    QString id = QUuid::createUuid().toString().remove('{').remove('}');
+    if (!m_stateChannel.create("nymea-pluginhost-" + id)) {
+        qCWarning(dcPluginHost()) << "Unable to create the state channel for" << pluginName() << m_stateChannel.errorString() << "State changes will be sent on the socket.";
+    }
+
+    m_server = new QLocalServer(this);
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(m_server, &QLocalServer::newConnection, this, &PluginHostIntegrationPlugin::onNewConnection);
+    if (!m_server->listen("nymea-pluginhost-" + id)) {
+        qCWarning(dcPluginHost()) << "Unable to listen for the plugin host of" << pluginName() << m_server->errorString();
+        return;
+    }
+
+    startHost();
+}
+
+void PluginHostIntegrationPlugin::startMonitoringAutoThings()
+{
+    m_monitoringAutoThings = true;
+    send(P::MessageStartMonitoringAutoThings);
+}
+
+void PluginHostIntegrationPlugin::discoverThings(ThingDiscoveryInfo *info)
+{
+    send(P::MessageDiscoverThings, P::encode(addRequest(info), info->thingClassId(), info->params()));
+}
+
+void PluginHostIntegrationPlugin::startPairing(ThingPairingInfo *info)
+{
+    send(P::MessageStartPairing, P::encode(addRequest(info), info->transactionId(), info->thingClassId(), info->thingId(),
+                                           info->thingName(), info->params(), info->parentId()));
+}
+
+void PluginHostIntegrationPlugin::confirmPairing(ThingPairingInfo *info, const QString &username, const QString &secret)
+{
+    send(P::MessageConfirmPairing, P::encode(addRequest(info), info->transactionId(), info->thingClassId(), info->thingId(),
+                                             info->thingName(), info->params(), info->parentId(), username, secret));
+}
+
+void PluginHostIntegrationPlugin::setupThing(ThingSetupInfo *info)
+{
+    send(P::MessageSetupThing, thingPayload(addRequest(info), info->thing()));
+}
+
+void PluginHostIntegrationPlugin::postSetupThing(Thing *thing)
+{
+    send(P::MessagePostSetupThing, P::encode(thingHandle(thing)));
+}
+
+void PluginHostIntegrationPlugin::thingRemoved(Thing *thing)
+{
+    quint32 handle = m_handles.take(thing);
+    if (handle == 0) {
+        return;
+    }
+    m_things.remove(handle);
+    thing->disconnect(this);
+    send(P::MessageThingRemoved, P::encode(handle));
+}
+
+void PluginHostIntegrationPlugin::executeAction(ThingActionInfo *info)
+{
+    Action action = info->action();
+    send(P::MessageExecuteAction, P::encode(addRequest(info), thingHandle(info->thing()), action.actionTypeId(),
+                                            action.params(), static_cast<qint32>(action.triggeredBy())));
+}
+
+void PluginHostIntegrationPlugin::browseThing(BrowseResult *result)
+{
+    send(P::MessageBrowseThing, P::encode(addRequest(result), thingHandle(result->thing()), result->itemId(), result->locale()));
+}
+
+void PluginHostIntegrationPlugin::browserItem(BrowserItemResult *result)
+{
+    send(P::MessageBrowserItem, P::encode(addRequest(result), thingHandle(result->thing()), result->itemId(), result->locale()));
+}
+
+void PluginHostIntegrationPlugin::executeBrowserItem(BrowserActionInfo *info)
+{
+    send(P::MessageExecuteBrowserItem, P::encode(addRequest(info), thingHandle(info->thing()), info->browserAction().itemId()));
+}
+
+void PluginHostIntegrationPlugin::executeBrowserItemAction(BrowserItemActionInfo *info)
+{
+    BrowserItemAction action = info->browserItemAction();
+    send(P::MessageExecuteBrowserItemAction, P::encode(addRequest(info), thingHandle(info->thing()), action.itemId(),
+                                                       action.actionTypeId(), action.params()));
+}
+
+void PluginHostIntegrationPlugin::onNewConnection()
+{
+    QLocalSocket *socket = m_server->nextPendingConnection();
+    if (m_connection) {
+        qCWarning(dcPluginHost()) << "Rejecting an additional connection to the plugin host of" << pluginName();
+        socket->abort();
+        socket->deleteLater();
+        return;
+    }
+
+    // The connection goes away along with its socket
+    m_connection = new PluginHostConnection(socket, socket);
+    connect(m_connection, &PluginHostConnection::messageReceived, this, &PluginHostIntegrationPlugin::onMessageReceived);
+    connect(m_connection, &PluginHostConnection::disconnected, this, [this, socket](){
+        qCDebug(dcPluginHost()) << "Plugin host of" << pluginName() << "disconnected";
+        m_connection = nullptr;
+        m_ready = false;
+        socket->deleteLater();
+        // A host closing the connection is of no use anymore
+        if (m_process && m_process->state() != QProcess::NotRunning) {
+            m_process->kill();
+        }
+    });
+}
+
+void PluginHostIntegrationPlugin::onMessageReceived(PluginHostProtocol::Message message, const QByteArray &payload)
+{
+    // State changes written before this message was sent must be applied before it
+    if (message == P::MessageStatesAvailable) {
+        m_stateChannel.clearWakeUp();
+    }
+    readStates();
+
+    QDataStream stream(payload);
+    stream.setVersion(P::streamVersion);
+    quint32 requestId = 0;
+    qint32 status = Thing::ThingErrorNoError;
+    QString displayMessage;
+
+    switch (message) {
+    case P::MessageHello: {
+        PluginId pluginId;
+        stream >> pluginId;
+        if (pluginId != this->pluginId()) {
+            qCWarning(dcPluginHost()) << "Plugin host for" << pluginName() << "loaded a different plugin" << pluginId;
+            m_process->kill();
+            return;
+        }
+        qCDebug(dcPluginHost()) << "Plugin host for" << pluginName() << "is ready";
+
+        QVariantMap apiKeys;
+        foreach (const QString &name, metadata().apiKeys()) {
+            ApiKey apiKey = apiKeyStorage()->requestKey(name);
+            QVariantMap properties;
+            foreach (const QString &key, apiKey.keys()) {
+                properties.insert(key, apiKey.data(key));
+            }
+            apiKeys.insert(name, properties);
+        }
+        m_connection->send(P::MessageInit, P::encode(configuration(), apiKeys));
+
+        // Things which were set up in a previous host
+        foreach (Thing *thing, m_things) {
+            if (thing->setupStatus() == Thing::ThingSetupStatusComplete) {
+                m_connection->send(P::MessageSetupThing, thingPayload(0, thing));
+            }
+        }
+        if (m_monitoringAutoThings) {
+            m_connection->send(P::MessageStartMonitoringAutoThings);
+        }
+
+        m_ready = true;
+        while (!m_queuedMessages.isEmpty()) {
+            QPair<P::Message, QByteArray> queued = m_queuedMessages.takeFirst();
+            m_connection->send(queued.first, queued.second);
+        }
+        break;
+    }
+    case P::MessageSetupFinished: {
+        stream >> requestId >> status >> displayMessage;
+        if (requestId == 0) {
+            if (status != Thing::ThingErrorNoError) {
+                qCWarning(dcPluginHost()) << "Setting up a thing again in the restarted plugin host of" << pluginName() << "failed:" << static_cast<Thing::ThingError>(status) << displayMessage;
+            }
+            break;
+        }
+        ThingSetupInfo *info = takeRequest<ThingSetupInfo>(requestId);
+        if (info) {
+            info->finish(static_cast<Thing::ThingError>(status), displayMessage);
+        }
+        break;
+    }
+    case P::MessageActionFinished: {
+        stream >> requestId >> status >> displayMessage;
+        ThingActionInfo *info = takeRequest<ThingActionInfo>(requestId);
+        if (info) {
+            info->finish(static_cast<Thing::ThingError>(status), displayMessage);
+        }
+        break;
+    }
+    case P::MessageDiscoveryFinished: {
+        ThingDescriptors descriptors;
+        stream >> requestId >> status >> displayMessage >> descriptors;
+        ThingDiscoveryInfo *info = takeRequest<ThingDiscoveryInfo>(requestId);
+        if (info) {
+            info->addThingDescriptors(descriptors);
+            info->finish(static_cast<Thing::ThingError>(status), displayMessage);
+        }
+        break;
+    }
+    case P::MessagePairingFinished: {
+        QUrl oAuthUrl;
+        stream >> requestId >> status >> displayMessage >> oAuthUrl;
+        ThingPairingInfo *info = takeRequest<ThingPairingInfo>(requestId);
+        if (info) {
+            info->setOAuthUrl(oAuthUrl);
+            info->finish(static_cast<Thing::ThingError>(status), displayMessage);
+        }
+        break;
+    }
+    case P::MessageBrowseFinished: {
+        quint32 cacheTimeout = 0;
+        BrowserItems items;
+        stream >> requestId >> status >> displayMessage >> cacheTimeout >> items;
+        BrowseResult *result = takeRequest<BrowseResult>(requestId);
+        if (result) {
+            result->addItems(items);
+            result->setCacheTimeout(cacheTimeout);
+            result->finish(static_cast<Thing::ThingError>(status), displayMessage);
+        }
+        break;
+    }
+    case P::MessageBrowserItemFinished: {
+        quint32 cacheTimeout = 0;
+        BrowserItem item;
+        stream >> requestId >> status >> displayMessage >> cacheTimeout >> item;
+        BrowserItemResult *result = takeRequest<BrowserItemResult>(requestId);
+        if (result) {
+            result->setCacheTimeout(cacheTimeout);
+            if (status == Thing::ThingErrorNoError) {
+                result->finish(item);
+            } else {
+                result->finish(static_cast<Thing::ThingError>(status), displayMessage);
+            }
+        }
+        break;
+    }
+    case P::MessageBrowserActionFinished: {
+        stream >> requestId >> status >> displayMessage;
+        BrowserActionInfo *info = takeRequest<BrowserActionInfo>(requestId);
+        if (info) {
+            info->finish(static_cast<Thing::ThingError>(status), displayMessage);
+        }
+        break;
+    }
+    case P::MessageBrowserItemActionFinished: {
+        stream >> requestId >> status >> displayMessage;
+        BrowserItemActionInfo *info = takeRequest<BrowserItemActionInfo>(requestId);
+        if (info) {
+            info->finish(static_cast<Thing::ThingError>(status), displayMessage);
+        }
+        break;
+    }
+    case P::MessageStatesAvailable:
+        // Read above already
+        break;
+    case P::MessageStateChanged:
+        applyStateChange(payload);
+        break;
+    case P::MessageThingNameChanged: {
+        quint32 handle; QString name;
+        stream >> handle >> name;
+        Thing *thing = this->thing(handle);
+        if (thing) {
+            thing->setName(name);
+        }
+        break;
+    }
+    case P::MessageThingSettingChanged: {
+        quint32 handle; ParamTypeId paramTypeId; QVariant value;
+        stream >> handle >> paramTypeId >> value;
+        Thing *thing = this->thing(handle);
+        if (thing) {
+            thing->setSettingValue(paramTypeId, value);
+        }
+        break;
+    }
+    case P::MessageEventTriggered: {
+        quint32 handle; EventTypeId eventTypeId; ParamList params;
+        stream >> handle >> eventTypeId >> params;
+        Thing *thing = this->thing(handle);
+        if (thing) {
+            thing->emitEvent(eventTypeId, params);
+        }
+        break;
+    }
+    case P::MessageAutoThingsAppeared: {
+        ThingDescriptors descriptors;
+        stream >> descriptors;
+        emit autoThingsAppeared(descriptors);
+        break;
+    }
+    case P::MessageAutoThingDisappeared: {
+        ThingId thingId;
+        stream >> thingId;
+        emit autoThingDisappeared(thingId);
+        break;
+    }
+    case P::MessageConfigValueChanged: {
+        ParamTypeId paramTypeId; QVariant value;
+        stream >> paramTypeId >> value;
+        m_applyingHostConfig = true;
+        setConfigValue(paramTypeId, value);
+        m_applyingHostConfig = false;
+        break;
+    }
+    case P::MessageBrowserItemsChanged: {
+        ThingId thingId; QString itemId;
+        stream >> thingId >> itemId;
+        emit browserItemsChanged(thingId, itemId);
+        break;
+    }
+    default:
+        qCWarning(dcPluginHost()) << "Unexpected message" << message << "from the plugin host of" << pluginName();
+        break;
+    }
+}
+
+void PluginHostIntegrationPlugin::onHostFinished()
+{
+    if (!m_process) {
+        return;
+    }
+    qCWarning(dcPluginHost()) << "Plugin host for" << pluginName() << "exited with code" << m_process->exitCode() << m_process->exitStatus();
+    m_process->deleteLater();
+    m_process = nullptr;
+    if (m_connection) {
+        // The connection is owned by its socket
+        m_connection->disconnect(this);
+        m_connection->parent()->deleteLater();
+        m_connection = nullptr;
+    }
+    m_ready = false;
+    m_queuedMessages.clear();
+
+    // Whatever the host managed to write before it went away
+    readStates();
+    failPendingRequests();
+
+    if (m_stopping) {
+        return;
+    }
+
+    // Back off when the host keeps crashing right after starting
+    if (m_hostStarted.elapsed() > 60000) {
+        m_restartDelay = 5000;
+    } else {
+        m_restartDelay = qMin(qMax(5000, m_restartDelay * 2), 60000);
+    }
+    qCInfo(dcPluginHost()) << "Restarting the plugin host for" << pluginName() << "in" << m_restartDelay / 1000 << "seconds";
+    m_restartTimer.start(m_restartDelay);
+}
+
+void PluginHostIntegrationPlugin::startHost()
+{
+    QString host = QCoreApplication::applicationDirPath() + "/nymea-pluginhost";
+    if (!QFileInfo(host).isExecutable()) {
+        host = QStandardPaths::findExecutable("nymea-pluginhost");
+    }
+    // Running from the build directory, like the plugin search dirs
+    if (host.isEmpty() && QFileInfo(QCoreApplication::applicationDirPath() + "/../../../pluginhost/nymea-pluginhost").isExecutable()) {
+        host = QDir(QCoreApplication::applicationDirPath() + "/../../../pluginhost/").absoluteFilePath("nymea-pluginhost");
+    }
+    if (host.isEmpty()) {
+        qCWarning(dcPluginHost()) << "Unable to find nymea-pluginhost. Plugin" << pluginName() << "will not be functional.";
+        return;
+    }
+
+    QStringList arguments;
+    arguments << "--socket" << m_server->fullServerName();
+    if (m_stateChannel.isValid()) {
+        arguments << "--state-channel" << m_stateChannel.key();
+    }
+    arguments << m_pluginFile;
+
+    // An optional command wrapping the host, for example to apply resource limits
+    QString program = host;
+    QStringList wrapper = m_hostCommand.split(' ', QString::SkipEmptyParts);
+    if (!wrapper.isEmpty()) {
+        for (int i = 0; i < wrapper.count(); i++) {
+            wrapper[i].replace("%1", pluginName());
+        }
+        program = wrapper.takeFirst();
+        arguments = wrapper + QStringList(host) + arguments;
+    }
+
+    qCDebug(dcPluginHost()) << "Starting plugin host for" << pluginName() << program << arguments;
+    m_process = new QProcess(this);
+    m_process->setProcessChannelMode(QProcess::ForwardedChannels);
+    connect(m_process, static_cast<void(QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished), this, &PluginHostIntegrationPlugin::onHostFinished);
+    connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error){
+        if (error == QProcess::FailedToStart) {
+            onHostFinished();
+        }
+    });
+    m_hostStarted.start();
+    m_process->start(program, arguments);
+}
+
+void PluginHostIntegrationPlugin::send(PluginHostProtocol::Message message, const QByteArray &payload)
+{
+    if (!m_ready || !m_connection) {
+        m_queuedMessages.append(qMakePair(message, payload));
+        return;
+    }
+    m_connection->send(message, payload);
+}
+
+QByteArray PluginHostIntegrationPlugin::thingPayload(quint32 requestId, Thing *thing)
+{
+    return P::encode(requestId, thingHandle(thing), thing->id(), thing->thingClassId(), thing->name(), thing->parentId(),
+                     thing->autoCreated(), thing->params(), thing->settings(), thing->states());
+}
+
+void PluginHostIntegrationPlugin::readStates()
+{
+    QByteArray record;
+    while (m_stateChannel.read(&record)) {
+        applyStateChange(record);
+    }
+}
+
+void PluginHostIntegrationPlugin::applyStateChange(const QByteArray &record)
+{
+    quint32 handle; int stateIndex; QVariant value; QVariant minValue; QVariant maxValue;
+    if (!P::decodeStateChange(record, &handle, &stateIndex, &value, &minValue, &maxValue)) {
+        qCWarning(dcPluginHost()) << "Invalid state change from the plugin host of" << pluginName();
+        return;
+    }
+    Thing *thing = this->thing(handle);
+    if (!thing) {
+        return;
+    }
+    const QList<StateTypeId> stateTypeIds = m_stateTypeIds.value(thing->thingClassId());
+    if (stateIndex < 0 || stateIndex >= stateTypeIds.count()) {
+        return;
+    }
+    StateTypeId stateTypeId = stateTypeIds.at(stateIndex);
+    if (minValue.isValid() || maxValue.isValid()) {
+        thing->setStateMinMaxValues(stateTypeId, minValue, maxValue);
+    }
+    thing->setStateValue(stateIndex, stateTypeId, value);
+}
+
+void PluginHostIntegrationPlugin::failPendingRequests()
+{
+    QList<PendingRequest> requests = m_pendingRequests.values();
+    m_pendingRequests.clear();
+    foreach (const PendingRequest &request, requests) {
+        request.fail(Thing::ThingErrorHardwareFailure);
+    }
+}
+
+template <typename T>
+quint32 PluginHostIntegrationPlugin::addRequest(T *info)
+{
+    quint32 requestId = ++m_lastRequestId;
+    if (requestId == 0) {
+        requestId = ++m_lastRequestId;
+    }
+
+    QPointer<T> guard(info);
+    PendingRequest request;
+    request.info = info;
+    request.fail = [guard](Thing::ThingError error) {
+        if (guard) {
+            guard->finish(error);
+        }
+    };
+    m_pendingRequests.insert(requestId, request);
+
+    connect(info, &T::aborted, this, [this, requestId](){
+        if (m_pendingRequests.remove(requestId) > 0) {
+            send(P::MessageAbort, P::encode(requestId));
+        }
+    });
+    connect(info, &QObject::destroyed, this, [this, requestId](){
+        m_pendingRequests.remove(requestId);
+    });
+    return requestId;
+}
+
+template <typename T>
+T *PluginHostIntegrationPlugin::takeRequest(quint32 requestId)
+{
+    return qobject_cast<T*>(m_pendingRequests.take(requestId).info.data());
+}
+
+quint32 PluginHostIntegrationPlugin::thingHandle(Thing *thing)
+{
+    quint32 handle = m_handles.value(thing);
+    if (handle > 0) {
+        return handle;
+    }
+
+    handle = ++m_lastHandle;
+    m_handles.insert(thing, handle);
+    m_things.insert(handle, thing);
+
+    if (!m_stateTypeIds.contains(thing->thingClassId())) {
+        QList<StateTypeId> stateTypeIds;
+        foreach (const State &state, thing->states()) {
+            stateTypeIds.append(state.stateTypeId());
+        }
+        m_stateTypeIds.insert(thing->thingClassId(), stateTypeIds);
+    }
+
+    connect(thing, &Thing::nameChanged, this, [this, thing, handle](){
+        send(P::MessageSetThingName, P::encode(handle, thing->name()));
+    });
+    connect(thing, &Thing::settingChanged, this, [this, handle](const ParamTypeId &paramTypeId, const QVariant &value){
+        send(P::MessageSetThingSetting, P::encode(handle, paramTypeId, value));
+    });
+    return handle;
+}
+
+Thing *PluginHostIntegrationPlugin::thing(quint32 handle) const
+{
+    return m_things.value(handle);
+}
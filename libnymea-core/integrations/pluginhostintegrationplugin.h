@@ -0,0 +1,130 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef PLUGINHOSTINTEGRATIONPLUGIN_H
+#define PLUGINHOSTINTEGRATIONPLUGIN_H
+
+#include "integrations/integrationplugin.h"
+#include "pluginhost/pluginhostprotocol.h"
+#include "pluginhost/pluginhoststatechannel.h"
+
+#include <QObject>
+#include <QPointer>
+#include <QProcess>
+#include <QLocalServer>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include <functional>
+
+/* Stands in for a C++ plugin running in a nymea-pluginhost process of its own. Calls into the plugin are
+   forwarded to the host and its replies, state changes and events are applied to the things here. */
+class PluginHostIntegrationPlugin: public IntegrationPlugin
+{
+    Q_OBJECT
+public:
+    explicit PluginHostIntegrationPlugin(const QString &pluginFile, const PluginMetadata &metadata, const QString &hostCommand = QString(), QObject *parent = nullptr);
+    ~PluginHostIntegrationPlugin() override;
+
+    // Whether the plugin is one of the hosted plugins in the configuration
+    static bool isHosted(const PluginMetadata &metadata, const QStringList &hostedPlugins);
+
+    // The process id of the running host, 0 while there is none
+    qint64 hostProcessId() const;
+
+    void init() override;
+    void startMonitoringAutoThings() override;
+    void discoverThings(ThingDiscoveryInfo *info) override;
+    void startPairing(ThingPairingInfo *info) override;
+    void confirmPairing(ThingPairingInfo *info, const QString &username, const QString &secret) override;
+    void setupThing(ThingSetupInfo *info) override;
+    void postSetupThing(Thing *thing) override;
+    void thingRemoved(Thing *thing) override;
+    void executeAction(ThingActionInfo *info) override;
+    void browseThing(BrowseResult *result) override;
+    void browserItem(BrowserItemResult *result) override;
+    void executeBrowserItem(BrowserActionInfo *info) override;
+    void executeBrowserItemAction(BrowserItemActionInfo *info) override;
+
+private slots:
+    void onNewConnection();
+    void onMessageReceived(PluginHostProtocol::Message message, const QByteArray &payload);
+    void onHostFinished();
+
+private:
+    class PendingRequest {
+    public:
+        QPointer<QObject> info;
+        std::function<void(Thing::ThingError)> fail;
+    };
+
+    void startHost();
+    void send(PluginHostProtocol::Message message, const QByteArray &payload = QByteArray());
+    QByteArray thingPayload(quint32 requestId, Thing *thing);
+    void readStates();
+    void applyStateChange(const QByteArray &record);
+    void failPendingRequests();
+
+    template <typename T> quint32 addRequest(T *info);
+    template <typename T> T *takeRequest(quint32 requestId);
+
+    quint32 thingHandle(Thing *thing);
+    Thing *thing(quint32 handle) const;
+
+    QString m_pluginFile;
+    QString m_hostCommand;
+
+    QLocalServer *m_server = nullptr;
+    QProcess *m_process = nullptr;
+    PluginHostConnection *m_connection = nullptr;
+    PluginHostStateChannel m_stateChannel;
+    QTimer m_restartTimer;
+    QElapsedTimer m_hostStarted;
+    int m_restartDelay = 0;
+    bool m_stopping = false;
+
+    // Messages sent before the host is ready
+    bool m_ready = false;
+    QList<QPair<PluginHostProtocol::Message, QByteArray>> m_queuedMessages;
+
+    quint32 m_lastRequestId = 0;
+    QHash<quint32, PendingRequest> m_pendingRequests;
+
+    quint32 m_lastHandle = 0;
+    QHash<quint32, Thing*> m_things;
+    QHash<Thing*, quint32> m_handles;
+    // The ids of the state types of a thing class in the order of the thing's states
+    QHash<ThingClassId, QList<StateTypeId>> m_stateTypeIds;
+
+    bool m_monitoringAutoThings = false;
+    bool m_applyingHostConfig = false;
+};
+
+#endif // PLUGINHOSTINTEGRATIONPLUGIN_H
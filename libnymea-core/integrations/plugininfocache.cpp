@@ -35,8 +35,21 @@
 #include <QDir>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QCryptographicHash>
 
 #include "loggingcategories.h"
+#include "version.h"
+
+// Bump whenever the header written by cachePluginMetadata() changes
+static const quint32 metadataCacheVersion = 1;
+
+static QString metadataCacheFile(const QString &pluginFileName)
+{
+    QString hash = QCryptographicHash::hash(pluginFileName.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/pluginmetadata/" + hash + ".cache";
+}
 
 PluginInfoCache::PluginInfoCache()
 {
@@ -80,3 +93,67 @@ QJsonObject PluginInfoCache::loadPluginInfo(const PluginId &pluginId)
     }
     return QJsonObject::fromVariantMap(jsonDoc.toVariant().toMap());
 }
+
+/*! Stores the validated \a metadata of the plugin library at \a pluginFileName. The entry is tied to the size and
+    modification time of the library and to the nymea version, so loadPluginMetadata() drops it once any of them change. */
+void PluginInfoCache::cachePluginMetadata(const QString &pluginFileName, const PluginMetadata &metadata)
+{
+    QFileInfo pluginFileInfo(pluginFileName);
+    QFileInfo cacheFileInfo(metadataCacheFile(pluginFileName));
+    QDir path = cacheFileInfo.absoluteDir();
+    if (!path.exists()) {
+        if (!path.mkpath(path.absolutePath())) {
+            qCWarning(dcThingManager()) << "Error creating plugin metadata cache dir at" << path.absolutePath();
+        }
+    }
+    QFile file(cacheFileInfo.absoluteFilePath());
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        qCWarning(dcThingManager()) << "Error opening plugin metadata cache for writing at" << file.fileName();
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << metadataCacheVersion << QString(NYMEA_VERSION_STRING) << pluginFileInfo.size() << pluginFileInfo.lastModified().toMSecsSinceEpoch();
+    stream << metadata.serialize();
+    file.close();
+}
+
+/*! Returns the cached metadata of the plugin library at \a pluginFileName, or an invalid PluginMetadata if there is
+    no entry or the library changed since it was written. The \a jsonObject is attached to the returned metadata as is. */
+PluginMetadata PluginInfoCache::loadPluginMetadata(const QString &pluginFileName, const QJsonObject &jsonObject)
+{
+    QFile file(metadataCacheFile(pluginFileName));
+    if (!file.open(QFile::ReadOnly)) {
+        return PluginMetadata();
+    }
+
+    // Map the file instead of reading it, the payload is only ever read once
+    uchar *mapped = file.map(0, file.size());
+    if (!mapped) {
+        return PluginMetadata();
+    }
+    QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), static_cast<int>(file.size()));
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 version;
+    QString nymeaVersion;
+    qint64 size;
+    qint64 lastModified;
+    stream >> version >> nymeaVersion >> size >> lastModified;
+
+    QFileInfo pluginFileInfo(pluginFileName);
+    PluginMetadata metadata;
+    if (stream.status() == QDataStream::Ok && version == metadataCacheVersion && nymeaVersion == NYMEA_VERSION_STRING
+            && size == pluginFileInfo.size() && lastModified == pluginFileInfo.lastModified().toMSecsSinceEpoch()) {
+        QByteArray payload;
+        stream >> payload;
+        if (stream.status() == QDataStream::Ok) {
+            metadata = PluginMetadata::deserialize(payload, jsonObject);
+        }
+    }
+
+    file.unmap(mapped);
+    return metadata;
+}
@@ -33,6 +33,7 @@
 
 #include "types/thingclass.h"
 #include "integrations/integrationplugin.h"
+#include "integrations/pluginmetadata.h"
 
 class PluginInfoCache
 {
@@ -41,6 +42,9 @@ public:
 
     static void cachePluginInfo(const QJsonObject &metaData);
     static QJsonObject loadPluginInfo(const PluginId &pluginId);
+
+    static void cachePluginMetadata(const QString &pluginFileName, const PluginMetadata &metadata);
+    static PluginMetadata loadPluginMetadata(const QString &pluginFileName, const QJsonObject &jsonObject);
 };
 
 #endif // PLUGININFOCACHE_H
@@ -0,0 +1,115 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "pluginstatistics.h"
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+#include "scriptintegrationplugin.h"
+#endif
+#ifdef WITH_PYTHON
+#include "pythonintegrationplugin.h"
+#endif
+
+#include <time.h>
+
+/*! \class PluginStatistics
+    \brief Accounts the time spent in the calls into a Python or JS plugin.
+
+    \ingroup core
+    \inmodule core
+
+    All times are given in microseconds. The queue time is the time a call waited for a thread of the plugin and,
+    for Python plugins, for the GIL. The CPU time is the time the thread actually spent running the call.
+    Recording is thread safe, so calls can be recorded from the threads running them.
+*/
+
+void PluginStatistics::recordCall(const QString &function, qint64 queueTime, qint64 wallTime, qint64 cpuTime)
+{
+    QMutexLocker locker(&m_mutex);
+    Counters &counters = m_calls[function];
+    counters.count++;
+    counters.wallTime += wallTime;
+    counters.maxWallTime = qMax(counters.maxWallTime, wallTime);
+    counters.cpuTime += cpuTime;
+    counters.queueTime += queueTime;
+    counters.maxQueueTime = qMax(counters.maxQueueTime, queueTime);
+}
+
+QVariantMap PluginStatistics::calls() const
+{
+    QMutexLocker locker(&m_mutex);
+    QVariantMap calls;
+    for (QHash<QString, Counters>::const_iterator it = m_calls.constBegin(); it != m_calls.constEnd(); ++it) {
+        QVariantMap counters;
+        counters.insert("count", it->count);
+        counters.insert("wallTimeUs", it->wallTime);
+        counters.insert("maxWallTimeUs", it->maxWallTime);
+        counters.insert("cpuTimeUs", it->cpuTime);
+        counters.insert("queueTimeUs", it->queueTime);
+        counters.insert("maxQueueTimeUs", it->maxQueueTime);
+        calls.insert(it.key(), counters);
+    }
+    return calls;
+}
+
+/*! Returns the CPU time consumed by the calling thread in microseconds. */
+qint64 PluginStatistics::threadCpuTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<qint64>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*! Returns the statistics of all Python and JS plugins in \a plugins, by plugin id. Native plugins are skipped. */
+QVariantMap PluginStatistics::collect(const IntegrationPlugins &plugins)
+{
+    QVariantMap statistics;
+    foreach (IntegrationPlugin *plugin, plugins) {
+        QVariantMap pluginStatistics;
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+        if (ScriptIntegrationPlugin *scriptPlugin = qobject_cast<ScriptIntegrationPlugin*>(plugin)) {
+            pluginStatistics = scriptPlugin->statistics();
+            pluginStatistics.insert("runtime", "js");
+        }
+#endif
+#ifdef WITH_PYTHON
+        if (PythonIntegrationPlugin *pythonPlugin = qobject_cast<PythonIntegrationPlugin*>(plugin)) {
+            pluginStatistics = pythonPlugin->statistics();
+            pluginStatistics.insert("runtime", "python");
+        }
+#endif
+        if (pluginStatistics.isEmpty()) {
+            continue;
+        }
+        pluginStatistics.insert("name", plugin->pluginName());
+        statistics.insert(plugin->pluginId().toString(), pluginStatistics);
+    }
+    return statistics;
+}
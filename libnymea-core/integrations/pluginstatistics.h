@@ -0,0 +1,65 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef PLUGINSTATISTICS_H
+#define PLUGINSTATISTICS_H
+
+#include <QHash>
+#include <QMutex>
+#include <QVariantMap>
+
+#include "integrations/integrationplugin.h"
+
+class PluginStatistics
+{
+public:
+    PluginStatistics() = default;
+
+    void recordCall(const QString &function, qint64 queueTime, qint64 wallTime, qint64 cpuTime);
+    QVariantMap calls() const;
+
+    static qint64 threadCpuTime();
+    static QVariantMap collect(const IntegrationPlugins &plugins);
+
+private:
+    struct Counters {
+        quint64 count = 0;
+        qint64 wallTime = 0;
+        qint64 maxWallTime = 0;
+        qint64 cpuTime = 0;
+        qint64 queueTime = 0;
+        qint64 maxQueueTime = 0;
+    };
+
+    mutable QMutex m_mutex;
+    QHash<QString, Counters> m_calls;
+};
+
+#endif // PLUGINSTATISTICS_H
@@ -12,6 +12,7 @@
 #include <QPointer>
 #include <QThread>
 #include <QMetaEnum>
+#include <QTimer>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Winvalid-offsetof"
@@ -46,7 +47,8 @@ typedef struct _thing {
     PyObject *pySettings = nullptr;
     PyObject *pyNameChangedHandler = nullptr;
     PyObject *pySettingChangedHandler = nullptr;
-    PyObject *pyStates = nullptr; // A copy of the things states
+    PyObject *pyStates = nullptr; // A copy of the things state values, by stateTypeId
+    QHash<StateTypeId, PyObject*> *pyStateTypeIds = nullptr; // Interned stateTypeId strings used as keys in pyStates
     PyThreadState *threadState = nullptr; // The python threadstate this thing belongs to
 } PyThing;
 
@@ -61,6 +63,18 @@ static PyObject* PyThing_new(PyTypeObject *type, PyObject */*args*/, PyObject */
     return (PyObject*)self;
 }
 
+// Must be called while holding the GIL
+static void PyThing_updateStateValue(PyThing *self, const StateTypeId &stateTypeId, const QVariant &value)
+{
+    PyObject *pyStateTypeId = self->pyStateTypeIds->value(stateTypeId);
+    if (!pyStateTypeId) {
+        return;
+    }
+    PyObject *pyValue = QVariantToPyObject(value);
+    PyDict_SetItem(self->pyStates, pyStateTypeId, pyValue);
+    Py_DECREF(pyValue);
+}
+
 static void PyThing_setThing(PyThing *self, Thing *thing, PyThreadState *threadState)
 {
     self->thing = thing;
@@ -76,13 +90,14 @@ static void PyThing_setThing(PyThing *self, Thing *thing, PyThreadState *threadS
     self->pyParams = PyParams_FromParamList(self->thing->params());
     self->pySettings = PyParams_FromParamList(self->thing->settings());
 
-    self->pyStates = PyList_New(thing->states().count());
-    for (int i = 0; i < thing->states().count(); i++) {
-        State state = thing->states().at(i);
-        PyObject *pyState = Py_BuildValue("{s:s, s:O}",
-                                          "stateTypeId", state.stateTypeId().toString().toUtf8().data(),
-                                          "value", QVariantToPyObject(state.value()));
-        PyList_SetItem(self->pyStates, i, pyState);
+    self->pyStates = PyDict_New();
+    self->pyStateTypeIds = new QHash<StateTypeId, PyObject*>();
+    foreach (const State &state, thing->states()) {
+        PyObject *pyStateTypeId = PyUnicode_InternFromString(state.stateTypeId().toString().toUtf8().data());
+        self->pyStateTypeIds->insert(state.stateTypeId(), pyStateTypeId);
+        PyObject *pyValue = QVariantToPyObject(state.value());
+        PyDict_SetItem(self->pyStates, pyStateTypeId, pyValue);
+        Py_DECREF(pyValue);
     }
 
 
@@ -122,17 +137,15 @@ static void PyThing_setThing(PyThing *self, Thing *thing, PyThreadState *threadS
 
     QObject::connect(thing, &Thing::stateValueChanged, [=](const StateTypeId &stateTypeId, const QVariant &value){
         PyEval_RestoreThread(self->threadState);
-        for (int i = 0; i < PyList_Size(self->pyStates); i++) {
-            PyObject *pyState = PyList_GetItem(self->pyStates, i);
-            PyObject *pyStateTypeId = PyDict_GetItemString(pyState, "stateTypeId");
-            StateTypeId stid = StateTypeId(PyUnicode_AsUTF8AndSize(pyStateTypeId, nullptr));
-            if (stid == stateTypeId) {
-                pyState = Py_BuildValue("{s:s, s:O}",
-                                  "stateTypeId", stateTypeId.toString().toUtf8().data(),
-                                  "value", QVariantToPyObject(value));
-                PyList_SetItem(self->pyStates, i, pyState);
-                break;
-            }
+        PyThing_updateStateValue(self, stateTypeId, value);
+        PyEval_ReleaseThread(self->threadState);
+    });
+
+    // Batched state updates only emit this one, sync all of them while holding the GIL once
+    QObject::connect(thing, &Thing::stateValuesChanged, [=](const QList<StateTypeId> &stateTypeIds){
+        PyEval_RestoreThread(self->threadState);
+        foreach (const StateTypeId &stateTypeId, stateTypeIds) {
+            PyThing_updateStateValue(self, stateTypeId, self->thing->stateValue(stateTypeId));
         }
         PyEval_ReleaseThread(self->threadState);
     });
@@ -148,6 +161,12 @@ static void PyThing_dealloc(PyThing * self) {
     Py_XDECREF(self->pyParams);
     Py_XDECREF(self->pySettings);
     Py_XDECREF(self->pyStates);
+    if (self->pyStateTypeIds) {
+        foreach (PyObject *pyStateTypeId, *self->pyStateTypeIds) {
+            Py_DECREF(pyStateTypeId);
+        }
+        delete self->pyStateTypeIds;
+    }
     Py_XDECREF(self->pyNameChangedHandler);
     Py_XDECREF(self->pySettingChangedHandler);
     delete self->thingClass;
@@ -266,29 +285,40 @@ static int PyThing_setSettings(PyThing */*self*/, PyObject */*value*/, void */*c
     return 0;
 }
 
+// Returns a borrowed reference to the interned key in pyStates for the given stateTypeId string, or nullptr
+static PyObject *PyThing_findStateTypeId(PyThing *self, PyObject *pyStateTypeId, StateTypeId *stateTypeId)
+{
+    // The ids exported to the plugin module have the same format as the keys, no need to parse them
+    if (PyDict_Contains(self->pyStates, pyStateTypeId) == 1) {
+        if (stateTypeId) {
+            *stateTypeId = StateTypeId(PyUnicode_AsUTF8(pyStateTypeId));
+        }
+        return pyStateTypeId;
+    }
+    StateTypeId id = StateTypeId(PyUnicode_AsUTF8(pyStateTypeId));
+    if (stateTypeId) {
+        *stateTypeId = id;
+    }
+    return self->pyStateTypeIds->value(id);
+}
+
 static PyObject * PyThing_stateValue(PyThing* self, PyObject* args)
 {
-    char *stateTypeIdStr = nullptr;
+    PyObject *pyStateTypeId = nullptr;
 
-    if (!PyArg_ParseTuple(args, "s", &stateTypeIdStr)) {
+    if (!PyArg_ParseTuple(args, "U", &pyStateTypeId)) {
         PyErr_SetString(PyExc_ValueError, "Error parsing arguments. Signature is 's'");
         return nullptr;
     }
 
-    StateTypeId stateTypeId = StateTypeId(stateTypeIdStr);
-
-    for (int i = 0; i < PyList_Size(self->pyStates); i++) {
-        PyObject *pyState = PyList_GetItem(self->pyStates, i);
-        PyObject *pyStateTypeId = PyDict_GetItemString(pyState, "stateTypeId");
-        StateTypeId stid = StateTypeId(PyUnicode_AsUTF8AndSize(pyStateTypeId, nullptr));
-        if (stid == stateTypeId) {
-            PyObject *value = PyDict_GetItemString(pyState, "value");
-            Py_INCREF(value);
-            return value;
-        }
+    PyObject *key = PyThing_findStateTypeId(self, pyStateTypeId, nullptr);
+    if (key) {
+        PyObject *value = PyDict_GetItem(self->pyStates, key);
+        Py_INCREF(value);
+        return value;
     }
 
-    PyErr_SetString(PyExc_ValueError, QString("No state type %1 in thing class %2").arg(stateTypeId.toString()).arg(self->thingClass->name()).toUtf8());
+    PyErr_SetString(PyExc_ValueError, QString("No state type %1 in thing class %2").arg(PyUnicode_AsUTF8(pyStateTypeId)).arg(self->thingClass->name()).toUtf8());
     return nullptr;
 }
 
@@ -312,6 +342,43 @@ static PyObject * PyThing_setStateValue(PyThing* self, PyObject* args)
     Py_RETURN_NONE;
 }
 
+static PyObject * PyThing_setStateValues(PyThing* self, PyObject* args)
+{
+    PyObject *valuesObj = nullptr;
+
+    if (!PyArg_ParseTuple(args, "O!", &PyDict_Type, &valuesObj)) {
+        PyErr_SetString(PyExc_ValueError, "Error parsing arguments. Signature is a dict of stateTypeIds and values");
+        return nullptr;
+    }
+
+    QHash<StateTypeId, QVariant> values;
+    Py_ssize_t pos = 0;
+    PyObject *key = nullptr;
+    PyObject *valueObj = nullptr;
+    while (PyDict_Next(valuesObj, &pos, &key, &valueObj)) {
+        if (!PyUnicode_Check(key)) {
+            PyErr_SetString(PyExc_TypeError, "State type ids must be strings");
+            return nullptr;
+        }
+        StateTypeId stateTypeId;
+        if (!PyThing_findStateTypeId(self, key, &stateTypeId)) {
+            PyErr_SetString(PyExc_ValueError, QString("No state type %1 in thing class %2").arg(PyUnicode_AsUTF8(key)).arg(self->thingClass->name()).toUtf8());
+            return nullptr;
+        }
+        values.insert(stateTypeId, PyObjectToQVariant(valueObj));
+    }
+
+    // Hand over all values with a single call into the main thread
+    if (self->thing != nullptr && !values.isEmpty()) {
+        Thing *thing = self->thing;
+        QTimer::singleShot(0, thing, [thing, values](){
+            thing->setStateValues(values);
+        });
+    }
+
+    Py_RETURN_NONE;
+}
+
 static PyObject * PyThing_emitEvent(PyThing* self, PyObject* args)
 {
     char *eventTypeIdStr = nullptr;
@@ -356,6 +423,7 @@ static PyMethodDef PyThing_methods[] = {
     { "setting", (PyCFunction)PyThing_setting, METH_VARARGS, "Get a things setting value by paramTypeId" },
     { "stateValue", (PyCFunction)PyThing_stateValue, METH_VARARGS, "Get a things state value by stateTypeId" },
     { "setStateValue", (PyCFunction)PyThing_setStateValue, METH_VARARGS, "Set a certain things state value by stateTypeIp" },
+    { "setStateValues", (PyCFunction)PyThing_setStateValues, METH_VARARGS, "Set multiple state values at once, given as a dict of stateTypeIds and values" },
     { "emitEvent", (PyCFunction)PyThing_emitEvent, METH_VARARGS, "Emits an event" },
     {nullptr, nullptr, 0, nullptr} // sentinel
 };
@@ -16,12 +16,73 @@
 #include <QMutex>
 #include <QFuture>
 #include <QFutureWatcher>
+#include <QThread>
+#include <QElapsedTimer>
 
 NYMEA_LOGGING_CATEGORY(dcPythonIntegrations, "PythonIntegrations")
 
 PyThreadState* PythonIntegrationPlugin::s_mainThreadState = nullptr;
+bool PythonIntegrationPlugin::s_sharedInterpreter = false;
+static bool s_sharedOutputRedirected = false;
 QHash<PythonIntegrationPlugin*, PyObject*> PythonIntegrationPlugin::s_plugins;
 
+// Creating and destroying a python thread state for every plugin call is expensive. Each thread of a
+// plugin's thread pool keeps its thread state instead and destroys it when the thread exits.
+struct PoolThreadState {
+    PyThreadState *threadState = nullptr;
+    QSharedPointer<QAtomicInt> liveThreadStates;
+
+    ~PoolThreadState() {
+        if (threadState) {
+            PyEval_RestoreThread(threadState);
+            PyThreadState_Clear(threadState);
+            PyEval_ReleaseThread(threadState);
+            PyThreadState_Delete(threadState);
+            liveThreadStates->deref();
+        }
+    }
+};
+static thread_local PoolThreadState s_poolThreadState;
+
+// Sums up the memory allocated by the plugin's own python files, if tracemalloc is enabled
+static const char *statisticsHelperCode =
+        "import tracemalloc\n"
+        "\n"
+        "def memory_usage(path):\n"
+        "    if not tracemalloc.is_tracing():\n"
+        "        return None\n"
+        "    snapshot = tracemalloc.take_snapshot().filter_traces([tracemalloc.Filter(True, path + '/*')])\n"
+        "    stats = snapshot.statistics('filename')\n"
+        "    return (sum(stat.size for stat in stats), sum(stat.count for stat in stats))\n";
+
+// Runs coroutines returned by "async def" plugin functions on a single asyncio loop per plugin
+static const char *asyncioRunnerCode =
+        "import asyncio\n"
+        "import sys\n"
+        "import traceback\n"
+        "\n"
+        "loop = asyncio.new_event_loop()\n"
+        "\n"
+        "def run_loop():\n"
+        "    asyncio.set_event_loop(loop)\n"
+        "    loop.run_forever()\n"
+        "    tasks = asyncio.all_tasks(loop)\n"
+        "    for task in tasks:\n"
+        "        task.cancel()\n"
+        "    loop.run_until_complete(asyncio.gather(*tasks, return_exceptions=True))\n"
+        "    loop.close()\n"
+        "\n"
+        "def stop_loop():\n"
+        "    loop.call_soon_threadsafe(loop.stop)\n"
+        "\n"
+        "def run_coroutine(coroutine, name):\n"
+        "    def done(future):\n"
+        "        if not future.cancelled() and future.exception() is not None:\n"
+        "            error = future.exception()\n"
+        "            print('Error in python plugin coroutine ' + name, file=sys.stderr)\n"
+        "            traceback.print_exception(type(error), error, error.__traceback__)\n"
+        "    asyncio.run_coroutine_threadsafe(coroutine, loop).add_done_callback(done)\n";
+
 PyObject* PythonIntegrationPlugin::pyConfiguration(PyObject* self, PyObject* /*args*/)
 {
     PythonIntegrationPlugin *plugin = s_plugins.key(self);
@@ -239,15 +300,45 @@ PythonIntegrationPlugin::~PythonIntegrationPlugin()
         }
     }
 
+    if (m_asyncioRunner) {
+        // Pending coroutines are cancelled when the loop stops
+        PyObject *result = PyObject_CallMethod(m_asyncioRunner, "stop_loop", nullptr);
+        Py_XDECREF(result);
+        Py_BEGIN_ALLOW_THREADS
+        m_asyncioLoop.waitForFinished();
+        Py_END_ALLOW_THREADS
+        Py_DECREF(m_asyncioRunner);
+    }
+
+    // The interpreter can only be ended once all pool threads have destroyed their thread states
+    Py_BEGIN_ALLOW_THREADS
+    delete m_threadPool;
+    m_threadPool = nullptr;
+    while (m_liveThreadStates->load() > 0) {
+        QThread::msleep(1);
+    }
+    Py_END_ALLOW_THREADS
+
     s_plugins.take(this);
+    Py_XDECREF(m_statisticsHelper);
     Py_XDECREF(m_pluginModule);
     Py_DECREF(m_nymeaModule);
     Py_XDECREF(m_stdOutHandler);
     Py_XDECREF(m_stdErrHandler);
 
-    Py_EndInterpreter(m_threadState);
+    if (s_sharedInterpreter) {
+        // Drop the plugin module so it is imported again if the plugin is loaded again
+        if (!m_moduleName.isEmpty() && PyDict_DelItemString(PyImport_GetModuleDict(), m_moduleName.toUtf8()) != 0) {
+            PyErr_Clear();
+        }
+        PyThreadState_Swap(s_mainThreadState);
+        PyThreadState_Clear(m_threadState);
+        PyThreadState_Delete(m_threadState);
+    } else {
+        Py_EndInterpreter(m_threadState);
+        PyThreadState_Swap(s_mainThreadState);
+    }
 
-    PyThreadState_Swap(s_mainThreadState);
     PyEval_ReleaseThread(s_mainThreadState);
 }
 
@@ -268,6 +359,14 @@ void PythonIntegrationPlugin::initPython()
     Py_InitializeEx(0);
     PyEval_InitThreads();
 
+    // By default, each plugin gets a subinterpreter of its own. Sharing the main interpreter saves the memory
+    // of importing the same modules in every plugin, at the cost of plugins sharing sys.path and sys.modules.
+    s_sharedInterpreter = qgetenv("NYMEA_PYTHON_INTERPRETER") == "shared";
+    s_sharedOutputRedirected = false;
+    if (s_sharedInterpreter) {
+        qCDebug(dcPythonIntegrations()) << "Python plugins share the main interpreter";
+    }
+
     // Store the main thread state and release the GIL
     s_mainThreadState = PyEval_SaveThread();
 }
@@ -290,9 +389,15 @@ bool PythonIntegrationPlugin::loadScript(const QString &scriptFile)
     // Grab the main thread context and GIL
     PyEval_RestoreThread(s_mainThreadState);
 
-    // Create a new interpreter
-    qCDebug(dcPythonIntegrations()) << "Creatig new Python interpreter for script:" << scriptFile;
-    m_threadState = Py_NewInterpreter();
+    if (s_sharedInterpreter) {
+        // A thread state of our own in the main interpreter, used from the main thread
+        qCDebug(dcPythonIntegrations()) << "Loading script into the shared Python interpreter:" << scriptFile;
+        m_threadState = PyThreadState_New(s_mainThreadState->interp);
+    } else {
+        // Create a new interpreter
+        qCDebug(dcPythonIntegrations()) << "Creatig new Python interpreter for script:" << scriptFile;
+        m_threadState = Py_NewInterpreter();
+    }
 
     // Switch to the new interpreter thread state
     PyThreadState_Swap(m_threadState);
@@ -341,6 +446,8 @@ bool PythonIntegrationPlugin::loadScript(const QString &scriptFile)
     importPaths.append(fi.absolutePath());
     importPaths.append(QString("%1/modules/").arg(fi.absolutePath()));
 
+    // With a shared interpreter, the paths of previously loaded plugins are kept
+    importPaths.removeDuplicates();
     PyObject* pluginPaths = PyList_New(importPaths.length());
     for (int i = 0; i < importPaths.length(); i++) {
         const QString &path = importPaths.at(i);
@@ -350,6 +457,11 @@ bool PythonIntegrationPlugin::loadScript(const QString &scriptFile)
     PySys_SetObject("path", pluginPaths);
 
     // Import the plugin
+    if (s_sharedInterpreter && PyDict_GetItemString(PyImport_GetModuleDict(), fi.baseName().toUtf8())) {
+        qCWarning(dcThingManager()) << "A python module named" << fi.baseName() << "is already loaded in the shared interpreter. Not loading" << fi.absoluteFilePath();
+        PyEval_ReleaseThread(m_threadState);
+        return false;
+    }
     m_pluginModule = PyImport_ImportModule(fi.baseName().toUtf8());
 
     if (!m_pluginModule) {
@@ -360,6 +472,13 @@ bool PythonIntegrationPlugin::loadScript(const QString &scriptFile)
         return false;
     }
     qCDebug(dcThingManager()) << "Imported python plugin from" << fi.absoluteFilePath();
+    m_pluginPath = fi.absolutePath();
+    m_moduleName = fi.baseName();
+
+    // Tracing allocations slows down python noticeably, so it's only done on demand
+    if (qEnvironmentVariableIntValue("NYMEA_PYTHON_TRACEMALLOC") > 0) {
+        PyRun_SimpleString("import tracemalloc\ntracemalloc.start()");
+    }
 
     s_plugins.insert(this, m_pluginModule);
 
@@ -377,15 +496,20 @@ bool PythonIntegrationPlugin::loadScript(const QString &scriptFile)
         Py_DECREF(logger);
     }
 
-    // Override stdout and stderr
-    args = Py_BuildValue("(si)", category.toUtf8().data(), QtMsgType::QtDebugMsg);
-    m_stdOutHandler = PyObject_CallObject((PyObject*)&PyStdOutHandlerType, args);
-    Py_DECREF(args);
-    PySys_SetObject("stdout", m_stdOutHandler);
-    args = Py_BuildValue("(si)", category.toUtf8().data(), QtMsgType::QtWarningMsg);
-    m_stdErrHandler = PyObject_CallObject((PyObject*)&PyStdOutHandlerType, args);
-    PySys_SetObject("stderr", m_stdErrHandler);
-    Py_DECREF(args);
+    // Override stdout and stderr. Those are per interpreter, so plugins sharing the main interpreter
+    // print to a common category instead of their own.
+    if (!s_sharedInterpreter || !s_sharedOutputRedirected) {
+        QString outputCategory = s_sharedInterpreter ? QString("PythonIntegrations") : category;
+        args = Py_BuildValue("(si)", outputCategory.toUtf8().data(), QtMsgType::QtDebugMsg);
+        m_stdOutHandler = PyObject_CallObject((PyObject*)&PyStdOutHandlerType, args);
+        Py_DECREF(args);
+        PySys_SetObject("stdout", m_stdOutHandler);
+        args = Py_BuildValue("(si)", outputCategory.toUtf8().data(), QtMsgType::QtWarningMsg);
+        m_stdErrHandler = PyObject_CallObject((PyObject*)&PyStdOutHandlerType, args);
+        PySys_SetObject("stderr", m_stdErrHandler);
+        Py_DECREF(args);
+        s_sharedOutputRedirected = s_sharedInterpreter;
+    }
 
 
     // Export metadata ids into module
@@ -399,14 +523,19 @@ bool PythonIntegrationPlugin::loadScript(const QString &scriptFile)
     // forcing every plugin developer to deal with threading in the plugin.
     // In oder to not create and destroy a thread for each plugin api call, we'll be using a
     // thread pool.
-    // The maximum number of threads in a plugin will be amount of things it manages + 2.
-    // This would allow for e.g. running an event loop using init(), performing something on a thing
+    // The maximum number of threads in a plugin will be amount of things it manages + 2 (or the
+    // number given in NYMEA_PYTHON_PLUGIN_THREADS). This would allow for e.g. running an event loop using init(), performing something on a thing
     // and still allow the user to perform a discovery at the same time. On the other hand, this is
     // strict enough to not encourage the plugin developer to block forever in ever api call but use
     // proper task processing means (timers, event loops etc) instead.
     // Plugins can still spawn more threads on their own if the need to but have to manage them on their own.
+    // Plugins using "async def" functions run them on an asyncio loop instead which needs one thread only.
+    int baseThreadCount = 2;
+    if (qEnvironmentVariableIsSet("NYMEA_PYTHON_PLUGIN_THREADS")) {
+        baseThreadCount = qMax(1, qEnvironmentVariableIntValue("NYMEA_PYTHON_PLUGIN_THREADS"));
+    }
     m_threadPool = new QThreadPool(this);
-    m_threadPool->setMaxThreadCount(2);
+    m_threadPool->setMaxThreadCount(baseThreadCount);
     qCDebug(dcPythonIntegrations()) << "Created a thread pool with a maximum of" << m_threadPool->maxThreadCount() << "threads for python plugin" << metadata.pluginName();
 
     PyEval_ReleaseThread(m_threadState);
@@ -782,23 +911,37 @@ bool PythonIntegrationPlugin::callPluginFunction(const QString &function, PyObje
 
     QFutureWatcher<void> *watcher = new QFutureWatcher<void>(this);
 
+    QElapsedTimer queueTimer;
+    queueTimer.start();
+
     // Run the plugin function in the thread pool
     QFuture<void> future = QtConcurrent::run(m_threadPool, [=](){
         qCDebug(dcPythonIntegrations()) << "+++ Thread for" << function << "in plugin" << metadata().pluginName();
 
-        // Register this new thread in the interpreter
-        PyThreadState *threadState = PyThreadState_New(m_threadState->interp);
-
-        // Acquire GIL and make the new thread state the current one
+        // Acquire GIL and make the thread state of this pool thread the current one
+        PyThreadState *threadState = poolThreadState();
         PyEval_RestoreThread(threadState);
 
+        // Waiting for the GIL counts as queue time too
+        qint64 queueTime = queueTimer.nsecsElapsed() / 1000;
+        qint64 cpuStart = PluginStatistics::threadCpuTime();
+        QElapsedTimer callTimer;
+        callTimer.start();
+
         PyObject *pluginFunctionResult = PyObject_CallFunctionObjArgs(pluginFunction, param1, param2, param3, nullptr);
 
+        // Coroutines of "async def" functions are accounted up to their first await only
+        m_statistics.recordCall(function, queueTime, callTimer.nsecsElapsed() / 1000, PluginStatistics::threadCpuTime() - cpuStart);
+
         if (PyErr_Occurred()) {
             qCWarning(dcThingManager()) << "Error calling python method:" << function << "on plugin" << pluginName();
             PyErr_Print();
         }
 
+        if (pluginFunctionResult && PyCoro_CheckExact(pluginFunctionResult)) {
+            runCoroutine(function, pluginFunctionResult);
+        }
+
         Py_DECREF(pluginFunction);
         Py_XDECREF(pluginFunctionResult);
         Py_XDECREF(param1);
@@ -807,10 +950,8 @@ bool PythonIntegrationPlugin::callPluginFunction(const QString &function, PyObje
 
         m_runningTasks.remove(watcher);
 
-        // Destroy the thread and release the GIL
-        PyThreadState_Clear(threadState);
+        // Release the GIL
         PyEval_ReleaseThread(threadState);
-        PyThreadState_Delete(threadState);
         qCDebug(dcPythonIntegrations()) << "--- Thread for" << function << "in plugin" << metadata().pluginName();
     });
     watcher->setFuture(future);
@@ -820,3 +961,96 @@ bool PythonIntegrationPlugin::callPluginFunction(const QString &function, PyObje
     return true;
 }
 
+PyThreadState *PythonIntegrationPlugin::poolThreadState()
+{
+    // Pool threads are never shared between plugins, so the thread state always belongs to this interpreter
+    if (!s_poolThreadState.threadState) {
+        s_poolThreadState.threadState = PyThreadState_New(m_threadState->interp);
+        s_poolThreadState.liveThreadStates = m_liveThreadStates;
+        m_liveThreadStates->ref();
+    }
+    return s_poolThreadState.threadState;
+}
+
+void PythonIntegrationPlugin::runCoroutine(const QString &function, PyObject *coroutine)
+{
+    // The GIL is held here, which also guards starting the loop
+    if (!m_asyncioRunner) {
+        QByteArray moduleName = helperModuleName("nymea_asyncio");
+        PyObject *code = Py_CompileString(asyncioRunnerCode, moduleName, Py_file_input);
+        if (code) {
+            m_asyncioRunner = PyImport_ExecCodeModule(moduleName.data(), code);
+            Py_DECREF(code);
+        }
+        if (!m_asyncioRunner) {
+            qCWarning(dcPythonIntegrations()) << "Failed to set up asyncio loop for plugin" << pluginName();
+            PyErr_Print();
+            return;
+        }
+
+        // The loop runs in a pool thread of its own, for as long as the plugin lives
+        m_threadPool->setMaxThreadCount(m_threadPool->maxThreadCount() + 1);
+        m_asyncioLoop = QtConcurrent::run(m_threadPool, [this](){
+            qCDebug(dcPythonIntegrations()) << "Starting asyncio loop for plugin" << metadata().pluginName();
+            PyThreadState *threadState = poolThreadState();
+            PyEval_RestoreThread(threadState);
+            PyObject *result = PyObject_CallMethod(m_asyncioRunner, "run_loop", nullptr);
+            if (!result) {
+                PyErr_Print();
+            }
+            Py_XDECREF(result);
+            PyEval_ReleaseThread(threadState);
+            qCDebug(dcPythonIntegrations()) << "Stopped asyncio loop for plugin" << metadata().pluginName();
+        });
+    }
+
+    PyObject *result = PyObject_CallMethod(m_asyncioRunner, "run_coroutine", "Os", coroutine, function.toUtf8().data());
+    if (!result) {
+        qCWarning(dcThingManager()) << "Error scheduling python coroutine:" << function << "on plugin" << pluginName();
+        PyErr_Print();
+    }
+    Py_XDECREF(result);
+}
+
+/*! Returns the time spent in the calls into this plugin, and with NYMEA_PYTHON_TRACEMALLOC set, the memory
+    allocated by the plugin's python files that is still in use. Taking the memory snapshot holds the GIL for
+    a while, so this shouldn't be polled at a high rate.
+*/
+QVariantMap PythonIntegrationPlugin::statistics()
+{
+    QVariantMap statistics;
+    statistics.insert("calls", m_statistics.calls());
+    statistics.insert("maxThreads", m_threadPool ? m_threadPool->maxThreadCount() : 0);
+    statistics.insert("activeThreads", m_threadPool ? m_threadPool->activeThreadCount() : 0);
+
+    if (!m_pluginModule || qEnvironmentVariableIntValue("NYMEA_PYTHON_TRACEMALLOC") <= 0) {
+        return statistics;
+    }
+
+    PyEval_RestoreThread(m_threadState);
+    if (!m_statisticsHelper) {
+        QByteArray moduleName = helperModuleName("nymea_statistics");
+        PyObject *code = Py_CompileString(statisticsHelperCode, moduleName, Py_file_input);
+        if (code) {
+            m_statisticsHelper = PyImport_ExecCodeModule(moduleName.data(), code);
+            Py_DECREF(code);
+        }
+    }
+    PyObject *result = m_statisticsHelper ? PyObject_CallMethod(m_statisticsHelper, "memory_usage", "s", m_pluginPath.toUtf8().data()) : nullptr;
+    if (result && PyTuple_Check(result)) {
+        statistics.insert("tracedMemory", static_cast<qlonglong>(PyLong_AsLongLong(PyTuple_GetItem(result, 0))));
+        statistics.insert("tracedBlocks", static_cast<qlonglong>(PyLong_AsLongLong(PyTuple_GetItem(result, 1))));
+    }
+    if (PyErr_Occurred()) {
+        PyErr_Print();
+    }
+    Py_XDECREF(result);
+    PyEval_ReleaseThread(m_threadState);
+    return statistics;
+}
+
+QByteArray PythonIntegrationPlugin::helperModuleName(const QString &name) const
+{
+    // Helper modules must not clash with the ones of other plugins in a shared interpreter
+    return QString("%1_%2").arg(name).arg(pluginId().toString().remove(QRegExp("[{}-]"))).toUtf8();
+}
@@ -2,11 +2,13 @@
 #define PYTHONINTEGRATIONPLUGIN_H
 
 #include "integrations/integrationplugin.h"
+#include "pluginstatistics.h"
 
 #include <QObject>
 #include <QJsonObject>
 #include <QFuture>
 #include <QThreadPool>
+#include <QSharedPointer>
 
 extern "C" {
 typedef struct _object PyObject;
@@ -41,6 +43,7 @@ public:
     void executeBrowserItem(BrowserActionInfo *info) override;
     void browserItem(BrowserItemResult *result) override;
 
+    QVariantMap statistics();
 
     static PyObject* pyConfiguration(PyObject* self, PyObject* args);
     static PyObject* pyConfigValue(PyObject* self, PyObject* args);
@@ -63,12 +66,17 @@ private:
 
 
     bool callPluginFunction(const QString &function, PyObject *param1 = nullptr, PyObject *param2 = nullptr, PyObject *param3 = nullptr);
+    PyThreadState *poolThreadState();
+    QByteArray helperModuleName(const QString &name) const;
+    void runCoroutine(const QString &function, PyObject *coroutine);
 
 private:
     // The main thread state in which we create an interpreter per plugin
     static PyThreadState* s_mainThreadState;
+    // Whether all plugins share the main interpreter instead (NYMEA_PYTHON_INTERPRETER=shared)
+    static bool s_sharedInterpreter;
 
-    // A per plugin thread state and interpreter
+    // A per plugin thread state and interpreter (a thread state in the main interpreter if it is shared)
     PyThreadState *m_threadState = nullptr;
 
     // A per plugin thread pool
@@ -77,6 +85,19 @@ private:
     // Running concurrent tasks in this plugins thread pool
     QHash<QFutureWatcher<void>*, QString> m_runningTasks;
 
+    // Number of thread states held by the pool threads of this plugin
+    QSharedPointer<QAtomicInt> m_liveThreadStates = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+
+    // The asyncio loop running coroutines of "async def" plugin functions, set up on first use
+    PyObject *m_asyncioRunner = nullptr;
+    QFuture<void> m_asyncioLoop;
+
+    // Resource accounting
+    PluginStatistics m_statistics;
+    PyObject *m_statisticsHelper = nullptr;
+    QString m_pluginPath;
+    QString m_moduleName;
+
     // The nymea module we import into the interpreter
     PyObject *m_nymeaModule = nullptr;
     // The imported plugin module (the plugin.py)
@@ -33,6 +33,7 @@
 #include <QQmlEngine>
 #include <QDir>
 #include <QJsonDocument>
+#include <QElapsedTimer>
 
 #include "loggingcategories.h"
 #include <plugintimer.h>
@@ -111,8 +112,7 @@ void ScriptIntegrationPlugin::init()
         IntegrationPlugin::init();
         return;
     }
-    QJSValue initFunction = m_pluginImport.property("init");
-    QJSValue result = initFunction.call();
+    QJSValue result = callPluginFunction("init");
     if (result.isError()) {
         qCWarning(dcThingManager()) << "Error calling init in JS plugin:" << result.toString();
         return;
@@ -129,8 +129,7 @@ void ScriptIntegrationPlugin::discoverThings(ThingDiscoveryInfo *info)
     ScriptThingDiscoveryInfo *scriptInfo = new ScriptThingDiscoveryInfo(info);
     QJSValue jsInfo = m_engine->newQObject(scriptInfo);
 
-    QJSValue discoverFunction = m_pluginImport.property("discoverThings");
-    QJSValue ret = discoverFunction.call({jsInfo});
+    QJSValue ret = callPluginFunction("discoverThings", {jsInfo});
     if (ret.isError()) {
         qCWarning(dcThingManager()) << "discoverThings script failed to execute:\n" << ret.toString();
     }
@@ -146,8 +145,7 @@ void ScriptIntegrationPlugin::startPairing(ThingPairingInfo *info)
     ScriptThingPairingInfo *scriptInfo = new ScriptThingPairingInfo(info);
     QJSValue jsInfo = m_engine->newQObject(scriptInfo);
 
-    QJSValue startPairingFunction = m_pluginImport.property("startPairing");
-    QJSValue ret = startPairingFunction.call({jsInfo});
+    QJSValue ret = callPluginFunction("startPairing", {jsInfo});
     if (ret.isError()) {
         qCWarning(dcThingManager()) << "startPairing script failed to execute:\n" << ret.toString();
     }
@@ -163,8 +161,7 @@ void ScriptIntegrationPlugin::confirmPairing(ThingPairingInfo *info, const QStri
     ScriptThingPairingInfo *scriptInfo = new ScriptThingPairingInfo(info);
     QJSValue jsInfo = m_engine->newQObject(scriptInfo);
 
-    QJSValue confirmPairingFunction = m_pluginImport.property("confirmPairing");
-    QJSValue ret = confirmPairingFunction.call({jsInfo, username, secret});
+    QJSValue ret = callPluginFunction("confirmPairing", {jsInfo, username, secret});
     if (ret.isError()) {
         qCWarning(dcThingManager()) << "confirmPairing script failed to execute:\n" << ret.toString();
     }
@@ -177,8 +174,7 @@ void ScriptIntegrationPlugin::startMonitoringAutoThings()
         return;
     }
 
-    QJSValue monitorFunction = m_pluginImport.property("startMonitoringAutoThings");
-    QJSValue ret = monitorFunction.call();
+    QJSValue ret = callPluginFunction("startMonitoringAutoThings");
     if (ret.isError()) {
         qCWarning(dcThingManager()) << "startMonitoringAutoThings failed to execute:\n" << ret.toString();
     }
@@ -190,7 +186,6 @@ void ScriptIntegrationPlugin::setupThing(ThingSetupInfo *info)
         IntegrationPlugin::setupThing(info);
         return;
     }
-    QJSValue setupFunction = m_pluginImport.property("setupThing");
 
     Thing *thing = info->thing();
     ScriptThing *scriptThing = new ScriptThing(thing);
@@ -202,7 +197,7 @@ void ScriptIntegrationPlugin::setupThing(ThingSetupInfo *info)
     ScriptThingSetupInfo *scriptInfo = new ScriptThingSetupInfo(info, scriptThing);
 
     QJSValue jsInfo = m_engine->newQObject(scriptInfo);
-    QJSValue ret = setupFunction.call({jsInfo});
+    QJSValue ret = callPluginFunction("setupThing", {jsInfo});
 
     if (ret.errorType() != QJSValue::NoError) {
         qCWarning(dcThingManager()) << "setupThing script failed to execute:\n" << ret.toString();
@@ -215,10 +210,9 @@ void ScriptIntegrationPlugin::postSetupThing(Thing *thing)
         IntegrationPlugin::postSetupThing(thing);
         return;
     }
-    QJSValue postSetupFunction = m_pluginImport.property("postSetupThing");
 
     QJSValue jsThing = m_engine->newQObject(m_things.value(thing));
-    QJSValue ret = postSetupFunction.call({jsThing});
+    QJSValue ret = callPluginFunction("postSetupThing", {jsThing});
     if (ret.errorType() != QJSValue::NoError) {
         qCWarning(dcThingManager()) << "setupThing script failed to execute:\n" << ret.toString();
     }
@@ -233,8 +227,7 @@ void ScriptIntegrationPlugin::thingRemoved(Thing *thing)
 
     QJSValue jsThing = m_engine->newQObject(m_things.value(thing));
 
-    QJSValue thingRemovedFunction = m_pluginImport.property("thingRemoved");
-    QJSValue ret = thingRemovedFunction.call({jsThing});
+    QJSValue ret = callPluginFunction("thingRemoved", {jsThing});
     if (ret.isError()) {
         qCWarning(dcThingManager()) << "thingRemoved script failed to execute:\n" << ret.toString();
     }
@@ -253,9 +246,26 @@ void ScriptIntegrationPlugin::executeAction(ThingActionInfo *info)
     ScriptThingActionInfo *scriptInfo = new ScriptThingActionInfo(info, scriptThing);
     QJSValue jsInfo = m_engine->newQObject(scriptInfo);
 
-    QJSValue executeActionFunction = m_pluginImport.property("executeAction");
-    QJSValue ret = executeActionFunction.call({jsInfo});
+    QJSValue ret = callPluginFunction("executeAction", {jsInfo});
     if (ret.isError()) {
         qCWarning(dcThingManager()) << "executeAction script failed to execute:\n" << ret.toString();
     }
 }
+
+QVariantMap ScriptIntegrationPlugin::statistics() const
+{
+    QVariantMap statistics;
+    statistics.insert("calls", m_statistics.calls());
+    return statistics;
+}
+
+QJSValue ScriptIntegrationPlugin::callPluginFunction(const QString &function, const QJSValueList &args)
+{
+    // Plugin functions run synchronously in the main thread, there's no queue time
+    qint64 cpuStart = PluginStatistics::threadCpuTime();
+    QElapsedTimer timer;
+    timer.start();
+    QJSValue ret = m_pluginImport.property(function).call(args);
+    m_statistics.recordCall(function, 0, timer.nsecsElapsed() / 1000, PluginStatistics::threadCpuTime() - cpuStart);
+    return ret;
+}
@@ -32,6 +32,7 @@
 #define SCRIPTINTEGRATIONPLUGIN_H
 
 #include "integrations/integrationplugin.h"
+#include "pluginstatistics.h"
 
 #include <QQmlEngine>
 #include <QJsonObject>
@@ -182,10 +183,15 @@ public:
     void thingRemoved(Thing *thing) override;
     void executeAction(ThingActionInfo *info) override;
 
+    QVariantMap statistics() const;
+
 private:
+    QJSValue callPluginFunction(const QString &function, const QJSValueList &args = QJSValueList());
+
     QQmlEngine *m_engine = nullptr;
     QJSValue m_pluginImport;
     QHash<Thing*, ScriptThing*> m_things;
+    PluginStatistics m_statistics;
 };
 
 #endif // SCRIPTINTEGRATIONPLUGIN_H
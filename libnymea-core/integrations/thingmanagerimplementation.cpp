@@ -42,6 +42,8 @@
 #include "nymeasettings.h"
 #include "version.h"
 #include "plugininfocache.h"
+#include "pluginhostintegrationplugin.h"
+#include "startuptrace.h"
 
 #include "integrations/thingdiscoveryinfo.h"
 #include "integrations/thingpairinginfo.h"
@@ -53,6 +55,7 @@
 #include "integrations/browseritemresult.h"
 #include "integrations/browseractioninfo.h"
 #include "integrations/browseritemactioninfo.h"
+#include "integrations/timeoutwheel.h"
 
 #include "apikeysprovidersloader.h"
 
@@ -69,12 +72,62 @@
 #include <QStandardPaths>
 #include <QDir>
 #include <QJsonDocument>
+#include <QPointer>
+#include <QSemaphore>
+#include <QtConcurrent/QtConcurrent>
+
+#include <functional>
+
+// How long state changes may wait before they are written to the state cache
+static const int stateCacheFlushInterval = 60000;
+// Setups a plugin gets to run at once while the configured things are loaded
+static const int maxStartupSetupsPerPlugin = 4;
+// Children of a browser listing fetched ahead when clients are idle
+static const int maxBrowserPrefetches = 10;
+
+// Stands in for a plugin which isn't instantiated yet. It only provides the metadata and configuration.
+class DeferredIntegrationPlugin: public IntegrationPlugin
+{
+public:
+    DeferredIntegrationPlugin(const PluginMetadata &metadata, QObject *parent):
+        IntegrationPlugin(parent)
+    {
+        setMetaData(metadata);
+    }
+};
+
+#if defined(WITH_PYTHON) || QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+// Reads the metadata of a Python or JS plugin without loading the plugin itself
+static PluginMetadata scriptPluginMetadata(const QString &scriptFile)
+{
+    QFileInfo fi(scriptFile);
+    QString metaDataFileName = fi.absolutePath() + "/" + fi.baseName() + ".json";
+    QFile metaDataFile(metaDataFileName);
+    if (!metaDataFile.open(QFile::ReadOnly)) {
+        return PluginMetadata();
+    }
+    QJsonParseError error;
+    QJsonDocument jsonDoc = QJsonDocument::fromJson(metaDataFile.readAll(), &error);
+    if (error.error != QJsonParseError::NoError) {
+        return PluginMetadata();
+    }
+    PluginMetadata metadata = PluginInfoCache::loadPluginMetadata(metaDataFileName, jsonDoc.object());
+    if (!metadata.isValid()) {
+        metadata = PluginMetadata(jsonDoc.object());
+        if (metadata.isValid()) {
+            PluginInfoCache::cachePluginMetadata(metaDataFileName, metadata);
+        }
+    }
+    return metadata;
+}
+#endif
 
 ThingManagerImplementation::ThingManagerImplementation(HardwareManager *hardwareManager, const QLocale &locale, QObject *parent) :
     ThingManager(parent),
     m_hardwareManager(hardwareManager),
     m_locale(locale),
-    m_translator(new Translator(this))
+    m_translator(new Translator(this)),
+    m_timeoutWheel(new TimeoutWheel(100, 512, this))
 {
     foreach (const Interface &interface, ThingUtils::allInterfaces()) {
         m_supportedInterfaces.insert(interface.name(), interface);
@@ -90,8 +143,40 @@ ThingManagerImplementation::ThingManagerImplementation(HardwareManager *hardware
         oldStateFile.copy(settingsPath + "/thingstates.conf");
     }
 
+    // Changes can only be appended to the journal of a valid snapshot. Changes appended after a broken
+    // journal entry would be lost as well.
+    m_stateSnapshotRewrite = !m_stateCache.open() || m_stateCache.journalTruncated();
+
+    // Migrate the state cache from thingstates.conf to the binary snapshot
+    if (!m_stateCache.isOpen() && QFile::exists(NymeaSettings(NymeaSettings::SettingsRoleThingStates).fileName())) {
+        qCDebug(dcThingManager()) << "Migrating thing states from" << NymeaSettings(NymeaSettings::SettingsRoleThingStates).fileName() << "to" << m_stateCache.fileName();
+        m_stateSnapshot = ThingStateCache::loadLegacySettings();
+    }
+
     m_apiKeysProvidersLoader = new ApiKeysProvidersLoader(this);
 
+    // Prefetching browser items waits until clients stopped browsing for a moment
+    m_browserPrefetchTimer = new QTimer(this);
+    m_browserPrefetchTimer->setSingleShot(true);
+    m_browserPrefetchTimer->setInterval(500);
+    connect(m_browserPrefetchTimer, &QTimer::timeout, this, &ThingManagerImplementation::prefetchBrowserItems);
+
+    m_thingConfigTimer = new QTimer(this);
+    m_thingConfigTimer->setSingleShot(true);
+    m_thingConfigTimer->setInterval(0);
+    connect(m_thingConfigTimer, &QTimer::timeout, this, &ThingManagerImplementation::storeConfiguredThings);
+
+    // State changes are written to the state cache in batches, off the main thread
+    m_stateCacheTimer = new QTimer(this);
+    m_stateCacheTimer->setSingleShot(true);
+    m_stateCacheTimer->setInterval(stateCacheFlushInterval);
+    connect(m_stateCacheTimer, &QTimer::timeout, this, &ThingManagerImplementation::flushThingStates);
+    connect(&m_stateCacheWatcher, &QFutureWatcher<void>::finished, this, [this](){
+        if (!m_dirtyStates.isEmpty() || !m_changedStateThings.isEmpty() || !m_removedStateThings.isEmpty() || m_stateSnapshotRewrite) {
+            m_stateCacheTimer->start();
+        }
+    });
+
     // Give hardware a chance to start up before loading plugins etc.
     QMetaObject::invokeMethod(this, "loadPlugins", Qt::QueuedConnection);
     QMetaObject::invokeMethod(this, "loadConfiguredThings", Qt::QueuedConnection);
@@ -110,10 +195,20 @@ ThingManagerImplementation::~ThingManagerImplementation()
 
     delete m_translator;
 
+    storeConfiguredThings();
     foreach (Thing *thing, m_configuredThings) {
         storeThingStates(thing);
-        delete thing;
     }
+    m_stateCacheWatcher.waitForFinished();
+    if (collectDirtyStates()) {
+        if (m_stateSnapshotRewrite) {
+            ThingStateCache::write(m_stateCache.fileName(), m_stateSnapshot);
+        } else {
+            ThingStateCache::writeChanges(m_stateCache.fileName(), m_stateSnapshot, m_changedStateThings.values(), m_removedStateThings.values());
+        }
+    }
+    stopPluginThreads();
+    qDeleteAll(m_configuredThings);
 
     foreach (IntegrationPlugin *plugin, m_integrationPlugins) {
         if (plugin->parent() == this) {
@@ -129,6 +224,33 @@ ThingManagerImplementation::~ThingManagerImplementation()
 #endif
 }
 
+// The plugin thread may still work with an info after it finished. Delete it only once that
+// thread has processed everything queued for it up to then.
+template <typename T>
+void ThingManagerImplementation::releaseInPluginThread(IntegrationPlugin *plugin, T *info)
+{
+    if (!m_pluginThreads.contains(plugin->pluginId())) {
+        return;
+    }
+    disconnect(info, &T::finished, info, &T::deleteLater);
+    connect(info, &T::finished, this, [plugin, info](){
+        QTimer::singleShot(0, plugin, [info](){ info->deleteLater(); });
+    });
+}
+
+template <typename T>
+void ThingManagerImplementation::callPlugin(IntegrationPlugin *plugin, T *info, const std::function<void()> &call)
+{
+    releaseInPluginThread(plugin, info);
+    callPlugin(plugin, call);
+}
+
+void ThingManagerImplementation::setPluginHostConfiguration(const QStringList &hostedPlugins, const QString &hostCommand)
+{
+    m_hostedPlugins = hostedPlugins;
+    m_pluginHostCommand = hostCommand;
+}
+
 QStringList ThingManagerImplementation::pluginSearchDirs()
 {
     QStringList searchDirs;
@@ -201,6 +323,9 @@ void ThingManagerImplementation::registerStaticPlugin(IntegrationPlugin *plugin)
         qCWarning(dcThingManager()) << "Plugin metadata not valid. Not loading static plugin:" << plugin->pluginName();
         return;
     }
+    if (plugin->metadata().workerThread()) {
+        m_workerThreadPlugins.insert(plugin->pluginId());
+    }
     loadPlugin(plugin);
 }
 
@@ -227,7 +352,8 @@ Thing::ThingError ThingManagerImplementation::setPluginConfig(const PluginId &pl
         return verify;
     ParamList params = buildParams(plugin->configurationDescription(), pluginConfig);
 
-    Thing::ThingError result = plugin->setConfiguration(params);
+    Thing::ThingError result = Thing::ThingErrorNoError;
+    callPlugin(plugin, [plugin, params, &result](){ result = plugin->setConfiguration(params); }, true);
     if (result != Thing::ThingErrorNoError)
         return result;
 
@@ -285,7 +411,7 @@ ThingDiscoveryInfo* ThingManagerImplementation::discoverThings(const ThingClassI
         discoveryInfo->finish(Thing::ThingErrorCreationMethodNotSupported);
         return discoveryInfo;
     }
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thingClass.pluginId());
     if (!plugin) {
         qCWarning(dcThingManager) << "Thing discovery failed. Plugin not found for thing class" << thingClass.name();
         ThingDiscoveryInfo *discoveryInfo = new ThingDiscoveryInfo(thingClassId, params, this);
@@ -303,13 +429,9 @@ ThingDiscoveryInfo* ThingManagerImplementation::discoverThings(const ThingClassI
     ParamList effectiveParams = buildParams(thingClass.discoveryParamTypes(), params);
 
     ThingDiscoveryInfo *discoveryInfo = new ThingDiscoveryInfo(thingClassId, effectiveParams, this, 30000);
-    connect(discoveryInfo, &ThingDiscoveryInfo::finished, this, [this, discoveryInfo](){
-        if (discoveryInfo->status() != Thing::ThingErrorNoError) {
-            qCWarning(dcThingManager()) << "Discovery failed:" << discoveryInfo->status() << discoveryInfo->displayMessage();
-            return;
-        }
-        qCDebug(dcThingManager()) << "Discovery finished. Found things:" << discoveryInfo->thingDescriptors().count();
-        foreach (const ThingDescriptor &descriptor, discoveryInfo->thingDescriptors()) {
+    // Results can be added right away, before the discovery is finished
+    connect(discoveryInfo, &ThingDiscoveryInfo::thingDescriptorsAdded, this, [this](const ThingDescriptors &descriptors){
+        foreach (const ThingDescriptor &descriptor, descriptors) {
             if (!descriptor.isValid()) {
                 qCWarning(dcThingManager()) << "Descriptor is invalid. Not adding to results";
                 continue;
@@ -317,9 +439,16 @@ ThingDiscoveryInfo* ThingManagerImplementation::discoverThings(const ThingClassI
             m_discoveredThings.insert(descriptor.id(), descriptor);
         }
     });
+    connect(discoveryInfo, &ThingDiscoveryInfo::finished, this, [discoveryInfo](){
+        if (discoveryInfo->status() != Thing::ThingErrorNoError) {
+            qCWarning(dcThingManager()) << "Discovery failed:" << discoveryInfo->status() << discoveryInfo->displayMessage();
+            return;
+        }
+        qCDebug(dcThingManager()) << "Discovery finished. Found things:" << discoveryInfo->thingDescriptors().count();
+    });
 
     qCDebug(dcThingManager) << "Thing discovery for" << thingClass.name() << "started...";
-    plugin->discoverThings(discoveryInfo);
+    callPlugin(plugin, discoveryInfo, [plugin, discoveryInfo](){ plugin->discoverThings(discoveryInfo); });
     return discoveryInfo;
 }
 
@@ -453,7 +582,7 @@ ThingSetupInfo *ThingManagerImplementation::reconfigureThingInternal(Thing *thin
 
     // try to setup the thing with the new params
     ThingSetupInfo *info = new ThingSetupInfo(thing, this, 30000);
-    plugin->setupThing(info);
+    callPlugin(plugin, info, [plugin, info](){ plugin->setupThing(info); });
     connect(info, &ThingSetupInfo::destroyed, thing, [=](){
         m_pendingSetups.remove(thing->id());
     });
@@ -467,7 +596,7 @@ ThingSetupInfo *ThingManagerImplementation::reconfigureThingInternal(Thing *thin
             return;
         }
 
-        storeConfiguredThings();
+        storeConfiguredThing(info->thing());
 
         postSetupThing(info->thing());
         info->thing()->setSetupStatus(Thing::ThingSetupStatusComplete, Thing::ThingErrorNoError);
@@ -516,7 +645,7 @@ Thing::ThingError ThingManagerImplementation::setEventLogging(const ThingId &thi
         qCWarning(dcThingManager()) << "Cannot configure event logging. Thing" << thingId.toString() << "not found";
         return Thing::ThingErrorThingNotFound;
     }
-    if (!thing->thingClass().eventTypes().findById(eventTypeId).isValid()) {
+    if (!thing->thingClass().getEventType(eventTypeId).isValid()) {
         qCWarning(dcThingManager()) << "Cannot configure event logging. Thing" << thingId.toString() << "has no event type with id" << eventTypeId;
         return Thing::ThingErrorEventTypeNotFound;
     }
@@ -540,7 +669,7 @@ Thing::ThingError ThingManagerImplementation::setStateFilter(const ThingId &thin
         qCWarning(dcThingManager()) << "Cannot configure state filter. Thing" << thingId.toString() << "not found";
         return Thing::ThingErrorThingNotFound;
     }
-    if (!thing->thingClass().stateTypes().findById(stateTypeId).isValid()) {
+    if (!thing->thingClass().getStateType(stateTypeId).isValid()) {
         qCWarning(dcThingManager()) << "Cannot configure state filter. Thing" << thingId.toString() << "has no state type with id" << stateTypeId;
         return Thing::ThingErrorEventTypeNotFound;
     }
@@ -550,6 +679,23 @@ Thing::ThingError ThingManagerImplementation::setStateFilter(const ThingId &thin
     return Thing::ThingErrorNoError;
 }
 
+Thing::ThingError ThingManagerImplementation::setStateChangePolicy(const ThingId &thingId, const StateTypeId &stateTypeId, const StateChangePolicy &policy)
+{
+    Thing *thing = m_configuredThings.value(thingId);
+    if (!thing) {
+        qCWarning(dcThingManager()) << "Cannot configure state change policy. Thing" << thingId.toString() << "not found";
+        return Thing::ThingErrorThingNotFound;
+    }
+    if (!thing->thingClass().getStateType(stateTypeId).isValid()) {
+        qCWarning(dcThingManager()) << "Cannot configure state change policy. Thing" << thingId.toString() << "has no state type with id" << stateTypeId;
+        return Thing::ThingErrorEventTypeNotFound;
+    }
+
+    thing->setStateChangePolicy(stateTypeId, policy);
+    emit thingChanged(thing);
+    return Thing::ThingErrorNoError;
+}
+
 ThingPairingInfo* ThingManagerImplementation::pairThing(const ThingClassId &thingClassId, const ParamList &params, const QString &name)
 {
     PairingTransactionId transactionId = PairingTransactionId::createPairingTransactionId();
@@ -639,7 +785,7 @@ ThingPairingInfo *ThingManagerImplementation::confirmPairing(const PairingTransa
     ThingClassId thingClassId = context.thingClassId;
 
     ThingClass thingClass = m_supportedThings.value(thingClassId);
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thingClass.pluginId());
     if (!plugin) {
         qCWarning(dcThingManager) << "Can't find a plugin for this thing class:" << thingClass;
         ThingPairingInfo *info = new ThingPairingInfo(pairingTransactionId, thingClassId, context.thingId, context.thingName, context.params, context.parentId, this);
@@ -656,7 +802,7 @@ ThingPairingInfo *ThingManagerImplementation::confirmPairing(const PairingTransa
     // both, the internal pairing and the setup have completed.
     ThingPairingInfo *internalInfo = new ThingPairingInfo(pairingTransactionId, thingClassId, thingId, context.thingName, context.params, context.parentId, this);
     ThingPairingInfo *externalInfo = new ThingPairingInfo(pairingTransactionId, thingClassId, thingId, context.thingName, context.params, context.parentId, this);
-    plugin->confirmPairing(internalInfo, username, secret);
+    callPlugin(plugin, internalInfo, [plugin, internalInfo, username, secret](){ plugin->confirmPairing(internalInfo, username, secret); });
 
     connect(internalInfo, &ThingPairingInfo::finished, this, [this, internalInfo, externalInfo, plugin, addNewThing](){
 
@@ -706,7 +852,7 @@ ThingPairingInfo *ThingManagerImplementation::confirmPairing(const PairingTransa
                     qCWarning(dcThingManager()) << "Failed to set up thing" << info->thing()->name()
                                                  << "Not adding thing to the system. Error:"
                                                   << info->status() << info->displayMessage();
-                    info->thing()->deleteLater();
+                    deleteThingLater(info->thing());
 
                 } else {
                     qCWarning(dcThingManager()) << "Failed to reconfigure thing" << info->thing()->name() <<
@@ -725,10 +871,11 @@ ThingPairingInfo *ThingManagerImplementation::confirmPairing(const PairingTransa
                 qCDebug(dcThingManager()) << "Thing added:" << info->thing();
                 registerThing(info->thing());
                 emit thingAdded(info->thing());
+                emit thingsAdded({info->thing()});
             } else {
                 emit thingChanged(info->thing());
             }
-            storeConfiguredThings();
+            storeConfiguredThing(info->thing());
 
             postSetupThing(info->thing());
         });
@@ -761,7 +908,7 @@ ThingSetupInfo* ThingManagerImplementation::addConfiguredThingInternal(const Thi
         thingId = ThingId::createThingId();
     }
 
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thingClass.pluginId());
     if (!plugin) {
         qCWarning(dcThingManager()) << "Cannot add thing. Plugin for thing class" << thingClass.name() << "not found.";
         ThingSetupInfo *info = new ThingSetupInfo(nullptr, this);
@@ -799,7 +946,7 @@ ThingSetupInfo* ThingManagerImplementation::addConfiguredThingInternal(const Thi
     connect(info, &ThingSetupInfo::finished, this, [this, info](){
         if (info->status() != Thing::ThingErrorNoError) {
             qCWarning(dcThingManager) << "Thing setup failed. Not adding thing to system.";
-            info->thing()->deleteLater();
+            deleteThingLater(info->thing());
             return;
         }
 
@@ -807,8 +954,9 @@ ThingSetupInfo* ThingManagerImplementation::addConfiguredThingInternal(const Thi
 
         qCDebug(dcThingManager) << "Thing setup complete.";
         registerThing(info->thing());
-        storeConfiguredThings();
+        storeConfiguredThing(info->thing());
         emit thingAdded(info->thing());
+        emit thingsAdded({info->thing()});
         postSetupThing(info->thing());
     });
 
@@ -822,10 +970,27 @@ Thing::ThingError ThingManagerImplementation::removeConfiguredThing(const ThingI
     // don't end up aborting an already finished setup instead of calling thingRemoved() on it.
     qApp->processEvents();
 
-    Thing *thing = m_configuredThings.take(thingId);
+    Thing *thing = m_configuredThings.value(thingId);
     if (!thing) {
         return Thing::ThingErrorThingNotFound;
     }
+    unregisterThing(thing);
+
+    m_browserCache.invalidate(thingId);
+
+    // Actions waiting for a coalesced one in flight won't be executed any more
+    QHash<QPair<ThingId, ActionTypeId>, CoalescedAction>::iterator it = m_coalescedActions.begin();
+    while (it != m_coalescedActions.end()) {
+        if (it.key().first != thingId) {
+            ++it;
+            continue;
+        }
+        if (!it->pending.isNull() && !it->pending->isFinished()) {
+            it->pending->finish(Thing::ThingErrorThingNotFound);
+        }
+        it = m_coalescedActions.erase(it);
+    }
+
     IntegrationPlugin *plugin = m_integrationPlugins.value(thing->pluginId());
     if (!plugin) {
         qCWarning(dcThingManager()).nospace() << "Plugin not loaded for thing " << thing->name() << ". Not calling thingRemoved on plugin.";
@@ -834,10 +999,10 @@ Thing::ThingError ThingManagerImplementation::removeConfiguredThing(const ThingI
         ThingSetupInfo *setupInfo = m_pendingSetups.value(thingId);
         emit setupInfo->aborted();
     } else if (thing->setupStatus() == Thing::ThingSetupStatusComplete) {
-        plugin->thingRemoved(thing);
+        callPlugin(plugin, [plugin, thing](){ plugin->thingRemoved(thing); }, true);
     }
 
-    thing->deleteLater();
+    deleteThingLater(thing);
 
     NymeaSettings settings(NymeaSettings::SettingsRoleThings);
     settings.beginGroup("ThingConfig");
@@ -845,8 +1010,16 @@ Thing::ThingError ThingManagerImplementation::removeConfiguredThing(const ThingI
     settings.remove("");
     settings.endGroup();
 
-    NymeaSettings stateCache(NymeaSettings::SettingsRoleThingStates);
-    stateCache.remove(thingId.toString());
+    // Don't let a pending write bring the removed thing or its states back
+    m_dirtyThings.remove(thingId);
+    m_dirtyStates.remove(thingId);
+    if (m_stateSnapshot.remove(thingId) > 0) {
+        m_changedStateThings.remove(thingId);
+        m_removedStateThings.insert(thingId);
+        if (!m_stateCacheTimer->isActive() && !m_stateCacheWatcher.isRunning()) {
+            m_stateCacheTimer->start();
+        }
+    }
 
     foreach (const IOConnectionId &ioConnectionId, m_ioConnections.keys()) {
         IOConnection ioConnection = m_ioConnections.value(ioConnectionId);
@@ -861,6 +1034,12 @@ Thing::ThingError ThingManagerImplementation::removeConfiguredThing(const ThingI
 }
 
 BrowseResult *ThingManagerImplementation::browseThing(const ThingId &thingId, const QString &itemId, const QLocale &locale)
+{
+    m_browserPrefetchTimer->start();
+    return browseThingInternal(thingId, itemId, locale, false);
+}
+
+BrowseResult *ThingManagerImplementation::browseThingInternal(const ThingId &thingId, const QString &itemId, const QLocale &locale, bool prefetch)
 {
     Thing *thing = m_configuredThings.value(thingId);
 
@@ -889,10 +1068,41 @@ BrowseResult *ThingManagerImplementation::browseThing(const ThingId &thingId, co
         return result;
     }
 
-    plugin->browseThing(result);
-    connect(result, &BrowseResult::finished, this, [result](){
+    BrowserItems cachedItems;
+    if (m_browserCache.lookup(BrowserCache::KindItems, thingId, itemId, locale, &cachedItems)) {
+        qCDebug(dcThingManager()) << "Browsing" << thing->name() << itemId << "from cache";
+        result->addItems(cachedItems);
+        result->finish(Thing::ThingErrorNoError);
+        return result;
+    }
+
+    callPlugin(plugin, result, [plugin, result](){ plugin->browseThing(result); });
+    connect(result, &BrowseResult::finished, this, [this, result, thingId, prefetch](){
         if (result->status() != Thing::ThingErrorNoError) {
             qCWarning(dcThingManager()) << "Browse thing failed:" << result->status();
+            return;
+        }
+        if (result->cacheTimeout() == 0) {
+            return;
+        }
+        m_browserCache.insert(BrowserCache::KindItems, thingId, result->itemId(), result->locale(), result->items(), result->cacheTimeout());
+
+        // Clients are likely to open one of the children next. Prefetching stays one level deep and
+        // follows the latest listing only.
+        if (!prefetch) {
+            m_browserPrefetchQueue.clear();
+            foreach (const BrowserItem &item, result->items()) {
+                if (m_browserPrefetchQueue.count() >= maxBrowserPrefetches) {
+                    break;
+                }
+                if (item.browsable()) {
+                    BrowserPrefetch child;
+                    child.thingId = thingId;
+                    child.itemId = item.id();
+                    child.locale = result->locale();
+                    m_browserPrefetchQueue.append(child);
+                }
+            }
         }
     });
     return result;
@@ -927,15 +1137,43 @@ BrowserItemResult *ThingManagerImplementation::browserItemDetails(const ThingId
         return result;
     }
 
-    plugin->browserItem(result);
-    connect(result, &BrowserItemResult::finished, this, [result](){
+    BrowserItems cachedItems;
+    if (m_browserCache.lookup(BrowserCache::KindDetails, thingId, itemId, locale, &cachedItems) && !cachedItems.isEmpty()) {
+        qCDebug(dcThingManager()) << "Browser item details of" << thing->name() << itemId << "from cache";
+        result->finish(cachedItems.first());
+        return result;
+    }
+
+    callPlugin(plugin, result, [plugin, result](){ plugin->browserItem(result); });
+    connect(result, &BrowserItemResult::finished, this, [this, result, thingId](){
         if (result->status() != Thing::ThingErrorNoError) {
             qCWarning(dcThingManager()) << "Browsing thing failed:" << result->status();
+            return;
         }
+        m_browserCache.insert(BrowserCache::KindDetails, thingId, result->itemId(), result->locale(), BrowserItems() << result->item(), result->cacheTimeout());
     });
     return result;
 }
 
+void ThingManagerImplementation::prefetchBrowserItems()
+{
+    while (!m_browserPrefetchQueue.isEmpty()) {
+        BrowserPrefetch next = m_browserPrefetchQueue.takeFirst();
+        if (m_browserCache.contains(BrowserCache::KindItems, next.thingId, next.itemId, next.locale)) {
+            continue;
+        }
+        qCDebug(dcThingManager()) << "Prefetching browser item" << next.itemId << "of thing" << next.thingId.toString();
+        BrowseResult *result = browseThingInternal(next.thingId, next.itemId, next.locale, true);
+        // One at a time, so the plugin isn't flooded
+        connect(result, &BrowseResult::finished, this, [this](){
+            if (!m_browserPrefetchTimer->isActive()) {
+                m_browserPrefetchTimer->start();
+            }
+        });
+        return;
+    }
+}
+
 BrowserActionInfo* ThingManagerImplementation::executeBrowserItem(const BrowserAction &browserAction)
 {
     Thing *thing = m_configuredThings.value(browserAction.thingId());
@@ -964,7 +1202,7 @@ BrowserActionInfo* ThingManagerImplementation::executeBrowserItem(const BrowserA
         info->finish(Thing::ThingErrorUnsupportedFeature);
         return info;
     }
-    plugin->executeBrowserItem(info);
+    callPlugin(plugin, info, [plugin, info](){ plugin->executeBrowserItem(info); });
     return info;
 }
 
@@ -998,7 +1236,12 @@ BrowserItemActionInfo* ThingManagerImplementation::executeBrowserItemAction(cons
     }
     // TODO: check browserItemAction.params with ThingClass
 
-    plugin->executeBrowserItemAction(info);
+    callPlugin(plugin, info, [plugin, info](){ plugin->executeBrowserItemAction(info); });
+    // Context actions like deleting or moving items may change any listing of the thing
+    ThingId thingId = thing->id();
+    connect(info, &BrowserItemActionInfo::finished, this, [this, thingId](){
+        m_browserCache.invalidate(thingId);
+    });
     return info;
 }
 
@@ -1032,7 +1275,7 @@ IOConnectionResult ThingManagerImplementation::connectIO(const IOConnection &con
         result.error = Thing::ThingErrorStateTypeNotFound;
         return result;
     }
-    StateType inputStateType = inputThing->thingClass().stateTypes().findById(connection.inputStateTypeId());
+    StateType inputStateType = inputThing->thingClass().getStateType(connection.inputStateTypeId());
 
     // Check if this is actually an input
     if (inputStateType.ioType() != Types::IOTypeDigitalInput && inputStateType.ioType() != Types::IOTypeAnalogInput) {
@@ -1052,7 +1295,7 @@ IOConnectionResult ThingManagerImplementation::connectIO(const IOConnection &con
         result.error = Thing::ThingErrorStateTypeNotFound;
         return result;
     }
-    StateType outputStateType = outputThing->thingClass().stateTypes().findById(connection.outputStateTypeId());
+    StateType outputStateType = outputThing->thingClass().getStateType(connection.outputStateTypeId());
 
     // Check if this is actually an output
     if (outputStateType.ioType() != Types::IOTypeDigitalOutput && outputStateType.ioType() != Types::IOTypeAnalogOutput) {
@@ -1074,22 +1317,20 @@ IOConnectionResult ThingManagerImplementation::connectIO(const IOConnection &con
     }
 
     // Check if either input or output is already connected
-    foreach (const IOConnectionId &id, m_ioConnections.keys()) {
-        if (m_ioConnections.value(id).inputThingId() == connection.inputThingId() && m_ioConnections.value(id).inputStateTypeId() == connection.inputStateTypeId()) {
-            qCDebug(dcThingManager()).nospace() << "Thing " << inputThing->name() << " already has an IO connection on " << inputStateType.displayName() << ". Replacing old connection.";
-            disconnectIO(id);
-            continue;
-        }
-        if (m_ioConnections.value(id).outputThingId() == connection.outputThingId() && m_ioConnections.value(id).outputStateTypeId() == connection.outputStateTypeId()) {
+    QList<IORoute> connectedRoutes = m_ioRoutesByInput.value(qMakePair(connection.inputThingId(), connection.inputStateTypeId()));
+    connectedRoutes.append(m_ioRoutesByOutput.value(qMakePair(connection.outputThingId(), connection.outputStateTypeId())));
+    foreach (const IORoute &route, connectedRoutes) {
+        if (m_ioConnections.contains(route.connection.id())) {
             qCDebug(dcThingManager()).nospace() << "Thing " << inputThing->name() << " already has an IO connection on " << inputStateType.displayName() << ". Replacing old connection.";
-            disconnectIO(id);
+            disconnectIO(route.connection.id());
         }
     }
 
     // Finally add the connection
     m_ioConnections.insert(connection.id(), connection);
+    addIORoute(connection);
 
-    storeIOConnections();
+    storeIOConnection(connection);
 
     emit ioConnectionAdded(connection);
 
@@ -1109,7 +1350,7 @@ Thing::ThingError ThingManagerImplementation::disconnectIO(const IOConnectionId
         qCWarning(dcThingManager()) << "IO connection" << ioConnectionId << "not found. Cannot disconnect.";
         return Thing::ThingErrorItemNotFound;
     }
-    m_ioConnections.remove(ioConnectionId);
+    removeIORoute(m_ioConnections.take(ioConnectionId));
 
     NymeaSettings settings(NymeaSettings::SettingsRoleIOConnections);
     settings.beginGroup("IOConnections");
@@ -1157,6 +1398,16 @@ ActionType ThingManagerImplementation::translateActionType(const PluginId &plugi
 
 ThingClass ThingManagerImplementation::translateThingClass(const ThingClass &thingClass, const QLocale &locale)
 {
+    // Thing classes of loaded plugins only change when the plugin gets loaded, memoize their translations
+    QHash<ThingClassId, ThingClass> *cache = nullptr;
+    if (m_supportedThings.contains(thingClass.id()) && m_integrationPlugins.contains(thingClass.pluginId())) {
+        cache = &m_translationCache[thingClass.pluginId()].thingClasses[locale.name()];
+        QHash<ThingClassId, ThingClass>::const_iterator it = cache->constFind(thingClass.id());
+        if (it != cache->constEnd()) {
+            return it.value();
+        }
+    }
+
     ThingClass translatedThingClass = thingClass;
     translatedThingClass.setDisplayName(translate(thingClass.pluginId(), thingClass.displayName(), locale));
 
@@ -1190,34 +1441,39 @@ ThingClass ThingManagerImplementation::translateThingClass(const ThingClass &thi
     }
     translatedThingClass.setActionTypes(translatedActionTypes);
 
+    if (cache) {
+        cache->insert(thingClass.id(), translatedThingClass);
+    }
     return translatedThingClass;
 }
 
 Vendor ThingManagerImplementation::translateVendor(const Vendor &vendor, const QLocale &locale)
 {
-    IntegrationPlugin *plugin = nullptr;
-    foreach (IntegrationPlugin *p, m_integrationPlugins) {
-        if (p->supportedVendors().contains(vendor)) {
-            plugin = p;
-        }
-    }
-    if (!plugin) {
+    PluginId pluginId = m_vendorPlugins.value(vendor.id());
+    if (pluginId.isNull() || !m_integrationPlugins.contains(pluginId)) {
         return vendor;
     }
 
+    QHash<VendorId, Vendor> &cache = m_translationCache[pluginId].vendors[locale.name()];
+    QHash<VendorId, Vendor>::const_iterator it = cache.constFind(vendor.id());
+    if (it != cache.constEnd()) {
+        return it.value();
+    }
+
     Vendor translatedVendor = vendor;
-    translatedVendor.setDisplayName(translate(plugin->pluginId(), vendor.displayName(), locale));
+    translatedVendor.setDisplayName(translate(pluginId, vendor.displayName(), locale));
+    cache.insert(vendor.id(), translatedVendor);
     return translatedVendor;
 }
 
+TimeoutWheel *ThingManagerImplementation::timeoutWheel() const
+{
+    return m_timeoutWheel;
+}
+
 Thing *ThingManagerImplementation::findConfiguredThing(const ThingId &id) const
 {
-    foreach (Thing *thing, m_configuredThings) {
-        if (thing->id() == id) {
-            return thing;
-        }
-    }
-    return nullptr;
+    return m_configuredThings.value(id);
 }
 
 Things ThingManagerImplementation::configuredThings() const
@@ -1227,36 +1483,17 @@ Things ThingManagerImplementation::configuredThings() const
 
 Things ThingManagerImplementation::findConfiguredThings(const ThingClassId &thingClassId) const
 {
-    QList<Thing*> ret;
-    foreach (Thing *thing, m_configuredThings) {
-        if (thing->thingClassId() == thingClassId) {
-            ret << thing;
-        }
-    }
-    return ret;
+    return m_thingsByThingClass.value(thingClassId);
 }
 
 Things ThingManagerImplementation::findConfiguredThings(const QString &interface) const
 {
-    QList<Thing*> ret;
-    foreach (Thing *thing, m_configuredThings) {
-        ThingClass thingClass = m_supportedThings.value(thing->thingClassId());
-        if (thingClass.interfaces().contains(interface)) {
-            ret.append(thing);
-        }
-    }
-    return ret;
+    return m_thingsByInterface.value(interface);
 }
 
 Things ThingManagerImplementation::findChilds(const ThingId &id) const
 {
-    QList<Thing *> ret;
-    foreach (Thing *d, m_configuredThings) {
-        if (d->parentId() == id) {
-            ret.append(d);
-        }
-    }
-    return ret;
+    return m_childThings.value(id);
 }
 
 ThingClass ThingManagerImplementation::findThingClass(const ThingClassId &thingClassId) const
@@ -1271,6 +1508,54 @@ ThingClass ThingManagerImplementation::findThingClass(const ThingClassId &thingC
 
 ThingActionInfo *ThingManagerImplementation::executeAction(const Action &action)
 {
+    IntegrationPlugin *plugin = nullptr;
+    ThingActionInfo *info = prepareAction(action, &plugin);
+    if (plugin) {
+        callPlugin(plugin, info, [plugin, info](){ plugin->executeAction(info); });
+    }
+    return info;
+}
+
+/*! Executes all the given \a actions at once. The actions are verified first and then handed to the plugins in one
+    batch per plugin, see \l{IntegrationPlugin::executeActions}. The returned infos are in the order of \a actions. */
+QList<ThingActionInfo *> ThingManagerImplementation::executeActions(const QList<Action> &actions)
+{
+    QList<ThingActionInfo*> infos;
+    // Keeping the plugins in the order they're first used
+    QList<IntegrationPlugin*> plugins;
+    QHash<IntegrationPlugin*, QList<ThingActionInfo*>> batches;
+    foreach (const Action &action, actions) {
+        IntegrationPlugin *plugin = nullptr;
+        ThingActionInfo *info = prepareAction(action, &plugin);
+        infos.append(info);
+        if (!plugin) {
+            continue;
+        }
+        if (!batches.contains(plugin)) {
+            plugins.append(plugin);
+        }
+        batches[plugin].append(info);
+    }
+
+    foreach (IntegrationPlugin *plugin, plugins) {
+        QList<ThingActionInfo*> batch = batches.value(plugin);
+        if (batch.count() == 1) {
+            ThingActionInfo *info = batch.first();
+            callPlugin(plugin, info, [plugin, info](){ plugin->executeAction(info); });
+        } else {
+            qCDebug(dcThingManager()) << "Executing" << batch.count() << "actions in plugin" << plugin->pluginName();
+            foreach (ThingActionInfo *info, batch) {
+                releaseInPluginThread(plugin, info);
+            }
+            callPlugin(plugin, [plugin, batch](){ plugin->executeActions(batch); });
+        }
+    }
+    return infos;
+}
+
+ThingActionInfo *ThingManagerImplementation::prepareAction(const Action &action, IntegrationPlugin **plugin)
+{
+    *plugin = nullptr;
     Action finalAction = action;
     Thing *thing = m_configuredThings.value(action.thingId());
     if (!thing) {
@@ -1289,7 +1574,7 @@ ThingActionInfo *ThingManagerImplementation::executeAction(const Action &action)
 
     // Make sure this thing has an action type with this id
     ThingClass thingClass = findThingClass(thing->thingClassId());
-    ActionType actionType = thingClass.actionTypes().findById(action.actionTypeId());
+    ActionType actionType = thingClass.getActionType(action.actionTypeId());
     if (actionType.id().isNull()) {
         qCWarning(dcThingManager()) << "Cannot execute action. No such action type" << action.actionTypeId();
         ThingActionInfo *info = new ThingActionInfo(thing, action, this);
@@ -1300,7 +1585,7 @@ ThingActionInfo *ThingManagerImplementation::executeAction(const Action &action)
     // If there's a stateType with the same id, we'll need to take min/max values from the state as
     // they might change at runtime
     ParamTypes paramTypes = actionType.paramTypes();
-    StateType stateType = thingClass.stateTypes().findById(action.actionTypeId());
+    StateType stateType = thingClass.getStateType(action.actionTypeId());
     if (!stateType.id().isNull()) {
         ParamType pt = actionType.paramTypes().at(0);
         pt.setMinValue(thing->state(stateType.id()).minValue());
@@ -1320,8 +1605,8 @@ ThingActionInfo *ThingManagerImplementation::executeAction(const Action &action)
 
     ThingActionInfo *info = new ThingActionInfo(thing, finalAction, this, 30000);
 
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thing->pluginId());
-    if (!plugin) {
+    IntegrationPlugin *targetPlugin = m_integrationPlugins.value(thing->pluginId());
+    if (!targetPlugin) {
         qCWarning(dcThingManager()) << "Cannot execute action. Plugin not found for device" << thing->name();
         info->finish(Thing::ThingErrorPluginNotFound);
         return info;
@@ -1331,11 +1616,64 @@ ThingActionInfo *ThingManagerImplementation::executeAction(const Action &action)
         emit actionExecuted(action, info->status());
     });
 
-    plugin->executeAction(info);
+    if (actionType.coalesce() && !startCoalescedAction(info)) {
+        return info;
+    }
 
+    *plugin = targetPlugin;
     return info;
 }
 
+bool ThingManagerImplementation::startCoalescedAction(ThingActionInfo *info)
+{
+    QPair<ThingId, ActionTypeId> key(info->thing()->id(), info->action().actionTypeId());
+    CoalescedAction &coalescedAction = m_coalescedActions[key];
+    if (coalescedAction.running.isNull()) {
+        coalescedAction.running = info;
+        connect(info, &ThingActionInfo::finished, this, [this, key](){
+            coalescedActionFinished(key);
+        });
+        return true;
+    }
+
+    // Latest wins, an action still waiting is replaced without ever reaching the plugin
+    if (!coalescedAction.pending.isNull() && !coalescedAction.pending->isFinished()) {
+        qCDebug(dcThingManager()) << "Action" << coalescedAction.pending->action().actionTypeId() << "on" << info->thing()->name() << "superseded by a newer one";
+        coalescedAction.pending->finish(Thing::ThingErrorActionSuperseded);
+    }
+    coalescedAction.pending = info;
+    return false;
+}
+
+void ThingManagerImplementation::coalescedActionFinished(const QPair<ThingId, ActionTypeId> &key)
+{
+    QHash<QPair<ThingId, ActionTypeId>, CoalescedAction>::iterator it = m_coalescedActions.find(key);
+    if (it == m_coalescedActions.end()) {
+        return;
+    }
+    ThingActionInfo *next = it->pending;
+    // A waiting action may have timed out in the meantime
+    if (!next || next->isFinished()) {
+        m_coalescedActions.erase(it);
+        return;
+    }
+
+    Thing *thing = m_configuredThings.value(key.first);
+    IntegrationPlugin *plugin = thing ? m_integrationPlugins.value(thing->pluginId()) : nullptr;
+    if (!plugin) {
+        m_coalescedActions.erase(it);
+        next->finish(Thing::ThingErrorPluginNotFound);
+        return;
+    }
+
+    it->pending.clear();
+    it->running = next;
+    connect(next, &ThingActionInfo::finished, this, [this, key](){
+        coalescedActionFinished(key);
+    });
+    callPlugin(plugin, next, [plugin, next](){ plugin->executeAction(next); });
+}
+
 void ThingManagerImplementation::loadPlugins()
 {    
     QStringList searchDirs;
@@ -1348,19 +1686,71 @@ void ThingManagerImplementation::loadPlugins()
         }
     }
 
+    QStringList pluginFiles;
+    QStringList cppPluginFiles;
     foreach (const QString &path, searchDirs) {
         QDir dir(path);
         qCDebug(dcThingManager) << "Loading plugins from:" << dir.absolutePath();
         foreach (const QString &entry, dir.entryList({"*.so", "*.js", "*.py"}, QDir::Files)) {
-
-            IntegrationPlugin *plugin = nullptr;
-
-            QFileInfo fi(path + '/' + entry);
+            QString fileName = QFileInfo(path + '/' + entry).absoluteFilePath();
+            pluginFiles.append(fileName);
             if (entry.startsWith("libnymea_integrationplugin") && entry.endsWith(".so")) {
-                plugin = createCppIntegrationPlugin(fi.absoluteFilePath());
+                cppPluginFiles.append(fileName);
+            }
+        }
+    }
 
-            } else if (entry.startsWith("integrationplugin") && entry.endsWith(".js")) {
+    // In lazy mode, plugins not used by any configured thing are instantiated once they are needed
+    bool lazy = qgetenv("NYMEA_LAZY_PLUGINS") == "1";
+    QSet<PluginId> requiredPlugins;
+    if (lazy) {
+        requiredPlugins = configuredPluginIds();
+    }
+
+    // Loading the libraries and parsing their metadata takes most of the time and doesn't touch any
+    // shared state, so it runs on the thread pool. The plugin objects are created on the main thread.
+    QStringList hostedPlugins = m_hostedPlugins;
+    std::function<CppPluginCandidate(const QString &)> prepare = [lazy, requiredPlugins, hostedPlugins](const QString &fileName) {
+        qint64 start = StartupTrace::now();
+        CppPluginCandidate candidate = prepareCppIntegrationPlugin(fileName, lazy, requiredPlugins, hostedPlugins);
+        QString name = candidate.metadata.isValid() ? candidate.metadata.pluginName() : QFileInfo(fileName).fileName();
+        StartupTrace::record("plugins", name, start, {{"step", "library"}, {"file", fileName}, {"deferred", candidate.deferred}});
+        return candidate;
+    };
+    QList<CppPluginCandidate> candidates = QtConcurrent::blockingMapped<QList<CppPluginCandidate>>(cppPluginFiles, prepare);
+    QHash<QString, CppPluginCandidate> cppPlugins;
+    foreach (const CppPluginCandidate &candidate, candidates) {
+        cppPlugins.insert(candidate.fileName, candidate);
+    }
+
+    foreach (const QString &fileName, pluginFiles) {
+        IntegrationPlugin *plugin = nullptr;
+        qint64 pluginStart = StartupTrace::now();
+
+        QFileInfo fi(fileName);
+        QString entry = fi.fileName();
+        if (cppPlugins.contains(fileName)) {
+            CppPluginCandidate candidate = cppPlugins.value(fileName);
+            if (candidate.deferred) {
+                qCDebug(dcThingManager()) << "Deferring plugin" << candidate.metadata.pluginName() << "until it is needed";
+                plugin = new DeferredIntegrationPlugin(candidate.metadata, this);
+                m_deferredPlugins.insert(plugin->pluginId(), fileName);
+            } else {
+                plugin = createCppIntegrationPlugin(candidate);
+            }
+
+        } else if (entry.startsWith("integrationplugin") && entry.endsWith(".js")) {
 #if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+            // Setting up a JS engine and evaluating the plugin is costly, so it's deferred like native plugins
+            PluginMetadata metadata;
+            if (lazy) {
+                metadata = scriptPluginMetadata(fi.absoluteFilePath());
+            }
+            if (metadata.isValid() && isDeferrable(metadata, requiredPlugins) && !m_integrationPlugins.contains(metadata.pluginId())) {
+                qCDebug(dcThingManager()) << "Deferring plugin" << metadata.pluginName() << "until it is needed";
+                plugin = new DeferredIntegrationPlugin(metadata, this);
+                m_deferredPlugins.insert(plugin->pluginId(), fi.absoluteFilePath());
+            } else {
                 ScriptIntegrationPlugin *p = new ScriptIntegrationPlugin(this);
                 bool ok = p->loadScript(fi.absoluteFilePath());
                 if (ok) {
@@ -1368,11 +1758,21 @@ void ThingManagerImplementation::loadPlugins()
                 } else {
                     delete p;
                 }
+            }
 #else
-                qCWarning(dcThingManager()) << "Not loading JS plugin as JS plugin support is not included in this nymea instance.";
+            qCWarning(dcThingManager()) << "Not loading JS plugin as JS plugin support is not included in this nymea instance.";
 #endif
-            } else if (entry.startsWith("integrationplugin") && entry.endsWith(".py")) {
+        } else if (entry.startsWith("integrationplugin") && entry.endsWith(".py")) {
 #ifdef WITH_PYTHON
+            PluginMetadata metadata;
+            if (lazy) {
+                metadata = scriptPluginMetadata(fi.absoluteFilePath());
+            }
+            if (metadata.isValid() && isDeferrable(metadata, requiredPlugins) && !m_integrationPlugins.contains(metadata.pluginId())) {
+                qCDebug(dcThingManager()) << "Deferring plugin" << metadata.pluginName() << "until it is needed";
+                plugin = new DeferredIntegrationPlugin(metadata, this);
+                m_deferredPlugins.insert(plugin->pluginId(), fi.absoluteFilePath());
+            } else {
                 PythonIntegrationPlugin *p = new PythonIntegrationPlugin(this);
                 bool ok = p->loadScript(fi.absoluteFilePath());
                 if (ok) {
@@ -1380,30 +1780,114 @@ void ThingManagerImplementation::loadPlugins()
                 } else {
                     delete p;
                 }
+            }
 #else
-                qCWarning(dcThingManager()) << "Not loading Python plugin as Python plugin support is not included in this nymea instance.";
+            qCWarning(dcThingManager()) << "Not loading Python plugin as Python plugin support is not included in this nymea instance.";
 #endif
-            } else {
-                // Not a known plugin type
-                continue;
-            }
+        } else {
+            // Not a known plugin type
+            continue;
+        }
 
-            if (!plugin) {
-                qCWarning(dcThingManager()) << "Error loading plugin:" << fi.absoluteFilePath();
-                continue;
-            }
+        if (!plugin) {
+            qCWarning(dcThingManager()) << "Error loading plugin:" << fi.absoluteFilePath();
+            continue;
+        }
 
-            if (m_integrationPlugins.contains(plugin->pluginId())) {
-                qCWarning(dcThingManager()) << "A plugin with this ID is already loaded. Not loading" << entry << plugin->pluginId();
-                delete plugin;
-                continue;
+        if (m_integrationPlugins.contains(plugin->pluginId())) {
+            qCWarning(dcThingManager()) << "A plugin with this ID is already loaded. Not loading" << entry << plugin->pluginId();
+            if (m_deferredPlugins.value(plugin->pluginId()) == fileName) {
+                m_deferredPlugins.remove(plugin->pluginId());
             }
-            loadPlugin(plugin);
-            PluginInfoCache::cachePluginInfo(plugin->metadata().jsonObject());
+            delete plugin;
+            continue;
         }
+        loadPlugin(plugin);
+        PluginInfoCache::cachePluginInfo(plugin->metadata().jsonObject());
+        StartupTrace::record("plugins", plugin->pluginName(), pluginStart, {{"step", "init"}, {"file", fileName}});
     }
 }
 
+IntegrationPlugin *ThingManagerImplementation::activatePlugin(const PluginId &pluginId)
+{
+    IntegrationPlugin *placeholder = m_integrationPlugins.value(pluginId);
+    if (!placeholder || !m_deferredPlugins.contains(pluginId)) {
+        return placeholder;
+    }
+
+    QString fileName = m_deferredPlugins.value(pluginId);
+    qCDebug(dcThingManager()) << "Instantiating deferred plugin" << placeholder->pluginName() << "from" << fileName;
+
+    IntegrationPlugin *plugin = nullptr;
+    if (fileName.endsWith(".so")) {
+        CppPluginCandidate candidate;
+        candidate.fileName = fileName;
+        candidate.valid = true;
+        candidate.metadata = placeholder->metadata();
+        plugin = createCppIntegrationPlugin(candidate);
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    if (fileName.endsWith(".js")) {
+        ScriptIntegrationPlugin *p = new ScriptIntegrationPlugin(this);
+        if (p->loadScript(fileName)) {
+            plugin = p;
+        } else {
+            delete p;
+        }
+    }
+#endif
+#ifdef WITH_PYTHON
+    if (fileName.endsWith(".py")) {
+        PythonIntegrationPlugin *p = new PythonIntegrationPlugin(this);
+        if (p->loadScript(fileName)) {
+            plugin = p;
+        } else {
+            delete p;
+        }
+    }
+#endif
+    if (!plugin || plugin->pluginId() != pluginId) {
+        // Keep the placeholder so the plugin's thing classes stay known
+        qCWarning(dcThingManager()) << "Error loading deferred plugin:" << fileName;
+        delete plugin;
+        return nullptr;
+    }
+
+    m_deferredPlugins.remove(pluginId);
+    m_integrationPlugins.remove(pluginId);
+    delete placeholder;
+    loadPlugin(plugin);
+    return plugin;
+}
+
+QSet<PluginId> ThingManagerImplementation::configuredPluginIds() const
+{
+    QSet<PluginId> pluginIds;
+    NymeaSettings settings(NymeaSettings::SettingsRoleThings);
+    settings.beginGroup(settings.childGroups().contains("ThingConfig") ? "ThingConfig" : "DeviceConfig");
+    foreach (const QString &idString, settings.childGroups()) {
+        settings.beginGroup(idString);
+        pluginIds.insert(PluginId(settings.value("pluginid").toString()));
+        settings.endGroup();
+    }
+    settings.endGroup();
+    return pluginIds;
+}
+
+bool ThingManagerImplementation::isDeferrable(const PluginMetadata &metadata, const QSet<PluginId> &requiredPlugins)
+{
+    if (requiredPlugins.contains(metadata.pluginId())) {
+        return false;
+    }
+    // Auto things appear on their own, the plugin needs to be running to find them
+    foreach (const ThingClass &thingClass, metadata.thingClasses()) {
+        if (thingClass.createMethods().testFlag(ThingClass::CreateMethodAuto)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void ThingManagerImplementation::loadPlugin(IntegrationPlugin *pluginIface)
 {
     // Populate the API storage for the plugin.
@@ -1430,8 +1914,10 @@ void ThingManagerImplementation::loadPlugin(IntegrationPlugin *pluginIface)
     pluginIface->initPlugin(this, m_hardwareManager, apiKeyStorage);
 
     qCDebug(dcThingManager) << "**** Loaded plugin" << pluginIface->pluginName();
+    m_translationCache.remove(pluginIface->pluginId());
     foreach (const Vendor &vendor, pluginIface->supportedVendors()) {
         qCDebug(dcThingManager) << "* Loaded vendor:" << vendor.name() << vendor.id();
+        m_vendorPlugins.insert(vendor.id(), pluginIface->pluginId());
         if (m_supportedVendors.contains(vendor.id()))
             continue;
 
@@ -1443,7 +1929,9 @@ void ThingManagerImplementation::loadPlugin(IntegrationPlugin *pluginIface)
             qCWarning(dcThingManager) << "Vendor not found. Ignoring thing. VendorId:" << thingClass.vendorId() << "ThingClass:" << thingClass.name() << thingClass.id();
             continue;
         }
-        m_vendorThingMap[thingClass.vendorId()].append(thingClass.id());
+        if (!m_vendorThingMap[thingClass.vendorId()].contains(thingClass.id())) {
+            m_vendorThingMap[thingClass.vendorId()].append(thingClass.id());
+        }
         m_supportedThings.insert(thingClass.id(), thingClass);
         qCDebug(dcThingManager) << "* Loaded thing class:" << thingClass.name();
     }
@@ -1478,14 +1966,23 @@ void ThingManagerImplementation::loadPlugin(IntegrationPlugin *pluginIface)
         }
     }
 
+    if (m_workerThreadPlugins.contains(pluginIface->pluginId())) {
+        startPluginThread(pluginIface);
+    }
+
     // Call the init method of the plugin
-    pluginIface->init();
+    callPlugin(pluginIface, [pluginIface](){ pluginIface->init(); });
 
     m_integrationPlugins.insert(pluginIface->pluginId(), pluginIface);
 
     connect(pluginIface, &IntegrationPlugin::emitEvent, this, &ThingManagerImplementation::onEventTriggered, Qt::QueuedConnection);
     connect(pluginIface, &IntegrationPlugin::autoThingsAppeared, this, &ThingManagerImplementation::onAutoThingsAppeared, Qt::QueuedConnection);
     connect(pluginIface, &IntegrationPlugin::autoThingDisappeared, this, &ThingManagerImplementation::onAutoThingDisappeared, Qt::QueuedConnection);
+    connect(pluginIface, &IntegrationPlugin::browserItemsChanged, this, [this](const ThingId &thingId, const QString &itemId){
+        m_browserCache.invalidate(thingId, itemId);
+    });
+
+    emit pluginLoaded(pluginIface->pluginId());
 }
 
 void ThingManagerImplementation::loadConfiguredThings()
@@ -1499,6 +1996,7 @@ void ThingManagerImplementation::loadConfiguredThings()
         needsMigration = true;
     }
     qCDebug(dcThingManager) << "Loading things from" << settings.fileName();
+    QList<Thing*> loadedThings;
     foreach (const QString &idString, settings.childGroups()) {
         settings.beginGroup(idString);
         QString thingName = settings.value("thingName").toString();
@@ -1624,15 +2122,24 @@ void ThingManagerImplementation::loadConfiguredThings()
         registerThing(thing);
 
         emit thingAdded(thing);
+        loadedThings.append(thing);
     }
     settings.endGroup();
+    if (!loadedThings.isEmpty()) {
+        emit thingsAdded(loadedThings);
+    }
 
     if (needsMigration) {
+        foreach (Thing *thing, m_configuredThings) {
+            m_dirtyThings.insert(thing->id());
+        }
         storeConfiguredThings();
         settings.remove("DeviceConfig");
     }
 
 
+    // Parents are queued before their children. Each plugin works through its own queue, so a slow
+    // plugin only delays its own things.
     QHash<ThingId, Thing*> setupList = m_configuredThings;
     while (!setupList.isEmpty()) {
         Thing *thing = nullptr;
@@ -1645,17 +2152,37 @@ void ThingManagerImplementation::loadConfiguredThings()
         }
         Q_ASSERT(thing != nullptr);
 
-        trySetupThing(thing);
+        m_startupSetupQueue[thing->pluginId()].append(thing->id());
     }
+    dispatchStartupSetups();
 
     loadIOConnections();
 }
 
+void ThingManagerImplementation::storeConfiguredThing(Thing *thing)
+{
+    // Edits often come in bursts, e.g. a reconfiguration changing params and settings. Write them in one go.
+    m_dirtyThings.insert(thing->id());
+    if (!m_thingConfigTimer->isActive()) {
+        m_thingConfigTimer->start();
+    }
+}
+
 void ThingManagerImplementation::storeConfiguredThings()
 {
+    m_thingConfigTimer->stop();
+    if (m_dirtyThings.isEmpty()) {
+        return;
+    }
+
+    // Only the groups of changed things are rewritten, the others stay untouched
     NymeaSettings settings(NymeaSettings::SettingsRoleThings);
     settings.beginGroup("ThingConfig");
-    foreach (Thing *thing, m_configuredThings) {
+    foreach (const ThingId &thingId, m_dirtyThings) {
+        Thing *thing = m_configuredThings.value(thingId);
+        if (!thing) {
+            continue;
+        }
         settings.beginGroup(thing->id().toString());
         // Note: clean thing settings before storing it for clean up
         settings.remove("");
@@ -1682,28 +2209,32 @@ void ThingManagerImplementation::storeConfiguredThings()
         settings.endGroup(); // ThingId
     }
     settings.endGroup(); // ThingConfig
+    m_dirtyThings.clear();
 }
 
 void ThingManagerImplementation::startMonitoringAutoThings()
 {
     foreach (IntegrationPlugin *plugin, m_integrationPlugins) {
-        plugin->startMonitoringAutoThings();
+        callPlugin(plugin, [plugin](){ plugin->startMonitoringAutoThings(); });
     }
 }
 
 void ThingManagerImplementation::onAutoThingsAppeared(const ThingDescriptors &thingDescriptors)
 {
+    // All new things of the descriptors are set up at the same time and added together once the last
+    // setup finished, so bridges reporting hundreds of things cause one write and one notification.
+    int batchId = ++m_nextAutoThingBatchId;
     foreach (const ThingDescriptor &thingDescriptor, thingDescriptors) {
 
         ThingClass thingClass = findThingClass(thingDescriptor.thingClassId());
         if (!thingClass.isValid()) {
             qCWarning(dcThingManager()) << "Ignoring appearing auto thing for an unknown ThingClass" << thingDescriptor.thingClassId();
-            return;
+            continue;
         }
 
         IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
         if (!plugin) {
-            return;
+            continue;
         }
 
         if (!thingDescriptor.parentId().isNull() && !m_configuredThings.contains(thingDescriptor.parentId())) {
@@ -1738,24 +2269,44 @@ void ThingManagerImplementation::onAutoThingsAppeared(const ThingDescriptors &th
 
         qCDebug(dcThingManager()) << "Setting up auto thing:" << thing->name() << thing->id().toString();
 
+        m_autoThingBatches[batchId].pending++;
         ThingSetupInfo *info = setupThing(thing);
-        connect(info, &ThingSetupInfo::finished, thing, [this, info](){
+        connect(info, &ThingSetupInfo::finished, this, [this, info, batchId](){
 
             if (info->status() != Thing::ThingErrorNoError) {
                 qCWarning(dcThingManager) << "Thing setup failed. Not adding auto thing to system.";
-                info->thing()->deleteLater();
-                return;
+                deleteThingLater(info->thing());
+            } else {
+                info->thing()->setSetupStatus(Thing::ThingSetupStatusComplete, Thing::ThingErrorNoError);
+                m_autoThingBatches[batchId].things.append(info->thing());
             }
 
-            info->thing()->setSetupStatus(Thing::ThingSetupStatusComplete, Thing::ThingErrorNoError);
-            registerThing(info->thing());
-            storeConfiguredThings();
-            emit thingAdded(info->thing());
-            postSetupThing(info->thing());
+            if (--m_autoThingBatches[batchId].pending == 0) {
+                finishAutoThingBatch(batchId);
+            }
         });
     }
 }
 
+void ThingManagerImplementation::finishAutoThingBatch(int batchId)
+{
+    QList<Thing*> things = m_autoThingBatches.take(batchId).things;
+    if (things.isEmpty()) {
+        return;
+    }
+
+    qCDebug(dcThingManager()) << "Adding" << things.count() << "auto things";
+    foreach (Thing *thing, things) {
+        registerThing(thing);
+        storeConfiguredThing(thing);
+        emit thingAdded(thing);
+    }
+    emit thingsAdded(things);
+    foreach (Thing *thing, things) {
+        postSetupThing(thing);
+    }
+}
+
 void ThingManagerImplementation::onAutoThingDisappeared(const ThingId &thingId)
 {
     IntegrationPlugin *plugin = static_cast<IntegrationPlugin*>(sender());
@@ -1786,20 +2337,30 @@ void ThingManagerImplementation::onLoaded()
     qCDebug(dcThingManager()) << "Done loading plugins and things.";
     emit loaded();
 
+    m_loaded = true;
+    checkStartupSetupsFinished();
+
     // schedule some housekeeping...
     QTimer::singleShot(0, this, SLOT(cleanupThingStateCache()));
 }
 
 void ThingManagerImplementation::cleanupThingStateCache()
 {
-    NymeaSettings settings(NymeaSettings::SettingsRoleThingStates);
-    foreach (const QString &entry, settings.childGroups()) {
-        ThingId thingId(entry);
+    QList<ThingId> cachedThingIds = m_stateCache.isOpen() ? m_stateCache.thingIds() : m_stateSnapshot.keys();
+    foreach (const ThingId &thingId, cachedThingIds) {
         if (!m_configuredThings.contains(thingId)) {
             qCDebug(dcThingManager()) << "Thing ID" << thingId << "not found in configured things. Cleaning up stale thing state cache.";
-            settings.remove(entry);
+            m_stateSnapshot.remove(thingId);
+            m_changedStateThings.remove(thingId);
+            m_removedStateThings.insert(thingId);
         }
     }
+    // All configured things are restored by now, the snapshot only contains the states of things added from now on
+    m_stateCache.close();
+
+    if ((!m_removedStateThings.isEmpty() || m_stateSnapshotRewrite) && !m_stateCacheTimer->isActive() && !m_stateCacheWatcher.isRunning()) {
+        m_stateCacheTimer->start();
+    }
 }
 
 void ThingManagerImplementation::onEventTriggered(Event event)
@@ -1810,7 +2371,7 @@ void ThingManagerImplementation::onEventTriggered(Event event)
         qCWarning(dcThingManager()) << "Invalid thing id in emitted event. Not forwarding event. Thing setup not complete yet?";
         return;
     }
-    EventType eventType = thing->thingClass().eventTypes().findById(event.eventTypeId());
+    EventType eventType = thing->thingClass().getEventType(event.eventTypeId());
     if (!eventType.isValid()) {
         qCWarning(dcThingManager()) << "The given thing does not have an event type of id " + event.eventTypeId().toString() + ". Not forwarding event.";
         return;
@@ -1835,130 +2396,191 @@ void ThingManagerImplementation::slotThingStateValueChanged(const StateTypeId &s
 
     emit thingStateChanged(thing, stateTypeId, value, minValue, maxValue);
 
-    Param valueParam(ParamTypeId(stateTypeId.toString()), value);
-    Event event(EventTypeId(stateTypeId.toString()), thing->id(), ParamList() << valueParam, true);
+    Param valueParam(ParamTypeId(stateTypeId), value);
+    Event event(EventTypeId(stateTypeId), thing->id(), ParamList() << valueParam, true);
     onEventTriggered(event);
 
     syncIOConnection(thing, stateTypeId);
 }
 
+void ThingManagerImplementation::slotThingStateValuesChanged(const QList<StateTypeId> &stateTypeIds)
+{
+    Thing *thing = qobject_cast<Thing*>(sender());
+    if (!thing || !m_configuredThings.contains(thing->id())) {
+        qCWarning(dcThingManager()) << "Invalid thing id in state change. Not forwarding event. Thing setup not complete yet?";
+        return;
+    }
+    foreach (const StateTypeId &stateTypeId, stateTypeIds) {
+        storeThingState(thing, stateTypeId);
+    }
+
+    // Announced once for the whole batch, listeners fetch the values from the thing
+    emit thingStatesChanged(thing, stateTypeIds);
+
+    foreach (const StateTypeId &stateTypeId, stateTypeIds) {
+        Param valueParam(ParamTypeId(stateTypeId), thing->stateValue(stateTypeId));
+        Event event(EventTypeId(stateTypeId), thing->id(), ParamList() << valueParam, true);
+        onEventTriggered(event);
+        syncIOConnection(thing, stateTypeId);
+    }
+}
+
 void ThingManagerImplementation::syncIOConnection(Thing *thing, const StateTypeId &stateTypeId)
 {
+    QPair<ThingId, StateTypeId> key = qMakePair(thing->id(), stateTypeId);
 
-    foreach (const IOConnection &ioConnection, m_ioConnections) {
-        // Check if this state is an input to an IO connection.
-        if (ioConnection.inputThingId() == thing->id() && ioConnection.inputStateTypeId() == stateTypeId) {
-            Thing *inputThing = thing;
-            QVariant inputValue = inputThing->stateValue(stateTypeId);
-
-            Thing *outputThing = m_configuredThings.value(ioConnection.outputThingId());
-            if (!outputThing) {
-                qCWarning(dcThingManager()) << "IO connection contains invalid output thing!";
-                continue;
-            }
-            IntegrationPlugin *plugin = m_integrationPlugins.value(outputThing->pluginId());
-            if (!plugin) {
-                qCWarning(dcThingManager()) << "Plugin not found for IO connection's output action.";
+    // Check if this state is an input to an IO connection.
+    foreach (const IORoute &route, m_ioRoutesByInput.value(key)) {
+        const IOConnection &ioConnection = route.connection;
+        Thing *inputThing = thing;
+        QVariant inputValue = inputThing->stateValue(stateTypeId);
+
+        Thing *outputThing = m_configuredThings.value(ioConnection.outputThingId());
+        if (!outputThing) {
+            qCWarning(dcThingManager()) << "IO connection contains invalid output thing!";
+            continue;
+        }
+        IntegrationPlugin *plugin = m_integrationPlugins.value(outputThing->pluginId());
+        if (!plugin) {
+            qCWarning(dcThingManager()) << "Plugin not found for IO connection's output action.";
+            continue;
+        }
+        StateType inputStateType = route.inputStateType;
+
+        StateType outputStateType = route.outputStateType;
+        if (outputStateType.id().isNull()) {
+            qCWarning(dcThingManager()) << "Could not find output state type for IO connection.";
+            continue;
+        }
+        QVariant outputValue;
+        if (outputStateType.ioType() == Types::IOTypeDigitalOutput) {
+            // Digital IOs are mapped as-is
+            outputValue = ioConnection.inverted() xor inputValue.toBool();
+
+            // We're already in sync! Skipping action.
+            if (outputThing->stateValue(outputStateType.id()) == outputValue) {
                 continue;
             }
-            StateType inputStateType = inputThing->thingClass().getStateType(stateTypeId);
+        } else {
+            // Analog IOs are mapped within the according min/max ranges
+            outputValue = mapValue(inputValue, inputStateType, outputStateType, ioConnection.inverted());
 
-            StateType outputStateType = outputThing->thingClass().getStateType(ioConnection.outputStateTypeId());
-            if (outputStateType.id().isNull()) {
-                qCWarning(dcThingManager()) << "Could not find output state type for IO connection.";
+            // We're already in sync (fuzzy, good enough)! Skipping action.
+            if (qFuzzyCompare(1.0 + outputThing->stateValue(outputStateType.id()).toDouble(), 1.0 + outputValue.toDouble())) {
                 continue;
             }
-            QVariant outputValue;
-            if (outputStateType.ioType() == Types::IOTypeDigitalOutput) {
-                // Digital IOs are mapped as-is
-                outputValue = ioConnection.inverted() xor inputValue.toBool();
-
-                // We're already in sync! Skipping action.
-                if (outputThing->stateValue(outputStateType.id()) == outputValue) {
-                    continue;
-                }
-            } else {
-                // Analog IOs are mapped within the according min/max ranges
-                outputValue = mapValue(inputValue, inputStateType, outputStateType, ioConnection.inverted());
-
-                // We're already in sync (fuzzy, good enough)! Skipping action.
-                if (qFuzzyCompare(1.0 + outputThing->stateValue(outputStateType.id()).toDouble(), 1.0 + outputValue.toDouble())) {
-                    continue;
+        }
+        Action outputAction(ActionTypeId(ioConnection.outputStateTypeId()), ioConnection.outputThingId());
+
+        Param outputParam(ioConnection.outputStateTypeId(), outputValue);
+        outputAction.setParams(ParamList() << outputParam);
+        qCDebug(dcThingManager()) << "Executing IO connection action on" << outputThing->name() << outputParam;
+        ThingActionInfo* info = executeAction(outputAction);
+        bool inverted = ioConnection.inverted();
+        connect(info, &ThingActionInfo::finished, this, [=](){
+            if (info->status() != Thing::ThingErrorNoError) {
+                // An error happened... let's switch the input back to be in sync with the output
+                qCWarning(dcThingManager()) << "Error syncing IO connection state. Reverting input back to old value.";
+                if (inputStateType.ioType() == Types::IOTypeDigitalInput) {
+                    inputThing->setStateValue(inputStateType.id(), outputThing->stateValue(outputStateType.id()));
+                } else {
+                    inputThing->setStateValue(inputStateType.id(), mapValue(outputThing->stateValue(outputStateType.id()), outputStateType, inputStateType, inverted));
                 }
             }
-            Action outputAction(ActionTypeId(ioConnection.outputStateTypeId()), ioConnection.outputThingId());
-
-            Param outputParam(ioConnection.outputStateTypeId(), outputValue);
-            outputAction.setParams(ParamList() << outputParam);
-            qCDebug(dcThingManager()) << "Executing IO connection action on" << outputThing->name() << outputParam;
-            ThingActionInfo* info = executeAction(outputAction);
-            connect(info, &ThingActionInfo::finished, this, [=](){
-                if (info->status() != Thing::ThingErrorNoError) {
-                    // An error happened... let's switch the input back to be in sync with the output
-                    qCWarning(dcThingManager()) << "Error syncing IO connection state. Reverting input back to old value.";
-                    if (inputStateType.ioType() == Types::IOTypeDigitalInput) {
-                        inputThing->setStateValue(inputStateType.id(), outputThing->stateValue(outputStateType.id()));
-                    } else {
-                        inputThing->setStateValue(inputStateType.id(), mapValue(outputThing->stateValue(outputStateType.id()), outputStateType, inputStateType, ioConnection.inverted()));
-                    }
-                }
-            });
+        });
+    }
+
+    // Now check if this is an output state type and - if possible - update the inputs for bidirectional connections
+    foreach (const IORoute &route, m_ioRoutesByOutput.value(key)) {
+        const IOConnection &ioConnection = route.connection;
+        Thing *outputThing = thing;
+        QVariant outputValue = outputThing->stateValue(stateTypeId);
+
+        Thing *inputThing = m_configuredThings.value(ioConnection.inputThingId());
+        if (!inputThing) {
+            qCWarning(dcThingManager()) << "IO connection contains invalid input thing!";
+            continue;
+        }
+        IntegrationPlugin *plugin = m_integrationPlugins.value(inputThing->pluginId());
+        if (!plugin) {
+            qCWarning(dcThingManager()) << "Plugin not found for IO connection's input action.";
+            continue;
         }
+        const StateType &outputStateType = route.outputStateType;
 
-        // Now check if this is an output state type and - if possible - update the inputs for bidirectional connections
-        if (ioConnection.outputThingId() == thing->id() && ioConnection.outputStateTypeId() == stateTypeId) {
-            Thing *outputThing = thing;
-            QVariant outputValue = outputThing->stateValue(stateTypeId);
+        const StateType &inputStateType = route.inputStateType;
+        if (inputStateType.id().isNull()) {
+            qCWarning(dcThingManager()) << "Could not find input state type for IO connection.";
+            continue;
+        }
 
-            Thing *inputThing = m_configuredThings.value(ioConnection.inputThingId());
-            if (!inputThing) {
-                qCWarning(dcThingManager()) << "IO connection contains invalid input thing!";
-                continue;
-            }
-            IntegrationPlugin *plugin = m_integrationPlugins.value(inputThing->pluginId());
-            if (!plugin) {
-                qCWarning(dcThingManager()) << "Plugin not found for IO connection's input action.";
-                continue;
-            }
-            StateType outputStateType = outputThing->thingClass().getStateType(stateTypeId);
+        if (!inputStateType.writable()) {
+            qCDebug(dcThingManager()) << "Input state is not writable. This connection is unidirectional.";
+            continue;
+        }
+
+        QVariant inputValue;
+        if (inputStateType.ioType() == Types::IOTypeDigitalInput) {
+            // Digital IOs are mapped as-is
+            inputValue = ioConnection.inverted() xor outputValue.toBool();
 
-            StateType inputStateType = inputThing->thingClass().getStateType(ioConnection.inputStateTypeId());
-            if (inputStateType.id().isNull()) {
-                qCWarning(dcThingManager()) << "Could not find input state type for IO connection.";
+            // Prevent looping
+            if (inputThing->stateValue(inputStateType.id()) == inputValue) {
                 continue;
             }
+        } else {
+            // Analog IOs are mapped within the according min/max ranges
+            inputValue = mapValue(outputValue, outputStateType, inputStateType, ioConnection.inverted());
 
-            if (!inputStateType.writable()) {
-                qCDebug(dcThingManager()) << "Input state is not writable. This connection is unidirectional.";
+            // Prevent looping even if the above calculation has rounding errors... Just skip this action if we're close enough already
+            if (qFuzzyCompare(1.0 + inputThing->stateValue(inputStateType.id()).toDouble(), 1.0 + inputValue.toDouble())) {
                 continue;
             }
+        }
+        Action inputAction(ActionTypeId(ioConnection.inputStateTypeId()), ioConnection.inputThingId());
 
-            QVariant inputValue;
-            if (inputStateType.ioType() == Types::IOTypeDigitalInput) {
-                // Digital IOs are mapped as-is
-                inputValue = ioConnection.inverted() xor outputValue.toBool();
+        Param inputParam(ioConnection.inputStateTypeId(), inputValue);
+        inputAction.setParams(ParamList() << inputParam);
+        qCDebug(dcThingManager()) << "Executing reverse IO connection action on" << inputThing->name() << inputParam;
+        executeAction(inputAction);
+    }
+}
 
-                // Prevent looping
-                if (inputThing->stateValue(inputStateType.id()) == inputValue) {
-                    continue;
-                }
-            } else {
-                // Analog IOs are mapped within the according min/max ranges
-                inputValue = mapValue(outputValue, outputStateType, inputStateType, ioConnection.inverted());
+void ThingManagerImplementation::addIORoute(const IOConnection &ioConnection)
+{
+    IORoute route;
+    route.connection = ioConnection;
+    Thing *inputThing = m_configuredThings.value(ioConnection.inputThingId());
+    if (inputThing) {
+        route.inputStateType = inputThing->thingClass().getStateType(ioConnection.inputStateTypeId());
+    }
+    Thing *outputThing = m_configuredThings.value(ioConnection.outputThingId());
+    if (outputThing) {
+        route.outputStateType = outputThing->thingClass().getStateType(ioConnection.outputStateTypeId());
+    }
+    m_ioRoutesByInput[qMakePair(ioConnection.inputThingId(), ioConnection.inputStateTypeId())].append(route);
+    m_ioRoutesByOutput[qMakePair(ioConnection.outputThingId(), ioConnection.outputStateTypeId())].append(route);
+}
 
-                // Prevent looping even if the above calculation has rounding errors... Just skip this action if we're close enough already
-                if (qFuzzyCompare(1.0 + inputThing->stateValue(inputStateType.id()).toDouble(), 1.0 + inputValue.toDouble())) {
-                    continue;
-                }
+void ThingManagerImplementation::removeIORoute(const IOConnection &ioConnection)
+{
+    typedef QHash<QPair<ThingId, StateTypeId>, QList<IORoute>> IORoutes;
+    auto removeFrom = [&ioConnection](IORoutes &routes, const QPair<ThingId, StateTypeId> &key) {
+        IORoutes::iterator it = routes.find(key);
+        if (it == routes.end()) {
+            return;
+        }
+        for (int i = it->count() - 1; i >= 0; i--) {
+            if (it->at(i).connection.id() == ioConnection.id()) {
+                it->removeAt(i);
             }
-            Action inputAction(ActionTypeId(ioConnection.inputStateTypeId()), ioConnection.inputThingId());
-
-            Param inputParam(ioConnection.inputStateTypeId(), inputValue);
-            inputAction.setParams(ParamList() << inputParam);
-            qCDebug(dcThingManager()) << "Executing reverse IO connection action on" << inputThing->name() << inputParam;
-            executeAction(inputAction);
         }
-    }
+        if (it->isEmpty()) {
+            routes.erase(it);
+        }
+    };
+    removeFrom(m_ioRoutesByInput, qMakePair(ioConnection.inputThingId(), ioConnection.inputStateTypeId()));
+    removeFrom(m_ioRoutesByOutput, qMakePair(ioConnection.outputThingId(), ioConnection.outputStateTypeId()));
 }
 
 void ThingManagerImplementation::slotThingSettingChanged(const ParamTypeId &paramTypeId, const QVariant &value)
@@ -1967,7 +2589,7 @@ void ThingManagerImplementation::slotThingSettingChanged(const ParamTypeId &para
     if (!thing) {
         return;
     }
-    storeConfiguredThings();
+    storeConfiguredThing(thing);
     emit thingSettingChanged(thing->id(), paramTypeId, value);
 }
 
@@ -1977,7 +2599,7 @@ void ThingManagerImplementation::slotThingNameChanged()
     if (!thing) {
         return;
     }
-    storeConfiguredThings();
+    storeConfiguredThing(thing);
     emit thingChanged(thing);
 }
 
@@ -1985,12 +2607,14 @@ void ThingManagerImplementation::slotThingNameChanged()
 ParamList ThingManagerImplementation::buildParams(const ParamTypes &types, const ParamList &first, const ParamList &second)
 {
     ParamList finalParams;
+    finalParams.reserve(types.count());
     foreach (const ParamType &paramType, types) {
         QVariant value;
-        if (first.hasParam(paramType.id())) {
-            value = first.paramValue(paramType.id());
-        } else if (second.hasParam(paramType.id())) {
-            value = second.paramValue(paramType.id());
+        int index = first.paramIndex(paramType.id());
+        if (index >= 0) {
+            value = first.at(index).value();
+        } else if ((index = second.paramIndex(paramType.id())) >= 0) {
+            value = second.at(index).value();
         } else if (paramType.defaultValue().isValid()){
             value = paramType.defaultValue();
         }
@@ -2020,14 +2644,14 @@ void ThingManagerImplementation::pairThingInternal(ThingPairingInfo *info)
         return;
     }
 
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thingClass.pluginId());
     if (!plugin) {
         qCWarning(dcThingManager) << "Cannot pair thing class" << thingClass.name() << "because no plugin for it is loaded.";
         info->finish(Thing::ThingErrorPluginNotFound);
         return;
     }
 
-    plugin->startPairing(info);
+    callPlugin(plugin, info, [plugin, info](){ plugin->startPairing(info); });
 
     connect(info, &ThingPairingInfo::finished, this, [this, info, thingClass](){
         if (info->status() != Thing::ThingErrorNoError) {
@@ -2051,17 +2675,20 @@ void ThingManagerImplementation::pairThingInternal(ThingPairingInfo *info)
 ThingSetupInfo* ThingManagerImplementation::setupThing(Thing *thing)
 {
     ThingClass thingClass = findThingClass(thing->thingClassId());
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thingClass.pluginId());
 
     ThingSetupInfo *info = new ThingSetupInfo(thing, this, 30000);
 
+    // A reconfigured thing may e.g. point to another media server
+    m_browserCache.invalidate(thing->id());
+
     if (!plugin) {
         qCWarning(dcThingManager) << "Can't find a plugin for this thing" << thing;
         info->finish(Thing::ThingErrorPluginNotFound, tr("The plugin for this thing is not loaded."));
         return info;
     }
 
-    plugin->setupThing(info);
+    callPlugin(plugin, info, [plugin, info](){ plugin->setupThing(info); });
 
     m_pendingSetups.insert(thing->id(), info);
     connect(info, &ThingSetupInfo::destroyed, thing, [=](){
@@ -2082,6 +2709,9 @@ void ThingManagerImplementation::initThing(Thing *thing)
     }
     thing->setStates(states);
     loadThingStates(thing);
+    if (m_pluginThreads.contains(thing->pluginId())) {
+        thing->enableWorkerThreadAccess();
+    }
 
     QList<EventTypeId> loggedEventTypeIds;
     foreach (const EventType &eventType, thingClass.eventTypes()) {
@@ -2097,13 +2727,13 @@ void ThingManagerImplementation::postSetupThing(Thing *thing)
     ThingClass thingClass = findThingClass(thing->thingClassId());
     IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
 
-    plugin->postSetupThing(thing);
+    callPlugin(plugin, [plugin, thing](){ plugin->postSetupThing(thing); });
 }
 
 void ThingManagerImplementation::loadThingStates(Thing *thing)
 {
-    NymeaSettings settings(NymeaSettings::SettingsRoleThingStates);
-    settings.beginGroup(thing->id().toString());
+    ThingStateCache::ThingStates cachedStates = m_stateCache.isOpen() ? m_stateCache.states(thing->id()) : m_stateSnapshot.value(thing->id());
+    ThingStateCache::ThingStates restoredStates;
     ThingClass thingClass = m_supportedThings.value(thing->thingClassId());
     foreach (const StateType &stateType, thingClass.stateTypes()) {
         QVariant value = stateType.defaultValue();
@@ -2111,15 +2741,13 @@ void ThingManagerImplementation::loadThingStates(Thing *thing)
         QVariant maxValue = stateType.maxValue();
 
         if (stateType.cached()) {
-            if (settings.childGroups().contains(stateType.id().toString())) {
-                settings.beginGroup(stateType.id().toString());
-                value = settings.value("value");
-                minValue = settings.value("minValue");
-                maxValue = settings.value("maxValue");
-                settings.endGroup();
-            } else if (settings.contains(stateType.id().toString())) {
-                // Migration from < 0.30
-                value = settings.value(stateType.id().toString());
+            if (cachedStates.contains(stateType.id())) {
+                ThingStateCache::CachedState cachedState = cachedStates.value(stateType.id());
+                value = cachedState.value;
+                if (cachedState.hasLimits) {
+                    minValue = cachedState.minValue;
+                    maxValue = cachedState.maxValue;
+                }
             }
             value.convert(stateType.type());
             minValue.convert(stateType.type());
@@ -2129,25 +2757,34 @@ void ThingManagerImplementation::loadThingStates(Thing *thing)
         thing->setStateValue(stateType.id(), value);
         thing->setStateMinMaxValues(stateType.id(), minValue, maxValue);
         thing->setStateValueFilter(stateType.id(), stateType.filter());
+        thing->setStateChangePolicy(stateType.id(), stateType.changePolicy());
+
+        if (stateType.cached()) {
+            State state = thing->state(stateType.id());
+            ThingStateCache::CachedState restoredState;
+            restoredState.value = state.value();
+            restoredState.minValue = state.minValue();
+            restoredState.maxValue = state.maxValue();
+            restoredStates.insert(stateType.id(), restoredState);
+        }
     }
-    settings.endGroup();
+    m_stateSnapshot.insert(thing->id(), restoredStates);
 }
 
-void ThingManagerImplementation::storeIOConnections()
+void ThingManagerImplementation::storeIOConnection(const IOConnection &ioConnection)
 {
+    // IO connections never change once created, only the new one needs to be written
     NymeaSettings connectionSettings(NymeaSettings::SettingsRoleIOConnections);
     connectionSettings.beginGroup("IOConnections");
-    foreach (const IOConnection &ioConnection, m_ioConnections) {
-        connectionSettings.beginGroup(ioConnection.id().toString());
+    connectionSettings.beginGroup(ioConnection.id().toString());
 
-        connectionSettings.setValue("inputThingId", ioConnection.inputThingId().toString());
-        connectionSettings.setValue("inputStateTypeId", ioConnection.inputStateTypeId().toString());
-        connectionSettings.setValue("outputThingId", ioConnection.outputThingId().toString());
-        connectionSettings.setValue("outputStateTypeId", ioConnection.outputStateTypeId().toString());
-        connectionSettings.setValue("inverted", ioConnection.inverted());
+    connectionSettings.setValue("inputThingId", ioConnection.inputThingId().toString());
+    connectionSettings.setValue("inputStateTypeId", ioConnection.inputStateTypeId().toString());
+    connectionSettings.setValue("outputThingId", ioConnection.outputThingId().toString());
+    connectionSettings.setValue("outputStateTypeId", ioConnection.outputStateTypeId().toString());
+    connectionSettings.setValue("inverted", ioConnection.inverted());
 
-        connectionSettings.endGroup();
-    }
+    connectionSettings.endGroup();
     connectionSettings.endGroup();
 }
 
@@ -2165,6 +2802,7 @@ void ThingManagerImplementation::loadIOConnections()
         bool inverted = connectionSettings.value("inverted").toBool();
         IOConnection ioConnection(id, inputThingId, inputStateTypeId, outputThingId, outputStateTypeId, inverted);
         m_ioConnections.insert(id, ioConnection);
+        addIORoute(ioConnection);
         connectionSettings.endGroup();
 
         Thing *inputThing = m_configuredThings.value(inputThingId);
@@ -2189,7 +2827,60 @@ QVariant ThingManagerImplementation::mapValue(const QVariant &value, const State
     return toValue;
 }
 
-void ThingManagerImplementation::trySetupThing(Thing *thing)
+void ThingManagerImplementation::dispatchStartupSetups()
+{
+    QHash<PluginId, QList<ThingId>>::iterator it = m_startupSetupQueue.begin();
+    while (it != m_startupSetupQueue.end()) {
+        PluginId pluginId = it.key();
+        QList<ThingId> &queue = it.value();
+        while (!queue.isEmpty() && m_runningStartupSetups.value(pluginId) < maxStartupSetupsPerPlugin) {
+            Thing *thing = m_configuredThings.value(queue.takeFirst());
+            if (!thing) {
+                // Removed while waiting
+                continue;
+            }
+            m_runningStartupSetups[pluginId]++;
+            qint64 setupStart = StartupTrace::now();
+            QString thingName = thing->name();
+            QPointer<Thing> thingPointer = thing;
+            ThingId thingId = thing->id();
+            ThingSetupInfo *info = trySetupThing(thing);
+            connect(info, &QObject::destroyed, this, [this, pluginId, setupStart, thingName, thingPointer, thingId](){
+                IntegrationPlugin *plugin = m_integrationPlugins.value(pluginId);
+                QVariantMap args;
+                args.insert("thingId", thingId);
+                args.insert("plugin", plugin ? plugin->pluginName() : pluginId.toString());
+                args.insert("complete", !thingPointer.isNull() && thingPointer->setupComplete());
+                StartupTrace::record("things", thingName, setupStart, args);
+                m_runningStartupSetups[pluginId]--;
+                dispatchStartupSetups();
+            });
+        }
+        if (queue.isEmpty()) {
+            it = m_startupSetupQueue.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    checkStartupSetupsFinished();
+}
+
+void ThingManagerImplementation::checkStartupSetupsFinished()
+{
+    if (!m_loaded || m_startupSetupsFinished || !m_startupSetupQueue.isEmpty()) {
+        return;
+    }
+    foreach (int running, m_runningStartupSetups) {
+        if (running > 0) {
+            return;
+        }
+    }
+    m_startupSetupsFinished = true;
+    qCDebug(dcThingManager()) << "Initial setup of all things finished.";
+    emit startupSetupsFinished();
+}
+
+ThingSetupInfo *ThingManagerImplementation::trySetupThing(Thing *thing)
 {
     thing->setSetupStatus(Thing::ThingSetupStatusInProgress, Thing::ThingErrorNoError);
     ThingSetupInfo *info = setupThing(thing);
@@ -2218,31 +2909,68 @@ void ThingManagerImplementation::trySetupThing(Thing *thing)
         emit thingChanged(info->thing());
         postSetupThing(info->thing());
     });
+    return info;
 }
 
 void ThingManagerImplementation::registerThing(Thing *thing)
 {
     m_configuredThings.insert(thing->id(), thing);
+    m_thingsByThingClass[thing->thingClassId()].append(thing);
+    foreach (const QString &interface, m_supportedThings.value(thing->thingClassId()).interfaces()) {
+        m_thingsByInterface[interface].append(thing);
+    }
+    if (!thing->parentId().isNull()) {
+        m_childThings[thing->parentId()].append(thing);
+    }
     connect(thing, &Thing::eventTriggered, this, &ThingManagerImplementation::onEventTriggered);
     connect(thing, &Thing::stateValueChanged, this, &ThingManagerImplementation::slotThingStateValueChanged);
+    connect(thing, &Thing::stateValuesChanged, this, &ThingManagerImplementation::slotThingStateValuesChanged);
     connect(thing, &Thing::settingChanged, this, &ThingManagerImplementation::slotThingSettingChanged);
     connect(thing, &Thing::nameChanged, this, &ThingManagerImplementation::slotThingNameChanged);
 }
 
-IntegrationPlugin *ThingManagerImplementation::createCppIntegrationPlugin(const QString &absoluteFilePath)
+void ThingManagerImplementation::unregisterThing(Thing *thing)
 {
+    m_configuredThings.remove(thing->id());
+
+    QList<Thing*> &classThings = m_thingsByThingClass[thing->thingClassId()];
+    classThings.removeAll(thing);
+    if (classThings.isEmpty()) {
+        m_thingsByThingClass.remove(thing->thingClassId());
+    }
+    foreach (const QString &interface, m_supportedThings.value(thing->thingClassId()).interfaces()) {
+        QList<Thing*> &interfaceThings = m_thingsByInterface[interface];
+        interfaceThings.removeAll(thing);
+        if (interfaceThings.isEmpty()) {
+            m_thingsByInterface.remove(interface);
+        }
+    }
+    if (!thing->parentId().isNull()) {
+        QList<Thing*> &siblings = m_childThings[thing->parentId()];
+        siblings.removeAll(thing);
+        if (siblings.isEmpty()) {
+            m_childThings.remove(thing->parentId());
+        }
+    }
+}
+
+ThingManagerImplementation::CppPluginCandidate ThingManagerImplementation::prepareCppIntegrationPlugin(const QString &absoluteFilePath, bool lazy, const QSet<PluginId> &requiredPlugins, const QStringList &hostedPlugins)
+{
+    CppPluginCandidate candidate;
+    candidate.fileName = absoluteFilePath;
+
     // Check plugin API version compatibility
     QLibrary lib(absoluteFilePath);
     if (!lib.load()) {
         qCWarning(dcThingManager()).nospace() << "Error loading plugin " << absoluteFilePath << ": " << lib.errorString();
-        return nullptr;
+        return candidate;
     }
 
     QFunctionPointer versionFunc = lib.resolve("libnymea_api_version");
     if (!versionFunc) {
         qCWarning(dcThingManager()).nospace() << "Unable to resolve version in plugin " << absoluteFilePath << ". Not loading plugin.";
         lib.unload();
-        return nullptr;
+        return candidate;
     }
 
     QString version = reinterpret_cast<QString(*)()>(versionFunc)();
@@ -2251,30 +2979,68 @@ IntegrationPlugin *ThingManagerImplementation::createCppIntegrationPlugin(const
     QStringList coreParts = QString(LIBNYMEA_API_VERSION).split('.');
     if (parts.length() != 3 || parts.at(0).toInt() != coreParts.at(0).toInt() || parts.at(1).toInt() > coreParts.at(1).toInt()) {
         qCWarning(dcThingManager()).nospace() << "Libnymea API mismatch for " << absoluteFilePath << ". Core API: " << LIBNYMEA_API_VERSION << ", Plugin API: " << version;
-        return nullptr;
+        return candidate;
     }
 
-    // Version is ok. Now load the plugin
+    // Version is ok. The metadata can be read without loading the plugin
     QPluginLoader loader;
     loader.setFileName(absoluteFilePath);
     loader.setLoadHints(QLibrary::ResolveAllSymbolsHint);
 
+    QJsonObject pluginInfo = loader.metaData().value("MetaData").toObject();
+
+    // Unchanged plugins were validated on an earlier start already
+    PluginMetadata metaData = PluginInfoCache::loadPluginMetadata(absoluteFilePath, pluginInfo);
+    if (!metaData.isValid()) {
+        metaData = PluginMetadata(pluginInfo, false, false);
+        if (!metaData.isValid()) {
+            foreach (const QString &error, metaData.validationErrors()) {
+                qCWarning(dcThingManager()) << error;
+            }
+            return candidate;
+        }
+        PluginInfoCache::cachePluginMetadata(absoluteFilePath, metaData);
+    }
+    candidate.metadata = metaData;
+
+    if (lazy && isDeferrable(metaData, requiredPlugins)) {
+        candidate.valid = true;
+        candidate.deferred = true;
+        return candidate;
+    }
+
+    // Plugins running in a plugin host are loaded by the host only
+    if (PluginHostIntegrationPlugin::isHosted(metaData, hostedPlugins)) {
+        candidate.valid = true;
+        return candidate;
+    }
+
     qCDebug(dcThingManager()) << "Loading plugin from:" << absoluteFilePath;
     if (!loader.load()) {
         qCWarning(dcThingManager) << "Could not load plugin data of" << absoluteFilePath << "\n" << loader.errorString();
-        return nullptr;
+        return candidate;
     }
 
-    QJsonObject pluginInfo = loader.metaData().value("MetaData").toObject();
-    PluginMetadata metaData(pluginInfo, false, false);
-    if (!metaData.isValid()) {
-        foreach (const QString &error, metaData.validationErrors()) {
-            qCWarning(dcThingManager()) << error;
-        }
-        loader.unload();
+    // The library stays loaded when the loader goes away, instantiating it later is cheap
+    candidate.valid = true;
+    return candidate;
+}
+
+IntegrationPlugin *ThingManagerImplementation::createCppIntegrationPlugin(const CppPluginCandidate &candidate)
+{
+    if (!candidate.valid) {
         return nullptr;
     }
 
+    if (PluginHostIntegrationPlugin::isHosted(candidate.metadata, m_hostedPlugins)) {
+        qCDebug(dcThingManager()) << "Running plugin" << candidate.metadata.pluginName() << "in a plugin host";
+        return new PluginHostIntegrationPlugin(candidate.fileName, candidate.metadata, m_pluginHostCommand);
+    }
+
+    // Instantiate on the main thread, so the plugin object lives there
+    QPluginLoader loader;
+    loader.setFileName(candidate.fileName);
+    loader.setLoadHints(QLibrary::ResolveAllSymbolsHint);
     QObject *p = loader.instance();
     if (!p) {
         qCWarning(dcThingManager()) << "Error loading plugin:" << loader.errorString();
@@ -2282,15 +3048,88 @@ IntegrationPlugin *ThingManagerImplementation::createCppIntegrationPlugin(const
     }
     IntegrationPlugin *pluginIface = qobject_cast<IntegrationPlugin *>(p);
     if (!pluginIface) {
-        qCWarning(dcThingManager) << "Could not get plugin instance of" << absoluteFilePath;
+        qCWarning(dcThingManager) << "Could not get plugin instance of" << candidate.fileName;
         return nullptr;
     }
 
-    pluginIface->setMetaData(metaData);
+    pluginIface->setMetaData(candidate.metadata);
+    if (candidate.metadata.workerThread()) {
+        m_workerThreadPlugins.insert(pluginIface->pluginId());
+    }
 
     return pluginIface;
 }
 
+void ThingManagerImplementation::startPluginThread(IntegrationPlugin *plugin)
+{
+    qCDebug(dcThingManager()) << "Starting worker thread for plugin" << plugin->pluginName();
+    QThread *thread = new QThread(this);
+    thread->setObjectName(plugin->pluginName());
+    m_pluginThreads.insert(plugin->pluginId(), thread);
+
+    // Things loaded before the plugin got activated
+    foreach (Thing *thing, m_configuredThings) {
+        if (thing->pluginId() == plugin->pluginId()) {
+            thing->enableWorkerThreadAccess();
+        }
+    }
+
+    // Objects with a parent can't be moved to another thread
+    plugin->setParent(nullptr);
+    plugin->moveToThread(thread);
+    thread->start();
+}
+
+void ThingManagerImplementation::stopPluginThreads()
+{
+    foreach (const PluginId &pluginId, m_pluginThreads.keys()) {
+        QThread *thread = m_pluginThreads.take(pluginId);
+        IntegrationPlugin *plugin = m_integrationPlugins.take(pluginId);
+        qCDebug(dcThingManager()) << "Stopping worker thread of plugin" << plugin->pluginName();
+        // Calls still queued for the plugin are processed before it is deleted
+        QTimer::singleShot(0, plugin, [plugin](){
+            delete plugin;
+            QThread::currentThread()->quit();
+        });
+        if (!thread->wait(5000)) {
+            qCWarning(dcThingManager()) << "Worker thread of plugin" << thread->objectName() << "does not stop. Terminating it.";
+            thread->terminate();
+            thread->wait();
+        }
+        delete thread;
+    }
+}
+
+/* Runs the given \a call in the plugin's worker thread, if it has one, or right away otherwise.
+   With \a blocking, this returns only once the call has been made. */
+void ThingManagerImplementation::callPlugin(IntegrationPlugin *plugin, const std::function<void()> &call, bool blocking)
+{
+    if (!m_pluginThreads.contains(plugin->pluginId())) {
+        call();
+        return;
+    }
+    if (!blocking) {
+        QTimer::singleShot(0, plugin, call);
+        return;
+    }
+    QSemaphore done;
+    QTimer::singleShot(0, plugin, [&call, &done](){
+        call();
+        done.release();
+    });
+    done.acquire();
+}
+
+// A plugin running in a worker thread may still have calls queued which use the thing
+void ThingManagerImplementation::deleteThingLater(Thing *thing)
+{
+    if (!m_pluginThreads.contains(thing->pluginId())) {
+        thing->deleteLater();
+        return;
+    }
+    QTimer::singleShot(0, m_integrationPlugins.value(thing->pluginId()), [thing](){ thing->deleteLater(); });
+}
+
 void ThingManagerImplementation::storeThingStates(Thing *thing)
 {
     ThingClass thingClass = m_supportedThings.value(thing->thingClassId());
@@ -2301,13 +3140,70 @@ void ThingManagerImplementation::storeThingStates(Thing *thing)
 
 void ThingManagerImplementation::storeThingState(Thing *thing, const StateTypeId &stateTypeId)
 {
-    NymeaSettings settings(NymeaSettings::SettingsRoleThingStates);
-    settings.beginGroup(thing->id().toString());
-    settings.beginGroup(stateTypeId.toString());
-    settings.setValue("value", thing->stateValue(stateTypeId));
-    settings.setValue("minValue", thing->state(stateTypeId).minValue());
-    settings.setValue("maxValue", thing->state(stateTypeId).maxValue());
-    settings.endGroup();
-    settings.endGroup();
+    // Only cached states are restored on startup, there is no point in writing the others
+    if (!thing->thingClass().getStateType(stateTypeId).cached()) {
+        return;
+    }
+    m_dirtyStates[thing->id()].insert(stateTypeId);
+    if (!m_stateCacheTimer->isActive() && !m_stateCacheWatcher.isRunning()) {
+        m_stateCacheTimer->start();
+    }
+}
+
+void ThingManagerImplementation::flushThingStates()
+{
+    if (m_stateCacheWatcher.isRunning()) {
+        // Picked up again once the running write finishes
+        return;
+    }
+    if (!collectDirtyStates()) {
+        return;
+    }
+    // The copy is shared with m_stateSnapshot until the next change detaches it
+    ThingStateCache::Snapshot snapshot = m_stateSnapshot;
+    QString fileName = m_stateCache.fileName();
+    bool rewrite = m_stateSnapshotRewrite;
+    QList<ThingId> changedThingIds = m_changedStateThings.values();
+    QList<ThingId> removedThingIds = m_removedStateThings.values();
+    m_stateSnapshotRewrite = false;
+    m_changedStateThings.clear();
+    m_removedStateThings.clear();
+
+    if (rewrite) {
+        qCDebug(dcThingManager()) << "Writing states of" << snapshot.count() << "things to the state cache";
+    } else {
+        qCDebug(dcThingManager()) << "Writing states of" << changedThingIds.count() << "changed and" << removedThingIds.count() << "removed things to the state cache";
+    }
+    m_stateCacheWatcher.setFuture(QtConcurrent::run([fileName, snapshot, changedThingIds, removedThingIds, rewrite](){
+        if (rewrite) {
+            ThingStateCache::write(fileName, snapshot);
+        } else {
+            ThingStateCache::writeChanges(fileName, snapshot, changedThingIds, removedThingIds);
+        }
+    }));
+}
+
+bool ThingManagerImplementation::collectDirtyStates()
+{
+    for (QHash<ThingId, QSet<StateTypeId>>::const_iterator it = m_dirtyStates.constBegin(); it != m_dirtyStates.constEnd(); ++it) {
+        Thing *thing = m_configuredThings.value(it.key());
+        if (!thing) {
+            continue;
+        }
+        ThingStateCache::ThingStates &cachedStates = m_stateSnapshot[it.key()];
+        foreach (const StateTypeId &stateTypeId, it.value()) {
+            State state = thing->state(stateTypeId);
+            ThingStateCache::CachedState cachedState;
+            cachedState.value = state.value();
+            cachedState.minValue = state.minValue();
+            cachedState.maxValue = state.maxValue();
+            cachedStates.insert(stateTypeId, cachedState);
+        }
+        m_changedStateThings.insert(it.key());
+        m_removedStateThings.remove(it.key());
+    }
+    m_dirtyStates.clear();
+
+    return !m_changedStateThings.isEmpty() || !m_removedStateThings.isEmpty() || m_stateSnapshotRewrite;
 }
 
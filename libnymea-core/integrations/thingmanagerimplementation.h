@@ -49,8 +49,16 @@
 #include <QLocale>
 #include <QPluginLoader>
 #include <QTranslator>
+#include <QFutureWatcher>
+#include <QSet>
+#include <QPointer>
+#include <QThread>
+
+#include <functional>
 
 #include "hardwaremanager.h"
+#include "thingstatecache.h"
+#include "browsercache.h"
 
 #include "integrations/thingmanager.h"
 
@@ -71,6 +79,10 @@ public:
     explicit ThingManagerImplementation(HardwareManager *hardwareManager, const QLocale &locale, QObject *parent = nullptr);
     ~ThingManagerImplementation() override;
 
+    // Plugins to run in a nymea-pluginhost process of their own and the command to start the hosts with.
+    // Must be set before the plugins are loaded.
+    void setPluginHostConfiguration(const QStringList &hostedPlugins, const QString &hostCommand);
+
     static QStringList pluginSearchDirs();
     static QList<QJsonObject> pluginsMetadata();
     void registerStaticPlugin(IntegrationPlugin* plugin);
@@ -108,10 +120,12 @@ public:
 
     Thing::ThingError setEventLogging(const ThingId &thingId, const EventTypeId &eventTypeId, bool enabled) override;
     Thing::ThingError setStateFilter(const ThingId &thingId, const StateTypeId &stateTypeId, Types::StateValueFilter filter) override;
+    Thing::ThingError setStateChangePolicy(const ThingId &thingId, const StateTypeId &stateTypeId, const StateChangePolicy &policy) override;
 
     Thing::ThingError removeConfiguredThing(const ThingId &thingId) override;
 
     ThingActionInfo* executeAction(const Action &action) override;
+    QList<ThingActionInfo*> executeActions(const QList<Action> &actions) override;
 
     BrowseResult* browseThing(const ThingId &thingId, const QString &itemId, const QLocale &locale) override;
     BrowserItemResult* browserItemDetails(const ThingId &thingId, const QString &itemId, const QLocale &locale) override;
@@ -130,23 +144,38 @@ public:
     ThingClass translateThingClass(const ThingClass &thingClass, const QLocale &locale) override;
     Vendor translateVendor(const Vendor &vendor, const QLocale &locale) override;
 
+    TimeoutWheel *timeoutWheel() const override;
+
 signals:
     void loaded();
+    // A plugin got loaded or replaced its placeholder, translations of its thing classes may differ
+    void pluginLoaded(const PluginId &pluginId);
+    // Emitted once after startup, when the initial setup of all configured things has finished
+    void startupSetupsFinished();
+    // Emitted after thingAdded() of each thing, once for all things added together
+    void thingsAdded(const QList<Thing*> &things);
 
 private slots:
     void loadPlugins();
     void loadPlugin(IntegrationPlugin *pluginIface);
+    IntegrationPlugin *activatePlugin(const PluginId &pluginId);
+    QSet<PluginId> configuredPluginIds() const;
+    static bool isDeferrable(const PluginMetadata &metadata, const QSet<PluginId> &requiredPlugins);
     void loadConfiguredThings();
+    void storeConfiguredThing(Thing *thing);
     void storeConfiguredThings();
     void startMonitoringAutoThings();
     void onAutoThingsAppeared(const ThingDescriptors &thingDescriptors);
     void onAutoThingDisappeared(const ThingId &thingId);
     void onLoaded();
     void cleanupThingStateCache();
+    void flushThingStates();
     void onEventTriggered(Event event);
+    void prefetchBrowserItems();
 
     // Only connect this to Things. It will query the sender()
     void slotThingStateValueChanged(const StateTypeId &stateTypeId, const QVariant &value, const QVariant &minValue, const QVariant &maxValue);
+    void slotThingStateValuesChanged(const QList<StateTypeId> &stateTypeIds);
     void slotThingSettingChanged(const ParamTypeId &paramTypeId, const QVariant &value);
     void slotThingNameChanged();
 
@@ -154,37 +183,89 @@ private:
     // Builds a list of params ready to create a thing.
     // Template is thingClass.paramtypes, "first" has highest priority. If a param is not found neither in first nor in second, defaults apply.
     ParamList buildParams(const ParamTypes &types, const ParamList &first, const ParamList &second = ParamList());
+    // Verifies the action and creates its info. Returns an already finished info and no plugin if the action fails verification.
+    ThingActionInfo *prepareAction(const Action &action, IntegrationPlugin **plugin);
+    BrowseResult *browseThingInternal(const ThingId &thingId, const QString &itemId, const QLocale &locale, bool prefetch);
+    // Returns false if the action has to wait for the one of the same coalesced action type in flight
+    bool startCoalescedAction(ThingActionInfo *info);
+    void coalescedActionFinished(const QPair<ThingId, ActionTypeId> &key);
     void pairThingInternal(ThingPairingInfo *info);
     ThingSetupInfo *addConfiguredThingInternal(const ThingClassId &thingClassId, const QString &name, const ParamList &params, const ThingId &parentId = ThingId());
     ThingSetupInfo *reconfigureThingInternal(Thing *thing, const ParamList &params, const QString &name = QString());
     ThingSetupInfo *setupThing(Thing *thing);
     void initThing(Thing *thing);
-    void trySetupThing(Thing *thing);
+    ThingSetupInfo *trySetupThing(Thing *thing);
+    void dispatchStartupSetups();
+    void checkStartupSetupsFinished();
     void registerThing(Thing *thing);
+    void unregisterThing(Thing *thing);
     void postSetupThing(Thing *thing);
+    void finishAutoThingBatch(int batchId);
     void storeThingStates(Thing *thing);
     void storeThingState(Thing *thing, const StateTypeId &stateTypeId);
+    bool collectDirtyStates();
     void loadThingStates(Thing *thing);
-    void storeIOConnections();
+    void storeIOConnection(const IOConnection &ioConnection);
     void loadIOConnections();
     void syncIOConnection(Thing *inputThing, const StateTypeId &stateTypeId);
+    void addIORoute(const IOConnection &ioConnection);
+    void removeIORoute(const IOConnection &ioConnection);
     QVariant mapValue(const QVariant &value, const StateType &fromStateType, const StateType &toStateType, bool inverted) const;
 
-    IntegrationPlugin *createCppIntegrationPlugin(const QString &absoluteFilePath);
+    // A plugin library loaded and validated by a worker thread, still to be instantiated on the main thread
+    class CppPluginCandidate {
+    public:
+        QString fileName;
+        bool valid = false;
+        bool deferred = false;
+        PluginMetadata metadata;
+    };
+    static CppPluginCandidate prepareCppIntegrationPlugin(const QString &absoluteFilePath, bool lazy, const QSet<PluginId> &requiredPlugins, const QStringList &hostedPlugins);
+    IntegrationPlugin *createCppIntegrationPlugin(const CppPluginCandidate &candidate);
+
+    // Plugins asking for it in their metadata run in a thread of their own. Calls into them are queued to that thread.
+    void startPluginThread(IntegrationPlugin *plugin);
+    void stopPluginThreads();
+    void callPlugin(IntegrationPlugin *plugin, const std::function<void()> &call, bool blocking = false);
+    template <typename T> void callPlugin(IntegrationPlugin *plugin, T *info, const std::function<void()> &call);
+    template <typename T> void releaseInPluginThread(IntegrationPlugin *plugin, T *info);
+    void deleteThingLater(Thing *thing);
 
 private:
     HardwareManager *m_hardwareManager;
 
     QLocale m_locale;
     Translator *m_translator = nullptr;
+    QStringList m_hostedPlugins;
+    QString m_pluginHostCommand;
+    // Runs the timeouts of all the infos handed to the plugins
+    TimeoutWheel *m_timeoutWheel = nullptr;
     QHash<VendorId, Vendor> m_supportedVendors;
     QHash<QString, Interface> m_supportedInterfaces;
     QHash<VendorId, QList<ThingClassId> > m_vendorThingMap;
     QHash<ThingClassId, ThingClass> m_supportedThings;
+    QHash<VendorId, PluginId> m_vendorPlugins;
     QHash<ThingId, Thing*> m_configuredThings;
+    // Things whose configuration changed since the last write
+    QSet<ThingId> m_dirtyThings;
+    QTimer *m_thingConfigTimer = nullptr;
+    // Secondary indexes on m_configuredThings, maintained by registerThing() and unregisterThing()
+    QHash<ThingClassId, QList<Thing*>> m_thingsByThingClass;
+    QHash<QString, QList<Thing*>> m_thingsByInterface;
+    QHash<ThingId, QList<Thing*>> m_childThings;
     QHash<ThingDescriptorId, ThingDescriptor> m_discoveredThings;
 
     QHash<PluginId, IntegrationPlugin*> m_integrationPlugins;
+    QSet<PluginId> m_workerThreadPlugins;
+    QHash<PluginId, QThread*> m_pluginThreads;
+
+    // Translated thing classes and vendors of a plugin, by locale name. Dropped when the plugin gets loaded.
+    class TranslationCache {
+    public:
+        QHash<QString, QHash<ThingClassId, ThingClass>> thingClasses;
+        QHash<QString, QHash<VendorId, Vendor>> vendors;
+    };
+    QHash<PluginId, TranslationCache> m_translationCache;
 
     class PairingContext {
     public:
@@ -195,9 +276,68 @@ private:
         QString thingName;
     };
     QHash<PairingTransactionId, PairingContext> m_pendingPairings;
+
+    // The action in flight and the latest one waiting for it, per thing and coalesced action type
+    class CoalescedAction {
+    public:
+        QPointer<ThingActionInfo> running;
+        QPointer<ThingActionInfo> pending;
+    };
+    QHash<QPair<ThingId, ActionTypeId>, CoalescedAction> m_coalescedActions;
     QHash<ThingId, ThingSetupInfo*> m_pendingSetups;
 
+    // Things waiting for their setup at startup and the setups running, by plugin
+    QHash<PluginId, QList<ThingId>> m_startupSetupQueue;
+    QHash<PluginId, int> m_runningStartupSetups;
+    bool m_loaded = false;
+    bool m_startupSetupsFinished = false;
+
+    // Plugins only known by their metadata so far, by the file they are loaded from when needed
+    QHash<PluginId, QString> m_deferredPlugins;
+
     QHash<IOConnectionId, IOConnection> m_ioConnections;
+    // IO connections by the input and by the output state they connect, with the state types needed to map values
+    class IORoute {
+    public:
+        IOConnection connection;
+        StateType inputStateType;
+        StateType outputStateType;
+    };
+    QHash<QPair<ThingId, StateTypeId>, QList<IORoute>> m_ioRoutesByInput;
+    QHash<QPair<ThingId, StateTypeId>, QList<IORoute>> m_ioRoutesByOutput;
+
+    // Snapshot read on startup, closed once all configured things restored their states from it
+    ThingStateCache m_stateCache;
+    // Current cached states of all things as written to the state cache, and what changed since the last write
+    ThingStateCache::Snapshot m_stateSnapshot;
+    // Things whose entries in m_stateSnapshot changed or have been removed since the last write
+    QSet<ThingId> m_changedStateThings;
+    QSet<ThingId> m_removedStateThings;
+    // Set if the next write must be a complete snapshot instead of appending to the journal
+    bool m_stateSnapshotRewrite = false;
+    QHash<ThingId, QSet<StateTypeId>> m_dirtyStates;
+    QTimer *m_stateCacheTimer = nullptr;
+    QFutureWatcher<void> m_stateCacheWatcher;
+
+    // Browser items plugins allowed to cache, and the children of the latest listing to fetch ahead
+    BrowserCache m_browserCache;
+    class BrowserPrefetch {
+    public:
+        ThingId thingId;
+        QString itemId;
+        QLocale locale;
+    };
+    QList<BrowserPrefetch> m_browserPrefetchQueue;
+    QTimer *m_browserPrefetchTimer = nullptr;
+
+    // Auto things appearing together are set up concurrently and added in one go
+    class AutoThingBatch {
+    public:
+        int pending = 0;
+        QList<Thing*> things;
+    };
+    QHash<int, AutoThingBatch> m_autoThingBatches;
+    int m_nextAutoThingBatchId = 0;
 
     ApiKeysProvidersLoader *m_apiKeysProvidersLoader = nullptr;
 };
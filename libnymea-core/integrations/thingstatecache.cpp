@@ -0,0 +1,451 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class ThingStateCache
+    \brief Stores the cached states of all things in a binary snapshot file and a journal of changes next to it.
+
+    The snapshot starts with a small header and an index of ThingId, offset and length for every thing, followed by
+    one record per thing holding its cached states. open() maps the file and only parses the index, the states of a
+    thing are decoded from the mapped memory when they are requested with states(). Snapshots are always written as
+    a whole with write(), which replaces the previous file atomically.
+
+    writeChanges() only appends the states of the changed things and the ids of removed ones to the journal. Once
+    the journal has grown larger than the snapshot, a new snapshot is written instead and the journal starts over.
+    Both files carry a generation, so a journal left behind by an interrupted compaction is never applied to the
+    newer snapshot.
+*/
+
+#include "thingstatecache.h"
+#include "nymeasettings.h"
+#include "loggingcategories.h"
+
+#include <QDataStream>
+#include <QFileInfo>
+#include <QSaveFile>
+
+// Bump whenever the layout written by write() changes
+static const quint32 stateCacheMagic = 0x4e595453;
+static const quint32 stateCacheVersion = 2;
+
+static const quint32 stateCacheJournalMagic = 0x4e59544a;
+static const quint32 stateCacheJournalVersion = 1;
+static const quint8 journalEntryChanged = 0;
+static const quint8 journalEntryRemoved = 1;
+// Small journals are never worth compacting
+static const qint64 minimumCompactionSize = 64 * 1024;
+
+ThingStateCache::ThingStateCache(const QString &fileName):
+    m_file(fileName)
+{
+
+}
+
+ThingStateCache::~ThingStateCache()
+{
+    close();
+}
+
+/*! Returns the path of the snapshot file used by nymead. */
+QString ThingStateCache::defaultFileName()
+{
+    return NymeaSettings::settingsPath() + "/thingstates.cache";
+}
+
+/*! Returns the path of the journal belonging to the snapshot \a fileName. */
+QString ThingStateCache::journalFileName(const QString &fileName)
+{
+    return fileName + ".journal";
+}
+
+QString ThingStateCache::fileName() const
+{
+    return m_file.fileName();
+}
+
+/*! Maps the snapshot file, reads its index and applies the journal. Returns false if the file does not exist or is
+    not a valid snapshot. */
+bool ThingStateCache::open()
+{
+    close();
+    if (!m_file.open(QFile::ReadOnly)) {
+        return false;
+    }
+    m_size = m_file.size();
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        qCWarning(dcThingManager()) << "Error mapping thing state cache" << m_file.fileName();
+        close();
+        return false;
+    }
+
+    QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char*>(m_data), static_cast<int>(m_size));
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic, version, thingCount;
+    quint32 generation = 0;
+    stream >> magic >> version;
+    // Version 1 snapshots have no generation and thus no journal
+    if (version >= 2) {
+        stream >> generation;
+    }
+    stream >> thingCount;
+    if (stream.status() != QDataStream::Ok || magic != stateCacheMagic || version < 1 || version > stateCacheVersion) {
+        qCWarning(dcThingManager()) << "Ignoring thing state cache" << m_file.fileName() << "with unknown format";
+        close();
+        return false;
+    }
+
+    m_index.reserve(static_cast<int>(thingCount));
+    for (quint32 i = 0; i < thingCount && stream.status() == QDataStream::Ok; i++) {
+        QUuid thingId;
+        quint32 offset, length;
+        stream >> thingId >> offset >> length;
+        m_index.insert(thingId, qMakePair(offset, length));
+    }
+    m_recordsOffset = stream.device()->pos();
+
+    bool valid = stream.status() == QDataStream::Ok;
+    foreach (const auto &entry, m_index) {
+        valid &= m_recordsOffset + entry.first + entry.second <= m_size;
+    }
+    if (!valid) {
+        qCWarning(dcThingManager()) << "Ignoring truncated thing state cache" << m_file.fileName();
+        close();
+        return false;
+    }
+
+    if (version >= 2) {
+        loadJournal(generation);
+    }
+    return true;
+}
+
+void ThingStateCache::close()
+{
+    if (m_data) {
+        m_file.unmap(const_cast<uchar*>(m_data));
+        m_data = nullptr;
+    }
+    m_file.close();
+    m_size = 0;
+    m_recordsOffset = 0;
+    m_index.clear();
+    m_journalStates.clear();
+    m_removedThingIds.clear();
+    m_journalTruncated = false;
+}
+
+bool ThingStateCache::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+QList<ThingId> ThingStateCache::thingIds() const
+{
+    QList<ThingId> thingIds;
+    foreach (const ThingId &thingId, m_index.keys()) {
+        if (!m_removedThingIds.contains(thingId) && !m_journalStates.contains(thingId)) {
+            thingIds.append(thingId);
+        }
+    }
+    thingIds.append(m_journalStates.keys());
+    return thingIds;
+}
+
+/*! Returns the cached states of the thing with the given \a thingId, decoded from the mapped snapshot unless the
+    journal holds newer ones. */
+ThingStateCache::ThingStates ThingStateCache::states(const ThingId &thingId) const
+{
+    if (m_journalStates.contains(thingId)) {
+        return m_journalStates.value(thingId);
+    }
+    if (!m_data || !m_index.contains(thingId) || m_removedThingIds.contains(thingId)) {
+        return ThingStates();
+    }
+    QPair<quint32, quint32> entry = m_index.value(thingId);
+    QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char*>(m_data + m_recordsOffset + entry.first), static_cast<int>(entry.second));
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_6);
+    return readStates(stream);
+}
+
+/*! Returns true if the journal ended with an incomplete entry, e.g. after a power loss while it was written. Changes
+    appended after it would never be read, so the next write must be a complete snapshot. */
+bool ThingStateCache::journalTruncated() const
+{
+    return m_journalTruncated;
+}
+
+/*! Returns a human readable dump of the snapshot, formatted like the former thingstates.conf. */
+QByteArray ThingStateCache::toText() const
+{
+    QByteArray text;
+    foreach (const ThingId &thingId, thingIds()) {
+        text += "[" + thingId.toString().toUtf8() + "]\n";
+        ThingStates thingStates = states(thingId);
+        for (ThingStates::const_iterator it = thingStates.constBegin(); it != thingStates.constEnd(); ++it) {
+            QByteArray stateTypeId = it.key().toString().toUtf8();
+            text += stateTypeId + "\\value=" + it.value().value.toString().toUtf8() + "\n";
+            text += stateTypeId + "\\minValue=" + it.value().minValue.toString().toUtf8() + "\n";
+            text += stateTypeId + "\\maxValue=" + it.value().maxValue.toString().toUtf8() + "\n";
+        }
+        text += "\n";
+    }
+    return text;
+}
+
+/*! Reads the states stored in the thingstates.conf used by earlier versions. This is only needed once to migrate
+    to the snapshot file. */
+ThingStateCache::Snapshot ThingStateCache::loadLegacySettings()
+{
+    Snapshot snapshot;
+    NymeaSettings settings(NymeaSettings::SettingsRoleThingStates);
+    foreach (const QString &thingGroup, settings.childGroups()) {
+        settings.beginGroup(thingGroup);
+        ThingStates states;
+        foreach (const QString &stateGroup, settings.childGroups()) {
+            settings.beginGroup(stateGroup);
+            CachedState state;
+            state.value = settings.value("value");
+            state.minValue = settings.value("minValue");
+            state.maxValue = settings.value("maxValue");
+            states.insert(StateTypeId(stateGroup), state);
+            settings.endGroup();
+        }
+        // Migration from < 0.30
+        foreach (const QString &key, settings.childKeys()) {
+            if (!states.contains(StateTypeId(key))) {
+                CachedState state;
+                state.value = settings.value(key);
+                state.hasLimits = false;
+                states.insert(StateTypeId(key), state);
+            }
+        }
+        settings.endGroup();
+        snapshot.insert(ThingId(thingGroup), states);
+    }
+    return snapshot;
+}
+
+/*! Writes \a snapshot to \a fileName, replacing the previous snapshot only once the new one is complete, and starts
+    a new journal. This is safe to call from a worker thread. */
+bool ThingStateCache::write(const QString &fileName, const Snapshot &snapshot)
+{
+    QByteArray records;
+    QList<QPair<ThingId, QPair<quint32, quint32>>> index;
+    index.reserve(snapshot.count());
+    QDataStream recordStream(&records, QIODevice::WriteOnly);
+    recordStream.setVersion(QDataStream::Qt_5_6);
+    for (Snapshot::const_iterator it = snapshot.constBegin(); it != snapshot.constEnd(); ++it) {
+        quint32 offset = static_cast<quint32>(records.size());
+        writeStates(recordStream, it.value());
+        index.append(qMakePair(it.key(), qMakePair(offset, static_cast<quint32>(records.size()) - offset)));
+    }
+
+    // The new generation invalidates the journal of the previous snapshot
+    quint32 generation = 0;
+    if (!readGeneration(fileName, &generation)) {
+        generation = 0;
+    }
+    generation++;
+
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(dcThingManager()) << "Error opening thing state cache for writing at" << fileName;
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << stateCacheMagic << stateCacheVersion << generation << static_cast<quint32>(index.count());
+    for (int i = 0; i < index.count(); i++) {
+        stream << static_cast<QUuid>(index.at(i).first) << index.at(i).second.first << index.at(i).second.second;
+    }
+    stream.writeRawData(records.constData(), records.size());
+    if (!file.commit()) {
+        qCWarning(dcThingManager()) << "Error writing thing state cache at" << fileName;
+        return false;
+    }
+
+    QSaveFile journal(journalFileName(fileName));
+    if (!journal.open(QFile::WriteOnly)) {
+        qCWarning(dcThingManager()) << "Error opening thing state cache journal for writing at" << journal.fileName();
+        return true;
+    }
+    QDataStream journalStream(&journal);
+    journalStream.setVersion(QDataStream::Qt_5_6);
+    journalStream << stateCacheJournalMagic << stateCacheJournalVersion << generation;
+    if (!journal.commit()) {
+        qCWarning(dcThingManager()) << "Error writing thing state cache journal at" << journal.fileName();
+    }
+    return true;
+}
+
+/*! Appends the states of the things in \a changedThingIds, as found in \a snapshot, and the removal of the things
+    in \a removedThingIds to the journal of \a fileName. The whole \a snapshot is written instead if there is no
+    matching journal yet or the journal has outgrown the snapshot. This is safe to call from a worker thread. */
+bool ThingStateCache::writeChanges(const QString &fileName, const Snapshot &snapshot, const QList<ThingId> &changedThingIds, const QList<ThingId> &removedThingIds)
+{
+    quint32 generation = 0;
+    if (!readGeneration(fileName, &generation)) {
+        return write(fileName, snapshot);
+    }
+
+    QFile journal(journalFileName(fileName));
+    if (!journal.open(QFile::ReadWrite)) {
+        qCWarning(dcThingManager()) << "Error opening thing state cache journal" << journal.fileName() << journal.errorString();
+        return write(fileName, snapshot);
+    }
+    QDataStream stream(&journal);
+    stream.setVersion(QDataStream::Qt_5_6);
+    quint32 magic, version, journalGeneration;
+    stream >> magic >> version >> journalGeneration;
+    if (stream.status() != QDataStream::Ok || magic != stateCacheJournalMagic || version != stateCacheJournalVersion || journalGeneration != generation) {
+        journal.close();
+        return write(fileName, snapshot);
+    }
+
+    journal.seek(journal.size());
+    foreach (const ThingId &thingId, removedThingIds) {
+        QByteArray entry;
+        QDataStream entryStream(&entry, QIODevice::WriteOnly);
+        entryStream.setVersion(QDataStream::Qt_5_6);
+        entryStream << journalEntryRemoved << static_cast<QUuid>(thingId);
+        stream << entry;
+    }
+    foreach (const ThingId &thingId, changedThingIds) {
+        if (!snapshot.contains(thingId)) {
+            continue;
+        }
+        QByteArray entry;
+        QDataStream entryStream(&entry, QIODevice::WriteOnly);
+        entryStream.setVersion(QDataStream::Qt_5_6);
+        entryStream << journalEntryChanged << static_cast<QUuid>(thingId);
+        writeStates(entryStream, snapshot.value(thingId));
+        stream << entry;
+    }
+    bool written = journal.flush() && stream.status() == QDataStream::Ok;
+    qint64 journalSize = journal.size();
+    journal.close();
+    if (!written) {
+        qCWarning(dcThingManager()) << "Error appending to thing state cache journal" << journal.fileName() << journal.errorString();
+        return write(fileName, snapshot);
+    }
+
+    // Compact once replaying the journal would take longer than reading the snapshot
+    if (journalSize > qMax(minimumCompactionSize, QFileInfo(fileName).size())) {
+        qCDebug(dcThingManager()) << "Compacting thing state cache journal of" << journalSize << "bytes";
+        return write(fileName, snapshot);
+    }
+    return true;
+}
+
+bool ThingStateCache::readGeneration(const QString &fileName, quint32 *generation)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    quint32 magic, version;
+    stream >> magic >> version >> *generation;
+    return stream.status() == QDataStream::Ok && magic == stateCacheMagic && version == stateCacheVersion;
+}
+
+ThingStateCache::ThingStates ThingStateCache::readStates(QDataStream &stream)
+{
+    ThingStates states;
+    quint32 stateCount;
+    stream >> stateCount;
+    if (stream.status() != QDataStream::Ok) {
+        return states;
+    }
+    states.reserve(static_cast<int>(qMin<quint32>(stateCount, 1024)));
+    for (quint32 i = 0; i < stateCount && stream.status() == QDataStream::Ok; i++) {
+        QUuid stateTypeId;
+        CachedState state;
+        stream >> stateTypeId >> state.value >> state.minValue >> state.maxValue;
+        if (stream.status() == QDataStream::Ok) {
+            states.insert(stateTypeId, state);
+        }
+    }
+    return states;
+}
+
+void ThingStateCache::writeStates(QDataStream &stream, const ThingStates &states)
+{
+    stream << static_cast<quint32>(states.count());
+    for (ThingStates::const_iterator it = states.constBegin(); it != states.constEnd(); ++it) {
+        stream << static_cast<QUuid>(it.key()) << it.value().value << it.value().minValue << it.value().maxValue;
+    }
+}
+
+void ThingStateCache::loadJournal(quint32 generation)
+{
+    QFile journal(journalFileName(m_file.fileName()));
+    if (!journal.open(QFile::ReadOnly)) {
+        return;
+    }
+    QDataStream stream(&journal);
+    stream.setVersion(QDataStream::Qt_5_6);
+    quint32 magic, version, journalGeneration;
+    stream >> magic >> version >> journalGeneration;
+    if (stream.status() != QDataStream::Ok || magic != stateCacheJournalMagic || version != stateCacheJournalVersion || journalGeneration != generation) {
+        qCDebug(dcThingManager()) << "Ignoring thing state cache journal" << journal.fileName() << "not matching the snapshot";
+        return;
+    }
+
+    int entryCount = 0;
+    while (!stream.atEnd()) {
+        QByteArray entry;
+        stream >> entry;
+        if (stream.status() != QDataStream::Ok) {
+            qCWarning(dcThingManager()) << "Ignoring truncated entry at the end of the thing state cache journal" << journal.fileName();
+            m_journalTruncated = true;
+            break;
+        }
+        QDataStream entryStream(entry);
+        entryStream.setVersion(QDataStream::Qt_5_6);
+        quint8 type;
+        QUuid thingId;
+        entryStream >> type >> thingId;
+        if (type == journalEntryRemoved) {
+            m_journalStates.remove(thingId);
+            m_removedThingIds.insert(thingId);
+        } else if (type == journalEntryChanged) {
+            m_journalStates.insert(thingId, readStates(entryStream));
+            m_removedThingIds.remove(thingId);
+        }
+        entryCount++;
+    }
+    qCDebug(dcThingManager()) << "Applied" << entryCount << "entries of the thing state cache journal";
+}
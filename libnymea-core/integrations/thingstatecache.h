@@ -0,0 +1,98 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef THINGSTATECACHE_H
+#define THINGSTATECACHE_H
+
+#include "typeutils.h"
+
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QVariant>
+
+class QDataStream;
+
+class ThingStateCache
+{
+public:
+    class CachedState {
+    public:
+        QVariant value;
+        QVariant minValue;
+        QVariant maxValue;
+        // False for entries migrated from caches that did not store min and max values
+        bool hasLimits = true;
+    };
+    typedef QHash<StateTypeId, CachedState> ThingStates;
+    typedef QHash<ThingId, ThingStates> Snapshot;
+
+    explicit ThingStateCache(const QString &fileName = defaultFileName());
+    ~ThingStateCache();
+
+    static QString defaultFileName();
+    static QString journalFileName(const QString &fileName);
+
+    QString fileName() const;
+
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    QList<ThingId> thingIds() const;
+    ThingStates states(const ThingId &thingId) const;
+    bool journalTruncated() const;
+
+    QByteArray toText() const;
+
+    static Snapshot loadLegacySettings();
+    static bool write(const QString &fileName, const Snapshot &snapshot);
+    static bool writeChanges(const QString &fileName, const Snapshot &snapshot, const QList<ThingId> &changedThingIds, const QList<ThingId> &removedThingIds);
+
+private:
+    static bool readGeneration(const QString &fileName, quint32 *generation);
+    static ThingStates readStates(QDataStream &stream);
+    static void writeStates(QDataStream &stream, const ThingStates &states);
+    void loadJournal(quint32 generation);
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+    qint64 m_recordsOffset = 0;
+    // Offset (relative to m_recordsOffset) and length of the record of each thing
+    QHash<ThingId, QPair<quint32, quint32>> m_index;
+    // Changes appended to the journal since the snapshot has been written. They override the snapshot.
+    QHash<ThingId, ThingStates> m_journalStates;
+    QSet<ThingId> m_removedThingIds;
+    bool m_journalTruncated = false;
+};
+
+#endif // THINGSTATECACHE_H
@@ -0,0 +1,161 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::ThingStateSnapshots
+    \brief Publishes immutable snapshots of all thing states for readers in other threads.
+
+    \ingroup core
+    \inmodule core
+
+    Things and their states may only be accessed in the thread of the \l{ThingManager}. Readers in
+    other threads, like isolated scripts, get the states from a \l{ThingStateSnapshot} instead.
+
+    State changes are collected while the main event loop processes a batch of events and a new
+    snapshot with an incremented epoch is published once control returns to the event loop. Only
+    the changed things are copied, all others are shared with the previous snapshot. Readers take a
+    reference to the current snapshot with current() and keep using it as long as they need to,
+    without holding any lock on the thing manager.
+*/
+
+#include "thingstatesnapshots.h"
+
+#include "integrations/thing.h"
+#include "integrations/thingmanager.h"
+
+#include <atomic>
+
+namespace nymeaserver {
+
+ThingStateSnapshot::ThingStateSnapshot(quint64 epoch, const QHash<ThingId, States> &states):
+    m_epoch(epoch),
+    m_states(states)
+{
+
+}
+
+/*! Returns the epoch of this snapshot. Each published snapshot has a higher epoch than the previous one. */
+quint64 ThingStateSnapshot::epoch() const
+{
+    return m_epoch;
+}
+
+bool ThingStateSnapshot::contains(const ThingId &thingId) const
+{
+    return m_states.contains(thingId);
+}
+
+States ThingStateSnapshot::states(const ThingId &thingId) const
+{
+    return m_states.value(thingId);
+}
+
+/*! Returns the value of the state with \a stateTypeId of the thing with \a thingId. If \a found is given,
+    it is set to whether the snapshot contains that state. */
+QVariant ThingStateSnapshot::stateValue(const ThingId &thingId, const StateTypeId &stateTypeId, bool *found) const
+{
+    QHash<ThingId, States>::const_iterator it = m_states.constFind(thingId);
+    if (it != m_states.constEnd()) {
+        foreach (const State &state, it.value()) {
+            if (state.stateTypeId() == stateTypeId) {
+                if (found) {
+                    *found = true;
+                }
+                return state.value();
+            }
+        }
+    }
+    if (found) {
+        *found = false;
+    }
+    return QVariant();
+}
+
+/*! Constructs the snapshot publisher for the things of \a thingManager. It has to live in the thread of
+    the \a thingManager. */
+ThingStateSnapshots::ThingStateSnapshots(ThingManager *thingManager, QObject *parent):
+    QObject(parent),
+    m_thingManager(thingManager),
+    m_current(std::make_shared<ThingStateSnapshot>())
+{
+    m_publishTimer.setSingleShot(true);
+    m_publishTimer.setInterval(0);
+    connect(&m_publishTimer, &QTimer::timeout, this, &ThingStateSnapshots::publish);
+
+    connect(thingManager, &ThingManager::thingAdded, this, &ThingStateSnapshots::onThingChanged);
+    connect(thingManager, &ThingManager::thingStateChanged, this, &ThingStateSnapshots::onThingChanged);
+    connect(thingManager, &ThingManager::thingStatesChanged, this, &ThingStateSnapshots::onThingChanged);
+    connect(thingManager, &ThingManager::thingRemoved, this, &ThingStateSnapshots::onThingRemoved);
+
+    foreach (Thing *thing, thingManager->configuredThings()) {
+        m_states.insert(thing->id(), thing->states());
+    }
+    publish();
+}
+
+/*! Returns the most recently published snapshot. This may be called from any thread. */
+ThingStateSnapshotPtr ThingStateSnapshots::current() const
+{
+    return std::atomic_load(&m_current);
+}
+
+/*! Publishes the pending changes right away instead of waiting for the event loop. */
+void ThingStateSnapshots::publish()
+{
+    m_publishTimer.stop();
+    foreach (const ThingId &thingId, m_dirtyThings) {
+        Thing *thing = m_thingManager->findConfiguredThing(thingId);
+        if (thing) {
+            m_states.insert(thingId, thing->states());
+        } else {
+            m_states.remove(thingId);
+        }
+    }
+    m_dirtyThings.clear();
+    std::atomic_store(&m_current, ThingStateSnapshotPtr(std::make_shared<ThingStateSnapshot>(++m_epoch, m_states)));
+}
+
+void ThingStateSnapshots::onThingChanged(Thing *thing)
+{
+    m_dirtyThings.insert(thing->id());
+    if (!m_publishTimer.isActive()) {
+        m_publishTimer.start();
+    }
+}
+
+void ThingStateSnapshots::onThingRemoved(const ThingId &thingId)
+{
+    m_dirtyThings.insert(thingId);
+    if (!m_publishTimer.isActive()) {
+        m_publishTimer.start();
+    }
+}
+
+}
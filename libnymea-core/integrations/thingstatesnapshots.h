@@ -0,0 +1,97 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef THINGSTATESNAPSHOTS_H
+#define THINGSTATESNAPSHOTS_H
+
+#include "typeutils.h"
+#include "types/state.h"
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+
+#include <memory>
+
+class Thing;
+class ThingManager;
+
+namespace nymeaserver {
+
+class ThingStateSnapshot
+{
+public:
+    ThingStateSnapshot(quint64 epoch = 0, const QHash<ThingId, States> &states = QHash<ThingId, States>());
+
+    quint64 epoch() const;
+
+    bool contains(const ThingId &thingId) const;
+    States states(const ThingId &thingId) const;
+    QVariant stateValue(const ThingId &thingId, const StateTypeId &stateTypeId, bool *found = nullptr) const;
+
+private:
+    quint64 m_epoch;
+    QHash<ThingId, States> m_states;
+};
+
+typedef std::shared_ptr<const ThingStateSnapshot> ThingStateSnapshotPtr;
+
+class ThingStateSnapshots : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ThingStateSnapshots(ThingManager *thingManager, QObject *parent = nullptr);
+
+    ThingStateSnapshotPtr current() const;
+
+public slots:
+    void publish();
+
+private slots:
+    void onThingChanged(Thing *thing);
+    void onThingRemoved(const ThingId &thingId);
+
+private:
+    ThingManager *m_thingManager = nullptr;
+
+    // Only accessed through std::atomic_load() and std::atomic_store()
+    ThingStateSnapshotPtr m_current;
+
+    // The working copy of the main thread. It shares its data with the published snapshot until the next change.
+    QHash<ThingId, States> m_states;
+    QSet<ThingId> m_dirtyThings;
+    quint64 m_epoch = 0;
+    QTimer m_publishTimer;
+};
+
+}
+
+#endif // THINGSTATESNAPSHOTS_H
@@ -5,6 +5,10 @@
 
 #include <QSettings>
 #include <QDir>
+#include <QTimer>
+
+// Stores are written behind, a client syncing its settings causes one write per group
+static const int saveInterval = 1000;
 
 AppDataHandler::AppDataHandler(QObject *parent) : JsonHandler(parent)
 {
@@ -37,6 +41,23 @@ AppDataHandler::AppDataHandler(QObject *parent) : JsonHandler(parent)
     returns.insert("value", enumValueName(String));
     registerMethod("Load", description, params, returns);
 
+    description.clear(); params.clear(); returns.clear();
+    description = "Store multiple app data entries of the same appId and group at once. The values map "
+                  "contains the keys and values to be stored. A Changed notification will be emitted for "
+                  "each of them.";
+    params.insert("appId", enumValueName(String));
+    params.insert("o:group", enumValueName(String));
+    params.insert("values", enumValueName(Object));
+    registerMethod("StoreMultiple", description, params, returns);
+
+    description.clear(); params.clear(); returns.clear();
+    description = "Retrieve all app data entries of an appId and group, as previously set with Store() or "
+                  "StoreMultiple(). The values map contains all keys and their values.";
+    params.insert("appId", enumValueName(String));
+    params.insert("o:group", enumValueName(String));
+    returns.insert("values", enumValueName(Object));
+    registerMethod("LoadAll", description, params, returns);
+
     // Notifications
     description.clear(); params.clear();
     description = "Emitted whenever the app data is changed on the server.";
@@ -45,6 +66,16 @@ AppDataHandler::AppDataHandler(QObject *parent) : JsonHandler(parent)
     params.insert("key", enumValueName(String));
     params.insert("value", enumValueName(String));
     registerNotification("Changed", description, params);
+
+    m_saveTimer = new QTimer(this);
+    m_saveTimer->setSingleShot(true);
+    m_saveTimer->setInterval(saveInterval);
+    connect(m_saveTimer, &QTimer::timeout, this, &AppDataHandler::saveGroups);
+}
+
+AppDataHandler::~AppDataHandler()
+{
+    saveGroups();
 }
 
 QString AppDataHandler::name() const
@@ -53,17 +84,86 @@ QString AppDataHandler::name() const
 }
 
 JsonReply* AppDataHandler::Store(const QVariantMap &params)
+{
+    storeValue(params.value("appId").toString(), params.value("group").toString(), params.value("key").toString(), params.value("value").toString());
+    return createReply(QVariantMap());
+}
+
+JsonReply* AppDataHandler::Load(const QVariantMap &params)
 {
     QString appId = params.value("appId").toString();
-    QString group = params.value("group").toString();
+    QString groupName = params.value("group").toString();
     QString key = params.value("key").toString();
-    QVariant value = params.value("value");
 
-    // Note: we're using a different file for each group as QSettings tends to get slow with loads of keys.
-    // Might be replaced with a DB at some point if needed. However, current estimate is this won't be
-    // used for excessive amounts of data as it is mostly meant as a config file syncing mechanism.
-    QSettings settings(NymeaSettings::storagePath() + "/appdata/" + appId + '/' + group + ".conf", QSettings::IniFormat);
-    settings.setValue(key, value);
+    QVariantMap returns;
+    returns.insert("value", group(appId, groupName).value(key));
+    return createReply(returns);
+}
+
+JsonReply *AppDataHandler::StoreMultiple(const QVariantMap &params)
+{
+    QString appId = params.value("appId").toString();
+    QString groupName = params.value("group").toString();
+
+    QVariantMap values = params.value("values").toMap();
+    for (QVariantMap::const_iterator it = values.constBegin(); it != values.constEnd(); ++it) {
+        storeValue(appId, groupName, it.key(), it.value().toString());
+    }
+    return createReply(QVariantMap());
+}
+
+JsonReply *AppDataHandler::LoadAll(const QVariantMap &params)
+{
+    QString appId = params.value("appId").toString();
+    QString groupName = params.value("group").toString();
+
+    QVariantMap values;
+    const QHash<QString, QString> &entries = group(appId, groupName);
+    for (QHash<QString, QString>::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        values.insert(it.key(), it.value());
+    }
+
+    QVariantMap returns;
+    returns.insert("values", values);
+    return createReply(returns);
+}
+
+void AppDataHandler::saveGroups()
+{
+    m_saveTimer->stop();
+    foreach (const QString &fileName, m_dirtyGroups) {
+        QSettings settings(fileName, QSettings::IniFormat);
+        const QHash<QString, QString> &entries = m_groups.value(fileName);
+        for (QHash<QString, QString>::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it) {
+            settings.setValue(it.key(), it.value());
+        }
+    }
+    m_dirtyGroups.clear();
+}
+
+QHash<QString, QString> &AppDataHandler::group(const QString &appId, const QString &group)
+{
+    QString fileName = AppDataHandler::fileName(appId, group);
+    QHash<QString, QHash<QString, QString>>::iterator it = m_groups.find(fileName);
+    if (it != m_groups.end()) {
+        return it.value();
+    }
+
+    QHash<QString, QString> entries;
+    QSettings settings(fileName, QSettings::IniFormat);
+    foreach (const QString &key, settings.allKeys()) {
+        entries.insert(key, settings.value(key).toString());
+    }
+    return m_groups.insert(fileName, entries).value();
+}
+
+void AppDataHandler::storeValue(const QString &appId, const QString &group, const QString &key, const QString &value)
+{
+    this->group(appId, group).insert(key, value);
+    m_dirtyGroups.insert(fileName(appId, group));
+    if (!m_saveTimer->isActive()) {
+        m_saveTimer->start();
+    }
 
     QVariantMap notification;
     notification.insert("appId", appId);
@@ -73,20 +173,11 @@ JsonReply* AppDataHandler::Store(const QVariantMap &params)
     notification.insert("key", key);
     notification.insert("value", value);
     emit Changed(notification);
-
-    return createReply(QVariantMap());
 }
 
-JsonReply* AppDataHandler::Load(const QVariantMap &params)
+QString AppDataHandler::fileName(const QString &appId, const QString &group)
 {
-    QString appId = params.value("appId").toString();
-    QString group = params.value("group").toString();
-    QString key = params.value("key").toString();
-
-    QSettings settings(NymeaSettings::storagePath() + "/appdata/" + appId + '/' + group + ".conf", QSettings::IniFormat);
-
-    QVariantMap returns;
-
-    returns.insert("value", settings.value(key).toString());
-    return createReply(returns);
+    // Note: we're using a different file for each group as QSettings tends to get slow with loads of keys.
+    // Every group is read once and kept in memory, stores are written behind.
+    return NymeaSettings::storagePath() + "/appdata/" + appId + '/' + group + ".conf";
 }
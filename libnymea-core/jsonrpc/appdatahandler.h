@@ -2,22 +2,42 @@
 #define APPDATAHANDLER_H
 
 #include <QObject>
+#include <QHash>
+#include <QSet>
 #include "jsonrpc/jsonhandler.h"
 
+class QTimer;
+
 class AppDataHandler : public JsonHandler
 {
     Q_OBJECT
 public:
     explicit AppDataHandler(QObject *parent = nullptr);
+    ~AppDataHandler() override;
 
     QString name() const override;
 
     Q_INVOKABLE JsonReply *Store(const QVariantMap &params);
     Q_INVOKABLE JsonReply *Load(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *StoreMultiple(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *LoadAll(const QVariantMap &params);
 
 signals:
     void Changed(const QVariantMap &params);
 
+private slots:
+    void saveGroups();
+
+private:
+    // Values of a group by key, read from its file on first access
+    QHash<QString, QString> &group(const QString &appId, const QString &group);
+    void storeValue(const QString &appId, const QString &group, const QString &key, const QString &value);
+
+    static QString fileName(const QString &appId, const QString &group);
+
+    QHash<QString, QHash<QString, QString>> m_groups;
+    QSet<QString> m_dirtyGroups;
+    QTimer *m_saveTimer = nullptr;
 };
 
 #endif // APPDATAHANDLER_H
@@ -73,6 +73,7 @@
 #include "nymeaconfiguration.h"
 #include "platform/platform.h"
 #include "platform/platformsystemcontroller.h"
+#include "servers/mqttbroker.h"
 
 namespace nymeaserver {
 
@@ -88,6 +89,21 @@ ConfigurationHandler::ConfigurationHandler(QObject *parent):
     registerObject<WebServerConfiguration>();
     registerObject<MqttPolicy>();
 
+    QVariantMap mqttTrafficStatistics;
+    mqttTrafficStatistics.insert("messagesIn", enumValueName(Uint));
+    mqttTrafficStatistics.insert("bytesIn", enumValueName(Uint));
+    mqttTrafficStatistics.insert("messagesOut", enumValueName(Uint));
+    mqttTrafficStatistics.insert("bytesOut", enumValueName(Uint));
+    mqttTrafficStatistics.insert("messagesDropped", enumValueName(Uint));
+    mqttTrafficStatistics.insert("averageLatency", enumValueName(Uint));
+    mqttTrafficStatistics.insert("maxLatency", enumValueName(Uint));
+    QVariantMap mqttClientStatistics = mqttTrafficStatistics;
+    mqttClientStatistics.insert("clientId", enumValueName(String));
+    registerObject("MqttClientStatistics", mqttClientStatistics);
+    QVariantMap mqttTopicStatistics = mqttTrafficStatistics;
+    mqttTopicStatistics.insert("topicPrefix", enumValueName(String));
+    registerObject("MqttTopicStatistics", mqttTopicStatistics);
+
     // Methods
     QString description; QVariantMap params; QVariantMap returns;
     description = "Get the list of available timezones.";
@@ -226,6 +242,16 @@ ConfigurationHandler::ConfigurationHandler(QObject *parent):
     returns.insert("configurationError", enumRef<NymeaConfiguration::ConfigurationError>());
     registerMethod("DeleteMqttPolicy", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Get the traffic statistics of the MQTT broker. Statistics are given per connected client and per first "
+                  "topic level. Latencies are given in milliseconds and describe how long outgoing messages have been queued "
+                  "in the broker. Messages are dropped if the publish queue is full or a client exceeds its outbound limit.";
+    returns.insert("pendingMessages", enumValueName(Uint));
+    returns.insert("droppedMessages", enumValueName(Uint));
+    returns.insert("clients", QVariantList() << objectRef("MqttClientStatistics"));
+    returns.insert("topics", QVariantList() << objectRef("MqttTopicStatistics"));
+    registerMethod("GetMqttStatistics", description, params, returns);
+
     // Notifications
     params.clear(); returns.clear();
     description = "Emitted whenever the basic configuration of this server changes.";
@@ -569,6 +595,35 @@ JsonReply *ConfigurationHandler::DeleteMqttPolicy(const QVariantMap &params) con
     return createReply(statusToReply(success ? NymeaConfiguration::ConfigurationErrorNoError : NymeaConfiguration::ConfigurationErrorInvalidId));
 }
 
+JsonReply *ConfigurationHandler::GetMqttStatistics(const QVariantMap &params) const
+{
+    Q_UNUSED(params)
+    MqttBroker *broker = NymeaCore::instance()->serverManager()->mqttBroker();
+
+    QVariantList clients;
+    QHash<QString, MqttTrafficStatistics> clientStatistics = broker->clientStatistics();
+    for (QHash<QString, MqttTrafficStatistics>::const_iterator it = clientStatistics.constBegin(); it != clientStatistics.constEnd(); ++it) {
+        QVariantMap client = packMqttTrafficStatistics(it.value());
+        client.insert("clientId", it.key());
+        clients.append(client);
+    }
+
+    QVariantList topics;
+    QHash<QString, MqttTrafficStatistics> topicStatistics = broker->topicStatistics();
+    for (QHash<QString, MqttTrafficStatistics>::const_iterator it = topicStatistics.constBegin(); it != topicStatistics.constEnd(); ++it) {
+        QVariantMap topic = packMqttTrafficStatistics(it.value());
+        topic.insert("topicPrefix", it.key());
+        topics.append(topic);
+    }
+
+    QVariantMap ret;
+    ret.insert("pendingMessages", broker->pendingPublishes());
+    ret.insert("droppedMessages", broker->droppedPublishes());
+    ret.insert("clients", clients);
+    ret.insert("topics", topics);
+    return createReply(ret);
+}
+
 JsonReply *ConfigurationHandler::SetCloudEnabled(const QVariantMap &params) const
 {
     bool enabled = params.value("enabled").toBool();
@@ -683,6 +738,19 @@ QVariantMap ConfigurationHandler::packBasicConfiguration()
     return basicConfiguration;
 }
 
+QVariantMap ConfigurationHandler::packMqttTrafficStatistics(const MqttTrafficStatistics &statistics)
+{
+    QVariantMap map;
+    map.insert("messagesIn", statistics.messagesIn);
+    map.insert("bytesIn", statistics.bytesIn);
+    map.insert("messagesOut", statistics.messagesOut);
+    map.insert("bytesOut", statistics.bytesOut);
+    map.insert("messagesDropped", statistics.messagesDropped);
+    map.insert("averageLatency", statistics.averageLatency());
+    map.insert("maxLatency", statistics.maxLatency);
+    return map;
+}
+
 QVariantMap ConfigurationHandler::statusToReply(NymeaConfiguration::ConfigurationError status) const
 {
     QVariantMap returns;
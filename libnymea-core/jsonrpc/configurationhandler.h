@@ -38,6 +38,8 @@
 
 namespace nymeaserver {
 
+class MqttTrafficStatistics;
+
 class ConfigurationHandler : public JsonHandler
 {
     Q_OBJECT
@@ -67,6 +69,7 @@ public:
     Q_INVOKABLE JsonReply *GetMqttPolicies(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *SetMqttPolicy(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *DeleteMqttPolicy(const QVariantMap &params) const;
+    Q_INVOKABLE JsonReply *GetMqttStatistics(const QVariantMap &params) const;
 
 signals:
     void BasicConfigurationChanged(const QVariantMap &params);
@@ -102,6 +105,7 @@ private slots:
 
 private:
     static QVariantMap packBasicConfiguration();
+    static QVariantMap packMqttTrafficStatistics(const MqttTrafficStatistics &statistics);
     QVariantMap statusToReply(NymeaConfiguration::ConfigurationError status) const;
 
 };
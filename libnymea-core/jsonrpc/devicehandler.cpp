@@ -49,8 +49,9 @@
 
 namespace nymeaserver {
 
-DeviceHandler::DeviceHandler(QObject *parent) :
-    JsonHandler(parent)
+DeviceHandler::DeviceHandler(IntegrationsHandler *integrationsHandler, QObject *parent) :
+    JsonHandler(parent),
+    m_integrationsHandler(integrationsHandler)
 {
     // Enums
     registerEnum<Device::DeviceError>();
@@ -391,6 +392,9 @@ DeviceHandler::DeviceHandler(QObject *parent) :
     params.insert("event", objectRef<Event>());
     registerNotification("EventTriggered", description, params);
     connect(NymeaCore::instance(), &NymeaCore::eventTriggered, this, [this](const Event &event){
+        if (!hasSubscribers()) {
+            return;
+        }
         QVariantMap params;
         params.insert("event", pack(event));
         emit EventTriggered(params);
@@ -398,6 +402,11 @@ DeviceHandler::DeviceHandler(QObject *parent) :
 
     connect(NymeaCore::instance(), &NymeaCore::pluginConfigChanged, this, &DeviceHandler::pluginConfigChanged);
     connect(NymeaCore::instance(), &NymeaCore::thingStateChanged, this, &DeviceHandler::deviceStateChanged);
+    connect(NymeaCore::instance(), &NymeaCore::thingStatesChanged, this, [this](Thing *thing, const QList<StateTypeId> &stateTypeIds){
+        foreach (const StateTypeId &stateTypeId, stateTypeIds) {
+            deviceStateChanged(thing, stateTypeId, thing->stateValue(stateTypeId));
+        }
+    });
     connect(NymeaCore::instance(), &NymeaCore::thingRemoved, this, &DeviceHandler::deviceRemovedNotification);
     connect(NymeaCore::instance(), &NymeaCore::thingAdded, this, &DeviceHandler::deviceAddedNotification);
     connect(NymeaCore::instance(), &NymeaCore::thingChanged, this, &DeviceHandler::deviceChangedNotification);
@@ -985,6 +994,10 @@ QVariantMap DeviceHandler::packBrowserItem(const BrowserItem &item)
 
 void DeviceHandler::pluginConfigChanged(const PluginId &id, const ParamList &config)
 {
+    if (!hasSubscribers()) {
+        return;
+    }
+
     QVariantMap params;
     params.insert("pluginId", id);
     QVariantList configList;
@@ -997,6 +1010,10 @@ void DeviceHandler::pluginConfigChanged(const PluginId &id, const ParamList &con
 
 void DeviceHandler::deviceStateChanged(Thing *device, const QUuid &stateTypeId, const QVariant &value)
 {
+    if (!hasSubscribers()) {
+        return;
+    }
+
     QVariantMap params;
     params.insert("deviceId", device->id());
     params.insert("stateTypeId", stateTypeId);
@@ -1006,6 +1023,10 @@ void DeviceHandler::deviceStateChanged(Thing *device, const QUuid &stateTypeId,
 
 void DeviceHandler::deviceRemovedNotification(const QUuid &deviceId)
 {
+    if (!hasSubscribers()) {
+        return;
+    }
+
     QVariantMap params;
     params.insert("deviceId", deviceId);
     emit DeviceRemoved(params);
@@ -1013,8 +1034,12 @@ void DeviceHandler::deviceRemovedNotification(const QUuid &deviceId)
 
 void DeviceHandler::deviceAddedNotification(Thing *thing)
 {
+    if (!hasSubscribers()) {
+        return;
+    }
+
     QVariantMap params;
-    QVariantMap deviceMap = pack(thing).toMap();
+    QVariantMap deviceMap = m_integrationsHandler->packedThing(thing);
     // Patch in deviceClassId
     deviceMap.insert("deviceClassId", deviceMap.value("thingClassId"));
     params.insert("device", deviceMap);
@@ -1023,8 +1048,12 @@ void DeviceHandler::deviceAddedNotification(Thing *thing)
 
 void DeviceHandler::deviceChangedNotification(Thing *thing)
 {
+    if (!hasSubscribers()) {
+        return;
+    }
+
     QVariantMap params;
-    QVariantMap deviceMap = pack(thing).toMap();
+    QVariantMap deviceMap = m_integrationsHandler->packedThing(thing);
     // Patch in deviceClassId
     deviceMap.insert("deviceClassId", deviceMap.value("thingClassId"));
     params.insert("device", deviceMap);
@@ -1033,6 +1062,10 @@ void DeviceHandler::deviceChangedNotification(Thing *thing)
 
 void DeviceHandler::deviceSettingChangedNotification(const ThingId &thingId, const ParamTypeId &paramTypeId, const QVariant &value)
 {
+    if (!hasSubscribers()) {
+        return;
+    }
+
     QVariantMap params;
     params.insert("deviceId", thingId);
     params.insert("paramTypeId", paramTypeId.toString());
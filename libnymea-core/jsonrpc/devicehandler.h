@@ -32,6 +32,7 @@
 #define DEVICEHANDLER_H
 
 #include "jsonrpc/jsonhandler.h"
+#include "jsonrpc/integrationshandler.h"
 #include "integrations/thingmanager.h"
 #include "integrations/thing.h"
 
@@ -137,7 +138,7 @@ class DeviceHandler : public JsonHandler
 {
     Q_OBJECT
 public:
-    explicit DeviceHandler(QObject *parent = nullptr);
+    explicit DeviceHandler(IntegrationsHandler *integrationsHandler, QObject *parent = nullptr);
 
     QString name() const override;
     QHash<QString, QString> cacheHashes() const override;
@@ -200,6 +201,7 @@ private slots:
 private:
     QVariantMap statusToReply(Device::ThingError status) const;
 
+    IntegrationsHandler *m_integrationsHandler = nullptr;
     QHash<QString, QString> m_cacheHashes;
 };
 
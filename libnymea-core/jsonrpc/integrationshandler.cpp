@@ -31,6 +31,7 @@
 #include "integrationshandler.h"
 #include "nymeacore.h"
 #include "integrations/thingmanager.h"
+#include "integrations/thingmanagerimplementation.h"
 #include "integrations/thing.h"
 #include "integrations/integrationplugin.h"
 #include "loggingcategories.h"
@@ -38,14 +39,17 @@
 #include "types/browseritem.h"
 #include "types/mediabrowseritem.h"
 #include "integrations/translator.h"
+#include "integrations/pluginstatistics.h"
 #include "integrations/thingdiscoveryinfo.h"
 #include "integrations/thingpairinginfo.h"
 #include "integrations/thingsetupinfo.h"
 #include "integrations/browseresult.h"
 #include "integrations/browseritemresult.h"
+#include "logging/logengine.h"
 
 #include <QDebug>
 #include <QJsonDocument>
+#include <QDateTime>
 
 namespace nymeaserver {
 
@@ -97,6 +101,17 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
     browserItem.insert("o:mediaIcon", enumRef<MediaBrowserItem::MediaBrowserIcon>());
     registerObject("BrowserItem", browserItem);
 
+    QVariantMap thingStateChange;
+    thingStateChange.insert("thingId", enumValueName(Uuid));
+    thingStateChange.insert("stateTypeId", enumValueName(Uuid));
+    thingStateChange.insert("value", enumValueName(Variant));
+    registerObject("ThingStateChange", thingStateChange);
+
+    QVariantMap stateHistoryEntry;
+    stateHistoryEntry.insert("timestamp", enumValueName(Uint));
+    stateHistoryEntry.insert("value", enumValueName(Variant));
+    registerObject("StateHistoryEntry", stateHistoryEntry);
+
 
     // Methods
     QString description; QVariantMap returns; QVariantMap params;
@@ -194,20 +209,41 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
     registerMethod("ConfirmPairing", description, params, returns);
 
     params.clear(); returns.clear();
-    description = "Returns a list of configured things, optionally filtered by thingId.";
+    description = "Returns a list of configured things, optionally filtered by thingId. The revision can be "
+                  "passed to GetChanges later on to fetch only what changed in the meantime.";
     params.insert("o:thingId", enumValueName(Uuid));
     returns.insert("o:things", objectRef<Things>());
+    returns.insert("o:revision", enumValueName(Uint));
     returns.insert("thingError", enumRef<Thing::ThingError>());
     registerMethod("GetThings", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Returns the changes to things since the given revision, as returned by GetThings or a previous "
+                  "call to GetChanges. things contains the things which have been added or changed, states the "
+                  "current value of states which changed on other things and removedThingIds the things which have "
+                  "been removed. If the changes since the given revision are not known any more, for instance "
+                  "because nymea has been restarted in the meantime, full is true and things contains all things. "
+                  "The returned revision is to be used for the next call.";
+    params.insert("sinceRevision", enumValueName(Uint));
+    returns.insert("revision", enumValueName(Uint));
+    returns.insert("full", enumValueName(Bool));
+    returns.insert("things", objectRef<Things>());
+    returns.insert("states", QVariantList() << objectRef("ThingStateChange"));
+    returns.insert("removedThingIds", QVariantList() << enumValueName(Uuid));
+    registerMethod("GetChanges", description, params, returns);
+
     params.clear(); returns.clear();
     description = "Performs a thing discovery for things of the given thingClassId and returns the results. "
                     "This function may take a while to return. Note that this method will include all the found "
                     "things, that is, including things that may already have been added. Those things will have "
                     "thingId set to the id of the already added thing. Such results may be used to reconfigure "
-                    "existing things and might be filtered in cases where only unknown things are of interest.";
+                    "existing things and might be filtered in cases where only unknown things are of interest. "
+                    "If streamResults is true, the things are also sent to the calling client with "
+                    "DiscoveryResultsAdded notifications as soon as they are found. They can be added right away, "
+                    "before this method returns.";
     params.insert("thingClassId", enumValueName(Uuid));
     params.insert("o:discoveryParams", objectRef<ParamList>());
+    params.insert("o:streamResults", enumValueName(Bool));
     returns.insert("thingError", enumRef<Thing::ThingError>());
     returns.insert("o:displayMessage", enumValueName(String));
     returns.insert("o:thingDescriptors", objectRef<ThingDescriptors>());
@@ -258,6 +294,21 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
     returns.insert("thingError", enumRef<Thing::ThingError>());
     registerMethod("SetStateFilter", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Set the change policy for the given state on the given thing. Changes of numeric states smaller than "
+                  "the deadband (absolute, or relative to the current value) are dropped unless maxInterval milliseconds "
+                  "have passed since the last forwarded change. Changes arriving within minInterval milliseconds of the "
+                  "last forwarded change are held back and only the latest one is applied once the interval has passed. "
+                  "Omitted or 0 values disable the respective limit.";
+    params.insert("thingId", enumValueName(Uuid));
+    params.insert("stateTypeId", enumValueName(Uuid));
+    params.insert("o:deadband", enumValueName(Double));
+    params.insert("o:relativeDeadband", enumValueName(Double));
+    params.insert("o:minInterval", enumValueName(Uint));
+    params.insert("o:maxInterval", enumValueName(Uint));
+    returns.insert("thingError", enumRef<Thing::ThingError>());
+    registerMethod("SetStateChangePolicy", description, params, returns);
+
     params.clear(); returns.clear();
     description = "Remove a thing from the system.";
     params.insert("thingId", enumValueName(Uuid));
@@ -305,6 +356,17 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
     returns.insert("o:values", objectRef<States>());
     registerMethod("GetStateValues", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Get the most recent values of the given thing and the given stateType, oldest first. The "
+                  "timestamps are in milliseconds since epoch. The history only covers logged states and is kept "
+                  "in memory, it does not query the log database and starts over when nymea is restarted. Use this "
+                  "for quick overviews such as small graphs and Logging.GetLogEntries for the full history.";
+    params.insert("thingId", enumValueName(Uuid));
+    params.insert("stateTypeId", enumValueName(Uuid));
+    returns.insert("thingError", enumRef<Thing::ThingError>());
+    returns.insert("o:history", QVariantList() << objectRef("StateHistoryEntry"));
+    registerMethod("GetStateHistory", description, params, returns);
+
     params.clear(); returns.clear();
     description = "Browse a thing. "
                     "If a ThingClass indicates a thing is browsable, this method will return the BrowserItems. If no "
@@ -391,6 +453,15 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
     returns.insert("thingError", enumRef<Thing::ThingError>());
     registerMethod("DisconnectIO", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Get resource usage statistics of the Python and JS plugins, by pluginId. For each plugin function, "
+                  "\"calls\" holds the number of calls, the wall and CPU time spent in them and the time they were "
+                  "queued before running, in microseconds. For Python plugins, the queue time includes waiting for the "
+                  "GIL, and when running with NYMEA_PYTHON_TRACEMALLOC=1, tracedMemory and tracedBlocks give the memory "
+                  "allocated by the plugin's python files.";
+    returns.insert("plugins", enumValueName(Object));
+    registerMethod("GetPluginStatistics", description, params, returns);
+
 
     // Notifications
     params.clear(); returns.clear();
@@ -402,6 +473,14 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
     params.insert("maxValue", enumValueName(Variant));
     registerNotification("StateChanged", description, params);
 
+    params.clear(); returns.clear();
+    description = "Emitted when multiple states of a thing changed at once. Only sent to clients which enabled "
+                  "batchStates in JSONRPC.Hello, other clients receive a StateChanged notification for each "
+                  "of the states instead.";
+    params.insert("thingId", enumValueName(Uuid));
+    params.insert("states", objectRef<States>());
+    registerNotification("StatesChanged", description, params);
+
     params.clear(); returns.clear();
     description = "Emitted whenever a thing was removed.";
     params.insert("thingId", enumValueName(Uuid));
@@ -412,6 +491,20 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
     params.insert("thing", objectRef<Thing>());
     registerNotification("ThingAdded", description, params);
 
+    params.clear(); returns.clear();
+    description = "Emitted when multiple things were added at once, e.g. the auto things of a bridge. Only sent to "
+                  "clients which enabled batchStates in JSONRPC.Hello, other clients receive a ThingAdded "
+                  "notification for each of the things instead.";
+    params.insert("things", QVariantList() << objectRef<Thing>());
+    registerNotification("ThingsAdded", description, params);
+
+    params.clear(); returns.clear();
+    description = "Emitted during a DiscoverThings call with streamResults enabled, whenever the discovery found "
+                  "new things. Only sent to the client which started the discovery.";
+    params.insert("thingClassId", enumValueName(Uuid));
+    params.insert("thingDescriptors", objectRef<ThingDescriptors>());
+    registerNotification("DiscoveryResultsAdded", description, params);
+
     params.clear(); returns.clear();
     description = "Emitted whenever the params or name of a thing are changed (by EditThing or ReconfigureThing).";
     params.insert("thing", objectRef<Thing>());
@@ -435,6 +528,9 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
     params.insert("event", objectRef<Event>());
     registerNotification("EventTriggered", description, params);
     connect(NymeaCore::instance(), &NymeaCore::eventTriggered, this, [this](const Event &event){
+        if (!hasSubscribers()) {
+            return;
+        }
         QVariantMap params;
         params.insert("event", pack(event));
         emit EventTriggered(params);
@@ -460,14 +556,28 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
         emit IOConnectionRemoved(params);
     });
 
+    m_revision = static_cast<quint64>(QDateTime::currentMSecsSinceEpoch());
+    m_journalStart = m_revision;
+
     connect(NymeaCore::instance(), &NymeaCore::pluginConfigChanged, this, &IntegrationsHandler::pluginConfigChanged);
     connect(NymeaCore::instance(), &NymeaCore::thingStateChanged, this, &IntegrationsHandler::thingStateChanged);
+    connect(NymeaCore::instance(), &NymeaCore::thingStatesChanged, this, &IntegrationsHandler::thingStatesChanged);
     connect(NymeaCore::instance(), &NymeaCore::thingRemoved, this, &IntegrationsHandler::thingRemovedNotification);
-    connect(NymeaCore::instance(), &NymeaCore::thingAdded, this, &IntegrationsHandler::thingAddedNotification);
+    connect(NymeaCore::instance(), &NymeaCore::thingsAdded, this, &IntegrationsHandler::thingsAddedNotification);
     connect(NymeaCore::instance(), &NymeaCore::thingChanged, this, &IntegrationsHandler::thingChangedNotification);
     connect(NymeaCore::instance(), &NymeaCore::thingSettingChanged, this, &IntegrationsHandler::thingSettingChangedNotification);
 
+    ThingManagerImplementation *thingManagerImplementation = qobject_cast<ThingManagerImplementation*>(m_thingManager);
+    if (thingManagerImplementation) {
+        connect(thingManagerImplementation, &ThingManagerImplementation::pluginLoaded, this, [this](){
+            m_packedCatalogs.clear();
+        });
+    }
+
     connect(NymeaCore::instance(), &NymeaCore::initialized, this, [=](){
+        // Thing classes of missing plugins are restored from the plugin info cache while loading things
+        m_packedCatalogs.clear();
+
         // Generating cache hashes.
         // NOTE: We need to sort the lists to get a stable result
         QHash<ThingClassId, ThingClass> thingClassesMap;
@@ -511,22 +621,23 @@ QHash<QString, QString> IntegrationsHandler::cacheHashes() const
 JsonReply* IntegrationsHandler::GetVendors(const QVariantMap &params, const JsonContext &context) const
 {
     Q_UNUSED(params)
-    QVariantList vendors;
-    foreach (const Vendor &vendor, NymeaCore::instance()->thingManager()->supportedVendors()) {
-        Vendor translatedVendor = NymeaCore::instance()->thingManager()->translateVendor(vendor, context.locale());
-        vendors.append(pack(translatedVendor));
-    }
-
     QVariantMap returns;
-    returns.insert("vendors", vendors);
+    returns.insert("vendors", QVariant::fromValue(packedCatalog(context.locale()).vendors));
     return createReply(returns);
 }
 
 JsonReply* IntegrationsHandler::GetThingClasses(const QVariantMap &params, const JsonContext &context) const
 {
     QVariantMap returns;
-    QVariantList thingClasses;
+    const PackedCatalog &catalog = packedCatalog(context.locale());
 
+    if (!params.contains("vendorId") && !params.contains("thingClassIds")) {
+        returns.insert("thingError", enumValueName(Thing::ThingErrorNoError));
+        returns.insert("thingClasses", QVariant::fromValue(catalog.thingClasses));
+        return createReply(returns);
+    }
+
+    QVariantList thingClasses;
     foreach (const ThingClass &thingClass, NymeaCore::instance()->thingManager()->supportedThings()) {
         if (params.contains("vendorId") && thingClass.vendorId() != VendorId(params.value("vendorId").toUuid())) {
             continue;
@@ -544,8 +655,7 @@ JsonReply* IntegrationsHandler::GetThingClasses(const QVariantMap &params, const
             }
         }
 
-        ThingClass translatedThingClass = NymeaCore::instance()->thingManager()->translateThingClass(thingClass, context.locale());
-        thingClasses.append(pack(translatedThingClass));
+        thingClasses.append(QVariant::fromValue(catalog.thingClassesById.value(thingClass.id())));
     }
 
     returns.insert("thingError", enumValueName(Thing::ThingErrorNoError));
@@ -564,6 +674,19 @@ JsonReply *IntegrationsHandler::DiscoverThings(const QVariantMap &params, const
 
     JsonReply *reply = createAsyncReply("DiscoverThings");
     ThingDiscoveryInfo *info = NymeaCore::instance()->thingManager()->discoverThings(thingClassId, discoveryParams);
+    if (params.value("streamResults").toBool()) {
+        QUuid clientId = context.clientId();
+        connect(info, &ThingDiscoveryInfo::thingDescriptorsAdded, reply, [this, clientId, thingClassId](const ThingDescriptors &thingDescriptors){
+            QVariantList thingDescriptorList;
+            foreach (const ThingDescriptor &thingDescriptor, thingDescriptors) {
+                thingDescriptorList.append(pack(thingDescriptor));
+            }
+            QVariantMap params;
+            params.insert("thingClassId", thingClassId);
+            params.insert("thingDescriptors", thingDescriptorList);
+            emit DiscoveryResultsAdded(clientId, params);
+        });
+    }
     connect(info, &ThingDiscoveryInfo::finished, reply, [this, reply, info, locale](){
         QVariantMap returns;
         returns.insert("thingError", enumValueName<Thing::ThingError>(info->status()));
@@ -740,32 +863,88 @@ JsonReply *IntegrationsHandler::ConfirmPairing(const QVariantMap &params)
 JsonReply* IntegrationsHandler::GetThings(const QVariantMap &params, const JsonContext &context) const
 {
     QVariantMap returns;
-    QVariantList things;
+    // Written straight into the reply instead of building a map for each thing
+    QByteArray things;
+    JsonWriter writer(&things);
+    writer.beginArray();
     if (params.contains("thingId")) {
         Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(ThingId(params.value("thingId").toString()));
         if (!thing) {
             returns.insert("thingError", enumValueName<Thing::ThingError>(Thing::ThingErrorThingNotFound));
             return createReply(returns);
         } else {
-            QVariantMap packedThing = pack(thing).toMap();
-            QString translatedSetupStatus = NymeaCore::instance()->thingManager()->translate(thing->pluginId(), thing->setupDisplayMessage(), context.locale());
-            if (!translatedSetupStatus.isEmpty()) {
-                packedThing["setupDisplayMessage"] = translatedSetupStatus;
-            }
-            things.append(packedThing);
+            packThing(writer, thing, context.locale());
         }
     } else {
         foreach (Thing *thing, NymeaCore::instance()->thingManager()->configuredThings()) {
-            QVariantMap packedThing = pack(thing).toMap();
-            QString translatedSetupStatus = NymeaCore::instance()->thingManager()->translate(thing->pluginId(), thing->setupDisplayMessage(), context.locale());
-            if (!translatedSetupStatus.isEmpty()) {
-                packedThing["setupDisplayMessage"] = translatedSetupStatus;
-            }
-            things.append(packedThing);
+            packThing(writer, thing, context.locale());
         }
     }
+    writer.endArray();
     returns.insert("thingError", enumValueName<Thing::ThingError>(Thing::ThingErrorNoError));
-    returns.insert("things", things);
+    returns.insert("things", QVariant::fromValue(JsonFragment(things)));
+    returns.insert("revision", m_revision);
+    return createReply(returns);
+}
+
+JsonReply *IntegrationsHandler::GetChanges(const QVariantMap &params, const JsonContext &context) const
+{
+    quint64 sinceRevision = params.value("sinceRevision").toULongLong();
+
+    QVariantMap returns;
+    QByteArray things;
+    JsonWriter writer(&things);
+    QVariantList states;
+    QVariantList removedThingIds;
+
+    bool full = sinceRevision < m_journalStart || sinceRevision > m_revision;
+    writer.beginArray();
+    if (full) {
+        qCDebug(dcJsonRpc()) << "Revision" << sinceRevision << "is out of the journal window. Sending all things.";
+        foreach (Thing *thing, NymeaCore::instance()->thingManager()->configuredThings()) {
+            packThing(writer, thing, context.locale());
+        }
+    } else {
+        QSet<ThingId> changedThings;
+        for (QHash<ThingId, quint64>::const_iterator it = m_thingRevisions.constBegin(); it != m_thingRevisions.constEnd(); ++it) {
+            if (it.value() <= sinceRevision) {
+                continue;
+            }
+            Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(it.key());
+            if (thing) {
+                changedThings.insert(it.key());
+                packThing(writer, thing, context.locale());
+            }
+        }
+        for (QHash<QPair<ThingId, StateTypeId>, quint64>::const_iterator it = m_stateRevisions.constBegin(); it != m_stateRevisions.constEnd(); ++it) {
+            // States of changed things are contained in the thing already
+            if (it.value() <= sinceRevision || changedThings.contains(it.key().first)) {
+                continue;
+            }
+            Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(it.key().first);
+            if (thing) {
+                QVariantMap state;
+                state.insert("thingId", it.key().first);
+                state.insert("stateTypeId", it.key().second);
+                state.insert("value", thing->stateValue(it.key().second));
+                states.append(state);
+            }
+        }
+        for (int i = m_removedThings.count() - 1; i >= 0 && m_removedThings.at(i).first > sinceRevision; i--) {
+            // Might have been added again in the meantime
+            if (!NymeaCore::instance()->thingManager()->findConfiguredThing(m_removedThings.at(i).second)) {
+                removedThingIds.append(m_removedThings.at(i).second);
+            }
+        }
+    }
+
+    writer.endArray();
+
+    returns.insert("revision", m_revision);
+    returns.insert("full", full);
+    returns.insert("things", QVariant::fromValue(JsonFragment(things)));
+    returns.insert("states", states);
+    returns.insert("removedThingIds", removedThingIds);
     return createReply(returns);
 }
 
@@ -877,6 +1056,19 @@ JsonReply *IntegrationsHandler::SetStateFilter(const QVariantMap &params)
     return createReply(statusToReply(status));
 }
 
+JsonReply *IntegrationsHandler::SetStateChangePolicy(const QVariantMap &params)
+{
+    ThingId thingId = ThingId(params.value("thingId").toString());
+    StateTypeId stateTypeId = StateTypeId(params.value("stateTypeId").toUuid());
+    StateChangePolicy policy;
+    policy.setDeadband(params.value("deadband").toDouble());
+    policy.setRelativeDeadband(params.value("relativeDeadband").toDouble());
+    policy.setMinInterval(params.value("minInterval").toUInt());
+    policy.setMaxInterval(params.value("maxInterval").toUInt());
+    Thing::ThingError status = NymeaCore::instance()->thingManager()->setStateChangePolicy(thingId, stateTypeId, policy);
+    return createReply(statusToReply(status));
+}
+
 JsonReply* IntegrationsHandler::GetEventTypes(const QVariantMap &params, const JsonContext &context) const
 {
     ThingClass thingClass = NymeaCore::instance()->thingManager()->findThingClass(ThingClassId(params.value("thingClassId").toString()));
@@ -935,6 +1127,31 @@ JsonReply *IntegrationsHandler::GetStateValues(const QVariantMap &params) const
     return createReply(returns);
 }
 
+JsonReply *IntegrationsHandler::GetStateHistory(const QVariantMap &params) const
+{
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(ThingId(params.value("thingId").toString()));
+    if (!thing) {
+        return createReply(statusToReply(Thing::ThingErrorThingNotFound));
+    }
+    StateTypeId stateTypeId = StateTypeId(params.value("stateTypeId").toString());
+    if (!thing->hasState(stateTypeId)) {
+        return createReply(statusToReply(Thing::ThingErrorStateTypeNotFound));
+    }
+
+    QVariantList history;
+    typedef QPair<QDateTime, QVariant> HistoryEntry;
+    foreach (const HistoryEntry &entry, NymeaCore::instance()->logEngine()->stateHistory(thing->id(), stateTypeId)) {
+        QVariantMap historyEntry;
+        historyEntry.insert("timestamp", entry.first.toMSecsSinceEpoch());
+        historyEntry.insert("value", entry.second);
+        history.append(historyEntry);
+    }
+
+    QVariantMap returns = statusToReply(Thing::ThingErrorNoError);
+    returns.insert("history", history);
+    return createReply(returns);
+}
+
 JsonReply *IntegrationsHandler::BrowseThing(const QVariantMap &params, const JsonContext &context) const
 {
     ThingId thingId = ThingId(params.value("thingId").toString());
@@ -1089,6 +1306,14 @@ JsonReply *IntegrationsHandler::DisconnectIO(const QVariantMap &params)
     return createReply(statusToReply(error));
 }
 
+JsonReply *IntegrationsHandler::GetPluginStatistics(const QVariantMap &params)
+{
+    Q_UNUSED(params)
+    QVariantMap returns;
+    returns.insert("plugins", PluginStatistics::collect(m_thingManager->plugins()));
+    return createReply(returns);
+}
+
 QVariantMap IntegrationsHandler::packBrowserItem(const BrowserItem &item)
 {
     QVariantMap ret;
@@ -1113,6 +1338,10 @@ QVariantMap IntegrationsHandler::packBrowserItem(const BrowserItem &item)
 
 void IntegrationsHandler::pluginConfigChanged(const PluginId &id, const ParamList &config)
 {
+    if (!hasSubscribers()) {
+        return;
+    }
+
     QVariantMap params;
     params.insert("pluginId", id);
     QVariantList configList;
@@ -1125,6 +1354,12 @@ void IntegrationsHandler::pluginConfigChanged(const PluginId &id, const ParamLis
 
 void IntegrationsHandler::thingStateChanged(Thing *thing, const QUuid &stateTypeId, const QVariant &value, const QVariant &minValue, const QVariant &maxValue)
 {
+    m_stateRevisions.insert(qMakePair(thing->id(), StateTypeId(stateTypeId)), ++m_revision);
+
+    if (!hasSubscribers()) {
+        return;
+    }
+
     QVariantMap params;
     params.insert("thingId", thing->id());
     params.insert("stateTypeId", stateTypeId);
@@ -1134,29 +1369,102 @@ void IntegrationsHandler::thingStateChanged(Thing *thing, const QUuid &stateType
     emit StateChanged(params);
 }
 
+void IntegrationsHandler::thingStatesChanged(Thing *thing, const QList<StateTypeId> &stateTypeIds)
+{
+    foreach (const StateTypeId &stateTypeId, stateTypeIds) {
+        m_stateRevisions.insert(qMakePair(thing->id(), stateTypeId), ++m_revision);
+    }
+
+    if (!hasSubscribers()) {
+        return;
+    }
+
+    QVariantList states;
+    foreach (const StateTypeId &stateTypeId, stateTypeIds) {
+        states.append(pack(thing->state(stateTypeId)));
+    }
+    QVariantMap params;
+    params.insert("thingId", thing->id());
+    params.insert("states", states);
+    emit StatesChanged(params);
+}
+
 void IntegrationsHandler::thingRemovedNotification(const ThingId &thingId)
 {
+    m_thingRevisions.remove(thingId);
+    QHash<QPair<ThingId, StateTypeId>, quint64>::iterator it = m_stateRevisions.begin();
+    while (it != m_stateRevisions.end()) {
+        if (it.key().first == thingId) {
+            it = m_stateRevisions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_removedThings.append(qMakePair(++m_revision, thingId));
+    // Keep the journal bounded. Clients with an older revision get a full snapshot.
+    if (m_removedThings.count() > 1000) {
+        m_journalStart = m_removedThings.takeFirst().first;
+    }
+    if (m_packedThingId == thingId) {
+        m_packedThingId = ThingId();
+        m_packedThing.clear();
+    }
+    m_packedThings.remove(thingId);
+
+    if (!hasSubscribers()) {
+        return;
+    }
+
     QVariantMap params;
     params.insert("thingId", thingId);
     emit ThingRemoved(params);
 }
 
-void IntegrationsHandler::thingAddedNotification(Thing *thing)
+void IntegrationsHandler::thingsAddedNotification(const QList<Thing*> &things)
 {
+    foreach (Thing *thing, things) {
+        bumpThingRevision(thing->id());
+    }
+
+    if (!hasSubscribers()) {
+        return;
+    }
+
     QVariantMap params;
-    params.insert("thing", pack(thing));
-    emit ThingAdded(params);
+    if (things.count() == 1) {
+        params.insert("thing", packedThing(things.first()));
+        emit ThingAdded(params);
+        return;
+    }
+    QVariantList packedThings;
+    foreach (Thing *thing, things) {
+        packedThings.append(packedThing(thing));
+    }
+    params.insert("things", packedThings);
+    emit ThingsAdded(params);
 }
 
 void IntegrationsHandler::thingChangedNotification(Thing *thing)
 {
+    bumpThingRevision(thing->id());
+
+    if (!hasSubscribers()) {
+        return;
+    }
+
     QVariantMap params;
-    params.insert("thing", pack(thing));
+    params.insert("thing", packedThing(thing));
     emit ThingChanged(params);
 }
 
 void IntegrationsHandler::thingSettingChangedNotification(const ThingId &thingId, const ParamTypeId &paramTypeId, const QVariant &value)
 {
+    bumpThingRevision(thingId);
+
+    if (!hasSubscribers()) {
+        return;
+    }
+
     QVariantMap params;
     params.insert("thingId", thingId);
     params.insert("paramTypeId", paramTypeId.toString());
@@ -1171,4 +1479,103 @@ QVariantMap IntegrationsHandler::statusToReply(Thing::ThingError status) const
     return returns;
 }
 
+const IntegrationsHandler::PackedCatalog &IntegrationsHandler::packedCatalog(const QLocale &locale) const
+{
+    QHash<QString, PackedCatalog>::const_iterator it = m_packedCatalogs.constFind(locale.name());
+    if (it != m_packedCatalogs.constEnd()) {
+        return it.value();
+    }
+
+    PackedCatalog catalog;
+    QByteArray vendors;
+    JsonWriter vendorsWriter(&vendors);
+    vendorsWriter.beginArray();
+    foreach (const Vendor &vendor, m_thingManager->supportedVendors()) {
+        pack(vendorsWriter, m_thingManager->translateVendor(vendor, locale));
+    }
+    vendorsWriter.endArray();
+    catalog.vendors = JsonFragment(vendors);
+
+    QByteArray thingClasses;
+    JsonWriter thingClassesWriter(&thingClasses);
+    thingClassesWriter.beginArray();
+    foreach (const ThingClass &thingClass, m_thingManager->supportedThings()) {
+        QByteArray packedThingClass;
+        JsonWriter thingClassWriter(&packedThingClass);
+        pack(thingClassWriter, m_thingManager->translateThingClass(thingClass, locale));
+        thingClassesWriter.writeFragment(JsonFragment(packedThingClass));
+        catalog.thingClassesById.insert(thingClass.id(), JsonFragment(packedThingClass));
+    }
+    thingClassesWriter.endArray();
+    catalog.thingClasses = JsonFragment(thingClasses);
+    return m_packedCatalogs.insert(locale.name(), catalog).value();
+}
+
+void IntegrationsHandler::packThing(JsonWriter &writer, Thing *thing, const QLocale &locale) const
+{
+    // Everything but the states and the translated setup message is only packed again once the
+    // thing revision moved, states once their own revision moved.
+    PackedThing &packed = m_packedThings[thing->id()];
+    quint64 thingRevision = m_thingRevisions.value(thing->id());
+    if (packed.thing.isNull() || packed.revision != thingRevision) {
+        QVariantMap excluded;
+        excluded.insert("states", QVariant());
+        excluded.insert("setupDisplayMessage", QVariant());
+        QByteArray json;
+        JsonWriter thingWriter(&json);
+        pack(thingWriter, thing, excluded);
+        packed.thing = JsonFragment(json);
+        packed.revision = thingRevision;
+        // Reconfiguring a thing may replace its states
+        packed.states.clear();
+    }
+
+    writer.beginObject();
+    writer.writeMembers(packed.thing);
+
+    QString setupDisplayMessage = thing->setupDisplayMessage();
+    QString translatedSetupStatus = NymeaCore::instance()->thingManager()->translate(thing->pluginId(), setupDisplayMessage, locale);
+    if (!translatedSetupStatus.isEmpty()) {
+        setupDisplayMessage = translatedSetupStatus;
+    }
+    if (!setupDisplayMessage.isNull()) {
+        writer.writeKey("setupDisplayMessage");
+        writer.writeString(setupDisplayMessage);
+    }
+
+    writer.writeKey("states");
+    writer.beginArray();
+    foreach (const State &state, thing->states()) {
+        quint64 stateRevision = m_stateRevisions.value(qMakePair(thing->id(), state.stateTypeId()));
+        QPair<quint64, JsonFragment> &packedState = packed.states[state.stateTypeId()];
+        if (packedState.second.isNull() || packedState.first != stateRevision) {
+            QByteArray json;
+            JsonWriter stateWriter(&json);
+            pack(stateWriter, state);
+            packedState = qMakePair(stateRevision, JsonFragment(json));
+        }
+        writer.writeFragment(packedState.second);
+    }
+    writer.endArray();
+    writer.endObject();
+}
+
+void IntegrationsHandler::bumpThingRevision(const ThingId &thingId)
+{
+    m_thingRevisions.insert(thingId, ++m_revision);
+}
+
+QVariantMap IntegrationsHandler::packedThing(Thing *thing)
+{
+    // Any change to a thing or its states bumps the revision, so the packed map stays valid
+    // for as long as the revision doesn't move. This lets the Devices namespace reuse it
+    // when both namespaces notify about the same change.
+    if (m_packedThingId != thing->id() || m_packedThingRevision != m_revision) {
+        m_packedThing = pack(thing).toMap();
+        m_packedThingId = thing->id();
+        m_packedThingRevision = m_revision;
+    }
+    return m_packedThing;
+}
+
 }
@@ -55,18 +55,21 @@ public:
     Q_INVOKABLE JsonReply *PairThing(const QVariantMap &params, const JsonContext &context);
     Q_INVOKABLE JsonReply *ConfirmPairing(const QVariantMap &params);
     Q_INVOKABLE JsonReply *GetThings(const QVariantMap &params, const JsonContext &context) const;
+    Q_INVOKABLE JsonReply *GetChanges(const QVariantMap &params, const JsonContext &context) const;
     Q_INVOKABLE JsonReply *ReconfigureThing(const QVariantMap &params, const JsonContext &context);
     Q_INVOKABLE JsonReply *EditThing(const QVariantMap &params);
     Q_INVOKABLE JsonReply *RemoveThing(const QVariantMap &params);
     Q_INVOKABLE JsonReply *SetThingSettings(const QVariantMap &params);
     Q_INVOKABLE JsonReply *SetEventLogging(const QVariantMap &params);
     Q_INVOKABLE JsonReply *SetStateFilter(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *SetStateChangePolicy(const QVariantMap &params);
 
     Q_INVOKABLE JsonReply *GetEventTypes(const QVariantMap &params, const JsonContext &context) const;
     Q_INVOKABLE JsonReply *GetActionTypes(const QVariantMap &params, const JsonContext &context) const;
     Q_INVOKABLE JsonReply *GetStateTypes(const QVariantMap &params, const JsonContext &context) const;
     Q_INVOKABLE JsonReply *GetStateValue(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *GetStateValues(const QVariantMap &params) const;
+    Q_INVOKABLE JsonReply *GetStateHistory(const QVariantMap &params) const;
 
     Q_INVOKABLE JsonReply *BrowseThing(const QVariantMap &params, const JsonContext &context) const;
     Q_INVOKABLE JsonReply *GetBrowserItem(const QVariantMap &params, const JsonContext &context) const;
@@ -79,27 +82,36 @@ public:
     Q_INVOKABLE JsonReply *ConnectIO(const QVariantMap &params);
     Q_INVOKABLE JsonReply *DisconnectIO(const QVariantMap &params);
 
+    Q_INVOKABLE JsonReply *GetPluginStatistics(const QVariantMap &params);
+
     static QVariantMap packBrowserItem(const BrowserItem &item);
 
+    QVariantMap packedThing(Thing *thing);
+
 signals:
     void PluginConfigurationChanged(const QVariantMap &params);
     void StateChanged(const QVariantMap &params);
+    void StatesChanged(const QVariantMap &params);
     void ThingRemoved(const QVariantMap &params);
     void ThingAdded(const QVariantMap &params);
+    void ThingsAdded(const QVariantMap &params);
     void ThingChanged(const QVariantMap &params);
     void ThingSettingChanged(const QVariantMap &params);
     void EventTriggered(const QVariantMap &params);
     void IOConnectionAdded(const QVariantMap &params);
     void IOConnectionRemoved(const QVariantMap &params);
+    // Emitted from the const DiscoverThings call
+    void DiscoveryResultsAdded(const QUuid &clientId, const QVariantMap &params) const;
 
 private slots:
     void pluginConfigChanged(const PluginId &id, const ParamList &config);
 
     void thingStateChanged(Thing *thing, const QUuid &stateTypeId, const QVariant &value, const QVariant &minValue, const QVariant &maxValue);
+    void thingStatesChanged(Thing *thing, const QList<StateTypeId> &stateTypeIds);
 
     void thingRemovedNotification(const ThingId &thingId);
 
-    void thingAddedNotification(Thing *thing);
+    void thingsAddedNotification(const QList<Thing*> &things);
 
     void thingChangedNotification(Thing *thing);
 
@@ -108,8 +120,43 @@ private slots:
 private:
     ThingManager *m_thingManager = nullptr;
     QVariantMap statusToReply(Thing::ThingError status) const;
+    void packThing(JsonWriter &writer, Thing *thing, const QLocale &locale) const;
+
+    void bumpThingRevision(const ThingId &thingId);
+
+    // Change journal for GetChanges. Revisions start at the startup time in ms, so revisions
+    // handed out by a previous run are always older than the journal.
+    quint64 m_revision = 0;
+    quint64 m_journalStart = 0;
+    QHash<ThingId, quint64> m_thingRevisions;
+    QHash<QPair<ThingId, StateTypeId>, quint64> m_stateRevisions;
+    QList<QPair<quint64, ThingId>> m_removedThings;
+
+    // Last thing packed for a notification, shared with the Devices namespace
+    ThingId m_packedThingId;
+    quint64 m_packedThingRevision = 0;
+    QVariantMap m_packedThing;
+
+    // Serialized things for GetThings and GetChanges, along with the revisions they were packed at
+    class PackedThing {
+    public:
+        quint64 revision = 0;
+        JsonFragment thing;
+        QHash<StateTypeId, QPair<quint64, JsonFragment> > states;
+    };
+    mutable QHash<ThingId, PackedThing> m_packedThings;
 
     QHash<QString, QString> m_cacheHashes;
+
+    // Translated and serialized vendors and thing classes by locale name, dropped whenever a plugin gets loaded
+    class PackedCatalog {
+    public:
+        JsonFragment vendors;
+        JsonFragment thingClasses;
+        QHash<ThingClassId, JsonFragment> thingClassesById;
+    };
+    mutable QHash<QString, PackedCatalog> m_packedCatalogs;
+    const PackedCatalog &packedCatalog(const QLocale &locale) const;
 };
 
 }
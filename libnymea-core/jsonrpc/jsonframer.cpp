@@ -0,0 +1,157 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::JsonFramer
+    \brief Splits a stream of JSON data into messages.
+
+    \ingroup api
+    \inmodule core
+
+    The framer tracks the nesting depth and the string state of the incoming data, so message
+    boundaries are found in a single pass regardless of how the stream is fragmented and of what
+    the string values contain. Complete messages are handed out as offsets into the buffer
+    without copying them.
+
+    Data which doesn't start a JSON object or array, as well as a raw newline within a string,
+    which is not valid JSON, ends the message at the next newline. Such messages are passed on
+    as they are, so the client gets a parse error for them.
+*/
+
+#include "jsonframer.h"
+
+namespace nymeaserver {
+
+/*! Appends \a data received from the stream and scans it for complete messages. */
+void JsonFramer::append(const QByteArray &data)
+{
+    m_buffer.append(data);
+    scan();
+}
+
+/*! Returns all complete messages found so far and drops them from the buffer. */
+JsonFramer::Messages JsonFramer::takeMessages()
+{
+    Messages messages;
+    if (m_spans.isEmpty()) {
+        return messages;
+    }
+    messages.data = m_buffer;
+    messages.spans = m_spans;
+    m_spans.clear();
+
+    // Only the incomplete message, if any, stays in the buffer
+    int consumed = m_messageStart >= 0 ? m_messageStart : m_buffer.size();
+    m_buffer.remove(0, consumed);
+    m_scanPos -= consumed;
+    if (m_messageStart >= 0) {
+        m_messageStart = 0;
+    }
+    return messages;
+}
+
+int JsonFramer::bufferedSize() const
+{
+    return m_buffer.size();
+}
+
+void JsonFramer::scan()
+{
+    const char *data = m_buffer.constData();
+    int size = m_buffer.size();
+    for (int i = m_scanPos; i < size; i++) {
+        char c = data[i];
+
+        if (m_messageStart < 0) {
+            // Skip whitespace between messages
+            if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+                continue;
+            }
+            m_messageStart = i;
+            m_depth = 0;
+            m_inString = false;
+            m_escape = false;
+            m_garbage = c != '{' && c != '[';
+            if (!m_garbage) {
+                m_depth = 1;
+            }
+            continue;
+        }
+
+        if (m_garbage) {
+            if (c == '\n') {
+                finishMessage(i);
+            }
+            continue;
+        }
+
+        if (m_inString) {
+            if (m_escape) {
+                m_escape = false;
+            } else if (c == '\\') {
+                m_escape = true;
+            } else if (c == '"') {
+                m_inString = false;
+            } else if (c == '\n') {
+                // Not allowed in a JSON string, this message is broken
+                finishMessage(i);
+            }
+            continue;
+        }
+
+        switch (c) {
+        case '"':
+            m_inString = true;
+            break;
+        case '{':
+        case '[':
+            m_depth++;
+            break;
+        case '}':
+        case ']':
+            m_depth--;
+            if (m_depth == 0) {
+                finishMessage(i + 1);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    m_scanPos = size;
+}
+
+void JsonFramer::finishMessage(int end)
+{
+    m_spans.append(qMakePair(m_messageStart, end - m_messageStart));
+    m_messageStart = -1;
+}
+
+}
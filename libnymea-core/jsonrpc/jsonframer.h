@@ -0,0 +1,80 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef JSONFRAMER_H
+#define JSONFRAMER_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QPair>
+
+namespace nymeaserver {
+
+class JsonFramer
+{
+public:
+    // Complete messages found in the stream. Each span (offset, length) points into data.
+    class Messages {
+    public:
+        QByteArray data;
+        QVector<QPair<int, int>> spans;
+
+        int count() const { return spans.count(); }
+        // A view into data, only valid as long as this object is alive
+        QByteArray at(int index) const { return QByteArray::fromRawData(data.constData() + spans.at(index).first, spans.at(index).second); }
+    };
+
+    JsonFramer() {}
+
+    void append(const QByteArray &data);
+    Messages takeMessages();
+
+    // Size of the incomplete message still being buffered
+    int bufferedSize() const;
+
+private:
+    void scan();
+    void finishMessage(int end);
+
+    QByteArray m_buffer;
+    int m_scanPos = 0;
+    QVector<QPair<int, int>> m_spans;
+
+    // State of the message currently being scanned
+    int m_messageStart = -1;
+    int m_depth = 0;
+    bool m_inString = false;
+    bool m_escape = false;
+    bool m_garbage = false;
+};
+
+}
+
+#endif // JSONFRAMER_H
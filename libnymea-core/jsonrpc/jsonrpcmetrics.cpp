@@ -0,0 +1,192 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::JsonRpcMetrics
+    \brief Keeps performance counters of the JSON-RPC server.
+
+    \ingroup api
+    \inmodule core
+
+    The server records how long each stage of handling a message takes: parsing, validating the
+    params, executing the handler, serializing the reply and handing it to the transport. Handler
+    execution is additionally counted per method, asynchronous calls up to their reply. Traffic
+    is counted per transport.
+
+    Latencies are kept in log-linear histograms, which have a fixed relative precision and can be
+    queried for percentiles. All counters accumulate since the start of the server.
+*/
+
+#include "jsonrpcmetrics.h"
+
+#include <QtAlgorithms>
+
+namespace nymeaserver {
+
+static const int bucketsPerPowerOfTwo = 4;
+// Enough for samples up to 2^32 microseconds, more than an hour
+static const int bucketCount = 31 * bucketsPerPowerOfTwo;
+
+/*! Adds a sample of \a nsecs nanoseconds. */
+void LatencyHistogram::record(qint64 nsecs)
+{
+    quint64 usecs = nsecs > 0 ? static_cast<quint64>(nsecs) / 1000 : 0;
+    if (m_buckets.isEmpty()) {
+        m_buckets.resize(bucketCount);
+    }
+    m_buckets[bucketIndex(usecs)]++;
+    m_count++;
+    m_totalUsecs += usecs;
+    m_maxUsecs = qMax(m_maxUsecs, usecs);
+}
+
+/*! Returns the latency in microseconds which \a percent percent of the samples don't exceed. */
+quint64 LatencyHistogram::percentile(double percent) const
+{
+    if (m_count == 0) {
+        return 0;
+    }
+    quint64 target = qMax<quint64>(1, static_cast<quint64>(m_count * percent / 100 + 0.5));
+    quint64 seen = 0;
+    for (int i = 0; i < m_buckets.count(); i++) {
+        seen += m_buckets.at(i);
+        if (seen >= target) {
+            return qMin(bucketUpperBound(i), m_maxUsecs);
+        }
+    }
+    return m_maxUsecs;
+}
+
+QVariantMap LatencyHistogram::toMap() const
+{
+    QVariantMap map;
+    map.insert("count", m_count);
+    map.insert("totalUs", m_totalUsecs);
+    map.insert("maxUs", m_maxUsecs);
+    map.insert("p50Us", percentile(50));
+    map.insert("p90Us", percentile(90));
+    map.insert("p99Us", percentile(99));
+    return map;
+}
+
+int LatencyHistogram::bucketIndex(quint64 usecs)
+{
+    if (usecs < bucketsPerPowerOfTwo) {
+        return static_cast<int>(usecs);
+    }
+    usecs = qMin<quint64>(usecs, 0xffffffff);
+    int msb = 31 - qCountLeadingZeroBits(static_cast<quint32>(usecs));
+    int sub = static_cast<int>(usecs >> (msb - 2)) & (bucketsPerPowerOfTwo - 1);
+    return (msb - 1) * bucketsPerPowerOfTwo + sub;
+}
+
+quint64 LatencyHistogram::bucketUpperBound(int index)
+{
+    int next = index + 1;
+    if (next < bucketsPerPowerOfTwo) {
+        return static_cast<quint64>(next);
+    }
+    int msb = next / bucketsPerPowerOfTwo + 1;
+    int sub = next % bucketsPerPowerOfTwo;
+    return static_cast<quint64>(bucketsPerPowerOfTwo + sub) << (msb - 2);
+}
+
+JsonRpcMetrics::JsonRpcMetrics()
+{
+    m_clock.start();
+}
+
+/*! Records that handling a message spent \a nsecs nanoseconds in the given \a stage. */
+void JsonRpcMetrics::recordStage(Stage stage, qint64 nsecs)
+{
+    m_stages[stage].record(nsecs);
+}
+
+/*! Records a call of \a method which took \a nsecs nanoseconds until its reply and whether it \a timedOut. */
+void JsonRpcMetrics::recordCall(const QString &method, qint64 nsecs, bool failed)
+{
+    MethodCounters &counters = m_methods[method];
+    counters.latency.record(nsecs);
+    if (timedOut) {
+        counters.timeouts++;
+    }
+    m_stages[StageExecution].record(nsecs);
+}
+
+/*! Records \a bytes received on the given \a transport. */
+void JsonRpcMetrics::recordIncoming(const QString &transport, int bytes)
+{
+    TransportCounters &counters = m_transports[transport];
+    counters.bytesIn += static_cast<quint64>(bytes);
+    counters.messagesIn++;
+}
+
+/*! Records a message of \a bytes sent to \a clients on the given \a transport. */
+void JsonRpcMetrics::recordOutgoing(const QString &transport, int bytes, int clients)
+{
+    TransportCounters &counters = m_transports[transport];
+    counters.bytesOut += static_cast<quint64>(bytes) * static_cast<quint64>(clients);
+    counters.messagesOut += static_cast<quint64>(clients);
+}
+
+QVariantMap JsonRpcMetrics::toMap() const
+{
+    static const char *stageNames[] = {"parse", "validation", "execution", "serialization", "write"};
+
+    QVariantMap stages;
+    for (int i = StageParse; i <= StageWrite; i++) {
+        stages.insert(stageNames[i], m_stages[i].toMap());
+    }
+
+    QVariantMap methods;
+    for (QHash<QString, MethodCounters>::const_iterator it = m_methods.constBegin(); it != m_methods.constEnd(); ++it) {
+        QVariantMap method = it.value().latency.toMap();
+        method.insert("timeouts", it.value().timeouts);
+        methods.insert(it.key(), method);
+    }
+
+    QVariantMap transports;
+    for (QHash<QString, TransportCounters>::const_iterator it = m_transports.constBegin(); it != m_transports.constEnd(); ++it) {
+        QVariantMap transport;
+        transport.insert("bytesIn", it.value().bytesIn);
+        transport.insert("bytesOut", it.value().bytesOut);
+        transport.insert("messagesIn", it.value().messagesIn);
+        transport.insert("messagesOut", it.value().messagesOut);
+        transports.insert(it.key(), transport);
+    }
+
+    QVariantMap map;
+    map.insert("stages", stages);
+    map.insert("methods", methods);
+    map.insert("transports", transports);
+    return map;
+}
+
+}
@@ -0,0 +1,110 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef JSONRPCMETRICS_H
+#define JSONRPCMETRICS_H
+
+#include <QElapsedTimer>
+#include <QVariantMap>
+#include <QVector>
+#include <QString>
+#include <QHash>
+
+namespace nymeaserver {
+
+// Counts samples in log-linear buckets, 4 per power of two microseconds, like a HDR histogram
+// with 2 significant bits. Recording is a couple of integer operations.
+class LatencyHistogram
+{
+public:
+    void record(qint64 nsecs);
+
+    quint64 count() const { return m_count; }
+    // Upper bound of the bucket holding the given percentile, in microseconds
+    quint64 percentile(double percent) const;
+
+    QVariantMap toMap() const;
+
+private:
+    static int bucketIndex(quint64 usecs);
+    static quint64 bucketUpperBound(int index);
+
+    QVector<quint32> m_buckets;
+    quint64 m_count = 0;
+    quint64 m_totalUsecs = 0;
+    quint64 m_maxUsecs = 0;
+};
+
+class JsonRpcMetrics
+{
+public:
+    enum Stage {
+        StageParse,
+        StageValidation,
+        StageExecution,
+        StageSerialization,
+        StageWrite
+    };
+
+    JsonRpcMetrics();
+
+    // Monotonic timestamp to measure stages with
+    qint64 now() const { return m_clock.nsecsElapsed(); }
+
+    void recordStage(Stage stage, qint64 nsecs);
+    void recordCall(const QString &method, qint64 nsecs, bool timedOut);
+    void recordIncoming(const QString &transport, int bytes);
+    void recordOutgoing(const QString &transport, int bytes, int clients);
+
+    QVariantMap toMap() const;
+
+private:
+    class MethodCounters {
+    public:
+        quint64 timeouts = 0;
+        LatencyHistogram latency;
+    };
+    class TransportCounters {
+    public:
+        quint64 bytesIn = 0;
+        quint64 bytesOut = 0;
+        quint64 messagesIn = 0;
+        quint64 messagesOut = 0;
+    };
+
+    QElapsedTimer m_clock;
+    LatencyHistogram m_stages[StageWrite + 1];
+    QHash<QString, MethodCounters> m_methods;
+    QHash<QString, TransportCounters> m_transports;
+};
+
+}
+
+#endif // JSONRPCMETRICS_H
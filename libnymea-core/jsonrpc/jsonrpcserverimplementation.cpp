@@ -47,6 +47,7 @@
 
 #include "jsonrpcserverimplementation.h"
 #include "jsonrpc/jsonhandler.h"
+#include "jsonrpc/jsonwriter.h"
 #include "jsonvalidator.h"
 #include "nymeacore.h"
 #include "integrations/thingmanager.h"
@@ -59,6 +60,7 @@
 #include "platform/platform.h"
 #include "version.h"
 #include "cloud/cloudmanager.h"
+#include "servers/timeoutwheel.h"
 
 #include "devicehandler.h"
 #include "integrationshandler.h"
@@ -78,23 +80,94 @@
 #include "modbusrtuhandler.h"
 
 #include <QJsonDocument>
+#include <QCryptographicHash>
 #include <QStringList>
 #include <QSslConfiguration>
 
+#include <limits>
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+#include <QCborValue>
+#include <QCborMap>
+#include <QCborArray>
+#include <QCborStreamReader>
+#include <QJsonValue>
+#endif
+
 namespace nymeaserver {
 
+// Clients with more than this many bytes waiting to be written only get coalesced state changes
+static const qint64 laggingClientThreshold = 256 * 1024;
+// How often coalesced state changes are sent to a lagging client
+static const int laggingClientInterval = 1000;
+// Connections not calling JSONRPC.Hello within this time are dropped
+static const qint64 handshakeTimeout = 10000;
+
+// Name of a transport in the performance counters
+static QString transportName(TransportInterface *interface)
+{
+    QString id = interface->configuration().id;
+    return id.isEmpty() ? QString(interface->metaObject()->className()) : id;
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+// Converts the message the same way QJsonDocument would, so CBOR clients see the same schema as JSON clients.
+static QCborValue variantToCbor(const QVariant &value)
+{
+    switch (static_cast<int>(value.type())) {
+    case QVariant::Map: {
+        QCborMap map;
+        const QVariantMap variantMap = value.toMap();
+        for (QVariantMap::const_iterator it = variantMap.constBegin(); it != variantMap.constEnd(); ++it) {
+            map.insert(it.key(), variantToCbor(it.value()));
+        }
+        return map;
+    }
+    case QVariant::List:
+    case QVariant::StringList: {
+        QCborArray array;
+        foreach (const QVariant &entry, value.toList()) {
+            array.append(variantToCbor(entry));
+        }
+        return array;
+    }
+    case QVariant::Invalid:
+        return QCborValue(QCborValue::Null);
+    case QVariant::Bool:
+        return value.toBool();
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+        return value.toLongLong();
+    case QVariant::Double:
+        return value.toDouble();
+    case QVariant::String:
+        return value.toString();
+    default:
+        if (value.userType() == qMetaTypeId<JsonFragment>()) {
+            return variantToCbor(value.value<JsonFragment>().toVariant());
+        }
+        return QCborValue::fromJsonValue(QJsonValue::fromVariant(value));
+    }
+}
+#endif
+
 /*! Constructs a \l{JsonRPCServer} with the given \a sslConfiguration and \a parent. */
-JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration &sslConfiguration, QObject *parent):
+JsonRPCServerImplementation::JsonRPCServerImplementation(TimeoutWheel *timeoutWheel, const QSslConfiguration &sslConfiguration, QObject *parent):
     JsonHandler(parent),
+    m_timeoutWheel(timeoutWheel),
     m_notificationId(0)
 {
     Q_UNUSED(sslConfiguration)
+
     // First, define our own JSONRPC API
 
     // Enums
     registerEnum<BasicType>();
     registerEnum<UserManager::UserError>();
     registerEnum<CloudManager::CloudConnectionState>();
+    registerEnum<JsonRPCServerImplementation::Encoding>();
+    registerEnum<JsonRPCServerImplementation::Compression>();
 
     // Objects
     registerObject<TokenInfo>();
@@ -122,14 +195,41 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
                             "like initialSetupRequired might change if the setup has been performed in the meantime.\n "
                             "The field cacheHashes may contain a map of methods and MD5 hashes. As long as the hash for "
                             "a method does not change, a client may use a previously cached copy of the call instead of "
-                            "fetching the content again.";
+                            "fetching the content again.\n"
+                            "The optional parameter encoding allows to switch the connection to a binary encoding. "
+                            "The reply to this call is still sent using the current encoding and contains the "
+                            "encoding used from then on. EncodingCbor will be rejected if the transport does not "
+                            "support binary data, in which case the connection stays on EncodingJson. With "
+                            "EncodingCbor, each message is a single CBOR encoded map with the same content as the "
+                            "JSON message. Clients must wait for the reply before sending CBOR messages.\n"
+                            "The optional parameter compression enables compression of messages sent by the server, "
+                            "taking effect the same way as the encoding. With CompressionZlib, messages of 1024 bytes "
+                            "or more are sent as a frame consisting of a 0x00 byte, the size of the following data as "
+                            "32 bit big endian integer and the message compressed with qCompress(), i.e. the size of the "
+                            "uncompressed message as 32 bit big endian integer followed by a zlib stream. Smaller "
+                            "messages are sent uncompressed. Messages sent by the client are never compressed. "
+                            "CompressionZlib will be rejected if the transport does not support binary data.\n"
+                            "With batchStates set to true, states of a thing changing together are announced with a "
+                            "single Integrations.StatesChanged notification instead of one Integrations.StateChanged "
+                            "notification per state, unless a state filter or notification interval is in use. "
+                            "Likewise, things added together, e.g. the auto things of a bridge, are announced with "
+                            "a single Integrations.ThingsAdded notification.\n"
+                            "Instead of a single call, a message may contain an array of calls. Such a batch is "
+                            "answered with a single array containing the replies to all of its calls, sent once the "
+                            "last one, including asynchronous calls, has finished. The replies are not necessarily in "
+                            "the order of the calls, use the id to match them.";
     params.insert("o:locale", enumValueName(String));
+    params.insert("o:encoding", enumRef<JsonRPCServerImplementation::Encoding>());
+    params.insert("o:compression", enumRef<JsonRPCServerImplementation::Compression>());
+    params.insert("o:batchStates", enumValueName(Bool));
     returns.insert("server", enumValueName(String));
     returns.insert("name", enumValueName(String));
     returns.insert("version", enumValueName(String));
     returns.insert("uuid", enumValueName(Uuid));
     returns.insert("language", enumValueName(String));
     returns.insert("locale", enumValueName(String));
+    returns.insert("encoding", enumRef<JsonRPCServerImplementation::Encoding>());
+    returns.insert("compression", enumRef<JsonRPCServerImplementation::Compression>());
     returns.insert("protocol version", enumValueName(String));
     returns.insert("initialSetupRequired", enumValueName(Bool));
     returns.insert("authenticationRequired", enumValueName(Bool));
@@ -168,6 +268,31 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     returns.insert("d:enabled", enumValueName(Bool));
     registerMethod("SetNotificationStatus", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Limit the StateChanged notifications of the Integrations and Devices namespaces sent to this "
+                  "connection. A state change is sent if the thing is listed in thingIds or implements one of the "
+                  "given interfaces, and, if stateTypeIds is given, the state type is listed in stateTypeIds. "
+                  "Calling this method without any parameters removes the filter. Other notifications are not "
+                  "affected. The filter in use is returned.";
+    params.insert("o:thingIds", QVariantList() << enumValueName(Uuid));
+    params.insert("o:stateTypeIds", QVariantList() << enumValueName(Uuid));
+    params.insert("o:interfaces", enumValueName(StringList));
+    returns.insert("thingIds", QVariantList() << enumValueName(Uuid));
+    returns.insert("stateTypeIds", QVariantList() << enumValueName(Uuid));
+    returns.insert("interfaces", enumValueName(StringList));
+    registerMethod("SetStateFilter", description, params, returns);
+
+    params.clear(); returns.clear();
+    description = "Limit the rate of StateChanged notifications of the Integrations and Devices namespaces sent to "
+                  "this connection. State changes are collected and sent every interval milliseconds. If a state "
+                  "changes multiple times within the interval, only the latest value is sent. An interval of 0 "
+                  "sends state changes right away, which is the default. Regardless of this setting, a connection "
+                  "which does not keep up with receiving data only receives collected state changes once per "
+                  "second until it has caught up.";
+    params.insert("interval", enumValueName(Uint));
+    returns.insert("interval", enumValueName(Uint));
+    registerMethod("SetNotificationInterval", description, params, returns);
+
     params.clear(); returns.clear();
     description = "Create a new user in the API. Currently this is only allowed to be called once when a new nymea instance is set up. Call Authenticate after this to obtain a device token for this user.";
     params.insert("username", enumValueName(String));
@@ -265,6 +390,13 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     QMetaObject::invokeMethod(this, "setup", Qt::QueuedConnection);
 
     connect(NymeaCore::instance()->userManager(), &UserManager::pushButtonAuthFinished, this, &JsonRPCServerImplementation::onPushButtonAuthFinished);
+    connect(NymeaCore::instance()->userManager(), &UserManager::tokenRevoked, this, [this](const QByteArray &token){
+        for (QHash<QUuid, Client>::iterator it = m_clients.begin(); it != m_clients.end(); ++it) {
+            if (it->token == token) {
+                it->token.clear();
+            }
+        }
+    });
 }
 
 /*! Returns the \e namespace of \l{JsonHandler}. */
@@ -273,21 +405,68 @@ QString JsonRPCServerImplementation::name() const
     return QStringLiteral("JSONRPC");
 }
 
+QHash<QString, QString> JsonRPCServerImplementation::cacheHashes() const
+{
+    // The API only changes when handlers register, the hash is dropped along with the cached replies then
+    if (m_apiHash.isEmpty()) {
+        m_apiHash = QCryptographicHash::hash(QJsonDocument::fromVariant(m_api).toJson(QJsonDocument::Compact), QCryptographicHash::Md5).toHex();
+    }
+    QHash<QString, QString> hashes;
+    hashes.insert("Introspect", m_apiHash);
+    return hashes;
+}
+
 JsonReply *JsonRPCServerImplementation::Hello(const QVariantMap &params, const JsonContext &context)
 {
     TransportInterface *interface = reinterpret_cast<TransportInterface*>(property("transportInterface").toLongLong());
 
     qCDebug(dcJsonRpc()) << params;
     QUuid clientId = context.clientId();
+    QHash<QUuid, Client>::iterator clientIt = m_clients.find(clientId);
+    if (clientIt == m_clients.end()) {
+        qCWarning(dcJsonRpc()) << "Hello from unknown client" << clientId;
+        return createReply(createWelcomeMessage(interface, clientId));
+    }
+    Client &client = *clientIt;
     if (params.contains("locale")) {
-        m_clientLocales.insert(clientId, QLocale(params.value("locale").toString()));
+        client.locale = QLocale(params.value("locale").toString());
+    }
+    if (params.contains("encoding") || params.contains("compression")) {
+        WireFormat format = client.format;
+        if (params.contains("encoding")) {
+            format.encoding = enumNameToValue<Encoding>(params.value("encoding").toString());
+#if QT_VERSION < QT_VERSION_CHECK(5,12,0)
+            if (format.encoding == EncodingCbor) {
+                qCWarning(dcJsonRpc()) << "CBOR encoding requested by client" << clientId << "but not supported by this build.";
+                format.encoding = EncodingJson;
+            }
+#endif
+            if (format.encoding == EncodingCbor && !interface->supportsBinaryData()) {
+                qCWarning(dcJsonRpc()) << "CBOR encoding requested by client" << clientId << "but the transport does not support binary data.";
+                format.encoding = EncodingJson;
+            }
+        }
+        if (params.contains("compression")) {
+            format.compression = enumNameToValue<Compression>(params.value("compression").toString());
+            if (format.compression != CompressionNone && !interface->supportsBinaryData()) {
+                qCWarning(dcJsonRpc()) << "Compression requested by client" << clientId << "but the transport does not support binary data.";
+                format.compression = CompressionNone;
+            }
+        }
+        // Applied once the reply to this call has been sent
+        client.pendingFormat = format;
+        client.formatPending = true;
+    }
+    if (params.contains("batchStates")) {
+        client.batchStates = params.value("batchStates").toBool();
     }
 
-    qCDebug(dcJsonRpc()) << "Client" << clientId << "initiated handshake." << m_clientLocales.value(clientId);
+    qCDebug(dcJsonRpc()) << "Client" << clientId << "initiated handshake." << client.locale;
 
-    // If we waited for the handshake, here it is. Remove the timer...
-    if (m_newConnectionWaitTimers.contains(clientId)) {
-        delete m_newConnectionWaitTimers.take(clientId);
+    // If we waited for the handshake, here it is
+    if (client.handshakePending) {
+        m_timeoutWheel->remove(client.handshakeTimeoutId);
+        client.handshakePending = false;
     }
 
     return createReply(createWelcomeMessage(interface, clientId));
@@ -314,7 +493,13 @@ JsonReply* JsonRPCServerImplementation::Version(const QVariantMap &params) const
 JsonReply* JsonRPCServerImplementation::SetNotificationStatus(const QVariantMap &params, const JsonContext &context)
 {
     QUuid clientId = context.clientId();
-    Q_ASSERT_X(m_clientTransports.contains(clientId), "JsonRPCServer", "Invalid client ID.");
+    Q_ASSERT_X(m_clients.contains(clientId), "JsonRPCServer", "Invalid client ID.");
+    Client &client = m_clients[clientId];
+
+    // Subscribing to an experience namespace by name loads it
+    foreach (const QVariant &namespaceName, params.value("namespaces").toList()) {
+        loadLazyExperience(namespaceName.toString());
+    }
 
     QStringList enabledNamespaces;
     foreach (const QString &namespaceName, m_handlers.keys()) {
@@ -329,15 +514,93 @@ JsonReply* JsonRPCServerImplementation::SetNotificationStatus(const QVariantMap
         }
     }
     qCDebug(dcJsonRpc()) << "Notification settings for client" << clientId << ":" << enabledNamespaces;
-    m_clientNotifications[clientId] = enabledNamespaces;
+    foreach (const QString &namespaceName, client.notifications) {
+        m_namespaceSubscribers[namespaceName].removeAll(clientId);
+    }
+    foreach (const QString &namespaceName, enabledNamespaces) {
+        m_namespaceSubscribers[namespaceName].append(clientId);
+    }
+    foreach (const QString &namespaceName, client.notifications + enabledNamespaces) {
+        m_handlers.value(namespaceName)->setSubscriberCount(m_namespaceSubscribers.value(namespaceName).count());
+    }
+    client.notifications = enabledNamespaces;
 
     QVariantMap returns;
-    returns.insert("namespaces", m_clientNotifications[clientId]);
+    returns.insert("namespaces", client.notifications);
     // legacy, deprecated
-    returns.insert("enabled", m_clientNotifications[clientId].count() > 0);
+    returns.insert("enabled", client.notifications.count() > 0);
+    return createReply(returns);
+}
+
+JsonReply *JsonRPCServerImplementation::SetStateFilter(const QVariantMap &params, const JsonContext &context)
+{
+    QUuid clientId = context.clientId();
+
+    StateFilter filter;
+    foreach (const QVariant &thingId, params.value("thingIds").toList()) {
+        filter.thingIds.insert(thingId.toUuid());
+    }
+    foreach (const QVariant &stateTypeId, params.value("stateTypeIds").toList()) {
+        filter.stateTypeIds.insert(stateTypeId.toUuid());
+    }
+    filter.interfaces = params.value("interfaces").toStringList();
+
+    if (filter.thingIds.isEmpty() && filter.stateTypeIds.isEmpty() && filter.interfaces.isEmpty()) {
+        qCDebug(dcJsonRpc()) << "Removing state filter for client" << clientId;
+        m_clientStateFilters.remove(clientId);
+    } else {
+        qCDebug(dcJsonRpc()) << "State filter for client" << clientId << ":" << filter.thingIds.count() << "things," << filter.stateTypeIds.count() << "state types," << filter.interfaces;
+        m_clientStateFilters.insert(clientId, filter);
+    }
+
+    QVariantList thingIds;
+    foreach (const QUuid &thingId, filter.thingIds) {
+        thingIds.append(thingId);
+    }
+    QVariantList stateTypeIds;
+    foreach (const QUuid &stateTypeId, filter.stateTypeIds) {
+        stateTypeIds.append(stateTypeId);
+    }
+    QVariantMap returns;
+    returns.insert("thingIds", thingIds);
+    returns.insert("stateTypeIds", stateTypeIds);
+    returns.insert("interfaces", filter.interfaces);
+    return createReply(returns);
+}
+
+JsonReply *JsonRPCServerImplementation::SetNotificationInterval(const QVariantMap &params, const JsonContext &context)
+{
+    QUuid clientId = context.clientId();
+    int interval = static_cast<int>(qMin(params.value("interval").toUInt(), static_cast<uint>(std::numeric_limits<int>::max())));
+    qCDebug(dcJsonRpc()) << "State change notification interval for client" << clientId << ":" << interval << "ms";
+
+    if (interval > 0 || m_clientCoalescing.contains(clientId)) {
+        m_clientCoalescing[clientId].interval = interval;
+        if (interval == 0) {
+            // Sends whatever is pending and drops the coalescing unless the client is lagging
+            flushStateChanges(clientId);
+        }
+    }
+
+    QVariantMap returns;
+    returns.insert("interval", interval);
     return createReply(returns);
 }
 
+bool JsonRPCServerImplementation::StateFilter::accepts(const QUuid &thingId, const QUuid &stateTypeId, const QStringList &thingInterfaces) const
+{
+    if (!thingIds.isEmpty() || !interfaces.isEmpty()) {
+        bool thingMatches = thingIds.contains(thingId);
+        for (int i = 0; i < interfaces.count() && !thingMatches; i++) {
+            thingMatches = thingInterfaces.contains(interfaces.at(i));
+        }
+        if (!thingMatches) {
+            return false;
+        }
+    }
+    return stateTypeIds.isEmpty() || stateTypeIds.contains(stateTypeId);
+}
+
 JsonReply *JsonRPCServerImplementation::CreateUser(const QVariantMap &params)
 {
     QString username = params.value("username").toString();
@@ -463,6 +726,20 @@ QHash<QString, JsonHandler *> JsonRPCServerImplementation::handlers() const
     return m_handlers;
 }
 
+/*! Sets the number of asynchronous calls a single client may have running at once to \a maxInFlightCalls.
+    Further calls are queued until one of them finishes. 0 disables the limit. */
+void JsonRPCServerImplementation::setMaxInFlightCalls(int maxInFlightCalls)
+{
+    m_maxInFlightCalls = maxInFlightCalls;
+}
+
+/*! Validates one of every \a validationSampleRate outgoing messages against the API in release builds. 0 disables
+    the validation. Debug builds always validate all messages. */
+void JsonRPCServerImplementation::setValidationSampleRate(int validationSampleRate)
+{
+    m_validationSampleRate = validationSampleRate;
+}
+
 /*! Register a new \l{TransportInterface} to the JSON server. If the given interface is already registered, just the authenticationRequired flag will be updated. */
 void JsonRPCServerImplementation::registerTransportInterface(TransportInterface *interface, bool authenticationRequired)
 {
@@ -481,7 +758,13 @@ void JsonRPCServerImplementation::unregisterTransportInterface(TransportInterfac
     disconnect(interface, &TransportInterface::clientConnected, this, &JsonRPCServerImplementation::clientConnected);
     disconnect(interface, &TransportInterface::clientDisconnected, this, &JsonRPCServerImplementation::clientDisconnected);
     disconnect(interface, &TransportInterface::dataAvailable, this, &JsonRPCServerImplementation::processData);
-    foreach (const QUuid &clientId, m_clientTransports.keys(interface)) {
+    QList<QUuid> clientIds;
+    for (QHash<QUuid, Client>::const_iterator it = m_clients.constBegin(); it != m_clients.constEnd(); ++it) {
+        if (it->transport == interface) {
+            clientIds.append(it.key());
+        }
+    }
+    foreach (const QUuid &clientId, clientIds) {
         interface->terminateClientConnection(clientId);
         clientDisconnected(clientId);
     }
@@ -493,10 +776,38 @@ bool JsonRPCServerImplementation::registerExperienceHandler(JsonHandler *handler
     bool ret = registerHandler(handler);
     if (ret) {
         m_experiences.insert(handler, QString("%1.%2").arg(majorVersion).arg(minorVersion));
+        m_lazyExperiences.remove(handler->name());
     }
     return ret;
 }
 
+/*! Announces the experience namespace \a namespaceName in \a version without loading it. The
+ * first method call into this namespace calls \a loader, which is expected to register the handler
+ * with registerExperienceHandler().
+ */
+void JsonRPCServerImplementation::registerLazyExperience(const QString &namespaceName, const QString &version, std::function<void()> loader)
+{
+    if (m_handlers.contains(namespaceName) || m_lazyExperiences.contains(namespaceName)) {
+        qCWarning(dcJsonRpc()) << "Namespace" << namespaceName << "is already registered. Not registering lazy experience.";
+        return;
+    }
+    LazyExperience experience;
+    experience.version = version;
+    experience.loader = loader;
+    m_lazyExperiences.insert(namespaceName, experience);
+}
+
+bool JsonRPCServerImplementation::loadLazyExperience(const QString &namespaceName)
+{
+    if (!m_lazyExperiences.contains(namespaceName)) {
+        return false;
+    }
+    LazyExperience experience = m_lazyExperiences.take(namespaceName);
+    qCDebug(dcJsonRpc()) << "Loading experience on first use of namespace" << namespaceName;
+    experience.loader();
+    return m_handlers.contains(namespaceName);
+}
+
 /*! Send a JSON success response to the client with the given \a clientId,
  * \a commandId and \a params to the inerted \l{TransportInterface}.
  */
@@ -511,9 +822,7 @@ void JsonRPCServerImplementation::sendResponse(TransportInterface *interface, co
         response.insert("deprecationWarning", deprecationWarning);
     }
 
-    QByteArray data = QJsonDocument::fromVariant(response).toJson(QJsonDocument::Compact);
-    qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
-    interface->sendData(clientId, data);
+    sendReply(interface, clientId, response);
 }
 
 /*! Send a JSON error response to the client with the given \a clientId,
@@ -526,9 +835,7 @@ void JsonRPCServerImplementation::sendErrorResponse(TransportInterface *interfac
     errorResponse.insert("status", "error");
     errorResponse.insert("error", error);
 
-    QByteArray data = QJsonDocument::fromVariant(errorResponse).toJson(QJsonDocument::Compact);
-    qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
-    interface->sendData(clientId, data);
+    sendReply(interface, clientId, errorResponse);
 }
 
 void JsonRPCServerImplementation::sendUnauthorizedResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error)
@@ -538,9 +845,99 @@ void JsonRPCServerImplementation::sendUnauthorizedResponse(TransportInterface *i
     errorResponse.insert("status", "unauthorized");
     errorResponse.insert("error", error);
 
-    QByteArray data = QJsonDocument::fromVariant(errorResponse).toJson(QJsonDocument::Compact);
-    qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
-    interface->sendData(clientId, data);
+    // The connection is dropped right after this, don't hold it back in a batch
+    sendMessage(interface, clientId, errorResponse);
+}
+
+void JsonRPCServerImplementation::sendReply(TransportInterface *interface, const QUuid &clientId, const QVariantMap &response)
+{
+    if (m_currentBatch == 0 || !m_batches.contains(m_currentBatch)) {
+        sendMessage(interface, clientId, response);
+        return;
+    }
+
+    // Replies to batch elements are collected and sent together once the last one is in
+    BatchReply &batch = m_batches[m_currentBatch];
+    batch.responses.append(response);
+    if (--batch.pending > 0) {
+        return;
+    }
+    BatchReply finishedBatch = m_batches.take(m_currentBatch);
+    qCDebug(dcJsonRpc()) << "Sending" << finishedBatch.responses.count() << "batched replies to client" << clientId;
+    sendPayload(interface, QList<QUuid>() << clientId, encodePayload(finishedBatch.responses, clientState(clientId).format));
+}
+
+void JsonRPCServerImplementation::sendMessage(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message)
+{
+    sendPayload(interface, QList<QUuid>() << clientId, encodePayload(message, clientState(clientId).format));
+}
+
+void JsonRPCServerImplementation::sendPayload(TransportInterface *interface, const QList<QUuid> &clients, const Payload &payload)
+{
+    qint64 start = m_metrics.now();
+    if (payload.binary) {
+        qCDebug(dcJsonRpcTraffic()) << "Sending binary data:" << payload.data.size() << "bytes";
+        interface->sendBinaryData(clients, payload.data);
+    } else {
+        qCDebug(dcJsonRpcTraffic()) << "Sending data:" << payload.data;
+        interface->sendData(clients, payload.data);
+    }
+    m_metrics.recordStage(JsonRpcMetrics::StageWrite, m_metrics.now() - start);
+    m_metrics.recordOutgoing(transportName(interface), payload.data.size(), clients.count());
+}
+
+JsonRPCServerImplementation::Payload JsonRPCServerImplementation::encodePayload(const QVariant &message, const WireFormat &format) const
+{
+    qint64 start = m_metrics.now();
+    Payload payload;
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    if (format.encoding == EncodingCbor) {
+        payload.data = variantToCbor(message).toCbor();
+        payload.binary = true;
+    }
+#endif
+    if (!payload.binary) {
+        payload.data = JsonWriter::toJson(message);
+    }
+
+    // Small messages, like most notifications, don't gain enough to be worth the effort
+    if (format.compression == CompressionZlib && payload.data.size() >= 1024) {
+        QByteArray compressed = qCompress(payload.data);
+        QByteArray frame;
+        frame.reserve(compressed.size() + 5);
+        frame.append('\0');
+        quint32 size = static_cast<quint32>(compressed.size());
+        frame.append(static_cast<char>((size >> 24) & 0xff));
+        frame.append(static_cast<char>((size >> 16) & 0xff));
+        frame.append(static_cast<char>((size >> 8) & 0xff));
+        frame.append(static_cast<char>(size & 0xff));
+        frame.append(compressed);
+        payload.data = frame;
+        payload.binary = true;
+    }
+    m_metrics.recordStage(JsonRpcMetrics::StageSerialization, m_metrics.now() - start);
+    return payload;
+}
+
+JsonRPCServerImplementation::Payload JsonRPCServerImplementation::introspectionPayload(const WireFormat &format, int commandId)
+{
+    // Clients number their calls from the start of each connection, so reconnecting clients
+    // mostly ask with the same few command ids
+    QPair<int, int> key = qMakePair(format.key(), commandId);
+    if (m_introspectionReplies.contains(key)) {
+        return m_introspectionReplies.value(key);
+    }
+    if (m_introspectionReplies.count() >= 16) {
+        m_introspectionReplies.clear();
+    }
+
+    QVariantMap response;
+    response.insert("id", commandId);
+    response.insert("status", "success");
+    response.insert("params", m_api);
+    Payload payload = encodePayload(response, format);
+    m_introspectionReplies.insert(key, payload);
+    return payload;
 }
 
 QVariantMap JsonRPCServerImplementation::createWelcomeMessage(TransportInterface *interface, const QUuid &clientId) const
@@ -551,13 +948,17 @@ QVariantMap JsonRPCServerImplementation::createWelcomeMessage(TransportInterface
     handshake.insert("version", NYMEA_VERSION_STRING);
     handshake.insert("uuid", NymeaCore::instance()->configuration()->serverUuid().toString());
     // "language" is deprecated
-    handshake.insert("language", m_clientLocales.value(clientId).name());
-    handshake.insert("locale", m_clientLocales.value(clientId).name());
+    const Client &client = clientState(clientId);
+    handshake.insert("language", client.locale.name());
+    handshake.insert("locale", client.locale.name());
+    WireFormat format = client.formatPending ? client.pendingFormat : client.format;
+    handshake.insert("encoding", enumValueName<Encoding>(format.encoding));
+    handshake.insert("compression", enumValueName<Compression>(format.compression));
     handshake.insert("protocol version", JSON_PROTOCOL_VERSION);
     handshake.insert("initialSetupRequired", (interface->configuration().authenticationEnabled ? NymeaCore::instance()->userManager()->initRequired() : false));
     handshake.insert("authenticationRequired", interface->configuration().authenticationEnabled);
     handshake.insert("pushButtonAuthAvailable", NymeaCore::instance()->userManager()->pushButtonAuthAvailable());
-    if (!m_experiences.isEmpty()) {
+    if (!m_experiences.isEmpty() || !m_lazyExperiences.isEmpty()) {
         QVariantList experiences;
         foreach (JsonHandler* handler, m_experiences.keys()) {
             QVariantMap experience;
@@ -565,6 +966,12 @@ QVariantMap JsonRPCServerImplementation::createWelcomeMessage(TransportInterface
             experience.insert("version", m_experiences.value(handler));
             experiences.append(experience);
         }
+        foreach (const QString &namespaceName, m_lazyExperiences.keys()) {
+            QVariantMap experience;
+            experience.insert("name", namespaceName);
+            experience.insert("version", m_lazyExperiences.value(namespaceName).version);
+            experiences.append(experience);
+        }
         handshake.insert("experiences", experiences);
     }
     QVariantList cacheHashes;
@@ -586,8 +993,9 @@ QVariantMap JsonRPCServerImplementation::createWelcomeMessage(TransportInterface
 void JsonRPCServerImplementation::setup()
 {
     registerHandler(this);
-    registerHandler(new IntegrationsHandler(NymeaCore::instance()->thingManager(), this));
-    registerHandler(new DeviceHandler(this));
+    IntegrationsHandler *integrationsHandler = new IntegrationsHandler(NymeaCore::instance()->thingManager(), this);
+    registerHandler(integrationsHandler);
+    registerHandler(new DeviceHandler(integrationsHandler, this));
     registerHandler(new ActionHandler(this));
     registerHandler(new RulesHandler(this));
     registerHandler(new EventHandler(this));
@@ -611,23 +1019,34 @@ void JsonRPCServerImplementation::processData(const QUuid &clientId, const QByte
     qCDebug(dcJsonRpcTraffic()) << "Incoming data:" << data;
 
     TransportInterface *interface = qobject_cast<TransportInterface *>(sender());
+    m_metrics.recordIncoming(transportName(interface), data.size());
 
-    // Handle packet fragmentation
-    QByteArray buffer = m_clientBuffers[clientId];
-    buffer.append(data);
-    int splitIndex = buffer.indexOf("}\n{");
-    while (splitIndex > -1) {
-        processJsonPacket(interface, clientId, buffer.left(splitIndex + 1));
-        buffer = buffer.right(buffer.length() - splitIndex - 2);
-        splitIndex = buffer.indexOf("}\n{");
+    QHash<QUuid, Client>::iterator client = m_clients.find(clientId);
+    if (client == m_clients.end()) {
+        qCWarning(dcJsonRpc()) << "Received data from unknown client" << clientId;
+        return;
     }
-    if (buffer.trimmed().endsWith("}")) {
-        processJsonPacket(interface, clientId, buffer);
-        buffer.clear();
+
+    if (client->format.encoding == EncodingCbor) {
+        processCborData(interface, clientId, data);
+        return;
     }
-    m_clientBuffers[clientId] = buffer;
 
-    if (buffer.size() > 1024 * 1024) {
+    // Handle packet fragmentation
+    JsonFramer &framer = client->framer;
+    framer.append(data);
+    JsonFramer::Messages messages = framer.takeMessages();
+    int bufferedSize = framer.bufferedSize();
+
+    for (int i = 0; i < messages.count(); i++) {
+        processJsonPacket(interface, clientId, messages.at(i));
+        // The connection might have been dropped while processing a message
+        if (!m_clients.contains(clientId)) {
+            return;
+        }
+    }
+
+    if (bufferedSize > 1024 * 1024) {
         qCWarning(dcJsonRpc()) << "Client buffer larger than 1MB and no valid data. Dropping client connection.";
         interface->terminateClientConnection(clientId);
     }
@@ -635,8 +1054,11 @@ void JsonRPCServerImplementation::processData(const QUuid &clientId, const QByte
 
 void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interface, const QUuid &clientId, const QByteArray &data)
 {
+    qint64 start = m_metrics.now();
     QJsonParseError error;
     QJsonDocument jsonDoc = QJsonDocument::fromJson(data, &error);
+    QVariant message = jsonDoc.toVariant();
+    m_metrics.recordStage(JsonRpcMetrics::StageParse, m_metrics.now() - start);
 
     if(error.error != QJsonParseError::NoError) {
         qCWarning(dcJsonRpc) << "Failed to parse JSON data" << data << ":" << error.errorString();
@@ -644,8 +1066,96 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
         return;
     }
 
-    QVariantMap message = jsonDoc.toVariant().toMap();
+    if (jsonDoc.isArray()) {
+        processBatch(interface, clientId, message.toList());
+        return;
+    }
+    processRequest(interface, clientId, message.toMap());
+}
+
+void JsonRPCServerImplementation::processBatch(TransportInterface *interface, const QUuid &clientId, const QVariantList &messages)
+{
+    if (messages.isEmpty()) {
+        sendErrorResponse(interface, clientId, -1, "Empty batch request");
+        return;
+    }
+
+    int batchId = ++m_batchCounter;
+    BatchReply batch;
+    batch.clientId = clientId;
+    batch.pending = messages.count();
+    m_batches.insert(batchId, batch);
+
+    foreach (const QVariant &message, messages) {
+        m_currentBatch = batchId;
+        processRequest(interface, clientId, message.toMap());
+        m_currentBatch = 0;
+        // The connection might have been dropped while processing a message
+        if (!m_clients.contains(clientId)) {
+            m_batches.remove(batchId);
+            return;
+        }
+    }
+}
+
+void JsonRPCServerImplementation::processCborData(TransportInterface *interface, const QUuid &clientId, const QByteArray &data)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    // CBOR items are self-delimiting, parse as many complete ones as there are in the buffer
+    QByteArray &buffer = m_clients[clientId].cborBuffer;
+    buffer.append(data);
+
+    qint64 start = m_metrics.now();
+    QList<QVariant> messages;
+    qint64 consumed = 0;
+    while (consumed < buffer.size()) {
+        QCborStreamReader reader(QByteArray::fromRawData(buffer.constData() + consumed, buffer.size() - static_cast<int>(consumed)));
+        QCborValue value = QCborValue::fromCbor(reader);
+        if (reader.lastError() == QCborError::EndOfFile) {
+            // Incomplete, wait for more data
+            break;
+        }
+        if (reader.lastError() != QCborError::NoError) {
+            // There is no way to find the start of the next message in a broken binary stream
+            qCWarning(dcJsonRpc()) << "Failed to parse CBOR data from client" << clientId << ":" << reader.lastError().toString() << ". Dropping client connection.";
+            sendErrorResponse(interface, clientId, -1, QString("Failed to parse CBOR data: %1").arg(reader.lastError().toString()));
+            interface->terminateClientConnection(clientId);
+            return;
+        }
+        consumed += reader.currentOffset();
+        messages.append(value.toVariant());
+    }
+    buffer.remove(0, static_cast<int>(consumed));
+    int bufferedSize = buffer.size();
+    if (!messages.isEmpty()) {
+        m_metrics.recordStage(JsonRpcMetrics::StageParse, m_metrics.now() - start);
+    }
+
+    foreach (const QVariant &message, messages) {
+        if (message.type() == QVariant::List) {
+            processBatch(interface, clientId, message.toList());
+        } else {
+            processRequest(interface, clientId, message.toMap());
+        }
+        // The connection might have been dropped while processing a message
+        if (!m_clients.contains(clientId)) {
+            return;
+        }
+    }
+
+    if (bufferedSize > 1024 * 1024) {
+        qCWarning(dcJsonRpc()) << "Client buffer larger than 1MB and no valid data. Dropping client connection.";
+        interface->terminateClientConnection(clientId);
+    }
+#else
+    Q_UNUSED(interface)
+    Q_UNUSED(clientId)
+    Q_UNUSED(data)
+#endif
+}
 
+void JsonRPCServerImplementation::processRequest(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message)
+{
     bool success;
     int commandId = message.value("id").toInt(&success);
     if (!success) {
@@ -654,57 +1164,70 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
         return;
     }
 
-    QStringList commandList = message.value("method").toString().split('.');
-    if (commandList.count() != 2) {
-        qCWarning(dcJsonRpc) << "Error parsing method.\nGot:" << message.value("method").toString() << "\nExpected: \"Namespace.method\"";
-        sendErrorResponse(interface, clientId, commandId, QString("Error parsing method. Got: '%1'', Expected: 'Namespace.method'").arg(message.value("method").toString()));
+    QString fullMethod = message.value("method").toString();
+    QHash<QString, MethodDispatch>::const_iterator dispatchIt = m_methods.constFind(fullMethod);
+    if (dispatchIt == m_methods.constEnd() && fullMethod.split('.').count() != 2) {
+        qCWarning(dcJsonRpc) << "Error parsing method.\nGot:" << fullMethod << "\nExpected: \"Namespace.method\"";
+        sendErrorResponse(interface, clientId, commandId, QString("Error parsing method. Got: '%1'', Expected: 'Namespace.method'").arg(fullMethod));
         return;
     }
-    QString targetNamespace = commandList.first();
-    QString method = commandList.last();
+    // Unknown methods are not exempt from authentication
+    bool authExemptNoUser = dispatchIt != m_methods.constEnd() && dispatchIt->authExemptNoUser;
+    bool authExemptWithUser = dispatchIt != m_methods.constEnd() && dispatchIt->authExemptWithUser;
 
     // check if authentication is required for this transport
     if (m_interfaces.value(interface)) {
         QByteArray token = message.value("token").toByteArray();
-        QStringList authExemptMethodsNoUser = {"JSONRPC.Introspect", "JSONRPC.Hello", "JSONRPC.RequestPushButtonAuth", "JSONRPC.CreateUser", "Users.RequestPushButtonAuth", "Users.CreateUser"};
-        QStringList authExemptMethodsWithUser = {"JSONRPC.Introspect", "JSONRPC.Hello", "JSONRPC.Authenticate", "JSONRPC.RequestPushButtonAuth", "Users.Authenticate", "Users.RequestPushButtonAuth"};
-        // if there is no user in the system yet, let's fail unless this is special method for authentication itself
-        if (NymeaCore::instance()->userManager()->initRequired()) {
-            if (!authExemptMethodsNoUser.contains(targetNamespace + "." + method) && (token.isEmpty() || !NymeaCore::instance()->userManager()->verifyToken(token))) {
-                sendUnauthorizedResponse(interface, clientId, commandId, "Initial setup required. Call Users.CreateUser first.");
-                qCWarning(dcJsonRpc()) << "Initial setup required but client does not call the setup. Dropping connection.";
-                interface->terminateClientConnection(clientId);
-                return;
+        // A token already verified on this connection stays valid until the user manager revokes it
+        if (token.isEmpty() || clientState(clientId).token != token) {
+            bool tokenValid = !token.isEmpty() && NymeaCore::instance()->userManager()->verifyToken(token);
+            // if there is no user in the system yet, let's fail unless this is special method for authentication itself
+            if (NymeaCore::instance()->userManager()->initRequired()) {
+                if (!authExemptNoUser && !tokenValid) {
+                    sendUnauthorizedResponse(interface, clientId, commandId, "Initial setup required. Call Users.CreateUser first.");
+                    qCWarning(dcJsonRpc()) << "Initial setup required but client does not call the setup. Dropping connection.";
+                    interface->terminateClientConnection(clientId);
+                    return;
+                }
+            } else {
+                // ok, we have a user. if there isn't a valid token, let's fail unless this is a Authenticate, Introspect  Hello call
+                if (!authExemptWithUser && !tokenValid) {
+                    sendUnauthorizedResponse(interface, clientId, commandId, "Forbidden: Invalid token.");
+                    qCWarning(dcJsonRpc()) << "Client did not not present a valid token. Dropping connection.";
+                    interface->terminateClientConnection(clientId);
+                    return;
+                }
             }
-        } else {
-            // ok, we have a user. if there isn't a valid token, let's fail unless this is a Authenticate, Introspect  Hello call
-            if (!authExemptMethodsWithUser.contains(targetNamespace + "." + method) && (token.isEmpty() || !NymeaCore::instance()->userManager()->verifyToken(token))) {
-                sendUnauthorizedResponse(interface, clientId, commandId, "Forbidden: Invalid token.");
-                qCWarning(dcJsonRpc()) << "Client did not not present a valid token. Dropping connection.";
-                interface->terminateClientConnection(clientId);
-                return;
+            if (tokenValid) {
+                m_clients[clientId].token = token;
             }
         }
     }
     // At this point we can assume all the calls are authorized
 
-    JsonHandler *handler = m_handlers.value(targetNamespace);
-    if (!handler) {
-        qCWarning(dcJsonRpc()) << "JSON RPC method called for invalid namespace:" << targetNamespace;
-        sendErrorResponse(interface, clientId, commandId, "No such namespace");
-        return;
+    if (dispatchIt == m_methods.constEnd() && loadLazyExperience(fullMethod.section('.', 0, 0))) {
+        dispatchIt = m_methods.constFind(fullMethod);
     }
-    if (!handler->jsonMethods().contains(method)) {
-        qCWarning(dcJsonRpc()) << QString("JSON RPC method called for invalid method: %1.%2").arg(targetNamespace).arg(method);
-        sendErrorResponse(interface, clientId, commandId, "No such method");
+    if (dispatchIt == m_methods.constEnd()) {
+        QString targetNamespace = fullMethod.section('.', 0, 0);
+        if (!m_handlers.contains(targetNamespace)) {
+            qCWarning(dcJsonRpc()) << "JSON RPC method called for invalid namespace:" << targetNamespace;
+            sendErrorResponse(interface, clientId, commandId, "No such namespace");
+        } else {
+            qCWarning(dcJsonRpc()) << "JSON RPC method called for invalid method:" << fullMethod;
+            sendErrorResponse(interface, clientId, commandId, "No such method");
+        }
         return;
     }
+    const MethodDispatch &dispatch = dispatchIt.value();
+    const QString &targetNamespace = dispatch.targetNamespace;
+    const QString &method = dispatch.method;
 
     QVariantMap params = message.value("params").toMap();
 
-    QVariantMap definition = handler->jsonMethods().value(method).toMap().value("params").toMap();
-    JsonValidator validator;
-    JsonValidator::Result validationResult = validator.validateParams(params, targetNamespace + '.' + method, m_api);
+    qint64 validationStart = m_metrics.now();
+    JsonValidator::Result validationResult = validator().validateParams(params, fullMethod);
+    m_metrics.recordStage(JsonRpcMetrics::StageValidation, m_metrics.now() - validationStart);
     if (!validationResult.success()) {
         qCWarning(dcJsonRpc()) << "JSON RPC parameter verification failed for method" << targetNamespace + '.' + method;
         qCWarning(dcJsonRpc()) << validationResult.errorString() << "in" << validationResult.where();
@@ -715,7 +1238,7 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
 
     if (!(targetNamespace == "JSONRPC" && method == "Hello")) {
         // This is not the handshake message. If we've waited for it, consider this a protocol violation and drop connection
-        if (m_newConnectionWaitTimers.contains(clientId)) {
+        if (clientState(clientId).handshakePending) {
             sendErrorResponse(interface, clientId, commandId, "Handshake required. Call JSONRPC.Hello first.");
             qCWarning(dcJsonRpc()) << "Connection requires a handshake but client did not initiate handshake. Dropping connection";
             interface->terminateClientConnection(clientId);
@@ -723,44 +1246,161 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
         }
     }
 
+    QueuedCall call;
+    call.interface = interface;
+    call.commandId = commandId;
+    call.method = fullMethod;
+    call.params = params;
+    call.token = message.value("token").toByteArray();
+    call.priority = dispatch.priority;
+    call.batchId = m_currentBatch;
+
+    // Once a client has used up its window of async calls, everything but cheap calls waits in line
+    ClientCalls &clientCalls = m_clients[clientId].calls;
+    if (m_maxInFlightCalls > 0 && call.priority != CallPriorityHigh && (clientCalls.inFlight >= m_maxInFlightCalls || !clientCalls.queue.isEmpty())) {
+        if (clientCalls.queue.count() >= m_maxInFlightCalls * 4) {
+            qCWarning(dcJsonRpc()) << "Client" << clientId << "exceeds the call queue limit. Rejecting" << fullMethod;
+            sendErrorResponse(interface, clientId, commandId, "Too many requests");
+            return;
+        }
+        // Slow calls go to the end, everything else before them
+        int index = clientCalls.queue.count();
+        if (call.priority == CallPriorityNormal) {
+            for (int i = 0; i < clientCalls.queue.count(); i++) {
+                if (clientCalls.queue.at(i).priority == CallPriorityLow) {
+                    index = i;
+                    break;
+                }
+            }
+        }
+        qCDebug(dcJsonRpc()) << "Queueing call" << fullMethod << "from client" << clientId << "with" << clientCalls.inFlight << "calls in flight";
+        clientCalls.queue.insert(index, call);
+        return;
+    }
+
+    invokeCall(clientId, call);
+}
+
+void JsonRPCServerImplementation::invokeCall(const QUuid &clientId, const QueuedCall &call)
+{
+    TransportInterface *interface = call.interface;
+    int commandId = call.commandId;
+    const QString &fullMethod = call.method;
+    const QVariantMap &params = call.params;
+    const MethodDispatch dispatch = m_methods.value(fullMethod);
+    JsonHandler *handler = dispatch.handler;
+    const QString &targetNamespace = dispatch.targetNamespace;
+    const QString &method = dispatch.method;
+
+    // Queued calls are dispatched later, their replies still belong to their batch
+    int previousBatch = m_currentBatch;
+    m_currentBatch = call.batchId;
+
     // Attach the transportInterface if this call is for ourselves
     if (handler == this) {
         handler->setProperty("transportInterface", reinterpret_cast<qint64>(interface));
     }
 
-    JsonContext callContext(clientId, m_clientLocales.value(clientId));
-    callContext.setToken(message.value("token").toByteArray());
+    JsonContext callContext(clientId, clientState(clientId).locale);
+    callContext.setToken(call.token);
 
     qCDebug(dcJsonRpc()) << "Invoking method" << targetNamespace + '.' +  method << "from client" << clientId;
 
+    qint64 start = m_metrics.now();
     JsonReply *reply;
-    if (handler->metaObject()->indexOfMethod(method.toUtf8() + "(QVariantMap,JsonContext)") >= 0) {
-        QMetaObject::invokeMethod(handler, method.toUtf8().data(), Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params), Q_ARG(JsonContext, callContext));
+    if (dispatch.withContext) {
+        dispatch.metaMethod.invoke(handler, Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params), Q_ARG(JsonContext, callContext));
     } else {
-        QMetaObject::invokeMethod(handler, method.toUtf8().data(), Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params));
+        dispatch.metaMethod.invoke(handler, Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params));
     }
 
     if (reply->type() == JsonReply::TypeAsync) {
+        QHash<QUuid, Client>::iterator client = m_clients.find(clientId);
+        if (client != m_clients.end()) {
+            client->calls.inFlight++;
+        }
         m_asyncReplies.insert(reply, interface);
+        m_asyncReplyStarts.insert(reply, start);
+        if (call.batchId != 0) {
+            m_asyncReplyBatches.insert(reply, call.batchId);
+        }
         reply->setClientId(clientId);
         reply->setCommandId(commandId);
         connect(reply, &JsonReply::finished, this, &JsonRPCServerImplementation::asyncReplyFinished);
         reply->startWait();
     } else {
-        JsonValidator validator;
-        Q_ASSERT_X((targetNamespace == "JSONRPC" && method == "Introspect") || validator.validateReturns(reply->data(), targetNamespace + '.' + method, m_api).success(),
-                   validator.result().where().toUtf8(),
-                   validator.result().errorString().toUtf8() + "\nReturn value:\n" + QJsonDocument::fromVariant(reply->data()).toJson());
-
-        QString deprecationWarning;
-        if (m_api.value("methods").toMap().value(targetNamespace + '.' + method).toMap().contains("deprecated")) {
-            deprecationWarning = m_api.value("methods").toMap().value(targetNamespace + '.' + method).toMap().value("deprecated").toString();
-            qCWarning(dcJsonRpc()) << "Client uses deprecated API. Please update client implementation!";
-            qCWarning(dcJsonRpc()) << targetNamespace + '.' + method + ':' << deprecationWarning;
+        m_metrics.recordCall(fullMethod, m_metrics.now() - start, false);
+        if (handler == this && method == "Introspect" && m_currentBatch == 0) {
+            sendPayload(interface, QList<QUuid>() << clientId, introspectionPayload(clientState(clientId).format, commandId));
+        } else {
+            verifyReturns(fullMethod, reply->data());
+
+            QString deprecationWarning = dispatch.deprecationWarning;
+            if (!deprecationWarning.isEmpty()) {
+                qCWarning(dcJsonRpc()) << "Client uses deprecated API. Please update client implementation!";
+                qCWarning(dcJsonRpc()) << fullMethod + ':' << deprecationWarning;
+            }
+
+            sendResponse(interface, clientId, commandId, reply->data(), deprecationWarning);
+        }
+        JsonReply::release(reply);
+
+        // A wire format negotiated in JSONRPC.Hello applies to everything after its reply
+        QHash<QUuid, Client>::iterator client = m_clients.find(clientId);
+        if (client != m_clients.end() && client->formatPending) {
+            client->format = client->pendingFormat;
+            client->formatPending = false;
+            client->cborBuffer.clear();
         }
+    }
+    m_currentBatch = previousBatch;
+}
 
-        sendResponse(interface, clientId, commandId, reply->data(), deprecationWarning);
-        reply->deleteLater();
+JsonValidator &JsonRPCServerImplementation::validator()
+{
+    // Compiled once the API is complete, i.e. on the first call after handlers have been registered
+    if (!m_validator.isCompiled()) {
+        m_validator.compile(m_api);
+    }
+    return m_validator;
+}
+
+bool JsonRPCServerImplementation::sampleValidation()
+{
+#ifdef QT_NO_DEBUG
+    // Release builds only check every n-th outgoing message, if enabled at all
+    if (m_validationSampleRate <= 0) {
+        return false;
+    }
+    return m_validationCounter++ % m_validationSampleRate == 0;
+#else
+    return true;
+#endif
+}
+
+void JsonRPCServerImplementation::verifyReturns(const QString &method, const QVariantMap &returns)
+{
+    if (!sampleValidation()) {
+        return;
+    }
+    // Large replies may carry parts which are serialized already
+    QVariantMap resolvedReturns = JsonWriter::resolveFragments(returns).toMap();
+    JsonValidator::Result result = validator().validateReturns(resolvedReturns, method);
+    if (!result.success()) {
+        qCWarning(dcJsonRpc()) << "Invalid return value of" << method << ":" << result.errorString() << "in" << result.where();
+        Q_ASSERT_X(false, result.where().toUtf8(), result.errorString().toUtf8() + "\nReturn value:\n" + QJsonDocument::fromVariant(resolvedReturns).toJson());
+    }
+}
+
+void JsonRPCServerImplementation::verifyNotificationParams(const QString &notification, const QVariantMap &params)
+{
+    if (!sampleValidation()) {
+        return;
+    }
+    JsonValidator::Result result = validator().validateNotificationParams(params, notification);
+    if (!result.success()) {
+        qCWarning(dcJsonRpc()) << "Invalid params in notification" << notification << ":" << result.errorString() << "in" << result.where();
+        Q_ASSERT_X(false, result.where().toUtf8(), result.errorString().toUtf8() + "\nGot:" + QJsonDocument::fromVariant(params).toJson(QJsonDocument::Indented));
     }
 }
 
@@ -769,41 +1409,239 @@ void JsonRPCServerImplementation::sendNotification(const QVariantMap &params)
     JsonHandler *handler = qobject_cast<JsonHandler *>(sender());
     QMetaMethod method = handler->metaObject()->method(senderSignalIndex());
 
+    const QList<QUuid> subscribers = m_namespaceSubscribers.value(handler->name());
+    if (subscribers.isEmpty()) {
+        return;
+    }
+
+    if (handler->name() == "Integrations" && method.name() == "ThingsAdded") {
+        // Only clients which asked for batches get them, all others get a ThingAdded for each thing
+        QList<QUuid> batchRecipients;
+        QList<QUuid> thingRecipients;
+        foreach (const QUuid &clientId, subscribers) {
+            if (clientState(clientId).batchStates) {
+                batchRecipients.append(clientId);
+            } else {
+                thingRecipients.append(clientId);
+            }
+        }
+        if (!batchRecipients.isEmpty()) {
+            dispatchNotification(handler, method.name(), params, batchRecipients);
+        }
+        if (!thingRecipients.isEmpty()) {
+            foreach (const QVariant &thing, params.value("things").toList()) {
+                QVariantMap thingParams;
+                thingParams.insert("thing", thing);
+                dispatchNotification(handler, "ThingAdded", thingParams, thingRecipients);
+            }
+        }
+        return;
+    }
+
+    if (handler->name() != "Integrations" || method.name() != "StatesChanged") {
+        dispatchNotification(handler, method.name(), params, subscribers);
+        return;
+    }
+
+    // Batched state changes are only sent as they are to clients which asked for them. All others, as
+    // well as clients filtering or coalescing state changes, get a StateChanged for each of the states.
+    QList<QUuid> batchRecipients;
+    QList<QUuid> stateRecipients;
+    foreach (const QUuid &clientId, subscribers) {
+        if (clientState(clientId).batchStates && !m_clientStateFilters.contains(clientId)
+                && !coalescesStates(clientId, clientState(clientId).transport)) {
+            batchRecipients.append(clientId);
+        } else {
+            stateRecipients.append(clientId);
+        }
+    }
+    if (!batchRecipients.isEmpty()) {
+        dispatchNotification(handler, method.name(), params, batchRecipients);
+    }
+    if (!stateRecipients.isEmpty()) {
+        foreach (const QVariant &state, params.value("states").toList()) {
+            QVariantMap stateMap = state.toMap();
+            QVariantMap stateParams;
+            stateParams.insert("thingId", params.value("thingId"));
+            stateParams.insert("stateTypeId", stateMap.value("stateTypeId"));
+            stateParams.insert("value", stateMap.value("value"));
+            stateParams.insert("minValue", stateMap.value("minValue"));
+            stateParams.insert("maxValue", stateMap.value("maxValue"));
+            dispatchNotification(handler, "StateChanged", stateParams, stateRecipients);
+        }
+    }
+}
+
+void JsonRPCServerImplementation::dispatchNotification(JsonHandler *handler, const QString &name, const QVariantMap &params, const QList<QUuid> &subscribers)
+{
+    QString notificationName = handler->name() + '.' + name;
+
+    // Group the interested clients by locale and transport. The notification is translated and
+    // serialized once per locale and wire format and handed to each transport as one batch.
+
+    // State changes may be filtered and coalesced per client
+    bool isStateChange = name == "StateChanged" && (handler->name() == "Integrations" || handler->name() == "Devices");
+    bool filterStates = isStateChange && !m_clientStateFilters.isEmpty();
+    QUuid thingId;
+    QUuid stateTypeId;
+    QStringList thingInterfaces;
+    if (filterStates) {
+        thingId = params.value(handler->name() == "Devices" ? "deviceId" : "thingId").toUuid();
+        stateTypeId = params.value("stateTypeId").toUuid();
+        Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(ThingId(thingId));
+        if (thing) {
+            thingInterfaces = thing->thingClass().interfaces();
+        }
+    }
+
+    QHash<QString, QLocale> locales;
+    QHash<QString, QHash<TransportInterface*, QList<QUuid>>> recipients;
+    QHash<QString, QList<QUuid>> coalescingRecipients;
+    foreach (const QUuid &clientId, subscribers) {
+        if (filterStates && m_clientStateFilters.contains(clientId) && !m_clientStateFilters[clientId].accepts(thingId, stateTypeId, thingInterfaces)) {
+            continue;
+        }
+        QHash<QUuid, Client>::const_iterator client = m_clients.constFind(clientId);
+        if (client == m_clients.constEnd()) {
+            continue;
+        }
+        const QLocale &locale = client->locale;
+        locales.insert(locale.name(), locale);
+        TransportInterface *transport = client->transport;
+        if (isStateChange && coalescesStates(clientId, transport)) {
+            coalescingRecipients[locale.name()].append(clientId);
+        } else {
+            recipients[locale.name()][transport].append(clientId);
+        }
+    }
+
+    if (locales.isEmpty()) {
+        return;
+    }
+
     QVariantMap notification;
     notification.insert("id", m_notificationId++);
-    notification.insert("notification", handler->name() + "." + method.name());
+    notification.insert("notification", notificationName);
 
-    foreach (const QUuid &clientId, m_clientNotifications.keys()) {
+    // Add deprecation warning if necessary
+    if (m_notificationDeprecations.contains(notificationName)) {
+        QString deprecationMessage = m_notificationDeprecations.value(notificationName);
+        qCWarning(dcJsonRpc()) << "Clients use deprecated API. Please update client implementation!";
+        qCWarning(dcJsonRpc()) << notificationName + ':' << deprecationMessage;
+        notification.insert("deprecationWarning", deprecationMessage);
+    }
 
-        // Check if this client wants to be notified
-        if (!m_clientNotifications.value(clientId).contains(handler->name())) {
-            continue;
+    for (QHash<QString, QLocale>::const_iterator it = locales.constBegin(); it != locales.constEnd(); ++it) {
+        QVariantMap translatedParams = handler->translateNotification(name, params, it.value());
+
+        verifyNotificationParams(notificationName, translatedParams);
+
+        notification.insert("params", translatedParams);
+
+        foreach (const QUuid &clientId, coalescingRecipients.value(it.key())) {
+            queueStateChange(clientId, notification);
         }
 
-        // Add deprecation warning if necessary
-        if (m_api.value("notifications").toMap().value(handler->name() + '.' + method.name()).toMap().contains("deprecated")) {
-            QString deprecationMessage = m_api.value("notifications").toMap().value(handler->name() + '.' + method.name()).toMap().value("deprecated").toString();
-            qCWarning(dcJsonRpc()) << "Client" << clientId << "uses deprecated API. Please update client implementation!";
-            qCWarning(dcJsonRpc()) << handler->name() + '.' + method.name() + ':' << deprecationMessage;
-            notification.insert("deprecationWarning", deprecationMessage);
+        // Each wire format is serialized only if there are clients using it
+        QHash<int, Payload> payloads;
+
+        const QHash<TransportInterface*, QList<QUuid>> transports = recipients.value(it.key());
+        foreach (TransportInterface *transport, transports.keys()) {
+            QHash<int, QList<QUuid>> clientsByFormat;
+            foreach (const QUuid &clientId, transports.value(transport)) {
+                WireFormat format = clientState(clientId).format;
+                if (!payloads.contains(format.key())) {
+                    payloads.insert(format.key(), encodePayload(notification, format));
+                }
+                clientsByFormat[format.key()].append(clientId);
+            }
+            for (QHash<int, QList<QUuid>>::const_iterator formatIt = clientsByFormat.constBegin(); formatIt != clientsByFormat.constEnd(); ++formatIt) {
+                qCDebug(dcJsonRpc()) << "Sending notification" << notificationName << "to clients" << formatIt.value();
+                sendPayload(transport, formatIt.value(), payloads.value(formatIt.key()));
+            }
         }
+    }
+}
 
-        QLocale locale = m_clientLocales.value(clientId);
-        QVariantMap translatedParams = handler->translateNotification(method.name(), params, locale);
+bool JsonRPCServerImplementation::coalescesStates(const QUuid &clientId, TransportInterface *transport)
+{
+    bool lagging = transport->pendingBytes(clientId) > laggingClientThreshold;
+    QHash<QUuid, CoalescedStates>::iterator it = m_clientCoalescing.find(clientId);
+    if (it == m_clientCoalescing.end()) {
+        if (!lagging) {
+            return false;
+        }
+        it = m_clientCoalescing.insert(clientId, CoalescedStates());
+    }
+    if (lagging && !it->lagging) {
+        qCInfo(dcJsonRpc()) << "Client" << clientId << "is lagging behind. Coalescing state changes until it catches up.";
+        it->lagging = true;
+    }
+    return it->lagging || it->interval > 0;
+}
 
-        JsonValidator validator;
-        Q_ASSERT_X(validator.validateNotificationParams(translatedParams, handler->name() + '.' + method.name(), m_api).success(),
-                   validator.result().where().toUtf8(),
-                   validator.result().errorString().toUtf8() + "\nGot:" + QJsonDocument::fromVariant(translatedParams).toJson(QJsonDocument::Indented));
+void JsonRPCServerImplementation::queueStateChange(const QUuid &clientId, const QVariantMap &notification)
+{
+    CoalescedStates &coalesced = m_clientCoalescing[clientId];
+
+    QVariantMap params = notification.value("params").toMap();
+    QString key = notification.value("notification").toString()
+            + params.value(params.contains("deviceId") ? "deviceId" : "thingId").toString()
+            + params.value("stateTypeId").toString();
+    if (!coalesced.notifications.contains(key)) {
+        coalesced.order.append(key);
+    }
+    coalesced.notifications.insert(key, notification);
+
+    if (!coalesced.timer) {
+        coalesced.timer = new QTimer(this);
+        coalesced.timer->setSingleShot(true);
+        connect(coalesced.timer, &QTimer::timeout, this, [this, clientId](){
+            flushStateChanges(clientId);
+        });
+    }
+    if (!coalesced.timer->isActive()) {
+        coalesced.timer->start(coalesced.lagging ? qMax(coalesced.interval, laggingClientInterval) : coalesced.interval);
+    }
+}
 
-        notification.insert("params", translatedParams);
+void JsonRPCServerImplementation::flushStateChanges(const QUuid &clientId)
+{
+    QHash<QUuid, CoalescedStates>::iterator it = m_clientCoalescing.find(clientId);
+    TransportInterface *transport = clientState(clientId).transport;
+    if (it == m_clientCoalescing.end() || !transport) {
+        return;
+    }
 
-        QByteArray data = QJsonDocument::fromVariant(notification).toJson(QJsonDocument::Compact);
+    if (transport->pendingBytes(clientId) > laggingClientThreshold) {
+        // Still behind, keep collecting
+        it->lagging = true;
+        if (!it->notifications.isEmpty()) {
+            it->timer->start(qMax(it->interval, laggingClientInterval));
+        }
+        return;
+    }
+    if (it->lagging) {
+        qCInfo(dcJsonRpc()) << "Client" << clientId << "caught up.";
+        it->lagging = false;
+    }
 
-        qCDebug(dcJsonRpc()) << "Sending notification" << handler->name() + "." + method.name() << "to client" << clientId;
-        qCDebug(dcJsonRpcTraffic()) << "Notification content:" << data;
+    QStringList order = it->order;
+    QHash<QString, QVariantMap> notifications = it->notifications;
+    it->order.clear();
+    it->notifications.clear();
+    if (it->interval == 0) {
+        if (it->timer) {
+            it->timer->deleteLater();
+        }
+        m_clientCoalescing.erase(it);
+    }
 
-        m_clientTransports.value(clientId)->sendData(clientId, data);
+    qCDebug(dcJsonRpc()) << "Sending" << order.count() << "coalesced state changes to client" << clientId;
+    foreach (const QString &key, order) {
+        QVariantMap notification = notifications.value(key);
+        notification.insert("id", m_notificationId++);
+        sendMessage(transport, clientId, notification);
     }
 }
 
@@ -812,7 +1650,7 @@ void JsonRPCServerImplementation::sendClientNotification(const QUuid &clientId,
     JsonHandler *handler = qobject_cast<JsonHandler *>(sender());
     QMetaMethod method = handler->metaObject()->method(senderSignalIndex());
 
-    if (!m_clientTransports.contains(clientId)) {
+    if (!m_clients.contains(clientId)) {
         qCWarning(dcJsonRpc()) << "No client with id" << clientId << ". Not sending client notification.";
         return;
     }
@@ -822,43 +1660,54 @@ void JsonRPCServerImplementation::sendClientNotification(const QUuid &clientId,
     notification.insert("notification", handler->name() + "." + method.name());
     notification.insert("params", params);
 
-    JsonValidator validator;
-    Q_ASSERT_X(validator.validateNotificationParams(params, handler->name() + '.' + method.name(), m_api).success(),
-               validator.result().where().toUtf8(),
-               validator.result().errorString().toUtf8() + "\nGot:" + QJsonDocument::fromVariant(params).toJson(QJsonDocument::Indented));
+    verifyNotificationParams(handler->name() + '.' + method.name(), params);
 
-    if (m_api.value("notifications").toMap().value(handler->name() + '.' + method.name()).toMap().contains("deprecated")) {
-        QString deprecationMessage = m_api.value("notifications").toMap().value(handler->name() + '.' + method.name()).toMap().value("deprecated").toString();
+    if (m_notificationDeprecations.contains(handler->name() + '.' + method.name())) {
+        QString deprecationMessage = m_notificationDeprecations.value(handler->name() + '.' + method.name());
         qCWarning(dcJsonRpc()) << "Client uses deprecated API. Please update client implementation!";
         qCWarning(dcJsonRpc()) << handler->name() + '.' + method.name() + ':' << deprecationMessage;
         notification.insert("deprecationWarning", deprecationMessage);
     }
 
-    QByteArray data = QJsonDocument::fromVariant(notification).toJson(QJsonDocument::Compact);
-    qCDebug(dcJsonRpcTraffic()) << "Notification content:" << data;
     qCDebug(dcJsonRpc()) << "Sending notification:" << handler->name() + "." + method.name();
-    m_clientTransports.value(clientId)->sendData(clientId, data);
+    sendMessage(clientState(clientId).transport, clientId, notification);
+}
+
+void JsonRPCServerImplementation::dispatchQueuedCalls(const QUuid &clientId)
+{
+    while (m_clients.contains(clientId)) {
+        ClientCalls &clientCalls = m_clients[clientId].calls;
+        if (clientCalls.queue.isEmpty() || clientCalls.inFlight >= m_maxInFlightCalls) {
+            return;
+        }
+        invokeCall(clientId, clientCalls.queue.takeFirst());
+    }
 }
 
 void JsonRPCServerImplementation::asyncReplyFinished()
 {
     JsonReply *reply = qobject_cast<JsonReply *>(sender());
     TransportInterface *interface = m_asyncReplies.take(reply);
+    int batchId = m_asyncReplyBatches.take(reply);
+    QString method = reply->handler()->name() + '.' + reply->method();
+    m_metrics.recordCall(method, m_metrics.now() - m_asyncReplyStarts.take(reply), reply->timedOut());
+    QHash<QUuid, Client>::iterator client = m_clients.find(reply->clientId());
+    if (client != m_clients.end()) {
+        client->calls.inFlight--;
+        // Queued calls are dispatched after this reply has been sent
+        QMetaObject::invokeMethod(this, "dispatchQueuedCalls", Qt::QueuedConnection, Q_ARG(QUuid, reply->clientId()));
+    }
     if (!interface) {
         qCWarning(dcJsonRpc()) << "Got an async reply but the requesting connection has vanished.";
         reply->deleteLater();
         return;
     }
+    m_currentBatch = batchId;
     if (!reply->timedOut()) {
-        JsonValidator validator;
-        QString method = reply->handler()->name() + '.' + reply->method();
-        Q_ASSERT_X(validator.validateReturns(reply->data(), method, m_api).success()
-                   ,validator.result().where().toUtf8()
-                   ,validator.result().errorString().toUtf8() + "\nReturn value:\n" + QJsonDocument::fromVariant(reply->data()).toJson());
-
-        QString deprecationWarning;
-        if (m_api.value("methods").toMap().value(method).toMap().contains("deprecated")) {
-            deprecationWarning = m_api.value("methods").toMap().value(method).toMap().value("deprecated").toString();
+        verifyReturns(method, reply->data());
+
+        QString deprecationWarning = m_methods.value(method).deprecationWarning;
+        if (!deprecationWarning.isEmpty()) {
             qCWarning(dcJsonRpc()) << "Client uses deprecated API. Please update client implementation!";
             qCWarning(dcJsonRpc()) << method + ':' << deprecationWarning;
         }
@@ -868,6 +1717,7 @@ void JsonRPCServerImplementation::asyncReplyFinished()
         qCWarning(dcJsonRpc()) << "RPC call timed out:" << reply->handler()->name() << ":" << reply->method();
         sendErrorResponse(interface, reply->clientId(), reply->commandId(), "Command timed out");
     }
+    m_currentBatch = 0;
 
     reply->deleteLater();
 }
@@ -911,6 +1761,75 @@ void JsonRPCServerImplementation::onPushButtonAuthFinished(int transactionId, bo
     emit PushButtonAuthFinished(clientId, params);
 }
 
+/*! Invokes the given \a method with \a params directly, without a transport and the JSON-RPC envelope.
+    The params are validated like for any other call, authentication is up to the caller. Methods of the
+    JSONRPC namespace depend on a connection and can't be invoked this way.
+
+    Returns the reply of the handler, or nullptr and sets \a error if the method can't be called. The caller
+    releases synchronous replies with JsonReply::release(), asynchronous replies need to be started with
+    JsonReply::startWait() and deleted once finished.
+*/
+JsonReply *JsonRPCServerImplementation::invokeMethod(const QString &method, const QVariantMap &params, const JsonContext &context, QString *error)
+{
+    QHash<QString, MethodDispatch>::const_iterator dispatchIt = m_methods.constFind(method);
+    if (dispatchIt == m_methods.constEnd() && loadLazyExperience(method.section('.', 0, 0))) {
+        dispatchIt = m_methods.constFind(method);
+    }
+    if (dispatchIt == m_methods.constEnd() || dispatchIt->handler == this) {
+        *error = "No such method";
+        return nullptr;
+    }
+    const MethodDispatch &dispatch = dispatchIt.value();
+
+    qint64 validationStart = m_metrics.now();
+    JsonValidator::Result validationResult = validator().validateParams(params, method);
+    m_metrics.recordStage(JsonRpcMetrics::StageValidation, m_metrics.now() - validationStart);
+    if (!validationResult.success()) {
+        *error = "Invalid params: " + validationResult.errorString() + " in " + validationResult.where();
+        return nullptr;
+    }
+
+    qCDebug(dcJsonRpc()) << "Invoking method" << method << "for client" << context.clientId() << "without transport";
+
+    qint64 start = m_metrics.now();
+    JsonReply *reply;
+    if (dispatch.withContext) {
+        dispatch.metaMethod.invoke(dispatch.handler, Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params), Q_ARG(JsonContext, context));
+    } else {
+        dispatch.metaMethod.invoke(dispatch.handler, Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params));
+    }
+
+    if (reply->type() == JsonReply::TypeAsync) {
+        connect(reply, &JsonReply::finished, this, [this, reply, method, start](){
+            m_metrics.recordCall(method, m_metrics.now() - start, reply->timedOut());
+            if (!reply->timedOut()) {
+                verifyReturns(method, reply->data());
+            }
+        });
+    } else {
+        m_metrics.recordCall(method, m_metrics.now() - start, false);
+        verifyReturns(method, reply->data());
+    }
+    return reply;
+}
+
+/*! Returns the performance counters of the server, along with the outbound buffer and call queue of each client. */
+QVariantMap JsonRPCServerImplementation::performanceCounters() const
+{
+    QVariantMap counters = m_metrics.toMap();
+    QVariantMap clients;
+    for (QHash<QUuid, Client>::const_iterator it = m_clients.constBegin(); it != m_clients.constEnd(); ++it) {
+        QVariantMap client;
+        client.insert("transport", transportName(it->transport));
+        client.insert("pendingBytes", it->transport->pendingBytes(it.key()));
+        client.insert("inFlightCalls", it->calls.inFlight);
+        client.insert("queuedCalls", it->calls.queue.count());
+        clients.insert(it.key().toString(), client);
+    }
+    counters.insert("clients", clients);
+    return counters;
+}
+
 bool JsonRPCServerImplementation::registerHandler(JsonHandler *handler)
 {
     // Sanity checks on API:
@@ -967,15 +1886,51 @@ bool JsonRPCServerImplementation::registerHandler(JsonHandler *handler)
     }
 
     // Verify methods
+    static const QStringList authExemptMethodsNoUser = {"JSONRPC.Introspect", "JSONRPC.Hello", "JSONRPC.RequestPushButtonAuth", "JSONRPC.CreateUser", "Users.RequestPushButtonAuth", "Users.CreateUser"};
+    static const QStringList authExemptMethodsWithUser = {"JSONRPC.Introspect", "JSONRPC.Hello", "JSONRPC.Authenticate", "JSONRPC.RequestPushButtonAuth", "Users.Authenticate", "Users.RequestPushButtonAuth"};
+    // Cheap calls, answered from memory, bypass the per client call queue. Discovery and browsing queue up behind
+    // everything else.
+    static const QStringList highPriorityMethods = {
+        "JSONRPC.Introspect", "JSONRPC.Hello", "JSONRPC.Version", "JSONRPC.KeepAlive", "JSONRPC.SetNotificationStatus", "JSONRPC.SetStateFilter", "JSONRPC.SetNotificationInterval",
+        "Integrations.GetVendors", "Integrations.GetThingClasses", "Integrations.GetPlugins", "Integrations.GetPluginConfiguration", "Integrations.GetThings",
+        "Integrations.GetStateTypes", "Integrations.GetEventTypes", "Integrations.GetActionTypes", "Integrations.GetStateValue", "Integrations.GetStateValues", "Integrations.GetIOConnections",
+        "Devices.GetSupportedVendors", "Devices.GetSupportedDevices", "Devices.GetPlugins", "Devices.GetPluginConfiguration", "Devices.GetConfiguredDevices",
+        "Devices.GetStateTypes", "Devices.GetEventTypes", "Devices.GetActionTypes", "Devices.GetStateValue", "Devices.GetStateValues",
+        "Actions.GetActionType", "Events.GetEventType", "States.GetStateType",
+        "Rules.GetRules", "Rules.GetRuleDetails", "Scripts.GetScripts", "Tags.GetTags", "Users.GetUserInfo", "Users.GetTokens",
+        "Configuration.GetConfigurations", "Configuration.GetTimeZones", "Configuration.GetAvailableLanguages", "Configuration.GetMqttServerConfigurations", "Configuration.GetMqttPolicies",
+        "System.GetCapabilities", "System.GetTime", "System.GetTimeZones"
+    };
+    static const QStringList lowPriorityMethods = {"Integrations.DiscoverThings", "Integrations.BrowseThing", "Integrations.GetBrowserItem", "Devices.GetDiscoveredDevices", "Devices.BrowseDevice", "Devices.GetBrowserItem", "NetworkManager.ScanWifiNetworks"};
     QVariantMap newMethods;
+    QHash<QString, MethodDispatch> newDispatches;
     foreach (const QString &methodName, handler->jsonMethods().keys()) {
         QVariantMap method = handler->jsonMethods().value(methodName).toMap();
 
-        if (handler->metaObject()->indexOfMethod(methodName.toUtf8() + "(QVariantMap)") < 0
-                && handler->metaObject()->indexOfMethod(methodName.toUtf8() + "(QVariantMap,JsonContext)") < 0) {
+        MethodDispatch dispatch;
+        dispatch.handler = handler;
+        dispatch.targetNamespace = handler->name();
+        dispatch.method = methodName;
+        int methodIndex = handler->metaObject()->indexOfMethod(methodName.toUtf8() + "(QVariantMap,JsonContext)");
+        dispatch.withContext = methodIndex >= 0;
+        if (methodIndex < 0) {
+            methodIndex = handler->metaObject()->indexOfMethod(methodName.toUtf8() + "(QVariantMap)");
+        }
+        if (methodIndex < 0) {
             qCWarning(dcJsonRpc()).nospace().noquote() << "Invalid method \"" << methodName << "\". Method \"JsonReply* " + methodName + "(QVariantMap,JsonContext)\" does not exist. Not registering handler " << handler->name();
             return false;
         }
+        dispatch.metaMethod = handler->metaObject()->method(methodIndex);
+        dispatch.authExemptNoUser = authExemptMethodsNoUser.contains(handler->name() + '.' + methodName);
+        dispatch.authExemptWithUser = authExemptMethodsWithUser.contains(handler->name() + '.' + methodName);
+        dispatch.deprecationWarning = method.value("deprecated").toString();
+        if (lowPriorityMethods.contains(handler->name() + '.' + methodName)) {
+            dispatch.priority = CallPriorityLow;
+        } else if (highPriorityMethods.contains(handler->name() + '.' + methodName)) {
+            dispatch.priority = CallPriorityHigh;
+        }
+        newDispatches.insert(handler->name() + '.' + methodName, dispatch);
+
         if (!JsonValidator::checkRefs(method.value("params").toMap(), apiIncludingThis)) {
             qCWarning(dcJsonRpc()).nospace() << "Invalid reference in params of method " << methodName << ". Not registering handler " << handler->name();
             return false;
@@ -991,6 +1946,7 @@ bool JsonRPCServerImplementation::registerHandler(JsonHandler *handler)
 
     // Verify notifications
     QVariantMap newNotifications;
+    QHash<QString, QString> newDeprecations;
     foreach (const QString &notificationName, handler->jsonNotifications().keys()) {
         QVariantMap notification = handler->jsonNotifications().value(notificationName).toMap();
         if (!JsonValidator::checkRefs(notification.value("params").toMap(), apiIncludingThis)) {
@@ -998,6 +1954,9 @@ bool JsonRPCServerImplementation::registerHandler(JsonHandler *handler)
             return false;
         }
         newNotifications.insert(handler->name() + '.' + notificationName, notification);
+        if (notification.contains("deprecated")) {
+            newDeprecations.insert(handler->name() + '.' + notificationName, notification.value("deprecated").toString());
+        }
     }
     notifications.unite(newNotifications);
     apiIncludingThis["notifications"] = notifications;
@@ -1005,6 +1964,14 @@ bool JsonRPCServerImplementation::registerHandler(JsonHandler *handler)
     // Checks completed. Store new API
     qCDebug(dcJsonRpc()) << "Registering JSON RPC handler:" << handler->name();
     m_api = apiIncludingThis;
+    m_apiHash.clear();
+    m_introspectionReplies.clear();
+    m_notificationDeprecations.unite(newDeprecations);
+    // Recompiled with the next validation
+    m_validator = JsonValidator();
+    foreach (const QString &methodName, newDispatches.keys()) {
+        m_methods.insert(methodName, newDispatches.value(methodName));
+    }
 
     m_handlers.insert(handler->name(), handler);
     for (int i = 0; i < handler->metaObject()->methodCount(); ++i) {
@@ -1025,35 +1992,56 @@ void JsonRPCServerImplementation::clientConnected(const QUuid &clientId)
     qCDebug(dcJsonRpc()) << "Client connected with uuid" << clientId.toString();
     TransportInterface *interface = qobject_cast<TransportInterface *>(sender());
 
-    m_clientTransports.insert(clientId, interface);
-
+    Client client;
+    client.transport = interface;
     // Initialize the connection locale to the settings default
-    m_clientLocales.insert(clientId, NymeaCore::instance()->configuration()->locale());
-
-    QTimer *timer = new QTimer(this);
-    connect(timer, &QTimer::timeout, this, [this, timer, clientId, interface](){
+    client.locale = NymeaCore::instance()->configuration()->locale();
+    client.handshakePending = true;
+    client.handshakeTimeoutId = m_timeoutWheel->add(static_cast<int>(handshakeTimeout), [this, clientId](){
+        QHash<QUuid, Client>::iterator it = m_clients.find(clientId);
+        if (it == m_clients.end() || !it->handshakePending) {
+            return;
+        }
         qCDebug(dcJsonRpc()) << "Client" << clientId << "did not initiate the handshake within the required timeout. Dropping connection.";
-        timer->deleteLater();
-        m_newConnectionWaitTimers.remove(clientId);
-        interface->terminateClientConnection(clientId);
+        it->handshakePending = false;
+        it->transport->terminateClientConnection(clientId);
     });
-    m_newConnectionWaitTimers.insert(clientId, timer);
-    timer->start(10000);
+    m_clients.insert(clientId, client);
+}
+
+const JsonRPCServerImplementation::Client &JsonRPCServerImplementation::clientState(const QUuid &clientId) const
+{
+    static const Client unknownClient;
+    QHash<QUuid, Client>::const_iterator it = m_clients.constFind(clientId);
+    return it == m_clients.constEnd() ? unknownClient : *it;
 }
 
 void JsonRPCServerImplementation::clientDisconnected(const QUuid &clientId)
 {
     qCDebug(dcJsonRpc()) << "Client disconnected:" << clientId;
-    m_clientTransports.remove(clientId);
-    m_clientNotifications.remove(clientId);
-    m_clientBuffers.remove(clientId);
-    m_clientLocales.remove(clientId);
+    Client client = m_clients.take(clientId);
+    if (client.handshakePending) {
+        m_timeoutWheel->remove(client.handshakeTimeoutId);
+    }
+    foreach (const QString &namespaceName, client.notifications) {
+        m_namespaceSubscribers[namespaceName].removeAll(clientId);
+        m_handlers.value(namespaceName)->setSubscriberCount(m_namespaceSubscribers.value(namespaceName).count());
+    }
+    m_clientStateFilters.remove(clientId);
+    QHash<int, BatchReply>::iterator batchIt = m_batches.begin();
+    while (batchIt != m_batches.end()) {
+        if (batchIt.value().clientId == clientId) {
+            batchIt = m_batches.erase(batchIt);
+        } else {
+            ++batchIt;
+        }
+    }
+    if (m_clientCoalescing.contains(clientId)) {
+        delete m_clientCoalescing.take(clientId).timer;
+    }
     if (m_pushButtonTransactions.values().contains(clientId)) {
         NymeaCore::instance()->userManager()->cancelPushButtonAuth(m_pushButtonTransactions.key(clientId));
     }
-    if (m_newConnectionWaitTimers.contains(clientId)) {
-        delete m_newConnectionWaitTimers.take(clientId);
-    }
 }
 
 }
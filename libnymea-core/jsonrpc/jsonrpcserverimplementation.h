@@ -33,6 +33,9 @@
 
 #include "jsonrpc/jsonrpcserver.h"
 #include "jsonrpc/jsonhandler.h"
+#include "jsonrpc/jsonvalidator.h"
+#include "jsonrpc/jsonframer.h"
+#include "jsonrpc/jsonrpcmetrics.h"
 #include "transportinterface.h"
 #include "usermanager/usermanager.h"
 
@@ -43,24 +46,45 @@
 #include <QObject>
 #include <QVariantMap>
 #include <QString>
+#include <QSet>
 #include <QSslConfiguration>
+#include <QElapsedTimer>
+
+#include <functional>
 
 class Thing;
 
 namespace nymeaserver {
 
+class TimeoutWheel;
+
 class JsonRPCServerImplementation: public JsonHandler, public JsonRPCServer
 {
     Q_OBJECT
 public:
-    JsonRPCServerImplementation(const QSslConfiguration &sslConfiguration = QSslConfiguration(), QObject *parent = nullptr);
+    enum Encoding {
+        EncodingJson,
+        EncodingCbor
+    };
+    Q_ENUM(Encoding)
+
+    enum Compression {
+        CompressionNone,
+        CompressionZlib
+    };
+    Q_ENUM(Compression)
+
+    JsonRPCServerImplementation(TimeoutWheel *timeoutWheel, const QSslConfiguration &sslConfiguration = QSslConfiguration(), QObject *parent = nullptr);
 
     // JsonHandler API implementation
     QString name() const override;
+    QHash<QString, QString> cacheHashes() const override;
     Q_INVOKABLE JsonReply *Hello(const QVariantMap &params, const JsonContext &context);
     Q_INVOKABLE JsonReply *Introspect(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *Version(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *SetNotificationStatus(const QVariantMap &params, const JsonContext &context);
+    Q_INVOKABLE JsonReply *SetStateFilter(const QVariantMap &params, const JsonContext &context);
+    Q_INVOKABLE JsonReply *SetNotificationInterval(const QVariantMap &params, const JsonContext &context);
 
     Q_INVOKABLE JsonReply *CreateUser(const QVariantMap &params);
     Q_INVOKABLE JsonReply *Authenticate(const QVariantMap &params);
@@ -83,6 +107,15 @@ public:
 
     bool registerHandler(JsonHandler *handler) override;
     bool registerExperienceHandler(JsonHandler *handler, int majorVersion, int minorVersion) override;
+    // Announces an experience namespace whose handler is registered by calling loader on first use
+    void registerLazyExperience(const QString &namespaceName, const QString &version, std::function<void()> loader);
+
+    QVariantMap performanceCounters() const;
+
+    void setMaxInFlightCalls(int maxInFlightCalls);
+    void setValidationSampleRate(int validationSampleRate);
+
+    JsonReply *invokeMethod(const QString &method, const QVariantMap &params, const JsonContext &context, QString *error);
 
 private:
     QHash<QString, JsonHandler *> handlers() const;
@@ -90,9 +123,59 @@ private:
     void sendResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QVariantMap &params = QVariantMap(), const QString &deprecationWarning = QString());
     void sendErrorResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error);
     void sendUnauthorizedResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error);
+    void sendReply(TransportInterface *interface, const QUuid &clientId, const QVariantMap &response);
+    // How messages are put on the wire for a client, as negotiated in JSONRPC.Hello
+    class WireFormat {
+    public:
+        Encoding encoding = EncodingJson;
+        Compression compression = CompressionNone;
+        int key() const { return (encoding << 8) | compression; }
+    };
+    class Payload {
+    public:
+        QByteArray data;
+        bool binary = false;
+    };
+
+    // Limits the state change notifications sent to a client
+    class StateFilter {
+    public:
+        QSet<QUuid> thingIds;
+        QSet<QUuid> stateTypeIds;
+        QStringList interfaces;
+        bool accepts(const QUuid &thingId, const QUuid &stateTypeId, const QStringList &thingInterfaces) const;
+    };
+
+    // State changes held back for a client, the latest value per thing and state type wins
+    class CoalescedStates {
+    public:
+        int interval = 0;
+        bool lagging = false;
+        QTimer *timer = nullptr;
+        QStringList order;
+        QHash<QString, QVariantMap> notifications;
+    };
+
+    bool coalescesStates(const QUuid &clientId, TransportInterface *transport);
+    void queueStateChange(const QUuid &clientId, const QVariantMap &notification);
+    void flushStateChanges(const QUuid &clientId);
+    void dispatchNotification(JsonHandler *handler, const QString &name, const QVariantMap &params, const QList<QUuid> &subscribers);
+
+    void sendMessage(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message);
+    void sendPayload(TransportInterface *interface, const QList<QUuid> &clients, const Payload &payload);
+    Payload encodePayload(const QVariant &message, const WireFormat &format) const;
+    Payload introspectionPayload(const WireFormat &format, int commandId);
     QVariantMap createWelcomeMessage(TransportInterface *interface, const QUuid &clientId) const;
 
     void processJsonPacket(TransportInterface *interface, const QUuid &clientId, const QByteArray &data);
+    void processCborData(TransportInterface *interface, const QUuid &clientId, const QByteArray &data);
+    void processRequest(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message);
+    void processBatch(TransportInterface *interface, const QUuid &clientId, const QVariantList &messages);
+
+    JsonValidator &validator();
+    bool sampleValidation();
+    void verifyReturns(const QString &method, const QVariantMap &returns);
+    void verifyNotificationParams(const QString &notification, const QVariantMap &params);
 
 private slots:
     void setup();
@@ -106,24 +189,128 @@ private slots:
     void sendClientNotification(const QUuid &clientId, const QVariantMap &params);
 
     void asyncReplyFinished();
+    void dispatchQueuedCalls(const QUuid &clientId);
 
     void pairingFinished(QString cognitoUserId, int status, const QString &message);
     void onCloudConnectionStateChanged();
     void onPushButtonAuthFinished(int transactionId, bool success, const QByteArray &token);
 
 private:
+    enum CallPriority {
+        CallPriorityHigh,
+        CallPriorityNormal,
+        CallPriorityLow
+    };
+
+    // Everything needed to dispatch a call, resolved once when the handler is registered
+    class MethodDispatch {
+    public:
+        JsonHandler *handler = nullptr;
+        QString targetNamespace;
+        QString method;
+        QMetaMethod metaMethod;
+        bool withContext = false;
+        bool authExemptNoUser = false;
+        bool authExemptWithUser = false;
+        QString deprecationWarning;
+        CallPriority priority = CallPriorityNormal;
+    };
+
+    // A validated call waiting for a free slot in the client's window of in-flight calls
+    class QueuedCall {
+    public:
+        TransportInterface *interface = nullptr;
+        int commandId = 0;
+        QString method;
+        QVariantMap params;
+        QByteArray token;
+        CallPriority priority = CallPriorityNormal;
+        int batchId = 0;
+    };
+    class ClientCalls {
+    public:
+        int inFlight = 0;
+        QList<QueuedCall> queue;
+    };
+
+    void invokeCall(const QUuid &clientId, const QueuedCall &call);
+
+    // Replies to the elements of a batch request, sent as one array once all of them are answered
+    class BatchReply {
+    public:
+        QUuid clientId;
+        QVariantList responses;
+        int pending = 0;
+    };
+
     QVariantMap m_api;
+    mutable QString m_apiHash;
+    // Serialized JSONRPC.Introspect replies, by wire format and command id
+    QHash<QPair<int, int>, Payload> m_introspectionReplies;
+    // Keyed by "Namespace.Method"
+    QHash<QString, MethodDispatch> m_methods;
+    JsonValidator m_validator;
+    // Outgoing messages are always validated in debug builds. Release builds validate one of every
+    // m_validationSampleRate messages, 0 disables it.
+    int m_validationSampleRate = 0;
+    quint64 m_validationCounter = 0;
+    // Async calls a client may have running at once, 0 disables the limit
+    int m_maxInFlightCalls = 32;
+
+    // Deprecation messages of notifications, by "Namespace.Notification"
+    QHash<QString, QString> m_notificationDeprecations;
     QHash<JsonHandler*, QString> m_experiences;
+    class LazyExperience {
+    public:
+        QString version;
+        std::function<void()> loader;
+    };
+    // Experience namespaces declared in plugin metadata which have not been loaded yet
+    QHash<QString, LazyExperience> m_lazyExperiences;
+    bool loadLazyExperience(const QString &namespaceName);
     QMap<TransportInterface*, bool> m_interfaces; // Interface, authenticationRequired
     QHash<QString, JsonHandler *> m_handlers;
     QHash<JsonReply *, TransportInterface *> m_asyncReplies;
+    QHash<JsonReply *, int> m_asyncReplyBatches;
+    QHash<JsonReply *, qint64> m_asyncReplyStarts;
+    mutable JsonRpcMetrics m_metrics;
+    QHash<int, BatchReply> m_batches;
+    int m_batchCounter = 0;
+    // The batch collecting replies while one of its elements is processed, 0 if none
+    int m_currentBatch = 0;
 
-    QHash<QUuid, TransportInterface*> m_clientTransports;
-    QHash<QUuid, QByteArray> m_clientBuffers;
-    QHash<QUuid, QStringList> m_clientNotifications;
-    QHash<QUuid, QLocale> m_clientLocales;
+    // Everything kept for a connected client
+    class Client {
+    public:
+        TransportInterface *transport = nullptr;
+        JsonFramer framer;
+        QByteArray cborBuffer;
+        WireFormat format;
+        // Negotiated in JSONRPC.Hello, applied once its reply has been sent
+        WireFormat pendingFormat;
+        bool formatPending = false;
+        QLocale locale;
+        QStringList notifications;
+        // Token already verified for this connection
+        QByteArray token;
+        ClientCalls calls;
+        // Receives multiple state changes of a thing as one Integrations.StatesChanged
+        bool batchStates = false;
+        bool handshakePending = false;
+        // Entry in the timeout wheel while the handshake is pending
+        quint64 handshakeTimeoutId = 0;
+    };
+    QHash<QUuid, Client> m_clients;
+    // The state of a client, an empty one for unknown clients
+    const Client &clientState(const QUuid &clientId) const;
+    // Clients with notifications enabled, by namespace
+    QHash<QString, QList<QUuid>> m_namespaceSubscribers;
+    // Only few clients filter or coalesce state changes, these are kept aside to check for any at a glance
+    QHash<QUuid, StateFilter> m_clientStateFilters;
+    QHash<QUuid, CoalescedStates> m_clientCoalescing;
     QHash<int, QUuid> m_pushButtonTransactions;
-    QHash<QUuid, QTimer*> m_newConnectionWaitTimers;
+    // Shared with the transports, drops connections not sending JSONRPC.Hello in time
+    TimeoutWheel *m_timeoutWheel = nullptr;
 
     QHash<QString, JsonReply*> m_pairingRequests;
 
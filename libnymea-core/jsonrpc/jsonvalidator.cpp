@@ -36,6 +36,7 @@
 #include <QJsonDocument>
 #include <QColor>
 #include <QDateTime>
+#include <QSet>
 
 namespace nymeaserver {
 
@@ -80,26 +81,91 @@ bool JsonValidator::checkRefs(const QVariantMap &map, const QVariantMap &api)
 
 }
 
-JsonValidator::Result JsonValidator::validateParams(const QVariantMap &params, const QString &method, const QVariantMap &api)
+class JsonValidator::Node
 {
-    QVariantMap paramDefinition = api.value("methods").toMap().value(method).toMap().value("params").toMap();
-    m_result = validateMap(params, paramDefinition, api, QIODevice::WriteOnly);
+public:
+    enum Kind {
+        KindInvalid,
+        KindBasic,
+        KindEnum,
+        KindFlags,
+        KindObject,
+        KindList
+    };
+
+    class Property {
+    public:
+        QString definitionKey;
+        QString key;
+        bool optional = false;
+        bool readOnly = false;
+        const Node *node = nullptr;
+    };
+
+    Kind kind = KindInvalid;
+    // The type, enum or flags name, as used in error messages
+    QString typeName;
+
+    // KindBasic
+    JsonHandler::BasicType basicType = JsonHandler::Variant;
+    QVariant::Type variantType = QVariant::Invalid;
+
+    // KindEnum
+    QSet<QString> enumValues;
+
+    // KindFlags and KindList
+    const Node *element = nullptr;
+
+    // KindObject
+    QList<Property> properties;
+    QHash<QString, int> propertyIndex;
+};
+
+void JsonValidator::compile(const QVariantMap &api)
+{
+    m_nodes.clear();
+    m_methodParams.clear();
+    m_methodReturns.clear();
+    m_notificationParams.clear();
+
+    // Referenced types are compiled once and shared by all their users
+    QHash<QString, Node*> refs;
+
+    QVariantMap methods = api.value("methods").toMap();
+    foreach (const QString &method, methods.keys()) {
+        m_methodParams.insert(method, compileEntry(methods.value(method).toMap().value("params").toMap(), api, refs));
+        m_methodReturns.insert(method, compileEntry(methods.value(method).toMap().value("returns").toMap(), api, refs));
+    }
+    QVariantMap notifications = api.value("notifications").toMap();
+    foreach (const QString &notification, notifications.keys()) {
+        m_notificationParams.insert(notification, compileEntry(notifications.value(notification).toMap().value("params").toMap(), api, refs));
+    }
+    m_compiled = true;
+    qCDebug(dcJsonRpc()) << "Compiled JSON validator with" << m_nodes.count() << "nodes";
+}
+
+bool JsonValidator::isCompiled() const
+{
+    return m_compiled;
+}
+
+JsonValidator::Result JsonValidator::validateParams(const QVariantMap &params, const QString &method)
+{
+    m_result = validateMap(params, m_methodParams.value(method), QIODevice::WriteOnly);
     m_result.setWhere(method + ", param " + m_result.where());
     return m_result;
 }
 
-JsonValidator::Result JsonValidator::validateReturns(const QVariantMap &returns, const QString &method, const QVariantMap &api)
+JsonValidator::Result JsonValidator::validateReturns(const QVariantMap &returns, const QString &method)
 {
-    QVariantMap returnsDefinition = api.value("methods").toMap().value(method).toMap().value("returns").toMap();
-    m_result = validateMap(returns, returnsDefinition, api, QIODevice::ReadOnly);
+    m_result = validateMap(returns, m_methodReturns.value(method), QIODevice::ReadOnly);
     m_result.setWhere(method + ", returns " + m_result.where());
     return m_result;
 }
 
-JsonValidator::Result JsonValidator::validateNotificationParams(const QVariantMap &params, const QString &notification, const QVariantMap &api)
+JsonValidator::Result JsonValidator::validateNotificationParams(const QVariantMap &params, const QString &notification)
 {
-    QVariantMap paramDefinition = api.value("notifications").toMap().value(notification).toMap().value("params").toMap();
-    m_result = validateMap(params, paramDefinition, api, QIODevice::ReadOnly);
+    m_result = validateMap(params, m_notificationParams.value(notification), QIODevice::ReadOnly);
     m_result.setWhere(notification + ", param " + m_result.where());
     return m_result;
 }
@@ -109,116 +175,166 @@ JsonValidator::Result JsonValidator::result() const
     return m_result;
 }
 
-JsonValidator::Result JsonValidator::validateMap(const QVariantMap &map, const QVariantMap &definition, const QVariantMap &api, QIODevice::OpenMode openMode)
+JsonValidator::Node *JsonValidator::createNode()
 {
-    // Make sure all required values are available
-    foreach (const QString &key, definition.keys()) {
+    Node *node = new Node();
+    m_nodes.append(QSharedPointer<Node>(node));
+    return node;
+}
+
+JsonValidator::Node *JsonValidator::compileEntry(const QVariant &definition, const QVariantMap &api, QHash<QString, Node*> &refs)
+{
+    if (definition.type() == QVariant::String && definition.toString().startsWith("$ref:")) {
+        QString refName = definition.toString();
+        refName.remove("$ref:");
+        if (refs.contains(refName)) {
+            return refs.value(refName);
+        }
+
+        // Register the node before compiling it, types may refer to themselves
+        Node *node = createNode();
+        refs.insert(refName, node);
+        node->typeName = refName;
+
+        // Refs might be enums
+        QVariantMap enums = api.value("enums").toMap();
+        if (enums.contains(refName)) {
+            node->kind = Node::KindEnum;
+            foreach (const QVariant &value, enums.value(refName).toList()) {
+                node->enumValues.insert(value.toString());
+            }
+            return node;
+        }
+        // Or flags
+        QVariantMap flags = api.value("flags").toMap();
+        if (flags.contains(refName)) {
+            node->kind = Node::KindFlags;
+            node->element = compileEntry(flags.value(refName).toList().first(), api, refs);
+            return node;
+        }
+
+        compileInto(node, api.value("types").toMap().value(refName), api, refs);
+        node->typeName = refName;
+        return node;
+    }
+
+    Node *node = createNode();
+    compileInto(node, definition, api, refs);
+    return node;
+}
+
+void JsonValidator::compileInto(Node *node, const QVariant &definition, const QVariantMap &api, QHash<QString, Node*> &refs)
+{
+    if (definition.type() == QVariant::String) {
+        node->kind = Node::KindBasic;
+        node->typeName = definition.toString();
+        node->basicType = JsonHandler::enumNameToValue<JsonHandler::BasicType>(node->typeName);
+        node->variantType = JsonHandler::basicTypeToVariantType(node->basicType);
+        return;
+    }
+
+    if (definition.type() == QVariant::Map) {
+        node->kind = Node::KindObject;
+        QVariantMap map = definition.toMap();
         QRegExp isOptional = QRegExp("^([a-z]:)*o:.*");
-        if (isOptional.exactMatch(key)) {
+        QRegExp isReadOnly = QRegExp("^([a-z]:)*r:.*");
+        foreach (const QString &key, map.keys()) {
+            Node::Property property;
+            property.definitionKey = key;
+            property.key = key;
+            property.key.remove(QRegExp("^(o:|r:|d:)*"));
+            property.optional = isOptional.exactMatch(key);
+            property.readOnly = isReadOnly.exactMatch(key);
+            property.node = compileEntry(map.value(key), api, refs);
+            node->propertyIndex.insert(property.key, node->properties.count());
+            node->properties.append(property);
+        }
+        return;
+    }
+
+    if (definition.type() == QVariant::List) {
+        node->kind = Node::KindList;
+        node->typeName = definition.toList().first().toString();
+        node->element = compileEntry(definition.toList().first(), api, refs);
+        return;
+    }
+
+    node->kind = Node::KindInvalid;
+}
+
+JsonValidator::Result JsonValidator::validateMap(const QVariantMap &map, const Node *node, QIODevice::OpenMode openMode)
+{
+    // Unknown methods or notifications don't have a definition, which means no params are allowed
+    static const Node emptyObject = [](){ Node empty; empty.kind = Node::KindObject; return empty; }();
+    if (!node) {
+        node = &emptyObject;
+    }
+
+    // Make sure all required values are available
+    foreach (const Node::Property &property, node->properties) {
+        if (property.optional) {
             continue;
         }
-        QRegExp isReadOnly = QRegExp("^([a-z]:)*r:.*");
-        if (isReadOnly.exactMatch(key) && openMode.testFlag(QIODevice::WriteOnly)) {
+        if (property.readOnly && openMode.testFlag(QIODevice::WriteOnly)) {
             continue;
         }
-        QString trimmedKey = key;
-        trimmedKey.remove(QRegExp("^(o:|r:|d:)*"));
-        if (!map.contains(trimmedKey)) {
-            return Result(false, "Missing required key: " + key, key);
+        if (!map.contains(property.key)) {
+            return Result(false, "Missing required key: " + property.definitionKey, property.definitionKey);
         }
     }
 
     // Make sure given values are valid
-    foreach (const QString &key, map.keys()) {
+    for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
         // Is the key allowed in here?
-        QVariant expectedValue = definition.value(key);
-        foreach (const QString &definitionKey, definition.keys()) {
-            QRegExp regExp = QRegExp("(o:|r:|d:)*" + key);
-            if (regExp.exactMatch(definitionKey)) {
-                expectedValue = definition.value(definitionKey);
-            }
-        }
-        if (!expectedValue.isValid()) {
-            expectedValue = definition.value("o:" + key);
-        }
-        if (!expectedValue.isValid()) {
-            expectedValue = definition.value("d:" + key);
-        }
-        if (!expectedValue.isValid()) {
-            return Result(false, "Invalid key: " + key);
+        int index = node->propertyIndex.value(it.key(), -1);
+        if (index < 0) {
+            return Result(false, "Invalid key: " + it.key());
         }
 
         // Validate content
-        QVariant value = map.value(key);
-
-        Result result = validateEntry(value, expectedValue, api, openMode);
+        Result result = validateEntry(it.value(), node->properties.at(index).node, openMode);
         if (!result.success()) {
-            result.setWhere(key + '.' + result.where());
-            result.setErrorString(result.errorString());
+            result.setWhere(it.key() + '.' + result.where());
             return result;
         }
-
-   }
+    }
 
     return Result(true);
 }
 
-JsonValidator::Result JsonValidator::validateEntry(const QVariant &value, const QVariant &definition, const QVariantMap &api, QIODevice::OpenMode openMode)
+JsonValidator::Result JsonValidator::validateEntry(const QVariant &value, const Node *node, QIODevice::OpenMode openMode)
 {
-    if (definition.type() == QVariant::String) {
-        QString expectedTypeName = definition.toString();
-
-        if (expectedTypeName.startsWith("$ref:")) {
-            QString refName = expectedTypeName;
-            refName.remove("$ref:");
-
-            // Refs might be enums
-            QVariantMap enums = api.value("enums").toMap();
-            if (enums.contains(refName)) {
-                QVariant refDefinition = enums.value(refName);
+    switch (node->kind) {
+    case Node::KindEnum:
+        if (!node->enumValues.contains(value.toString())) {
+            return Result(false, "Expected enum " + node->typeName + " but got " + value.toJsonDocument().toJson());
+        }
+        return Result(true);
 
-                QVariantList enumList = refDefinition.toList();
-                if (!enumList.contains(value.toString())) {
-                    return Result(false, "Expected enum " + refName + " but got " + value.toJsonDocument().toJson());
-                }
-                return Result(true);
-            }
-            // Or flags
-            QVariantMap flags = api.value("flags").toMap();
-            if (flags.contains(refName)) {
-                QVariant refDefinition = flags.value(refName);
-                if (value.type() != QVariant::StringList) {
-                    return Result(false, "Expected flags " + refName + " but got " + value.toString());
-                }
-                QString flagEnum = refDefinition.toList().first().toString();
-                foreach (const QVariant &flagsEntry, value.toList()) {
-                    Result result = validateEntry(flagsEntry, flagEnum, api, openMode);
-                    if (!result.success()) {
-                        return result;
-                    }
-                }
-                return Result(true);
+    case Node::KindFlags:
+        if (value.type() != QVariant::StringList) {
+            return Result(false, "Expected flags " + node->typeName + " but got " + value.toString());
+        }
+        foreach (const QVariant &flagsEntry, value.toList()) {
+            Result result = validateEntry(flagsEntry, node->element, openMode);
+            if (!result.success()) {
+                return result;
             }
-
-            QVariantMap types = api.value("types").toMap();
-            QVariant refDefinition = types.value(refName);
-            return validateEntry(value, refDefinition, api, openMode);
         }
+        return Result(true);
 
-        JsonHandler::BasicType expectedBasicType = JsonHandler::enumNameToValue<JsonHandler::BasicType>(expectedTypeName);
-        QVariant::Type expectedVariantType = JsonHandler::basicTypeToVariantType(expectedBasicType);
-
+    case Node::KindBasic: {
         // Verify basic compatiblity
-        if (expectedBasicType != JsonHandler::Variant && !value.canConvert(expectedVariantType)) {
-            return Result(false, "Invalid value. Expected: " + definition.toString() + ", Got: " + value.toString());
+        if (node->basicType != JsonHandler::Variant && !value.canConvert(node->variantType)) {
+            return Result(false, "Invalid value. Expected: " + node->typeName + ", Got: " + value.toString());
         }
 
         // Any string converts fine to Uuid, but the resulting uuid might be null
-        if (expectedBasicType == JsonHandler::Uuid && value.toUuid().isNull()) {
+        if (node->basicType == JsonHandler::Uuid && value.toUuid().isNull()) {
             return Result(false, "Invalid Uuid: " + value.toString());
         }
         // Make sure ints are valid
-        if (expectedBasicType == JsonHandler::Int) {
+        if (node->basicType == JsonHandler::Int) {
             bool ok;
             value.toLongLong(&ok);
             if (!ok) {
@@ -226,7 +342,7 @@ JsonValidator::Result JsonValidator::validateEntry(const QVariant &value, const
             }
         }
         // UInts
-        if (expectedBasicType == JsonHandler::Uint) {
+        if (node->basicType == JsonHandler::Uint) {
             bool ok;
             value.toULongLong(&ok);
             if (!ok) {
@@ -234,7 +350,7 @@ JsonValidator::Result JsonValidator::validateEntry(const QVariant &value, const
             }
         }
         // Double
-        if (expectedBasicType == JsonHandler::Double) {
+        if (node->basicType == JsonHandler::Double) {
             bool ok;
             value.toDouble(&ok);
             if (!ok) {
@@ -242,45 +358,44 @@ JsonValidator::Result JsonValidator::validateEntry(const QVariant &value, const
             }
         }
         // Color
-        if (expectedBasicType == JsonHandler::Color) {
+        if (node->basicType == JsonHandler::Color) {
             QColor color = value.value<QColor>();
             if (!color.isValid()) {
                 return Result(false, "Invalid Color: " + value.toString());
             }
         }
         // Time
-        if (expectedBasicType == JsonHandler::Time) {
+        if (node->basicType == JsonHandler::Time) {
             QTime time = QTime::fromString(value.toString(), "hh:mm");
             if (!time.isValid()) {
                 return Result(false, "Invalid Time: " + value.toString());
             }
         }
-
-
         return Result(true);
     }
 
-    if (definition.type() == QVariant::Map) {
+    case Node::KindObject:
         if (value.type() != QVariant::Map) {
             return Result(false, "Invalid value. Expected a map bug received: " + value.toString());
         }
-        return validateMap(value.toMap(), definition.toMap(), api, openMode);
-    }
+        return validateMap(value.toMap(), node, openMode);
 
-    if (definition.type() == QVariant::List) {
-        QVariantList list = definition.toList();
-        QVariant entryDefinition = list.first();
+    case Node::KindList:
         if (value.type() != QVariant::List && value.type() != QVariant::StringList) {
-            return Result(false, "Expected list of " + entryDefinition.toString() + " but got value of type " + value.typeName() + "\n" + QJsonDocument::fromVariant(value).toJson());
+            return Result(false, "Expected list of " + node->typeName + " but got value of type " + value.typeName() + "\n" + QJsonDocument::fromVariant(value).toJson());
         }
         foreach (const QVariant &entry, value.toList()) {
-            Result result = validateEntry(entry, entryDefinition, api, openMode);
+            Result result = validateEntry(entry, node->element, openMode);
             if (!result.success()) {
                 return result;
             }
         }
         return Result(true);
+
+    case Node::KindInvalid:
+        break;
     }
+
     Q_ASSERT_X(false, "JsonValildator", "Incomplete validation. Unexpected type in template");
     return Result(false);
 }
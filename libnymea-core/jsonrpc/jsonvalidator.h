@@ -34,6 +34,8 @@
 #include <QPair>
 #include <QVariant>
 #include <QIODevice>
+#include <QHash>
+#include <QSharedPointer>
 
 namespace nymeaserver {
 
@@ -63,14 +65,29 @@ public:
 
     static bool checkRefs(const QVariantMap &map, const QVariantMap &api);
 
-    Result validateParams(const QVariantMap &params, const QString &method, const QVariantMap &api);
-    Result validateReturns(const QVariantMap &returns, const QString &method, const QVariantMap &api);
-    Result validateNotificationParams(const QVariantMap &params, const QString &notification, const QVariantMap &api);
+    // Compiles the definitions of the given api into validator nodes. Needs to be called whenever the api changes.
+    void compile(const QVariantMap &api);
+    bool isCompiled() const;
+
+    Result validateParams(const QVariantMap &params, const QString &method);
+    Result validateReturns(const QVariantMap &returns, const QString &method);
+    Result validateNotificationParams(const QVariantMap &params, const QString &notification);
 
     Result result() const;
 private:
-    Result validateMap(const QVariantMap &map, const QVariantMap &definition, const QVariantMap &api, QIODevice::OpenMode openMode);
-    Result validateEntry(const QVariant &value, const QVariant &definition, const QVariantMap &api, QIODevice::OpenMode openMode);
+    class Node;
+    Node *createNode();
+    Node *compileEntry(const QVariant &definition, const QVariantMap &api, QHash<QString, Node*> &refs);
+    void compileInto(Node *node, const QVariant &definition, const QVariantMap &api, QHash<QString, Node*> &refs);
+
+    Result validateMap(const QVariantMap &map, const Node *node, QIODevice::OpenMode openMode);
+    Result validateEntry(const QVariant &value, const Node *node, QIODevice::OpenMode openMode);
+
+    QList<QSharedPointer<Node>> m_nodes;
+    QHash<QString, const Node*> m_methodParams;
+    QHash<QString, const Node*> m_methodReturns;
+    QHash<QString, const Node*> m_notificationParams;
+    bool m_compiled = false;
 
     Result m_result;
 };
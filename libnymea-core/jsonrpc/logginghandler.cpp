@@ -49,6 +49,7 @@ LoggingHandler::LoggingHandler(QObject *parent) :
 
     // Objects
     registerObject<LogEntry, LogEntries>();
+    registerObject<LogEntrySample, LogEntrySamples>();
 
     // Methods
     QString description; QVariantMap params; QVariantMap returns;
@@ -66,7 +67,11 @@ LoggingHandler::LoggingHandler(QObject *parent) :
                    "1) offset 0, maxCount 1000: Entries 0 to 9999\n"
                    "2) offset 10000, maxCount 1000: Entries 10000 - 19999\n"
                    "3) offset 20000, maxCount 1000: Entries 20000 - 29999\n"
-                   "...";
+                   "...\n\n"
+                   "For large result sets, prefer paging using a cursor: If a limit is given and the page is full, "
+                   "the reply contains a nextCursor. Passing it as cursor in the next call returns the following "
+                   "page. The cost of fetching a page using a cursor does not grow with the number of preceding "
+                   "entries. If a cursor is given, the offset is ignored.";
     QVariantMap timeFilter;
     timeFilter.insert("o:startDate", enumValueName(Int));
     timeFilter.insert("o:endDate", enumValueName(Int));
@@ -80,12 +85,30 @@ LoggingHandler::LoggingHandler(QObject *parent) :
     params.insert("o:values", QVariantList() << enumValueName(Variant));
     params.insert("o:limit", enumValueName(Int));
     params.insert("o:offset", enumValueName(Int));
+    params.insert("o:cursor", enumValueName(String));
     returns.insert("loggingError", enumRef<Logging::LoggingError>());
     returns.insert("o:logEntries", objectRef<LogEntries>());
     returns.insert("count", enumValueName(Int));
     returns.insert("offset", enumValueName(Int));
+    returns.insert("o:nextCursor", enumValueName(String));
     registerMethod("GetLogEntries", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Get the history of a numeric state as aggregated samples. The time range between "
+                  "startDate and endDate (seconds since epoch) is divided into sampleCount buckets of equal "
+                  "length. For each bucket containing log entries, the minimum, maximum, average and last "
+                  "value is returned. Buckets without any entries are omitted. The timestamp of a sample "
+                  "marks the start of its bucket in milliseconds. If not given, endDate defaults to now "
+                  "and startDate to 24 hours before endDate.";
+    params.insert("thingId", enumValueName(Uuid));
+    params.insert("stateTypeId", enumValueName(Uuid));
+    params.insert("o:startDate", enumValueName(Int));
+    params.insert("o:endDate", enumValueName(Int));
+    params.insert("sampleCount", enumValueName(Int));
+    returns.insert("loggingError", enumRef<Logging::LoggingError>());
+    returns.insert("o:logEntrySamples", objectRef<LogEntrySamples>());
+    registerMethod("GetLogEntrySamples", description, params, returns);
+
     // Notifications
     params.clear();
     description = "Emitted whenever an entry is appended to the logging system. ";
@@ -125,21 +148,95 @@ JsonReply* LoggingHandler::GetLogEntries(const QVariantMap &params) const
 {
     LogFilter filter = unpackLogFilter(params);
 
+    if (params.contains("cursor")) {
+        // The cursor is an opaque token for clients, internally it's "<timestamp>:<rowid>" in base64
+        QList<QByteArray> cursor = QByteArray::fromBase64(params.value("cursor").toByteArray()).split(':');
+        bool timestampOk = false, rowIdOk = false;
+        qint64 timestamp = cursor.count() == 2 ? cursor.at(0).toLongLong(&timestampOk) : 0;
+        qint64 rowId = cursor.count() == 2 ? cursor.at(1).toLongLong(&rowIdOk) : 0;
+        if (!timestampOk || !rowIdOk) {
+            QVariantMap returns;
+            returns.insert("loggingError", enumValueName<Logging::LoggingError>(Logging::LoggingErrorInvalidFilterParameter));
+            returns.insert("offset", filter.offset());
+            returns.insert("count", 0);
+            return createReply(returns);
+        }
+        filter.setCursor(timestamp, rowId);
+    }
+
     LogEntriesFetchJob *job = NymeaCore::instance()->logEngine()->fetchLogEntries(filter);
 
     JsonReply *reply = createAsyncReply("GetLogEntries");
 
     connect(job, &LogEntriesFetchJob::finished, reply, [reply, job, filter](){
 
-        QVariantList entries;
+        // Each entry is serialized right away, so only one entry map exists at a time
+        QByteArray entries;
+        JsonWriter writer(&entries);
+        writer.beginArray();
         foreach (const LogEntry &entry, job->results()) {
-            entries.append(packLogEntry(entry));
+            writer.writeValue(packLogEntry(entry));
         }
+        writer.endArray();
         QVariantMap returns;
         returns.insert("loggingError", enumValueName<Logging::LoggingError>(Logging::LoggingErrorNoError));
-        returns.insert("logEntries", entries);
+        returns.insert("logEntries", QVariant::fromValue(JsonFragment(entries)));
         returns.insert("offset", filter.offset());
-        returns.insert("count", entries.count());
+        returns.insert("count", job->results().count());
+        if (job->hasMore()) {
+            QByteArray cursor = QByteArray::number(job->lastTimestamp()) + ':' + QByteArray::number(job->lastRowId());
+            returns.insert("nextCursor", QString::fromUtf8(cursor.toBase64()));
+        }
+
+        reply->setData(returns);
+        reply->finished();
+    });
+
+    return reply;
+}
+
+JsonReply *LoggingHandler::GetLogEntrySamples(const QVariantMap &params) const
+{
+    ThingId thingId = params.value("thingId").toUuid();
+    StateTypeId stateTypeId = params.value("stateTypeId").toUuid();
+    int sampleCount = params.value("sampleCount").toInt();
+
+    QDateTime endDate = params.contains("endDate") ? QDateTime::fromTime_t(params.value("endDate").toUInt()) : QDateTime::currentDateTime();
+    QDateTime startDate = params.contains("startDate") ? QDateTime::fromTime_t(params.value("startDate").toUInt()) : endDate.addDays(-1);
+
+    QVariantMap returns;
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(thingId);
+    if (!thing || !thing->thingClass().stateTypes().contains(stateTypeId)) {
+        qCWarning(dcJsonRpc()) << "Cannot fetch log entry samples. No such thing or state type:" << thingId << stateTypeId;
+        returns.insert("loggingError", enumValueName<Logging::LoggingError>(Logging::LoggingErrorInvalidFilterParameter));
+        return createReply(returns);
+    }
+
+    QVariant::Type stateType = thing->thingClass().getStateType(stateTypeId).type();
+    if (stateType != QVariant::Int && stateType != QVariant::UInt && stateType != QVariant::Double) {
+        qCWarning(dcJsonRpc()) << "Cannot fetch log entry samples for non-numeric state" << stateTypeId;
+        returns.insert("loggingError", enumValueName<Logging::LoggingError>(Logging::LoggingErrorInvalidFilterParameter));
+        return createReply(returns);
+    }
+
+    if (sampleCount <= 0 || sampleCount > 10000 || startDate >= endDate) {
+        qCWarning(dcJsonRpc()) << "Invalid sample parameters. sampleCount:" << sampleCount << "startDate:" << startDate << "endDate:" << endDate;
+        returns.insert("loggingError", enumValueName<Logging::LoggingError>(Logging::LoggingErrorInvalidFilterParameter));
+        return createReply(returns);
+    }
+
+    LogEntrySamplesFetchJob *job = NymeaCore::instance()->logEngine()->fetchLogEntrySamples(thingId, stateTypeId, startDate, endDate, sampleCount);
+
+    JsonReply *reply = createAsyncReply("GetLogEntrySamples");
+
+    connect(job, &LogEntrySamplesFetchJob::finished, reply, [reply, job](){
+        QVariantList samples;
+        foreach (const LogEntrySample &sample, job->results()) {
+            samples.append(packLogEntrySample(sample));
+        }
+        QVariantMap returns;
+        returns.insert("loggingError", enumValueName<Logging::LoggingError>(Logging::LoggingErrorNoError));
+        returns.insert("logEntrySamples", samples);
 
         reply->setData(returns);
         reply->finished();
@@ -148,6 +245,20 @@ JsonReply* LoggingHandler::GetLogEntries(const QVariantMap &params) const
     return reply;
 }
 
+QVariantMap LoggingHandler::packLogEntrySample(const LogEntrySample &sample)
+{
+    QVariantMap sampleMap;
+    sampleMap.insert("timestamp", sample.timestamp().toMSecsSinceEpoch());
+    sampleMap.insert("count", sample.count());
+    sampleMap.insert("min", sample.min());
+    sampleMap.insert("max", sample.max());
+    sampleMap.insert("avg", sample.avg());
+    if (sample.last().isValid()) {
+        sampleMap.insert("last", sample.last());
+    }
+    return sampleMap;
+}
+
 QVariantMap LoggingHandler::packLogEntry(const LogEntry &logEntry)
 {
     QVariantMap logEntryMap;
@@ -248,14 +359,14 @@ LogFilter LoggingHandler::unpackLogFilter(const QVariantMap &logFilterMap)
     if (logFilterMap.contains("thingIds")) {
         QVariantList thingIds = logFilterMap.value("thingIds").toList();
         foreach (const QVariant &thingId, thingIds) {
-            filter.addThingId(ThingId(thingId.toString()));
+            filter.addThingId(thingId.toUuid());
         }
     }
     // DEPRECATED
     if (logFilterMap.contains("deviceIds")) {
         QVariantList deviceIds = logFilterMap.value("deviceIds").toList();
         foreach (const QVariant &deviceId, deviceIds) {
-            filter.addThingId(ThingId(deviceId.toString()));
+            filter.addThingId(deviceId.toUuid());
         }
     }
     if (logFilterMap.contains("values")) {
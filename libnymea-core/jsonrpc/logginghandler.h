@@ -33,6 +33,7 @@
 
 #include "jsonrpc/jsonhandler.h"
 #include "logging/logentry.h"
+#include "logging/logentrysample.h"
 #include "logging/logfilter.h"
 
 namespace nymeaserver {
@@ -45,6 +46,7 @@ public:
     QString name() const override;
 
     Q_INVOKABLE JsonReply *GetLogEntries(const QVariantMap &params) const;
+    Q_INVOKABLE JsonReply *GetLogEntrySamples(const QVariantMap &params) const;
 
 signals:
     void LogEntryAdded(const QVariantMap &params);
@@ -52,6 +54,7 @@ signals:
 
 private:
     static QVariantMap packLogEntry(const LogEntry &logEntry);
+    static QVariantMap packLogEntrySample(const LogEntrySample &sample);
 
     static LogFilter unpackLogFilter(const QVariantMap &logFilterMap);
 
@@ -30,6 +30,7 @@
 
 #include "modbusrtuhandler.h"
 #include "hardware/modbus/modbusrtumanager.h"
+#include "hardware/modbus/modbusrtumasterimpl.h"
 #include "hardware/serialport/serialportmonitor.h"
 
 namespace nymeaserver {
@@ -58,6 +59,32 @@ ModbusRtuHandler::ModbusRtuHandler(ModbusRtuManager *modbusRtuManager, QObject *
 
     registerObject("ModbusRtuMaster", modbusRtuMasterDescription);
 
+    QVariantMap modbusRtuSlaveStatisticsDescription;
+    modbusRtuSlaveStatisticsDescription.insert("slaveAddress", enumValueName(Uint));
+    modbusRtuSlaveStatisticsDescription.insert("requests", enumValueName(Uint));
+    modbusRtuSlaveStatisticsDescription.insert("errors", enumValueName(Uint));
+    modbusRtuSlaveStatisticsDescription.insert("timeouts", enumValueName(Uint));
+    modbusRtuSlaveStatisticsDescription.insert("averageResponseTime", enumValueName(Uint));
+    modbusRtuSlaveStatisticsDescription.insert("maxResponseTime", enumValueName(Uint));
+    modbusRtuSlaveStatisticsDescription.insert("responseTimeHistogram", QVariantList() << enumValueName(Uint));
+    registerObject("ModbusRtuSlaveStatistics", modbusRtuSlaveStatisticsDescription);
+
+    QVariantMap modbusRtuMasterStatisticsDescription;
+    modbusRtuMasterStatisticsDescription.insert("modbusUuid", enumValueName(Uuid));
+    modbusRtuMasterStatisticsDescription.insert("since", enumValueName(Uint));
+    modbusRtuMasterStatisticsDescription.insert("requests", enumValueName(Uint));
+    modbusRtuMasterStatisticsDescription.insert("readRequests", enumValueName(Uint));
+    modbusRtuMasterStatisticsDescription.insert("writeRequests", enumValueName(Uint));
+    modbusRtuMasterStatisticsDescription.insert("coalescedReads", enumValueName(Uint));
+    modbusRtuMasterStatisticsDescription.insert("retries", enumValueName(Uint));
+    modbusRtuMasterStatisticsDescription.insert("timeouts", enumValueName(Uint));
+    modbusRtuMasterStatisticsDescription.insert("errors", enumValueName(Uint));
+    modbusRtuMasterStatisticsDescription.insert("bytesSent", enumValueName(Uint));
+    modbusRtuMasterStatisticsDescription.insert("bytesReceived", enumValueName(Uint));
+    modbusRtuMasterStatisticsDescription.insert("busOccupancy", enumValueName(Double));
+    modbusRtuMasterStatisticsDescription.insert("slaves", QVariantList() << objectRef("ModbusRtuSlaveStatistics"));
+    registerObject("ModbusRtuMasterStatistics", modbusRtuMasterStatisticsDescription);
+
     QVariantMap params, returns;
     QString description;
 
@@ -139,6 +166,19 @@ ModbusRtuHandler::ModbusRtuHandler(ModbusRtuManager *modbusRtuManager, QObject *
     returns.insert("modbusError", enumRef<ModbusRtuManager::ModbusRtuError>());
     registerMethod("ReconfigureModbusRtuMaster", description, params, returns);
 
+    // GetStatistics
+    params.clear(); returns.clear();
+    description = "Get the traffic statistics of the modbus RTU masters, or only of the one with the given modbusUuid. "
+                  "The counters are collected since the given timestamp (in seconds since epoch), read requests merged into "
+                  "other ones are not sent and counted in coalescedReads. Retries include the repetitions of requests which timed out. "
+                  "The busOccupancy is the percentage of time the line was occupied, estimated from the frame sizes and the serial "
+                  "configuration. Response times are in milliseconds, the responseTimeHistogram counts the responses up to "
+                  "10, 20, 50, 100, 200, 500, 1000 and above 1000 ms.";
+    params.insert("o:modbusUuid", enumValueName(Uuid));
+    returns.insert("o:statistics", QVariantList() << objectRef("ModbusRtuMasterStatistics"));
+    returns.insert("modbusError", enumRef<ModbusRtuManager::ModbusRtuError>());
+    registerMethod("GetStatistics", description, params, returns);
+
     // Serial port monitor
     connect(modbusRtuManager->serialPortMonitor(), &SerialPortMonitor::serialPortAdded, this, [=](const SerialPort &serialPort){
         QVariantMap params;
@@ -267,6 +307,36 @@ JsonReply *ModbusRtuHandler::ReconfigureModbusRtuMaster(const QVariantMap &param
     return createReply(returnMap);
 }
 
+JsonReply *ModbusRtuHandler::GetStatistics(const QVariantMap &params)
+{
+    QVariantMap returnMap;
+    if (!m_modbusRtuManager->supported()) {
+        returnMap.insert("modbusError", enumValueName<ModbusRtuManager::ModbusRtuError>(ModbusRtuManager::ModbusRtuErrorNotSupported));
+        return createReply(returnMap);
+    }
+
+    QList<ModbusRtuMaster *> modbusRtuMasters = m_modbusRtuManager->modbusRtuMasters();
+    if (params.contains("modbusUuid")) {
+        ModbusRtuMaster *modbusRtuMaster = m_modbusRtuManager->getModbusRtuMaster(params.value("modbusUuid").toUuid());
+        if (!modbusRtuMaster) {
+            returnMap.insert("modbusError", enumValueName<ModbusRtuManager::ModbusRtuError>(ModbusRtuManager::ModbusRtuErrorUuidNotFound));
+            return createReply(returnMap);
+        }
+        modbusRtuMasters = {modbusRtuMaster};
+    }
+
+    QVariantList statisticsList;
+    foreach (ModbusRtuMaster *modbusRtuMaster, modbusRtuMasters) {
+        ModbusRtuMasterImpl *modbusRtuMasterImpl = qobject_cast<ModbusRtuMasterImpl *>(modbusRtuMaster);
+        if (!modbusRtuMasterImpl)
+            continue;
+
+        statisticsList << packModbusRtuStatistics(modbusRtuMasterImpl->modbusUuid(), modbusRtuMasterImpl->statistics());
+    }
+    returnMap.insert("statistics", statisticsList);
+    returnMap.insert("modbusError", enumValueName<ModbusRtuManager::ModbusRtuError>(ModbusRtuManager::ModbusRtuErrorNoError));
+    return createReply(returnMap);
+}
 
 QVariantMap ModbusRtuHandler::packModbusRtuMaster(ModbusRtuMaster *modbusRtuMaster)
 {
@@ -283,4 +353,45 @@ QVariantMap ModbusRtuHandler::packModbusRtuMaster(ModbusRtuMaster *modbusRtuMast
     return modbusRtuMasterMap;
 }
 
+QVariantMap ModbusRtuHandler::packModbusRtuStatistics(const QUuid &modbusUuid, const ModbusRtuStatistics &statistics)
+{
+    ModbusRtuStatistics::Counters counters = statistics.counters();
+    QVariantMap statisticsMap;
+    statisticsMap.insert("modbusUuid", modbusUuid);
+    statisticsMap.insert("since", counters.since.toTime_t());
+    statisticsMap.insert("requests", counters.requests);
+    statisticsMap.insert("readRequests", counters.readRequests);
+    statisticsMap.insert("writeRequests", counters.writeRequests);
+    statisticsMap.insert("coalescedReads", counters.coalescedReads);
+    statisticsMap.insert("retries", counters.retries);
+    statisticsMap.insert("timeouts", counters.timeouts);
+    statisticsMap.insert("errors", counters.errors);
+    statisticsMap.insert("bytesSent", counters.bytesSent);
+    statisticsMap.insert("bytesReceived", counters.bytesReceived);
+    statisticsMap.insert("busOccupancy", statistics.busOccupancy());
+
+    QVariantList slaveList;
+    QHash<int, ModbusRtuStatistics::SlaveCounters> slaveCounters = statistics.slaveCounters();
+    QList<int> slaveAddresses = slaveCounters.keys();
+    std::sort(slaveAddresses.begin(), slaveAddresses.end());
+    foreach (int slaveAddress, slaveAddresses) {
+        const ModbusRtuStatistics::SlaveCounters &slave = slaveCounters[slaveAddress];
+        QVariantMap slaveMap;
+        slaveMap.insert("slaveAddress", slaveAddress);
+        slaveMap.insert("requests", slave.requests);
+        slaveMap.insert("errors", slave.errors);
+        slaveMap.insert("timeouts", slave.timeouts);
+        slaveMap.insert("averageResponseTime", slave.responses > 0 ? slave.responseTimeTotal / static_cast<qint64>(slave.responses) : 0);
+        slaveMap.insert("maxResponseTime", slave.responseTimeMax);
+        QVariantList histogram;
+        foreach (quint64 count, slave.histogram) {
+            histogram << count;
+        }
+        slaveMap.insert("responseTimeHistogram", histogram);
+        slaveList << slaveMap;
+    }
+    statisticsMap.insert("slaves", slaveList);
+    return statisticsMap;
+}
+
 }
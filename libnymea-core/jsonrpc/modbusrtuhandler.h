@@ -35,6 +35,7 @@
 
 #include "jsonrpc/jsonhandler.h"
 #include "hardware/modbus/modbusrtumaster.h"
+#include "hardware/modbus/modbusrtustatistics.h"
 
 namespace nymeaserver {
 
@@ -55,6 +56,8 @@ public:
     Q_INVOKABLE JsonReply *RemoveModbusRtuMaster(const QVariantMap &params);
     Q_INVOKABLE JsonReply *ReconfigureModbusRtuMaster(const QVariantMap &params);
 
+    Q_INVOKABLE JsonReply *GetStatistics(const QVariantMap &params);
+
 signals:
     void SerialPortAdded(const QVariantMap &params);
     void SerialPortRemoved(const QVariantMap &params);
@@ -67,6 +70,7 @@ private:
     ModbusRtuManager *m_modbusRtuManager = nullptr;
 
     QVariantMap packModbusRtuMaster(ModbusRtuMaster *modbusRtuMaster);
+    QVariantMap packModbusRtuStatistics(const QUuid &modbusUuid, const ModbusRtuStatistics &statistics);
 };
 
 }
@@ -226,6 +226,9 @@ NetworkManagerHandler::NetworkManagerHandler(NetworkManager *networkManager, QOb
     registerNotification("WiredNetworkDeviceChanged", description, params);
 
     connect(m_networkManager, &NetworkManager::stateChanged, this, &NetworkManagerHandler::onNetworkManagerStatusChanged);
+    connect(m_networkManager, &NetworkManager::stateChanged, this, [this](){
+        m_networkDevicesCached = false;
+    });
     connect(m_networkManager, &NetworkManager::networkingEnabledChanged, this, &NetworkManagerHandler::onNetworkManagerStatusChanged);
     connect(m_networkManager, &NetworkManager::wirelessEnabledChanged, this, &NetworkManagerHandler::onNetworkManagerStatusChanged);
 
@@ -327,13 +330,16 @@ JsonReply *NetworkManagerHandler::GetNetworkDevices(const QVariantMap &params)
     if (!m_networkManager->available())
         return createReply(statusToReply(NetworkManager::NetworkManagerErrorNetworkManagerNotAvailable));
 
+    if (!m_networkDevicesCached)
+        cacheNetworkDevices();
+
     QVariantList wirelessNetworkDevices;
-    foreach (WirelessNetworkDevice *networkDevice, m_networkManager->wirelessNetworkDevices())
-        wirelessNetworkDevices.append(packWirelessNetworkDevice(networkDevice));
+    foreach (const QVariantMap &networkDevice, m_wirelessNetworkDevices)
+        wirelessNetworkDevices.append(networkDevice);
 
     QVariantList wiredNetworkDevices;
-    foreach (WiredNetworkDevice *networkDevice, m_networkManager->wiredNetworkDevices())
-        wiredNetworkDevices.append(packWiredNetworkDevice(networkDevice));
+    foreach (const QVariantMap &networkDevice, m_wiredNetworkDevices)
+        wiredNetworkDevices.append(networkDevice);
 
     QVariantMap returns = statusToReply(NetworkManager::NetworkManagerErrorNoError);
     returns.insert("wirelessNetworkDevices", wirelessNetworkDevices);
@@ -440,13 +446,18 @@ void NetworkManagerHandler::onNetworkManagerStatusChanged()
 
 void NetworkManagerHandler::onWirelessNetworkDeviceAdded(WirelessNetworkDevice *networkDevice)
 {
+    QVariantMap packedDevice = packWirelessNetworkDevice(networkDevice);
+    m_wirelessNetworkDevices.insert(networkDevice->interface(), packedDevice);
+
     QVariantMap notification;
-    notification.insert("wirelessNetworkDevice", packWirelessNetworkDevice(networkDevice));
+    notification.insert("wirelessNetworkDevice", packedDevice);
     emit WirelessNetworkDeviceAdded(notification);
 }
 
 void NetworkManagerHandler::onWirelessNetworkDeviceRemoved(const QString &interface)
 {
+    m_wirelessNetworkDevices.remove(interface);
+
     QVariantMap notification;
     notification.insert("interface", interface);
     emit WirelessNetworkDeviceRemoved(notification);
@@ -454,20 +465,28 @@ void NetworkManagerHandler::onWirelessNetworkDeviceRemoved(const QString &interf
 
 void NetworkManagerHandler::onWirelessNetworkDeviceChanged(WirelessNetworkDevice *networkDevice)
 {
+    QVariantMap packedDevice = packWirelessNetworkDevice(networkDevice);
+    m_wirelessNetworkDevices.insert(networkDevice->interface(), packedDevice);
+
     QVariantMap notification;
-    notification.insert("wirelessNetworkDevice", packWirelessNetworkDevice(networkDevice));
+    notification.insert("wirelessNetworkDevice", packedDevice);
     emit WirelessNetworkDeviceChanged(notification);
 }
 
 void NetworkManagerHandler::onWiredNetworkDeviceAdded(WiredNetworkDevice *networkDevice)
 {
+    QVariantMap packedDevice = packWiredNetworkDevice(networkDevice);
+    m_wiredNetworkDevices.insert(networkDevice->interface(), packedDevice);
+
     QVariantMap notification;
-    notification.insert("wiredNetworkDevice", packWiredNetworkDevice(networkDevice));
+    notification.insert("wiredNetworkDevice", packedDevice);
     emit WiredNetworkDeviceAdded(notification);
 }
 
 void NetworkManagerHandler::onWiredNetworkDeviceRemoved(const QString &interface)
 {
+    m_wiredNetworkDevices.remove(interface);
+
     QVariantMap notification;
     notification.insert("interface", interface);
     emit WiredNetworkDeviceRemoved(notification);
@@ -475,11 +494,27 @@ void NetworkManagerHandler::onWiredNetworkDeviceRemoved(const QString &interface
 
 void NetworkManagerHandler::onWiredNetworkDeviceChanged(WiredNetworkDevice *networkDevice)
 {
+    QVariantMap packedDevice = packWiredNetworkDevice(networkDevice);
+    m_wiredNetworkDevices.insert(networkDevice->interface(), packedDevice);
+
     QVariantMap notification;
-    notification.insert("wiredNetworkDevice", packWiredNetworkDevice(networkDevice));
+    notification.insert("wiredNetworkDevice", packedDevice);
     emit WiredNetworkDeviceChanged(notification);
 }
 
+void NetworkManagerHandler::cacheNetworkDevices()
+{
+    m_wirelessNetworkDevices.clear();
+    foreach (WirelessNetworkDevice *networkDevice, m_networkManager->wirelessNetworkDevices())
+        m_wirelessNetworkDevices.insert(networkDevice->interface(), packWirelessNetworkDevice(networkDevice));
+
+    m_wiredNetworkDevices.clear();
+    foreach (WiredNetworkDevice *networkDevice, m_networkManager->wiredNetworkDevices())
+        m_wiredNetworkDevices.insert(networkDevice->interface(), packWiredNetworkDevice(networkDevice));
+
+    m_networkDevicesCached = true;
+}
+
 QVariantMap NetworkManagerHandler::packWirelessAccessPoint(WirelessAccessPoint *wirelessAccessPoint)
 {
     QVariantMap wirelessAccessPointVariant;
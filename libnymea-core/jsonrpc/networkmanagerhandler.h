@@ -94,6 +94,12 @@ private:
 
     NetworkManager* m_networkManager = nullptr;
 
+    // Packed network devices by interface, kept up to date from the device signals
+    void cacheNetworkDevices();
+    bool m_networkDevicesCached = false;
+    QMap<QString, QVariantMap> m_wirelessNetworkDevices;
+    QMap<QString, QVariantMap> m_wiredNetworkDevices;
+
 };
 
 }
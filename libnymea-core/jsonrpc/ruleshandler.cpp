@@ -61,6 +61,16 @@
     The \a params contain the map for the notification.
 */
 
+/*! \fn void nymeaserver::RulesHandler::RulesAdded(const QVariantMap &params);
+    This signal is emitted to the API notifications when multiple \l{Rule}{Rules} were added at once.
+    The \a params contain the map for the notification.
+*/
+
+/*! \fn void nymeaserver::RulesHandler::RulesConfigurationChanged(const QVariantMap &params);
+    This signal is emitted to the API notifications when the configuration of multiple \l{Rule}{Rules} was changed at once.
+    The \a params contain the map for the notification.
+*/
+
 #include "ruleshandler.h"
 #include "nymeacore.h"
 #include "ruleengine/ruleengine.h"
@@ -90,6 +100,26 @@ RulesHandler::RulesHandler(QObject *parent) :
     ruleDescription.insert("executable", enumValueName(Bool));
     registerObject("RuleDescription", ruleDescription);
 
+    QVariantMap ruleStatistics;
+    ruleStatistics.insert("ruleId", enumValueName(Uuid));
+    ruleStatistics.insert("evaluations", enumValueName(Uint));
+    ruleStatistics.insert("matches", enumValueName(Uint));
+    ruleStatistics.insert("stateEvaluationTime", enumValueName(Uint));
+    ruleStatistics.insert("executedActions", enumValueName(Uint));
+    ruleStatistics.insert("averageActionLatency", enumValueName(Uint));
+    ruleStatistics.insert("maxActionLatency", enumValueName(Uint));
+    registerObject("RuleStatistics", ruleStatistics);
+
+    QVariantMap ruleTrace;
+    ruleTrace.insert("timestamp", enumValueName(Uint));
+    ruleTrace.insert("thingId", enumValueName(Uuid));
+    ruleTrace.insert("eventTypeId", enumValueName(Uuid));
+    ruleTrace.insert("evaluationTime", enumValueName(Uint));
+    ruleTrace.insert("ruleIds", QVariantList() << enumValueName(Uuid));
+    ruleTrace.insert("o:actionCount", enumValueName(Uint));
+    ruleTrace.insert("o:completionTime", enumValueName(Uint));
+    registerObject("RuleTrace", ruleTrace);
+
     registerObject<ParamDescriptor, ParamDescriptors>();
     registerObject<EventDescriptor, EventDescriptors>();
     registerObject<StateDescriptor>();
@@ -158,6 +188,30 @@ RulesHandler::RulesHandler(QObject *parent) :
     returns.insert("o:rule", objectRef("Rule"));
     registerMethod("EditRule", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Add multiple rules at once. Each rule is described the same way as in Rules.AddRule, any given id is ignored. "
+                  "All rules are validated before any of them is added. If one of them is invalid, none of the rules will be "
+                  "added and failedIndex contains the position of the offending rule in the list. If successful, the ruleIds "
+                  "are returned in the order of the given rules and the notification \"Rules.RulesAdded\" will be emitted "
+                  "once for all of them.";
+    params.insert("rules", QVariantList() << objectRef("Rule"));
+    returns.insert("ruleError", enumRef<RuleEngine::RuleError>());
+    returns.insert("o:ruleIds", QVariantList() << enumValueName(Uuid));
+    returns.insert("o:failedIndex", enumValueName(Int));
+    registerMethod("AddRules", description, params, returns);
+
+    params.clear(); returns.clear();
+    description = "Edit multiple rules at once. The configuration of each rule with the given id will be replaced with the "
+                  "given configuration, as in Rules.EditRule. All rules are validated before any of them is changed. If one of "
+                  "them is invalid, none of the rules will be changed and failedIndex contains the position of the offending "
+                  "rule in the list. If successful, the notification \"Rules.RulesConfigurationChanged\" will be emitted "
+                  "once for all of them.";
+    params.insert("rules", QVariantList() << objectRef("Rule"));
+    returns.insert("ruleError", enumRef<RuleEngine::RuleError>());
+    returns.insert("o:rules", QVariantList() << objectRef("Rule"));
+    returns.insert("o:failedIndex", enumValueName(Int));
+    registerMethod("EditRules", description, params, returns);
+
     params.clear(); returns.clear();
     description = "Remove a rule";
     params.insert("ruleId", enumValueName(Uuid));
@@ -197,6 +251,19 @@ RulesHandler::RulesHandler(QObject *parent) :
     returns.insert("ruleError", enumRef<RuleEngine::RuleError>());
     registerMethod("ExecuteExitActions", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Get statistics about the evaluation and execution of rules. If ruleId is given, only the statistics of that "
+                  "rule are returned. The stateEvaluationTime is the total time in microseconds spent in evaluating the "
+                  "states of the rule. Action latencies are given in milliseconds from the triggering event until the action "
+                  "finished. In addition, a sample of recent events is traced from their arrival until all actions they caused "
+                  "have finished. The evaluationTime of a trace is given in microseconds, the completionTime in milliseconds. "
+                  "The completionTime is not set while actions are still pending.";
+    params.insert("o:ruleId", enumValueName(Uuid));
+    returns.insert("ruleError", enumRef<RuleEngine::RuleError>());
+    returns.insert("o:ruleStatistics", QVariantList() << objectRef("RuleStatistics"));
+    returns.insert("o:traces", QVariantList() << objectRef("RuleTrace"));
+    registerMethod("GetStatistics", description, params, returns);
+
     // Notifications
     params.clear(); returns.clear();
     description = "Emitted whenever a Rule was removed.";
@@ -219,10 +286,22 @@ RulesHandler::RulesHandler(QObject *parent) :
     params.insert("rule", objectRef("Rule"));
     registerNotification("RuleConfigurationChanged", description, params);
 
+    params.clear(); returns.clear();
+    description = "Emitted when multiple Rules were added using Rules.AddRules.";
+    params.insert("rules", QVariantList() << objectRef("Rule"));
+    registerNotification("RulesAdded", description, params);
+
+    params.clear(); returns.clear();
+    description = "Emitted when the configuration of multiple Rules changed using Rules.EditRules.";
+    params.insert("rules", QVariantList() << objectRef("Rule"));
+    registerNotification("RulesConfigurationChanged", description, params);
+
     connect(NymeaCore::instance(), &NymeaCore::ruleAdded, this, &RulesHandler::ruleAddedNotification);
     connect(NymeaCore::instance(), &NymeaCore::ruleRemoved, this, &RulesHandler::ruleRemovedNotification);
     connect(NymeaCore::instance(), &NymeaCore::ruleActiveChanged, this, &RulesHandler::ruleActiveChangedNotification);
     connect(NymeaCore::instance(), &NymeaCore::ruleConfigurationChanged, this, &RulesHandler::ruleConfigurationChangedNotification);
+    connect(NymeaCore::instance(), &NymeaCore::rulesAdded, this, &RulesHandler::rulesAddedNotification);
+    connect(NymeaCore::instance(), &NymeaCore::rulesConfigurationChanged, this, &RulesHandler::rulesConfigurationChangedNotification);
 }
 
 /*! Returns the name of the \l{RulesHandler}. In this case \b Rules.*/
@@ -290,6 +369,57 @@ JsonReply *RulesHandler::EditRule(const QVariantMap &params)
     return createReply(returns);
 }
 
+JsonReply *RulesHandler::AddRules(const QVariantMap &params)
+{
+    QList<Rule> rules;
+    foreach (const QVariant &ruleVariant, params.value("rules").toList()) {
+        Rule rule = unpack<Rule>(ruleVariant.toMap());
+        rule.setId(RuleId::createRuleId());
+        rules.append(rule);
+    }
+
+    int failedIndex = -1;
+    RuleEngine::RuleError status = NymeaCore::instance()->ruleEngine()->addRules(rules, &failedIndex);
+    QVariantMap returns;
+    if (status == RuleEngine::RuleErrorNoError) {
+        QVariantList ruleIds;
+        foreach (const Rule &rule, rules) {
+            ruleIds.append(rule.id().toString());
+        }
+        returns.insert("ruleIds", ruleIds);
+    } else if (failedIndex >= 0) {
+        returns.insert("failedIndex", failedIndex);
+    }
+    returns.insert("ruleError", enumValueName<RuleEngine::RuleError>(status));
+    return createReply(returns);
+}
+
+JsonReply *RulesHandler::EditRules(const QVariantMap &params)
+{
+    QList<Rule> rules;
+    foreach (const QVariant &ruleVariant, params.value("rules").toList()) {
+        Rule rule = unpack<Rule>(ruleVariant.toMap());
+        // The id property is read only, so it won't be unpacked automatically
+        rule.setId(ruleVariant.toMap().value("id").toUuid());
+        rules.append(rule);
+    }
+
+    int failedIndex = -1;
+    RuleEngine::RuleError status = NymeaCore::instance()->ruleEngine()->editRules(rules, &failedIndex);
+    QVariantMap returns;
+    if (status == RuleEngine::RuleErrorNoError) {
+        QVariantList rulesList;
+        foreach (const Rule &rule, rules) {
+            rulesList.append(pack(NymeaCore::instance()->ruleEngine()->findRule(rule.id())));
+        }
+        returns.insert("rules", rulesList);
+    } else if (failedIndex >= 0) {
+        returns.insert("failedIndex", failedIndex);
+    }
+    returns.insert("ruleError", enumValueName<RuleEngine::RuleError>(status));
+    return createReply(returns);
+}
+
 JsonReply* RulesHandler::RemoveRule(const QVariantMap &params)
 {
     QVariantMap returns;
@@ -384,6 +514,88 @@ void RulesHandler::ruleConfigurationChangedNotification(const Rule &rule)
     emit RuleConfigurationChanged(params);
 }
 
+void RulesHandler::rulesAddedNotification(const QList<Rule> &rules)
+{
+    QVariantList rulesList;
+    foreach (const Rule &rule, rules) {
+        rulesList.append(pack(rule));
+    }
+    QVariantMap params;
+    params.insert("rules", rulesList);
+
+    emit RulesAdded(params);
+}
+
+void RulesHandler::rulesConfigurationChangedNotification(const QList<Rule> &rules)
+{
+    QVariantList rulesList;
+    foreach (const Rule &rule, rules) {
+        rulesList.append(pack(rule));
+    }
+    QVariantMap params;
+    params.insert("rules", rulesList);
+
+    emit RulesConfigurationChanged(params);
+}
+
+JsonReply *RulesHandler::GetStatistics(const QVariantMap &params)
+{
+    RuleEngine *ruleEngine = NymeaCore::instance()->ruleEngine();
+    QVariantMap returns;
+    QList<RuleId> ruleIds = ruleEngine->ruleIds();
+    if (params.contains("ruleId")) {
+        RuleId ruleId = RuleId(params.value("ruleId").toString());
+        if (ruleEngine->findRule(ruleId).id().isNull()) {
+            returns.insert("ruleError", enumValueName<RuleEngine::RuleError>(RuleEngine::RuleErrorRuleNotFound));
+            return createReply(returns);
+        }
+        ruleIds = {ruleId};
+    }
+
+    QVariantList ruleStatisticsList;
+    foreach (const RuleId &ruleId, ruleIds) {
+        RuleStatistics::Counters counters = ruleEngine->statistics()->counters(ruleId);
+        QVariantMap ruleStatistics;
+        ruleStatistics.insert("ruleId", ruleId);
+        ruleStatistics.insert("evaluations", counters.evaluations);
+        ruleStatistics.insert("matches", counters.matches);
+        ruleStatistics.insert("stateEvaluationTime", counters.stateEvaluationTime / 1000);
+        ruleStatistics.insert("executedActions", counters.executedActions);
+        ruleStatistics.insert("averageActionLatency", counters.executedActions > 0 ? counters.actionLatencyTotal / static_cast<qint64>(counters.executedActions) : 0);
+        ruleStatistics.insert("maxActionLatency", counters.actionLatencyMax);
+        ruleStatisticsList.append(ruleStatistics);
+    }
+
+    QVariantList tracesList;
+    foreach (const RuleStatistics::Trace &trace, ruleEngine->statistics()->traces()) {
+        if (params.contains("ruleId") && !trace.ruleIds.contains(ruleIds.first())) {
+            continue;
+        }
+        QVariantMap traceMap;
+        traceMap.insert("timestamp", trace.timestamp.toMSecsSinceEpoch());
+        traceMap.insert("thingId", trace.thingId);
+        traceMap.insert("eventTypeId", trace.eventTypeId);
+        traceMap.insert("evaluationTime", trace.evaluationTime);
+        QVariantList traceRuleIds;
+        foreach (const RuleId &ruleId, trace.ruleIds) {
+            traceRuleIds.append(ruleId);
+        }
+        traceMap.insert("ruleIds", traceRuleIds);
+        if (trace.actionCount >= 0) {
+            traceMap.insert("actionCount", trace.actionCount);
+        }
+        if (trace.completionTime >= 0) {
+            traceMap.insert("completionTime", trace.completionTime);
+        }
+        tracesList.append(traceMap);
+    }
+
+    returns.insert("ruleError", enumValueName<RuleEngine::RuleError>(RuleEngine::RuleErrorNoError));
+    returns.insert("ruleStatistics", ruleStatisticsList);
+    returns.insert("traces", tracesList);
+    return createReply(returns);
+}
+
 QVariantMap RulesHandler::packRuleDescription(const Rule &rule)
 {
     QVariantMap ruleDescriptionMap;
@@ -50,6 +50,8 @@ public:
 
     Q_INVOKABLE JsonReply *AddRule(const QVariantMap &params);
     Q_INVOKABLE JsonReply *EditRule(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *AddRules(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *EditRules(const QVariantMap &params);
     Q_INVOKABLE JsonReply *RemoveRule(const QVariantMap &params);
     Q_INVOKABLE JsonReply *FindRules(const QVariantMap &params);
 
@@ -59,17 +61,23 @@ public:
     Q_INVOKABLE JsonReply *ExecuteActions(const QVariantMap &params);
     Q_INVOKABLE JsonReply *ExecuteExitActions(const QVariantMap &params);
 
+    Q_INVOKABLE JsonReply *GetStatistics(const QVariantMap &params);
+
 signals:
     void RuleRemoved(const QVariantMap &params);
     void RuleAdded(const QVariantMap &params);
     void RuleActiveChanged(const QVariantMap &params);
     void RuleConfigurationChanged(const QVariantMap &params);
+    void RulesAdded(const QVariantMap &params);
+    void RulesConfigurationChanged(const QVariantMap &params);
 
 private slots:
     void ruleRemovedNotification(const RuleId &ruleId);
     void ruleAddedNotification(const Rule &rule);
     void ruleActiveChangedNotification(const Rule &rule);
     void ruleConfigurationChangedNotification(const Rule &rule);
+    void rulesAddedNotification(const QList<Rule> &rules);
+    void rulesConfigurationChangedNotification(const QList<Rule> &rules);
 
 private:
     QVariantMap packRuleDescription(const Rule &rule);
@@ -61,9 +61,12 @@ ScriptsHandler::ScriptsHandler(ScriptEngine *scriptEngine, QObject *parent):
     registerMethod("GetScriptContent", description, params, returns);
 
     params.clear(); returns.clear();
-    description = "Add a script";
+    description = "Add a script. If isolated is true, the script runs in its own thread so it can't delay the rest of "
+                  "the system. The cpuTime of isolated scripts tells how many milliseconds they have been running. "
+                  "Isolated scripts which are busy for more than 10 seconds at a time are terminated.";
     params.insert("name", enumValueName(String));
     params.insert("content", enumValueName(String));
+    params.insert("o:isolated", enumValueName(Bool));
     returns.insert("scriptError", enumRef<ScriptEngine::ScriptError>());
     returns.insert("o:script", objectRef<Script>());
     returns.insert("o:errors", enumValueName(StringList));
@@ -173,7 +176,7 @@ JsonReply* ScriptsHandler::AddScript(const QVariantMap &params)
     qWarning() << "Script:" << params.value("content").toString();
     QVariantMap returns;
 
-    ScriptEngine::AddScriptReply scriptReply = m_engine->addScript(params.value("name").toString(), params.value("content").toByteArray());
+    ScriptEngine::AddScriptReply scriptReply = m_engine->addScript(params.value("name").toString(), params.value("content").toByteArray(), params.value("isolated", false).toBool());
 
     returns.insert("scriptError", enumValueName(scriptReply.scriptError));
     if (scriptReply.scriptError != ScriptEngine::ScriptErrorNoError) {
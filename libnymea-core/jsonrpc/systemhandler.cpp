@@ -29,8 +29,12 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "systemhandler.h"
+#include "jsonrpcserverimplementation.h"
+#include "nymeacore.h"
+#include "startuptrace.h"
 
 #include "platform/platform.h"
+#include "platform/platformcache.h"
 #include "platform/platformupdatecontroller.h"
 #include "platform/platformsystemcontroller.h"
 
@@ -173,6 +177,35 @@ SystemHandler::SystemHandler(Platform *platform, QObject *parent):
     returns.insert("deviceSerialNumber", enumValueName(String));
     registerMethod("GetSystemInfo", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Returns the performance counters of the JSON-RPC server, accumulated since it started. "
+                  "\"stages\" holds latency histograms of parsing, params validation, handler execution, "
+                  "serialization and handing messages to the transport. \"methods\" holds the execution "
+                  "latency per method, for async methods up to their reply. \"transports\" counts the traffic "
+                  "per transport, \"clients\" lists the bytes waiting to be written and the calls running and "
+                  "queued per client. Latencies are given in microseconds as count, totalUs, maxUs, p50Us, p90Us "
+                  "and p99Us, with percentiles accurate to about 25%.";
+    returns.insert("stages", enumValueName(Object));
+    returns.insert("methods", enumValueName(Object));
+    returns.insert("transports", enumValueName(Object));
+    returns.insert("clients", enumValueName(Object));
+    registerMethod("GetPerformanceCounters", description, params, returns);
+
+    params.clear(); returns.clear();
+    description = "Returns where the time went while nymea was starting up. \"finished\" is false while things "
+                  "are still being set up. \"duration\" gives the startup time in milliseconds. \"phases\" holds "
+                  "the milliseconds spent per startup phase, \"plugins\" the milliseconds spent loading and "
+                  "initializing each plugin and \"things\" the setup time per thing id, together with its name, "
+                  "plugin and whether the setup completed. The full trace is written in Chrome trace format to "
+                  "\"traceFile\" once the startup finished.";
+    returns.insert("finished", enumValueName(Bool));
+    returns.insert("duration", enumValueName(Uint));
+    returns.insert("phases", enumValueName(Object));
+    returns.insert("plugins", enumValueName(Object));
+    returns.insert("things", enumValueName(Object));
+    returns.insert("traceFile", enumValueName(String));
+    registerMethod("GetStartupReport", description, params, returns);
+
     // Notifications
     params.clear();
     description = "Emitted whenever the system capabilities change.";
@@ -272,8 +305,8 @@ SystemHandler::SystemHandler(Platform *platform, QObject *parent):
         QVariantMap params;
         params.insert("time", QDateTime::currentDateTime().toMSecsSinceEpoch() / 1000);
         params.insert("timeZone", QTimeZone::systemTimeZoneId());
-        params.insert("automaticTimeAvailable", m_platform->systemController()->automaticTimeAvailable());
-        params.insert("automaticTime", m_platform->systemController()->automaticTime());
+        params.insert("automaticTimeAvailable", m_platform->cache()->automaticTimeAvailable());
+        params.insert("automaticTime", m_platform->cache()->automaticTime());
         emit TimeConfigurationChanged(params);
     }, Qt::QueuedConnection); // Queued to give QDateTime a chance to sync itself to the system
 }
@@ -324,8 +357,8 @@ JsonReply *SystemHandler::GetUpdateStatus(const QVariantMap &params) const
 {
     Q_UNUSED(params)
     QVariantMap ret;
-    ret.insert("busy", m_platform->updateController()->busy());
-    ret.insert("updateRunning", m_platform->updateController()->updateRunning());
+    ret.insert("busy", m_platform->cache()->busy());
+    ret.insert("updateRunning", m_platform->cache()->updateRunning());
     return createReply(ret);
 }
 
@@ -342,7 +375,7 @@ JsonReply *SystemHandler::GetPackages(const QVariantMap &params) const
 {
     Q_UNUSED(params)
     QVariantList packagelist;
-    foreach (const Package &package, m_platform->updateController()->packages()) {
+    foreach (const Package &package, m_platform->cache()->packages()) {
         packagelist.append(pack(package));
     }
     QVariantMap returns;
@@ -378,7 +411,7 @@ JsonReply *SystemHandler::GetRepositories(const QVariantMap &params) const
 {
     Q_UNUSED(params)
     QVariantList repos;
-    foreach (const Repository &repository, m_platform->updateController()->repositories()) {
+    foreach (const Repository &repository, m_platform->cache()->repositories()) {
         repos.append(pack(repository));
     }
     QVariantMap returns;
@@ -399,8 +432,8 @@ JsonReply *SystemHandler::GetTime(const QVariantMap &params) const
 {
     Q_UNUSED(params)
     QVariantMap returns;
-    returns.insert("automaticTimeAvailable", m_platform->systemController()->automaticTimeAvailable());
-    returns.insert("automaticTime", m_platform->systemController()->automaticTime());
+    returns.insert("automaticTimeAvailable", m_platform->cache()->automaticTimeAvailable());
+    returns.insert("automaticTime", m_platform->cache()->automaticTime());
     returns.insert("time", QDateTime::currentDateTime().toMSecsSinceEpoch() / 1000);
     returns.insert("timeZone", QTimeZone::systemTimeZoneId());
     return createReply(returns);
@@ -441,13 +474,8 @@ JsonReply *SystemHandler::SetTime(const QVariantMap &params) const
 JsonReply *SystemHandler::GetTimeZones(const QVariantMap &params) const
 {
     Q_UNUSED(params)
-    QVariantList timeZones;
-    foreach (const QByteArray &timeZoneId, QTimeZone::availableTimeZoneIds()) {
-        timeZones.append(QString::fromUtf8(timeZoneId));
-    }
-
     QVariantMap returns;
-    returns.insert("timeZones", timeZones);
+    returns.insert("timeZones", m_platform->cache()->timeZones());
     return createReply(returns);
 }
 
@@ -455,11 +483,23 @@ JsonReply *SystemHandler::GetSystemInfo(const QVariantMap &params) const
 {
     Q_UNUSED(params)
     QVariantMap returns;
-    QString deviceSerial = m_platform->systemController()->deviceSerialNumber();
+    QString deviceSerial = m_platform->cache()->deviceSerialNumber();
     returns.insert("deviceSerialNumber", deviceSerial);
     return createReply(returns);
 }
 
+JsonReply *SystemHandler::GetPerformanceCounters(const QVariantMap &params) const
+{
+    Q_UNUSED(params)
+    return createReply(NymeaCore::instance()->jsonRPCServer()->performanceCounters());
+}
+
+JsonReply *SystemHandler::GetStartupReport(const QVariantMap &params) const
+{
+    Q_UNUSED(params)
+    return createReply(StartupTrace::summary());
+}
+
 void SystemHandler::onCapabilitiesChanged()
 {
     QVariantMap caps;
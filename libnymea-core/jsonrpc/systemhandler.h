@@ -70,6 +70,9 @@ public:
 
     Q_INVOKABLE JsonReply *GetSystemInfo(const QVariantMap &params) const;
 
+    Q_INVOKABLE JsonReply *GetPerformanceCounters(const QVariantMap &params) const;
+    Q_INVOKABLE JsonReply *GetStartupReport(const QVariantMap &params) const;
+
 signals:
     void CapabilitiesChanged(const QVariantMap &params);
 
@@ -103,8 +103,23 @@ QString TagsHandler::name() const
 
 JsonReply *TagsHandler::GetTags(const QVariantMap &params) const
 {
+    // Start from the smallest index matching the filter, the remaining filters only look at the result
+    TagsStorage *tagsStorage = NymeaCore::instance()->tagsStorage();
+    QList<Tag> tags;
+    if (params.contains("thingId")) {
+        tags = tagsStorage->tags(ThingId(params.value("thingId").toUuid()));
+    } else if (params.contains("deviceId")) {
+        tags = tagsStorage->tags(ThingId(params.value("deviceId").toUuid()));
+    } else if (params.contains("ruleId")) {
+        tags = tagsStorage->tags(RuleId(params.value("ruleId").toUuid()));
+    } else if (params.contains("appId") && params.contains("tagId")) {
+        tags = tagsStorage->tags(params.value("appId").toString(), params.value("tagId").toString());
+    } else {
+        tags = tagsStorage->tags();
+    }
+
     QVariantList ret;
-    foreach (const Tag &tag, NymeaCore::instance()->tagsStorage()->tags()) {
+    foreach (const Tag &tag, tags) {
         if (params.contains("thingId") && params.value("thingId").toUuid() != tag.thingId()) {
             continue;
         }
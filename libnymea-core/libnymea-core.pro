@@ -5,7 +5,7 @@ include(../nymea.pri)
 
 QT += bluetooth dbus qml sql websockets serialport
 INCLUDEPATH += $$top_srcdir/libnymea $$top_builddir
-LIBS += -L$$top_builddir/libnymea/ -lnymea -lssl -lcrypto
+LIBS += -L$$top_builddir/libnymea/ -lnymea -lssl -lcrypto -ldl
 
 CONFIG += link_pkgconfig
 PKGCONFIG += nymea-mqtt nymea-networkmanager nymea-zigbee nymea-remoteproxyclient nymea-gpio
@@ -39,6 +39,9 @@ packagesExist(Qt5SerialBus) {
     message("Building with QtSerialBus support.")
     PKGCONFIG += Qt5SerialBus
     DEFINES += WITH_QTSERIALBUS
+
+    HEADERS += hardware/modbus/modbusrturequestscheduler.h
+    SOURCES += hardware/modbus/modbusrturequestscheduler.cpp
 } else {
     message("Qt5SerialBus package not found. Building without QtSerialBus support.")
 }
@@ -64,6 +67,10 @@ HEADERS += nymeacore.h \
     hardware/serialport/serialportmonitor.h \
     integrations/apikeysprovidersloader.h \
     integrations/plugininfocache.h \
+    integrations/pluginhostintegrationplugin.h \
+    integrations/pluginhost/pluginhostprotocol.h \
+    integrations/pluginhost/pluginhoststatechannel.h \
+    integrations/pluginstatistics.h \
     integrations/python/pyapikeystorage.h \
     integrations/python/pybrowseractioninfo.h \
     integrations/python/pybrowseresult.h \
@@ -72,6 +79,9 @@ HEADERS += nymeacore.h \
     integrations/python/pypluginstorage.h \
     integrations/python/pyplugintimer.h \
     integrations/thingmanagerimplementation.h \
+    integrations/thingstatecache.h \
+    integrations/thingstatesnapshots.h \
+    integrations/browsercache.h \
     integrations/translator.h \
     experiences/experiencemanager.h \
     jsonrpc/modbusrtuhandler.h \
@@ -79,6 +89,10 @@ HEADERS += nymeacore.h \
     ruleengine/ruleengine.h \
     ruleengine/rule.h \
     ruleengine/stateevaluator.h \
+    ruleengine/compiledstateevaluator.h \
+    ruleengine/compiledeventmatcher.h \
+    ruleengine/rulestatistics.h \
+    ruleengine/rulestore.h \
     ruleengine/ruleaction.h \
     ruleengine/ruleactionparam.h \
     scriptengine/script.h \
@@ -89,19 +103,27 @@ HEADERS += nymeacore.h \
     scriptengine/scriptinterfaceaction.h \
     scriptengine/scriptinterfaceevent.h \
     scriptengine/scriptstate.h \
+    scriptengine/scriptstategroup.h \
+    scriptengine/scriptworker.h \
     transportinterface.h \
     nymeaconfiguration.h \
     servermanager.h \
     servers/tcpserver.h \
     servers/mocktcpserver.h \
     servers/webserver.h \
+    servers/sslhandshaker.h \
+    servers/timeoutwheel.h \
+    servers/httpeventstream.h \
     servers/httprequest.h \
     servers/httpreply.h \
     servers/bluetoothserver.h \
     servers/websocketserver.h \
     servers/mqttbroker.h \
+    servers/mqttstateexporter.h \
     jsonrpc/jsonrpcserverimplementation.h \
     jsonrpc/jsonvalidator.h \
+    jsonrpc/jsonframer.h \
+    jsonrpc/jsonrpcmetrics.h \
     jsonrpc/integrationshandler.h \
     jsonrpc/devicehandler.h \
     jsonrpc/ruleshandler.h \
@@ -120,8 +142,13 @@ HEADERS += nymeacore.h \
     logging/logengine.h \
     logging/logfilter.h \
     logging/logentry.h \
+    logging/logentrysample.h \
+    logging/logstoragebackend.h \
+    logging/logsegmentstorage.h \
+    logging/logcolumncache.h \
     logging/logvaluetool.h \
     time/timemanager.h \
+    time/deadlinescheduler.h \
     usermanager/userinfo.h \
     usermanager/usermanager.h \
     usermanager/tokeninfo.h \
@@ -142,12 +169,16 @@ HEADERS += nymeacore.h \
     hardware/modbus/modbusrtumanager.h \
     hardware/modbus/modbusrtumasterimpl.h \
     hardware/modbus/modbusrtureplyimpl.h \
+    hardware/modbus/modbusrtustatistics.h \
     hardware/network/networkaccessmanagerimpl.h \
+    hardware/network/coaphardwareresourceimplementation.h \
     hardware/network/upnp/upnpdiscoveryimplementation.h \
     hardware/network/upnp/upnpdiscoveryrequest.h \
     hardware/network/upnp/upnpdiscoveryreplyimplementation.h \
     hardware/network/mqtt/mqttproviderimplementation.h \
     hardware/network/mqtt/mqttchannelimplementation.h \
+    hardware/network/zeroconf/sharedzeroconfcontroller.h \
+    hardware/i2c/i2cbusworker.h \
     hardware/i2c/i2cmanagerimplementation.h \
     hardware/zigbee/zigbeehardwareresourceimplementation.h \
     debugserverhandler.h \
@@ -155,7 +186,17 @@ HEADERS += nymeacore.h \
     tagging/tag.h \
     cloud/cloudtransport.h \
     debugreportgenerator.h \
+    startuptrace.h \
+    eventqueue.h \
+    memoryprofiler.h \
+    federation/federationmanager.h \
+    federation/federationpeer.h \
+    federation/federationintegrationplugin.h \
+    replication/replicationprotocol.h \
+    replication/replicationprimary.h \
+    replication/replicationstandby.h \
     platform/platform.h \
+    platform/platformcache.h \
     zigbee/zigbeeadapter.h \
     zigbee/zigbeeadapters.h \
     zigbee/zigbeemanager.h
@@ -165,7 +206,14 @@ SOURCES += nymeacore.cpp \
     hardware/serialport/serialportmonitor.cpp \
     integrations/apikeysprovidersloader.cpp \
     integrations/plugininfocache.cpp \
+    integrations/pluginhostintegrationplugin.cpp \
+    integrations/pluginhost/pluginhostprotocol.cpp \
+    integrations/pluginhost/pluginhoststatechannel.cpp \
+    integrations/pluginstatistics.cpp \
     integrations/thingmanagerimplementation.cpp \
+    integrations/thingstatecache.cpp \
+    integrations/thingstatesnapshots.cpp \
+    integrations/browsercache.cpp \
     integrations/translator.cpp \
     experiences/experiencemanager.cpp \
     jsonrpc/modbusrtuhandler.cpp \
@@ -173,6 +221,10 @@ SOURCES += nymeacore.cpp \
     ruleengine/ruleengine.cpp \
     ruleengine/rule.cpp \
     ruleengine/stateevaluator.cpp \
+    ruleengine/compiledstateevaluator.cpp \
+    ruleengine/compiledeventmatcher.cpp \
+    ruleengine/rulestatistics.cpp \
+    ruleengine/rulestore.cpp \
     ruleengine/ruleaction.cpp \
     ruleengine/ruleactionparam.cpp \
     scriptengine/script.cpp \
@@ -183,19 +235,27 @@ SOURCES += nymeacore.cpp \
     scriptengine/scriptinterfaceaction.cpp \
     scriptengine/scriptinterfaceevent.cpp \
     scriptengine/scriptstate.cpp \
+    scriptengine/scriptstategroup.cpp \
+    scriptengine/scriptworker.cpp \
     transportinterface.cpp \
     nymeaconfiguration.cpp \
     servermanager.cpp \
     servers/tcpserver.cpp \
     servers/mocktcpserver.cpp \
     servers/webserver.cpp \
+    servers/sslhandshaker.cpp \
+    servers/timeoutwheel.cpp \
+    servers/httpeventstream.cpp \
     servers/httprequest.cpp \
     servers/httpreply.cpp \
     servers/websocketserver.cpp \
     servers/bluetoothserver.cpp \
     servers/mqttbroker.cpp \
+    servers/mqttstateexporter.cpp \
     jsonrpc/jsonrpcserverimplementation.cpp \
     jsonrpc/jsonvalidator.cpp \
+    jsonrpc/jsonframer.cpp \
+    jsonrpc/jsonrpcmetrics.cpp \
     jsonrpc/integrationshandler.cpp \
     jsonrpc/devicehandler.cpp \
     jsonrpc/ruleshandler.cpp \
@@ -213,8 +273,13 @@ SOURCES += nymeacore.cpp \
     logging/logengine.cpp \
     logging/logfilter.cpp \
     logging/logentry.cpp \
+    logging/logentrysample.cpp \
+    logging/logstoragebackend.cpp \
+    logging/logsegmentstorage.cpp \
+    logging/logcolumncache.cpp \
     logging/logvaluetool.cpp \
     time/timemanager.cpp \
+    time/deadlinescheduler.cpp \
     usermanager/userinfo.cpp \
     usermanager/usermanager.cpp \
     usermanager/tokeninfo.cpp \
@@ -235,12 +300,16 @@ SOURCES += nymeacore.cpp \
     hardware/modbus/modbusrtumanager.cpp \
     hardware/modbus/modbusrtumasterimpl.cpp \
     hardware/modbus/modbusrtureplyimpl.cpp \
+    hardware/modbus/modbusrtustatistics.cpp \
     hardware/network/networkaccessmanagerimpl.cpp \
+    hardware/network/coaphardwareresourceimplementation.cpp \
     hardware/network/upnp/upnpdiscoveryimplementation.cpp \
     hardware/network/upnp/upnpdiscoveryrequest.cpp \
     hardware/network/upnp/upnpdiscoveryreplyimplementation.cpp \
     hardware/network/mqtt/mqttproviderimplementation.cpp \
     hardware/network/mqtt/mqttchannelimplementation.cpp \
+    hardware/network/zeroconf/sharedzeroconfcontroller.cpp \
+    hardware/i2c/i2cbusworker.cpp \
     hardware/i2c/i2cmanagerimplementation.cpp \
     hardware/zigbee/zigbeehardwareresourceimplementation.cpp \
     debugserverhandler.cpp \
@@ -248,7 +317,17 @@ SOURCES += nymeacore.cpp \
     tagging/tag.cpp \
     cloud/cloudtransport.cpp \
     debugreportgenerator.cpp \
+    startuptrace.cpp \
+    eventqueue.cpp \
+    memoryprofiler.cpp \
+    federation/federationmanager.cpp \
+    federation/federationpeer.cpp \
+    federation/federationintegrationplugin.cpp \
+    replication/replicationprotocol.cpp \
+    replication/replicationprimary.cpp \
+    replication/replicationstandby.cpp \
     platform/platform.cpp \
+    platform/platformcache.cpp \
     zigbee/zigbeeadapter.cpp \
     zigbee/zigbeeadapters.cpp \
     zigbee/zigbeemanager.cpp
@@ -0,0 +1,319 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::LogColumnCache
+    \brief Keeps recent power and energy state values in memory for fast aggregation.
+
+    \ingroup logs
+    \inmodule core
+
+    Dashboards repeatedly aggregate the power and energy states of many meters over the last hours
+    or days. The \l{LogEngine} appends the values of states with a metering unit to this cache,
+    which keeps the timestamps and values of each state in separate, contiguous chunks. Samples
+    for ranges within the cache window are computed from memory with SIMD reductions over the
+    value arrays instead of querying the log database.
+
+    \sa LogEngine
+*/
+
+#include "logcolumncache.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace nymeaserver {
+
+// Values per chunk. Chunks are dropped as a whole once all their values left the window.
+static const int chunkSize = 4096;
+
+// Sum, minimum and maximum of count values, count must be at least 1
+static void reduce(const double *values, int count, double &sum, double &min, double &max)
+{
+    int i = 0;
+    double s = 0;
+    double lo = values[0];
+    double hi = values[0];
+#if defined(__SSE2__)
+    if (count >= 4) {
+        // Two independent accumulators so consecutive adds don't wait for each other
+        __m128d sum0 = _mm_setzero_pd();
+        __m128d sum1 = _mm_setzero_pd();
+        __m128d min0 = _mm_loadu_pd(values);
+        __m128d max0 = min0;
+        __m128d min1 = min0;
+        __m128d max1 = min0;
+        for (; i + 4 <= count; i += 4) {
+            __m128d v0 = _mm_loadu_pd(values + i);
+            __m128d v1 = _mm_loadu_pd(values + i + 2);
+            sum0 = _mm_add_pd(sum0, v0);
+            sum1 = _mm_add_pd(sum1, v1);
+            min0 = _mm_min_pd(min0, v0);
+            min1 = _mm_min_pd(min1, v1);
+            max0 = _mm_max_pd(max0, v0);
+            max1 = _mm_max_pd(max1, v1);
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, _mm_add_pd(sum0, sum1));
+        s = lanes[0] + lanes[1];
+        _mm_storeu_pd(lanes, _mm_min_pd(min0, min1));
+        lo = qMin(lanes[0], lanes[1]);
+        _mm_storeu_pd(lanes, _mm_max_pd(max0, max1));
+        hi = qMax(lanes[0], lanes[1]);
+    }
+#elif defined(__aarch64__)
+    if (count >= 4) {
+        float64x2_t sum0 = vdupq_n_f64(0);
+        float64x2_t sum1 = vdupq_n_f64(0);
+        float64x2_t min0 = vld1q_f64(values);
+        float64x2_t max0 = min0;
+        float64x2_t min1 = min0;
+        float64x2_t max1 = min0;
+        for (; i + 4 <= count; i += 4) {
+            float64x2_t v0 = vld1q_f64(values + i);
+            float64x2_t v1 = vld1q_f64(values + i + 2);
+            sum0 = vaddq_f64(sum0, v0);
+            sum1 = vaddq_f64(sum1, v1);
+            min0 = vminq_f64(min0, v0);
+            min1 = vminq_f64(min1, v1);
+            max0 = vmaxq_f64(max0, v0);
+            max1 = vmaxq_f64(max1, v1);
+        }
+        s = vaddvq_f64(vaddq_f64(sum0, sum1));
+        lo = vminvq_f64(vminq_f64(min0, min1));
+        hi = vmaxvq_f64(vmaxq_f64(max0, max1));
+    }
+#endif
+    for (; i < count; i++) {
+        s += values[i];
+        lo = qMin(lo, values[i]);
+        hi = qMax(hi, values[i]);
+    }
+    sum = s;
+    min = lo;
+    max = hi;
+}
+
+/*! Constructs a \l{LogColumnCache} keeping the values of the last \a window seconds. */
+LogColumnCache::LogColumnCache(int window):
+    m_window(qMax(60, window) * 1000LL),
+    m_createdAt(QDateTime::currentMSecsSinceEpoch())
+{
+
+}
+
+/*! Returns true if states with the given \a unit are kept in the cache. These are the power,
+    energy, current and voltage states of meters. */
+bool LogColumnCache::isCachedUnit(Types::Unit unit)
+{
+    switch (unit) {
+    case Types::UnitMilliWatt:
+    case Types::UnitWatt:
+    case Types::UnitKiloWatt:
+    case Types::UnitKiloWattHour:
+    case Types::UnitAmpere:
+    case Types::UnitMilliAmpere:
+    case Types::UnitVolt:
+    case Types::UnitMilliVolt:
+    case Types::UnitVoltAmpere:
+    case Types::UnitVoltAmpereReactive:
+    case Types::UnitAmpereHour:
+        return true;
+    default:
+        return false;
+    }
+}
+
+int LogColumnCache::window() const
+{
+    return m_window / 1000;
+}
+
+/*! Returns the number of values currently held in the cache. */
+int LogColumnCache::valueCount() const
+{
+    int count = 0;
+    foreach (const Column &column, m_columns) {
+        foreach (const Chunk &chunk, column) {
+            count += chunk.values.count();
+        }
+    }
+    return count;
+}
+
+/*! Returns true if all values of the state with \a stateTypeId of the thing with \a thingId since
+    \a startTime are in the cache. Values logged before the cache was created or older than the window
+    are not. */
+bool LogColumnCache::covers(const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &startTime) const
+{
+    if (!m_columns.contains(Series(thingId, stateTypeId))) {
+        return false;
+    }
+    qint64 coveredFrom = qMax(m_createdAt, QDateTime::currentMSecsSinceEpoch() - m_window);
+    return startTime.toMSecsSinceEpoch() >= coveredFrom;
+}
+
+/*! Appends the \a value of the state with \a stateTypeId of the thing with \a thingId at \a timestamp. */
+void LogColumnCache::append(const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &timestamp, double value)
+{
+    qint64 time = timestamp.toMSecsSinceEpoch();
+    Column &column = m_columns[Series(thingId, stateTypeId)];
+
+    if (column.isEmpty() || time >= column.last().timestamps.last()) {
+        if (column.isEmpty() || column.last().values.count() >= chunkSize) {
+            expire(column, QDateTime::currentMSecsSinceEpoch() - m_window);
+            column.append(Chunk());
+            column.last().timestamps.reserve(chunkSize);
+            column.last().values.reserve(chunkSize);
+        }
+        column.last().timestamps.append(time);
+        column.last().values.append(value);
+        return;
+    }
+
+    // Out of order values are rare, insert them into the chunk they belong to
+    Column::iterator chunk = std::upper_bound(column.begin(), column.end(), time, [](qint64 time, const Chunk &chunk){
+        return time < chunk.timestamps.last();
+    });
+    if (chunk == column.end()) {
+        --chunk;
+    }
+    int index = std::upper_bound(chunk->timestamps.constBegin(), chunk->timestamps.constEnd(), time) - chunk->timestamps.constBegin();
+    chunk->timestamps.insert(index, time);
+    chunk->values.insert(index, value);
+}
+
+/*! Aggregates the cached values between \a startTime and \a endTime into \a sampleCount equally sized buckets.
+    Empty buckets are omitted. */
+LogEntrySamples LogColumnCache::samples(const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &startTime, const QDateTime &endTime, int sampleCount) const
+{
+    LogEntrySamples samples;
+    QHash<Series, Column>::const_iterator column = m_columns.constFind(Series(thingId, stateTypeId));
+    if (column == m_columns.constEnd()) {
+        return samples;
+    }
+
+    qint64 start = startTime.toMSecsSinceEpoch();
+    qint64 end = endTime.toMSecsSinceEpoch();
+    qint64 bucketSize = qMax<qint64>(1, (end - start + sampleCount - 1) / qMax(1, sampleCount));
+
+    qint64 bucketIndex = -1;
+    Aggregate bucket;
+    scan(*column, start, end, [&](const qint64 *timestamps, const double *values, int count){
+        int i = 0;
+        while (i < count) {
+            qint64 index = (timestamps[i] - start) / bucketSize;
+            int next = std::lower_bound(timestamps + i, timestamps + count, start + (index + 1) * bucketSize) - timestamps;
+            if (index != bucketIndex) {
+                if (bucket.count > 0) {
+                    samples.append(LogEntrySample(QDateTime::fromMSecsSinceEpoch(start + bucketIndex * bucketSize),
+                                                  bucket.count, bucket.min, bucket.max, bucket.sum / bucket.count, bucket.last));
+                }
+                bucketIndex = index;
+                bucket = Aggregate();
+            }
+            bucket.add(values + i, next - i);
+            i = next;
+        }
+    });
+    if (bucket.count > 0) {
+        samples.append(LogEntrySample(QDateTime::fromMSecsSinceEpoch(start + bucketIndex * bucketSize),
+                                      bucket.count, bucket.min, bucket.max, bucket.sum / bucket.count, bucket.last));
+    }
+    return samples;
+}
+
+/*! Removes all values of the thing with \a thingId. */
+void LogColumnCache::removeThing(const ThingId &thingId)
+{
+    for (QHash<Series, Column>::iterator it = m_columns.begin(); it != m_columns.end(); ) {
+        if (it.key().first == thingId) {
+            it = m_columns.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/*! Removes all values. */
+void LogColumnCache::clear()
+{
+    m_columns.clear();
+}
+
+void LogColumnCache::expire(Column &column, qint64 cutoff)
+{
+    while (!column.isEmpty() && column.first().timestamps.last() < cutoff) {
+        column.removeFirst();
+    }
+}
+
+// Calls callback with the contiguous parts of each chunk which lie between start and end
+void LogColumnCache::scan(const Column &column, qint64 start, qint64 end, const std::function<void (const qint64 *, const double *, int)> &callback) const
+{
+    Column::const_iterator chunk = std::lower_bound(column.constBegin(), column.constEnd(), start, [](const Chunk &chunk, qint64 start){
+        return chunk.timestamps.last() < start;
+    });
+    for (; chunk != column.constEnd(); ++chunk) {
+        const qint64 *timestamps = chunk->timestamps.constData();
+        int count = chunk->timestamps.count();
+        int first = std::lower_bound(timestamps, timestamps + count, start) - timestamps;
+        int last = std::lower_bound(timestamps + first, timestamps + count, end) - timestamps;
+        if (last > first) {
+            callback(timestamps + first, chunk->values.constData() + first, last - first);
+        }
+        if (last < count) {
+            break;
+        }
+    }
+}
+
+void LogColumnCache::Aggregate::add(const double *values, int count)
+{
+    double valuesSum, valuesMin, valuesMax;
+    reduce(values, count, valuesSum, valuesMin, valuesMax);
+    if (this->count == 0) {
+        min = valuesMin;
+        max = valuesMax;
+    } else {
+        min = qMin(min, valuesMin);
+        max = qMax(max, valuesMax);
+    }
+    sum += valuesSum;
+    last = values[count - 1];
+    this->count += count;
+}
+
+}
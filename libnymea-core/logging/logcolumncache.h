@@ -0,0 +1,96 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef LOGCOLUMNCACHE_H
+#define LOGCOLUMNCACHE_H
+
+#include "typeutils.h"
+#include "logentrysample.h"
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QVector>
+#include <QDateTime>
+
+#include <functional>
+
+namespace nymeaserver {
+
+class LogColumnCache
+{
+public:
+    explicit LogColumnCache(int window);
+
+    static bool isCachedUnit(Types::Unit unit);
+
+    int window() const;
+    int valueCount() const;
+
+    bool covers(const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &startTime) const;
+
+    void append(const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &timestamp, double value);
+    LogEntrySamples samples(const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &startTime, const QDateTime &endTime, int sampleCount) const;
+
+    void removeThing(const ThingId &thingId);
+    void clear();
+
+private:
+    typedef QPair<QUuid, QUuid> Series;
+
+    // Timestamps and values are kept in separate arrays so ranges can be reduced without touching the timestamps
+    class Chunk {
+    public:
+        QVector<qint64> timestamps;
+        QVector<double> values;
+    };
+    typedef QList<Chunk> Column;
+
+    class Aggregate {
+    public:
+        int count = 0;
+        double sum = 0;
+        double min = 0;
+        double max = 0;
+        double last = 0;
+        void add(const double *values, int count);
+    };
+
+    void expire(Column &column, qint64 cutoff);
+    void scan(const Column &column, qint64 start, qint64 end, const std::function<void(const qint64 *timestamps, const double *values, int count)> &callback) const;
+
+    qint64 m_window;
+    qint64 m_createdAt;
+    QHash<Series, Column> m_columns;
+};
+
+}
+
+#endif // LOGCOLUMNCACHE_H
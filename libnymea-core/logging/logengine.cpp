@@ -33,6 +33,7 @@
 #include "loggingcategories.h"
 #include "logging.h"
 #include "logvaluetool.h"
+#include "logcolumncache.h"
 
 #include "integrations/thingmanager.h"
 
@@ -48,10 +49,16 @@
 #include <QTime>
 #include <QtConcurrent/QtConcurrent>
 
-#define DB_SCHEMA_VERSION 4
+#define DB_SCHEMA_VERSION 6
 
 namespace nymeaserver {
 
+// Selects all columns of an entry, resolving the interned type and thing ids
+static const QString entriesSelect = QStringLiteral("SELECT entries.ROWID AS entryRowId, entries.timestamp, entries.loggingLevel, entries.sourceType, "
+                                                    "types.uuid AS typeUuid, things.uuid AS thingUuid, COALESCE(entries.numericValue, entries.value) AS entryValue, "
+                                                    "entries.loggingEventType, entries.active, entries.errorCode "
+                                                    "FROM entries LEFT JOIN uuids AS types ON types.id = entries.typeId LEFT JOIN uuids AS things ON things.id = entries.thingId");
+
 // IMPORTANT:
 // DatabaseJobs run threaded, however, QSql is *not* threadsafe.
 // It is crucial to *not* access m_db while the job queue is being processed.
@@ -72,38 +79,79 @@ LogEngine::LogEngine(const QString &driver, const QString &dbName, const QString
 
     qCDebug(dcLogEngine) << "Opening logging database" << m_db.databaseName() << "(Max size:" << m_dbMaxSize << "trim size:" << m_trimSize << ")";
 
-    if (!m_db.isValid()) {
-        qCWarning(dcLogEngine) << "Database not valid:" << m_db.lastError().driverText() << m_db.lastError().databaseText();
-        rotate(m_db.databaseName());
-    }
+    m_batchTimer.setSingleShot(true);
+    connect(&m_batchTimer, &QTimer::timeout, this, &LogEngine::onBatchWindowElapsed);
+
+    m_coalesceTimer.setSingleShot(true);
+    connect(&m_coalesceTimer, &QTimer::timeout, this, [this](){
+        flushCoalescedEntries();
+    });
+
+    connect(&m_jobWatcher, SIGNAL(finished()), this, SLOT(handleJobFinished()));
 
-    if (!initDB(username, password)) {
-        qCWarning(dcLogEngine()) << "Error initializing database. Trying to correct it.";
-        if (QFileInfo(m_db.databaseName()).exists()) {
+    // Opening and migrating a large database can take minutes. Do it in the background so the startup
+    // doesn't depend on the database size. Entries logged in the meantime are kept in m_initBuffer.
+    m_initializing = true;
+    connect(&m_initWatcher, &QFutureWatcher<bool>::finished, this, &LogEngine::handleInitFinished);
+    QFuture<bool> future = QtConcurrent::run([this, username, password](){
+        if (!m_db.isValid()) {
+            qCWarning(dcLogEngine) << "Database not valid:" << m_db.lastError().driverText() << m_db.lastError().databaseText();
+            rotate(m_db.databaseName());
+        }
+
+        if (!initDB(username, password)) {
+            qCWarning(dcLogEngine()) << "Error initializing database. Trying to correct it.";
+            if (!QFileInfo(m_db.databaseName()).exists()) {
+                return false;
+            }
             rotate(m_db.databaseName());
             if (!initDB(username, password)) {
                 qCWarning(dcLogEngine()) << "Error fixing log database. Giving up. Logs can't be stored.";
-                return;
+                return false;
             }
         }
-    }
-
-    connect(&m_jobWatcher, SIGNAL(finished()), this, SLOT(handleJobFinished()));
-    checkDBSize();
+        return true;
+    });
+    m_initWatcher.setFuture(future);
 }
 
 LogEngine::~LogEngine()
 {
+    if (m_initializing) {
+        qCDebug(dcLogEngine()) << "Waiting for the log database initialization to finish...";
+        m_initWatcher.waitForFinished();
+        handleInitFinished();
+    }
+
+    // Don't hold back any coalesced values or pending batch while shutting down
+    m_coalesceTimer.stop();
+    flushCoalescedEntries(true);
+    m_batchInterval = 0;
+    m_batchTimer.stop();
+    processQueue();
+
     // Process the job queue before allowing to shut down
-    while (m_currentJob) {
+    while (!m_currentJobs.isEmpty() || !m_runningReadJobs.isEmpty()) {
         qCDebug(dcLogEngine()) << "Waiting for job to finish... (" << m_jobQueue.count() << "jobs left in queue)";
         m_jobWatcher.waitForFinished();
         // Make sure that the job queue is processes
         // We can't call processQueue ourselves because thread synchronisation is done via queued connections
         qApp->processEvents();
     }
+    stopReadConnections();
+    stopStateStorage();
+
     qCDebug(dcLogEngine()) << "Closing Database";
     m_db.close();
+
+    delete m_columnCache;
+}
+
+/*! Returns true while the log database is being opened or migrated in the background. Log entries
+    are buffered in memory during that time and fetch requests are answered once it's done. */
+bool LogEngine::initializing() const
+{
+    return m_initializing;
 }
 
 void LogEngine::setThingManager(ThingManager *thingManager)
@@ -115,60 +163,154 @@ void LogEngine::setThingManager(ThingManager *thingManager)
 
 LogEntriesFetchJob *LogEngine::fetchLogEntries(const LogFilter &filter)
 {
-    QList<LogEntry> results;
-
     QString limitString;
     if (filter.limit() >= 0) {
         limitString.append(QString("LIMIT %1 ").arg(filter.limit()));
     }
-    if (filter.offset() > 0) {
+    // Offset based paging is only used if there is no cursor
+    if (filter.offset() > 0 && !filter.hasCursor()) {
         limitString.append(QString("OFFSET %1").arg(QString::number(filter.offset())));
     }
 
+    QStringList predicates;
+    if (!filter.isEmpty()) {
+        predicates.append(QString("(%1)").arg(filter.queryString()));
+    }
+    if (filter.hasCursor()) {
+        // Keyset pagination: resume right after the last entry of the previous page
+        predicates.append(QString("(timestamp < %1 OR (timestamp = %1 AND entries.ROWID < %2))").arg(filter.cursorTimestamp()).arg(filter.cursorRowId()));
+    }
+
     QString queryString;
-    if (filter.isEmpty()) {
-        queryString = QString("SELECT * FROM entries ORDER BY timestamp DESC %1;").arg(limitString);
+    if (predicates.isEmpty()) {
+        queryString = QString("%1 ORDER BY timestamp DESC, entries.ROWID DESC %2;").arg(entriesSelect).arg(limitString);
     } else {
-        queryString = QString("SELECT * FROM entries WHERE %1 ORDER BY timestamp DESC %2;").arg(filter.queryString()).arg(limitString);
+        queryString = QString("%1 WHERE %2 ORDER BY timestamp DESC, entries.ROWID DESC %3;").arg(entriesSelect).arg(predicates.join(" AND ")).arg(limitString);
     }
 
-    DatabaseJob *job = new DatabaseJob(m_db, queryString, filter.values());
+    DatabaseJob *job = new DatabaseJob(m_db, queryString, filter.bindValues());
     LogEntriesFetchJob *fetchJob = new LogEntriesFetchJob(this);
 
-    connect(job, &DatabaseJob::finished, this, [job, fetchJob](){
+    // Convert the rows straight into LogEntries in the worker thread instead of collecting QSqlRecords first.
+    // The fetch job isn't touched by anyone else until the database job has finished.
+    job->m_rowHandler = [fetchJob](const QSqlQuery &query){
+        QSqlRecord record = query.record();
+        LogEntry entry(
+                    QDateTime::fromMSecsSinceEpoch(query.value(record.indexOf("timestamp")).toLongLong()),
+                    static_cast<Logging::LoggingLevel>(query.value(record.indexOf("loggingLevel")).toInt()),
+                    static_cast<Logging::LoggingSource>(query.value(record.indexOf("sourceType")).toInt()),
+                    query.value(record.indexOf("errorCode")).toInt());
+        entry.setTypeId(query.value(record.indexOf("typeUuid")).toUuid());
+        entry.setThingId(query.value(record.indexOf("thingUuid")).toUuid());
+        entry.setValue(query.value(record.indexOf("entryValue")));
+        entry.setEventType(static_cast<Logging::LoggingEventType>(query.value(record.indexOf("loggingEventType")).toInt()));
+        entry.setActive(query.value(record.indexOf("active")).toBool());
+
+        fetchJob->m_results.append(entry);
+        fetchJob->m_lastTimestamp = entry.timestamp().toMSecsSinceEpoch();
+        fetchJob->m_lastRowId = query.value(record.indexOf("entryRowId")).toLongLong();
+    };
+
+    connect(job, &DatabaseJob::finished, this, [job, fetchJob, filter](){
         fetchJob->deleteLater();
         if (job->error().isValid()) {
             qCWarning(dcLogEngine) << "Error fetching log entries. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
+            fetchJob->m_results.clear();
+            fetchJob->finished();
+            return;
+        }
+
+        // Only a full page may be followed by another one
+        fetchJob->m_hasMore = filter.limit() > 0 && fetchJob->m_results.count() == filter.limit();
+
+        qCDebug(dcLogEngine) << "Fetched" << fetchJob->results().count() << "entries for db query:" << job->executedQuery();
+        fetchJob->finished();
+    });
+
+    enqueReadJob(job);
+
+    return fetchJob;
+}
+
+LogEntrySamplesFetchJob *LogEngine::fetchLogEntrySamples(const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &startTime, const QDateTime &endTime, int sampleCount)
+{
+    if (m_columnCache && m_columnCache->covers(thingId, stateTypeId, startTime)) {
+        LogEntrySamplesFetchJob *fetchJob = new LogEntrySamplesFetchJob(this);
+        fetchJob->m_results = m_columnCache->samples(thingId, stateTypeId, startTime, endTime, sampleCount);
+        // Callers connect to finished() after this returns
+        QTimer::singleShot(0, fetchJob, [fetchJob](){
+            fetchJob->finished();
+            fetchJob->deleteLater();
+        });
+        return fetchJob;
+    }
+
+    if (m_stateStorage) {
+        // Runs in the thread of the backend, after all values appended so far. See handleStateSamplesFetched().
+        LogEntrySamplesFetchJob *fetchJob = new LogEntrySamplesFetchJob(this);
+        int requestId = m_nextStateSamplesRequestId++;
+        m_stateSamplesRequests.insert(requestId, fetchJob);
+        QMetaObject::invokeMethod(m_stateStorage, "requestStateSamples", Qt::QueuedConnection,
+                                  Q_ARG(int, requestId), Q_ARG(ThingId, thingId), Q_ARG(StateTypeId, stateTypeId),
+                                  Q_ARG(QDateTime, startTime), Q_ARG(QDateTime, endTime), Q_ARG(int, sampleCount));
+        return fetchJob;
+    }
+
+    qint64 start = startTime.toMSecsSinceEpoch();
+    qint64 end = endTime.toMSecsSinceEpoch();
+    qint64 bucketSize = qMax<qint64>(1, (end - start + sampleCount - 1) / qMax(1, sampleCount));
+
+    // Aggregate in SQL so the result size only depends on the number of buckets. The last value
+    // of each bucket is looked up through the (thingId, typeId, timestamp) index.
+    QString entriesFilter = QString("thingId = %1 AND typeId = %2 AND sourceType = '%3'")
+            .arg(LogFilter::uuidIdQuery(thingId))
+            .arg(LogFilter::uuidIdQuery(stateTypeId))
+            .arg(Logging::LoggingSourceStates);
+    QString queryString = QString("SELECT buckets.bucket, buckets.count, buckets.minValue, buckets.maxValue, buckets.avgValue, "
+                                  "(SELECT COALESCE(numericValue, value) FROM entries WHERE %1 AND timestamp = buckets.lastTimestamp ORDER BY ROWID DESC LIMIT 1) AS lastValue "
+                                  "FROM (SELECT (timestamp - %2) / %3 AS bucket, COUNT(*) AS count, "
+                                  "MIN(numericValue) AS minValue, MAX(numericValue) AS maxValue, AVG(numericValue) AS avgValue, "
+                                  "MAX(timestamp) AS lastTimestamp "
+                                  "FROM entries WHERE %1 AND timestamp >= %2 AND timestamp < %4 GROUP BY bucket) AS buckets "
+                                  "ORDER BY buckets.bucket ASC;")
+            .arg(entriesFilter)
+            .arg(start)
+            .arg(bucketSize)
+            .arg(end);
+
+    DatabaseJob *job = new DatabaseJob(m_db, queryString);
+    LogEntrySamplesFetchJob *fetchJob = new LogEntrySamplesFetchJob(this);
+
+    connect(job, &DatabaseJob::finished, this, [job, fetchJob, start, bucketSize](){
+        fetchJob->deleteLater();
+        if (job->error().isValid()) {
+            qCWarning(dcLogEngine) << "Error fetching log entry samples. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
             fetchJob->finished();
             return;
         }
 
         foreach (const QSqlRecord &result, job->results()) {
-            LogEntry entry(
-                        QDateTime::fromMSecsSinceEpoch(result.value("timestamp").toLongLong()),
-                        static_cast<Logging::LoggingLevel>(result.value("loggingLevel").toInt()),
-                        static_cast<Logging::LoggingSource>(result.value("sourceType").toInt()),
-                        result.value("errorCode").toInt());
-            entry.setTypeId(result.value("typeId").toUuid());
-            entry.setThingId(ThingId(result.value("thingId").toString()));
-            entry.setValue(result.value("value").toString());
-            entry.setEventType(static_cast<Logging::LoggingEventType>(result.value("loggingEventType").toInt()));
-            entry.setActive(result.value("active").toBool());
-
-            fetchJob->m_results.append(entry);
+            QDateTime timestamp = QDateTime::fromMSecsSinceEpoch(start + result.value("bucket").toLongLong() * bucketSize);
+            LogEntrySample sample(timestamp,
+                                  result.value("count").toInt(),
+                                  result.value("minValue").toDouble(),
+                                  result.value("maxValue").toDouble(),
+                                  result.value("avgValue").toDouble(),
+                                  result.value("lastValue"));
+            fetchJob->m_results.append(sample);
         }
-        qCDebug(dcLogEngine) << "Fetched" << fetchJob->results().count() << "entries for db query:" << job->executedQuery();
+        qCDebug(dcLogEngine) << "Fetched" << fetchJob->m_results.count() << "samples for db query:" << job->executedQuery();
         fetchJob->finished();
     });
 
-    enqueJob(job, true);
+    enqueReadJob(job);
 
     return fetchJob;
 }
 
 ThingsFetchJob *LogEngine::fetchThings()
 {
-    QString queryString = QString("SELECT thingId FROM entries WHERE thingId != \"%1\" GROUP BY thingId;").arg(QUuid().toString());
+    QString queryString = QString("SELECT uuid FROM uuids WHERE id IN (SELECT DISTINCT thingId FROM entries) AND uuid != '%1';").arg(QUuid().toString());
 
     DatabaseJob *job = new DatabaseJob(m_db, queryString);
     ThingsFetchJob *fetchJob = new ThingsFetchJob(this);
@@ -181,17 +323,17 @@ ThingsFetchJob *LogEngine::fetchThings()
         }
 
         foreach (const QSqlRecord &result, job->results()) {
-            fetchJob->m_results.append(ThingId(result.value("thingId").toUuid()));
+            fetchJob->m_results.append(ThingId(result.value("uuid").toUuid()));
         }
         fetchJob->finished();
     });
-    enqueJob(job, true);
+    enqueReadJob(job);
     return fetchJob;
 }
 
 bool LogEngine::jobsRunning() const
 {
-    return !m_jobQueue.isEmpty() || m_currentJob;
+    return !m_jobQueue.isEmpty() || !m_currentJobs.isEmpty() || !m_runningReadJobs.isEmpty();
 }
 
 void LogEngine::setMaxLogEntries(int maxLogEntries, int trimSize)
@@ -201,10 +343,160 @@ void LogEngine::setMaxLogEntries(int maxLogEntries, int trimSize)
     trim();
 }
 
+void LogEngine::setBatchingParameters(int maxBatchSize, int batchInterval)
+{
+    m_maxBatchSize = qMax(1, maxBatchSize);
+    m_batchInterval = qMax(0, batchInterval);
+    qCDebug(dcLogEngine()) << "Log insert batching: max batch size" << m_maxBatchSize << "batch interval" << m_batchInterval << "ms";
+    if (m_batchInterval == 0 && m_batchTimer.isActive()) {
+        m_batchTimer.stop();
+        processQueue();
+    }
+}
+
+void LogEngine::setReadConnections(int count)
+{
+    m_readConnectionCount = count;
+    if (m_initializing || count == m_readConnections.count()) {
+        return;
+    }
+
+    // Reads still running on the old connections finish there, new ones go to the new connections right away
+    for (int i = 0; i < m_readConnections.count(); i++) {
+        LogReadConnection *connection = m_readConnections.at(i);
+        if (m_readConnectionLoad.value(connection) > 0) {
+            m_retiringReadConnections.insert(connection, m_readThreads.at(i));
+        } else {
+            stopReadThread(m_readThreads.at(i));
+            m_readConnectionLoad.remove(connection);
+        }
+    }
+    m_readThreads.clear();
+    m_readConnections.clear();
+    startReadConnections(count);
+}
+
+void LogEngine::setStateRateLimit(const ThingId &thingId, const StateTypeId &stateTypeId, int minInterval, double deadband)
+{
+    RateLimit limit;
+    limit.minInterval = qMax(0, minInterval);
+    limit.deadband = qMax(0.0, deadband);
+    bool enabled = limit.minInterval > 0 || limit.deadband > 0;
+
+    if (thingId.isNull()) {
+        if (enabled) {
+            m_stateTypeRateLimits.insert(stateTypeId, limit);
+        } else {
+            m_stateTypeRateLimits.remove(stateTypeId);
+        }
+    } else {
+        if (enabled) {
+            m_sourceRateLimits.insert(LogSource(thingId, stateTypeId), limit);
+        } else {
+            m_sourceRateLimits.remove(LogSource(thingId, stateTypeId));
+        }
+    }
+    qCDebug(dcLogEngine()) << "State rate limit for thing" << thingId << "state" << stateTypeId << "set to" << limit.minInterval << "ms, deadband" << limit.deadband;
+}
+
+void LogEngine::setDefaultStateRateLimit(int minInterval, double deadband)
+{
+    m_defaultRateLimit.minInterval = qMax(0, minInterval);
+    m_defaultRateLimit.deadband = qMax(0.0, deadband);
+}
+
+/*! Installs \a backend to keep the numeric state history in addition to the log database.
+    The LogEngine takes ownership of the backend and, once initialized, moves it into a thread of
+    its own. Values are appended and samples are fetched there through queued calls, like the
+    jobs of the read connections. Passing nullptr serves the history from the log database again. */
+void LogEngine::setStateStorageBackend(LogStorageBackend *backend)
+{
+    stopStateStorage();
+    if (!backend) {
+        return;
+    }
+    if (!backend->init()) {
+        qCWarning(dcLogEngine()) << "Unable to initialize" << backend->name() << "state storage. Using the log database only.";
+        delete backend;
+        return;
+    }
+    qCDebug(dcLogEngine()) << "Using" << backend->name() << "state storage backend";
+
+    qRegisterMetaType<ThingId>();
+    qRegisterMetaType<StateTypeId>();
+    qRegisterMetaType<LogEntrySamples>();
+
+    m_stateStorageThread = new QThread();
+    m_stateStorageThread->setObjectName("LogStateStorage");
+    backend->setParent(nullptr);
+    backend->moveToThread(m_stateStorageThread);
+    // Quits the thread once everything queued before the deleteLater() in stopStateStorage() is done
+    connect(backend, &QObject::destroyed, m_stateStorageThread, &QThread::quit, Qt::DirectConnection);
+    connect(backend, &LogStorageBackend::stateSamplesFetched, this, &LogEngine::handleStateSamplesFetched, Qt::QueuedConnection);
+    m_stateStorageThread->start();
+    m_stateStorage = backend;
+}
+
+LogStorageBackend *LogEngine::stateStorageBackend() const
+{
+    return m_stateStorage;
+}
+
+/*! Keeps the values of power and energy states logged within the last \a window seconds in a \l{LogColumnCache}.
+    Samples of ranges within the window are computed from memory. A \a window of 0 disables the cache. */
+void LogEngine::setColumnCacheWindow(int window)
+{
+    delete m_columnCache;
+    m_columnCache = nullptr;
+    m_columnCacheSources.clear();
+    if (window > 0) {
+        m_columnCache = new LogColumnCache(window);
+    }
+}
+
+LogColumnCache *LogEngine::columnCache() const
+{
+    return m_columnCache;
+}
+
+/*! Keeps the last \a size logged values of each state in memory, to be returned by stateHistory(). A \a size of 0
+    disables the history. */
+void LogEngine::setStateHistorySize(int size)
+{
+    m_stateHistorySize = qMax(0, size);
+    m_stateHistories.clear();
+}
+
+/*! Returns the last logged values of the state with the given \a stateTypeId of the thing with the given \a thingId,
+    oldest first. The history is kept in memory and doesn't query the database. */
+QList<QPair<QDateTime, QVariant>> LogEngine::stateHistory(const ThingId &thingId, const StateTypeId &stateTypeId) const
+{
+    QList<QPair<QDateTime, QVariant>> history;
+    QHash<LogSource, StateHistory>::const_iterator it = m_stateHistories.constFind(LogSource(thingId, stateTypeId));
+    if (it == m_stateHistories.constEnd()) {
+        return history;
+    }
+    int count = it->entries.count();
+    history.reserve(count);
+    for (int i = 0; i < count; i++) {
+        const QPair<qint64, QVariant> &entry = it->entries.at((it->next + i) % count);
+        history.append(qMakePair(QDateTime::fromMSecsSinceEpoch(entry.first), entry.second));
+    }
+    return history;
+}
+
 void LogEngine::clearDatabase()
 {
     qCWarning(dcLogEngine) << "Clearing logging database.";
 
+    if (m_stateStorage) {
+        QMetaObject::invokeMethod(m_stateStorage, "clear", Qt::QueuedConnection);
+    }
+    if (m_columnCache) {
+        m_columnCache->clear();
+    }
+    m_stateHistories.clear();
+
     QString queryDeleteString = QString("DELETE FROM entries;");
 
     DatabaseJob *job = new DatabaseJob(m_db, queryDeleteString);
@@ -260,7 +552,12 @@ void LogEngine::logEvent(const Event &event)
     } else {
         entry.setValue(valueList);
     }
-    appendLogEntry(entry);
+
+    if (sourceType == Logging::LoggingSourceStates) {
+        ingestStateEntry(entry);
+    } else {
+        appendLogEntry(entry);
+    }
 }
 
 void LogEngine::logAction(const Action &action, Thing::ThingError status)
@@ -343,11 +640,47 @@ void LogEngine::logRuleExitActionsExecuted(const Rule &rule)
     appendLogEntry(entry);
 }
 
+/*! Writes the \a entry received from the primary of a hot standby setup. The primary applied the rate limits already. */
+void LogEngine::appendReplicatedEntry(const LogEntry &entry)
+{
+    appendLogEntry(entry);
+}
+
 void LogEngine::removeThingLogs(const ThingId &thingId)
 {
     qCDebug(dcLogEngine) << "Deleting log entries from device" << thingId.toString();
 
-    QString queryDeleteString = QString("DELETE FROM entries WHERE thingId = '%1';").arg(thingId.toString());
+    if (m_stateStorage) {
+        QMetaObject::invokeMethod(m_stateStorage, "removeThing", Qt::QueuedConnection, Q_ARG(ThingId, thingId));
+    }
+    if (m_columnCache) {
+        m_columnCache->removeThing(thingId);
+    }
+    for (QHash<LogSource, bool>::iterator it = m_columnCacheSources.begin(); it != m_columnCacheSources.end(); ) {
+        if (it.key().first == thingId) {
+            it = m_columnCacheSources.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Don't write back any coalesced value of the removed thing
+    for (QHash<LogSource, SourceState>::iterator it = m_sourceStates.begin(); it != m_sourceStates.end(); ) {
+        if (it.key().first == thingId) {
+            it = m_sourceStates.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (QHash<LogSource, StateHistory>::iterator it = m_stateHistories.begin(); it != m_stateHistories.end(); ) {
+        if (it.key().first == thingId) {
+            it = m_stateHistories.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    QString queryDeleteString = QString("DELETE FROM entries WHERE thingId = %1;").arg(LogFilter::uuidIdQuery(thingId));
 
     DatabaseJob *job = new DatabaseJob(m_db, queryDeleteString);
     connect(job, &DatabaseJob::finished, this, [this, job, thingId](){
@@ -367,7 +700,7 @@ void LogEngine::removeRuleLogs(const RuleId &ruleId)
 {
     qCDebug(dcLogEngine) << "Deleting log entries from rule" << ruleId.toString();
 
-    QString queryDeleteString = QString("DELETE FROM entries WHERE typeId = '%1';").arg(ruleId.toString());
+    QString queryDeleteString = QString("DELETE FROM entries WHERE typeId = %1;").arg(LogFilter::uuidIdQuery(ruleId));
 
     DatabaseJob *job = new DatabaseJob(m_db, queryDeleteString);
 
@@ -385,48 +718,222 @@ void LogEngine::removeRuleLogs(const RuleId &ruleId)
     enqueJob(job);
 }
 
-void LogEngine::appendLogEntry(const LogEntry &entry)
+DatabaseJob *LogEngine::createInsertJob(const LogEntry &entry)
 {
-    qCDebug(dcLogEngine()) << "Adding log entry:" << entry;
-    QString queryString = QString("INSERT INTO entries (timestamp, loggingEventType, loggingLevel, sourceType, typeId, thingId, value, active, errorCode) values (?, ?, ?, ?, ?, ?, ?, ?, ?);");
+    QString queryString = QString("INSERT INTO entries (timestamp, loggingEventType, loggingLevel, sourceType, typeId, thingId, value, numericValue, active, errorCode) values (?, ?, ?, ?, ?, ?, ?, ?, ?, ?);");
     QVariantList bindValues;
     bindValues.append(entry.timestamp().toMSecsSinceEpoch());
     bindValues.append(entry.eventType());
     bindValues.append(entry.level());
     bindValues.append(entry.source());
-    bindValues.append(entry.typeId().toString());
-    bindValues.append(entry.thingId().toString());
-    bindValues.append(LogValueTool::convertVariantToString(entry.value()));
+    bindValues.append(internUuid(entry.typeId()));
+    bindValues.append(internUuid(entry.thingId()));
+    if (LogValueTool::isNumeric(entry.value())) {
+        bindValues.append(QVariant(QVariant::String));
+        bindValues.append(entry.value());
+    } else {
+        bindValues.append(LogValueTool::convertVariantToString(entry.value()));
+        bindValues.append(QVariant(QVariant::Double));
+    }
     bindValues.append(entry.active());
     bindValues.append(entry.errorCode());
 
-    DatabaseJob *job = new DatabaseJob(m_db, queryString, bindValues);
+    return new DatabaseJob(m_db, queryString, bindValues, true);
+}
+
+int LogEngine::internUuid(const QUuid &uuid)
+{
+    if (m_uuidIds.contains(uuid)) {
+        return m_uuidIds.value(uuid);
+    }
+
+    // We're the only writer, so ids can be assigned right away. The insert is queued before any entry using it.
+    int id = m_nextUuidId++;
+    m_uuidIds.insert(uuid, id);
+    m_pendingUuidIds.insert(id);
+    DatabaseJob *job = new DatabaseJob(m_db, "INSERT INTO uuids (id, uuid) VALUES (?, ?);", QVariantList() << id << uuid.toString());
+    connect(job, &DatabaseJob::finished, this, [this, job, id, uuid](){
+        m_pendingUuidIds.remove(id);
+        if (job->error().type() != QSqlError::NoError) {
+            qCWarning(dcLogEngine) << "Error storing uuid" << uuid.toString() << "in log database. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
+        }
+    });
+    enqueJob(job);
+    return id;
+}
+
+/* After recovering from a malformed database, the jobs still in the queue refer to uuid ids of the old
+   one. The given ids are stored again in the new database, except for the ones still queued for insertion. */
+void LogEngine::restoreUuids(const QHash<QUuid, int> &uuidIds, int nextUuidId)
+{
+    m_db.transaction();
+    QSqlQuery query(m_db);
+    query.prepare("INSERT INTO uuids (id, uuid) VALUES (?, ?);");
+    for (QHash<QUuid, int>::const_iterator it = uuidIds.constBegin(); it != uuidIds.constEnd(); ++it) {
+        if (m_uuidIds.contains(it.key())) {
+            continue;
+        }
+        m_uuidIds.insert(it.key(), it.value());
+        if (m_pendingUuidIds.contains(it.value())) {
+            continue;
+        }
+        query.addBindValue(it.value());
+        query.addBindValue(it.key().toString());
+        if (!query.exec()) {
+            qCWarning(dcLogEngine) << "Error restoring uuid" << it.key().toString() << "in log database. Driver error:" << query.lastError().driverText() << "Database error:" << query.lastError().databaseText();
+        }
+    }
+    m_db.commit();
+    m_nextUuidId = qMax(m_nextUuidId, nextUuidId);
+}
+
+LogEngine::RateLimit LogEngine::rateLimit(const LogSource &source) const
+{
+    if (m_sourceRateLimits.contains(source)) {
+        return m_sourceRateLimits.value(source);
+    }
+    if (m_stateTypeRateLimits.contains(source.second)) {
+        return m_stateTypeRateLimits.value(source.second);
+    }
+    return m_defaultRateLimit;
+}
+
+void LogEngine::ingestStateEntry(const LogEntry &entry)
+{
+    LogSource source(entry.thingId(), entry.typeId());
+    RateLimit limit = rateLimit(source);
+    if (limit.minInterval <= 0 && limit.deadband <= 0) {
+        appendLogEntry(entry);
+        return;
+    }
+
+    SourceState &state = m_sourceStates[source];
+
+    if (limit.deadband > 0 && state.lastValue.isValid()
+            && LogValueTool::isNumeric(entry.value()) && LogValueTool::isNumeric(state.lastValue)
+            && qAbs(entry.value().toDouble() - state.lastValue.toDouble()) < limit.deadband) {
+        qCDebug(dcLogEngine()) << "Dropping state change within deadband:" << entry;
+        return;
+    }
+    state.lastValue = entry.value();
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (limit.minInterval > 0 && state.lastWritten > 0 && now - state.lastWritten < limit.minInterval) {
+        // Keep only the most recent value, it will be written once the interval elapsed
+        if (!state.pending) {
+            state.pending = true;
+            state.pendingDue = state.lastWritten + limit.minInterval;
+            if (!m_coalesceTimer.isActive() || m_coalesceTimer.remainingTime() > state.pendingDue - now) {
+                m_coalesceTimer.start(state.pendingDue - now);
+            }
+        }
+        state.pendingEntry = entry;
+        return;
+    }
+
+    state.pending = false;
+    state.pendingEntry = LogEntry();
+    state.lastWritten = now;
+    appendLogEntry(entry);
+}
+
+void LogEngine::flushCoalescedEntries(bool all)
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 nextDue = 0;
+    QList<LogEntry> dueEntries;
+    for (QHash<LogSource, SourceState>::iterator it = m_sourceStates.begin(); it != m_sourceStates.end(); ++it) {
+        if (!it->pending) {
+            continue;
+        }
+        if (all || it->pendingDue <= now) {
+            dueEntries.append(it->pendingEntry);
+            it->pending = false;
+            it->pendingEntry = LogEntry();
+            it->lastWritten = now;
+        } else if (nextDue == 0 || it->pendingDue < nextDue) {
+            nextDue = it->pendingDue;
+        }
+    }
+
+    if (nextDue > 0) {
+        m_coalesceTimer.start(nextDue - now);
+    }
+
+    foreach (const LogEntry &entry, dueEntries) {
+        appendLogEntry(entry);
+    }
+}
+
+void LogEngine::appendLogEntry(const LogEntry &entry)
+{
+    if (m_stateHistorySize > 0 && entry.source() == Logging::LoggingSourceStates) {
+        appendStateHistory(entry);
+    }
+
+    if (m_initializing) {
+        // The uuid ids are only known once the database is loaded, keep the most recent entries until then
+        if (m_initBuffer.count() >= m_maxQueueLength) {
+            m_initBuffer.removeFirst();
+            m_initBufferOverflow++;
+        }
+        m_initBuffer.append(entry);
+        return;
+    }
+
+    writeLogEntry(entry);
+}
+
+// Writes an entry to the database and the state storages. The state history has already been updated when the
+// entry was appended, so entries buffered during the initialization are replayed through here.
+void LogEngine::writeLogEntry(const LogEntry &entry)
+{
+    qCDebug(dcLogEngine()) << "Adding log entry:" << entry;
+
+    DatabaseJob *job = createInsertJob(entry);
+    LogSource source(entry.thingId(), entry.typeId());
+
+    if (m_stateStorage && entry.source() == Logging::LoggingSourceStates && LogValueTool::isNumeric(entry.value())) {
+        QMetaObject::invokeMethod(m_stateStorage, "appendStateValue", Qt::QueuedConnection,
+                                  Q_ARG(ThingId, entry.thingId()), Q_ARG(StateTypeId, StateTypeId(entry.typeId())),
+                                  Q_ARG(QDateTime, entry.timestamp()), Q_ARG(double, entry.value().toDouble()));
+    }
+    if (m_columnCache && entry.source() == Logging::LoggingSourceStates && LogValueTool::isNumeric(entry.value())) {
+        appendColumnCache(entry);
+    }
 
     // Check for log flooding. If we are exceeding the queue we'll start flagging log events of a certain type.
     // If we'll get more log events of the same type while the queue is still exceededd, we'll discard the old
     // ones and queue up the new one instead. The most recent one is more important (i.e. we don't want to lose
     // the last event in a series).
-    if (m_jobQueue.count() > m_maxQueueLength) {
+    if (m_jobQueue.count() - m_discardedJobs > m_maxQueueLength) {
         if (!m_initialized) {
             qCDebug(dcLogEngine()) << "Log DB not initialized and queue is full. Discarding log entry.";
             delete job;
             return;
         }
         qCDebug(dcLogEngine()) << "An excessive amount of data is being logged. (" << m_jobQueue.length() << "jobs in the queue)";
-        if (m_flaggedJobs.contains(entry.typeId().toString() + entry.thingId().toString())) {
-            if (m_flaggedJobs.value(entry.typeId().toString() + entry.thingId().toString()).count() > 10) {
-                qCWarning(dcLogEngine()) << "Discarding log entry because of excessive log flooding.";
-                DatabaseJob *job = m_flaggedJobs[entry.typeId().toString() + entry.thingId().toString()].takeFirst();
-                int jobIdx = m_jobQueue.indexOf(job);
-                m_jobQueue.takeAt(jobIdx)->deleteLater();
-            }
+        QList<DatabaseJob*> &flaggedJobs = m_flaggedJobs[source];
+        if (flaggedJobs.count() > 10) {
+            qCWarning(dcLogEngine()) << "Discarding log entry because of excessive log flooding.";
+            // The job stays in the queue until it reaches the head, processQueue() drops it there.
+            // If it's already part of the batch being written, it's too late to discard it.
+            DatabaseJob *discardedJob = flaggedJobs.takeFirst();
+            discardedJob->m_discarded = true;
+            m_discardedJobs++;
         }
-        m_flaggedJobs[entry.typeId().toString() + entry.thingId().toString()].append(job);
+        flaggedJobs.append(job);
     }
 
-    connect(job, &DatabaseJob::finished, this, [this, job, entry](){
+    connect(job, &DatabaseJob::finished, this, [this, job, entry, source](){
 
-        m_flaggedJobs[entry.typeId().toString() + entry.thingId().toString()].removeAll(job);
+        QHash<LogSource, QList<DatabaseJob*>>::iterator flagged = m_flaggedJobs.find(source);
+        if (flagged != m_flaggedJobs.end()) {
+            flagged->removeOne(job);
+            if (flagged->isEmpty()) {
+                m_flaggedJobs.erase(flagged);
+            }
+        }
 
         if (job->error().type() != QSqlError::NoError) {
             qCWarning(dcLogEngine) << "Error writing log entry. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
@@ -445,6 +952,39 @@ void LogEngine::appendLogEntry(const LogEntry &entry)
     enqueJob(job);
 }
 
+void LogEngine::appendStateHistory(const LogEntry &entry)
+{
+    StateHistory &history = m_stateHistories[LogSource(entry.thingId(), entry.typeId())];
+    QPair<qint64, QVariant> value(entry.timestamp().toMSecsSinceEpoch(), entry.value());
+    if (history.entries.count() < m_stateHistorySize) {
+        history.entries.append(value);
+        return;
+    }
+    history.entries[history.next] = value;
+    history.next = (history.next + 1) % history.entries.count();
+}
+
+void LogEngine::appendColumnCache(const LogEntry &entry)
+{
+    LogSource source(entry.thingId(), entry.typeId());
+    QHash<LogSource, bool>::const_iterator it = m_columnCacheSources.constFind(source);
+    bool cached = false;
+    if (it != m_columnCacheSources.constEnd()) {
+        cached = it.value();
+    } else {
+        // Things are not known before they are loaded, look them up again with the next value
+        Thing *thing = m_thingManager ? m_thingManager->findConfiguredThing(entry.thingId()) : nullptr;
+        if (!thing) {
+            return;
+        }
+        cached = LogColumnCache::isCachedUnit(thing->thingClass().getStateType(entry.typeId()).unit());
+        m_columnCacheSources.insert(source, cached);
+    }
+    if (cached) {
+        m_columnCache->append(entry.thingId(), entry.typeId(), entry.timestamp(), entry.value().toDouble());
+    }
+}
+
 void LogEngine::checkDBSize()
 {
     DatabaseJob *job = new DatabaseJob(m_db, "SELECT COUNT(*) FROM entries;");
@@ -465,24 +1005,61 @@ void LogEngine::trim()
         // No trimming required
         return;
     }
-    QDateTime startTime = QDateTime::currentDateTime();
 
-    QString queryDeleteString = QString("DELETE FROM entries WHERE ROWID IN (SELECT ROWID FROM entries ORDER BY timestamp DESC LIMIT -1 OFFSET %1);").arg(QString::number(m_dbMaxSize - m_trimSize));
+    if (m_trimRunning) {
+        // Housekeeping is already in progress and will continue until the target size is reached
+        return;
+    }
+
+    m_trimRunning = true;
+    m_trimDeletedCount = 0;
+    m_trimStartTime = QDateTime::currentDateTime();
+
+    qCDebug(dcLogEngine()) << "Scheduling housekeeping job.";
+    trimChunk(qMax(0, m_dbMaxSize - m_trimSize));
+}
+
+void LogEngine::trimChunk(int targetSize)
+{
+    // Delete the oldest entries in bounded chunks. Walking the timestamp index from its lower end
+    // makes each chunk cost proportional to the rows removed instead of sorting the whole table.
+    // Chunks are enqueued as regular jobs so fetches and inserts get processed in between.
+    static const int maxChunkSize = 500;
+    int chunkSize = qMin(m_entryCount - targetSize, maxChunkSize);
+    if (chunkSize <= 0) {
+        qCDebug(dcLogEngine()) << "Ran housekeeping on log database in" << m_trimStartTime.msecsTo(QDateTime::currentDateTime()) << "ms. (Deleted" << m_trimDeletedCount << "entries)";
+        m_trimRunning = false;
+        emit logDatabaseUpdated();
+        return;
+    }
+
+    QString queryDeleteString = QString("DELETE FROM entries WHERE ROWID IN (SELECT ROWID FROM entries ORDER BY timestamp ASC LIMIT %1);").arg(chunkSize);
 
     DatabaseJob *deleteJob = new DatabaseJob(m_db, queryDeleteString);
 
-    connect(deleteJob, &DatabaseJob::finished, this, [this, deleteJob, startTime](){
+    connect(deleteJob, &DatabaseJob::finished, this, [this, deleteJob, targetSize, chunkSize](){
         if (deleteJob->error().type() != QSqlError::NoError) {
             qCWarning(dcLogEngine) << "Error deleting oldest log entries to keep size. Driver error:" << deleteJob->error().driverText() << "Database error:" << deleteJob->error().databaseText();
+            m_trimRunning = false;
+            return;
         }
-        qCDebug(dcLogEngine()) << "Ran housekeeping on log database in" << startTime.msecsTo(QDateTime::currentDateTime()) << "ms. (Deleted" << m_entryCount - (m_dbMaxSize - m_trimSize) << "entries)";
-        m_entryCount = m_dbMaxSize - m_trimSize;
 
-        emit logDatabaseUpdated();
+        int deleted = deleteJob->numRowsAffected() >= 0 ? deleteJob->numRowsAffected() : chunkSize;
+        m_trimDeletedCount += deleted;
+        m_entryCount = qMax(0, m_entryCount - deleted);
+
+        if (deleted == 0) {
+            // Our entry count is off, nothing left to delete. Resync it with the database.
+            m_trimRunning = false;
+            checkDBSize();
+            emit logDatabaseUpdated();
+            return;
+        }
+
+        trimChunk(targetSize);
     });
 
-    qCDebug(dcLogEngine()) << "Scheduling housekeeping job.";
-    enqueJob(deleteJob, true);
+    enqueJob(deleteJob);
 }
 
 void LogEngine::enqueJob(DatabaseJob *job, bool priority)
@@ -498,54 +1075,134 @@ void LogEngine::enqueJob(DatabaseJob *job, bool priority)
 
 void LogEngine::processQueue()
 {
-    if (!m_initialized) {
+    if (m_initializing || !m_initialized) {
         return;
     }
 
+    // Drop jobs superseded by the flood protection
+    while (!m_jobQueue.isEmpty() && m_jobQueue.first()->m_discarded) {
+        m_jobQueue.takeFirst()->deleteLater();
+        m_discardedJobs--;
+    }
+
     if (m_jobQueue.isEmpty()) {
         emit jobsRunningChanged();
         return;
     }
 
-    if (m_currentJob) {
+    if (!m_currentJobs.isEmpty()) {
         return;
     }
 
+    // Group commit: collect consecutive insert jobs from the head of the queue
+    int batchableCount = 0;
+    while (batchableCount < m_jobQueue.count() && batchableCount < m_maxBatchSize && m_jobQueue.at(batchableCount)->m_batchable) {
+        batchableCount++;
+    }
+
+    // Give more inserts a chance to arrive within the batch window before committing
+    if (batchableCount > 0 && batchableCount < m_maxBatchSize && m_batchInterval > 0 && !m_batchWindowElapsed) {
+        if (!m_batchTimer.isActive()) {
+            m_batchTimer.start(m_batchInterval);
+        }
+        return;
+    }
+    m_batchTimer.stop();
+    m_batchWindowElapsed = false;
+
     emit jobsRunningChanged();
 
     if (m_dbMalformed) {
         qCWarning(dcLogEngine()) << "Database is malformed. Trying to recover...";
+        QHash<QUuid, int> uuidIds = m_uuidIds;
+        int nextUuidId = m_nextUuidId;
         m_db.close();
         rotate(m_db.databaseName());
-        initDB(m_username, m_password);
+        if (initDB(m_username, m_password)) {
+            restoreUuids(uuidIds, nextUuidId);
+        }
         m_dbMalformed = false;
+
+        // The read connections still point to the rotated file
+        foreach (LogReadConnection *connection, m_readConnections) {
+            QMetaObject::invokeMethod(connection, "open", Qt::QueuedConnection);
+        }
+    }
+
+    QList<DatabaseJob*> jobs;
+    if (batchableCount > 1) {
+        for (int i = 0; i < batchableCount; i++) {
+            DatabaseJob *job = m_jobQueue.takeFirst();
+            if (job->m_discarded) {
+                job->deleteLater();
+                m_discardedJobs--;
+                continue;
+            }
+            jobs.append(job);
+        }
+    } else {
+        jobs.append(m_jobQueue.takeFirst());
     }
+    qCDebug(dcLogEngine()) << "Processing DB queue." << jobs.count() << "jobs in this batch. (" << m_jobQueue.count() << "jobs left in queue," << m_entryCount << "entries in DB)";
+    m_currentJobs = jobs;
 
+    QFuture<QList<DatabaseJob*>> future = QtConcurrent::run([jobs](){
+        if (jobs.count() == 1) {
+            DatabaseJob *job = jobs.first();
+            QSqlQuery query(job->m_db);
+            query.prepare(job->m_queryString);
 
-    DatabaseJob *job = m_jobQueue.takeFirst();
-    qCDebug(dcLogEngine()) << "Processing DB queue. (" << m_jobQueue.count() << "jobs left in queue," << m_entryCount << "entries in DB)";
-    m_currentJob = job;
+            foreach (const QVariant &value, job->m_bindValues) {
+                query.addBindValue(value);
+            }
+
+            query.exec();
 
-    QFuture<DatabaseJob*> future = QtConcurrent::run([job](){
-        QSqlQuery query(job->m_db);
-        query.prepare(job->m_queryString);
+            job->m_error = query.lastError();
+            job->m_executedQuery = query.executedQuery();
+            job->m_numRowsAffected = query.numRowsAffected();
 
-        foreach (const QVariant &value, job->m_bindValues) {
-            query.addBindValue(value);
+            if (!query.lastError().isValid()) {
+                job->readResults(query);
+            }
+            return jobs;
         }
 
-        query.exec();
+        // Batchable jobs all share the same statement, prepare it once and run all of them in one transaction
+        QSqlDatabase db = jobs.first()->m_db;
+        bool transaction = db.transaction();
 
-        job->m_error = query.lastError();
-        job->m_executedQuery = query.executedQuery();
+        QSqlQuery query(db);
+        query.prepare(jobs.first()->m_queryString);
 
-        if (!query.lastError().isValid()) {
-            while (query.next()) {
-                job->m_results.append(query.record());
+        QSqlError batchError;
+        foreach (DatabaseJob *job, jobs) {
+            for (int i = 0; i < job->m_bindValues.count(); i++) {
+                query.bindValue(i, job->m_bindValues.at(i));
+            }
+            query.exec();
+            job->m_error = query.lastError();
+            job->m_executedQuery = query.executedQuery();
+            job->m_numRowsAffected = query.numRowsAffected();
+            if (query.lastError().isValid() && transaction) {
+                batchError = query.lastError();
+                break;
             }
         }
 
-       return job;
+        if (transaction) {
+            if (!batchError.isValid() && !db.commit()) {
+                batchError = db.lastError();
+            }
+            if (batchError.isValid()) {
+                db.rollback();
+                // Nothing of this batch has been written
+                foreach (DatabaseJob *job, jobs) {
+                    job->m_error = batchError;
+                }
+            }
+        }
+        return jobs;
     });
 
     m_jobWatcher.setFuture(future);
@@ -553,15 +1210,180 @@ void LogEngine::processQueue()
 
 void LogEngine::handleJobFinished()
 {
-    DatabaseJob *job = m_jobWatcher.result();
-    job->finished();
-    job->deleteLater();
-    m_currentJob = nullptr;
+    QList<DatabaseJob*> jobs = m_jobWatcher.result();
+    foreach (DatabaseJob *job, jobs) {
+        // Flagged for discarding after it has been handed to the worker already
+        if (job->m_discarded) {
+            m_discardedJobs--;
+        }
+        job->finished();
+        job->deleteLater();
+    }
+    m_currentJobs.clear();
 
     qCDebug(dcLogEngine()) << "DB job finished. (" << m_entryCount << "entries in DB)";
     processQueue();
 }
 
+void LogEngine::handleInitFinished()
+{
+    if (!m_initializing) {
+        return;
+    }
+    m_initializing = false;
+
+    if (m_initWatcher.result()) {
+        // If there is still a deviceId column, schedule items to be migrated in the
+        // background with low priority as this might take hours
+        if (m_db.tables().contains("_entries_v3")) {
+            migrateEntries3to4();
+        }
+        startReadConnections(m_readConnectionCount);
+        checkDBSize();
+    }
+
+    if (m_initBufferOverflow > 0) {
+        qCWarning(dcLogEngine()) << "Discarded" << m_initBufferOverflow << "log entries while the log database was being initialized.";
+    }
+    qCDebug(dcLogEngine()) << "Log database initialization finished. Writing" << m_initBuffer.count() << "buffered log entries.";
+    QList<LogEntry> bufferedEntries = m_initBuffer;
+    m_initBuffer.clear();
+    m_initBufferOverflow = 0;
+    foreach (const LogEntry &entry, bufferedEntries) {
+        writeLogEntry(entry);
+    }
+
+    processQueue();
+}
+
+void LogEngine::onBatchWindowElapsed()
+{
+    m_batchWindowElapsed = true;
+    processQueue();
+}
+
+void LogEngine::enqueReadJob(DatabaseJob *job)
+{
+    if (m_readConnections.isEmpty() || !m_initialized || m_dbMalformed) {
+        // No read connections available, fall back to the write queue
+        enqueJob(job, true);
+        return;
+    }
+
+    LogReadConnection *connection = m_readConnections.first();
+    foreach (LogReadConnection *candidate, m_readConnections) {
+        if (m_readConnectionLoad.value(candidate) < m_readConnectionLoad.value(connection)) {
+            connection = candidate;
+        }
+    }
+
+    m_readConnectionLoad[connection]++;
+    m_runningReadJobs.insert(job, connection);
+    qCDebug(dcLogEngine()) << "Scheduled read job on read connection" << m_readConnections.indexOf(connection) << "(" << m_runningReadJobs.count() << "read jobs running)";
+    emit jobsRunningChanged();
+
+    QMetaObject::invokeMethod(connection, "execute", Qt::QueuedConnection, Q_ARG(DatabaseJob*, job));
+}
+
+void LogEngine::handleReadJobFinished(DatabaseJob *job)
+{
+    LogReadConnection *connection = m_runningReadJobs.take(job);
+    m_readConnectionLoad[connection]--;
+    if (m_readConnectionLoad.value(connection) == 0 && m_retiringReadConnections.contains(connection)) {
+        stopReadThread(m_retiringReadConnections.take(connection));
+        m_readConnectionLoad.remove(connection);
+    }
+
+    job->finished();
+    job->deleteLater();
+
+    emit jobsRunningChanged();
+}
+
+void LogEngine::startReadConnections(int count)
+{
+    // Concurrent readers next to a writer require SQLite in WAL mode on a file based database
+    if (m_db.driverName() != "QSQLITE" || m_db.databaseName() == ":memory:" || !m_initialized) {
+        return;
+    }
+
+    qRegisterMetaType<DatabaseJob*>("DatabaseJob*");
+
+    for (int i = 0; i < count; i++) {
+        // Connections being replaced may still be open, names are never reused
+        int serial = m_readConnectionSerial++;
+        QThread *thread = new QThread();
+        thread->setObjectName(QString("LogReader%1").arg(serial));
+        LogReadConnection *connection = new LogReadConnection(m_db, QString("logs-reader-%1").arg(serial), m_username, m_password);
+        connection->moveToThread(thread);
+        connect(thread, &QThread::started, connection, &LogReadConnection::open);
+        connect(thread, &QThread::finished, connection, &QObject::deleteLater);
+        connect(connection, &LogReadConnection::jobFinished, this, &LogEngine::handleReadJobFinished, Qt::QueuedConnection);
+        thread->start();
+
+        m_readThreads.append(thread);
+        m_readConnections.append(connection);
+        m_readConnectionLoad.insert(connection, 0);
+    }
+    qCDebug(dcLogEngine()) << "Started" << count << "read connections for the log database";
+}
+
+void LogEngine::stopReadConnections()
+{
+    foreach (QThread *thread, m_readThreads) {
+        stopReadThread(thread);
+    }
+    foreach (QThread *thread, m_retiringReadConnections) {
+        stopReadThread(thread);
+    }
+    m_readThreads.clear();
+    m_readConnections.clear();
+    m_retiringReadConnections.clear();
+    m_readConnectionLoad.clear();
+}
+
+void LogEngine::stopReadThread(QThread *thread)
+{
+    // The connection is deleted in its thread once the event loop quits
+    thread->quit();
+    thread->wait();
+    delete thread;
+}
+
+void LogEngine::stopStateStorage()
+{
+    if (!m_stateStorage) {
+        return;
+    }
+
+    // Queued behind the pending appends, so nothing logged so far is lost
+    QMetaObject::invokeMethod(m_stateStorage, "deleteLater", Qt::QueuedConnection);
+    m_stateStorage = nullptr;
+    m_stateStorageThread->wait();
+    delete m_stateStorageThread;
+    m_stateStorageThread = nullptr;
+
+    // Results still queued for this thread are dropped in handleStateSamplesFetched()
+    QHash<int, LogEntrySamplesFetchJob*> requests = m_stateSamplesRequests;
+    m_stateSamplesRequests.clear();
+    foreach (LogEntrySamplesFetchJob *fetchJob, requests) {
+        fetchJob->finished();
+        fetchJob->deleteLater();
+    }
+}
+
+void LogEngine::handleStateSamplesFetched(int requestId, const LogEntrySamples &samples)
+{
+    LogEntrySamplesFetchJob *fetchJob = m_stateSamplesRequests.take(requestId);
+    if (!fetchJob) {
+        return;
+    }
+    fetchJob->m_results = samples;
+    qCDebug(dcLogEngine()) << "Fetched" << samples.count() << "samples from the state storage";
+    fetchJob->finished();
+    fetchJob->deleteLater();
+}
+
 void LogEngine::rotate(const QString &dbName)
 {
     int index = 1;
@@ -608,8 +1430,8 @@ bool LogEngine::migrateDatabaseVersion3to4()
     }
     qCDebug(dcLogEngine()) << "Created new entries table:" << m_db.lastError().text();
 
-    qCDebug(dcLogEngine()) << "Updating database version to" << DB_SCHEMA_VERSION;
-    m_db.exec(QString("UPDATE metadata SET data = %1 WHERE `key` = 'version';").arg(DB_SCHEMA_VERSION));
+    qCDebug(dcLogEngine()) << "Updating database version to" << 4;
+    m_db.exec(QString("UPDATE metadata SET data = %1 WHERE `key` = 'version';").arg(4));
     if (m_db.lastError().isValid()) {
         qCWarning(dcLogEngine) << "Error updating database verion 3 -> 4. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
         return false;
@@ -621,6 +1443,122 @@ bool LogEngine::migrateDatabaseVersion3to4()
 
 }
 
+bool LogEngine::migrateDatabaseVersion4to5()
+{
+    QDateTime startTime = QDateTime::currentDateTime();
+    // If there is no entries table yet, the indexes will be created along with it
+    if (m_db.tables().contains("entries") && !createIndexes()) {
+        qCWarning(dcLogEngine) << "Error migrating database verion 4 -> 5 (creating indexes).";
+        return false;
+    }
+
+    qCDebug(dcLogEngine()) << "Updating database version to" << 5;
+    m_db.exec(QString("UPDATE metadata SET data = %1 WHERE `key` = 'version';").arg(5));
+    if (m_db.lastError().isValid()) {
+        qCWarning(dcLogEngine) << "Error updating database verion 4 -> 5. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    qCDebug(dcLogEngine()) << "Migrated database schema from version 4 to 5 in" << startTime.msecsTo(QDateTime::currentDateTime()) << "ms.";
+    return true;
+}
+
+bool LogEngine::migrateDatabaseVersion5to6()
+{
+    // Schema 6 interns all UUIDs into the uuids table and stores numeric values in a NUMERIC column
+    QDateTime startTime = QDateTime::currentDateTime();
+    if (!m_db.tables().contains("entries")) {
+        // Nothing to migrate, the tables will be created in the new format
+        m_db.exec(QString("UPDATE metadata SET data = %1 WHERE `key` = 'version';").arg(6));
+        return !m_db.lastError().isValid();
+    }
+
+    m_db.transaction();
+
+    QStringList statements;
+    statements << "CREATE TABLE uuids (id INTEGER PRIMARY KEY, uuid VARCHAR(38) UNIQUE);"
+               << "INSERT OR IGNORE INTO uuids (uuid) SELECT DISTINCT typeId FROM entries;"
+               << "INSERT OR IGNORE INTO uuids (uuid) SELECT DISTINCT thingId FROM entries;"
+               << "ALTER TABLE entries RENAME TO _entries_v5;"
+               << entriesTableSchema()
+               // Only values which convert back to the very same string are considered numeric
+               << "INSERT INTO entries (timestamp, loggingLevel, sourceType, typeId, thingId, value, numericValue, loggingEventType, active, errorCode) "
+                  "SELECT old.timestamp, old.loggingLevel, old.sourceType, types.id, things.id, "
+                  "CASE WHEN CAST(CAST(old.value AS NUMERIC) AS TEXT) = old.value THEN NULL ELSE old.value END, "
+                  "CASE WHEN CAST(CAST(old.value AS NUMERIC) AS TEXT) = old.value THEN CAST(old.value AS NUMERIC) ELSE NULL END, "
+                  "old.loggingEventType, old.active, old.errorCode "
+                  "FROM _entries_v5 AS old LEFT JOIN uuids AS types ON types.uuid = old.typeId LEFT JOIN uuids AS things ON things.uuid = old.thingId "
+                  "ORDER BY old.ROWID ASC;"
+               // Dropping the old table drops its indexes too, so the new ones can take their names
+               << "DROP TABLE _entries_v5;"
+               << QString("UPDATE metadata SET data = %1 WHERE `key` = 'version';").arg(6);
+
+    foreach (const QString &statement, statements) {
+        m_db.exec(statement);
+        if (m_db.lastError().isValid()) {
+            qCWarning(dcLogEngine) << "Error migrating database verion 5 -> 6. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+            m_db.rollback();
+            return false;
+        }
+    }
+
+    if (!createIndexes()) {
+        m_db.rollback();
+        return false;
+    }
+
+    if (!m_db.commit()) {
+        qCWarning(dcLogEngine) << "Error committing migration of database verion 5 -> 6. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        m_db.rollback();
+        return false;
+    }
+
+    // Give the space of the string columns back to the file system
+    m_db.exec("VACUUM;");
+
+    qCDebug(dcLogEngine()) << "Migrated database schema from version 5 to 6 in" << startTime.msecsTo(QDateTime::currentDateTime()) << "ms.";
+    return true;
+}
+
+QString LogEngine::entriesTableSchema() const
+{
+    return QStringLiteral("CREATE TABLE entries "
+                          "("
+                          "timestamp BIGINT,"
+                          "loggingLevel INT,"
+                          "sourceType INT,"
+                          "typeId INT,"
+                          "thingId INT,"
+                          "value VARCHAR(100),"
+                          "numericValue NUMERIC,"
+                          "loggingEventType INT,"
+                          "active BOOL,"
+                          "errorCode INT,"
+                          "FOREIGN KEY(sourceType) REFERENCES sourceTypes(id),"
+                          "FOREIGN KEY(loggingEventType) REFERENCES loggingEventTypes(id),"
+                          "FOREIGN KEY(typeId) REFERENCES uuids(id),"
+                          "FOREIGN KEY(thingId) REFERENCES uuids(id)"
+                          ");");
+}
+
+bool LogEngine::createIndexes()
+{
+    // Covers fetching/deleting logs for a thing and its types, ordered by time
+    m_db.exec("CREATE INDEX IF NOT EXISTS idx_entries_thingId_typeId_timestamp ON entries (thingId, typeId, timestamp);");
+    if (m_db.lastError().isValid()) {
+        qCWarning(dcLogEngine) << "Error creating thingId index on entries table. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    // Covers unfiltered queries ordered by time and housekeeping
+    m_db.exec("CREATE INDEX IF NOT EXISTS idx_entries_timestamp ON entries (timestamp);");
+    if (m_db.lastError().isValid()) {
+        qCWarning(dcLogEngine) << "Error creating timestamp index on entries table. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+    return true;
+}
+
 void LogEngine::migrateEntries3to4()
 {
     QString selectQuery = QString("SELECT * FROM _entries_v3;");
@@ -645,20 +1583,18 @@ void LogEngine::migrateEntries3to4()
 
         QSqlRecord result = job->results().first();
         QString encodedValue = result.value("value").toByteArray();
-        QString decodedValue = LogValueTool::convertVariantToString(LogValueTool::deserializeValue(encodedValue));
-
-        QString insertCall = QString("INSERT INTO entries (timestamp, loggingEventType, loggingLevel, sourceType, typeId, thingId, value, active, errorCode) values ('%1', '%2', '%3', '%4', '%5', '%6', '%7', '%8', '%9');")
-                .arg(result.value("timestamp").toLongLong() * 1000)
-                .arg(result.value("loggingEventType").toInt())
-                .arg(result.value("loggingLevel").toInt())
-                .arg(result.value("sourceType").toInt())
-                .arg(result.value("typeId").toString())
-                .arg(result.value("deviceId").toString())
-                .arg(decodedValue)
-                .arg(result.value("active").toBool())
-                .arg(result.value("errorCode").toInt());
-
-        DatabaseJob *insertJob = new DatabaseJob(m_db, insertCall);
+
+        LogEntry entry(QDateTime::fromMSecsSinceEpoch(result.value("timestamp").toLongLong() * 1000),
+                       static_cast<Logging::LoggingLevel>(result.value("loggingLevel").toInt()),
+                       static_cast<Logging::LoggingSource>(result.value("sourceType").toInt()),
+                       result.value("errorCode").toInt());
+        entry.setEventType(static_cast<Logging::LoggingEventType>(result.value("loggingEventType").toInt()));
+        entry.setTypeId(result.value("typeId").toUuid());
+        entry.setThingId(ThingId(result.value("deviceId").toUuid()));
+        entry.setValue(LogValueTool::deserializeValue(encodedValue));
+        entry.setActive(result.value("active").toBool());
+
+        DatabaseJob *insertJob = createInsertJob(entry);
         connect(insertJob, &DatabaseJob::finished, this, [this, insertJob, count, result](){
             if (insertJob->error().type() != QSqlError::NoError) {
                 qCWarning(dcLogEngine) << "Error fetching entries to migrate. Driver error:" << insertJob->error().driverText() << "Database error:" << insertJob->error().databaseText();
@@ -751,17 +1687,34 @@ bool LogEngine::initDB(const QString &username, const QString &password)
             }
         }
 
+        // Migration from 4 -> 5
+        if (version == 4) {
+            if (!migrateDatabaseVersion4to5()) {
+                qCWarning(dcLogEngine()) << "Migration process failed.";
+                m_db.close();
+                return false;
+            } else {
+                version = 5;
+            }
+        }
+
+        // Migration from 5 -> 6
+        if (version == 5) {
+            if (!migrateDatabaseVersion5to6()) {
+                qCWarning(dcLogEngine()) << "Migration process failed.";
+                m_db.close();
+                return false;
+            } else {
+                version = 6;
+            }
+        }
+
         if (version != DB_SCHEMA_VERSION) {
             qCWarning(dcLogEngine) << "Log schema version not matching! Schema upgrade not implemented for this version change.";
             m_db.close();
             return false;
         } else {
             qCDebug(dcLogEngine) << QString("Log database schema version \"%1\" matches").arg(DB_SCHEMA_VERSION).toLatin1().data();
-            // If there is still a deviceId column, schedule items to be migrated in the
-            // background with low priority as this might take hours
-            if (m_db.tables().contains("_entries_v3")) {
-                migrateEntries3to4();
-            }
         }
     } else {
         qCWarning(dcLogEngine) << "Broken log database. Version not found in metadata table.";
@@ -792,22 +1745,18 @@ bool LogEngine::initDB(const QString &username, const QString &password)
         }
     }
 
+    if (!m_db.tables().contains("uuids")) {
+        m_db.exec("CREATE TABLE uuids (id INTEGER PRIMARY KEY, uuid VARCHAR(38) UNIQUE);");
+        if (m_db.lastError().isValid()) {
+            qCWarning(dcLogEngine) << "Error creating uuids table in database. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+            m_db.close();
+            return false;
+        }
+    }
+
     if (!m_db.tables().contains("entries")) {
         qCDebug(dcLogEngine()) << "No \"entries\" table in database. Creating it.";
-        m_db.exec("CREATE TABLE entries "
-                  "("
-                  "timestamp BIGINT,"
-                  "loggingLevel INT,"
-                  "sourceType INT,"
-                  "typeId VARCHAR(38),"
-                  "thingId VARCHAR(38),"
-                  "value VARCHAR(100),"
-                  "loggingEventType INT,"
-                  "active BOOL,"
-                  "errorCode INT,"
-                  "FOREIGN KEY(sourceType) REFERENCES sourceTypes(id),"
-                  "FOREIGN KEY(loggingEventType) REFERENCES loggingEventTypes(id)"
-                  ");");
+        m_db.exec(entriesTableSchema());
 
         if (m_db.lastError().isValid()) {
             qCWarning(dcLogEngine) << "Error creating log table in database. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
@@ -815,12 +1764,91 @@ bool LogEngine::initDB(const QString &username, const QString &password)
             return false;
         }
 
+        if (!createIndexes()) {
+            m_db.close();
+            return false;
+        }
 
     }
 
+    if (m_db.driverName() == "QSQLITE") {
+        // Allows the read connections to query the database while it is being written
+        m_db.exec("PRAGMA journal_mode=WAL;");
+        if (m_db.lastError().isValid()) {
+            qCWarning(dcLogEngine) << "Error enabling WAL mode on log database. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        }
+    }
+
+    // Load the interned uuids. This happens before the queue is processed, so accessing m_db is fine.
+    m_uuidIds.clear();
+    m_nextUuidId = 1;
+    QSqlQuery uuidsQuery = m_db.exec("SELECT id, uuid FROM uuids;");
+    while (uuidsQuery.next()) {
+        int id = uuidsQuery.value("id").toInt();
+        m_uuidIds.insert(uuidsQuery.value("uuid").toUuid(), id);
+        m_nextUuidId = qMax(m_nextUuidId, id + 1);
+    }
+
     qCDebug(dcLogEngine) << "Initialized logging DB successfully. (maximum DB size:" << m_dbMaxSize << ")";
     m_initialized = true;
     return true;
 }
 
+LogReadConnection::LogReadConnection(const QSqlDatabase &db, const QString &connectionName, const QString &username, const QString &password):
+    m_driver(db.driverName()),
+    m_databaseName(db.databaseName()),
+    m_connectionName(connectionName),
+    m_username(username),
+    m_password(password)
+{
+
+}
+
+LogReadConnection::~LogReadConnection()
+{
+    // Called in the reader thread, which owns the connection
+    if (m_db.isValid()) {
+        m_db.close();
+        m_db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
+}
+
+void LogReadConnection::open()
+{
+    if (m_db.isValid()) {
+        m_db.close();
+    } else {
+        m_db = QSqlDatabase::addDatabase(m_driver, m_connectionName);
+        m_db.setDatabaseName(m_databaseName);
+        m_db.setConnectOptions("QSQLITE_OPEN_READONLY");
+    }
+
+    if (!m_db.open(m_username, m_password)) {
+        qCWarning(dcLogEngine()) << "Error opening read connection" << m_connectionName << "on log database:" << m_db.lastError().driverText() << m_db.lastError().databaseText();
+    }
+}
+
+void LogReadConnection::execute(DatabaseJob *job)
+{
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare(job->m_queryString);
+
+    foreach (const QVariant &value, job->m_bindValues) {
+        query.addBindValue(value);
+    }
+
+    query.exec();
+
+    job->m_error = query.lastError();
+    job->m_executedQuery = query.executedQuery();
+
+    if (!query.lastError().isValid()) {
+        job->readResults(query);
+    }
+
+    emit jobFinished(job);
+}
+
 }
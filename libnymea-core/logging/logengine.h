@@ -32,7 +32,9 @@
 #define LOGENGINE_H
 
 #include "logentry.h"
+#include "logentrysample.h"
 #include "logfilter.h"
+#include "logstoragebackend.h"
 #include "types/event.h"
 #include "types/action.h"
 #include "types/browseritemaction.h"
@@ -46,13 +48,21 @@
 #include <QSqlError>
 #include <QSqlRecord>
 #include <QTimer>
+#include <QVector>
+#include <QSet>
+#include <QThread>
 #include <QFutureWatcher>
 
+#include <functional>
+
 namespace nymeaserver {
 
 class DatabaseJob;
+class LogReadConnection;
 class LogEntriesFetchJob;
+class LogEntrySamplesFetchJob;
 class ThingsFetchJob;
+class LogColumnCache;
 
 class LogEngine: public QObject
 {
@@ -64,16 +74,30 @@ public:
     void setThingManager(ThingManager *thingManager);
 
     LogEntriesFetchJob *fetchLogEntries(const LogFilter &filter = LogFilter());
+    LogEntrySamplesFetchJob *fetchLogEntrySamples(const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &startTime, const QDateTime &endTime, int sampleCount);
     ThingsFetchJob *fetchThings();
 
     bool jobsRunning() const;
+    bool initializing() const;
 
     void setMaxLogEntries(int maxLogEntries, int trimSize);
+    void setBatchingParameters(int maxBatchSize, int batchInterval);
+    void setReadConnections(int count);
+    void setStateRateLimit(const ThingId &thingId, const StateTypeId &stateTypeId, int minInterval, double deadband = 0);
+    void setDefaultStateRateLimit(int minInterval, double deadband = 0);
+    void setStateStorageBackend(LogStorageBackend *backend);
+    LogStorageBackend *stateStorageBackend() const;
+    void setColumnCacheWindow(int window);
+    LogColumnCache *columnCache() const;
+    void setStateHistorySize(int size);
+    QList<QPair<QDateTime, QVariant>> stateHistory(const ThingId &thingId, const StateTypeId &stateTypeId) const;
     void clearDatabase();
 
     void removeThingLogs(const ThingId &thingId);
     void removeRuleLogs(const RuleId &ruleId);
 
+    void appendReplicatedEntry(const LogEntry &entry);
+
 public slots:
     void logSystemEvent(const QDateTime &dateTime, bool active, Logging::LoggingLevel level = Logging::LoggingLevelInfo);
     void logBrowserAction(const BrowserAction &browserAction, Logging::LoggingLevel level = Logging::LoggingLevelInfo, int errorCode = 0);
@@ -96,70 +120,220 @@ signals:
 
 private:
     bool initDB(const QString &username, const QString &password);
+    void ingestStateEntry(const LogEntry &entry);
+    void flushCoalescedEntries(bool all = false);
     void appendLogEntry(const LogEntry &entry);
+    void writeLogEntry(const LogEntry &entry);
+    void appendStateHistory(const LogEntry &entry);
+    void appendColumnCache(const LogEntry &entry);
+    DatabaseJob *createInsertJob(const LogEntry &entry);
+    int internUuid(const QUuid &uuid);
+    void restoreUuids(const QHash<QUuid, int> &uuidIds, int nextUuidId);
     void rotate(const QString &dbName);
 
     bool migrateDatabaseVersion3to4();
+    bool migrateDatabaseVersion4to5();
+    bool migrateDatabaseVersion5to6();
+    QString entriesTableSchema() const;
+    bool createIndexes();
     void migrateEntries3to4();
     void finalizeMigration3To4();
 
 private slots:
     void checkDBSize();
     void trim();
+    void trimChunk(int targetSize);
 
     void enqueJob(DatabaseJob *job, bool priority = false);
     void processQueue();
     void handleJobFinished();
+    void onBatchWindowElapsed();
+    void handleInitFinished();
+
+    void enqueReadJob(DatabaseJob *job);
+    void handleReadJobFinished(DatabaseJob *job);
+    void handleStateSamplesFetched(int requestId, const LogEntrySamples &samples);
 
 private:
+    void startReadConnections(int count);
+    void stopReadConnections();
+    void stopReadThread(QThread *thread);
+    void stopStateStorage();
+
     QSqlDatabase m_db;
     QString m_username;
     QString m_password;
     int m_dbMaxSize;
     int m_trimSize;
     int m_entryCount = 0;
+    bool m_trimRunning = false;
+    int m_trimDeletedCount = 0;
+    QDateTime m_trimStartTime;
     bool m_initialized = false;
     bool m_dbMalformed = false;
 
+    // Set while initDB() runs in m_initWatcher's thread. Nothing but initDB() may touch m_db
+    // and the uuid cache during that time.
+    bool m_initializing = false;
+    QFutureWatcher<bool> m_initWatcher;
+    QList<LogEntry> m_initBuffer;
+    int m_initBufferOverflow = 0;
+    int m_readConnectionCount = 2;
+
     ThingManager *m_thingManager = nullptr;
 
+    // Optional store for the numeric state history. State samples are served from it if set.
+    // It lives in its own thread and is only called through queued invocations.
+    LogStorageBackend *m_stateStorage = nullptr;
+    QThread *m_stateStorageThread = nullptr;
+    QHash<int, LogEntrySamplesFetchJob*> m_stateSamplesRequests;
+    int m_nextStateSamplesRequestId = 0;
+
+    // Optional in-memory cache for the recent values of metering states. Samples within its window are served from it.
+    // Whether a state is cached depends on its unit, which is looked up once per source.
+    LogColumnCache *m_columnCache = nullptr;
+    QHash<QPair<QUuid, QUuid>, bool> m_columnCacheSources;
+
+    // Type and thing ids are stored as references into the uuids table
+    QHash<QUuid, int> m_uuidIds;
+    int m_nextUuidId = 1;
+    // Ids whose insert into the uuids table is still queued
+    QSet<int> m_pendingUuidIds;
+
+    // Log sources are identified by their thingId and typeId
+    typedef QPair<QUuid, QUuid> LogSource;
+
+    // State changes pass the ingestion stage before they are queued. Values arriving faster than the
+    // minimum interval are coalesced so only the most recent one is written once the interval elapsed.
+    // Numeric values within the deadband of the last accepted value are dropped.
+    class RateLimit {
+    public:
+        int minInterval = 0;
+        double deadband = 0;
+    };
+    class SourceState {
+    public:
+        qint64 lastWritten = 0;
+        QVariant lastValue;
+        bool pending = false;
+        LogEntry pendingEntry;
+        qint64 pendingDue = 0;
+    };
+    RateLimit rateLimit(const LogSource &source) const;
+    RateLimit m_defaultRateLimit;
+    QHash<QUuid, RateLimit> m_stateTypeRateLimits;
+    QHash<LogSource, RateLimit> m_sourceRateLimits;
+    QHash<LogSource, SourceState> m_sourceStates;
+    QTimer m_coalesceTimer;
+
+    // The last logged values of each state, kept in memory to serve recent history without the database.
+    // Once a buffer is full, next points to the oldest entry which is overwritten by the next value.
+    class StateHistory {
+    public:
+        QVector<QPair<qint64, QVariant>> entries;
+        int next = 0;
+    };
+    int m_stateHistorySize = 0;
+    QHash<LogSource, StateHistory> m_stateHistories;
+
     // When maxQueueLength is exceeded, jobs will be flagged and discarded if this source logs more events
     int m_maxQueueLength;
-    QHash<QString, QList<DatabaseJob*>> m_flaggedJobs;
+    QHash<LogSource, QList<DatabaseJob*>> m_flaggedJobs;
+    int m_discardedJobs = 0;
+
+    // Consecutive insert jobs are grouped into a single transaction. If a batch interval is set,
+    // the queue waits up to that many ms for more inserts to arrive before committing a batch.
+    int m_maxBatchSize = 100;
+    int m_batchInterval = 0;
+    bool m_batchWindowElapsed = false;
+    QTimer m_batchTimer;
 
     QList<DatabaseJob*> m_jobQueue;
-    DatabaseJob *m_currentJob = nullptr;
-    QFutureWatcher<DatabaseJob*> m_jobWatcher;
+    QList<DatabaseJob*> m_currentJobs;
+    QFutureWatcher<QList<DatabaseJob*>> m_jobWatcher;
+
+    // Read-only connections (SQLite in WAL mode only), each living in its own thread.
+    // Fetch jobs are dispatched to the least busy one and don't wait for the write queue.
+    QList<LogReadConnection*> m_readConnections;
+    QList<QThread*> m_readThreads;
+    QHash<LogReadConnection*, int> m_readConnectionLoad;
+    QHash<DatabaseJob*, LogReadConnection*> m_runningReadJobs;
+    // Connections replaced by setReadConnections() while reads were running on them, stopped once they're done
+    QHash<LogReadConnection*, QThread*> m_retiringReadConnections;
+    int m_readConnectionSerial = 0;
+};
+
+class LogReadConnection: public QObject
+{
+    Q_OBJECT
+public:
+    LogReadConnection(const QSqlDatabase &db, const QString &connectionName, const QString &username, const QString &password);
+    ~LogReadConnection();
+
+public slots:
+    void open();
+    void execute(DatabaseJob *job);
+
+signals:
+    void jobFinished(DatabaseJob *job);
+
+private:
+    QString m_driver;
+    QString m_databaseName;
+    QString m_connectionName;
+    QString m_username;
+    QString m_password;
+    QSqlDatabase m_db;
 };
 
 class DatabaseJob: public QObject
 {
     Q_OBJECT
 public:
-    DatabaseJob(const QSqlDatabase &db, const QString &queryString, const QVariantList &bindValues = QVariantList()):
+    DatabaseJob(const QSqlDatabase &db, const QString &queryString, const QVariantList &bindValues = QVariantList(), bool batchable = false):
         m_db(db),
         m_queryString(queryString),
-        m_bindValues(bindValues)
+        m_bindValues(bindValues),
+        m_batchable(batchable)
     {
     }
 
     QString executedQuery() const { return m_executedQuery; }
     QSqlError error() const { return m_error; }
     QList<QSqlRecord> results() const { return m_results; }
+    int numRowsAffected() const { return m_numRowsAffected; }
 
 signals:
     void finished();
 
 private:
+    void readResults(QSqlQuery &query) {
+        while (query.next()) {
+            if (m_rowHandler) {
+                m_rowHandler(query);
+            } else {
+                m_results.append(query.record());
+            }
+        }
+    }
+
     QSqlDatabase m_db;
     QString m_queryString;
     QVariantList m_bindValues;
+    bool m_batchable = false;
+    // Flood protection marks superseded jobs instead of searching them in the queue
+    bool m_discarded = false;
 
     QString m_executedQuery;
     QSqlError m_error;
     QList<QSqlRecord> m_results;
+    int m_numRowsAffected = -1;
+
+    // If set, gets called for each result row in the worker thread instead of collecting the records
+    std::function<void(const QSqlQuery &query)> m_rowHandler;
 
     friend class LogEngine;
+    friend class LogReadConnection;
 };
 
 class LogEntriesFetchJob: public QObject
@@ -168,10 +342,31 @@ class LogEntriesFetchJob: public QObject
 public:
     LogEntriesFetchJob(QObject *parent): QObject(parent) {}
     QList<LogEntry> results() { return m_results; }
+
+    // Position of the last returned entry, to be used as cursor for the next page
+    bool hasMore() const { return m_hasMore; }
+    qint64 lastTimestamp() const { return m_lastTimestamp; }
+    qint64 lastRowId() const { return m_lastRowId; }
 signals:
     void finished();
 private:
     QList<LogEntry> m_results;
+    bool m_hasMore = false;
+    qint64 m_lastTimestamp = 0;
+    qint64 m_lastRowId = 0;
+    friend class LogEngine;
+};
+
+class LogEntrySamplesFetchJob: public QObject
+{
+    Q_OBJECT
+public:
+    LogEntrySamplesFetchJob(QObject *parent): QObject(parent) {}
+    LogEntrySamples results() { return m_results; }
+signals:
+    void finished();
+private:
+    LogEntrySamples m_results;
     friend class LogEngine;
 };
 
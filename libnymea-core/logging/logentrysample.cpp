@@ -0,0 +1,121 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::LogEntrySample
+    \brief Represents an aggregated time bucket of numeric log entries.
+
+    \ingroup logs
+    \inmodule core
+
+    A \l{LogEntrySample} holds the minimum, maximum, average and last value of all
+    \l{LogEntry}{LogEntries} of a state within one time bucket.
+
+    \sa LogEngine, LogEntry, LoggingHandler
+*/
+
+#include "logentrysample.h"
+
+namespace nymeaserver {
+
+LogEntrySample::LogEntrySample()
+{
+
+}
+
+/*! Constructs a \l{LogEntrySample} for the bucket starting at \a timestamp, aggregating \a count entries. */
+LogEntrySample::LogEntrySample(const QDateTime &timestamp, int count, double min, double max, double avg, const QVariant &last):
+    m_timestamp(timestamp),
+    m_count(count),
+    m_min(min),
+    m_max(max),
+    m_avg(avg),
+    m_last(last)
+{
+
+}
+
+/*! Returns the start time of the bucket this sample represents. */
+QDateTime LogEntrySample::timestamp() const
+{
+    return m_timestamp;
+}
+
+/*! Returns the number of log entries aggregated in this sample. */
+int LogEntrySample::count() const
+{
+    return m_count;
+}
+
+/*! Returns the smallest value within this sample. */
+double LogEntrySample::min() const
+{
+    return m_min;
+}
+
+/*! Returns the largest value within this sample. */
+double LogEntrySample::max() const
+{
+    return m_max;
+}
+
+/*! Returns the average of all values within this sample. */
+double LogEntrySample::avg() const
+{
+    return m_avg;
+}
+
+/*! Returns the most recent value within this sample. */
+QVariant LogEntrySample::last() const
+{
+    return m_last;
+}
+
+LogEntrySamples::LogEntrySamples()
+{
+
+}
+
+LogEntrySamples::LogEntrySamples(const QList<LogEntrySample> &other): QList<LogEntrySample>(other)
+{
+
+}
+
+QVariant LogEntrySamples::get(int index) const
+{
+    return QVariant::fromValue(at(index));
+}
+
+void LogEntrySamples::put(const QVariant &variant)
+{
+    append(variant.value<LogEntrySample>());
+}
+
+}
@@ -0,0 +1,89 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef LOGENTRYSAMPLE_H
+#define LOGENTRYSAMPLE_H
+
+#include <QObject>
+#include <QVariant>
+#include <QDateTime>
+
+namespace nymeaserver {
+
+class LogEntrySample
+{
+    Q_GADGET
+    Q_PROPERTY(QDateTime timestamp READ timestamp)
+    Q_PROPERTY(int count READ count)
+    Q_PROPERTY(double min READ min)
+    Q_PROPERTY(double max READ max)
+    Q_PROPERTY(double avg READ avg)
+    Q_PROPERTY(QVariant last READ last USER true)
+
+public:
+    LogEntrySample();
+    LogEntrySample(const QDateTime &timestamp, int count, double min, double max, double avg, const QVariant &last);
+
+    // The start of the time bucket this sample represents
+    QDateTime timestamp() const;
+
+    // The number of log entries aggregated in this sample
+    int count() const;
+
+    double min() const;
+    double max() const;
+    double avg() const;
+    QVariant last() const;
+
+private:
+    QDateTime m_timestamp;
+    int m_count = 0;
+    double m_min = 0;
+    double m_max = 0;
+    double m_avg = 0;
+    QVariant m_last;
+};
+
+class LogEntrySamples: public QList<LogEntrySample>
+{
+    Q_GADGET
+    Q_PROPERTY(int count READ count)
+public:
+    LogEntrySamples();
+    LogEntrySamples(const QList<LogEntrySample> &other);
+    Q_INVOKABLE QVariant get(int index) const;
+    Q_INVOKABLE void put(const QVariant &variant);
+};
+
+}
+Q_DECLARE_METATYPE(nymeaserver::LogEntrySample)
+Q_DECLARE_METATYPE(nymeaserver::LogEntrySamples)
+
+#endif // LOGENTRYSAMPLE_H
@@ -44,6 +44,8 @@
 #include "logfilter.h"
 #include "loggingcategories.h"
 
+#include <QStringList>
+
 namespace nymeaserver {
 
 /*! Constructs a new \l{LogFilter}.*/
@@ -59,39 +61,19 @@ QString LogFilter::queryString() const
         return QString();
     }
 
-    QString query;
-    query.append(createDateString());
-
-    if (!query.isEmpty() && !loggingSources().isEmpty()) {
-        query.append("AND ");
-    }
-    query.append(createSourcesString());
-
-    if (!query.isEmpty() && !loggingLevels().isEmpty()) {
-        query.append("AND ");
-    }
-    query.append(createLevelsString());
-
-    if (!query.isEmpty() && !loggingEventTypes().isEmpty()) {
-        query.append("AND ");
-    }
-    query.append(createEventTypesString());
-
-    if (!query.isEmpty() && !typeIds().isEmpty()) {
-        query.append("AND ");
-    }
-    query.append(createTypeIdsString());
-
-    if (!query.isEmpty() && !thingIds().isEmpty()) {
-        query.append("AND ");
-    }
-    query.append(createThingIdString());
-
-    if (!query.isEmpty() && !values().isEmpty()) {
-        query.append("AND ");
-    }
-    query.append(createValuesString());
-
+    // The order of the predicates matches the column order of the indexes on the entries table
+    // (thingId, typeId, timestamp) so the query planner can make use of them.
+    QStringList predicates;
+    predicates.append(createThingIdString());
+    predicates.append(createTypeIdsString());
+    predicates.append(createDateString());
+    predicates.append(createSourcesString());
+    predicates.append(createEventTypesString());
+    predicates.append(createLevelsString());
+    predicates.append(createValuesString());
+    predicates.removeAll(QString());
+
+    QString query = predicates.join("AND ");
     return query;
 }
 
@@ -187,6 +169,24 @@ QVariantList LogFilter::values() const
     return m_values;
 }
 
+/*! Returns the values to be bound to the placeholders of the \l{queryString}. */
+QVariantList LogFilter::bindValues() const
+{
+    // Each value is matched against the value and the numericValue column
+    QVariantList bindValues;
+    foreach (const QVariant &value, m_values) {
+        bindValues.append(value);
+        bindValues.append(value);
+    }
+    return bindValues;
+}
+
+/*! Returns a sub query selecting the id under which the given \a uuid is stored in the uuids table. */
+QString LogFilter::uuidIdQuery(const QUuid &uuid)
+{
+    return QString("(SELECT id FROM uuids WHERE uuid = '%1')").arg(uuid.toString());
+}
+
 /*! Set the maximum count for the result set. Unless a \l{offset} is specified,
  * the newest \a count entries will be returned. \sa{setOffset}
  */
@@ -228,6 +228,35 @@ int LogFilter::offset() const
     return m_offset;
 }
 
+/*! Set a cursor for keyset pagination. Only entries older than the entry with the given \a timestamp
+ * and \a rowId will be returned. Unlike the \l{offset}, the cost of fetching a page using a cursor does
+ * not grow with the number of preceding entries. If a cursor is set, the offset is ignored.
+ */
+void LogFilter::setCursor(qint64 timestamp, qint64 rowId)
+{
+    m_hasCursor = true;
+    m_cursorTimestamp = timestamp;
+    m_cursorRowId = rowId;
+}
+
+/*! Returns true if a cursor has been set on this \l{LogFilter}. \sa{setCursor} */
+bool LogFilter::hasCursor() const
+{
+    return m_hasCursor;
+}
+
+/*! Returns the timestamp of the cursor position. \sa{setCursor} */
+qint64 LogFilter::cursorTimestamp() const
+{
+    return m_cursorTimestamp;
+}
+
+/*! Returns the row id of the cursor position. \sa{setCursor} */
+qint64 LogFilter::cursorRowId() const
+{
+    return m_cursorRowId;
+}
+
 /*! Returns true if this \l{LogFilter} is empty. */
 bool LogFilter::isEmpty() const
 {
@@ -349,37 +378,32 @@ QString LogFilter::createEventTypesString() const
 
 QString LogFilter::createTypeIdsString() const
 {
-    QString query;
-    if (!m_typeIds.isEmpty()) {
-        if (m_typeIds.count() == 1) {
-            query.append(QString("typeId = '%1' ").arg(m_typeIds.first().toString()));
-        } else {
-            query.append("( ");
-            foreach (const QUuid &typeId, m_typeIds) {
-                query.append(QString("typeId = '%1' ").arg(typeId.toString()));
-                if (typeId != m_typeIds.last())
-                    query.append("OR ");
-            }
-            query.append(") ");
-        }
-    }
-    return query;
+    return createUuidIdsString("typeId", m_typeIds);
 }
 
 QString LogFilter::createThingIdString() const
 {
+    QList<QUuid> thingIds;
+    foreach (const ThingId &thingId, m_thingIds) {
+        thingIds.append(thingId);
+    }
+    return createUuidIdsString("thingId", thingIds);
+}
+
+QString LogFilter::createUuidIdsString(const QString &column, const QList<QUuid> &uuids) const
+{
+    // UUIDs are interned in the uuids table, the entries table only holds their ids
     QString query;
-    if (!m_thingIds.isEmpty()) {
-        if (m_thingIds.count() == 1) {
-            query.append(QString("thingId = '%1' ").arg(m_thingIds.first().toString()));
+    if (!uuids.isEmpty()) {
+        if (uuids.count() == 1) {
+            query.append(QString("%1 = %2 ").arg(column).arg(uuidIdQuery(uuids.first())));
         } else {
-            query.append("( ");
-            foreach (const ThingId &thingId, m_thingIds) {
-                query.append(QString("thingId = '%1' ").arg(thingId.toString()));
-                if (thingId != m_thingIds.last())
-                    query.append("OR ");
+            // IN allows index lookups, a chain of OR terms usually doesn't
+            QStringList uuidStrings;
+            foreach (const QUuid &uuid, uuids) {
+                uuidStrings.append(QString("'%1'").arg(uuid.toString()));
             }
-            query.append(") ");
+            query.append(QString("%1 IN (SELECT id FROM uuids WHERE uuid IN (%2)) ").arg(column).arg(uuidStrings.join(", ")));
         }
     }
     return query;
@@ -389,12 +413,13 @@ QString LogFilter::createValuesString() const
 {
     QString query;
     if (!m_values.isEmpty()) {
+        // Numeric values are stored in the numericValue column, others in the value column
         if (m_values.count() == 1) {
-            query.append("value = ? ");
+            query.append("(value = ? OR numericValue = ?) ");
         } else {
             query.append("( ");
             foreach (const QVariant &value, m_values) {
-                query.append("value = ? ");
+                query.append("(value = ? OR numericValue = ?) ");
                 if (value != m_values.last())
                     query.append("OR ");
             }
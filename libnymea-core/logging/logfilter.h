@@ -45,6 +45,9 @@ public:
     LogFilter();
 
     QString queryString() const;
+    QVariantList bindValues() const;
+
+    static QString uuidIdQuery(const QUuid &uuid);
 
 
     void addTimeFilter(const QDateTime &startDate = QDateTime(), const QDateTime &endDate = QDateTime());
@@ -77,6 +80,12 @@ public:
     void setOffset(int offset);
     int offset() const;
 
+    // Keyset pagination: only return entries older than the given position
+    void setCursor(qint64 timestamp, qint64 rowId);
+    bool hasCursor() const;
+    qint64 cursorTimestamp() const;
+    qint64 cursorRowId() const;
+
     bool isEmpty() const;
 
 private:
@@ -89,6 +98,9 @@ private:
     QVariantList m_values;
     int m_limit = -1;
     int m_offset = 0;
+    bool m_hasCursor = false;
+    qint64 m_cursorTimestamp = 0;
+    qint64 m_cursorRowId = 0;
 
     QString createDateString() const;
     QString createTimeFilterString(QPair<QDateTime, QDateTime> timeFilter) const;
@@ -97,6 +109,7 @@ private:
     QString createEventTypesString() const;
     QString createTypeIdsString() const;
     QString createThingIdString() const;
+    QString createUuidIdsString(const QString &column, const QList<QUuid> &uuids) const;
     QString createValuesString() const;
 };
 
@@ -0,0 +1,375 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::LogSegmentStorage
+    \brief Stores numeric state history in append-only, time partitioned segment files.
+
+    \ingroup logs
+    \inmodule core
+
+    Each segment file holds the values of one state within one time partition as fixed size
+    records, named after the start of the partition and the series id. Appending is a plain file
+    write and range scans memory map only the segments of the requested series overlapping the
+    requested range. Retention deletes whole segments instead of single rows. Segments without a
+    series id in their name hold the values of all states, as written by earlier versions. They
+    are scanned as a whole until they expire.
+
+    Things and state types are mapped to series ids in the series index file next to the segments.
+    The index also keeps the next free id. Ids of removed things are never handed out again, as
+    their records stay in the segments until those expire.
+
+    \sa LogStorageBackend, LogEngine
+*/
+
+#include "logsegmentstorage.h"
+#include "loggingcategories.h"
+
+#include <QDir>
+#include <QMap>
+#include <QSaveFile>
+#include <QTextStream>
+
+#include <algorithm>
+
+namespace nymeaserver {
+
+/*! Constructs a \l{LogSegmentStorage} keeping its files in the directory \a path. Each segment
+    covers \a segmentDuration seconds. Segments older than \a retentionDays are deleted, 0 disables
+    the retention. */
+LogSegmentStorage::LogSegmentStorage(const QString &path, int segmentDuration, int retentionDays, QObject *parent):
+    LogStorageBackend(parent),
+    m_path(path),
+    m_segmentDuration(qMax(60, segmentDuration) * 1000LL),
+    m_retentionDays(retentionDays)
+{
+    // A child, so it moves along into the thread of the storage
+    m_retentionTimer = new QTimer(this);
+    m_retentionTimer->setInterval(60 * 60 * 1000);
+    connect(m_retentionTimer, &QTimer::timeout, this, &LogSegmentStorage::applyRetention);
+}
+
+LogSegmentStorage::~LogSegmentStorage()
+{
+    closeSegments();
+}
+
+QString LogSegmentStorage::name() const
+{
+    return "segments";
+}
+
+bool LogSegmentStorage::init()
+{
+    if (!QDir().mkpath(m_path)) {
+        qCWarning(dcLogEngine()) << "Unable to create log segment directory" << m_path;
+        return false;
+    }
+
+    m_series.clear();
+    m_nextSeriesId = 1;
+    QFile indexFile(QDir(m_path).filePath("series.idx"));
+    if (indexFile.exists()) {
+        if (!indexFile.open(QFile::ReadOnly | QFile::Text)) {
+            qCWarning(dcLogEngine()) << "Unable to open log series index" << indexFile.fileName() << indexFile.errorString();
+            return false;
+        }
+        QTextStream stream(&indexFile);
+        while (!stream.atEnd()) {
+            QStringList parts = stream.readLine().split(' ', QString::SkipEmptyParts);
+            if (parts.count() == 2 && parts.first() == "next") {
+                m_nextSeriesId = qMax(m_nextSeriesId, parts.at(1).toUInt());
+                continue;
+            }
+            if (parts.count() != 3) {
+                continue;
+            }
+            quint32 id = parts.at(0).toUInt();
+            m_series.insert(Series(QUuid(parts.at(1)), QUuid(parts.at(2))), id);
+            m_nextSeriesId = qMax(m_nextSeriesId, id + 1);
+        }
+    }
+
+    applyRetention();
+    m_retentionTimer->start();
+
+    qCDebug(dcLogEngine()) << "Log segment storage initialized in" << m_path << "(" << m_series.count() << "series," << segments().count() << "segments)";
+    return true;
+}
+
+void LogSegmentStorage::appendStateValue(const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &timestamp, double value)
+{
+    Record record;
+    record.timestamp = timestamp.toMSecsSinceEpoch();
+    record.seriesId = seriesId(thingId, stateTypeId);
+    record.reserved = 0;
+    record.value = value;
+
+    qint64 partition = partitionStart(record.timestamp);
+    if (partition != m_currentPartition) {
+        closeSegments();
+        m_currentPartition = partition;
+    }
+
+    QFile *segment = m_openSegments.value(record.seriesId);
+    if (!segment) {
+        segment = openSegment(partition, record.seriesId);
+        if (!segment) {
+            return;
+        }
+    }
+
+    if (segment->write(reinterpret_cast<const char*>(&record), sizeof(Record)) != sizeof(Record)) {
+        qCWarning(dcLogEngine()) << "Error writing to log segment" << segment->fileName() << segment->errorString();
+    }
+}
+
+LogEntrySamples LogSegmentStorage::fetchStateSamples(const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &startTime, const QDateTime &endTime, int sampleCount)
+{
+    class Bucket {
+    public:
+        int count = 0;
+        double min = 0;
+        double max = 0;
+        double sum = 0;
+        qint64 lastTimestamp = 0;
+        double last = 0;
+    };
+
+    LogEntrySamples samples;
+    Series series(thingId, stateTypeId);
+    if (!m_series.contains(series)) {
+        return samples;
+    }
+    quint32 id = m_series.value(series);
+
+    qint64 start = startTime.toMSecsSinceEpoch();
+    qint64 end = endTime.toMSecsSinceEpoch();
+    qint64 bucketSize = qMax<qint64>(1, (end - start + sampleCount - 1) / qMax(1, sampleCount));
+
+    QMap<qint64, Bucket> buckets;
+    foreach (const QString &segment, segments()) {
+        qint64 partition = segment.section('.', 0, 0).toLongLong();
+        if (partition >= end || partition + m_segmentDuration <= start) {
+            continue;
+        }
+        // Skip the segments of other series, legacy segments without a series id hold all of them
+        QStringList parts = segment.split('.');
+        if (parts.count() == 3 && parts.at(1).toUInt() != id) {
+            continue;
+        }
+
+        QFile file(QDir(m_path).filePath(segment));
+        if (!file.open(QFile::ReadOnly)) {
+            qCWarning(dcLogEngine()) << "Unable to open log segment" << file.fileName() << file.errorString();
+            continue;
+        }
+        qint64 recordCount = file.size() / static_cast<qint64>(sizeof(Record));
+        if (recordCount == 0) {
+            continue;
+        }
+        uchar *data = file.map(0, recordCount * sizeof(Record));
+        if (!data) {
+            qCWarning(dcLogEngine()) << "Unable to map log segment" << file.fileName() << file.errorString();
+            continue;
+        }
+
+        const Record *records = reinterpret_cast<const Record*>(data);
+        for (qint64 i = 0; i < recordCount; i++) {
+            const Record &record = records[i];
+            if (record.seriesId != id || record.timestamp < start || record.timestamp >= end) {
+                continue;
+            }
+            Bucket &bucket = buckets[(record.timestamp - start) / bucketSize];
+            if (bucket.count == 0) {
+                bucket.min = record.value;
+                bucket.max = record.value;
+            } else {
+                bucket.min = qMin(bucket.min, record.value);
+                bucket.max = qMax(bucket.max, record.value);
+            }
+            bucket.count++;
+            bucket.sum += record.value;
+            if (record.timestamp >= bucket.lastTimestamp) {
+                bucket.lastTimestamp = record.timestamp;
+                bucket.last = record.value;
+            }
+        }
+        file.unmap(data);
+    }
+
+    for (QMap<qint64, Bucket>::const_iterator it = buckets.constBegin(); it != buckets.constEnd(); ++it) {
+        samples.append(LogEntrySample(QDateTime::fromMSecsSinceEpoch(start + it.key() * bucketSize),
+                                      it->count, it->min, it->max, it->sum / it->count, it->last));
+    }
+    return samples;
+}
+
+void LogSegmentStorage::removeThing(const ThingId &thingId)
+{
+    // Records in legacy segments stay until they expire, but without a series they are never returned
+    QList<quint32> removedIds;
+    for (QHash<Series, quint32>::iterator it = m_series.begin(); it != m_series.end(); ) {
+        if (it.key().first == thingId) {
+            removedIds.append(it.value());
+            it = m_series.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (removedIds.isEmpty()) {
+        return;
+    }
+    storeSeriesIndex();
+
+    foreach (quint32 id, removedIds) {
+        delete m_openSegments.take(id);
+        foreach (const QString &segment, QDir(m_path).entryList({QString("*.%1.seg").arg(id)}, QDir::Files)) {
+            QFile::remove(QDir(m_path).filePath(segment));
+        }
+    }
+}
+
+void LogSegmentStorage::clear()
+{
+    closeSegments();
+    m_currentPartition = -1;
+    foreach (const QString &segment, segments()) {
+        QFile::remove(QDir(m_path).filePath(segment));
+    }
+    m_series.clear();
+    m_nextSeriesId = 1;
+    storeSeriesIndex();
+}
+
+/*! Returns the file names of all segments, oldest first. */
+QStringList LogSegmentStorage::segments() const
+{
+    QStringList segments = QDir(m_path).entryList({"*.seg"}, QDir::Files);
+    std::sort(segments.begin(), segments.end(), [](const QString &a, const QString &b){
+        return a.section('.', 0, 0).toLongLong() < b.section('.', 0, 0).toLongLong();
+    });
+    return segments;
+}
+
+/*! Deletes all segments which are entirely older than the retention period. */
+void LogSegmentStorage::applyRetention()
+{
+    if (m_retentionDays <= 0) {
+        return;
+    }
+
+    qint64 cutoff = QDateTime::currentDateTime().addDays(-m_retentionDays).toMSecsSinceEpoch();
+    foreach (const QString &segment, segments()) {
+        qint64 partition = segment.section('.', 0, 0).toLongLong();
+        if (partition + m_segmentDuration > cutoff) {
+            // Sorted, all the following ones are newer
+            break;
+        }
+        if (partition == m_currentPartition) {
+            closeSegments();
+            m_currentPartition = -1;
+        }
+        qCDebug(dcLogEngine()) << "Removing expired log segment" << segment;
+        QFile::remove(QDir(m_path).filePath(segment));
+    }
+}
+
+quint32 LogSegmentStorage::seriesId(const ThingId &thingId, const StateTypeId &stateTypeId)
+{
+    Series series(thingId, stateTypeId);
+    if (m_series.contains(series)) {
+        return m_series.value(series);
+    }
+
+    quint32 id = m_nextSeriesId++;
+    m_series.insert(series, id);
+    storeSeriesIndex();
+    return id;
+}
+
+bool LogSegmentStorage::storeSeriesIndex()
+{
+    QSaveFile indexFile(QDir(m_path).filePath("series.idx"));
+    if (!indexFile.open(QFile::WriteOnly | QFile::Text)) {
+        qCWarning(dcLogEngine()) << "Unable to write log series index" << indexFile.fileName() << indexFile.errorString();
+        return false;
+    }
+    QTextStream stream(&indexFile);
+    stream << "next " << m_nextSeriesId << '\n';
+    for (QHash<Series, quint32>::const_iterator it = m_series.constBegin(); it != m_series.constEnd(); ++it) {
+        stream << it.value() << ' ' << it.key().first.toString() << ' ' << it.key().second.toString() << '\n';
+    }
+    stream.flush();
+    return indexFile.commit();
+}
+
+qint64 LogSegmentStorage::partitionStart(qint64 timestamp) const
+{
+    return timestamp - (timestamp % m_segmentDuration);
+}
+
+QString LogSegmentStorage::segmentFileName(qint64 partitionStart, quint32 seriesId) const
+{
+    return QDir(m_path).filePath(QString("%1.%2.seg").arg(partitionStart).arg(seriesId));
+}
+
+QFile *LogSegmentStorage::openSegment(qint64 partitionStart, quint32 seriesId)
+{
+    // Don't run out of file descriptors with lots of series, reopening is cheap
+    if (m_openSegments.count() >= 64) {
+        closeSegments();
+    }
+
+    // Unbuffered, so every record is visible to fetches and other instances right away
+    QFile *segment = new QFile(segmentFileName(partitionStart, seriesId));
+    if (!segment->open(QFile::WriteOnly | QFile::Append | QFile::Unbuffered)) {
+        qCWarning(dcLogEngine()) << "Unable to open log segment" << segment->fileName() << segment->errorString();
+        delete segment;
+        return nullptr;
+    }
+
+    // Drop a partially written record, e.g. after a power loss
+    qint64 excess = segment->size() % static_cast<qint64>(sizeof(Record));
+    if (excess > 0) {
+        segment->resize(segment->size() - excess);
+    }
+
+    m_openSegments.insert(seriesId, segment);
+    return segment;
+}
+
+void LogSegmentStorage::closeSegments()
+{
+    qDeleteAll(m_openSegments);
+    m_openSegments.clear();
+}
+
+}
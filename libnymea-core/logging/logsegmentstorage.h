@@ -0,0 +1,98 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef LOGSEGMENTSTORAGE_H
+#define LOGSEGMENTSTORAGE_H
+
+#include "logstoragebackend.h"
+
+#include <QObject>
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QTimer>
+
+namespace nymeaserver {
+
+class LogSegmentStorage: public LogStorageBackend
+{
+    Q_OBJECT
+public:
+    explicit LogSegmentStorage(const QString &path, int segmentDuration = 86400, int retentionDays = 30, QObject *parent = nullptr);
+    ~LogSegmentStorage() override;
+
+    QString name() const override;
+    bool init() override;
+
+    void appendStateValue(const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &timestamp, double value) override;
+    LogEntrySamples fetchStateSamples(const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &startTime, const QDateTime &endTime, int sampleCount) override;
+
+    void removeThing(const ThingId &thingId) override;
+    void clear() override;
+
+    QStringList segments() const;
+
+public slots:
+    void applyRetention();
+
+private:
+    typedef QPair<QUuid, QUuid> Series;
+
+    // Fixed size record, written in host byte order
+    struct Record {
+        qint64 timestamp;
+        quint32 seriesId;
+        quint32 reserved;
+        double value;
+    };
+
+    quint32 seriesId(const ThingId &thingId, const StateTypeId &stateTypeId);
+    bool storeSeriesIndex();
+    qint64 partitionStart(qint64 timestamp) const;
+    QString segmentFileName(qint64 partitionStart, quint32 seriesId) const;
+    QFile *openSegment(qint64 partitionStart, quint32 seriesId);
+    void closeSegments();
+
+    QString m_path;
+    qint64 m_segmentDuration;
+    int m_retentionDays;
+
+    QHash<Series, quint32> m_series;
+    quint32 m_nextSeriesId = 1;
+
+    // Segments of the current partition opened for appending, by series id
+    QHash<quint32, QFile*> m_openSegments;
+    qint64 m_currentPartition = -1;
+    QTimer *m_retentionTimer = nullptr;
+};
+
+}
+
+#endif // LOGSEGMENTSTORAGE_H
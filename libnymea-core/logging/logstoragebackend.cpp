@@ -0,0 +1,94 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::LogStorageBackend
+    \brief Interface for storing the numeric state history outside of the log database.
+
+    \ingroup logs
+    \inmodule core
+
+    By default the \l{LogEngine} keeps all entries, including state changes, in its SQL database.
+    A \l{LogStorageBackend} can be installed to additionally keep numeric state values in a store
+    which is better suited for high rate time series. Sampled history is then served from it.
+
+    The \l{LogEngine} moves the backend into a thread of its own and calls it through queued
+    invocations, so the methods of a backend are never called concurrently and may block on I/O.
+
+    \sa LogEngine, LogSegmentStorage
+*/
+
+/*! \fn QString nymeaserver::LogStorageBackend::name() const
+    Returns the name of this backend as used in the configuration.
+*/
+
+/*! \fn bool nymeaserver::LogStorageBackend::init()
+    Opens the storage. Returns false if it can't be used.
+*/
+
+/*! \fn void nymeaserver::LogStorageBackend::appendStateValue(const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &timestamp, double value)
+    Stores the \a value of the state with \a stateTypeId of the thing with \a thingId at \a timestamp.
+*/
+
+/*! \fn LogEntrySamples nymeaserver::LogStorageBackend::fetchStateSamples(const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &startTime, const QDateTime &endTime, int sampleCount)
+    Aggregates the stored values between \a startTime and \a endTime into \a sampleCount equally sized buckets.
+    Empty buckets are omitted.
+*/
+
+/*! \fn void nymeaserver::LogStorageBackend::removeThing(const ThingId &thingId)
+    Removes all values of the thing with \a thingId.
+*/
+
+/*! \fn void nymeaserver::LogStorageBackend::clear()
+    Removes all stored values.
+*/
+
+/*! \fn void nymeaserver::LogStorageBackend::stateSamplesFetched(int requestId, const LogEntrySamples &samples)
+    Emitted with the \a samples fetched for the request with \a requestId.
+    \sa requestStateSamples()
+*/
+
+#include "logstoragebackend.h"
+
+namespace nymeaserver {
+
+LogStorageBackend::LogStorageBackend(QObject *parent): QObject(parent)
+{
+
+}
+
+/*! Runs \l{fetchStateSamples()} for the given arguments and emits \l{stateSamplesFetched()} with
+    \a requestId and the result. Used to fetch samples from the thread of the backend. */
+void LogStorageBackend::requestStateSamples(int requestId, const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &startTime, const QDateTime &endTime, int sampleCount)
+{
+    emit stateSamplesFetched(requestId, fetchStateSamples(thingId, stateTypeId, startTime, endTime, sampleCount));
+}
+
+}
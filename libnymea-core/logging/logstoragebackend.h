@@ -0,0 +1,67 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef LOGSTORAGEBACKEND_H
+#define LOGSTORAGEBACKEND_H
+
+#include "logentrysample.h"
+#include "typeutils.h"
+
+#include <QObject>
+#include <QDateTime>
+
+namespace nymeaserver {
+
+class LogStorageBackend: public QObject
+{
+    Q_OBJECT
+public:
+    explicit LogStorageBackend(QObject *parent = nullptr);
+    virtual ~LogStorageBackend() = default;
+
+    virtual QString name() const = 0;
+    virtual bool init() = 0;
+
+    Q_INVOKABLE virtual void appendStateValue(const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &timestamp, double value) = 0;
+    virtual LogEntrySamples fetchStateSamples(const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &startTime, const QDateTime &endTime, int sampleCount) = 0;
+
+    Q_INVOKABLE virtual void removeThing(const ThingId &thingId) = 0;
+    Q_INVOKABLE virtual void clear() = 0;
+
+public slots:
+    void requestStateSamples(int requestId, const ThingId &thingId, const StateTypeId &stateTypeId, const QDateTime &startTime, const QDateTime &endTime, int sampleCount);
+
+signals:
+    void stateSamplesFetched(int requestId, const LogEntrySamples &samples);
+};
+
+}
+
+#endif // LOGSTORAGEBACKEND_H
@@ -56,6 +56,20 @@ QString LogValueTool::convertVariantToString(const QVariant &value)
     }
 }
 
+bool LogValueTool::isNumeric(const QVariant &value)
+{
+    switch (value.type()) {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+    case QVariant::Double:
+        return true;
+    default:
+        return static_cast<QMetaType::Type>(value.type()) == QMetaType::Float;
+    }
+}
+
 QString LogValueTool::serializeValue(const QVariant &value)
 {
     QByteArray byteArray;
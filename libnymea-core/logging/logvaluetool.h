@@ -41,6 +41,7 @@ public:
     explicit LogValueTool(QObject *parent = nullptr);
 
     static QString convertVariantToString(const QVariant &value);
+    static bool isNumeric(const QVariant &value);
     static QString serializeValue(const QVariant &value);
     static QVariant deserializeValue(const QString &serializedValue);
 };
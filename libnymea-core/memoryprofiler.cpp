@@ -0,0 +1,270 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*!
+    \class nymeaserver::MemoryProfiler
+    \brief Reports the memory usage of nymead at runtime.
+
+    \ingroup core
+    \inmodule core
+
+    Memory growth on a running system is hard to chase down once the daemon is restarted under a heap profiler,
+    as the state leading to it is gone. The memory profiler is exposed on the debug server instead and reports
+    the resident set size, the heap usage of the allocator and the number of objects held by the major
+    subsystems.
+
+    With NYMEA_MEMORY_SNAPSHOT_INTERVAL set to a number of seconds, a snapshot of these is taken periodically
+    and the last 360 snapshots are kept, so the growth over time can be seen. The detailed allocator state is
+    available through malloc_info() on glibc. When nymead runs with jemalloc (built with profiling and started
+    with MALLOC_CONF=prof:true) or tcmalloc preloaded, a heap profile can be dumped on request.
+*/
+
+#include "memoryprofiler.h"
+#include "nymeacore.h"
+#include "eventqueue.h"
+#include "integrations/thingmanager.h"
+#include "ruleengine/ruleengine.h"
+#include "loggingcategories.h"
+
+#include <QCoreApplication>
+#include <QMetaEnum>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+Q_DECLARE_LOGGING_CATEGORY(dcCore)
+
+namespace nymeaserver {
+
+static const int maxSnapshots = 360;
+
+typedef int (*MallctlFunction)(const char *name, void *oldp, size_t *oldlenp, void *newp, size_t newlen);
+typedef void (*HeapProfilerStartFunction)(const char *prefix);
+typedef void (*HeapProfilerDumpFunction)(const char *reason);
+typedef int (*IsHeapProfilerRunningFunction)();
+
+static qint64 residentSetSize()
+{
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QFile::ReadOnly)) {
+        return 0;
+    }
+    // The resident size is given in pages, which aren't 4k everywhere (e.g. 16k or 64k on some arm64 kernels)
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    return fields.count() > 1 ? fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE) : 0;
+}
+
+MemoryProfiler::MemoryProfiler(QObject *parent):
+    QObject(parent)
+{
+    // The allocator in use provides its own symbols, whether linked or preloaded
+    if (dlsym(RTLD_DEFAULT, "mallctl")) {
+        m_allocator = AllocatorJemalloc;
+    } else if (dlsym(RTLD_DEFAULT, "HeapProfilerDump") || dlsym(RTLD_DEFAULT, "MallocExtension_GetNumericProperty")) {
+        m_allocator = AllocatorTcmalloc;
+    } else {
+#ifdef __GLIBC__
+        m_allocator = AllocatorGlibc;
+#endif
+    }
+
+    int interval = qEnvironmentVariableIntValue("NYMEA_MEMORY_SNAPSHOT_INTERVAL");
+    if (interval > 0) {
+        qCInfo(dcCore()) << "Taking memory snapshots every" << interval << "seconds";
+        connect(&m_snapshotTimer, &QTimer::timeout, this, &MemoryProfiler::takeSnapshot);
+        m_snapshotTimer.start(interval * 1000);
+    }
+}
+
+MemoryProfiler::Allocator MemoryProfiler::allocator() const
+{
+    return m_allocator;
+}
+
+/*! Returns the current memory usage, along with the periodic snapshots taken so far. */
+QVariantMap MemoryProfiler::statistics() const
+{
+    Snapshot snapshot = currentSnapshot();
+    QVariantMap statistics = toMap(snapshot);
+    statistics.insert("peakRss", qMax(m_peakRss, snapshot.rss));
+    statistics.insert("allocator", QString(QMetaEnum::fromType<Allocator>().valueToKey(m_allocator)).remove("Allocator").toLower());
+    statistics.insert("snapshotInterval", m_snapshotTimer.isActive() ? m_snapshotTimer.interval() / 1000 : 0);
+    QVariantList snapshots;
+    foreach (const Snapshot &entry, m_snapshots) {
+        snapshots.append(toMap(entry));
+    }
+    statistics.insert("snapshots", snapshots);
+    return statistics;
+}
+
+/*! Returns the XML document of malloc_info(), describing the state of each glibc malloc arena. */
+QByteArray MemoryProfiler::mallocInfo() const
+{
+    QByteArray info;
+#ifdef __GLIBC__
+    char *buffer = nullptr;
+    size_t size = 0;
+    FILE *stream = open_memstream(&buffer, &size);
+    if (!stream) {
+        return info;
+    }
+    malloc_info(0, stream);
+    fclose(stream);
+    info = QByteArray(buffer, static_cast<int>(size));
+    free(buffer);
+#endif
+    return info;
+}
+
+/*! Returns free heap memory to the system. Returns false if the allocator does not support this. */
+bool MemoryProfiler::trim()
+{
+#ifdef __GLIBC__
+    if (m_allocator == AllocatorGlibc) {
+        qint64 before = residentSetSize();
+        malloc_trim(0);
+        qCInfo(dcCore()) << "Trimmed heap, RSS" << before / 1024 << "kB ->" << residentSetSize() / 1024 << "kB";
+        return true;
+    }
+#endif
+    return false;
+}
+
+/*! Writes a heap profile of jemalloc or tcmalloc and returns its file name. Returns an empty string and
+    sets \a errorMessage if no profile could be written. */
+QString MemoryProfiler::dumpHeapProfile(QString *errorMessage)
+{
+    QString prefix = QDir::temp().filePath(QString("nymead-%1").arg(QCoreApplication::applicationPid()));
+
+    if (m_allocator == AllocatorJemalloc) {
+        MallctlFunction mallctl = reinterpret_cast<MallctlFunction>(dlsym(RTLD_DEFAULT, "mallctl"));
+        bool active = false;
+        size_t length = sizeof(active);
+        if (mallctl("opt.prof", &active, &length, nullptr, 0) != 0 || !active) {
+            *errorMessage = "jemalloc profiling is not enabled. Start nymead with MALLOC_CONF=prof:true.";
+            return QString();
+        }
+        QByteArray fileName = QString("%1-%2.heap").arg(prefix).arg(QDateTime::currentMSecsSinceEpoch()).toLocal8Bit();
+        const char *name = fileName.constData();
+        if (mallctl("prof.dump", nullptr, nullptr, &name, sizeof(name)) != 0) {
+            *errorMessage = "jemalloc failed to write the heap profile.";
+            return QString();
+        }
+        return QString::fromLocal8Bit(fileName);
+    }
+
+    if (m_allocator == AllocatorTcmalloc) {
+        HeapProfilerStartFunction heapProfilerStart = reinterpret_cast<HeapProfilerStartFunction>(dlsym(RTLD_DEFAULT, "HeapProfilerStart"));
+        HeapProfilerDumpFunction heapProfilerDump = reinterpret_cast<HeapProfilerDumpFunction>(dlsym(RTLD_DEFAULT, "HeapProfilerDump"));
+        IsHeapProfilerRunningFunction isHeapProfilerRunning = reinterpret_cast<IsHeapProfilerRunningFunction>(dlsym(RTLD_DEFAULT, "IsHeapProfilerRunning"));
+        if (!heapProfilerStart || !heapProfilerDump || !isHeapProfilerRunning) {
+            *errorMessage = "The heap profiler of tcmalloc is not available. Preload libtcmalloc_and_profiler.";
+            return QString();
+        }
+        // Allocations are only recorded from here on, the first dump shows little
+        if (!isHeapProfilerRunning()) {
+            qCInfo(dcCore()) << "Starting the tcmalloc heap profiler";
+            heapProfilerStart(prefix.toLocal8Bit().constData());
+        }
+        heapProfilerDump("debug server request");
+        QFileInfo fileInfo(prefix);
+        QFileInfoList dumps = fileInfo.dir().entryInfoList({fileInfo.fileName() + ".*.heap"}, QDir::Files, QDir::Time);
+        if (dumps.isEmpty()) {
+            *errorMessage = "tcmalloc did not write a heap profile.";
+            return QString();
+        }
+        return dumps.first().absoluteFilePath();
+    }
+
+    *errorMessage = "Heap profiles need nymead to run with jemalloc or tcmalloc.";
+    return QString();
+}
+
+void MemoryProfiler::takeSnapshot()
+{
+    Snapshot snapshot = currentSnapshot();
+    m_peakRss = qMax(m_peakRss, snapshot.rss);
+    m_snapshots.append(snapshot);
+    if (m_snapshots.count() > maxSnapshots) {
+        m_snapshots.removeFirst();
+    }
+}
+
+MemoryProfiler::Snapshot MemoryProfiler::currentSnapshot() const
+{
+    Snapshot snapshot;
+    snapshot.timestamp = QDateTime::currentDateTime();
+    snapshot.rss = residentSetSize();
+
+#ifdef __GLIBC__
+    if (m_allocator == AllocatorGlibc) {
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33)
+        struct mallinfo2 info = mallinfo2();
+#else
+        struct mallinfo info = mallinfo();
+#endif
+        snapshot.heapInUse = static_cast<qint64>(info.uordblks) + static_cast<qint64>(info.hblkhd);
+        snapshot.heapFree = static_cast<qint64>(info.fordblks);
+    }
+#endif
+
+    NymeaCore *core = NymeaCore::instance();
+    int states = 0;
+    foreach (Thing *thing, core->thingManager()->configuredThings()) {
+        states += thing->states().count();
+    }
+    snapshot.subsystems.insert("things", core->thingManager()->configuredThings().count());
+    snapshot.subsystems.insert("states", states);
+    snapshot.subsystems.insert("rules", core->ruleEngine()->ruleIds().count());
+    snapshot.subsystems.insert("queuedEvents", core->eventQueue()->depth());
+    return snapshot;
+}
+
+QVariantMap MemoryProfiler::toMap(const Snapshot &snapshot)
+{
+    QVariantMap map;
+    map.insert("timestamp", snapshot.timestamp.toMSecsSinceEpoch());
+    map.insert("rss", snapshot.rss);
+    if (snapshot.heapInUse >= 0) {
+        map.insert("heapInUse", snapshot.heapInUse);
+        map.insert("heapFree", snapshot.heapFree);
+    }
+    map.insert("subsystems", snapshot.subsystems);
+    return map;
+}
+
+}
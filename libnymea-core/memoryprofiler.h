@@ -0,0 +1,86 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#ifndef MEMORYPROFILER_H
+#define MEMORYPROFILER_H
+
+#include <QObject>
+#include <QList>
+#include <QTimer>
+#include <QVariantMap>
+#include <QDateTime>
+
+namespace nymeaserver {
+
+class MemoryProfiler : public QObject
+{
+    Q_OBJECT
+public:
+    enum Allocator {
+        AllocatorUnknown,
+        AllocatorGlibc,
+        AllocatorJemalloc,
+        AllocatorTcmalloc
+    };
+    Q_ENUM(Allocator)
+
+    explicit MemoryProfiler(QObject *parent = nullptr);
+
+    Allocator allocator() const;
+
+    QVariantMap statistics() const;
+    QByteArray mallocInfo() const;
+    bool trim();
+    QString dumpHeapProfile(QString *errorMessage);
+
+private slots:
+    void takeSnapshot();
+
+private:
+    class Snapshot {
+    public:
+        QDateTime timestamp;
+        qint64 rss = 0;
+        qint64 heapInUse = -1;
+        qint64 heapFree = -1;
+        QVariantMap subsystems;
+    };
+
+    Snapshot currentSnapshot() const;
+    static QVariantMap toMap(const Snapshot &snapshot);
+
+    Allocator m_allocator = AllocatorUnknown;
+    QTimer m_snapshotTimer;
+    QList<Snapshot> m_snapshots;
+    qint64 m_peakRss = 0;
+};
+
+}
+
+#endif // MEMORYPROFILER_H
@@ -219,6 +219,41 @@ NymeaConfiguration::NymeaConfiguration(QObject *parent) :
     settings.setValue("logDBUser", logDBUser());
     settings.setValue("logDBPassword", logDBPassword());
     settings.setValue("logDBMaxEntries", logDBMaxEntries());
+    settings.setValue("logDBBatchSize", logDBBatchSize());
+    settings.setValue("logDBBatchInterval", logDBBatchInterval());
+    settings.setValue("logDBReadConnections", logDBReadConnections());
+    settings.setValue("logDBStateMinInterval", logDBStateMinInterval());
+    settings.setValue("logDBStateStorage", logDBStateStorage());
+    settings.setValue("logDBSegmentDuration", logDBSegmentDuration());
+    settings.setValue("logDBSegmentRetention", logDBSegmentRetention());
+    settings.setValue("logStateHistorySize", logStateHistorySize());
+    settings.setValue("logColumnCacheWindow", logColumnCacheWindow());
+    settings.endGroup();
+
+    // Write defaults for the MQTT state export
+    settings.beginGroup("MqttStateExport");
+    settings.setValue("enabled", mqttStateExportEnabled());
+    settings.setValue("topicPrefix", mqttStateExportTopicPrefix());
+    settings.setValue("retained", mqttStateExportRetained());
+    settings.setValue("interval", mqttStateExportInterval());
+    settings.endGroup();
+
+    // Write defaults for the MQTT broker limits
+    settings.beginGroup("MqttBroker");
+    settings.setValue("clientOutboundLimit", mqttClientOutboundLimit());
+    settings.setValue("slowClientPolicy", mqttSlowClientPolicy());
+    settings.setValue("maxPendingMessages", mqttMaxPendingMessages());
+    settings.endGroup();
+
+    // Write defaults for the event queue
+    settings.beginGroup("EventQueue");
+    settings.setValue("sliceBudget", eventQueueSliceBudget());
+    settings.endGroup();
+
+    // Write defaults for the JSON-RPC server limits
+    settings.beginGroup("JsonRpc");
+    settings.setValue("maxInFlightCalls", jsonRpcMaxInFlightCalls());
+    settings.setValue("validationSampleRate", jsonRpcValidationSampleRate());
     settings.endGroup();
 }
 
@@ -555,6 +590,229 @@ int NymeaConfiguration::logDBMaxEntries() const
     return settings.value("logDBMaxEntries", 200000).toInt();
 }
 
+int NymeaConfiguration::logDBBatchSize() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Logs");
+    return settings.value("logDBBatchSize", 100).toInt();
+}
+
+int NymeaConfiguration::logDBBatchInterval() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Logs");
+    return settings.value("logDBBatchInterval", 0).toInt();
+}
+
+int NymeaConfiguration::logDBReadConnections() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Logs");
+    return settings.value("logDBReadConnections", 2).toInt();
+}
+
+int NymeaConfiguration::logDBStateMinInterval() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Logs");
+    return settings.value("logDBStateMinInterval", 0).toInt();
+}
+
+QString NymeaConfiguration::logDBStateStorage() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Logs");
+    return settings.value("logDBStateStorage", "sql").toString();
+}
+
+int NymeaConfiguration::logDBSegmentDuration() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Logs");
+    return settings.value("logDBSegmentDuration", 86400).toInt();
+}
+
+int NymeaConfiguration::logDBSegmentRetention() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Logs");
+    return settings.value("logDBSegmentRetention", 30).toInt();
+}
+
+int NymeaConfiguration::logStateHistorySize() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Logs");
+    return settings.value("logStateHistorySize", 60).toInt();
+}
+
+int NymeaConfiguration::logColumnCacheWindow() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Logs");
+    return settings.value("logColumnCacheWindow", 0).toInt();
+}
+
+bool NymeaConfiguration::mqttStateExportEnabled() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("MqttStateExport");
+    return settings.value("enabled", false).toBool();
+}
+
+QString NymeaConfiguration::mqttStateExportTopicPrefix() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("MqttStateExport");
+    return settings.value("topicPrefix", "nymea/things").toString();
+}
+
+bool NymeaConfiguration::mqttStateExportRetained() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("MqttStateExport");
+    return settings.value("retained", true).toBool();
+}
+
+int NymeaConfiguration::mqttStateExportInterval() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("MqttStateExport");
+    return settings.value("interval", 0).toInt();
+}
+
+int NymeaConfiguration::mqttClientOutboundLimit() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("MqttBroker");
+    return settings.value("clientOutboundLimit", 1048576).toInt();
+}
+
+QString NymeaConfiguration::mqttSlowClientPolicy() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("MqttBroker");
+    return settings.value("slowClientPolicy", "drop").toString();
+}
+
+int NymeaConfiguration::mqttMaxPendingMessages() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("MqttBroker");
+    return settings.value("maxPendingMessages", 10000).toInt();
+}
+
+// The Replication group is not written with defaults, it holds the shared secret and
+// replication stays disabled as long as neither listenAddress nor primary is set.
+QString NymeaConfiguration::replicationListenAddress() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Replication");
+    return settings.value("listenAddress").toString();
+}
+
+QString NymeaConfiguration::replicationPrimary() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Replication");
+    return settings.value("primary").toString();
+}
+
+QByteArray NymeaConfiguration::replicationSecret() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Replication");
+    return settings.value("secret").toString().toUtf8();
+}
+
+int NymeaConfiguration::replicationBacklogSize() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Replication");
+    return settings.value("backlogSize", 100000).toInt();
+}
+
+// Like the Replication group, the Federation group holds a credential and is not written with defaults.
+// The certificates of the peers are pinned in the FederationCertificates group.
+QStringList NymeaConfiguration::federationPeers() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Federation");
+    return settings.value("peers").toStringList();
+}
+
+QByteArray NymeaConfiguration::federationToken() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Federation");
+    return settings.value("token").toString().toUtf8();
+}
+
+// Names of the plugins to run in a nymea-pluginhost process each, "*" for all of them
+QStringList NymeaConfiguration::pluginHostPlugins() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("PluginHost");
+    return settings.value("plugins").toStringList();
+}
+
+// A command the plugin hosts are started with, "%1" is replaced by the plugin name
+QString NymeaConfiguration::pluginHostCommand() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("PluginHost");
+    return settings.value("command").toString();
+}
+
+// Time in ms the event queue delivers events within one event loop iteration
+int NymeaConfiguration::eventQueueSliceBudget() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("EventQueue");
+    return settings.value("sliceBudget", 10).toInt();
+}
+
+// Asynchronous calls a single client may have running at once, 0 disables the limit
+int NymeaConfiguration::jsonRpcMaxInFlightCalls() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("JsonRpc");
+    return settings.value("maxInFlightCalls", 32).toInt();
+}
+
+// Release builds validate one of every n outgoing messages against the API, 0 disables it
+int NymeaConfiguration::jsonRpcValidationSampleRate() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("JsonRpc");
+    return settings.value("validationSampleRate", 0).toInt();
+}
+
+LogRateLimits NymeaConfiguration::logDBRateLimits() const
+{
+    LogRateLimits rateLimits;
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Logs");
+    settings.beginGroup("RateLimits");
+    foreach (const QString &group, settings.childGroups()) {
+        settings.beginGroup(group);
+        LogRateLimit rateLimit;
+        rateLimit.thingId = settings.value("thingId").toUuid();
+        rateLimit.stateTypeId = settings.value("stateTypeId").toUuid();
+        rateLimit.minInterval = settings.value("minInterval", 0).toInt();
+        rateLimit.deadband = settings.value("deadband", 0).toDouble();
+        settings.endGroup();
+        if (rateLimit.stateTypeId.isNull()) {
+            qCWarning(dcConfiguration()) << "Ignoring log rate limit" << group << "without a stateTypeId";
+            continue;
+        }
+        rateLimits.append(rateLimit);
+    }
+    settings.endGroup();
+    settings.endGroup();
+    return rateLimits;
+}
+
 QString NymeaConfiguration::sslCertificate() const
 {
     NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
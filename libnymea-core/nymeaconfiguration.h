@@ -93,6 +93,17 @@ public:
 };
 typedef QList<MqttPolicy> MqttPolicies;
 
+class LogRateLimit
+{
+public:
+    // A null thingId applies the limit to the state type on all things
+    QUuid thingId;
+    QUuid stateTypeId;
+    int minInterval = 0;
+    double deadband = 0;
+};
+typedef QList<LogRateLimit> LogRateLimits;
+
 class NymeaConfiguration : public QObject
 {
     Q_OBJECT
@@ -180,6 +191,48 @@ public:
     QString logDBUser() const;
     QString logDBPassword() const;
     int logDBMaxEntries() const;
+    int logDBBatchSize() const;
+    int logDBBatchInterval() const;
+    int logDBReadConnections() const;
+    int logDBStateMinInterval() const;
+    LogRateLimits logDBRateLimits() const;
+    QString logDBStateStorage() const;
+    int logDBSegmentDuration() const;
+    int logDBSegmentRetention() const;
+    int logStateHistorySize() const;
+    int logColumnCacheWindow() const;
+
+    // MQTT state export
+    bool mqttStateExportEnabled() const;
+    QString mqttStateExportTopicPrefix() const;
+    bool mqttStateExportRetained() const;
+    int mqttStateExportInterval() const;
+
+    // MQTT broker limits
+    int mqttClientOutboundLimit() const;
+    QString mqttSlowClientPolicy() const;
+    int mqttMaxPendingMessages() const;
+
+    // Replication
+    QString replicationListenAddress() const;
+    QString replicationPrimary() const;
+    QByteArray replicationSecret() const;
+    int replicationBacklogSize() const;
+
+    // Federation
+    QStringList federationPeers() const;
+    QByteArray federationToken() const;
+
+    // Plugin host
+    QStringList pluginHostPlugins() const;
+    QString pluginHostCommand() const;
+
+    // Event queue
+    int eventQueueSliceBudget() const;
+
+    // JSON-RPC
+    int jsonRpcMaxInFlightCalls() const;
+    int jsonRpcValidationSampleRate() const;
 
 private:
     QHash<QString, ServerConfiguration> m_tcpServerConfigs;
@@ -35,6 +35,7 @@
 #include "ruleengine/ruleengine.h"
 #include "nymeasettings.h"
 #include "tagging/tagsstorage.h"
+#include "logging/logsegmentstorage.h"
 #include "platform/platform.h"
 #include "experiences/experiencemanager.h"
 #include "platform/platformsystemcontroller.h"
@@ -43,6 +44,7 @@
 #include "jsonrpc/scriptshandler.h"
 
 #include "integrations/thingmanagerimplementation.h"
+#include "integrations/thingstatesnapshots.h"
 #include "integrations/thing.h"
 #include "integrations/thingactioninfo.h"
 #include "integrations/browseractioninfo.h"
@@ -55,11 +57,19 @@
 
 #include "hardware/modbus/modbusrtumanager.h"
 #include "hardware/serialport/serialportmonitor.h"
+#include "servers/mqttstateexporter.h"
+#include "startuptrace.h"
+#include "eventqueue.h"
+#include "memoryprofiler.h"
+#include "federation/federationmanager.h"
+#include "replication/replicationprimary.h"
 
 #include <networkmanager.h>
 
 #include <QDir>
+#include <QFileInfo>
 #include <QCoreApplication>
+#include <QFuture>
 
 NYMEA_LOGGING_CATEGORY(dcCore, "Core")
 
@@ -86,11 +96,26 @@ NymeaCore::NymeaCore(QObject *parent) :
 void NymeaCore::init(const QStringList &additionalInterfaces) {
     qCDebug(dcCore()) << "Initializing NymeaCore";
 
+    // Subsystems are created in the order of their dependencies, the timings of the individual
+    // phases tell where startup time goes on slow devices.
+    StartupTrace::start();
+    qint64 phaseStart = StartupTrace::now();
+    auto phaseFinished = [&phaseStart](const char *phase) {
+        StartupTrace::record("core", phase, phaseStart);
+        qint64 now = StartupTrace::now();
+        qCInfo(dcCore()).nospace() << phase << " initialized in " << (now - phaseStart) / 1000 << " ms";
+        phaseStart = now;
+    };
+
     qCDebug(dcPlatform()) << "Loading platform abstraction";
     m_platform = new Platform(this);
 
     qCDebug(dcCore()) << "Loading nymea configurations" << NymeaSettings(NymeaSettings::SettingsRoleGlobal).fileName();
     m_configuration = new NymeaConfiguration(this);
+    phaseFinished("Configuration");
+
+    // Nothing else depends on the certificate until the servers get created
+    QFuture<void> certificateGeneration = ServerManager::generateMissingCertificate(m_configuration);
 
     qCDebug(dcCore()) << "Creating Time Manager";
     // Migration path: nymea < 0.18 doesn't use system time zone but stores its own time zone in the config
@@ -101,54 +126,92 @@ void NymeaCore::init(const QStringList &additionalInterfaces) {
         }
     }
     m_timeManager = new TimeManager(this);
+    phaseFinished("Time manager");
 
     qCDebug(dcCore()) << "Creating User Manager";
     m_userManager = new UserManager(NymeaSettings::settingsPath() + "/user-db.sqlite", this);
+    phaseFinished("User manager");
 
     qCDebug(dcCore) << "Creating Server Manager";
+    certificateGeneration.waitForFinished();
     m_serverManager = new ServerManager(m_platform, m_configuration, additionalInterfaces, this);
+    phaseFinished("Server manager");
 
     qCDebug(dcCore()) << "Create Zigbee Manager";
     m_zigbeeManager = new ZigbeeManager(this);
+    phaseFinished("Zigbee manager");
 
     qCDebug(dcCore()) << "Create Serial Port Monitor";
     m_serialPortMonitor = new SerialPortMonitor(this);
 
     qCDebug(dcCore()) << "Create Modbus RTU Manager";
     m_modbusRtuManager = new ModbusRtuManager(m_serialPortMonitor, this);
+    phaseFinished("Modbus RTU manager");
 
     qCDebug(dcCore) << "Creating Hardware Manager";
     m_hardwareManager = new HardwareManagerImplementation(m_platform, m_serverManager->mqttBroker(), m_zigbeeManager, m_modbusRtuManager, this);
+    phaseFinished("Hardware manager");
 
     qCDebug(dcCore) << "Creating Thing Manager (locale:" << m_configuration->locale() << ")";
     m_thingManager = new ThingManagerImplementation(m_hardwareManager, m_configuration->locale(), this);
+    m_thingManager->setPluginHostConfiguration(m_configuration->pluginHostPlugins(), m_configuration->pluginHostCommand());
+    m_thingStateSnapshots = new ThingStateSnapshots(m_thingManager, this);
+    phaseFinished("Thing manager");
+
+    qCDebug(dcCore) << "Creating MQTT State Exporter";
+    m_mqttStateExporter = new MqttStateExporter(m_thingManager, m_serverManager->mqttBroker(), this);
+    m_mqttStateExporter->setTopicPrefix(m_configuration->mqttStateExportTopicPrefix());
+    m_mqttStateExporter->setRetained(m_configuration->mqttStateExportRetained());
+    m_mqttStateExporter->setInterval(m_configuration->mqttStateExportInterval());
+    m_mqttStateExporter->setEnabled(m_configuration->mqttStateExportEnabled());
+    phaseFinished("MQTT state exporter");
 
     qCDebug(dcCore) << "Creating Rule Engine";
     m_ruleEngine = new RuleEngine(this);
+    phaseFinished("Rule engine");
 
     qCDebug(dcCore) << "Creating Log Engine";
     m_logger = new LogEngine(m_configuration->logDBDriver(), m_configuration->logDBName(), m_configuration->logDBHost(), m_configuration->logDBUser(), m_configuration->logDBPassword(), m_configuration->logDBMaxEntries(), this);
+    m_logger->setBatchingParameters(m_configuration->logDBBatchSize(), m_configuration->logDBBatchInterval());
+    m_logger->setReadConnections(m_configuration->logDBReadConnections());
+    m_logger->setDefaultStateRateLimit(m_configuration->logDBStateMinInterval());
+    m_logger->setStateHistorySize(m_configuration->logStateHistorySize());
+    m_logger->setColumnCacheWindow(m_configuration->logColumnCacheWindow());
+    foreach (const LogRateLimit &rateLimit, m_configuration->logDBRateLimits()) {
+        m_logger->setStateRateLimit(rateLimit.thingId, rateLimit.stateTypeId, rateLimit.minInterval, rateLimit.deadband);
+    }
+    if (m_configuration->logDBStateStorage() == "segments") {
+        QFileInfo logDBInfo(m_configuration->logDBName());
+        QString segmentsPath = logDBInfo.absolutePath() + "/" + logDBInfo.completeBaseName() + "-segments";
+        m_logger->setStateStorageBackend(new LogSegmentStorage(segmentsPath, m_configuration->logDBSegmentDuration(), m_configuration->logDBSegmentRetention()));
+    }
     m_logger->setThingManager(m_thingManager);
+    phaseFinished("Log engine");
 
     qCDebug(dcCore()) << "Creating Script Engine";
-    m_scriptEngine = new ScriptEngine(m_thingManager, this);
+    m_scriptEngine = new ScriptEngine(m_thingManager, m_thingStateSnapshots, this);
     m_serverManager->jsonServer()->registerHandler(new ScriptsHandler(m_scriptEngine, m_scriptEngine));
+    phaseFinished("Script engine");
 
     qCDebug(dcCore()) << "Creating Tags Storage";
     m_tagsStorage = new TagsStorage(m_thingManager, m_ruleEngine, this);
+    phaseFinished("Tags storage");
 
     qCDebug(dcCore) << "Creating Network Manager";
     m_networkManager = new NetworkManager(this);
     m_networkManager->start();
+    phaseFinished("Network manager");
 
     qCDebug(dcCore) << "Creating Debug Server Handler";
     m_debugServerHandler = new DebugServerHandler(this);
 
     qCDebug(dcCore) << "Creating Cloud Manager";
     m_cloudManager = new CloudManager(m_configuration, m_networkManager, this);
+    phaseFinished("Cloud manager");
 
     qCDebug(dcCore()) << "Loading experiences";
     m_experienceManager = new ExperienceManager(m_thingManager, m_serverManager->jsonServer(), this);
+    phaseFinished("Experiences");
 
 
     // To be removed with 0.31 or later.
@@ -157,28 +220,47 @@ void NymeaCore::init(const QStringList &additionalInterfaces) {
     CloudNotifications *cloudNotifications = m_cloudManager->createNotificationsPlugin();
     m_thingManager->registerStaticPlugin(cloudNotifications);
 
+    qCDebug(dcCore()) << "Creating Federation Manager";
+    m_federationManager = new FederationManager(m_configuration, m_thingManager, this);
+
     CloudTransport *cloudTransport = m_cloudManager->createTransportInterface();
     m_serverManager->jsonServer()->registerTransportInterface(cloudTransport, false);
 
     connect(m_configuration, &NymeaConfiguration::serverNameChanged, m_serverManager, &ServerManager::setServerName);
 
     connect(m_thingManager, &ThingManagerImplementation::pluginConfigChanged, this, &NymeaCore::pluginConfigChanged);
-    connect(m_thingManager, &ThingManagerImplementation::eventTriggered, this, &NymeaCore::gotEvent);
+    m_eventQueue = new EventQueue(m_configuration->eventQueueSliceBudget(), this);
+    connect(m_thingManager, &ThingManagerImplementation::eventTriggered, m_eventQueue, &EventQueue::enqueue);
+    connect(m_thingManager, &ThingManagerImplementation::actionExecuted, m_eventQueue, &EventQueue::onActionExecuted);
+    connect(m_eventQueue, &EventQueue::eventReady, this, &NymeaCore::gotEvent);
+    m_memoryProfiler = new MemoryProfiler(this);
     connect(m_thingManager, &ThingManagerImplementation::thingStateChanged, this, &NymeaCore::thingStateChanged);
+    connect(m_thingManager, &ThingManagerImplementation::thingStatesChanged, this, &NymeaCore::thingStatesChanged);
     connect(m_thingManager, &ThingManagerImplementation::thingAdded, this, &NymeaCore::thingAdded);
+    connect(m_thingManager, &ThingManagerImplementation::thingsAdded, this, &NymeaCore::thingsAdded);
     connect(m_thingManager, &ThingManagerImplementation::thingChanged, this, &NymeaCore::thingChanged);
     connect(m_thingManager, &ThingManagerImplementation::thingSettingChanged, this, &NymeaCore::thingSettingChanged);
     connect(m_thingManager, &ThingManagerImplementation::thingRemoved, this, &NymeaCore::thingRemoved);
     connect(m_thingManager, &ThingManagerImplementation::thingDisappeared, this, &NymeaCore::onThingDisappeared);
     connect(m_thingManager, &ThingManagerImplementation::loaded, this, &NymeaCore::thingManagerLoaded);
+    connect(m_thingManager, &ThingManagerImplementation::startupSetupsFinished, this, [](){
+        StartupTrace::finish();
+    });
 
     connect(m_ruleEngine, &RuleEngine::ruleAdded, this, &NymeaCore::ruleAdded);
     connect(m_ruleEngine, &RuleEngine::ruleRemoved, this, &NymeaCore::ruleRemoved);
     connect(m_ruleEngine, &RuleEngine::ruleConfigurationChanged, this, &NymeaCore::ruleConfigurationChanged);
+    connect(m_ruleEngine, &RuleEngine::rulesAdded, this, &NymeaCore::rulesAdded);
+    connect(m_ruleEngine, &RuleEngine::rulesConfigurationChanged, this, &NymeaCore::rulesConfigurationChanged);
 
     connect(m_timeManager, &TimeManager::dateTimeChanged, this, &NymeaCore::onDateTimeChanged);
 
+    qCDebug(dcCore()) << "Creating Replication Primary";
+    m_replicationPrimary = new ReplicationPrimary(m_configuration, m_serverManager->sslConfiguration(), m_thingManager, m_ruleEngine, m_logger, this);
+
     m_logger->logSystemEvent(m_timeManager->currentDateTime(), true);
+
+    qCInfo(dcCore()) << "NymeaCore initialized in" << StartupTrace::now() / 1000 << "ms";
 }
 
 /*! Destructor of the \l{NymeaCore}. */
@@ -196,6 +278,10 @@ NymeaCore::~NymeaCore()
     qCDebug(dcCore) << "Shutting down \"Rule Engine\"";
     delete m_ruleEngine;
 
+    // Scripts access things, stop them before the ThingManager goes away
+    qCDebug(dcCore) << "Shutting down \"Script Engine\"";
+    m_scriptEngine->unloadScripts();
+
     // Next, ThingManager, so plugins don't access any resources any more.
     qCDebug(dcCore) << "Shutting down \"Thing Manager\"";
     delete m_thingManager;
@@ -414,9 +500,32 @@ BrowserItemActionInfo *NymeaCore::executeBrowserItemAction(const BrowserItemActi
 /*! Execute the given \a ruleActions. */
 void NymeaCore::executeRuleActions(const QList<RuleAction> ruleActions)
 {
+    QVector<QPair<RuleId, RuleAction>> untaggedActions;
+    untaggedActions.reserve(ruleActions.count());
+    foreach (const RuleAction &ruleAction, ruleActions) {
+        untaggedActions.append(qMakePair(RuleId(), ruleAction));
+    }
+    executeRuleActions(untaggedActions, QElapsedTimer());
+}
+
+void NymeaCore::executeRuleActions(const QVector<QPair<RuleId, RuleAction>> &ruleActions, const QElapsedTimer &timer, quint64 traceId)
+{
+    if (ruleActions.isEmpty()) {
+        if (timer.isValid()) {
+            m_ruleEngine->statistics()->traceDispatched(traceId, 0, timer.elapsed());
+        }
+        return;
+    }
+
     QList<Action> actions;
+    actions.reserve(ruleActions.count());
+    // The rule of each entry in actions
+    QList<RuleId> actionRules;
+    actionRules.reserve(ruleActions.count());
     QList<BrowserAction> browserActions;
-    foreach (const RuleAction &ruleAction, ruleActions) {
+    for (int i = 0; i < ruleActions.count(); i++) {
+        const RuleId &ruleId = ruleActions.at(i).first;
+        const RuleAction &ruleAction = ruleActions.at(i).second;
         if (ruleAction.type() == RuleAction::TypeThing) {
             Thing *thing = m_thingManager->findConfiguredThing(ruleAction.thingId());
             if (!thing) {
@@ -424,9 +533,11 @@ void NymeaCore::executeRuleActions(const QList<RuleAction> ruleActions)
                 continue;
             }
             ActionTypeId actionTypeId = ruleAction.actionTypeId();
+            const RuleActionParams ruleActionParams = ruleAction.ruleActionParams();
             ParamList params;
+            params.reserve(ruleActionParams.count());
             bool ok = true;
-            foreach (const RuleActionParam &ruleActionParam, ruleAction.ruleActionParams()) {
+            foreach (const RuleActionParam &ruleActionParam, ruleActionParams) {
                 if (ruleActionParam.isValueBased()) {
                     params.append(Param(ruleActionParam.paramTypeId(), ruleActionParam.value()));
                 } else if (ruleActionParam.isStateBased()) {
@@ -436,8 +547,7 @@ void NymeaCore::executeRuleActions(const QList<RuleAction> ruleActions)
                         ok = false;
                         break;
                     }
-                    ThingClass stateThingClass = m_thingManager->findThingClass(stateThing->thingClassId());
-                    if (!stateThingClass.hasStateType(ruleActionParam.stateTypeId())) {
+                    if (!stateThing->hasState(ruleActionParam.stateTypeId())) {
                         qCWarning(dcRuleEngine()) << "Device" << thing->name() << thing->id() << "does not have a state type" << ruleActionParam.stateTypeId();
                         ok = false;
                         break;
@@ -452,6 +562,7 @@ void NymeaCore::executeRuleActions(const QList<RuleAction> ruleActions)
             Action action(actionTypeId, thing->id(), Action::TriggeredByRule);
             action.setParams(params);
             actions.append(action);
+            actionRules.append(ruleId);
         } else if (ruleAction.type() == RuleAction::TypeBrowser) {
             Thing *thing = m_thingManager->findConfiguredThing(ruleAction.thingId());
             if (!thing) {
@@ -488,8 +599,7 @@ void NymeaCore::executeRuleActions(const QList<RuleAction> ruleActions)
                             ok = false;
                             break;
                         }
-                        ThingClass stateThingClass = m_thingManager->findThingClass(stateThing->thingClassId());
-                        if (!stateThingClass.hasStateType(ruleActionParam.stateTypeId())) {
+                        if (!stateThing->hasState(ruleActionParam.stateTypeId())) {
                             qCWarning(dcRuleEngine()) << "Thing" << thing->name() << thing->id() << "does not have a state type" << ruleActionParam.stateTypeId();
                             ok = false;
                             break;
@@ -505,17 +615,30 @@ void NymeaCore::executeRuleActions(const QList<RuleAction> ruleActions)
                 Action action = Action(actionType.id(), thing->id(), Action::TriggeredByRule);
                 action.setParams(params);
                 actions.append(action);
+                actionRules.append(ruleId);
             }
         }
     }
 
+    // Handing all actions over at once lets plugins execute them together
     foreach (const Action &action, actions) {
         qCDebug(dcRuleEngine) << "Executing action" << action.actionTypeId() << action.params();
-        ThingActionInfo *info = m_thingManager->executeAction(action);
-        connect(info, &ThingActionInfo::finished, this, [info](){
+    }
+    if (timer.isValid()) {
+        m_ruleEngine->statistics()->traceDispatched(traceId, actions.count(), timer.elapsed());
+    }
+    QList<ThingActionInfo*> infos = m_thingManager->executeActions(actions);
+    for (int i = 0; i < infos.count(); i++) {
+        ThingActionInfo *info = infos.at(i);
+        RuleId ruleId = actionRules.at(i);
+        connect(info, &ThingActionInfo::finished, this, [this, info, ruleId, timer, traceId](){
             if (info->status() != Thing::ThingErrorNoError) {
                 qCWarning(dcRuleEngine) << "Error executing action:" << info->status() << info->displayMessage();
             }
+            if (timer.isValid()) {
+                m_ruleEngine->statistics()->actionFinished(ruleId, timer.elapsed());
+                m_ruleEngine->statistics()->traceActionFinished(traceId, timer.elapsed());
+            }
         });
     }
 
@@ -662,13 +785,54 @@ ModbusRtuManager *NymeaCore::modbusRtuManager() const
     return m_modbusRtuManager;
 }
 
+EventQueue *NymeaCore::eventQueue() const
+{
+    return m_eventQueue;
+}
+
+MemoryProfiler *NymeaCore::memoryProfiler() const
+{
+    return m_memoryProfiler;
+}
+
+/*! Returns the publisher of the thing state snapshots, which may be read from any thread. */
+ThingStateSnapshots *NymeaCore::thingStateSnapshots() const
+{
+    return m_thingStateSnapshots;
+}
+
+FederationManager *NymeaCore::federationManager() const
+{
+    return m_federationManager;
+}
+
+ReplicationPrimary *NymeaCore::replicationPrimary() const
+{
+    return m_replicationPrimary;
+}
+
 void NymeaCore::gotEvent(const Event &event)
 {
+    QElapsedTimer eventTimer;
+    eventTimer.start();
+    quint64 traceId = m_ruleEngine->statistics()->startTrace(event);
+
     emit eventTriggered(event);
 
-    QList<RuleAction> actions;
-    QList<RuleAction> eventBasedActions;
-    foreach (const Rule &rule, m_ruleEngine->evaluateEvent(event)) {
+    QList<RuleId> ruleIds = m_ruleEngine->evaluateEvent(event);
+    m_ruleEngine->statistics()->traceEvaluated(traceId, eventTimer.nsecsElapsed() / 1000, ruleIds);
+    if (ruleIds.isEmpty()) {
+        // Most events don't trigger any rule, don't build anything for them
+        m_ruleEngine->statistics()->traceDispatched(traceId, 0, eventTimer.elapsed());
+        return;
+    }
+
+    // Actions taking over event params are executed after all the others
+    QVector<QPair<RuleId, RuleAction>> actions;
+    QVector<QPair<RuleId, RuleAction>> eventBasedActions;
+    foreach (const RuleId &ruleId, ruleIds) {
+        const Rule &rule = m_ruleEngine->ruleDefinition(ruleId);
+        RuleEngine::RuleState state = m_ruleEngine->ruleState(ruleId);
         if (m_executingRules.contains(rule.id())) {
             qCWarning(dcRuleEngine()) << "WARNING: Loop detected in rule execution for rule" << rule.id() << rule.name();
             break;
@@ -678,82 +842,89 @@ void NymeaCore::gotEvent(const Event &event)
         // Event based
         if (!rule.eventDescriptors().isEmpty()) {
             m_logger->logRuleTriggered(rule);
-            QList<RuleAction> tmp;
-            if (rule.statesActive() && rule.timeActive()) {
-                qCDebug(dcRuleEngineDebug()) << "Executing actions";
-                tmp = rule.actions();
-            } else {
-                qCDebug(dcRuleEngineDebug()) << "Executing exitActions";
-                tmp = rule.exitActions();
-            }
+            bool executeActions = state.statesActive && state.timeActive;
+            qCDebug(dcRuleEngineDebug()) << (executeActions ? "Executing actions" : "Executing exitActions");
+            const RuleActions ruleActions = executeActions ? rule.actions() : rule.exitActions();
+            actions.reserve(actions.count() + ruleActions.count());
             // check if we have an event based action or a normal action
-            foreach (const RuleAction &action, tmp) {
+            foreach (const RuleAction &action, ruleActions) {
                 if (action.isEventBased()) {
-                    eventBasedActions.append(action);
+                    eventBasedActions.append(qMakePair(ruleId, action));
                 } else {
-                    actions.append(action);
+                    actions.append(qMakePair(ruleId, action));
                 }
             }
         } else {
             // State based rule
-            m_logger->logRuleActiveChanged(rule);
-            emit ruleActiveChanged(rule);
-            if (rule.active()) {
-                actions.append(rule.actions());
-            } else {
-                actions.append(rule.exitActions());
+            Rule ruleWithState = m_ruleEngine->findRule(ruleId);
+            m_logger->logRuleActiveChanged(ruleWithState);
+            emit ruleActiveChanged(ruleWithState);
+            const RuleActions ruleActions = state.active ? rule.actions() : rule.exitActions();
+            actions.reserve(actions.count() + ruleActions.count());
+            foreach (const RuleAction &action, ruleActions) {
+                actions.append(qMakePair(ruleId, action));
             }
         }
     }
 
-    // Set action params, depending on the event value
-    foreach (RuleAction ruleAction, eventBasedActions) {
-        RuleActionParams newParams;
-        foreach (RuleActionParam ruleActionParam, ruleAction.ruleActionParams()) {
+    // Set action params, depending on the event value. Only the params taking over a value are detached.
+    actions.reserve(actions.count() + eventBasedActions.count());
+    for (int i = 0; i < eventBasedActions.count(); i++) {
+        RuleAction &ruleAction = eventBasedActions[i].second;
+        RuleActionParams params = ruleAction.ruleActionParams();
+        for (int j = 0; j < params.count(); j++) {
             // if this event param should be taken over in this action
-            if (event.eventTypeId() == ruleActionParam.eventTypeId()) {
-                QVariant eventValue = event.params().paramValue(ruleActionParam.eventParamTypeId());
+            if (event.eventTypeId() == params.at(j).eventTypeId()) {
+                QVariant eventValue = event.params().paramValue(params.at(j).eventParamTypeId());
 
                 // TODO: limits / scale calculation -> actionValue = eventValue * x
                 //       something like a EventParamDescriptor
 
-                ruleActionParam.setValue(eventValue);
-                qCDebug(dcRuleEngine) << "Using param value from event:" << ruleActionParam.value();
+                params[j].setValue(eventValue);
+                qCDebug(dcRuleEngine) << "Using param value from event:" << params.at(j).value();
             }
-            newParams.append(ruleActionParam);
         }
-        ruleAction.setRuleActionParams(newParams);
-        actions.append(ruleAction);
+        ruleAction.setRuleActionParams(params);
+        actions.append(eventBasedActions.at(i));
     }
 
-    executeRuleActions(actions);
+    executeRuleActions(actions, eventTimer, traceId);
     m_executingRules.clear();
 }
 
 void NymeaCore::onDateTimeChanged(const QDateTime &dateTime)
 {
-    QList<RuleAction> actions;
-    foreach (const Rule &rule, m_ruleEngine->evaluateTime(dateTime)) {
+    QElapsedTimer timer;
+    timer.start();
+    QVector<QPair<RuleId, RuleAction>> actions;
+    foreach (const RuleId &ruleId, m_ruleEngine->evaluateTime(dateTime)) {
+        const Rule &rule = m_ruleEngine->ruleDefinition(ruleId);
+        RuleEngine::RuleState state = m_ruleEngine->ruleState(ruleId);
+        QList<RuleAction> ruleActions;
         // TimeEvent based
         if (!rule.timeDescriptor().timeEventItems().isEmpty()) {
             m_logger->logRuleTriggered(rule);
-            if (rule.statesActive() && rule.timeActive()) {
-                actions.append(rule.actions());
+            if (state.statesActive && state.timeActive) {
+                ruleActions = rule.actions();
             } else {
-                actions.append(rule.exitActions());
+                ruleActions = rule.exitActions();
             }
         } else {
             // Calendar based rule
-            m_logger->logRuleActiveChanged(rule);
-            emit ruleActiveChanged(rule);
-            if (rule.active()) {
-                actions.append(rule.actions());
+            Rule ruleWithState = m_ruleEngine->findRule(ruleId);
+            m_logger->logRuleActiveChanged(ruleWithState);
+            emit ruleActiveChanged(ruleWithState);
+            if (state.active) {
+                ruleActions = rule.actions();
             } else {
-                actions.append(rule.exitActions());
+                ruleActions = rule.exitActions();
             }
         }
+        foreach (const RuleAction &ruleAction, ruleActions) {
+            actions.append(qMakePair(ruleId, ruleAction));
+        }
     }
-    executeRuleActions(actions);
+    executeRuleActions(actions, timer);
 }
 
 LogEngine* NymeaCore::logEngine() const
@@ -822,7 +993,9 @@ void NymeaCore::onThingDisappeared(const ThingId &thingId)
 
 void NymeaCore::thingManagerLoaded()
 {
+    qint64 rulesStart = StartupTrace::now();
     m_ruleEngine->init();
+    StartupTrace::record("rules", "Rule engine init", rulesStart, {{"rules", m_ruleEngine->rules().count()}});
     // Evaluate rules on current time
     onDateTimeChanged(m_timeManager->currentDateTime());
 
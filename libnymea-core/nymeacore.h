@@ -49,6 +49,8 @@
 #include "debugserverhandler.h"
 
 #include <QObject>
+#include <QElapsedTimer>
+#include <QVector>
 
 class Thing;
 
@@ -69,6 +71,12 @@ class CloudManager;
 class ZigbeeManager;
 class ModbusRtuManager;
 class SerialPortMonitor;
+class MqttStateExporter;
+class EventQueue;
+class MemoryProfiler;
+class ThingStateSnapshots;
+class FederationManager;
+class ReplicationPrimary;
 
 class NymeaCore : public QObject
 {
@@ -110,6 +118,11 @@ public:
     Platform *platform() const;
     ZigbeeManager *zigbeeManager() const;
     ModbusRtuManager *modbusRtuManager() const;
+    EventQueue *eventQueue() const;
+    MemoryProfiler *memoryProfiler() const;
+    ThingStateSnapshots *thingStateSnapshots() const;
+    FederationManager *federationManager() const;
+    ReplicationPrimary *replicationPrimary() const;
 
     static QStringList getAvailableLanguages();
     static QStringList loggingFilters();
@@ -121,8 +134,10 @@ signals:
     void pluginConfigChanged(const PluginId &id, const ParamList &config);
     void eventTriggered(const Event &event);
     void thingStateChanged(Thing *thing, const QUuid &stateTypeId, const QVariant &value, const QVariant &minValue, const QVariant &maxValue);
+    void thingStatesChanged(Thing *thing, const QList<StateTypeId> &stateTypeIds);
     void thingRemoved(const ThingId &thingId);
     void thingAdded(Thing *thing);
+    void thingsAdded(const QList<Thing*> &things);
     void thingChanged(Thing *thing);
     void thingSettingChanged(const ThingId &thingId, const ParamTypeId &settingParamTypeId, const QVariant &value);
 
@@ -130,6 +145,8 @@ signals:
     void ruleAdded(const Rule &rule);
     void ruleActiveChanged(const Rule &rule);
     void ruleConfigurationChanged(const Rule &rule);
+    void rulesAdded(const QList<Rule> &rules);
+    void rulesConfigurationChanged(const QList<Rule> &rules);
 
 private:
     explicit NymeaCore(QObject *parent = nullptr);
@@ -156,9 +173,18 @@ private:
     ZigbeeManager *m_zigbeeManager;
     SerialPortMonitor *m_serialPortMonitor;
     ModbusRtuManager *m_modbusRtuManager;
+    MqttStateExporter *m_mqttStateExporter;
+    EventQueue *m_eventQueue;
+    MemoryProfiler *m_memoryProfiler;
+    ThingStateSnapshots *m_thingStateSnapshots;
+    FederationManager *m_federationManager;
+    ReplicationPrimary *m_replicationPrimary;
 
     QList<RuleId> m_executingRules;
 
+    // Executes the actions, each tagged with the rule it belongs to, and records their latency since the timer started
+    void executeRuleActions(const QVector<QPair<RuleId, RuleAction>> &ruleActions, const QElapsedTimer &timer, quint64 traceId = 0);
+
 private slots:
     void gotEvent(const Event &event);
     void onDateTimeChanged(const QDateTime &dateTime);
@@ -29,6 +29,7 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "platform.h"
+#include "platformcache.h"
 #include "platform/platformsystemcontroller.h"
 #include "platform/platformupdatecontroller.h"
 #include "platform/platformzeroconfcontroller.h"
@@ -82,6 +83,8 @@ Platform::Platform(QObject *parent) : QObject(parent)
         qCWarning(dcPlatform()) << "No ZeroConf plugin loaded. ZeroConf will not be available.";
         m_platformZeroConfController = new PlatformZeroConfController(this);
     }
+
+    m_cache = new PlatformCache(m_platformSystemController, m_platformUpdateController, this);
 }
 
 PlatformSystemController *Platform::systemController() const
@@ -99,6 +102,12 @@ PlatformZeroConfController *Platform::zeroConfController() const
     return m_platformZeroConfController;
 }
 
+/*! Returns the in-memory copy of the platform state, for serving reads without querying the controllers. */
+PlatformCache *Platform::cache() const
+{
+    return m_cache;
+}
+
 QStringList Platform::pluginSearchDirs() const
 {
     QStringList searchDirs;
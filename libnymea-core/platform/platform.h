@@ -39,6 +39,8 @@ class PlatformZeroConfController;
 
 namespace nymeaserver {
 
+class PlatformCache;
+
 class Platform : public QObject
 {
     Q_OBJECT
@@ -49,6 +51,8 @@ public:
     PlatformUpdateController *updateController() const;
     PlatformZeroConfController *zeroConfController() const;
 
+    PlatformCache *cache() const;
+
 private:
     QStringList pluginSearchDirs() const;
 
@@ -60,6 +64,7 @@ private:
     PlatformSystemController *m_platformSystemController = nullptr;
     PlatformUpdateController *m_platformUpdateController = nullptr;
     PlatformZeroConfController *m_platformZeroConfController = nullptr;
+    PlatformCache *m_cache = nullptr;
 };
 
 }
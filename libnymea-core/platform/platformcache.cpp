@@ -0,0 +1,180 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::PlatformCache
+    \brief Serves the state of the platform controllers from memory.
+
+    \ingroup core
+    \inmodule core
+
+    Platform plugins may query system services over DBus for their getters. The PlatformCache keeps
+    a copy of the update and time state, updates it from the change signals of the controllers and
+    re-reads it in the next event loop pass when a controller changes its availability. Clients
+    opening the settings pages are served from this copy.
+*/
+
+#include "platformcache.h"
+#include "platform/platformsystemcontroller.h"
+#include "platform/platformupdatecontroller.h"
+
+#include <QTimeZone>
+#include <QtConcurrent/QtConcurrentRun>
+
+namespace nymeaserver {
+
+PlatformCache::PlatformCache(PlatformSystemController *systemController, PlatformUpdateController *updateController, QObject *parent):
+    QObject(parent),
+    m_systemController(systemController),
+    m_updateController(updateController)
+{
+    m_timeZones = QtConcurrent::run([](){
+        QStringList timeZones;
+        foreach (const QByteArray &timeZoneId, QTimeZone::availableTimeZoneIds()) {
+            timeZones.append(QString::fromUtf8(timeZoneId));
+        }
+        return timeZones;
+    });
+
+    connect(m_updateController, &PlatformUpdateController::availableChanged, this, &PlatformCache::refreshUpdateState, Qt::QueuedConnection);
+    connect(m_updateController, &PlatformUpdateController::busyChanged, this, [this](){
+        m_busy = m_updateController->busy();
+    });
+    connect(m_updateController, &PlatformUpdateController::updateRunningChanged, this, [this](){
+        m_updateRunning = m_updateController->updateRunning();
+    });
+    connect(m_updateController, &PlatformUpdateController::packageAdded, this, [this](const Package &package){
+        m_packages.append(package);
+    });
+    connect(m_updateController, &PlatformUpdateController::packageChanged, this, [this](const Package &package){
+        for (int i = 0; i < m_packages.count(); i++) {
+            if (m_packages.at(i).packageId() == package.packageId()) {
+                m_packages[i] = package;
+                return;
+            }
+        }
+        m_packages.append(package);
+    });
+    connect(m_updateController, &PlatformUpdateController::packageRemoved, this, [this](const QString &packageId){
+        for (int i = 0; i < m_packages.count(); i++) {
+            if (m_packages.at(i).packageId() == packageId) {
+                m_packages.removeAt(i);
+                return;
+            }
+        }
+    });
+    connect(m_updateController, &PlatformUpdateController::repositoryAdded, this, [this](const Repository &repository){
+        m_repositories.append(repository);
+    });
+    connect(m_updateController, &PlatformUpdateController::repositoryChanged, this, [this](const Repository &repository){
+        for (int i = 0; i < m_repositories.count(); i++) {
+            if (m_repositories.at(i).id() == repository.id()) {
+                m_repositories[i] = repository;
+                return;
+            }
+        }
+        m_repositories.append(repository);
+    });
+    connect(m_updateController, &PlatformUpdateController::repositoryRemoved, this, [this](const QString &repositoryId){
+        for (int i = 0; i < m_repositories.count(); i++) {
+            if (m_repositories.at(i).id() == repositoryId) {
+                m_repositories.removeAt(i);
+                return;
+            }
+        }
+    });
+
+    connect(m_systemController, &PlatformSystemController::availableChanged, this, &PlatformCache::refreshTimeConfiguration, Qt::QueuedConnection);
+    connect(m_systemController, &PlatformSystemController::timeConfigurationChanged, this, &PlatformCache::refreshTimeConfiguration);
+
+    refreshUpdateState();
+    refreshTimeConfiguration();
+}
+
+bool PlatformCache::busy() const
+{
+    return m_busy;
+}
+
+bool PlatformCache::updateRunning() const
+{
+    return m_updateRunning;
+}
+
+QList<Package> PlatformCache::packages() const
+{
+    return m_packages;
+}
+
+QList<Repository> PlatformCache::repositories() const
+{
+    return m_repositories;
+}
+
+bool PlatformCache::automaticTimeAvailable() const
+{
+    return m_automaticTimeAvailable;
+}
+
+bool PlatformCache::automaticTime() const
+{
+    return m_automaticTime;
+}
+
+QString PlatformCache::deviceSerialNumber() const
+{
+    // Doesn't change at runtime, but only read it once it's asked for
+    if (!m_deviceSerialNumberValid) {
+        m_deviceSerialNumber = m_systemController->deviceSerialNumber();
+        m_deviceSerialNumberValid = true;
+    }
+    return m_deviceSerialNumber;
+}
+
+QStringList PlatformCache::timeZones() const
+{
+    return m_timeZones.result();
+}
+
+void PlatformCache::refreshUpdateState()
+{
+    m_busy = m_updateController->busy();
+    m_updateRunning = m_updateController->updateRunning();
+    m_packages = m_updateController->packages();
+    m_repositories = m_updateController->repositories();
+}
+
+void PlatformCache::refreshTimeConfiguration()
+{
+    m_automaticTimeAvailable = m_systemController->automaticTimeAvailable();
+    m_automaticTime = m_systemController->automaticTime();
+}
+
+}
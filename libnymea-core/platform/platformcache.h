@@ -0,0 +1,86 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef PLATFORMCACHE_H
+#define PLATFORMCACHE_H
+
+#include <QObject>
+#include <QFuture>
+#include <QStringList>
+
+#include "platform/package.h"
+#include "platform/repository.h"
+
+class PlatformSystemController;
+class PlatformUpdateController;
+
+namespace nymeaserver {
+
+class PlatformCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PlatformCache(PlatformSystemController *systemController, PlatformUpdateController *updateController, QObject *parent = nullptr);
+
+    bool busy() const;
+    bool updateRunning() const;
+    QList<Package> packages() const;
+    QList<Repository> repositories() const;
+
+    bool automaticTimeAvailable() const;
+    bool automaticTime() const;
+    QString deviceSerialNumber() const;
+    QStringList timeZones() const;
+
+private slots:
+    void refreshUpdateState();
+    void refreshTimeConfiguration();
+
+private:
+    PlatformSystemController *m_systemController = nullptr;
+    PlatformUpdateController *m_updateController = nullptr;
+
+    bool m_busy = false;
+    bool m_updateRunning = false;
+    QList<Package> m_packages;
+    QList<Repository> m_repositories;
+
+    bool m_automaticTimeAvailable = false;
+    bool m_automaticTime = false;
+    mutable QString m_deviceSerialNumber;
+    mutable bool m_deviceSerialNumberValid = false;
+
+    // Reading the zone info database takes a while, it is done in a worker thread
+    QFuture<QStringList> m_timeZones;
+};
+
+}
+
+#endif // PLATFORMCACHE_H
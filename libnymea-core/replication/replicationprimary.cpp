@@ -0,0 +1,477 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*!
+    \class nymeaserver::ReplicationPrimary
+    \brief Streams the configuration, the thing states and the log of this nymead to hot standbys.
+
+    \ingroup core
+    \inmodule core
+
+    The primary is enabled by setting listenAddress in the Replication section of nymead.conf to the
+    port (or address:port) to listen on and secret to the secret shared with the standbys.
+
+    Every change made through NymeaSettings, every stored or removed rule, every state change and every log
+    entry written becomes a record with a sequence number. Records are batched per event loop iteration and
+    sent to all connected standbys. The most recent records (backlogSize, 100000 by default)
+    are kept in memory, so a standby reconnecting within that window continues from its last applied
+    record. Any other standby gets a snapshot of the complete configuration and all current states first.
+
+    A standby promoted to primary serves the term following the one of its old primary. Once a standby
+    of a higher term connects, this primary has been superseded and stops replicating, which keeps the
+    standbys of the new primary from being fed diverging state after a network partition.
+
+    \sa ReplicationStandby
+*/
+
+#include "replicationprimary.h"
+#include "nymeaconfiguration.h"
+#include "ruleengine/ruleengine.h"
+#include "ruleengine/rulestore.h"
+#include "logging/logengine.h"
+#include "integrations/thingmanager.h"
+#include "integrations/thing.h"
+
+#include "replicationstandby.h"
+#include "servers/tcpserver.h"
+
+#include <QMetaEnum>
+#include <QFile>
+#include <QSslSocket>
+
+namespace nymeaserver {
+
+// Records per message when catching up a standby
+static const int recordsPerMessage = 1000;
+
+ReplicationPrimary::ReplicationPrimary(NymeaConfiguration *configuration, const QSslConfiguration &sslConfiguration, ThingManager *thingManager, RuleEngine *ruleEngine, LogEngine *logEngine, QObject *parent):
+    QObject(parent),
+    m_thingManager(thingManager),
+    m_ruleEngine(ruleEngine),
+    m_sslConfiguration(sslConfiguration)
+{
+    QString listen = configuration->replicationListenAddress();
+    m_secret = configuration->replicationSecret();
+    if (listen.isEmpty()) {
+        return;
+    }
+    if (m_secret.isEmpty()) {
+        qCWarning(dcReplication()) << "No replication secret configured in nymead.conf. Not accepting any standbys.";
+        return;
+    }
+    // The stream carries the complete configuration, passwords included
+    if (!QSslSocket::supportsSsl() || m_sslConfiguration.localCertificate().isNull() || m_sslConfiguration.privateKey().isNull()) {
+        qCWarning(dcReplication()) << "TLS is not available. Not accepting any standbys.";
+        return;
+    }
+
+    QHostAddress address = QHostAddress::Any;
+    int separator = listen.lastIndexOf(':');
+    if (separator >= 0) {
+        address = QHostAddress(listen.left(separator).remove('[').remove(']'));
+    }
+    bool ok;
+    quint16 port = listen.mid(separator + 1).toUShort(&ok);
+    if (!ok || address.isNull()) {
+        qCWarning(dcReplication()) << "Invalid replication listenAddress" << listen << ". Expected port or address:port.";
+        return;
+    }
+
+    if (configuration->replicationBacklogSize() >= 0) {
+        m_backlogSize = configuration->replicationBacklogSize();
+    }
+
+    m_server = new SslServer(this);
+    if (!m_server->listen(address, port)) {
+        qCWarning(dcReplication()) << "Could not listen on" << listen << ":" << m_server->errorString();
+        delete m_server;
+        m_server = nullptr;
+        return;
+    }
+    connect(m_server, &SslServer::socketDescriptorAvailable, this, &ReplicationPrimary::onNewConnection);
+
+    m_epoch = QUuid::createUuid();
+    loadTerm();
+    qCInfo(dcReplication()) << "Accepting standbys of term" << m_term << "on" << m_server->serverAddress().toString() << m_server->serverPort();
+
+    NymeaSettings::setChangeHandler([this](NymeaSettings::SettingsRole role, NymeaSettings::Change change, const QString &key, const QVariant &value){
+        if (!ReplicationRecord::isReplicatedSetting(role, key)) {
+            return;
+        }
+        switch (change) {
+        case NymeaSettings::ChangeValue:
+            append(ReplicationRecord::TypeSettingChanged, {static_cast<int>(role), key, value});
+            break;
+        case NymeaSettings::ChangeRemove:
+            append(ReplicationRecord::TypeSettingRemoved, {static_cast<int>(role), key});
+            break;
+        case NymeaSettings::ChangeClear:
+            append(ReplicationRecord::TypeSettingsCleared, {static_cast<int>(role)});
+            break;
+        }
+    });
+
+    connect(thingManager, &ThingManager::thingStateChanged, this, [this](Thing *thing, const StateTypeId &stateTypeId, const QVariant &value, const QVariant &minValue, const QVariant &maxValue){
+        append(ReplicationRecord::TypeStateChanged, {QUuid(thing->id()), QUuid(stateTypeId), value, minValue, maxValue});
+    });
+    connect(thingManager, &ThingManager::thingRemoved, this, [this](const ThingId &thingId){
+        append(ReplicationRecord::TypeThingStatesRemoved, {QUuid(thingId)});
+    });
+
+    connect(ruleEngine, &RuleEngine::ruleAdded, this, &ReplicationPrimary::appendRule);
+    connect(ruleEngine, &RuleEngine::ruleConfigurationChanged, this, &ReplicationPrimary::appendRule);
+    connect(ruleEngine, &RuleEngine::rulesAdded, this, [this](const QList<Rule> &rules){
+        foreach (const Rule &rule, rules) {
+            appendRule(rule);
+        }
+    });
+    connect(ruleEngine, &RuleEngine::rulesConfigurationChanged, this, [this](const QList<Rule> &rules){
+        foreach (const Rule &rule, rules) {
+            appendRule(rule);
+        }
+    });
+    connect(ruleEngine, &RuleEngine::ruleRemoved, this, [this](const RuleId &ruleId){
+        append(ReplicationRecord::TypeRuleRemoved, {QUuid(ruleId)});
+    });
+
+    connect(logEngine, &LogEngine::logEntryAdded, this, [this](const LogEntry &entry){
+        ReplicationRecord record = ReplicationRecord::fromLogEntry(entry);
+        append(record.type, record.arguments);
+    });
+
+    m_heartbeatTimer.setInterval(1000);
+    connect(&m_heartbeatTimer, &QTimer::timeout, this, &ReplicationPrimary::sendHeartbeats);
+    m_heartbeatTimer.start();
+}
+
+ReplicationPrimary::~ReplicationPrimary()
+{
+    if (m_server) {
+        NymeaSettings::setChangeHandler(nullptr);
+    }
+}
+
+bool ReplicationPrimary::enabled() const
+{
+    return m_server != nullptr;
+}
+
+QVariantMap ReplicationPrimary::statistics() const
+{
+    QVariantMap statistics;
+    statistics.insert("enabled", enabled());
+    if (!m_server) {
+        return statistics;
+    }
+    statistics.insert("address", m_server->serverAddress().toString());
+    statistics.insert("port", m_server->serverPort());
+    statistics.insert("epoch", m_epoch.toString());
+    statistics.insert("term", m_term);
+    statistics.insert("fenced", m_fenced);
+    statistics.insert("sequence", m_sequence);
+    statistics.insert("backlog", m_backlog.count());
+    statistics.insert("backlogSize", m_backlogSize);
+    statistics.insert("recordsSent", m_recordsSent);
+    statistics.insert("snapshotsSent", m_snapshotsSent);
+    QVariantList standbys;
+    foreach (ReplicationConnection *connection, m_standbys.keys()) {
+        const Standby &standby = m_standbys.value(connection);
+        QVariantMap standbyMap;
+        standbyMap.insert("address", connection->socket()->peerAddress().toString());
+        standbyMap.insert("authenticated", standby.authenticated);
+        standbyMap.insert("acked", standby.acked);
+        standbyMap.insert("lag", standby.authenticated ? m_sequence - standby.acked : 0);
+        standbys.append(standbyMap);
+    }
+    statistics.insert("standbys", standbys);
+    return statistics;
+}
+
+void ReplicationPrimary::onNewConnection(qintptr socketDescriptor)
+{
+    QSslSocket *socket = new QSslSocket();
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        qCWarning(dcReplication()) << "Could not accept standby connection:" << socket->errorString();
+        delete socket;
+        return;
+    }
+    socket->setSslConfiguration(m_sslConfiguration);
+
+    ReplicationConnection *connection = new ReplicationConnection(socket, this);
+    connect(connection, &ReplicationConnection::messageReceived, this, &ReplicationPrimary::onMessageReceived);
+    connect(connection, &ReplicationConnection::disconnected, this, &ReplicationPrimary::onDisconnected);
+
+    Standby standby;
+    standby.nonce = ReplicationConnection::createNonce();
+    m_standbys.insert(connection, standby);
+    qCDebug(dcReplication()) << "Standby connected from" << socket->peerAddress().toString();
+
+    connect(socket, &QSslSocket::encrypted, connection, [this, connection](){
+        connection->send(ReplicationMessage(ReplicationMessage::TypeChallenge, {m_standbys.value(connection).nonce}));
+    });
+    connect(socket, static_cast<void(QSslSocket::*)(const QList<QSslError> &)>(&QSslSocket::sslErrors), connection, [connection](const QList<QSslError> &errors){
+        qCWarning(dcReplication()) << "TLS handshake with standby" << connection->socket()->peerAddress().toString() << "failed:" << errors;
+        connection->close();
+    });
+    socket->startServerEncryption();
+
+    QTimer::singleShot(10000, connection, [this, connection](){
+        if (m_standbys.contains(connection) && !m_standbys.value(connection).authenticated) {
+            qCWarning(dcReplication()) << "Standby" << connection->socket()->peerAddress().toString() << "did not authenticate in time.";
+            connection->close();
+        }
+    });
+}
+
+void ReplicationPrimary::onMessageReceived(const ReplicationMessage &message)
+{
+    ReplicationConnection *connection = qobject_cast<ReplicationConnection*>(sender());
+    if (!m_standbys.contains(connection)) {
+        return;
+    }
+    Standby &standby = m_standbys[connection];
+
+    if (!standby.authenticated) {
+        if (message.type != ReplicationMessage::TypeHello || message.arguments.count() != 5) {
+            qCWarning(dcReplication()) << "Unexpected message from unauthenticated standby" << connection->socket()->peerAddress().toString();
+            connection->close();
+            return;
+        }
+
+        QByteArray expected = ReplicationConnection::authenticate(m_secret, ReplicationConnection::RoleStandby, standby.nonce, m_sslConfiguration.localCertificate());
+        if (!ReplicationConnection::verify(expected, message.arguments.at(0).toByteArray())) {
+            qCWarning(dcReplication()) << "Standby" << connection->socket()->peerAddress().toString() << "failed to authenticate.";
+            connection->close();
+            return;
+        }
+
+        quint64 standbyTerm = message.arguments.at(4).toULongLong();
+        if (standbyTerm > m_term) {
+            fence(standbyTerm);
+            return;
+        }
+
+        // Prove the knowledge of the secret in return, the standby doesn't apply anything before
+        QByteArray standbyNonce = message.arguments.at(1).toByteArray();
+        connection->send(ReplicationMessage(ReplicationMessage::TypeWelcome, {ReplicationConnection::authenticate(m_secret, ReplicationConnection::RolePrimary, standbyNonce, m_sslConfiguration.localCertificate()), m_term}));
+
+        // Anything pending must be sequenced, and sent to the others, before deciding where the standby continues
+        flush();
+        standby.authenticated = true;
+
+        QUuid epoch = message.arguments.at(2).toUuid();
+        quint64 sequence = message.arguments.at(3).toULongLong();
+        bool covered = epoch == m_epoch && sequence <= m_sequence
+                && (sequence == m_sequence || (!m_backlog.isEmpty() && m_backlog.first().sequence <= sequence + 1));
+        if (!covered) {
+            sendSnapshot(connection);
+            standby.acked = m_sequence;
+            return;
+        }
+
+        qCInfo(dcReplication()) << "Standby" << connection->socket()->peerAddress().toString() << "continues after record" << sequence << "of" << m_sequence;
+        standby.acked = sequence;
+        ReplicationMessage records(ReplicationMessage::TypeRecords);
+        foreach (const ReplicationRecord &record, m_backlog) {
+            if (record.sequence <= sequence) {
+                continue;
+            }
+            records.records.append(record);
+            if (records.records.count() == recordsPerMessage) {
+                connection->send(records);
+                m_recordsSent += records.records.count();
+                records.records.clear();
+            }
+        }
+        if (!records.records.isEmpty()) {
+            connection->send(records);
+            m_recordsSent += records.records.count();
+        }
+        return;
+    }
+
+    if (message.type == ReplicationMessage::TypeAck && !message.arguments.isEmpty()) {
+        standby.acked = message.arguments.first().toULongLong();
+    }
+}
+
+void ReplicationPrimary::onDisconnected()
+{
+    ReplicationConnection *connection = qobject_cast<ReplicationConnection*>(sender());
+    if (m_standbys.remove(connection) > 0) {
+        qCInfo(dcReplication()) << "Standby" << connection->socket()->peerAddress().toString() << "disconnected";
+    }
+    connection->deleteLater();
+}
+
+void ReplicationPrimary::flush()
+{
+    QList<ReplicationRecord> records;
+    {
+        QMutexLocker locker(&m_pendingMutex);
+        records.swap(m_pending);
+        m_flushScheduled = false;
+    }
+    if (records.isEmpty()) {
+        return;
+    }
+
+    for (int i = 0; i < records.count(); i++) {
+        records[i].sequence = ++m_sequence;
+    }
+    m_backlog.append(records);
+    while (m_backlog.count() > m_backlogSize) {
+        m_backlog.removeFirst();
+    }
+
+    ReplicationMessage message(ReplicationMessage::TypeRecords);
+    message.records = records;
+    foreach (ReplicationConnection *connection, m_standbys.keys()) {
+        if (m_standbys.value(connection).authenticated) {
+            connection->send(message);
+            m_recordsSent += records.count();
+        }
+    }
+}
+
+void ReplicationPrimary::sendHeartbeats()
+{
+    ReplicationMessage heartbeat(ReplicationMessage::TypeHeartbeat, {m_sequence});
+    foreach (ReplicationConnection *connection, m_standbys.keys()) {
+        if (m_standbys.value(connection).authenticated) {
+            connection->send(heartbeat);
+        }
+    }
+}
+
+void ReplicationPrimary::append(ReplicationRecord::Type type, const QVariantList &arguments)
+{
+    QMutexLocker locker(&m_pendingMutex);
+    if (m_fenced) {
+        return;
+    }
+    m_pending.append(ReplicationRecord(type, arguments));
+    if (!m_flushScheduled) {
+        m_flushScheduled = true;
+        QMetaObject::invokeMethod(this, "flush", Qt::QueuedConnection);
+    }
+}
+
+void ReplicationPrimary::appendRule(const Rule &rule)
+{
+    append(ReplicationRecord::TypeRuleStored, {RuleStore::serialize(rule)});
+}
+
+void ReplicationPrimary::loadTerm()
+{
+    QFile termFile(NymeaSettings::storagePath() + "/replication-term");
+    if (termFile.open(QFile::ReadOnly)) {
+        m_term = termFile.readAll().trimmed().toULongLong();
+        termFile.close();
+    }
+
+    // An instance which has been a standby got promoted, its old primary is superseded
+    QUuid standbyEpoch;
+    quint64 standbySequence = 0;
+    quint64 standbyTerm = 0;
+    if (ReplicationStandby::readPosition(&standbyEpoch, &standbySequence, &standbyTerm)) {
+        m_term = qMax(m_term, standbyTerm + 1);
+        qCInfo(dcReplication()) << "Promoted from standby at record" << standbySequence << "of term" << standbyTerm;
+    }
+
+    if (!termFile.open(QFile::WriteOnly | QFile::Truncate)) {
+        qCWarning(dcReplication()) << "Could not store the replication term to" << termFile.fileName() << termFile.errorString();
+        return;
+    }
+    termFile.write(QByteArray::number(m_term));
+    termFile.close();
+    QFile::remove(ReplicationStandby::positionFileName());
+}
+
+void ReplicationPrimary::fence(quint64 term)
+{
+    qCCritical(dcReplication()) << "A standby of term" << term << "connected while this primary serves term" << m_term
+                                << ". Another instance has been promoted. Stopping replication, configure this instance as standby of the new primary.";
+    {
+        QMutexLocker locker(&m_pendingMutex);
+        m_fenced = true;
+        m_pending.clear();
+    }
+    NymeaSettings::setChangeHandler(nullptr);
+    m_heartbeatTimer.stop();
+    m_server->close();
+    m_backlog.clear();
+    foreach (ReplicationConnection *connection, m_standbys.keys()) {
+        connection->close();
+    }
+}
+
+void ReplicationPrimary::sendSnapshot(ReplicationConnection *connection)
+{
+    qCInfo(dcReplication()) << "Sending snapshot at record" << m_sequence << "to standby" << connection->socket()->peerAddress().toString();
+
+    QList<ReplicationRecord> records;
+    QMetaEnum roles = QMetaEnum::fromType<NymeaSettings::SettingsRole>();
+    for (int i = 0; i < roles.keyCount(); i++) {
+        NymeaSettings::SettingsRole role = static_cast<NymeaSettings::SettingsRole>(roles.value(i));
+        if (role == NymeaSettings::SettingsRoleNone) {
+            continue;
+        }
+        NymeaSettings settings(role);
+        records.append(ReplicationRecord(ReplicationRecord::TypeSettingsCleared, {static_cast<int>(role)}));
+        foreach (const QString &key, settings.allKeys()) {
+            if (!ReplicationRecord::isReplicatedSetting(role, key)) {
+                continue;
+            }
+            records.append(ReplicationRecord(ReplicationRecord::TypeSettingChanged, {static_cast<int>(role), key, settings.value(key)}));
+        }
+    }
+
+    records.append(ReplicationRecord(ReplicationRecord::TypeRulesCleared));
+    foreach (const Rule &rule, m_ruleEngine->rules()) {
+        records.append(ReplicationRecord(ReplicationRecord::TypeRuleStored, {RuleStore::serialize(rule)}));
+    }
+
+    foreach (Thing *thing, m_thingManager->configuredThings()) {
+        foreach (const State &state, thing->states()) {
+            records.append(ReplicationRecord(ReplicationRecord::TypeStateChanged, {QUuid(thing->id()), QUuid(state.stateTypeId()), state.value(), state.minValue(), state.maxValue()}));
+        }
+    }
+
+    connection->send(ReplicationMessage(ReplicationMessage::TypeSnapshotBegin, {m_epoch}));
+    for (int i = 0; i < records.count(); i += recordsPerMessage) {
+        ReplicationMessage message(ReplicationMessage::TypeRecords);
+        message.records = records.mid(i, recordsPerMessage);
+        connection->send(message);
+    }
+    connection->send(ReplicationMessage(ReplicationMessage::TypeSnapshotEnd, {m_sequence}));
+    m_snapshotsSent++;
+}
+
+}
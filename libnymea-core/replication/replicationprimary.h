@@ -0,0 +1,121 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#ifndef REPLICATIONPRIMARY_H
+#define REPLICATIONPRIMARY_H
+
+#include "replicationprotocol.h"
+#include "nymeasettings.h"
+
+#include <QObject>
+#include <QSslConfiguration>
+#include <QTimer>
+#include <QMutex>
+#include <QHash>
+#include <QUuid>
+
+class ThingManager;
+class Thing;
+
+namespace nymeaserver {
+
+class NymeaConfiguration;
+class RuleEngine;
+class LogEngine;
+class Rule;
+class SslServer;
+
+class ReplicationPrimary : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ReplicationPrimary(NymeaConfiguration *configuration, const QSslConfiguration &sslConfiguration, ThingManager *thingManager, RuleEngine *ruleEngine, LogEngine *logEngine, QObject *parent = nullptr);
+    ~ReplicationPrimary() override;
+
+    bool enabled() const;
+
+    QVariantMap statistics() const;
+
+private slots:
+    void onNewConnection(qintptr socketDescriptor);
+    void onMessageReceived(const ReplicationMessage &message);
+    void onDisconnected();
+
+    void flush();
+    void sendHeartbeats();
+
+private:
+    class Standby {
+    public:
+        QByteArray nonce;
+        bool authenticated = false;
+        quint64 acked = 0;
+    };
+
+    // Thread safe, settings are changed from plugin threads too
+    void append(ReplicationRecord::Type type, const QVariantList &arguments);
+    void appendRule(const Rule &rule);
+
+    void sendSnapshot(ReplicationConnection *connection);
+    void loadTerm();
+    void fence(quint64 term);
+
+    ThingManager *m_thingManager = nullptr;
+    RuleEngine *m_ruleEngine = nullptr;
+
+    SslServer *m_server = nullptr;
+    QSslConfiguration m_sslConfiguration;
+    QByteArray m_secret;
+
+    // Identifies the sequence numbers of this process. A standby of another epoch needs a snapshot.
+    QUuid m_epoch;
+    quint64 m_sequence = 0;
+
+    // Raised whenever a standby gets promoted. A primary learning about a higher term has been superseded.
+    quint64 m_term = 0;
+    bool m_fenced = false;
+
+    QMutex m_pendingMutex;
+    QList<ReplicationRecord> m_pending;
+    bool m_flushScheduled = false;
+
+    // The most recent records, for standbys reconnecting without needing a snapshot
+    QList<ReplicationRecord> m_backlog;
+    int m_backlogSize = 100000;
+
+    QHash<ReplicationConnection*, Standby> m_standbys;
+    QTimer m_heartbeatTimer;
+
+    quint64 m_snapshotsSent = 0;
+    quint64 m_recordsSent = 0;
+};
+
+}
+
+#endif // REPLICATIONPRIMARY_H
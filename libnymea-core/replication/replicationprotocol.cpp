@@ -0,0 +1,215 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*!
+    \class nymeaserver::ReplicationConnection
+    \brief The connection between a replication primary and a hot standby.
+
+    \ingroup core
+    \inmodule core
+
+    Messages are serialized with QDataStream and sent as frames prefixed with their length over a TLS
+    connection, using the certificate of the nymead servers on the primary.
+
+    Before anything is replicated, both sides prove that they know the shared secret. The primary challenges
+    the standby with a nonce, the standby answers with the HMAC-SHA256 of that nonce and a nonce of its own,
+    and the primary answers with the HMAC-SHA256 of the standby's nonce. Each proof covers the role of the
+    sender and the certificate the primary presented in the TLS handshake. The certificate is usually self
+    signed and therefore not verified by TLS, but a man in the middle presenting a certificate of its own
+    can't produce a proof matching it without knowing the secret.
+
+    \sa ReplicationPrimary, ReplicationStandby
+*/
+
+#include "replicationprotocol.h"
+#include "loggingcategories.h"
+#include "nymeasettings.h"
+
+#include <QMessageAuthenticationCode>
+#include <QUuid>
+
+NYMEA_LOGGING_CATEGORY(dcReplication, "Replication")
+
+namespace nymeaserver {
+
+// Frames bigger than this can only come from something that doesn't speak the protocol
+static const quint32 maxFrameSize = 64 * 1024 * 1024;
+
+ReplicationRecord::ReplicationRecord(Type type, const QVariantList &arguments):
+    type(type),
+    arguments(arguments)
+{
+}
+
+ReplicationRecord ReplicationRecord::fromLogEntry(const LogEntry &entry)
+{
+    return ReplicationRecord(TypeLogEntry, {entry.timestamp(), static_cast<int>(entry.level()), static_cast<int>(entry.source()), static_cast<int>(entry.eventType()),
+                                            entry.typeId(), QUuid(entry.thingId()), entry.value(), entry.active(), entry.errorCode()});
+}
+
+bool ReplicationRecord::isReplicatedSetting(int role, const QString &key)
+{
+    return role != NymeaSettings::SettingsRoleGlobal || (key != "Replication" && !key.startsWith("Replication/"));
+}
+
+LogEntry ReplicationRecord::toLogEntry() const
+{
+    if (arguments.count() != 9) {
+        return LogEntry();
+    }
+    LogEntry entry(arguments.at(0).toDateTime(),
+                   static_cast<Logging::LoggingLevel>(arguments.at(1).toInt()),
+                   static_cast<Logging::LoggingSource>(arguments.at(2).toInt()),
+                   arguments.at(8).toInt());
+    entry.setEventType(static_cast<Logging::LoggingEventType>(arguments.at(3).toInt()));
+    entry.setTypeId(arguments.at(4).toUuid());
+    entry.setThingId(ThingId(arguments.at(5).toUuid()));
+    entry.setValue(arguments.at(6));
+    entry.setActive(arguments.at(7).toBool());
+    return entry;
+}
+
+QDataStream &operator<<(QDataStream &stream, const ReplicationRecord &record)
+{
+    stream << record.sequence << static_cast<quint8>(record.type) << record.arguments;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, ReplicationRecord &record)
+{
+    quint8 type;
+    stream >> record.sequence >> type >> record.arguments;
+    record.type = static_cast<ReplicationRecord::Type>(type);
+    return stream;
+}
+
+ReplicationMessage::ReplicationMessage(Type type, const QVariantList &arguments):
+    type(type),
+    arguments(arguments)
+{
+}
+
+ReplicationConnection::ReplicationConnection(QSslSocket *socket, QObject *parent):
+    QObject(parent),
+    m_socket(socket)
+{
+    m_socket->setParent(this);
+    m_socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    connect(m_socket, &QSslSocket::readyRead, this, &ReplicationConnection::onReadyRead);
+    connect(m_socket, &QSslSocket::disconnected, this, &ReplicationConnection::disconnected);
+}
+
+QSslSocket *ReplicationConnection::socket() const
+{
+    return m_socket;
+}
+
+void ReplicationConnection::send(const ReplicationMessage &message)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << static_cast<quint8>(message.type) << message.arguments << message.records;
+
+    QByteArray frame;
+    QDataStream frameStream(&frame, QIODevice::WriteOnly);
+    frameStream << static_cast<quint32>(payload.size());
+    frame.append(payload);
+    m_socket->write(frame);
+}
+
+void ReplicationConnection::close()
+{
+    m_buffer.clear();
+    m_socket->abort();
+}
+
+QByteArray ReplicationConnection::createNonce()
+{
+    QByteArray nonce;
+    for (int i = 0; i < 4; i++) {
+        nonce.append(QUuid::createUuid().toRfc4122());
+    }
+    return nonce;
+}
+
+QByteArray ReplicationConnection::authenticate(const QByteArray &secret, Role role, const QByteArray &nonce, const QSslCertificate &primaryCertificate)
+{
+    QByteArray message = role == RolePrimary ? "primary:" : "standby:";
+    message.append(nonce);
+    message.append(primaryCertificate.digest(QCryptographicHash::Sha256));
+    return QMessageAuthenticationCode::hash(message, secret, QCryptographicHash::Sha256);
+}
+
+// Compares in constant time
+bool ReplicationConnection::verify(const QByteArray &expected, const QByteArray &received)
+{
+    char difference = expected.size() == received.size() && !expected.isEmpty() ? 0 : 1;
+    for (int i = 0; i < qMin(expected.size(), received.size()); i++) {
+        difference |= expected.at(i) ^ received.at(i);
+    }
+    return difference == 0;
+}
+
+void ReplicationConnection::onReadyRead()
+{
+    m_buffer.append(m_socket->readAll());
+
+    while (m_buffer.size() >= 4) {
+        quint32 size;
+        QDataStream sizeStream(m_buffer.left(4));
+        sizeStream >> size;
+        if (size > maxFrameSize) {
+            qCWarning(dcReplication()) << "Received a frame of" << size << "bytes from" << m_socket->peerAddress().toString() << ". Closing the connection.";
+            close();
+            return;
+        }
+        if (static_cast<quint32>(m_buffer.size()) < size + 4) {
+            return;
+        }
+
+        QByteArray payload = m_buffer.mid(4, size);
+        m_buffer.remove(0, size + 4);
+
+        ReplicationMessage message;
+        quint8 type;
+        QDataStream stream(payload);
+        stream.setVersion(QDataStream::Qt_5_6);
+        stream >> type >> message.arguments >> message.records;
+        if (stream.status() != QDataStream::Ok) {
+            qCWarning(dcReplication()) << "Received a malformed message from" << m_socket->peerAddress().toString() << ". Closing the connection.";
+            close();
+            return;
+        }
+        message.type = static_cast<ReplicationMessage::Type>(type);
+        emit messageReceived(message);
+    }
+}
+
+}
@@ -0,0 +1,135 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#ifndef REPLICATIONPROTOCOL_H
+#define REPLICATIONPROTOCOL_H
+
+#include "logging/logentry.h"
+
+#include <QObject>
+#include <QSslSocket>
+#include <QSslCertificate>
+#include <QLoggingCategory>
+#include <QDataStream>
+#include <QVariant>
+
+namespace nymeaserver {
+
+Q_DECLARE_LOGGING_CATEGORY(dcReplication)
+
+class ReplicationRecord
+{
+public:
+    enum Type {
+        TypeSettingChanged,     // role, key, value
+        TypeSettingRemoved,     // role, key
+        TypeSettingsCleared,    // role
+        TypeRuleStored,         // serialized rule
+        TypeRuleRemoved,        // ruleId
+        TypeRulesCleared,       //
+        TypeStateChanged,       // thingId, stateTypeId, value, minValue, maxValue
+        TypeThingStatesRemoved, // thingId
+        TypeLogEntry            // see fromLogEntry()
+    };
+
+    ReplicationRecord(Type type = TypeSettingChanged, const QVariantList &arguments = QVariantList());
+
+    static ReplicationRecord fromLogEntry(const LogEntry &entry);
+
+    // The Replication group of nymead.conf configures each instance on its own and is never replicated
+    static bool isReplicatedSetting(int role, const QString &key);
+    LogEntry toLogEntry() const;
+
+    // 0 for records of a snapshot
+    quint64 sequence = 0;
+    Type type = TypeSettingChanged;
+    QVariantList arguments;
+};
+
+QDataStream &operator<<(QDataStream &stream, const ReplicationRecord &record);
+QDataStream &operator>>(QDataStream &stream, ReplicationRecord &record);
+
+class ReplicationMessage
+{
+public:
+    enum Type {
+        TypeChallenge,      // primary -> standby: nonce
+        TypeHello,          // standby -> primary: proof of the primary's nonce, nonce, epoch, last applied sequence, term
+        TypeWelcome,        // primary -> standby: proof of the standby's nonce, term
+        TypeSnapshotBegin,  // primary -> standby: epoch
+        TypeSnapshotEnd,    // primary -> standby: sequence the snapshot corresponds to
+        TypeRecords,        // primary -> standby: records
+        TypeHeartbeat,      // primary -> standby: current sequence
+        TypeAck             // standby -> primary: last applied sequence
+    };
+
+    ReplicationMessage(Type type = TypeHeartbeat, const QVariantList &arguments = QVariantList());
+
+    Type type = TypeHeartbeat;
+    QVariantList arguments;
+    QList<ReplicationRecord> records;
+};
+
+// Length prefixed frames of a QDataStream serialized ReplicationMessage, over TLS
+class ReplicationConnection : public QObject
+{
+    Q_OBJECT
+public:
+    enum Role {
+        RolePrimary,
+        RoleStandby
+    };
+
+    explicit ReplicationConnection(QSslSocket *socket, QObject *parent = nullptr);
+
+    QSslSocket *socket() const;
+
+    void send(const ReplicationMessage &message);
+    void close();
+
+    static QByteArray createNonce();
+    // Proves the knowledge of the secret to the peer, bound to the role of the sender and to the primary's certificate
+    static QByteArray authenticate(const QByteArray &secret, Role role, const QByteArray &nonce, const QSslCertificate &primaryCertificate);
+    static bool verify(const QByteArray &expected, const QByteArray &received);
+
+signals:
+    void messageReceived(const ReplicationMessage &message);
+    void disconnected();
+
+private slots:
+    void onReadyRead();
+
+private:
+    QSslSocket *m_socket = nullptr;
+    QByteArray m_buffer;
+};
+
+}
+
+#endif // REPLICATIONPROTOCOL_H
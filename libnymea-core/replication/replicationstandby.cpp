@@ -0,0 +1,340 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*!
+    \class nymeaserver::ReplicationStandby
+    \brief Follows a replication primary as a hot standby.
+
+    \ingroup core
+    \inmodule core
+
+    A standby is configured by setting primary in the Replication section of nymead.conf to the host:port
+    of the primary and secret to the secret shared with it. The connection is encrypted with TLS, and
+    nothing is applied before the primary proved that it knows the secret as well. Instead of starting up nymea, the standby applies
+    the records streamed by the primary as they arrive: configuration changes are written through NymeaSettings,
+    rules to the rule store, states to the thing state cache and log entries to the log database. The position
+    of the last applied record is stored, so that a restarted standby continues where it stopped.
+
+    A standby never promotes itself, as it can't tell a primary which is down from one it is only cut off
+    from. It is promoted by removing primary from the Replication section and restarting it, nymea then
+    starts up with the replicated configuration. The promoted instance serves the next term: standbys
+    following it refuse primaries of an older term, and the old primary stops replicating as soon as a
+    standby of the new term connects to it.
+
+    \sa ReplicationPrimary
+*/
+
+#include "replicationstandby.h"
+#include "nymeaconfiguration.h"
+#include "nymeasettings.h"
+#include "logging/logengine.h"
+
+#include <QFile>
+#include <QDir>
+#include <QSslSocket>
+
+namespace nymeaserver {
+
+ReplicationStandby::ReplicationStandby(QObject *parent):
+    QObject(parent)
+{
+    m_configuration = new NymeaConfiguration(this);
+
+    QString primary = m_configuration->replicationPrimary();
+    int separator = primary.lastIndexOf(':');
+    m_host = primary.left(separator).remove('[').remove(']');
+    m_port = primary.mid(separator + 1).toUShort();
+    m_secret = m_configuration->replicationSecret();
+    if (separator < 0 || m_host.isEmpty() || m_port == 0) {
+        qCWarning(dcReplication()) << "Invalid replication primary" << primary << ". Expected host:port.";
+    }
+    if (m_secret.isEmpty()) {
+        qCWarning(dcReplication()) << "No replication secret configured in nymead.conf. The primary will not accept this standby.";
+    }
+
+    readPosition(&m_epoch, &m_sequence, &m_term);
+
+    ThingStateCache stateCache;
+    if (stateCache.open()) {
+        foreach (const ThingId &thingId, stateCache.thingIds()) {
+            m_states.insert(thingId, stateCache.states(thingId));
+        }
+    }
+
+    m_logEngine = new LogEngine(m_configuration->logDBDriver(), m_configuration->logDBName(), m_configuration->logDBHost(), m_configuration->logDBUser(), m_configuration->logDBPassword(), m_configuration->logDBMaxEntries(), this);
+    m_logEngine->setBatchingParameters(m_configuration->logDBBatchSize(), m_configuration->logDBBatchInterval());
+
+    m_reconnectTimer.setSingleShot(true);
+    m_reconnectTimer.setInterval(2000);
+    connect(&m_reconnectTimer, &QTimer::timeout, this, &ReplicationStandby::connectToPrimary);
+
+    m_persistTimer.setInterval(5000);
+    connect(&m_persistTimer, &QTimer::timeout, this, &ReplicationStandby::persist);
+    m_persistTimer.start();
+
+    qCInfo(dcReplication()) << "Running as hot standby of" << primary << "at record" << m_sequence;
+    connectToPrimary();
+}
+
+ReplicationStandby::~ReplicationStandby()
+{
+    persist();
+    // The log engine must be done with the database before nymea opens it
+    delete m_logEngine;
+}
+
+/*! Returns true if this instance is configured to run as hot standby. */
+bool ReplicationStandby::configured()
+{
+    // Called before anything else is set up, NymeaConfiguration would write its defaults already
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Replication");
+    return !settings.value("primary").toString().isEmpty();
+}
+
+/*! Reads the position stored by a standby into \a epoch, \a sequence and \a term. Returns false if there is none. */
+bool ReplicationStandby::readPosition(QUuid *epoch, quint64 *sequence, quint64 *term)
+{
+    QFile positionFile(positionFileName());
+    if (!positionFile.open(QFile::ReadOnly)) {
+        return false;
+    }
+    // Positions stored before terms were introduced have two fields
+    QList<QByteArray> position = positionFile.readAll().trimmed().split(' ');
+    if (position.count() < 2) {
+        return false;
+    }
+    *epoch = QUuid(position.at(0));
+    *sequence = position.at(1).toULongLong();
+    *term = position.value(2).toULongLong();
+    return true;
+}
+
+QString ReplicationStandby::positionFileName()
+{
+    return NymeaSettings::storagePath() + "/replication-position";
+}
+
+void ReplicationStandby::connectToPrimary()
+{
+    QSslSocket *socket = new QSslSocket(this);
+    m_connection = new ReplicationConnection(socket, this);
+    m_nonce.clear();
+    m_authenticated = false;
+    connect(m_connection, &ReplicationConnection::messageReceived, this, &ReplicationStandby::onMessageReceived);
+    connect(m_connection, &ReplicationConnection::disconnected, this, &ReplicationStandby::onDisconnected);
+    connect(socket, static_cast<void(QSslSocket::*)(QAbstractSocket::SocketError)>(&QSslSocket::error), this, [this, socket](){
+        if (socket->state() == QAbstractSocket::UnconnectedState) {
+            qCDebug(dcReplication()) << "Could not connect to primary:" << socket->errorString();
+            onDisconnected();
+        }
+    });
+    // The primary usually has a self signed certificate. Its identity is verified by the proof in the
+    // welcome message instead, which covers the certificate presented here.
+    connect(socket, static_cast<void(QSslSocket::*)(const QList<QSslError> &)>(&QSslSocket::sslErrors), socket, [socket](){
+        socket->ignoreSslErrors();
+    });
+    socket->connectToHostEncrypted(m_host, m_port);
+}
+
+void ReplicationStandby::onMessageReceived(const ReplicationMessage &message)
+{
+    if (!m_authenticated) {
+        if (message.type == ReplicationMessage::TypeChallenge && m_nonce.isEmpty()) {
+            m_nonce = ReplicationConnection::createNonce();
+            QByteArray proof = ReplicationConnection::authenticate(m_secret, ReplicationConnection::RoleStandby, message.arguments.value(0).toByteArray(), m_connection->socket()->peerCertificate());
+            m_connection->send(ReplicationMessage(ReplicationMessage::TypeHello, {proof, m_nonce, m_epoch, m_sequence, m_term}));
+            return;
+        }
+        QByteArray expected = ReplicationConnection::authenticate(m_secret, ReplicationConnection::RolePrimary, m_nonce, m_connection->socket()->peerCertificate());
+        if (message.type != ReplicationMessage::TypeWelcome || m_nonce.isEmpty() || !ReplicationConnection::verify(expected, message.arguments.value(0).toByteArray())) {
+            qCWarning(dcReplication()) << "The primary at" << m_host << m_port << "failed to authenticate. Not applying anything from it.";
+            m_connection->close();
+            return;
+        }
+        quint64 term = message.arguments.value(1).toULongLong();
+        if (term < m_term) {
+            qCWarning(dcReplication()) << "The primary at" << m_host << m_port << "serves term" << term << "but term" << m_term << "has been seen already. Not following a superseded primary.";
+            m_connection->close();
+            return;
+        }
+        qCInfo(dcReplication()) << "Authenticated primary at" << m_host << m_port << "of term" << term;
+        if (term > m_term) {
+            m_term = term;
+            m_dirty = true;
+        }
+        m_authenticated = true;
+        return;
+    }
+
+    switch (message.type) {
+    case ReplicationMessage::TypeSnapshotBegin:
+        // Until the snapshot is complete the copy is of no use
+        qCInfo(dcReplication()) << "Receiving snapshot from primary";
+        m_epoch = QUuid();
+        m_sequence = 0;
+        m_states.clear();
+        m_dirty = true;
+        persist();
+        m_epoch = message.arguments.value(0).toUuid();
+        break;
+    case ReplicationMessage::TypeSnapshotEnd:
+        m_sequence = message.arguments.value(0).toULongLong();
+        qCInfo(dcReplication()) << "Snapshot complete at record" << m_sequence;
+        m_dirty = true;
+        persist();
+        break;
+    case ReplicationMessage::TypeRecords:
+        foreach (const ReplicationRecord &record, message.records) {
+            if (record.sequence != 0 && record.sequence <= m_sequence) {
+                continue;
+            }
+            apply(record);
+            if (record.sequence != 0) {
+                m_sequence = record.sequence;
+            }
+        }
+        m_dirty = true;
+        break;
+    case ReplicationMessage::TypeHeartbeat:
+        m_connection->send(ReplicationMessage(ReplicationMessage::TypeAck, {m_sequence}));
+        break;
+    default:
+        break;
+    }
+}
+
+void ReplicationStandby::onDisconnected()
+{
+    if (!m_connection) {
+        return;
+    }
+    qCDebug(dcReplication()) << "Disconnected from primary";
+    m_connection->disconnect(this);
+    m_connection->socket()->disconnect(this);
+    m_connection->deleteLater();
+    m_connection = nullptr;
+    m_reconnectTimer.start();
+}
+
+void ReplicationStandby::persist()
+{
+    if (!m_dirty) {
+        return;
+    }
+    m_dirty = false;
+
+    foreach (int role, m_changedRoles) {
+        NymeaSettings(static_cast<NymeaSettings::SettingsRole>(role)).sync();
+    }
+    m_changedRoles.clear();
+
+    ThingStateCache::write(ThingStateCache::defaultFileName(), m_states);
+
+    // The position is written last, records applied after it are applied once more after a restart
+    QDir().mkpath(NymeaSettings::storagePath());
+    QFile positionFile(positionFileName());
+    if (!positionFile.open(QFile::WriteOnly | QFile::Truncate)) {
+        qCWarning(dcReplication()) << "Could not store the replication position to" << positionFile.fileName() << positionFile.errorString();
+        return;
+    }
+    positionFile.write(m_epoch.toByteArray() + ' ' + QByteArray::number(m_sequence) + ' ' + QByteArray::number(m_term));
+}
+
+void ReplicationStandby::apply(const ReplicationRecord &record)
+{
+    const QVariantList &arguments = record.arguments;
+    if (record.type == ReplicationRecord::TypeSettingChanged || record.type == ReplicationRecord::TypeSettingRemoved) {
+        if (!ReplicationRecord::isReplicatedSetting(arguments.value(0).toInt(), arguments.value(1).toString())) {
+            return;
+        }
+    }
+
+    switch (record.type) {
+    case ReplicationRecord::TypeSettingChanged:
+        NymeaSettings(static_cast<NymeaSettings::SettingsRole>(arguments.value(0).toInt())).setValue(arguments.value(1).toString(), arguments.value(2));
+        m_changedRoles.insert(arguments.value(0).toInt());
+        break;
+    case ReplicationRecord::TypeSettingRemoved:
+        NymeaSettings(static_cast<NymeaSettings::SettingsRole>(arguments.value(0).toInt())).remove(arguments.value(1).toString());
+        m_changedRoles.insert(arguments.value(0).toInt());
+        break;
+    case ReplicationRecord::TypeSettingsCleared: {
+        // Keep the local replication configuration of this standby
+        NymeaSettings settings(static_cast<NymeaSettings::SettingsRole>(arguments.value(0).toInt()));
+        QVariantMap localSettings;
+        foreach (const QString &key, settings.allKeys()) {
+            if (!ReplicationRecord::isReplicatedSetting(arguments.value(0).toInt(), key)) {
+                localSettings.insert(key, settings.value(key));
+            }
+        }
+        settings.clear();
+        foreach (const QString &key, localSettings.keys()) {
+            settings.setValue(key, localSettings.value(key));
+        }
+        m_changedRoles.insert(arguments.value(0).toInt());
+        break;
+    }
+    case ReplicationRecord::TypeRuleStored: {
+        Rule rule;
+        if (RuleStore::deserialize(arguments.value(0).toByteArray(), &rule)) {
+            m_ruleStore.storeRule(rule);
+        } else {
+            qCWarning(dcReplication()) << "Could not deserialize replicated rule";
+        }
+        break;
+    }
+    case ReplicationRecord::TypeRuleRemoved:
+        m_ruleStore.removeRule(RuleId(arguments.value(0).toUuid()));
+        m_logEngine->removeRuleLogs(RuleId(arguments.value(0).toUuid()));
+        break;
+    case ReplicationRecord::TypeRulesCleared:
+        QDir().mkpath(m_ruleStore.path());
+        foreach (const RuleId &ruleId, m_ruleStore.ruleIds()) {
+            m_ruleStore.removeRule(ruleId);
+        }
+        break;
+    case ReplicationRecord::TypeStateChanged: {
+        ThingStateCache::CachedState &state = m_states[ThingId(arguments.value(0).toUuid())][StateTypeId(arguments.value(1).toUuid())];
+        state.value = arguments.value(2);
+        state.minValue = arguments.value(3);
+        state.maxValue = arguments.value(4);
+        break;
+    }
+    case ReplicationRecord::TypeThingStatesRemoved:
+        m_states.remove(ThingId(arguments.value(0).toUuid()));
+        m_logEngine->removeThingLogs(ThingId(arguments.value(0).toUuid()));
+        break;
+    case ReplicationRecord::TypeLogEntry:
+        m_logEngine->appendReplicatedEntry(record.toLogEntry());
+        break;
+    }
+}
+
+}
@@ -0,0 +1,97 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#ifndef REPLICATIONSTANDBY_H
+#define REPLICATIONSTANDBY_H
+
+#include "replicationprotocol.h"
+#include "ruleengine/rulestore.h"
+#include "integrations/thingstatecache.h"
+
+#include <QObject>
+#include <QTimer>
+#include <QUuid>
+#include <QSet>
+
+namespace nymeaserver {
+
+class NymeaConfiguration;
+class LogEngine;
+
+class ReplicationStandby : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ReplicationStandby(QObject *parent = nullptr);
+    ~ReplicationStandby() override;
+
+    static bool configured();
+
+    // The position of the last applied record, false if this instance has never been a standby
+    static bool readPosition(QUuid *epoch, quint64 *sequence, quint64 *term);
+    static QString positionFileName();
+
+private slots:
+    void connectToPrimary();
+    void onMessageReceived(const ReplicationMessage &message);
+    void onDisconnected();
+    void persist();
+
+private:
+    void apply(const ReplicationRecord &record);
+
+    QString m_host;
+    quint16 m_port = 0;
+    QByteArray m_secret;
+
+    ReplicationConnection *m_connection = nullptr;
+    // Nothing is applied before the primary proved the knowledge of the secret
+    QByteArray m_nonce;
+    bool m_authenticated = false;
+    QTimer m_reconnectTimer;
+    QTimer m_persistTimer;
+
+    // Position of the last applied record. A null epoch means there is no complete copy yet.
+    QUuid m_epoch;
+    quint64 m_sequence = 0;
+    // The highest term of a primary seen so far. Primaries of a lower term have been superseded.
+    quint64 m_term = 0;
+
+    bool m_dirty = false;
+    QSet<int> m_changedRoles;
+    ThingStateCache::Snapshot m_states;
+    RuleStore m_ruleStore;
+
+    NymeaConfiguration *m_configuration = nullptr;
+    LogEngine *m_logEngine = nullptr;
+};
+
+}
+
+#endif // REPLICATIONSTANDBY_H
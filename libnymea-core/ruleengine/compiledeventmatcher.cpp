@@ -0,0 +1,207 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*!
+    \class nymeaserver::CompiledEventMatcher
+    \brief Matches events against the \l{EventDescriptor}{EventDescriptors} of a rule.
+
+    The param descriptors of each event descriptor are resolved once per thing class: param names are translated
+    to \l{ParamTypeId}{ParamTypeIds}, the comparison values are converted to the native type of the param and
+    interface descriptors remember whether the thing class implements the interface event. Matching an event is
+    then a hash lookup followed by a few typed compares.
+*/
+
+#include "compiledeventmatcher.h"
+#include "loggingcategories.h"
+
+namespace nymeaserver {
+
+CompiledEventMatcher::CompiledEventMatcher()
+{
+
+}
+
+CompiledEventMatcher::CompiledEventMatcher(const QList<EventDescriptor> &eventDescriptors)
+{
+    foreach (const EventDescriptor &eventDescriptor, eventDescriptors) {
+        Descriptor descriptor;
+        descriptor.descriptor = eventDescriptor;
+        m_descriptors.append(descriptor);
+    }
+}
+
+/*! Returns true if the given \a event, emitted by a thing of the given \a thingClass, matches any of the event
+    descriptors. */
+bool CompiledEventMatcher::matches(const Event &event, const ThingClass &thingClass)
+{
+    for (int i = 0; i < m_descriptors.count(); i++) {
+        Descriptor &descriptor = m_descriptors[i];
+        // If this is a thing based rule, eventTypeId and thingId must match
+        if (descriptor.descriptor.type() == EventDescriptor::TypeThing) {
+            if (descriptor.descriptor.eventTypeId() != event.eventTypeId() || descriptor.descriptor.thingId() != event.thingId()) {
+                continue;
+            }
+        }
+
+        QPair<ThingClassId, EventTypeId> key = qMakePair(thingClass.id(), event.eventTypeId());
+        QHash<QPair<ThingClassId, EventTypeId>, Resolution>::const_iterator it = descriptor.resolutions.constFind(key);
+        if (it == descriptor.resolutions.constEnd()) {
+            it = descriptor.resolutions.insert(key, resolve(descriptor.descriptor, thingClass.getEventType(event.eventTypeId()), thingClass));
+        }
+        const Resolution &resolution = it.value();
+        if (!resolution.matchesEvent) {
+            continue;
+        }
+
+        const ParamList eventParams = event.params();
+        bool allOK = true;
+        foreach (const CompiledParam &param, resolution.params) {
+            if (!matchesParam(param, eventParams.paramValue(param.paramTypeId))) {
+                allOK = false;
+                break;
+            }
+        }
+        // All matching!
+        if (allOK) {
+            return true;
+        }
+    }
+    return false;
+}
+
+CompiledEventMatcher::Resolution CompiledEventMatcher::resolve(const EventDescriptor &eventDescriptor, const EventType &eventType, const ThingClass &thingClass)
+{
+    Resolution resolution;
+    // If this is a interface based rule, the thing must implement the interface and the event name must match
+    if (eventDescriptor.type() == EventDescriptor::TypeInterface) {
+        if (!thingClass.interfaces().contains(eventDescriptor.interface()) || eventType.name() != eventDescriptor.interfaceEvent()) {
+            return resolution;
+        }
+    }
+
+    resolution.matchesEvent = true;
+    foreach (const ParamDescriptor &paramDescriptor, eventDescriptor.paramDescriptors()) {
+        ParamType paramType;
+        if (!paramDescriptor.paramTypeId().isNull()) {
+            paramType = eventType.paramTypes().findById(paramDescriptor.paramTypeId());
+        } else if (!paramDescriptor.paramName().isEmpty()) {
+            paramType = eventType.paramTypes().findByName(paramDescriptor.paramName());
+        } else {
+            qCWarning(dcRuleEngine()) << "ParamDescriptor invalid. Either paramTypeId or paramName are required";
+            resolution.matchesEvent = false;
+            return resolution;
+        }
+
+        CompiledParam param;
+        param.paramTypeId = paramType.id().isNull() ? paramDescriptor.paramTypeId() : paramType.id();
+        param.operatorType = paramDescriptor.operatorType();
+        param.variantValue = paramDescriptor.value();
+        QVariant value = paramDescriptor.value();
+        switch (paramType.type()) {
+        case QVariant::Int:
+        case QVariant::UInt:
+        case QVariant::LongLong:
+        case QVariant::ULongLong:
+            if (value.convert(QVariant::LongLong)) {
+                param.kind = ValueKindInt;
+                param.intValue = value.toLongLong();
+            }
+            break;
+        case QVariant::Double:
+            if (value.convert(QVariant::Double)) {
+                param.kind = ValueKindDouble;
+                param.doubleValue = value.toDouble();
+            }
+            break;
+        case QVariant::Bool:
+            param.kind = ValueKindBool;
+            param.boolValue = value.toBool();
+            break;
+        case QVariant::String:
+            param.kind = ValueKindString;
+            param.stringValue = value.toString();
+            break;
+        default:
+            break;
+        }
+        resolution.params.append(param);
+    }
+    return resolution;
+}
+
+bool CompiledEventMatcher::matchesParam(const CompiledParam &param, const QVariant &value)
+{
+    if (!value.isValid()) {
+        // The event does not carry this param
+        return param.operatorType == Types::ValueOperatorNotEquals;
+    }
+
+    // -1: less, 0: equal, 1: greater
+    int comparison = 0;
+    switch (param.kind) {
+    case ValueKindInt: {
+        qint64 intValue = value.toLongLong();
+        comparison = intValue < param.intValue ? -1 : (intValue > param.intValue ? 1 : 0);
+        break;
+    }
+    case ValueKindDouble: {
+        double doubleValue = value.toDouble();
+        comparison = doubleValue < param.doubleValue ? -1 : (doubleValue > param.doubleValue ? 1 : 0);
+        break;
+    }
+    case ValueKindBool:
+        comparison = value.toBool() == param.boolValue ? 0 : (value.toBool() ? 1 : -1);
+        break;
+    case ValueKindString:
+        comparison = value.toString().compare(param.stringValue);
+        comparison = comparison < 0 ? -1 : (comparison > 0 ? 1 : 0);
+        break;
+    case ValueKindVariant:
+        comparison = value < param.variantValue ? -1 : (value == param.variantValue ? 0 : 1);
+        break;
+    }
+
+    switch (param.operatorType) {
+    case Types::ValueOperatorEquals:
+        return comparison == 0;
+    case Types::ValueOperatorNotEquals:
+        return comparison != 0;
+    case Types::ValueOperatorGreater:
+        return comparison > 0;
+    case Types::ValueOperatorGreaterOrEqual:
+        return comparison >= 0;
+    case Types::ValueOperatorLess:
+        return comparison < 0;
+    case Types::ValueOperatorLessOrEqual:
+        return comparison <= 0;
+    }
+    return false;
+}
+
+}
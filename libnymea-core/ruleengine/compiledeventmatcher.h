@@ -0,0 +1,93 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#ifndef COMPILEDEVENTMATCHER_H
+#define COMPILEDEVENTMATCHER_H
+
+#include "types/event.h"
+#include "types/eventdescriptor.h"
+#include "types/thingclass.h"
+
+#include <QHash>
+#include <QPair>
+#include <QVector>
+
+namespace nymeaserver {
+
+class CompiledEventMatcher
+{
+public:
+    CompiledEventMatcher();
+    explicit CompiledEventMatcher(const QList<EventDescriptor> &eventDescriptors);
+
+    bool matches(const Event &event, const ThingClass &thingClass);
+
+private:
+    enum ValueKind {
+        ValueKindInt,
+        ValueKindDouble,
+        ValueKindBool,
+        ValueKindString,
+        ValueKindVariant
+    };
+
+    class CompiledParam {
+    public:
+        ParamTypeId paramTypeId;
+        Types::ValueOperator operatorType = Types::ValueOperatorEquals;
+        ValueKind kind = ValueKindVariant;
+        qint64 intValue = 0;
+        double doubleValue = 0;
+        bool boolValue = false;
+        QString stringValue;
+        QVariant variantValue;
+    };
+
+    // The param descriptors of a descriptor resolved against the event type of one thing class
+    class Resolution {
+    public:
+        bool matchesEvent = false;
+        QVector<CompiledParam> params;
+    };
+
+    class Descriptor {
+    public:
+        EventDescriptor descriptor;
+        QHash<QPair<ThingClassId, EventTypeId>, Resolution> resolutions;
+    };
+
+    static Resolution resolve(const EventDescriptor &eventDescriptor, const EventType &eventType, const ThingClass &thingClass);
+    static bool matchesParam(const CompiledParam &param, const QVariant &value);
+
+    QVector<Descriptor> m_descriptors;
+};
+
+}
+
+#endif // COMPILEDEVENTMATCHER_H
@@ -0,0 +1,248 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::CompiledStateEvaluator
+    \brief Evaluates a \l{StateEvaluator} tree incrementally.
+
+    The tree is flattened into nodes which cache the result of their state descriptor and the number of matching
+    operands. When a state changes, only the descriptors reading that state are evaluated again and the new result
+    is carried up towards the root until a node's result stays the same. Operands that did not change are never
+    looked at again, so a state change costs O(depth) instead of a full evaluation of the tree.
+
+    State descriptors with a hold time only start matching once their condition held for that long. The
+    evaluator only remembers when that will be, see nextHoldDeadline(), and it is up to the owner to call
+    updateTime() once it has passed. Descriptors with a hysteresis are evaluated against the relaxed value
+    while they are matching, so they only stop matching once the value moved past it by the hysteresis.
+*/
+
+#include "compiledstateevaluator.h"
+#include "loggingcategories.h"
+#include "nymeacore.h"
+
+namespace nymeaserver {
+
+CompiledStateEvaluator::CompiledStateEvaluator()
+{
+
+}
+
+CompiledStateEvaluator::CompiledStateEvaluator(const StateEvaluator &stateEvaluator)
+{
+    compile(stateEvaluator, -1);
+}
+
+/*! Returns the cached result of the whole tree. */
+bool CompiledStateEvaluator::result() const
+{
+    if (m_nodes.isEmpty()) {
+        return true;
+    }
+    return m_nodes.first().result;
+}
+
+/*! Evaluates all state descriptors of the tree and returns the result. */
+bool CompiledStateEvaluator::evaluate()
+{
+    for (int i = 0; i < m_nodes.count(); i++) {
+        m_nodes[i].matchingOperands = 0;
+    }
+    // Children come after their parent, going backwards settles all children before their parent
+    for (int i = m_nodes.count() - 1; i >= 0; i--) {
+        Node &node = m_nodes[i];
+        if (node.descriptor.isValid()) {
+            node.descriptorResult = evaluateLeaf(node, QDateTime());
+            node.matchingOperands += node.descriptorResult ? 1 : 0;
+        }
+        node.result = nodeResult(node);
+        if (node.parent >= 0) {
+            m_nodes[node.parent].matchingOperands += node.result ? 1 : 0;
+        }
+    }
+    return result();
+}
+
+/*! Re-evaluates the state descriptors depending on the state with the given \a stateTypeId of the thing with the given
+    \a thingId, which implements the given \a interfaces. Returns false if the tree does not depend on this state at all.
+*/
+bool CompiledStateEvaluator::updateState(const ThingId &thingId, const StateTypeId &stateTypeId, const QStringList &interfaces)
+{
+    QList<int> leaves = m_stateLeaves.value(qMakePair(thingId, stateTypeId));
+    foreach (const QString &interface, interfaces) {
+        leaves.append(m_interfaceLeaves.value(interface));
+    }
+    if (leaves.isEmpty()) {
+        return false;
+    }
+    foreach (int index, leaves) {
+        updateLeaf(index);
+    }
+    return true;
+}
+
+/*! Returns true if any of the state descriptors has a hold time. */
+bool CompiledStateEvaluator::hasHoldTimes() const
+{
+    return !m_holdLeaves.isEmpty();
+}
+
+/*! Returns the earliest time a state descriptor's hold time passes, or an invalid QDateTime if no descriptor
+    is waiting for its hold time. */
+QDateTime CompiledStateEvaluator::nextHoldDeadline() const
+{
+    QDateTime deadline;
+    foreach (int index, m_holdLeaves) {
+        const QDateTime &holdUntil = m_nodes.at(index).holdUntil;
+        if (holdUntil.isValid() && (!deadline.isValid() || holdUntil < deadline)) {
+            deadline = holdUntil;
+        }
+    }
+    return deadline;
+}
+
+/*! Lets the state descriptors whose hold time passed at the given \a dateTime start matching. */
+void CompiledStateEvaluator::updateTime(const QDateTime &dateTime)
+{
+    foreach (int index, m_holdLeaves) {
+        const QDateTime &holdUntil = m_nodes.at(index).holdUntil;
+        if (holdUntil.isValid() && holdUntil <= dateTime) {
+            updateLeaf(index, dateTime);
+        }
+    }
+}
+
+int CompiledStateEvaluator::compile(const StateEvaluator &stateEvaluator, int parent)
+{
+    int index = m_nodes.count();
+    Node node;
+    node.parent = parent;
+    node.operatorType = stateEvaluator.operatorType();
+    node.descriptor = stateEvaluator.stateDescriptor();
+    node.operandCount = stateEvaluator.childEvaluators().count();
+    if (node.descriptor.isValid()) {
+        node.operandCount++;
+        if (node.descriptor.holdTime() > 0) {
+            m_holdLeaves.append(index);
+        }
+        if (node.descriptor.type() == StateDescriptor::TypeThing) {
+            m_stateLeaves[qMakePair(node.descriptor.thingId(), node.descriptor.stateTypeId())].append(index);
+            if (!node.descriptor.valueThingId().isNull()) {
+                m_stateLeaves[qMakePair(node.descriptor.valueThingId(), node.descriptor.valueStateTypeId())].append(index);
+            }
+        } else {
+            m_interfaceLeaves[node.descriptor.interface()].append(index);
+        }
+    }
+    m_nodes.append(node);
+
+    foreach (const StateEvaluator &childEvaluator, stateEvaluator.childEvaluators()) {
+        compile(childEvaluator, index);
+    }
+    return index;
+}
+
+bool CompiledStateEvaluator::nodeResult(const Node &node) const
+{
+    if (node.operatorType == Types::StateOperatorOr) {
+        return node.matchingOperands > 0;
+    }
+    return node.matchingOperands == node.operandCount;
+}
+
+bool CompiledStateEvaluator::evaluateLeaf(Node &leaf, const QDateTime &dateTime)
+{
+    StateDescriptor descriptor = leaf.descriptor;
+    // A matching descriptor only stops matching once the value is past the hysteresis
+    if (leaf.descriptorResult && descriptor.hysteresis() > 0 && !descriptor.stateValue().isNull()) {
+        bool numeric = false;
+        double value = descriptor.stateValue().toDouble(&numeric);
+        if (numeric) {
+            switch (descriptor.operatorType()) {
+            case Types::ValueOperatorGreater:
+            case Types::ValueOperatorGreaterOrEqual:
+                descriptor.setStateValue(value - descriptor.hysteresis());
+                break;
+            case Types::ValueOperatorLess:
+            case Types::ValueOperatorLessOrEqual:
+                descriptor.setStateValue(value + descriptor.hysteresis());
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    if (!StateEvaluator::evaluateDescriptor(descriptor)) {
+        leaf.holdUntil = QDateTime();
+        return false;
+    }
+    if (leaf.descriptorResult || descriptor.holdTime() == 0) {
+        return true;
+    }
+
+    // The condition holds, but not for long enough yet
+    QDateTime now = dateTime.isValid() ? dateTime : NymeaCore::instance()->timeManager()->currentDateTime();
+    if (!leaf.holdUntil.isValid()) {
+        leaf.holdUntil = now.addSecs(descriptor.holdTime());
+        qCDebug(dcRuleEngineDebug()) << "State descriptor matching, waiting for its hold time until" << leaf.holdUntil;
+    }
+    if (leaf.holdUntil > now) {
+        return false;
+    }
+    leaf.holdUntil = QDateTime();
+    return true;
+}
+
+void CompiledStateEvaluator::updateLeaf(int index, const QDateTime &dateTime)
+{
+    Node &leaf = m_nodes[index];
+    bool descriptorResult = evaluateLeaf(leaf, dateTime);
+    if (descriptorResult == leaf.descriptorResult) {
+        return;
+    }
+    leaf.descriptorResult = descriptorResult;
+    leaf.matchingOperands += descriptorResult ? 1 : -1;
+
+    while (index >= 0) {
+        Node &node = m_nodes[index];
+        bool nodeResult = this->nodeResult(node);
+        if (nodeResult == node.result) {
+            return;
+        }
+        qCDebug(dcRuleEngineDebug()) << "StateEvaluator node" << index << "changed to" << nodeResult;
+        node.result = nodeResult;
+        index = node.parent;
+        if (index >= 0) {
+            m_nodes[index].matchingOperands += nodeResult ? 1 : -1;
+        }
+    }
+}
+
+}
@@ -0,0 +1,87 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef COMPILEDSTATEEVALUATOR_H
+#define COMPILEDSTATEEVALUATOR_H
+
+#include "stateevaluator.h"
+
+#include <QDateTime>
+#include <QHash>
+#include <QPair>
+#include <QVector>
+
+namespace nymeaserver {
+
+class CompiledStateEvaluator
+{
+public:
+    CompiledStateEvaluator();
+    explicit CompiledStateEvaluator(const StateEvaluator &stateEvaluator);
+
+    bool result() const;
+
+    bool evaluate();
+    bool updateState(const ThingId &thingId, const StateTypeId &stateTypeId, const QStringList &interfaces);
+
+    bool hasHoldTimes() const;
+    QDateTime nextHoldDeadline() const;
+    void updateTime(const QDateTime &dateTime);
+
+private:
+    class Node {
+    public:
+        int parent = -1;
+        Types::StateOperator operatorType = Types::StateOperatorAnd;
+        StateDescriptor descriptor;
+        bool descriptorResult = false;
+        // Set while the descriptor's condition holds but its hold time has not passed yet
+        QDateTime holdUntil;
+        // The descriptor, if valid, and the child nodes
+        int operandCount = 0;
+        int matchingOperands = 0;
+        bool result = false;
+    };
+
+    int compile(const StateEvaluator &stateEvaluator, int parent);
+    bool nodeResult(const Node &node) const;
+    void updateLeaf(int index, const QDateTime &dateTime = QDateTime());
+    static bool evaluateLeaf(Node &leaf, const QDateTime &dateTime);
+
+    // Parents are always stored before their children
+    QVector<Node> m_nodes;
+    QHash<QPair<ThingId, StateTypeId>, QList<int>> m_stateLeaves;
+    QHash<QString, QList<int>> m_interfaceLeaves;
+    QList<int> m_holdLeaves;
+};
+
+}
+
+#endif // COMPILEDSTATEEVALUATOR_H
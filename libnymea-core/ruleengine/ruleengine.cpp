@@ -126,15 +126,143 @@
 #include <QStringList>
 #include <QStandardPaths>
 #include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QDir>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+
+#include <algorithm>
+#include <functional>
 
 namespace nymeaserver {
 
+// Returns the earliest time after dateTime at which the result of the given timeDescriptor may change. Week and month
+// days are not taken into account, so this may be earlier than the actual transition, but never later.
+static QDateTime nextTimeTransition(const TimeDescriptor &timeDescriptor, const QDateTime &dateTime)
+{
+    // Times of the day and seconds within each hour at which anything may change
+    QList<QTime> dailyTimes = { QTime(0, 0) };
+    QList<int> hourlyOffsets;
+
+    foreach (const CalendarItem &calendarItem, timeDescriptor.calendarItems()) {
+        int duration = static_cast<int>(calendarItem.duration());
+        if (calendarItem.startTime().isValid() && calendarItem.repeatingOption().mode() == RepeatingOption::RepeatingModeHourly) {
+            hourlyOffsets << calendarItem.startTime().minute() * 60 << (calendarItem.startTime().minute() + duration) % 60 * 60;
+            continue;
+        }
+        QList<QTime> startTimes;
+        if (calendarItem.startTime().isValid()) {
+            startTimes << calendarItem.startTime();
+        } else {
+            startTimes << calendarItem.dateTime().time() << calendarItem.dateTime().toTimeSpec(dateTime.timeSpec()).time();
+        }
+        foreach (const QTime &startTime, startTimes) {
+            QTime endTime = startTime.addSecs(duration % 1440 * 60);
+            // Ends are calculated with addSecs() and move by an hour when crossing a daylight saving time change
+            dailyTimes << startTime << endTime << endTime.addSecs(-3600) << endTime.addSecs(3600);
+        }
+    }
+
+    foreach (const TimeEventItem &timeEventItem, timeDescriptor.timeEventItems()) {
+        if (timeEventItem.time().isValid() && timeEventItem.repeatingOption().mode() == RepeatingOption::RepeatingModeHourly) {
+            hourlyOffsets << timeEventItem.time().minute() * 60 + timeEventItem.time().second();
+        } else if (timeEventItem.time().isValid()) {
+            dailyTimes << timeEventItem.time();
+        } else {
+            dailyTimes << timeEventItem.dateTime().time() << timeEventItem.dateTime().toTimeSpec(dateTime.timeSpec()).time();
+        }
+    }
+
+    QDateTime next;
+    foreach (const QTime &time, dailyTimes) {
+        QDateTime candidate = dateTime;
+        candidate.setTime(time);
+        if (candidate <= dateTime) {
+            candidate = candidate.addDays(1);
+            candidate.setTime(time);
+        }
+        if (!next.isValid() || candidate < next) {
+            next = candidate;
+        }
+    }
+    QDateTime hourStart = dateTime;
+    hourStart.setTime(QTime(dateTime.time().hour(), 0));
+    foreach (int offset, hourlyOffsets) {
+        QDateTime candidate = hourStart.addSecs(offset);
+        if (candidate <= dateTime) {
+            candidate = candidate.addSecs(3600);
+        }
+        if (candidate < next) {
+            next = candidate;
+        }
+    }
+    return next;
+}
+
+// Calls function with each index from 0 to count - 1. Large counts are split into contiguous partitions of at least
+// minimumPartitionSize indexes which run in the global thread pool, the calling thread takes the first one itself.
+static void parallelFor(int count, int minimumPartitionSize, const std::function<void(int index)> &function)
+{
+    int partitions = minimumPartitionSize > 0 ? qMin(QThread::idealThreadCount(), count / minimumPartitionSize) : 1;
+    if (partitions <= 1) {
+        for (int i = 0; i < count; i++) {
+            function(i);
+        }
+        return;
+    }
+    int partitionSize = (count + partitions - 1) / partitions;
+    QList<QFuture<void>> futures;
+    for (int start = partitionSize; start < count; start += partitionSize) {
+        int end = qMin(count, start + partitionSize);
+        futures.append(QtConcurrent::run([&function, start, end](){
+            for (int i = start; i < end; i++) {
+                function(i);
+            }
+        }));
+    }
+    for (int i = 0; i < partitionSize; i++) {
+        function(i);
+    }
+    foreach (QFuture<void> future, futures) {
+        future.waitForFinished();
+    }
+}
+
+// The outcome of evaluating the time descriptor of a rule, which only depends on the rule and the time
+class TimeEvaluation {
+public:
+    const Rule *rule = nullptr;
+    bool timeEventFired = false;
+    bool result = false;
+    QDateTime nextTransition;
+};
+
+template <typename Key>
+static void updateIndex(QHash<Key, QSet<RuleId>> &index, const Key &key, const RuleId &ruleId, bool add)
+{
+    if (add) {
+        index[key].insert(ruleId);
+        return;
+    }
+    typename QHash<Key, QSet<RuleId>>::iterator it = index.find(key);
+    if (it == index.end()) {
+        return;
+    }
+    it->remove(ruleId);
+    if (it->isEmpty()) {
+        index.erase(it);
+    }
+}
+
 /*! Constructs the RuleEngine with the given \a parent. Although it wouldn't harm to have multiple RuleEngines, there is one
     instance available from \l{NymeaCore}. This one should be used instead of creating multiple ones.
  */
 RuleEngine::RuleEngine(QObject *parent) :
     QObject(parent)
 {
+    if (qEnvironmentVariableIsSet("NYMEA_RULE_ENGINE_PARTITION_SIZE")) {
+        m_parallelPartitionSize = qEnvironmentVariableIntValue("NYMEA_RULE_ENGINE_PARTITION_SIZE");
+    }
 }
 
 /*! Destructor of the \l{RuleEngine}. */
@@ -144,19 +272,19 @@ RuleEngine::~RuleEngine()
 
 /*! Ask the Engine to evaluate all the rules for the given \a event.
     This will search all the \l{Rule}{Rules} triggered by the given \a event
-    and evaluate their states in the system. It will return a
-    list of all \l{Rule}{Rules} that are triggered or change its active state
-    because of this \a event.
+    and evaluate their states in the system. It will return the ids of
+    all \l{Rule}{Rules} that are triggered or change its active state
+    because of this \a event. Use ruleDefinition() and ruleState() to look them up.
 */
-QList<Rule> RuleEngine::evaluateEvent(const Event &event)
+QList<RuleId> RuleEngine::evaluateEvent(const Event &event)
 {
     Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(event.thingId());
     if (!thing) {
         qCWarning(dcRuleEngine()) << "Invalid event. ThingID does not reference a valid thing";
-        return QList<Rule>();
+        return QList<RuleId>();
     }
     ThingClass thingClass = NymeaCore::instance()->thingManager()->findThingClass(thing->thingClassId());
-    EventType eventType = thingClass.eventTypes().findById(event.eventTypeId());
+    EventType eventType = thingClass.getEventType(event.eventTypeId());
 
 
     if (event.params().count() == 0) {
@@ -165,52 +293,77 @@ QList<Rule> RuleEngine::evaluateEvent(const Event &event)
         qCDebug(dcRuleEngineDebug).nospace().noquote() << "Evaluate event: " << thing->name() << " - " << eventType.name() << " (ThingId:" << thing->id().toString() << ", EventTypeId:" << eventType.id().toString() << ")" << endl << "     " << event.params();
     }
 
-    QList<Rule> rules;
-    foreach (const RuleId &id, ruleIds()) {
-        Rule rule = m_rules.value(id);
+    // Only rules referencing this event or state, or not evaluated since they changed, can be affected
+    QSet<RuleId> candidates = m_unevaluatedRules;
+    m_unevaluatedRules.clear();
+    candidates.unite(m_rulesByThingEvent.value(qMakePair(event.thingId(), event.eventTypeId())));
+    candidates.unite(m_rulesByThingState.value(qMakePair(event.thingId(), StateTypeId(event.eventTypeId()))));
+    foreach (const QString &interface, thingClass.interfaces()) {
+        candidates.unite(m_rulesByInterfaceEvent.value(qMakePair(interface, eventType.name())));
+        candidates.unite(m_rulesByInterfaceState.value(interface));
+    }
+    QList<RuleId> candidateIds = candidates.toList();
+    std::sort(candidateIds.begin(), candidateIds.end(), [this](const RuleId &a, const RuleId &b){
+        return m_ruleSequence.value(a) < m_ruleSequence.value(b);
+    });
+
+    QList<RuleId> rules;
+    foreach (const RuleId &id, candidateIds) {
+        QHash<RuleId, Rule>::const_iterator ruleIt = m_rules.constFind(id);
+        if (ruleIt == m_rules.constEnd()) {
+            continue;
+        }
+        const Rule &rule = ruleIt.value();
         if (!rule.enabled()) {
             qCDebug(dcRuleEngineDebug()).nospace().noquote() << "Skipping rule " << rule.name() << " (" << rule.id().toString() << ") "  << " because it is disabled.";
             continue;
         }
+        RuleState &state = m_ruleStates[id];
+        int previousCount = rules.count();
 
         // If we have a state based on this event
-        if (containsState(rule.stateEvaluator(), event)) {
-            rule.setStatesActive(rule.stateEvaluator().evaluate());
-            m_rules[rule.id()] = rule;
+        QHash<RuleId, CompiledStateEvaluator>::iterator stateEvaluator = m_stateEvaluators.find(id);
+        QElapsedTimer stateEvaluationTimer;
+        stateEvaluationTimer.start();
+        if (stateEvaluator != m_stateEvaluators.end() && stateEvaluator->updateState(event.thingId(), StateTypeId(event.eventTypeId()), thingClass.interfaces())) {
+            state.statesActive = stateEvaluator->result();
+            if (stateEvaluator->hasHoldTimes()) {
+                scheduleHoldDeadline(id);
+            }
         }
+        qint64 stateEvaluationTime = stateEvaluationTimer.nsecsElapsed();
 
         // If this rule does not base on an event, evaluate the rule
         if (rule.eventDescriptors().isEmpty() && rule.timeDescriptor().timeEventItems().isEmpty() && !rule.stateEvaluator().isEmpty()) {
-            if (rule.timeActive() && rule.statesActive()) {
-                if (!m_activeRules.contains(rule.id())) {
+            if (state.timeActive && state.statesActive) {
+                if (!state.active) {
                     qCDebug(dcRuleEngine).nospace().noquote() << "Rule " << rule.name() << " (" << rule.id().toString() << ") active.";
-                    rule.setActive(true);
-                    m_rules[rule.id()] = rule;
-                    m_activeRules.append(rule.id());
-                    rules.append(rule);
+                    state.active = true;
+                    rules.append(id);
                 }
             } else {
-                if (m_activeRules.contains(rule.id())) {
+                if (state.active) {
                     qCDebug(dcRuleEngine).nospace().noquote() << "Rule " << rule.name() << " (" << rule.id().toString() << ") inactive.";
-                    rule.setActive(false);
-                    m_rules[rule.id()] = rule;
-                    m_activeRules.removeAll(rule.id());
-                    rules.append(rule);
+                    state.active = false;
+                    rules.append(id);
                 }
             }
         } else {
             // Event based rule
-            if (containsEvent(rule, event, thing->thingClassId())) {
-                qCDebug(dcRuleEngineDebug()).nospace().noquote() << "Rule " << rule.name() << " (" << rule.id().toString() << ") contains event. States active:" << rule.statesActive() << "Time active:" << rule.timeActive();
-                if (rule.statesActive() && rule.timeActive()) {
+            if (m_eventMatchers[id].matches(event, thingClass)) {
+                qCDebug(dcRuleEngineDebug()).nospace().noquote() << "Rule " << rule.name() << " (" << rule.id().toString() << ") contains event. States active:" << state.statesActive << "Time active:" << state.timeActive;
+                if (state.statesActive && state.timeActive) {
                     qCDebug(dcRuleEngine).nospace().noquote() << "Rule " << rule.name() << " (" + rule.id().toString() << ") contains event and all states match.";
-                    rules.append(rule);
+                    rules.append(id);
                 } else {
                     qCDebug(dcRuleEngine).nospace().noquote() << "Rule " << rule.name() << " (" + rule.id().toString() << ") contains event but state are not matching.";
-                    rules.append(rule);
+                    rules.append(id);
                 }
+            } else {
+                qCDebug(dcRuleEngineDebug()) << "Rule" << rule.name() << "does not match event descriptors";
             }
         }
+        m_statistics.ruleEvaluated(id, rules.count() > previousCount, stateEvaluationTime);
     }
 
     return rules;
@@ -219,9 +372,9 @@ QList<Rule> RuleEngine::evaluateEvent(const Event &event)
 /*! Ask the Engine to evaluate all the rules for the given \a dateTime.
     This will search all the \l{Rule}{Rules} triggered by the given \a dateTime
     and evaluate their \l{CalendarItem}{CalendarItems} and \l{TimeEventItem}{TimeEventItems}.
-    It will return a list of all \l{Rule}{Rules} that are triggered or change its active state.
+    It will return the ids of all \l{Rule}{Rules} that are triggered or change its active state.
 */
-QList<Rule> RuleEngine::evaluateTime(const QDateTime &dateTime)
+QList<RuleId> RuleEngine::evaluateTime(const QDateTime &dateTime)
 {
     // Initialize the last datetime if not already set (current time -1 second)
     if (!m_lastEvaluationTime.isValid()) {
@@ -229,11 +382,73 @@ QList<Rule> RuleEngine::evaluateTime(const QDateTime &dateTime)
         m_lastEvaluationTime = m_lastEvaluationTime.addSecs(-1);
     }
 
-    QList<Rule> rules;
+    // Only look at rules whose time descriptor may have changed since the last evaluation
+    QSet<RuleId> dueRules = m_dueTimeRules;
+    m_dueTimeRules.clear();
+    if (dateTime < m_lastEvaluationTime) {
+        // The clock went backwards, none of the scheduled transitions can be trusted any more
+        dueRules.unite(QSet<RuleId>::fromList(m_scheduledTimes.keys()));
+        m_timeSchedule.clear();
+        m_scheduledTimes.clear();
+    }
+    while (!m_timeSchedule.isEmpty() && m_timeSchedule.firstKey() <= dateTime) {
+        QMultiMap<QDateTime, RuleId>::iterator it = m_timeSchedule.begin();
+        dueRules.insert(it.value());
+        m_scheduledTimes.remove(it.value());
+        m_timeSchedule.erase(it);
+    }
+    QList<RuleId> dueRuleIds = dueRules.toList();
+    std::sort(dueRuleIds.begin(), dueRuleIds.end(), [this](const RuleId &a, const RuleId &b){
+        return m_ruleSequence.value(a) < m_ruleSequence.value(b);
+    });
+
+    QList<RuleId> rules;
+
+    // State descriptors which held their condition for long enough
+    QList<RuleId> holdRuleIds;
+    while (!m_holdSchedule.isEmpty() && m_holdSchedule.firstKey() <= dateTime) {
+        QMultiMap<QDateTime, RuleId>::iterator it = m_holdSchedule.begin();
+        holdRuleIds.append(it.value());
+        m_holdDeadlines.remove(it.value());
+        m_holdSchedule.erase(it);
+    }
+    std::sort(holdRuleIds.begin(), holdRuleIds.end(), [this](const RuleId &a, const RuleId &b){
+        return m_ruleSequence.value(a) < m_ruleSequence.value(b);
+    });
+    foreach (const RuleId &ruleId, holdRuleIds) {
+        QHash<RuleId, Rule>::const_iterator ruleIt = m_rules.constFind(ruleId);
+        if (ruleIt == m_rules.constEnd()) {
+            continue;
+        }
+        const Rule &rule = ruleIt.value();
+        if (!rule.enabled()) {
+            // Evaluated again once it gets enabled
+            continue;
+        }
+        CompiledStateEvaluator &stateEvaluator = m_stateEvaluators[ruleId];
+        stateEvaluator.updateTime(dateTime);
+        scheduleHoldDeadline(ruleId);
+        RuleState &state = m_ruleStates[ruleId];
+        state.statesActive = stateEvaluator.result();
+        if (rule.eventDescriptors().isEmpty() && rule.timeDescriptor().timeEventItems().isEmpty()) {
+            if (state.timeActive && state.statesActive && !state.active) {
+                qCDebug(dcRuleEngine) << "Rule" << rule.id().toString() << "active after hold time.";
+                state.active = true;
+                rules.append(ruleId);
+            }
+        }
+    }
 
-    foreach (const Rule &r, m_rules.values()) {
-        Rule rule = m_rules.value(r.id());
+    QVector<TimeEvaluation> timeEvaluations;
+    timeEvaluations.reserve(dueRuleIds.count());
+    foreach (const RuleId &ruleId, dueRuleIds) {
+        QHash<RuleId, Rule>::const_iterator ruleIt = m_rules.constFind(ruleId);
+        if (ruleIt == m_rules.constEnd()) {
+            continue;
+        }
+        const Rule &rule = ruleIt.value();
         if (!rule.enabled()) {
+            // Scheduled again once it gets enabled
             qCDebug(dcRuleEngineDebug()) << "Skipping rule" + rule.name() + "because it is disabled";
             continue;
         }
@@ -242,28 +457,57 @@ QList<Rule> RuleEngine::evaluateTime(const QDateTime &dateTime)
         if (rule.timeDescriptor().isEmpty())
             continue;
 
+        TimeEvaluation evaluation;
+        evaluation.rule = &rule;
+        timeEvaluations.append(evaluation);
+    }
+
+    // The rules are not modified while the workers look at them. Each worker only writes its own evaluations,
+    // the results are applied in rule order below so the outcome doesn't depend on the partitioning.
+    TimeEvaluation *evaluations = timeEvaluations.data();
+    QDateTime lastEvaluationTime = m_lastEvaluationTime;
+    parallelFor(timeEvaluations.count(), m_parallelPartitionSize, [evaluations, &lastEvaluationTime, &dateTime](int index){
+        TimeEvaluation &evaluation = evaluations[index];
+        TimeDescriptor timeDescriptor = evaluation.rule->timeDescriptor();
+        // A time event firing now makes the descriptor evaluate to false again on the next tick
+        foreach (const TimeEventItem &timeEventItem, timeDescriptor.timeEventItems()) {
+            evaluation.timeEventFired |= timeEventItem.evaluate(lastEvaluationTime, dateTime);
+        }
+        if (!evaluation.timeEventFired) {
+            evaluation.nextTransition = nextTimeTransition(timeDescriptor, dateTime);
+        }
+        evaluation.result = timeDescriptor.evaluate(lastEvaluationTime, dateTime);
+    });
+
+    foreach (const TimeEvaluation &evaluation, timeEvaluations) {
+        const Rule &rule = *evaluation.rule;
+        RuleId ruleId = rule.id();
+        if (evaluation.timeEventFired) {
+            scheduleTimeEvaluation(ruleId);
+        } else {
+            scheduleTimeEvaluation(ruleId, evaluation.nextTransition);
+        }
+
+        RuleState &state = m_ruleStates[ruleId];
+        int previousCount = rules.count();
+
         // Check if this rule is based on calendarItems
         if (!rule.timeDescriptor().calendarItems().isEmpty()) {
-            rule.setTimeActive(rule.timeDescriptor().evaluate(m_lastEvaluationTime, dateTime));
-            m_rules[rule.id()] = rule;
+            state.timeActive = evaluation.result;
 
             if (rule.timeDescriptor().timeEventItems().isEmpty() && rule.eventDescriptors().isEmpty()) {
 
-                if (rule.timeActive() && rule.statesActive()) {
-                    if (!m_activeRules.contains(rule.id())) {
+                if (state.timeActive && state.statesActive) {
+                    if (!state.active) {
                         qCDebug(dcRuleEngine) << "Rule" << rule.id().toString() << "active.";
-                        rule.setActive(true);
-                        m_rules[rule.id()] = rule;
-                        m_activeRules.append(rule.id());
-                        rules.append(rule);
+                        state.active = true;
+                        rules.append(ruleId);
                     }
                 } else {
-                    if (m_activeRules.contains(rule.id())) {
+                    if (state.active) {
                         qCDebug(dcRuleEngine) << "Rule" << rule.id().toString() << "inactive.";
-                        rule.setActive(false);
-                        m_rules[rule.id()] = rule;
-                        m_activeRules.removeAll(rule.id());
-                        rules.append(rule);
+                        state.active = false;
+                        rules.append(ruleId);
                     }
                 }
             }
@@ -272,12 +516,12 @@ QList<Rule> RuleEngine::evaluateTime(const QDateTime &dateTime)
 
         // If we have timeEvent items
         if (!rule.timeDescriptor().timeEventItems().isEmpty()) {
-            bool valid = rule.timeDescriptor().evaluate(m_lastEvaluationTime, dateTime);
-            if (valid && rule.timeActive()) {
+            if (evaluation.result && state.timeActive) {
                 qCDebug(dcRuleEngine) << "Rule" << rule.id() << "time event triggert.";
-                rules.append(rule);
+                rules.append(ruleId);
             }
         }
+        m_statistics.ruleEvaluated(ruleId, rules.count() > previousCount);
     }
 
     m_lastEvaluationTime = dateTime;
@@ -297,11 +541,64 @@ RuleEngine::RuleError RuleEngine::addRule(const Rule &rule, bool fromEdit)
     if (rule.id().isNull())
         return RuleErrorInvalidRuleId;
 
-    if (!findRule(rule.id()).id().isNull()) {
+    if (m_rules.contains(rule.id())) {
         qCWarning(dcRuleEngine) << "Already have a rule with this id.";
         return RuleErrorInvalidRuleId;
     }
 
+    RuleError validationError = validateRule(rule);
+    if (validationError != RuleErrorNoError) {
+        return validationError;
+    }
+
+    appendRule(rule);
+    saveRule(rule);
+
+    if (!fromEdit)
+        emit ruleAdded(rule);
+
+    qCDebug(dcRuleEngine()) << "Rule" << rule.name() << rule.id().toString() << "added successfully.";
+    return RuleErrorNoError;
+}
+
+/*! Adds all the given \a rules in one go. All rules are validated before any of them is added. If one of them
+    is invalid, none of the rules will be added and \a failedIndex, if given, is set to the position of the
+    offending rule in \a rules. The rules are written to the configuration at once and rulesAdded() is emitted
+    once for the whole batch instead of ruleAdded() for each rule.
+*/
+RuleEngine::RuleError RuleEngine::addRules(const QList<Rule> &rules, int *failedIndex)
+{
+    QSet<RuleId> batchIds;
+    for (int i = 0; i < rules.count(); i++) {
+        const Rule &rule = rules.at(i);
+        RuleError error = RuleErrorNoError;
+        if (rule.id().isNull() || m_rules.contains(rule.id()) || batchIds.contains(rule.id())) {
+            error = RuleErrorInvalidRuleId;
+        } else {
+            error = validateRule(rule);
+        }
+        if (error != RuleErrorNoError) {
+            qCWarning(dcRuleEngine()) << "Cannot add rules. Rule" << i << rule.name() << "is invalid:" << error;
+            if (failedIndex)
+                *failedIndex = i;
+            return error;
+        }
+        batchIds.insert(rule.id());
+    }
+
+    foreach (const Rule &rule, rules) {
+        appendRule(rule);
+    }
+    saveRules(rules);
+
+    emit rulesAdded(rules);
+
+    qCDebug(dcRuleEngine()) << rules.count() << "rules added successfully.";
+    return RuleErrorNoError;
+}
+
+RuleEngine::RuleError RuleEngine::validateRule(const Rule &rule)
+{
     if (!rule.isConsistent()) {
         qCWarning(dcRuleEngine) << "Rule inconsistent.";
         return RuleErrorInvalidRuleFormat;
@@ -411,13 +708,6 @@ RuleEngine::RuleError RuleEngine::addRule(const Rule &rule, bool fromEdit)
         }
     }
 
-    appendRule(rule);
-    saveRule(rule);
-
-    if (!fromEdit)
-        emit ruleAdded(rule);
-
-    qCDebug(dcRuleEngine()) << "Rule" << rule.name() << rule.id().toString() << "added successfully.";
     return RuleErrorNoError;
 }
 
@@ -461,13 +751,56 @@ RuleEngine::RuleError RuleEngine::editRule(const Rule &rule)
     return RuleErrorNoError;
 }
 
+/*! Replaces the configuration of all rules in \a rules with the given ones. All rules are validated before any of
+    them is changed. If one of them is invalid, none of the rules will be changed and \a failedIndex, if given, is set
+    to the position of the offending rule in \a rules. The rules are written to the configuration at once and
+    rulesConfigurationChanged() is emitted once for the whole batch.
+*/
+RuleEngine::RuleError RuleEngine::editRules(const QList<Rule> &rules, int *failedIndex)
+{
+    QSet<RuleId> batchIds;
+    for (int i = 0; i < rules.count(); i++) {
+        const Rule &rule = rules.at(i);
+        RuleError error = RuleErrorNoError;
+        if (rule.id().isNull() || batchIds.contains(rule.id())) {
+            error = RuleErrorInvalidRuleId;
+        } else if (!m_rules.contains(rule.id())) {
+            error = RuleErrorRuleNotFound;
+        } else {
+            error = validateRule(rule);
+        }
+        if (error != RuleErrorNoError) {
+            qCWarning(dcRuleEngine()) << "Cannot edit rules. Rule" << i << rule.id().toString() << "is invalid:" << error;
+            if (failedIndex)
+                *failedIndex = i;
+            return error;
+        }
+        batchIds.insert(rule.id());
+    }
+
+    foreach (const Rule &rule, rules) {
+        dropRule(rule.id());
+        appendRule(rule);
+    }
+    saveRules(rules);
+
+    emit rulesConfigurationChanged(rules);
+
+    qCDebug(dcRuleEngine()) << rules.count() << "rules updated.";
+    return RuleErrorNoError;
+}
+
 /*! Returns a list of all \l{Rule}{Rules} loaded in this Engine.
     Be aware that this does not necessarily reflect the order of the rules in the engine.
     Use ruleIds() if you need the correct order.
 */
 QList<Rule> RuleEngine::rules() const
 {
-    return m_rules.values();
+    QList<Rule> rules;
+    foreach (const Rule &rule, m_rules) {
+        rules.append(withRuntimeState(rule));
+    }
+    return rules;
 }
 
 /*! Returns a list of all ruleIds loaded in this Engine. */
@@ -488,14 +821,8 @@ RuleEngine::RuleError RuleEngine::removeRule(const RuleId &ruleId, bool fromEdit
         return RuleErrorRuleNotFound;
     }
 
-    m_ruleIds.takeAt(index);
-    m_rules.remove(ruleId);
-    m_activeRules.removeAll(ruleId);
-
-    NymeaSettings settings(NymeaSettings::SettingsRoleRules);
-    settings.beginGroup(ruleId.toString());
-    settings.remove("");
-    settings.endGroup();
+    dropRule(ruleId);
+    m_ruleStore.removeRule(ruleId);
 
     if (!fromEdit)
         emit ruleRemoved(ruleId);
@@ -522,9 +849,16 @@ RuleEngine::RuleError RuleEngine::enableRule(const RuleId &ruleId)
         return RuleErrorNoError;
 
     rule.setEnabled(true);
+    // States were not followed while the rule was disabled
+    m_ruleStates[ruleId].statesActive = m_stateEvaluators[ruleId].evaluate();
+    scheduleHoldDeadline(ruleId);
     m_rules[ruleId] = rule;
+    if (!rule.timeDescriptor().isEmpty()) {
+        scheduleTimeEvaluation(ruleId);
+    }
+    m_unevaluatedRules.insert(ruleId);
     saveRule(rule);
-    emit ruleConfigurationChanged(rule);
+    emit ruleConfigurationChanged(withRuntimeState(rule));
 
     NymeaCore::instance()->logEngine()->logRuleEnabledChanged(rule, true);
     qCDebug(dcRuleEngine()) << "Rule" << rule.name() << rule.id() << "enabled.";
@@ -550,7 +884,7 @@ RuleEngine::RuleError RuleEngine::disableRule(const RuleId &ruleId)
     rule.setEnabled(false);
     m_rules[ruleId] = rule;
     saveRule(rule);
-    emit ruleConfigurationChanged(rule);
+    emit ruleConfigurationChanged(withRuntimeState(rule));
 
     NymeaCore::instance()->logEngine()->logRuleEnabledChanged(rule, false);
     qCDebug(dcRuleEngine()) << "Rule" << rule.name() << rule.id() << "disabled.";
@@ -629,95 +963,47 @@ Rule RuleEngine::findRule(const RuleId &ruleId)
     if (!m_rules.contains(ruleId))
         return Rule();
 
-    return m_rules.value(ruleId);
+    return withRuntimeState(m_rules.value(ruleId));
 }
 
-QList<RuleId> RuleEngine::findRules(const ThingId &thingId) const
+/*! Returns the definition of the rule with the given \a ruleId without copying it. The runtime state of the rule
+    is not part of the returned rule, use ruleState() for that. The reference is only valid until rules are changed.
+*/
+const Rule &RuleEngine::ruleDefinition(const RuleId &ruleId) const
 {
-    // Find all offending rules
-    QList<RuleId> offendingRules;
-    foreach (const Rule &rule, m_rules) {
-        bool offending = false;
-        foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
-            if (eventDescriptor.thingId() == thingId) {
-                offending = true;
-                break;
-            }
-        }
-
-        if (!offending && rule.stateEvaluator().containsThing(thingId))
-            offending = true;
-
-        if (!offending) {
-            foreach (const RuleAction &action, rule.actions()) {
-                if (action.thingId() == thingId) {
-                    offending = true;
-                    break;
-                }
-                foreach (const RuleActionParam &ruleActionParam, action.ruleActionParams()) {
-                    if (ruleActionParam.stateThingId() == thingId) {
-                        offending = true;
-                        break;
-                    }
-                }
-                if (offending) {
-                    break;
-                }
-            }
-        }
+    static const Rule invalidRule;
+    QHash<RuleId, Rule>::const_iterator it = m_rules.constFind(ruleId);
+    if (it == m_rules.constEnd()) {
+        return invalidRule;
+    }
+    return it.value();
+}
 
-        if (!offending) {
-            foreach (const RuleAction &action, rule.exitActions()) {
-                if (action.thingId() == thingId) {
-                    offending = true;
-                    break;
-                }
-                foreach (const RuleActionParam &ruleActionParam, action.ruleActionParams()) {
-                    if (ruleActionParam.stateThingId() == thingId) {
-                        offending = true;
-                        break;
-                    }
-                }
-                if (offending) {
-                    break;
-                }
-            }
-        }
+/*! Returns the evaluation and execution statistics of the rules. */
+RuleStatistics *RuleEngine::statistics()
+{
+    return &m_statistics;
+}
 
-        if (offending)
-            offendingRules.append(rule.id());
+/*! Returns the current runtime state of the rule with the given \a ruleId. */
+RuleEngine::RuleState RuleEngine::ruleState(const RuleId &ruleId) const
+{
+    return m_ruleStates.value(ruleId);
+}
 
-    }
-    return offendingRules;
+QList<RuleId> RuleEngine::findRules(const ThingId &thingId) const
+{
+    QList<RuleId> ruleIds = m_rulesByThing.value(thingId).toList();
+    std::sort(ruleIds.begin(), ruleIds.end(), [this](const RuleId &a, const RuleId &b){
+        return m_ruleSequence.value(a) < m_ruleSequence.value(b);
+    });
+    return ruleIds;
 }
 
 /*! Returns all \l Things that are contained in a rule */
 QList<ThingId> RuleEngine::thingsInRules() const
 {
-    QList<ThingId> tmp;
-    foreach (const Rule &rule, m_rules) {
-        foreach (const EventDescriptor &descriptor, rule.eventDescriptors()) {
-            if (!tmp.contains(descriptor.thingId()) && !descriptor.thingId().isNull()) {
-                tmp.append(descriptor.thingId());
-            }
-        }
-        foreach (const ThingId &thingId, rule.stateEvaluator().containedThings()) {
-            if (!tmp.contains(thingId) && !thingId.isNull()) {
-                tmp.append(thingId);
-            }
-        }
-        foreach (const RuleAction &action, rule.actions()) {
-            if (!tmp.contains(action.thingId()) && !action.thingId().isNull()) {
-                tmp.append(action.thingId());
-            }
-        }
-        foreach (const RuleAction &exitAction, rule.exitActions()) {
-            if (!tmp.contains(exitAction.thingId()) && !exitAction.thingId().isNull()) {
-                tmp.append(exitAction.thingId());
-            }
-        }
-    }
-    return tmp;
+    return m_rulesByThing.keys();
 }
 
 void RuleEngine::removeThingFromRule(const RuleId &id, const ThingId &thingId)
@@ -779,16 +1065,20 @@ void RuleEngine::removeThingFromRule(const RuleId &id, const ThingId &thingId)
         exitActions.takeAt(removeIndexes.takeLast());
     }
 
-    // remove the rule from settings
-    NymeaSettings settings(NymeaSettings::SettingsRoleRules);
-    settings.beginGroup(id.toString());
-    settings.remove("");
-    settings.endGroup();
-
     if (actions.isEmpty() && exitActions.isEmpty()) {
         // The rule doesn't have any actions any more and is useless at this point... let's remove it altogether
         qCDebug(dcRuleEngine()) << "Rule" << rule.name() << "(" + rule.id().toString() + ")" << "does not have any actions any more. Removing it.";
-        m_rules.take(id);
+        m_ruleStore.removeRule(id);
+        updateRuleIndex(m_rules.take(id), false);
+        m_stateEvaluators.remove(id);
+        m_eventMatchers.remove(id);
+        m_statistics.removeRule(id);
+        unscheduleTimeEvaluation(id);
+        unscheduleHoldDeadline(id);
+        m_ruleIds.removeAll(id);
+        m_ruleStates.remove(id);
+        m_unevaluatedRules.remove(id);
+        m_ruleSequence.remove(id);
         emit ruleRemoved(id);
         return;
     }
@@ -801,125 +1091,22 @@ void RuleEngine::removeThingFromRule(const RuleId &id, const ThingId &thingId)
     newRule.setTimeDescriptor(rule.timeDescriptor());
     newRule.setActions(actions);
     newRule.setExitActions(exitActions);
+    updateRuleIndex(rule, false);
+    CompiledStateEvaluator compiledStateEvaluator(stateEvalatuator);
+    m_ruleStates[id].statesActive = compiledStateEvaluator.evaluate();
+    m_stateEvaluators.insert(id, compiledStateEvaluator);
+    m_eventMatchers.insert(id, CompiledEventMatcher(eventDescriptors));
     m_rules[id] = newRule;
+    scheduleHoldDeadline(id);
+    if (!newRule.timeDescriptor().isEmpty()) {
+        scheduleTimeEvaluation(id);
+    }
+    updateRuleIndex(newRule, true);
+    m_unevaluatedRules.insert(id);
 
     // save it
     saveRule(newRule);
-    emit ruleConfigurationChanged(newRule);
-}
-
-bool RuleEngine::containsEvent(const Rule &rule, const Event &event, const ThingClassId &thingClassId)
-{
-    foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
-        // If this is a thing based rule, eventTypeId and thingId must match
-        if (eventDescriptor.type() == EventDescriptor::TypeThing) {
-            if (eventDescriptor.eventTypeId() != event.eventTypeId() ||  eventDescriptor.thingId() != event.thingId()) {
-                continue;
-            }
-        }
-
-        // If this is a interface based rule, the thing must implement the interface
-        if (eventDescriptor.type() == EventDescriptor::TypeInterface) {
-            ThingClass dc = NymeaCore::instance()->thingManager()->findThingClass(thingClassId);
-            if (!dc.interfaces().contains(eventDescriptor.interface())) {
-                // ThingClass for this event doesn't implement the interface for this eventDescriptor
-                continue;
-            }
-
-            EventType et = dc.eventTypes().findById(event.eventTypeId());
-            if (et.name() != eventDescriptor.interfaceEvent()) {
-                // The fired event name does not match with the eventDescriptor's interfaceEvent
-                continue;
-            }
-        }
-
-        // Ok, either thing/eventTypeId or interface/interfaceEvent are matching. Compare the paramdescriptor
-        bool allOK = true;
-        foreach (const ParamDescriptor &paramDescriptor, eventDescriptor.paramDescriptors()) {
-            QVariant paramValue;
-            if (!paramDescriptor.paramTypeId().isNull()) {
-                paramValue = event.param(paramDescriptor.paramTypeId()).value();
-            } else {
-                if (paramDescriptor.paramName().isEmpty()) {
-                    qWarning(dcRuleEngine()) << "ParamDescriptor invalid. Either paramTypeId or paramName are required";
-                    allOK = false;
-                    continue;
-                }
-                ThingClass dc = NymeaCore::instance()->thingManager()->findThingClass(thingClassId);
-                EventType et = dc.eventTypes().findById(event.eventTypeId());
-                ParamType pt = et.paramTypes().findByName(paramDescriptor.paramName());
-                paramValue = event.param(pt.id()).value();
-            }
-
-            switch (paramDescriptor.operatorType()) {
-            case Types::ValueOperatorEquals:
-                if (paramValue != paramDescriptor.value()) {
-                    allOK = false;
-                }
-                break;
-            case Types::ValueOperatorNotEquals:
-                if (paramValue == paramDescriptor.value()) {
-                    allOK = false;
-                }
-                break;
-            case Types::ValueOperatorGreater:
-                if (event.param(paramDescriptor.paramTypeId()).value() <= paramDescriptor.value()) {
-                    allOK = false;
-                }
-                break;
-            case Types::ValueOperatorGreaterOrEqual:
-                if (event.param(paramDescriptor.paramTypeId()).value() < paramDescriptor.value()) {
-                    allOK = false;
-                }
-                break;
-            case Types::ValueOperatorLess:
-                if (event.param(paramDescriptor.paramTypeId()).value() >= paramDescriptor.value()) {
-                    allOK = false;
-                }
-                break;
-            case Types::ValueOperatorLessOrEqual:
-                if (event.param(paramDescriptor.paramTypeId()).value() < paramDescriptor.value()) {
-                    allOK = false;
-                }
-                break;
-            }
-        }
-        // All matching!
-        if (allOK) {
-            return true;
-        }
-    }
-
-    qCDebug(dcRuleEngineDebug()) << "Rule" << rule.name() << "does not match event descriptors";
-    return false;
-}
-
-bool RuleEngine::containsState(const StateEvaluator &stateEvaluator, const Event &stateChangeEvent)
-{
-    if (stateEvaluator.stateDescriptor().isValid()) {
-        if (stateEvaluator.stateDescriptor().type() == StateDescriptor::TypeThing) {
-            if (stateEvaluator.stateDescriptor().thingId() == stateChangeEvent.thingId() && stateEvaluator.stateDescriptor().stateTypeId() == stateChangeEvent.eventTypeId()) {
-                return true;
-            }
-            if (stateEvaluator.stateDescriptor().valueThingId() == stateChangeEvent.thingId() && stateEvaluator.stateDescriptor().valueStateTypeId() == stateChangeEvent.eventTypeId()) {
-                return true;
-            }
-        } else {
-            Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(stateChangeEvent.thingId());
-            ThingClass thingClass = NymeaCore::instance()->thingManager()->findThingClass(thing->thingClassId());
-            if (thingClass.interfaces().contains(stateEvaluator.stateDescriptor().interface())) {
-                return true;
-            }
-        }
-    }
-
-    foreach (const StateEvaluator &childEvaluator, stateEvaluator.childEvaluators()) {
-        if (containsState(childEvaluator, stateChangeEvent)) {
-            return true;
-        }
-    }
-
-    return false;
+    emit ruleConfigurationChanged(withRuntimeState(newRule));
 }
 
 RuleEngine::RuleError RuleEngine::checkRuleAction(const RuleAction &ruleAction, const Rule &rule)
@@ -943,7 +1130,7 @@ RuleEngine::RuleError RuleEngine::checkRuleAction(const RuleAction &ruleAction,
             return RuleErrorActionTypeNotFound;
         }
 
-        actionType = thingClass.actionTypes().findById(ruleAction.actionTypeId());
+        actionType = thingClass.getActionType(ruleAction.actionTypeId());
     } else if (ruleAction.type() == RuleAction::TypeInterface) {
         Interface iface = NymeaCore::instance()->thingManager()->supportedInterfaces().findByName(ruleAction.interface());
         if (!iface.isValid()) {
@@ -1040,7 +1227,7 @@ RuleEngine::RuleError RuleEngine::checkRuleActionParam(const RuleActionParam &ru
             return RuleErrorThingNotFound;
         }
         ThingClass stateThingClass = NymeaCore::instance()->thingManager()->findThingClass(d->thingClassId());
-        StateType stateType = stateThingClass.stateTypes().findById(ruleActionParam.stateTypeId());
+        StateType stateType = stateThingClass.getStateType(ruleActionParam.stateTypeId());
         QVariant::Type actionParamType = getActionParamType(actionType.id(), ruleActionParam.paramTypeId());
         QVariant v(stateType.type());
         if (actionParamType != stateType.type() && !v.canConvert(static_cast<int>(actionParamType))) {
@@ -1099,172 +1286,163 @@ QVariant::Type RuleEngine::getEventParamType(const EventTypeId &eventTypeId, con
     return QVariant::Invalid;
 }
 
-void RuleEngine::appendRule(const Rule &rule)
+Rule RuleEngine::withRuntimeState(const Rule &rule) const
 {
-    Rule newRule = rule;
-    newRule.setStatesActive(newRule.stateEvaluator().evaluate());
-    newRule.setTimeActive(newRule.timeDescriptor().evaluate(QDateTime(), QDateTime::currentDateTime()));
-    qCDebug(dcRuleEngine()) << "Adding Rule:" << newRule;
-    m_rules.insert(rule.id(), newRule);
-    m_ruleIds.append(rule.id());
+    Rule ruleWithState = rule;
+    RuleState state = m_ruleStates.value(rule.id());
+    ruleWithState.setActive(state.active);
+    ruleWithState.setStatesActive(state.statesActive);
+    ruleWithState.setTimeActive(state.timeActive);
+    return ruleWithState;
 }
 
-void RuleEngine::saveRule(const Rule &rule)
+/*! Removes the rule with the given \a ruleId from the engine's memory, leaving the configuration untouched. */
+void RuleEngine::dropRule(const RuleId &ruleId)
 {
-    NymeaSettings settings(NymeaSettings::SettingsRoleRules);
-    settings.beginGroup(rule.id().toString());
-    settings.setValue("name", rule.name());
-    settings.setValue("enabled", rule.enabled());
-    settings.setValue("executable", rule.executable());
+    m_ruleIds.removeOne(ruleId);
+    updateRuleIndex(m_rules.take(ruleId), false);
+    m_stateEvaluators.remove(ruleId);
+    m_eventMatchers.remove(ruleId);
+    m_statistics.removeRule(ruleId);
+    unscheduleTimeEvaluation(ruleId);
+    unscheduleHoldDeadline(ruleId);
+    m_ruleStates.remove(ruleId);
+    m_unevaluatedRules.remove(ruleId);
+    m_ruleSequence.remove(ruleId);
+}
 
-    // Save timeDescriptor
-    settings.beginGroup("timeDescriptor");
-    if (!rule.timeDescriptor().isEmpty()) {
-        settings.beginGroup("calendarItems");
-        for (int i = 0; i < rule.timeDescriptor().calendarItems().count(); i++) {
-            settings.beginGroup("CalendarItem-" + QString::number(i));
+void RuleEngine::appendRule(const Rule &rule)
+{
+    appendRule(rule, rule.timeDescriptor().evaluate(QDateTime(), QDateTime::currentDateTime()));
+}
 
-            const CalendarItem &calendarItem = rule.timeDescriptor().calendarItems().at(i);
-            if (calendarItem.dateTime().isValid())
-                settings.setValue("dateTime", calendarItem.dateTime().toTime_t());
+void RuleEngine::appendRule(const Rule &rule, bool timeActive)
+{
+    CompiledStateEvaluator stateEvaluator(rule.stateEvaluator());
+    RuleState state;
+    state.statesActive = stateEvaluator.evaluate();
+    state.timeActive = timeActive;
+    m_stateEvaluators.insert(rule.id(), stateEvaluator);
+    m_eventMatchers.insert(rule.id(), CompiledEventMatcher(rule.eventDescriptors()));
+    m_ruleStates.insert(rule.id(), state);
+    qCDebug(dcRuleEngine()) << "Adding Rule:" << rule;
+    m_rules.insert(rule.id(), rule);
+    m_ruleIds.append(rule.id());
+    m_ruleSequence.insert(rule.id(), m_nextRuleSequence++);
+    m_unevaluatedRules.insert(rule.id());
+    updateRuleIndex(rule, true);
+    if (!rule.timeDescriptor().isEmpty()) {
+        scheduleTimeEvaluation(rule.id());
+    }
+    scheduleHoldDeadline(rule.id());
+}
 
-            if (calendarItem.startTime().isValid())
-                settings.setValue("startTime", calendarItem.startTime().toString("hh:mm"));
+/*! Schedules the time descriptor of the rule with the given \a ruleId to be evaluated at the first tick at or after
+    \a dueTime, or on the next tick if \a dueTime is invalid. */
+void RuleEngine::scheduleTimeEvaluation(const RuleId &ruleId, const QDateTime &dueTime)
+{
+    unscheduleTimeEvaluation(ruleId);
+    if (!dueTime.isValid()) {
+        m_dueTimeRules.insert(ruleId);
+        return;
+    }
+    m_timeSchedule.insert(dueTime, ruleId);
+    m_scheduledTimes.insert(ruleId, dueTime);
+}
 
-            settings.setValue("duration", calendarItem.duration());
-            settings.setValue("mode", calendarItem.repeatingOption().mode());
+void RuleEngine::unscheduleTimeEvaluation(const RuleId &ruleId)
+{
+    m_dueTimeRules.remove(ruleId);
+    if (m_scheduledTimes.contains(ruleId)) {
+        m_timeSchedule.remove(m_scheduledTimes.take(ruleId), ruleId);
+    }
+}
 
-            // Save weekDays
-            settings.beginWriteArray("weekDays");
-            for (int i = 0; i < calendarItem.repeatingOption().weekDays().count(); ++i) {
-                settings.setArrayIndex(i);
-                settings.setValue("weekDay", calendarItem.repeatingOption().weekDays().at(i));
-            }
-            settings.endArray();
+/*! Schedules the state evaluator of the rule with the given \a ruleId to be updated on the first tick after the
+    hold time of one of its state descriptors passes. Rules without pending hold times are not scheduled. */
+void RuleEngine::scheduleHoldDeadline(const RuleId &ruleId)
+{
+    unscheduleHoldDeadline(ruleId);
+    QHash<RuleId, CompiledStateEvaluator>::const_iterator stateEvaluator = m_stateEvaluators.constFind(ruleId);
+    if (stateEvaluator == m_stateEvaluators.constEnd()) {
+        return;
+    }
+    QDateTime deadline = stateEvaluator->nextHoldDeadline();
+    if (!deadline.isValid()) {
+        return;
+    }
+    m_holdSchedule.insert(deadline, ruleId);
+    m_holdDeadlines.insert(ruleId, deadline);
+}
 
-            // Save monthDays
-            settings.beginWriteArray("monthDays");
-            for (int i = 0; i < calendarItem.repeatingOption().monthDays().count(); ++i) {
-                settings.setArrayIndex(i);
-                settings.setValue("monthDay", calendarItem.repeatingOption().monthDays().at(i));
-            }
-            settings.endArray();
+void RuleEngine::unscheduleHoldDeadline(const RuleId &ruleId)
+{
+    if (m_holdDeadlines.contains(ruleId)) {
+        m_holdSchedule.remove(m_holdDeadlines.take(ruleId), ruleId);
+    }
+}
 
-            settings.endGroup();
+void RuleEngine::updateRuleIndex(const Rule &rule, bool add)
+{
+    foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
+        if (eventDescriptor.type() == EventDescriptor::TypeThing) {
+            updateIndex(m_rulesByThingEvent, qMakePair(eventDescriptor.thingId(), eventDescriptor.eventTypeId()), rule.id(), add);
+        } else {
+            updateIndex(m_rulesByInterfaceEvent, qMakePair(eventDescriptor.interface(), eventDescriptor.interfaceEvent()), rule.id(), add);
         }
-        settings.endGroup();
-
-        settings.beginGroup("timeEventItems");
-        for (int i = 0; i < rule.timeDescriptor().timeEventItems().count(); i++) {
-            settings.beginGroup("TimeEventItem-" + QString::number(i));
-            const TimeEventItem &timeEventItem = rule.timeDescriptor().timeEventItems().at(i);
-
-            if (timeEventItem.dateTime().isValid())
-                settings.setValue("dateTime", timeEventItem.dateTime().toTime_t());
-
-            if (timeEventItem.time().isValid())
-                settings.setValue("time", timeEventItem.time().toString("hh:mm"));
-
-            settings.setValue("mode", timeEventItem.repeatingOption().mode());
-
-            // Save weekDays
-            settings.beginWriteArray("weekDays");
-            for (int i = 0; i < timeEventItem.repeatingOption().weekDays().count(); ++i) {
-                settings.setArrayIndex(i);
-                settings.setValue("weekDay", timeEventItem.repeatingOption().weekDays().at(i));
-            }
-            settings.endArray();
-
-            // Save monthDays
-            settings.beginWriteArray("monthDays");
-            for (int i = 0; i < timeEventItem.repeatingOption().monthDays().count(); ++i) {
-                settings.setArrayIndex(i);
-                settings.setValue("monthDay", timeEventItem.repeatingOption().monthDays().at(i));
-            }
-            settings.endArray();
+    }
+    updateRuleIndex(rule.stateEvaluator(), rule.id(), add);
 
-            settings.endGroup();
+    QSet<ThingId> thingIds;
+    foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
+        thingIds.insert(eventDescriptor.thingId());
+    }
+    foreach (const ThingId &thingId, rule.stateEvaluator().containedThings()) {
+        thingIds.insert(thingId);
+    }
+    foreach (const RuleAction &action, rule.actions() + rule.exitActions()) {
+        thingIds.insert(action.thingId());
+        foreach (const RuleActionParam &ruleActionParam, action.ruleActionParams()) {
+            thingIds.insert(ruleActionParam.stateThingId());
         }
-        settings.endGroup();
     }
-    settings.endGroup();
-
-    // Save Events / EventDescriptors
-    settings.beginGroup("events");
-    for (int i = 0; i < rule.eventDescriptors().count(); i++) {
-        const EventDescriptor &eventDescriptor = rule.eventDescriptors().at(i);
-        settings.beginGroup("EventDescriptor-" + QString::number(i));
-        settings.setValue("thingId", eventDescriptor.thingId().toString());
-        settings.setValue("eventTypeId", eventDescriptor.eventTypeId().toString());
-        settings.setValue("interface", eventDescriptor.interface());
-        settings.setValue("interfaceEvent", eventDescriptor.interfaceEvent());
-
-        foreach (const ParamDescriptor &paramDescriptor, eventDescriptor.paramDescriptors()) {
-            if (!paramDescriptor.paramTypeId().isNull()) {
-                settings.beginGroup("ParamDescriptor-" + paramDescriptor.paramTypeId().toString());
-            } else {
-                settings.beginGroup("ParamDescriptor-" + paramDescriptor.paramName());
+    thingIds.remove(ThingId());
+    foreach (const ThingId &thingId, thingIds) {
+        updateIndex(m_rulesByThing, thingId, rule.id(), add);
+    }
+}
+
+void RuleEngine::updateRuleIndex(const StateEvaluator &stateEvaluator, const RuleId &ruleId, bool add)
+{
+    StateDescriptor stateDescriptor = stateEvaluator.stateDescriptor();
+    if (stateDescriptor.isValid()) {
+        if (stateDescriptor.type() == StateDescriptor::TypeThing) {
+            updateIndex(m_rulesByThingState, qMakePair(stateDescriptor.thingId(), stateDescriptor.stateTypeId()), ruleId, add);
+            if (!stateDescriptor.valueThingId().isNull()) {
+                updateIndex(m_rulesByThingState, qMakePair(stateDescriptor.valueThingId(), stateDescriptor.valueStateTypeId()), ruleId, add);
             }
-            settings.setValue("valueType", static_cast<int>(paramDescriptor.value().type()));
-            settings.setValue("value", paramDescriptor.value());
-            settings.setValue("operator", paramDescriptor.operatorType());
-            settings.endGroup();
+        } else {
+            // containsState() matches any state change of a thing implementing the interface
+            updateIndex(m_rulesByInterfaceState, stateDescriptor.interface(), ruleId, add);
         }
-        settings.endGroup();
     }
-    settings.endGroup();
-
-    // Save StateEvaluator
-    rule.stateEvaluator().dumpToSettings(settings, "stateEvaluator");
-
-    // Save ruleActions
-    settings.beginGroup("ruleActions");
-    saveRuleActions(&settings, rule.actions());
-    settings.endGroup();
+    foreach (const StateEvaluator &childEvaluator, stateEvaluator.childEvaluators()) {
+        updateRuleIndex(childEvaluator, ruleId, add);
+    }
+}
 
-    // Save ruleExitActions
-    settings.beginGroup("ruleExitActions");
-    saveRuleActions(&settings, rule.exitActions());
-    settings.endGroup();
+void RuleEngine::saveRule(const Rule &rule)
+{
+    // Only the record of this rule is written, the other rules stay untouched
+    m_ruleStore.storeRule(rule);
     qCDebug(dcRuleEngineDebug()) << "Saved rule to config:" << rule;
 }
 
-void RuleEngine::saveRuleActions(NymeaSettings *settings, const QList<RuleAction> &ruleActions)
+/*! Writes all the given \a rules to the configuration, replacing any previous configuration of them. */
+void RuleEngine::saveRules(const QList<Rule> &rules)
 {
-    int i = 0;
-    foreach (const RuleAction &action, ruleActions) {
-        settings->beginGroup(QString::number(i));
-        if (action.type() == RuleAction::TypeThing) {
-            settings->setValue("thingId", action.thingId().toString());
-            settings->setValue("actionTypeId", action.actionTypeId().toString());
-        } else if (action.type() == RuleAction::TypeBrowser) {
-            settings->setValue("thingId", action.thingId().toString());
-            settings->setValue("browserItemId", action.browserItemId());
-        } else if (action.type() == RuleAction::TypeInterface){
-            settings->setValue("interface", action.interface());
-            settings->setValue("interfaceAction", action.interfaceAction());
-        } else {
-            Q_ASSERT_X(false, "RuleEngine::saveRule", "Unhandled rule action type.");
-        }
-        foreach (const RuleActionParam &param, action.ruleActionParams()) {
-            if (!param.paramTypeId().isNull()) {
-                settings->beginGroup("RuleActionParam-" + param.paramTypeId().toString());
-            } else {
-                settings->beginGroup("RuleActionParam-" + param.paramName());
-            }
-            settings->setValue("valueType", static_cast<int>(param.value().type()));
-            settings->setValue("value", param.value());
-            if (param.isEventBased()) {
-                settings->setValue("eventTypeId", param.eventTypeId().toString());
-                settings->setValue("eventParamTypeId", param.eventParamTypeId());
-            } else if (param.isStateBased()) {
-                settings->setValue("stateThingId", param.stateThingId().toString());
-                settings->setValue("stateTypeId", param.stateTypeId());
-            }
-            settings->endGroup();
-        }
-        i++;
-        settings->endGroup();
+    foreach (const Rule &rule, rules) {
+        saveRule(rule);
     }
 }
 
@@ -1343,8 +1521,42 @@ QList<RuleAction> RuleEngine::loadRuleActions(NymeaSettings *settings)
     return actions;
 }
 
+/*! Loads the rules from the rule store. Rules of earlier versions are moved from rules.conf to the rule store first. */
 void RuleEngine::init()
 {
+    QList<Rule> rules;
+    if (m_ruleStore.exists()) {
+        qCDebug(dcRuleEngine) << "Loading rules from" << m_ruleStore.path();
+        rules = m_ruleStore.loadRules();
+    } else {
+        rules = loadLegacyRules();
+        qCInfo(dcRuleEngine()) << "Migrating" << rules.count() << "rules to" << m_ruleStore.path();
+        bool migrated = QDir().mkpath(m_ruleStore.path());
+        foreach (const Rule &rule, rules) {
+            migrated &= m_ruleStore.storeRule(rule);
+        }
+        if (migrated) {
+            NymeaSettings(NymeaSettings::SettingsRoleRules).clear();
+        } else {
+            qCWarning(dcRuleEngine()) << "Error migrating rules, keeping" << NymeaSettings(NymeaSettings::SettingsRoleRules).fileName();
+        }
+    }
+
+    // Evaluating the time descriptors of thousands of rules takes a while, do it in parallel up front
+    QVector<bool> timeActive(rules.count());
+    bool *results = timeActive.data();
+    QDateTime now = QDateTime::currentDateTime();
+    parallelFor(rules.count(), m_parallelPartitionSize, [&rules, results, &now](int index){
+        results[index] = rules.at(index).timeDescriptor().evaluate(QDateTime(), now);
+    });
+    for (int i = 0; i < rules.count(); i++) {
+        appendRule(rules.at(i), timeActive.at(i));
+    }
+}
+
+QList<Rule> RuleEngine::loadLegacyRules()
+{
+    QList<Rule> rules;
     NymeaSettings settings(NymeaSettings::SettingsRoleRules);
     qCDebug(dcRuleEngine) << "Loading rules from" << settings.fileName();
     foreach (const QString &idString, settings.childGroups()) {
@@ -1528,11 +1740,10 @@ void RuleEngine::init()
         rule.setExitActions(exitActions);
         rule.setEnabled(enabled);
         rule.setExecutable(executable);
-        rule.setStatesActive(rule.stateEvaluator().evaluate());
-        appendRule(rule);
+        rules.append(rule);
         settings.endGroup();
     }
-
+    return rules;
 }
 
 }
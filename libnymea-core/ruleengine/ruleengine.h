@@ -33,6 +33,10 @@
 
 #include "rule.h"
 #include "stateevaluator.h"
+#include "compiledstateevaluator.h"
+#include "compiledeventmatcher.h"
+#include "rulestatistics.h"
+#include "rulestore.h"
 #include "types/event.h"
 #include "types/thingclass.h"
 
@@ -40,6 +44,9 @@
 #include <QList>
 #include <QUuid>
 #include <QSettings>
+#include <QHash>
+#include <QSet>
+#include <QMap>
 
 namespace nymeaserver {
 
@@ -78,15 +85,25 @@ public:
     };
     Q_ENUM(RemovePolicy)
 
+    // Evaluation results of a rule, kept apart from its definition so evaluating does not copy rules around
+    class RuleState {
+    public:
+        bool active = false;
+        bool statesActive = false;
+        bool timeActive = false;
+    };
+
     explicit RuleEngine(QObject *parent = nullptr);
     ~RuleEngine();
     void init();
 
-    QList<Rule> evaluateEvent(const Event &event);
-    QList<Rule> evaluateTime(const QDateTime &dateTime);
+    QList<RuleId> evaluateEvent(const Event &event);
+    QList<RuleId> evaluateTime(const QDateTime &dateTime);
 
     RuleError addRule(const Rule &rule, bool fromEdit = false);
     RuleError editRule(const Rule &rule);
+    RuleError addRules(const QList<Rule> &rules, int *failedIndex = nullptr);
+    RuleError editRules(const QList<Rule> &rules, int *failedIndex = nullptr);
 
     QList<Rule> rules() const;
     QList<RuleId> ruleIds() const;
@@ -100,6 +117,9 @@ public:
     RuleError executeExitActions(const RuleId &ruleId);
 
     Rule findRule(const RuleId &ruleId);
+    const Rule &ruleDefinition(const RuleId &ruleId) const;
+    RuleState ruleState(const RuleId &ruleId) const;
+    RuleStatistics *statistics();
     QList<RuleId> findRules(const ThingId &thingId) const;
     QList<ThingId> thingsInRules() const;
 
@@ -109,11 +129,11 @@ signals:
     void ruleAdded(const Rule &rule);
     void ruleRemoved(const RuleId &ruleId);
     void ruleConfigurationChanged(const Rule &rule);
+    void rulesAdded(const QList<Rule> &rules);
+    void rulesConfigurationChanged(const QList<Rule> &rules);
 
 private:
-    bool containsEvent(const Rule &rule, const Event &event, const ThingClassId &thingClassId);
-    bool containsState(const StateEvaluator &stateEvaluator, const Event &stateChangeEvent);
-
+    RuleError validateRule(const Rule &rule);
     RuleError checkRuleAction(const RuleAction &ruleAction, const Rule &rule);
     RuleError checkRuleActionParam(const RuleActionParam &ruleActionParam, const ActionType &actionType, const Rule &rule);
 
@@ -121,16 +141,54 @@ private:
     QVariant::Type getEventParamType(const EventTypeId &eventTypeId, const ParamTypeId &paramTypeId);
 
     void appendRule(const Rule &rule);
+    void appendRule(const Rule &rule, bool timeActive);
+    void dropRule(const RuleId &ruleId);
+    Rule withRuntimeState(const Rule &rule) const;
+    void updateRuleIndex(const Rule &rule, bool add);
+    void updateRuleIndex(const StateEvaluator &stateEvaluator, const RuleId &ruleId, bool add);
+    void scheduleTimeEvaluation(const RuleId &ruleId, const QDateTime &dueTime = QDateTime());
+    void unscheduleTimeEvaluation(const RuleId &ruleId);
+    void scheduleHoldDeadline(const RuleId &ruleId);
+    void unscheduleHoldDeadline(const RuleId &ruleId);
     void saveRule(const Rule &rule);
-    void saveRuleActions(NymeaSettings *settings, const QList<RuleAction> &ruleActions);
+    void saveRules(const QList<Rule> &rules);
+    QList<Rule> loadLegacyRules();
     QList<RuleAction> loadRuleActions(NymeaSettings *settings);
 
 private:
     QList<RuleId> m_ruleIds; // Keeping a list of RuleIds to keep sorting order...
     QHash<RuleId, Rule> m_rules; // ...but use a Hash for faster finding
-    QList<RuleId> m_activeRules;
+    QHash<RuleId, RuleState> m_ruleStates;
+    QHash<RuleId, CompiledStateEvaluator> m_stateEvaluators;
+    QHash<RuleId, CompiledEventMatcher> m_eventMatchers;
+    RuleStatistics m_statistics;
+    RuleStore m_ruleStore;
+
+    // Rules referencing an event or state, so evaluateEvent() only looks at rules the event can affect
+    QHash<QPair<ThingId, EventTypeId>, QSet<RuleId>> m_rulesByThingEvent;
+    QHash<QPair<QString, QString>, QSet<RuleId>> m_rulesByInterfaceEvent;
+    QHash<QPair<ThingId, StateTypeId>, QSet<RuleId>> m_rulesByThingState;
+    QHash<QString, QSet<RuleId>> m_rulesByInterfaceState;
+    // Rules referencing a thing anywhere, in events, states, actions or action params
+    QHash<ThingId, QSet<RuleId>> m_rulesByThing;
+    // Rules added, enabled or changed since the last event, their active state is settled on the next event
+    QSet<RuleId> m_unevaluatedRules;
+    // Position of each rule in m_ruleIds, to hand out candidates in rule order
+    QHash<RuleId, quint64> m_ruleSequence;
+    quint64 m_nextRuleSequence = 0;
+
+    // Time based rules by the next time their time descriptor may change, and those due on the next tick
+    QMultiMap<QDateTime, RuleId> m_timeSchedule;
+    QHash<RuleId, QDateTime> m_scheduledTimes;
+    // When the next state descriptor hold time of a rule passes
+    QMultiMap<QDateTime, RuleId> m_holdSchedule;
+    QHash<RuleId, QDateTime> m_holdDeadlines;
+    QSet<RuleId> m_dueTimeRules;
 
     QDateTime m_lastEvaluationTime;
+
+    // Minimum number of rules per worker when evaluating time descriptors in parallel, 0 disables it
+    int m_parallelPartitionSize = 256;
 };
 
 }
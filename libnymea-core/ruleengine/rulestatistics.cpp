@@ -0,0 +1,163 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+/*!
+    \class nymeaserver::RuleStatistics
+    \brief Keeps counters about the evaluation and execution of rules.
+
+    The counters are always on and only cost a few additions per evaluated rule. In addition, one out of
+    100 events is traced from the moment it arrives in the core until all actions it caused
+    have finished. The last traces are kept for inspection.
+*/
+
+#include "rulestatistics.h"
+
+namespace nymeaserver {
+
+// Trace one out of this many events
+static const quint64 traceSampleInterval = 100;
+// Number of traces kept
+static const int maxTraces = 50;
+
+RuleStatistics::RuleStatistics()
+{
+
+}
+
+/*! Counts an evaluation of the rule with the given \a ruleId which took \a stateEvaluationTime nanoseconds to
+    update its states. \a matched tells whether the rule got triggered or changed its active state. */
+void RuleStatistics::ruleEvaluated(const RuleId &ruleId, bool matched, qint64 stateEvaluationTime)
+{
+    Counters &counters = m_counters[ruleId];
+    counters.evaluations++;
+    counters.matches += matched ? 1 : 0;
+    counters.stateEvaluationTime += stateEvaluationTime;
+}
+
+/*! Counts an action of the rule with the given \a ruleId which finished \a latency milliseconds after the
+    event triggering it. */
+void RuleStatistics::actionFinished(const RuleId &ruleId, qint64 latency)
+{
+    QHash<RuleId, Counters>::iterator it = m_counters.find(ruleId);
+    if (it == m_counters.end()) {
+        // The rule has been removed in the meantime
+        return;
+    }
+    it->executedActions++;
+    it->actionLatencyTotal += latency;
+    it->actionLatencyMax = qMax(it->actionLatencyMax, latency);
+}
+
+void RuleStatistics::removeRule(const RuleId &ruleId)
+{
+    m_counters.remove(ruleId);
+}
+
+RuleStatistics::Counters RuleStatistics::counters(const RuleId &ruleId) const
+{
+    return m_counters.value(ruleId);
+}
+
+/*! Starts a trace for the given \a event if it is sampled. Returns the id of the trace or 0 if the event is not traced. */
+quint64 RuleStatistics::startTrace(const Event &event)
+{
+    if (m_eventCount++ % traceSampleInterval != 0) {
+        return 0;
+    }
+    Trace trace;
+    trace.id = m_nextTraceId++;
+    trace.timestamp = QDateTime::currentDateTime();
+    trace.thingId = event.thingId();
+    trace.eventTypeId = event.eventTypeId();
+    m_traces.append(trace);
+    while (m_traces.count() > maxTraces) {
+        m_traces.removeFirst();
+    }
+    return trace.id;
+}
+
+/*! Records that the rules for the trace with the given \a traceId took \a evaluationTime microseconds to evaluate
+    and triggered the rules with the given \a ruleIds. */
+void RuleStatistics::traceEvaluated(quint64 traceId, qint64 evaluationTime, const QList<RuleId> &ruleIds)
+{
+    Trace *trace = findTrace(traceId);
+    if (!trace) {
+        return;
+    }
+    trace->evaluationTime = evaluationTime;
+    trace->ruleIds = ruleIds;
+}
+
+/*! Records that \a actionCount actions have been dispatched for the trace with the given \a traceId, \a elapsed
+    milliseconds after the event. */
+void RuleStatistics::traceDispatched(quint64 traceId, int actionCount, qint64 elapsed)
+{
+    Trace *trace = findTrace(traceId);
+    if (!trace) {
+        return;
+    }
+    trace->actionCount = actionCount;
+    if (actionCount == 0) {
+        trace->completionTime = elapsed;
+    }
+}
+
+/*! Records that an action of the trace with the given \a traceId finished \a elapsed milliseconds after the event. */
+void RuleStatistics::traceActionFinished(quint64 traceId, qint64 elapsed)
+{
+    Trace *trace = findTrace(traceId);
+    if (!trace) {
+        return;
+    }
+    trace->finishedActions++;
+    if (trace->finishedActions == trace->actionCount) {
+        trace->completionTime = elapsed;
+    }
+}
+
+QList<RuleStatistics::Trace> RuleStatistics::traces() const
+{
+    return m_traces;
+}
+
+RuleStatistics::Trace *RuleStatistics::findTrace(quint64 traceId)
+{
+    if (traceId == 0) {
+        return nullptr;
+    }
+    // Recent traces are at the end
+    for (int i = m_traces.count() - 1; i >= 0; i--) {
+        if (m_traces.at(i).id == traceId) {
+            return &m_traces[i];
+        }
+    }
+    return nullptr;
+}
+
+}
@@ -0,0 +1,97 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#ifndef RULESTATISTICS_H
+#define RULESTATISTICS_H
+
+#include "typeutils.h"
+#include "types/event.h"
+
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+
+namespace nymeaserver {
+
+class RuleStatistics
+{
+public:
+    class Counters {
+    public:
+        quint64 evaluations = 0;
+        quint64 matches = 0;
+        // Nanoseconds spent in evaluating the state evaluator
+        qint64 stateEvaluationTime = 0;
+        quint64 executedActions = 0;
+        // Milliseconds from the triggering event to the actions being finished
+        qint64 actionLatencyTotal = 0;
+        qint64 actionLatencyMax = 0;
+    };
+
+    class Trace {
+    public:
+        quint64 id = 0;
+        QDateTime timestamp;
+        ThingId thingId;
+        EventTypeId eventTypeId;
+        // Microseconds for evaluating the rules
+        qint64 evaluationTime = 0;
+        QList<RuleId> ruleIds;
+        int actionCount = -1;
+        int finishedActions = 0;
+        // Milliseconds from the event until the last action finished, -1 while actions are pending
+        qint64 completionTime = -1;
+    };
+
+    RuleStatistics();
+
+    void ruleEvaluated(const RuleId &ruleId, bool matched, qint64 stateEvaluationTime = 0);
+    void actionFinished(const RuleId &ruleId, qint64 latency);
+    void removeRule(const RuleId &ruleId);
+
+    Counters counters(const RuleId &ruleId) const;
+
+    quint64 startTrace(const Event &event);
+    void traceEvaluated(quint64 traceId, qint64 evaluationTime, const QList<RuleId> &ruleIds);
+    void traceDispatched(quint64 traceId, int actionCount, qint64 elapsed);
+    void traceActionFinished(quint64 traceId, qint64 elapsed);
+    QList<Trace> traces() const;
+
+private:
+    Trace *findTrace(quint64 traceId);
+
+    QHash<RuleId, Counters> m_counters;
+    QList<Trace> m_traces;
+    quint64 m_eventCount = 0;
+    quint64 m_nextTraceId = 1;
+};
+
+}
+
+#endif // RULESTATISTICS_H
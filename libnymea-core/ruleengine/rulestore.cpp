@@ -0,0 +1,427 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::RuleStore
+    \brief Stores every rule in its own binary record file.
+
+    The records live in the rules directory next to the other settings files, named after the RuleId of the rule
+    they hold. The directory listing is the index of the store, so a single rule can be written, read or removed
+    without touching any other rule. Each record starts with a small header followed by the rule serialized with
+    QDataStream. Records are replaced atomically when a rule is stored again.
+*/
+
+#include "rulestore.h"
+#include "nymeasettings.h"
+#include "loggingcategories.h"
+
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+
+// Bump whenever the layout written by serialize() changes
+static const quint32 ruleRecordMagic = 0x4e59524c;
+static const quint32 ruleRecordVersion = 1;
+
+static const QString ruleRecordSuffix = QStringLiteral(".rule");
+
+namespace nymeaserver {
+
+static void writeRepeatingOption(QDataStream &stream, const RepeatingOption &repeatingOption)
+{
+    stream << static_cast<qint32>(repeatingOption.mode()) << repeatingOption.weekDays() << repeatingOption.monthDays();
+}
+
+static RepeatingOption readRepeatingOption(QDataStream &stream)
+{
+    qint32 mode;
+    QList<int> weekDays, monthDays;
+    stream >> mode >> weekDays >> monthDays;
+    return RepeatingOption(static_cast<RepeatingOption::RepeatingMode>(mode), weekDays, monthDays);
+}
+
+static void writeStateEvaluator(QDataStream &stream, const StateEvaluator &stateEvaluator)
+{
+    const StateDescriptor descriptor = stateEvaluator.stateDescriptor();
+    stream << static_cast<QUuid>(descriptor.stateTypeId()) << static_cast<QUuid>(descriptor.thingId());
+    stream << descriptor.interface() << descriptor.interfaceState() << descriptor.stateValue();
+    stream << static_cast<QUuid>(descriptor.valueThingId()) << static_cast<QUuid>(descriptor.valueStateTypeId());
+    stream << static_cast<qint32>(descriptor.operatorType()) << static_cast<quint32>(descriptor.holdTime()) << descriptor.hysteresis();
+
+    stream << static_cast<qint32>(stateEvaluator.operatorType());
+    stream << static_cast<quint32>(stateEvaluator.childEvaluators().count());
+    foreach (const StateEvaluator &childEvaluator, stateEvaluator.childEvaluators()) {
+        writeStateEvaluator(stream, childEvaluator);
+    }
+}
+
+static StateEvaluator readStateEvaluator(QDataStream &stream)
+{
+    QUuid stateTypeId, thingId, valueThingId, valueStateTypeId;
+    QString interface, interfaceState;
+    QVariant stateValue;
+    qint32 valueOperator, stateOperator;
+    quint32 holdTime, childCount;
+    double hysteresis;
+    stream >> stateTypeId >> thingId >> interface >> interfaceState >> stateValue >> valueThingId >> valueStateTypeId;
+    stream >> valueOperator >> holdTime >> hysteresis;
+
+    StateDescriptor descriptor;
+    descriptor.setStateTypeId(stateTypeId);
+    descriptor.setThingId(thingId);
+    descriptor.setInterface(interface);
+    descriptor.setInterfaceState(interfaceState);
+    descriptor.setStateValue(stateValue);
+    descriptor.setValueThingId(valueThingId);
+    descriptor.setValueStateTypeId(valueStateTypeId);
+    descriptor.setOperatorType(static_cast<Types::ValueOperator>(valueOperator));
+    descriptor.setHoldTime(holdTime);
+    descriptor.setHysteresis(hysteresis);
+
+    StateEvaluator stateEvaluator(descriptor);
+    stream >> stateOperator >> childCount;
+    stateEvaluator.setOperatorType(static_cast<Types::StateOperator>(stateOperator));
+    for (quint32 i = 0; i < childCount && stream.status() == QDataStream::Ok; i++) {
+        stateEvaluator.appendEvaluator(readStateEvaluator(stream));
+    }
+    return stateEvaluator;
+}
+
+static void writeRuleActions(QDataStream &stream, const QList<RuleAction> &ruleActions)
+{
+    stream << static_cast<quint32>(ruleActions.count());
+    foreach (const RuleAction &action, ruleActions) {
+        stream << static_cast<QUuid>(action.thingId()) << static_cast<QUuid>(action.actionTypeId());
+        stream << action.browserItemId() << action.interface() << action.interfaceAction();
+        stream << static_cast<quint32>(action.ruleActionParams().count());
+        foreach (const RuleActionParam &param, action.ruleActionParams()) {
+            stream << static_cast<QUuid>(param.paramTypeId()) << param.paramName() << param.value();
+            stream << static_cast<QUuid>(param.eventTypeId()) << static_cast<QUuid>(param.eventParamTypeId());
+            stream << static_cast<QUuid>(param.stateThingId()) << static_cast<QUuid>(param.stateTypeId());
+        }
+    }
+}
+
+static QList<RuleAction> readRuleActions(QDataStream &stream)
+{
+    QList<RuleAction> actions;
+    quint32 actionCount;
+    stream >> actionCount;
+    for (quint32 i = 0; i < actionCount && stream.status() == QDataStream::Ok; i++) {
+        QUuid thingId, actionTypeId;
+        QString browserItemId, interface, interfaceAction;
+        quint32 paramCount;
+        stream >> thingId >> actionTypeId >> browserItemId >> interface >> interfaceAction >> paramCount;
+
+        RuleActionParams params;
+        for (quint32 j = 0; j < paramCount && stream.status() == QDataStream::Ok; j++) {
+            QUuid paramTypeId, eventTypeId, eventParamTypeId, stateThingId, stateTypeId;
+            QString paramName;
+            QVariant value;
+            stream >> paramTypeId >> paramName >> value >> eventTypeId >> eventParamTypeId >> stateThingId >> stateTypeId;
+
+            RuleActionParam param(ParamTypeId(paramTypeId), value);
+            param.setParamName(paramName);
+            param.setEventTypeId(eventTypeId);
+            param.setEventParamTypeId(eventParamTypeId);
+            param.setStateThingId(stateThingId);
+            param.setStateTypeId(stateTypeId);
+            params.append(param);
+        }
+
+        RuleAction action;
+        action.setThingId(thingId);
+        action.setActionTypeId(actionTypeId);
+        action.setBrowserItemId(browserItemId);
+        action.setInterface(interface);
+        action.setInterfaceAction(interfaceAction);
+        action.setRuleActionParams(params);
+        actions.append(action);
+    }
+    return actions;
+}
+
+/*! Constructs a store keeping its records in the directory \a path. The directory is created when the first
+    rule is stored. */
+RuleStore::RuleStore(const QString &path):
+    m_path(path)
+{
+
+}
+
+/*! Returns the path of the rules directory used by nymead. */
+QString RuleStore::defaultPath()
+{
+    return NymeaSettings::settingsPath() + "/rules";
+}
+
+QString RuleStore::path() const
+{
+    return m_path;
+}
+
+/*! Returns true if the rules directory exists, even if it is empty. A missing directory means the rules
+    still need to be migrated from the rules.conf used by earlier versions. */
+bool RuleStore::exists() const
+{
+    return QDir(m_path).exists();
+}
+
+/*! Returns the ids of all stored rules, sorted by their id. */
+QList<RuleId> RuleStore::ruleIds() const
+{
+    QList<RuleId> ruleIds;
+    foreach (const QString &fileName, QDir(m_path).entryList({"*" + ruleRecordSuffix}, QDir::Files, QDir::Name)) {
+        RuleId ruleId(fileName.left(fileName.length() - ruleRecordSuffix.length()));
+        if (!ruleId.isNull()) {
+            ruleIds.append(ruleId);
+        }
+    }
+    return ruleIds;
+}
+
+/*! Reads the record of the rule with the given \a ruleId into \a rule. Returns false if there is no such record
+    or it can't be decoded. */
+bool RuleStore::loadRule(const RuleId &ruleId, Rule *rule) const
+{
+    QFile file(fileName(ruleId));
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+    if (!deserialize(file.readAll(), rule)) {
+        qCWarning(dcRuleEngine()) << "Ignoring invalid rule record" << file.fileName();
+        return false;
+    }
+    rule->setId(ruleId);
+    return true;
+}
+
+/*! Reads all stored rules, in the order of ruleIds(). Records which can't be decoded are skipped. */
+QList<Rule> RuleStore::loadRules() const
+{
+    QList<Rule> rules;
+    foreach (const RuleId &ruleId, ruleIds()) {
+        Rule rule;
+        if (loadRule(ruleId, &rule)) {
+            rules.append(rule);
+        }
+    }
+    return rules;
+}
+
+/*! Writes the record of the given \a rule, replacing any previous record of it. */
+bool RuleStore::storeRule(const Rule &rule)
+{
+    if (!QDir().mkpath(m_path)) {
+        qCWarning(dcRuleEngine()) << "Error creating rules directory" << m_path;
+        return false;
+    }
+
+    QSaveFile file(fileName(rule.id()));
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(dcRuleEngine()) << "Error opening rule record for writing at" << file.fileName();
+        return false;
+    }
+    file.write(serialize(rule));
+    if (!file.commit()) {
+        qCWarning(dcRuleEngine()) << "Error writing rule record at" << file.fileName();
+        return false;
+    }
+    return true;
+}
+
+/*! Deletes the record of the rule with the given \a ruleId. Returns true if there is no such record afterwards. */
+bool RuleStore::removeRule(const RuleId &ruleId)
+{
+    QFile file(fileName(ruleId));
+    if (file.exists() && !file.remove()) {
+        qCWarning(dcRuleEngine()) << "Error removing rule record" << file.fileName();
+        return false;
+    }
+    return true;
+}
+
+/*! Returns a human readable dump of all stored rules. */
+QByteArray RuleStore::toText() const
+{
+    QByteArray text;
+    foreach (const Rule &rule, loadRules()) {
+        QString ruleText;
+        QDebug(&ruleText) << rule;
+        text += "[" + rule.id().toString().toUtf8() + "]\n";
+        text += ruleText.toUtf8() + "\n\n";
+    }
+    return text;
+}
+
+/*! Returns the record of the given \a rule, without its runtime state. */
+QByteArray RuleStore::serialize(const Rule &rule)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << ruleRecordMagic << ruleRecordVersion;
+    stream << rule.name() << rule.enabled() << rule.executable();
+
+    const TimeDescriptor timeDescriptor = rule.timeDescriptor();
+    stream << static_cast<quint32>(timeDescriptor.calendarItems().count());
+    foreach (const CalendarItem &calendarItem, timeDescriptor.calendarItems()) {
+        stream << calendarItem.dateTime() << calendarItem.startTime() << static_cast<quint32>(calendarItem.duration());
+        writeRepeatingOption(stream, calendarItem.repeatingOption());
+    }
+    stream << static_cast<quint32>(timeDescriptor.timeEventItems().count());
+    foreach (const TimeEventItem &timeEventItem, timeDescriptor.timeEventItems()) {
+        stream << timeEventItem.dateTime() << timeEventItem.time();
+        writeRepeatingOption(stream, timeEventItem.repeatingOption());
+    }
+
+    stream << static_cast<quint32>(rule.eventDescriptors().count());
+    foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
+        stream << static_cast<QUuid>(eventDescriptor.thingId()) << static_cast<QUuid>(eventDescriptor.eventTypeId());
+        stream << eventDescriptor.interface() << eventDescriptor.interfaceEvent();
+        stream << static_cast<quint32>(eventDescriptor.paramDescriptors().count());
+        foreach (const ParamDescriptor &paramDescriptor, eventDescriptor.paramDescriptors()) {
+            stream << static_cast<QUuid>(paramDescriptor.paramTypeId()) << paramDescriptor.paramName();
+            stream << paramDescriptor.value() << static_cast<qint32>(paramDescriptor.operatorType());
+        }
+    }
+
+    writeStateEvaluator(stream, rule.stateEvaluator());
+    writeRuleActions(stream, rule.actions());
+    writeRuleActions(stream, rule.exitActions());
+    return data;
+}
+
+/*! Decodes a record written by serialize() into \a rule. The id of the rule is not part of the record. Returns false
+    if \a data is not a valid record. */
+bool RuleStore::deserialize(const QByteArray &data, Rule *rule)
+{
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic, version;
+    stream >> magic >> version;
+    if (stream.status() != QDataStream::Ok || magic != ruleRecordMagic || version != ruleRecordVersion) {
+        return false;
+    }
+
+    QString name;
+    bool enabled, executable;
+    stream >> name >> enabled >> executable;
+
+    quint32 count;
+    QList<CalendarItem> calendarItems;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        CalendarItem calendarItem;
+        QDateTime dateTime;
+        QTime startTime;
+        quint32 duration;
+        stream >> dateTime >> startTime >> duration;
+        calendarItem.setDateTime(dateTime);
+        calendarItem.setStartTime(startTime);
+        calendarItem.setDuration(duration);
+        calendarItem.setRepeatingOption(readRepeatingOption(stream));
+        calendarItems.append(calendarItem);
+    }
+
+    QList<TimeEventItem> timeEventItems;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        TimeEventItem timeEventItem;
+        QDateTime dateTime;
+        QTime time;
+        stream >> dateTime >> time;
+        timeEventItem.setDateTime(dateTime);
+        timeEventItem.setTime(time);
+        timeEventItem.setRepeatingOption(readRepeatingOption(stream));
+        timeEventItems.append(timeEventItem);
+    }
+
+    TimeDescriptor timeDescriptor;
+    timeDescriptor.setCalendarItems(calendarItems);
+    timeDescriptor.setTimeEventItems(timeEventItems);
+
+    QList<EventDescriptor> eventDescriptors;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QUuid thingId, eventTypeId;
+        QString interface, interfaceEvent;
+        quint32 paramCount;
+        stream >> thingId >> eventTypeId >> interface >> interfaceEvent >> paramCount;
+
+        QList<ParamDescriptor> paramDescriptors;
+        for (quint32 j = 0; j < paramCount && stream.status() == QDataStream::Ok; j++) {
+            QUuid paramTypeId;
+            QString paramName;
+            QVariant value;
+            qint32 operatorType;
+            stream >> paramTypeId >> paramName >> value >> operatorType;
+            ParamDescriptor paramDescriptor(ParamTypeId(paramTypeId), value);
+            paramDescriptor.setParamName(paramName);
+            paramDescriptor.setOperatorType(static_cast<Types::ValueOperator>(operatorType));
+            paramDescriptors.append(paramDescriptor);
+        }
+
+        EventDescriptor eventDescriptor;
+        eventDescriptor.setThingId(thingId);
+        eventDescriptor.setEventTypeId(eventTypeId);
+        eventDescriptor.setInterface(interface);
+        eventDescriptor.setInterfaceEvent(interfaceEvent);
+        eventDescriptor.setParamDescriptors(paramDescriptors);
+        eventDescriptors.append(eventDescriptor);
+    }
+
+    StateEvaluator stateEvaluator = readStateEvaluator(stream);
+    QList<RuleAction> actions = readRuleActions(stream);
+    QList<RuleAction> exitActions = readRuleActions(stream);
+
+    if (stream.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    rule->setName(name);
+    rule->setEnabled(enabled);
+    rule->setExecutable(executable);
+    rule->setTimeDescriptor(timeDescriptor);
+    rule->setEventDescriptors(eventDescriptors);
+    rule->setStateEvaluator(stateEvaluator);
+    rule->setActions(actions);
+    rule->setExitActions(exitActions);
+    return true;
+}
+
+QString RuleStore::fileName(const RuleId &ruleId) const
+{
+    return m_path + "/" + ruleId.toString().remove('{').remove('}') + ruleRecordSuffix;
+}
+
+}
@@ -161,33 +161,6 @@ QList<ThingId> StateEvaluator::containedThings() const
     return ret;
 }
 
-void StateEvaluator::dumpToSettings(NymeaSettings &settings, const QString &groupName) const
-{
-    settings.beginGroup(groupName);
-
-    settings.beginGroup("stateDescriptor");
-    settings.setValue("stateTypeId", m_stateDescriptor.stateTypeId().toString());
-    settings.setValue("thingId", m_stateDescriptor.thingId().toString());
-    settings.setValue("interface", m_stateDescriptor.interface());
-    settings.setValue("interfaceState", m_stateDescriptor.interfaceState());
-    settings.setValue("value", m_stateDescriptor.stateValue());
-    settings.setValue("valueType", (int)m_stateDescriptor.stateValue().type());
-    settings.setValue("valueThingId", m_stateDescriptor.valueThingId().toString());
-    settings.setValue("valueStateTypeId", m_stateDescriptor.valueStateTypeId().toString());
-    settings.setValue("operator", m_stateDescriptor.operatorType());
-    settings.endGroup();
-
-    settings.setValue("operator", m_operatorType);
-
-    settings.beginGroup("childEvaluators");
-    for (int i = 0; i < m_childEvaluators.count(); i++) {
-        m_childEvaluators.at(i).dumpToSettings(settings, "stateEvaluator-" + QString::number(i));
-    }
-    settings.endGroup();
-
-    settings.endGroup();
-}
-
 StateEvaluator StateEvaluator::loadFromSettings(NymeaSettings &settings, const QString &groupName)
 {
     settings.beginGroup(groupName);
@@ -224,6 +197,8 @@ StateEvaluator StateEvaluator::loadFromSettings(NymeaSettings &settings, const Q
     }
     stateDescriptor.setValueThingId(valueThingId);
     stateDescriptor.setValueStateTypeId(valueStateTypeId);
+    stateDescriptor.setHoldTime(settings.value("holdTime", 0).toUInt());
+    stateDescriptor.setHysteresis(settings.value("hysteresis", 0).toDouble());
 
     settings.endGroup();
 
@@ -242,6 +217,10 @@ StateEvaluator StateEvaluator::loadFromSettings(NymeaSettings &settings, const Q
 bool StateEvaluator::isValid() const
 {
     if (m_stateDescriptor.isValid()) {
+        if (m_stateDescriptor.hysteresis() < 0) {
+            qCWarning(dcRuleEngine) << "State evaluator hysteresis must not be negative:" << m_stateDescriptor.hysteresis();
+            return false;
+        }
         if (m_stateDescriptor.type() == StateDescriptor::TypeThing) {
             Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_stateDescriptor.thingId());
             if (!thing) {
@@ -293,7 +272,7 @@ bool StateEvaluator::isValid() const
                             qCWarning(dcRuleEngine()) << "State descriptor valueThing does not exist" << m_stateDescriptor.valueThingId().toString();
                             return false;
                         }
-                        StateType valueStateType = valueThing->thingClass().stateTypes().findById(m_stateDescriptor.valueStateTypeId());
+                        StateType valueStateType = valueThing->thingClass().getStateType(m_stateDescriptor.valueStateTypeId());
                         if (!valueStateType.isValid()) {
                             qCWarning(dcRuleEngine()) << "State descriptor value state type" << m_stateDescriptor.valueStateTypeId().toString() << "does not exist in thing" << valueThing->name();
                             return false;
@@ -339,7 +318,7 @@ bool StateEvaluator::isEmpty() const
     return !m_stateDescriptor.isValid() && m_childEvaluators.isEmpty();
 }
 
-bool StateEvaluator::evaluateDescriptor(const StateDescriptor &descriptor) const
+bool StateEvaluator::evaluateDescriptor(const StateDescriptor &descriptor)
 {
     if (descriptor.type() == StateDescriptor::TypeThing) {
         qCDebug(dcRuleEngineDebug()) << "Evaluating thing based state descriptor";
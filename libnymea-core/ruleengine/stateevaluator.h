@@ -78,14 +78,12 @@ public:
     void removeThing(const ThingId &thingId);
     QList<ThingId> containedThings() const;
 
-    void dumpToSettings(NymeaSettings &settings, const QString &groupName) const;
     static StateEvaluator loadFromSettings(NymeaSettings &settings, const QString &groupPrefix);
 
     bool isValid() const;
     bool isEmpty() const;
 
-private:
-    bool evaluateDescriptor(const StateDescriptor &descriptor) const;
+    static bool evaluateDescriptor(const StateDescriptor &descriptor);
 
 private:
     StateDescriptor m_stateDescriptor;
@@ -57,6 +57,21 @@ void Script::setName(const QString &name)
     m_name = name;
 }
 
+bool Script::isolated() const
+{
+    return m_isolated;
+}
+
+void Script::setIsolated(bool isolated)
+{
+    m_isolated = isolated;
+}
+
+uint Script::cpuTime() const
+{
+    return m_cpuTime;
+}
+
 Scripts::Scripts()
 {
 
@@ -39,11 +39,15 @@
 
 namespace nymeaserver {
 
+class ScriptWorker;
+
 class Script
 {
     Q_GADGET
     Q_PROPERTY(QUuid id READ id)
     Q_PROPERTY(QString name READ name WRITE setName)
+    Q_PROPERTY(bool isolated READ isolated WRITE setIsolated USER true)
+    Q_PROPERTY(uint cpuTime READ cpuTime USER true)
 public:
     Script();
 
@@ -53,16 +57,24 @@ public:
     QString name() const;
     void setName(const QString &name);
 
+    bool isolated() const;
+    void setIsolated(bool isolated);
+
+    uint cpuTime() const;
+
     QStringList errors;
 
 private:
     QUuid m_id;
     QString m_name;
+    bool m_isolated = false;
+    uint m_cpuTime = 0;
 
     friend class ScriptEngine;
     QQmlContext *context = nullptr;
     QQmlComponent *component = nullptr;
     QObject *object = nullptr;
+    ScriptWorker *worker = nullptr;
 };
 
 class Scripts: public QList<Script>
@@ -29,6 +29,7 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "scriptaction.h"
+#include "scriptengine.h"
 
 #include "integrations/thingmanager.h"
 #include "types/action.h"
@@ -109,53 +110,56 @@ void ScriptAction::setActionName(const QString &actionName)
 
 void ScriptAction::execute(const QVariantMap &params)
 {
-    Things things;
-    if (m_thingId.isEmpty() && !m_interfaceName.isEmpty()) {
-        foreach (Thing *thing, m_thingManager->configuredThings()) {
-            if (thing->thingClass().interfaces().contains(m_interfaceName)) {
-                things.append(thing);
+    // Things may only be accessed in the core thread, which isn't ours for isolated scripts
+    ScriptEngine::invokeInThread(m_thingManager, [this, &params](){
+        Things things;
+        if (m_thingId.isEmpty() && !m_interfaceName.isEmpty()) {
+            foreach (Thing *thing, m_thingManager->configuredThings()) {
+                if (thing->thingClass().interfaces().contains(m_interfaceName)) {
+                    things.append(thing);
+                }
             }
         }
-    }
-    Thing *thing = m_thingManager->configuredThings().findById(ThingId(m_thingId));
-    if (thing && !things.contains(thing)) {
-        things.append(thing);
-    }
-    if (things.isEmpty()) {
-        qCWarning(dcScriptEngine) << "No things matching by id" << m_thingId << "and interface" << m_interfaceName;
-        return;
-    }
-
-    foreach (Thing *thing, things) {
-        ActionType actionType;
-        if (!ActionTypeId(m_actionTypeId).isNull()) {
-            actionType = thing->thingClass().actionTypes().findById(ActionTypeId(m_actionTypeId));
-        } else {
-            actionType = thing->thingClass().actionTypes().findByName(m_actionName);
+        Thing *thing = m_thingManager->configuredThings().findById(ThingId(m_thingId));
+        if (thing && !things.contains(thing)) {
+            things.append(thing);
         }
-        if (actionType.id().isNull()) {
-            qCWarning(dcScriptEngine()) << "Thing" << thing->name() << "does not have actionTypeId" << m_actionTypeId << "or actionName" << m_actionName;
-            continue;
+        if (things.isEmpty()) {
+            qCWarning(dcScriptEngine) << "No things matching by id" << m_thingId << "and interface" << m_interfaceName;
+            return;
         }
-        Action action(actionType.id(), thing->id(), Action::TriggeredByScript);
-        ParamList paramList;
-        foreach (const QString &paramNameOrId, params.keys()) {
-            ParamType paramType;
-            if (!ParamTypeId(paramNameOrId).isNull()) {
-                paramType = actionType.paramTypes().findById(ParamTypeId(paramNameOrId));
+
+        foreach (Thing *thing, things) {
+            ActionType actionType;
+            if (!ActionTypeId(m_actionTypeId).isNull()) {
+                actionType = thing->thingClass().getActionType(ActionTypeId(m_actionTypeId));
             } else {
-                paramType = actionType.paramTypes().findByName(paramNameOrId);
+                actionType = thing->thingClass().actionTypes().findByName(m_actionName);
             }
-            if (paramType.id().isNull()) {
-                qCWarning(dcScriptEngine()) << "Invalid param id or name";
+            if (actionType.id().isNull()) {
+                qCWarning(dcScriptEngine()) << "Thing" << thing->name() << "does not have actionTypeId" << m_actionTypeId << "or actionName" << m_actionName;
                 continue;
             }
-            paramList << Param(paramType.id(), params.value(paramNameOrId));
+            Action action(actionType.id(), thing->id(), Action::TriggeredByScript);
+            ParamList paramList;
+            foreach (const QString &paramNameOrId, params.keys()) {
+                ParamType paramType;
+                if (!ParamTypeId(paramNameOrId).isNull()) {
+                    paramType = actionType.paramTypes().findById(ParamTypeId(paramNameOrId));
+                } else {
+                    paramType = actionType.paramTypes().findByName(paramNameOrId);
+                }
+                if (paramType.id().isNull()) {
+                    qCWarning(dcScriptEngine()) << "Invalid param id or name";
+                    continue;
+                }
+                paramList << Param(paramType.id(), params.value(paramNameOrId));
+            }
+            action.setParams(paramList);
+            qCDebug(dcScriptEngine()) << "Executing action:" << action.thingId() << action.actionTypeId() << action.params();
+            m_thingManager->executeAction(action);
         }
-        action.setParams(paramList);
-        qCDebug(dcScriptEngine()) << "Executing action:" << action.thingId() << action.actionTypeId() << action.params();
-        m_thingManager->executeAction(action);
-    }
+    });
 }
 
 }
@@ -34,17 +34,24 @@
 #include "scriptaction.h"
 #include "scriptevent.h"
 #include "scriptstate.h"
+#include "scriptstategroup.h"
 #include "scriptalarm.h"
 #include "scriptinterfaceaction.h"
 #include "scriptinterfaceevent.h"
+#include "scriptworker.h"
 
 #include "nymeasettings.h"
+#include "startuptrace.h"
 
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
 #include <QQmlComponent>
 #include <QJsonParseError>
 #include <QJsonDocument>
+#include <QSemaphore>
+#include <QSharedPointer>
+#include <QCryptographicHash>
+#include <QThread>
 
 #include "loggingcategories.h"
 
@@ -57,8 +64,24 @@ QtMessageHandler ScriptEngine::s_upstreamMessageHandler;
 QLoggingCategory::CategoryFilter ScriptEngine::s_oldCategoryFilter = nullptr;
 QMutex ScriptEngine::s_loggerMutex;
 
-ScriptEngine::ScriptEngine(ThingManager *deviceManager, QObject *parent) : QObject(parent),
-    m_deviceManager(deviceManager)
+// Isolated scripts busy with a single event for longer than this are terminated
+static const int scriptWatchdogTimeout = 10000;
+
+// Calls the given function in the thread of the script item, right away if that's the current thread
+template <typename Item, typename Function>
+static void deliverToItem(Item *item, Function function)
+{
+    if (item->thread() == QThread::currentThread()) {
+        function();
+    } else {
+        QTimer::singleShot(0, item, function);
+    }
+}
+
+ScriptEngine::ScriptEngine(ThingManager *deviceManager, ThingStateSnapshots *stateSnapshots, QObject *parent) : QObject(parent),
+    m_deviceManager(deviceManager),
+    m_stateSnapshots(stateSnapshots),
+    m_subscriptionMutex(QMutex::Recursive)
 {
     qmlRegisterType<ScriptEvent>("nymea", 1, 0, "DeviceEvent");
     qmlRegisterType<ScriptAction>("nymea", 1, 0, "DeviceAction");
@@ -66,12 +89,23 @@ ScriptEngine::ScriptEngine(ThingManager *deviceManager, QObject *parent) : QObje
     qmlRegisterType<ScriptEvent>("nymea", 1, 0, "ThingEvent");
     qmlRegisterType<ScriptAction>("nymea", 1, 0, "ThingAction");
     qmlRegisterType<ScriptState>("nymea", 1, 0, "ThingState");
+    qmlRegisterType<ScriptStateGroup>("nymea", 1, 0, "ThingStateGroup");
     qmlRegisterType<ScriptInterfaceAction>("nymea", 1, 0, "InterfaceAction");
     qmlRegisterType<ScriptInterfaceEvent>("nymea", 1, 0, "InterfaceEvent");
     qmlRegisterType<ScriptAlarm>("nymea", 1, 0, "Alarm");
 
     m_engine = new QQmlEngine(this);
     m_engine->setProperty("thingManager", reinterpret_cast<quint64>(m_deviceManager));
+    m_engine->setProperty("scriptEngine", reinterpret_cast<quint64>(this));
+
+    connect(m_deviceManager, &ThingManager::thingStateChanged, this, &ScriptEngine::onThingStateChanged);
+    connect(m_deviceManager, &ThingManager::thingStatesChanged, this, [this](Thing *thing, const QList<StateTypeId> &stateTypeIds){
+        foreach (const StateTypeId &stateTypeId, stateTypeIds) {
+            onThingStateChanged(thing, stateTypeId);
+        }
+    });
+    connect(m_deviceManager, &ThingManager::thingAdded, this, &ScriptEngine::onThingAdded);
+    connect(m_deviceManager, &ThingManager::eventTriggered, this, &ScriptEngine::onEventTriggered);
 
     // Don't automatically print script warnings (that is, runtime errors, *not* console.warn() messages)
     // to stdout as they'd end up on the "default" logging category.
@@ -104,11 +138,18 @@ ScriptEngine::ScriptEngine(ThingManager *deviceManager, QObject *parent) : QObje
     }
     s_engines.append(this);
 
+    m_watchdog = new QTimer(this);
+    m_watchdog->setInterval(1000);
+    connect(m_watchdog, &QTimer::timeout, this, &ScriptEngine::onWatchdogTimeout);
+    m_watchdog->start();
 
     QDir dir;
     if (!dir.exists(NymeaSettings::storagePath() + "/scripts/")) {
         dir.mkpath(NymeaSettings::storagePath() + "/scripts/");
     }
+    if (!dir.exists(NymeaSettings::storagePath() + "/scripts/cache/")) {
+        dir.mkpath(NymeaSettings::storagePath() + "/scripts/cache/");
+    }
 
     loadScripts();
 
@@ -116,10 +157,8 @@ ScriptEngine::ScriptEngine(ThingManager *deviceManager, QObject *parent) : QObje
 
 ScriptEngine::~ScriptEngine()
 {
-    foreach (Script *script, m_scripts) {
-        unloadScript(script);
-        delete script;
-    }
+    unloadScripts();
+    qDeleteAll(m_scripts);
     s_engines.removeAll(this);
     if (s_engines.isEmpty()) {
         qInstallMessageHandler(s_upstreamMessageHandler);
@@ -130,7 +169,11 @@ Scripts ScriptEngine::scripts()
 {
     Scripts ret;
     foreach (Script *script, m_scripts) {
-        ret.append(*script);
+        Script copy = *script;
+        if (script->worker) {
+            copy.m_cpuTime += script->worker->cpuTime();
+        }
+        ret.append(copy);
     }
     return ret;
 }
@@ -154,7 +197,7 @@ ScriptEngine::GetScriptReply ScriptEngine::scriptContent(const QUuid &id)
     return reply;
 }
 
-ScriptEngine::AddScriptReply ScriptEngine::addScript(const QString &name, const QByteArray &content)
+ScriptEngine::AddScriptReply ScriptEngine::addScript(const QString &name, const QByteArray &content, bool isolated)
 {
     QUuid id = QUuid::createUuid();
     QString fileName = baseName(id) + ".qml";
@@ -170,6 +213,7 @@ ScriptEngine::AddScriptReply ScriptEngine::addScript(const QString &name, const
     }
     QVariantMap metadata;
     metadata.insert("name", name);
+    metadata.insert("isolated", isolated);
     jsonFile.write(QJsonDocument::fromVariant(metadata).toJson());
     jsonFile.close();
 
@@ -191,6 +235,7 @@ ScriptEngine::AddScriptReply ScriptEngine::addScript(const QString &name, const
     Script *script = new Script();
     script->setId(id);
     script->setName(name);
+    script->setIsolated(isolated);
     bool loaded = loadScript(script);
     if (!loaded) {
         reply.scriptError = ScriptErrorInvalidScript;
@@ -320,6 +365,7 @@ ScriptEngine::ScriptError ScriptEngine::removeScript(const QUuid &id)
     QFile::remove(scriptFileName);
     QFile::remove(jsonFileName);
     QFile::remove(compiledScriptFileName);
+    removeCachedScripts(id);
 
     emit scriptRemoved(script->id());
 
@@ -327,6 +373,133 @@ ScriptEngine::ScriptError ScriptEngine::removeScript(const QUuid &id)
     return ScriptErrorNoError;
 }
 
+/*! Delivers changes of the state with the given \a stateTypeId of the thing with the given \a thingId, as well
+    as the appearance of that thing, to the given \a state. A previous subscription of \a state is replaced.
+    The \a stateTypeId may be null if it can't be resolved yet, in which case only the appearance is delivered.
+*/
+void ScriptEngine::subscribeState(ScriptState *state, const ThingId &thingId, const StateTypeId &stateTypeId)
+{
+    QMutexLocker locker(&m_subscriptionMutex);
+    unsubscribeState(state);
+    QPair<ThingId, StateTypeId> key(thingId, stateTypeId);
+    m_stateSubscriptions.insert(state, key);
+    m_stateSubscribers[key].append(state);
+    m_stateThingSubscribers[thingId].append(state);
+}
+
+void ScriptEngine::unsubscribeState(ScriptState *state)
+{
+    QMutexLocker locker(&m_subscriptionMutex);
+    if (!m_stateSubscriptions.contains(state)) {
+        return;
+    }
+    QPair<ThingId, StateTypeId> key = m_stateSubscriptions.take(state);
+    m_stateSubscribers[key].removeAll(state);
+    if (m_stateSubscribers.value(key).isEmpty()) {
+        m_stateSubscribers.remove(key);
+    }
+    m_stateThingSubscribers[key.first].removeAll(state);
+    if (m_stateThingSubscribers.value(key.first).isEmpty()) {
+        m_stateThingSubscribers.remove(key.first);
+    }
+}
+
+/*! Delivers events of the thing with the given \a thingId to the given \a event, replacing a previous subscription. */
+void ScriptEngine::subscribeEvent(ScriptEvent *event, const ThingId &thingId)
+{
+    QMutexLocker locker(&m_subscriptionMutex);
+    unsubscribeEvent(event);
+    m_eventSubscriptions.insert(event, thingId);
+    m_eventSubscribers[thingId].append(event);
+}
+
+void ScriptEngine::unsubscribeEvent(ScriptEvent *event)
+{
+    QMutexLocker locker(&m_subscriptionMutex);
+    if (!m_eventSubscriptions.contains(event)) {
+        return;
+    }
+    ThingId thingId = m_eventSubscriptions.take(event);
+    m_eventSubscribers[thingId].removeAll(event);
+    if (m_eventSubscribers.value(thingId).isEmpty()) {
+        m_eventSubscribers.remove(thingId);
+    }
+}
+
+/*! Delivers events of all things implementing the interface with the given \a interfaceName to the given \a event,
+    replacing a previous subscription.
+*/
+void ScriptEngine::subscribeInterfaceEvent(ScriptInterfaceEvent *event, const QString &interfaceName)
+{
+    QMutexLocker locker(&m_subscriptionMutex);
+    unsubscribeInterfaceEvent(event);
+    m_interfaceEventSubscriptions.insert(event, interfaceName);
+    m_interfaceEventSubscribers[interfaceName].append(event);
+}
+
+void ScriptEngine::unsubscribeInterfaceEvent(ScriptInterfaceEvent *event)
+{
+    QMutexLocker locker(&m_subscriptionMutex);
+    if (!m_interfaceEventSubscriptions.contains(event)) {
+        return;
+    }
+    QString interfaceName = m_interfaceEventSubscriptions.take(event);
+    m_interfaceEventSubscribers[interfaceName].removeAll(event);
+    if (m_interfaceEventSubscribers.value(interfaceName).isEmpty()) {
+        m_interfaceEventSubscribers.remove(interfaceName);
+    }
+}
+
+void ScriptEngine::onThingStateChanged(Thing *thing, const StateTypeId &stateTypeId)
+{
+    QMutexLocker locker(&m_subscriptionMutex);
+    // Script handlers may change or drop subscriptions while we're delivering, so work on a copy
+    QList<ScriptState*> states = m_stateSubscribers.value(qMakePair(thing->id(), stateTypeId));
+    foreach (ScriptState *state, states) {
+        if (m_stateSubscriptions.value(state) == qMakePair(thing->id(), stateTypeId)) {
+            deliverToItem(state, [state](){ state->onThingStateChanged(); });
+        }
+    }
+}
+
+void ScriptEngine::onThingAdded(Thing *thing)
+{
+    QMutexLocker locker(&m_subscriptionMutex);
+    QList<ScriptState*> states = m_stateThingSubscribers.value(thing->id());
+    foreach (ScriptState *state, states) {
+        if (m_stateSubscriptions.contains(state)) {
+            deliverToItem(state, [state](){ state->onThingAdded(); });
+        }
+    }
+}
+
+void ScriptEngine::onEventTriggered(const Event &event)
+{
+    QMutexLocker locker(&m_subscriptionMutex);
+    QList<ScriptEvent*> events = m_eventSubscribers.value(event.thingId());
+    foreach (ScriptEvent *scriptEvent, events) {
+        if (m_eventSubscriptions.contains(scriptEvent)) {
+            deliverToItem(scriptEvent, [scriptEvent, event](){ scriptEvent->onEventTriggered(event); });
+        }
+    }
+
+    if (m_interfaceEventSubscribers.isEmpty()) {
+        return;
+    }
+    Thing *thing = m_deviceManager->findConfiguredThing(event.thingId());
+    if (!thing) {
+        return;
+    }
+    foreach (const QString &interfaceName, thing->thingClass().interfaces()) {
+        QList<ScriptInterfaceEvent*> interfaceEvents = m_interfaceEventSubscribers.value(interfaceName);
+        foreach (ScriptInterfaceEvent *interfaceEvent, interfaceEvents) {
+            if (m_interfaceEventSubscriptions.contains(interfaceEvent)) {
+                deliverToItem(interfaceEvent, [interfaceEvent, event](){ interfaceEvent->onEventTriggered(event); });
+            }
+        }
+    }
+}
+
 void ScriptEngine::loadScripts()
 {
     QDir dir(NymeaSettings::storagePath() + "/scripts/");
@@ -357,8 +530,12 @@ void ScriptEngine::loadScripts()
         Script *script = new Script();
         script->setId(jsonFileInfo.baseName());
         script->setName(jsonDoc.toVariant().toMap().value("name").toString());
+        script->setIsolated(jsonDoc.toVariant().toMap().value("isolated").toBool());
 
-        bool loaded = loadScript(script);
+        // Scripts are compiled concurrently by the QML type loader and instantiated once they're ready
+        qint64 loadStart = StartupTrace::now();
+        bool loaded = loadScript(script, true);
+        StartupTrace::record("scripts", script->name(), loadStart, {{"loaded", loaded}});
         if (!loaded) {
             qCWarning(dcScriptEngine()) << "Script failed to load:";
             delete script;
@@ -366,15 +543,19 @@ void ScriptEngine::loadScripts()
         }
 
         m_scripts.insert(script->id(), script);
-        qCDebug(dcScriptEngine()) << "Script loaded" << scriptFileName;
+        qCDebug(dcScriptEngine()) << "Script loading" << scriptFileName;
     }
 }
 
-bool ScriptEngine::loadScript(Script *script)
+bool ScriptEngine::loadScript(Script *script, bool asynchronous)
 {
     qCDebug(dcScriptEngine()) << "Loading script" << script->name();
 
-    QString fileName = baseName(script->id()) + ".qml";
+    QString fileName = cachedScriptFileName(script->id());
+    if (fileName.isEmpty()) {
+        qCWarning(dcScriptEngine()) << "Failed to prepare script for loading";
+        return false;
+    }
     QString jsonFileName = baseName(script->id()) + ".json";
 
     QFile jsonFile(jsonFileName);
@@ -395,8 +576,51 @@ bool ScriptEngine::loadScript(Script *script)
 
     script->errors.clear();
 
-    script->component = new QQmlComponent(m_engine, QUrl::fromLocalFile(fileName), this);
+    if (script->isolated()) {
+        // Only compile the script here to report errors, it will be instantiated by a worker in its own thread
+        QQmlComponent component(m_engine, QUrl::fromLocalFile(fileName));
+        if (component.isError()) {
+            qCWarning(dcScriptEngine()) << "Script failed to load:";
+            foreach (const QQmlError &error, component.errors()) {
+                qCWarning(dcScriptEngine()) << error.toString();
+                script->errors.append(QString("%1:%2: %3").arg(error.line()).arg(error.column()).arg(error.description()));
+            }
+            m_engine->trimComponentCache();
+            return false;
+        }
+        m_engine->trimComponentCache();
+
+        script->worker = new ScriptWorker(m_deviceManager, this, this);
+        connect(script->worker, &ScriptWorker::warningReceived, this, &ScriptEngine::onScriptWarning);
+        script->worker->load(QUrl::fromLocalFile(fileName));
+        return true;
+    }
+
+    QQmlComponent::CompilationMode mode = asynchronous ? QQmlComponent::Asynchronous : QQmlComponent::PreferSynchronous;
+    script->component = new QQmlComponent(m_engine, QUrl::fromLocalFile(fileName), mode, this);
     script->context = new QQmlContext(m_engine, this);
+
+    if (script->component->isLoading()) {
+        connect(script->component, &QQmlComponent::statusChanged, this, [this, script](QQmlComponent::Status status){
+            if (status == QQmlComponent::Loading) {
+                return;
+            }
+            if (!createScriptObject(script)) {
+                qCWarning(dcScriptEngine()) << "Script failed to load:" << script->name();
+                m_scripts.remove(script->id());
+                delete script;
+                return;
+            }
+            qCDebug(dcScriptEngine()) << "Script loaded" << script->name();
+        });
+        return true;
+    }
+
+    return createScriptObject(script);
+}
+
+bool ScriptEngine::createScriptObject(Script *script)
+{
     script->object = script->component->create(script->context);
 
     if (!script->object) {
@@ -406,9 +630,10 @@ bool ScriptEngine::loadScript(Script *script)
             script->errors.append(QString("%1:%2: %3").arg(error.line()).arg(error.column()).arg(error.description()));
         }
         delete script->context;
-        delete script->component;
-
-        m_engine->clearComponentCache();
+        script->context = nullptr;
+        // This may be called from the component's statusChanged signal
+        script->component->deleteLater();
+        script->component = nullptr;
         return false;
     }
     return true;
@@ -416,10 +641,19 @@ bool ScriptEngine::loadScript(Script *script)
 
 void ScriptEngine::unloadScript(Script *script)
 {
-    if (!script->object || !script->component || !script->context) {
+    if (script->worker) {
+        script->m_cpuTime += script->worker->cpuTime();
+        script->worker->stop();
+        script->worker = nullptr;
+        qCDebug(dcScriptEngine()) << "Unloading script" << script->name();
+        return;
+    }
+
+    if (!script->component || !script->context) {
         qCWarning(dcScriptEngine()) << "Script seems not to be loaded. Cannot unload.";
         return;
     }
+    // The object is still missing if the script is unloaded while being compiled asynchronously
     delete script->object;
     script->object = nullptr;
     delete script->component;
@@ -427,10 +661,69 @@ void ScriptEngine::unloadScript(Script *script)
     delete script->context;
     script->context = nullptr;
 
-    m_engine->clearComponentCache();
+    // Cached types are keyed by content, so there is no need to clear the cache of all the other scripts
+    m_engine->trimComponentCache();
     qCDebug(dcScriptEngine()) << "Unloading script" << script->name();
 }
 
+/*! Unloads all scripts and waits for isolated scripts to finish. Scripts may access things, so this must
+    happen before the ThingManager goes away.
+*/
+void ScriptEngine::unloadScripts()
+{
+    foreach (Script *script, m_scripts) {
+        if (script->object || script->worker) {
+            unloadScript(script);
+        }
+    }
+    foreach (ScriptWorker *worker, findChildren<ScriptWorker*>()) {
+        worker->waitForStopped();
+        delete worker;
+    }
+}
+
+/*! Runs the given \a function in the thread of the given \a context object and waits for it to finish.
+    Things may only be accessed from the core thread, so script items of isolated scripts use this for
+    everything involving things.
+
+    If interruption of the calling thread is requested while the function has not started yet, the call is
+    dropped and this returns right away. A script worker being stopped therefore never waits for the core
+    thread, which may be waiting for the worker.
+*/
+void ScriptEngine::invokeInThread(QObject *context, const std::function<void()> &function)
+{
+    if (context->thread() == QThread::currentThread()) {
+        function();
+        return;
+    }
+
+    // Outlives this call if it is dropped, the function itself is never called after that
+    enum CallState { CallStatePending, CallStateRunning, CallStateDropped };
+    struct Call {
+        QAtomicInt state = CallStatePending;
+        QSemaphore done;
+    };
+    QSharedPointer<Call> call(new Call());
+    QTimer::singleShot(0, context, [call, &function](){
+        if (call->state.testAndSetOrdered(CallStatePending, CallStateRunning)) {
+            function();
+        }
+        call->done.release();
+    });
+
+    while (!call->done.tryAcquire(1, 10)) {
+        if (QThread::currentThread()->isInterruptionRequested() && call->state.testAndSetOrdered(CallStatePending, CallStateDropped)) {
+            qCDebug(dcScriptEngine()) << "Dropping call into the core thread, the script is being stopped";
+            return;
+        }
+    }
+}
+
+ThingStateSnapshots *ScriptEngine::stateSnapshots() const
+{
+    return m_stateSnapshots;
+}
+
 QString ScriptEngine::baseName(const QUuid &id)
 {
     QString path = NymeaSettings::storagePath() + "/scripts/";
@@ -438,8 +731,61 @@ QString ScriptEngine::baseName(const QUuid &id)
     return path + basename;
 }
 
+/*! Returns the file name of the cached copy of the script with the given \a id, named after the script id
+    and the hash of its content. The QML engine caches compiled scripts by their URL, so compiled code is
+    reused across restarts as long as the content is unchanged and can never be stale after editing.
+    Cached copies of previous contents are removed. Returns an empty string if the script can't be read.
+*/
+QString ScriptEngine::cachedScriptFileName(const QUuid &id)
+{
+    QFile scriptFile(baseName(id) + ".qml");
+    if (!scriptFile.open(QFile::ReadOnly)) {
+        return QString();
+    }
+    QByteArray content = scriptFile.readAll();
+    scriptFile.close();
+
+    QString hash = QCryptographicHash::hash(content, QCryptographicHash::Sha1).toHex();
+    QString basename = id.toString().remove(QRegExp("[{}]"));
+    QString fileName = NymeaSettings::storagePath() + "/scripts/cache/" + basename + "." + hash + ".qml";
+    if (QFile::exists(fileName)) {
+        return fileName;
+    }
+
+    removeCachedScripts(id);
+    QFile cacheFile(fileName);
+    if (!cacheFile.open(QFile::WriteOnly | QFile::Truncate) || cacheFile.write(content) != content.length()) {
+        qCWarning(dcScriptEngine()) << "Error writing script cache" << fileName;
+        cacheFile.close();
+        QFile::remove(fileName);
+        return QString();
+    }
+    cacheFile.close();
+    return fileName;
+}
+
+void ScriptEngine::removeCachedScripts(const QUuid &id)
+{
+    QDir dir(NymeaSettings::storagePath() + "/scripts/cache/");
+    QString basename = id.toString().remove(QRegExp("[{}]"));
+    foreach (const QString &entry, dir.entryList({basename + ".*"}, QDir::Files)) {
+        dir.remove(entry);
+    }
+}
+
 void ScriptEngine::onScriptMessage(QtMsgType type, const QMessageLogContext &context, const QString &message)
 {
+    if (QThread::currentThread() != thread()) {
+        // Console messages of isolated scripts arrive in their worker thread
+        QString file = context.file;
+        int line = context.line;
+        QTimer::singleShot(0, this, [this, type, file, line, message](){
+            QByteArray fileName = file.toUtf8();
+            QMessageLogContext ctx(fileName.constData(), line, "", "ScriptEngine");
+            onScriptMessage(type, ctx, message);
+        });
+        return;
+    }
     QFileInfo fi(context.file);
     QUuid scriptId = fi.baseName();
     if (!m_scripts.contains(scriptId)) {
@@ -448,6 +794,26 @@ void ScriptEngine::onScriptMessage(QtMsgType type, const QMessageLogContext &con
     emit scriptConsoleMessage(scriptId, type == QtDebugMsg ? ScriptMessageTypeLog : ScriptMessageTypeWarning, QString::number(context.line) + ": " + message);
 }
 
+void ScriptEngine::onScriptWarning(const QString &file, int line, const QString &description, const QString &text)
+{
+    QByteArray fileName = file.toUtf8();
+    QMessageLogContext ctx(fileName.constData(), line, "", "ScriptEngine");
+    onScriptMessage(QtWarningMsg, ctx, description);
+    qCWarning(dcScriptEngine()) << text;
+}
+
+void ScriptEngine::onWatchdogTimeout()
+{
+    foreach (Script *script, m_scripts) {
+        if (!script->worker || script->worker->busyTime() < scriptWatchdogTimeout) {
+            continue;
+        }
+        qCWarning(dcScriptEngine()) << "Script" << script->name() << "has been busy for more than" << scriptWatchdogTimeout << "ms. Terminating it.";
+        emit scriptConsoleMessage(script->id(), ScriptMessageTypeWarning, QString("Script terminated after being busy for more than %1 ms").arg(scriptWatchdogTimeout));
+        unloadScript(script);
+    }
+}
+
 void ScriptEngine::logMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
 {
     if (strcmp(context.category, "qml") != 0) {
@@ -37,12 +37,20 @@
 #include <QJsonValue>
 #include <QLoggingCategory>
 #include <QMutex>
+#include <QTimer>
+
+#include <functional>
 
 #include "integrations/thingmanager.h"
 #include "script.h"
 
 namespace nymeaserver {
 
+class ScriptState;
+class ScriptEvent;
+class ScriptInterfaceEvent;
+class ThingStateSnapshots;
+
 class ScriptEngine : public QObject
 {
     Q_OBJECT
@@ -75,15 +83,26 @@ public:
         QByteArray content;
     };
 
-    explicit ScriptEngine(ThingManager *deviceManager, QObject *parent = nullptr);
+    explicit ScriptEngine(ThingManager *deviceManager, ThingStateSnapshots *stateSnapshots = nullptr, QObject *parent = nullptr);
     ~ScriptEngine();
 
     Scripts scripts();
     GetScriptReply scriptContent(const QUuid &id);
-    AddScriptReply addScript(const QString &name, const QByteArray &content);
+    AddScriptReply addScript(const QString &name, const QByteArray &content, bool isolated = false);
     ScriptError renameScript(const QUuid &id, const QString &name);
     EditScriptReply editScript(const QUuid &id, const QByteArray &content);
     ScriptError removeScript(const QUuid &id);
+    void unloadScripts();
+
+    static void invokeInThread(QObject *context, const std::function<void()> &function);
+    ThingStateSnapshots *stateSnapshots() const;
+
+    void subscribeState(ScriptState *state, const ThingId &thingId, const StateTypeId &stateTypeId);
+    void unsubscribeState(ScriptState *state);
+    void subscribeEvent(ScriptEvent *event, const ThingId &thingId);
+    void unsubscribeEvent(ScriptEvent *event);
+    void subscribeInterfaceEvent(ScriptInterfaceEvent *event, const QString &interfaceName);
+    void unsubscribeInterfaceEvent(ScriptInterfaceEvent *event);
 
 signals:
     void scriptAdded(const Script &script);
@@ -95,17 +114,40 @@ signals:
 
 private:
     void loadScripts();
-    bool loadScript(Script *script);
+    bool loadScript(Script *script, bool asynchronous = false);
+    bool createScriptObject(Script *script);
     void unloadScript(Script *script);
 
     QString baseName(const QUuid &id);
+    QString cachedScriptFileName(const QUuid &id);
+    void removeCachedScripts(const QUuid &id);
 
     void onScriptMessage(QtMsgType type, const QMessageLogContext &context, const QString &message);
+    void onScriptWarning(const QString &file, int line, const QString &description, const QString &text);
+    void onWatchdogTimeout();
+
+    void onThingStateChanged(Thing *thing, const StateTypeId &stateTypeId);
+    void onThingAdded(Thing *thing);
+    void onEventTriggered(const Event &event);
+
 private:
     ThingManager *m_deviceManager = nullptr;
+    ThingStateSnapshots *m_stateSnapshots = nullptr;
     QQmlEngine *m_engine = nullptr;
 
     QHash<QUuid, Script*> m_scripts;
+    QTimer *m_watchdog = nullptr;
+
+    // Script items by the thing notifications they are interested in, so each notification only reaches those.
+    // Isolated scripts subscribe from their own threads.
+    QMutex m_subscriptionMutex;
+    QHash<QPair<ThingId, StateTypeId>, QList<ScriptState*>> m_stateSubscribers;
+    QHash<ThingId, QList<ScriptState*>> m_stateThingSubscribers;
+    QHash<ScriptState*, QPair<ThingId, StateTypeId>> m_stateSubscriptions;
+    QHash<ThingId, QList<ScriptEvent*>> m_eventSubscribers;
+    QHash<ScriptEvent*, ThingId> m_eventSubscriptions;
+    QHash<QString, QList<ScriptInterfaceEvent*>> m_interfaceEventSubscribers;
+    QHash<ScriptInterfaceEvent*, QString> m_interfaceEventSubscriptions;
 
     static QList<ScriptEngine*> s_engines;
     static QtMessageHandler s_upstreamMessageHandler;
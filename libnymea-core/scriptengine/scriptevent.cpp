@@ -29,6 +29,7 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "scriptevent.h"
+#include "scriptengine.h"
 
 #include <qqml.h>
 #include <QQmlEngine>
@@ -40,10 +41,18 @@ ScriptEvent::ScriptEvent(QObject *parent) : QObject(parent)
 {
 }
 
+ScriptEvent::~ScriptEvent()
+{
+    if (m_scriptEngine) {
+        m_scriptEngine->unsubscribeEvent(this);
+    }
+}
+
 void ScriptEvent::classBegin()
 {
     m_thingManager = reinterpret_cast<ThingManager*>(qmlEngine(this)->property("thingManager").toULongLong());
-    connect(m_thingManager, &ThingManager::eventTriggered, this, &ScriptEvent::onEventTriggered);
+    m_scriptEngine = reinterpret_cast<ScriptEngine*>(qmlEngine(this)->property("scriptEngine").toULongLong());
+    m_scriptEngine->subscribeEvent(this, ThingId(m_thingId));
 }
 
 void ScriptEvent::componentComplete()
@@ -61,6 +70,9 @@ void ScriptEvent::setThingId(const QString &thingId)
     if (m_thingId != thingId) {
         m_thingId = thingId;
         emit thingIdChanged();
+        if (m_scriptEngine) {
+            m_scriptEngine->subscribeEvent(this, ThingId(m_thingId));
+        }
     }
 }
 
@@ -73,6 +85,7 @@ void ScriptEvent::setEventTypeId(const QString &eventTypeId)
 {
     if (m_eventTypeId != eventTypeId) {
         m_eventTypeId = eventTypeId;
+        m_parsedEventTypeId = EventTypeId(eventTypeId);
         emit eventTypeIdChanged();
     }
 }
@@ -92,24 +105,31 @@ void ScriptEvent::setEventName(const QString &eventName)
 
 void ScriptEvent::onEventTriggered(const Event &event)
 {
-    if (ThingId(m_thingId) != event.thingId()) {
-        return;
-    }
-
-    if (!m_eventTypeId.isEmpty() && event.eventTypeId() != m_eventTypeId) {
-        return;
-    }
-
-    Thing *thing = m_thingManager->findConfiguredThing(event.thingId());
-    if (!m_eventName.isEmpty() && thing->thingClass().eventTypes().findByName(m_eventName).id() != event.eventTypeId()) {
+    // The ScriptEngine only delivers events of our thing
+    if (!m_eventTypeId.isEmpty() && event.eventTypeId() != m_parsedEventTypeId) {
         return;
     }
 
+    bool matching = false;
     QVariantMap params;
-    foreach (const Param &param, event.params()) {
-        params.insert(param.paramTypeId().toString().remove(QRegExp("[{}]")), param.value().toByteArray());
-        QString paramName = thing->thingClass().eventTypes().findById(event.eventTypeId()).paramTypes().findById(param.paramTypeId()).name();
-        params.insert(paramName, param.value().toByteArray());
+    ScriptEngine::invokeInThread(m_thingManager, [this, &event, &matching, &params](){
+        Thing *thing = m_thingManager->findConfiguredThing(event.thingId());
+        if (!thing) {
+            return;
+        }
+        if (!m_eventName.isEmpty() && thing->thingClass().eventTypes().findByName(m_eventName).id() != event.eventTypeId()) {
+            return;
+        }
+
+        matching = true;
+        foreach (const Param &param, event.params()) {
+            params.insert(param.paramTypeId().toString().remove(QRegExp("[{}]")), param.value().toByteArray());
+            QString paramName = thing->thingClass().getEventType(event.eventTypeId()).paramTypes().findById(param.paramTypeId()).name();
+            params.insert(paramName, param.value().toByteArray());
+        }
+    });
+    if (!matching) {
+        return;
     }
 
     // Note: Explicitly convert the params to a Json document because auto-casting from QVariantMap to the JS engine might drop some values.
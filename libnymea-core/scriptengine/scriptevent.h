@@ -34,6 +34,7 @@
 #include <QObject>
 #include <QUuid>
 #include <QQmlParserStatus>
+#include <QPointer>
 
 #include "types/event.h"
 #include "integrations/thingmanager.h"
@@ -41,6 +42,7 @@
 namespace nymeaserver {
 
 class ScriptParams;
+class ScriptEngine;
 
 class ScriptEvent: public QObject, public QQmlParserStatus
 {
@@ -52,6 +54,7 @@ class ScriptEvent: public QObject, public QQmlParserStatus
     Q_PROPERTY(QString eventName READ eventName WRITE setEventName NOTIFY eventNameChanged)
 public:
     ScriptEvent(QObject *parent = nullptr);
+    ~ScriptEvent() override;
     void classBegin() override;
     void componentComplete() override;
 
@@ -64,9 +67,6 @@ public:
     QString eventName() const;
     void setEventName(const QString &eventName);
 
-private slots:
-    void onEventTriggered(const Event &event);
-
 signals:
     void thingIdChanged();
     void eventTypeIdChanged();
@@ -75,11 +75,16 @@ signals:
     void triggered(const QVariantMap &params);
 
 private:
+    friend class ScriptEngine;
+    void onEventTriggered(const Event &event);
+
     ThingManager *m_thingManager = nullptr;
+    QPointer<ScriptEngine> m_scriptEngine;
 
     QString m_thingId;
     QString m_eventTypeId;
     QString m_eventName;
+    EventTypeId m_parsedEventTypeId;
 };
 
 }
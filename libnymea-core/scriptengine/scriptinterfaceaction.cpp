@@ -29,6 +29,7 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "scriptinterfaceaction.h"
+#include "scriptengine.h"
 
 #include "integrations/thingmanager.h"
 #include "types/action.h"
@@ -83,44 +84,47 @@ void ScriptInterfaceAction::setActionName(const QString &actionName)
 
 void ScriptInterfaceAction::execute(const QVariantMap &params)
 {
-    Things things;
-    if (!m_interfaceName.isEmpty()) {
-        foreach (Thing *thing, m_thingManager->configuredThings()) {
-            if (thing->thingClass().interfaces().contains(m_interfaceName)) {
-                things.append(thing);
+    // Things may only be accessed in the core thread, which isn't ours for isolated scripts
+    ScriptEngine::invokeInThread(m_thingManager, [this, &params](){
+        Things things;
+        if (!m_interfaceName.isEmpty()) {
+            foreach (Thing *thing, m_thingManager->configuredThings()) {
+                if (thing->thingClass().interfaces().contains(m_interfaceName)) {
+                    things.append(thing);
+                }
             }
         }
-    }
-    if (things.isEmpty()) {
-        qCWarning(dcScriptEngine) << "No things matching by interface" << m_interfaceName;
-        return;
-    }
-
-    foreach (Thing *thing, things) {
-        ActionType actionType = thing->thingClass().actionTypes().findByName(m_actionName);
-        if (actionType.id().isNull()) {
-            qCWarning(dcScriptEngine()) << "Thing" << thing->name() << "does not have action" << m_actionName;
-            continue;
+        if (things.isEmpty()) {
+            qCWarning(dcScriptEngine) << "No things matching by interface" << m_interfaceName;
+            return;
         }
-        Action action(actionType.id(), thing->id(), Action::TriggeredByScript);
-        ParamList paramList;
-        foreach (const QString &paramNameOrId, params.keys()) {
-            ParamType paramType;
-            if (!ParamTypeId(paramNameOrId).isNull()) {
-                paramType = actionType.paramTypes().findById(ParamTypeId(paramNameOrId));
-            } else {
-                paramType = actionType.paramTypes().findByName(paramNameOrId);
-            }
-            if (paramType.id().isNull()) {
-                qCWarning(dcScriptEngine()) << "Invalid param id or name";
+
+        foreach (Thing *thing, things) {
+            ActionType actionType = thing->thingClass().actionTypes().findByName(m_actionName);
+            if (actionType.id().isNull()) {
+                qCWarning(dcScriptEngine()) << "Thing" << thing->name() << "does not have action" << m_actionName;
                 continue;
             }
-            paramList << Param(paramType.id(), params.value(paramNameOrId));
+            Action action(actionType.id(), thing->id(), Action::TriggeredByScript);
+            ParamList paramList;
+            foreach (const QString &paramNameOrId, params.keys()) {
+                ParamType paramType;
+                if (!ParamTypeId(paramNameOrId).isNull()) {
+                    paramType = actionType.paramTypes().findById(ParamTypeId(paramNameOrId));
+                } else {
+                    paramType = actionType.paramTypes().findByName(paramNameOrId);
+                }
+                if (paramType.id().isNull()) {
+                    qCWarning(dcScriptEngine()) << "Invalid param id or name";
+                    continue;
+                }
+                paramList << Param(paramType.id(), params.value(paramNameOrId));
+            }
+            action.setParams(paramList);
+            qCDebug(dcScriptEngine()) << "Executing action:" << action.thingId() << action.actionTypeId() << action.params();
+            m_thingManager->executeAction(action);
         }
-        action.setParams(paramList);
-        qCDebug(dcScriptEngine()) << "Executing action:" << action.thingId() << action.actionTypeId() << action.params();
-        m_thingManager->executeAction(action);
-    }
+    });
 }
 
 }
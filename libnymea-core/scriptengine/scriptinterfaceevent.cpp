@@ -29,6 +29,7 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "scriptinterfaceevent.h"
+#include "scriptengine.h"
 
 #include <qqml.h>
 #include <QQmlEngine>
@@ -40,10 +41,18 @@ ScriptInterfaceEvent::ScriptInterfaceEvent(QObject *parent) : QObject(parent)
 {
 }
 
+ScriptInterfaceEvent::~ScriptInterfaceEvent()
+{
+    if (m_scriptEngine) {
+        m_scriptEngine->unsubscribeInterfaceEvent(this);
+    }
+}
+
 void ScriptInterfaceEvent::classBegin()
 {
     m_thingManager = reinterpret_cast<ThingManager*>(qmlEngine(this)->property("thingManager").toULongLong());
-    connect(m_thingManager, &ThingManager::eventTriggered, this, &ScriptInterfaceEvent::onEventTriggered);
+    m_scriptEngine = reinterpret_cast<ScriptEngine*>(qmlEngine(this)->property("scriptEngine").toULongLong());
+    m_scriptEngine->subscribeInterfaceEvent(this, m_interfaceName);
 }
 
 void ScriptInterfaceEvent::componentComplete()
@@ -61,6 +70,9 @@ void ScriptInterfaceEvent::setInterfaceName(const QString &interfaceName)
     if (m_interfaceName != interfaceName) {
         m_interfaceName = interfaceName;
         emit interfaceNameChanged();
+        if (m_scriptEngine) {
+            m_scriptEngine->subscribeInterfaceEvent(this, m_interfaceName);
+        }
     }
 }
 
@@ -79,20 +91,27 @@ void ScriptInterfaceEvent::setEventName(const QString &eventName)
 
 void ScriptInterfaceEvent::onEventTriggered(const Event &event)
 {
-    Thing *thing = m_thingManager->findConfiguredThing(event.thingId());
-    if (!thing->thingClass().interfaces().contains(m_interfaceName)) {
-        return;
-    }
-
-    if (!m_eventName.isEmpty() && thing->thingClass().eventTypes().findByName(m_eventName).id() != event.eventTypeId()) {
-        return;
-    }
-
+    // The ScriptEngine only delivers events of things implementing our interface
+    bool matching = false;
     QVariantMap params;
-    foreach (const Param &param, event.params()) {
-        params.insert(param.paramTypeId().toString().remove(QRegExp("[{}]")), param.value().toByteArray());
-        QString paramName = thing->thingClass().eventTypes().findById(event.eventTypeId()).paramTypes().findById(param.paramTypeId()).name();
-        params.insert(paramName, param.value().toByteArray());
+    ScriptEngine::invokeInThread(m_thingManager, [this, &event, &matching, &params](){
+        Thing *thing = m_thingManager->findConfiguredThing(event.thingId());
+        if (!thing) {
+            return;
+        }
+        if (!m_eventName.isEmpty() && thing->thingClass().eventTypes().findByName(m_eventName).id() != event.eventTypeId()) {
+            return;
+        }
+
+        matching = true;
+        foreach (const Param &param, event.params()) {
+            params.insert(param.paramTypeId().toString().remove(QRegExp("[{}]")), param.value().toByteArray());
+            QString paramName = thing->thingClass().getEventType(event.eventTypeId()).paramTypes().findById(param.paramTypeId()).name();
+            params.insert(paramName, param.value().toByteArray());
+        }
+    });
+    if (!matching) {
+        return;
     }
 
     // Note: Explicitly convert the params to a Json document because auto-casting from QVariantMap to the JS engine might drop some values.
@@ -34,6 +34,7 @@
 #include <QObject>
 #include <QUuid>
 #include <QQmlParserStatus>
+#include <QPointer>
 
 #include "types/event.h"
 #include "integrations/thingmanager.h"
@@ -41,6 +42,7 @@
 namespace nymeaserver {
 
 class ScriptParams;
+class ScriptEngine;
 
 class ScriptInterfaceEvent: public QObject, public QQmlParserStatus
 {
@@ -50,6 +52,7 @@ class ScriptInterfaceEvent: public QObject, public QQmlParserStatus
     Q_PROPERTY(QString eventName READ eventName WRITE setEventName NOTIFY eventNameChanged)
 public:
     ScriptInterfaceEvent(QObject *parent = nullptr);
+    ~ScriptInterfaceEvent() override;
     void classBegin() override;
     void componentComplete() override;
 
@@ -59,9 +62,6 @@ public:
     QString eventName() const;
     void setEventName(const QString &eventName);
 
-private slots:
-    void onEventTriggered(const Event &event);
-
 signals:
     void interfaceNameChanged();
     void eventNameChanged();
@@ -69,7 +69,11 @@ signals:
     void triggered(const QString &thingId, const QVariantMap &params);
 
 private:
+    friend class ScriptEngine;
+    void onEventTriggered(const Event &event);
+
     ThingManager *m_thingManager = nullptr;
+    QPointer<ScriptEngine> m_scriptEngine;
 
     QString m_interfaceName;
     QString m_eventName;
@@ -29,12 +29,15 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "scriptstate.h"
+#include "scriptengine.h"
+#include "integrations/thingstatesnapshots.h"
 
 #include "loggingcategories.h"
 
 #include <QColor>
 #include <qqml.h>
 #include <QQmlEngine>
+#include <QThread>
 
 namespace nymeaserver {
 
@@ -43,17 +46,18 @@ ScriptState::ScriptState(QObject *parent) : QObject(parent)
 
 }
 
+ScriptState::~ScriptState()
+{
+    if (m_scriptEngine) {
+        m_scriptEngine->unsubscribeState(this);
+    }
+}
+
 void ScriptState::classBegin()
 {
     m_thingManager = reinterpret_cast<ThingManager*>(qmlEngine(this)->property("thingManager").toULongLong());
-    connect(m_thingManager, &ThingManager::thingStateChanged, this, &ScriptState::onThingStateChanged);
-
-    connect(m_thingManager, &ThingManager::thingAdded, this, [this](Thing *newThing){
-        if (newThing->id() == ThingId(m_thingId)) {
-            qCDebug(dcScriptEngine()) << "Thing" << newThing->name() << "appeared in system";
-            connectToThing();
-        }
-    });
+    m_scriptEngine = reinterpret_cast<ScriptEngine*>(qmlEngine(this)->property("scriptEngine").toULongLong());
+    updateSubscription();
 }
 
 void ScriptState::componentComplete()
@@ -70,7 +74,9 @@ void ScriptState::setThingId(const QString &thingId)
 {
     if (m_thingId != thingId) {
         m_thingId = thingId;
+        m_thingUuid = ThingId(thingId);
         emit thingIdChanged();
+        updateSubscription();
         store();
         if (!m_valueCache.isNull()) {
             setValue(m_valueCache);
@@ -89,7 +95,9 @@ void ScriptState::setStateTypeId(const QString &stateTypeId)
 {
     if (m_stateTypeId != stateTypeId) {
         m_stateTypeId = stateTypeId;
+        m_stateTypeUuid = StateTypeId(stateTypeId);
         emit stateTypeChanged();
+        updateSubscription();
         store();
         if (!m_valueCache.isNull()) {
             setValue(m_valueCache);
@@ -107,6 +115,7 @@ void ScriptState::setStateName(const QString &stateName)
     if (m_stateName != stateName) {
         m_stateName = stateName;
         emit stateTypeChanged();
+        updateSubscription();
         store();
         if (!m_valueCache.isNull()) {
             setValue(m_valueCache);
@@ -116,16 +125,29 @@ void ScriptState::setStateName(const QString &stateName)
 
 QVariant ScriptState::value() const
 {
-    Thing* thing = m_thingManager->findConfiguredThing(ThingId(m_thingId));
-    if (!thing) {
-        return QVariant();
-    }
-    StateTypeId stateTypeId = StateTypeId(m_stateTypeId);
-    if (stateTypeId.isNull()) {
-        stateTypeId = thing->thingClass().stateTypes().findByName(m_stateName).id();
+    // Isolated scripts read from the state snapshot instead of blocking on the core thread
+    if (m_scriptEngine && m_scriptEngine->stateSnapshots() && !m_stateTypeUuid.isNull() && m_thingManager->thread() != QThread::currentThread()) {
+        bool found = false;
+        QVariant value = m_scriptEngine->stateSnapshots()->current()->stateValue(m_thingUuid, m_stateTypeUuid, &found);
+        if (found) {
+            return value;
+        }
     }
 
-    return thing->stateValue(stateTypeId);
+    QVariant value;
+    ScriptEngine::invokeInThread(m_thingManager, [this, &value](){
+        Thing* thing = m_thingManager->findConfiguredThing(m_thingUuid);
+        if (!thing) {
+            return;
+        }
+        StateTypeId stateTypeId = m_stateTypeUuid;
+        if (stateTypeId.isNull()) {
+            stateTypeId = thing->thingClass().stateTypes().findByName(m_stateName).id();
+        }
+
+        value = thing->stateValue(stateTypeId);
+    });
+    return value;
 }
 
 void ScriptState::setValue(const QVariant &value)
@@ -135,78 +157,89 @@ void ScriptState::setValue(const QVariant &value)
         return;
     }
 
-    Thing* thing = m_thingManager->findConfiguredThing(ThingId(m_thingId));
-    if (!thing) {
-        m_valueCache = value;
-        qCDebug(dcScriptEngine()) << "No thing with id" << m_thingId << "found.";
-        return;
-    }
+    // Things may only be accessed in the core thread, which isn't ours for isolated scripts
+    ScriptEngine::invokeInThread(m_thingManager, [this, &value](){
+        Thing* thing = m_thingManager->findConfiguredThing(m_thingUuid);
+        if (!thing) {
+            m_valueCache = value;
+            qCDebug(dcScriptEngine()) << "No thing with id" << m_thingId << "found.";
+            return;
+        }
 
-    if (thing->setupStatus() != Thing::ThingSetupStatusComplete) {
-        m_valueCache = value;
-        qCDebug(dcScriptEngine()) << "Thing is not ready yet...";
-        return;
-    }
+        if (thing->setupStatus() != Thing::ThingSetupStatusComplete) {
+            m_valueCache = value;
+            qCDebug(dcScriptEngine()) << "Thing is not ready yet...";
+            return;
+        }
 
-    ActionTypeId actionTypeId;
-    if (!m_stateTypeId.isNull()) {
-        actionTypeId = thing->thingClass().stateTypes().findById(StateTypeId(m_stateTypeId)).id();
-        if (actionTypeId.isNull()) {
-            qCDebug(dcScriptEngine) << "Thing" << thing->name() << "does not have a state with type id" << m_stateTypeId;
+        ActionTypeId actionTypeId;
+        if (!m_stateTypeUuid.isNull()) {
+            actionTypeId = thing->thingClass().getStateType(m_stateTypeUuid).id();
+            if (actionTypeId.isNull()) {
+                qCDebug(dcScriptEngine) << "Thing" << thing->name() << "does not have a state with type id" << m_stateTypeId;
+            }
         }
-    }
-    if (actionTypeId.isNull()) {
-        actionTypeId = thing->thingClass().stateTypes().findByName(stateName()).id();
         if (actionTypeId.isNull()) {
-            qCDebug(dcScriptEngine) << "Thing" << thing->name() << "does not have a state named" << m_stateName;
+            actionTypeId = thing->thingClass().stateTypes().findByName(stateName()).id();
+            if (actionTypeId.isNull()) {
+                qCDebug(dcScriptEngine) << "Thing" << thing->name() << "does not have a state named" << m_stateName;
+            }
         }
-    }
 
-    if (actionTypeId.isNull()) {
-        m_valueCache = value;
-        qCDebug(dcScriptEngine()) << "Either stateTypeId or stateName is required to be valid.";
-        return;
-    }
+        if (actionTypeId.isNull()) {
+            m_valueCache = value;
+            qCDebug(dcScriptEngine()) << "Either stateTypeId or stateName is required to be valid.";
+            return;
+        }
 
-    Action action(ActionTypeId(actionTypeId), ThingId(m_thingId), Action::TriggeredByScript);
-    ParamList params = ParamList() << Param(ParamTypeId(actionTypeId), value);
-    action.setParams(params);
+        Action action(ActionTypeId(actionTypeId), m_thingUuid, Action::TriggeredByScript);
+        ParamList params = ParamList() << Param(ParamTypeId(actionTypeId), value);
+        action.setParams(params);
 
-    qCDebug(dcScriptEngine()) << "Executing action on" << thing->name();
-    m_valueCache = QVariant();
-    m_pendingActionInfo = m_thingManager->executeAction(action);
-    connect(m_pendingActionInfo, &ThingActionInfo::finished, this, [this](){
-        m_pendingActionInfo = nullptr;
-        if (!m_valueCache.isNull()) {
-            setValue(m_valueCache);
-        }
+        qCDebug(dcScriptEngine()) << "Executing action on" << thing->name();
+        m_valueCache = QVariant();
+        m_pendingActionInfo = m_thingManager->executeAction(action);
+        connect(m_pendingActionInfo, &ThingActionInfo::finished, this, [this](){
+            m_pendingActionInfo = nullptr;
+            if (!m_valueCache.isNull()) {
+                setValue(m_valueCache);
+            }
+        });
     });
 }
 
 QVariant ScriptState::minimumValue() const
 {
-    Thing *thing = m_thingManager->configuredThings().findById(ThingId(m_thingId));
-    if (!thing) {
-        return QVariant();
-    }
-    StateType stateType = thing->thingClass().stateTypes().findById(StateTypeId(m_stateTypeId));
-    if (stateType.id().isNull()) {
-        stateType = thing->thingClass().stateTypes().findByName(m_stateName);
-    }
-    return stateType.minValue();
+    QVariant value;
+    ScriptEngine::invokeInThread(m_thingManager, [this, &value](){
+        Thing *thing = m_thingManager->configuredThings().findById(m_thingUuid);
+        if (!thing) {
+            return;
+        }
+        StateType stateType = thing->thingClass().getStateType(m_stateTypeUuid);
+        if (stateType.id().isNull()) {
+            stateType = thing->thingClass().stateTypes().findByName(m_stateName);
+        }
+        value = stateType.minValue();
+    });
+    return value;
 }
 
 QVariant ScriptState::maximumValue() const
 {
-    Thing *thing = m_thingManager->configuredThings().findById(ThingId(m_thingId));
-    if (!thing) {
-        return QVariant();
-    }
-    StateType stateType = thing->thingClass().stateTypes().findById(StateTypeId(m_stateTypeId));
-    if (stateType.id().isNull()) {
-        stateType = thing->thingClass().stateTypes().findByName(m_stateName);
-    }
-    return stateType.minValue();
+    QVariant value;
+    ScriptEngine::invokeInThread(m_thingManager, [this, &value](){
+        Thing *thing = m_thingManager->configuredThings().findById(m_thingUuid);
+        if (!thing) {
+            return;
+        }
+        StateType stateType = thing->thingClass().getStateType(m_stateTypeUuid);
+        if (stateType.id().isNull()) {
+            stateType = thing->thingClass().stateTypes().findByName(m_stateName);
+        }
+        value = stateType.minValue();
+    });
+    return value;
 }
 
 void ScriptState::store()
@@ -219,46 +252,66 @@ void ScriptState::restore()
     setValue(m_valueStore);
 }
 
-void ScriptState::onThingStateChanged(Thing *thing, const StateTypeId &stateTypeId)
+void ScriptState::onThingStateChanged()
 {
-    if (thing->id() != ThingId(m_thingId)) {
-        return;
-    }
-    StateTypeId localStateTypeId = StateTypeId(m_stateTypeId);
-    if (localStateTypeId.isNull()) {
-        localStateTypeId = thing->thingClass().stateTypes().findByName(m_stateName).id();
-    }
-    if (localStateTypeId.isNull()) {
+    emit valueChanged();
+}
+
+void ScriptState::onThingAdded()
+{
+    qCDebug(dcScriptEngine()) << "Thing" << m_thingId << "appeared in system";
+    // A state given by name can only be resolved once the thing is known
+    updateSubscription();
+    connectToThing();
+}
+
+void ScriptState::updateSubscription()
+{
+    if (!m_scriptEngine) {
         return;
     }
-    if (stateTypeId == localStateTypeId) {
-        emit valueChanged();
+    ThingId thingId = m_thingUuid;
+    StateTypeId stateTypeId = m_stateTypeUuid;
+    if (stateTypeId.isNull()) {
+        ScriptEngine::invokeInThread(m_thingManager, [this, &thingId, &stateTypeId](){
+            Thing *thing = m_thingManager->findConfiguredThing(thingId);
+            if (thing) {
+                stateTypeId = thing->thingClass().stateTypes().findByName(m_stateName).id();
+            }
+        });
     }
+    m_scriptEngine->subscribeState(this, thingId, stateTypeId);
 }
 
 void ScriptState::connectToThing()
 {
-    Thing *thing = m_thingManager->findConfiguredThing(ThingId(m_thingId));
-    if (!thing) {
-        qCDebug(dcScriptEngine()) << "Can't find thing with id" << m_thingId << "(yet)";
-        return;
-    }
-
-    if (thing->setupStatus() == Thing::ThingSetupStatusComplete) {
-        if (!m_valueCache.isNull()) {
-            setValue(m_valueCache);
+    ScriptEngine::invokeInThread(m_thingManager, [this](){
+        Thing *thing = m_thingManager->findConfiguredThing(m_thingUuid);
+        if (!thing) {
+            qCDebug(dcScriptEngine()) << "Can't find thing with id" << m_thingId << "(yet)";
+            return;
         }
-    } else {
-        qCDebug(dcScriptEngine()) << "Thing setup for" << thing->name() << "not complete yet";
-    }
 
-    connect(thing, &Thing::setupStatusChanged, this, [this, thing](){
         if (thing->setupStatus() == Thing::ThingSetupStatusComplete) {
-            qCDebug(dcScriptEngine()) << "Thing setup for" << thing->name() << "completed";
             if (!m_valueCache.isNull()) {
                 setValue(m_valueCache);
             }
+        } else {
+            qCDebug(dcScriptEngine()) << "Thing setup for" << thing->name() << "not complete yet";
         }
+
+        connect(thing, &Thing::setupStatusChanged, this, [this, thing](){
+            bool complete = false;
+            ScriptEngine::invokeInThread(m_thingManager, [thing, &complete](){
+                complete = thing->setupStatus() == Thing::ThingSetupStatusComplete;
+            });
+            if (complete) {
+                qCDebug(dcScriptEngine()) << "Thing setup for" << m_thingId << "completed";
+                if (!m_valueCache.isNull()) {
+                    setValue(m_valueCache);
+                }
+            }
+        });
     });
 }
 
@@ -40,6 +40,8 @@
 
 namespace nymeaserver {
 
+class ScriptEngine;
+
 class ScriptState : public QObject, public QQmlParserStatus
 {
     Q_OBJECT
@@ -54,6 +56,7 @@ class ScriptState : public QObject, public QQmlParserStatus
 
 public:
     explicit ScriptState(QObject *parent = nullptr);
+    ~ScriptState() override;
     void classBegin() override;
     void componentComplete() override;
 
@@ -82,16 +85,23 @@ signals:
     void valueChanged();
 
 private slots:
-    void onThingStateChanged(Thing *thing, const StateTypeId &stateTypeId);
-
     void connectToThing();
 
 private:
+    friend class ScriptEngine;
+    void onThingStateChanged();
+    void onThingAdded();
+    void updateSubscription();
+
     ThingManager *m_thingManager = nullptr;
+    QPointer<ScriptEngine> m_scriptEngine;
 
     QString m_thingId;
     QString m_stateTypeId;
     QString m_stateName;
+    // Parsed once when set instead of on every access
+    ThingId m_thingUuid;
+    StateTypeId m_stateTypeUuid;
 
 
     ThingActionInfo *m_pendingActionInfo = nullptr;
@@ -0,0 +1,130 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "scriptstategroup.h"
+
+namespace nymeaserver {
+
+/*! \class nymeaserver::ScriptStateGroup
+    \brief Coalesces value changes of multiple ThingStates in scripts.
+
+    \ingroup core
+    \inmodule core
+
+    Instead of reacting to every single state change, the triggered signal is emitted once for a burst of
+    changes, carrying the list of states which changed. With an interval of 0, changes are collected until
+    the next event loop iteration, otherwise for at most the given interval in milliseconds.
+*/
+
+ScriptStateGroup::ScriptStateGroup(QObject *parent) : QObject(parent)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(0);
+    connect(&m_timer, &QTimer::timeout, this, &ScriptStateGroup::onTimeout);
+}
+
+QQmlListProperty<ScriptState> ScriptStateGroup::states()
+{
+    return QQmlListProperty<ScriptState>(this, nullptr, &appendState, &stateCount, &stateAt, &clearStates);
+}
+
+int ScriptStateGroup::interval() const
+{
+    return m_timer.interval();
+}
+
+void ScriptStateGroup::setInterval(int interval)
+{
+    if (m_timer.interval() != interval) {
+        m_timer.setInterval(qMax(0, interval));
+        emit intervalChanged();
+    }
+}
+
+void ScriptStateGroup::appendState(QQmlListProperty<ScriptState> *list, ScriptState *state)
+{
+    ScriptStateGroup *group = qobject_cast<ScriptStateGroup*>(list->object);
+    if (!state || group->m_states.contains(state)) {
+        return;
+    }
+    group->m_states.append(state);
+    connect(state, &ScriptState::valueChanged, group, &ScriptStateGroup::onStateValueChanged);
+    connect(state, &ScriptState::destroyed, group, [group, state](){
+        group->m_states.removeAll(state);
+        group->m_changedStates.removeAll(state);
+    });
+}
+
+int ScriptStateGroup::stateCount(QQmlListProperty<ScriptState> *list)
+{
+    return qobject_cast<ScriptStateGroup*>(list->object)->m_states.count();
+}
+
+ScriptState *ScriptStateGroup::stateAt(QQmlListProperty<ScriptState> *list, int index)
+{
+    return qobject_cast<ScriptStateGroup*>(list->object)->m_states.at(index);
+}
+
+void ScriptStateGroup::clearStates(QQmlListProperty<ScriptState> *list)
+{
+    ScriptStateGroup *group = qobject_cast<ScriptStateGroup*>(list->object);
+    foreach (ScriptState *state, group->m_states) {
+        disconnect(state, nullptr, group, nullptr);
+    }
+    group->m_states.clear();
+    group->m_changedStates.clear();
+}
+
+void ScriptStateGroup::onStateValueChanged()
+{
+    ScriptState *state = qobject_cast<ScriptState*>(sender());
+    if (!m_changedStates.contains(state)) {
+        m_changedStates.append(state);
+    }
+    // Not restarted on further changes so a steady stream of changes is still delivered every interval
+    if (!m_timer.isActive()) {
+        m_timer.start();
+    }
+}
+
+void ScriptStateGroup::onTimeout()
+{
+    if (m_changedStates.isEmpty()) {
+        return;
+    }
+    QVariantList changedStates;
+    foreach (ScriptState *state, m_changedStates) {
+        changedStates.append(QVariant::fromValue<QObject*>(state));
+    }
+    m_changedStates.clear();
+    emit triggered(changedStates);
+}
+
+}
@@ -0,0 +1,77 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SCRIPTSTATEGROUP_H
+#define SCRIPTSTATEGROUP_H
+
+#include <QObject>
+#include <QQmlListProperty>
+#include <QTimer>
+
+#include "scriptstate.h"
+
+namespace nymeaserver {
+
+class ScriptStateGroup : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QQmlListProperty<nymeaserver::ScriptState> states READ states)
+    Q_PROPERTY(int interval READ interval WRITE setInterval NOTIFY intervalChanged)
+    Q_CLASSINFO("DefaultProperty", "states")
+
+public:
+    explicit ScriptStateGroup(QObject *parent = nullptr);
+
+    QQmlListProperty<ScriptState> states();
+
+    int interval() const;
+    void setInterval(int interval);
+
+signals:
+    void intervalChanged();
+    void triggered(const QVariantList &changedStates);
+
+private:
+    static void appendState(QQmlListProperty<ScriptState> *list, ScriptState *state);
+    static int stateCount(QQmlListProperty<ScriptState> *list);
+    static ScriptState *stateAt(QQmlListProperty<ScriptState> *list, int index);
+    static void clearStates(QQmlListProperty<ScriptState> *list);
+
+    void onStateValueChanged();
+    void onTimeout();
+
+    QList<ScriptState*> m_states;
+    QList<ScriptState*> m_changedStates;
+    QTimer m_timer;
+};
+
+}
+
+#endif // SCRIPTSTATEGROUP_H
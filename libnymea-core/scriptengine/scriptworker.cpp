@@ -0,0 +1,192 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "scriptworker.h"
+
+#include "loggingcategories.h"
+
+#include <QTimer>
+#include <QAbstractEventDispatcher>
+
+#include <time.h>
+
+namespace nymeaserver {
+
+static quint64 threadCpuTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<quint64>(ts.tv_sec) * 1000000 + static_cast<quint64>(ts.tv_nsec) / 1000;
+}
+
+/*! \class nymeaserver::ScriptWorker
+    \brief Runs a single script in its own thread, with its own QQmlEngine.
+
+    \ingroup core
+    \inmodule core
+
+    Isolated scripts are executed by a ScriptWorker so heavy JavaScript doesn't delay the core. The script items
+    reach things through ScriptEngine::invokeInThread() and are notified by the ScriptEngine through queued calls.
+    The worker accounts the CPU time its thread spends processing events and tells how long it has been busy with
+    the current one, which is used by the ScriptEngine watchdog.
+*/
+
+ScriptWorker::ScriptWorker(ThingManager *thingManager, ScriptEngine *scriptEngine, QObject *parent) :
+    QObject(parent),
+    m_thingManager(thingManager),
+    m_scriptEngine(scriptEngine),
+    m_busySince(-1),
+    m_cpuTime(0)
+{
+    m_clock.start();
+
+    m_thread = new QThread(this);
+    m_threadContext = new QObject();
+    m_threadContext->moveToThread(m_thread);
+    connect(m_thread, &QThread::finished, m_threadContext, &QObject::deleteLater);
+    connect(m_thread, &QThread::finished, this, &QObject::deleteLater);
+    m_thread->start();
+
+    QTimer::singleShot(0, m_threadContext, [this](){
+        QQmlEngine *engine = new QQmlEngine();
+        engine->setProperty("thingManager", reinterpret_cast<quint64>(m_thingManager));
+        engine->setProperty("scriptEngine", reinterpret_cast<quint64>(m_scriptEngine));
+        engine->setOutputWarningsToStandardError(false);
+        connect(engine, &QQmlEngine::warnings, m_threadContext, [this](const QList<QQmlError> &warnings){
+            foreach (const QQmlError &warning, warnings) {
+                emit warningReceived(warning.url().toString(), warning.line(), warning.description(), warning.toString());
+            }
+        });
+        m_engine.storeRelease(engine);
+
+        QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance();
+        connect(dispatcher, &QAbstractEventDispatcher::awake, m_threadContext, [this](){ beginSlice(); });
+        connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, m_threadContext, [this](){ endSlice(); });
+    });
+}
+
+ScriptWorker::~ScriptWorker()
+{
+    if (!m_thread->isFinished()) {
+        stop();
+        waitForStopped();
+    }
+}
+
+/*! Instantiates the script at the given \a url in the worker thread. Errors are reported through warningReceived(). */
+void ScriptWorker::load(const QUrl &url)
+{
+    QTimer::singleShot(0, m_threadContext, [this, url](){
+        m_component = new QQmlComponent(m_engine.loadAcquire(), url);
+        m_context = new QQmlContext(m_engine.loadAcquire());
+        m_object = m_component->create(m_context);
+        if (!m_object) {
+            foreach (const QQmlError &error, m_component->errors()) {
+                emit warningReceived(error.url().toString(), error.line(), error.description(), error.toString());
+            }
+        }
+    });
+}
+
+/*! Interrupts the JavaScript currently running in the worker, tears down the script and ends the thread.
+    This doesn't block, the worker deletes itself once its thread has finished.
+*/
+void ScriptWorker::stop()
+{
+    // Calls into the core thread the script is waiting for are dropped
+    m_thread->requestInterruption();
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,14,0)
+    // The engine is used no more after this, setInterrupted() may be called from any thread
+    QQmlEngine *engine = m_engine.loadAcquire();
+    if (engine) {
+        engine->setInterrupted(true);
+    }
+#endif
+
+    QTimer::singleShot(0, m_threadContext, [this](){
+        delete m_object;
+        m_object = nullptr;
+        delete m_component;
+        m_component = nullptr;
+        delete m_context;
+        m_context = nullptr;
+        delete m_engine.fetchAndStoreOrdered(nullptr);
+        QThread::currentThread()->quit();
+    });
+}
+
+/*! Blocks until the worker thread has finished after stop(). stop() interrupts the JavaScript and the calls into
+    the core thread the script may be waiting for, so the thread normally ends right away.
+*/
+void ScriptWorker::waitForStopped()
+{
+    // We're waiting for the thread ourselves, don't get deleted while doing so
+    disconnect(m_thread, &QThread::finished, this, &QObject::deleteLater);
+
+    if (!m_thread->wait(5000)) {
+        qCWarning(dcScriptEngine()) << "Script thread did not stop within 5 seconds. Still waiting for it.";
+        m_thread->wait();
+        qCWarning(dcScriptEngine()) << "Script thread stopped after all.";
+    }
+}
+
+/*! Returns the CPU time in milliseconds the worker thread has spent processing events. */
+uint ScriptWorker::cpuTime() const
+{
+    return static_cast<uint>(m_cpuTime.load() / 1000);
+}
+
+/*! Returns for how many milliseconds the worker thread has been busy with the current event, or 0 if it is idle. */
+qint64 ScriptWorker::busyTime() const
+{
+    qint64 busySince = m_busySince.load();
+    if (busySince < 0) {
+        return 0;
+    }
+    return m_clock.elapsed() - busySince;
+}
+
+void ScriptWorker::beginSlice()
+{
+    m_sliceCpuStart = threadCpuTime();
+    m_busySince.store(m_clock.elapsed());
+}
+
+void ScriptWorker::endSlice()
+{
+    if (m_busySince.load() < 0) {
+        return;
+    }
+    m_cpuTime += threadCpuTime() - m_sliceCpuStart;
+    m_busySince.store(-1);
+}
+
+}
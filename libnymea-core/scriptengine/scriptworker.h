@@ -0,0 +1,93 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SCRIPTWORKER_H
+#define SCRIPTWORKER_H
+
+#include <QObject>
+#include <QUrl>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QAtomicPointer>
+#include <QQmlEngine>
+#include <QQmlContext>
+#include <QQmlComponent>
+
+#include <atomic>
+
+#include "integrations/thingmanager.h"
+
+namespace nymeaserver {
+
+class ScriptEngine;
+
+class ScriptWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ScriptWorker(ThingManager *thingManager, ScriptEngine *scriptEngine, QObject *parent = nullptr);
+    ~ScriptWorker() override;
+
+    void load(const QUrl &url);
+    void stop();
+    void waitForStopped();
+
+    uint cpuTime() const;
+    qint64 busyTime() const;
+
+signals:
+    void warningReceived(const QString &file, int line, const QString &description, const QString &text);
+
+private:
+    void beginSlice();
+    void endSlice();
+
+    ThingManager *m_thingManager = nullptr;
+    ScriptEngine *m_scriptEngine = nullptr;
+
+    QThread *m_thread = nullptr;
+    QObject *m_threadContext = nullptr;
+
+    // Created, used and destroyed in the worker thread only
+    QAtomicPointer<QQmlEngine> m_engine;
+    QQmlComponent *m_component = nullptr;
+    QQmlContext *m_context = nullptr;
+    QObject *m_object = nullptr;
+    quint64 m_sliceCpuStart = 0;
+
+    // Written by the worker thread, read by the watchdog in the core thread
+    QElapsedTimer m_clock;
+    std::atomic<qint64> m_busySince;
+    std::atomic<quint64> m_cpuTime;
+};
+
+}
+
+#endif // SCRIPTWORKER_H
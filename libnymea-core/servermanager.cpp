@@ -45,6 +45,7 @@
 #include "servermanager.h"
 #include "nymeacore.h"
 #include "certificategenerator.h"
+#include "startuptrace.h"
 #include "nymeasettings.h"
 #include "platform/platform.h"
 #include "platform/platformzeroconfcontroller.h"
@@ -57,15 +58,22 @@
 #include "servers/webserver.h"
 #include "servers/bluetoothserver.h"
 #include "servers/mqttbroker.h"
+#include "servers/timeoutwheel.h"
 
 #include "network/zeroconf/zeroconfservicepublisher.h"
 
 #include <QSslCertificate>
 #include <QSslConfiguration>
 #include <QSslKey>
+#include <QFileInfo>
+#include <QtConcurrent/QtConcurrentRun>
 
 namespace nymeaserver {
 
+static const int zeroConfUpdateDelay = 200;
+static const int zeroConfMinRetryInterval = 1000;
+static const int zeroConfMaxRetryInterval = 300000;
+
 ServerManager::ServerManager(Platform *platform, NymeaConfiguration *configuration, const QStringList &additionalInterfaces, QObject *parent) :
     QObject(parent),
     m_platform(platform),
@@ -79,8 +87,8 @@ ServerManager::ServerManager(Platform *platform, NymeaConfiguration *configurati
         QString configCertificateFileName = configuration->sslCertificate();
         QString configKeyFileName = configuration->sslCertificateKey();
 
-        QString fallbackCertificateFileName = NymeaSettings::storagePath() + "/certs/nymead-certificate.crt";
-        QString fallbackKeyFileName = NymeaSettings::storagePath() + "/certs/nymead-certificate.key";
+        QString fallbackCertificateFileName = ServerManager::fallbackCertificateFileName();
+        QString fallbackKeyFileName = ServerManager::fallbackKeyFileName();
 
         bool certsLoaded = false;
         if (!configKeyFileName.isEmpty() && !configCertificateFileName.isEmpty() && loadCertificate(configKeyFileName, configCertificateFileName)) {
@@ -91,7 +99,7 @@ ServerManager::ServerManager(Platform *platform, NymeaConfiguration *configurati
             qCDebug(dcServerManager()) << "Using fallback self-signed SSL certificate:" << fallbackCertificateFileName;
         } else {
             qCDebug(dcServerManager()) << "Generating self signed certificates...";
-            CertificateGenerator::generate(fallbackCertificateFileName, fallbackKeyFileName);
+            CertificateGenerator::generate(fallbackCertificateFileName, fallbackKeyFileName, fallbackKeyType());
             if (loadCertificate(fallbackKeyFileName, fallbackCertificateFileName)) {
                 qCWarning(dcServerManager()) << "Using newly created self-signed SSL certificate:" << fallbackCertificateFileName;
                 certsLoaded = true;
@@ -107,8 +115,17 @@ ServerManager::ServerManager(Platform *platform, NymeaConfiguration *configurati
         }
     }
 
+    m_zeroConfPublisher = m_platform->zeroConfController()->servicePublisher();
+    m_zeroConfTimer.setSingleShot(true);
+    m_zeroConfTimer.setInterval(zeroConfUpdateDelay);
+    connect(&m_zeroConfTimer, &QTimer::timeout, this, &ServerManager::publishZeroConfServices);
+
+    m_timeoutWheel = new TimeoutWheel(1000, 128);
+
     // Interfaces
-    m_jsonServer = new JsonRPCServerImplementation(m_sslConfiguration, this);
+    m_jsonServer = new JsonRPCServerImplementation(m_timeoutWheel, m_sslConfiguration, this);
+    m_jsonServer->setMaxInFlightCalls(configuration->jsonRpcMaxInFlightCalls());
+    m_jsonServer->setValidationSampleRate(configuration->jsonRpcValidationSampleRate());
 
     // Transports
     MockTcpServer *tcpServer = new MockTcpServer(this);
@@ -166,7 +183,7 @@ ServerManager::ServerManager(Platform *platform, NymeaConfiguration *configurati
     }
 
     foreach (const WebServerConfiguration &config, configuration->webServerConfigurations()) {
-        WebServer *webServer = new WebServer(config, m_sslConfiguration, this);
+        WebServer *webServer = new WebServer(config, m_sslConfiguration, m_timeoutWheel, this);
         m_webServers.insert(config.id, webServer);
         if (webServer->startServer()) {
             registerZeroConfService(config, "http", "_http._tcp");
@@ -174,6 +191,9 @@ ServerManager::ServerManager(Platform *platform, NymeaConfiguration *configurati
     }
 
     m_mqttBroker = new MqttBroker(this);
+    m_mqttBroker->setClientOutboundLimit(configuration->mqttClientOutboundLimit());
+    m_mqttBroker->setSlowClientPolicy(configuration->mqttSlowClientPolicy() == "disconnect" ? MqttBroker::SlowClientPolicyDisconnect : MqttBroker::SlowClientPolicyDrop);
+    m_mqttBroker->setMaxPendingPublishes(configuration->mqttMaxPendingMessages());
     foreach (const ServerConfiguration &config, configuration->mqttServerConfigurations()) {
         if (m_mqttBroker->startServer(config)) {
             registerZeroConfService(config, "mqtt", "_mqtt._tcp");
@@ -193,6 +213,16 @@ ServerManager::ServerManager(Platform *platform, NymeaConfiguration *configurati
     connect(configuration, &NymeaConfiguration::mqttPolicyRemoved, this, &ServerManager::mqttPolicyRemoved);
 }
 
+ServerManager::~ServerManager()
+{
+    // The servers use the timeout wheel until they are gone
+    qDeleteAll(m_webServers);
+    qDeleteAll(m_webSocketServers);
+    qDeleteAll(m_tcpServers);
+    delete m_jsonServer;
+    delete m_timeoutWheel;
+}
+
 /*! Returns the pointer to the created \l{JsonRPCServer} in this \l{ServerManager}. */
 JsonRPCServerImplementation *ServerManager::jsonServer() const
 {
@@ -216,6 +246,13 @@ MqttBroker *ServerManager::mqttBroker() const
     return m_mqttBroker;
 }
 
+/*! Returns the TLS configuration with the certificate of the nymead servers. The configuration has
+    no certificate if TLS is not available. */
+QSslConfiguration ServerManager::sslConfiguration() const
+{
+    return m_sslConfiguration;
+}
+
 void ServerManager::tcpServerConfigurationChanged(const QString &id)
 {
     ServerConfiguration config = NymeaCore::instance()->configuration()->tcpServerConfigurations().value(id);
@@ -293,7 +330,7 @@ void ServerManager::webServerConfigurationChanged(const QString &id)
         server->setConfiguration(config);
     } else {
         qDebug(dcServerManager()) << "Received a Web Server config change event but don't have a Web Server instance for it. Creating new WebServer instance on" << config.address.toString() << config.port << "(SSL:" << config.sslEnabled << ")";
-        server = new WebServer(config, m_sslConfiguration, this);
+        server = new WebServer(config, m_sslConfiguration, m_timeoutWheel, this);
         m_webServers.insert(config.id, server);
     }
     if (server->startServer()) {
@@ -341,27 +378,113 @@ void ServerManager::mqttPolicyRemoved(const QString &clientId)
     m_mqttBroker->removePolicy(clientId);
 }
 
-bool ServerManager::registerZeroConfService(const ServerConfiguration &configuration, const QString &serverType, const QString &serviceType)
+void ServerManager::registerZeroConfService(const ServerConfiguration &configuration, const QString &serverType, const QString &serviceType)
 {
+    ZeroConfService service;
+    service.address = configuration.address;
+    service.port = static_cast<quint16>(configuration.port);
+    service.serviceType = serviceType;
     // Note: reversed order
-    QHash<QString, QString> txt;
-    txt.insert("jsonrpcVersion", JSON_PROTOCOL_VERSION);
-    txt.insert("serverVersion", NYMEA_VERSION_STRING);
-    txt.insert("manufacturer", "nymea GmbH");
-    txt.insert("uuid", NymeaCore::instance()->configuration()->serverUuid().toString());
-    txt.insert("name", NymeaCore::instance()->configuration()->serverName());
-    txt.insert("sslEnabled", configuration.sslEnabled ? "true" : "false");
-    QString name = "nymea-" + serverType + "-" + configuration.id;
-    if (!m_platform->zeroConfController()->servicePublisher()->registerService(name, configuration.address, static_cast<quint16>(configuration.port), serviceType, txt)) {
-        qCWarning(dcServerManager()) << "Could not register ZeroConf service for" << configuration;
-        return false;
-    }
-    return true;
+    service.txt.insert("jsonrpcVersion", JSON_PROTOCOL_VERSION);
+    service.txt.insert("serverVersion", NYMEA_VERSION_STRING);
+    service.txt.insert("manufacturer", "nymea GmbH");
+    service.txt.insert("uuid", NymeaCore::instance()->configuration()->serverUuid().toString());
+    service.txt.insert("name", NymeaCore::instance()->configuration()->serverName());
+    service.txt.insert("sslEnabled", configuration.sslEnabled ? "true" : "false");
+    m_zeroConfServices.insert("nymea-" + serverType + "-" + configuration.id, service);
+    m_zeroConfTimer.start(zeroConfUpdateDelay);
 }
 
 void ServerManager::unregisterZeroConfService(const QString &configId, const QString &serverType)
 {
-    m_platform->zeroConfController()->servicePublisher()->unregisterService("nymea-" + serverType + "-" + configId);
+    m_zeroConfServices.remove("nymea-" + serverType + "-" + configId);
+    m_zeroConfTimer.start(zeroConfUpdateDelay);
+}
+
+void ServerManager::publishZeroConfServices()
+{
+    foreach (const QString &name, m_publishedZeroConfServices.keys()) {
+        if (m_zeroConfServices.value(name) != m_publishedZeroConfServices.value(name)) {
+            m_zeroConfPublisher->unregisterService(name);
+            m_publishedZeroConfServices.remove(name);
+        }
+    }
+
+    bool failed = false;
+    foreach (const QString &name, m_zeroConfServices.keys()) {
+        if (m_publishedZeroConfServices.contains(name)) {
+            continue;
+        }
+        const ZeroConfService &service = m_zeroConfServices[name];
+        qint64 start = StartupTrace::now();
+        bool registered = m_zeroConfPublisher->registerService(name, service.address, service.port, service.serviceType, service.txt);
+        StartupTrace::record("zeroconf", name, start);
+        if (!registered) {
+            // Only warn once, not on every retry
+            if (m_zeroConfRetryInterval == 0) {
+                qCWarning(dcServerManager()) << "Could not register ZeroConf service" << name << service.address << service.port;
+            }
+            failed = true;
+            continue;
+        }
+        m_publishedZeroConfServices.insert(name, service);
+    }
+
+    // The publisher may not be ready yet (e.g. the avahi daemon restarting), try again later
+    if (failed) {
+        m_zeroConfRetryInterval = qBound(zeroConfMinRetryInterval, m_zeroConfRetryInterval * 2, zeroConfMaxRetryInterval);
+        qCDebug(dcServerManager()) << "Retrying to register ZeroConf services in" << m_zeroConfRetryInterval << "ms";
+        m_zeroConfTimer.start(m_zeroConfRetryInterval);
+    } else {
+        m_zeroConfRetryInterval = 0;
+    }
+}
+
+/*! Starts generating the self signed fallback certificate in a background thread if neither the
+    configured nor the fallback certificate exist yet. Generating the RSA key takes several seconds on
+    small devices, this way it runs while the other subsystems are being set up. The returned future is
+    to be waited for before constructing the ServerManager.
+*/
+QFuture<void> ServerManager::generateMissingCertificate(NymeaConfiguration *configuration)
+{
+    if (!QSslSocket::supportsSsl()) {
+        return QFuture<void>();
+    }
+    if (QFileInfo::exists(configuration->sslCertificate()) && QFileInfo::exists(configuration->sslCertificateKey())) {
+        return QFuture<void>();
+    }
+    QString certificateFileName = fallbackCertificateFileName();
+    QString keyFileName = fallbackKeyFileName();
+    if (QFileInfo::exists(certificateFileName) && QFileInfo::exists(keyFileName)) {
+        return QFuture<void>();
+    }
+    CertificateGenerator::KeyType keyType = fallbackKeyType();
+    qCDebug(dcServerManager()) << "Generating self signed certificates in the background...";
+    return QtConcurrent::run([certificateFileName, keyFileName, keyType](){
+        CertificateGenerator::generate(certificateFileName, keyFileName, keyType);
+    });
+}
+
+/*! Returns the key type for generating the fallback certificate. NYMEA_CERTIFICATE_KEY_TYPE=ec selects an
+    EC P-256 key, which is generated in milliseconds instead of seconds, RSA is used otherwise for the
+    widest client compatibility.
+*/
+CertificateGenerator::KeyType ServerManager::fallbackKeyType()
+{
+    if (qgetenv("NYMEA_CERTIFICATE_KEY_TYPE").toLower() == "ec") {
+        return CertificateGenerator::KeyTypeEc;
+    }
+    return CertificateGenerator::KeyTypeRsa;
+}
+
+QString ServerManager::fallbackCertificateFileName()
+{
+    return NymeaSettings::storagePath() + "/certs/nymead-certificate.crt";
+}
+
+QString ServerManager::fallbackKeyFileName()
+{
+    return NymeaSettings::storagePath() + "/certs/nymead-certificate.key";
 }
 
 bool ServerManager::loadCertificate(const QString &certificateKeyFileName, const QString &certificateFileName)
@@ -377,7 +500,11 @@ bool ServerManager::loadCertificate(const QString &certificateKeyFileName, const
         return false;
     }
 
-    m_certificateKey = QSslKey(certificateKeyFile.readAll(), QSsl::Rsa);
+    QByteArray keyData = certificateKeyFile.readAll();
+    m_certificateKey = QSslKey(keyData, QSsl::Rsa);
+    if (m_certificateKey.isNull()) {
+        m_certificateKey = QSslKey(keyData, QSsl::Ec);
+    }
     qCDebug(dcServerManager()) << "Loaded private certificate key " << certificateKeyFileName;
     certificateKeyFile.close();
 
@@ -399,6 +526,19 @@ bool ServerManager::loadCertificate(const QString &certificateKeyFileName, const
     return true;
 }
 
+/*! Publishes the ZeroConf services with the given \a publisher instead of the one of the platform. The services
+    registered so far are moved over to it. */
+void ServerManager::setZeroConfServicePublisher(ZeroConfServicePublisher *publisher)
+{
+    foreach (const QString &name, m_publishedZeroConfServices.keys()) {
+        m_zeroConfPublisher->unregisterService(name);
+    }
+    m_publishedZeroConfServices.clear();
+    m_zeroConfPublisher = publisher;
+    m_zeroConfRetryInterval = 0;
+    m_zeroConfTimer.start(zeroConfUpdateDelay);
+}
+
 /*! Set the server name for all servers to the given \a serverName. */
 void ServerManager::setServerName(const QString &serverName)
 {
@@ -35,10 +35,15 @@
 
 #include "loggingcategories.h"
 #include "nymeaconfiguration.h"
+#include "certificategenerator.h"
 
 #include <QSslConfiguration>
 #include <QSslKey>
+#include <QFuture>
+#include <QTimer>
+#include <QHostAddress>
 
+class ZeroConfServicePublisher;
 
 namespace nymeaserver {
 
@@ -50,6 +55,7 @@ class WebSocketServer;
 class WebServer;
 class BluetoothServer;
 class MqttBroker;
+class TimeoutWheel;
 
 class MockTcpServer;
 
@@ -58,6 +64,9 @@ class ServerManager : public QObject
     Q_OBJECT
 public:
     explicit ServerManager(Platform *platform, NymeaConfiguration *configuration, const QStringList &additionalInterfaces = QStringList(), QObject *parent = nullptr);
+    ~ServerManager() override;
+
+    static QFuture<void> generateMissingCertificate(NymeaConfiguration *configuration);
 
     // Interfaces
     JsonRPCServerImplementation *jsonServer() const;
@@ -68,6 +77,10 @@ public:
 
     MqttBroker *mqttBroker() const;
 
+    QSslConfiguration sslConfiguration() const;
+
+    void setZeroConfServicePublisher(ZeroConfServicePublisher *publisher);
+
 private slots:
     void tcpServerConfigurationChanged(const QString &id);
     void tcpServerConfigurationRemoved(const QString &id);
@@ -80,13 +93,31 @@ private slots:
     void mqttPolicyChanged(const QString &clientId);
     void mqttPolicyRemoved(const QString &clientId);
 
+    void publishZeroConfServices();
+
 private:
-    bool registerZeroConfService(const ServerConfiguration &configuration, const QString &serverType, const QString &serviceType);
+    // Only update the desired set of services, the publisher is updated by publishZeroConfServices()
+    void registerZeroConfService(const ServerConfiguration &configuration, const QString &serverType, const QString &serviceType);
     void unregisterZeroConfService(const QString &configId, const QString &serverType);
 
+    class ZeroConfService {
+    public:
+        QHostAddress address;
+        quint16 port = 0;
+        QString serviceType;
+        QHash<QString, QString> txt;
+        bool operator==(const ZeroConfService &other) const {
+            return address == other.address && port == other.port && serviceType == other.serviceType && txt == other.txt;
+        }
+        bool operator!=(const ZeroConfService &other) const { return !(*this == other); }
+    };
+
 private:
     Platform *m_platform = nullptr;
 
+    // Idle timeouts of all connections
+    TimeoutWheel *m_timeoutWheel = nullptr;
+
     // Interfaces
     JsonRPCServerImplementation *m_jsonServer;
 
@@ -98,12 +129,23 @@ private:
 
     MqttBroker *m_mqttBroker;
 
+    // ZeroConf services by name. Changes within a short window are applied at once.
+    QHash<QString, ZeroConfService> m_zeroConfServices;
+    QHash<QString, ZeroConfService> m_publishedZeroConfServices;
+    QTimer m_zeroConfTimer;
+    // Failed registrations are retried with a growing interval, 0 while all are registered
+    int m_zeroConfRetryInterval = 0;
+    ZeroConfServicePublisher *m_zeroConfPublisher = nullptr;
+
     // Encrytption and stuff
     QSslConfiguration m_sslConfiguration;
     QSslKey m_certificateKey;
     QSslCertificate m_certificate;
 
     bool loadCertificate(const QString &certificateKeyFileName, const QString &certificateFileName);
+    static QString fallbackCertificateFileName();
+    static QString fallbackKeyFileName();
+    static CertificateGenerator::KeyType fallbackKeyType();
 
 public slots:
     void setServerName(const QString &serverName);
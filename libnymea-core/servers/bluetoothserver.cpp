@@ -76,20 +76,74 @@ bool BluetoothServer::hardwareAvailable()
 /*! Send \a data to the client with the given \a clientId.*/
 void BluetoothServer::sendData(const QUuid &clientId, const QByteArray &data)
 {
-    QBluetoothSocket *client = 0;
-    client = m_clientList.value(clientId);
-    if (!client)
-        return;
-
     qCDebug(dcBluetoothServerTraffic()) << "Send data:" << qUtf8Printable(data);
-    client->write(data + '\n');
+    queueData(clientId, data + '\n');
 }
 
 /*! Send the given \a data to the \a clients. */
 void BluetoothServer::sendData(const QList<QUuid> &clients, const QByteArray &data)
 {
-    foreach (const QUuid &client, clients)
-        sendData(client, data);
+    QByteArray message = data + '\n';
+    foreach (const QUuid &clientId, clients) {
+        queueData(clientId, message);
+    }
+}
+
+/*! Returns true. Clients can negotiate CBOR and compression in JSONRPC.Hello, which matters a lot on RFCOMM links. */
+bool BluetoothServer::supportsBinaryData() const
+{
+    return true;
+}
+
+/*! Send the binary \a data to the client with the given \a clientId.*/
+void BluetoothServer::sendBinaryData(const QUuid &clientId, const QByteArray &data)
+{
+    qCDebug(dcBluetoothServerTraffic()) << "Send binary data:" << data.size() << "bytes";
+    queueData(clientId, data);
+}
+
+/*! Send the binary \a data to the \a clients.*/
+void BluetoothServer::sendBinaryData(const QList<QUuid> &clients, const QByteArray &data)
+{
+    foreach (const QUuid &clientId, clients) {
+        queueData(clientId, data);
+    }
+}
+
+/*! Returns the number of bytes queued for the client with the given \a clientId but not yet written.
+    Lagging clients get their state changes coalesced by the JSON-RPC server.
+*/
+qint64 BluetoothServer::pendingBytes(const QUuid &clientId) const
+{
+    QBluetoothSocket *client = m_clientList.value(clientId);
+    if (!client) {
+        return 0;
+    }
+    return m_outgoingData.value(clientId).size() + client->bytesToWrite();
+}
+
+void BluetoothServer::queueData(const QUuid &clientId, const QByteArray &data)
+{
+    if (!m_clientList.contains(clientId)) {
+        return;
+    }
+    m_outgoingData[clientId].append(data);
+    writeNextChunk(clientId);
+}
+
+void BluetoothServer::writeNextChunk(const QUuid &clientId)
+{
+    // Close to the default RFCOMM MTU. Feeding the socket frame by frame keeps large
+    // replies from piling up in its buffer ahead of small ones, e.g. during the setup.
+    static const int chunkSize = 990;
+
+    QBluetoothSocket *client = m_clientList.value(clientId);
+    QByteArray &buffer = m_outgoingData[clientId];
+    if (!client || buffer.isEmpty() || client->bytesToWrite() > 0) {
+        return;
+    }
+    client->write(buffer.constData(), qMin(chunkSize, buffer.size()));
+    buffer.remove(0, qMin(chunkSize, buffer.size()));
 }
 
 void BluetoothServer::terminateClientConnection(const QUuid &clientId)
@@ -123,6 +177,7 @@ void BluetoothServer::onClientConnected()
     m_clientList.insert(clientId, client);
 
     connect(client, SIGNAL(readyRead()), this, SLOT(readData()));
+    connect(client, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten()));
     connect(client, SIGNAL(disconnected()), this, SLOT(onClientDisconnected()));
     connect(client, SIGNAL(stateChanged(QBluetoothSocket::SocketState)), this, SLOT(onClientStateChanged(QBluetoothSocket::SocketState)));
     connect(client, SIGNAL(error(QBluetoothSocket::SocketError)), this, SLOT(onClientError(QBluetoothSocket::SocketError)));
@@ -139,6 +194,7 @@ void BluetoothServer::onClientDisconnected()
     qCDebug(dcBluetoothServer()) << "Client disconnected:" << client->peerName() << client->peerAddress().toString();
     QUuid clientId = m_clientList.key(client);
     m_clientList.take(clientId)->deleteLater();
+    m_outgoingData.remove(clientId);
     emit clientDisconnected(clientId);
 }
 
@@ -152,6 +208,15 @@ void BluetoothServer::onClientStateChanged(QBluetoothSocket::SocketState state)
     qCDebug(dcBluetoothServer()) << "Client socket state changed:" << state;
 }
 
+void BluetoothServer::onBytesWritten()
+{
+    QBluetoothSocket *client = qobject_cast<QBluetoothSocket *>(sender());
+    if (!client)
+        return;
+
+    writeNextChunk(m_clientList.key(client));
+}
+
 void BluetoothServer::readData()
 {
     QBluetoothSocket *client = qobject_cast<QBluetoothSocket *>(sender());
@@ -52,15 +52,26 @@ public:
     void sendData(const QUuid &clientId, const QByteArray &data) override;
     void sendData(const QList<QUuid> &clients, const QByteArray &data) override;
 
+    bool supportsBinaryData() const override;
+    void sendBinaryData(const QUuid &clientId, const QByteArray &data) override;
+    void sendBinaryData(const QList<QUuid> &clients, const QByteArray &data) override;
+
+    qint64 pendingBytes(const QUuid &clientId) const override;
+
     void terminateClientConnection(const QUuid &clientId) override;
 
 private:
+    void queueData(const QUuid &clientId, const QByteArray &data);
+    void writeNextChunk(const QUuid &clientId);
+
     QBluetoothServer *m_server = nullptr;
     QBluetoothLocalDevice *m_localDevice = nullptr;
     QBluetoothServiceInfo m_serviceInfo;
 
     // Client storage
     QHash<QUuid, QBluetoothSocket *> m_clientList;
+    // Data not yet handed to the socket, written one RFCOMM frame sized chunk at a time
+    QHash<QUuid, QByteArray> m_outgoingData;
 
 private slots:
     void onHostModeChanged(const QBluetoothLocalDevice::HostMode &mode);
@@ -69,6 +80,7 @@ private slots:
     void onClientDisconnected();
     void onClientError(QBluetoothSocket::SocketError error);
     void onClientStateChanged(QBluetoothSocket::SocketState state);
+    void onBytesWritten();
     void readData();
 
 public slots:
@@ -0,0 +1,138 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::HttpEventStream
+    \brief This class provides the body of a Server-Sent Events reply of the \l{WebServer}.
+
+    \ingroup server
+    \inmodule core
+
+    The stream is a sequential device which never ends. The \l{WebServer} sends it as chunked reply
+    body and reads from it whenever the socket is able to take more data. Events are serialized once
+    by the \l{WebServer} and posted to every stream accepting them.
+
+    If the client does not keep up, the data waiting in the stream grows. Once it exceeds the buffer
+    limit, new events are held back and only the latest event for each thing and state is kept. They
+    are appended again as soon as the client has received half of the buffered data.
+
+    \sa WebServer
+*/
+
+#include "httpeventstream.h"
+
+namespace nymeaserver {
+
+static const int maxBufferedBytes = 256 * 1024;
+
+/*! Constructs a new event stream accepting events for the given \a thingIds and \a stateTypeIds with the given \a parent.
+    Empty sets accept all things and state types respectively.
+*/
+HttpEventStream::HttpEventStream(const QSet<QUuid> &thingIds, const QSet<QUuid> &stateTypeIds, QObject *parent):
+    QIODevice(parent),
+    m_thingIds(thingIds),
+    m_stateTypeIds(stateTypeIds)
+{
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+
+    // Tell the client how long to wait before reconnecting
+    m_buffer = "retry: 3000\n\n";
+}
+
+bool HttpEventStream::isSequential() const
+{
+    return true;
+}
+
+/*! The stream ends only when it gets closed. */
+bool HttpEventStream::atEnd() const
+{
+    return !isOpen();
+}
+
+qint64 HttpEventStream::bytesAvailable() const
+{
+    return m_buffer.size() + QIODevice::bytesAvailable();
+}
+
+/*! Returns true if events for the given \a thingId and \a stateTypeId should be sent on this stream. */
+bool HttpEventStream::accepts(const QUuid &thingId, const QUuid &stateTypeId) const
+{
+    return (m_thingIds.isEmpty() || m_thingIds.contains(thingId)) && (m_stateTypeIds.isEmpty() || m_stateTypeIds.contains(stateTypeId));
+}
+
+/*! Appends the serialized \a event to the stream. Events with the same \a coalesceKey replace each other while the client lags behind. */
+void HttpEventStream::postEvent(const QByteArray &event, const QString &coalesceKey)
+{
+    if (m_buffer.size() < maxBufferedBytes && m_coalescedOrder.isEmpty()) {
+        m_buffer.append(event);
+        emit readyRead();
+        return;
+    }
+
+    if (!m_coalescedEvents.contains(coalesceKey)) {
+        m_coalescedOrder.append(coalesceKey);
+    }
+    m_coalescedEvents.insert(coalesceKey, event);
+}
+
+/*! Sends a comment line if the stream is idle, keeping the connection and any proxies in between alive. */
+void HttpEventStream::sendKeepAlive()
+{
+    if (m_buffer.isEmpty()) {
+        m_buffer.append(": keepalive\n\n");
+        emit readyRead();
+    }
+}
+
+qint64 HttpEventStream::readData(char *data, qint64 maxSize)
+{
+    if (m_buffer.size() < maxBufferedBytes / 2 && !m_coalescedOrder.isEmpty()) {
+        foreach (const QString &key, m_coalescedOrder) {
+            m_buffer.append(m_coalescedEvents.value(key));
+        }
+        m_coalescedOrder.clear();
+        m_coalescedEvents.clear();
+    }
+
+    qint64 size = qMin(maxSize, static_cast<qint64>(m_buffer.size()));
+    memcpy(data, m_buffer.constData(), static_cast<size_t>(size));
+    m_buffer.remove(0, static_cast<int>(size));
+    return size;
+}
+
+qint64 HttpEventStream::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data)
+    Q_UNUSED(maxSize)
+    return -1;
+}
+
+}
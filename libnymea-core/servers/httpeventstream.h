@@ -0,0 +1,73 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HTTPEVENTSTREAM_H
+#define HTTPEVENTSTREAM_H
+
+#include <QIODevice>
+#include <QUuid>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+
+namespace nymeaserver {
+
+class HttpEventStream: public QIODevice
+{
+    Q_OBJECT
+public:
+    explicit HttpEventStream(const QSet<QUuid> &thingIds, const QSet<QUuid> &stateTypeIds, QObject *parent = nullptr);
+
+    bool isSequential() const override;
+    bool atEnd() const override;
+    qint64 bytesAvailable() const override;
+
+    bool accepts(const QUuid &thingId, const QUuid &stateTypeId) const;
+    void postEvent(const QByteArray &event, const QString &coalesceKey);
+    void sendKeepAlive();
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    QSet<QUuid> m_thingIds;
+    QSet<QUuid> m_stateTypeIds;
+
+    QByteArray m_buffer;
+
+    // Events held back while the client is not keeping up, the latest event per key wins
+    QStringList m_coalescedOrder;
+    QHash<QString, QByteArray> m_coalescedEvents;
+};
+
+}
+
+#endif // HTTPEVENTSTREAM_H
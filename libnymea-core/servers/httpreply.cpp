@@ -55,12 +55,18 @@
         The resource was accepted.
     \value NoContent
         The request has no content but it was expected.
+    \value PartialContent
+        The reply contains only the part of the resource selected by the Range header of the request.
     \value Found
         The resource was found.
+    \value NotModified
+        The resource has not been modified since the version identified by the request's If-None-Match header.
     \value PermanentRedirect
         The resource redirects permanent to given url.
     \value BadRequest
         The request was bad formatted. Also if a \l{Param} was not understood or the header is not correct.
+    \value Unauthorized
+        The request lacks valid authentication credentials for the resource.
     \value Forbidden
         The request tries to get access to a forbidden space.
     \value NotFound
@@ -71,6 +77,8 @@
         The request method timed out. Default timeout = 5s.
     \value Conflict
         The request resource conflicts with an other.
+    \value RangeNotSatisfiable
+        The Range header of the request does not overlap with the resource.
     \value InternalServerError
         There was an internal server error.
     \value NotImplemented
@@ -107,6 +115,12 @@
         The server date header.
     \value ServerHeader
         The name of the server i.e. "Server: nymea/0.6.0"
+    \value ETagHeader
+        The entity tag identifying the current version of the resource.
+    \value ContentEncodingHeader
+        The encoding applied to the payload i.e. gzip.
+    \value VaryHeader
+        The request headers the reply depends on.
 */
 
 /*! \enum nymeaserver::HttpReply::Type
@@ -263,6 +277,12 @@ QUuid HttpReply::clientId() const
 /*! Set the payload of this \l{HttpReply} to the given \a data.*/
 void HttpReply::setPayload(const QByteArray &data)
 {
+    if (m_payloadDevice) {
+        delete m_payloadDevice;
+        m_payloadDevice = nullptr;
+        m_payloadDeviceSize = -1;
+        m_rawHeaderList.remove("Transfer-Encoding");
+    }
     m_payload = data;
     setHeader(HttpHeaderType::ContentLenghtHeader, QByteArray::number(data.length()));
     packReply();
@@ -274,6 +294,71 @@ QByteArray HttpReply::payload() const
     return m_payload;
 }
 
+/*! Sets the payload of this \l{HttpReply} to the content of the given open \a device. The reply takes
+    ownership of the \a device. Instead of loading the whole content into memory, the \l{WebServer} reads
+    the device in chunks while the connection is able to take more data.
+
+    If the \a size is known, it will be sent as Content-Length, otherwise the payload will be sent using
+    chunked transfer encoding.
+
+    \sa setPayloadDeviceRange(), takePayloadDevice()
+*/
+void HttpReply::setPayloadDevice(QIODevice *device, qint64 size)
+{
+    if (m_payloadDevice && m_payloadDevice != device) {
+        delete m_payloadDevice;
+    }
+    m_payload.clear();
+    m_payloadDevice = device;
+    m_payloadDeviceSize = size;
+    m_payloadDevice->setParent(this);
+
+    if (size >= 0) {
+        m_rawHeaderList.remove("Transfer-Encoding");
+        setHeader(HttpHeaderType::ContentLenghtHeader, QByteArray::number(size));
+    } else {
+        m_rawHeaderList.remove(getHeaderType(HttpHeaderType::ContentLenghtHeader));
+        setRawHeader("Transfer-Encoding", "chunked");
+    }
+    packReply();
+}
+
+/*! Limits the payload device of this \l{HttpReply} to \a length bytes starting at \a offset.
+    The device must be random access. This is used to answer requests containing a Range header.
+*/
+void HttpReply::setPayloadDeviceRange(qint64 offset, qint64 length)
+{
+    if (!m_payloadDevice || m_payloadDevice->isSequential()) {
+        qCWarning(dcWebServer()) << "Cannot set a range on a sequential payload device.";
+        return;
+    }
+    m_payloadDevice->seek(offset);
+    setPayloadDevice(m_payloadDevice, length);
+}
+
+/*! Returns the payload device of this \l{HttpReply} or nullptr if the payload is held in memory.*/
+QIODevice *HttpReply::payloadDevice() const
+{
+    return m_payloadDevice;
+}
+
+/*! Returns the number of bytes to be sent from the payload device, or -1 if unknown.*/
+qint64 HttpReply::payloadDeviceSize() const
+{
+    return m_payloadDeviceSize;
+}
+
+/*! Releases the ownership of the payload device and returns it. The caller is responsible to delete it.*/
+QIODevice *HttpReply::takePayloadDevice()
+{
+    QIODevice *device = m_payloadDevice;
+    if (device) {
+        device->setParent(nullptr);
+    }
+    m_payloadDevice = nullptr;
+    return device;
+}
+
 /*! This method appends a raw header to the header list of this \l{HttpReply}.
     The Header will be set to \a headerType : \a value.
 */
@@ -329,7 +414,7 @@ bool HttpReply::closeConnection() const
 /*! Returns true if the raw header and the payload of this \l{HttpReply} is empty.*/
 bool HttpReply::isEmpty() const
 {
-    return m_rawHeader.isEmpty() && m_payload.isEmpty() && m_rawHeaderList.isEmpty();
+    return m_rawHeader.isEmpty() && m_payload.isEmpty() && !m_payloadDevice && m_rawHeaderList.isEmpty();
 }
 
 /*! Clears all data of this \l{HttpReply}. */
@@ -341,8 +426,14 @@ void HttpReply::clear()
     m_rawHeader.clear();
     m_payload.clear();
     m_rawHeaderList.clear();
+    if (m_payloadDevice) {
+        delete m_payloadDevice;
+        m_payloadDevice = nullptr;
+        m_payloadDeviceSize = -1;
+    }
 }
 /*! Packs the whole reply data of this \l{HttpReply}. The data can be accessed with \l{HttpReply::data()}.
+    If a payload device is set, the data only contains the header.
     \sa data()
 */
 void HttpReply::packReply()
@@ -389,15 +480,24 @@ QByteArray HttpReply::getHttpReasonPhrase(const HttpReply::HttpStatusCode &statu
     case NoContent:
         response = QString("No Content").toUtf8();
         break;
+    case PartialContent:
+        response = QString("Partial Content").toUtf8();
+        break;
     case Found:
         response = QString("Found").toUtf8();
         break;
+    case NotModified:
+        response = QString("Not Modified").toUtf8();
+        break;
     case PermanentRedirect:
         response = QString("Permanent Redirect").toUtf8();
         break;
     case BadRequest:
         response = QString("Bad Request").toUtf8();
         break;
+    case Unauthorized:
+        response = QString("Unauthorized").toUtf8();
+        break;
     case Forbidden:
         response = QString("Forbidden").toUtf8();
         break;
@@ -413,6 +513,9 @@ QByteArray HttpReply::getHttpReasonPhrase(const HttpReply::HttpStatusCode &statu
     case Conflict:
         response = QString("Conflict").toUtf8();
         break;
+    case RangeNotSatisfiable:
+        response = QString("Range Not Satisfiable").toUtf8();
+        break;
     case InternalServerError:
         response = QString("Internal Server Error").toUtf8();
         break;
@@ -467,6 +570,15 @@ QByteArray HttpReply::getHeaderType(const HttpReply::HttpHeaderType &headerType)
     case ServerHeader:
         header = QString("Server").toUtf8();
         break;
+    case ETagHeader:
+        header = QString("ETag").toUtf8();
+        break;
+    case ContentEncodingHeader:
+        header = QString("Content-Encoding").toUtf8();
+        break;
+    case VaryHeader:
+        header = QString("Vary").toUtf8();
+        break;
     }
 
     return header;
@@ -36,6 +36,7 @@
 #include <QHash>
 #include <QTimer>
 #include <QUuid>
+#include <QIODevice>
 
 // Note: RFC 7231 HTTP/1.1 Semantics and Content -> http://tools.ietf.org/html/rfc7231
 
@@ -51,14 +52,18 @@ public:
         Created                 = 201,
         Accepted                = 202,
         NoContent               = 204,
+        PartialContent          = 206,
         Found                   = 302,
+        NotModified             = 304,
         PermanentRedirect       = 308,
         BadRequest              = 400,
+        Unauthorized            = 401,
         Forbidden               = 403,
         NotFound                = 404,
         MethodNotAllowed        = 405,
         RequestTimeout          = 408,
         Conflict                = 409,
+        RangeNotSatisfiable     = 416,
         InternalServerError     = 500,
         NotImplemented          = 501,
         BadGateway              = 502,
@@ -76,7 +81,10 @@ public:
         CacheControlHeader,
         AllowHeader,
         DateHeader,
-        ServerHeader
+        ServerHeader,
+        ETagHeader,
+        ContentEncodingHeader,
+        VaryHeader
     };
 
     enum Type {
@@ -104,6 +112,12 @@ public:
     void setPayload(const QByteArray &data);
     QByteArray payload() const;
 
+    void setPayloadDevice(QIODevice *device, qint64 size = -1);
+    void setPayloadDeviceRange(qint64 offset, qint64 length);
+    QIODevice *payloadDevice() const;
+    qint64 payloadDeviceSize() const;
+    QIODevice *takePayloadDevice();
+
     void setRawHeader(const QByteArray headerType, const QByteArray &value);
     void setHeader(const HttpHeaderType &headerType, const QByteArray &value);
     QHash<QByteArray, QByteArray> rawHeaderList() const;
@@ -131,6 +145,9 @@ private:
     QByteArray m_payload;
     QByteArray m_data;
 
+    QIODevice *m_payloadDevice = nullptr;
+    qint64 m_payloadDeviceSize = -1;
+
     QHash<QByteArray, QByteArray> m_rawHeaderList;
 
     bool m_closeConnection;
@@ -70,6 +70,9 @@
 
 namespace nymeaserver {
 
+// Requests with a header bigger than this are rejected instead of being buffered forever
+static const int maxHeaderSize = 64 * 1024;
+
 /*! Construct an empty \l{HttpRequest}. */
 HttpRequest::HttpRequest() :
     m_rawData(QByteArray()),
@@ -84,11 +87,10 @@ HttpRequest::HttpRequest() :
     \sa isValid(), isComplete()
 */
 HttpRequest::HttpRequest(QByteArray rawData) :
-    m_rawData(rawData),
     m_valid(false),
     m_isComplete(false)
 {
-    validate();
+    appendData(rawData);
 }
 
 /*! Returns the raw header of this request.*/
@@ -160,49 +162,119 @@ bool HttpRequest::hasPayload() const
     return !m_payload.isEmpty();
 }
 
-/*! Appends the given \a data to the current raw data of this \l{HttpRequest}.
- *  This method will be used if a \l{HttpRequest} is not complete yet.
+/*! Returns true if the client wants to reuse the connection for further requests. This is the default
+    for HTTP/1.1 unless the client sent "Connection: close". HTTP/1.0 clients have to ask for it explicitly.
+*/
+bool HttpRequest::keepAlive() const
+{
+    QByteArray connection;
+    foreach (const QByteArray &key, m_rawHeaderList.keys()) {
+        if (key.toLower() == "connection") {
+            connection = m_rawHeaderList.value(key).toLower();
+            break;
+        }
+    }
+
+    if (m_httpVersion == "HTTP/1.0")
+        return connection.contains("keep-alive");
+
+    return !connection.contains("close");
+}
+
+/*! Appends the given \a data to this \l{HttpRequest} and continues parsing where the last call stopped.
+ *  The header is parsed only once, payload data gets appended directly without re-parsing anything.
+ *  Data received after the end of this request, i.e. pipelined requests, can be fetched with \l{takeTrailingData()}.
  *
- *  \sa isComplete()
+ *  \sa isComplete(), takeTrailingData()
 */
 void HttpRequest::appendData(const QByteArray &data)
 {
+    if (m_parserState == ParserStateFinished) {
+        m_trailingData.append(data);
+        return;
+    }
+
+    if (m_parserState == ParserStatePayload) {
+        int missing = m_contentLength - m_payload.size();
+        if (data.size() < missing) {
+            m_payload.append(data);
+            return;
+        }
+        m_payload.append(data.left(missing));
+        finish(data.mid(missing));
+        return;
+    }
+
     m_rawData.append(data);
-    validate();
-}
 
-void HttpRequest::validate()
-{
-    m_isComplete = true; m_valid = false;
+    // Skip empty lines in front of the request line (RFC 7230, section 3.5)
+    int start = 0;
+    while (start < m_rawData.size() && (m_rawData.at(start) == '\r' || m_rawData.at(start) == '\n' || m_rawData.at(start) == ' ')) {
+        start++;
+    }
+    if (start > 0) {
+        m_rawData.remove(0, start);
+        m_headerSearchOffset = 0;
+    }
 
-    // Parese the HTTP request. The request is invalid, until the end of the parse process.
     if (m_rawData.isEmpty())
         return;
 
-    // split the data into header and payload
-    int headerEndIndex = m_rawData.indexOf("\r\n\r\n");
+    // Only search the newly arrived bytes (plus the ones which could belong to a split delimiter) for the end of the header
+    int headerEndIndex = m_rawData.indexOf("\r\n\r\n", m_headerSearchOffset);
     if (headerEndIndex < 0) {
-        qCWarning(dcWebServer()) << "Could not parse end of HTTP header (empty line between header and body):" << m_rawData;
+        if (m_rawData.size() > maxHeaderSize) {
+            qCWarning(dcWebServer()) << "HTTP header exceeds" << maxHeaderSize << "bytes. Rejecting request.";
+            m_rawData.clear();
+            m_parserState = ParserStateFinished;
+            m_isComplete = true;
+        }
+        m_headerSearchOffset = qMax(0, m_rawData.size() - 3);
         return;
     }
 
     m_rawHeader = m_rawData.left(headerEndIndex);
-    m_payload = m_rawData.right(m_rawData.length() - headerEndIndex).simplified();
+    QByteArray payloadData = m_rawData.mid(headerEndIndex + 4);
+    m_rawData.clear();
+
+    if (!parseHeader()) {
+        m_parserState = ParserStateFinished;
+        m_isComplete = true;
+        return;
+    }
+
+    // The payload is collected separately and never copied again while more data arrives
+    m_parserState = ParserStatePayload;
+    m_payload.reserve(m_contentLength);
+    appendData(payloadData);
+}
+
+/*! Returns the data which was received after the end of this request and removes it from this \l{HttpRequest}.
+    This is the beginning of the next request on a persistent connection.
+*/
+QByteArray HttpRequest::takeTrailingData()
+{
+    QByteArray trailingData = m_trailingData;
+    m_trailingData.clear();
+    return trailingData;
+}
 
+bool HttpRequest::parseHeader()
+{
     // parse status line
     QStringList headerLines = QString(m_rawHeader).split(QRegExp("\r\n"));
     QString statusLine = headerLines.takeFirst();
     QStringList statusLineTokens = statusLine.split(QRegExp("[ \r\n][ \r\n]*"));
     if (statusLineTokens.count() != 3) {
         qCWarning(dcWebServer()) << "Could not parse HTTP status line:" << statusLine;
-        return;
+        return false;
     }
 
     // verify http version
     m_httpVersion = statusLineTokens.at(2).toUtf8().simplified();
     if (!m_httpVersion.contains("HTTP")) {
         qCWarning(dcWebServer()) << "Unknown HTTP version:" << m_httpVersion;
-        return;
+        return false;
     }
     m_methodString = statusLineTokens.at(0).simplified();
     m_method = getRequestMethodType(m_methodString);
@@ -216,7 +288,7 @@ void HttpRequest::validate()
     foreach (const QString &line, headerLines) {
         if (!line.contains(":")) {
             qCWarning(dcWebServer()) << "Invalid HTTP header:" << line;
-            return;
+            return false;
         }
         int index = line.indexOf(":");
         QByteArray key = line.left(index).toUtf8().simplified();
@@ -228,34 +300,43 @@ void HttpRequest::validate()
     if (!m_rawHeaderList.contains("User-Agent"))
         qCDebug(dcWebServer()) << "User-Agent header is missing";
 
-
-    // verify content length with actual payload
+    // Without Content-Length a request has no payload (RFC 7230, section 3.3.3)
+    m_contentLength = 0;
     if (m_rawHeaderList.contains("Content-Length")) {
         bool ok = false;
-        int contentLength = m_rawHeaderList.value("Content-Length").toInt(&ok);
-        if (!ok) {
+        m_contentLength = m_rawHeaderList.value("Content-Length").toInt(&ok);
+        if (!ok || m_contentLength < 0) {
             qCWarning(dcWebServer()) << "Could not parse Content-Length.";
-            return;
+            return false;
         }
-        // check if we have all data
-        if (m_payload.size() < contentLength) {
-            qCDebug(dcWebServer()) << "Request incomplete:";
-            qCDebug(dcWebServer()) << "   -> Content-Length:" << contentLength;
-            qCDebug(dcWebServer()) << "   -> Payload size  :" << payload().size();
-            m_isComplete = false;
-            return;
-        }
-        // check if the content length bigger than header Content-Length
-        if (m_payload.size() > contentLength) {
+    }
+    return true;
+}
+
+void HttpRequest::finish(const QByteArray &trailingData)
+{
+    m_parserState = ParserStateFinished;
+    m_isComplete = true;
+    m_valid = true;
+    m_trailingData = trailingData;
+
+    // Whatever follows the payload has to be the beginning of the next request. If it can't be a request line,
+    // the client sent more payload than announced in Content-Length.
+    int i = 0;
+    while (i < m_trailingData.size() && (m_trailingData.at(i) == '\r' || m_trailingData.at(i) == '\n' || m_trailingData.at(i) == ' ')) {
+        i++;
+    }
+    for (; i < m_trailingData.size() && m_trailingData.at(i) != ' '; i++) {
+        char c = m_trailingData.at(i);
+        if (c < 'A' || c > 'Z') {
             qCWarning(dcWebServer()) << "Payload size greater than header Content-Length:";
-            qCWarning(dcWebServer()) << "   -> Content-Length:" << contentLength;
-            qCWarning(dcWebServer()) << "   -> Payload size  :" << payload().size();
-            m_isComplete = true;
+            qCWarning(dcWebServer()) << "   -> Content-Length:" << m_contentLength;
+            qCWarning(dcWebServer()) << "   -> Trailing data :" << m_trailingData.left(32);
+            m_trailingData.clear();
+            m_valid = false;
             return;
         }
-
     }
-    m_valid = true;
 }
 
 HttpRequest::RequestMethod HttpRequest::getRequestMethodType(const QString &methodString)
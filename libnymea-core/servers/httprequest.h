@@ -68,11 +68,24 @@ public:
     bool isValid() const;
     bool isComplete() const;
     bool hasPayload() const;
+    bool keepAlive() const;
 
     void appendData(const QByteArray &data);
+    QByteArray takeTrailingData();
 
 private:
+    enum ParserState {
+        ParserStateHeader,
+        ParserStatePayload,
+        ParserStateFinished
+    };
+
+    ParserState m_parserState = ParserStateHeader;
+    int m_headerSearchOffset = 0;
+    int m_contentLength = 0;
+
     QByteArray m_rawData;
+    QByteArray m_trailingData;
     QByteArray m_rawHeader;
     QHash<QByteArray, QByteArray> m_rawHeaderList;
 
@@ -88,7 +101,8 @@ private:
     bool m_valid;
     bool m_isComplete;
 
-    void validate();
+    bool parseHeader();
+    void finish(const QByteArray &trailingData);
     RequestMethod getRequestMethodType(const QString &methodString);
 };
 
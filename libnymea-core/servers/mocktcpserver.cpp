@@ -66,10 +66,32 @@ void MockTcpServer::sendData(const QUuid &clientId, const QByteArray &data)
 void MockTcpServer::sendData(const QList<QUuid> &clients, const QByteArray &data)
 {
     foreach (const QUuid &clientId, clients) {
-        sendData(clientId, data + '\n');
+        sendData(clientId, data);
     }
 }
 
+bool MockTcpServer::supportsBinaryData() const
+{
+    return true;
+}
+
+void MockTcpServer::sendBinaryData(const QUuid &clientId, const QByteArray &data)
+{
+    emit outgoingData(clientId, data);
+}
+
+void MockTcpServer::sendBinaryData(const QList<QUuid> &clients, const QByteArray &data)
+{
+    foreach (const QUuid &clientId, clients) {
+        sendBinaryData(clientId, data);
+    }
+}
+
+qint64 MockTcpServer::pendingBytes(const QUuid &clientId) const
+{
+    return m_pendingBytes.value(clientId);
+}
+
 void MockTcpServer::terminateClientConnection(const QUuid &clientId)
 {
     emit connectionTerminated(clientId);
@@ -87,6 +109,11 @@ void MockTcpServer::injectData(const QUuid &clientId, const QByteArray &data)
     emit dataAvailable(clientId, data);
 }
 
+void MockTcpServer::setPendingBytes(const QUuid &clientId, qint64 pendingBytes)
+{
+    m_pendingBytes.insert(clientId, pendingBytes);
+}
+
 bool MockTcpServer::reconfigureServer(const QHostAddress &address, const uint &port)
 {
     Q_UNUSED(address)
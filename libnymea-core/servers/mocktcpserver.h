@@ -50,11 +50,16 @@ public:
 
     void sendData(const QUuid &clientId, const QByteArray &data) override;
     void sendData(const QList<QUuid> &clients, const QByteArray &data) override;
+    bool supportsBinaryData() const override;
+    void sendBinaryData(const QUuid &clientId, const QByteArray &data) override;
+    void sendBinaryData(const QList<QUuid> &clients, const QByteArray &data) override;
+    qint64 pendingBytes(const QUuid &clientId) const override;
     void terminateClientConnection(const QUuid &clientId) override;
 
 /************** Used for testing **************************/
     static QList<MockTcpServer*> servers();
     void injectData(const QUuid &clientId, const QByteArray &data);
+    void setPendingBytes(const QUuid &clientId, qint64 pendingBytes);
 signals:
     void outgoingData(const QUuid &clientId, const QByteArray &data);
     void connectionTerminated(const QUuid &clientId);
@@ -69,6 +74,7 @@ private:
     static QList<MockTcpServer*> s_allServers;
 
     QList<QUuid> m_connectedClients;
+    QHash<QUuid, qint64> m_pendingBytes;
 };
 
 }
@@ -32,6 +32,8 @@
 #include "loggingcategories.h"
 
 #include <mqttserver.h>
+#include <QTimer>
+#include <QDateTime>
 
 namespace nymeaserver {
 
@@ -119,6 +121,25 @@ private:
     MqttBroker *m_broker;
 };
 
+void MqttTrafficStatistics::addIncoming(int bytes)
+{
+    messagesIn++;
+    bytesIn += bytes;
+}
+
+void MqttTrafficStatistics::addOutgoing(int bytes, qint64 latency)
+{
+    messagesOut++;
+    bytesOut += bytes;
+    totalLatency += latency;
+    maxLatency = qMax(maxLatency, static_cast<quint64>(latency));
+}
+
+quint64 MqttTrafficStatistics::averageLatency() const
+{
+    return messagesOut > 0 ? totalLatency / messagesOut : 0;
+}
+
 MqttBroker::MqttBroker(QObject *parent) : QObject(parent)
 {
     m_server = new MqttServer(this);
@@ -233,21 +254,165 @@ bool MqttBroker::removePolicy(const QString &clientId)
     return false;
 }
 
-void MqttBroker::publish(const QString &topic, const QByteArray &payload)
+void MqttBroker::publish(const QString &topic, const QByteArray &payload, bool retain)
+{
+    publish(QList<QPair<QString, QByteArray> >() << qMakePair(topic, payload), retain);
+}
+
+/* Queues the given messages for publishing. All messages queued within one event loop
+ * iteration are sent together. Retained messages are stored for later subscribers and
+ * a retained message replaces a not yet sent retained message for the same topic. An
+ * empty retained payload removes the retained message of the topic.
+ */
+void MqttBroker::publish(const QList<QPair<QString, QByteArray> > &messages, bool retain)
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0; i < messages.count(); i++) {
+        const QString &topic = messages.at(i).first;
+        const QByteArray &payload = messages.at(i).second;
+
+        if (retain) {
+            if (payload.isEmpty()) {
+                m_retainedMessages.remove(topic);
+            } else {
+                m_retainedMessages.insert(topic, payload);
+            }
+
+            // Only the latest state of a topic needs to go out
+            if (m_pendingRetainedPublishes.contains(topic)) {
+                m_pendingPublishes[m_pendingRetainedPublishes.value(topic)].payload = payload;
+                continue;
+            }
+        }
+
+        // Keep the broker bounded if something floods it within one event loop iteration
+        if (m_maxPendingPublishes > 0 && m_pendingPublishes.count() >= m_maxPendingPublishes) {
+            if (m_droppedPublishes++ % 1000 == 0) {
+                qCWarning(dcMqtt) << "Publish queue full (" << m_maxPendingPublishes << "messages). Dropping message for" << topic;
+            }
+            topicStatisticsEntry(topic).messagesDropped++;
+            continue;
+        }
+
+        if (retain) {
+            m_pendingRetainedPublishes.insert(topic, m_pendingPublishes.count());
+        }
+
+        PendingPublish pendingPublish;
+        pendingPublish.topic = topic;
+        pendingPublish.payload = payload;
+        pendingPublish.queuedAt = now;
+        m_pendingPublishes.append(pendingPublish);
+    }
+
+    if (!m_flushScheduled && !m_pendingPublishes.isEmpty()) {
+        m_flushScheduled = true;
+        QTimer::singleShot(0, this, &MqttBroker::flushPublishes);
+    }
+}
+
+/* Returns the retained messages matching the given \a topicFilter. */
+QHash<QString, QByteArray> MqttBroker::retainedMessages(const QString &topicFilter) const
+{
+    QHash<QString, QByteArray> messages;
+    if (!topicFilter.contains('+') && !topicFilter.contains('#')) {
+        if (m_retainedMessages.contains(topicFilter))
+            messages.insert(topicFilter, m_retainedMessages.value(topicFilter));
+
+        return messages;
+    }
+
+    MqttTopicTrie<bool> filter;
+    filter.insert(topicFilter, true);
+    for (QHash<QString, QByteArray>::const_iterator it = m_retainedMessages.constBegin(); it != m_retainedMessages.constEnd(); ++it) {
+        if (!filter.match(it.key()).isEmpty()) {
+            messages.insert(it.key(), it.value());
+        }
+    }
+    return messages;
+}
+
+/* Returns the maximum number of bytes per second sent to a single client before it is considered a slow client. */
+int MqttBroker::clientOutboundLimit() const
+{
+    return m_clientOutboundLimit;
+}
+
+/* Sets the maximum number of bytes per second sent to a single client to \a bytesPerSecond. 0 disables the limit. */
+void MqttBroker::setClientOutboundLimit(int bytesPerSecond)
+{
+    m_clientOutboundLimit = qMax(0, bytesPerSecond);
+}
+
+MqttBroker::SlowClientPolicy MqttBroker::slowClientPolicy() const
+{
+    return m_slowClientPolicy;
+}
+
+/* Sets how clients exceeding the outbound limit are handled. With SlowClientPolicyDrop messages
+ * for QoS 0 subscriptions are dropped for the rest of the second, while clients with QoS 1 or 2
+ * subscriptions are disconnected, as they expect every message to arrive. With
+ * SlowClientPolicyDisconnect every slow client is disconnected.
+ */
+void MqttBroker::setSlowClientPolicy(MqttBroker::SlowClientPolicy policy)
+{
+    m_slowClientPolicy = policy;
+}
+
+int MqttBroker::maxPendingPublishes() const
 {
-    m_server->publish(topic, payload);
+    return m_maxPendingPublishes;
+}
+
+/* Sets the maximum number of queued messages. Further messages are dropped until the queue has been flushed. */
+void MqttBroker::setMaxPendingPublishes(int maxPendingPublishes)
+{
+    m_maxPendingPublishes = qMax(0, maxPendingPublishes);
+}
+
+int MqttBroker::pendingPublishes() const
+{
+    return m_pendingPublishes.count();
+}
+
+quint64 MqttBroker::droppedPublishes() const
+{
+    return m_droppedPublishes;
+}
+
+/* Returns the traffic statistics of the connected clients. */
+QHash<QString, MqttTrafficStatistics> MqttBroker::clientStatistics() const
+{
+    QHash<QString, MqttTrafficStatistics> statistics;
+    for (QHash<QString, ClientInfo>::const_iterator it = m_clients.constBegin(); it != m_clients.constEnd(); ++it) {
+        statistics.insert(it.key(), it.value().statistics);
+    }
+    return statistics;
+}
+
+/* Returns the traffic statistics per first topic level. */
+QHash<QString, MqttTrafficStatistics> MqttBroker::topicStatistics() const
+{
+    return m_topicStatistics;
 }
 
 void MqttBroker::onClientConnected(int serverAddressId, const QString &clientId, const QString &username, const QHostAddress &clientAddress)
 {
     Q_UNUSED(serverAddressId)
     qCDebug(dcMqtt) << "Client" << clientId << "connected with username" << username << "from" << clientAddress.toString();
+    m_clients.insert(clientId, ClientInfo());
     emit clientConnected(clientId);
 }
 
 void MqttBroker::onClientDisconnected(const QString &clientId)
 {
     qCDebug(dcMqtt) << "Client" << clientId << "disconnected";
+    ClientInfo clientInfo = m_clients.take(clientId);
+    foreach (const QString &topicFilter, clientInfo.subscriptions.keys()) {
+        ClientSubscription subscription;
+        subscription.clientId = clientId;
+        m_clientSubscriptions.remove(topicFilter, subscription);
+    }
     emit clientDisconnected(clientId);
 }
 
@@ -255,19 +420,118 @@ void MqttBroker::onPublishReceived(const QString &clientId, quint16 packetId, co
 {
     Q_UNUSED(packetId)
     qCDebug(dcMqtt) << "Publish received from client" << clientId << ":" << topic << ">" << payload;
+    if (m_clients.contains(clientId)) {
+        m_clients[clientId].statistics.addIncoming(payload.size());
+    }
+    topicStatisticsEntry(topic).addIncoming(payload.size());
     emit publishReceived(clientId, topic, payload);
 }
 
 void MqttBroker::onClientSubscribed(const QString &clientId, const QString &topicFilter, Mqtt::QoS requestedQoS)
 {
     qCDebug(dcMqtt) << "Client" << clientId << "subscribed to" << topicFilter << "(QoS:" << requestedQoS << ")";
+    if (m_clients.contains(clientId)) {
+        ClientSubscription subscription;
+        subscription.clientId = clientId;
+        subscription.qos = requestedQoS;
+        m_clientSubscriptions.remove(topicFilter, subscription);
+        m_clientSubscriptions.insert(topicFilter, subscription);
+        m_clients[clientId].subscriptions.insert(topicFilter, requestedQoS);
+    }
     emit clientSubscribed(clientId, topicFilter);
 }
 
 void MqttBroker::onClientUnsubscribed(const QString &clientId, const QString &topicFilter)
 {
     qCDebug(dcMqtt) << "Client" << clientId << "unsubscribed from" << topicFilter;
+    if (m_clients.contains(clientId)) {
+        ClientSubscription subscription;
+        subscription.clientId = clientId;
+        m_clientSubscriptions.remove(topicFilter, subscription);
+        m_clients[clientId].subscriptions.remove(topicFilter);
+    }
     emit clientUnsubscribed(clientId, topicFilter);
 }
 
+void MqttBroker::flushPublishes()
+{
+    m_flushScheduled = false;
+
+    QList<PendingPublish> publishes = m_pendingPublishes;
+    m_pendingPublishes.clear();
+    m_pendingRetainedPublishes.clear();
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QStringList slowClients;
+
+    qCDebug(dcMqtt) << "Publishing" << publishes.count() << "messages";
+    for (int i = 0; i < publishes.count(); i++) {
+        const PendingPublish &publish = publishes.at(i);
+        qint64 latency = now - publish.queuedAt;
+        MqttTrafficStatistics &topicStats = topicStatisticsEntry(publish.topic);
+
+        // A client may match with several subscriptions, the highest QoS counts
+        QHash<QString, Mqtt::QoS> subscribers;
+        foreach (const ClientSubscription &subscription, m_clientSubscriptions.match(publish.topic)) {
+            if (subscription.qos >= subscribers.value(subscription.clientId, Mqtt::QoS0)) {
+                subscribers.insert(subscription.clientId, subscription.qos);
+            }
+        }
+
+        int receivers = 0;
+        for (QHash<QString, Mqtt::QoS>::const_iterator it = subscribers.constBegin(); it != subscribers.constEnd(); ++it) {
+            ClientInfo &clientInfo = m_clients[it.key()];
+            if (now - clientInfo.windowStart >= 1000) {
+                clientInfo.windowStart = now;
+                clientInfo.windowBytes = 0;
+                clientInfo.dropping = false;
+            }
+            clientInfo.windowBytes += publish.payload.size();
+
+            if (m_clientOutboundLimit > 0 && clientInfo.windowBytes > m_clientOutboundLimit) {
+                if (m_slowClientPolicy == SlowClientPolicyDrop && it.value() == Mqtt::QoS0) {
+                    if (!clientInfo.dropping) {
+                        qCWarning(dcMqtt) << "Client" << it.key() << "exceeds the outbound limit of" << m_clientOutboundLimit << "bytes per second. Dropping messages.";
+                        clientInfo.dropping = true;
+                    }
+                    clientInfo.statistics.messagesDropped++;
+                    continue;
+                }
+                if (!slowClients.contains(it.key())) {
+                    slowClients.append(it.key());
+                }
+                continue;
+            }
+
+            clientInfo.statistics.addOutgoing(publish.payload.size(), latency);
+            receivers++;
+        }
+
+        // The server delivers to all subscribers, so the message can only be dropped if nobody takes it
+        if (!subscribers.isEmpty() && receivers == 0) {
+            topicStats.messagesDropped++;
+            continue;
+        }
+
+        topicStats.addOutgoing(publish.payload.size(), latency);
+        m_server->publish(publish.topic, publish.payload);
+    }
+
+    foreach (const QString &clientId, slowClients) {
+        qCWarning(dcMqtt) << "Disconnecting client" << clientId << "for exceeding the outbound limit of" << m_clientOutboundLimit << "bytes per second.";
+        m_server->disconnectClient(clientId);
+    }
+}
+
+MqttTrafficStatistics &MqttBroker::topicStatisticsEntry(const QString &topic)
+{
+    QString prefix = topic.section('/', 0, 0);
+
+    // Don't let clients flood the statistics with arbitrary topics
+    if (!m_topicStatistics.contains(prefix) && m_topicStatistics.count() >= 256) {
+        prefix = "#";
+    }
+    return m_topicStatistics[prefix];
+}
+
 }
@@ -37,6 +37,7 @@
 
 #include <mqtt.h>
 #include "nymeaconfiguration.h"
+#include "network/mqtt/mqtttopictrie.h"
 
 class MqttServer;
 
@@ -44,10 +45,34 @@ namespace nymeaserver {
 
 class NymeaMqttAuthorizer;
 
+class MqttTrafficStatistics
+{
+public:
+    quint64 messagesIn = 0;
+    quint64 bytesIn = 0;
+    quint64 messagesOut = 0;
+    quint64 bytesOut = 0;
+    quint64 messagesDropped = 0;
+
+    // Time outgoing messages spent in the broker queue in ms
+    quint64 totalLatency = 0;
+    quint64 maxLatency = 0;
+
+    void addIncoming(int bytes);
+    void addOutgoing(int bytes, qint64 latency);
+    quint64 averageLatency() const;
+};
+
 class MqttBroker : public QObject
 {
     Q_OBJECT
 public:
+    enum SlowClientPolicy {
+        SlowClientPolicyDrop,
+        SlowClientPolicyDisconnect
+    };
+    Q_ENUM(SlowClientPolicy)
+
     explicit MqttBroker(QObject *parent = nullptr);
     ~MqttBroker();
 
@@ -63,7 +88,24 @@ public:
     void updatePolicies(const QList<MqttPolicy> &policies);
     bool removePolicy(const QString &clientId);
 
-    void publish(const QString &topic, const QByteArray &payload);
+    void publish(const QString &topic, const QByteArray &payload, bool retain = false);
+    void publish(const QList<QPair<QString, QByteArray> > &messages, bool retain = false);
+
+    QHash<QString, QByteArray> retainedMessages(const QString &topicFilter) const;
+
+    int clientOutboundLimit() const;
+    void setClientOutboundLimit(int bytesPerSecond);
+
+    SlowClientPolicy slowClientPolicy() const;
+    void setSlowClientPolicy(SlowClientPolicy policy);
+
+    int maxPendingPublishes() const;
+    void setMaxPendingPublishes(int maxPendingPublishes);
+
+    int pendingPublishes() const;
+    quint64 droppedPublishes() const;
+    QHash<QString, MqttTrafficStatistics> clientStatistics() const;
+    QHash<QString, MqttTrafficStatistics> topicStatistics() const;
 
 private slots:
     void onClientConnected(int serverAddressId, const QString &clientId, const QString &username, const QHostAddress &clientAddress);
@@ -71,6 +113,7 @@ private slots:
     void onPublishReceived(const QString &clientId, quint16 packetId, const QString &topic, const QByteArray &payload);
     void onClientSubscribed(const QString &clientId, const QString &topicFilter, Mqtt::QoS requestedQoS);
     void onClientUnsubscribed(const QString &clientId, const QString &topicFilter);
+    void flushPublishes();
 
 signals:
     void clientConnected(const QString &clientId);
@@ -88,6 +131,47 @@ private:
     QHash<int, ServerConfiguration> m_configs;
     QHash<QString, MqttPolicy> m_policies;
 
+    class PendingPublish {
+    public:
+        QString topic;
+        QByteArray payload;
+        qint64 queuedAt = 0;
+    };
+
+    class ClientSubscription {
+    public:
+        QString clientId;
+        Mqtt::QoS qos = Mqtt::QoS0;
+        bool operator==(const ClientSubscription &other) const { return clientId == other.clientId; }
+    };
+
+    class ClientInfo {
+    public:
+        MqttTrafficStatistics statistics;
+        QHash<QString, Mqtt::QoS> subscriptions;                        // topic filter | granted QoS
+        qint64 windowStart = 0;
+        qint64 windowBytes = 0;
+        bool dropping = false;
+    };
+
+    // Publishes are collected and sent in one go, so the packets end up in as few socket writes as possible
+    QList<PendingPublish> m_pendingPublishes;
+    QHash<QString, int> m_pendingRetainedPublishes;                     // topic | index in m_pendingPublishes
+    bool m_flushScheduled = false;
+
+    QHash<QString, QByteArray> m_retainedMessages;                       // topic | payload
+
+    // The MQTT server does not expose its client sockets, so the outbound traffic of each client is
+    // accounted here from its subscriptions and limited per second
+    int m_clientOutboundLimit = 1048576;
+    SlowClientPolicy m_slowClientPolicy = SlowClientPolicyDrop;
+    int m_maxPendingPublishes = 10000;
+    quint64 m_droppedPublishes = 0;
+    QHash<QString, ClientInfo> m_clients;
+    MqttTopicTrie<ClientSubscription> m_clientSubscriptions;
+    QHash<QString, MqttTrafficStatistics> m_topicStatistics;            // first topic level | statistics
+
+    MqttTrafficStatistics &topicStatisticsEntry(const QString &topic);
 
     friend class NymeaMqttAuthorizer;
 };
@@ -0,0 +1,230 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::MqttStateExporter
+    \brief Publishes all thing states on the internal MQTT broker.
+
+    \ingroup server
+    \inmodule core
+
+    The MqttStateExporter publishes each state change of each thing to
+    "<topicPrefix>/<thingId>/<stateName>". The payload is the plain value: numbers and booleans as
+    text, strings as UTF-8 and everything else as JSON. Changes are coalesced per topic and
+    published in batches, either in the next event loop iteration or after the configured interval.
+    If retained publishing is enabled the broker keeps the last value of each state for new
+    subscribers.
+*/
+
+#include "mqttstateexporter.h"
+#include "mqttbroker.h"
+#include "loggingcategories.h"
+
+#include "integrations/thing.h"
+#include "integrations/thingmanager.h"
+
+#include <QColor>
+#include <QJsonDocument>
+
+namespace nymeaserver {
+
+/*! Constructs a state exporter for the things of the given \a thingManager publishing on \a broker with the given \a parent. */
+MqttStateExporter::MqttStateExporter(ThingManager *thingManager, MqttBroker *broker, QObject *parent) :
+    QObject(parent),
+    m_thingManager(thingManager),
+    m_broker(broker)
+{
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(0);
+    connect(&m_flushTimer, &QTimer::timeout, this, &MqttStateExporter::flush);
+    connect(m_thingManager, &ThingManager::thingRemoved, this, &MqttStateExporter::onThingRemoved);
+}
+
+/*! Returns true if state changes get published. */
+bool MqttStateExporter::enabled() const
+{
+    return m_enabled;
+}
+
+/*! Enables or disables publishing of state changes according to \a enabled. */
+void MqttStateExporter::setEnabled(bool enabled)
+{
+    if (m_enabled == enabled)
+        return;
+
+    m_enabled = enabled;
+    if (enabled) {
+        connect(m_thingManager, &ThingManager::thingStateChanged, this, &MqttStateExporter::onThingStateChanged);
+    } else {
+        disconnect(m_thingManager, &ThingManager::thingStateChanged, this, &MqttStateExporter::onThingStateChanged);
+        m_flushTimer.stop();
+        m_pendingValues.clear();
+        m_pendingTopics.clear();
+    }
+    qCDebug(dcMqtt()) << "State export" << (enabled ? "enabled" : "disabled") << "on topic prefix" << m_topicPrefix;
+}
+
+/*! Returns the topic prefix the states are published on. */
+QString MqttStateExporter::topicPrefix() const
+{
+    return m_topicPrefix;
+}
+
+/*! Sets the topic prefix the states are published on to \a topicPrefix. */
+void MqttStateExporter::setTopicPrefix(const QString &topicPrefix)
+{
+    QString prefix = topicPrefix;
+    while (prefix.endsWith('/'))
+        prefix.chop(1);
+
+    if (m_topicPrefix == prefix)
+        return;
+
+    flush();
+    m_topicPrefix = prefix;
+    m_topics.clear();
+}
+
+/*! Returns true if states are published as retained messages. */
+bool MqttStateExporter::retained() const
+{
+    return m_retained;
+}
+
+/*! Sets whether states are published as retained messages to \a retained. */
+void MqttStateExporter::setRetained(bool retained)
+{
+    m_retained = retained;
+}
+
+/*! Returns the interval in milliseconds changes are collected before being published. */
+int MqttStateExporter::interval() const
+{
+    return m_flushTimer.interval();
+}
+
+/*! Sets the \a interval in milliseconds changes are collected before being published. Only the latest value of
+    a state within the interval gets published. With 0 the changes are published in the next event loop iteration.
+*/
+void MqttStateExporter::setInterval(int interval)
+{
+    m_flushTimer.setInterval(qMax(0, interval));
+}
+
+/*! Returns the compact MQTT payload for the given state \a value. */
+QByteArray MqttStateExporter::encodeValue(const QVariant &value)
+{
+    switch (static_cast<int>(value.type())) {
+    case QVariant::Invalid:
+        return QByteArray();
+    case QVariant::Bool:
+        return value.toBool() ? QByteArrayLiteral("true") : QByteArrayLiteral("false");
+    case QVariant::Int:
+    case QVariant::LongLong:
+        return QByteArray::number(value.toLongLong());
+    case QVariant::UInt:
+    case QVariant::ULongLong:
+        return QByteArray::number(value.toULongLong());
+    case QMetaType::Float:
+    case QVariant::Double:
+        return QByteArray::number(value.toDouble(), 'g', 15);
+    case QVariant::String:
+        return value.toString().toUtf8();
+    case QVariant::ByteArray:
+        return value.toByteArray();
+    case QVariant::Color:
+        return value.value<QColor>().name().toUtf8();
+    default:
+        // Wrap in an array so plain values encode as well and strip the brackets again
+        QByteArray json = QJsonDocument::fromVariant(QVariantList() << value).toJson(QJsonDocument::Compact);
+        return json.mid(1, json.length() - 2);
+    }
+}
+
+void MqttStateExporter::onThingStateChanged(Thing *thing, const StateTypeId &stateTypeId, const QVariant &value)
+{
+    QString stateTopic = topic(thing, stateTypeId);
+    if (!m_pendingValues.contains(stateTopic))
+        m_pendingTopics.append(stateTopic);
+
+    m_pendingValues.insert(stateTopic, value);
+
+    if (!m_flushTimer.isActive())
+        m_flushTimer.start();
+}
+
+void MqttStateExporter::onThingRemoved(const ThingId &thingId)
+{
+    QHash<StateTypeId, QString> topics = m_topics.take(thingId);
+    if (!m_enabled || !m_retained)
+        return;
+
+    // Clear the retained states of the removed thing
+    QList<QPair<QString, QByteArray> > messages;
+    foreach (const QString &topic, topics) {
+        messages.append(qMakePair(topic, QByteArray()));
+    }
+    m_broker->publish(messages, true);
+}
+
+void MqttStateExporter::flush()
+{
+    m_flushTimer.stop();
+    if (m_pendingTopics.isEmpty())
+        return;
+
+    QList<QPair<QString, QByteArray> > messages;
+    messages.reserve(m_pendingTopics.count());
+    foreach (const QString &topic, m_pendingTopics) {
+        messages.append(qMakePair(topic, encodeValue(m_pendingValues.value(topic))));
+    }
+    m_pendingTopics.clear();
+    m_pendingValues.clear();
+
+    m_broker->publish(messages, m_retained);
+}
+
+QString MqttStateExporter::topic(Thing *thing, const StateTypeId &stateTypeId)
+{
+    QHash<StateTypeId, QString> &thingTopics = m_topics[thing->id()];
+    QHash<StateTypeId, QString>::const_iterator it = thingTopics.constFind(stateTypeId);
+    if (it != thingTopics.constEnd())
+        return it.value();
+
+    QString stateName = thing->thingClass().stateTypes().findById(stateTypeId).name();
+    if (stateName.isEmpty())
+        stateName = stateTypeId.toString().remove(QRegExp("[{}]"));
+
+    QString topic = QString("%1/%2/%3").arg(m_topicPrefix, thing->id().toString().remove(QRegExp("[{}]")), stateName);
+    thingTopics.insert(stateTypeId, topic);
+    return topic;
+}
+
+}
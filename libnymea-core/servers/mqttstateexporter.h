@@ -0,0 +1,93 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MQTTSTATEEXPORTER_H
+#define MQTTSTATEEXPORTER_H
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+
+#include "typeutils.h"
+
+class Thing;
+class ThingManager;
+
+namespace nymeaserver {
+
+class MqttBroker;
+
+class MqttStateExporter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MqttStateExporter(ThingManager *thingManager, MqttBroker *broker, QObject *parent = nullptr);
+
+    bool enabled() const;
+    void setEnabled(bool enabled);
+
+    QString topicPrefix() const;
+    void setTopicPrefix(const QString &topicPrefix);
+
+    bool retained() const;
+    void setRetained(bool retained);
+
+    int interval() const;
+    void setInterval(int interval);
+
+    static QByteArray encodeValue(const QVariant &value);
+
+private slots:
+    void onThingStateChanged(Thing *thing, const StateTypeId &stateTypeId, const QVariant &value);
+    void onThingRemoved(const ThingId &thingId);
+    void flush();
+
+private:
+    ThingManager *m_thingManager = nullptr;
+    MqttBroker *m_broker = nullptr;
+
+    bool m_enabled = false;
+    QString m_topicPrefix = "nymea/things";
+    bool m_retained = true;
+
+    // Topic strings are built once per thing and state
+    QHash<ThingId, QHash<StateTypeId, QString> > m_topics;
+
+    // Latest value of each changed topic since the last flush, in order of the first change
+    QHash<QString, QVariant> m_pendingValues;
+    QStringList m_pendingTopics;
+    QTimer m_flushTimer;
+
+    QString topic(Thing *thing, const StateTypeId &stateTypeId);
+};
+
+}
+
+#endif // MQTTSTATEEXPORTER_H
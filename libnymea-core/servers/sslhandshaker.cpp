@@ -0,0 +1,159 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::SslHandshaker
+    \brief This class runs the TLS handshakes of incoming connections in a worker thread.
+
+    \ingroup server
+    \inmodule core
+
+    Full TLS handshakes are expensive on small devices. Servers which handle their sockets in the main thread
+    pass the socket descriptors of new connections to \l{handleConnection()}. Once the connection is encrypted,
+    the socket is moved to the thread of the \l{SslHandshaker} and handed out with \l{connectionEncrypted()}.
+    Connections which fail or don't finish the handshake in time are dropped in the worker thread.
+
+    \sa WebServer, WebSocketServer, TcpSocketWorker
+*/
+
+/*! \fn void nymeaserver::SslHandshaker::connectionEncrypted(QSslSocket *socket);
+    This signal is emitted when the handshake for a new connection finished. The \a socket lives in the thread
+    of this \l{SslHandshaker} and has no parent. The receiver takes ownership of it.
+*/
+
+/*!
+    \class nymeaserver::SslHandshakeWorker
+    \brief This class performs the TLS handshakes for the \l{SslHandshaker} in its worker thread.
+
+    \ingroup server
+    \inmodule core
+
+    \sa SslHandshaker
+*/
+
+/*! \fn void nymeaserver::SslHandshakeWorker::handshakeFinished(QSslSocket *socket);
+    This signal is emitted when the encryption of the \a socket has been established.
+*/
+
+#include "sslhandshaker.h"
+#include "loggingcategories.h"
+
+#include <QTimer>
+
+namespace nymeaserver {
+
+// Clients not finishing the handshake in time (port scanners, stale connections) are dropped
+static const int handshakeTimeout = 10000;
+
+/*! Constructs a \l{SslHandshakeWorker} using the given \a config for all handshakes, with the given \a parent. */
+SslHandshakeWorker::SslHandshakeWorker(const QSslConfiguration &config, QObject *parent):
+    QObject(parent),
+    m_config(config)
+{
+
+}
+
+/*! Starts the server side handshake on the socket with the given \a socketDescriptor. Once encrypted, the socket
+    will be moved to the \a targetThread. Runs in the worker thread.
+*/
+void SslHandshakeWorker::startHandshake(qintptr socketDescriptor, QThread *targetThread)
+{
+    QSslSocket *socket = new QSslSocket(this);
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        qCWarning(dcWebServer()) << "Could not set socket descriptor. Rejecting connection.";
+        delete socket;
+        return;
+    }
+
+    QTimer *timer = new QTimer(socket);
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, [socket](){
+        qCDebug(dcWebServer()) << "TLS handshake with" << socket->peerAddress().toString() << "timed out. Dropping connection.";
+        socket->abort();
+        socket->deleteLater();
+    });
+
+    connect(socket, &QSslSocket::encrypted, this, [this, socket, timer, targetThread](){
+        delete timer;
+        socket->disconnect(this);
+        socket->setParent(nullptr);
+        socket->moveToThread(targetThread);
+        emit handshakeFinished(socket);
+    });
+    connect(socket, &QSslSocket::disconnected, this, [socket](){
+        qCDebug(dcWebServer()) << "Client disconnected during TLS handshake" << socket->peerAddress().toString();
+        socket->deleteLater();
+    });
+    typedef void (QSslSocket:: *sslErrorsSignal)(const QList<QSslError> &);
+    connect(socket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, [socket](const QList<QSslError> &errors) {
+        foreach (const QSslError &error, errors) {
+            qCWarning(dcWebServer()) << "SSL error during handshake with" << socket->peerAddress().toString() << error.errorString();
+        }
+    });
+
+    socket->setSslConfiguration(m_config);
+    socket->startServerEncryption();
+    timer->start(handshakeTimeout);
+}
+
+/*! Constructs a \l{SslHandshaker} using the given \a config with the given \a parent. This starts the worker thread. */
+SslHandshaker::SslHandshaker(const QSslConfiguration &config, QObject *parent) :
+    QObject(parent)
+{
+    qRegisterMetaType<qintptr>("qintptr");
+    qRegisterMetaType<QThread*>("QThread*");
+    qRegisterMetaType<QSslSocket*>("QSslSocket*");
+
+    m_thread = new QThread();
+    m_thread->setObjectName("SslHandshaker");
+    m_worker = new SslHandshakeWorker(config);
+    m_worker->moveToThread(m_thread);
+    connect(m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(m_worker, &SslHandshakeWorker::handshakeFinished, this, &SslHandshaker::connectionEncrypted);
+    m_thread->start();
+}
+
+/*! Destroys this \l{SslHandshaker}. Connections still in the handshake are dropped. */
+SslHandshaker::~SslHandshaker()
+{
+    m_thread->quit();
+    m_thread->wait();
+    delete m_thread;
+}
+
+/*! Starts the TLS handshake for the connection with the given \a socketDescriptor in the worker thread.
+    \l{connectionEncrypted()} will be emitted once it succeeded.
+*/
+void SslHandshaker::handleConnection(qintptr socketDescriptor)
+{
+    QMetaObject::invokeMethod(m_worker, "startHandshake", Qt::QueuedConnection, Q_ARG(qintptr, socketDescriptor), Q_ARG(QThread*, thread()));
+}
+
+}
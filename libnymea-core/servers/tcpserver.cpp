@@ -30,32 +30,54 @@
 
 /*!
     \class nymeaserver::SslServer
-    \brief This class represents the SSL server for nymead.
+    \brief This class represents the listening socket of the TCP server for nymead.
 
     \ingroup server
     \inmodule core
 
-    \inherits TcpServer
+    \inherits QTcpServer
 
-    The SSL server allows clients to connect to the JSON-RPC API over an encrypted SSL/TLS connection.
+    The SSL server accepts incoming connections and hands their socket descriptors to the \l{TcpServer},
+    which passes them on to one of its I/O threads.
 
     \sa WebSocketServer, TransportInterface, TcpServer
 */
 
-/*! \fn nymeaserver::SslServer::SslServer(bool sslEnabled, const QSslConfiguration &config, QObject *parent = nullptr)
-    Constructs a \l{SslServer} with the given \a sslEnabled, \a config and \a parent.
+/*! \fn nymeaserver::SslServer::SslServer(QObject *parent = nullptr)
+    Constructs a \l{SslServer} with the given \a parent.
 */
 
-/*! \fn void nymeaserver::SslServer::clientConnected(QSslSocket *socket);
-    This signal is emitted when a new SSL \a socket connected.
+/*! \fn void nymeaserver::SslServer::socketDescriptorAvailable(qintptr socketDescriptor);
+    This signal is emitted when a new connection with the given \a socketDescriptor has been accepted.
 */
 
-/*! \fn void nymeaserver::SslServer::clientDisconnected(QSslSocket *socket);
-    This signal is emitted when a \a socket disconnected.
+/*!
+    \class nymeaserver::TcpSocketWorker
+    \brief This class owns the client sockets of one I/O thread of the \l{TcpServer}.
+
+    \ingroup server
+    \inmodule core
+
+    The worker lives in its own thread. It runs the TLS handshakes, reads from and writes to its sockets
+    and talks to the \l{TcpServer} in the main thread through queued connections only.
+
+    \sa TcpServer
 */
 
-/*! \fn void nymeaserver::SslServer::dataAvailable(QSslSocket *socket, const QByteArray &data);
-    This signal is emitted when \a data from \a socket is available.
+/*! \fn void nymeaserver::TcpSocketWorker::clientConnected(const QUuid &clientId, const QString &peerAddress);
+    This signal is emitted when the client with the given \a clientId and \a peerAddress is connected and, if enabled, encrypted.
+*/
+
+/*! \fn void nymeaserver::TcpSocketWorker::clientDisconnected(const QUuid &clientId);
+    This signal is emitted when the client with the given \a clientId disconnected.
+*/
+
+/*! \fn void nymeaserver::TcpSocketWorker::dataAvailable(const QUuid &clientId, const QByteArray &data);
+    This signal is emitted when \a data from the client with the given \a clientId is available.
+*/
+
+/*! \fn void nymeaserver::TcpSocketWorker::pendingBytesChanged(const QUuid &clientId, qint64 pendingBytes);
+    This signal is emitted when the number of \a pendingBytes not yet written to the client with the given \a clientId changed.
 */
 
 
@@ -68,7 +90,8 @@
 
     \inherits TransportInterface
 
-    The TCP server allows clients to connect to the JSON-RPC API.
+    The TCP server allows clients to connect to the JSON-RPC API. Client sockets are spread over a small pool of
+    \l{TcpSocketWorker}{I/O threads}, so TLS handshakes and socket reads don't block the main event loop.
 
     \sa WebSocketServer, TransportInterface
 */
@@ -78,6 +101,12 @@
 
 #include <QDebug>
 
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
 namespace nymeaserver {
 
 /*! Constructs a \l{TcpServer} with the given \a configuration, \a sslConfiguration and \a parent.
@@ -89,6 +118,8 @@ TcpServer::TcpServer(const ServerConfiguration &configuration, const QSslConfigu
     m_server(nullptr),
     m_sslConfig(sslConfiguration)
 {
+    qRegisterMetaType<qintptr>("qintptr");
+    qRegisterMetaType<QList<QUuid>>("QList<QUuid>");
 }
 
 /*! Destructor of this \l{TcpServer}. */
@@ -104,49 +135,113 @@ QUrl TcpServer::serverUrl() const
     return QUrl(QString("%1://%2:%3").arg((configuration().sslEnabled ? "nymeas" : "nymea")).arg(configuration().address.toString()).arg(configuration().port));
 }
 
+/*! Enables TCP keepalive on the given \a socket. The kernel probes a connection after 60 seconds of
+    silence and drops it when 3 probes, 10 seconds apart, remain unanswered. Clients don't need to
+    send JSONRPC.KeepAlive calls for dead connections to be detected.
+*/
+void TcpServer::enableKeepAlive(QAbstractSocket *socket)
+{
+    socket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+#ifdef Q_OS_LINUX
+    int descriptor = static_cast<int>(socket->socketDescriptor());
+    int idle = 60;
+    int interval = 10;
+    int count = 3;
+    if (setsockopt(descriptor, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle)) != 0
+            || setsockopt(descriptor, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval)) != 0
+            || setsockopt(descriptor, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count)) != 0) {
+        qCWarning(dcTcpServer()) << "Could not set the TCP keepalive intervals for" << socket->peerAddress().toString();
+    }
+#endif
+}
+
 /*! Sending \a data to a list of \a clients.*/
 void TcpServer::sendData(const QList<QUuid> &clients, const QByteArray &data)
 {
-    foreach (const QUuid &client, clients) {
-        sendData(client, data);
-    }
+    writeToClients(clients, data + '\n');
 }
 
 void TcpServer::terminateClientConnection(const QUuid &clientId)
 {
-    QTcpSocket *client = m_clientList.value(clientId);
-    if (client) {
-        client->close();
+    TcpSocketWorker *worker = m_clientList.value(clientId);
+    if (worker) {
+        QMetaObject::invokeMethod(worker, "closeSocket", Qt::QueuedConnection, Q_ARG(QUuid, clientId));
     }
 }
 
 /*! Sending \a data to the client with the given \a clientId.*/
 void TcpServer::sendData(const QUuid &clientId, const QByteArray &data)
 {
-    QTcpSocket *client = nullptr;
-    client = m_clientList.value(clientId);
-    if (client) {
-        qCDebug(dcTcpServerTraffic()) << "Sending to client" << clientId.toString() << data;
-        client->write(data + '\n');
-    } else {
+    qCDebug(dcTcpServerTraffic()) << "Sending to client" << clientId.toString() << data;
+    writeToClient(clientId, data + '\n');
+}
+
+/*! Returns true. Binary messages are written to the socket as they are. */
+bool TcpServer::supportsBinaryData() const
+{
+    return true;
+}
+
+/*! Sending the binary \a data to the client with the given \a clientId.*/
+void TcpServer::sendBinaryData(const QUuid &clientId, const QByteArray &data)
+{
+    qCDebug(dcTcpServerTraffic()) << "Sending binary data to client" << clientId.toString() << data.size() << "bytes";
+    writeToClient(clientId, data);
+}
+
+/*! Sending the binary \a data to a list of \a clients.*/
+void TcpServer::sendBinaryData(const QList<QUuid> &clients, const QByteArray &data)
+{
+    writeToClients(clients, data);
+}
+
+/*! Returns the number of bytes still waiting to be written to the client with the given \a clientId.*/
+qint64 TcpServer::pendingBytes(const QUuid &clientId) const
+{
+    return m_pendingBytes.value(clientId);
+}
+
+void TcpServer::writeToClient(const QUuid &clientId, const QByteArray &data)
+{
+    TcpSocketWorker *worker = m_clientList.value(clientId);
+    if (!worker) {
         qCWarning(dcTcpServer()) << "Client" << clientId.toString() << "unknown to this transport";
+        return;
     }
+    // Count the data right away, the worker reports the real value once it has been written
+    m_pendingBytes[clientId] += data.size();
+    QMetaObject::invokeMethod(worker, "writeData", Qt::QueuedConnection, Q_ARG(QUuid, clientId), Q_ARG(QByteArray, data));
 }
 
-void TcpServer::onClientConnected(QSslSocket *socket)
+void TcpServer::writeToClients(const QList<QUuid> &clients, const QByteArray &data)
 {
-    QUuid clientId = QUuid::createUuid();
-    qCDebug(dcTcpServer()) << "New client connected:" << clientId.toString() << "(Remote address:" << socket->peerAddress().toString() << ")";
-    m_clientList.insert(clientId, socket);
-    emit clientConnected(clientId);
+    // One queued call per I/O thread, all sharing the same buffer
+    QHash<TcpSocketWorker *, QList<QUuid>> workerClients;
+    foreach (const QUuid &clientId, clients) {
+        TcpSocketWorker *worker = m_clientList.value(clientId);
+        if (!worker) {
+            qCWarning(dcTcpServer()) << "Client" << clientId.toString() << "unknown to this transport";
+            continue;
+        }
+        m_pendingBytes[clientId] += data.size();
+        workerClients[worker].append(clientId);
+    }
+    for (QHash<TcpSocketWorker *, QList<QUuid>>::const_iterator it = workerClients.constBegin(); it != workerClients.constEnd(); ++it) {
+        QMetaObject::invokeMethod(it.key(), "broadcastData", Qt::QueuedConnection, Q_ARG(QList<QUuid>, it.value()), Q_ARG(QByteArray, data));
+    }
 }
 
-void TcpServer::onClientDisconnected(QSslSocket *socket)
+void TcpServer::onSocketDescriptorAvailable(qintptr socketDescriptor)
 {
-    QUuid clientId = m_clientList.key(socket);
-    qCDebug(dcTcpServer()) << "Client disconnected:" << clientId.toString() << "(Remote address:" << socket->peerAddress().toString() << ")";
-    m_clientList.take(clientId);
-    emit clientDisconnected(clientId);
+    // Hand the connection to the least busy I/O thread
+    TcpSocketWorker *worker = m_workers.first();
+    foreach (TcpSocketWorker *candidate, m_workers) {
+        if (m_workerLoad.value(candidate) < m_workerLoad.value(worker)) {
+            worker = candidate;
+        }
+    }
+    m_workerLoad[worker]++;
+    QMetaObject::invokeMethod(worker, "addSocket", Qt::QueuedConnection, Q_ARG(QUuid, QUuid::createUuid()), Q_ARG(qintptr, socketDescriptor));
 }
 
 void TcpServer::onError(QAbstractSocket::SocketError error)
@@ -156,13 +251,6 @@ void TcpServer::onError(QAbstractSocket::SocketError error)
     stopServer();
 }
 
-void TcpServer::onDataAvailable(QSslSocket * socket, const QByteArray &data)
-{
-    qCDebug(dcTcpServerTraffic()) << "Emitting data available";
-    QUuid clientId = m_clientList.key(socket);
-    emit dataAvailable(clientId, data);
-}
-
 /*! Sets the name of this server to the given \a serverName. */
 void TcpServer::setServerName(const QString &serverName)
 {
@@ -175,7 +263,7 @@ void TcpServer::setServerName(const QString &serverName)
  */
 bool TcpServer::startServer()
 {
-    m_server = new SslServer(configuration().sslEnabled, m_sslConfig);
+    m_server = new SslServer();
     if(!m_server->listen(configuration().address, static_cast<quint16>(configuration().port))) {
         qCWarning(dcTcpServer()) << "Tcp server error: can not listen on" << configuration().address.toString() << configuration().port;
         delete m_server;
@@ -183,11 +271,51 @@ bool TcpServer::startServer()
         return false;
     }
 
-    connect(m_server, SIGNAL(clientConnected(QSslSocket *)), SLOT(onClientConnected(QSslSocket *)));
-    connect(m_server, SIGNAL(clientDisconnected(QSslSocket *)), SLOT(onClientDisconnected(QSslSocket *)));
-    connect(m_server, &SslServer::dataAvailable, this, &TcpServer::onDataAvailable);
+    connect(m_server, &SslServer::socketDescriptorAvailable, this, &TcpServer::onSocketDescriptorAvailable);
+
+    int threadCount = qBound(1, QThread::idealThreadCount(), 4);
+    for (int i = 0; i < threadCount; i++) {
+        QThread *thread = new QThread();
+        thread->setObjectName(QString("TcpServerIO%1").arg(i));
+        TcpSocketWorker *worker = new TcpSocketWorker(configuration().sslEnabled, m_sslConfig);
+        worker->moveToThread(thread);
+        connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+
+        connect(worker, &TcpSocketWorker::clientConnected, this, [this, worker](const QUuid &clientId, const QString &peerAddress){
+            qCDebug(dcTcpServer()) << "New client connected:" << clientId.toString() << "(Remote address:" << peerAddress << ")";
+            m_clientList.insert(clientId, worker);
+            emit clientConnected(clientId);
+        });
+        connect(worker, &TcpSocketWorker::clientDisconnected, this, [this, worker](const QUuid &clientId){
+            // Sockets torn down with a stopped worker are already cleaned up
+            if (!m_workerLoad.contains(worker)) {
+                return;
+            }
+            m_workerLoad[worker]--;
+            m_pendingBytes.remove(clientId);
+            // Connections failing the TLS handshake never made it into the client list
+            if (m_clientList.remove(clientId) > 0) {
+                qCDebug(dcTcpServer()) << "Client disconnected:" << clientId.toString();
+                emit clientDisconnected(clientId);
+            }
+        });
+        connect(worker, &TcpSocketWorker::dataAvailable, this, [this](const QUuid &clientId, const QByteArray &data){
+            qCDebug(dcTcpServerTraffic()) << "Emitting data available";
+            emit dataAvailable(clientId, data);
+        });
+        connect(worker, &TcpSocketWorker::pendingBytesChanged, this, [this](const QUuid &clientId, qint64 pendingBytes){
+            if (m_clientList.contains(clientId)) {
+                m_pendingBytes[clientId] = pendingBytes;
+            }
+        });
+
+        thread->start();
+        m_ioThreads.append(thread);
+        m_workers.append(worker);
+        m_workerLoad.insert(worker, 0);
+    }
 
-    qCDebug(dcTcpServer()) << "Started Tcp server" << serverUrl().toString();
+    qCDebug(dcTcpServer()) << "Started Tcp server" << serverUrl().toString() << "with" << threadCount << "I/O threads";
 
     return true;
 }
@@ -204,19 +332,66 @@ bool TcpServer::stopServer()
     m_server->close();
     m_server->deleteLater();
     m_server = nullptr;
+
+    // Quitting the threads deletes the workers and with them all client sockets
+    foreach (QThread *thread, m_ioThreads) {
+        thread->quit();
+        thread->wait();
+        delete thread;
+    }
+    m_ioThreads.clear();
+    m_workers.clear();
+    m_workerLoad.clear();
+
+    foreach (const QUuid &clientId, m_clientList.keys()) {
+        emit clientDisconnected(clientId);
+    }
+    m_clientList.clear();
+    m_pendingBytes.clear();
     return true;
 }
 
 /*! This method will be called if a new \a socketDescriptor is about to connect to this SslSocket. */
 void SslServer::incomingConnection(qintptr socketDescriptor)
 {
-    QSslSocket *sslSocket = new QSslSocket(this);
+    qCDebug(dcTcpServer()) << "New client socket connection:" << socketDescriptor;
+    emit socketDescriptorAvailable(socketDescriptor);
+}
+
+/*! Constructs a \l{TcpSocketWorker} with the given \a sslEnabled, \a config and \a parent. */
+TcpSocketWorker::TcpSocketWorker(bool sslEnabled, const QSslConfiguration &config, QObject *parent):
+    QObject(parent),
+    m_sslEnabled(sslEnabled),
+    m_config(config)
+{
+
+}
 
-    qCDebug(dcTcpServer()) << "New client socket connection:" << sslSocket;
+/*! Creates the socket for the client with the given \a clientId from the \a socketDescriptor. Runs in the I/O thread. */
+void TcpSocketWorker::addSocket(const QUuid &clientId, qintptr socketDescriptor)
+{
+    QSslSocket *sslSocket = new QSslSocket(this);
 
-    connect(sslSocket, &QSslSocket::encrypted, this, [this, sslSocket](){ emit clientConnected(sslSocket); });
-    connect(sslSocket, &QSslSocket::readyRead, this, &SslServer::onSocketReadyRead);
-    connect(sslSocket, &QSslSocket::disconnected, this, &SslServer::onClientDisconnected);
+    connect(sslSocket, &QSslSocket::encrypted, this, [this, clientId, sslSocket](){
+        emit clientConnected(clientId, sslSocket->peerAddress().toString());
+    });
+    connect(sslSocket, &QSslSocket::readyRead, this, [this, clientId, sslSocket](){
+        QByteArray data = sslSocket->readAll();
+        qCDebug(dcTcpServerTraffic()) << "Reading socket data:" << data;
+        emit dataAvailable(clientId, data);
+    });
+    connect(sslSocket, &QSslSocket::bytesWritten, this, [this, clientId, sslSocket](){
+        reportPendingBytes(clientId, sslSocket);
+    });
+    connect(sslSocket, &QSslSocket::encryptedBytesWritten, this, [this, clientId, sslSocket](){
+        reportPendingBytes(clientId, sslSocket);
+    });
+    connect(sslSocket, &QSslSocket::disconnected, this, [this, clientId, sslSocket](){
+        qCDebug(dcTcpServer()) << "Client socket disconnected:" << sslSocket;
+        m_sockets.remove(clientId);
+        emit clientDisconnected(clientId);
+        sslSocket->deleteLater();
+    });
     typedef void (QSslSocket:: *sslErrorsSignal)(const QList<QSslError> &);
     connect(sslSocket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, [](const QList<QSslError> &errors) {
         qCWarning(dcTcpServer()) << "SSL Errors happened in the client connections:";
@@ -228,31 +403,51 @@ void SslServer::incomingConnection(qintptr socketDescriptor)
     if (!sslSocket->setSocketDescriptor(socketDescriptor)) {
         qCWarning(dcTcpServer()) << "Failed to set SSL socket descriptor.";
         delete sslSocket;
+        emit clientDisconnected(clientId);
         return;
     }
+    TcpServer::enableKeepAlive(sslSocket);
+    m_sockets.insert(clientId, sslSocket);
     if (m_sslEnabled) {
         qCDebug(dcTcpServer()) << "Starting SSL encryption";
         sslSocket->setSslConfiguration(m_config);
         sslSocket->startServerEncryption();
     } else {
-        emit clientConnected(sslSocket);
+        emit clientConnected(clientId, sslSocket->peerAddress().toString());
+    }
+}
+
+/*! Writes \a data to the client with the given \a clientId. Runs in the I/O thread. */
+void TcpSocketWorker::writeData(const QUuid &clientId, const QByteArray &data)
+{
+    QSslSocket *socket = m_sockets.value(clientId);
+    if (!socket) {
+        return;
     }
+    socket->write(data);
+    reportPendingBytes(clientId, socket);
 }
 
-void SslServer::onClientDisconnected()
+/*! Writes the same \a data buffer to all the given \a clients handled by this worker. Runs in the I/O thread. */
+void TcpSocketWorker::broadcastData(const QList<QUuid> &clients, const QByteArray &data)
 {
-    QSslSocket *socket = static_cast<QSslSocket*>(sender());
-    qCDebug(dcTcpServer()) << "Client socket disconnected:" << socket;
-    emit clientDisconnected(socket);
-    socket->deleteLater();
+    foreach (const QUuid &clientId, clients) {
+        writeData(clientId, data);
+    }
+}
+
+/*! Closes the connection to the client with the given \a clientId. Runs in the I/O thread. */
+void TcpSocketWorker::closeSocket(const QUuid &clientId)
+{
+    QSslSocket *socket = m_sockets.value(clientId);
+    if (socket) {
+        socket->close();
+    }
 }
 
-void SslServer::onSocketReadyRead()
+void TcpSocketWorker::reportPendingBytes(const QUuid &clientId, QSslSocket *socket)
 {
-    QSslSocket *socket = static_cast<QSslSocket*>(sender());
-    QByteArray data = socket->readAll();
-    qCDebug(dcTcpServerTraffic()) << "Reading socket data:" << data;
-    emit dataAvailable(socket, data);
+    emit pendingBytesChanged(clientId, socket->bytesToWrite() + socket->encryptedBytesToWrite());
 }
 
 }
@@ -33,10 +33,10 @@
 
 #include <QObject>
 #include <QTcpServer>
-#include <QTcpSocket>
+#include <QSslSocket>
 #include <QNetworkInterface>
 #include <QUuid>
-#include <QTimer>
+#include <QThread>
 #include <QSslConfiguration>
 #include <QDebug>
 
@@ -50,29 +50,43 @@ class SslServer: public QTcpServer
 {
     Q_OBJECT
 public:
-    SslServer(bool sslEnabled, const QSslConfiguration &config, QObject *parent = nullptr):
-        QTcpServer(parent),
-        m_sslEnabled(sslEnabled),
-        m_config(config)
+    SslServer(QObject *parent = nullptr):
+        QTcpServer(parent)
     {
 
     }
 
 signals:
-    void clientConnected(QSslSocket *socket);
-    void clientDisconnected(QSslSocket *socket);
-    void dataAvailable(QSslSocket *socket, const QByteArray &data);
+    void socketDescriptorAvailable(qintptr socketDescriptor);
 
 protected:
     void incomingConnection(qintptr socketDescriptor) override;
+};
 
-private slots:
-    void onClientDisconnected();
-    void onSocketReadyRead();
+class TcpSocketWorker: public QObject
+{
+    Q_OBJECT
+public:
+    TcpSocketWorker(bool sslEnabled, const QSslConfiguration &config, QObject *parent = nullptr);
+
+public slots:
+    void addSocket(const QUuid &clientId, qintptr socketDescriptor);
+    void writeData(const QUuid &clientId, const QByteArray &data);
+    void broadcastData(const QList<QUuid> &clients, const QByteArray &data);
+    void closeSocket(const QUuid &clientId);
+
+signals:
+    void clientConnected(const QUuid &clientId, const QString &peerAddress);
+    void clientDisconnected(const QUuid &clientId);
+    void dataAvailable(const QUuid &clientId, const QByteArray &data);
+    void pendingBytesChanged(const QUuid &clientId, qint64 pendingBytes);
 
 private:
+    void reportPendingBytes(const QUuid &clientId, QSslSocket *socket);
+
     bool m_sslEnabled = false;
     QSslConfiguration m_config;
+    QHash<QUuid, QSslSocket *> m_sockets;
 };
 
 class TcpServer : public TransportInterface
@@ -84,23 +98,37 @@ public:
 
     QUrl serverUrl() const;
 
+    static void enableKeepAlive(QAbstractSocket *socket);
+
     void sendData(const QUuid &clientId, const QByteArray &data) override;
     void sendData(const QList<QUuid> &clients, const QByteArray &data) override;
 
+    bool supportsBinaryData() const override;
+    void sendBinaryData(const QUuid &clientId, const QByteArray &data) override;
+    void sendBinaryData(const QList<QUuid> &clients, const QByteArray &data) override;
+
+    qint64 pendingBytes(const QUuid &clientId) const override;
+
     void terminateClientConnection(const QUuid &clientId) override;
 
 private:
-    QTimer *m_timer = nullptr;
+    void writeToClient(const QUuid &clientId, const QByteArray &data);
+    void writeToClients(const QList<QUuid> &clients, const QByteArray &data);
 
     SslServer *m_server = nullptr;
-    QHash<QUuid, QTcpSocket *> m_clientList;
+
+    // Sockets, TLS handshakes and reads run in I/O threads, one worker per thread
+    QList<QThread *> m_ioThreads;
+    QList<TcpSocketWorker *> m_workers;
+    QHash<TcpSocketWorker *, int> m_workerLoad;
+
+    QHash<QUuid, TcpSocketWorker *> m_clientList;
+    QHash<QUuid, qint64> m_pendingBytes;
 
     QSslConfiguration m_sslConfig;
 
 private slots:
-    void onClientConnected(QSslSocket *socket);
-    void onClientDisconnected(QSslSocket *socket);
-    void onDataAvailable(QSslSocket *socket, const QByteArray &data);
+    void onSocketDescriptorAvailable(qintptr socketDescriptor);
     void onError(QAbstractSocket::SocketError error);
 
 public slots:
@@ -0,0 +1,145 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::TimeoutWheel
+    \brief Runs the idle timeouts of all connections on a single timer.
+
+    \ingroup server
+    \inmodule core
+
+    Entries are sorted into slots by their deadline, rounded up to the resolution of the wheel. Each
+    tick only visits the entries of one slot. Restarting an entry only moves its deadline, the entry
+    is moved to a later slot when its old slot comes up. The timer only runs while there are entries.
+*/
+
+#include "timeoutwheel.h"
+
+namespace nymeaserver {
+
+/*! Constructs a TimeoutWheel ticking every \a resolution milliseconds with \a slotCount slots. */
+TimeoutWheel::TimeoutWheel(int resolution, int slotCount, QObject *parent):
+    QObject(parent),
+    m_resolution(resolution)
+{
+    m_slots.resize(slotCount);
+    m_clock.start();
+    m_timer.setInterval(m_resolution);
+    connect(&m_timer, &QTimer::timeout, this, &TimeoutWheel::tick);
+}
+
+/*! Adds an entry calling \a callback once it hasn't been restarted for \a timeout milliseconds.
+    Returns the id of the entry. The callback is called at most one resolution late. */
+quint64 TimeoutWheel::add(int timeout, std::function<void()> callback)
+{
+    quint64 id = m_nextId++;
+    Entry entry;
+    entry.timeout = timeout;
+    entry.deadline = m_clock.elapsed() + timeout;
+    entry.callback = callback;
+    m_entries.insert(id, entry);
+    if (!m_timer.isActive()) {
+        m_currentTick = m_clock.elapsed() / m_resolution;
+        m_timer.start();
+    }
+    insert(id, entry.deadline);
+    return id;
+}
+
+/*! Restarts the timeout of the entry with the given \a id. */
+void TimeoutWheel::restart(quint64 id)
+{
+    QHash<quint64, Entry>::iterator it = m_entries.find(id);
+    if (it != m_entries.end()) {
+        it->deadline = m_clock.elapsed() + it->timeout;
+    }
+}
+
+/*! Removes the entry with the given \a id without calling its callback. */
+void TimeoutWheel::remove(quint64 id)
+{
+    m_entries.remove(id);
+}
+
+/*! Returns the number of entries in the wheel. */
+int TimeoutWheel::count() const
+{
+    return m_entries.count();
+}
+
+void TimeoutWheel::tick()
+{
+    qint64 now = m_clock.elapsed();
+    qint64 nowTick = now / m_resolution;
+
+    QList<std::function<void()>> expired;
+    // If the event loop was blocked, several slots are due. Going round once covers all of them.
+    qint64 lastTick = qMin(nowTick, m_currentTick + m_slots.count());
+    while (m_currentTick < lastTick) {
+        m_currentTick++;
+        QVector<quint64> slot;
+        slot.swap(m_slots[m_currentTick % m_slots.count()]);
+        foreach (quint64 id, slot) {
+            QHash<quint64, Entry>::iterator it = m_entries.find(id);
+            if (it == m_entries.end()) {
+                continue;
+            }
+            if (it->deadline <= now) {
+                expired.append(it->callback);
+                m_entries.erase(it);
+            } else {
+                insert(id, it->deadline);
+            }
+        }
+    }
+    m_currentTick = nowTick;
+
+    if (m_entries.isEmpty()) {
+        m_timer.stop();
+        for (int i = 0; i < m_slots.count(); i++) {
+            m_slots[i].clear();
+        }
+    }
+
+    // Callbacks may add and remove entries
+    foreach (const std::function<void()> &callback, expired) {
+        callback();
+    }
+}
+
+void TimeoutWheel::insert(quint64 id, qint64 deadline)
+{
+    // Round up, an entry must not be looked at before its deadline. Entries further away than a
+    // round of the wheel get looked at on the way and put back.
+    qint64 tick = qMax((deadline + m_resolution - 1) / m_resolution, m_currentTick + 1);
+    m_slots[tick % m_slots.count()].append(id);
+}
+
+}
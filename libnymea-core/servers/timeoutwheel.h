@@ -0,0 +1,83 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef TIMEOUTWHEEL_H
+#define TIMEOUTWHEEL_H
+
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include <functional>
+
+namespace nymeaserver {
+
+class TimeoutWheel : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TimeoutWheel(int resolution = 1000, int slotCount = 128, QObject *parent = nullptr);
+
+    quint64 add(int timeout, std::function<void()> callback);
+    void restart(quint64 id);
+    void remove(quint64 id);
+
+    int count() const;
+
+private slots:
+    void tick();
+
+private:
+    class Entry {
+    public:
+        qint64 deadline = 0;
+        int timeout = 0;
+        std::function<void()> callback;
+    };
+
+    void insert(quint64 id, qint64 deadline);
+
+    int m_resolution = 1000;
+    QElapsedTimer m_clock;
+    QTimer m_timer;
+    qint64 m_currentTick = 0;
+    quint64 m_nextId = 1;
+
+    QHash<quint64, Entry> m_entries;
+    // Entry ids by the tick they are looked at again. Removed and restarted entries stay in their
+    // slot until it comes up, that's what keeps restart() and remove() cheap.
+    QVector<QVector<quint64>> m_slots;
+};
+
+}
+
+#endif // TIMEOUTWHEEL_H
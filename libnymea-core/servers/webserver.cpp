@@ -54,6 +54,27 @@
     The URL for the secure HTTPS (TLS 1.2) REST API access to a \l{RestResource}:
     \code https://localhost:3333/api/v1/{RestResource}\endcode
 
+    Constrained clients which can't speak JSON-RPC can read states and execute actions with plain HTTP
+    requests. The requests are dispatched to the same handlers as the JSON-RPC API, the replies contain
+    the returns of the corresponding method without the JSON-RPC envelope:
+    \list
+        \li \tt{GET /api/v1/things/{thingId}/states} calls \tt Integrations.GetStateValues
+        \li \tt{GET /api/v1/things/{thingId}/states/{stateTypeId}} calls \tt Integrations.GetStateValue
+        \li \tt{POST /api/v1/things/{thingId}/actions/{actionTypeId}} calls \tt Integrations.ExecuteAction
+             with the action params as JSON list in the body
+    \endlist
+    State replies carry an ETag which changes whenever a state of the thing changes, so polling clients
+    can use \tt If-None-Match to get a 304 reply for unchanged states.
+
+    Clients which want to be notified about state changes without polling can open a Server-Sent Events
+    stream with \tt{GET /api/v1/events}. Each state change is sent as \tt Integrations.StateChanged event
+    with the params of the JSON-RPC notification as data. The events can be limited to certain things and
+    state types with the \tt thingId and \tt stateTypeId query items, each of which may be given multiple
+    times. As browsers can't add headers to event stream requests, the token can also be passed in the
+    \tt token query item. The API is available if
+    \tt restServerEnabled is set in the configuration of the web server. If authentication is enabled
+    for the web server, a token needs to be passed in an \tt{Authorization: Bearer} header.
+
     You can turn on the HTTPS server in the \tt WebServer section of the \tt /etc/nymea/nymead.conf file.
 
     \note For \tt HTTPS you need to have a certificate and configure it in the \tt SSL-configuration
@@ -87,7 +108,15 @@
 #include "httpreply.h"
 #include "httprequest.h"
 #include "debugserverhandler.h"
+#include "sslhandshaker.h"
+#include "httpeventstream.h"
+#include "timeoutwheel.h"
+#include "tcpserver.h"
 #include "version.h"
+#include "jsonrpc/jsonrpcserverimplementation.h"
+#include "jsonrpc/jsonwriter.h"
+#include "usermanager/usermanager.h"
+#include "integrations/thingmanager.h"
 
 #include <QJsonDocument>
 #include <QNetworkInterface>
@@ -100,17 +129,130 @@
 #include <QUuid>
 #include <QUrl>
 #include <QFile>
+#include <QCryptographicHash>
+#include <QRegularExpression>
+#include <QJsonParseError>
 
 namespace nymeaserver {
 
+// Files bigger than this are streamed from disk on every request instead of being kept in memory
+static const qint64 maxCachedAssetSize = 4 * 1024 * 1024;
+static const qint64 maxAssetCacheSize = 32 * 1024 * 1024;
+
+// Streamed payloads are read in chunks of this size, one more chunk is read as soon as the socket buffer drains below two chunks
+static const qint64 streamChunkSize = 64 * 1024;
+
+static QByteArray assetContentType(const QString &fileName)
+{
+    if (fileName.endsWith(".html")) {
+        return "text/html; charset=\"utf-8\";";
+    } else if (fileName.endsWith(".css")) {
+        return "text/css; charset=\"utf-8\";";
+    } else if (fileName.endsWith(".pdf")) {
+        return "application/pdf";
+    } else if (fileName.endsWith(".js")) {
+        return "text/javascript; charset=\"utf-8\";";
+    } else if (fileName.endsWith(".ttf")) {
+        return "application/x-font-ttf";
+    } else if (fileName.endsWith(".eot")) {
+        return "application/vnd.ms-fontobject";
+    } else if (fileName.endsWith(".woff")) {
+        return "application/x-font-woff";
+    } else if (fileName.endsWith(".jpg") || fileName.endsWith(".jpeg")) {
+        return "image/jpeg";
+    } else if (fileName.endsWith(".png") || fileName.endsWith(".PNG")) {
+        return "image/png";
+    } else if (fileName.endsWith(".ico")) {
+        return "image/x-icon";
+    } else if (fileName.endsWith(".svg")) {
+        return "image/svg+xml; charset=\"utf-8\";";
+    }
+    return QByteArray();
+}
+
+// HTTP header names are case insensitive, HttpRequest stores them as received
+static QByteArray requestHeader(const HttpRequest &request, const QByteArray &name)
+{
+    QHash<QByteArray, QByteArray> headers = request.rawHeaderList();
+    foreach (const QByteArray &key, headers.keys()) {
+        if (key.toLower() == name.toLower()) {
+            return headers.value(key);
+        }
+    }
+    return QByteArray();
+}
+
+static bool acceptsEncoding(const QByteArray &acceptEncoding, const QByteArray &encoding)
+{
+    foreach (const QByteArray &entry, acceptEncoding.split(',')) {
+        QList<QByteArray> tokens = entry.split(';');
+        if (tokens.first().trimmed().toLower() != encoding) {
+            continue;
+        }
+        // Honor an explicit "q=0" which forbids the encoding
+        for (int i = 1; i < tokens.count(); i++) {
+            QByteArray param = tokens.at(i).trimmed();
+            if (param.startsWith("q=") && param.mid(2).toDouble() == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+static bool etagMatches(const QByteArray &ifNoneMatch, const QByteArray &etag)
+{
+    foreach (QByteArray candidate, ifNoneMatch.split(',')) {
+        candidate = candidate.trimmed();
+        if (candidate == "*") {
+            return true;
+        }
+        // If-None-Match uses the weak comparison function (RFC 7232, section 3.2)
+        if (candidate.startsWith("W/")) {
+            candidate = candidate.mid(2);
+        }
+        if (candidate == etag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static QByteArray assetCacheControl(const QString &fileName)
+{
+    // Build tools put a content hash into the file names of versioned assets (i.e. main.3f2a9b1c.js).
+    // Those can never change under the same name, everything else has to be revalidated with the ETag.
+    static const QRegularExpression hashedName("[.-][0-9a-fA-F]{8,}\\.[^/]+$");
+    if (hashedName.match(fileName).hasMatch()) {
+        return "public, max-age=31536000, immutable";
+    }
+    return "no-cache";
+}
+
+static QByteArray readPrecompressedVariant(const QString &fileName, const QDateTime &lastModified)
+{
+    QFileInfo variantInfo(fileName);
+    // Ignore stale variants which are older than the original file
+    if (!variantInfo.exists() || variantInfo.lastModified() < lastModified) {
+        return QByteArray();
+    }
+    QFile variant(fileName);
+    if (!variant.open(QFile::ReadOnly)) {
+        return QByteArray();
+    }
+    return variant.readAll();
+}
+
 /*! Constructs a \l{WebServer} with the given \a configuration, \a sslConfiguration and \a parent.
  *
  *  \sa ServerManager, WebServerConfiguration
  */
-WebServer::WebServer(const WebServerConfiguration &configuration, const QSslConfiguration &sslConfiguration, QObject *parent) :
+WebServer::WebServer(const WebServerConfiguration &configuration, const QSslConfiguration &sslConfiguration, TimeoutWheel *timeoutWheel, QObject *parent) :
     QTcpServer(parent),
     m_configuration(configuration),
-    m_sslConfiguration(sslConfiguration)
+    m_sslConfiguration(sslConfiguration),
+    m_timeoutWheel(timeoutWheel)
 {
     if (QCoreApplication::instance()->organizationName() == "nymea-test") {
         m_configuration.publicFolder = QCoreApplication::applicationDirPath();
@@ -146,11 +288,42 @@ void WebServer::sendHttpReply(HttpReply *reply)
         return;
     }
 
+    // The client asked to close the connection after this reply
+    bool closeConnection = m_closeRequested.remove(socket);
+    if (closeConnection) {
+        reply->setHeader(HttpReply::ConnectionHeader, "close");
+    }
+
     // send raw data
     reply->packReply();
     qCDebug(dcWebServerTraffic()) << "Send reply to" << socket->peerAddress().toString() << reply;
     qCDebug(dcWebServer()) << "Respond" << socket->peerAddress().toString() << reply->httpStatusCode() << reply->httpReasonPhrase();
-    socket->write(reply->data());
+
+    // Write in-memory replies directly unless a streamed reply is still being sent on this connection
+    if (!reply->payloadDevice() && !m_outgoingData.contains(socket)) {
+        socket->write(reply->data());
+        if (closeConnection) {
+            socket->disconnectFromHost();
+        }
+        return;
+    }
+
+    OutgoingData outgoing;
+    outgoing.data = reply->data();
+    outgoing.remaining = reply->payloadDeviceSize();
+    outgoing.device = reply->takePayloadDevice();
+    if (outgoing.device && outgoing.device->isSequential()) {
+        connect(outgoing.device, &QIODevice::readyRead, this, [this, socket](){
+            writeOutgoingData(socket);
+        });
+    }
+    m_outgoingData[socket].append(outgoing);
+    if (closeConnection) {
+        OutgoingData closeMarker;
+        closeMarker.closeConnection = true;
+        m_outgoingData[socket].append(closeMarker);
+    }
+    writeOutgoingData(socket);
 }
 
 bool WebServer::verifyFile(QSslSocket *socket, const QString &fileName)
@@ -190,6 +363,240 @@ bool WebServer::verifyFile(QSslSocket *socket, const QString &fileName)
     return true;
 }
 
+bool WebServer::loadStaticAsset(const QString &fileName, StaticAsset *asset)
+{
+    QFileInfo fileInfo(fileName);
+    QString key = fileInfo.canonicalFilePath();
+
+    QHash<QString, StaticAsset>::iterator it = m_assetCache.find(key);
+    if (it != m_assetCache.end()) {
+        if (it->lastModified == fileInfo.lastModified() && it->size == fileInfo.size()) {
+            *asset = it.value();
+            return true;
+        }
+        qCDebug(dcWebServer()) << "File" << fileInfo.fileName() << "changed on disk. Reloading it.";
+        m_assetCacheSize -= it->data.size() + it->gzipData.size() + it->brotliData.size();
+        m_assetCache.erase(it);
+    }
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        qCWarning(dcWebServer()) << "Could not open file" << fileName << file.errorString();
+        return false;
+    }
+
+    asset->lastModified = fileInfo.lastModified();
+    asset->size = fileInfo.size();
+    asset->contentType = assetContentType(fileName);
+    asset->data = file.readAll();
+    asset->etag = "\"" + QCryptographicHash::hash(asset->data, QCryptographicHash::Sha1).toHex() + "\"";
+    asset->gzipData = readPrecompressedVariant(fileName + ".gz", asset->lastModified);
+    asset->brotliData = readPrecompressedVariant(fileName + ".br", asset->lastModified);
+
+    // Simple size bound: drop everything once the budget is exhausted
+    qint64 assetSize = asset->data.size() + asset->gzipData.size() + asset->brotliData.size();
+    if (m_assetCacheSize + assetSize > maxAssetCacheSize) {
+        qCDebug(dcWebServer()) << "Static asset cache full. Clearing" << m_assetCache.count() << "entries.";
+        m_assetCache.clear();
+        m_assetCacheSize = 0;
+    }
+
+    qCDebug(dcWebServer()) << "Load file" << fileName << "into the asset cache" << (asset->gzipData.isEmpty() ? "" : "(gzip)") << (asset->brotliData.isEmpty() ? "" : "(br)");
+    m_assetCache.insert(key, *asset);
+    m_assetCacheSize += assetSize;
+    return true;
+}
+
+HttpReply *WebServer::processFileRequest(const HttpRequest &request, const QString &fileName)
+{
+    // Big files are streamed from disk and never kept in memory
+    QFileInfo fileInfo(fileName);
+    if (fileInfo.size() > maxCachedAssetSize) {
+        QByteArray etag = "\"" + QByteArray::number(fileInfo.size(), 16) + "-" + QByteArray::number(fileInfo.lastModified().toMSecsSinceEpoch(), 16) + "\"";
+        HttpReply *reply = HttpReply::createSuccessReply();
+        reply->setHeader(HttpReply::CacheControlHeader, assetCacheControl(fileName));
+        reply->setHeader(HttpReply::ETagHeader, etag);
+        QByteArray contentType = assetContentType(fileName);
+        if (!contentType.isEmpty()) {
+            reply->setHeader(HttpReply::ContentTypeHeader, contentType);
+        }
+        if (etagMatches(requestHeader(request, "If-None-Match"), etag)) {
+            reply->setHttpStatusCode(HttpReply::NotModified);
+            reply->setPayload(QByteArray());
+            return reply;
+        }
+
+        QFile *file = new QFile(fileName);
+        if (!file->open(QFile::ReadOnly)) {
+            qCWarning(dcWebServer()) << "Could not open file" << fileName << file->errorString();
+            delete file;
+            delete reply;
+            return HttpReply::createErrorReply(HttpReply::Forbidden);
+        }
+        qCDebug(dcWebServer()) << "Stream file" << fileName << fileInfo.size() << "B";
+        reply->setPayloadDevice(file, file->size());
+        applyRequestRange(request, reply);
+        return reply;
+    }
+
+    StaticAsset asset;
+    if (!loadStaticAsset(fileName, &asset)) {
+        return HttpReply::createErrorReply(HttpReply::Forbidden);
+    }
+    return createAssetReply(request, asset, assetCacheControl(fileName));
+}
+
+HttpReply *WebServer::createAssetReply(const HttpRequest &request, const StaticAsset &asset, const QByteArray &cacheControl)
+{
+    // Pick the smallest representation the client is able to decode
+    QByteArray acceptEncoding = requestHeader(request, "Accept-Encoding");
+    QByteArray payload = asset.data;
+    QByteArray encoding;
+    if (!asset.brotliData.isEmpty() && acceptsEncoding(acceptEncoding, "br")) {
+        payload = asset.brotliData;
+        encoding = "br";
+    } else if (!asset.gzipData.isEmpty() && acceptsEncoding(acceptEncoding, "gzip")) {
+        payload = asset.gzipData;
+        encoding = "gzip";
+    }
+
+    // Each representation needs its own strong validator
+    QByteArray etag = asset.etag;
+    if (!encoding.isEmpty()) {
+        etag.insert(etag.length() - 1, "-" + encoding);
+    }
+
+    HttpReply *reply = HttpReply::createSuccessReply();
+    if (etagMatches(requestHeader(request, "If-None-Match"), etag)) {
+        reply->setHttpStatusCode(HttpReply::NotModified);
+        payload.clear();
+    }
+
+    reply->setHeader(HttpReply::CacheControlHeader, cacheControl);
+    reply->setHeader(HttpReply::ETagHeader, etag);
+    if (!asset.gzipData.isEmpty() || !asset.brotliData.isEmpty()) {
+        reply->setHeader(HttpReply::VaryHeader, "Accept-Encoding");
+    }
+    if (!encoding.isEmpty()) {
+        reply->setHeader(HttpReply::ContentEncodingHeader, encoding);
+    }
+    if (!asset.contentType.isEmpty()) {
+        reply->setHeader(HttpReply::ContentTypeHeader, asset.contentType);
+    }
+    reply->setPayload(payload);
+    return reply;
+}
+
+void WebServer::applyRequestRange(const HttpRequest &request, HttpReply *reply)
+{
+    // Ranges are only supported for complete replies streamed from random access devices
+    QIODevice *device = reply->payloadDevice();
+    if (reply->httpStatusCode() != HttpReply::Ok || !device || device->isSequential() || reply->payloadDeviceSize() < 0) {
+        return;
+    }
+
+    qint64 size = reply->payloadDeviceSize();
+    reply->setRawHeader("Accept-Ranges", "bytes");
+
+    // Only a single range is supported, anything else falls back to sending the whole resource (RFC 7233, section 3.1)
+    QByteArray range = requestHeader(request, "Range").trimmed();
+    if (!range.startsWith("bytes=") || range.contains(',')) {
+        return;
+    }
+
+    QList<QByteArray> bounds = range.mid(6).split('-');
+    if (bounds.count() != 2) {
+        return;
+    }
+
+    bool startOk = false;
+    bool endOk = false;
+    qint64 start = bounds.at(0).trimmed().toLongLong(&startOk);
+    qint64 end = bounds.at(1).trimmed().toLongLong(&endOk);
+    if (!startOk && endOk) {
+        // Suffix range selecting the last bytes ("bytes=-500")
+        start = qMax(Q_INT64_C(0), size - end);
+        end = size - 1;
+    } else if (startOk && !endOk && bounds.at(1).trimmed().isEmpty()) {
+        // Open range ("bytes=500-")
+        end = size - 1;
+    } else if (!startOk || !endOk || end < start) {
+        return;
+    }
+    end = qMin(end, size - 1);
+
+    if (start >= size || end < start) {
+        reply->setHttpStatusCode(HttpReply::RangeNotSatisfiable);
+        reply->setRawHeader("Content-Range", "bytes */" + QByteArray::number(size));
+        reply->setPayload(QByteArray());
+        return;
+    }
+
+    qCDebug(dcWebServer()) << "Sending range" << start << "-" << end << "of" << size << "B";
+    reply->setHttpStatusCode(HttpReply::PartialContent);
+    reply->setRawHeader("Content-Range", "bytes " + QByteArray::number(start) + "-" + QByteArray::number(end) + "/" + QByteArray::number(size));
+    reply->setPayloadDeviceRange(start, end - start + 1);
+}
+
+void WebServer::writeOutgoingData(QSslSocket *socket)
+{
+    QList<OutgoingData> &queue = m_outgoingData[socket];
+    while (!queue.isEmpty() && socket->bytesToWrite() < 2 * streamChunkSize) {
+        OutgoingData &outgoing = queue.first();
+        if (!outgoing.data.isEmpty()) {
+            socket->write(outgoing.data);
+            outgoing.data.clear();
+            continue;
+        }
+
+        if (outgoing.closeConnection) {
+            m_outgoingData.remove(socket);
+            socket->disconnectFromHost();
+            return;
+        }
+
+        if (!outgoing.device) {
+            queue.removeFirst();
+            continue;
+        }
+
+        bool chunked = outgoing.remaining < 0;
+        QByteArray chunk = outgoing.device->read(chunked ? streamChunkSize : qMin(streamChunkSize, outgoing.remaining));
+        if (chunked) {
+            if (!chunk.isEmpty()) {
+                socket->write(QByteArray::number(chunk.size(), 16) + "\r\n" + chunk + "\r\n");
+                continue;
+            }
+            if (!outgoing.device->atEnd()) {
+                // A sequential device without data right now, continue on readyRead
+                break;
+            }
+            socket->write("0\r\n\r\n");
+        } else {
+            if (chunk.isEmpty() && outgoing.remaining > 0) {
+                // The promised Content-Length can't be satisfied any more, the client has to notice by the closed connection
+                qCWarning(dcWebServer()) << "Payload device ended before" << outgoing.remaining << "remaining bytes were sent. Closing connection.";
+                outgoing.device->deleteLater();
+                queue.removeFirst();
+                socket->close();
+                return;
+            }
+            socket->write(chunk);
+            outgoing.remaining -= chunk.size();
+            if (outgoing.remaining > 0) {
+                continue;
+            }
+        }
+
+        outgoing.device->deleteLater();
+        queue.removeFirst();
+    }
+
+    if (queue.isEmpty()) {
+        m_outgoingData.remove(socket);
+    }
+}
+
 QString WebServer::fileName(const QString &query)
 {
     QString fileName;
@@ -229,6 +636,12 @@ void WebServer::incomingConnection(qintptr socketDescriptor)
     if (!m_enabled)
         return;
 
+    // TLS handshakes are expensive, keep them away from the main event loop
+    if (m_sslHandshaker) {
+        m_sslHandshaker->handleConnection(socketDescriptor);
+        return;
+    }
+
     QSslSocket *socket = new QSslSocket();
     if (!socket->setSocketDescriptor(socketDescriptor)) {
         qCWarning(dcWebServer()) << "Could not set socket descriptor. Rejecting connection.";
@@ -237,6 +650,13 @@ void WebServer::incomingConnection(qintptr socketDescriptor)
         return;
     }
 
+    setupConnection(socket);
+}
+
+void WebServer::setupConnection(QSslSocket *socket)
+{
+    TcpServer::enableKeepAlive(socket);
+
     // check webserver client
     bool existing = false;
     foreach (WebServerClient *client, m_webServerClients) {
@@ -254,7 +674,7 @@ void WebServer::incomingConnection(qintptr socketDescriptor)
     }
 
     if (!existing) {
-        WebServerClient *webServerClient = new WebServerClient(socket->peerAddress());
+        WebServerClient *webServerClient = new WebServerClient(socket->peerAddress(), m_timeoutWheel);
         webServerClient->addConnection(socket);
         m_webServerClients.append(webServerClient);
     }
@@ -265,20 +685,17 @@ void WebServer::incomingConnection(qintptr socketDescriptor)
 
     qCDebug(dcWebServer()).noquote() << QString("Webserver client %1:%2 connected").arg(socket->peerAddress().toString()).arg(socket->peerPort());
 
-    if (m_configuration.sslEnabled) {
-        // configure client connection
-        socket->setSslConfiguration(m_sslConfiguration);
-        connect(socket, SIGNAL(encrypted()), this, SLOT(onEncrypted()));
-        socket->startServerEncryption();
-        // wait for encrypted connection before continue with this client
-        return;
-    }
-
     connect(socket, SIGNAL(readyRead()), this, SLOT(readClient()));
     connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten()));
     connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onError(QAbstractSocket::SocketError)));
 
     emit clientConnected(clientId);
+
+    // The request might have arrived together with the end of the handshake, before we were listening
+    if (socket->bytesAvailable() > 0) {
+        processClientData(socket);
+    }
 }
 
 void WebServer::readClient()
@@ -286,7 +703,11 @@ void WebServer::readClient()
     if (!m_enabled)
         return;
 
-    QSslSocket *socket = qobject_cast<QSslSocket *>(sender());
+    processClientData(qobject_cast<QSslSocket *>(sender()));
+}
+
+void WebServer::processClientData(QSslSocket *socket)
+{
     QUuid clientId = m_clientList.key(socket);
 
     // Check client
@@ -296,23 +717,40 @@ void WebServer::readClient()
         return;
     }
 
-    // Read HTTP request
-    QByteArray data = socket->readAll();
+    // Feed the data into the parser of this connection, it continues where the last read stopped
+    QHash<QSslSocket *, HttpRequest>::iterator it = m_incompleteRequests.find(socket);
+    if (it == m_incompleteRequests.end())
+        it = m_incompleteRequests.insert(socket, HttpRequest());
 
-    HttpRequest request;
-    if (m_incompleteRequests.contains(socket)) {
-        request = m_incompleteRequests.take(socket);
-        request.appendData(data);
-    } else {
-        request = HttpRequest(data);
-    }
+    it->appendData(socket->readAll());
 
-    // Check if the request is complete
-    if (!request.isComplete()) {
-        m_incompleteRequests.insert(socket, request);
-        return;
+    // Handle all requests which were pipelined in this read
+    while (it != m_incompleteRequests.end() && it->isComplete()) {
+        HttpRequest completeRequest = std::move(it.value());
+        bool valid = completeRequest.isValid();
+        bool keepAlive = valid && completeRequest.keepAlive();
+
+        it.value() = HttpRequest();
+        if (valid && keepAlive) {
+            it->appendData(completeRequest.takeTrailingData());
+        } else {
+            // Invalid requests leave the stream in an undefined state, don't try to read anything after them
+            m_incompleteRequests.erase(it);
+            m_closeRequested.insert(socket);
+        }
+
+        processRequest(socket, clientId, completeRequest);
+
+        if (!keepAlive)
+            return;
+
+        // Processing the request might have closed the connection
+        it = m_incompleteRequests.find(socket);
     }
+}
 
+void WebServer::processRequest(QSslSocket *socket, const QUuid &clientId, const HttpRequest &request)
+{
     qCDebug(dcWebServerTraffic()) << "Received request from" << clientId.toString() << socket->peerAddress().toString() << request;
 
     // Check if the request is valid
@@ -387,6 +825,7 @@ void WebServer::readClient()
                 connect(reply, &HttpReply::finished, this, &WebServer::onAsyncReplyFinished);
                 reply->startWait();
             } else {
+                applyRequestRange(request, reply);
                 sendHttpReply(reply);
                 reply->deleteLater();
             }
@@ -401,12 +840,16 @@ void WebServer::readClient()
         }
     }
 
+    // Check API call
+    if (m_configuration.restServerEnabled && request.url().path().startsWith("/api/v1/")) {
+        processApiRequest(clientId, request);
+        return;
+    }
+
     // Check server.xml call
     if (request.url().path() == "/server.xml" && request.method() == HttpRequest::Get) {
         qCDebug(dcWebServer()) << "Server XML request call";
-        HttpReply *reply = HttpReply::createSuccessReply();
-        reply->setHeader(HttpReply::ContentTypeHeader, "text/xml");
-        reply->setPayload(createServerXmlDocument(socket->localAddress()));
+        HttpReply *reply = createAssetReply(request, serverXmlAsset(socket->localAddress()), "no-cache");
         reply->setClientId(clientId);
         sendHttpReply(reply);
         reply->deleteLater();
@@ -431,42 +874,11 @@ void WebServer::readClient()
         if (!verifyFile(socket, path))
             return;
 
-        QFile file(path);
-        if (file.open(QFile::ReadOnly)) {
-            qCDebug(dcWebServer()) << "Load file" << file.fileName();
-            HttpReply *reply = HttpReply::createSuccessReply();
-
-            // Check content type
-            if (file.fileName().endsWith(".html")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "text/html; charset=\"utf-8\";");
-            } else if (file.fileName().endsWith(".css")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "text/css; charset=\"utf-8\";");
-            } else if (file.fileName().endsWith(".pdf")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "application/pdf");
-            } else if (file.fileName().endsWith(".js")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "text/javascript; charset=\"utf-8\";");
-            } else if (file.fileName().endsWith(".ttf")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "application/x-font-ttf");
-            } else if (file.fileName().endsWith(".eot")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "application/vnd.ms-fontobject");
-            } else if (file.fileName().endsWith(".woff")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "application/x-font-woff");
-            } else if (file.fileName().endsWith(".jpg") || file.fileName().endsWith(".jpeg")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "image/jpeg");
-            } else if (file.fileName().endsWith(".png") || file.fileName().endsWith(".PNG")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "image/png");
-            } else if (file.fileName().endsWith(".ico")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "image/x-icon");
-            } else if (file.fileName().endsWith(".svg")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "image/svg+xml; charset=\"utf-8\";");
-            }
-
-            reply->setPayload(file.readAll());
-            reply->setClientId(clientId);
-            sendHttpReply(reply);
-            reply->deleteLater();
-            return;
-        }
+        HttpReply *reply = processFileRequest(request, path);
+        reply->setClientId(clientId);
+        sendHttpReply(reply);
+        reply->deleteLater();
+        return;
     }
 
     // Reject everything else...
@@ -499,20 +911,44 @@ void WebServer::onDisconnected()
     QUuid clientId = m_clientList.key(socket);
     m_clientList.remove(clientId);
     m_incompleteRequests.remove(socket);
+    m_closeRequested.remove(socket);
+    foreach (const OutgoingData &outgoing, m_outgoingData.take(socket)) {
+        if (outgoing.device) {
+            outgoing.device->deleteLater();
+        }
+    }
     emit clientDisconnected(clientId);
 
     socket->deleteLater();
 }
 
-void WebServer::onEncrypted()
+void WebServer::onBytesWritten()
 {
     QSslSocket* socket = static_cast<QSslSocket *>(sender());
-    qCDebug(dcWebServer()).noquote() << QString("Encrypted connection %1:%2 successfully established.").arg(socket->peerAddress().toString()).arg(socket->peerPort());
-    connect(socket, SIGNAL(readyRead()), this, SLOT(readClient()));
-    connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
-    connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onError(QAbstractSocket::SocketError)));
+    if (!m_outgoingData.contains(socket)) {
+        return;
+    }
+
+    // Keep the connection alive as long as the client is receiving data
+    foreach (WebServerClient *webserverClient, m_webServerClients) {
+        if (webserverClient->address() == socket->peerAddress()) {
+            webserverClient->resetTimout(socket);
+            break;
+        }
+    }
+
+    writeOutgoingData(socket);
+}
+
+void WebServer::onConnectionEncrypted(QSslSocket *socket)
+{
+    if (!m_enabled) {
+        delete socket;
+        return;
+    }
 
-    emit clientConnected(m_clientList.key(socket));
+    qCDebug(dcWebServer()).noquote() << QString("Encrypted connection %1:%2 successfully established.").arg(socket->peerAddress().toString()).arg(socket->peerPort());
+    setupConnection(socket);
 }
 
 void WebServer::onError(QAbstractSocket::SocketError error)
@@ -550,17 +986,26 @@ void WebServer::onAsyncReplyFinished()
 void WebServer::setConfiguration(const WebServerConfiguration &config)
 {
     m_configuration = config;
+    m_serverXmlCache.clear();
 }
 
 /*! Sets the server name to the given \a serverName. */
 void WebServer::setServerName(const QString &serverName)
 {
     m_serverName = serverName;
+    m_serverXmlCache.clear();
 }
 
 /*! Returns true if this \l{WebServer} started successfully. */
 bool WebServer::startServer()
 {
+    if (m_configuration.sslEnabled && !m_sslHandshaker) {
+        m_sslHandshaker = new SslHandshaker(m_sslConfiguration, this);
+        connect(m_sslHandshaker, &SslHandshaker::connectionEncrypted, this, &WebServer::onConnectionEncrypted);
+    }
+
+    m_serverXmlCache.clear();
+
     if (!listen(m_configuration.address, static_cast<quint16>(m_configuration.port))) {
         qCWarning(dcWebServer()) << "Webserver could not listen on" << serverUrl().toString() << errorString();
         m_enabled = false;
@@ -581,6 +1026,11 @@ bool WebServer::stopServer()
 
     close();
     m_enabled = false;
+
+    // Drops all connections still in the handshake
+    delete m_sslHandshaker;
+    m_sslHandshaker = nullptr;
+
     qCDebug(dcWebServer()) << "Webserver closed.";
     return true;
 }
@@ -591,6 +1041,283 @@ WebServerConfiguration WebServer::configuration() const
 }
 
 
+static HttpReply *createApiReply(HttpReply::HttpStatusCode statusCode, const QVariantMap &data)
+{
+    HttpReply *reply = HttpReply::createSuccessReply();
+    reply->setHttpStatusCode(statusCode);
+    reply->setHeader(HttpReply::ContentTypeHeader, "application/json; charset=\"utf-8\";");
+    reply->setPayload(JsonWriter::toJson(data));
+    return reply;
+}
+
+static HttpReply *createApiErrorReply(HttpReply::HttpStatusCode statusCode, const QString &error)
+{
+    QVariantMap data;
+    data.insert("error", error);
+    return createApiReply(statusCode, data);
+}
+
+static HttpReply::HttpStatusCode apiStatusCode(const QVariantMap &returns)
+{
+    QString thingError = returns.value("thingError").toString();
+    if (thingError.isEmpty() || thingError == "ThingErrorNoError") {
+        return HttpReply::Ok;
+    }
+    if (thingError.endsWith("NotFound")) {
+        return HttpReply::NotFound;
+    }
+    if (thingError == "ThingErrorMissingParameter" || thingError == "ThingErrorInvalidParameter" || thingError == "ThingErrorParameterNotWritable") {
+        return HttpReply::BadRequest;
+    }
+    if (thingError == "ThingErrorTimeout") {
+        return HttpReply::GatewayTimeout;
+    }
+    return HttpReply::Conflict;
+}
+
+// Changes whenever a state of the thing changes. The prefix keeps tags apart across restarts.
+QByteArray WebServer::thingStateEtag(const QUuid &thingId)
+{
+    if (m_thingStateEtagPrefix.isEmpty()) {
+        m_thingStateEtagPrefix = QUuid::createUuid().toRfc4122().toHex().left(8);
+        ThingManager *thingManager = NymeaCore::instance()->thingManager();
+        connect(thingManager, &ThingManager::thingStateChanged, this, [this](Thing *thing){
+            m_thingStateVersions[thing->id()]++;
+        });
+        connect(thingManager, &ThingManager::thingRemoved, this, [this](const ThingId &thingId){
+            m_thingStateVersions[thingId]++;
+        });
+    }
+    return "\"" + m_thingStateEtagPrefix + "-" + QByteArray::number(m_thingStateVersions.value(thingId)) + "\"";
+}
+
+void WebServer::processApiRequest(const QUuid &clientId, const HttpRequest &request)
+{
+    HttpReply *reply = nullptr;
+
+    // Same rules as for JSON-RPC transports requiring authentication
+    if (m_configuration.authenticationEnabled) {
+        QByteArray authorization = requestHeader(request, "Authorization").trimmed();
+        QByteArray token = authorization.startsWith("Bearer ") ? authorization.mid(7).trimmed() : QByteArray();
+        // Browsers can't set headers for event streams
+        if (token.isEmpty()) {
+            token = request.urlQuery().queryItemValue("token", QUrl::FullyDecoded).toUtf8();
+        }
+        UserManager *userManager = NymeaCore::instance()->userManager();
+        if (userManager->initRequired() || token.isEmpty() || !userManager->verifyToken(token)) {
+            qCDebug(dcWebServer()) << "API request without valid token";
+            reply = createApiErrorReply(HttpReply::Unauthorized, "Forbidden: Invalid token.");
+            reply->setRawHeader("WWW-Authenticate", "Bearer");
+            reply->setClientId(clientId);
+            sendHttpReply(reply);
+            reply->deleteLater();
+            return;
+        }
+    }
+
+    // api/v1/things/{thingId}/states[/{stateTypeId}] or api/v1/things/{thingId}/actions/{actionTypeId}
+    QStringList path = request.url().path().split('/', QString::SkipEmptyParts);
+
+    // api/v1/events
+    if (path.count() == 3 && path.at(2) == "events") {
+        if (request.method() != HttpRequest::Get) {
+            reply = createApiErrorReply(HttpReply::MethodNotAllowed, "Method not allowed");
+            reply->setHeader(HttpReply::AllowHeader, "GET");
+        } else {
+            reply = createEventStreamReply(request);
+        }
+        reply->setClientId(clientId);
+        sendHttpReply(reply);
+        reply->deleteLater();
+        return;
+    }
+
+    QUuid thingId = path.count() > 3 ? QUuid(path.at(3)) : QUuid();
+    QString method;
+    QVariantMap params;
+    HttpRequest::RequestMethod allowedMethod = HttpRequest::Get;
+    if (path.count() < 5 || path.count() > 6 || path.at(2) != "things" || thingId.isNull()) {
+        reply = createApiErrorReply(HttpReply::NotFound, "No such resource");
+    } else if (path.at(4) == "states" && path.count() == 5) {
+        method = "Integrations.GetStateValues";
+        params.insert("thingId", thingId.toString());
+    } else if (path.at(4) == "states" && !QUuid(path.at(5)).isNull()) {
+        method = "Integrations.GetStateValue";
+        params.insert("thingId", thingId.toString());
+        params.insert("stateTypeId", QUuid(path.at(5)).toString());
+    } else if (path.at(4) == "actions" && path.count() == 6 && !QUuid(path.at(5)).isNull()) {
+        allowedMethod = HttpRequest::Post;
+        method = "Integrations.ExecuteAction";
+        params.insert("thingId", thingId.toString());
+        params.insert("actionTypeId", QUuid(path.at(5)).toString());
+        if (!request.payload().trimmed().isEmpty()) {
+            QJsonParseError error;
+            QJsonDocument jsonDoc = QJsonDocument::fromJson(request.payload(), &error);
+            if (error.error != QJsonParseError::NoError || !jsonDoc.isArray()) {
+                reply = createApiErrorReply(HttpReply::BadRequest, "The body must contain a JSON list of action params");
+            } else {
+                params.insert("params", jsonDoc.toVariant());
+            }
+        }
+    } else {
+        reply = createApiErrorReply(HttpReply::NotFound, "No such resource");
+    }
+
+    if (!reply && request.method() != allowedMethod) {
+        reply = createApiErrorReply(HttpReply::MethodNotAllowed, "Method not allowed");
+        reply->setHeader(HttpReply::AllowHeader, allowedMethod == HttpRequest::Get ? "GET" : "POST");
+    }
+
+    // Unchanged states are answered without calling into the handler at all
+    QByteArray etag;
+    if (!reply && allowedMethod == HttpRequest::Get) {
+        etag = thingStateEtag(thingId);
+        if (etagMatches(requestHeader(request, "If-None-Match"), etag)) {
+            reply = HttpReply::createSuccessReply();
+            reply->setHttpStatusCode(HttpReply::NotModified);
+            reply->setHeader(HttpReply::ETagHeader, etag);
+            reply->setPayload(QByteArray());
+        }
+    }
+
+    JsonReply *jsonReply = nullptr;
+    if (!reply) {
+        QString error;
+        JsonContext context(clientId, NymeaCore::instance()->configuration()->locale());
+        jsonReply = NymeaCore::instance()->jsonRPCServer()->invokeMethod(method, params, context, &error);
+        if (!jsonReply) {
+            reply = createApiErrorReply(HttpReply::BadRequest, error);
+        }
+    }
+
+    if (reply) {
+        reply->setClientId(clientId);
+        sendHttpReply(reply);
+        reply->deleteLater();
+        return;
+    }
+
+    if (jsonReply->type() == JsonReply::TypeSync) {
+        reply = createApiReply(apiStatusCode(jsonReply->data()), jsonReply->data());
+        JsonReply::release(jsonReply);
+        if (!etag.isEmpty()) {
+            reply->setHeader(HttpReply::ETagHeader, etag);
+            reply->setHeader(HttpReply::CacheControlHeader, "no-cache");
+        }
+        reply->setClientId(clientId);
+        sendHttpReply(reply);
+        reply->deleteLater();
+        return;
+    }
+
+    // The HTTP reply times out on its own, the JSON reply must not touch it afterwards
+    reply = HttpReply::createAsyncReply();
+    reply->setClientId(clientId);
+    reply->setHeader(HttpReply::ContentTypeHeader, "application/json; charset=\"utf-8\";");
+    connect(reply, &HttpReply::finished, this, &WebServer::onAsyncReplyFinished);
+    connect(jsonReply, &JsonReply::finished, reply, [reply, jsonReply](){
+        if (jsonReply->timedOut()) {
+            reply->setHttpStatusCode(HttpReply::GatewayTimeout);
+            reply->setPayload(QJsonDocument::fromVariant(QVariantMap({{"error", "Command timed out"}})).toJson(QJsonDocument::Compact));
+        } else {
+            reply->setHttpStatusCode(apiStatusCode(jsonReply->data()));
+            reply->setPayload(JsonWriter::toJson(jsonReply->data()));
+        }
+        reply->finished();
+    });
+    connect(jsonReply, &JsonReply::finished, jsonReply, &JsonReply::deleteLater);
+    reply->startWait();
+    jsonReply->startWait();
+}
+
+HttpReply *WebServer::createEventStreamReply(const HttpRequest &request)
+{
+    QSet<QUuid> thingIds;
+    foreach (const QString &thingId, request.urlQuery().allQueryItemValues("thingId")) {
+        thingIds.insert(QUuid(thingId));
+    }
+    QSet<QUuid> stateTypeIds;
+    foreach (const QString &stateTypeId, request.urlQuery().allQueryItemValues("stateTypeId")) {
+        stateTypeIds.insert(QUuid(stateTypeId));
+    }
+    if (thingIds.contains(QUuid()) || stateTypeIds.contains(QUuid())) {
+        return createApiErrorReply(HttpReply::BadRequest, "Invalid thingId or stateTypeId filter");
+    }
+
+    if (!m_eventStreamKeepAliveTimer) {
+        connect(NymeaCore::instance(), &NymeaCore::thingStateChanged, this, &WebServer::onThingStateChanged);
+        m_eventStreamKeepAliveTimer = new QTimer(this);
+        m_eventStreamKeepAliveTimer->setInterval(25000);
+        connect(m_eventStreamKeepAliveTimer, &QTimer::timeout, this, [this](){
+            foreach (HttpEventStream *stream, m_eventStreams) {
+                stream->sendKeepAlive();
+            }
+        });
+    }
+    m_eventStreamKeepAliveTimer->start();
+
+    // The stream is owned by the reply and deleted with the connection
+    HttpEventStream *stream = new HttpEventStream(thingIds, stateTypeIds);
+    m_eventStreams.append(stream);
+    connect(stream, &QObject::destroyed, this, [this, stream](){
+        m_eventStreams.removeAll(stream);
+        if (m_eventStreams.isEmpty()) {
+            m_eventStreamKeepAliveTimer->stop();
+        }
+    });
+    qCDebug(dcWebServer()) << "Opened event stream. Active streams:" << m_eventStreams.count();
+
+    HttpReply *reply = HttpReply::createSuccessReply();
+    reply->setHeader(HttpReply::ContentTypeHeader, "text/event-stream");
+    reply->setHeader(HttpReply::CacheControlHeader, "no-cache");
+    reply->setPayloadDevice(stream);
+    return reply;
+}
+
+void WebServer::onThingStateChanged(Thing *thing, const QUuid &stateTypeId, const QVariant &value, const QVariant &minValue, const QVariant &maxValue)
+{
+    // Serialized once for all streams, and only if anyone is interested
+    QByteArray event;
+    QString coalesceKey;
+    foreach (HttpEventStream *stream, m_eventStreams) {
+        if (!stream->accepts(thing->id(), stateTypeId)) {
+            continue;
+        }
+        if (event.isEmpty()) {
+            QVariantMap params;
+            params.insert("thingId", thing->id());
+            params.insert("stateTypeId", stateTypeId);
+            params.insert("value", value);
+            params.insert("minValue", minValue);
+            params.insert("maxValue", maxValue);
+            event = "event: Integrations.StateChanged\ndata: " + QJsonDocument::fromVariant(params).toJson(QJsonDocument::Compact) + "\n\n";
+            coalesceKey = thing->id().toString() + stateTypeId.toString();
+        }
+        stream->postEvent(event, coalesceKey);
+    }
+}
+
+/* The description document only depends on the address of the interface it is requested on,
+ * the server configuration, name and uuid. Name and configuration changes clear the cache, the
+ * uuid is fixed for the lifetime of the server.
+ */
+WebServer::StaticAsset WebServer::serverXmlAsset(const QHostAddress &address)
+{
+    QHash<QHostAddress, StaticAsset>::const_iterator it = m_serverXmlCache.constFind(address);
+    if (it != m_serverXmlCache.constEnd()) {
+        return it.value();
+    }
+
+    StaticAsset asset;
+    asset.contentType = "text/xml";
+    asset.data = createServerXmlDocument(address);
+    asset.size = asset.data.size();
+    asset.lastModified = QDateTime::currentDateTimeUtc();
+    asset.etag = "\"" + QCryptographicHash::hash(asset.data, QCryptographicHash::Sha1).toHex() + "\"";
+    m_serverXmlCache.insert(address, asset);
+    return asset;
+}
+
 QByteArray WebServer::createServerXmlDocument(QHostAddress address)
 {
     QByteArray uuid = NymeaCore::instance()->configuration()->serverUuid().toString().remove(QRegExp("[{}]")).toUtf8();
@@ -760,13 +1487,23 @@ QByteArray WebServer::createServerXmlDocument(QHostAddress address)
     \sa WebServer
 */
 
-/*! Constructs a \l{WebServerClient} with the given \a address and \a parent. */
-WebServerClient::WebServerClient(const QHostAddress &address, QObject *parent):
+/*! Constructs a \l{WebServerClient} with the given \a address and \a parent. The connection
+ *  timeouts run on the given \a timeoutWheel.
+ */
+WebServerClient::WebServerClient(const QHostAddress &address, TimeoutWheel *timeoutWheel, QObject *parent):
     QObject(parent),
-    m_address(address)
+    m_address(address),
+    m_timeoutWheel(timeoutWheel)
 {
 }
 
+WebServerClient::~WebServerClient()
+{
+    foreach (quint64 timeoutId, m_runningConnections) {
+        m_timeoutWheel->remove(timeoutId);
+    }
+}
+
 /*! Returns the address of this \l{WebServerClient}. */
 QHostAddress WebServerClient::address() const
 {
@@ -785,25 +1522,20 @@ QList<QSslSocket *> WebServerClient::connections()
  */
 void WebServerClient::addConnection(QSslSocket *socket)
 {
-    QTimer *timer = new QTimer(this);
-    timer->setSingleShot(true);
-    timer->setInterval(65000);
-    connect(timer, &QTimer::timeout, this, &WebServerClient::onTimout);
-
-    m_runningConnections.insert(timer, socket);
+    quint64 timeoutId = m_timeoutWheel->add(65000, [this, socket](){
+        onTimout(socket);
+    });
+    m_runningConnections.insert(socket, timeoutId);
     m_connections.append(socket);
-
-    timer->start();
 }
 
 /*! Removes a connection the given \a socket from the connection list of this \l{WebServerClient}. */
 void WebServerClient::removeConnection(QSslSocket *socket)
 {
-    QTimer *timer = m_runningConnections.key(socket);
-    m_runningConnections.remove(timer);
+    if (m_runningConnections.contains(socket)) {
+        m_timeoutWheel->remove(m_runningConnections.take(socket));
+    }
     m_connections.removeAll(socket);
-
-    delete timer;
 }
 
 /*! Resets the connection timeout for the given \a socket. If the socket will not be used for 12 seconds the
@@ -811,16 +1543,14 @@ void WebServerClient::removeConnection(QSslSocket *socket)
  */
 void WebServerClient::resetTimout(QSslSocket *socket)
 {
-    QTimer *timer = nullptr;
-    timer = m_runningConnections.key(socket);
-    if (timer)
-        timer->start();
+    if (m_runningConnections.contains(socket))
+        m_timeoutWheel->restart(m_runningConnections.value(socket));
 }
 
-void WebServerClient::onTimout()
+void WebServerClient::onTimout(QSslSocket *socket)
 {
-    QTimer *timer =  static_cast<QTimer *>(sender());
-    QSslSocket *socket = m_runningConnections.value(timer);
+    // The wheel entry is gone already
+    m_runningConnections.remove(socket);
     qCDebug(dcWebServer()).noquote() << QString("Client connection timout %1:%2 -> closing connection").arg(socket->peerAddress().toString()).arg(socket->peerPort());
     removeConnection(socket);
     socket->close();
@@ -35,6 +35,7 @@
 #include <QTcpServer>
 #include <QTcpSocket>
 #include <QHash>
+#include <QSet>
 #include <QDir>
 #include <QTimer>
 #include <QImage>
@@ -43,22 +44,29 @@
 #include <QSslCertificate>
 #include <QSslConfiguration>
 #include <QSslKey>
+#include <QDateTime>
 
 #include "nymeaconfiguration.h"
 
 // Note: Hypertext Transfer Protocol (HTTP/1.1) from the Internet Engineering Task Force (IETF):
 //       https://tools.ietf.org/html/rfc7231
 
+class Thing;
+
 namespace nymeaserver {
 
 class HttpReply;
 class HttpRequest;
+class SslHandshaker;
+class HttpEventStream;
+class TimeoutWheel;
 
 class WebServerClient : public QObject
 {
     Q_OBJECT
 public:
-    WebServerClient(const QHostAddress &address, QObject *parent = nullptr);
+    WebServerClient(const QHostAddress &address, TimeoutWheel *timeoutWheel, QObject *parent = nullptr);
+    ~WebServerClient() override;
 
     QHostAddress address() const;
 
@@ -70,11 +78,12 @@ public:
 
 private:
     QHostAddress m_address;
+    TimeoutWheel *m_timeoutWheel = nullptr;
     QList<QSslSocket *> m_connections;
-    QHash<QTimer *, QSslSocket *> m_runningConnections;
+    // Timeout wheel entries of the connections
+    QHash<QSslSocket *, quint64> m_runningConnections;
 
-private slots:
-    void onTimout();
+    void onTimout(QSslSocket *socket);
 };
 
 
@@ -82,7 +91,7 @@ class WebServer : public QTcpServer
 {
     Q_OBJECT
 public:
-    explicit WebServer(const WebServerConfiguration &configuration, const QSslConfiguration &sslConfiguration, QObject *parent = nullptr);
+    explicit WebServer(const WebServerConfiguration &configuration, const QSslConfiguration &sslConfiguration, TimeoutWheel *timeoutWheel, QObject *parent = nullptr);
     ~WebServer() override;
 
     QUrl serverUrl() const;
@@ -93,16 +102,57 @@ private:
     QHash<QUuid, QSslSocket *> m_clientList;
     QList<WebServerClient *> m_webServerClients;
     QHash<QSslSocket *, HttpRequest> m_incompleteRequests;
+    QSet<QSslSocket *> m_closeRequested;
 
     QString m_serverName;
     WebServerConfiguration m_configuration;
     QSslConfiguration m_sslConfiguration;
+    TimeoutWheel *m_timeoutWheel = nullptr;
 
     bool m_enabled = false;
+    SslHandshaker *m_sslHandshaker = nullptr;
+
+    struct StaticAsset {
+        QDateTime lastModified;
+        qint64 size = 0;
+        QByteArray contentType;
+        QByteArray etag;
+        QByteArray data;
+        QByteArray gzipData;
+        QByteArray brotliData;
+    };
+    QHash<QString, StaticAsset> m_assetCache;
+    QHash<QHostAddress, StaticAsset> m_serverXmlCache;
+    QHash<QUuid, quint32> m_thingStateVersions;
+    QByteArray m_thingStateEtagPrefix;
+    QList<HttpEventStream *> m_eventStreams;
+    QTimer *m_eventStreamKeepAliveTimer = nullptr;
+
+    struct OutgoingData {
+        QByteArray data;
+        QIODevice *device = nullptr;
+        qint64 remaining = -1;
+        bool closeConnection = false;
+    };
+    QHash<QSslSocket *, QList<OutgoingData>> m_outgoingData;
+    qint64 m_assetCacheSize = 0;
+
+    bool loadStaticAsset(const QString &fileName, StaticAsset *asset);
+    HttpReply *processFileRequest(const HttpRequest &request, const QString &fileName);
+    HttpReply *createAssetReply(const HttpRequest &request, const StaticAsset &asset, const QByteArray &cacheControl);
+    void setupConnection(QSslSocket *socket);
+    void processClientData(QSslSocket *socket);
+    void processRequest(QSslSocket *socket, const QUuid &clientId, const HttpRequest &request);
+    void applyRequestRange(const HttpRequest &request, HttpReply *reply);
+    void writeOutgoingData(QSslSocket *socket);
 
     bool verifyFile(QSslSocket *socket, const QString &fileName);
     QString fileName(const QString &query);
 
+    StaticAsset serverXmlAsset(const QHostAddress &address);
+    QByteArray thingStateEtag(const QUuid &thingId);
+    void processApiRequest(const QUuid &clientId, const HttpRequest &request);
+    HttpReply *createEventStreamReply(const HttpRequest &request);
     QByteArray createServerXmlDocument(QHostAddress address);
     HttpReply *processIconRequest(const QString &fileName);
     HttpReply *processDebugRequest(const QString &requestPath);
@@ -118,9 +168,11 @@ signals:
 private slots:
     void readClient();
     void onDisconnected();
-    void onEncrypted();
+    void onBytesWritten();
+    void onConnectionEncrypted(QSslSocket *socket);
     void onError(QAbstractSocket::SocketError error);
     void onAsyncReplyFinished();
+    void onThingStateChanged(Thing *thing, const QUuid &stateTypeId, const QVariant &value, const QVariant &minValue, const QVariant &maxValue);
 
 public slots:
     void setConfiguration(const WebServerConfiguration &config);
@@ -60,6 +60,8 @@
 #include "nymeasettings.h"
 #include "nymeacore.h"
 #include "websocketserver.h"
+#include "sslhandshaker.h"
+#include "tcpserver.h"
 #include "loggingcategories.h"
 
 #include <QSslConfiguration>
@@ -96,27 +98,75 @@ QUrl WebSocketServer::serverUrl() const
  */
 void WebSocketServer::sendData(const QUuid &clientId, const QByteArray &data)
 {
-    QWebSocket *client = nullptr;
-    client = m_clientList.value(clientId);
+    qCDebug(dcWebSocketServerTraffic()) << "Sending data to client" << data;
+    sendTextMessage(clientId, QString::fromUtf8(data + '\n'));
+}
+
+/*! Send the given \a data map to the given list of \a clients.
+ *
+ * \sa TransportInterface::sendData()
+ */
+void WebSocketServer::sendData(const QList<QUuid> &clients, const QByteArray &data)
+{
+    // Convert to a text message once, QWebSocket takes it as an implicitly shared QString
+    const QString message = QString::fromUtf8(data + '\n');
+    foreach (const QUuid &client, clients) {
+        sendTextMessage(client, message);
+    }
+}
+
+void WebSocketServer::sendTextMessage(const QUuid &clientId, const QString &message)
+{
+    QWebSocket *client = m_clientList.value(clientId);
     if (client) {
-        qCDebug(dcWebSocketServerTraffic()) << "Sending data to client" << data;
-        client->sendTextMessage(data + '\n');
+        m_pendingBytes[clientId] += client->sendTextMessage(message);
     } else {
         qCWarning(dcWebSocketServer()) << "Client" << clientId << "unknown to this transport";
     }
 }
 
-/*! Send the given \a data map to the given list of \a clients.
+/*! Returns true. Binary data is sent in binary WebSocket messages. */
+bool WebSocketServer::supportsBinaryData() const
+{
+    return true;
+}
+
+/*! Send the given binary \a data to the client with the given \a clientId in a binary message.
  *
- * \sa TransportInterface::sendData()
+ * \sa TransportInterface::sendBinaryData()
  */
-void WebSocketServer::sendData(const QList<QUuid> &clients, const QByteArray &data)
+void WebSocketServer::sendBinaryData(const QUuid &clientId, const QByteArray &data)
+{
+    QWebSocket *client = m_clientList.value(clientId);
+    if (client) {
+        qCDebug(dcWebSocketServerTraffic()) << "Sending binary data to client" << data.size() << "bytes";
+        m_pendingBytes[clientId] += client->sendBinaryMessage(data);
+    } else {
+        qCWarning(dcWebSocketServer()) << "Client" << clientId << "unknown to this transport";
+    }
+}
+
+/*! Send the given binary \a data to the given list of \a clients.
+ *
+ * \sa TransportInterface::sendBinaryData()
+ */
+void WebSocketServer::sendBinaryData(const QList<QUuid> &clients, const QByteArray &data)
 {
     foreach (const QUuid &client, clients) {
-        sendData(client, data);
+        sendBinaryData(client, data);
     }
 }
 
+/*! Returns the number of bytes queued for the client with the given \a clientId which have not
+ *  been written yet.
+ *
+ * \sa TransportInterface::pendingBytes()
+ */
+qint64 WebSocketServer::pendingBytes(const QUuid &clientId) const
+{
+    return m_pendingBytes.value(clientId);
+}
+
 void WebSocketServer::terminateClientConnection(const QUuid &clientId)
 {
     QWebSocket *client = m_clientList.value(clientId);
@@ -150,6 +200,7 @@ void WebSocketServer::onClientConnected()
     connect(client, SIGNAL(textMessageReceived(QString)), this, SLOT(onTextMessageReceived(QString)));
     connect(client, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onClientError(QAbstractSocket::SocketError)));
     connect(client, SIGNAL(disconnected()), this, SLOT(onClientDisconnected()));
+    connect(client, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten(qint64)));
 
     emit clientConnected(clientId);
 }
@@ -160,6 +211,7 @@ void WebSocketServer::onClientDisconnected()
     QUuid clientId = m_clientList.key(client);
     qCDebug(dcWebSocketServer()) << "Client" << clientId.toString() << "disconnected. (Remote address:" << client->peerAddress().toString() << ")" ;
     m_clientList.take(clientId)->deleteLater();
+    m_pendingBytes.remove(clientId);
     emit clientDisconnected(clientId);
 }
 
@@ -168,6 +220,7 @@ void WebSocketServer::onBinaryMessageReceived(const QByteArray &data)
     QWebSocket *client = qobject_cast<QWebSocket *>(sender());
     QUuid clientId = m_clientList.key(client);
     qCDebug(dcWebSocketServerTraffic()) << "Binary message from" << clientId.toString() << ":" << data;
+    emit dataAvailable(clientId, data);
 }
 
 void WebSocketServer::onTextMessageReceived(const QString &message)
@@ -190,6 +243,17 @@ void WebSocketServer::onServerError(QAbstractSocket::SocketError error)
     qCWarning(dcWebSocketServer()) << "Server error " << error << m_server->errorString();
 }
 
+void WebSocketServer::onBytesWritten(qint64 bytes)
+{
+    QWebSocket *client = qobject_cast<QWebSocket *>(sender());
+    QUuid clientId = m_clientList.key(client);
+    if (!m_pendingBytes.contains(clientId)) {
+        return;
+    }
+    // Frame headers are written too, so this might overshoot
+    m_pendingBytes[clientId] = qMax(Q_INT64_C(0), m_pendingBytes.value(clientId) - bytes);
+}
+
 void WebSocketServer::onPing(quint64 elapsedTime, const QByteArray &payload)
 {
     QWebSocket *client = qobject_cast<QWebSocket *>(sender());
@@ -209,16 +273,22 @@ void WebSocketServer::setServerName(const QString &serverName)
  */
 bool WebSocketServer::startServer()
 {
-    if (configuration().sslEnabled) {
-        m_server = new QWebSocketServer("nymea", QWebSocketServer::SecureMode, this);
-        m_server->setSslConfiguration(m_sslConfiguration);
-    } else {
-        m_server = new QWebSocketServer("nymea", QWebSocketServer::NonSecureMode, this);
-    }
+    m_server = new QWebSocketServer("nymea", QWebSocketServer::NonSecureMode, this);
     connect (m_server, &QWebSocketServer::newConnection, this, &WebSocketServer::onClientConnected);
     connect (m_server, &QWebSocketServer::acceptError, this, &WebSocketServer::onServerError);
 
-    if (!m_server->listen(configuration().address, static_cast<quint16>(configuration().port))) {
+    if (configuration().sslEnabled) {
+        // Accept the connections ourselves and run the TLS handshakes in a worker thread. The websocket
+        // server only gets to see connections which are encrypted already.
+        m_sslServer = new SslServer(this);
+        m_sslHandshaker = new SslHandshaker(m_sslConfiguration, this);
+        connect(m_sslServer, &SslServer::socketDescriptorAvailable, m_sslHandshaker, &SslHandshaker::handleConnection);
+        connect(m_sslHandshaker, &SslHandshaker::connectionEncrypted, m_server, &QWebSocketServer::handleConnection);
+        if (!m_sslServer->listen(configuration().address, static_cast<quint16>(configuration().port))) {
+            qCWarning(dcWebSocketServer()) << "Error listening on" << serverUrl().toString();
+            return false;
+        }
+    } else if (!m_server->listen(configuration().address, static_cast<quint16>(configuration().port))) {
         qCWarning(dcWebSocketServer()) << "Error listening on" << serverUrl().toString();
         return false;
     }
@@ -237,6 +307,15 @@ bool WebSocketServer::stopServer()
         client->close(QWebSocketProtocol::CloseCodeNormal, "Stop server");
     }
 
+    if (m_sslServer) {
+        m_sslServer->close();
+        delete m_sslServer;
+        m_sslServer = nullptr;
+    }
+
+    delete m_sslHandshaker;
+    m_sslHandshaker = nullptr;
+
     if (m_server) {
         m_server->close();
         delete m_server;
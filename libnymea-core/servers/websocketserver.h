@@ -47,6 +47,9 @@ class QSslConfiguration;
 
 namespace nymeaserver {
 
+class SslServer;
+class SslHandshaker;
+
 class WebSocketServer : public TransportInterface
 {
     Q_OBJECT
@@ -59,11 +62,23 @@ public:
     void sendData(const QUuid &clientId, const QByteArray &data) override;
     void sendData(const QList<QUuid> &clients, const QByteArray &data) override;
 
+    bool supportsBinaryData() const override;
+    void sendBinaryData(const QUuid &clientId, const QByteArray &data) override;
+    void sendBinaryData(const QList<QUuid> &clients, const QByteArray &data) override;
+
+    qint64 pendingBytes(const QUuid &clientId) const override;
+
     void terminateClientConnection(const QUuid &clientId) override;
 
 private:
+    void sendTextMessage(const QUuid &clientId, const QString &message);
+
     QWebSocketServer *m_server = nullptr;
+    SslServer *m_sslServer = nullptr;
+    SslHandshaker *m_sslHandshaker = nullptr;
     QHash<QUuid, QWebSocket *> m_clientList;
+    // QWebSocket doesn't expose its write buffer, so count what's been queued but not written yet
+    QHash<QUuid, qint64> m_pendingBytes;
     QSslConfiguration m_sslConfiguration;
     bool m_enabled;
 
@@ -74,6 +89,7 @@ private slots:
     void onTextMessageReceived(const QString &message);
     void onClientError(QAbstractSocket::SocketError error);
     void onServerError(QAbstractSocket::SocketError error);
+    void onBytesWritten(qint64 bytes);
     void onPing(quint64 elapsedTime, const QByteArray & payload);
 
 public slots:
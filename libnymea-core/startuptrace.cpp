@@ -0,0 +1,269 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::StartupTrace
+    \brief Records where the startup time of nymead goes.
+
+    \ingroup core
+    \inmodule core
+
+    The startup phases of the core, loading and initializing every plugin, the initial setup of every
+    thing, loading rules and scripts and starting the servers are recorded as spans. Recording starts
+    with \l{NymeaCore::init()} and ends once the initial setup of all configured things has finished.
+    The trace is then written to \l{fileName()} in the Chrome trace event format, which can be loaded
+    into chrome://tracing or Perfetto, and \l{summary()} is available through System.GetStartupReport
+    and in debug reports.
+
+    Spans may be recorded from any thread.
+*/
+
+#include "startuptrace.h"
+#include "nymeasettings.h"
+#include "loggingcategories.h"
+#include "jsonrpc/jsonwriter.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QHash>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+
+Q_DECLARE_LOGGING_CATEGORY(dcCore)
+
+namespace nymeaserver {
+
+namespace {
+
+struct TraceEvent {
+    QString category;
+    QString name;
+    qint64 start = 0;
+    qint64 duration = 0;
+    int thread = 0;
+    QVariantMap args;
+};
+
+struct TraceState {
+    QMutex mutex;
+    QElapsedTimer timer;
+    QList<TraceEvent> events;
+    QHash<Qt::HANDLE, int> threads;
+    qint64 finishedAt = -1;
+};
+
+TraceState *traceState()
+{
+    static TraceState state;
+    return &state;
+}
+
+}
+
+/*! Starts a new trace, dropping the events of a previous one. */
+void StartupTrace::start()
+{
+    TraceState *state = traceState();
+    QMutexLocker locker(&state->mutex);
+    state->timer.start();
+    state->events.clear();
+    state->threads.clear();
+    // The main thread always shows up first
+    state->threads.insert(QThread::currentThreadId(), 0);
+    state->finishedAt = -1;
+}
+
+/*! Stops recording, writes the trace file and logs the summary. Calls after the first one are ignored. */
+void StartupTrace::finish()
+{
+    TraceState *state = traceState();
+    {
+        QMutexLocker locker(&state->mutex);
+        if (!state->timer.isValid() || state->finishedAt >= 0) {
+            return;
+        }
+        state->finishedAt = state->timer.nsecsElapsed() / 1000;
+    }
+
+    qCInfo(dcCore()) << "Startup finished after" << duration() / 1000 << "ms";
+
+    QDir().mkpath(QFileInfo(fileName()).absolutePath());
+    QFile traceFile(fileName());
+    if (!traceFile.open(QFile::WriteOnly | QFile::Truncate)) {
+        qCWarning(dcCore()) << "Cannot write startup trace to" << traceFile.fileName() << traceFile.errorString();
+        return;
+    }
+    traceFile.write(toChromeTrace());
+    traceFile.close();
+    qCInfo(dcCore()) << "Startup trace written to" << traceFile.fileName();
+}
+
+/*! Returns true once the startup trace is complete. */
+bool StartupTrace::isFinished()
+{
+    TraceState *state = traceState();
+    QMutexLocker locker(&state->mutex);
+    return state->finishedAt >= 0;
+}
+
+/*! Returns the microseconds since the trace has been started, to be passed to \l{record()} later. */
+qint64 StartupTrace::now()
+{
+    TraceState *state = traceState();
+    QMutexLocker locker(&state->mutex);
+    if (!state->timer.isValid()) {
+        return 0;
+    }
+    return state->timer.nsecsElapsed() / 1000;
+}
+
+/*! Records a span of the given \a category and \a name which started at \a startTime, as returned by
+    \l{now()}, and ends now. The \a args are shown along with the span. Nothing is recorded if the trace
+    isn't running.
+*/
+void StartupTrace::record(const QString &category, const QString &name, qint64 startTime, const QVariantMap &args)
+{
+    TraceState *state = traceState();
+    QMutexLocker locker(&state->mutex);
+    if (!state->timer.isValid() || state->finishedAt >= 0) {
+        return;
+    }
+    TraceEvent event;
+    event.category = category;
+    event.name = name;
+    event.start = startTime;
+    event.duration = state->timer.nsecsElapsed() / 1000 - startTime;
+    Qt::HANDLE threadId = QThread::currentThreadId();
+    if (!state->threads.contains(threadId)) {
+        state->threads.insert(threadId, state->threads.count());
+    }
+    event.thread = state->threads.value(threadId);
+    event.args = args;
+    state->events.append(event);
+}
+
+/*! Returns the duration of the startup in microseconds, or the time since the start while it's still running. */
+qint64 StartupTrace::duration()
+{
+    TraceState *state = traceState();
+    QMutexLocker locker(&state->mutex);
+    if (!state->timer.isValid()) {
+        return 0;
+    }
+    return state->finishedAt >= 0 ? state->finishedAt : state->timer.nsecsElapsed() / 1000;
+}
+
+/*! Returns all recorded spans in the Chrome trace event format. */
+QByteArray StartupTrace::toChromeTrace()
+{
+    TraceState *state = traceState();
+    QMutexLocker locker(&state->mutex);
+
+    QByteArray json;
+    JsonWriter writer(&json);
+    writer.beginObject();
+    writer.writeKey("displayTimeUnit");
+    writer.writeString("ms");
+    writer.writeKey("traceEvents");
+    writer.beginArray();
+    qint64 pid = QCoreApplication::applicationPid();
+    foreach (const TraceEvent &event, state->events) {
+        writer.beginObject();
+        writer.writeKey("name");
+        writer.writeString(event.name);
+        writer.writeKey("cat");
+        writer.writeString(event.category);
+        writer.writeKey("ph");
+        writer.writeString("X");
+        writer.writeKey("ts");
+        writer.writeInteger(event.start);
+        writer.writeKey("dur");
+        writer.writeInteger(event.duration);
+        writer.writeKey("pid");
+        writer.writeInteger(pid);
+        writer.writeKey("tid");
+        writer.writeInteger(event.thread);
+        if (!event.args.isEmpty()) {
+            writer.writeKey("args");
+            writer.writeValue(event.args);
+        }
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+    return json;
+}
+
+/*! Returns the durations in milliseconds of the core phases, of each plugin and of the setup of each
+    thing. Plugins which are loaded on several threads sum up all their spans.
+*/
+QVariantMap StartupTrace::summary()
+{
+    QVariantMap phases;
+    QVariantMap plugins;
+    QVariantMap things;
+    {
+        TraceState *state = traceState();
+        QMutexLocker locker(&state->mutex);
+        foreach (const TraceEvent &event, state->events) {
+            if (event.category == "plugins") {
+                plugins.insert(event.name, plugins.value(event.name).toLongLong() + event.duration / 1000);
+            } else if (event.category == "things") {
+                QVariantMap thing = event.args;
+                thing.insert("name", event.name);
+                thing.insert("duration", event.duration / 1000);
+                things.insert(event.args.value("thingId").toString(), thing);
+            } else {
+                phases.insert(event.name, phases.value(event.name).toLongLong() + event.duration / 1000);
+            }
+        }
+    }
+
+    QVariantMap summary;
+    summary.insert("finished", isFinished());
+    summary.insert("duration", duration() / 1000);
+    summary.insert("phases", phases);
+    summary.insert("plugins", plugins);
+    summary.insert("things", things);
+    summary.insert("traceFile", fileName());
+    return summary;
+}
+
+/*! Returns the file the trace is written to once the startup is finished. */
+QString StartupTrace::fileName()
+{
+    return NymeaSettings::storagePath() + "/startup-trace.json";
+}
+
+}
@@ -33,6 +33,8 @@
 #include "ruleengine/ruleengine.h"
 #include "nymeasettings.h"
 
+#include <QTimer>
+
 namespace nymeaserver {
 
 TagsStorage::TagsStorage(ThingManager *thingManager, RuleEngine *ruleEngine, QObject *parent):
@@ -43,9 +45,16 @@ TagsStorage::TagsStorage(ThingManager *thingManager, RuleEngine *ruleEngine, QOb
     connect(thingManager, &ThingManager::thingRemoved, this, &TagsStorage::thingRemoved);
     connect(ruleEngine, &RuleEngine::ruleRemoved, this, &TagsStorage::ruleRemoved);
 
+    // Tag changes, e.g. all tags of a removed thing, are written in one go
+    m_saveTimer = new QTimer(this);
+    m_saveTimer->setSingleShot(true);
+    m_saveTimer->setInterval(0);
+    connect(m_saveTimer, &QTimer::timeout, this, &TagsStorage::saveTags);
+
     NymeaSettings settings(NymeaSettings::SettingsRoleTags);
 
-    if (settings.childGroups().contains("Things")) {
+    bool migrate = !settings.childGroups().contains("Things") && settings.childGroups().contains("Devices");
+    if (!migrate) {
         settings.beginGroup("Things");
     } else { // backwards compatibility with <= 0.19
         settings.beginGroup("Devices");
@@ -57,7 +66,11 @@ TagsStorage::TagsStorage(ThingManager *thingManager, RuleEngine *ruleEngine, QOb
             settings.beginGroup(appId);
             foreach (const QString &tagId, settings.childKeys()) {
                 Tag tag(ThingId(thingId), appId, tagId, settings.value(tagId).toString());
-                m_tags.append(tag);
+                insertTag(tag);
+                // Migration path from nymea <= 0.19: save all Devices tags to things tags
+                if (migrate) {
+                    m_pendingChanges.append(qMakePair(tag, false));
+                }
             }
             settings.endGroup();
         }
@@ -67,10 +80,7 @@ TagsStorage::TagsStorage(ThingManager *thingManager, RuleEngine *ruleEngine, QOb
 
     // Migration path from nymea <= 0.19
     if (settings.childGroups().contains("Devices")) {
-        // Save all Devices tags to things tags and drop Devices group
-        foreach (const Tag &tag, m_tags) {
-            saveTag(tag);
-        }
+        saveTags();
         settings.remove("Devices");
     }
 
@@ -81,7 +91,7 @@ TagsStorage::TagsStorage(ThingManager *thingManager, RuleEngine *ruleEngine, QOb
             settings.beginGroup(appId);
             foreach (const QString &tagId, settings.childKeys()) {
                 Tag tag(RuleId(ruleId), appId, tagId, settings.value(tagId).toString());
-                m_tags.append(tag);
+                insertTag(tag);
             }
             settings.endGroup();
         }
@@ -90,31 +100,36 @@ TagsStorage::TagsStorage(ThingManager *thingManager, RuleEngine *ruleEngine, QOb
     settings.endGroup();
 }
 
-QList<Tag> TagsStorage::tags() const
+TagsStorage::~TagsStorage()
 {
-    return m_tags;
+    saveTags();
 }
 
-QList<Tag> TagsStorage::tags(const ThingId &thingId) const
+QList<Tag> TagsStorage::tags() const
 {
     QList<Tag> ret;
-    foreach (const Tag &tag, m_tags) {
-        if (tag.thingId() == thingId) {
-            ret.append(tag);
-        }
+    foreach (const QList<Tag> &tags, m_thingTags) {
+        ret.append(tags);
+    }
+    foreach (const QList<Tag> &tags, m_ruleTags) {
+        ret.append(tags);
     }
     return ret;
 }
 
+QList<Tag> TagsStorage::tags(const ThingId &thingId) const
+{
+    return m_thingTags.value(thingId);
+}
+
 QList<Tag> TagsStorage::tags(const RuleId &ruleId) const
 {
-    QList<Tag> ret;
-    foreach (const Tag &tag, m_tags) {
-        if (tag.ruleId() == ruleId) {
-            ret.append(tag);
-        }
-    }
-    return ret;
+    return m_ruleTags.value(ruleId);
+}
+
+QList<Tag> TagsStorage::tags(const QString &appId, const QString &tagId) const
+{
+    return m_tagsByKey.value(qMakePair(appId, tagId));
 }
 
 TagsStorage::TagError TagsStorage::addTag(const Tag &tag)
@@ -129,25 +144,27 @@ TagsStorage::TagError TagsStorage::addTag(const Tag &tag)
        }
     }
 
-    int index = m_tags.indexOf(tag);
-    if (index >= 0) {
-        m_tags.replace(index, tag);
+    const QList<Tag> &ownerTags = tag.thingId().isNull() ? m_ruleTags.value(tag.ruleId()) : m_thingTags.value(tag.thingId());
+    if (ownerTags.contains(tag)) {
+        takeTag(tag);
+        insertTag(tag);
         emit tagValueChanged(tag);
     } else {
-        m_tags.append(tag);
+        insertTag(tag);
         emit tagAdded(tag);
     }
-    saveTag(tag);
+    scheduleSave(tag, false);
     return TagsStorage::TagErrorNoError;
 }
 
 TagsStorage::TagError TagsStorage::removeTag(const Tag &tag)
 {
-    if (!m_tags.contains(tag)) {
+    const QList<Tag> &ownerTags = tag.thingId().isNull() ? m_ruleTags.value(tag.ruleId()) : m_thingTags.value(tag.thingId());
+    if (!ownerTags.contains(tag)) {
         return TagErrorTagNotFound;
     }
-    m_tags.removeAll(tag);
-    unsaveTag(tag);
+    takeTag(tag);
+    scheduleSave(tag, true);
     emit tagRemoved(tag);
     return TagErrorNoError;
 }
@@ -155,58 +172,88 @@ TagsStorage::TagError TagsStorage::removeTag(const Tag &tag)
 
 void TagsStorage::thingRemoved(const ThingId &thingId)
 {
-    QList<Tag> tagsToRemove;
-    foreach (const Tag &tag, m_tags) {
-        if (tag.thingId() == thingId) {
-            tagsToRemove.append(tag);
-        }
-    }
-    while (!tagsToRemove.isEmpty()) {
-        removeTag(tagsToRemove.takeFirst());
+    foreach (const Tag &tag, m_thingTags.value(thingId)) {
+        removeTag(tag);
     }
 }
 
 void TagsStorage::ruleRemoved(const RuleId &ruleId)
 {
-    QList<Tag> tagsToRemove;
-    foreach (const Tag &tag, m_tags) {
-        if (tag.ruleId() == ruleId) {
-            tagsToRemove.append(tag);
-        }
-    }
-    while (!tagsToRemove.isEmpty()) {
-        removeTag(tagsToRemove.takeFirst());
+    foreach (const Tag &tag, m_ruleTags.value(ruleId)) {
+        removeTag(tag);
     }
 }
 
-void TagsStorage::saveTag(const Tag &tag)
+void TagsStorage::insertTag(const Tag &tag)
 {
-    NymeaSettings settings(NymeaSettings::SettingsRoleTags);
-
     if (!tag.thingId().isNull()) {
-        settings.beginGroup("Things");
-        settings.beginGroup(tag.thingId().toString());
+        m_thingTags[tag.thingId()].append(tag);
     } else {
-        settings.beginGroup("Rules");
-        settings.beginGroup(tag.ruleId().toString());
+        m_ruleTags[tag.ruleId()].append(tag);
     }
-    settings.beginGroup(tag.appId());
-    settings.setValue(tag.tagId(), tag.value());
+    m_tagsByKey[qMakePair(tag.appId(), tag.tagId())].append(tag);
 }
 
-void TagsStorage::unsaveTag(const Tag &tag)
+void TagsStorage::takeTag(const Tag &tag)
 {
-    NymeaSettings settings(NymeaSettings::SettingsRoleTags);
-
     if (!tag.thingId().isNull()) {
-        settings.beginGroup("Things");
-        settings.beginGroup(tag.thingId().toString());
+        QList<Tag> &tags = m_thingTags[tag.thingId()];
+        tags.removeAll(tag);
+        if (tags.isEmpty()) {
+            m_thingTags.remove(tag.thingId());
+        }
     } else {
-        settings.beginGroup("Rules");
-        settings.beginGroup(tag.thingId().toString());
+        QList<Tag> &tags = m_ruleTags[tag.ruleId()];
+        tags.removeAll(tag);
+        if (tags.isEmpty()) {
+            m_ruleTags.remove(tag.ruleId());
+        }
+    }
+
+    TagKey key = qMakePair(tag.appId(), tag.tagId());
+    QList<Tag> &tags = m_tagsByKey[key];
+    tags.removeAll(tag);
+    if (tags.isEmpty()) {
+        m_tagsByKey.remove(key);
+    }
+}
+
+void TagsStorage::scheduleSave(const Tag &tag, bool remove)
+{
+    m_pendingChanges.append(qMakePair(tag, remove));
+    if (!m_saveTimer->isActive()) {
+        m_saveTimer->start();
+    }
+}
+
+void TagsStorage::saveTags()
+{
+    m_saveTimer->stop();
+    if (m_pendingChanges.isEmpty()) {
+        return;
+    }
+
+    NymeaSettings settings(NymeaSettings::SettingsRoleTags);
+    for (int i = 0; i < m_pendingChanges.count(); i++) {
+        const Tag &tag = m_pendingChanges.at(i).first;
+        if (!tag.thingId().isNull()) {
+            settings.beginGroup("Things");
+            settings.beginGroup(tag.thingId().toString());
+        } else {
+            settings.beginGroup("Rules");
+            settings.beginGroup(tag.ruleId().toString());
+        }
+        settings.beginGroup(tag.appId());
+        if (m_pendingChanges.at(i).second) {
+            settings.remove(tag.tagId());
+        } else {
+            settings.setValue(tag.tagId(), tag.value());
+        }
+        settings.endGroup(); // appId
+        settings.endGroup(); // thingId or ruleId
+        settings.endGroup(); // Things or Rules
     }
-    settings.beginGroup(tag.appId());
-    settings.remove(tag.tagId());
+    m_pendingChanges.clear();
 }
 
 }
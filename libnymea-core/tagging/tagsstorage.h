@@ -36,6 +36,10 @@
 
 #include <QObject>
 #include <QVector>
+#include <QHash>
+#include <QPair>
+
+class QTimer;
 
 class ThingManager;
 
@@ -56,6 +60,7 @@ public:
     Q_ENUM(TagError)
 
     explicit TagsStorage(ThingManager* thingManager, RuleEngine* ruleEngine, QObject *parent = nullptr);
+    ~TagsStorage() override;
 
     TagError addTag(const Tag &tag);
     TagError removeTag(const Tag &tag);
@@ -63,6 +68,7 @@ public:
     QList<Tag> tags() const;
     QList<Tag> tags(const ThingId &thingId) const;
     QList<Tag> tags(const RuleId &ruleId) const;
+    QList<Tag> tags(const QString &appId, const QString &tagId) const;
 
 signals:
     void tagAdded(const Tag &tag);
@@ -72,15 +78,28 @@ signals:
 private slots:
     void thingRemoved(const ThingId &thingId);
     void ruleRemoved(const RuleId &ruleId);
+    void saveTags();
 
 private:
-    void saveTag(const Tag &tag);
-    void unsaveTag(const Tag &tag);
+    // appId, tagId
+    typedef QPair<QString, QString> TagKey;
+
+    void insertTag(const Tag &tag);
+    void takeTag(const Tag &tag);
+    void scheduleSave(const Tag &tag, bool remove);
 
 private:
     ThingManager *m_thingManager;
     RuleEngine *m_ruleEngine;
-    QList<Tag> m_tags;
+
+    // Tags of every thing and rule, and the same tags indexed by appId and tagId
+    QHash<ThingId, QList<Tag>> m_thingTags;
+    QHash<RuleId, QList<Tag>> m_ruleTags;
+    QHash<TagKey, QList<Tag>> m_tagsByKey;
+
+    // Changes not written to the settings yet, in order. True removes the tag.
+    QList<QPair<Tag, bool>> m_pendingChanges;
+    QTimer *m_saveTimer = nullptr;
 };
 
 }
@@ -0,0 +1,182 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::DeadlineScheduler
+    \brief Runs callbacks at deadlines on the monotonic clock.
+
+    \ingroup rules
+    \inmodule core
+
+    Deadlines are given in milliseconds of the monotonic clock returned by now(), so they neither drift with a busy
+    event loop nor move when the wall clock gets set. There is only one timer, armed for the next deadline, and
+    nothing wakes up in between.
+
+    A callback may allow a \e slack in milliseconds by which it can be delayed. Whenever the scheduler wakes up, all
+    callbacks whose deadline has passed run, so callbacks with overlapping windows get coalesced into one wake up.
+
+    Wall clock jumps, e.g. when NTP sets the time, are noticed on every wake up and reported with wallClockJumped().
+    Components scheduling by wall clock time should compute their deadlines again then.
+*/
+
+/*! \fn void nymeaserver::DeadlineScheduler::wallClockJumped(qint64 offset);
+    Emitted when the wall clock moved by \a offset milliseconds relative to the monotonic clock.
+*/
+
+#include "deadlinescheduler.h"
+#include "loggingcategories.h"
+
+#include <QDateTime>
+
+namespace nymeaserver {
+
+// Differences below this are regular clock slewing, not a jump
+static const qint64 s_wallClockJumpThreshold = 2000; // ms
+
+/*! Constructs a new \l{DeadlineScheduler} with the given \a parent. */
+DeadlineScheduler::DeadlineScheduler(QObject *parent) :
+    QObject(parent)
+{
+    m_clock.start();
+    m_wallClockOffset = QDateTime::currentMSecsSinceEpoch() - m_clock.elapsed();
+
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &DeadlineScheduler::onTimeout);
+}
+
+/*! Returns the current monotonic time in milliseconds. */
+qint64 DeadlineScheduler::now() const
+{
+    return m_clock.elapsed();
+}
+
+/*! Schedules the \a callback to run at the monotonic time \a deadline, or up to \a slack milliseconds later.
+    The callback will not run if the \a context object gets destroyed before. Returns the id of the deadline. */
+int DeadlineScheduler::scheduleAt(qint64 deadline, QObject *context, std::function<void()> callback, int slack)
+{
+    int id = m_nextId++;
+    Entry entry;
+    entry.deadline = deadline;
+    entry.latest = deadline + qMax(0, slack);
+    entry.context = context;
+    entry.callback = callback;
+    m_entries.insert(id, entry);
+    m_deadlines.insert(entry.deadline, id);
+    m_latest.insert(entry.latest, id);
+    rearm();
+    return id;
+}
+
+/*! Schedules the \a callback to run in \a msecs milliseconds, or up to \a slack milliseconds later.
+    The callback will not run if the \a context object gets destroyed before. Returns the id of the deadline. */
+int DeadlineScheduler::scheduleIn(qint64 msecs, QObject *context, std::function<void()> callback, int slack)
+{
+    return scheduleAt(now() + msecs, context, callback, slack);
+}
+
+/*! Cancels the deadline with the given \a id. Does nothing if it has already passed. */
+void DeadlineScheduler::cancel(int id)
+{
+    if (!m_entries.contains(id)) {
+        return;
+    }
+    removeEntry(id);
+    rearm();
+}
+
+/*! Returns true if the deadline with the given \a id is still pending. */
+bool DeadlineScheduler::isScheduled(int id) const
+{
+    return m_entries.contains(id);
+}
+
+/*! Returns the monotonic time of the deadline with the given \a id, or -1 if it is not pending. */
+qint64 DeadlineScheduler::deadline(int id) const
+{
+    return m_entries.contains(id) ? m_entries.value(id).deadline : -1;
+}
+
+void DeadlineScheduler::removeEntry(int id)
+{
+    Entry entry = m_entries.take(id);
+    m_deadlines.remove(entry.deadline, id);
+    m_latest.remove(entry.latest, id);
+}
+
+void DeadlineScheduler::checkWallClock()
+{
+    qint64 offset = QDateTime::currentMSecsSinceEpoch() - m_clock.elapsed();
+    qint64 jump = offset - m_wallClockOffset;
+    if (qAbs(jump) < s_wallClockJumpThreshold) {
+        return;
+    }
+    m_wallClockOffset = offset;
+    qCWarning(dcTimeManager()) << "Wall clock jumped by" << jump << "ms";
+    emit wallClockJumped(jump);
+}
+
+void DeadlineScheduler::rearm()
+{
+    if (m_latest.isEmpty()) {
+        m_timer->stop();
+        return;
+    }
+    m_timer->start(static_cast<int>(qMax<qint64>(0, m_latest.firstKey() - now())));
+}
+
+void DeadlineScheduler::onTimeout()
+{
+    checkWallClock();
+
+    // Everything due by now runs, callbacks scheduled from within a callback wait for the next round
+    qint64 currentTime = now();
+    QList<int> due;
+    for (QMultiMap<qint64, int>::const_iterator it = m_deadlines.constBegin(); it != m_deadlines.constEnd() && it.key() <= currentTime; ++it) {
+        due.append(it.value());
+    }
+
+    foreach (int id, due) {
+        // Might have been cancelled by one of the callbacks before
+        if (!m_entries.contains(id)) {
+            continue;
+        }
+        Entry entry = m_entries.value(id);
+        removeEntry(id);
+        if (!entry.context.isNull()) {
+            entry.callback();
+        }
+    }
+
+    rearm();
+}
+
+}
@@ -0,0 +1,89 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef DEADLINESCHEDULER_H
+#define DEADLINESCHEDULER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QHash>
+#include <QMultiMap>
+#include <QElapsedTimer>
+
+#include <functional>
+
+namespace nymeaserver {
+
+class DeadlineScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DeadlineScheduler(QObject *parent = nullptr);
+
+    qint64 now() const;
+
+    int scheduleAt(qint64 deadline, QObject *context, std::function<void()> callback, int slack = 0);
+    int scheduleIn(qint64 msecs, QObject *context, std::function<void()> callback, int slack = 0);
+    void cancel(int id);
+    bool isScheduled(int id) const;
+    qint64 deadline(int id) const;
+
+signals:
+    void wallClockJumped(qint64 offset);
+
+private:
+    struct Entry {
+        qint64 deadline = 0;
+        qint64 latest = 0;
+        QPointer<QObject> context;
+        std::function<void()> callback;
+    };
+
+    QElapsedTimer m_clock;
+    QTimer *m_timer = nullptr;
+    int m_nextId = 1;
+
+    QHash<int, Entry> m_entries;
+    QMultiMap<qint64, int> m_deadlines;
+    QMultiMap<qint64, int> m_latest;
+
+    // Wall clock time minus monotonic time, to notice when the wall clock gets set
+    qint64 m_wallClockOffset = 0;
+
+    void removeEntry(int id);
+    void checkWallClock();
+    void rearm();
+    void onTimeout();
+};
+
+}
+
+#endif // DEADLINESCHEDULER_H
@@ -36,12 +36,9 @@
     \inmodule core
 */
 
-/*! \fn void nymeaserver::TimeManager::tick()
-    Represents the central time tick. Will be emitted every second.
-*/
-
 /*! \fn void nymeaserver::TimeManager::dateTimeChanged(const QDateTime &dateTime);
-    Will be emitted when the \a dateTime has changed.
+    Will be emitted when the \a dateTime has changed. This happens when a new minute starts and when the wall clock
+    gets set.
 */
 
 #include "timemanager.h"
@@ -53,7 +50,11 @@ namespace nymeaserver {
 TimeManager::TimeManager(QObject *parent) :
     QObject(parent)
 {
-    m_timerId = startTimer(1000, Qt::VeryCoarseTimer);
+    m_scheduler = new DeadlineScheduler(this);
+    connect(m_scheduler, &DeadlineScheduler::wallClockJumped, this, &TimeManager::onWallClockJumped);
+
+    m_lastEvent = QDateTime::currentDateTime();
+    scheduleNextMinute();
 }
 
 /*! Returns the current dateTime of this \l{TimeManager}. */
@@ -62,6 +63,12 @@ QDateTime TimeManager::currentDateTime() const
     return QDateTime::currentDateTime().addSecs(m_overrideDifference);
 }
 
+/*! Returns the monotonic \l{DeadlineScheduler} components can use to sleep until their next deadline. */
+DeadlineScheduler *TimeManager::scheduler() const
+{
+    return m_scheduler;
+}
+
 /*! Stop the time.
  *
  * \note This method should only be used in tests.
@@ -70,7 +77,8 @@ void TimeManager::stopTimer()
 {
     qCWarning(dcTimeManager()) << "TimeManager timer stopped. You should only see this in tests.";
     // Stop clock (used for testing)
-    killTimer(m_timerId);
+    m_stopped = true;
+    m_scheduler->cancel(m_minuteDeadline);
 }
 
 /*! Set the current time of this TimeManager to the given \a dateTime.
@@ -85,18 +93,41 @@ void TimeManager::setTime(const QDateTime &dateTime)
     emit dateTimeChanged(dateTime);
 }
 
-void TimeManager::timerEvent(QTimerEvent *event)
+// Sleeps until the next minute of the wall clock starts. The deadline is computed from the wall clock every time,
+// so a late wake up doesn't accumulate.
+void TimeManager::scheduleNextMinute()
 {
-    Q_UNUSED(event)
-
-    emit tick();
+    if (m_stopped) {
+        return;
+    }
+    m_scheduler->cancel(m_minuteDeadline);
+    QDateTime now = QDateTime::currentDateTime();
+    qint64 msecs = 60000 - (now.time().second() * 1000 + now.time().msec());
+    m_minuteDeadline = m_scheduler->scheduleIn(msecs, this, [this](){ onMinuteDeadline(); });
+}
 
-    // Minute based nymea time
+void TimeManager::onMinuteDeadline()
+{
+    // Minute based nymea time. The wall clock may be slewed slightly behind the monotonic one.
     QDateTime now = QDateTime::currentDateTime();
     if (m_lastEvent.time().minute() != now.time().minute()) {
         m_lastEvent = now;
         emit dateTimeChanged(now.addSecs(m_overrideDifference));
     }
+    scheduleNextMinute();
+}
+
+void TimeManager::onWallClockJumped(qint64 offset)
+{
+    if (m_stopped) {
+        return;
+    }
+    // Evaluate the new time right away instead of waiting for the next minute
+    qCInfo(dcTimeManager()) << "Time changed by" << offset / 1000 << "seconds";
+    QDateTime now = QDateTime::currentDateTime();
+    m_lastEvent = now;
+    emit dateTimeChanged(now.addSecs(m_overrideDifference));
+    scheduleNextMinute();
 }
 
 }
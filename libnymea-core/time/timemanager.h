@@ -36,6 +36,8 @@
 #include <QDateTime>
 #include <QTimeZone>
 
+#include "deadlinescheduler.h"
+
 namespace nymeaserver {
 
 class TimeManager : public QObject
@@ -46,23 +48,27 @@ public:
 
     QDateTime currentDateTime() const;
 
+    DeadlineScheduler *scheduler() const;
+
     // For testability only
     void stopTimer();
     void setTime(const QDateTime &dateTime);
 
 signals:
-    void tick();
     void dateTimeChanged(const QDateTime &dateTime);
 
-protected:
-    void timerEvent(QTimerEvent *event) override;
-
 private:
-    int m_timerId = 0;
+    DeadlineScheduler *m_scheduler = nullptr;
+    int m_minuteDeadline = 0;
+    bool m_stopped = false;
     QDateTime m_lastEvent;
 
     // For testability
     qint64 m_overrideDifference = 0;
+
+    void scheduleNextMinute();
+    void onMinuteDeadline();
+    void onWallClockJumped(qint64 offset);
 };
 
 }
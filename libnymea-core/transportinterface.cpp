@@ -70,6 +70,14 @@
 
 /*! \fn void nymeaserver::TransportInterface::sendData(const QList<QUuid> &clients, const QByteArray &data);
     Pure virtual method for sending \a data to \a clients over the corresponding \l{TransportInterface}.
+    This is the broadcast path used for notifications. Implementations should frame the data once and
+    write the same buffer to every client instead of calling the single client sendData() for each.
+*/
+
+/*! \fn void nymeaserver::TransportInterface::sendBinaryData(const QUuid &clientId, const QByteArray &data);
+    Virtual method for sending the binary \a data to the client with the id \a clientId. In contrast to
+    sendData(), the data must be passed on exactly as it is, without any delimiters. Only called if
+    supportsBinaryData() returns true.
 */
 
 /*! \fn void nymeaserver::TransportInterface::terminateClientConnection(const QUuid &clientId);
@@ -118,6 +126,38 @@ void TransportInterface::setServerName(const QString &serverName)
     m_serverName = serverName;
 }
 
+/*! Returns true if this transport can pass binary data, such as CBOR encoded messages, to its clients
+    without altering it. The default implementation returns false.
+*/
+bool TransportInterface::supportsBinaryData() const
+{
+    return false;
+}
+
+void TransportInterface::sendBinaryData(const QUuid &clientId, const QByteArray &data)
+{
+    Q_UNUSED(data)
+    qCWarning(dcJsonRpc()) << "Transport does not support binary data. Not sending data to" << clientId;
+}
+
+/*! Sends the binary \a data to \a clients by calling sendBinaryData() for each of them. */
+void TransportInterface::sendBinaryData(const QList<QUuid> &clients, const QByteArray &data)
+{
+    foreach (const QUuid &clientId, clients) {
+        sendBinaryData(clientId, data);
+    }
+}
+
+/*! Returns the number of bytes sent to the client with the given \a clientId which have not been written
+    to the network yet. The JSON RPC server uses this to detect clients which can't keep up with the
+    notifications. The default implementation returns 0.
+*/
+qint64 TransportInterface::pendingBytes(const QUuid &clientId) const
+{
+    Q_UNUSED(clientId)
+    return 0;
+}
+
 /*! Virtual destructor for \l{TransportInterface}. */
 TransportInterface::~TransportInterface()
 {
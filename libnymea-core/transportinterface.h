@@ -50,6 +50,12 @@ public:
     virtual void sendData(const QUuid &clientId, const QByteArray &data) = 0;
     virtual void sendData(const QList<QUuid> &clients, const QByteArray &data) = 0;
 
+    virtual bool supportsBinaryData() const;
+    virtual void sendBinaryData(const QUuid &clientId, const QByteArray &data);
+    virtual void sendBinaryData(const QList<QUuid> &clients, const QByteArray &data);
+
+    virtual qint64 pendingBytes(const QUuid &clientId) const;
+
     virtual void terminateClientConnection(const QUuid &clientId) = 0;
 
     void setConfiguration(const ServerConfiguration &config);
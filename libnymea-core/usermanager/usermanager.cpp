@@ -226,6 +226,17 @@ UserManager::UserError UserManager::removeUser(const QString &username)
     QString dropTokensQuery = QString("DELETE FROM tokens WHERE lower(username) = \"%1\";").arg(username.toLower());
     m_db.exec(dropTokensQuery);
 
+    QHash<QByteArray, TokenInfo>::iterator it = m_verifiedTokens.begin();
+    while (it != m_verifiedTokens.end()) {
+        if (it.value().username() == username.toLower()) {
+            QByteArray token = it.key();
+            it = m_verifiedTokens.erase(it);
+            emit tokenRevoked(token);
+        } else {
+            ++it;
+        }
+    }
+
     return UserErrorNoError;
 }
 
@@ -359,6 +370,10 @@ QList<TokenInfo> UserManager::tokens(const QString &username) const
 
 TokenInfo UserManager::tokenInfo(const QByteArray &token) const
 {
+    if (m_verifiedTokens.contains(token)) {
+        return m_verifiedTokens.value(token);
+    }
+
     if (!validateToken(token)) {
         qCWarning(dcUserManager) << "Token did not pass validation:" << token;
         return TokenInfo();
@@ -411,21 +426,38 @@ UserManager::UserError UserManager::removeToken(const QUuid &tokenId)
     }
 
     qCDebug(dcUserManager) << "Token" << tokenId << "removed from DB";
+
+    QHash<QByteArray, TokenInfo>::iterator it = m_verifiedTokens.begin();
+    while (it != m_verifiedTokens.end()) {
+        if (it.value().id() == tokenId) {
+            QByteArray token = it.key();
+            it = m_verifiedTokens.erase(it);
+            emit tokenRevoked(token);
+        } else {
+            ++it;
+        }
+    }
     return UserErrorNoError;
 }
 
-/*! Returns true, if the given \a token is valid. */
+/*! Returns true, if the given \a token is valid. Verified tokens are cached until they are
+    removed with \l{removeToken} or \l{removeUser}, in which case \l{tokenRevoked} is emitted.
+*/
 bool UserManager::verifyToken(const QByteArray &token)
 {
+    if (m_verifiedTokens.contains(token)) {
+        return true;
+    }
+
     if (!validateToken(token)) {
         qCWarning(dcUserManager) << "Token failed character validation" << token;
         return false;
     }
-    QString getTokenQuery = QString("SELECT * FROM tokens WHERE token = \"%1\";")
-            .arg(QString::fromUtf8(token));
-    QSqlQuery result = m_db.exec(getTokenQuery);
-    if (m_db.lastError().type() != QSqlError::NoError) {
-        qCWarning(dcUserManager) << "Query for token failed:" << m_db.lastError().databaseText() << m_db.lastError().driverText() << getTokenQuery;
+    QSqlQuery result(m_db);
+    result.prepare("SELECT id, username, creationdate, devicename FROM tokens WHERE token = ?;");
+    result.addBindValue(QString::fromUtf8(token));
+    if (!result.exec()) {
+        qCWarning(dcUserManager) << "Query for token failed:" << result.lastError().databaseText() << result.lastError().driverText() << result.lastQuery();
         return false;
     }
     if (!result.first()) {
@@ -433,6 +465,7 @@ bool UserManager::verifyToken(const QByteArray &token)
         return false;
     }
     //qCDebug(dcUserManager) << "Token authorized for user" << result.value("username").toString();
+    m_verifiedTokens.insert(token, TokenInfo(result.value("id").toUuid(), result.value("username").toString(), result.value("creationdate").toDateTime(), result.value("devicename").toString()));
     return true;
 }
 
@@ -83,6 +83,7 @@ public:
 
 signals:
     void pushButtonAuthFinished(int transactionId, bool success, const QByteArray &token);
+    void tokenRevoked(const QByteArray &token);
 
 private:
     bool initDB();
@@ -99,6 +100,7 @@ private:
     PushButtonDBusService *m_pushButtonDBusService = nullptr;
     int m_pushButtonTransactionIdCounter = 0;
     QPair<int, QString> m_pushButtonTransaction;
+    QHash<QByteArray, TokenInfo> m_verifiedTokens;
 
 };
 }
@@ -47,6 +47,16 @@ namespace nymeaserver {
 ZigbeeManager::ZigbeeManager(QObject *parent) :
     QObject(parent)
 {
+    // Network settings changes come in bursts while a network is starting up
+    m_saveTimer.setInterval(2000);
+    m_saveTimer.setSingleShot(true);
+    connect(&m_saveTimer, &QTimer::timeout, this, &ZigbeeManager::savePendingNetworks);
+
+    // Every received frame updates LQI and last seen of a node, don't notify about each of them
+    m_nodeChangedTimer.setInterval(1000);
+    m_nodeChangedTimer.setSingleShot(true);
+    connect(&m_nodeChangedTimer, &QTimer::timeout, this, &ZigbeeManager::emitPendingNodeChanges);
+
     // Adapter monitor
     qCDebug(dcZigbee()) << "Initialize the Zigbee manager";
     m_adapterMonitor = new ZigbeeUartAdapterMonitor(this);
@@ -127,6 +137,11 @@ ZigbeeManager::ZigbeeManager(QObject *parent) :
     }
 }
 
+ZigbeeManager::~ZigbeeManager()
+{
+    savePendingNetworks();
+}
+
 bool ZigbeeManager::available() const
 {
     return m_available;
@@ -198,6 +213,7 @@ ZigbeeManager::ZigbeeError ZigbeeManager::removeZigbeeNetwork(const QUuid &netwo
 
     // Make sure to delete later, so all node removed signals can be processed
     m_zigbeeNetworks.remove(networkUuid);
+    m_networksToSave.remove(networkUuid);
     network->deleteLater();
 
     // Delete network settings
@@ -239,6 +255,48 @@ ZigbeeManager::ZigbeeError ZigbeeManager::setZigbeeNetworkPermitJoin(const QUuid
     return ZigbeeManager::ZigbeeErrorNoError;
 }
 
+QString ZigbeeManager::networkDump() const
+{
+    QString dump;
+    QDebug debug(&dump);
+    debug.nospace().noquote();
+
+    foreach (ZigbeeNetwork *network, m_zigbeeNetworks) {
+        debug << network << "\n";
+        foreach (ZigbeeNode *node, network->nodes()) {
+            debug << "--> " << node << "\n";
+            foreach (ZigbeeNodeEndpoint *endpoint, node->endpoints()) {
+                debug << "  " << endpoint << "\n";
+                if (!endpoint->manufacturerName().isEmpty())
+                    debug << "    Manufacturer: " << endpoint->manufacturerName() << "\n";
+
+                if (!endpoint->modelIdentifier().isEmpty())
+                    debug << "    Model: " << endpoint->modelIdentifier() << "\n";
+
+                if (!endpoint->softwareBuildId().isEmpty())
+                    debug << "    Version: " << endpoint->softwareBuildId() << "\n";
+
+                debug << "    Input clusters (" << endpoint->inputClusters().count() << ")\n";
+                foreach (ZigbeeCluster *cluster, endpoint->inputClusters()) {
+                    debug << "     - " << cluster << "\n";
+                    foreach(const ZigbeeClusterAttribute &attribute, cluster->attributes()) {
+                        debug << "       - " << attribute << "\n";
+                    }
+                }
+
+                debug << "    Output clusters (" << endpoint->outputClusters().count() << ")\n";
+                foreach (ZigbeeCluster *cluster, endpoint->outputClusters()) {
+                    debug << "     - " << cluster << "\n";
+                    foreach(const ZigbeeClusterAttribute &attribute, cluster->attributes()) {
+                        debug << "       - " << attribute << "\n";
+                    }
+                }
+            }
+        }
+    }
+    return dump;
+}
+
 ZigbeeManager::ZigbeeError ZigbeeManager::factoryResetNetwork(const QUuid &networkUuid)
 {
     if (!m_zigbeeNetworks.keys().contains(networkUuid)) {
@@ -284,6 +342,26 @@ void ZigbeeManager::saveNetwork(ZigbeeNetwork *network)
     settings.endGroup(); // ZigbeeNetworks
 }
 
+void ZigbeeManager::scheduleSaveNetwork(ZigbeeNetwork *network)
+{
+    m_networksToSave.insert(network->networkUuid());
+    if (!m_saveTimer.isActive()) {
+        m_saveTimer.start();
+    }
+}
+
+void ZigbeeManager::savePendingNetworks()
+{
+    m_saveTimer.stop();
+    foreach (const QUuid &networkUuid, m_networksToSave) {
+        ZigbeeNetwork *network = m_zigbeeNetworks.value(networkUuid);
+        if (network) {
+            saveNetwork(network);
+        }
+    }
+    m_networksToSave.clear();
+}
+
 void ZigbeeManager::loadZigbeeNetworks()
 {
     NymeaSettings settings(NymeaSettings::SettingsRoleZigbee);
@@ -464,30 +542,30 @@ void ZigbeeManager::addNetwork(ZigbeeNetwork *network)
 
     connect(network, &ZigbeeNetwork::panIdChanged, this, [this, network](quint16 panId){
         qCDebug(dcZigbee()) << "Network PAN ID changed for" << network << panId;
-        saveNetwork(network);
+        scheduleSaveNetwork(network);
         emit zigbeeNetworkChanged(network);
     });
 
     connect(network, &ZigbeeNetwork::channelChanged, this, [this, network](quint8 channel){
         qCDebug(dcZigbee()) << "Network channel changed for" << network << channel;
-        saveNetwork(network);
+        scheduleSaveNetwork(network);
         emit zigbeeNetworkChanged(network);
     });
 
     connect(network, &ZigbeeNetwork::macAddressChanged, this, [this, network](const ZigbeeAddress &macAddress){
         qCDebug(dcZigbee()) << "Network MAC address changed for" << network << macAddress.toString();
-        saveNetwork(network);
+        scheduleSaveNetwork(network);
         emit zigbeeNetworkChanged(network);
     });
 
     connect(network, &ZigbeeNetwork::securityConfigurationChanged, this, [this, network](const ZigbeeSecurityConfiguration &securityConfiguration){
         qCDebug(dcZigbee()) << "Network security configuration changed for" << network << securityConfiguration.networkKey().toString() << securityConfiguration.globalTrustCenterLinkKey().toString();
-        saveNetwork(network);
+        scheduleSaveNetwork(network);
     });
 
     connect(network, &ZigbeeNetwork::channelMaskChanged, this, [this, network](const ZigbeeChannelMask &channelMask){
         qCDebug(dcZigbee()) << "Network channel mask changed for" << network << channelMask;
-        saveNetwork(network);
+        scheduleSaveNetwork(network);
         emit zigbeeNetworkChanged(network);
     });
 
@@ -503,40 +581,12 @@ void ZigbeeManager::addNetwork(ZigbeeNetwork *network)
             return;
         }
 
-        qCDebug(dcZigbee()) << "-->" << node;
-        foreach (ZigbeeNodeEndpoint *endpoint, node->endpoints()) {
-            qCDebug(dcZigbee()) << " " << endpoint;
-            if (!endpoint->manufacturerName().isEmpty())
-                qCDebug(dcZigbee()) << "  Manufacturer:" << endpoint->manufacturerName();
-
-            if (!endpoint->modelIdentifier().isEmpty())
-                qCDebug(dcZigbee()) << "  Model" << endpoint->modelIdentifier();
-
-            if (!endpoint->softwareBuildId().isEmpty())
-                qCDebug(dcZigbee()) << "  Version" << endpoint->softwareBuildId();
-
-            qCDebug(dcZigbee()) << "    Input clusters (" << endpoint->inputClusters().count() << ")";
-            foreach (ZigbeeCluster *cluster, endpoint->inputClusters()) {
-                qCDebug(dcZigbee()) << "     -" << cluster;
-                foreach(const ZigbeeClusterAttribute &attribute, cluster->attributes()) {
-                    qCDebug(dcZigbee()) << "       - " << attribute;
-                }
-            }
-
-            qCDebug(dcZigbee()) << "    Output clusters (" << endpoint->outputClusters().count() << ")";
-            foreach (ZigbeeCluster *cluster, endpoint->outputClusters()) {
-                qCDebug(dcZigbee()) << "     -" << cluster;
-                foreach(const ZigbeeClusterAttribute &attribute, cluster->attributes()) {
-                    qCDebug(dcZigbee()) << "       - " << attribute;
-                }
-            }
-        }
-
         emit nodeAdded(network->networkUuid(), node);
     });
 
     connect(network, &ZigbeeNetwork::nodeRemoved, this, [this, network](ZigbeeNode *node){
         qCDebug(dcZigbee()) << "Node removed from" << network->networkUuid().toString() << node;
+        m_changedNodes.remove(node);
         // The plugin don't need to see the coordinator node
         if (node->shortAddress() == 0) {
             return;
@@ -560,37 +610,9 @@ void ZigbeeManager::addNetwork(ZigbeeNetwork *network)
     m_zigbeeNetworks.insert(network->networkUuid(), network);
     emit zigbeeNetworkAdded(network);
 
-    qCDebug(dcZigbee()) << "Network added" << network;
-    foreach (ZigbeeNode *node, network->nodes()) {
-        qCDebug(dcZigbee()) << "-->" << node;
-        foreach (ZigbeeNodeEndpoint *endpoint, node->endpoints()) {
-            qCDebug(dcZigbee()) << " " << endpoint;
-            if (!endpoint->manufacturerName().isEmpty())
-                qCDebug(dcZigbee()) << "  Manufacturer:" << endpoint->manufacturerName();
-
-            if (!endpoint->modelIdentifier().isEmpty())
-                qCDebug(dcZigbee()) << "  Model" << endpoint->modelIdentifier();
-
-            if (!endpoint->softwareBuildId().isEmpty())
-                qCDebug(dcZigbee()) << "  Version" << endpoint->softwareBuildId();
-
-            qCDebug(dcZigbee()) << "    Input clusters (" << endpoint->inputClusters().count() << ")";
-            foreach (ZigbeeCluster *cluster, endpoint->inputClusters()) {
-                qCDebug(dcZigbee()) << "     -" << cluster;
-                foreach(const ZigbeeClusterAttribute &attribute, cluster->attributes()) {
-                    qCDebug(dcZigbee()) << "       - " << attribute;
-                }
-            }
-
-            qCDebug(dcZigbee()) << "    Output clusters (" << endpoint->outputClusters().count() << ")";
-            foreach (ZigbeeCluster *cluster, endpoint->outputClusters()) {
-                qCDebug(dcZigbee()) << "     -" << cluster;
-                foreach(const ZigbeeClusterAttribute &attribute, cluster->attributes()) {
-                    qCDebug(dcZigbee()) << "       - " << attribute;
-                }
-            }
-        }
-    }
+    // The full node dump is available on demand through networkDump(), walking all clusters
+    // and attributes here would make the startup time grow with the network size.
+    qCDebug(dcZigbee()) << "Network added" << network << "with" << network->nodes().count() << "nodes";
 
     foreach (ZigbeeNode *node, network->nodes()) {
         setupNodeSignals(node);
@@ -645,37 +667,65 @@ void ZigbeeManager::setupNodeSignals(ZigbeeNode *node)
     // Connect signals while joining for initializing
 
     connect(node, &ZigbeeNode::shortAddressChanged, this, [=](){
-        emit nodeChanged(node->networkUuid(), node);
+        emitNodeChanged(node);
     });
 
     connect(node, &ZigbeeNode::stateChanged, this, [=](){
-        emit nodeChanged(node->networkUuid(), node);
+        emitNodeChanged(node);
     });
 
     connect(node, &ZigbeeNode::manufacturerNameChanged, this, [=](){
-        emit nodeChanged(node->networkUuid(), node);
+        emitNodeChanged(node);
     });
 
     connect(node, &ZigbeeNode::modelNameChanged, this, [=](){
-        emit nodeChanged(node->networkUuid(), node);
+        emitNodeChanged(node);
     });
 
     connect(node, &ZigbeeNode::versionChanged, this, [=](){
-        emit nodeChanged(node->networkUuid(), node);
+        emitNodeChanged(node);
     });
 
     connect(node, &ZigbeeNode::lqiChanged, this, [=](){
-        emit nodeChanged(node->networkUuid(), node);
+        scheduleNodeChanged(node);
     });
 
     connect(node, &ZigbeeNode::lastSeenChanged, this, [=](){
-        emit nodeChanged(node->networkUuid(), node);
+        scheduleNodeChanged(node);
     });
 
     connect(node, &ZigbeeNode::reachableChanged, this, [=](){
-        emit nodeChanged(node->networkUuid(), node);
+        emitNodeChanged(node);
+    });
+
+    connect(node, &ZigbeeNode::destroyed, this, [=](){
+        m_changedNodes.remove(node);
     });
 }
 
+void ZigbeeManager::emitNodeChanged(ZigbeeNode *node)
+{
+    // A pending coalesced change is covered by this one
+    m_changedNodes.remove(node);
+    emit nodeChanged(node->networkUuid(), node);
+}
+
+void ZigbeeManager::scheduleNodeChanged(ZigbeeNode *node)
+{
+    m_changedNodes.insert(node);
+    if (!m_nodeChangedTimer.isActive()) {
+        m_nodeChangedTimer.start();
+    }
+}
+
+void ZigbeeManager::emitPendingNodeChanges()
+{
+    QSet<ZigbeeNode*> changedNodes = m_changedNodes;
+    m_changedNodes.clear();
+    foreach (ZigbeeNode *node, changedNodes) {
+        emit nodeChanged(node->networkUuid(), node);
+    }
+}
+
 
 }
@@ -32,6 +32,8 @@
 #define ZIGBEEMANAGER_H
 
 #include <QObject>
+#include <QTimer>
+#include <QSet>
 
 #include <zigbeenetworkmanager.h>
 #include <zigbeeuartadaptermonitor.h>
@@ -84,6 +86,7 @@ public:
     Q_ENUM(ZigbeeNodeState)
 
     explicit ZigbeeManager(QObject *parent = nullptr);
+    ~ZigbeeManager() override;
 
     bool available() const;
     bool enabled() const;
@@ -96,6 +99,9 @@ public:
     ZigbeeError setZigbeeNetworkPermitJoin(const QUuid &networkUuid, quint16 shortAddress = Zigbee::BroadcastAddressAllRouters, uint duration = 120);
     ZigbeeError factoryResetNetwork(const QUuid &networkUuid);
 
+    // Human readable dump of all networks, nodes, endpoints, clusters and attributes
+    QString networkDump() const;
+
 private:
     ZigbeeAdapters m_adapters;
     ZigbeeUartAdapterMonitor *m_adapterMonitor = nullptr;
@@ -104,7 +110,15 @@ private:
     bool m_available = false;
     bool m_autoSetupAdapters = false;
 
+    QTimer m_saveTimer;
+    QSet<QUuid> m_networksToSave;
+
+    QTimer m_nodeChangedTimer;
+    QSet<ZigbeeNode*> m_changedNodes;
+
     void saveNetwork(ZigbeeNetwork *network);
+    void scheduleSaveNetwork(ZigbeeNetwork *network);
+    void savePendingNetworks();
     void loadZigbeeNetworks();
     void checkPlatformConfiguration();
     bool networkExistsForAdapter(const ZigbeeUartAdapter &uartAdapter);
@@ -116,6 +130,9 @@ private:
     ZigbeeAdapter convertUartAdapterToAdapter(const ZigbeeUartAdapter &uartAdapter);
     void evaluateZigbeeAvailable();
     void setupNodeSignals(ZigbeeNode *node);
+    void emitNodeChanged(ZigbeeNode *node);
+    void scheduleNodeChanged(ZigbeeNode *node);
+    void emitPendingNodeChanges();
 
 signals:
     void availableChanged(bool available);
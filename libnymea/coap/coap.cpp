@@ -41,6 +41,9 @@
     This class supports also blockwise transfere according to the \l{https://tools.ietf.org/html/draft-ietf-core-block-18}{IETF V18} specifications and
     observing resources according to the \l{https://tools.ietf.org/html/rfc7641}{RFC7641}.
 
+    Large blockwise responses can be streamed and downloaded with several block requests in flight, see
+    \l{CoapRequest::setStreamingEnabled()} and \l{CoapRequest::setPipelineDepth()}.
+
     \sa CoapReply, CoapRequest
 
     \section2 Example
@@ -89,7 +92,8 @@ Q_LOGGING_CATEGORY(dcCoap, "Coap")
 /*! Constructs a Coap access manager with the given \a parent and \a port. */
 Coap::Coap(QObject *parent, const quint16 &port) :
     QObject(parent),
-    m_reply(nullptr)
+    m_nStart(1),
+    m_responseCacheEnabled(false)
 {
     m_socket = new QUdpSocket(this);
 
@@ -99,6 +103,70 @@ Coap::Coap(QObject *parent, const quint16 &port) :
     connect(m_socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
 }
 
+/*! Returns the default number of simultaneous outstanding confirmable requests per endpoint (NSTART).
+    The default value is 1, as recommended in \l{https://tools.ietf.org/html/rfc7252#section-4.7}{RFC7252 section 4.7}.
+
+    \sa setNStart()
+*/
+int Coap::nStart() const
+{
+    return m_nStart;
+}
+
+/*! Sets the default number of simultaneous outstanding confirmable requests per endpoint to \a nStart.
+    Requests to different endpoints are always sent in parallel, requests exceeding the limit for one
+    endpoint are queued until an outstanding request to that endpoint has finished.
+
+    \sa nStart()
+*/
+void Coap::setNStart(int nStart)
+{
+    m_nStart = qMax(1, nStart);
+    foreach (const QString &endpoint, m_pendingRequests.keys()) {
+        startPendingRequests(endpoint);
+    }
+}
+
+/*! Sets the number of simultaneous outstanding confirmable requests for the endpoint with the given
+    \a hostAddress and \a port to \a nStart, overriding the default value set with setNStart() for
+    this endpoint. Use this only for servers which are known to handle parallel requests well.
+*/
+void Coap::setNStart(const QHostAddress &hostAddress, const quint16 &port, int nStart)
+{
+    QString endpoint = endpointKey(hostAddress, port);
+    m_endpointNStart.insert(endpoint, qMax(1, nStart));
+    startPendingRequests(endpoint);
+}
+
+/*! Returns true if responses of GET requests get cached.
+
+    \sa setResponseCacheEnabled()
+*/
+bool Coap::responseCacheEnabled() const
+{
+    return m_responseCacheEnabled;
+}
+
+/*! Enables or disables the response cache according to \a enabled. If enabled, successful responses to GET
+    requests are kept as long as their Max-Age option allows, and identical GET requests are answered
+    from the cache without sending a message. Successful PUT, POST and DELETE requests invalidate the
+    cached response of their resource (\l{https://tools.ietf.org/html/rfc7252#section-5.6}{RFC7252 section 5.6}).
+
+    \sa clearResponseCache()
+*/
+void Coap::setResponseCacheEnabled(bool enabled)
+{
+    m_responseCacheEnabled = enabled;
+    if (!enabled)
+        clearResponseCache();
+}
+
+/*! Removes all cached responses. */
+void Coap::clearResponseCache()
+{
+    m_responseCache.clear();
+}
+
 /*! Performs a ping request to the CoAP server specified in the given \a request.
  *  Returns a \l{CoapReply} to match the response with the request. */
 CoapReply *Coap::ping(const CoapRequest &request)
@@ -108,6 +176,7 @@ CoapReply *Coap::ping(const CoapRequest &request)
 
     connect(reply, &CoapReply::timeout, this, &Coap::onReplyTimeout);
     connect(reply, &CoapReply::finished, this, &Coap::onReplyFinished);
+    connect(reply, &CoapReply::destroyed, this, [this, reply](){ releaseReply(reply); });
 
     if (request.url().scheme() != "coap") {
         reply->setError(CoapReply::InvalidUrlSchemeError);
@@ -115,13 +184,7 @@ CoapReply *Coap::ping(const CoapRequest &request)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply == 0) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    lookupHost(reply);
 
     return reply;
 }
@@ -135,6 +198,7 @@ CoapReply *Coap::get(const CoapRequest &request)
 
     connect(reply, &CoapReply::timeout, this, &Coap::onReplyTimeout);
     connect(reply, &CoapReply::finished, this, &Coap::onReplyFinished);
+    connect(reply, &CoapReply::destroyed, this, [this, reply](){ releaseReply(reply); });
 
     if (request.url().scheme() != "coap") {
         reply->setError(CoapReply::InvalidUrlSchemeError);
@@ -142,13 +206,10 @@ CoapReply *Coap::get(const CoapRequest &request)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply == 0) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    if (finishFromCache(reply))
+        return reply;
+
+    lookupHost(reply);
     return reply;
 }
 
@@ -162,6 +223,7 @@ CoapReply *Coap::put(const CoapRequest &request, const QByteArray &data)
 
     connect(reply, &CoapReply::timeout, this, &Coap::onReplyTimeout);
     connect(reply, &CoapReply::finished, this, &Coap::onReplyFinished);
+    connect(reply, &CoapReply::destroyed, this, [this, reply](){ releaseReply(reply); });
 
     if (request.url().scheme() != "coap") {
         reply->setError(CoapReply::InvalidUrlSchemeError);
@@ -169,13 +231,7 @@ CoapReply *Coap::put(const CoapRequest &request, const QByteArray &data)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply == 0) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    lookupHost(reply);
 
     return reply;
 }
@@ -190,6 +246,7 @@ CoapReply *Coap::post(const CoapRequest &request, const QByteArray &data)
 
     connect(reply, &CoapReply::timeout, this, &Coap::onReplyTimeout);
     connect(reply, &CoapReply::finished, this, &Coap::onReplyFinished);
+    connect(reply, &CoapReply::destroyed, this, [this, reply](){ releaseReply(reply); });
 
     if (request.url().scheme() != "coap") {
         reply->setError(CoapReply::InvalidUrlSchemeError);
@@ -197,13 +254,7 @@ CoapReply *Coap::post(const CoapRequest &request, const QByteArray &data)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply == 0) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    lookupHost(reply);
 
     return reply;
 }
@@ -217,6 +268,7 @@ CoapReply *Coap::deleteResource(const CoapRequest &request)
 
     connect(reply, &CoapReply::timeout, this, &Coap::onReplyTimeout);
     connect(reply, &CoapReply::finished, this, &Coap::onReplyFinished);
+    connect(reply, &CoapReply::destroyed, this, [this, reply](){ releaseReply(reply); });
 
     if (request.url().scheme() != "coap") {
         reply->setError(CoapReply::InvalidUrlSchemeError);
@@ -224,13 +276,7 @@ CoapReply *Coap::deleteResource(const CoapRequest &request)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply.isNull()) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    lookupHost(reply);
 
     return reply;
 }
@@ -247,6 +293,7 @@ CoapReply *Coap::enableResourceNotifications(const CoapRequest &request)
 
     connect(reply, &CoapReply::timeout, this, &Coap::onReplyTimeout);
     connect(reply, &CoapReply::finished, this, &Coap::onReplyFinished);
+    connect(reply, &CoapReply::destroyed, this, [this, reply](){ releaseReply(reply); });
 
     if (request.url().scheme() != "coap") {
         reply->setError(CoapReply::InvalidUrlSchemeError);
@@ -254,13 +301,7 @@ CoapReply *Coap::enableResourceNotifications(const CoapRequest &request)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply.isNull()) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    lookupHost(reply);
 
     return reply;
 }
@@ -278,6 +319,7 @@ CoapReply *Coap::disableNotifications(const CoapRequest &request)
 
     connect(reply, &CoapReply::timeout, this, &Coap::onReplyTimeout);
     connect(reply, &CoapReply::finished, this, &Coap::onReplyFinished);
+    connect(reply, &CoapReply::destroyed, this, [this, reply](){ releaseReply(reply); });
 
     if (request.url().scheme() != "coap") {
         reply->setError(CoapReply::InvalidUrlSchemeError);
@@ -285,21 +327,161 @@ CoapReply *Coap::disableNotifications(const CoapRequest &request)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply == 0) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    lookupHost(reply);
 
     return reply;
 }
 
-void Coap::lookupHost()
+QString Coap::endpointKey(const QHostAddress &hostAddress, const quint16 &port)
 {
-    int lookupId = QHostInfo::lookupHost(m_reply->request().url().host(), this, SLOT(hostLookupFinished(QHostInfo)));
-    m_runningHostLookups.insert(lookupId, m_reply);
+    return QString("%1:%2").arg(hostAddress.toString()).arg(port);
+}
+
+int Coap::endpointNStart(const QString &endpoint) const
+{
+    return m_endpointNStart.value(endpoint, m_nStart);
+}
+
+void Coap::lookupHost(CoapReply *reply)
+{
+    int lookupId = QHostInfo::lookupHost(reply->request().url().host(), this, SLOT(hostLookupFinished(QHostInfo)));
+    m_runningHostLookups.insert(lookupId, reply);
+}
+
+void Coap::scheduleRequest(CoapReply *reply, const bool &lookedUp)
+{
+    reply->m_lockedUp = lookedUp;
+
+    // Non confirmable requests will not be acknowledged, they don't count against NSTART
+    if (reply->request().messageType() == CoapPdu::NonConfirmable) {
+        sendRequest(reply, lookedUp);
+        return;
+    }
+
+    QString endpoint = endpointKey(reply->hostAddress(), reply->port());
+    if (m_outstandingRequests.value(endpoint) >= endpointNStart(endpoint)) {
+        qCDebug(dcCoap) << "Request limit reached for" << endpoint << "Queueing request" << reply->request().url().toString();
+        m_pendingRequests[endpoint].enqueue(reply);
+        return;
+    }
+
+    m_outstandingRequests[endpoint]++;
+    m_replyEndpoints.insert(reply, endpoint);
+    sendRequest(reply, lookedUp);
+}
+
+void Coap::startPendingRequests(const QString &endpoint)
+{
+    while (m_pendingRequests.contains(endpoint) && m_outstandingRequests.value(endpoint) < endpointNStart(endpoint)) {
+        QPointer<CoapReply> reply = m_pendingRequests[endpoint].dequeue();
+        if (m_pendingRequests.value(endpoint).isEmpty())
+            m_pendingRequests.remove(endpoint);
+
+        if (reply.isNull() || reply->isFinished())
+            continue;
+
+        m_outstandingRequests[endpoint]++;
+        m_replyEndpoints.insert(reply, endpoint);
+        sendRequest(reply, reply->m_lockedUp);
+    }
+}
+
+void Coap::releaseReply(CoapReply *reply)
+{
+    // Note: the reply might already be destroyed, use the pointer only as key
+    foreach (int lookupId, m_runningHostLookups.keys(reply)) {
+        QHostInfo::abortHostLookup(lookupId);
+        m_runningHostLookups.remove(lookupId);
+    }
+
+    foreach (const quint16 &messageId, m_repliesById.keys(reply))
+        m_repliesById.remove(messageId);
+
+    foreach (const QByteArray &token, m_repliesByToken.keys(reply))
+        m_repliesByToken.remove(token);
+
+    if (!m_replyEndpoints.contains(reply))
+        return;
+
+    QString endpoint = m_replyEndpoints.take(reply);
+    if (--m_outstandingRequests[endpoint] <= 0)
+        m_outstandingRequests.remove(endpoint);
+
+    startPendingRequests(endpoint);
+}
+
+void Coap::updateMessageId(CoapReply *reply, const quint16 &messageId)
+{
+    if (m_repliesById.value(reply->messageId()) == reply)
+        m_repliesById.remove(reply->messageId());
+
+    reply->setMessageId(messageId);
+    m_repliesById.insert(messageId, reply);
+}
+
+bool Coap::finishFromCache(CoapReply *reply)
+{
+    if (!m_responseCacheEnabled || reply->m_streaming)
+        return false;
+
+    QString url = reply->request().url().toString();
+    if (!m_responseCache.contains(url))
+        return false;
+
+    const CachedResponse cachedResponse = m_responseCache.value(url);
+    qint64 secondsLeft = QDateTime::currentDateTimeUtc().secsTo(cachedResponse.expirationTime);
+    if (secondsLeft <= 0) {
+        m_responseCache.remove(url);
+        return false;
+    }
+
+    qCDebug(dcCoap) << "Answering GET" << url << "from the response cache";
+    reply->setStatusCode(cachedResponse.statusCode);
+    reply->setContentType(cachedResponse.contentType);
+    reply->setMaxAge(secondsLeft);
+    reply->m_payload = cachedResponse.payload;
+
+    // Finish asynchronously, the caller has to be able to connect to the reply first
+    QTimer::singleShot(0, reply, [reply](){ reply->setFinished(); });
+    return true;
+}
+
+void Coap::cacheResponse(CoapReply *reply)
+{
+    // Streamed replies don't keep their payload
+    if (!m_responseCacheEnabled || reply->error() != CoapReply::NoError || reply->m_streaming)
+        return;
+
+    QString url = reply->request().url().toString();
+    if (reply->requestMethod() != CoapPdu::Get) {
+        // A successful unsafe request invalidates the cached response of the resource
+        if ((reply->statusCode() & 0xe0) == 0x40)
+            m_responseCache.remove(url);
+
+        return;
+    }
+
+    if (reply->observation() || reply->statusCode() != CoapPdu::Content || reply->maxAge() == 0)
+        return;
+
+    QDateTime now = QDateTime::currentDateTimeUtc();
+    if (m_responseCache.count() >= 256) {
+        QMutableHashIterator<QString, CachedResponse> it(m_responseCache);
+        while (it.hasNext()) {
+            if (it.next().value().expirationTime <= now)
+                it.remove();
+        }
+
+        if (m_responseCache.count() >= 256)
+            return;
+    }
+
+    CachedResponse cachedResponse;
+    cachedResponse.statusCode = reply->statusCode();
+    cachedResponse.contentType = reply->contentType();
+    cachedResponse.payload = reply->payload();
+    cachedResponse.expirationTime = now.addSecs(reply->maxAge());
+    m_responseCache.insert(url, cachedResponse);
 }
 
 void Coap::sendRequest(CoapReply *reply, const bool &lookedUp)
@@ -310,6 +492,13 @@ void Coap::sendRequest(CoapReply *reply, const bool &lookedUp)
     pdu.createMessageId();
     pdu.createToken();
 
+    // Message id and token have to be unique among all outstanding requests
+    while (m_repliesById.contains(pdu.messageId()))
+        pdu.createMessageId();
+
+    while (m_repliesByToken.contains(pdu.token()))
+        pdu.createToken();
+
     // Add the options in correct order
     // Option number 3
     if (lookedUp)
@@ -350,9 +539,9 @@ void Coap::sendRequest(CoapReply *reply, const bool &lookedUp)
         pdu.addOption(CoapOption::ContentFormat, QByteArray(1, ((quint8)reply->request().contentType())));
 
         // check if we have to block the payload
-        if (reply->requestPayload().size() > 64) {
-            pdu.addOption(CoapOption::Block1, CoapPduBlock::createBlock(0, 2, true));
-            pdu.setPayload(reply->requestPayload().mid(0, 64));
+        if (reply->requestPayload().size() > reply->m_blockSize) {
+            pdu.addOption(CoapOption::Block1, CoapPduBlock::createBlock(0, CoapPduBlock::sizeExponent(reply->m_blockSize), true));
+            pdu.setPayload(reply->requestPayload().mid(0, reply->m_blockSize));
         } else {
             pdu.setPayload(reply->requestPayload());
         }
@@ -364,14 +553,17 @@ void Coap::sendRequest(CoapReply *reply, const bool &lookedUp)
 
     // Option number 23
     if (reply->requestMethod() == CoapPdu::Get)
-        pdu.addOption(CoapOption::Block2, CoapPduBlock::createBlock(0));
+        pdu.addOption(CoapOption::Block2, CoapPduBlock::createBlock(0, CoapPduBlock::sizeExponent(reply->m_blockSize)));
 
     QByteArray pduData = pdu.pack();
     reply->setRequestData(pduData);
     reply->setMessageId(pdu.messageId());
     reply->setMessageToken(pdu.token());
     reply->m_lockedUp = lookedUp;
-    reply->m_timer->start();
+    reply->startRetransmissionTimer();
+
+    m_repliesById.insert(pdu.messageId(), reply);
+    m_repliesByToken.insert(pdu.token(), reply);
 
     qCDebug(dcCoap) << "--->" << pdu;
 
@@ -394,29 +586,37 @@ void Coap::sendCoapPdu(const QHostAddress &hostAddress, const quint16 &port, con
     m_socket->writeDatagram(pdu.pack(), hostAddress, port);
 }
 
-void Coap::processResponse(const CoapPdu &pdu, const QHostAddress &address, const quint16 &port)
+void Coap::processResponse(const QByteArray &data, const QHostAddress &address, const quint16 &port)
 {
-    // if we are waiting for a reply response
-    if (m_reply) {
+    CoapPduView pdu(data);
+    if (data.size() < 4) {
+        qCWarning(dcCoap) << "Received datagram from" << address.toString() << "which is too short for a CoAP message";
+        return;
+    }
+
+    // check if the message is a response to a reply (message id based check)
+    CoapReply *reply = m_repliesById.value(pdu.messageId());
+    bool idBased = (reply != nullptr);
+
+    // check if we know the message by token (message token based check)
+    if (!reply)
+        reply = m_repliesByToken.value(pdu.token());
+
+    if (reply) {
         qCDebug(dcCoap) << "<---" << QString("%1:%2").arg(address.toString()).arg(QString::number(port)) << pdu;
         if (!pdu.isValid()) {
             qCWarning(dcCoap) << "Got invalid PDU";
-            m_reply->setError(CoapReply::InvalidPduError);
-            m_reply->setFinished();
-            return;
-        }
-
-        // check if the message is a response to a reply (message id based check)
-        if (m_reply->messageId() == pdu.messageId()) {
-            processIdBasedResponse(m_reply, pdu);
+            reply->setError(CoapReply::InvalidPduError);
+            reply->setFinished();
             return;
         }
 
-        // check if we know the message by token (message token based check)
-        if (m_reply->messageToken() == pdu.token()) {
-            processTokenBasedResponse(m_reply, pdu);
-            return;
+        if (idBased) {
+            processIdBasedResponse(reply, pdu);
+        } else {
+            processTokenBasedResponse(reply, pdu);
         }
+        return;
     }
 
 
@@ -426,7 +626,7 @@ void Coap::processResponse(const CoapPdu &pdu, const QHostAddress &address, cons
     }
 
     // check if this is a notification
-    if (m_observeResources.keys().contains(pdu.token())) {
+    if (m_observeResources.contains(pdu.token())) {
         processNotification(pdu, address, port);
         return;
     }
@@ -439,7 +639,7 @@ void Coap::processResponse(const CoapPdu &pdu, const QHostAddress &address, cons
     sendCoapPdu(address, port, responsePdu);
 }
 
-void Coap::processIdBasedResponse(CoapReply *reply, const CoapPdu &pdu)
+void Coap::processIdBasedResponse(CoapReply *reply, const CoapPduView &pdu)
 {
     // check if this is an empty ACK response (which indicates a separated response)
     if (pdu.statusCode() == CoapPdu::Empty && pdu.messageType() == CoapPdu::Acknowledgement) {
@@ -460,14 +660,21 @@ void Coap::processIdBasedResponse(CoapReply *reply, const CoapPdu &pdu)
         return;
     }
 
+    // check if a block of a blockwise transfer could not be delivered
+    if (reply->m_blockRequests.contains(pdu.messageId())) {
+        processBlock2Failure(reply, pdu);
+        return;
+    }
+
     // Piggybacked response
     reply->setStatusCode(pdu.statusCode());
     reply->setContentType(pdu.contentType());
+    reply->setMaxAge(pdu.optionValue(CoapOption::MaxAge, 60));
     reply->appendPayloadData(pdu.payload());
     reply->setFinished();
 }
 
-void Coap::processTokenBasedResponse(CoapReply *reply, const CoapPdu &pdu)
+void Coap::processTokenBasedResponse(CoapReply *reply, const CoapPduView &pdu)
 {
     // Separate Response
     CoapPdu responsePdu;
@@ -478,11 +685,12 @@ void Coap::processTokenBasedResponse(CoapReply *reply, const CoapPdu &pdu)
 
     reply->setStatusCode(pdu.statusCode());
     reply->setContentType(pdu.contentType());
+    reply->setMaxAge(pdu.optionValue(CoapOption::MaxAge, 60));
     reply->appendPayloadData(pdu.payload());
     reply->setFinished();
 }
 
-void Coap::processNotification(const CoapPdu &pdu, const QHostAddress &address, const quint16 &port)
+void Coap::processNotification(const CoapPduView &pdu, const QHostAddress &address, const quint16 &port)
 {
     CoapObserveResource resource = m_observeResources.value(pdu.token());
     qCDebug(dcCoap) << "<--- Notification" << endl << pdu;
@@ -515,12 +723,7 @@ void Coap::processNotification(const CoapPdu &pdu, const QHostAddress &address,
             m_observerReply->appendPayloadData(pdu.payload());
 
             // Lets store the observation number
-            int notificationNumber = 0;
-            foreach (const CoapOption &option, pdu.options()) {
-                if (option.option() == CoapOption::Observe) {
-                    notificationNumber = option.data().toHex().toInt(0, 16);
-                }
-            }
+            int notificationNumber = pdu.optionValue(CoapOption::Observe);
 
             m_observeReplyResource.insert(m_observerReply, resource);
             m_observeBlockwise.insert(m_observerReply, notificationNumber);
@@ -575,23 +778,20 @@ void Coap::processNotification(const CoapPdu &pdu, const QHostAddress &address,
     qCDebug(dcCoap) << "---> Notification" << endl << responsePdu;
     sendCoapPdu(address, port, responsePdu);
 
-    int notificationNumber = 0;
-    foreach (const CoapOption &option, pdu.options()) {
-        if (option.option() == CoapOption::Observe) {
-            notificationNumber = option.data().toHex().toInt(0, 16);
-        }
-    }
+    int notificationNumber = pdu.optionValue(CoapOption::Observe);
 
     emit notificationReceived(resource, notificationNumber, pdu.payload());
 }
 
-void Coap::processBlock1Response(CoapReply *reply, const CoapPdu &pdu)
+void Coap::processBlock1Response(CoapReply *reply, const CoapPduView &pdu)
 {
     qCDebug(dcCoap) << "Sent successfully block #" << pdu.block().blockNumber();
 
-    // create next block
-    int index = (pdu.block().blockNumber() * 64) + 64;
-    QByteArray newBlockData = reply->requestPayload().mid(index, 64);
+    // create next block, the server may ask for smaller blocks in its response (RFC 7959 2.3)
+    int index = (pdu.block().blockNumber() + 1) * reply->m_blockSize;
+    reply->m_blockSize = qMin(reply->m_blockSize, pdu.block().blockSize());
+    int blockNumber = index / reply->m_blockSize;
+    QByteArray newBlockData = reply->requestPayload().mid(index, reply->m_blockSize);
     bool moreFlag = true;
 
     // check if this was the last block
@@ -603,7 +803,7 @@ void Coap::processBlock1Response(CoapReply *reply, const CoapPdu &pdu)
     }
 
     // check if this is the last block or there will be no next block
-    if (newBlockData.size() < 64 || (index + 64) == reply->requestPayload().size())
+    if (newBlockData.size() < reply->m_blockSize || (index + reply->m_blockSize) == reply->requestPayload().size())
         moreFlag = false;
 
     CoapPdu nextBlockRequest;
@@ -634,74 +834,157 @@ void Coap::processBlock1Response(CoapReply *reply, const CoapPdu &pdu)
         nextBlockRequest.addOption(CoapOption::UriQuery, reply->request().url().query().toUtf8());
 
     // Option number 27
-    nextBlockRequest.addOption(CoapOption::Block1, CoapPduBlock::createBlock(pdu.block().blockNumber() + 1, 2, moreFlag));
+    nextBlockRequest.addOption(CoapOption::Block1, CoapPduBlock::createBlock(blockNumber, CoapPduBlock::sizeExponent(reply->m_blockSize), moreFlag));
 
     nextBlockRequest.setPayload(newBlockData);
 
     QByteArray pduData = nextBlockRequest.pack();
     reply->setRequestData(pduData);
-    reply->m_timer->start();
-    reply->m_retransmissions = 1;
+    reply->startRetransmissionTimer();
 
-    reply->setMessageId(nextBlockRequest.messageId());
+    updateMessageId(reply, nextBlockRequest.messageId());
 
     qCDebug(dcCoap) << "--->" << nextBlockRequest;
     sendData(reply->hostAddress(), reply->port(), pduData);
 }
 
-void Coap::processBlock2Response(CoapReply *reply, const CoapPdu &pdu)
+void Coap::processBlock2Response(CoapReply *reply, const CoapPduView &pdu)
 {
-    reply->appendPayloadData(pdu.payload());
+    CoapPduBlock block(pdu.option(CoapOption::Block2));
+    reply->m_blockRequests.remove(pdu.messageId());
 
-    // check if this was the last block
-    if (!pdu.block().moreFlag()) {
+    // The server answers the first block with the block size it wants to use (RFC 7959 2.2)
+    if (block.blockNumber() == 0 && reply->m_nextBlock == 0)
+        reply->m_blockSize = qMin(reply->m_blockSize, block.blockSize());
+
+    if (!block.moreFlag() && (reply->m_lastBlock < 0 || block.blockNumber() < reply->m_lastBlock))
+        reply->m_lastBlock = block.blockNumber();
+
+    // Duplicates of already delivered blocks are ignored
+    if (block.blockNumber() >= reply->m_nextBlock) {
         reply->setStatusCode(pdu.statusCode());
         reply->setContentType(pdu.contentType());
-        reply->setFinished();
+        reply->setMaxAge(pdu.optionValue(CoapOption::MaxAge, 60));
+        reply->m_receivedBlocks.insert(block.blockNumber(), pdu.payload());
+    }
+
+    deliverBlocks(reply);
+    if (reply->isFinished())
         return;
+
+    requestBlocks(reply, pdu.token());
+}
+
+void Coap::processBlock2Failure(CoapReply *reply, const CoapPduView &pdu)
+{
+    int blockNumber = reply->m_blockRequests.take(pdu.messageId()).blockNumber;
+
+    // Pipelined requests may ask for blocks behind the last one
+    if (reply->m_lastBlock >= 0 && blockNumber > reply->m_lastBlock)
+        return;
+
+    if (reply->m_failedBlock < 0 || blockNumber < reply->m_failedBlock) {
+        reply->m_failedBlock = blockNumber;
+        reply->m_failedStatusCode = pdu.statusCode();
+        reply->m_failedPayload = pdu.payload();
     }
 
-    CoapPdu nextBlockRequest;
-    nextBlockRequest.setContentType(reply->request().contentType());
-    nextBlockRequest.setMessageType(reply->request().messageType());
-    nextBlockRequest.setStatusCode(reply->requestMethod());
-    nextBlockRequest.setMessageId(pdu.messageId() + 1);
-    nextBlockRequest.setToken(pdu.token());
+    deliverBlocks(reply);
+}
 
-    // Add the options in correct order
-    // Option number 3
-    if (reply->m_lockedUp)
-        nextBlockRequest.addOption(CoapOption::UriHost, reply->request().url().host().toUtf8());
+void Coap::deliverBlocks(CoapReply *reply)
+{
+    while (reply->m_receivedBlocks.contains(reply->m_nextBlock)) {
+        reply->appendPayloadData(reply->m_receivedBlocks.take(reply->m_nextBlock));
+        if (reply->m_nextBlock == reply->m_lastBlock) {
+            reply->m_blockRequests.clear();
+            reply->m_receivedBlocks.clear();
+            reply->setFinished();
+            return;
+        }
+        reply->m_nextBlock++;
+    }
 
-    // Option number 7
-    if (reply->port() != 5683)
-        nextBlockRequest.addOption(CoapOption::UriPort, QByteArray::number(reply->request().url().port()));
+    if (reply->m_nextBlock == reply->m_failedBlock) {
+        qCWarning(dcCoap) << "Could not get block #" << reply->m_failedBlock << "of" << reply->request().url().toString();
+        reply->m_blockRequests.clear();
+        reply->m_receivedBlocks.clear();
+        reply->setStatusCode(reply->m_failedStatusCode);
+        reply->appendPayloadData(reply->m_failedPayload);
+        reply->setFinished();
+    }
+}
 
-    QStringList urlTokens = reply->request().url().path().split("/");
-    urlTokens.removeAll(QString());
+void Coap::requestBlocks(CoapReply *reply, const QByteArray &token)
+{
+    int pipelineDepth = reply->request().pipelineDepth();
+    while (reply->m_blockRequests.count() < pipelineDepth) {
+        int blockNumber = reply->m_requestedBlock + 1;
 
-    // Option number 11
-    foreach (const QString &token, urlTokens)
-        nextBlockRequest.addOption(CoapOption::UriPath, token.toUtf8());
+        // Don't request behind the end and keep at most pipelineDepth blocks buffered
+        if (reply->m_lastBlock >= 0 && blockNumber > reply->m_lastBlock)
+            return;
 
-    // Option number 15
-    if (reply->request().url().hasQuery())
-        nextBlockRequest.addOption(CoapOption::UriQuery, reply->request().url().query().toUtf8());
+        if (reply->m_failedBlock >= 0 && blockNumber >= reply->m_failedBlock)
+            return;
 
-    // Option number 23
-    nextBlockRequest.addOption(CoapOption::Block2, CoapPduBlock::createBlock(pdu.block().blockNumber() + 1, 2, false));
+        if (blockNumber >= reply->m_nextBlock + pipelineDepth)
+            return;
 
-    QByteArray pduData = nextBlockRequest.pack();
-    reply->setRequestData(pduData);
-    reply->m_timer->start();
+        quint16 messageId = reply->messageId() + 1;
+        while (m_repliesById.contains(messageId))
+            messageId++;
 
-    reply->setMessageId(nextBlockRequest.messageId());
+        CoapPdu nextBlockRequest;
+        nextBlockRequest.setContentType(reply->request().contentType());
+        nextBlockRequest.setMessageType(reply->request().messageType());
+        nextBlockRequest.setStatusCode(reply->requestMethod());
+        nextBlockRequest.setMessageId(messageId);
+        nextBlockRequest.setToken(token);
 
-    qCDebug(dcCoap) << "--->" << nextBlockRequest;
-    sendData(reply->hostAddress(), reply->port(), pduData);
+        // Add the options in correct order
+        // Option number 3
+        if (reply->m_lockedUp)
+            nextBlockRequest.addOption(CoapOption::UriHost, reply->request().url().host().toUtf8());
+
+        // Option number 7
+        if (reply->port() != 5683)
+            nextBlockRequest.addOption(CoapOption::UriPort, QByteArray::number(reply->request().url().port()));
+
+        QStringList urlTokens = reply->request().url().path().split("/");
+        urlTokens.removeAll(QString());
+
+        // Option number 11
+        foreach (const QString &urlToken, urlTokens)
+            nextBlockRequest.addOption(CoapOption::UriPath, urlToken.toUtf8());
+
+        // Option number 15
+        if (reply->request().url().hasQuery())
+            nextBlockRequest.addOption(CoapOption::UriQuery, reply->request().url().query().toUtf8());
+
+        // Option number 23
+        nextBlockRequest.addOption(CoapOption::Block2, CoapPduBlock::createBlock(blockNumber, CoapPduBlock::sizeExponent(reply->m_blockSize), false));
+
+        QByteArray pduData = nextBlockRequest.pack();
+        reply->setRequestData(pduData);
+        reply->startRetransmissionTimer();
+
+        // Older message ids stay registered, late duplicates of delivered blocks get ignored
+        reply->setMessageId(messageId);
+        m_repliesById.insert(messageId, reply);
+
+        CoapReply::BlockRequest blockRequest;
+        blockRequest.blockNumber = blockNumber;
+        blockRequest.requestData = pduData;
+        reply->m_blockRequests.insert(messageId, blockRequest);
+        reply->m_requestedBlock = blockNumber;
+
+        qCDebug(dcCoap) << "--->" << nextBlockRequest;
+        sendData(reply->hostAddress(), reply->port(), pduData);
+    }
 }
 
-void Coap::processBlock2Notification(CoapReply *reply, const CoapPdu &pdu)
+void Coap::processBlock2Notification(CoapReply *reply, const CoapPduView &pdu)
 {
     if (!m_observeReplyResource.contains(reply)) {
         qCWarning(dcCoap) << "Could not find observation resource for" << reply;
@@ -792,9 +1075,9 @@ void Coap::hostLookupFinished(const QHostInfo &hostInfo)
     // check if the url had to be looked up
     if (reply->request().url().host() != hostAddress.toString()) {
         qCDebug(dcCoap) << reply->request().url().host() << " -> " << hostAddress.toString();
-        sendRequest(reply, true);
+        scheduleRequest(reply, true);
     } else {
-        sendRequest(reply);
+        scheduleRequest(reply, false);
     }
 }
 
@@ -807,10 +1090,8 @@ void Coap::onReadyRead()
     while (m_socket->hasPendingDatagrams()) {
         data.resize(m_socket->pendingDatagramSize());
         m_socket->readDatagram(data.data(), data.size(), &hostAddress, &port);
+        processResponse(data, hostAddress, port);
     }
-
-    CoapPdu pdu(data);
-    processResponse(pdu, hostAddress, port);
 }
 
 void Coap::onReplyTimeout()
@@ -820,6 +1101,17 @@ void Coap::onReplyTimeout()
         qCDebug(dcCoap) << QString("Reply timeout: resending message %1/4").arg(reply->m_retransmissions);
     }
     reply->resend();
+    if (reply->isFinished())
+        return;
+
+    // Resend all outstanding block requests of a pipelined transfer
+    if (!reply->m_blockRequests.isEmpty()) {
+        foreach (const CoapReply::BlockRequest &blockRequest, reply->m_blockRequests)
+            m_socket->writeDatagram(blockRequest.requestData, reply->hostAddress(), reply->port());
+
+        return;
+    }
+
     m_socket->writeDatagram(reply->requestData(), reply->hostAddress(), reply->port());
 }
 
@@ -835,16 +1127,9 @@ void Coap::onReplyFinished()
         return;
     }
 
-    if (reply != m_reply)
-        qCWarning(dcCoap) << "This should never happen!! Please report a bug if you get this message!";
+    // free the slot of this endpoint and send the next queued request
+    releaseReply(reply);
+    cacheResponse(reply);
 
     emit replyFinished(reply);
-    m_reply.clear();
-
-    // check if there is a request in the queue
-    if (!m_replyQueue.isEmpty()) {
-        m_reply = m_replyQueue.dequeue();
-        if (m_reply)
-            lookupHost();
-    }
 }
@@ -38,10 +38,12 @@
 #include <QLoggingCategory>
 #include <QPointer>
 #include <QQueue>
+#include <QDateTime>
 
 #include "libnymea.h"
 #include "coaprequest.h"
 #include "coapreply.h"
+#include "coappduview.h"
 #include "coapobserveresource.h"
 
 /* Information about CoAP
@@ -60,6 +62,16 @@ class LIBNYMEA_EXPORT Coap : public QObject
 public:
     Coap(QObject *parent = nullptr, const quint16 &port = 5683);
 
+    // Congestion control (NSTART)
+    int nStart() const;
+    void setNStart(int nStart);
+    void setNStart(const QHostAddress &hostAddress, const quint16 &port, int nStart);
+
+    // Response cache for GET requests
+    bool responseCacheEnabled() const;
+    void setResponseCacheEnabled(bool enabled);
+    void clearResponseCache();
+
     CoapReply *ping(const CoapRequest &request);
     CoapReply *get(const CoapRequest &request);
     CoapReply *put(const CoapRequest &request, const QByteArray &data = QByteArray());
@@ -72,13 +84,32 @@ public:
 
 
 private:
+    struct CachedResponse {
+        CoapPdu::StatusCode statusCode;
+        CoapPdu::ContentType contentType;
+        QByteArray payload;
+        QDateTime expirationTime;
+    };
+
     QUdpSocket *m_socket;
 
-    QPointer<CoapReply> m_reply;
-    QQueue<CoapReply *> m_replyQueue;
+    // Outstanding requests
+    QHash<quint16, CoapReply *> m_repliesById;                          // message id | reply
+    QHash<QByteArray, CoapReply *> m_repliesByToken;                    // token | reply
+
+    // Congestion control
+    int m_nStart;
+    QHash<QString, int> m_endpointNStart;                               // endpoint | NSTART
+    QHash<QString, int> m_outstandingRequests;                          // endpoint | confirmable requests in flight
+    QHash<QString, QQueue<QPointer<CoapReply> > > m_pendingRequests;   // endpoint | requests waiting for a free slot
+    QHash<CoapReply *, QString> m_replyEndpoints;                       // reply in flight | endpoint
 
     QHash<int, CoapReply *> m_runningHostLookups;
 
+    // Response cache
+    bool m_responseCacheEnabled;
+    QHash<QString, CachedResponse> m_responseCache;                     // url | response
+
     QHash<QByteArray, CoapObserveResource> m_observeResources;          // token | resource
 
     // Blockwise notifications
@@ -86,21 +117,34 @@ private:
     QHash<CoapReply *, CoapObserveResource> m_observeReplyResource;     // observe reply | resource
     QHash<CoapReply *, int> m_observeBlockwise;                         // observe reply | observe nr.
 
-    void lookupHost();
+    static QString endpointKey(const QHostAddress &hostAddress, const quint16 &port);
+    int endpointNStart(const QString &endpoint) const;
+
+    void lookupHost(CoapReply *reply);
+    void scheduleRequest(CoapReply *reply, const bool &lookedUp);
+    void startPendingRequests(const QString &endpoint);
+    void releaseReply(CoapReply *reply);
+    void updateMessageId(CoapReply *reply, const quint16 &messageId);
+
+    bool finishFromCache(CoapReply *reply);
+    void cacheResponse(CoapReply *reply);
     void sendRequest(CoapReply *reply, const bool &lookedUp = false);
     void sendData(const QHostAddress &hostAddress, const quint16 &port, const QByteArray &data);
     void sendCoapPdu(const QHostAddress &address, const quint16 &port, const CoapPdu &pdu);
 
-    void processResponse(const CoapPdu &pdu, const QHostAddress &address, const quint16 &port);
-    void processIdBasedResponse(CoapReply *reply, const CoapPdu &pdu);
-    void processTokenBasedResponse(CoapReply *reply, const CoapPdu &pdu);
+    void processResponse(const QByteArray &data, const QHostAddress &address, const quint16 &port);
+    void processIdBasedResponse(CoapReply *reply, const CoapPduView &pdu);
+    void processTokenBasedResponse(CoapReply *reply, const CoapPduView &pdu);
 
-    void processNotification(const CoapPdu &pdu, const QHostAddress &address, const quint16 &port);
+    void processNotification(const CoapPduView &pdu, const QHostAddress &address, const quint16 &port);
 
-    void processBlock1Response(CoapReply *reply, const CoapPdu &pdu);
-    void processBlock2Response(CoapReply *reply, const CoapPdu &pdu);
+    void processBlock1Response(CoapReply *reply, const CoapPduView &pdu);
+    void processBlock2Response(CoapReply *reply, const CoapPduView &pdu);
+    void processBlock2Failure(CoapReply *reply, const CoapPduView &pdu);
+    void deliverBlocks(CoapReply *reply);
+    void requestBlocks(CoapReply *reply, const QByteArray &token);
 
-    void processBlock2Notification(CoapReply *reply, const CoapPdu &pdu);
+    void processBlock2Notification(CoapReply *reply, const CoapPduView &pdu);
 
 signals:
     void replyFinished(CoapReply *reply);
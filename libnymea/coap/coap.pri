@@ -9,22 +9,26 @@ DEPENDPATH += $$PWD
 HEADERS += \
     $$PWD/coap.h \
     $$PWD/coappdu.h \
+    $$PWD/coappduview.h \
     $$PWD/coapoption.h \
     $$PWD/coaprequest.h \
     $$PWD/coapreply.h \
     $$PWD/coappdublock.h \
     $$PWD/corelinkparser.h \
     $$PWD/corelink.h \
-    $$PWD/coapobserveresource.h
+    $$PWD/coapobserveresource.h \
+    $$PWD/coaphardwareresource.h
 
 SOURCES += \
     $$PWD/coap.cpp \
     $$PWD/coappdu.cpp \
+    $$PWD/coappduview.cpp \
     $$PWD/coapoption.cpp \
     $$PWD/coaprequest.cpp \
     $$PWD/coapreply.cpp \
     $$PWD/coappdublock.cpp \
     $$PWD/corelinkparser.cpp \
     $$PWD/corelink.cpp \
-    $$PWD/coapobserveresource.cpp
+    $$PWD/coapobserveresource.cpp \
+    $$PWD/coaphardwareresource.cpp
 
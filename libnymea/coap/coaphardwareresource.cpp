@@ -0,0 +1,92 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class CoapHardwareResource
+    \brief The shared CoAP client of nymea.
+
+    \ingroup hardware
+    \inmodule libnymea
+
+    The CoapHardwareResource allows plugins to talk to CoAP devices without creating their own \l{Coap}
+    instance. All requests of all plugins are multiplexed over one UDP socket, which keeps block-wise
+    transfers and observations on a single socket and lets identical GET requests be answered from a
+    shared response cache according to the Max-Age of the response.
+
+    Each request returns a \l{CoapReply}; connect to \l{CoapReply::finished()} to get the response
+    and delete the reply using deleteLater() once it is finished. Notifications of observed resources
+    are emitted for all observations with \l{notificationReceived()}, plugins should filter them by
+    the \l{CoapObserveResource} they have enabled.
+
+    \sa Coap, CoapReply
+*/
+
+/*! \fn CoapReply *CoapHardwareResource::ping(const CoapRequest &request);
+    Performs a ping request to the CoAP server specified in the given \a request.
+*/
+
+/*! \fn CoapReply *CoapHardwareResource::get(const CoapRequest &request);
+    Performs a GET request to the CoAP server specified in the given \a request. The reply might be
+    served from the shared response cache.
+*/
+
+/*! \fn CoapReply *CoapHardwareResource::put(const CoapRequest &request, const QByteArray &data = QByteArray());
+    Performs a PUT request to the CoAP server specified in the given \a request and \a data.
+*/
+
+/*! \fn CoapReply *CoapHardwareResource::post(const CoapRequest &request, const QByteArray &data = QByteArray());
+    Performs a POST request to the CoAP server specified in the given \a request and \a data.
+*/
+
+/*! \fn CoapReply *CoapHardwareResource::deleteResource(const CoapRequest &request);
+    Performs a DELETE request to the CoAP server specified in the given \a request.
+*/
+
+/*! \fn CoapReply *CoapHardwareResource::enableResourceNotifications(const CoapRequest &request);
+    Enables notifications (observing) for the resource specified in the given \a request.
+*/
+
+/*! \fn CoapReply *CoapHardwareResource::disableNotifications(const CoapRequest &request);
+    Disables notifications (observing) for the resource specified in the given \a request.
+*/
+
+/*! \fn void CoapHardwareResource::notificationReceived(const CoapObserveResource &resource, const int &notificationNumber, const QByteArray &payload);
+    This signal is emitted when a value of an observed \a resource changed. The \a notificationNumber specifies the count of the notification
+    to keep the correct order. The value can be parsed from the \a payload parameter.
+*/
+
+#include "coaphardwareresource.h"
+
+/*! Constructs a CoapHardwareResource with the given \a parent. */
+CoapHardwareResource::CoapHardwareResource(QObject *parent) :
+    HardwareResource("CoAP", parent)
+{
+
+}
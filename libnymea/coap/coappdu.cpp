@@ -159,6 +159,7 @@
 */
 
 #include "coappdu.h"
+#include "coappduview.h"
 #include "coapoption.h"
 
 #include <QMetaEnum>
@@ -504,71 +505,24 @@ QByteArray CoapPdu::pack() const
 
 void CoapPdu::unpack(const QByteArray &data)
 {
-    // create a CoapPDU
-    if (data.length() < 4) {
-        m_error = InvalidPduSizeError;
-    }
-
-    quint8 *rawData = (quint8 *)data.data();
-    setVersion((rawData[0] & 0xc0) >> 6);
-    setMessageType(static_cast<MessageType>((rawData[0] & 0x30) >> 4));
-    quint8 tokenLength = (rawData[0] & 0xf);
-
-    if (tokenLength > 8) {
-        m_error = InvalidTokenError;
-    }
-
-    setToken(QByteArray((const char *)rawData + 4, tokenLength));
-    setStatusCode(static_cast<StatusCode>(rawData[1]));
-    setMessageId((qint16)data.mid(2,2).toHex().toUInt(0,16));
-
-    // parse options
-    int index = 4 + tokenLength;
-    quint8 optionByte = rawData[index];
-    quint16 delta = 0;
-    while (QByteArray::number(optionByte, 16) != "ff" && optionByte != 0) {
-        quint16 optionNumber = ((optionByte & 0xf0) >> 4);
-
-        // check option delta
-        if (optionNumber < 13) {
-            delta += optionNumber;
-        } else if (optionNumber == 13) {
-            // extended 8 bit option delta
-            delta += (quint8)(rawData[index + 1] + 13);
-            index += 1;
-        } else if (optionNumber == 14) {
-            // extended 16 bit option delta
-            delta += ((rawData[index + 1] << 8) | rawData[index + 2]) + 269;
-            index += 2;
-        } else if (optionNumber == 15) {
-            m_error = InvalidOptionDeltaError;
-        }
+    CoapPduView view(data);
+    m_error = view.error();
+    if (data.length() < 4)
+        return;
 
-        // check option length
-        quint16 optionLength = (optionByte & 0xf);
-        if (optionLength == 13) {
-            // extended 8 bit option length
-            optionLength = (quint8)(rawData[index + 1] - 13);
-            index += 1;
-        } else if (optionLength == 14) {
-            // extended 16 bit option delta
-            optionLength = ((rawData[index + 1] << 8) | rawData[index + 2]) - 269;
-            index += 2;
-        } else if (optionLength == 15) {
-            m_error = InvalidOptionLengthError;
-        }
+    setVersion(view.version());
+    setMessageType(view.messageType());
+    setStatusCode(view.statusCode());
+    setMessageId(view.messageId());
 
-        QByteArray optionData = QByteArray((const char *)rawData + index + 1, optionLength);
-        addOption(static_cast<CoapOption::Option>(delta), optionData);
+    // the token of the view references the datagram
+    QByteArray token = view.token();
+    setToken(QByteArray(token.constData(), token.size()));
 
-        index += optionLength + 1;
-        optionByte = rawData[index];
+    foreach (const CoapOption &option, view.options())
+        addOption(option.option(), option.data());
 
-        if (QByteArray::number(optionByte, 16) == "ff") {
-            setPayload(data.right(data.length() - index - 1));
-            break;
-        }
-    }
+    setPayload(view.payload());
 }
 
 /*! Writes the data of the given \a coapPdu to \a dbg.
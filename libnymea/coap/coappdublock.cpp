@@ -28,49 +28,58 @@
 *
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-#include <math.h>
-
 #include "coappdublock.h"
 
-CoapPduBlock::CoapPduBlock()
+CoapPduBlock::CoapPduBlock() :
+    m_blockNumber(0),
+    m_blockSize(16),
+    m_moreFlag(false)
 {
 }
 
-CoapPduBlock::CoapPduBlock(const QByteArray &blockData)
+// The block option value is NUM (4 - 20 bit) | M (1 bit) | SZX (3 bit) in 0 - 3 bytes (RFC 7959 2.2)
+CoapPduBlock::CoapPduBlock(const QByteArray &blockData) :
+    m_blockNumber(0),
+    m_blockSize(16),
+    m_moreFlag(false)
 {
-    if (blockData.size() == 1) {
-        quint8 block = (quint8)blockData.at(0);
-        m_blockNumber = (block & 0xf0) >> 4;
-        m_blockSize = (quint8) pow(2, (block & 0x07) + 4);
-        m_moreFlag = (bool)((block & 0x8) >> 3);
-    } else if (blockData.size() == 2) {
-        quint16 block = (quint16)blockData.toHex().toUInt(0, 16);
-        m_blockNumber = (int)(block & 0xff0) >> 4;
-        m_blockSize = (int) pow(2, (block & 0x07) + 4);
-        m_moreFlag = (bool)((block & 0x08) >> 3);
-    }
+    if (blockData.size() > 3)
+        return;
+
+    quint32 block = 0;
+    for (int i = 0; i < blockData.size(); i++)
+        block = (block << 8) | (quint8)blockData.at(i);
+
+    m_blockNumber = (int)(block >> 4);
+    m_blockSize = 1 << ((block & 0x07) + 4);
+    m_moreFlag = (bool)((block & 0x08) >> 3);
 }
 
 QByteArray CoapPduBlock::createBlock(const int &blockNumber, const int &blockSize, const bool &moreFlag)
 {
+    quint32 block = ((quint32)blockNumber << 4) | ((quint32)moreFlag << 3) | ((quint32)blockSize & 0x07);
+
     QByteArray blockData;
-    if (blockNumber < 16) {
-        quint8 block = (quint8)blockSize;
-        block |= (quint8)moreFlag << 3;
-        block |= (quint8)blockNumber << 4;
-        blockData = QByteArray(1, (char)block);
-    } else {
-        quint16 block = (quint16)blockSize;
-        block |= (quint16)moreFlag << 3;
-        block |= (quint8)blockNumber << 4;
-        blockData.resize(2);
-        blockData.fill(0);
-        blockData[0] = (quint8)(block >> 8);
-        blockData[1] = (quint8)(block & 0xff);
-    }
+    if (block > 0xffff)
+        blockData.append((char)(block >> 16));
+
+    if (block > 0xff)
+        blockData.append((char)((block >> 8) & 0xff));
+
+    blockData.append((char)(block & 0xff));
     return blockData;
 }
 
+int CoapPduBlock::sizeExponent(int blockSize)
+{
+    // Round down to the next valid block size between 16 and 1024 bytes
+    int szx = 0;
+    while (szx < 6 && (16 << (szx + 1)) <= blockSize)
+        szx++;
+
+    return szx;
+}
+
 int CoapPduBlock::blockNumber() const
 {
     return m_blockNumber;
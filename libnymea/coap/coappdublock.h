@@ -42,6 +42,7 @@ public:
     CoapPduBlock(const QByteArray &blockData);
 
     static QByteArray createBlock(const int &blockNumber, const int &blockSize = 2, const bool &moreFlag = false);
+    static int sizeExponent(int blockSize);
 
     int blockNumber() const;
     int blockSize() const;
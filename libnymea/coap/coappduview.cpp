@@ -0,0 +1,344 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class CoapPduView
+    \brief Provides a read only view on a received CoAP datagram.
+
+    \ingroup coap-group
+    \inmodule libnymea
+
+    The CoapPduView validates the header and the option encoding of the given datagram in one pass
+    without allocating. Options are decoded only when they get accessed. The \l{token()} and the data
+    returned by \l{option()} reference the datagram directly and are only valid as long as this view
+    exists. Use \l{CoapPdu} for assembling or modifying PDUs.
+
+    \sa CoapPdu
+*/
+
+#include "coappduview.h"
+
+#include <QMetaEnum>
+
+static bool readExtendedValue(const quint8 *rawData, int size, int *index, quint32 *value)
+{
+    switch (*value) {
+    case 13:
+        // extended 8 bit value
+        if (*index + 1 > size)
+            return false;
+
+        *value = rawData[*index] + 13;
+        *index += 1;
+        return true;
+    case 14:
+        // extended 16 bit value
+        if (*index + 2 > size)
+            return false;
+
+        *value = ((rawData[*index] << 8) | rawData[*index + 1]) + 269;
+        *index += 2;
+        return true;
+    case 15:
+        // reserved
+        return false;
+    default:
+        return true;
+    }
+}
+
+/*! Constructs a CoapPduView on the given \a data. */
+CoapPduView::CoapPduView(const QByteArray &data) :
+    m_data(data),
+    m_tokenLength(0),
+    m_optionsOffset(0),
+    m_payloadOffset(-1),
+    m_error(CoapPdu::NoError)
+{
+    const quint8 *rawData = reinterpret_cast<const quint8 *>(m_data.constData());
+    if (m_data.size() < 4) {
+        m_error = CoapPdu::InvalidPduSizeError;
+        return;
+    }
+
+    quint8 tokenLength = rawData[0] & 0x0f;
+    if (tokenLength > 8) {
+        m_error = CoapPdu::InvalidTokenError;
+        return;
+    }
+
+    if (4 + tokenLength > m_data.size()) {
+        m_error = CoapPdu::InvalidPduSizeError;
+        return;
+    }
+
+    m_tokenLength = tokenLength;
+    m_optionsOffset = 4 + tokenLength;
+
+    // Validate the options and search the payload marker
+    int offset = m_optionsOffset;
+    quint32 optionNumber = 0;
+    int dataOffset = 0;
+    int dataLength = 0;
+    while (readOption(&offset, &optionNumber, &dataOffset, &dataLength, &m_error)) { }
+
+    if (m_error != CoapPdu::NoError)
+        return;
+
+    if (offset < m_data.size()) {
+        // A payload marker followed by a zero-length payload is a message format error
+        if (offset + 1 >= m_data.size()) {
+            m_error = CoapPdu::InvalidPduSizeError;
+            return;
+        }
+        m_payloadOffset = offset + 1;
+    }
+}
+
+/*! Returns true if the viewed datagram is a valid CoAP message. */
+bool CoapPduView::isValid() const
+{
+    return m_error == CoapPdu::NoError;
+}
+
+/*! Returns the \l{CoapPdu::Error} found while validating the datagram. */
+CoapPdu::Error CoapPduView::error() const
+{
+    return m_error;
+}
+
+/*! Returns the version of the viewed PDU. */
+quint8 CoapPduView::version() const
+{
+    if (m_data.size() < 4)
+        return 0;
+
+    return (static_cast<quint8>(m_data.at(0)) & 0xc0) >> 6;
+}
+
+/*! Returns the \l{CoapPdu::MessageType} of the viewed PDU. */
+CoapPdu::MessageType CoapPduView::messageType() const
+{
+    if (m_data.size() < 4)
+        return CoapPdu::Confirmable;
+
+    return static_cast<CoapPdu::MessageType>((static_cast<quint8>(m_data.at(0)) & 0x30) >> 4);
+}
+
+/*! Returns the \l{CoapPdu::StatusCode} of the viewed PDU. */
+CoapPdu::StatusCode CoapPduView::statusCode() const
+{
+    if (m_data.size() < 4)
+        return CoapPdu::Empty;
+
+    return static_cast<CoapPdu::StatusCode>(static_cast<quint8>(m_data.at(1)));
+}
+
+/*! Returns the message id of the viewed PDU. */
+quint16 CoapPduView::messageId() const
+{
+    if (m_data.size() < 4)
+        return 0;
+
+    return (static_cast<quint8>(m_data.at(2)) << 8) | static_cast<quint8>(m_data.at(3));
+}
+
+/*! Returns the token of the viewed PDU. The returned data references the datagram. */
+QByteArray CoapPduView::token() const
+{
+    return QByteArray::fromRawData(m_data.constData() + 4, m_tokenLength);
+}
+
+/*! Returns true if the viewed PDU contains the given \a option. */
+bool CoapPduView::hasOption(const CoapOption::Option &option) const
+{
+    int dataOffset = 0;
+    int dataLength = 0;
+    return findOption(option, &dataOffset, &dataLength);
+}
+
+/*! Returns the data of the first occurrence of the given \a option. The returned data references the datagram.
+
+    \sa optionValue()
+*/
+QByteArray CoapPduView::option(const CoapOption::Option &option) const
+{
+    int dataOffset = 0;
+    int dataLength = 0;
+    if (!findOption(option, &dataOffset, &dataLength))
+        return QByteArray();
+
+    return QByteArray::fromRawData(m_data.constData() + dataOffset, dataLength);
+}
+
+/*! Returns the data of the given \a option decoded as unsigned integer, or \a defaultValue if the
+    PDU does not contain the option.
+*/
+quint32 CoapPduView::optionValue(const CoapOption::Option &option, quint32 defaultValue) const
+{
+    int dataOffset = 0;
+    int dataLength = 0;
+    if (!findOption(option, &dataOffset, &dataLength))
+        return defaultValue;
+
+    const quint8 *rawData = reinterpret_cast<const quint8 *>(m_data.constData()) + dataOffset;
+    quint32 value = 0;
+    for (int i = 0; i < qMin(dataLength, 4); i++)
+        value = (value << 8) | rawData[i];
+
+    return value;
+}
+
+/*! Returns a list of all options of the viewed PDU. This decodes and copies all options, use
+    \l{option()} or \l{optionValue()} for accessing single options.
+*/
+QList<CoapOption> CoapPduView::options() const
+{
+    QList<CoapOption> options;
+    if (!isValid())
+        return options;
+
+    CoapPdu::Error error = CoapPdu::NoError;
+    int offset = m_optionsOffset;
+    quint32 optionNumber = 0;
+    int dataOffset = 0;
+    int dataLength = 0;
+    while (readOption(&offset, &optionNumber, &dataOffset, &dataLength, &error)) {
+        CoapOption option;
+        option.setOption(static_cast<CoapOption::Option>(optionNumber));
+        option.setData(m_data.mid(dataOffset, dataLength));
+        options.append(option);
+    }
+    return options;
+}
+
+/*! Returns the \l{CoapPdu::ContentType} of the viewed PDU. */
+CoapPdu::ContentType CoapPduView::contentType() const
+{
+    return static_cast<CoapPdu::ContentType>(optionValue(CoapOption::ContentFormat, CoapPdu::TextPlain));
+}
+
+/*! Returns the Block1 option of the viewed PDU, or the Block2 option if there is no Block1 option. */
+CoapPduBlock CoapPduView::block() const
+{
+    if (hasOption(CoapOption::Block1))
+        return CoapPduBlock(option(CoapOption::Block1));
+
+    return CoapPduBlock(option(CoapOption::Block2));
+}
+
+/*! Returns a copy of the payload of the viewed PDU. */
+QByteArray CoapPduView::payload() const
+{
+    if (m_payloadOffset < 0)
+        return QByteArray();
+
+    return m_data.mid(m_payloadOffset);
+}
+
+bool CoapPduView::readOption(int *offset, quint32 *optionNumber, int *dataOffset, int *dataLength, CoapPdu::Error *error) const
+{
+    const quint8 *rawData = reinterpret_cast<const quint8 *>(m_data.constData());
+    int size = m_data.size();
+    int index = *offset;
+
+    // end of the options (payload marker or end of the message)
+    if (index >= size || rawData[index] == 0xff)
+        return false;
+
+    quint32 delta = (rawData[index] & 0xf0) >> 4;
+    quint32 length = rawData[index] & 0x0f;
+    index++;
+
+    if (!readExtendedValue(rawData, size, &index, &delta)) {
+        *error = CoapPdu::InvalidOptionDeltaError;
+        return false;
+    }
+
+    if (!readExtendedValue(rawData, size, &index, &length)) {
+        *error = CoapPdu::InvalidOptionLengthError;
+        return false;
+    }
+
+    if (index + static_cast<int>(length) > size) {
+        *error = CoapPdu::InvalidOptionLengthError;
+        return false;
+    }
+
+    *optionNumber += delta;
+    *dataOffset = index;
+    *dataLength = length;
+    *offset = index + length;
+    return true;
+}
+
+bool CoapPduView::findOption(const CoapOption::Option &option, int *dataOffset, int *dataLength) const
+{
+    if (!isValid())
+        return false;
+
+    CoapPdu::Error error = CoapPdu::NoError;
+    int offset = m_optionsOffset;
+    quint32 optionNumber = 0;
+    while (readOption(&offset, &optionNumber, dataOffset, dataLength, &error)) {
+        if (optionNumber == static_cast<quint32>(option))
+            return true;
+
+        // options are sorted by their number
+        if (optionNumber > static_cast<quint32>(option))
+            return false;
+    }
+    return false;
+}
+
+/*! Writes the data of the given \a coapPdu to \a dbg.
+
+    \sa CoapPduView
+*/
+QDebug operator<<(QDebug debug, const CoapPduView &coapPdu)
+{
+    const QMetaObject &metaObject = CoapPdu::staticMetaObject;
+    QMetaEnum messageTypeEnum = metaObject.enumerator(metaObject.indexOfEnumerator("MessageType"));
+    debug.nospace() << "CoapPdu(" << messageTypeEnum.valueToKey(coapPdu.messageType()) << ")" << endl;
+    debug.nospace() << "  Code: " << CoapPdu::getStatusCodeString(coapPdu.statusCode()) << endl;
+    debug.nospace() << "  Ver: " << coapPdu.version() << endl;
+    debug.nospace() << "  Token: " << coapPdu.token().length() << " " << "0x"+ coapPdu.token().toHex() << endl;
+    debug.nospace() << "  Message ID: " << coapPdu.messageId() << endl;
+    QByteArray payload = coapPdu.payload();
+    debug.nospace() << "  Payload size: " << payload.size() << endl;
+    foreach (const CoapOption &option, coapPdu.options()) {
+        debug.nospace() << "  " << option;
+    }
+
+    if (!payload.isEmpty())
+        debug.nospace() << endl << payload << endl;
+
+    return debug.space();
+}
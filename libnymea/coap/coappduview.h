@@ -0,0 +1,81 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef COAPPDUVIEW_H
+#define COAPPDUVIEW_H
+
+#include <QDebug>
+#include <QByteArray>
+
+#include "libnymea.h"
+#include "coappdu.h"
+#include "coapoption.h"
+#include "coappdublock.h"
+
+class LIBNYMEA_EXPORT CoapPduView
+{
+public:
+    explicit CoapPduView(const QByteArray &data);
+
+    bool isValid() const;
+    CoapPdu::Error error() const;
+
+    // header fields
+    quint8 version() const;
+    CoapPdu::MessageType messageType() const;
+    CoapPdu::StatusCode statusCode() const;
+    quint16 messageId() const;
+    QByteArray token() const;
+
+    // options
+    bool hasOption(const CoapOption::Option &option) const;
+    QByteArray option(const CoapOption::Option &option) const;
+    quint32 optionValue(const CoapOption::Option &option, quint32 defaultValue = 0) const;
+    QList<CoapOption> options() const;
+
+    CoapPdu::ContentType contentType() const;
+    CoapPduBlock block() const;
+
+    QByteArray payload() const;
+
+private:
+    QByteArray m_data;
+    int m_tokenLength;
+    int m_optionsOffset;
+    int m_payloadOffset;
+    CoapPdu::Error m_error;
+
+    bool readOption(int *offset, quint32 *optionNumber, int *dataOffset, int *dataLength, CoapPdu::Error *error) const;
+    bool findOption(const CoapOption::Option &option, int *dataOffset, int *dataLength) const;
+};
+
+QDebug operator<<(QDebug debug, const CoapPduView &coapPdu);
+
+#endif // COAPPDUVIEW_H
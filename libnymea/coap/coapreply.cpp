@@ -76,6 +76,12 @@
     This signal is emitted when the reply is finished.
 */
 
+/*! \fn void CoapReply::readyRead();
+    This signal is emitted for streamed blockwise responses whenever new payload data is available.
+
+    \sa readAll(), CoapRequest::setStreamingEnabled()
+*/
+
 /*! \fn void CoapReply::error(const Error &code);
     This signal is emitted when an error occurred. The given \a code represents the \l{CoapReply::Error}.
 
@@ -117,6 +123,24 @@ QByteArray CoapReply::payload() const
     return m_payload;
 }
 
+/*! Returns the payload data received so far and removes it from the reply. For streamed blockwise
+    responses this keeps the memory usage bounded to the unread blocks.
+
+    \sa readyRead(), CoapRequest::setStreamingEnabled()
+*/
+QByteArray CoapReply::readAll()
+{
+    QByteArray data = m_payload;
+    m_payload.clear();
+    return data;
+}
+
+/*! Returns the number of payload bytes received so far, including already read data. */
+qint64 CoapReply::bytesReceived() const
+{
+    return m_bytesReceived;
+}
+
 /*! Returns true if the \l{CoapReply} is finished.
 
     \sa finished()
@@ -190,6 +214,15 @@ CoapPdu::StatusCode CoapReply::statusCode() const
     return m_statusCode;
 }
 
+/*! Returns the number of seconds the response of this \l{CoapReply} may be cached (Max-Age option).
+    The default is 60 seconds if the server did not send a Max-Age option. For replies served from the
+    response cache this is the remaining freshness of the cached response.
+*/
+quint32 CoapReply::maxAge() const
+{
+    return m_maxAge;
+}
+
 CoapReply::CoapReply(const CoapRequest &request, QObject *parent) :
     QObject(parent),
     m_request(request),
@@ -199,7 +232,16 @@ CoapReply::CoapReply(const CoapRequest &request, QObject *parent) :
     m_contentType(CoapPdu::TextPlain),
     m_messageType(CoapPdu::Acknowledgement),
     m_statusCode(CoapPdu::Empty),
-    m_lockedUp(false)
+    m_maxAge(60),
+    m_lockedUp(false),
+    m_streaming(request.streamingEnabled()),
+    m_bytesReceived(0),
+    m_blockSize(16 << CoapPduBlock::sizeExponent(request.blockSize())),
+    m_nextBlock(0),
+    m_requestedBlock(0),
+    m_lastBlock(-1),
+    m_failedBlock(-1),
+    m_failedStatusCode(CoapPdu::Empty)
 {
     m_timer = new QTimer(this);
     m_timer->setSingleShot(false);
@@ -272,7 +314,19 @@ void CoapReply::resend()
     if (m_retransmissions > 5) {
         setError(CoapReply::TimeoutError);
         setFinished();
+        return;
     }
+
+    // Exponential back-off (RFC7252 section 4.2)
+    m_timer->setInterval(m_timer->interval() * 2);
+}
+
+void CoapReply::startRetransmissionTimer()
+{
+    // Initial timeout between ACK_TIMEOUT and ACK_TIMEOUT * ACK_RANDOM_FACTOR (2 s - 3 s)
+    m_retransmissions = 1;
+    m_timer->setInterval(2000 + qrand() % 1000);
+    m_timer->start();
 }
 
 void CoapReply::setContentType(const CoapPdu::ContentType contentType)
@@ -290,6 +344,11 @@ void CoapReply::setStatusCode(const CoapPdu::StatusCode &statusCode)
     m_statusCode = statusCode;
 }
 
+void CoapReply::setMaxAge(quint32 maxAge)
+{
+    m_maxAge = maxAge;
+}
+
 void CoapReply::setHostAddress(const QHostAddress &address)
 {
     m_hostAddress = address;
@@ -333,8 +392,12 @@ CoapPdu::StatusCode CoapReply::requestMethod() const
 void CoapReply::appendPayloadData(const QByteArray &data)
 {
     m_payload.append(data);
+    m_bytesReceived += data.size();
     m_timer->start();
     m_retransmissions = 1;
+
+    if (m_streaming && !data.isEmpty())
+        emit readyRead();
 }
 
 void CoapReply::setRequestData(const QByteArray &requestData)
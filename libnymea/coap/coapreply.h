@@ -33,6 +33,8 @@
 
 #include <QObject>
 #include <QTimer>
+#include <QMap>
+#include <QHash>
 
 #include "libnymea.h"
 #include "coappdu.h"
@@ -57,6 +59,8 @@ public:
 
     CoapRequest request() const;
     QByteArray payload() const;
+    QByteArray readAll();
+    qint64 bytesReceived() const;
 
     bool isFinished() const;
     bool isRunning() const;
@@ -67,6 +71,7 @@ public:
     CoapPdu::ContentType contentType() const;
     CoapPdu::MessageType messageType() const;
     CoapPdu::StatusCode statusCode() const;
+    quint32 maxAge() const;
 
 private:
     CoapReply(const CoapRequest &request, QObject *parent = 0);
@@ -77,10 +82,12 @@ private:
     void setError(const Error &error);
 
     void resend();
+    void startRetransmissionTimer();
 
     void setContentType(const CoapPdu::ContentType contentType = CoapPdu::TextPlain);
     void setMessageType(const CoapPdu::MessageType &messageType);
     void setStatusCode(const CoapPdu::StatusCode &statusCode);
+    void setMaxAge(quint32 maxAge);
 
     QTimer *m_timer;
     CoapRequest m_request;
@@ -94,6 +101,7 @@ private:
     CoapPdu::ContentType m_contentType;
     CoapPdu::MessageType m_messageType;
     CoapPdu::StatusCode m_statusCode;
+    quint32 m_maxAge;
 
     // data for the request
     void setHostAddress(const QHostAddress &address);
@@ -135,9 +143,28 @@ private:
     bool m_observation;
     bool m_observationEnable;
 
+    // blockwise transfer state
+    struct BlockRequest {
+        int blockNumber;
+        QByteArray requestData;
+    };
+
+    bool m_streaming;
+    qint64 m_bytesReceived;
+    int m_blockSize;
+    int m_nextBlock;
+    int m_requestedBlock;
+    int m_lastBlock;
+    int m_failedBlock;
+    CoapPdu::StatusCode m_failedStatusCode;
+    QByteArray m_failedPayload;
+    QMap<int, QByteArray> m_receivedBlocks;             // out of order blocks
+    QHash<quint16, BlockRequest> m_blockRequests;       // outstanding block requests by message id
+
 signals:
     void timeout();
     void finished();
+    void readyRead();
     void error(const Error &code);
 };
 
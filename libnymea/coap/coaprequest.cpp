@@ -44,7 +44,10 @@ CoapRequest::CoapRequest(const QUrl &url) :
     m_url(url),
     m_contentType(CoapPdu::TextPlain),
     m_messageType(CoapPdu::Confirmable),
-    m_statusCode(CoapPdu::Empty)
+    m_statusCode(CoapPdu::Empty),
+    m_blockSize(64),
+    m_streamingEnabled(false),
+    m_pipelineDepth(1)
 {
 }
 
@@ -85,3 +88,46 @@ CoapPdu::MessageType CoapRequest::messageType() const
 {
     return m_messageType;
 }
+
+/*! Sets the preferred block size for blockwise transfers of this CoAP request to \a blockSize bytes.
+ *  Valid block sizes are the powers of two from 16 to 1024, other values get rounded down. The server
+ *  may answer with smaller blocks, which will then be used for the rest of the transfer. The default
+ *  block size is 64 bytes. */
+void CoapRequest::setBlockSize(int blockSize)
+{
+    m_blockSize = blockSize;
+}
+
+/*! Returns the preferred block size for blockwise transfers in bytes. */
+int CoapRequest::blockSize() const
+{
+    return m_blockSize;
+}
+
+/*! Enables or disables streaming of blockwise responses according to \a streamingEnabled. With streaming
+ *  enabled the \l{CoapReply} emits \l{CoapReply::readyRead()}{readyRead()} for each block received in order
+ *  and only keeps the data not fetched with \l{CoapReply::readAll()}{readAll()} yet. */
+void CoapRequest::setStreamingEnabled(bool streamingEnabled)
+{
+    m_streamingEnabled = streamingEnabled;
+}
+
+/*! Returns true if blockwise responses get streamed. */
+bool CoapRequest::streamingEnabled() const
+{
+    return m_streamingEnabled;
+}
+
+/*! Sets the number of block requests which may be outstanding at a time during a blockwise download to
+ *  \a pipelineDepth. Blocks arriving out of order are held back until the missing blocks arrived, so at
+ *  most \a pipelineDepth blocks get buffered. The default is 1, which requests one block after the other. */
+void CoapRequest::setPipelineDepth(int pipelineDepth)
+{
+    m_pipelineDepth = qMax(1, pipelineDepth);
+}
+
+/*! Returns the number of block requests which may be outstanding at a time. */
+int CoapRequest::pipelineDepth() const
+{
+    return m_pipelineDepth;
+}
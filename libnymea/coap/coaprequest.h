@@ -53,11 +53,23 @@ public:
     void setMessageType(const CoapPdu::MessageType &messageType);
     CoapPdu::MessageType messageType() const;
 
+    void setBlockSize(int blockSize);
+    int blockSize() const;
+
+    void setStreamingEnabled(bool streamingEnabled);
+    bool streamingEnabled() const;
+
+    void setPipelineDepth(int pipelineDepth);
+    int pipelineDepth() const;
+
 private:
     QUrl m_url;
     CoapPdu::ContentType m_contentType;
     CoapPdu::MessageType m_messageType;
     CoapPdu::StatusCode m_statusCode;
+    int m_blockSize;
+    bool m_streamingEnabled;
+    int m_pipelineDepth;
 
 };
 
@@ -39,6 +39,10 @@ class JsonRPCServer;
 namespace nymeaserver {
 class ExperienceManager;
 }
+
+// An experience plugin may declare the JSON-RPC namespaces it registers in its plugin metadata:
+//   { "namespaces": [ { "name": "Energy", "version": "0.1" } ] }
+// Such plugins are not loaded at startup but on the first call into one of those namespaces.
 class ExperiencePlugin : public QObject
 {
     Q_OBJECT
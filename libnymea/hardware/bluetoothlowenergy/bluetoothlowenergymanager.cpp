@@ -46,6 +46,9 @@
     This method starts a Bluetooth discovery process running for \a interval milli seconds. Returns a BluetoothDiscoveryReply object
     which will emits the \l{BluetoothDiscoveryReply::finished()}{finished()} signal when the
     \l{BluetoothDiscoveryReply::discoveredDevices()}{discoveredDevices()} list is ready.
+
+    Discoveries requested while a scan is already running share that scan. Devices recently seen by the
+    running scan are included in the result right away.
 */
 
 /*! \fn BluetoothLowEnergyDevice *BluetoothLowEnergyManager::registerDevice(const QBluetoothDeviceInfo &deviceInfo, const QLowEnergyController::RemoteAddressType &addressType = QLowEnergyController::RandomAddress);
@@ -56,6 +59,25 @@
     This method should be used to unregister the given \a bluetoothDevice in your DevicePlugin if you don't need it any more.
 */
 
+/*! \fn void BluetoothLowEnergyManager::subscribeAdvertisements(QObject *subscriber);
+    Keeps a shared scan running on all adapters as long as the \a subscriber is subscribed and not destroyed. Every
+    received advertisement is emitted in \l{advertisementReceived()}. Devices broadcasting their readings in
+    advertisements can be read this way without establishing a connection.
+*/
+
+/*! \fn void BluetoothLowEnergyManager::unsubscribeAdvertisements(QObject *subscriber);
+    Removes the \a subscriber. The shared scan stops once there are no subscribers and no discoveries left.
+*/
+
+/*! \fn QList<QBluetoothDeviceInfo> BluetoothLowEnergyManager::cachedDevices() const;
+    Returns the latest advertisement of all Bluetooth LE devices seen by recent scans.
+*/
+
+/*! \fn void BluetoothLowEnergyManager::advertisementReceived(const QBluetoothDeviceInfo &deviceInfo);
+    This signal is emitted whenever an advertisement has been received from a device while a scan is running.
+    The \a deviceInfo contains the advertised data like the RSSI, the manufacturer data and the service UUIDs.
+*/
+
 
 #include "bluetoothlowenergymanager.h"
 #include "loggingcategories.h"
@@ -59,8 +59,16 @@ public:
     virtual BluetoothLowEnergyDevice *registerDevice(const QBluetoothDeviceInfo &deviceInfo, const QLowEnergyController::RemoteAddressType &addressType = QLowEnergyController::RandomAddress) = 0;
     virtual void unregisterDevice(BluetoothLowEnergyDevice *bluetoothDevice) = 0;
 
+    // Shared continuous scan for devices broadcasting their data in advertisements
+    virtual void subscribeAdvertisements(QObject *subscriber) = 0;
+    virtual void unsubscribeAdvertisements(QObject *subscriber) = 0;
+    virtual QList<QBluetoothDeviceInfo> cachedDevices() const = 0;
+
 public slots:
     Q_SCRIPTABLE void EnableBluetooth(bool enabled);
+
+signals:
+    void advertisementReceived(const QBluetoothDeviceInfo &deviceInfo);
 };
 
 #endif // BLUETOOTHLOWENERGYMANAGER_H
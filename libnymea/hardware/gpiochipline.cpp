@@ -0,0 +1,256 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class GpioChipLine
+    \brief A single line of a GPIO chip, accessed through the GPIO character device.
+
+    \ingroup hardware
+    \inmodule libnymea
+
+    This class uses \tt{/dev/gpiochip<N>} instead of the sysfs GPIO interface. Output lines are
+    set with a single ioctl instead of a file write, and input lines deliver every edge as an event
+    carrying the kernel timestamp of the interrupt. Timing sensitive code such as the 433 MHz
+    receiver and transmitter should use this class, the time between the edge and the moment the
+    thread gets scheduled does not show up in the measured pulses.
+
+    The class is not thread safe and not a QObject, it is meant to be owned by the single thread
+    doing the GPIO work.
+
+    \code
+        GpioChipLine line("gpiochip0", 27);
+        if (line.requestEdgeEvents()) {
+            foreach (const GpioChipLine::Event &event, line.waitForEvents(1000)) {
+                qDebug() << event.edge << event.timestamp;
+            }
+        }
+    \endcode
+*/
+
+/*! \enum GpioChipLine::Edge
+
+    \value EdgeRising
+        The line changed from low to high.
+    \value EdgeFalling
+        The line changed from high to low.
+*/
+
+#include "gpiochipline.h"
+#include "loggingcategories.h"
+
+#include <linux/gpio.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+/*! Constructs a GpioChipLine for the line \a offset of the given \a chip, e.g. \tt{gpiochip0}. On the
+    Raspberry Pi the offsets on \tt{gpiochip0} are the BCM GPIO numbers. The line needs to be requested
+    before it can be used.
+*/
+GpioChipLine::GpioChipLine(const QString &chip, int offset) :
+    m_chip(chip),
+    m_offset(offset)
+{
+
+}
+
+/*! Destroys this GpioChipLine and releases the line. */
+GpioChipLine::~GpioChipLine()
+{
+    release();
+}
+
+/*! Returns the name of the GPIO chip of this line. */
+QString GpioChipLine::chip() const
+{
+    return m_chip;
+}
+
+/*! Returns the offset of this line on its GPIO chip. */
+int GpioChipLine::offset() const
+{
+    return m_offset;
+}
+
+/*! Requests this line as output with the initial \a value. The \a consumer shows up in the kernel
+    as the user of the line. Returns false if the line could not be requested. */
+bool GpioChipLine::requestOutput(bool value, const QString &consumer)
+{
+    release();
+
+    int chipFd = -1;
+    if (!openChip(&chipFd))
+        return false;
+
+    struct gpiohandle_request request;
+    memset(&request, 0, sizeof(request));
+    request.lineoffsets[0] = static_cast<__u32>(m_offset);
+    request.lines = 1;
+    request.flags = GPIOHANDLE_REQUEST_OUTPUT;
+    request.default_values[0] = value ? 1 : 0;
+    strncpy(request.consumer_label, consumer.toUtf8().constData(), sizeof(request.consumer_label) - 1);
+
+    int result = ioctl(chipFd, GPIO_GET_LINEHANDLE_IOCTL, &request);
+    close(chipFd);
+    if (result < 0) {
+        qCWarning(dcHardware()) << "Could not request GPIO line" << m_offset << "of" << m_chip << "as output:" << strerror(errno);
+        return false;
+    }
+
+    m_lineFd = request.fd;
+    return true;
+}
+
+/*! Requests this line as input delivering events for rising and falling edges. The \a consumer
+    shows up in the kernel as the user of the line. Returns false if the line could not be requested. */
+bool GpioChipLine::requestEdgeEvents(const QString &consumer)
+{
+    release();
+
+    int chipFd = -1;
+    if (!openChip(&chipFd))
+        return false;
+
+    struct gpioevent_request request;
+    memset(&request, 0, sizeof(request));
+    request.lineoffset = static_cast<__u32>(m_offset);
+    request.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    request.eventflags = GPIOEVENT_REQUEST_BOTH_EDGES;
+    strncpy(request.consumer_label, consumer.toUtf8().constData(), sizeof(request.consumer_label) - 1);
+
+    int result = ioctl(chipFd, GPIO_GET_LINEEVENT_IOCTL, &request);
+    close(chipFd);
+    if (result < 0) {
+        qCWarning(dcHardware()) << "Could not request edge events for GPIO line" << m_offset << "of" << m_chip << ":" << strerror(errno);
+        return false;
+    }
+    m_lineFd = request.fd;
+
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLPRI;
+    event.data.fd = m_lineFd;
+    if (m_epollFd < 0 || epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_lineFd, &event) < 0) {
+        qCWarning(dcHardware()) << "Could not watch GPIO line" << m_offset << "of" << m_chip << ":" << strerror(errno);
+        release();
+        return false;
+    }
+    return true;
+}
+
+/*! Releases the line, it can be requested again afterwards. */
+void GpioChipLine::release()
+{
+    if (m_epollFd >= 0) {
+        close(m_epollFd);
+        m_epollFd = -1;
+    }
+    if (m_lineFd >= 0) {
+        close(m_lineFd);
+        m_lineFd = -1;
+    }
+}
+
+/*! Returns true if the line has been requested successfully. */
+bool GpioChipLine::isValid() const
+{
+    return m_lineFd >= 0;
+}
+
+/*! Sets the output line to \a value. Returns false if the line is not requested as output. */
+bool GpioChipLine::setValue(bool value)
+{
+    struct gpiohandle_data data;
+    memset(&data, 0, sizeof(data));
+    data.values[0] = value ? 1 : 0;
+    return m_lineFd >= 0 && ioctl(m_lineFd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) >= 0;
+}
+
+/*! Returns the current value of the line. */
+bool GpioChipLine::value() const
+{
+    struct gpiohandle_data data;
+    memset(&data, 0, sizeof(data));
+    if (m_lineFd < 0 || ioctl(m_lineFd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0)
+        return false;
+
+    return data.values[0] != 0;
+}
+
+/*! Blocks up to \a timeout milli seconds until edges arrive on a line requested with requestEdgeEvents()
+    and returns all queued edges. An empty list is returned on timeout and on errors. */
+QVector<GpioChipLine::Event> GpioChipLine::waitForEvents(int timeout)
+{
+    QVector<Event> events;
+    if (m_epollFd < 0)
+        return events;
+
+    struct epoll_event epollEvent;
+    int result = epoll_wait(m_epollFd, &epollEvent, 1, timeout);
+    if (result <= 0) {
+        if (result < 0 && errno != EINTR)
+            qCWarning(dcHardware()) << "Waiting for GPIO events failed:" << strerror(errno);
+
+        return events;
+    }
+
+    // The kernel queues the edges with their timestamps, drain them all in one go
+    struct gpioevent_data data[16];
+    ssize_t length = read(m_lineFd, data, sizeof(data));
+    if (length < 0) {
+        qCWarning(dcHardware()) << "Could not read GPIO events:" << strerror(errno);
+        return events;
+    }
+
+    int count = static_cast<int>(length / static_cast<ssize_t>(sizeof(struct gpioevent_data)));
+    events.reserve(count);
+    for (int i = 0; i < count; i++) {
+        Event event;
+        event.edge = data[i].id == GPIOEVENT_EVENT_RISING_EDGE ? EdgeRising : EdgeFalling;
+        event.timestamp = data[i].timestamp;
+        events.append(event);
+    }
+    return events;
+}
+
+bool GpioChipLine::openChip(int *chipFd) const
+{
+    QString path = m_chip.startsWith("/") ? m_chip : "/dev/" + m_chip;
+    *chipFd = open(path.toUtf8().constData(), O_RDONLY | O_CLOEXEC);
+    if (*chipFd < 0) {
+        qCWarning(dcHardware()) << "Could not open GPIO chip" << path << ":" << strerror(errno);
+        return false;
+    }
+    return true;
+}
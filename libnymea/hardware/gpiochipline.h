@@ -0,0 +1,80 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef GPIOCHIPLINE_H
+#define GPIOCHIPLINE_H
+
+#include <QString>
+#include <QVector>
+
+#include "libnymea.h"
+
+class LIBNYMEA_EXPORT GpioChipLine
+{
+public:
+    enum Edge {
+        EdgeRising,
+        EdgeFalling
+    };
+
+    struct Event {
+        Edge edge;
+        // Kernel timestamp of the edge in nano seconds
+        quint64 timestamp;
+    };
+
+    explicit GpioChipLine(const QString &chip, int offset);
+    ~GpioChipLine();
+
+    QString chip() const;
+    int offset() const;
+
+    bool requestOutput(bool value = false, const QString &consumer = "nymea");
+    bool requestEdgeEvents(const QString &consumer = "nymea");
+    void release();
+
+    bool isValid() const;
+
+    bool setValue(bool value);
+    bool value() const;
+
+    QVector<Event> waitForEvents(int timeout);
+
+private:
+    QString m_chip;
+    int m_offset;
+
+    int m_lineFd = -1;
+    int m_epollFd = -1;
+
+    bool openChip(int *chipFd) const;
+};
+
+#endif // GPIOCHIPLINE_H
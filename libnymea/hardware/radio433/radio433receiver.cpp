@@ -21,36 +21,58 @@
 #include <QFile>
 #include <QFileSystemWatcher>
 #include <QDebug>
-#include <sys/time.h>
+#include <unistd.h>
+#include <climits>
 
 #include "radio433receiver.h"
 #include "loggingcategories.h"
 
-Radio433Receiver::Radio433Receiver(QObject *parent, int gpio) :
-    QThread(parent),m_gpioPin(gpio)
+// Runs the decoder stage, so decoding never competes with the GPIO thread or the main thread
+class Radio433DecoderThread : public QThread
 {
-    m_timings.clear();
-    m_available = false;
+public:
+    explicit Radio433DecoderThread(Radio433Receiver *receiver) : QThread(receiver), m_receiver(receiver) { }
+
+protected:
+    void run() override {
+        m_receiver->decode();
+    }
 
-    m_mutex.lock();
-    m_enabled = false;
-    m_mutex.unlock();
+private:
+    Radio433Receiver *m_receiver;
+};
 
-    connect(this, &Radio433Receiver::timingReady, this, &Radio433Receiver::handleTiming, Qt::DirectConnection);
+Radio433Receiver::Radio433Receiver(QObject *parent, int gpio) :
+    QThread(parent),
+    m_gpioPin(gpio)
+{
+    m_decoder = new Radio433PulseDecoder();
+    m_decoderThread = new Radio433DecoderThread(this);
 }
 
 Radio433Receiver::~Radio433Receiver()
 {
-    quit();
-    wait();
-    deleteLater();
+    stopReceiver();
+    delete m_decoder;
+    delete m_gpio;
+}
+
+void Radio433Receiver::setDecoder(Radio433Decoder *decoder)
+{
+    if (isRunning()) {
+        qCWarning(dcHardware) << "Cannot change the 433 MHz decoder while the receiver is running";
+        delete decoder;
+        return;
+    }
+    delete m_decoder;
+    m_decoder = decoder;
 }
 
 bool Radio433Receiver::stopReceiver()
 {
-    m_mutex.lock();
-    m_enabled = false;
-    m_mutex.unlock();
+    m_enabled.storeRelease(0);
+    wait();
+    m_decoderThread->wait();
     return true;
 }
 
@@ -61,59 +83,53 @@ bool Radio433Receiver::available()
 
 void Radio433Receiver::run()
 {
-    struct pollfd fdset[2];
-    int gpio_fd = m_gpio->openGpio();
-    char buf[1];
-
-    bool enabled = true;
-    m_mutex.lock();
-    m_enabled = true;
-    m_mutex.unlock();
-
-    int lastTime = micros();
-    // poll the gpio file, if something changes...emit the signal with the current pulse length
-    while(enabled){
-        memset((void*)fdset, 0, sizeof(fdset));
-        fdset[0].fd = STDIN_FILENO;
-        fdset[0].events = POLLIN;
-
-        fdset[1].fd = gpio_fd;
-        fdset[1].events = POLLPRI;
-        int rc = poll(fdset, 2, 1000);
-
-        if (rc < 0) {
-            qCWarning(dcHardware) << "ERROR: poll failed";
-            return;
+    // The duration of a pulse is the distance between the kernel timestamps of its edges,
+    // the scheduling latency of this thread does not end up in the timings.
+    quint64 lastTimestamp = 0;
+    while (m_enabled.loadAcquire()) {
+        foreach (const GpioChipLine::Event &event, m_gpio->waitForEvents(1000)) {
+            if (lastTimestamp != 0) {
+                quint64 duration = (event.timestamp - lastTimestamp) / 1000;
+                m_edges.push(static_cast<int>(qMin<quint64>(duration, INT_MAX)));
+            }
+            lastTimestamp = event.timestamp;
         }
-        if(rc == 0){
-            //timeout
+    }
+}
+
+void Radio433Receiver::decode()
+{
+    int duration = 0;
+    while (m_enabled.loadAcquire()) {
+        int dropped = m_edges.takeDropped();
+        if (dropped > 0) {
+            // Lost edges corrupt the frame being received
+            qCWarning(dcHardware) << "433 MHz decoder too slow, dropped" << dropped << "edges";
+            m_decoder->reset();
         }
-        if (fdset[1].revents & POLLPRI){
-            if(read(fdset[1].fd, buf, 1) != 1){
-                qCWarning(dcHardware) << "could not read GPIO";
+
+        bool idle = true;
+        while (m_edges.pop(&duration)) {
+            idle = false;
+            if (m_decoder->addTiming(duration)) {
+                emit dataReceived(m_decoder->takeFrame());
             }
-            int currentTime = micros();
-            int duration = currentTime - lastTime;
-            lastTime = currentTime;
-            emit timingReady(duration);
         }
 
-        m_mutex.lock();
-        enabled = m_enabled;
-        m_mutex.unlock();
+        // A frame takes tens of milli seconds, collecting edges for a moment costs no latency worth mentioning
+        if (idle) {
+            usleep(2000);
+        }
     }
 }
 
 bool Radio433Receiver::setUpGpio()
 {
     if(!m_gpio){
-        m_gpio = new Gpio(this,m_gpioPin);
+        m_gpio = new GpioChipLine("gpiochip0", m_gpioPin);
     }
 
-    if(!m_gpio->exportGpio() || !m_gpio->setDirection(INPUT) || !m_gpio->setEdgeInterrupt(EDGE_BOTH)){
-        return false;
-    }
-    return true;
+    return m_gpio->requestEdgeEvents("nymea-radio433");
 }
 
 bool Radio433Receiver::startReceiver()
@@ -123,148 +139,138 @@ bool Radio433Receiver::startReceiver()
         return false;
     }
 
-    m_mutex.lock();
-    m_enabled = true;
-    m_mutex.unlock();
     m_available = true;
+    m_decoder->reset();
+    m_enabled.storeRelease(1);
 
-    start();
+    m_decoderThread->start();
+    start(QThread::TimeCriticalPriority);
     return true;
 }
 
-int Radio433Receiver::micros()
+bool Radio433PulseDecoder::addTiming(int duration)
 {
-    struct timeval tv ;
-    int now ;
-    gettimeofday (&tv, NULL) ;
-    now  = (int)tv.tv_sec * (int)1000000 + (int)tv.tv_usec ;
+    // to short...
+    if (duration < m_minimumPulseLength) {
+        m_timings.clear();
+        return false;
+    }
 
-    return (int)(now - m_epochMicro) ;
-}
+    // could by a sync signal...
+    bool sync = duration > m_minimumSyncLength && duration < m_maximumSyncLength;
 
-bool Radio433Receiver::valueInTolerance(int value, int correctValue)
-{
-    // in in range of +- 200 [us] of sollValue return true, eles return false
-    if(value >= (double)correctValue - 200 && value <= (double)correctValue + 200){
-        return true;
+    // got sync signal and list is not empty...
+    if (!m_timings.isEmpty() && sync) {
+        bool complete = completeFrame();
+        m_timings.clear();
+        m_timings.append(duration);
+        m_pulseProtocolOne = duration / 31;
+        m_pulseProtocolTwo = duration / 10;
+        return complete;
     }
-    return false;
-}
 
-bool Radio433Receiver::checkValue(int value)
-{
-    if(valueInTolerance(value,m_pulseProtocolOne) || valueInTolerance(value,2*m_pulseProtocolOne) || valueInTolerance(value,3*m_pulseProtocolOne) || valueInTolerance(value,4*m_pulseProtocolOne) || valueInTolerance(value,8*m_pulseProtocolOne)){
-        return true;
-    }
-    if(valueInTolerance(value,m_pulseProtocolTwo) || valueInTolerance(value,2*m_pulseProtocolTwo) || valueInTolerance(value,3*m_pulseProtocolTwo) || valueInTolerance(value,4*m_pulseProtocolTwo) || valueInTolerance(value,8*m_pulseProtocolTwo)){
-        return true;
+    // got sync signal and list is empty...
+    if (m_timings.isEmpty()) {
+        if (sync) {
+            m_timings.append(duration);
+            m_pulseProtocolOne = duration / 31;
+            m_pulseProtocolTwo = duration / 10;
+        }
+        return false;
     }
-    return false;
-}
 
-bool Radio433Receiver::checkValues(Protocol protocol)
-{
-    switch (protocol) {
-    case Protocol48:
-        for(int i = 1; i < m_timings.count(); i++){
-            if(!(valueInTolerance(m_timings.at(i),m_pulseProtocolOne) || valueInTolerance(m_timings.at(i),2*m_pulseProtocolOne) || valueInTolerance(m_timings.at(i),3*m_pulseProtocolOne) || valueInTolerance(m_timings.at(i),4*m_pulseProtocolOne) || valueInTolerance(m_timings.at(i),8*m_pulseProtocolOne))){
-                break;
-            }
-        }
-        return true;
-    case Protocol64:
-        for(int i = 1; i < m_timings.count(); i++){
-            if(!(valueInTolerance(m_timings.at(i),m_pulseProtocolTwo) || valueInTolerance(m_timings.at(i),2*m_pulseProtocolTwo) || valueInTolerance(m_timings.at(i),3*m_pulseProtocolTwo) || valueInTolerance(m_timings.at(i),4*m_pulseProtocolTwo) || valueInTolerance(m_timings.at(i),8*m_pulseProtocolTwo))){
-                break;
-            }
+    // list not empty and this is a possible value
+    if (checkValue(duration, m_pulseProtocolOne) || checkValue(duration, m_pulseProtocolTwo)) {
+        m_timings.append(duration);
+        if (m_timings.count() == 65) {
+            bool complete = completeFrame();
+            m_timings.clear();
+            return complete;
         }
-        return true;
-    default:
-        break;
+        return false;
     }
+
+    // Noise, drop the partial frame
+    m_timings.clear();
     return false;
 }
 
-void Radio433Receiver::changeReading(bool reading)
+QList<int> Radio433PulseDecoder::takeFrame()
 {
-    if(reading != m_reading){
-        m_reading = reading;
+    QList<int> frame = m_frame;
+    m_frame.clear();
+    return frame;
+}
 
-        //TODO: create colission detection
+void Radio433PulseDecoder::reset()
+{
+    m_timings.clear();
+    m_frame.clear();
+    m_pulseProtocolOne = 0;
+    m_pulseProtocolTwo = 0;
+}
 
-        //emit readingChanged(reading);
-    }
+void Radio433PulseDecoder::setTolerance(int tolerance)
+{
+    m_tolerance = tolerance;
 }
 
-void Radio433Receiver::handleTiming(int duration)
+void Radio433PulseDecoder::setMinimumPulseLength(int minimumPulseLength)
 {
-    // to short...
-    if(duration < 60){
-        changeReading(false);
-        m_timings.clear();
-        return;
-    }
+    m_minimumPulseLength = minimumPulseLength;
+}
 
-    // could by a sync signal...
-    bool sync = false;
-    if(duration > 2400 && duration < 14000){
-        changeReading(false);
-        sync = true;
-    }
+void Radio433PulseDecoder::setSyncRange(int minimumSyncLength, int maximumSyncLength)
+{
+    m_minimumSyncLength = minimumSyncLength;
+    m_maximumSyncLength = maximumSyncLength;
+}
 
-    // got sync signal and list is not empty...
-    if(!m_timings.isEmpty() && sync){
-        // 1 sync bit + 48 data bit
-        if(m_timings.count() == 49 && checkValues(Protocol48)){
-            //qCWarning(dcHardware) << "48 bit ->" << m_timings << "\n--------------------------";
-            changeReading(false);
-            emit dataReceived(m_timings);
-        }
+bool Radio433PulseDecoder::valueInTolerance(int value, int correctValue) const
+{
+    return value >= correctValue - m_tolerance && value <= correctValue + m_tolerance;
+}
 
-        // 1 sync bit + 64 data bit
-        if(m_timings.count() == 65 && checkValues(Protocol64)){
-            //qCWarning(dcHardware) << "64 bit ->" << m_timings << "\n--------------------------";
-            changeReading(false);
-            emit dataReceived(m_timings);
-        }
-        m_timings.clear();
-        m_pulseProtocolOne = 0;
-        m_pulseProtocolTwo = 0;
-        changeReading(false);
-    }
+bool Radio433PulseDecoder::checkValue(int value, int pulse) const
+{
+    return valueInTolerance(value, pulse) || valueInTolerance(value, 2 * pulse) || valueInTolerance(value, 3 * pulse)
+            || valueInTolerance(value, 4 * pulse) || valueInTolerance(value, 8 * pulse);
+}
 
-    // got sync signal and list is empty...
-    if(m_timings.isEmpty() && sync){
-        m_timings.append(duration);
-        m_pulseProtocolOne = (int)((double)m_timings.first()/31);
-        m_pulseProtocolTwo = (int)((double)m_timings.first()/10);
-        changeReading(false);
-        return;
+bool Radio433PulseDecoder::checkValues(Protocol protocol) const
+{
+    int pulse = 0;
+    switch (protocol) {
+    case Protocol48:
+        pulse = m_pulseProtocolOne;
+        break;
+    case Protocol64:
+        pulse = m_pulseProtocolTwo;
+        break;
+    default:
+        return false;
     }
 
-    // list not empty and this is a possible value
-    if(!m_timings.isEmpty() && checkValue(duration)){
-        m_timings.append(duration);
-
-        // check if it could be a signal -> if we have a sync and 15 valid values
-        // set reading true to prevent a collision from own transmitter
-        if(m_timings.count() == 20 && (checkValues(Protocol48) || checkValues(Protocol64))){
-            changeReading(true);
+    for (int i = 1; i < m_timings.count(); i++) {
+        if (!checkValue(m_timings.at(i), pulse)) {
+            return false;
         }
+    }
+    return true;
+}
 
-        // check if we have already a vallid protocol
-        // 1 sync bit + 48 data bit
-        if(m_timings.count() == 49 && checkValues(Protocol48)){
-            //qCWarning(dcHardware) << "48 bit -> " << m_timings << "\n--------------------------";
-            emit dataReceived(m_timings);
-        }
+bool Radio433PulseDecoder::completeFrame()
+{
+    // 1 sync bit + 48 data bit
+    if (m_timings.count() == 49 && checkValues(Protocol48)) {
+        m_frame = m_timings;
+        return true;
+    }
 
-        // 1 sync bit + 64 data bit
-        if(m_timings.count() == 65 && checkValues(Protocol64)){
-            //qCWarning(dcHardware) << "64 bit -> " << m_timings << "\n--------------------------";
-            changeReading(false);
-            emit dataReceived(m_timings);
-            m_timings.clear();
-        }
+    // 1 sync bit + 64 data bit
+    if (m_timings.count() == 65 && checkValues(Protocol64)) {
+        m_frame = m_timings;
+        return true;
     }
+    return false;
 }
@@ -22,23 +22,114 @@
 #define RADIO433RECEIVER_H
 
 #include <QThread>
+#include <QAtomicInt>
+#include <QList>
 
 #include "libnymea.h"
-#include "../gpio.h"
+#include "../gpiochipline.h"
 
-class LIBGUH_EXPORT Radio433Receiver : public QThread
+// Lock-free ring buffer for exactly one producer and one consumer thread.
+// The GPIO thread pushes edge timings, the decoder thread pops them.
+template <typename T, int Size>
+class Radio433RingBuffer
 {
-    Q_OBJECT
 public:
-    explicit Radio433Receiver(QObject *parent = 0, int gpio = 27);
-    ~Radio433Receiver();
+    bool push(const T &value) {
+        int head = m_head.loadAcquire();
+        int next = (head + 1) % Size;
+        if (next == m_tail.loadAcquire()) {
+            m_dropped.ref();
+            return false;
+        }
+        m_buffer[head] = value;
+        m_head.storeRelease(next);
+        return true;
+    }
+
+    bool pop(T *value) {
+        int tail = m_tail.loadAcquire();
+        if (tail == m_head.loadAcquire())
+            return false;
+
+        *value = m_buffer[tail];
+        m_tail.storeRelease((tail + 1) % Size);
+        return true;
+    }
+
+    int takeDropped() {
+        return m_dropped.fetchAndStoreRelaxed(0);
+    }
+
+private:
+    T m_buffer[Size];
+    QAtomicInt m_head = 0;
+    QAtomicInt m_tail = 0;
+    QAtomicInt m_dropped = 0;
+};
+
+// Protocol decoder stage, fed with edge timings in micro seconds from the decoder thread
+class LIBNYMEA_EXPORT Radio433Decoder
+{
+public:
+    virtual ~Radio433Decoder() = default;
 
+    // Returns true if the timing completed a frame, which can be fetched with takeFrame()
+    virtual bool addTiming(int duration) = 0;
+    virtual QList<int> takeFrame() = 0;
+    virtual void reset() = 0;
+};
+
+// Decodes the 48 and 64 bit pulse protocols: one sync pulse followed by the data pulses,
+// all of them multiples of the base pulse length derived from the sync pulse.
+class LIBNYMEA_EXPORT Radio433PulseDecoder : public Radio433Decoder
+{
+public:
     enum Protocol{
         Protocol48,
         Protocol64,
         ProtocolNone
     };
 
+    bool addTiming(int duration) override;
+    QList<int> takeFrame() override;
+    void reset() override;
+
+    // Timing configuration in micro seconds
+    void setTolerance(int tolerance);
+    void setMinimumPulseLength(int minimumPulseLength);
+    void setSyncRange(int minimumSyncLength, int maximumSyncLength);
+
+private:
+    int m_tolerance = 200;
+    int m_minimumPulseLength = 60;
+    int m_minimumSyncLength = 2400;
+    int m_maximumSyncLength = 14000;
+
+    int m_pulseProtocolOne = 0;
+    int m_pulseProtocolTwo = 0;
+
+    QList<int> m_timings;
+    QList<int> m_frame;
+
+    bool valueInTolerance(int value, int correctValue) const;
+    bool checkValue(int value, int pulse) const;
+    bool checkValues(Protocol protocol) const;
+    bool completeFrame();
+};
+
+class LIBNYMEA_EXPORT Radio433Receiver : public QThread
+{
+    Q_OBJECT
+
+    friend class Radio433DecoderThread;
+
+public:
+    explicit Radio433Receiver(QObject *parent = 0, int gpio = 27);
+    ~Radio433Receiver();
+
+    // Takes ownership of the decoder, must be set before starting the receiver
+    void setDecoder(Radio433Decoder *decoder);
+
     bool startReceiver();
     bool stopReceiver();
     bool available();
@@ -48,35 +139,21 @@ protected:
 
 private:
     int m_gpioPin;
-    Gpio *m_gpio;
-    unsigned int m_epochMicro;
+    GpioChipLine *m_gpio = nullptr;
 
-    unsigned int m_pulseProtocolOne;
-    unsigned int m_pulseProtocolTwo;
+    QAtomicInt m_enabled = 0;
+    bool m_available = false;
 
-    QList<int> m_timings;
-
-    QMutex m_mutex;
-    bool m_enabled;
-    bool m_available;
-    bool m_reading;
+    Radio433RingBuffer<int, 4096> m_edges;
+    Radio433Decoder *m_decoder = nullptr;
+    QThread *m_decoderThread = nullptr;
 
     bool setUpGpio();
-    int micros();
-    bool valueInTolerance(int value, int correctValue);
-    bool checkValue(int value);
-    bool checkValues(Protocol protocol);
-    void changeReading(bool reading);
-
-private slots:
-    void handleTiming(int duration);
+    void decode();
 
 signals:
-    void timingReady(int duration);
     void dataReceived(QList<int> rawData);
     void readingChanged(const bool &reading);
-
-public slots:
 };
 
 #endif // RADIO433RECEIVER_H
@@ -28,9 +28,43 @@
 *
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
+/*!
+    \class ZigbeeHandler
+    \brief Handles Zigbee nodes on behalf of a plugin.
+
+    \ingroup hardware
+    \inmodule libnymea
+
+    Handlers are registered in the \l{ZigbeeHardwareResource} and are offered every node joining the network
+    until one of them takes it.
+*/
+
+/*! \class ZigbeeHandler::AttributeReport
+    \brief A changed attribute of a cluster on a node endpoint.
+*/
+
+/*! \fn bool ZigbeeHandler::handleNode(ZigbeeNode *node, const QUuid &networkUuid);
+    Return true if this handler takes care of the given \a node in the network with \a networkUuid.
+*/
+
+/*! \fn void ZigbeeHandler::handleRemoveNode(ZigbeeNode *node, const QUuid &networkUuid);
+    The \a node handled by this handler has been removed from the network with \a networkUuid.
+*/
+
 #include "zigbeehandler.h"
 
 ZigbeeHandler::ZigbeeHandler()
 {
 
 }
+
+/*! Called with all attribute changes of a \a node handled by this handler, collected over a short time window.
+    Repeated reports of the same attribute within that window are coalesced, \a reports only contains the
+    latest value of each attribute. Handlers updating many thing states from reports can use this instead of
+    connecting to the signals of every cluster. The default implementation does nothing.
+*/
+void ZigbeeHandler::handleAttributeReports(ZigbeeNode *node, const QList<ZigbeeHandler::AttributeReport> &reports)
+{
+    Q_UNUSED(node)
+    Q_UNUSED(reports)
+}
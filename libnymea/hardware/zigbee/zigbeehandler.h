@@ -37,12 +37,21 @@
 class LIBNYMEA_EXPORT   ZigbeeHandler
 {
 public:
+    class AttributeReport {
+    public:
+        quint8 endpointId = 0;
+        ZigbeeClusterLibrary::ClusterId clusterId;
+        ZigbeeClusterAttribute attribute;
+    };
+
     ZigbeeHandler();
     virtual ~ZigbeeHandler() = default;
 
     virtual QString name() const = 0;
     virtual bool handleNode(ZigbeeNode *node, const QUuid &networkUuid) = 0;
     virtual void handleRemoveNode(ZigbeeNode *node, const QUuid &networkUuid) = 0;
+
+    virtual void handleAttributeReports(ZigbeeNode *node, const QList<AttributeReport> &reports);
 };
 
 #endif // ZIGBEEHANDLER_H
@@ -73,6 +73,10 @@
     Returns the Zigbee \l{HardwareResource}.
 */
 
+/*! \fn CoapHardwareResource *HardwareManager::coapResource();
+    Returns the shared CoAP client \l{HardwareResource}.
+*/
+
 
 #include "hardwaremanager.h"
 #include "hardwareresource.h"
@@ -46,6 +46,7 @@ class ZigbeeHardwareResource;
 class HardwareResource;
 class ModbusRtuHardwareResource;
 class NetworkDeviceDiscovery;
+class CoapHardwareResource;
 
 class HardwareManager : public QObject
 {
@@ -67,6 +68,7 @@ public:
     virtual ZigbeeHardwareResource *zigbeeResource() = 0;
     virtual ModbusRtuHardwareResource *modbusRtuResource() = 0;
     virtual NetworkDeviceDiscovery *networkDeviceDiscovery() = 0;
+    virtual CoapHardwareResource *coapResource() = 0;
 
 protected:
     void setResourceEnabled(HardwareResource* resource, bool enabled);
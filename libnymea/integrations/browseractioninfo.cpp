@@ -30,7 +30,9 @@
 
 #include "browseractioninfo.h"
 #include "thingmanager.h"
+#include "timeoutwheel.h"
 
+#include <QThread>
 #include <QTimer>
 
 Q_DECLARE_LOGGING_CATEGORY(dcIntegrations)
@@ -43,8 +45,8 @@ BrowserActionInfo::BrowserActionInfo(Thing *thing, ThingManager *thingManager, c
 {
     connect(this, &BrowserActionInfo::finished, this, &BrowserActionInfo::deleteLater, Qt::QueuedConnection);
 
-    if (timeout > 0) {
-        QTimer::singleShot(timeout, this, [this] {
+    if (timeout > 0 && m_thingManager) {
+        m_thingManager->timeoutWheel()->schedule(this, timeout, [this] {
             emit aborted();
             finish(Thing::ThingErrorTimeout);
         });
@@ -87,11 +89,18 @@ QString BrowserActionInfo::translatedDisplayMessage(const QLocale &locale)
 
 void BrowserActionInfo::finish(Thing::ThingError status, const QString &displayMessage)
 {
+    if (QThread::currentThread() != thread()) {
+        QTimer::singleShot(0, this, [this, status, displayMessage](){ finish(status, displayMessage); });
+        return;
+    }
     if (m_finished) {
         qCWarning(dcIntegrations()) << "BrowserActionInfo::finish() called on an already finished object.";
         return;
     }
     m_finished = true;
+    if (m_thingManager) {
+        m_thingManager->timeoutWheel()->cancel(this);
+    }
     m_status = status;
     m_displayMessage = displayMessage;
     staticMetaObject.invokeMethod(this, "finished", Qt::QueuedConnection);
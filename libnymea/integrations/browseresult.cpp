@@ -30,7 +30,9 @@
 
 #include "browseresult.h"
 #include "thingmanager.h"
+#include "timeoutwheel.h"
 
+#include <QThread>
 #include <QTimer>
 
 Q_DECLARE_LOGGING_CATEGORY(dcIntegrations)
@@ -44,8 +46,8 @@ BrowseResult::BrowseResult(Thing *thing, ThingManager *thingManager, const QStri
 {
     connect(this, &BrowseResult::finished, this, &BrowseResult::deleteLater, Qt::QueuedConnection);
 
-    if (timeout > 0) {
-        QTimer::singleShot(timeout, this, [this] {
+    if (timeout > 0 && m_thingManager) {
+        m_thingManager->timeoutWheel()->schedule(this, timeout, [this] {
             emit aborted();
             finish(Thing::ThingErrorTimeout);
         });
@@ -72,6 +74,20 @@ BrowserItems BrowseResult::items() const
     return m_items;
 }
 
+quint32 BrowseResult::cacheTimeout() const
+{
+    return m_cacheTimeout;
+}
+
+/*! Allows the system to cache the items of this result for the given number of \a seconds and to answer the same
+    request from the cache in the meantime. By default nothing is cached. A plugin should only set this if browsing
+    is costly, like asking a media server, and emit \l{IntegrationPlugin::browserItemsChanged} when the content changes
+    before the timeout. */
+void BrowseResult::setCacheTimeout(quint32 seconds)
+{
+    m_cacheTimeout = seconds;
+}
+
 bool BrowseResult::isFinished() const
 {
     return m_finished;
@@ -108,11 +124,18 @@ void BrowseResult::addItems(const BrowserItems &items)
 
 void BrowseResult::finish(Thing::ThingError status, const QString &displayMessage)
 {
+    if (QThread::currentThread() != thread()) {
+        QTimer::singleShot(0, this, [this, status, displayMessage](){ finish(status, displayMessage); });
+        return;
+    }
     if (m_finished) {
         qCWarning(dcIntegrations()) << "BrowseResult::finish() called on an already finished object.";
         return;
     }
     m_finished = true;
+    if (m_thingManager) {
+        m_thingManager->timeoutWheel()->cancel(this);
+    }
     m_status = status;
     m_displayMessage = displayMessage;
     staticMetaObject.invokeMethod(this, "finished", Qt::QueuedConnection);
@@ -49,6 +49,9 @@ public:
 
     BrowserItems items() const;
 
+    quint32 cacheTimeout() const;
+    void setCacheTimeout(quint32 seconds);
+
     bool isFinished() const;
     Thing::ThingError status() const;
     QString displayMessage() const;
@@ -71,6 +74,8 @@ private:
 
     BrowserItems m_items;
 
+    quint32 m_cacheTimeout = 0;
+
     bool m_finished = false;
     Thing::ThingError m_status = Thing::ThingErrorNoError;
     QString m_displayMessage;
@@ -30,7 +30,9 @@
 
 #include "browseritemactioninfo.h"
 #include "thingmanager.h"
+#include "timeoutwheel.h"
 
+#include <QThread>
 #include <QTimer>
 
 Q_DECLARE_LOGGING_CATEGORY(dcIntegrations)
@@ -43,8 +45,8 @@ BrowserItemActionInfo::BrowserItemActionInfo(Thing *thing, ThingManager *thingMa
 {
     connect(this, &BrowserItemActionInfo::finished, this, &BrowserItemActionInfo::deleteLater, Qt::QueuedConnection);
 
-    if (timeout > 0) {
-        QTimer::singleShot(timeout, this, [this] {
+    if (timeout > 0 && m_thingManager) {
+        m_thingManager->timeoutWheel()->schedule(this, timeout, [this] {
             emit aborted();
             finish(Thing::ThingErrorTimeout);
         });
@@ -87,11 +89,18 @@ QString BrowserItemActionInfo::translatedDisplayMessage(const QLocale &locale)
 
 void BrowserItemActionInfo::finish(Thing::ThingError status, const QString &displayMessage)
 {
+    if (QThread::currentThread() != thread()) {
+        QTimer::singleShot(0, this, [this, status, displayMessage](){ finish(status, displayMessage); });
+        return;
+    }
     if (m_finished) {
         qCWarning(dcIntegrations()) << "BrowserItemActionInfo::finish() called on an already finished object.";
         return;
     }
     m_finished = true;
+    if (m_thingManager) {
+        m_thingManager->timeoutWheel()->cancel(this);
+    }
     m_status = status;
     m_displayMessage = displayMessage;
     staticMetaObject.invokeMethod(this, "finished", Qt::QueuedConnection);
@@ -30,7 +30,9 @@
 
 #include "browseritemresult.h"
 #include "thingmanager.h"
+#include "timeoutwheel.h"
 
+#include <QThread>
 #include <QTimer>
 
 Q_DECLARE_LOGGING_CATEGORY(dcIntegrations)
@@ -44,8 +46,8 @@ BrowserItemResult::BrowserItemResult(Thing *thing, ThingManager *thingManager, c
 {
     connect(this, &BrowserItemResult::finished, this, &BrowserItemResult::deleteLater, Qt::QueuedConnection);
 
-    if (timeout > 0) {
-        QTimer::singleShot(timeout, this, [this] {
+    if (timeout > 0 && m_thingManager) {
+        m_thingManager->timeoutWheel()->schedule(this, timeout, [this] {
             emit aborted();
             finish(Thing::ThingErrorTimeout);
         });
@@ -72,6 +74,20 @@ BrowserItem BrowserItemResult::item() const
     return m_item;
 }
 
+quint32 BrowserItemResult::cacheTimeout() const
+{
+    return m_cacheTimeout;
+}
+
+/*! Allows the system to cache the item of this result for the given number of \a seconds and to answer the same
+    request from the cache in the meantime. By default nothing is cached. A plugin should only set this if browsing
+    is costly, like asking a media server, and emit \l{IntegrationPlugin::browserItemsChanged} when the content changes
+    before the timeout. */
+void BrowserItemResult::setCacheTimeout(quint32 seconds)
+{
+    m_cacheTimeout = seconds;
+}
+
 bool BrowserItemResult::isFinished() const
 {
     return m_finished;
@@ -104,11 +120,18 @@ void BrowserItemResult::finish(const BrowserItem &item)
 
 void BrowserItemResult::finish(Thing::ThingError status, const QString &displayMessage)
 {
+    if (QThread::currentThread() != thread()) {
+        QTimer::singleShot(0, this, [this, status, displayMessage](){ finish(status, displayMessage); });
+        return;
+    }
     if (m_finished) {
         qCWarning(dcIntegrations()) << "BrowserItemResult::finish() called on an already finished object.";
         return;
     }
     m_finished = true;
+    if (m_thingManager) {
+        m_thingManager->timeoutWheel()->cancel(this);
+    }
     m_status = status;
     m_displayMessage = displayMessage;
     staticMetaObject.invokeMethod(this, "finished", Qt::QueuedConnection);
@@ -50,6 +50,9 @@ public:
 
     BrowserItem item() const;
 
+    quint32 cacheTimeout() const;
+    void setCacheTimeout(quint32 seconds);
+
     bool isFinished() const;
     Thing::ThingError status() const;
     QString displayMessage() const;
@@ -70,6 +73,8 @@ private:
 
     BrowserItem m_item;
 
+    quint32 m_cacheTimeout = 0;
+
     bool m_finished = false;
     Thing::ThingError m_status = Thing::ThingErrorNoError;
     QString m_displayMessage;
@@ -39,6 +39,14 @@
 
   This is the base class to be subclassed when starting a new integration plugin.
 
+  C++ plugins setting \c{"workerThread": true} in their JSON metadata run in a thread of their own, so that
+  blocking work in the plugin doesn't stall the rest of the system. All the calls into the plugin are made in
+  that thread. Changes to \l{Thing}{Things} are written right away, so reading a state right after setting it
+  returns the new value. The signals announcing the changes are emitted in the core thread afterwards, in the
+  order the plugin made the changes. The info objects are finished in the core thread too. Such a plugin must
+  use itself or other objects living in its thread as context when connecting to things, infos and hardware resources. Hardware resources, like the
+  NetworkAccessManager, live in the core thread and must not be called directly from the plugin thread.
+
 */
 
 
@@ -59,6 +67,13 @@
     This can only be used for things that have been added using \l{IntegrationPlugin::autoThingsAppeared}.
 */
 
+/*! \fn void IntegrationPlugin::browserItemsChanged(const ThingId &thingId, const QString &itemId)
+    A plugin should emit this signal when the children or the details of the browser item \a itemId of the thing
+    with the given \a thingId changed, for instance after a playlist was edited on the media server. Results cached
+    because of \l{BrowseResult::setCacheTimeout} are dropped for this item. An empty \a itemId drops everything
+    cached for the thing.
+*/
+
 /*! \fn void IntegrationPlugin::emitEvent(const Event &event)
     To produce a new event in the system, a plugin should create a new \l{Event} and emit this signal it with that \a event.
     Usually events are emitted in response to incoming data or other other events happening on the actua device or online service.
@@ -179,6 +194,9 @@ void IntegrationPlugin::startMonitoringAutoThings()
     When the nymea system needs to discover available things, this will be called on the plugin. The plugin implementation
     is set to discover devices or online service endpoints for the \l{ThingClassId} given in the \a info object.
     When things are discovered, they should be added to the info object by calling \l{ThingDiscoveryInfo::addThingDescriptor}.
+    Things added are reported to clients right away, so they should be added as soon as they are found. Things found
+    again, for instance by another discovery mechanism, are dropped by the info object if the thing class declares
+    discoveryKeyParams.
     Once the discovery is complete, a plugin must finish it by calling \l{ThingDiscoveryInfo::finish} using \l{Thing::ThingErrorNoError}
     in case of success, or a matching error code otherwise. An optional display message can be passed which might be shown
     to the user, indicating more details about the error. The displayMessage must be made translatable by wrapping it in a QT_TR_NOOP()
@@ -291,6 +309,19 @@ void IntegrationPlugin::executeAction(ThingActionInfo *info)
     info->finish(Thing::ThingErrorUnsupportedFeature);
 }
 
+/*! This will be called when multiple actions for things of this plugin are executed at the same time, for instance
+    by a rule or scene. Each of the given \a infos must be finished just like in \l{executeAction}.
+
+    The default implementation calls \l{executeAction} for each of the \a infos. A plugin may reimplement this to
+    send all the actions at once if the hardware supports that, e.g. with a group cast or a single request to a bridge.
+*/
+void IntegrationPlugin::executeActions(const QList<ThingActionInfo *> &infos)
+{
+    foreach (ThingActionInfo *info, infos) {
+        executeAction(info);
+    }
+}
+
 /*! A plugin must implement this if its things support browsing ("browsable" being true in the metadata JSON).
     When the system calls this method, the \a result must be filled with entries from the browser using
     \l{BrowseResult::addItems}. The \a info object will contain information about which thing and which item/node
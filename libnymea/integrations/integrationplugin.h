@@ -106,6 +106,7 @@ public:
     virtual void confirmPairing(ThingPairingInfo *info, const QString &username, const QString &secret);
 
     virtual void executeAction(ThingActionInfo *info);
+    virtual void executeActions(const QList<ThingActionInfo *> &infos);
 
     virtual void browseThing(BrowseResult *result);
     virtual void browserItem(BrowserItemResult *result);
@@ -128,6 +129,7 @@ signals:
     void configValueChanged(const ParamTypeId &paramTypeId, const QVariant &value);
     void autoThingsAppeared(const ThingDescriptors &thingDescriptors);
     void autoThingDisappeared(const ThingId &thingId);
+    void browserItemsChanged(const ThingId &thingId, const QString &itemId = QString());
 
 protected:
     Things myThings() const;
@@ -140,6 +142,7 @@ protected:
 private:
     friend class ThingManager;
     friend class ThingManagerImplementation;
+    friend class PluginHostThingManager;
 
     void initPlugin(ThingManager *thingManager, HardwareManager *hardwareManager, ApiKeyStorage *apiKeyStorage);
 
@@ -0,0 +1,229 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef NYMEAASYNC_H
+#define NYMEAASYNC_H
+
+// Awaitable wrappers for the asynchronous objects used in integration plugins. libnymea itself is built as C++11,
+// this header only provides them to plugins built with C++20 coroutine support, e.g. by adding
+// "QMAKE_CXXFLAGS += -std=c++20" after including plugin.pri. Otherwise it is empty.
+//
+// The virtual methods of IntegrationPlugin keep returning void, they hand over to a coroutine instead:
+//
+//     void IntegrationPluginExample::executeAction(ThingActionInfo *info)
+//     {
+//         executeActionAsync(info);
+//     }
+//
+//     NymeaAsync::Task IntegrationPluginExample::executeActionAsync(ThingActionInfo *info)
+//     {
+//         QNetworkReply *reply = co_await NymeaAsync::finished(hardwareManager()->networkManager()->get(request));
+//         if (!reply || reply->error() != QNetworkReply::NoError) {
+//             info->finish(Thing::ThingErrorHardwareNotAvailable);
+//             co_return;
+//         }
+//         co_await NymeaAsync::delay(info, 500);
+//         ...
+//         info->finish(Thing::ThingErrorNoError);
+//     }
+//
+// A suspended coroutine is resumed from the event loop of the thread the awaited object lives in, once it emits
+// the awaited signal. If the object is destroyed without emitting it, the coroutine is resumed right away and the
+// co_await returns nullptr. The thing infos, browser results, QNetworkReply, ModbusRtuReply, CoapReply and
+// PingReply all emit finished() before they are deleted, also when they are aborted or time out.
+// If the context of a delay() or yield() is destroyed, the coroutine is not resumed anymore. Its frame is destroyed
+// instead, which runs the destructors of its local variables.
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <QObject>
+#include <QTimer>
+
+#include <coroutine>
+#include <exception>
+
+namespace NymeaAsync {
+
+// Coroutine type for plugin methods. It runs eagerly until the first suspension and its frame is released when
+// it returns, nobody has to keep a handle to it.
+class Task
+{
+public:
+    class promise_type
+    {
+    public:
+        Task get_return_object() noexcept { return Task(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+// Suspends until object emits signal. Objects that are already finished are not waited for.
+// The awaiter lives in the coroutine frame, so waiting costs two connections and no other allocation.
+template <typename T, typename Signal>
+class SignalAwaiter
+{
+public:
+    SignalAwaiter(T *object, Signal signal, bool ready):
+        m_object(object),
+        m_signal(signal),
+        m_ready(ready)
+    {
+    }
+
+    ~SignalAwaiter()
+    {
+        disconnect();
+    }
+
+    bool await_ready() const noexcept
+    {
+        return m_ready || !m_object;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        m_connection = QObject::connect(m_object, m_signal, m_object, [this, handle](){
+            disconnect();
+            // The awaiter may be gone once the coroutine continues, don't touch it afterwards
+            handle.resume();
+        });
+        // Direct, so the coroutine continues before the object is gone
+        m_destroyedConnection = QObject::connect(m_object, &QObject::destroyed, [this, handle](){
+            disconnect();
+            m_object = nullptr;
+            handle.resume();
+        });
+    }
+
+    T *await_resume() const noexcept
+    {
+        return m_object;
+    }
+
+private:
+    void disconnect()
+    {
+        QObject::disconnect(m_connection);
+        QObject::disconnect(m_destroyedConnection);
+    }
+
+    T *m_object;
+    Signal m_signal;
+    bool m_ready;
+    QMetaObject::Connection m_connection;
+    QMetaObject::Connection m_destroyedConnection;
+};
+
+// Suspends until object emits the given signal, e.g. emitted(reply, &ModbusRtuReply::errorOccurred)
+template <typename T, typename Signal>
+SignalAwaiter<T, Signal> emitted(T *object, Signal signal)
+{
+    return SignalAwaiter<T, Signal>(object, signal, false);
+}
+
+// Suspends until object emits finished(), returns the object
+template <typename T>
+SignalAwaiter<T, void (T::*)()> finished(T *object)
+{
+    bool ready = false;
+    if constexpr (requires { object->isFinished(); }) {
+        ready = object && object->isFinished();
+    }
+    return SignalAwaiter<T, void (T::*)()>(object, &T::finished, ready);
+}
+
+// Suspends until the next timeout of timer, e.g. a PluginTimer
+template <typename T>
+SignalAwaiter<T, void (T::*)()> timeout(T *timer)
+{
+    return SignalAwaiter<T, void (T::*)()>(timer, &T::timeout, false);
+}
+
+// Suspends for msec milliseconds, or until the event loop of the thread of context is back for 0. The coroutine
+// frame is destroyed without resuming it if context is destroyed in the meantime.
+class DelayAwaiter
+{
+public:
+    DelayAwaiter(QObject *context, int msec):
+        m_context(context),
+        m_msec(msec)
+    {
+    }
+
+    ~DelayAwaiter()
+    {
+        QObject::disconnect(m_destroyedConnection);
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        QTimer::singleShot(m_msec, m_context, [this, handle](){
+            QObject::disconnect(m_destroyedConnection);
+            handle.resume();
+        });
+        // The timer is gone with the context, nothing would ever resume the coroutine
+        m_destroyedConnection = QObject::connect(m_context, &QObject::destroyed, [handle](){
+            handle.destroy();
+        });
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+
+private:
+    QObject *m_context;
+    int m_msec;
+    QMetaObject::Connection m_destroyedConnection;
+};
+
+inline DelayAwaiter delay(QObject *context, int msec)
+{
+    return DelayAwaiter(context, msec);
+}
+
+inline DelayAwaiter yield(QObject *context)
+{
+    return DelayAwaiter(context, 0);
+}
+
+}
+
+#endif
+
+#endif // NYMEAASYNC_H
@@ -0,0 +1,113 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef PLUGINACCESSORS_H
+#define PLUGINACCESSORS_H
+
+#include "typeutils.h"
+#include "integrations/thing.h"
+#include "types/param.h"
+#include "types/action.h"
+
+#include <QUuid>
+#include <QVariant>
+
+// Typed accessors generated into plugininfo.h by nymea-plugininfocompiler, one per state, event, action and param of
+// the plugin json file. They carry the id and, for states, the position in the thing class, so setting a state doesn't
+// need to look it up by name or id. Passing a value of any other type than the one in the json file fails to compile.
+//
+//     mockPowerState.set(thing, true);
+//     bool power = mockPowerState.value(thing);
+//     if (mockPercentageAction.matches(info->action())) {
+//         int percentage = mockPercentageActionPercentageParam.value(info->action().params());
+//     }
+//     mockIntEvent.emitEvent(thing, ParamList() << mockIntEventIntParam.param(42));
+
+template <typename T>
+class StateAccessor
+{
+public:
+    constexpr StateAccessor(const QUuid &stateTypeId, int index): m_stateTypeId(stateTypeId), m_index(index) {}
+
+    StateTypeId stateTypeId() const { return m_stateTypeId; }
+    constexpr int index() const { return m_index; }
+
+    T value(const Thing *thing) const { return thing->stateValue(m_index, m_stateTypeId).template value<T>(); }
+    void set(Thing *thing, const T &value) const { thing->setStateValue(m_index, m_stateTypeId, QVariant::fromValue(value)); }
+    template <typename U> void set(Thing *thing, const U &value) const = delete;
+
+private:
+    QUuid m_stateTypeId;
+    int m_index;
+};
+
+template <typename T>
+class ParamAccessor
+{
+public:
+    constexpr ParamAccessor(const QUuid &paramTypeId): m_paramTypeId(paramTypeId) {}
+
+    ParamTypeId paramTypeId() const { return m_paramTypeId; }
+
+    T value(const ParamList &params) const { return params.paramValue(m_paramTypeId).template value<T>(); }
+    Param param(const T &value) const { return Param(m_paramTypeId, QVariant::fromValue(value)); }
+    template <typename U> Param param(const U &value) const = delete;
+
+private:
+    QUuid m_paramTypeId;
+};
+
+class EventAccessor
+{
+public:
+    constexpr EventAccessor(const QUuid &eventTypeId): m_eventTypeId(eventTypeId) {}
+
+    EventTypeId eventTypeId() const { return m_eventTypeId; }
+
+    void emitEvent(Thing *thing, const ParamList &params = ParamList()) const { thing->emitEvent(m_eventTypeId, params); }
+
+private:
+    QUuid m_eventTypeId;
+};
+
+class ActionAccessor
+{
+public:
+    constexpr ActionAccessor(const QUuid &actionTypeId): m_actionTypeId(actionTypeId) {}
+
+    ActionTypeId actionTypeId() const { return m_actionTypeId; }
+
+    bool matches(const Action &action) const { return action.actionTypeId() == m_actionTypeId; }
+
+private:
+    QUuid m_actionTypeId;
+};
+
+#endif // PLUGINACCESSORS_H
@@ -38,6 +38,7 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QJsonDocument>
+#include <QDataStream>
 #include <QMetaObject>
 #include <QMetaEnum>
 
@@ -89,6 +90,12 @@ QStringList PluginMetadata::apiKeys() const
     return m_apiKeys;
 }
 
+/*! Returns true if the plugin asked to run in a worker thread of its own instead of the main thread. */
+bool PluginMetadata::workerThread() const
+{
+    return m_workerThread;
+}
+
 ParamTypes PluginMetadata::pluginSettings() const
 {
     return m_pluginSettings;
@@ -109,13 +116,256 @@ QJsonObject PluginMetadata::jsonObject() const
     return m_jsonObject;
 }
 
+// Bump whenever the layout written by serialize() changes
+static const quint32 serializationVersion = 5;
+
+static void writeParamTypes(QDataStream &stream, const ParamTypes &paramTypes)
+{
+    stream << static_cast<quint32>(paramTypes.count());
+    foreach (const ParamType &paramType, paramTypes) {
+        stream << paramType.id() << paramType.name() << paramType.displayName() << paramType.index()
+               << static_cast<qint32>(paramType.type()) << paramType.defaultValue() << paramType.minValue() << paramType.maxValue()
+               << static_cast<qint32>(paramType.inputType()) << static_cast<qint32>(paramType.unit())
+               << paramType.allowedValues() << paramType.readOnly();
+    }
+}
+
+static ParamTypes readParamTypes(QDataStream &stream)
+{
+    ParamTypes paramTypes;
+    quint32 count;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QUuid id; QString name; QString displayName; int index; qint32 type;
+        QVariant defaultValue; QVariant minValue; QVariant maxValue;
+        qint32 inputType; qint32 unit; QVariantList allowedValues; bool readOnly;
+        stream >> id >> name >> displayName >> index >> type >> defaultValue >> minValue >> maxValue
+               >> inputType >> unit >> allowedValues >> readOnly;
+        ParamType paramType(id, name, static_cast<QVariant::Type>(type), defaultValue);
+        paramType.setDisplayName(displayName);
+        paramType.setIndex(index);
+        paramType.setLimits(minValue, maxValue);
+        paramType.setInputType(static_cast<Types::InputType>(inputType));
+        paramType.setUnit(static_cast<Types::Unit>(unit));
+        paramType.setAllowedValues(allowedValues);
+        paramType.setReadOnly(readOnly);
+        paramTypes.append(paramType);
+    }
+    return paramTypes;
+}
+
+static void writeActionTypes(QDataStream &stream, const ActionTypes &actionTypes)
+{
+    stream << static_cast<quint32>(actionTypes.count());
+    foreach (const ActionType &actionType, actionTypes) {
+        stream << actionType.id() << actionType.name() << actionType.displayName() << actionType.index() << actionType.coalesce();
+        writeParamTypes(stream, actionType.paramTypes());
+    }
+}
+
+static ActionTypes readActionTypes(QDataStream &stream)
+{
+    ActionTypes actionTypes;
+    quint32 count;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QUuid id; QString name; QString displayName; int index; bool coalesce;
+        stream >> id >> name >> displayName >> index >> coalesce;
+        ActionType actionType(id);
+        actionType.setName(name);
+        actionType.setDisplayName(displayName);
+        actionType.setIndex(index);
+        actionType.setCoalesce(coalesce);
+        actionType.setParamTypes(readParamTypes(stream));
+        actionTypes.append(actionType);
+    }
+    return actionTypes;
+}
+
+/*! Returns the validated metadata in a compact binary form, meant to be cached and passed to deserialize()
+    on the next start instead of parsing and validating the JSON again. */
+QByteArray PluginMetadata::serialize() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    stream << serializationVersion;
+    stream << m_pluginId << m_pluginName << m_pluginDisplayName << m_apiKeys << m_workerThread;
+    writeParamTypes(stream, m_pluginSettings);
+
+    stream << static_cast<quint32>(m_vendors.count());
+    foreach (const Vendor &vendor, m_vendors) {
+        stream << vendor.id() << vendor.name() << vendor.displayName();
+    }
+
+    stream << static_cast<quint32>(m_thingClasses.count());
+    foreach (const ThingClass &thingClass, m_thingClasses) {
+        stream << thingClass.id() << thingClass.vendorId() << thingClass.pluginId() << thingClass.name() << thingClass.displayName()
+               << thingClass.browsable() << static_cast<qint32>(thingClass.createMethods()) << static_cast<qint32>(thingClass.setupMethod())
+               << thingClass.interfaces() << thingClass.providedInterfaces();
+        writeParamTypes(stream, thingClass.paramTypes());
+        writeParamTypes(stream, thingClass.settingsTypes());
+        writeParamTypes(stream, thingClass.discoveryParamTypes());
+        stream << static_cast<quint32>(thingClass.discoveryKeyParamTypeIds().count());
+        foreach (const ParamTypeId &paramTypeId, thingClass.discoveryKeyParamTypeIds()) {
+            stream << paramTypeId;
+        }
+
+        stream << static_cast<quint32>(thingClass.stateTypes().count());
+        foreach (const StateType &stateType, thingClass.stateTypes()) {
+            stream << stateType.id() << stateType.name() << stateType.displayName() << stateType.index()
+                   << static_cast<qint32>(stateType.type()) << stateType.defaultValue() << stateType.minValue() << stateType.maxValue()
+                   << stateType.possibleValues() << static_cast<qint32>(stateType.unit()) << static_cast<qint32>(stateType.ioType())
+                   << stateType.writable() << stateType.cached() << stateType.suggestLogging() << static_cast<qint32>(stateType.filter())
+                   << stateType.changePolicy().deadband() << stateType.changePolicy().relativeDeadband()
+                   << stateType.changePolicy().minInterval() << stateType.changePolicy().maxInterval();
+        }
+
+        stream << static_cast<quint32>(thingClass.eventTypes().count());
+        foreach (const EventType &eventType, thingClass.eventTypes()) {
+            stream << eventType.id() << eventType.name() << eventType.displayName() << eventType.index() << eventType.suggestLogging();
+            writeParamTypes(stream, eventType.paramTypes());
+        }
+
+        writeActionTypes(stream, thingClass.actionTypes());
+        writeActionTypes(stream, thingClass.browserItemActionTypes());
+    }
+    return data;
+}
+
+/*! Restores metadata written by serialize(). The result is taken as valid without running the validation again.
+    The \a jsonObject is the plugin's JSON as returned by jsonObject(). If \a data can't be read, an invalid
+    PluginMetadata is returned and the caller should parse the JSON instead. */
+PluginMetadata PluginMetadata::deserialize(const QByteArray &data, const QJsonObject &jsonObject, bool isBuiltIn)
+{
+    PluginMetadata metadata;
+    metadata.m_jsonObject = jsonObject;
+    metadata.m_isBuiltIn = isBuiltIn;
+
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 version;
+    stream >> version;
+    if (version != serializationVersion) {
+        return PluginMetadata();
+    }
+
+    QUuid pluginId;
+    stream >> pluginId >> metadata.m_pluginName >> metadata.m_pluginDisplayName >> metadata.m_apiKeys >> metadata.m_workerThread;
+    metadata.m_pluginId = pluginId;
+    metadata.m_pluginSettings = readParamTypes(stream);
+
+    quint32 vendorCount;
+    stream >> vendorCount;
+    for (quint32 i = 0; i < vendorCount && stream.status() == QDataStream::Ok; i++) {
+        QUuid id; QString name; QString displayName;
+        stream >> id >> name >> displayName;
+        Vendor vendor(id, name);
+        vendor.setDisplayName(displayName);
+        metadata.m_vendors.append(vendor);
+    }
+
+    quint32 thingClassCount;
+    stream >> thingClassCount;
+    for (quint32 i = 0; i < thingClassCount && stream.status() == QDataStream::Ok; i++) {
+        QUuid id; QUuid vendorId; QUuid thingClassPluginId; QString name; QString displayName;
+        bool browsable; qint32 createMethods; qint32 setupMethod; QStringList interfaces; QStringList providedInterfaces;
+        stream >> id >> vendorId >> thingClassPluginId >> name >> displayName >> browsable >> createMethods >> setupMethod
+               >> interfaces >> providedInterfaces;
+        ThingClass thingClass(thingClassPluginId, vendorId, id);
+        thingClass.setName(name);
+        thingClass.setDisplayName(displayName);
+        thingClass.setBrowsable(browsable);
+        thingClass.setCreateMethods(ThingClass::CreateMethods(createMethods));
+        thingClass.setSetupMethod(static_cast<ThingClass::SetupMethod>(setupMethod));
+        thingClass.setInterfaces(interfaces);
+        thingClass.setProvidedInterfaces(providedInterfaces);
+        thingClass.setParamTypes(readParamTypes(stream));
+        thingClass.setSettingsTypes(readParamTypes(stream));
+        thingClass.setDiscoveryParamTypes(readParamTypes(stream));
+        QList<ParamTypeId> discoveryKeyParamTypeIds;
+        quint32 discoveryKeyCount;
+        stream >> discoveryKeyCount;
+        for (quint32 j = 0; j < discoveryKeyCount && stream.status() == QDataStream::Ok; j++) {
+            QUuid paramTypeId;
+            stream >> paramTypeId;
+            discoveryKeyParamTypeIds.append(ParamTypeId(paramTypeId));
+        }
+        thingClass.setDiscoveryKeyParamTypeIds(discoveryKeyParamTypeIds);
+
+        StateTypes stateTypes;
+        quint32 stateTypeCount;
+        stream >> stateTypeCount;
+        for (quint32 j = 0; j < stateTypeCount && stream.status() == QDataStream::Ok; j++) {
+            QUuid stateTypeId; QString stateTypeName; QString stateTypeDisplayName; int index; qint32 type;
+            QVariant defaultValue; QVariant minValue; QVariant maxValue; QVariantList possibleValues;
+            qint32 unit; qint32 ioType; bool writable; bool cached; bool logged; qint32 filter;
+            double deadband; double relativeDeadband; quint32 minInterval; quint32 maxInterval;
+            stream >> stateTypeId >> stateTypeName >> stateTypeDisplayName >> index >> type >> defaultValue >> minValue >> maxValue
+                   >> possibleValues >> unit >> ioType >> writable >> cached >> logged >> filter
+                   >> deadband >> relativeDeadband >> minInterval >> maxInterval;
+            StateType stateType(stateTypeId);
+            stateType.setName(stateTypeName);
+            stateType.setDisplayName(stateTypeDisplayName);
+            stateType.setIndex(index);
+            stateType.setType(static_cast<QVariant::Type>(type));
+            stateType.setDefaultValue(defaultValue);
+            stateType.setMinValue(minValue);
+            stateType.setMaxValue(maxValue);
+            stateType.setPossibleValues(possibleValues);
+            stateType.setUnit(static_cast<Types::Unit>(unit));
+            stateType.setIOType(static_cast<Types::IOType>(ioType));
+            stateType.setWritable(writable);
+            stateType.setCached(cached);
+            stateType.setSuggestLogging(logged);
+            stateType.setFilter(static_cast<Types::StateValueFilter>(filter));
+            StateChangePolicy changePolicy;
+            changePolicy.setDeadband(deadband);
+            changePolicy.setRelativeDeadband(relativeDeadband);
+            changePolicy.setMinInterval(minInterval);
+            changePolicy.setMaxInterval(maxInterval);
+            stateType.setChangePolicy(changePolicy);
+            stateTypes.append(stateType);
+        }
+        thingClass.setStateTypes(stateTypes);
+
+        EventTypes eventTypes;
+        quint32 eventTypeCount;
+        stream >> eventTypeCount;
+        for (quint32 j = 0; j < eventTypeCount && stream.status() == QDataStream::Ok; j++) {
+            QUuid eventTypeId; QString eventTypeName; QString eventTypeDisplayName; int index; bool logged;
+            stream >> eventTypeId >> eventTypeName >> eventTypeDisplayName >> index >> logged;
+            EventType eventType(eventTypeId);
+            eventType.setName(eventTypeName);
+            eventType.setDisplayName(eventTypeDisplayName);
+            eventType.setIndex(index);
+            eventType.setSuggestLogging(logged);
+            eventType.setParamTypes(readParamTypes(stream));
+            eventTypes.append(eventType);
+        }
+        thingClass.setEventTypes(eventTypes);
+
+        thingClass.setActionTypes(readActionTypes(stream));
+        thingClass.setBrowserItemActionTypes(readActionTypes(stream));
+        metadata.m_thingClasses.append(thingClass);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        return PluginMetadata();
+    }
+    metadata.m_isValid = true;
+    return metadata;
+}
+
 void PluginMetadata::parse(const QJsonObject &jsonObject)
 {
     bool hasError = false;
 
     // General plugin info
     QStringList pluginMandatoryJsonProperties = QStringList() << "id" << "name" << "displayName" << "vendors";
-    QStringList pluginJsonProperties = QStringList() << "id" << "name" << "displayName" << "vendors" << "paramTypes" << "builtIn" << "apiKeys";
+    QStringList pluginJsonProperties = QStringList() << "id" << "name" << "displayName" << "vendors" << "paramTypes" << "builtIn" << "apiKeys" << "workerThread";
     QPair<QStringList, QStringList> verificationResult = verifyFields(pluginJsonProperties, pluginMandatoryJsonProperties, jsonObject);
     if (!verificationResult.first.isEmpty()) {
         m_validationErrors.append("Plugin metadata has missing fields: " + verificationResult.first.join(", "));
@@ -130,6 +380,7 @@ void PluginMetadata::parse(const QJsonObject &jsonObject)
     foreach (const QVariant &apiKeyVariant, jsonObject.value("apiKeys").toArray().toVariantList()) {
         m_apiKeys.append(apiKeyVariant.toString());
     }
+    m_workerThread = jsonObject.value("workerThread").toBool();
 
     if (!verificationResult.second.isEmpty()) {
         m_validationErrors.append("Plugin \"" + m_pluginName + "\" has unknown fields: \"" + verificationResult.second.join("\", \"") + "\"");
@@ -202,7 +453,7 @@ void PluginMetadata::parse(const QJsonObject &jsonObject)
             QJsonObject thingClassObject = thingClassJson.toObject();
             /*! Returns a list of all valid JSON properties a ThingClass JSON definition can have. */
             QStringList thingClassProperties = QStringList() << "id" << "name" << "displayName" << "createMethods" << "setupMethod"
-                                     << "interfaces" << "providedInterfaces" << "browsable" << "discoveryParamTypes"
+                                     << "interfaces" << "providedInterfaces" << "browsable" << "discoveryParamTypes" << "discoveryKeyParams"
                                      << "paramTypes" << "settingsTypes" << "stateTypes" << "actionTypes" << "eventTypes" << "browserItemActionTypes";
             QStringList mandatoryThingClassProperties = QStringList() << "id" << "name" << "displayName";
 
@@ -284,6 +535,19 @@ void PluginMetadata::parse(const QJsonObject &jsonObject)
                 thingClass.setDiscoveryParamTypes(discoveryParamVerification.second);
             }
 
+            // Read the params identifying discovered things, given by name
+            QList<ParamTypeId> discoveryKeyParamTypeIds;
+            foreach (const QJsonValue &value, thingClassObject.value("discoveryKeyParams").toArray()) {
+                ParamType paramType = thingClass.paramTypes().findByName(value.toString());
+                if (!paramType.isValid()) {
+                    m_validationErrors.append("Thing class \"" + thingClassName + "\" uses non-existing param type \"" + value.toString() + "\" in discoveryKeyParams.");
+                    hasError = true;
+                    continue;
+                }
+                discoveryKeyParamTypeIds.append(paramType.id());
+            }
+            thingClass.setDiscoveryKeyParamTypeIds(discoveryKeyParamTypeIds);
+
             // Read setup method
             ThingClass::SetupMethod setupMethod = ThingClass::SetupMethodJustAdd;
             if (thingClassObject.contains("setupMethod")) {
@@ -320,7 +584,8 @@ void PluginMetadata::parse(const QJsonObject &jsonObject)
 
                 QStringList stateTypeProperties = {"id", "name", "displayName", "displayNameEvent", "type", "defaultValue", "cached",
                                                    "unit", "minValue", "maxValue", "possibleValues", "writable", "displayNameAction",
-                                                   "ioType", "suggestLogging", "filter"};
+                                                   "ioType", "suggestLogging", "filter", "deadband", "relativeDeadband",
+                                                   "minInterval", "maxInterval", "coalesceActions"};
                 QStringList mandatoryStateTypeProperties = {"id", "name", "displayName", "displayNameEvent", "type", "defaultValue"};
                 QPair<QStringList, QStringList> verificationResult = verifyFields(stateTypeProperties, mandatoryStateTypeProperties, st);
 
@@ -350,6 +615,12 @@ void PluginMetadata::parse(const QJsonObject &jsonObject)
                     }
                 }
 
+                // Coalescing only makes sense for the action setting a writable state
+                if (st.value("coalesceActions").toBool() && !writableState) {
+                    m_validationErrors.append("Thing class \"" + thingClass.name() + "\" state type \"" + stateTypeName + "\" has coalesceActions set but is not writable");
+                    hasError = true;
+                }
+
                 QVariant::Type t = QVariant::nameToType(st.value("type").toString().toLatin1().data());
                 if (t == QVariant::Invalid) {
                     m_validationErrors.append("Thing class \"" + thingClass.name() + "\" state type \"" + stateTypeName + "\" has invalid type: \"" + st.value("type").toString() + "\"");
@@ -482,18 +753,41 @@ void PluginMetadata::parse(const QJsonObject &jsonObject)
                     QString filter = st.value("filter").toString();
                     if (filter == "adaptive") {
                         stateType.setFilter(Types::StateValueFilterAdaptive);
+                    } else if (filter == "ema") {
+                        stateType.setFilter(Types::StateValueFilterEma);
+                    } else if (filter == "median") {
+                        stateType.setFilter(Types::StateValueFilterMedian);
+                    } else if (filter == "kalman") {
+                        stateType.setFilter(Types::StateValueFilterKalman);
                     } else if (!filter.isEmpty()) {
-                        m_validationErrors.append("Thing class \"" + thingClass.name() + "\" state type \"" + stateTypeName + "\" has invalid filter value \"" + filter + "\". Supported filters are: \"adaptive\"");
+                        m_validationErrors.append("Thing class \"" + thingClass.name() + "\" state type \"" + stateTypeName + "\" has invalid filter value \"" + filter + "\". Supported filters are: \"adaptive\", \"ema\", \"median\" and \"kalman\"");
+                        hasError = true;
+                    }
+                }
+
+                StateChangePolicy changePolicy;
+                foreach (const QString &property, QStringList({"deadband", "relativeDeadband", "minInterval", "maxInterval"})) {
+                    if (!st.contains(property)) {
+                        continue;
+                    }
+                    bool ok = st.value(property).isDouble() && st.value(property).toDouble() >= 0;
+                    if (!ok) {
+                        m_validationErrors.append("Thing class \"" + thingClass.name() + "\" state type \"" + stateTypeName + "\" has invalid " + property + " value. Expected a non-negative number.");
                         hasError = true;
                     }
                 }
+                changePolicy.setDeadband(st.value("deadband").toDouble());
+                changePolicy.setRelativeDeadband(st.value("relativeDeadband").toDouble());
+                changePolicy.setMinInterval(static_cast<uint>(st.value("minInterval").toDouble()));
+                changePolicy.setMaxInterval(static_cast<uint>(st.value("maxInterval").toDouble()));
+                stateType.setChangePolicy(changePolicy);
                 stateTypes.append(stateType);
 
                 // Events for state changed (Not checking for duplicate UUID, this is expected to be the same as the state!)
-                EventType eventType(EventTypeId(stateType.id().toString()));
+                EventType eventType(EventTypeId(stateType.id()));
                 eventType.setName(st.value("name").toString());
                 eventType.setDisplayName(st.value("displayNameEvent").toString());
-                ParamType paramType(ParamTypeId(stateType.id().toString()), st.value("name").toString(), stateType.type());
+                ParamType paramType(ParamTypeId(stateType.id()), st.value("name").toString(), stateType.type());
                 paramType.setDisplayName(st.value("displayName").toString());
                 paramType.setAllowedValues(stateType.possibleValues());
                 paramType.setDefaultValue(stateType.defaultValue());
@@ -507,11 +801,12 @@ void PluginMetadata::parse(const QJsonObject &jsonObject)
 
                 // ActionTypes for writeable StateTypes
                 if (writableState) {
-                    ActionType actionType(ActionTypeId(stateType.id().toString()));
+                    ActionType actionType(ActionTypeId(stateType.id()));
                     actionType.setName(stateType.name());
                     actionType.setDisplayName(st.value("displayNameAction").toString());
                     actionType.setIndex(stateType.index());
                     actionType.setParamTypes(QList<ParamType>() << paramType);
+                    actionType.setCoalesce(st.value("coalesceActions").toBool());
                     actionTypes.append(actionType);
                 }
             }
@@ -50,6 +50,7 @@ public:
     QString pluginDisplayName() const;
     bool isBuiltIn() const;
     QStringList apiKeys() const;
+    bool workerThread() const;
 
     ParamTypes pluginSettings() const;
 
@@ -58,6 +59,9 @@ public:
 
     QJsonObject jsonObject() const;
 
+    QByteArray serialize() const;
+    static PluginMetadata deserialize(const QByteArray &data, const QJsonObject &jsonObject, bool isBuiltIn = false);
+
 private:
     void parse(const QJsonObject &jsonObject);
     QPair<bool, ParamTypes> parseParamTypes(const QJsonArray &array);
@@ -78,6 +82,7 @@ private:
     Vendors m_vendors;
     ThingClasses m_thingClasses;
     QStringList m_apiKeys;
+    bool m_workerThread = false;
 
     QList<QUuid> m_allUuids;
 
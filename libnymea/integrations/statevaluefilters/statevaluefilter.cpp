@@ -29,6 +29,10 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "statevaluefilter.h"
+#include "statevaluefilteradaptive.h"
+#include "statevaluefilterema.h"
+#include "statevaluefiltermedian.h"
+#include "statevaluefilterkalman.h"
 
 #include "loggingcategories.h"
 
@@ -43,3 +47,21 @@ StateValueFilter::~StateValueFilter()
 {
 
 }
+
+/*! Returns a new filter of the given \a filter type, or nullptr for Types::StateValueFilterNone. */
+StateValueFilter *StateValueFilter::create(Types::StateValueFilter filter)
+{
+    switch (filter) {
+    case Types::StateValueFilterNone:
+        return nullptr;
+    case Types::StateValueFilterAdaptive:
+        return new StateValueFilterAdaptive();
+    case Types::StateValueFilterEma:
+        return new StateValueFilterEma();
+    case Types::StateValueFilterMedian:
+        return new StateValueFilterMedian();
+    case Types::StateValueFilterKalman:
+        return new StateValueFilterKalman();
+    }
+    return nullptr;
+}
@@ -31,6 +31,8 @@
 #ifndef STATEVALUEFILTER_H
 #define STATEVALUEFILTER_H
 
+#include "typeutils.h"
+
 #include <QVariant>
 #include <QLoggingCategory>
 
@@ -46,6 +48,8 @@ public:
 
     virtual QVariant filteredValue() const = 0;
 
+    static StateValueFilter *create(Types::StateValueFilter filter);
+
 };
 
 #endif // STATEVALUEFILTER_H
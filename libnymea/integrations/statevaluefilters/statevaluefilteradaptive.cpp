@@ -32,14 +32,35 @@
 
 #include <qmath.h>
 
+// The running sum is recomputed from the buffer every now and then, so rounding errors don't add up
+static const int s_resumInterval = 1000;
+
 StateValueFilterAdaptive::StateValueFilterAdaptive()
 {
-
+    m_inputValues.fill(0, m_windowSize);
 }
 
 void StateValueFilterAdaptive::addValue(const QVariant &value)
 {
-    m_inputValues.prepend(value.toDouble());
+    double inputValue = value.toDouble();
+    int next = (m_head + 1) % m_windowSize;
+    if (m_count == m_windowSize) {
+        m_sum -= m_inputValues.at(next);
+    } else {
+        m_count++;
+    }
+    m_inputValues[next] = inputValue;
+    m_sum += inputValue;
+    m_head = next;
+
+    if (++m_samplesSinceResum >= s_resumInterval) {
+        m_samplesSinceResum = 0;
+        m_sum = 0;
+        for (int i = 0; i < m_count; i++) {
+            m_sum += m_inputValues.at((m_head - i + m_windowSize) % m_windowSize);
+        }
+    }
+
     m_inputValueCount++;
     update();
 }
@@ -49,38 +70,37 @@ QVariant StateValueFilterAdaptive::filteredValue() const
     return m_outputValue;
 }
 
-void StateValueFilterAdaptive::update()
+void StateValueFilterAdaptive::resetHistory(double value)
 {
-    while (m_inputValues.count() > m_windowSize) {
-        m_inputValues.removeLast();
-    }
+    m_count = 1;
+    m_inputValues[m_head] = value;
+    m_sum = value;
+}
 
-    if (m_inputValues.isEmpty()) {
+void StateValueFilterAdaptive::update()
+{
+    if (m_count == 0) {
         m_outputValue = 0;
         return;
     }
 
-    if (m_inputValues.count() == 1) {
+    if (m_count == 1) {
         // Not enough data
-        m_outputValue = m_inputValues.first();
+        m_outputValue = m_inputValues.at(m_head);
         m_outputValueCount++;
         return;
     }
 
-    double currentValue = m_inputValues.first();
+    double currentValue = m_inputValues.at(m_head);
     if (qFuzzyCompare(currentValue, 0)) {
         // If we went to 0, follow right away.
         m_outputValue = 0;
         return;
     }
 
-    // Calculate average of history, for all values and for all but the last one
-    double sum = 0;
-    for (int i = 0; i < m_inputValues.count(); i++) {
-        sum += m_inputValues.at(i);
-    }
-    double normalizedValue = sum / m_inputValues.count();
-    double previousNormalizedValue = (sum - m_inputValues.first()) / (m_inputValues.count() - 1);
+    // Average of history, for all values and for all but the last one
+    double normalizedValue = m_sum / m_count;
+    double previousNormalizedValue = (m_sum - currentValue) / (m_count - 1);
 
     if (qFuzzyCompare(previousNormalizedValue, 0)) {
         // We can't calculate anything if the history is at 0. Follow right away to the new value.
@@ -99,8 +119,7 @@ void StateValueFilterAdaptive::update()
     // it's a 99% chance a big change happened that's not jitter (e.g turned on/off)
     // Discard the history and follow the new value right away
     if (qAbs(changeRatioToAverage) > m_standardDeviation * 3) {
-        m_inputValues.clear();
-        m_inputValues.prepend(currentValue);
+        resetHistory(currentValue);
         m_totalDeviation = 0;
         if (!qFuzzyCompare(m_outputValue, normalizedValue)) {
             m_outputValue = currentValue;
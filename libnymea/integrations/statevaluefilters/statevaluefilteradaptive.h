@@ -33,6 +33,8 @@
 
 #include "statevaluefilter.h"
 
+#include <QVector>
+
 class StateValueFilterAdaptive : public StateValueFilter
 {
 public:
@@ -43,9 +45,15 @@ public:
 
 private:
     void update();
+    void resetHistory(double value);
 
 private:
-    QList<double> m_inputValues;
+    // Ring buffer of the last m_windowSize input values, m_head is the newest one
+    QVector<double> m_inputValues;
+    int m_head = 0;
+    int m_count = 0;
+    double m_sum = 0;
+    int m_samplesSinceResum = 0;
 
     int m_windowSize = 20;
     double m_standardDeviation = 0.05;
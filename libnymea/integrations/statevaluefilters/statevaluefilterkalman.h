@@ -0,0 +1,55 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2021, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef STATEVALUEFILTERKALMAN_H
+#define STATEVALUEFILTERKALMAN_H
+
+#include "statevaluefilter.h"
+
+// One dimensional Kalman filter for a value expected to stay constant between samples. The gain only depends on the
+// ratio between process and measurement noise, so the same parameters work regardless of the unit of the value.
+class StateValueFilterKalman : public StateValueFilter
+{
+public:
+    StateValueFilterKalman();
+
+    void addValue(const QVariant &value) override;
+    QVariant filteredValue() const override;
+
+private:
+    double m_processNoise = 0.05;
+    double m_measurementNoise = 1;
+
+    bool m_initialized = false;
+    double m_estimate = 0;
+    double m_errorCovariance = 1;
+};
+
+#endif // STATEVALUEFILTERKALMAN_H
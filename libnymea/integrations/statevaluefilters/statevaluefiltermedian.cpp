@@ -0,0 +1,55 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2021, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "statevaluefiltermedian.h"
+
+#include <algorithm>
+
+StateValueFilterMedian::StateValueFilterMedian()
+{
+    m_inputValues.fill(0);
+}
+
+void StateValueFilterMedian::addValue(const QVariant &value)
+{
+    m_head = (m_head + 1) % s_windowSize;
+    m_inputValues[m_head] = value.toDouble();
+    m_count = qMin(m_count + 1, s_windowSize);
+
+    // The order in the ring buffer matters, select on a copy
+    std::array<double, s_windowSize> values = m_inputValues;
+    std::nth_element(values.begin(), values.begin() + m_count / 2, values.begin() + m_count);
+    m_outputValue = values.at(m_count / 2);
+}
+
+QVariant StateValueFilterMedian::filteredValue() const
+{
+    return m_outputValue;
+}
@@ -0,0 +1,57 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2021, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef STATEVALUEFILTERMEDIAN_H
+#define STATEVALUEFILTERMEDIAN_H
+
+#include "statevaluefilter.h"
+
+#include <array>
+
+// Median of the last s_windowSize values, drops single outliers without lagging behind steps like an average does
+class StateValueFilterMedian : public StateValueFilter
+{
+public:
+    StateValueFilterMedian();
+
+    void addValue(const QVariant &value) override;
+    QVariant filteredValue() const override;
+
+private:
+    static const int s_windowSize = 5;
+
+    std::array<double, s_windowSize> m_inputValues;
+    int m_head = 0;
+    int m_count = 0;
+
+    double m_outputValue = 0;
+};
+
+#endif // STATEVALUEFILTERMEDIAN_H
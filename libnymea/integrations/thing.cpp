@@ -93,6 +93,8 @@
         The thing is in a rule and can not be deleted withou \l{nymeaserver::RuleEngine::RemovePolicy}.
     \value ThingErrorParameterNotWritable
         One of the given thing params is not writable.
+    \value ThingErrorActionSuperseded
+        The action was not executed because a newer action of the same coalesced \l{ActionType} replaced it.
 */
 
 /*! \enum Thing::ThingSetupStatus
@@ -114,6 +116,11 @@
     The \a value parameter describes the new value of the State.
 */
 
+/*! \fn void Thing::stateValuesChanged(const QList<StateTypeId> &stateTypeIds)
+    This signal is emitted by commitStateUpdate() with the \a stateTypeIds of all the \l{State}{States}
+    which changed since beginStateUpdate(). The stateValueChanged() signal is not emitted for those changes.
+*/
+
 /*! \fn void settingChanged(const ParamTypeId &paramTypeId, const QVariant &value)
     This signal is emitted whenever a setting is changed.
 */
@@ -133,18 +140,21 @@
 #include "thing.h"
 #include "types/event.h"
 #include "loggingcategories.h"
-#include "statevaluefilters/statevaluefilteradaptive.h"
+#include "statevaluefilters/statevaluefilter.h"
 
 #include <QDebug>
+#include <QTimer>
+#include <QThread>
+#include <QMutexLocker>
 
 /*! Construct a Thing with the given \a pluginId, \a id, \a thingClassId and \a parent. */
 Thing::Thing(const PluginId &pluginId, const ThingClass &thingClass, const ThingId &id, QObject *parent):
     QObject(parent),
     m_thingClass(thingClass),
     m_pluginId(pluginId),
-    m_id(id)
+    m_id(id),
+    m_stateTypes(thingClass.stateTypes())
 {
-
 }
 
 /*! Construct a Thing with the given \a pluginId, \a thingClassId and \a parent. A new ThingId will be created for this Thing. */
@@ -152,15 +162,16 @@ Thing::Thing(const PluginId &pluginId, const ThingClass &thingClass, QObject *pa
     QObject(parent),
     m_thingClass(thingClass),
     m_pluginId(pluginId),
-    m_id(ThingId::createThingId())
+    m_id(ThingId::createThingId()),
+    m_stateTypes(thingClass.stateTypes())
 {
-
 }
 
 Thing::~Thing()
 {
     qDeleteAll(m_stateValueFilters);
     m_stateValueFilters.clear();
+    delete m_workerThreadAccess;
 }
 
 /*! Returns the id of this thing. */
@@ -190,33 +201,45 @@ ThingClass Thing::thingClass() const
 /*! Returns the name of this Thing. This is visible to the user. */
 QString Thing::name() const
 {
+    QMutexLocker locker(dataMutex());
     return m_name;
 }
 
 /*! Set the \a name for this thing. This is visible to the user.*/
 void Thing::setName(const QString &name)
 {
-    if (m_name != name) {
+    {
+        QMutexLocker locker(dataMutex());
+        if (m_name == name) {
+            return;
+        }
         m_name = name;
-        emit nameChanged();
     }
+    if (isWorkerThread()) {
+        postUpdate([this](){ emit nameChanged(); });
+        return;
+    }
+    emit nameChanged();
 }
 
 /*! Returns the parameter of this thing. It must match the parameter description in the associated \l{ThingClass}. */
 ParamList Thing::params() const
 {
+    QMutexLocker locker(dataMutex());
     return m_params;
 }
 
 /*! Sets the \a params of this thing. It must match the parameter description in the associated \l{ThingClass}. */
 void Thing::setParams(const ParamList &params)
 {
+    QMutexLocker locker(dataMutex());
     m_params = params;
 }
 
 /*! Returns the value of the \l{Param} of this thing with the given \a paramTypeId. */
 QVariant Thing::paramValue(const ParamTypeId &paramTypeId) const
 {
+    QMutexLocker locker(dataMutex());
     foreach (const Param &param, m_params) {
         if (param.paramTypeId() == paramTypeId) {
             return param.value();
@@ -234,6 +257,7 @@ QVariant Thing::paramValue(const QString &paramName) const
 /*! Sets the \a value of the \l{Param} with the given \a paramTypeId. */
 void Thing::setParamValue(const ParamTypeId &paramTypeId, const QVariant &value)
 {
+    QMutexLocker locker(dataMutex());
     ParamList params;
     foreach (Param param, m_params) {
         if (param.paramTypeId() == paramTypeId) {
@@ -252,17 +276,22 @@ void Thing::setParamValue(const QString &paramName, const QVariant &value)
 
 ParamList Thing::settings() const
 {
+    QMutexLocker locker(dataMutex());
     return m_settings;
 }
 
 bool Thing::hasSetting(const ParamTypeId &paramTypeId) const
 {
+    QMutexLocker locker(dataMutex());
     return m_settings.hasParam(paramTypeId);
 }
 
 void Thing::setSettings(const ParamList &settings)
 {
-    m_settings = settings;
+    {
+        QMutexLocker locker(dataMutex());
+        m_settings = settings;
+    }
     foreach (const Param &param, m_settings) {
         emit settingChanged(param.paramTypeId(), param.value());
     }
@@ -270,6 +299,7 @@ void Thing::setSettings(const ParamList &settings)
 
 QVariant Thing::setting(const ParamTypeId &paramTypeId) const
 {
+    QMutexLocker locker(dataMutex());
     foreach (Param setting, m_settings) {
         if (setting.paramTypeId() == paramTypeId) {
             return setting.value();
@@ -286,6 +316,7 @@ QVariant Thing::setting(const QString &paramName) const
 
 void Thing::setSettingValue(const ParamTypeId &paramTypeId, const QVariant &value)
 {
+    QMutexLocker locker(dataMutex());
     ParamList settings;
     bool found = false;
     bool changed = false;
@@ -303,10 +334,17 @@ void Thing::setSettingValue(const ParamTypeId &paramTypeId, const QVariant &valu
         qCWarning(dcThingManager()) << "Thing" << m_name << "(" << m_id.toString() << ") does not have a setting with id" << paramTypeId;
         return;
     }
-    if (changed) {
-        m_settings = settings;
-        emit settingChanged(paramTypeId, value);
+    if (!changed) {
+        return;
+    }
+    m_settings = settings;
+    locker.unlock();
+
+    if (isWorkerThread()) {
+        postUpdate([=](){ emit settingChanged(paramTypeId, value); });
+        return;
     }
+    emit settingChanged(paramTypeId, value);
 }
 
 void Thing::setSettingValue(const QString &paramName, const QVariant &value)
@@ -318,30 +356,40 @@ void Thing::setSettingValue(const QString &paramName, const QVariant &value)
 /*! Returns the states of this thing. It must match the \l{StateType} description in the associated \l{ThingClass}. */
 States Thing::states() const
 {
+    QMutexLocker locker(dataMutex());
     return m_states;
 }
 
 /*! Returns true, a \l{Param} with the given \a paramTypeId exists for this thing. */
 bool Thing::hasParam(const ParamTypeId &paramTypeId) const
 {
+    QMutexLocker locker(dataMutex());
     return m_params.hasParam(paramTypeId);
 }
 
 /*! Set the \l{State}{States} of this \l{Thing} to the given \a states.*/
 void Thing::setStates(const States &states)
 {
+    QMutexLocker locker(dataMutex());
     m_states = states;
+    m_stateIndexes.clear();
+    m_statesInClassOrder = m_states.count() == m_stateTypes.count();
+    for (int i = 0; m_statesInClassOrder && i < m_states.count(); i++) {
+        m_statesInClassOrder = m_states.at(i).stateTypeId() == m_stateTypes.at(i).id();
+    }
+    if (m_statesInClassOrder) {
+        return;
+    }
+    m_stateIndexes.reserve(m_states.count());
+    for (int i = 0; i < m_states.count(); i++) {
+        m_stateIndexes.insert(m_states.at(i).stateTypeId(), i);
+    }
 }
 
 /*! Returns true, a \l{State} with the state given by \a stateTypeId exists for this thing. */
 bool Thing::hasState(const StateTypeId &stateTypeId) const
 {
-    foreach (const State &state, m_states) {
-        if (state.stateTypeId() == stateTypeId) {
-            return true;
-        }
-    }
-    return false;
+    return stateIndex(stateTypeId) >= 0;
 }
 
 /*! Finds the \l{State} matching the given \a stateTypeId in this thing and returns the current value. */
@@ -354,10 +402,10 @@ bool Thing::hasState(const QString &stateName) const
 /*! Finds the \l{State} matching the given \a stateTypeId in this thing and returns the current value. */
 QVariant Thing::stateValue(const StateTypeId &stateTypeId) const
 {
-    foreach (const State &state, m_states) {
-        if (state.stateTypeId() == stateTypeId) {
-            return state.value();
-        }
+    QMutexLocker locker(dataMutex());
+    int i = stateIndex(stateTypeId);
+    if (i >= 0) {
+        return m_states.at(i).value();
     }
     return QVariant();
 }
@@ -371,52 +419,85 @@ QVariant Thing::stateValue(const QString &stateName) const
 /*! Sets the value for the \l{State} matching the given \a stateTypeId in this thing to value. */
 void Thing::setStateValue(const StateTypeId &stateTypeId, const QVariant &value)
 {
-    StateType stateType = m_thingClass.stateTypes().findById(stateTypeId);
-    if (!stateType.isValid()) {
+    const StateType *stateType = findStateType(stateTypeId);
+    if (!stateType) {
         qCWarning(dcThing()) << "No such state type" << stateTypeId.toString() << "in" << m_name << "(" + thingClass().name() + ")";
         return;
     }
-    for (int i = 0; i < m_states.count(); ++i) {
-        if (m_states.at(i).stateTypeId() == stateTypeId) {
-            QVariant newValue = value;
-            if (!newValue.convert(stateType.type())) {
-                qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Type mismatch. Expected type: " << QVariant::typeToName(stateType.type()) << " (Discarding change)";
-                return;
-            }
-            State state = m_states.at(i);
-            if (state.minValue().isValid() && value < state.minValue()) {
-                qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Out of range: " << state.minValue() << " - " << state.maxValue() << " (Correcting to closest value within range)";
-                newValue = state.minValue();
-            }
-            if (state.maxValue().isValid() && value > state.maxValue()) {
-                qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Out of range: " << state.minValue() << " - " << state.maxValue() << " (Correcting to closest value within range)";
-                newValue = state.maxValue();
-            }
-            if (!stateType.possibleValues().isEmpty() && !stateType.possibleValues().contains(value)) {
-                qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Not an accepted value. Possible values: " << stateType.possibleValues() << " (Discarding change)";
-                return;
-            }
+    int i = stateIndex(stateTypeId);
+    if (i >= 0) {
+        updateStateValue(i, stateType, value);
+        return;
+    }
+    Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting state %1 to %2").arg(stateType->name()).arg(value.toString()).toUtf8());
+    qCWarning(dcThing).nospace() << m_name << ": Failed setting state " << stateType->name() << "to" << value;
+}
 
-            StateValueFilter *filter = m_stateValueFilters.value(stateTypeId);
-            if (filter) {
-                filter->addValue(newValue);
-                newValue = filter->filteredValue();
-            }
+/*! Sets the value for the \l{State} at position \a stateIndex in the state types of the thing class, which must have
+    the given \a stateTypeId. The generated state accessors in plugininfo.h use this to skip looking the state up. If
+    the position doesn't match, the state is looked up by \a stateTypeId. */
+void Thing::setStateValue(int stateIndex, const StateTypeId &stateTypeId, const QVariant &value)
+{
+    if (!isStateIndex(stateIndex, stateTypeId)) {
+        setStateValue(stateTypeId, value);
+        return;
+    }
+    updateStateValue(stateIndex, &m_stateTypes.at(stateIndex), value);
+}
 
-            QVariant oldValue = m_states.at(i).value();
-            if (oldValue == newValue) {
-                qCDebug(dcThing()).nospace() << m_name << ": Discarding state change for " << stateType.name() << " as the value did not actually change. Old value:" << oldValue << "New value:" << newValue;
-                return;
-            }
+/*! Returns the value of the \l{State} at position \a stateIndex in the state types of the thing class, which must
+    have the given \a stateTypeId. If the position doesn't match, the state is looked up by \a stateTypeId. */
+QVariant Thing::stateValue(int stateIndex, const StateTypeId &stateTypeId) const
+{
+    if (!isStateIndex(stateIndex, stateTypeId)) {
+        return stateValue(stateTypeId);
+    }
+    QMutexLocker locker(dataMutex());
+    return m_states.at(stateIndex).value();
+}
 
-            qCDebug(dcThing()).nospace() << m_name << ": State " << stateType.name() << " changed from " << oldValue << " to " << newValue;
-            m_states[i].setValue(newValue);
-            emit stateValueChanged(stateTypeId, newValue, m_states.at(i).minValue(), m_states.at(i).maxValue());
-            return;
-        }
+// States are created in the order of the thing class, a single id compare confirms the position
+bool Thing::isStateIndex(int index, const StateTypeId &stateTypeId) const
+{
+    return index >= 0 && index < m_states.count() && index < m_stateTypes.count()
+            && m_states.at(index).stateTypeId() == stateTypeId && m_stateTypes.at(index).id() == stateTypeId;
+}
+
+void Thing::updateStateValue(int i, const StateType *stateType, const QVariant &value)
+{
+    QVariant newValue = value;
+    if (!newValue.convert(stateType->type())) {
+        qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType->name() << ". Type mismatch. Expected type: " << QVariant::typeToName(stateType->type()) << " (Discarding change)";
+        return;
     }
-    Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting state %1 to %2").arg(stateType.name()).arg(value.toString()).toUtf8());
-    qCWarning(dcThing).nospace() << m_name << ": Failed setting state " << stateType.name() << "to" << value;
+
+    QMutexLocker locker(dataMutex());
+    const State &state = m_states.at(i);
+    if (state.minValue().isValid() && value < state.minValue()) {
+        qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType->name() << ". Out of range: " << state.minValue() << " - " << state.maxValue() << " (Correcting to closest value within range)";
+        newValue = state.minValue();
+    }
+    if (state.maxValue().isValid() && value > state.maxValue()) {
+        qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType->name() << ". Out of range: " << state.minValue() << " - " << state.maxValue() << " (Correcting to closest value within range)";
+        newValue = state.maxValue();
+    }
+    if (!stateType->possibleValues().isEmpty() && !stateType->possibleValues().contains(value)) {
+        qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType->name() << ". Not an accepted value. Possible values: " << stateType->possibleValues() << " (Discarding change)";
+        return;
+    }
+
+    StateValueFilter *filter = m_stateValueFilters.isEmpty() ? nullptr : m_stateValueFilters.value(stateType->id());
+    if (filter) {
+        filter->addValue(newValue);
+        newValue = filter->filteredValue();
+    }
+
+    if (!passesChangePolicy(i, stateType, newValue)) {
+        return;
+    }
+    locker.unlock();
+
+    applyStateValue(i, stateType, newValue);
 }
 
 /*! Sets the value for the \l{State} matching the given \a stateName in this thing to value. */
@@ -429,37 +510,38 @@ void Thing::setStateValue(const QString &stateName, const QVariant &value)
 /*! Sets the minimum value for the \l{State} matching the given \a stateTypeId in this thing to value. */
 void Thing::setStateMinValue(const StateTypeId &stateTypeId, const QVariant &minValue)
 {
-    StateType stateType = m_thingClass.stateTypes().findById(stateTypeId);
-    if (!stateType.isValid()) {
+    const StateType *stateType = findStateType(stateTypeId);
+    if (!stateType) {
         qCWarning(dcThing()) << "No such state type" << stateTypeId.toString() << "in" << m_name << "(" + thingClass().name() + ")";
         return;
     }
-    for (int i = 0; i < m_states.count(); ++i) {
-        if (m_states.at(i).stateTypeId() == stateTypeId) {
-            QVariant newMin = minValue.isValid() ? minValue : stateType.minValue();
-
-            if (newMin == m_states.at(i).minValue()) {
-                return;
-            }
-
-            m_states[i].setMinValue(newMin);
-
-            // Sanity check for max >= min
-            if (m_states.at(i).maxValue() < newMin) {
-                qCWarning(dcThing()) << "Adjusting state maximum value for" << stateType.name() << "from" << m_states.at(i).maxValue() << "to new minimum value of" << newMin;
-                m_states[i].setMaxValue(newMin);
-            }
-            if (m_states.at(i).value() < newMin) {
-                qCInfo(dcThing()) << "Adjusting state value for" << stateType.name() << "from" << m_states.at(i).value() << "to new minimum value of" << newMin;
-                m_states[i].setValue(newMin);
-            }
+    int i = stateIndex(stateTypeId);
+    if (i >= 0) {
+        QVariant newMin = minValue.isValid() ? minValue : stateType->minValue();
 
-            emit stateValueChanged(stateTypeId, m_states.at(i).value(), m_states.at(i).minValue(), m_states.at(i).maxValue());
+        QMutexLocker locker(dataMutex());
+        if (newMin == m_states.at(i).minValue()) {
             return;
         }
+        m_states[i].setMinValue(newMin);
+
+        // Sanity check for max >= min
+        if (m_states.at(i).maxValue() < newMin) {
+            qCWarning(dcThing()) << "Adjusting state maximum value for" << stateType->name() << "from" << m_states.at(i).maxValue() << "to new minimum value of" << newMin;
+            m_states[i].setMaxValue(newMin);
+        }
+        if (m_states.at(i).value() < newMin) {
+            qCInfo(dcThing()) << "Adjusting state value for" << stateType->name() << "from" << m_states.at(i).value() << "to new minimum value of" << newMin;
+            m_states[i].setValue(newMin);
+        }
+        State state = m_states.at(i);
+        locker.unlock();
+
+        notifyStateChanged(state);
+        return;
     }
-    Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting minimum state value %1 to %2").arg(stateType.name()).arg(minValue.toString()).toUtf8());
-    qCWarning(dcThing).nospace() << m_name << ": Failed setting minimum state value " << stateType.name() << " to " << minValue;
+    Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting minimum state value %1 to %2").arg(stateType->name()).arg(minValue.toString()).toUtf8());
+    qCWarning(dcThing).nospace() << m_name << ": Failed setting minimum state value " << stateType->name() << " to " << minValue;
 }
 
 /*! Sets the minimum value for the \l{State} matching the given \a stateName in this thing to value. */
@@ -472,40 +554,41 @@ void Thing::setStateMinValue(const QString &stateName, const QVariant &minValue)
 /*! Sets the maximum value for the \l{State} matching the given \a stateTypeId in this thing to value. */
 void Thing::setStateMaxValue(const StateTypeId &stateTypeId, const QVariant &maxValue)
 {
-    StateType stateType = m_thingClass.stateTypes().findById(stateTypeId);
-    if (!stateType.isValid()) {
+    const StateType *stateType = findStateType(stateTypeId);
+    if (!stateType) {
         qCWarning(dcThing()) << "No such state type" << stateTypeId.toString() << "in" << m_name << "(" + thingClass().name() + ")";
         return;
     }
-    for (int i = 0; i < m_states.count(); ++i) {
-        if (m_states.at(i).stateTypeId() == stateTypeId) {
-            QVariant newMax = maxValue.isValid() ? maxValue : stateType.maxValue();
+    int i = stateIndex(stateTypeId);
+    if (i >= 0) {
+        QVariant newMax = maxValue.isValid() ? maxValue : stateType->maxValue();
 
-            if (newMax == m_states.at(i).maxValue()) {
-                return;
-            }
-
-            m_states[i].setMaxValue(newMax);
-
-            if (newMax.isValid()) {
-                // Sanity check for min <= max
-                if (m_states.at(i).minValue() > newMax) {
-                    qCWarning(dcThing()) << "Adjusting minimum state value for" << stateType.name() << "from" << m_states.at(i).minValue() << "to new maximum value of" << newMax;
-                    m_states[i].setMinValue(newMax);
-                }
+        QMutexLocker locker(dataMutex());
+        if (newMax == m_states.at(i).maxValue()) {
+            return;
+        }
+        m_states[i].setMaxValue(newMax);
 
-                if (m_states.at(i).value() > newMax) {
-                    qCInfo(dcThing()) << "Adjusting state value for" << stateType.name() << "from" << m_states.at(i).value() << "to new maximum value of" << newMax;
-                    m_states[i].setValue(maxValue);
-                }
+        if (newMax.isValid()) {
+            // Sanity check for min <= max
+            if (m_states.at(i).minValue() > newMax) {
+                qCWarning(dcThing()) << "Adjusting minimum state value for" << stateType->name() << "from" << m_states.at(i).minValue() << "to new maximum value of" << newMax;
+                m_states[i].setMinValue(newMax);
             }
 
-            emit stateValueChanged(stateTypeId, m_states.at(i).value(), m_states.at(i).minValue(), m_states.at(i).maxValue());
-            return;
+            if (m_states.at(i).value() > newMax) {
+                qCInfo(dcThing()) << "Adjusting state value for" << stateType->name() << "from" << m_states.at(i).value() << "to new maximum value of" << newMax;
+                m_states[i].setValue(maxValue);
+            }
         }
+        State state = m_states.at(i);
+        locker.unlock();
+
+        notifyStateChanged(state);
+        return;
     }
-    Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting maximum state value %1 to %2").arg(stateType.name()).arg(maxValue.toString()).toUtf8());
-    qCWarning(dcThing).nospace() << m_name << ": Failed setting maximum state value " << stateType.name() << " t o" << maxValue;
+    Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting maximum state value %1 to %2").arg(stateType->name()).arg(maxValue.toString()).toUtf8());
+    qCWarning(dcThing).nospace() << m_name << ": Failed setting maximum state value " << stateType->name() << " t o" << maxValue;
 }
 
 /*! Sets the maximum value for the \l{State} matching the given \a stateName in this thing to value. */
@@ -517,46 +600,47 @@ void Thing::setStateMaxValue(const QString &stateName, const QVariant &maxValue)
 
 void Thing::setStateMinMaxValues(const StateTypeId &stateTypeId, const QVariant &minValue, const QVariant &maxValue)
 {
-    StateType stateType = m_thingClass.stateTypes().findById(stateTypeId);
-    if (!stateType.isValid()) {
+    const StateType *stateType = findStateType(stateTypeId);
+    if (!stateType) {
         qCWarning(dcThing()) << "No such state type" << stateTypeId.toString() << "in" << m_name << "(" + thingClass().name() + ")";
         return;
     }
-    for (int i = 0; i < m_states.count(); ++i) {
-        if (m_states.at(i).stateTypeId() == stateTypeId) {
-            QVariant newMin = minValue.isValid() ? minValue : stateType.minValue();
-            QVariant newMax = maxValue.isValid() ? maxValue : stateType.maxValue();
+    int i = stateIndex(stateTypeId);
+    if (i >= 0) {
+        QVariant newMin = minValue.isValid() ? minValue : stateType->minValue();
+        QVariant newMax = maxValue.isValid() ? maxValue : stateType->maxValue();
 
-            if (newMin == m_states.at(i).minValue() && newMax == m_states.at(i).maxValue()) {
-                return;
-            }
+        QMutexLocker locker(dataMutex());
+        if (newMin == m_states.at(i).minValue() && newMax == m_states.at(i).maxValue()) {
+            return;
+        }
+        m_states[i].setMinValue(newMin);
+        m_states[i].setMaxValue(newMax);
 
-            m_states[i].setMinValue(newMin);
-            m_states[i].setMaxValue(newMax);
-
-            if (newMax.isValid() || newMax.isValid()) {
-                // Sanity check for min <= max
-                if (newMin > newMax) {
-                    qCWarning(dcThing()) << "Adjusting maximum state value for" << stateType.name() << "from" << m_states.at(i).maxValue() << "to new minimum value of" << newMax;
-                    m_states[i].setMaxValue(newMin);
-                }
-
-                if (m_states.at(i).value() < m_states.at(i).minValue()) {
-                    qCInfo(dcThing()) << "Adjusting state value for" << stateType.name() << "from" << m_states.at(i).value() << "to new minimum value of" << m_states.at(i).minValue();
-                    m_states[i].setValue(m_states.at(i).minValue());
-                }
-                if (m_states.at(i).value() > m_states.at(i).maxValue()) {
-                    qCInfo(dcThing()) << "Adjusting state value for" << stateType.name() << "from" << m_states.at(i).value() << "to new maximum value of" << m_states.at(i).maxValue();
-                    m_states[i].setValue(m_states.at(i).maxValue());
-                }
+        if (newMax.isValid() || newMax.isValid()) {
+            // Sanity check for min <= max
+            if (newMin > newMax) {
+                qCWarning(dcThing()) << "Adjusting maximum state value for" << stateType->name() << "from" << m_states.at(i).maxValue() << "to new minimum value of" << newMax;
+                m_states[i].setMaxValue(newMin);
             }
 
-            emit stateValueChanged(stateTypeId, m_states.at(i).value(), m_states.at(i).minValue(), m_states.at(i).maxValue());
-            return;
+            if (m_states.at(i).value() < m_states.at(i).minValue()) {
+                qCInfo(dcThing()) << "Adjusting state value for" << stateType->name() << "from" << m_states.at(i).value() << "to new minimum value of" << m_states.at(i).minValue();
+                m_states[i].setValue(m_states.at(i).minValue());
+            }
+            if (m_states.at(i).value() > m_states.at(i).maxValue()) {
+                qCInfo(dcThing()) << "Adjusting state value for" << stateType->name() << "from" << m_states.at(i).value() << "to new maximum value of" << m_states.at(i).maxValue();
+                m_states[i].setValue(m_states.at(i).maxValue());
+            }
         }
+        State state = m_states.at(i);
+        locker.unlock();
+
+        notifyStateChanged(state);
+        return;
     }
-    Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting maximum state value %1 to %2").arg(stateType.name()).arg(maxValue.toString()).toUtf8());
-    qCWarning(dcThing).nospace() << m_name << ": Failed setting maximum state value " << stateType.name() << " t o" << maxValue;
+    Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting maximum state value %1 to %2").arg(stateType->name()).arg(maxValue.toString()).toUtf8());
+    qCWarning(dcThing).nospace() << m_name << ": Failed setting maximum state value " << stateType->name() << " t o" << maxValue;
 
 }
 
@@ -566,13 +650,75 @@ void Thing::setStateMinMaxValues(const QString &stateName, const QVariant &minVa
     setStateMinMaxValues(stateTypeId, minValue, maxValue);
 }
 
+/*! Sets the values of all the states in \a values at once. Each value is checked the same way setStateValue() does,
+    invalid values are discarded. The changes are announced with a single stateValuesChanged() signal.
+    Plugins updating many states at once, for instance after polling a device, should prefer this over
+    calling setStateValue() for each of them. */
+void Thing::setStateValues(const QHash<StateTypeId, QVariant> &values)
+{
+    beginStateUpdate();
+    for (QHash<StateTypeId, QVariant>::const_iterator it = values.constBegin(); it != values.constEnd(); ++it) {
+        setStateValue(it.key(), it.value());
+    }
+    commitStateUpdate();
+}
+
+/*! Starts collecting state changes. The states are still changed right away, but instead of emitting
+    stateValueChanged() for each of them, one stateValuesChanged() is emitted by the matching commitStateUpdate().
+    Calls may be nested, only the outermost commitStateUpdate() emits the signal. */
+void Thing::beginStateUpdate()
+{
+    if (isWorkerThread()) {
+        postUpdate([=](){ beginStateUpdate(); });
+        return;
+    }
+    m_stateUpdateDepth++;
+}
+
+/*! Ends a state update started with beginStateUpdate() and emits stateValuesChanged() if any state changed. */
+void Thing::commitStateUpdate()
+{
+    if (isWorkerThread()) {
+        postUpdate([=](){ commitStateUpdate(); });
+        return;
+    }
+    if (m_stateUpdateDepth == 0) {
+        qCWarning(dcThing()) << m_name << ": commitStateUpdate() called without beginStateUpdate()";
+        return;
+    }
+    if (--m_stateUpdateDepth > 0 || m_pendingStateChanges.isEmpty()) {
+        return;
+    }
+    QList<StateTypeId> stateTypeIds = m_pendingStateChanges;
+    m_pendingStateChanges.clear();
+    emit stateValuesChanged(stateTypeIds);
+}
+
+// Emits the change of the given copy of the state. Coming from a worker thread, only the signal is handed
+// to the core thread, the value has been written already. Signals keep the value the state had when it was
+// changed, so none of them gets lost even if the plugin changes the state again before they are emitted.
+void Thing::notifyStateChanged(const State &state)
+{
+    if (isWorkerThread()) {
+        postUpdate([=](){ notifyStateChanged(state); });
+        return;
+    }
+    if (m_stateUpdateDepth > 0) {
+        if (!m_pendingStateChanges.contains(state.stateTypeId())) {
+            m_pendingStateChanges.append(state.stateTypeId());
+        }
+        return;
+    }
+    emit stateValueChanged(state.stateTypeId(), state.value(), state.minValue(), state.maxValue());
+}
+
 /*! Returns the \l{State} with the given \a stateTypeId of this thing. */
 State Thing::state(const StateTypeId &stateTypeId) const
 {
-    for (int i = 0; i < m_states.count(); ++i) {
-        if (m_states.at(i).stateTypeId() == stateTypeId) {
-            return m_states.at(i);
-        }
+    QMutexLocker locker(dataMutex());
+    int i = stateIndex(stateTypeId);
+    if (i >= 0) {
+        return m_states.at(i);
     }
     return State(StateTypeId(), ThingId());
 }
@@ -620,6 +766,10 @@ QString Thing::setupDisplayMessage() const
 /*! Emits an event from this thing to the system. */
 void Thing::emitEvent(const EventTypeId &eventTypeId, const ParamList &params)
 {
+    if (isWorkerThread()) {
+        postUpdate([=](){ emitEvent(eventTypeId, params); });
+        return;
+    }
     emit eventTriggered(Event(eventTypeId, m_id, params));
 }
 
@@ -627,7 +777,7 @@ void Thing::emitEvent(const EventTypeId &eventTypeId, const ParamList &params)
 void Thing::emitEvent(const QString &eventName, const ParamList &params)
 {
     EventTypeId eventTypeId = m_thingClass.eventTypes().findByName(eventName).id();
-    emit eventTriggered(Event(eventTypeId, m_id, params));
+    emitEvent(eventTypeId, params);
 }
 
 /*! Returns true if this thing has been auto-created (not created by the user) */
@@ -662,17 +812,184 @@ void Thing::setLoggedEventTypeIds(const QList<EventTypeId> loggedEventTypeIds)
 
 void Thing::setStateValueFilter(const StateTypeId &stateTypeId, Types::StateValueFilter filter)
 {
-    for (int i = 0; i < m_states.count(); i++) {
-        if (m_states.at(i).stateTypeId() == stateTypeId) {
-            m_states[i].setFilter(filter);
-            StateValueFilter *stateValueFilter = m_stateValueFilters.take(stateTypeId);
-            if (stateValueFilter) {
-                delete stateValueFilter;
-            }
-            if (filter == Types::StateValueFilterAdaptive) {
-                m_stateValueFilters.insert(stateTypeId, new StateValueFilterAdaptive());
-            }
+    int i = stateIndex(stateTypeId);
+    if (i >= 0) {
+        QMutexLocker locker(dataMutex());
+        m_states[i].setFilter(filter);
+        StateValueFilter *stateValueFilter = m_stateValueFilters.take(stateTypeId);
+        if (stateValueFilter) {
+            delete stateValueFilter;
+        }
+        stateValueFilter = StateValueFilter::create(filter);
+        if (stateValueFilter) {
+            m_stateValueFilters.insert(stateTypeId, stateValueFilter);
+        }
+    }
+}
+
+/*! Returns the \l{StateChangePolicy} currently applied to the state with the given \a stateTypeId. */
+StateChangePolicy Thing::stateChangePolicy(const StateTypeId &stateTypeId) const
+{
+    QMutexLocker locker(dataMutex());
+    return m_stateChangeLimiters.value(stateTypeId).policy;
+}
+
+void Thing::setStateChangePolicy(const StateTypeId &stateTypeId, const StateChangePolicy &policy)
+{
+    if (stateIndex(stateTypeId) < 0) {
+        return;
+    }
+    QMutexLocker locker(dataMutex());
+    if (policy.isNull()) {
+        m_stateChangeLimiters.remove(stateTypeId);
+        return;
+    }
+    m_stateChangeLimiters[stateTypeId].policy = policy;
+}
+
+void Thing::applyStateValue(int index, const StateType *stateType, const QVariant &newValue)
+{
+    QMutexLocker locker(dataMutex());
+    QVariant oldValue = m_states.at(index).value();
+    if (oldValue == newValue) {
+        qCDebug(dcThing()).nospace() << m_name << ": Discarding state change for " << stateType->name() << " as the value did not actually change. Old value:" << oldValue << "New value:" << newValue;
+        return;
+    }
+
+    qCDebug(dcThing()).nospace() << m_name << ": State " << stateType->name() << " changed from " << oldValue << " to " << newValue;
+    m_states[index].setValue(newValue);
+    State state = m_states.at(index);
+    locker.unlock();
+
+    notifyStateChanged(state);
+}
+
+bool Thing::passesChangePolicy(int index, const StateType *stateType, const QVariant &newValue)
+{
+    auto it = m_stateChangeLimiters.find(stateType->id());
+    if (it == m_stateChangeLimiters.end()) {
+        return true;
+    }
+    StateChangeLimiter &limiter = it.value();
+    const QVariant currentValue = m_states.at(index).value();
+
+    // Settling back on the current value drops anything still held back by the rate limit
+    if (currentValue == newValue) {
+        limiter.pendingValue.clear();
+        return true;
+    }
+
+    qint64 elapsed = limiter.sinceLastChange.isValid() ? limiter.sinceLastChange.elapsed() : -1;
+    bool heartbeatDue = limiter.policy.maxInterval() > 0 && (elapsed < 0 || elapsed >= limiter.policy.maxInterval());
+
+    switch (stateType->type()) {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+    case QVariant::Double: {
+        double threshold = qMax(limiter.policy.deadband(), limiter.policy.relativeDeadband() * qAbs(currentValue.toDouble()));
+        if (!heartbeatDue && threshold > 0 && qAbs(newValue.toDouble() - currentValue.toDouble()) < threshold) {
+            limiter.pendingValue.clear();
+            return false;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    if (limiter.policy.minInterval() > 0 && elapsed >= 0 && elapsed < limiter.policy.minInterval()) {
+        limiter.pendingValue = newValue;
+        if (!limiter.flushScheduled) {
+            limiter.flushScheduled = true;
+            StateTypeId stateTypeId = stateType->id();
+            QTimer::singleShot(static_cast<int>(limiter.policy.minInterval() - elapsed), this, [this, stateTypeId](){
+                flushPendingStateValue(stateTypeId);
+            });
         }
+        return false;
+    }
+
+    limiter.pendingValue.clear();
+    limiter.sinceLastChange.start();
+    return true;
+}
+
+void Thing::flushPendingStateValue(const StateTypeId &stateTypeId)
+{
+    QMutexLocker locker(dataMutex());
+    auto it = m_stateChangeLimiters.find(stateTypeId);
+    if (it == m_stateChangeLimiters.end()) {
+        return;
+    }
+    it->flushScheduled = false;
+    if (!it->pendingValue.isValid()) {
+        return;
+    }
+    QVariant value = it->pendingValue;
+    it->pendingValue.clear();
+    it->sinceLastChange.start();
+    locker.unlock();
+
+    applyStateValue(stateIndex(stateTypeId), findStateType(stateTypeId), value);
+}
+
+int Thing::stateIndex(const StateTypeId &stateTypeId) const
+{
+    if (m_statesInClassOrder) {
+        return m_thingClass.stateTypeIndex(stateTypeId);
+    }
+    return m_stateIndexes.value(stateTypeId, -1);
+}
+
+const StateType *Thing::findStateType(const StateTypeId &stateTypeId) const
+{
+    int i = m_thingClass.stateTypeIndex(stateTypeId);
+    if (i < 0) {
+        return nullptr;
+    }
+    return &m_stateTypes.at(i);
+}
+
+/* Called for things of plugins running in a worker thread, before the plugin gets to see the thing. */
+void Thing::enableWorkerThreadAccess()
+{
+    if (!m_workerThreadAccess) {
+        m_workerThreadAccess = new WorkerThreadAccess();
+    }
+}
+
+bool Thing::isWorkerThread() const
+{
+    return m_workerThreadAccess && QThread::currentThread() != thread();
+}
+
+QMutex *Thing::dataMutex() const
+{
+    return m_workerThreadAccess ? &m_workerThreadAccess->dataMutex : nullptr;
+}
+
+// Signals and events are collected until the core thread gets to them. They are emitted in the order
+// the plugin caused them.
+void Thing::postUpdate(const std::function<void()> &update)
+{
+    QMutexLocker locker(&m_workerThreadAccess->updatesMutex);
+    m_workerThreadAccess->pendingUpdates.append(update);
+    if (m_workerThreadAccess->pendingUpdates.count() == 1) {
+        QTimer::singleShot(0, this, [this](){ applyPostedUpdates(); });
+    }
+}
+
+void Thing::applyPostedUpdates()
+{
+    QList<std::function<void()>> updates;
+    {
+        QMutexLocker locker(&m_workerThreadAccess->updatesMutex);
+        updates.swap(m_workerThreadAccess->pendingUpdates);
+    }
+    foreach (const std::function<void()> &update, updates) {
+        update();
     }
 }
 
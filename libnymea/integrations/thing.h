@@ -39,10 +39,15 @@
 #include "types/param.h"
 #include "types/event.h"
 #include "types/browseritem.h"
+#include "types/statechangepolicy.h"
 
 #include <QObject>
 #include <QUuid>
 #include <QVariant>
+#include <QElapsedTimer>
+#include <QMutex>
+
+#include <functional>
 
 class IntegrationPlugin;
 class StateValueFilter;
@@ -92,6 +97,7 @@ public:
         ThingErrorItemNotExecutable,
         ThingErrorUnsupportedFeature,
         ThingErrorTimeout,
+        ThingErrorActionSuperseded,
     };
     Q_ENUM(ThingError)
 
@@ -141,6 +147,9 @@ public:
     Q_INVOKABLE QVariant stateValue(const QString &stateName) const;
     Q_INVOKABLE void setStateValue(const StateTypeId &stateTypeId, const QVariant &value);
     Q_INVOKABLE void setStateValue(const QString &stateName, const QVariant &value);
+    // Take the position of the state in the thing class as well, as generated into plugininfo.h
+    QVariant stateValue(int stateIndex, const StateTypeId &stateTypeId) const;
+    void setStateValue(int stateIndex, const StateTypeId &stateTypeId, const QVariant &value);
     Q_INVOKABLE void setStateMinValue(const StateTypeId &stateTypeId, const QVariant &minValue);
     Q_INVOKABLE void setStateMinValue(const QString &stateName, const QVariant &minValue);
     Q_INVOKABLE void setStateMaxValue(const StateTypeId &stateTypeId, const QVariant &maxValue);
@@ -148,9 +157,15 @@ public:
     Q_INVOKABLE void setStateMinMaxValues(const StateTypeId &stateTypeId, const QVariant &minValue, const QVariant &maxValue);
     Q_INVOKABLE void setStateMinMaxValues(const QString &stateName, const QVariant &minValue, const QVariant &maxValue);
 
+    void setStateValues(const QHash<StateTypeId, QVariant> &values);
+    Q_INVOKABLE void beginStateUpdate();
+    Q_INVOKABLE void commitStateUpdate();
+
     Q_INVOKABLE State state(const StateTypeId &stateTypeId) const;
     Q_INVOKABLE State state(const QString &stateName) const;
 
+    StateChangePolicy stateChangePolicy(const StateTypeId &stateTypeId) const;
+
     QList<EventTypeId> loggedEventTypeIds() const;
 
     ThingId parentId() const;
@@ -170,6 +185,7 @@ public slots:
 
 signals:
     void stateValueChanged(const StateTypeId &stateTypeId, const QVariant &value, const QVariant &minValue, const QVariant &maxValue);
+    void stateValuesChanged(const QList<StateTypeId> &stateTypeIds);
     void settingChanged(const ParamTypeId &paramTypeId, const QVariant &value);
     void nameChanged();
     void setupStatusChanged();
@@ -178,14 +194,46 @@ signals:
 private:
     friend class ThingManager;
     friend class ThingManagerImplementation;
+    friend class PluginHostThingManager;
     Thing(const PluginId &pluginId, const ThingClass &thingClass, const ThingId &id, QObject *parent = nullptr);
     Thing(const PluginId &pluginId, const ThingClass &thingClass, QObject *parent = nullptr);
 
     void setSetupStatus(ThingSetupStatus status, ThingError setupError, const QString &displayMessage = QString());
     void setLoggedEventTypeIds(const QList<EventTypeId> loggedEventTypeIds);
     void setStateValueFilter(const StateTypeId &stateTypeId, Types::StateValueFilter filter);
+    void setStateChangePolicy(const StateTypeId &stateTypeId, const StateChangePolicy &policy);
+    void enableWorkerThreadAccess();
 
 private:
+    struct StateChangeLimiter {
+        StateChangePolicy policy;
+        QElapsedTimer sinceLastChange;
+        QVariant pendingValue;
+        bool flushScheduled = false;
+    };
+
+    int stateIndex(const StateTypeId &stateTypeId) const;
+    // Points into m_stateTypes, which is never modified after construction
+    const StateType *findStateType(const StateTypeId &stateTypeId) const;
+    void notifyStateChanged(const State &state);
+    bool isStateIndex(int index, const StateTypeId &stateTypeId) const;
+    void updateStateValue(int index, const StateType *stateType, const QVariant &value);
+    void applyStateValue(int index, const StateType *stateType, const QVariant &newValue);
+    bool passesChangePolicy(int index, const StateType *stateType, const QVariant &newValue);
+    void flushPendingStateValue(const StateTypeId &stateTypeId);
+
+    // Things of plugins running in a worker thread are written by the plugin right away under the data mutex,
+    // so the plugin reads back what it has just set. Only the signals are queued and emitted in the core thread.
+    struct WorkerThreadAccess {
+        QMutex dataMutex;
+        QMutex updatesMutex;
+        QList<std::function<void()>> pendingUpdates;
+    };
+    bool isWorkerThread() const;
+    void postUpdate(const std::function<void()> &update);
+    void applyPostedUpdates();
+    QMutex *dataMutex() const;
+
     ThingClass m_thingClass;
     PluginId m_pluginId;
     ThingId m_id;
@@ -194,6 +242,11 @@ private:
     ParamList m_params;
     ParamList m_settings;
     States m_states;
+    // Shares the list of the thing class. States normally follow its order, so the positions come from the
+    // index of the thing class and only states set in a different order get an index of their own.
+    StateTypes m_stateTypes;
+    QHash<StateTypeId, int> m_stateIndexes;
+    bool m_statesInClassOrder = false;
     bool m_autoCreated = false;
 
     ThingSetupStatus m_setupStatus = ThingSetupStatusNone;
@@ -202,6 +255,13 @@ private:
 
     QList<EventTypeId> m_loggedEventTypeIds;
     QHash<StateTypeId, StateValueFilter*> m_stateValueFilters;
+    QHash<StateTypeId, StateChangeLimiter> m_stateChangeLimiters;
+
+    // Open beginStateUpdate() calls and the states changed since the first one
+    int m_stateUpdateDepth = 0;
+    QList<StateTypeId> m_pendingStateChanges;
+
+    WorkerThreadAccess *m_workerThreadAccess = nullptr;
 };
 
 QDebug operator<<(QDebug dbg, Thing *device);
@@ -31,7 +31,9 @@
 #include "thingactioninfo.h"
 
 #include "thingmanager.h"
+#include "timeoutwheel.h"
 
+#include <QThread>
 #include <QTimer>
 
 Q_DECLARE_LOGGING_CATEGORY(dcIntegrations)
@@ -44,8 +46,8 @@ ThingActionInfo::ThingActionInfo(Thing *thing, const Action &action, ThingManage
 {
     connect(this, &ThingActionInfo::finished, this, &ThingActionInfo::deleteLater, Qt::QueuedConnection);
 
-    if (timeout > 0) {
-        QTimer::singleShot(timeout, this, [this] {
+    if (timeout > 0 && m_thingManager) {
+        m_thingManager->timeoutWheel()->schedule(this, timeout, [this] {
             emit aborted();
             finish(Thing::ThingErrorTimeout);
         });
@@ -87,11 +89,19 @@ QString ThingActionInfo::translatedDisplayMessage(const QLocale &locale)
 
 void ThingActionInfo::finish(Thing::ThingError status, const QString &displayMessage)
 {
+    if (QThread::currentThread() != thread()) {
+        // Called by a plugin running in a worker thread, infos are always finished in the core thread
+        QTimer::singleShot(0, this, [this, status, displayMessage](){ finish(status, displayMessage); });
+        return;
+    }
     if (m_finished) {
         qCWarning(dcIntegrations()) << "ThingActionInfo::finish() called on an already finished object.";
         return;
     }
     m_finished = true;
+    if (m_thingManager) {
+        m_thingManager->timeoutWheel()->cancel(this);
+    }
     m_status = status;
     m_displayMessage = displayMessage;
     staticQtMetaObject.invokeMethod(this, "finished", Qt::QueuedConnection);
@@ -30,7 +30,9 @@
 
 #include "thingdiscoveryinfo.h"
 #include "thingmanager.h"
+#include "timeoutwheel.h"
 
+#include <QThread>
 #include <QTimer>
 
 Q_DECLARE_LOGGING_CATEGORY(dcIntegrations)
@@ -43,8 +45,8 @@ ThingDiscoveryInfo::ThingDiscoveryInfo(const ThingClassId &thingClassId, const P
 {
     connect(this, &ThingDiscoveryInfo::finished, this, &ThingDiscoveryInfo::deleteLater, Qt::QueuedConnection);
 
-    if (timeout > 0) {
-        QTimer::singleShot(timeout, this, [this] {
+    if (timeout > 0 && m_thingManager) {
+        m_thingManager->timeoutWheel()->schedule(this, timeout, [this] {
             emit aborted();
             finish(Thing::ThingErrorTimeout);
         });
@@ -71,14 +73,38 @@ Thing::ThingError ThingDiscoveryInfo::status() const
     return m_status;
 }
 
+/*! Adds the \a thingDescriptor to the results of the discovery, unless the same thing has been found already.
+    Results are reported with thingDescriptorsAdded() right away, so a plugin should add things as soon as
+    it finds them rather than collecting them until the discovery is finished. */
 void ThingDiscoveryInfo::addThingDescriptor(const ThingDescriptor &thingDescriptor)
 {
-    m_thingDescriptors.append(thingDescriptor);
+    addThingDescriptors(ThingDescriptors() << thingDescriptor);
 }
 
+/*! Adds the \a thingDescriptors to the results of the discovery, leaving out things that have been found already. */
 void ThingDiscoveryInfo::addThingDescriptors(const ThingDescriptors &thingDescriptors)
 {
-    m_thingDescriptors.append(thingDescriptors);
+    if (QThread::currentThread() != thread()) {
+        QTimer::singleShot(0, this, [this, thingDescriptors](){ addThingDescriptors(thingDescriptors); });
+        return;
+    }
+    if (m_finished) {
+        qCWarning(dcIntegrations()) << "ThingDiscoveryInfo::addThingDescriptors() called on an already finished object.";
+        return;
+    }
+    ThingDescriptors added;
+    foreach (const ThingDescriptor &thingDescriptor, thingDescriptors) {
+        if (isDuplicate(thingDescriptor)) {
+            qCDebug(dcIntegrations()) << "Dropping duplicate discovery result" << thingDescriptor.title();
+            continue;
+        }
+        added.append(thingDescriptor);
+    }
+    if (added.isEmpty()) {
+        return;
+    }
+    m_thingDescriptors.append(added);
+    emit thingDescriptorsAdded(added);
 }
 
 ThingDescriptors ThingDiscoveryInfo::thingDescriptors() const
@@ -100,13 +126,41 @@ QString ThingDiscoveryInfo::translatedDisplayMessage(const QLocale &locale)
     return m_thingManager->translate(deviceClass.pluginId(), m_displayMessage.toUtf8(), locale);
 }
 
+bool ThingDiscoveryInfo::isDuplicate(const ThingDescriptor &thingDescriptor)
+{
+    if (!m_thingManager) {
+        return false;
+    }
+    QList<ParamTypeId> keyParamTypeIds = m_thingManager->findThingClass(thingDescriptor.thingClassId()).discoveryKeyParamTypeIds();
+    if (keyParamTypeIds.isEmpty()) {
+        return false;
+    }
+    QStringList values = {thingDescriptor.thingClassId().toString()};
+    foreach (const ParamTypeId &paramTypeId, keyParamTypeIds) {
+        values.append(thingDescriptor.params().paramValue(paramTypeId).toString());
+    }
+    QString discoveryKey = values.join(QChar(0x1f));
+    if (m_discoveryKeys.contains(discoveryKey)) {
+        return true;
+    }
+    m_discoveryKeys.insert(discoveryKey);
+    return false;
+}
+
 void ThingDiscoveryInfo::finish(Thing::ThingError status, const QString &displayMessage)
 {
+    if (QThread::currentThread() != thread()) {
+        QTimer::singleShot(0, this, [this, status, displayMessage](){ finish(status, displayMessage); });
+        return;
+    }
     if (m_finished) {
         qCWarning(dcIntegrations()) << "ThingDiscoveryInfo::finish() called on an already finished object.";
         return;
     }
     m_finished = true;
+    if (m_thingManager) {
+        m_thingManager->timeoutWheel()->cancel(this);
+    }
     m_status = status;
     m_displayMessage = displayMessage;
     staticMetaObject.invokeMethod(this, "finished", Qt::QueuedConnection);
@@ -32,6 +32,7 @@
 #define THINGDISCOVERYINFO_H
 
 #include <QObject>
+#include <QSet>
 
 #include "types/thingclass.h"
 #include "types/param.h"
@@ -65,6 +66,7 @@ public slots:
     void finish(Thing::ThingError status,  const QString &displayMessage = QString());
 
 signals:
+    void thingDescriptorsAdded(const ThingDescriptors &thingDescriptors);
     void finished();
     void aborted();
 
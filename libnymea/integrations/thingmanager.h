@@ -42,6 +42,8 @@
 #include "types/browseraction.h"
 #include "types/browseritemaction.h"
 
+class TimeoutWheel;
+
 class ThingManager : public QObject
 {
     Q_OBJECT
@@ -83,10 +85,12 @@ public:
 
     virtual Thing::ThingError setEventLogging(const ThingId &thingId, const EventTypeId &eventTypeId, bool enabled) = 0;
     virtual Thing::ThingError setStateFilter(const ThingId &thingId, const StateTypeId &stateTypeId, Types::StateValueFilter filter) = 0;
+    virtual Thing::ThingError setStateChangePolicy(const ThingId &thingId, const StateTypeId &stateTypeId, const StateChangePolicy &policy) = 0;
 
     virtual Thing::ThingError removeConfiguredThing(const ThingId &thingId) = 0;
 
     virtual ThingActionInfo* executeAction(const Action &action) = 0;
+    virtual QList<ThingActionInfo*> executeActions(const QList<Action> &actions) = 0;
 
     virtual BrowseResult* browseThing(const ThingId &thingId, const QString &itemId, const QLocale &locale) = 0;
     virtual BrowserItemResult* browserItemDetails(const ThingId &thingId, const QString &itemId, const QLocale &locale) = 0;
@@ -105,6 +109,9 @@ public:
     virtual ThingClass translateThingClass(const ThingClass &thingClass, const QLocale &locale) = 0;
     virtual Vendor translateVendor(const Vendor &vendor, const QLocale &locale) = 0;
 
+    // Runs the timeouts of the infos handed to the plugins
+    virtual TimeoutWheel *timeoutWheel() const = 0;
+
 protected:
     virtual IOConnectionResult connectIO(const IOConnection &connection) = 0;
 
@@ -112,6 +119,7 @@ signals:
     void pluginConfigChanged(const PluginId &id, const ParamList &config);
     void eventTriggered(const Event &event);
     void thingStateChanged(Thing *thing, const StateTypeId &stateTypeId, const QVariant &value, const QVariant &minValue, const QVariant &maxValue);
+    void thingStatesChanged(Thing *thing, const QList<StateTypeId> &stateTypeIds);
     void thingRemoved(const ThingId &thingId);
     void thingDisappeared(const ThingId &thingId);
     void thingAdded(Thing *thing);
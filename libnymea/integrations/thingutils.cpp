@@ -35,6 +35,30 @@
 #include <QFileInfo>
 #include <QJsonParseError>
 #include <QMetaEnum>
+#include <QMutex>
+#include <QMutexLocker>
+
+// Interface definitions are compiled in and never change, each one is parsed once. Plugin metadata is
+// loaded from several threads at startup, hence the lock.
+static QMutex s_interfaceCacheMutex;
+static QHash<QString, Interface> s_interfaceCache;
+static QHash<QString, QStringList> s_interfaceParentListCache;
+
+static QVariantMap readInterfaceDefinition(const QString &name)
+{
+    QFile f(QString(":/interfaces/%1.json").arg(name));
+    if (!f.open(QFile::ReadOnly)) {
+        qCWarning(dcThingManager()) << "Failed to load interface" << name;
+        return QVariantMap();
+    }
+    QJsonParseError error;
+    QJsonDocument jsonDoc = QJsonDocument::fromJson(f.readAll(), &error);
+    if (error.error != QJsonParseError::NoError) {
+        qCWarning(dcThingManager) << "Cannot load interface definition for interface" << name << ":" << error.errorString();
+        return QVariantMap();
+    }
+    return jsonDoc.toVariant().toMap();
+}
 
 ThingUtils::ThingUtils()
 {
@@ -51,15 +75,7 @@ Thing::ThingError ThingUtils::verifyParams(const QList<ParamType> paramTypes, co
         }
     }
     foreach (const ParamType &paramType, paramTypes) {
-        bool found = !paramType.defaultValue().isNull();
-        foreach (const Param &param, params) {
-            if (paramType.id() == param.paramTypeId()) {
-                found = true;
-                break;
-            }
-        }
-
-        if (!found) {
+        if (paramType.defaultValue().isNull() && !params.hasParam(paramType.id())) {
             qCWarning(dcThing) << "Missing parameter:" << paramType.name() << params;
             return Thing::ThingErrorMissingParameter;
         }
@@ -163,21 +179,31 @@ Interfaces ThingUtils::allInterfaces()
     return ret;
 }
 
+/*! Returns the interface with the given \a name, with the states, actions and events of the interfaces it
+    extends merged in. Returns an invalid interface if there is no such interface. */
 Interface ThingUtils::loadInterface(const QString &name)
 {
-    Interface iface;
-    QFile f(QString(":/interfaces/%1.json").arg(name));
-    if (!f.open(QFile::ReadOnly)) {
-        qCWarning(dcThingManager()) << "Failed to load interface" << name;
-        return iface;
+    {
+        QMutexLocker locker(&s_interfaceCacheMutex);
+        QHash<QString, Interface>::const_iterator it = s_interfaceCache.constFind(name);
+        if (it != s_interfaceCache.constEnd()) {
+            return *it;
+        }
     }
-    QJsonParseError error;
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(f.readAll(), &error);
-    if (error.error != QJsonParseError::NoError) {
-        qCWarning(dcThingManager) << "Cannot load interface definition for interface" << name << ":" << error.errorString();
+    // Parsed without holding the lock, as the extended interfaces are loaded recursively
+    Interface iface = parseInterface(name);
+    QMutexLocker locker(&s_interfaceCacheMutex);
+    s_interfaceCache.insert(name, iface);
+    return iface;
+}
+
+Interface ThingUtils::parseInterface(const QString &name)
+{
+    Interface iface;
+    QVariantMap content = readInterfaceDefinition(name);
+    if (content.isEmpty()) {
         return iface;
     }
-    QVariantMap content = jsonDoc.toVariant().toMap();
     if (content.contains("extends")) {
         if (!content.value("extends").toString().isEmpty()) {
             iface = loadInterface(content.value("extends").toString());
@@ -311,19 +337,18 @@ Interface ThingUtils::mergeInterfaces(const Interface &iface1, const Interface &
 
 QStringList ThingUtils::generateInterfaceParentList(const QString &interface)
 {
-    QFile f(QString(":/interfaces/%1.json").arg(interface));
-    if (!f.open(QFile::ReadOnly)) {
-        qCWarning(dcThingManager()) << "Failed to load interface" << interface;
-        return QStringList();
+    {
+        QMutexLocker locker(&s_interfaceCacheMutex);
+        QHash<QString, QStringList>::const_iterator it = s_interfaceParentListCache.constFind(interface);
+        if (it != s_interfaceParentListCache.constEnd()) {
+            return *it;
+        }
     }
-    QJsonParseError error;
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(f.readAll(), &error);
-    if (error.error != QJsonParseError::NoError) {
-        qCWarning(dcThingManager) << "Cannot load interface definition for interface" << interface << ":" << error.errorString();
+    QVariantMap content = readInterfaceDefinition(interface);
+    if (content.isEmpty()) {
         return QStringList();
     }
     QStringList ret = {interface};
-    QVariantMap content = jsonDoc.toVariant().toMap();
     if (content.contains("extends")) {
         if (!content.value("extends").toString().isEmpty()) {
             ret << generateInterfaceParentList(content.value("extends").toString());
@@ -333,5 +358,7 @@ QStringList ThingUtils::generateInterfaceParentList(const QString &interface)
             }
         }
     }
+    QMutexLocker locker(&s_interfaceCacheMutex);
+    s_interfaceParentListCache.insert(interface, ret);
     return ret;
 }
@@ -51,6 +51,8 @@ public:
     static Interface mergeInterfaces(const Interface &iface1, const Interface &iface2);
     static QStringList generateInterfaceParentList(const QString &interface);
 
+private:
+    static Interface parseInterface(const QString &name);
 };
 
 #endif // THINGUTILS_H
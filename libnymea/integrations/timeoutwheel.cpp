@@ -0,0 +1,134 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class TimeoutWheel
+    \brief Runs the timeouts of many objects on one timer.
+
+    \ingroup things
+    \inmodule libnymea
+
+    The infos handed to the plugins, like \l{ThingActionInfo} or \l{ThingSetupInfo}, time out if the plugin
+    doesn't finish them in time. There can be hundreds of them at once, for instance when rules run scenes
+    on many things. Instead of a timer each, they are scheduled on the timeout wheel of the \l{ThingManager}.
+
+    The wheel is a ring of slots, advanced by one slot every \c resolution milliseconds. A timeout is put into
+    the slot it expires in and counts the rounds it has to wait if it is longer than one turn of the wheel.
+    Scheduling and cancelling take constant time, timeouts fire up to one \c resolution late. The timer only
+    runs while there are timeouts scheduled.
+*/
+
+#include "timeoutwheel.h"
+
+#include <QTimer>
+
+/*! Constructs a timeout wheel with \a slotCount slots, advancing every \a resolution milliseconds. */
+TimeoutWheel::TimeoutWheel(int resolution, int slotCount, QObject *parent):
+    QObject(parent),
+    m_resolution(qMax(1, resolution)),
+    m_slots(qMax(1, slotCount))
+{
+    m_timer = new QTimer(this);
+    m_timer->setInterval(m_resolution);
+    connect(m_timer, &QTimer::timeout, this, &TimeoutWheel::tick);
+}
+
+/*! Calls \a callback after \a timeout milliseconds unless \a object is cancelled or destroyed before.
+    An object has one timeout at most, scheduling it again replaces the previous one. */
+void TimeoutWheel::schedule(QObject *object, quint32 timeout, const std::function<void()> &callback)
+{
+    cancel(object);
+
+    // One more tick as the next one may be due any moment, so a timeout never fires early
+    quint64 ticks = timeout / static_cast<quint32>(m_resolution) + 1;
+    int slot = static_cast<int>((m_current + ticks) % static_cast<quint64>(m_slots.count()));
+
+    Entry entry;
+    entry.object = object;
+    entry.callback = callback;
+    entry.rounds = static_cast<int>((ticks - 1) / static_cast<quint64>(m_slots.count()));
+    m_slots[slot].insert(object, entry);
+    m_slotIndex.insert(object, slot);
+
+    if (!m_timer->isActive()) {
+        m_timer->start();
+    }
+}
+
+/*! Cancels the timeout of \a object, if there is one. */
+void TimeoutWheel::cancel(QObject *object)
+{
+    QHash<QObject*, int>::iterator it = m_slotIndex.find(object);
+    if (it == m_slotIndex.end()) {
+        return;
+    }
+    m_slots[it.value()].remove(object);
+    m_slotIndex.erase(it);
+
+    if (m_slotIndex.isEmpty()) {
+        m_timer->stop();
+    }
+}
+
+/*! Returns the number of timeouts currently scheduled. */
+int TimeoutWheel::count() const
+{
+    return m_slotIndex.count();
+}
+
+void TimeoutWheel::tick()
+{
+    m_current = (m_current + 1) % m_slots.count();
+
+    QList<Entry> expired;
+    QHash<QObject*, Entry> &slot = m_slots[m_current];
+    QHash<QObject*, Entry>::iterator it = slot.begin();
+    while (it != slot.end()) {
+        if (it->rounds > 0) {
+            it->rounds--;
+            ++it;
+            continue;
+        }
+        expired.append(it.value());
+        m_slotIndex.remove(it.key());
+        it = slot.erase(it);
+    }
+
+    if (m_slotIndex.isEmpty()) {
+        m_timer->stop();
+    }
+
+    // Callbacks may schedule or cancel other timeouts, so they run after the slot is done
+    foreach (const Entry &entry, expired) {
+        if (!entry.object.isNull()) {
+            entry.callback();
+        }
+    }
+}
@@ -0,0 +1,73 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef TIMEOUTWHEEL_H
+#define TIMEOUTWHEEL_H
+
+#include "libnymea.h"
+
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+#include <QHash>
+#include <functional>
+
+class QTimer;
+
+class LIBNYMEA_EXPORT TimeoutWheel : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TimeoutWheel(int resolution = 100, int slotCount = 512, QObject *parent = nullptr);
+
+    void schedule(QObject *object, quint32 timeout, const std::function<void()> &callback);
+    void cancel(QObject *object);
+
+    int count() const;
+
+private:
+    void tick();
+
+    class Entry {
+    public:
+        QPointer<QObject> object;
+        std::function<void()> callback;
+        int rounds = 0;
+    };
+
+    int m_resolution;
+    QTimer *m_timer = nullptr;
+    QVector<QHash<QObject*, Entry>> m_slots;
+    // The slot of each scheduled object, for cancelling without searching the wheel
+    QHash<QObject*, int> m_slotIndex;
+    int m_current = 0;
+};
+
+#endif // TIMEOUTWHEEL_H
@@ -78,6 +78,16 @@ QVariantMap JsonHandler::jsonNotifications() const
     return m_notifications;
 }
 
+bool JsonHandler::hasSubscribers() const
+{
+    return m_subscriberCount > 0;
+}
+
+void JsonHandler::setSubscriberCount(int subscriberCount)
+{
+    m_subscriberCount = subscriberCount;
+}
+
 QString JsonHandler::objectRef(const QString &objectName)
 {
     return "$ref:" + objectName;
@@ -228,6 +238,7 @@ void JsonHandler::registerObject(const QMetaObject &metaObject)
     }
     m_objects.insert(className, description);
     m_metaObjects.insert(className, metaObject);
+    m_packingPlans.clear();
 }
 
 void JsonHandler::registerObject(const QMetaObject &metaObject, const QMetaObject &listMetaObject)
@@ -239,165 +250,345 @@ void JsonHandler::registerObject(const QMetaObject &metaObject, const QMetaObjec
     m_metaObjects.insert(listTypeName, listMetaObject);
     m_listMetaObjects.insert(listTypeName, listMetaObject);
     m_listEntryTypes.insert(listTypeName, objectTypeName);
+    m_packingPlans.clear();
     Q_ASSERT_X(listMetaObject.indexOfProperty("count") >= 0, "JsonHandler", QString("List type %1 does not implement \"count\" property!").arg(listTypeName).toUtf8());
     Q_ASSERT_X(listMetaObject.indexOfMethod("get(int)") >= 0, "JsonHandler", QString("List type %1 does not implement \"Q_INVOKABLE QVariant get(int index)\" method!").arg(listTypeName).toUtf8());
     Q_ASSERT_X(listMetaObject.indexOfMethod("put(QVariant)") >= 0, "JsonHandler", QString("List type %1 does not implement \"Q_INVOKABLE void put(QVariant variant)\" method!").arg(listTypeName).toUtf8());
 }
 
-QVariant JsonHandler::pack(const QMetaObject &metaObject, const void *value) const
+// Resolves all the type names, meta enums and nested types of the given type. Plans of nested types are built
+// along, a plan is in the cache before its properties are resolved so self referencing types work.
+const JsonHandler::PackingPlan *JsonHandler::packingPlan(const QMetaObject &metaObject) const
 {
+    QHash<const char*, QSharedPointer<PackingPlan> >::const_iterator it = m_packingPlans.constFind(metaObject.className());
+    if (it != m_packingPlans.constEnd()) {
+        return it.value().data();
+    }
+
     QString className = QString(metaObject.className()).split("::").last();
+    if (!m_metaObjects.contains(className)) {
+        return nullptr;
+    }
+
+    QSharedPointer<PackingPlan> plan(new PackingPlan);
+    m_packingPlans.insert(metaObject.className(), plan);
+    plan->className = className;
+
     if (m_listMetaObjects.contains(className)) {
+        plan->isList = true;
+        plan->countProperty = metaObject.property(metaObject.indexOfProperty("count"));
+        plan->getMethod = metaObject.method(metaObject.indexOfMethod("get(int)"));
+        plan->entryPlan = packingPlan(m_metaObjects.value(m_listEntryTypes.value(className)));
+        return plan.data();
+    }
+
+    QMetaEnum basicTypeEnum = QMetaEnum::fromType<BasicType>();
+    for (int i = 0; i < metaObject.propertyCount(); i++) {
+        QMetaProperty metaProperty = metaObject.property(i);
+
+        // Skip QObject's objectName property
+        if (metaProperty.name() == QStringLiteral("objectName")) {
+            continue;
+        }
+
+        PackingPlan::Property property;
+        property.metaProperty = metaProperty;
+        property.name = QString::fromUtf8(metaProperty.name());
+        property.optional = metaProperty.isUser();
+        property.typeName = QString(metaProperty.typeName()).split("::").last();
+
+        if (metaProperty.isFlagType()) {
+            Q_ASSERT_X(m_metaFlags.contains(property.typeName), this->metaObject()->className(), QString("Cannot pack %1. %2 is not registered in this handler.").arg(className).arg(property.typeName).toUtf8());
+            QMetaEnum metaFlag = m_metaFlags.value(property.typeName);
+            property.kind = PackingPlan::Property::KindFlag;
+            for (int j = 0; j < metaFlag.keyCount(); j++) {
+                property.flagKeys.append(qMakePair(metaFlag.value(j), QString::fromUtf8(metaFlag.key(j))));
+            }
+        } else if (metaProperty.isEnumType()) {
+            Q_ASSERT_X(m_metaEnums.contains(property.typeName), this->metaObject()->className(), QString("Cannot pack %1. %2 is not registered in this handler.").arg(className).arg(metaProperty.typeName()).toUtf8());
+            QMetaEnum metaEnum = m_metaEnums.value(property.typeName);
+            property.kind = PackingPlan::Property::KindEnum;
+            for (int j = 0; j < metaEnum.keyCount(); j++) {
+                property.enumKeys.append(QString::fromUtf8(metaEnum.key(j)));
+            }
+        } else if (metaProperty.typeName() == QStringLiteral("QVariant::Type")) {
+            property.kind = PackingPlan::Property::KindBasicType;
+            for (int j = 0; j < basicTypeEnum.keyCount(); j++) {
+                property.enumKeys.append(QString::fromUtf8(basicTypeEnum.key(j)));
+            }
+        } else if (metaProperty.type() == QVariant::UserType) {
+            if (m_listMetaObjects.contains(property.typeName)) {
+                property.kind = PackingPlan::Property::KindList;
+                property.nested = packingPlan(m_listMetaObjects.value(property.typeName));
+            } else if (m_metaObjects.contains(property.typeName)) {
+                QMetaObject entryMetaObject = m_metaObjects.value(property.typeName);
+                property.kind = PackingPlan::Property::KindObject;
+                property.nested = packingPlan(entryMetaObject);
+                int isValidIndex = entryMetaObject.indexOfMethod("isValid()");
+                if (isValidIndex >= 0) {
+                    property.isValidMethod = entryMetaObject.method(isValidIndex);
+                }
+            } else if (property.typeName.startsWith("QList<")) {
+                // Manually converting QList<BasicType>... Only QVariantList is known to the meta system
+                if (property.typeName == "QList<int>") {
+                    property.kind = PackingPlan::Property::KindIntList;
+                } else if (property.typeName == "QList<QUuid>") {
+                    property.kind = PackingPlan::Property::KindUuidList;
+                } else if (property.typeName == "QList<EventTypeId>" || property.typeName == "QList<StateTypeId>" || property.typeName == "QList<ActionTypeId>") {
+                    property.kind = PackingPlan::Property::KindIdList;
+                } else if (property.typeName == "QList<QDateTime>") {
+                    property.kind = PackingPlan::Property::KindDateTimeList;
+                } else {
+                    Q_ASSERT_X(false, this->metaObject()->className(), QString("Unhandled list type: %1").arg(property.typeName).toUtf8());
+                    property.kind = PackingPlan::Property::KindUnhandledList;
+                }
+            } else {
+                Q_ASSERT_X(false, this->metaObject()->className(), QString("Unregistered property type: %1").arg(property.typeName).toUtf8());
+                property.kind = PackingPlan::Property::KindUnregistered;
+            }
+        } else if (metaProperty.type() == QVariant::DateTime) {
+            // Special treatment for QDateTime (converting to time_t)
+            property.kind = PackingPlan::Property::KindDateTime;
+        } else if (metaProperty.type() == QVariant::Time) {
+            property.kind = PackingPlan::Property::KindTime;
+        }
+        plan->properties.append(property);
+    }
+    return plan.data();
+}
+
+QVariant JsonHandler::pack(const PackingPlan &plan, const void *value) const
+{
+    if (plan.isList) {
         QVariantList ret;
-        QMetaProperty countProperty = metaObject.property(metaObject.indexOfProperty("count"));
-        QMetaObject entryMetaObject = m_metaObjects.value(m_listEntryTypes.value(className));
-        int count = countProperty.readOnGadget(value).toInt();
-        QMetaMethod getMethod = metaObject.method(metaObject.indexOfMethod("get(int)"));
+        int count = plan.countProperty.readOnGadget(value).toInt();
+        ret.reserve(count);
         for (int i = 0; i < count; i++) {
             QVariant entry;
-            getMethod.invokeOnGadget(const_cast<void*>(value), Q_RETURN_ARG(QVariant, entry), Q_ARG(int, i));
-            ret.append(pack(entryMetaObject, entry.data()));
+            plan.getMethod.invokeOnGadget(const_cast<void*>(value), Q_RETURN_ARG(QVariant, entry), Q_ARG(int, i));
+            if (!plan.entryPlan) {
+                Q_ASSERT_X(false, this->metaObject()->className(), QString("Unregistered entry type of %1").arg(plan.className).toUtf8());
+                qCWarning(dcJsonRpc()) << "Cannot pack entries of unregistered type in" << plan.className;
+                ret.append(QVariant());
+                continue;
+            }
+            ret.append(pack(*plan.entryPlan, entry.data()));
         }
         return ret;
     }
 
-    if (m_metaObjects.contains(className)) {
-        QVariantMap ret;
-        for (int i = 0; i < metaObject.propertyCount(); i++) {
-            QMetaProperty metaProperty = metaObject.property(i);
-
-            // Skip QObject's objectName property
-            if (metaProperty.name() == QStringLiteral("objectName")) {
-                continue;
-            }
+    QVariantMap ret;
+    foreach (const PackingPlan::Property &property, plan.properties) {
+        QVariant propertyValue = property.metaProperty.readOnGadget(value);
+        // If it's optional and empty, we may skip it
+        if (property.optional && (!propertyValue.isValid() || propertyValue.isNull())) {
+            continue;
+        }
 
-            QVariant propertyValue = metaProperty.readOnGadget(value);
-            // If it's optional and empty, we may skip it
-            if (metaProperty.isUser() && (!propertyValue.isValid() || propertyValue.isNull())) {
-                continue;
+        switch (property.kind) {
+        case PackingPlan::Property::KindList: {
+            QVariant packed = pack(*property.nested, propertyValue.data());
+            if (!property.optional || packed.toList().count() > 0) {
+                ret.insert(property.name, packed);
             }
-
-            // Pack flags
-            if (metaProperty.isFlagType()) {
-                QString flagName = QString(metaProperty.typeName()).split("::").last();
-                Q_ASSERT_X(m_metaFlags.contains(flagName), this->metaObject()->className(), QString("Cannot pack %1. %2 is not registered in this handler.").arg(className).arg(flagName).toUtf8());
-                QMetaEnum metaFlag = m_metaFlags.value(flagName);
-                int flagValue = propertyValue.toInt();
-                QStringList flags;
-                for (int i = 0; i < metaFlag.keyCount(); i++) {
-                    if ((metaFlag.value(i) & flagValue) > 0) {
-                        flags.append(metaFlag.key(i));
-                    }
-                }
-                ret.insert(metaProperty.name(), flags);
-                continue;
+            break;
+        }
+        case PackingPlan::Property::KindObject: {
+            if (isPackedObjectValid(property, propertyValue)) {
+                ret.insert(property.name, pack(*property.nested, propertyValue.data()));
             }
-
-            // Pack enums
-            if (metaProperty.isEnumType()) {
-                QString enumName = QString(metaProperty.typeName()).split("::").last();
-                Q_ASSERT_X(m_metaEnums.contains(enumName), this->metaObject()->className(), QString("Cannot pack %1. %2 is not registered in this handler.").arg(className).arg(metaProperty.typeName()).toUtf8());
-                QMetaEnum metaEnum = m_metaEnums.value(enumName);
-                ret.insert(metaProperty.name(), metaEnum.key(propertyValue.toInt()));
-                continue;
+            break;
+        }
+        default: {
+            QVariant packed;
+            if (packValue(property, propertyValue, &packed)) {
+                ret.insert(property.name, packed);
             }
+            break;
+        }
+        }
+    }
+    return ret;
+}
 
-            // Basic type/Variant type
-            if (metaProperty.typeName() == QStringLiteral("QVariant::Type")) {
-                QMetaEnum metaEnum = QMetaEnum::fromType<BasicType>();
-                ret.insert(metaProperty.name(), metaEnum.key(variantTypeToBasicType(propertyValue.template value<QVariant::Type>())));
+void JsonHandler::pack(JsonWriter &writer, const PackingPlan &plan, const void *value, const QVariantMap &overrides) const
+{
+    if (plan.isList) {
+        writer.beginArray();
+        int count = plan.countProperty.readOnGadget(value).toInt();
+        for (int i = 0; i < count; i++) {
+            QVariant entry;
+            plan.getMethod.invokeOnGadget(const_cast<void*>(value), Q_RETURN_ARG(QVariant, entry), Q_ARG(int, i));
+            if (!plan.entryPlan) {
+                Q_ASSERT_X(false, this->metaObject()->className(), QString("Unregistered entry type of %1").arg(plan.className).toUtf8());
+                qCWarning(dcJsonRpc()) << "Cannot pack entries of unregistered type in" << plan.className;
+                writer.writeNull();
                 continue;
             }
+            pack(writer, *plan.entryPlan, entry.data(), QVariantMap());
+        }
+        writer.endArray();
+        return;
+    }
 
-            // Our own objects
-            if (metaProperty.type() == QVariant::UserType) {
-                QString propertyTypeName = QString(metaProperty.typeName()).split("::").last();
-                if (m_listMetaObjects.contains(propertyTypeName)) {
-                    QMetaObject entryMetaObject = m_listMetaObjects.value(propertyTypeName);
-                    QVariant packed = pack(entryMetaObject, propertyValue.data());
-                    if (!metaProperty.isUser() || packed.toList().count() > 0) {
-                        ret.insert(metaProperty.name(), packed);
-                    }
-                    continue;
-                }
+    writer.beginObject();
+    foreach (const PackingPlan::Property &property, plan.properties) {
+        if (!overrides.isEmpty() && overrides.contains(property.name)) {
+            continue;
+        }
+        QVariant propertyValue = property.metaProperty.readOnGadget(value);
+        // If it's optional and empty, we may skip it
+        if (property.optional && (!propertyValue.isValid() || propertyValue.isNull())) {
+            continue;
+        }
 
-                if (m_metaObjects.contains(propertyTypeName)) {
-                    QMetaObject entryMetaObject = m_metaObjects.value(propertyTypeName);
-                    QVariant packed = pack(entryMetaObject, propertyValue.data());
-                    int isValidIndex = entryMetaObject.indexOfMethod("isValid()");
-                    bool isValid = true;
-                    if (isValidIndex >= 0) {
-                        QMetaMethod isValidMethod = entryMetaObject.method(isValidIndex);
-                        isValidMethod.invokeOnGadget(propertyValue.data(), Q_RETURN_ARG(bool, isValid));
-                    }
-                    if (isValid || !metaProperty.isUser()) {
-                        ret.insert(metaProperty.name(), packed);
-                    }
-                    continue;
-                }
+        switch (property.kind) {
+        case PackingPlan::Property::KindList: {
+            // Empty optional lists are left out, so the count is needed before writing the key
+            if (property.optional && property.nested && property.nested->countProperty.readOnGadget(propertyValue.data()).toInt() == 0) {
+                break;
+            }
+            writer.writeKey(property.name);
+            pack(writer, *property.nested, propertyValue.data(), QVariantMap());
+            break;
+        }
+        case PackingPlan::Property::KindObject: {
+            if (isPackedObjectValid(property, propertyValue)) {
+                writer.writeKey(property.name);
+                pack(writer, *property.nested, propertyValue.data(), QVariantMap());
+            }
+            break;
+        }
+        default: {
+            QVariant packed;
+            if (packValue(property, propertyValue, &packed)) {
+                writer.writeKey(property.name);
+                writer.writeValue(packed);
+            }
+            break;
+        }
+        }
+    }
+    for (QVariantMap::const_iterator it = overrides.constBegin(); it != overrides.constEnd(); ++it) {
+        // An invalid override leaves the property out
+        if (!it.value().isValid()) {
+            continue;
+        }
+        writer.writeKey(it.key());
+        writer.writeValue(it.value());
+    }
+    writer.endObject();
+}
 
-                // Manually converting QList<BasicType>... Only QVariantList is known to the meta system
-                if (propertyTypeName.startsWith("QList<")) {
-                    QVariantList list;
-                    if (propertyTypeName == "QList<int>") {
-                        foreach (int entry, propertyValue.value<QList<int>>()) {
-                            list << entry;
-                        }
-                    } else if (propertyTypeName == "QList<QUuid>") {
-                        foreach (const QUuid &entry, propertyValue.value<QList<QUuid>>()) {
-                            list << entry;
-                        }
-                    } else if (propertyTypeName == "QList<EventTypeId>") {
-                        foreach (const EventTypeId &entry, propertyValue.value<QList<EventTypeId>>()) {
-                            list << entry;
-                        }
-                    } else if (propertyTypeName == "QList<StateTypeId>") {
-                        foreach (const EventTypeId &entry, propertyValue.value<QList<EventTypeId>>()) {
-                            list << entry;
-                        }
-                    } else if (propertyTypeName == "QList<ActionTypeId>") {
-                        foreach (const EventTypeId &entry, propertyValue.value<QList<EventTypeId>>()) {
-                            list << entry;
-                        }
-                    } else if (propertyTypeName == "QList<QDateTime>") {
-                        foreach (const QDateTime &timestamp, propertyValue.value<QList<QDateTime>>()) {
-                            list << timestamp.toMSecsSinceEpoch() / 1000;
-                        }
-                    } else {
-                        Q_ASSERT_X(false, this->metaObject()->className(), QString("Unhandled list type: %1").arg(propertyTypeName).toUtf8());
-                        qCWarning(dcJsonRpc()) << "Cannot pack property of unhandled list type" << propertyTypeName;
-                    }
+void JsonHandler::pack(JsonWriter &writer, const QMetaObject &metaObject, const void *value, const QVariantMap &overrides) const
+{
+    const PackingPlan *plan = packingPlan(metaObject);
+    if (!plan) {
+        QString className = QString(metaObject.className()).split("::").last();
+        Q_ASSERT_X(false, this->metaObject()->className(), QString("Unregistered object type: %1").arg(className).toUtf8());
+        qCWarning(dcJsonRpc()) << "Cannot pack object of unregistered type" << className;
+        writer.writeNull();
+        return;
+    }
+    pack(writer, *plan, value, overrides);
+}
 
-                    if (!list.isEmpty() || !metaProperty.isUser()) {
-                        ret.insert(metaProperty.name(), list);
-                    }
-                    continue;
-                }
+// Optional nested objects are only packed if their isValid() says so
+bool JsonHandler::isPackedObjectValid(const PackingPlan::Property &property, const QVariant &propertyValue)
+{
+    bool isValid = true;
+    if (property.isValidMethod.isValid()) {
+        property.isValidMethod.invokeOnGadget(const_cast<void*>(propertyValue.constData()), Q_RETURN_ARG(bool, isValid));
+    }
+    return isValid || !property.optional;
+}
 
-                Q_ASSERT_X(false, this->metaObject()->className(), QString("Unregistered property type: %1").arg(propertyTypeName).toUtf8());
-                qCWarning(dcJsonRpc()) << "Cannot pack property of unregistered object type" << propertyTypeName;
-                continue;
+// Converts all the properties which don't refer to a registered type. Returns false if the property is to be left out.
+bool JsonHandler::packValue(const PackingPlan::Property &property, const QVariant &propertyValue, QVariant *packed)
+{
+    switch (property.kind) {
+    case PackingPlan::Property::KindPlain:
+        *packed = propertyValue;
+        return true;
+    case PackingPlan::Property::KindDateTime: {
+        uint timestamp = propertyValue.toDateTime().toTime_t();
+        if (property.optional && timestamp == 0) {
+            return false;
+        }
+        *packed = timestamp;
+        return true;
+    }
+    case PackingPlan::Property::KindTime:
+        *packed = propertyValue.toTime().toString("hh:mm");
+        return true;
+    case PackingPlan::Property::KindFlag: {
+        int flagValue = propertyValue.toInt();
+        QStringList flags;
+        for (int i = 0; i < property.flagKeys.count(); i++) {
+            if ((property.flagKeys.at(i).first & flagValue) > 0) {
+                flags.append(property.flagKeys.at(i).second);
             }
-
-            // Standard properties, QString, int etc...
-            // Special treatment for QDateTime (converting to time_t)
-            if (metaProperty.type() == QVariant::DateTime) {
-                QDateTime dateTime = propertyValue.toDateTime();
-                if (metaProperty.isUser() && dateTime.toTime_t() == 0) {
-                    continue;
-                }
-                propertyValue = propertyValue.toDateTime().toTime_t();
-            } else if (metaProperty.type() == QVariant::Time) {
-                propertyValue = propertyValue.toTime().toString("hh:mm");
+        }
+        *packed = flags;
+        return true;
+    }
+    case PackingPlan::Property::KindEnum:
+        *packed = property.enumKeys.value(propertyValue.toInt());
+        return true;
+    case PackingPlan::Property::KindBasicType:
+        *packed = property.enumKeys.value(variantTypeToBasicType(propertyValue.value<QVariant::Type>()));
+        return true;
+    case PackingPlan::Property::KindIntList:
+    case PackingPlan::Property::KindUuidList:
+    case PackingPlan::Property::KindIdList:
+    case PackingPlan::Property::KindDateTimeList:
+    case PackingPlan::Property::KindUnhandledList: {
+        QVariantList list;
+        if (property.kind == PackingPlan::Property::KindIntList) {
+            foreach (int entry, propertyValue.value<QList<int>>()) {
+                list << entry;
             }
-            ret.insert(metaProperty.name(), propertyValue);
+        } else if (property.kind == PackingPlan::Property::KindUuidList) {
+            foreach (const QUuid &entry, propertyValue.value<QList<QUuid>>()) {
+                list << entry;
+            }
+        } else if (property.kind == PackingPlan::Property::KindIdList) {
+            foreach (const EventTypeId &entry, propertyValue.value<QList<EventTypeId>>()) {
+                list << entry;
+            }
+        } else if (property.kind == PackingPlan::Property::KindDateTimeList) {
+            foreach (const QDateTime &timestamp, propertyValue.value<QList<QDateTime>>()) {
+                list << timestamp.toMSecsSinceEpoch() / 1000;
+            }
+        } else {
+            qCWarning(dcJsonRpc()) << "Cannot pack property of unhandled list type" << property.typeName;
         }
-        return ret;
+        if (list.isEmpty() && property.optional) {
+            return false;
+        }
+        *packed = list;
+        return true;
     }
+    case PackingPlan::Property::KindUnregistered:
+        qCWarning(dcJsonRpc()) << "Cannot pack property of unregistered object type" << property.typeName;
+        return false;
+    case PackingPlan::Property::KindList:
+    case PackingPlan::Property::KindObject:
+        break;
+    }
+    return false;
+}
 
-    Q_ASSERT_X(false, this->metaObject()->className(), QString("Unregistered object type: %1").arg(className).toUtf8());
-    qCWarning(dcJsonRpc()) << "Cannot pack object of unregistered type" << className;
-    return QVariant();    
+QVariant JsonHandler::pack(const QMetaObject &metaObject, const void *value) const
+{
+    const PackingPlan *plan = packingPlan(metaObject);
+    if (!plan) {
+        QString className = QString(metaObject.className()).split("::").last();
+        Q_ASSERT_X(false, this->metaObject()->className(), QString("Unregistered object type: %1").arg(className).toUtf8());
+        qCWarning(dcJsonRpc()) << "Cannot pack object of unregistered type" << className;
+        return QVariant();
+    }
+    return pack(*plan, value);
 }
 
 QVariant JsonHandler::unpack(const QMetaObject &metaObject, const QVariant &value) const
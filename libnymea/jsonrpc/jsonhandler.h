@@ -34,12 +34,15 @@
 #include <QObject>
 #include <QVariantMap>
 #include <QMetaMethod>
+#include <QSharedPointer>
+#include <QVector>
 #include <QDebug>
 #include <QVariant>
 #include <QDateTime>
 
 #include "jsonreply.h"
 #include "jsoncontext.h"
+#include "jsonwriter.h"
 
 class JsonHandler : public QObject
 {
@@ -74,6 +77,9 @@ public:
     QVariantMap jsonMethods() const;
     QVariantMap jsonNotifications() const;
 
+    // Whether any client has enabled notifications for this namespace. Maintained by the JSON-RPC server.
+    bool hasSubscribers() const;
+    void setSubscriberCount(int subscriberCount);
 
     template<typename T> static QString enumRef();
     template<typename T> static QString flagRef();
@@ -91,6 +97,8 @@ public:
 
     template<typename T> QVariant pack(const T &value) const;
     template<typename T> QVariant pack(T *value) const;
+    template<typename T> void pack(JsonWriter &writer, const T &value, const QVariantMap &overrides = QVariantMap()) const;
+    template<typename T> void pack(JsonWriter &writer, T *value, const QVariantMap &overrides = QVariantMap()) const;
     template <typename T> T unpack(const QVariant &value) const;
 
 protected:
@@ -115,10 +123,54 @@ protected:
     JsonReply *createAsyncReply(const QString &method) const;
 
 private:
+    // Everything pack() needs to know about a type, worked out once instead of on every packed object
+    struct PackingPlan {
+        struct Property {
+            enum Kind {
+                KindPlain,
+                KindDateTime,
+                KindTime,
+                KindFlag,
+                KindEnum,
+                KindBasicType,
+                KindList,
+                KindObject,
+                KindIntList,
+                KindUuidList,
+                KindIdList,
+                KindDateTimeList,
+                KindUnhandledList,
+                KindUnregistered
+            };
+            QMetaProperty metaProperty;
+            QString name;
+            Kind kind = KindPlain;
+            bool optional = false;
+            QString typeName;
+            QVector<QString> enumKeys;
+            QVector<QPair<int, QString> > flagKeys;
+            const PackingPlan *nested = nullptr;
+            QMetaMethod isValidMethod;
+        };
+
+        QString className;
+        bool isList = false;
+        QVector<Property> properties;
+        QMetaProperty countProperty;
+        QMetaMethod getMethod;
+        const PackingPlan *entryPlan = nullptr;
+    };
+
     void registerObject(const QMetaObject &metaObject);
     void registerObject(const QMetaObject &metaObject, const QMetaObject &listMetaObject);
 
+    const PackingPlan *packingPlan(const QMetaObject &metaObject) const;
+    QVariant pack(const PackingPlan &plan, const void *gadget) const;
     QVariant pack(const QMetaObject &metaObject, const void *gadget) const;
+    void pack(JsonWriter &writer, const PackingPlan &plan, const void *gadget, const QVariantMap &overrides) const;
+    void pack(JsonWriter &writer, const QMetaObject &metaObject, const void *gadget, const QVariantMap &overrides) const;
+    static bool isPackedObjectValid(const PackingPlan::Property &property, const QVariant &propertyValue);
+    static bool packValue(const PackingPlan::Property &property, const QVariant &propertyValue, QVariant *packed);
     QVariant unpack(const QMetaObject &metaObject, const QVariant &value) const;
 
 private:
@@ -131,8 +183,11 @@ private:
     QHash<QString, QMetaObject> m_metaObjects;
     QHash<QString, QMetaObject> m_listMetaObjects;
     QHash<QString, QString> m_listEntryTypes;
+    // Built on first use, keyed by the class name pointer which is the same for all copies of a static meta object
+    mutable QHash<const char*, QSharedPointer<PackingPlan> > m_packingPlans;
     QVariantMap m_methods;
     QVariantMap m_notifications;
+    int m_subscriberCount = 0;
 };
 Q_DECLARE_METATYPE(QVariant::Type)
 
@@ -146,6 +201,7 @@ void JsonHandler::registerEnum()
     }
     m_enums.insert(metaEnum.name(), values);
     m_metaEnums.insert(metaEnum.name(), metaEnum);
+    m_packingPlans.clear();
 }
 
 template<typename Enum, typename Flags>
@@ -157,6 +213,7 @@ void JsonHandler::registerFlag()
     m_metaFlags.insert(metaFlags.name(), metaFlags);
     m_flagsEnums.insert(metaFlags.name(), metaEnum.name());
     m_flags.insert(metaFlags.name(), QVariantList() << QString("$ref:%1").arg(metaEnum.name()));
+    m_packingPlans.clear();
 }
 
 template<typename ObjectType>
@@ -199,6 +256,7 @@ void JsonHandler::registerList(BasicTypeName typeName)
     QString listTypeName = QString(listMetaObject.className()).split("::").last();
     m_metaObjects.insert(listTypeName, listMetaObject);
     m_objects.insert(listTypeName, QVariantList() << QVariant(QString("$ref:%1").arg(enumValueName(typeName))));
+    m_packingPlans.clear();
     Q_ASSERT_X(listMetaObject.indexOfProperty("count") >= 0, "JsonHandler", QString("List type %1 does not implement \"count\" property!").arg(listTypeName).toUtf8());
     Q_ASSERT_X(listMetaObject.indexOfMethod("get(int)") >= 0, "JsonHandler", QString("List type %1 does not implement \"Q_INVOKABLE QVariant get(int index)\" method!").arg(listTypeName).toUtf8());
     Q_ASSERT_X(listMetaObject.indexOfMethod("put(QVariant)") >= 0, "JsonHandler", QString("List type %1 does not implement \"Q_INVOKABLE void put(QVariant variant)\" method!").arg(listTypeName).toUtf8());
@@ -283,6 +341,20 @@ QVariant JsonHandler::pack(T *value) const
     return pack(metaObject, static_cast<const void*>(value));
 }
 
+template<typename T>
+void JsonHandler::pack(JsonWriter &writer, const T &value, const QVariantMap &overrides) const
+{
+    QMetaObject metaObject = T::staticMetaObject;
+    pack(writer, metaObject, static_cast<const void*>(&value), overrides);
+}
+
+template<typename T>
+void JsonHandler::pack(JsonWriter &writer, T *value, const QVariantMap &overrides) const
+{
+    QMetaObject metaObject = T::staticMetaObject;
+    pack(writer, metaObject, static_cast<const void*>(value), overrides);
+}
+
 template<typename T>
 T JsonHandler::unpack(const QVariant &value) const
 {
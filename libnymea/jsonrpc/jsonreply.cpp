@@ -30,6 +30,9 @@
 
 #include "jsonreply.h"
 
+#include <QCoreApplication>
+#include <QThread>
+
 /*!
     \class JsonReply
     \brief This class represents a reply for the JSON-RPC API request.
@@ -57,6 +60,20 @@
 
 
 
+// Released synchronous replies, reused by createReply() in the main thread
+class JsonReplyPool
+{
+public:
+    ~JsonReplyPool() { qDeleteAll(replies); }
+    QList<JsonReply *> replies;
+};
+Q_GLOBAL_STATIC(JsonReplyPool, s_replyPool)
+
+static bool replyPoolAvailable()
+{
+    return QCoreApplication::instance() && QThread::currentThread() == QCoreApplication::instance()->thread();
+}
+
 /*! Constructs a new \l JsonReply with the given \a type, \a handler, \a method and \a data. */
 JsonReply::JsonReply(Type type, JsonHandler *handler, const QString &method, const QVariantMap &data):
     m_type(type),
@@ -65,12 +82,19 @@ JsonReply::JsonReply(Type type, JsonHandler *handler, const QString &method, con
     m_method(method),
     m_timedOut(false)
 {
-    connect(&m_timeout, &QTimer::timeout, this, &JsonReply::timeout);
 }
 
-/*! Returns the pointer to a new \l{JsonReply} for the given \a handler and \a data. */
+/*! Returns the pointer to a new \l{JsonReply} for the given \a handler and \a data. Replies handed back with
+    \l{release} are reused.
+*/
 JsonReply *JsonReply::createReply(JsonHandler *handler, const QVariantMap &data)
 {
+    if (replyPoolAvailable() && !s_replyPool->replies.isEmpty()) {
+        JsonReply *reply = s_replyPool->replies.takeLast();
+        reply->m_handler = handler;
+        reply->m_data = data;
+        return reply;
+    }
     return new JsonReply(TypeSync, handler, QString(), data);
 }
 
@@ -80,6 +104,23 @@ JsonReply *JsonReply::createAsyncReply(JsonHandler *handler, const QString &meth
     return new JsonReply(TypeAsync, handler, method);
 }
 
+/*! Disposes the given \a reply once it has been answered. Synchronous replies are kept for reuse
+    by \l{createReply}, asynchronous ones are deleted later.
+*/
+void JsonReply::release(JsonReply *reply)
+{
+    if (reply->m_type != TypeSync || !replyPoolAvailable() || s_replyPool->replies.count() >= 64) {
+        reply->deleteLater();
+        return;
+    }
+    reply->disconnect();
+    reply->m_data.clear();
+    reply->m_handler = nullptr;
+    reply->m_clientId = QUuid();
+    reply->m_commandId = 0;
+    s_replyPool->replies.append(reply);
+}
+
 /*! Returns the type of this \l{JsonReply}.*/
 JsonReply::Type JsonReply::type() const
 {
@@ -137,7 +178,12 @@ void JsonReply::setCommandId(int commandId)
 /*! Start the timeout timer for this \l{JsonReply}. The default timeout is 15 seconds. */
 void JsonReply::startWait()
 {
-    m_timeout.start(30000);
+    if (!m_timeout) {
+        m_timeout = new QTimer(this);
+        m_timeout->setSingleShot(true);
+        connect(m_timeout, &QTimer::timeout, this, &JsonReply::timeout);
+    }
+    m_timeout->start(30000);
 }
 
 void JsonReply::timeout()
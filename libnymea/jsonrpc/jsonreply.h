@@ -49,6 +49,7 @@ public:
 
     static JsonReply *createReply(JsonHandler *handler, const QVariantMap &data);
     static JsonReply *createAsyncReply(JsonHandler *handler, const QString &method);
+    static void release(JsonReply *reply);
 
     Type type() const;
     QVariantMap data() const;
@@ -85,7 +86,8 @@ private:
     int m_commandId;
     bool m_timedOut;
 
-    QTimer m_timeout;
+    // Only async replies wait, sync ones don't get a timer
+    QTimer *m_timeout = nullptr;
 
 };
 
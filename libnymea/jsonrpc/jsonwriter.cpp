@@ -0,0 +1,417 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class JsonWriter
+    \brief Writes compact JSON straight into a QByteArray.
+
+    \ingroup json
+    \inmodule core
+
+    Converting a reply with QJsonDocument::fromVariant() copies the whole variant tree into a
+    QJsonDocument before serializing it. The JsonWriter serializes the variants directly instead,
+    and handlers with large replies can write their objects token by token without building a
+    variant tree at all.
+
+    Parts of a reply which have been written already, or which are cached in serialized form, can
+    be put into a variant tree as \l{JsonFragment}. The writer copies them into the output as they
+    are.
+
+    \sa JsonHandler, JsonFragment
+*/
+
+/*!
+    \class JsonFragment
+    \brief Holds a piece of serialized JSON which is to be embedded into a reply.
+
+    \ingroup json
+    \inmodule core
+
+    \sa JsonWriter
+*/
+
+#include "jsonwriter.h"
+
+#include <QJsonDocument>
+#include <QJsonValue>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QLocale>
+
+#include <cmath>
+#include <limits>
+
+/*! Constructs a fragment holding the given serialized \a json value. */
+JsonFragment::JsonFragment(const QByteArray &json):
+    m_json(json)
+{
+
+}
+
+/*! Returns the serialized JSON of this fragment. */
+QByteArray JsonFragment::json() const
+{
+    return m_json;
+}
+
+/*! Returns true if this fragment does not hold any JSON. */
+bool JsonFragment::isNull() const
+{
+    return m_json.isEmpty();
+}
+
+/*! Parses the fragment back into a variant. This is slow and only meant for debugging and validation. */
+QVariant JsonFragment::toVariant() const
+{
+    // QJsonDocument only parses objects and arrays, wrap the fragment in case it is a plain value
+    QJsonDocument document = QJsonDocument::fromJson("[" + m_json + "]");
+    return document.array().first().toVariant();
+}
+
+/*! Constructs a writer appending to \a output. */
+JsonWriter::JsonWriter(QByteArray *output):
+    m_output(output)
+{
+
+}
+
+/*! Starts a new object. Entries are added by writing a key followed by its value. */
+void JsonWriter::beginObject()
+{
+    separate();
+    m_output->append('{');
+    m_empty.append(true);
+}
+
+/*! Closes the object started last. */
+void JsonWriter::endObject()
+{
+    m_empty.removeLast();
+    m_output->append('}');
+}
+
+/*! Starts a new array. */
+void JsonWriter::beginArray()
+{
+    separate();
+    m_output->append('[');
+    m_empty.append(true);
+}
+
+/*! Closes the array started last. */
+void JsonWriter::endArray()
+{
+    m_empty.removeLast();
+    m_output->append(']');
+}
+
+/*! Writes the \a key of the next entry in the current object. */
+void JsonWriter::writeKey(const QString &key)
+{
+    separate();
+    appendString(key);
+    m_output->append(':');
+    m_afterKey = true;
+}
+
+void JsonWriter::writeNull()
+{
+    separate();
+    m_output->append("null", 4);
+}
+
+void JsonWriter::writeBool(bool value)
+{
+    separate();
+    if (value) {
+        m_output->append("true", 4);
+    } else {
+        m_output->append("false", 5);
+    }
+}
+
+void JsonWriter::writeInteger(qint64 value)
+{
+    separate();
+    m_output->append(QByteArray::number(value));
+}
+
+void JsonWriter::writeUnsigned(quint64 value)
+{
+    separate();
+    m_output->append(QByteArray::number(value));
+}
+
+/*! Writes \a value, NaN and infinity are written as null like QJsonDocument does. */
+void JsonWriter::writeDouble(double value)
+{
+    separate();
+    if (!std::isfinite(value)) {
+        m_output->append("null", 4);
+        return;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5,7,0)
+    m_output->append(QByteArray::number(value, 'g', QLocale::FloatingPointShortest));
+#else
+    m_output->append(QByteArray::number(value, 'g', std::numeric_limits<double>::digits10 + 2));
+#endif
+}
+
+void JsonWriter::writeString(const QString &value)
+{
+    separate();
+    appendString(value);
+}
+
+void JsonWriter::separate()
+{
+    if (m_afterKey) {
+        m_afterKey = false;
+        return;
+    }
+    if (!m_empty.isEmpty()) {
+        if (!m_empty.last()) {
+            m_output->append(',');
+        }
+        m_empty.last() = false;
+    }
+}
+
+void JsonWriter::appendString(const QString &value)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    const QByteArray utf8 = value.toUtf8();
+    m_output->reserve(m_output->size() + utf8.size() + 2);
+    m_output->append('"');
+    const char *data = utf8.constData();
+    int start = 0;
+    for (int i = 0; i < utf8.size(); i++) {
+        const uchar c = static_cast<uchar>(data[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        // Copy the plain run in one go and escape the character which ended it
+        m_output->append(data + start, i - start);
+        start = i + 1;
+        switch (c) {
+        case '"': m_output->append("\\\"", 2); break;
+        case '\\': m_output->append("\\\\", 2); break;
+        case '\b': m_output->append("\\b", 2); break;
+        case '\f': m_output->append("\\f", 2); break;
+        case '\n': m_output->append("\\n", 2); break;
+        case '\r': m_output->append("\\r", 2); break;
+        case '\t': m_output->append("\\t", 2); break;
+        default: {
+            const char escaped[] = { '\\', 'u', '0', '0', hexDigits[c >> 4], hexDigits[c & 0xf] };
+            m_output->append(escaped, 6);
+            break;
+        }
+        }
+    }
+    m_output->append(data + start, utf8.size() - start);
+    m_output->append('"');
+}
+
+/*! Copies the serialized \a fragment into the output. A null fragment is written as null. */
+void JsonWriter::writeFragment(const JsonFragment &fragment)
+{
+    separate();
+    if (fragment.isNull()) {
+        m_output->append("null", 4);
+        return;
+    }
+    m_output->append(fragment.json());
+}
+
+/*! Copies the members of the serialized \a object into the object which is currently being
+    written, so cached parts of an object can be combined with members written on the fly.
+*/
+void JsonWriter::writeMembers(const JsonFragment &object)
+{
+    const QByteArray json = object.json();
+    // Nothing to copy for a null fragment or an empty object
+    if (json.size() <= 2) {
+        return;
+    }
+    separate();
+    m_output->append(json.constData() + 1, json.size() - 2);
+}
+
+/*! Writes \a value with the same mapping of types QJsonDocument::fromVariant() uses. Nested
+    maps and lists are written recursively, \l{JsonFragment}{JsonFragments} are copied as they are.
+*/
+void JsonWriter::writeValue(const QVariant &value)
+{
+    switch (static_cast<int>(value.type())) {
+    case QVariant::Map: {
+        beginObject();
+        const QVariantMap map = value.toMap();
+        for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+            writeKey(it.key());
+            writeValue(it.value());
+        }
+        endObject();
+        return;
+    }
+    case QVariant::Hash: {
+        beginObject();
+        const QVariantHash hash = value.toHash();
+        for (QVariantHash::const_iterator it = hash.constBegin(); it != hash.constEnd(); ++it) {
+            writeKey(it.key());
+            writeValue(it.value());
+        }
+        endObject();
+        return;
+    }
+    case QVariant::List: {
+        beginArray();
+        const QVariantList list = value.toList();
+        for (int i = 0; i < list.count(); i++) {
+            writeValue(list.at(i));
+        }
+        endArray();
+        return;
+    }
+    case QVariant::StringList: {
+        beginArray();
+        const QStringList list = value.toStringList();
+        for (int i = 0; i < list.count(); i++) {
+            writeString(list.at(i));
+        }
+        endArray();
+        return;
+    }
+    case QVariant::Invalid:
+        writeNull();
+        return;
+    case QVariant::Bool:
+        writeBool(value.toBool());
+        return;
+    case QVariant::Int:
+    case QVariant::LongLong:
+        writeInteger(value.toLongLong());
+        return;
+    case QVariant::UInt:
+    case QVariant::ULongLong:
+        writeUnsigned(value.toULongLong());
+        return;
+    case QVariant::Double:
+    case QMetaType::Float:
+        writeDouble(value.toDouble());
+        return;
+    case QVariant::String:
+        writeString(value.toString());
+        return;
+    default:
+        break;
+    }
+
+    if (value.userType() == qMetaTypeId<JsonFragment>()) {
+        writeFragment(value.value<JsonFragment>());
+        return;
+    }
+    writeJsonValue(QJsonValue::fromVariant(value));
+}
+
+/*! Serializes \a value into compact JSON. */
+QByteArray JsonWriter::toJson(const QVariant &value)
+{
+    QByteArray json;
+    JsonWriter writer(&json);
+    writer.writeValue(value);
+    return json;
+}
+
+/*! Returns a copy of \a value with all \l{JsonFragment}{JsonFragments} parsed back into variants,
+    for code which needs to look into a reply, like the API validation.
+*/
+QVariant JsonWriter::resolveFragments(const QVariant &value)
+{
+    switch (static_cast<int>(value.type())) {
+    case QVariant::Map: {
+        QVariantMap map = value.toMap();
+        for (QVariantMap::iterator it = map.begin(); it != map.end(); ++it) {
+            it.value() = resolveFragments(it.value());
+        }
+        return map;
+    }
+    case QVariant::List: {
+        QVariantList list = value.toList();
+        for (int i = 0; i < list.count(); i++) {
+            list[i] = resolveFragments(list.at(i));
+        }
+        return list;
+    }
+    default:
+        break;
+    }
+    if (value.userType() == qMetaTypeId<JsonFragment>()) {
+        return value.value<JsonFragment>().toVariant();
+    }
+    return value;
+}
+
+void JsonWriter::writeJsonValue(const QJsonValue &value)
+{
+    switch (value.type()) {
+    case QJsonValue::Null:
+    case QJsonValue::Undefined:
+        writeNull();
+        break;
+    case QJsonValue::Bool:
+        writeBool(value.toBool());
+        break;
+    case QJsonValue::Double:
+        writeDouble(value.toDouble());
+        break;
+    case QJsonValue::String:
+        writeString(value.toString());
+        break;
+    case QJsonValue::Array: {
+        beginArray();
+        const QJsonArray array = value.toArray();
+        for (int i = 0; i < array.count(); i++) {
+            writeJsonValue(array.at(i));
+        }
+        endArray();
+        break;
+    }
+    case QJsonValue::Object: {
+        beginObject();
+        const QJsonObject object = value.toObject();
+        for (QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it) {
+            writeKey(it.key());
+            writeJsonValue(it.value());
+        }
+        endObject();
+        break;
+    }
+    }
+}
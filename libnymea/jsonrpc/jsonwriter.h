@@ -0,0 +1,93 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <QByteArray>
+#include <QVariant>
+#include <QVector>
+#include <QMetaType>
+
+class QJsonValue;
+
+class JsonFragment
+{
+public:
+    JsonFragment() = default;
+    explicit JsonFragment(const QByteArray &json);
+
+    QByteArray json() const;
+    bool isNull() const;
+
+    QVariant toVariant() const;
+
+private:
+    QByteArray m_json;
+};
+Q_DECLARE_METATYPE(JsonFragment)
+
+class JsonWriter
+{
+public:
+    explicit JsonWriter(QByteArray *output);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    void writeKey(const QString &key);
+
+    void writeNull();
+    void writeBool(bool value);
+    void writeInteger(qint64 value);
+    void writeUnsigned(quint64 value);
+    void writeDouble(double value);
+    void writeString(const QString &value);
+    void writeFragment(const JsonFragment &fragment);
+    void writeMembers(const JsonFragment &object);
+    void writeValue(const QVariant &value);
+
+    static QByteArray toJson(const QVariant &value);
+    static QVariant resolveFragments(const QVariant &value);
+
+private:
+    void separate();
+    void appendString(const QString &value);
+    void writeJsonValue(const QJsonValue &value);
+
+    QByteArray *m_output = nullptr;
+    // One entry per open object or array, true as long as nothing has been written into it
+    QVector<bool> m_empty;
+    bool m_afterKey = false;
+};
+
+#endif // JSONWRITER_H
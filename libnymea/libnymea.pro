@@ -24,6 +24,7 @@ HEADERS += \
     integrations/browseritemresult.h \
     integrations/integrationplugin.h \
     integrations/ioconnection.h \
+    integrations/pluginaccessors.h \
     integrations/pluginmetadata.h \
     integrations/browseresult.h \
     integrations/thing.h \
@@ -34,11 +35,14 @@ HEADERS += \
     integrations/thingpairinginfo.h \
     integrations/thingsetupinfo.h \
     integrations/thingutils.h \
+    integrations/timeoutwheel.h \
+    integrations/nymeaasync.h \
     integrations/servicedata.h \
     jsonrpc/jsoncontext.h \
     jsonrpc/jsonhandler.h \
     jsonrpc/jsonreply.h \
     jsonrpc/jsonrpcserver.h \
+    jsonrpc/jsonwriter.h \
     libnymea.h \
     network/apikeys/apikey.h \
     network/apikeys/apikeysprovider.h \
@@ -52,6 +56,7 @@ HEADERS += \
     network/networkutils.h \
     network/ping.h \
     network/pingreply.h \
+    network/pingsweepreply.h \
     platform/package.h \
     platform/repository.h \
     types/browseritem.h \
@@ -64,9 +69,12 @@ HEADERS += \
     types/thingclass.h \
     typeutils.h \
     loggingcategories.h \
+    logsink.h \
     nymeasettings.h \
+    hardware/gpiochipline.h \
     hardware/pwm.h \
     hardware/radio433/radio433.h \
+    hardware/radio433/radio433receiver.h \
     network/upnp/upnpdiscovery.h \
     network/upnp/upnpdevice.h \
     network/upnp/upnpdevicedescriptor.h \
@@ -83,6 +91,7 @@ HEADERS += \
     hardware/i2c/i2cdevice.h \
     coap/coap.h \
     coap/coappdu.h \
+    coap/coappduview.h \
     coap/coapoption.h \
     coap/coaprequest.h \
     coap/coapreply.h \
@@ -90,10 +99,12 @@ HEADERS += \
     coap/corelinkparser.h \
     coap/corelink.h \
     coap/coapobserveresource.h \
+    coap/coaphardwareresource.h \
     types/action.h \
     types/actiontype.h \
     types/state.h \
     types/statetype.h \
+    types/statechangepolicy.h \
     types/eventtype.h \
     types/event.h \
     types/eventdescriptor.h \
@@ -113,6 +124,7 @@ HEADERS += \
     nymeadbusservice.h \
     network/mqtt/mqttprovider.h \
     network/mqtt/mqttchannel.h \
+    network/mqtt/mqtttopictrie.h \
     platform/platformsystemcontroller.h \
     platform/platformupdatecontroller.h \
     platform/platformzeroconfcontroller.h \
@@ -137,14 +149,20 @@ SOURCES += \
     integrations/thingpairinginfo.cpp \
     integrations/thingsetupinfo.cpp \
     integrations/thingutils.cpp \
+    integrations/timeoutwheel.cpp \
     integrations/servicedata.cpp \
     integrations/statevaluefilters/statevaluefilter.cpp \
     integrations/statevaluefilters/statevaluefilteradaptive.cpp \
+    integrations/statevaluefilters/statevaluefilterema.cpp \
+    integrations/statevaluefilters/statevaluefiltermedian.cpp \
+    integrations/statevaluefilters/statevaluefilterkalman.cpp \
     jsonrpc/jsoncontext.cpp \
     jsonrpc/jsonhandler.cpp \
     jsonrpc/jsonreply.cpp \
     jsonrpc/jsonrpcserver.cpp \
+    jsonrpc/jsonwriter.cpp \
     loggingcategories.cpp \
+    logsink.cpp \
     network/apikeys/apikey.cpp \
     network/apikeys/apikeysprovider.cpp \
     network/apikeys/apikeystorage.cpp \
@@ -157,11 +175,14 @@ SOURCES += \
     network/networkutils.cpp \
     network/ping.cpp \
     network/pingreply.cpp \
+    network/pingsweepreply.cpp \
     nymeasettings.cpp \
     platform/package.cpp \
     platform/repository.cpp \
+    hardware/gpiochipline.cpp \
     hardware/pwm.cpp \
     hardware/radio433/radio433.cpp \
+    hardware/radio433/radio433receiver.cpp \
     network/upnp/upnpdiscovery.cpp \
     network/upnp/upnpdevice.cpp \
     network/upnp/upnpdevicedescriptor.cpp \
@@ -178,6 +199,7 @@ SOURCES += \
     hardware/i2c/i2cdevice.cpp \
     coap/coap.cpp \
     coap/coappdu.cpp \
+    coap/coappduview.cpp \
     coap/coapoption.cpp \
     coap/coaprequest.cpp \
     coap/coapreply.cpp \
@@ -185,6 +207,7 @@ SOURCES += \
     coap/corelinkparser.cpp \
     coap/corelink.cpp \
     coap/coapobserveresource.cpp \
+    coap/coaphardwareresource.cpp \
     types/browseritem.cpp \
     types/browseritemaction.cpp \
     types/browseraction.cpp \
@@ -196,6 +219,7 @@ SOURCES += \
     types/actiontype.cpp \
     types/state.cpp \
     types/statetype.cpp \
+    types/statechangepolicy.cpp \
     types/eventtype.cpp \
     types/event.cpp \
     types/eventdescriptor.cpp \
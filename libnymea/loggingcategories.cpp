@@ -29,6 +29,8 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "loggingcategories.h"
+#include "logsink.h"
+
 #include <QFileInfo>
 #include <QDir>
 #include <QDateTime>
@@ -83,7 +85,8 @@ NYMEA_LOGGING_CATEGORY(dcI2C, "I2C")
 static QFile s_logFile;
 static bool s_useColors;
 static QList<QtMessageHandler> s_handlers;
-static QMutex s_loggerMutex;
+static QMutex s_loggerMutex(QMutex::Recursive);
+static LogSink *s_logSink = nullptr;
 
 static const char *const normal = "\033[0m";
 static const char *const warning = "\033[33m";
@@ -91,57 +94,83 @@ static const char *const error = "\033[31m";
 
 void nymeaInstallMessageHandler(QtMessageHandler handler)
 {
+    QMutexLocker locker(&s_loggerMutex);
     s_handlers.append(handler);
 }
 
 void nymeaUninstallMessageHandler(QtMessageHandler handler)
 {
+    QMutexLocker locker(&s_loggerMutex);
     s_handlers.removeAll(handler);
 }
 
-void nymeaLogMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+// Formats and writes a batch of records. Called on the log sink thread, or on the
+// posting thread for fatal messages and while the log sink is not running.
+static void writeLogRecords(const QVector<LogRecord> &records)
 {
-    // Copy message to all installed nymea handlers
-    foreach (QtMessageHandler handler, s_handlers) {
-        handler(type, context, message);
-    }
+    QMutexLocker locker(&s_loggerMutex);
+    QTextStream textStream(&s_logFile);
 
-    QString messageString;
-    QString timeString = QDateTime::currentDateTime().toString("yyyy.MM.dd hh:mm:ss.zzz");
-    switch (type) {
+    foreach (const LogRecord &record, records) {
+        // Copy message to all installed nymea handlers
+        QMessageLogContext context(nullptr, 0, nullptr, record.category);
+        foreach (QtMessageHandler handler, s_handlers) {
+            handler(record.type, context, record.message);
+        }
+
+        QString messageString;
+        QString timeString = QDateTime::fromMSecsSinceEpoch(record.timestamp).toString("yyyy.MM.dd hh:mm:ss.zzz");
+        QByteArray message = record.message.toUtf8();
+        switch (record.type) {
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 5, 0))
-    case QtInfoMsg:
-        messageString = QString(" I %1 | %2: %3").arg(timeString).arg(context.category).arg(message);
-        fprintf(stdout, " I | %s: %s\n", context.category, message.toUtf8().data());
-        break;
+        case QtInfoMsg:
+            messageString = QString(" I %1 | %2: %3").arg(timeString).arg(record.category).arg(record.message);
+            fprintf(stdout, " I | %s: %s\n", record.category, message.constData());
+            break;
 #endif
-    case QtDebugMsg:
-        messageString = QString(" I %1 | %2: %3").arg(timeString).arg(context.category).arg(message);
-        fprintf(stdout, " I | %s: %s\n", context.category, message.toUtf8().data());
-        break;
-    case QtWarningMsg:
-        messageString = QString(" W %1 | %2: %3").arg(timeString).arg(context.category).arg(message);
-        fprintf(stdout, "%s W | %s: %s%s\n", s_useColors ? warning : "", context.category, message.toUtf8().data(), s_useColors ? normal : "");
-        break;
-    case QtCriticalMsg:
-        messageString = QString(" C %1 | %2: %3").arg(timeString).arg(context.category).arg(message);
-        fprintf(stdout, "%s C | %s: %s%s\n", s_useColors ? error : "", context.category, message.toUtf8().data(), s_useColors ? error : "");
-        break;
-    case QtFatalMsg:
-        messageString = QString(" F %1 | %2: %3").arg(timeString).arg(context.category).arg(message);
-        fprintf(stdout, "%s F | %s: %s%s\n", s_useColors ? error : "", context.category, message.toUtf8().data(), s_useColors ? error: "");
-        break;
+        case QtDebugMsg:
+            messageString = QString(" I %1 | %2: %3").arg(timeString).arg(record.category).arg(record.message);
+            fprintf(stdout, " I | %s: %s\n", record.category, message.constData());
+            break;
+        case QtWarningMsg:
+            messageString = QString(" W %1 | %2: %3").arg(timeString).arg(record.category).arg(record.message);
+            fprintf(stdout, "%s W | %s: %s%s\n", s_useColors ? warning : "", record.category, message.constData(), s_useColors ? normal : "");
+            break;
+        case QtCriticalMsg:
+            messageString = QString(" C %1 | %2: %3").arg(timeString).arg(record.category).arg(record.message);
+            fprintf(stdout, "%s C | %s: %s%s\n", s_useColors ? error : "", record.category, message.constData(), s_useColors ? error : "");
+            break;
+        case QtFatalMsg:
+            messageString = QString(" F %1 | %2: %3").arg(timeString).arg(record.category).arg(record.message);
+            fprintf(stdout, "%s F | %s: %s%s\n", s_useColors ? error : "", record.category, message.constData(), s_useColors ? error: "");
+            break;
+        }
+
+        if (s_logFile.isOpen()) {
+            textStream << messageString << endl;
+        }
     }
     fflush(stdout);
+}
 
-    QMutexLocker locker(&s_loggerMutex);
-    if (s_logFile.isOpen()) {
-        QTextStream textStream(&s_logFile);
-        textStream << messageString << endl;
+void nymeaLogMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    // Fatal messages abort right after this handler returns. Write everything still
+    // queued and the message itself before that happens.
+    if (type == QtFatalMsg && s_logSink && QThread::currentThread() != s_logSink) {
+        s_logSink->stop();
     }
+
+    if (type != QtFatalMsg && s_logSink && s_logSink->post(type, context.category, message)) {
+        return;
+    }
+
+    QVector<LogRecord> records(1);
+    LogSink::fillRecord(&records[0], type, context.category, message);
+    writeLogRecords(records);
 }
 
-bool initLogging(const QString &fileName, bool useColors)
+bool initLogging(const QString &fileName, bool useColors, LogDropPolicy dropPolicy)
 {
     s_useColors = useColors;
 
@@ -160,11 +189,26 @@ bool initLogging(const QString &fileName, bool useColors)
             return false;
         }
     }
+
+    // The sink lives until the process exits, threads may still hold on to their buffers
+    if (!s_logSink) {
+        s_logSink = new LogSink(writeLogRecords);
+    }
+    s_logSink->setDropPolicy(dropPolicy);
+    if (!s_logSink->isRunning()) {
+        s_logSink->start(QThread::LowPriority);
+    }
     return true;
 }
 
 void closeLogFile()
 {
+    // Write out everything still queued, messages from now on are written synchronously
+    if (s_logSink) {
+        s_logSink->stop();
+    }
+
+    QMutexLocker locker(&s_loggerMutex);
     if (s_logFile.isOpen()) {
         s_logFile.close();
     }
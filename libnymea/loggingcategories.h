@@ -34,6 +34,8 @@
 #include <QLoggingCategory>
 #include <QDebug>
 
+#include "logsink.h"
+
 QStringList& nymeaLoggingCategories();
 
 #define NYMEA_LOGGING_CATEGORY(name, string) \
@@ -102,11 +104,26 @@ Q_DECLARE_LOGGING_CATEGORY(dcJsIntegrations)
   for the entire system (e.g. redirect to a different logging category, the Qt's
   mechanism of qInstallMessageHandler() is still available and will always be called
   *before* distributing the message to every nymea message handler.
+
+  Since API version 8.36, nymea message handlers are called on the log sink thread
+  (see initLogging()), not on the thread which logged the message. The
+  QMessageLogContext passed to them only carries the category, file, line and
+  function are not set. Handlers must be thread safe and must not rely on being
+  called on the thread of the logging object.
 */
 
 void nymeaInstallMessageHandler(QtMessageHandler handler);
 void nymeaUninstallMessageHandler(QtMessageHandler handler);
-bool initLogging(const QString &fileName, bool useColors);
+
+/*
+  Log messages are queued in per thread buffers and written to the console and the log file
+  on a background thread. The drop policy decides what happens if a thread logs faster than
+  the messages can be written, see LogDropPolicy in logsink.h.
+
+  Since API version 8.36 this takes the drop policy and starts the log sink thread.
+  Call closeLogFile() on shutdown to write everything still queued.
+*/
+bool initLogging(const QString &fileName, bool useColors, LogDropPolicy dropPolicy = LogDropPolicyDropNewest);
 void closeLogFile();
 
 #endif // LOGGINGCATEGORYS_H
@@ -0,0 +1,302 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class LogSink
+    \brief Collects log records from all threads and writes them on a background thread.
+
+    \ingroup logs
+    \inmodule libnymea
+
+    Every thread posting a message gets its own single producer, single consumer ring buffer, so
+    posting a record costs a copy of the message and two atomic operations and never takes a lock.
+    The sink thread periodically, or as soon as a buffer fills up to half of its capacity, collects
+    the records of all buffers, orders them by time and hands them to the \l{LogWriter} in one batch,
+    which keeps the formatting, console and file output off the calling threads.
+
+    If a thread produces messages faster than they can be written, the \l{LogDropPolicy} decides
+    whether new messages get dropped (the default) or whether the producing thread waits for the
+    sink to catch up. Dropped messages are reported in the log once the sink has caught up.
+*/
+
+#include "logsink.h"
+
+#include <QDateTime>
+
+#include <algorithm>
+
+static const quint32 s_bufferCapacity = 1024;
+static const int s_flushInterval = 50;
+
+class LogRingBuffer
+{
+public:
+    LogRingBuffer(): m_ref(2) { }
+
+    bool push(QtMsgType type, const char *category, const QString &message)
+    {
+        quint32 head = m_head.loadAcquire();
+        if (head - m_tail.loadAcquire() >= s_bufferCapacity) {
+            return false;
+        }
+        LogSink::fillRecord(&m_records[head % s_bufferCapacity], type, category, message);
+        m_head.storeRelease(head + 1);
+        return true;
+    }
+
+    bool pop(LogRecord *record)
+    {
+        quint32 tail = m_tail.loadAcquire();
+        if (tail == m_head.loadAcquire()) {
+            return false;
+        }
+        LogRecord &slot = m_records[tail % s_bufferCapacity];
+        *record = slot;
+        slot.message.clear();
+        m_tail.storeRelease(tail + 1);
+        return true;
+    }
+
+    quint32 size() const
+    {
+        return m_head.loadAcquire() - m_tail.loadAcquire();
+    }
+
+    // One reference is held by the producing thread, one by the sink
+    void deref()
+    {
+        if (!m_ref.deref()) {
+            delete this;
+        }
+    }
+
+    QAtomicInt m_orphaned;
+
+private:
+    QAtomicInt m_ref;
+    QAtomicInteger<quint32> m_head;
+    QAtomicInteger<quint32> m_tail;
+    LogRecord m_records[s_bufferCapacity];
+};
+
+namespace {
+
+struct ThreadBuffer
+{
+    quint64 sinkId = 0;
+    LogRingBuffer *buffer = nullptr;
+
+    ~ThreadBuffer()
+    {
+        if (buffer) {
+            buffer->m_orphaned.storeRelease(1);
+            buffer->deref();
+        }
+    }
+};
+
+}
+
+static thread_local ThreadBuffer s_threadBuffer;
+static QAtomicInteger<quint64> s_nextSinkId(1);
+
+/*! \enum LogDropPolicy
+    This enum describes what happens with a message posted from a thread whose buffer is full.
+    \value LogDropPolicyDropNewest
+        The message gets dropped and accounted for in the dropped messages report.
+    \value LogDropPolicyBlock
+        The posting thread waits until the sink has written enough messages. Messages posted
+        from the sink thread itself, i.e. from within a message handler, are dropped instead.
+*/
+
+/*! Constructs a new log sink handing all records to the given \a writer. */
+LogSink::LogSink(LogWriter writer, QObject *parent):
+    QThread(parent),
+    m_id(s_nextSinkId.fetchAndAddRelaxed(1)),
+    m_writer(writer),
+    m_dropPolicy(LogDropPolicyDropNewest)
+{
+    setObjectName("LogSink");
+    m_batch.reserve(s_bufferCapacity);
+}
+
+LogSink::~LogSink()
+{
+    stop();
+    foreach (LogRingBuffer *buffer, m_buffers) {
+        buffer->deref();
+    }
+}
+
+/*! Returns the policy used when a thread posts faster than its messages can be written. */
+LogDropPolicy LogSink::dropPolicy() const
+{
+    return static_cast<LogDropPolicy>(m_dropPolicy.loadAcquire());
+}
+
+/*! Sets the \a dropPolicy used when a thread posts faster than its messages can be written. */
+void LogSink::setDropPolicy(LogDropPolicy dropPolicy)
+{
+    m_dropPolicy.storeRelease(dropPolicy);
+}
+
+/*! Queues a message for writing on the sink thread. Returns false if the sink is not running,
+    in which case the caller is expected to write the message on its own. Messages dropped due
+    to the \l{LogDropPolicy} still count as handled and return true.
+*/
+bool LogSink::post(QtMsgType type, const char *category, const QString &message)
+{
+    // Announce the post before checking whether the sink accepts messages. stop() waits
+    // for all announced posts, so a record pushed after the check can't miss the final drain.
+    m_postsInFlight.ref();
+    if (!m_accepting.loadAcquire()) {
+        m_postsInFlight.deref();
+        return false;
+    }
+
+    LogRingBuffer *buffer = threadBuffer();
+    while (!buffer->push(type, category, message)) {
+        m_wakeCondition.wakeOne();
+        if (dropPolicy() == LogDropPolicyDropNewest || QThread::currentThread() == this || !m_accepting.loadAcquire()) {
+            m_droppedMessages.ref();
+            m_postsInFlight.deref();
+            return true;
+        }
+        QThread::yieldCurrentThread();
+    }
+
+    if (buffer->size() >= s_bufferCapacity / 2) {
+        m_wakeCondition.wakeOne();
+    }
+    m_postsInFlight.deref();
+    return true;
+}
+
+/*! Stops accepting messages, writes all queued records and waits for the sink thread to finish.
+    Posts which have already been accepted when this is called are waited for and written as well.
+*/
+void LogSink::stop()
+{
+    m_accepting.fetchAndStoreOrdered(0);
+    if (isRunning() && QThread::currentThread() != this) {
+        requestInterruption();
+        m_wakeCondition.wakeOne();
+        wait();
+    }
+
+    // A blocking post bails out as soon as it sees m_accepting cleared, so this can't stall
+    // for longer than a single push.
+    while (m_postsInFlight.loadAcquire() > 0) {
+        QThread::yieldCurrentThread();
+    }
+    drain();
+}
+
+/*! Fills the given \a record, truncating the \a category name if required. */
+void LogSink::fillRecord(LogRecord *record, QtMsgType type, const char *category, const QString &message)
+{
+    record->timestamp = QDateTime::currentMSecsSinceEpoch();
+    record->type = type;
+    qstrncpy(record->category, category ? category : "default", sizeof(record->category));
+    record->message = message;
+}
+
+void LogSink::run()
+{
+    m_accepting.storeRelease(1);
+    while (!isInterruptionRequested()) {
+        m_wakeMutex.lock();
+        m_wakeCondition.wait(&m_wakeMutex, s_flushInterval);
+        m_wakeMutex.unlock();
+        while (drain()) { }
+    }
+}
+
+LogRingBuffer *LogSink::threadBuffer()
+{
+    // A sink created at the address of a destroyed one must not pick up the buffer of the old one
+    if (s_threadBuffer.sinkId == m_id) {
+        return s_threadBuffer.buffer;
+    }
+
+    if (s_threadBuffer.buffer) {
+        s_threadBuffer.buffer->m_orphaned.storeRelease(1);
+        s_threadBuffer.buffer->deref();
+    }
+    s_threadBuffer.sinkId = m_id;
+    s_threadBuffer.buffer = new LogRingBuffer();
+
+    QMutexLocker locker(&m_buffersMutex);
+    m_buffers.append(s_threadBuffer.buffer);
+    return s_threadBuffer.buffer;
+}
+
+// Writes everything queued so far in one batch, returns true if anything has been written
+bool LogSink::drain()
+{
+    QList<LogRingBuffer *> buffers;
+    m_buffersMutex.lock();
+    buffers = m_buffers;
+    m_buffersMutex.unlock();
+
+    m_batch.clear();
+    foreach (LogRingBuffer *buffer, buffers) {
+        // A buffer flagged as orphaned won't receive any more records. Check before draining
+        // so nothing that has been posted in between gets lost.
+        bool orphaned = buffer->m_orphaned.loadAcquire();
+        LogRecord record;
+        while (buffer->pop(&record)) {
+            m_batch.append(record);
+        }
+        if (orphaned) {
+            QMutexLocker locker(&m_buffersMutex);
+            m_buffers.removeAll(buffer);
+            buffer->deref();
+        }
+    }
+
+    int droppedMessages = m_droppedMessages.fetchAndStoreOrdered(0);
+    if (droppedMessages > 0) {
+        LogRecord record;
+        fillRecord(&record, QtWarningMsg, "default", QString("Log buffer overrun, dropped %1 messages").arg(droppedMessages));
+        m_batch.append(record);
+    }
+
+    if (m_batch.isEmpty()) {
+        return false;
+    }
+
+    std::stable_sort(m_batch.begin(), m_batch.end(), [](const LogRecord &a, const LogRecord &b) {
+        return a.timestamp < b.timestamp;
+    });
+    m_writer(m_batch);
+    m_batch.clear();
+    return true;
+}
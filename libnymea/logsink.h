@@ -0,0 +1,98 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef LOGSINK_H
+#define LOGSINK_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <QList>
+#include <QAtomicInt>
+
+class LogRingBuffer;
+
+enum LogDropPolicy {
+    LogDropPolicyDropNewest,
+    LogDropPolicyBlock
+};
+
+struct LogRecord
+{
+    qint64 timestamp = 0;
+    QtMsgType type = QtDebugMsg;
+    char category[64] = {0};
+    QString message;
+};
+
+class LogSink : public QThread
+{
+    Q_OBJECT
+
+public:
+    typedef void (*LogWriter)(const QVector<LogRecord> &records);
+
+    explicit LogSink(LogWriter writer, QObject *parent = nullptr);
+    ~LogSink() override;
+
+    LogDropPolicy dropPolicy() const;
+    void setDropPolicy(LogDropPolicy dropPolicy);
+
+    bool post(QtMsgType type, const char *category, const QString &message);
+    void stop();
+
+    static void fillRecord(LogRecord *record, QtMsgType type, const char *category, const QString &message);
+
+protected:
+    void run() override;
+
+private:
+    LogRingBuffer *threadBuffer();
+    bool drain();
+
+    // Identifies the sink in the per-thread buffer cache, unlike its address it's never reused
+    quint64 m_id = 0;
+    LogWriter m_writer = nullptr;
+    QAtomicInt m_dropPolicy;
+    QAtomicInt m_accepting;
+    QAtomicInt m_postsInFlight;
+    QAtomicInt m_droppedMessages;
+
+    QMutex m_buffersMutex;
+    QList<LogRingBuffer *> m_buffers;
+
+    QMutex m_wakeMutex;
+    QWaitCondition m_wakeCondition;
+
+    QVector<LogRecord> m_batch;
+};
+
+#endif // LOGSINK_H
@@ -8,6 +8,15 @@ ApiKey::ApiKey()
 
 }
 
+/*!
+ * \brief ApiKey::keys
+ * \return Returns the names of all the properties of this api key.
+ */
+QStringList ApiKey::keys() const
+{
+    return m_data.keys();
+}
+
 /*!
  * \brief ApiKey::data
  * \param key
@@ -3,6 +3,7 @@
 
 #include <QString>
 #include <QHash>
+#include <QStringList>
 
 #include <QLoggingCategory>
 Q_DECLARE_LOGGING_CATEGORY(dcApiKeys)
@@ -12,6 +13,7 @@ class ApiKey
 public:
     ApiKey();
 
+    QStringList keys() const;
     QByteArray data(const QString &key) const;
     void insert(const QString &key, const QByteArray &data);
 
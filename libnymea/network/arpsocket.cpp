@@ -232,8 +232,11 @@ bool ArpSocket::openSocket()
             char receiveBuffer[ETHER_ARP_PACKET_LEN];
             memset(&receiveBuffer, 0, sizeof(receiveBuffer));
 
-            // Read the buffer
-            int bytesReceived = recv(m_socketDescriptor, receiveBuffer, ETHER_ARP_PACKET_LEN, 0);
+            // Read the buffer, the link layer address tells us the receiving interface
+            struct sockaddr_ll linkLayerAddress;
+            socklen_t linkLayerAddressLength = sizeof(linkLayerAddress);
+            memset(&linkLayerAddress, 0, sizeof(linkLayerAddress));
+            int bytesReceived = recvfrom(m_socketDescriptor, receiveBuffer, ETHER_ARP_PACKET_LEN, 0, (struct sockaddr *)&linkLayerAddress, &linkLayerAddressLength);
             if (bytesReceived < 0) {
                 // Finished reading
                 return;
@@ -249,22 +252,39 @@ bool ArpSocket::openSocket()
             uint16_t etherType = htons(etherHeader->ether_type);
             if (etherType != ETHERTYPE_ARP) {
                 qCWarning(dcArpSocketTraffic()) << "Received ARP socket data header with invalid type" << etherType;
-                return;
+                continue;
             }
 
             // Filter for ARP replies
             uint16_t arpOperationCode = htons(arpPacket->arp_op);
             switch (arpOperationCode) {
-            case ARPOP_REQUEST:
-                //qCDebug(dcArpSocket()) << "ARP request from " << senderMacAddress << senderHostAddress.toString() << "-->" << targetMacAddress << targetHostAddress.toString();
+            case ARPOP_REQUEST: {
+                // The sender of a request is alive as well. ARP probes have no sender address yet.
+                if (senderHostAddress.isNull() || senderHostAddress.toIPv4Address() == 0)
+                    break;
+
+                QNetworkInterface networkInterface = QNetworkInterface::interfaceFromIndex(linkLayerAddress.sll_ifindex);
+                if (!networkInterface.isValid() || networkInterface.hardwareAddress().toLower() == senderMacAddress.toLower())
+                    break;
+
+                qCDebug(dcArpSocketTraffic()) << "ARP request from" << senderMacAddress << senderHostAddress.toString() << "-->" << targetMacAddress << targetHostAddress.toString();
+                emit arpRequest(networkInterface, senderHostAddress, senderMacAddress.toLower());
                 break;
+            }
             case ARPOP_REPLY: {
+                // Replies not addressed to us are gratuitous announcements, e.g. after a host changed its address
                 QNetworkInterface networkInterface = NetworkUtils::getInterfaceForMacAddress(targetMacAddress);
+                if (!networkInterface.isValid())
+                    networkInterface = QNetworkInterface::interfaceFromIndex(linkLayerAddress.sll_ifindex);
+
                 if (!networkInterface.isValid()) {
                     qCWarning(dcArpSocket()) << "Could not find interface from ARP response" << targetHostAddress.toString() << targetMacAddress;
-                    return;
+                    break;
                 }
 
+                if (senderHostAddress.isNull() || senderHostAddress.toIPv4Address() == 0)
+                    break;
+
                 qCDebug(dcArpSocketTraffic()) << "ARP response from" << senderMacAddress << senderHostAddress.toString() << "on" << networkInterface.name();
                 emit arpResponse(networkInterface, senderHostAddress, senderMacAddress.toLower());
                 break;
@@ -65,6 +65,7 @@ public:
 
 signals:
     void arpResponse(const QNetworkInterface &networkInterface, const QHostAddress &address, const QString &macAddress);
+    void arpRequest(const QNetworkInterface &networkInterface, const QHostAddress &address, const QString &macAddress);
 
 private:
     QSocketNotifier *m_socketNotifier = nullptr;
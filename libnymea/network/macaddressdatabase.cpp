@@ -39,6 +39,8 @@
 #include <QStandardPaths>
 #include <QtConcurrent/QtConcurrent>
 
+#include <algorithm>
+
 NYMEA_LOGGING_CATEGORY(dcMacAddressDatabase, "MacAddressDatabase")
 
 MacAddressDatabase::MacAddressDatabase(QObject *parent) : QObject(parent)
@@ -66,8 +68,8 @@ MacAddressDatabase::MacAddressDatabase(QObject *parent) : QObject(parent)
 
     m_available = initDatabase();
     if (m_available) {
-        m_futureWatcher = new QFutureWatcher<QString>(this);
-        connect(m_futureWatcher, &QFutureWatcher<QString>::finished, this, &MacAddressDatabase::onLookupFinished);
+        m_futureWatcher = new QFutureWatcher<OuiTable>(this);
+        connect(m_futureWatcher, &QFutureWatcher<OuiTable>::finished, this, &MacAddressDatabase::onLoadingFinished);
     }
 }
 
@@ -77,13 +79,17 @@ MacAddressDatabase::MacAddressDatabase(const QString &databaseName, QObject *par
 {
     m_available = initDatabase();
     if (m_available) {
-        m_futureWatcher = new QFutureWatcher<QString>(this);
-        connect(m_futureWatcher, &QFutureWatcher<QString>::finished, this, &MacAddressDatabase::onLookupFinished);
+        m_futureWatcher = new QFutureWatcher<OuiTable>(this);
+        connect(m_futureWatcher, &QFutureWatcher<OuiTable>::finished, this, &MacAddressDatabase::onLoadingFinished);
     }
 }
 
 MacAddressDatabase::~MacAddressDatabase()
 {
+    if (m_futureWatcher) {
+        m_futureWatcher->waitForFinished();
+    }
+
     m_db.close();
     m_db = QSqlDatabase();
     QSqlDatabase::removeDatabase(m_connectionName);
@@ -105,8 +111,24 @@ MacAddressDatabaseReply *MacAddressDatabase::lookupMacAddress(const QString &mac
         return reply;
     }
 
+    reply->m_startTimestamp = QDateTime::currentMSecsSinceEpoch();
     m_pendingReplies.enqueue(reply);
-    runNextLookup();
+
+    // Load the table on first use, the lookups waiting for it get resolved in one go
+    if (!m_loaded) {
+        if (!m_futureWatcher->isRunning()) {
+            qCDebug(dcMacAddressDatabase()) << "Loading the OUI table from" << m_databaseName;
+            m_loadStartTimestamp = QDateTime::currentMSecsSinceEpoch();
+            m_futureWatcher->setFuture(QtConcurrent::run(&MacAddressDatabase::loadOuiTable, m_databaseName));
+        }
+        return reply;
+    }
+
+    // Resolve all lookups of this event loop iteration at once
+    if (!m_resolveScheduled) {
+        m_resolveScheduled = true;
+        QTimer::singleShot(0, this, &MacAddressDatabase::resolvePendingReplies);
+    }
     return reply;
 }
 
@@ -143,81 +165,107 @@ bool MacAddressDatabase::initDatabase()
     return true;
 }
 
-void MacAddressDatabase::runNextLookup()
+void MacAddressDatabase::resolvePendingReplies()
 {
-    if (m_pendingReplies.isEmpty())
-        return;
-
-    if (m_futureWatcher->isRunning() || m_currentReply)
-        return;
-
-    m_currentReply = m_pendingReplies.dequeue();
-    m_currentReply->m_startTimestamp = QDateTime::currentMSecsSinceEpoch();
-    QFuture<QString> future = QtConcurrent::run(this, &MacAddressDatabase::lookupMacAddressVendorInternal, m_currentReply->macAddress());
-    m_futureWatcher->setFuture(future);
+    m_resolveScheduled = false;
+    while (!m_pendingReplies.isEmpty()) {
+        MacAddressDatabaseReply *reply = m_pendingReplies.dequeue();
+        reply->m_manufacturer = lookupManufacturer(reply->macAddress());
+        qCDebug(dcMacAddressDatabase()) << "Manufacturer lookup for" << reply->macAddress() << "finished:" << reply->manufacturer() << QDateTime::currentMSecsSinceEpoch() - reply->m_startTimestamp << "ms";
+        emit reply->finished();
+    }
 }
 
-void MacAddressDatabase::onLookupFinished()
+QString MacAddressDatabase::lookupManufacturer(const QString &macAddress) const
 {
-    if (m_currentReply) {
-        QString manufacturer = m_futureWatcher->future().result();
-        qCDebug(dcMacAddressDatabase()) << "Manufacturer lookup for" << m_currentReply->macAddress() << "finished:" << manufacturer << QDateTime::currentMSecsSinceEpoch() - m_currentReply->m_startTimestamp << "ms";
-        m_currentReply->m_manufacturer = manufacturer;
-        emit m_currentReply->finished();
-        m_currentReply = nullptr;
+    // The database contains upper case hex prefixes without the separators
+    QString macAddressString = QString(macAddress).remove(':').remove('-');
+    if (macAddressString.length() != 12)
+        return QString();
+
+    bool valid = false;
+    quint64 address = macAddressString.toULongLong(&valid, 16);
+    if (!valid)
+        return QString();
+
+    // The longest matching prefix wins, i.e. a 36 bit block within a 24 bit block
+    QMapIterator<int, QVector<OuiEntry>> iterator(m_ouiTable.entries);
+    iterator.toBack();
+    while (iterator.hasPrevious()) {
+        iterator.previous();
+        OuiEntry searchEntry;
+        searchEntry.prefix = address >> (4 * (12 - iterator.key()));
+        const QVector<OuiEntry> &entries = iterator.value();
+        QVector<OuiEntry>::const_iterator entry = std::lower_bound(entries.constBegin(), entries.constEnd(), searchEntry);
+        if (entry != entries.constEnd() && entry->prefix == searchEntry.prefix) {
+            return m_ouiTable.companyNames.value(static_cast<int>(entry->companyNameIndex));
+        }
     }
 
-    runNextLookup();
+    return QString();
 }
 
-QString MacAddressDatabase::lookupMacAddressVendorInternal(const QString &macAddress)
+MacAddressDatabase::OuiTable MacAddressDatabase::loadOuiTable(const QString &databaseName)
 {
-    qCDebug(dcMacAddressDatabase()) << "Start looking up vendor for" << macAddress;
-    // Convert the mac address string to upper like in the database and remove : since they have been removed for size reasons
-    QString fullMacAddressString = QString(macAddress).toUpper().remove(":");
-
-    QString manufacturer;
-    int length = 6;
-    while (true) {
-        QString searchString = fullMacAddressString.left(length);
-        QString queryString = QString("SELECT COUNT(oui) FROM oui WHERE oui LIKE \'%1%\';").arg(searchString);
-        qCDebug(dcMacAddressDatabase()) << "Query:" << queryString;
-        QSqlQuery countQuery = m_db.exec(queryString);
-        if (countQuery.lastError().isValid()) {
-            qCWarning(dcMacAddressDatabase()) << "Query finished with error" << countQuery.lastError().text();
-            break;
-        }
-
-        if (!countQuery.next())
-            break;
-
-        int rowCount = countQuery.value(0).toInt();
-        qCDebug(dcMacAddressDatabase()) << "Found" << rowCount << "with" << searchString;
-        // If we have found the one...
-        if (rowCount == 1) {
-            // Query the name
-            queryString = QString("SELECT companyName from companyNames WHERE rowid IS (SELECT companyNameIndex FROM oui WHERE oui=\'%1\');").arg(searchString);
-            qCDebug(dcMacAddressDatabase()) << "Query:" << queryString;
-            countQuery = m_db.exec(queryString);
-            if (!countQuery.next())
-                break;
-
-            manufacturer = countQuery.value(0).toString();
-            break;
+    OuiTable ouiTable;
+
+    // Use an own connection, database connections can only be used in the thread which created them
+    QString connectionName = QFileInfo(databaseName).baseName() + "-loader";
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionName);
+        db.setDatabaseName(databaseName);
+        if (!db.open()) {
+            qCWarning(dcMacAddressDatabase()) << "Could not open database" << databaseName << "for loading the OUI table.";
+        } else {
+            QSqlQuery companyNamesQuery = db.exec("SELECT rowid, companyName FROM companyNames;");
+            if (companyNamesQuery.lastError().isValid()) {
+                qCWarning(dcMacAddressDatabase()) << "Loading the company names finished with error" << companyNamesQuery.lastError().text();
+            }
+            while (companyNamesQuery.next()) {
+                int index = companyNamesQuery.value(0).toInt();
+                if (index < 0)
+                    continue;
+
+                if (index >= ouiTable.companyNames.count())
+                    ouiTable.companyNames.resize(index + 1);
+
+                ouiTable.companyNames[index] = companyNamesQuery.value(1).toString();
+            }
+
+            QSqlQuery ouiQuery = db.exec("SELECT oui, companyNameIndex FROM oui;");
+            if (ouiQuery.lastError().isValid()) {
+                qCWarning(dcMacAddressDatabase()) << "Loading the OUI prefixes finished with error" << ouiQuery.lastError().text();
+            }
+            while (ouiQuery.next()) {
+                QString oui = ouiQuery.value(0).toString();
+                bool valid = false;
+                OuiEntry entry;
+                entry.prefix = oui.toULongLong(&valid, 16);
+                entry.companyNameIndex = ouiQuery.value(1).toUInt();
+                if (!valid || oui.length() > 12)
+                    continue;
+
+                ouiTable.entries[oui.length()].append(entry);
+                ouiTable.count++;
+            }
+
+            db.close();
         }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
 
-        // If nothing found
-        if (rowCount == 0)
-            break;
-
-        // Found to many results, lets add a value until we find the matching vendor
-        length += 1;
-        if (length > fullMacAddressString.length())
-            break;
-
-        // Search with one addition digit
+    for (QMap<int, QVector<OuiEntry>>::iterator it = ouiTable.entries.begin(); it != ouiTable.entries.end(); ++it) {
+        std::sort(it.value().begin(), it.value().end());
+        it.value().squeeze();
     }
 
-    return manufacturer;
+    return ouiTable;
 }
 
+void MacAddressDatabase::onLoadingFinished()
+{
+    m_ouiTable = m_futureWatcher->future().result();
+    m_loaded = true;
+    qCDebug(dcMacAddressDatabase()) << "Loaded" << m_ouiTable.count << "OUI prefixes of" << m_ouiTable.companyNames.count() << "companies in" << QDateTime::currentMSecsSinceEpoch() - m_loadStartTimestamp << "ms";
+    resolvePendingReplies();
+}
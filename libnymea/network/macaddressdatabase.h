@@ -31,7 +31,9 @@
 #ifndef MACADDRESSDATABASE_H
 #define MACADDRESSDATABASE_H
 
+#include <QMap>
 #include <QQueue>
+#include <QVector>
 #include <QObject>
 #include <QSqlDatabase>
 #include <QFutureWatcher>
@@ -72,21 +74,39 @@ public:
     MacAddressDatabaseReply *lookupMacAddress(const QString &macAddress);
 
 private:
+    // The OUI table is held in memory, one sorted prefix list per prefix length (24, 28 and 36 bit)
+    struct OuiEntry {
+        quint64 prefix;
+        quint32 companyNameIndex;
+        bool operator<(const OuiEntry &other) const { return prefix < other.prefix; }
+    };
+
+    struct OuiTable {
+        QMap<int, QVector<OuiEntry>> entries;
+        QVector<QString> companyNames;
+        int count = 0;
+    };
+
     QSqlDatabase m_db;
     bool m_available = false;
     QString m_connectionName;
     QString m_databaseName = "/usr/share/nymea/mac-addresses.db";
 
-    MacAddressDatabaseReply *m_currentReply = nullptr;
-    QFutureWatcher<QString> *m_futureWatcher = nullptr;
+    OuiTable m_ouiTable;
+    bool m_loaded = false;
+    bool m_resolveScheduled = false;
+    qint64 m_loadStartTimestamp = 0;
+    QFutureWatcher<OuiTable> *m_futureWatcher = nullptr;
     QQueue<MacAddressDatabaseReply *> m_pendingReplies;
 
     bool initDatabase();
-    void runNextLookup();
+    void resolvePendingReplies();
+    QString lookupManufacturer(const QString &macAddress) const;
+
+    static OuiTable loadOuiTable(const QString &databaseName);
 
 private slots:
-    void onLookupFinished();
-    QString lookupMacAddressVendorInternal(const QString &macAddress);
+    void onLoadingFinished();
 
 };
 
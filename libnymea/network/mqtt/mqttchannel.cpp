@@ -74,6 +74,43 @@
     as publishing to "topicPrefix/..."
 */
 
+/*! \fn void MqttChannel::publish(const QString &topic, const QByteArray &payload);
+    Publishes the \a payload on the given \a topic. The topic must be within the topic prefixes of this channel.
+*/
+
+/*! \fn void MqttChannel::publish(const QList<QPair<QString, QByteArray> > &messages, bool retain = false);
+    Publishes all the given \a messages (topic and payload pairs) in one batch. Use this when publishing many
+    messages at once, for example when mirroring states to MQTT. If \a retain is true the broker keeps the last
+    payload of each topic and hands it to subscribers when they subscribe later. Consecutive retained messages for
+    the same topic which have not been sent yet are merged. An empty retained payload clears the retained message.
+    Messages outside of the topic prefixes of this channel are discarded.
+*/
+
+/*! \fn bool MqttChannel::addTopicFilter(const QString &topicFilter);
+    Registers the given \a topicFilter for this channel. Whenever any client publishes a message with a topic
+    matching the filter, \l{topicFilterMatched()} will be emitted with the registered filter, so plugins don't need to
+    match topics themselves. Retained messages matching the filter are delivered right after registering it.
+    The filter must be within the topic prefixes of this channel.
+    Returns false if the filter is invalid or not allowed for this channel.
+
+    \sa removeTopicFilter(), topicFilters()
+*/
+
+/*! \fn void MqttChannel::removeTopicFilter(const QString &topicFilter);
+    Removes the given \a topicFilter registered with \l{addTopicFilter()}.
+*/
+
+/*! \fn QStringList MqttChannel::topicFilters() const;
+    Returns the topic filters registered for this channel.
+*/
+
+/*! \fn void MqttChannel::topicFilterMatched(MqttChannel* channel, const QString &topicFilter, const QString &topic, const QByteArray &payload);
+    This signal is emitted for each of the registered topic filters of the \a channel matching a published message.
+    The \a topicFilter is the registered filter, \a topic and \a payload are the ones of the published message.
+
+    \sa addTopicFilter()
+*/
+
 #include "mqttchannel.h"
 
 
@@ -51,11 +51,17 @@ public:
     virtual QStringList topicPrefixList() const = 0;
 
     virtual void publish(const QString &topic, const QByteArray &payload) = 0;
+    virtual void publish(const QList<QPair<QString, QByteArray> > &messages, bool retain = false) = 0;
+
+    virtual bool addTopicFilter(const QString &topicFilter) = 0;
+    virtual void removeTopicFilter(const QString &topicFilter) = 0;
+    virtual QStringList topicFilters() const = 0;
 
 signals:
     void clientConnected(MqttChannel* channel);
     void clientDisconnected(MqttChannel* channel);
     void publishReceived(MqttChannel* channel, const QString &topic, const QByteArray &payload);
+    void topicFilterMatched(MqttChannel* channel, const QString &topicFilter, const QString &topic, const QByteArray &payload);
 };
 
 #endif // MQTTCHANNEL_H
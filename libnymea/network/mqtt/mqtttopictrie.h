@@ -0,0 +1,198 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MQTTTOPICTRIE_H
+#define MQTTTOPICTRIE_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+/*! \class MqttTopicTrie
+    \brief A trie of MQTT topic filters for matching topics in O(topic depth).
+
+    \ingroup hardware
+    \inmodule libnymea
+
+    The MqttTopicTrie stores values for MQTT topic filters and returns the values of all filters
+    matching a given topic according to the MQTT 3.1.1 wildcard rules: "+" matches exactly one
+    topic level, "#" matches the parent level and any number of child levels and topics starting
+    with "$" are not matched by wildcards in the first level.
+
+    The same value may be inserted for several filters. Values are compared using operator==.
+*/
+template <typename T>
+class MqttTopicTrie
+{
+public:
+    MqttTopicTrie() = default;
+    ~MqttTopicTrie() { clear(); }
+
+    MqttTopicTrie(const MqttTopicTrie &other) = delete;
+    MqttTopicTrie &operator=(const MqttTopicTrie &other) = delete;
+
+    /*! Returns true if the given \a topicFilter is a valid MQTT topic filter. */
+    static bool isValidTopicFilter(const QString &topicFilter)
+    {
+        if (topicFilter.isEmpty())
+            return false;
+
+        QStringList levels = topicFilter.split('/');
+        for (int i = 0; i < levels.count(); i++) {
+            const QString &level = levels.at(i);
+            if (level == "#" && i != levels.count() - 1)
+                return false;
+
+            if (level.length() > 1 && (level.contains('#') || level.contains('+')))
+                return false;
+        }
+        return true;
+    }
+
+    /*! Inserts the \a value for the given \a topicFilter. Returns false if the filter is invalid. */
+    bool insert(const QString &topicFilter, const T &value)
+    {
+        if (!isValidTopicFilter(topicFilter))
+            return false;
+
+        Node *node = &m_root;
+        foreach (const QString &level, topicFilter.split('/')) {
+            Node *child = node->children.value(level);
+            if (!child) {
+                child = new Node;
+                node->children.insert(level, child);
+            }
+            node = child;
+        }
+        if (!node->values.contains(value))
+            node->values.append(value);
+
+        return true;
+    }
+
+    /*! Removes the \a value inserted for the given \a topicFilter. Returns true if the value was found. */
+    bool remove(const QString &topicFilter, const T &value)
+    {
+        return removeValue(&m_root, topicFilter.split('/'), 0, value);
+    }
+
+    /*! Removes all filters and values. */
+    void clear()
+    {
+        deleteChildren(&m_root);
+        m_root.values.clear();
+    }
+
+    bool isEmpty() const
+    {
+        return m_root.children.isEmpty() && m_root.values.isEmpty();
+    }
+
+    /*! Returns the values of all topic filters matching the given \a topic. A value inserted for
+        several matching filters is returned once for each of them.
+    */
+    QList<T> match(const QString &topic) const
+    {
+        QList<T> result;
+        QStringList levels = topic.split('/');
+        collect(&m_root, levels, 0, &result);
+        return result;
+    }
+
+    /*! Returns true if the given \a topic is matched by any topic filter inserted with \a value. */
+    bool matches(const QString &topic, const T &value) const
+    {
+        return match(topic).contains(value);
+    }
+
+private:
+    struct Node {
+        QHash<QString, Node *> children;
+        QList<T> values;
+    };
+
+    Node m_root;
+
+    static void deleteChildren(Node *node)
+    {
+        foreach (Node *child, node->children) {
+            deleteChildren(child);
+            delete child;
+        }
+        node->children.clear();
+    }
+
+    static bool removeValue(Node *node, const QStringList &levels, int index, const T &value)
+    {
+        if (index == levels.count())
+            return node->values.removeAll(value) > 0;
+
+        Node *child = node->children.value(levels.at(index));
+        if (!child)
+            return false;
+
+        bool removed = removeValue(child, levels, index + 1, value);
+
+        // Prune branches which don't lead to any value any more
+        if (child->values.isEmpty() && child->children.isEmpty()) {
+            node->children.remove(levels.at(index));
+            delete child;
+        }
+        return removed;
+    }
+
+    static void collect(const Node *node, const QStringList &levels, int index, QList<T> *result)
+    {
+        if (index == levels.count()) {
+            result->append(node->values);
+
+            // "a/#" matches "a" too
+            if (const Node *multiLevel = node->children.value("#"))
+                result->append(multiLevel->values);
+
+            return;
+        }
+
+        // Wildcards don't match topics beginning with $ (e.g. $SYS)
+        if (index != 0 || !levels.first().startsWith('$')) {
+            if (const Node *multiLevel = node->children.value("#"))
+                result->append(multiLevel->values);
+
+            if (const Node *singleLevel = node->children.value("+"))
+                collect(singleLevel, levels, index + 1, result);
+        }
+
+        if (const Node *exact = node->children.value(levels.at(index)))
+            collect(exact, levels, index + 1, result);
+    }
+};
+
+#endif // MQTTTOPICTRIE_H
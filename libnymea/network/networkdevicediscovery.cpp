@@ -30,10 +30,13 @@
 
 #include "networkdevicediscovery.h"
 #include "loggingcategories.h"
+#include "nymeasettings.h"
 #include "networkutils.h"
 #include "macaddressdatabase.h"
 #include "arpsocket.h"
 
+#include <QSet>
+#include <QSettings>
 #include <QDateTime>
 
 NYMEA_LOGGING_CATEGORY(dcNetworkDeviceDiscovery, "NetworkDeviceDiscovery")
@@ -41,9 +44,10 @@ NYMEA_LOGGING_CATEGORY(dcNetworkDeviceDiscovery, "NetworkDeviceDiscovery")
 NetworkDeviceDiscovery::NetworkDeviceDiscovery(QObject *parent) :
     QObject(parent)
 {
-    // Create ARP socket
+    // Create ARP socket, the requests and responses of other hosts keep the cache up to date
     m_arpSocket = new ArpSocket(this);
     connect(m_arpSocket, &ArpSocket::arpResponse, this, &NetworkDeviceDiscovery::onArpResponseRceived);
+    connect(m_arpSocket, &ArpSocket::arpRequest, this, &NetworkDeviceDiscovery::onArpResponseRceived);
     bool arpAvailable = m_arpSocket->openSocket();
     if (!arpAvailable) {
         m_arpSocket->closeSocket();
@@ -62,44 +66,105 @@ NetworkDeviceDiscovery::NetworkDeviceDiscovery(QObject *parent) :
     m_discoveryTimer->setInterval(20000);
     m_discoveryTimer->setSingleShot(true);
     connect(m_discoveryTimer, &QTimer::timeout, this, [=](){
-        if (m_runningPingRepies.isEmpty() && m_currentReply) {
+        if (!m_runningSweep && m_running) {
+            finishDiscovery();
+        }
+    });
+
+    // Host names are nice to have, don't let a slow name server hold back the discovery
+    m_hostLookupTimer = new QTimer(this);
+    m_hostLookupTimer->setInterval(1500);
+    m_hostLookupTimer->setSingleShot(true);
+    connect(m_hostLookupTimer, &QTimer::timeout, this, [=](){
+        if (m_running && !m_runningSweep) {
+            qCDebug(dcNetworkDeviceDiscovery()) << "Host name lookup timeout. Finishing without" << m_pendingHostLookups.count() << "host names";
             finishDiscovery();
         }
     });
 
     if (!arpAvailable && !m_ping->available()) {
         qCWarning(dcNetworkDeviceDiscovery()) << "Network device discovery is not available on this system.";
-    } else {
-        qCDebug(dcNetworkDeviceDiscovery()) << "Created successfully";
+        return;
     }
+
+    loadCache();
+
+    // With the ARP socket open the cache gets updated passively, a full sweep is needed less often
+    if (arpAvailable)
+        m_refreshInterval = 900;
+
+    // Refresh the cache in the background, the first time once the system had some time to settle
+    m_refreshTimer = new QTimer(this);
+    m_refreshTimer->setInterval(10000);
+    m_refreshTimer->setSingleShot(true);
+    connect(m_refreshTimer, &QTimer::timeout, this, [=](){
+        m_refreshTimer->setSingleShot(false);
+        m_refreshTimer->start(m_refreshInterval * 1000);
+        if (!m_running) {
+            qCDebug(dcNetworkDeviceDiscovery()) << "Refreshing the network device cache";
+            startDiscovery();
+        }
+    });
+    m_refreshTimer->start();
+
+    qCDebug(dcNetworkDeviceDiscovery()) << "Created successfully";
 }
 
-NetworkDeviceDiscoveryReply *NetworkDeviceDiscovery::discover()
+NetworkDeviceDiscoveryReply *NetworkDeviceDiscovery::discover(bool fresh)
 {
-    if (m_currentReply) {
-        qCDebug(dcNetworkDeviceDiscovery()) << "Discovery already running. Returning current pending discovery reply...";
-        return m_currentReply;
-    }
-
-    qCDebug(dcNetworkDeviceDiscovery()) << "Starting network device discovery ...";
     NetworkDeviceDiscoveryReply *reply = new NetworkDeviceDiscoveryReply(this);
-    m_currentReply = reply;
-    m_currentReply->m_startTimestamp = QDateTime::currentMSecsSinceEpoch();
+    reply->m_startTimestamp = QDateTime::currentMSecsSinceEpoch();
 
-    if (m_ping->available()) {
-        pingAllNetworkDevices();
+    if (!fresh && !m_cache.isEmpty()) {
+        qCDebug(dcNetworkDeviceDiscovery()) << "Answering network device discovery from the cache with" << m_cache.count() << "network devices";
+        reply->m_networkDeviceInfos = m_cache;
+        reply->m_networkDeviceInfos.sortNetworkDevices();
+
+        // Finish in the next event loop to give the user time to do the reply connects
+        QTimer::singleShot(0, reply, [=](){
+            emit reply->finished();
+            reply->deleteLater();
+        });
+
+        // Incremental rediscovery: if the cache is getting old, refresh it for the next one asking
+        if (!m_running && reply->m_startTimestamp - m_lastDiscoveryTimestamp > 60000) {
+            startDiscovery();
+        }
+        return reply;
     }
 
-    if (m_arpSocket->isOpen()) {
-        m_arpSocket->sendRequest();
+    m_pendingReplies.append(reply);
+    if (m_running) {
+        qCDebug(dcNetworkDeviceDiscovery()) << "Discovery already running. Waiting for the pending discovery to finish...";
+        return reply;
     }
 
-    m_discoveryTimer->start();
-    m_running = true;
-    emit runningChanged(m_running);
+    startDiscovery();
     return reply;
 }
 
+NetworkDeviceInfos NetworkDeviceDiscovery::cachedNetworkDeviceInfos() const
+{
+    return m_cache;
+}
+
+QDateTime NetworkDeviceDiscovery::lastSeen(const QHostAddress &address) const
+{
+    if (!m_lastSeen.contains(address))
+        return QDateTime();
+
+    return QDateTime::fromMSecsSinceEpoch(m_lastSeen.value(address));
+}
+
+QHostAddress NetworkDeviceDiscovery::addressForMacAddress(const QString &macAddress) const
+{
+    int index = m_cache.indexFromMacAddress(macAddress.toLower());
+    if (index < 0)
+        return QHostAddress();
+
+    return m_cache.at(index).address();
+}
+
 bool NetworkDeviceDiscovery::available() const
 {
     return m_arpSocket->isOpen() || m_ping->available();
@@ -120,9 +185,31 @@ MacAddressDatabaseReply *NetworkDeviceDiscovery::lookupMacAddress(const QString
     return m_macAddressDatabase->lookupMacAddress(macAddress);
 }
 
+void NetworkDeviceDiscovery::startDiscovery()
+{
+    qCDebug(dcNetworkDeviceDiscovery()) << "Starting network device discovery ...";
+    m_discoveredInfos.clear();
+    m_discoveryTimestamp = QDateTime::currentMSecsSinceEpoch();
+    m_running = true;
+    emit runningChanged(m_running);
+
+    if (m_ping->available()) {
+        pingAllNetworkDevices();
+    }
+
+    if (m_arpSocket->isOpen()) {
+        m_arpSocket->sendRequest();
+    }
+
+    // Without ping there is nothing telling us when we are done, ARP responses arrive fast
+    m_discoveryTimer->start(m_ping->available() ? 20000 : 3000);
+}
+
 void NetworkDeviceDiscovery::pingAllNetworkDevices()
 {
     qCDebug(dcNetworkDeviceDiscovery()) << "Starting ping for all network devices...";
+    QList<QHostAddress> targetAddresses;
+    QSet<QHostAddress> ownAddresses;
     foreach (const QNetworkInterface &networkInterface, QNetworkInterface::allInterfaces()) {
         if (networkInterface.flags().testFlag(QNetworkInterface::IsLoopBack))
             continue;
@@ -142,118 +229,248 @@ void NetworkDeviceDiscovery::pingAllNetworkDevices()
             qCDebug(dcNetworkDeviceDiscovery()) << "    Host address:" << entry.ip().toString();
             qCDebug(dcNetworkDeviceDiscovery()) << "    Broadcast address:" << entry.broadcast().toString();
             qCDebug(dcNetworkDeviceDiscovery()) << "    Netmask:" << entry.netmask().toString();
+            ownAddresses.insert(entry.ip());
             quint32 addressRangeStart = entry.ip().toIPv4Address() & entry.netmask().toIPv4Address();
             quint32 addressRangeStop = entry.broadcast().toIPv4Address() | addressRangeStart;
             quint32 range = addressRangeStop - addressRangeStart;
 
-            // Let's scan only 255.255.255.0 networks for now
-            if (range > 255)
+            // The sweep identifies targets by the 16 bit sequence number, up to 255.255.0.0 networks fit
+            if (range > 65535) {
+                qCDebug(dcNetworkDeviceDiscovery()) << "    Skipping address range" << range << "because it is too large";
                 continue;
+            }
 
             qCDebug(dcNetworkDeviceDiscovery()) << "    Address range" << range << " | from" << QHostAddress(addressRangeStart).toString() << "-->" << QHostAddress(addressRangeStop).toString();
-            // Send ping request to each address within the range
             for (quint32 i = 1; i < range; i++) {
-                quint32 address = addressRangeStart + i;
-                QHostAddress targetAddress(address);
-
-                // Skip our self
-                if (targetAddress == entry.ip())
-                    continue;
-
-                PingReply *reply = m_ping->ping(targetAddress);
-                m_runningPingRepies.append(reply);
-                connect(reply, &PingReply::finished, this, [=](){
-                    m_runningPingRepies.removeAll(reply);
-                    if (reply->error() == PingReply::ErrorNoError) {
-                        qCDebug(dcNetworkDeviceDiscovery()) << "Ping response from" << targetAddress.toString() << reply->hostName() << reply->duration() << "ms";
-                        int index = m_currentReply->networkDeviceInfos().indexFromHostAddress(targetAddress);
-                        if (index < 0) {
-                            // Add the network device
-                            NetworkDeviceInfo networkDeviceInfo;
-                            networkDeviceInfo.setAddress(targetAddress);
-                            networkDeviceInfo.setHostName(reply->hostName());
-                            m_currentReply->networkDeviceInfos().append(networkDeviceInfo);
-                        } else {
-                            m_currentReply->networkDeviceInfos()[index].setAddress(targetAddress);
-                            m_currentReply->networkDeviceInfos()[index].setHostName(reply->hostName());
-                            if (!m_currentReply->networkDeviceInfos()[index].networkInterface().isValid()) {
-                                m_currentReply->networkDeviceInfos()[index].setNetworkInterface(NetworkUtils::getInterfaceForHostaddress(targetAddress));
-                            }
-                        }
-                    }
-
-                    if (m_runningPingRepies.isEmpty() && m_currentReply && !m_discoveryTimer->isActive()) {
-                        finishDiscovery();
-                    }
-                });
+                targetAddresses.append(QHostAddress(addressRangeStart + i));
             }
         }
     }
+
+    // Skip our self and networks shared by multiple interfaces
+    QSet<QHostAddress> addedAddresses = ownAddresses;
+    QList<QHostAddress> sweepAddresses;
+    foreach (const QHostAddress &targetAddress, targetAddresses) {
+        if (addedAddresses.contains(targetAddress))
+            continue;
+
+        addedAddresses.insert(targetAddress);
+        sweepAddresses.append(targetAddress);
+    }
+
+    m_runningSweep = m_ping->sweep(sweepAddresses);
+    connect(m_runningSweep, &PingSweepReply::hostResponded, this, [=](const QHostAddress &targetAddress, double duration){
+        if (!m_running)
+            return;
+
+        qCDebug(dcNetworkDeviceDiscovery()) << "Ping response from" << targetAddress.toString() << duration << "ms";
+        NetworkDeviceInfo networkDeviceInfo;
+        networkDeviceInfo.setAddress(targetAddress);
+        networkDeviceInfo.setNetworkInterface(NetworkUtils::getInterfaceForHostaddress(targetAddress));
+
+        // Known host names don't need another lookup
+        int index = m_cache.indexFromHostAddress(targetAddress);
+        if (index >= 0 && !m_cache.at(index).hostName().isEmpty()) {
+            networkDeviceInfo.setHostName(m_cache.at(index).hostName());
+            registerNetworkDeviceInfo(networkDeviceInfo);
+            return;
+        }
+
+        registerNetworkDeviceInfo(networkDeviceInfo);
+
+        // Note: due to a Qt bug < 5.9 we need to use old SLOT style and cannot make use of lambda here
+        int lookupId = QHostInfo::lookupHost(targetAddress.toString(), this, SLOT(onHostLookupFinished(QHostInfo)));
+        m_pendingHostLookups.insert(lookupId, targetAddress);
+    });
+
+    connect(m_runningSweep, &PingSweepReply::finished, this, [=](){
+        qCDebug(dcNetworkDeviceDiscovery()) << "Ping sweep finished." << m_runningSweep->respondedAddresses().count() << "of" << m_runningSweep->targetAddresses().count() << "hosts responded";
+        m_runningSweep = nullptr;
+        if (!m_running)
+            return;
+
+        if (m_pendingHostLookups.isEmpty()) {
+            finishDiscovery();
+        } else {
+            m_hostLookupTimer->start();
+        }
+    });
 }
 
 void NetworkDeviceDiscovery::finishDiscovery()
 {
     m_discoveryTimer->stop();
+    m_hostLookupTimer->stop();
+    foreach (int lookupId, m_pendingHostLookups.keys()) {
+        QHostInfo::abortHostLookup(lookupId);
+    }
+    m_pendingHostLookups.clear();
     m_running = false;
     emit runningChanged(m_running);
 
     // Sort by host address
-    m_currentReply->networkDeviceInfos().sortNetworkDevices();
-
-    qint64 durationMilliSeconds = QDateTime::currentMSecsSinceEpoch() - m_currentReply->m_startTimestamp;
-    qCDebug(dcNetworkDeviceDiscovery()) << "Discovery finished. Found" << m_currentReply->networkDeviceInfos().count() << "network devices in" << QTime::fromMSecsSinceStartOfDay(durationMilliSeconds).toString("mm:ss.zzz");
-    emit m_currentReply->finished();
-    m_currentReply->deleteLater();
-    m_currentReply = nullptr;
+    m_discoveredInfos.sortNetworkDevices();
+    m_lastDiscoveryTimestamp = QDateTime::currentMSecsSinceEpoch();
+    cleanUpCache();
+    saveCache();
+
+    qint64 durationMilliSeconds = m_lastDiscoveryTimestamp - m_discoveryTimestamp;
+    qCDebug(dcNetworkDeviceDiscovery()) << "Discovery finished. Found" << m_discoveredInfos.count() << "network devices in" << QTime::fromMSecsSinceStartOfDay(durationMilliSeconds).toString("mm:ss.zzz")
+                                        << "for" << m_pendingReplies.count() << "pending discoveries";
+
+    foreach (NetworkDeviceDiscoveryReply *reply, m_pendingReplies) {
+        reply->m_networkDeviceInfos = m_discoveredInfos;
+        emit reply->finished();
+        reply->deleteLater();
+    }
+    m_pendingReplies.clear();
 }
 
 void NetworkDeviceDiscovery::updateOrAddNetworkDeviceArp(const QNetworkInterface &interface, const QHostAddress &address, const QString &macAddress, const QString &manufacturer)
 {
-    int index = m_currentReply->networkDeviceInfos().indexFromHostAddress(address);
-    if (index >= 0) {
-        // Update the network device
-        m_currentReply->networkDeviceInfos()[index].setMacAddress(macAddress);
-        if (!manufacturer.isEmpty())
-            m_currentReply->networkDeviceInfos()[index].setMacAddressManufacturer(manufacturer);
-
-        if (interface.isValid()) {
-            m_currentReply->networkDeviceInfos()[index].setNetworkInterface(interface);
-        }
-    } else {
-        index = m_currentReply->networkDeviceInfos().indexFromMacAddress(macAddress);
-        if (index >= 0) {
-            // Update the network device
-            m_currentReply->networkDeviceInfos()[index].setAddress(address);
-            if (!manufacturer.isEmpty())
-                m_currentReply->networkDeviceInfos()[index].setMacAddressManufacturer(manufacturer);
-
-            if (interface.isValid()) {
-                m_currentReply->networkDeviceInfos()[index].setNetworkInterface(interface);
-            }
-        } else {
-            // Add the network device
-            NetworkDeviceInfo networkDeviceInfo;
-            networkDeviceInfo.setAddress(address);
-            networkDeviceInfo.setMacAddress(macAddress);
-            if (!manufacturer.isEmpty())
-                networkDeviceInfo.setMacAddressManufacturer(manufacturer);
+    NetworkDeviceInfo networkDeviceInfo(macAddress);
+    networkDeviceInfo.setAddress(address);
+    networkDeviceInfo.setMacAddressManufacturer(manufacturer);
+    networkDeviceInfo.setNetworkInterface(interface);
+    registerNetworkDeviceInfo(networkDeviceInfo);
+}
 
-            if (interface.isValid())
-                networkDeviceInfo.setNetworkInterface(interface);
+void NetworkDeviceDiscovery::updateOrAddNetworkDeviceInfo(NetworkDeviceInfos &networkDeviceInfos, const NetworkDeviceInfo &networkDeviceInfo)
+{
+    int index = networkDeviceInfos.indexFromHostAddress(networkDeviceInfo.address());
+    if (index < 0 && !networkDeviceInfo.macAddress().isEmpty()) {
+        // The host might have a new address
+        index = networkDeviceInfos.indexFromMacAddress(networkDeviceInfo.macAddress());
+    }
 
-            m_currentReply->networkDeviceInfos().append(networkDeviceInfo);
+    if (index < 0) {
+        // Add the network device
+        networkDeviceInfos.append(networkDeviceInfo);
+        return;
+    }
+
+    // Update the network device, but keep what is known already
+    NetworkDeviceInfo &knownInfo = networkDeviceInfos[index];
+    knownInfo.setAddress(networkDeviceInfo.address());
+    if (!networkDeviceInfo.macAddress().isEmpty())
+        knownInfo.setMacAddress(networkDeviceInfo.macAddress());
+
+    if (!networkDeviceInfo.macAddressManufacturer().isEmpty())
+        knownInfo.setMacAddressManufacturer(networkDeviceInfo.macAddressManufacturer());
+
+    if (!networkDeviceInfo.hostName().isEmpty())
+        knownInfo.setHostName(networkDeviceInfo.hostName());
+
+    if (networkDeviceInfo.networkInterface().isValid())
+        knownInfo.setNetworkInterface(networkDeviceInfo.networkInterface());
+}
+
+void NetworkDeviceDiscovery::registerNetworkDeviceInfo(const NetworkDeviceInfo &networkDeviceInfo)
+{
+    QHostAddress previousAddress;
+    if (!networkDeviceInfo.macAddress().isEmpty()) {
+        int index = m_cache.indexFromMacAddress(networkDeviceInfo.macAddress());
+        if (index >= 0)
+            previousAddress = m_cache.at(index).address();
+    }
+
+    updateOrAddNetworkDeviceInfo(m_cache, networkDeviceInfo);
+    m_lastSeen[networkDeviceInfo.address()] = QDateTime::currentMSecsSinceEpoch();
+
+    if (!previousAddress.isNull() && previousAddress != networkDeviceInfo.address()) {
+        qCDebug(dcNetworkDeviceDiscovery()) << "Network device" << networkDeviceInfo.macAddress() << "changed address from" << previousAddress.toString() << "to" << networkDeviceInfo.address().toString();
+        m_lastSeen.remove(previousAddress);
+        emit networkDeviceAddressChanged(networkDeviceInfo.macAddress(), previousAddress, networkDeviceInfo.address());
+    }
+
+    emit networkDeviceSeen(m_cache.at(m_cache.indexFromHostAddress(networkDeviceInfo.address())));
+
+    if (m_running) {
+        // Fill in what the cache knows about this host
+        NetworkDeviceInfo cachedInfo = m_cache.at(m_cache.indexFromHostAddress(networkDeviceInfo.address()));
+        updateOrAddNetworkDeviceInfo(m_discoveredInfos, cachedInfo);
+    }
+}
+
+QString NetworkDeviceDiscovery::cacheFileName() const
+{
+    return NymeaSettings::storagePath() + "/networkdevices.conf";
+}
+
+void NetworkDeviceDiscovery::loadCache()
+{
+    QSettings settings(cacheFileName(), QSettings::IniFormat);
+    int count = settings.beginReadArray("NetworkDevices");
+    for (int i = 0; i < count; i++) {
+        settings.setArrayIndex(i);
+        NetworkDeviceInfo networkDeviceInfo(settings.value("macAddress").toString());
+        networkDeviceInfo.setAddress(QHostAddress(settings.value("address").toString()));
+        networkDeviceInfo.setMacAddressManufacturer(settings.value("macAddressManufacturer").toString());
+        networkDeviceInfo.setHostName(settings.value("hostName").toString());
+        networkDeviceInfo.setNetworkInterface(QNetworkInterface::interfaceFromName(settings.value("networkInterface").toString()));
+        if (networkDeviceInfo.address().isNull())
+            continue;
+
+        updateOrAddNetworkDeviceInfo(m_cache, networkDeviceInfo);
+        m_lastSeen.insert(networkDeviceInfo.address(), settings.value("lastSeen").toLongLong());
+    }
+    settings.endArray();
+
+    cleanUpCache();
+    qCDebug(dcNetworkDeviceDiscovery()) << "Loaded" << m_cache.count() << "network devices from the cache";
+}
+
+void NetworkDeviceDiscovery::saveCache()
+{
+    QSettings settings(cacheFileName(), QSettings::IniFormat);
+    settings.remove("NetworkDevices");
+    settings.beginWriteArray("NetworkDevices", m_cache.count());
+    for (int i = 0; i < m_cache.count(); i++) {
+        const NetworkDeviceInfo &networkDeviceInfo = m_cache.at(i);
+        settings.setArrayIndex(i);
+        settings.setValue("address", networkDeviceInfo.address().toString());
+        settings.setValue("macAddress", networkDeviceInfo.macAddress());
+        settings.setValue("macAddressManufacturer", networkDeviceInfo.macAddressManufacturer());
+        settings.setValue("hostName", networkDeviceInfo.hostName());
+        settings.setValue("networkInterface", networkDeviceInfo.networkInterface().name());
+        settings.setValue("lastSeen", m_lastSeen.value(networkDeviceInfo.address()));
+    }
+    settings.endArray();
+}
+
+void NetworkDeviceDiscovery::cleanUpCache()
+{
+    // Forget hosts which have not been seen for a while
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QHash<QHostAddress, qint64> lastSeen;
+    NetworkDeviceInfos networkDeviceInfos;
+    foreach (const NetworkDeviceInfo &networkDeviceInfo, m_cache) {
+        qint64 timestamp = m_lastSeen.value(networkDeviceInfo.address());
+        if (now - timestamp > m_cacheExpiryTime * 1000) {
+            qCDebug(dcNetworkDeviceDiscovery()) << "Removing" << networkDeviceInfo.address().toString() << networkDeviceInfo.macAddress() << "from the cache";
+            continue;
         }
+
+        networkDeviceInfos.append(networkDeviceInfo);
+        lastSeen.insert(networkDeviceInfo.address(), timestamp);
     }
+
+    m_cache = networkDeviceInfos;
+    m_lastSeen = lastSeen;
 }
 
 void NetworkDeviceDiscovery::onArpResponseRceived(const QNetworkInterface &interface, const QHostAddress &address, const QString &macAddress)
 {
-    if (!m_currentReply) {
-        qCDebug(dcNetworkDeviceDiscovery()) << "Received ARP reply from" << address.toString() << macAddress << "but there is no discovery running.";
+    if (m_running)
+        qCDebug(dcNetworkDeviceDiscovery()) << "ARP reply received" << address.toString() << macAddress << interface.name();
+
+    // The manufacturer does not change for a MAC address
+    int index = m_cache.indexFromMacAddress(macAddress);
+    if (index >= 0 && !m_cache.at(index).macAddressManufacturer().isEmpty()) {
+        updateOrAddNetworkDeviceArp(interface, address, macAddress, m_cache.at(index).macAddressManufacturer());
         return;
     }
 
-    qCDebug(dcNetworkDeviceDiscovery()) << "ARP reply received" << address.toString() << macAddress << interface.name();
     // Lookup the mac address vendor if possible
     if (m_macAddressDatabase->available()) {
         MacAddressDatabaseReply *reply = m_macAddressDatabase->lookupMacAddress(macAddress);
@@ -265,3 +482,26 @@ void NetworkDeviceDiscovery::onArpResponseRceived(const QNetworkInterface &inter
         updateOrAddNetworkDeviceArp(interface, address, macAddress);
     }
 }
+
+void NetworkDeviceDiscovery::onHostLookupFinished(const QHostInfo &info)
+{
+    if (!m_pendingHostLookups.contains(info.lookupId()))
+        return;
+
+    QHostAddress address = m_pendingHostLookups.take(info.lookupId());
+    if (!m_running)
+        return;
+
+    if (info.error() != QHostInfo::NoError) {
+        qCDebug(dcNetworkDeviceDiscovery()) << "Failed to look up host name of" << address.toString() << info.error();
+    } else if (info.hostName() != address.toString()) {
+        NetworkDeviceInfo networkDeviceInfo;
+        networkDeviceInfo.setAddress(address);
+        networkDeviceInfo.setHostName(info.hostName());
+        registerNetworkDeviceInfo(networkDeviceInfo);
+    }
+
+    if (m_pendingHostLookups.isEmpty() && !m_runningSweep) {
+        finishDiscovery();
+    }
+}
@@ -31,8 +31,11 @@
 #ifndef NETWORKDEVICEDISCOVERY_H
 #define NETWORKDEVICEDISCOVERY_H
 
+#include <QHash>
 #include <QTimer>
 #include <QObject>
+#include <QHostInfo>
+#include <QDateTime>
 #include <QLoggingCategory>
 
 #include "ping.h"
@@ -51,7 +54,14 @@ class LIBNYMEA_EXPORT NetworkDeviceDiscovery : public QObject
 public:
     explicit NetworkDeviceDiscovery(QObject *parent = nullptr);
 
-    NetworkDeviceDiscoveryReply *discover();
+    // Answers from the cache if possible, fresh waits for a new sweep of the network
+    NetworkDeviceDiscoveryReply *discover(bool fresh = false);
+
+    NetworkDeviceInfos cachedNetworkDeviceInfos() const;
+
+    // Passive monitoring: the cache is kept up to date by the ARP traffic on the network
+    QDateTime lastSeen(const QHostAddress &address) const;
+    QHostAddress addressForMacAddress(const QString &macAddress) const;
 
     bool available() const;
     bool running() const;
@@ -61,6 +71,8 @@ public:
 
 signals:
     void runningChanged(bool running);
+    void networkDeviceSeen(const NetworkDeviceInfo &networkDeviceInfo);
+    void networkDeviceAddressChanged(const QString &macAddress, const QHostAddress &oldAddress, const QHostAddress &newAddress);
 
 private:
     MacAddressDatabase *m_macAddressDatabase = nullptr;
@@ -69,16 +81,37 @@ private:
     bool m_running = false;
 
     QTimer *m_discoveryTimer = nullptr;
-    NetworkDeviceDiscoveryReply *m_currentReply = nullptr;
-    QList<PingReply *> m_runningPingRepies;
-
+    QList<NetworkDeviceDiscoveryReply *> m_pendingReplies;
+    NetworkDeviceInfos m_discoveredInfos;
+    qint64 m_discoveryTimestamp = 0;
+    PingSweepReply *m_runningSweep = nullptr;
+    QTimer *m_hostLookupTimer = nullptr;
+    QHash<int, QHostAddress> m_pendingHostLookups;
+
+    // Cache, fed by the discoveries and passive ARP monitoring
+    NetworkDeviceInfos m_cache;
+    QHash<QHostAddress, qint64> m_lastSeen;
+    QTimer *m_refreshTimer = nullptr;
+    qint64 m_lastDiscoveryTimestamp = 0;
+    int m_refreshInterval = 300;
+    int m_cacheExpiryTime = 3600;
+
+    void startDiscovery();
     void pingAllNetworkDevices();
     void finishDiscovery();
 
     void updateOrAddNetworkDeviceArp(const QNetworkInterface &interface, const QHostAddress &address, const QString &macAddress, const QString &manufacturer = QString());
+    void updateOrAddNetworkDeviceInfo(NetworkDeviceInfos &networkDeviceInfos, const NetworkDeviceInfo &networkDeviceInfo);
+    void registerNetworkDeviceInfo(const NetworkDeviceInfo &networkDeviceInfo);
+
+    QString cacheFileName() const;
+    void loadCache();
+    void saveCache();
+    void cleanUpCache();
 
 private slots:
     void onArpResponseRceived(const QNetworkInterface &interface, const QHostAddress &address, const QString &macAddress);
+    void onHostLookupFinished(const QHostInfo &info);
 
 };
 
@@ -66,6 +66,12 @@ Ping::Ping(QObject *parent) : QObject(parent)
         return;
     }
 
+    // Sweeps receive many responses at once, make sure they fit into the socket buffer
+    const int receiveBufferSize = 256 * 1024;
+    if (setsockopt(m_socketDescriptor, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize, sizeof(receiveBufferSize)) != 0) {
+        qCDebug(dcPing()) << "Failed to set the ICMP socket receive buffer size:" << strerror(errno);
+    }
+
     // Configure non blocking
     if (fcntl(m_socketDescriptor, F_SETFL, fcntl(m_socketDescriptor, F_GETFL, 0) | O_NONBLOCK) != 0) {
         verifyErrno(errno);
@@ -85,6 +91,11 @@ Ping::Ping(QObject *parent) : QObject(parent)
         sendNextReply();
     });
 
+    m_sweepTimer = new QTimer(this);
+    m_sweepTimer->setTimerType(Qt::PreciseTimer);
+    m_sweepTimer->setInterval(5);
+    connect(m_sweepTimer, &QTimer::timeout, this, &Ping::sendSweepPackets);
+
     m_socketNotifier->setEnabled(true);
     m_available = true;
     qCDebug(dcPing()) << "ICMP socket set up successfully (Socket ID:" << m_socketDescriptor << ")";
@@ -124,6 +135,64 @@ PingReply *Ping::ping(const QHostAddress &hostAddress)
     return reply;
 }
 
+int Ping::sweepRate() const
+{
+    return m_sweepRate;
+}
+
+void Ping::setSweepRate(int packetsPerSecond)
+{
+    m_sweepRate = packetsPerSecond;
+}
+
+int Ping::sweepTimeout() const
+{
+    return m_sweepTimeout;
+}
+
+void Ping::setSweepTimeout(int timeout)
+{
+    m_sweepTimeout = timeout;
+}
+
+PingSweepReply *Ping::sweep(const QList<QHostAddress> &targetAddresses)
+{
+    PingSweepReply *reply = new PingSweepReply(this);
+    connect(reply->m_timer, &QTimer::timeout, this, [=](){
+        finishSweep(reply, PingReply::ErrorNoError);
+    });
+
+    // The sequence number identifies the target within the sweep
+    reply->m_targetAddresses = targetAddresses.mid(0, 65536);
+    if (targetAddresses.count() > reply->m_targetAddresses.count()) {
+        qCWarning(dcPing()) << "Sweeping only the first" << reply->m_targetAddresses.count() << "of" << targetAddresses.count() << "addresses";
+    }
+    reply->m_sendTimes.fill(-1, reply->m_targetAddresses.count());
+
+    if (!m_available || reply->m_targetAddresses.isEmpty()) {
+        PingReply::Error error = m_available ? PingReply::ErrorNoError : m_error;
+        QTimer::singleShot(0, reply, [=](){ finishSweep(reply, error); });
+        return reply;
+    }
+
+    reply->m_requestId = calculateRequestId();
+    reply->m_elapsedTimer.start();
+    m_pendingSweeps.insert(reply->requestId(), reply);
+
+    qCDebug(dcPing()) << "Start sweeping" << reply->m_targetAddresses.count() << "hosts with" << m_sweepRate << "packets per second"
+                      << "ID:" << QString("0x%1").arg(reply->requestId(), 4, 16, QChar('0'));
+
+    // Sending starts with the next timer tick, which gives the user time to do the reply connects
+    m_sendingSweeps.append(reply);
+    if (!m_sweepTimer->isActive()) {
+        m_sweepBudget = 0;
+        m_sweepBudgetTimer.start();
+        m_sweepTimer->start();
+    }
+
+    return reply;
+}
+
 void Ping::sendNextReply()
 {
     if (m_queueTimer->isActive())
@@ -158,22 +227,7 @@ void Ping::performPing(PingReply *reply)
 
     // Build the ICMP echo request packet
     struct icmpPacket requestPacket;
-    memset(&requestPacket, 0, sizeof(requestPacket));
-    requestPacket.icmpHeadr.type = ICMP_ECHO;
-    if (reply->requestId() == 0) {
-        requestPacket.icmpHeadr.un.echo.id = calculateRequestId();
-    } else {
-        requestPacket.icmpHeadr.un.echo.id = reply->requestId();
-    }
-    requestPacket.icmpHeadr.un.echo.sequence = htons(reply->m_sequenceNumber++);
-
-    // Write the ICMP payload
-    memset(&requestPacket.icmpPayload, ' ', sizeof(requestPacket.icmpPayload));
-    for (int i = 0; i < m_payload.count(); i++)
-        requestPacket.icmpPayload[i] = m_payload.at(i);
-
-    // Calculate the ICMP packet checksum
-    requestPacket.icmpHeadr.checksum = calculateChecksum(reinterpret_cast<unsigned short *>(&requestPacket), sizeof(requestPacket));
+    buildEchoRequest(&requestPacket, reply->requestId() == 0 ? calculateRequestId() : reply->requestId(), reply->m_sequenceNumber++);
 
     // Get time for ping measurement and fill reply information
     if (gettimeofday(&reply->m_startTime, nullptr) < 0 ) {
@@ -205,6 +259,109 @@ void Ping::performPing(PingReply *reply)
     });
 }
 
+void Ping::buildEchoRequest(icmpPacket *requestPacket, quint16 requestId, quint16 sequenceNumber)
+{
+    memset(requestPacket, 0, sizeof(struct icmpPacket));
+    requestPacket->icmpHeadr.type = ICMP_ECHO;
+    requestPacket->icmpHeadr.un.echo.id = requestId;
+    requestPacket->icmpHeadr.un.echo.sequence = htons(sequenceNumber);
+
+    // Write the ICMP payload
+    memset(&requestPacket->icmpPayload, ' ', sizeof(requestPacket->icmpPayload));
+    for (int i = 0; i < m_payload.count(); i++)
+        requestPacket->icmpPayload[i] = m_payload.at(i);
+
+    // Calculate the ICMP packet checksum
+    requestPacket->icmpHeadr.checksum = calculateChecksum(reinterpret_cast<unsigned short *>(requestPacket), sizeof(struct icmpPacket));
+}
+
+void Ping::sendSweepPackets()
+{
+    // Refill the packet budget for the time since the last tick, allow bursts of up to 50 ms
+    if (m_sweepRate > 0) {
+        m_sweepBudget += m_sweepRate * m_sweepBudgetTimer.nsecsElapsed() / 1000000000.0;
+        m_sweepBudget = qMin(m_sweepBudget, qMax(1.0, m_sweepRate / 20.0));
+    } else {
+        m_sweepBudget = 65536;
+    }
+    m_sweepBudgetTimer.restart();
+
+    // Round robin between the running sweeps
+    while (m_sweepBudget >= 1 && !m_sendingSweeps.isEmpty()) {
+        PingSweepReply *reply = m_sendingSweeps.takeFirst();
+        if (!sendSweepPacket(reply)) {
+            // The socket buffer is full, try again with the next tick
+            m_sendingSweeps.prepend(reply);
+            break;
+        }
+
+        m_sweepBudget -= 1;
+        if (reply->m_nextTarget < reply->m_targetAddresses.count()) {
+            m_sendingSweeps.append(reply);
+        } else if (reply->m_durations.count() < reply->m_targetAddresses.count()) {
+            // Everything sent, give the late responses some time
+            reply->m_timer->start(m_sweepTimeout);
+        }
+    }
+
+    if (m_sendingSweeps.isEmpty()) {
+        m_sweepTimer->stop();
+    }
+}
+
+bool Ping::sendSweepPacket(PingSweepReply *reply)
+{
+    int sequenceNumber = reply->m_nextTarget;
+    QHostAddress targetAddress = reply->m_targetAddresses.at(sequenceNumber);
+    if (targetAddress.protocol() != QAbstractSocket::IPv4Protocol) {
+        qCDebug(dcPing()) << "Skipping sweep target" << targetAddress.toString() << "because it is not an IPv4 address";
+        reply->m_nextTarget++;
+        return true;
+    }
+
+    struct sockaddr_in pingAddress;
+    memset(&pingAddress, 0, sizeof(pingAddress));
+    pingAddress.sin_family = AF_INET;
+    pingAddress.sin_port = 0;
+    pingAddress.sin_addr.s_addr = qToBigEndian(targetAddress.toIPv4Address());
+
+    struct icmpPacket requestPacket;
+    buildEchoRequest(&requestPacket, reply->requestId(), sequenceNumber);
+
+    reply->m_sendTimes[sequenceNumber] = reply->m_elapsedTimer.nsecsElapsed();
+    int bytesSent = sendto(m_socketDescriptor, &requestPacket, sizeof(requestPacket), 0, (struct sockaddr *)&pingAddress, sizeof(pingAddress));
+    if (bytesSent < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+            reply->m_sendTimes[sequenceNumber] = -1;
+            return false;
+        }
+
+        // Not reachable at all, a response will not come
+        qCDebug(dcPing()) << "Failed to send sweep echo request to" << targetAddress.toString() << strerror(errno);
+        reply->m_sendTimes[sequenceNumber] = -1;
+    }
+
+    reply->m_nextTarget++;
+    return true;
+}
+
+void Ping::finishSweep(PingSweepReply *reply, PingReply::Error error)
+{
+    if (reply->m_finished)
+        return;
+
+    reply->m_finished = true;
+    reply->m_error = error;
+    reply->m_timer->stop();
+    m_sendingSweeps.removeAll(reply);
+    m_pendingSweeps.remove(reply->requestId());
+
+    qCDebug(dcPing()) << "Sweep finished." << reply->m_durations.count() << "of" << reply->m_targetAddresses.count() << "hosts responded"
+                      << "ID:" << QString("0x%1").arg(reply->requestId(), 4, 16, QChar('0')) << error;
+    emit reply->finished();
+    reply->deleteLater();
+}
+
 void Ping::verifyErrno(int error)
 {
     switch (error) {
@@ -273,7 +430,7 @@ void Ping::timeValueSubtract(timeval *start, timeval *stop)
 quint16 Ping::calculateRequestId()
 {
     quint16 requestId = 0;
-    while (requestId == 0 || m_pendingReplies.contains(requestId)) {
+    while (requestId == 0 || m_pendingReplies.contains(requestId) || m_pendingSweeps.contains(requestId)) {
         requestId = rand();
     }
 
@@ -323,6 +480,32 @@ void Ping::onSocketReadyRead(int socketDescriptor)
                           << "Sequence:" << responsePacket->icmp_seq;
 
         if (responsePacket->icmp_type == ICMP_ECHOREPLY) {
+            PingSweepReply *sweepReply = m_pendingSweeps.value(responsePacket->icmp_id);
+            if (sweepReply) {
+                // Sweep responses are matched by the sequence number, which is the index of the target
+                int sequenceNumber = ntohs(responsePacket->icmp_seq);
+                if (sequenceNumber >= sweepReply->m_targetAddresses.count() || sweepReply->m_sendTimes.at(sequenceNumber) < 0
+                        || sweepReply->m_targetAddresses.at(sequenceNumber) != senderAddress) {
+                    qCDebug(dcPingTraffic()) << "Ignoring unexpected sweep response from" << senderAddress.toString() << "Sequence:" << sequenceNumber;
+                    continue;
+                }
+
+                // Duplicated responses
+                if (sweepReply->m_durations.contains(senderAddress))
+                    continue;
+
+                qint64 nanoSeconds = sweepReply->m_elapsedTimer.nsecsElapsed() - sweepReply->m_sendTimes.at(sequenceNumber);
+                double duration = qRound(nanoSeconds / 10000.0) / 100.0;
+                sweepReply->m_durations.insert(senderAddress, duration);
+                qCDebug(dcPingTraffic()) << "Received ICMP sweep response" << senderAddress.toString() << "Sequence:" << sequenceNumber << "Time:" << duration << "[ms]";
+                emit sweepReply->hostResponded(senderAddress, duration);
+
+                if (sweepReply->m_durations.count() == sweepReply->m_targetAddresses.count()) {
+                    finishSweep(sweepReply, PingReply::ErrorNoError);
+                }
+                continue;
+            }
+
             PingReply *reply = m_pendingReplies.take(responsePacket->icmp_id);
             if (!reply) {
                 qCDebug(dcPing()) << "No pending reply for ping echo response with id" << QString("0x%1").arg(responsePacket->icmp_id, 4, 16, QChar('0')) << "Sequence:" << htons(responsePacket->icmp_seq) << "from" << senderAddress.toString();
@@ -386,6 +569,9 @@ void Ping::onSocketReadyRead(int socketDescriptor)
                               << "ID:" << QString("0x%1").arg(nestedResponsePacket->icmp_id, 4, 16, QChar('0'))
                               << "Sequence:" << htons(nestedResponsePacket->icmp_seq);
 
+            if (m_pendingSweeps.contains(nestedResponsePacket->icmp_id))
+                continue;
+
             PingReply *reply = m_pendingReplies.take(nestedResponsePacket->icmp_id);
             if (!reply) {
                 qCDebug(dcPingTraffic()) << "No pending reply for ping echo response unreachable with ID"
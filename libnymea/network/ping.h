@@ -35,6 +35,7 @@
 #include <QQueue>
 #include <QTimer>
 #include <QObject>
+#include <QElapsedTimer>
 #include <QHostInfo>
 #include <QHostAddress>
 #include <QSocketNotifier>
@@ -42,6 +43,7 @@
 
 #include "libnymea.h"
 #include "pingreply.h"
+#include "pingsweepreply.h"
 
 #include <netinet/ip_icmp.h>
 
@@ -64,6 +66,15 @@ public:
 
     PingReply *ping(const QHostAddress &hostAddress);
 
+    // Sweep mode: one echo request to each target, paced at the configured packets per second
+    int sweepRate() const;
+    void setSweepRate(int packetsPerSecond);
+
+    int sweepTimeout() const;
+    void setSweepTimeout(int timeout);
+
+    PingSweepReply *sweep(const QList<QHostAddress> &targetAddresses);
+
 signals:
     void availableChanged(bool available);
 
@@ -88,8 +99,21 @@ private:
     void sendNextReply();
     QHash<int, PingReply *> m_pendingHostLookups;
 
+    // Sweeps
+    int m_sweepRate = 2000;
+    int m_sweepTimeout = 500;
+    double m_sweepBudget = 0;
+    QTimer *m_sweepTimer = nullptr;
+    QElapsedTimer m_sweepBudgetTimer;
+    QHash<quint16, PingSweepReply *> m_pendingSweeps;
+    QList<PingSweepReply *> m_sendingSweeps;
+    void sendSweepPackets();
+    bool sendSweepPacket(PingSweepReply *reply);
+    void finishSweep(PingSweepReply *reply, PingReply::Error error);
+
     //Error performPing(const QString &address);
     void performPing(PingReply *reply);
+    void buildEchoRequest(struct icmpPacket *requestPacket, quint16 requestId, quint16 sequenceNumber);
     void verifyErrno(int error);
 
     // Helper
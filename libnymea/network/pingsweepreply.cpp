@@ -0,0 +1,72 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2021, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "pingsweepreply.h"
+
+PingSweepReply::PingSweepReply(QObject *parent) : QObject(parent)
+{
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+}
+
+QList<QHostAddress> PingSweepReply::targetAddresses() const
+{
+    return m_targetAddresses;
+}
+
+quint16 PingSweepReply::requestId() const
+{
+    return m_requestId;
+}
+
+int PingSweepReply::sentCount() const
+{
+    return m_nextTarget;
+}
+
+QList<QHostAddress> PingSweepReply::respondedAddresses() const
+{
+    return m_durations.keys();
+}
+
+double PingSweepReply::duration(const QHostAddress &address) const
+{
+    return m_durations.value(address, -1);
+}
+
+bool PingSweepReply::isFinished() const
+{
+    return m_finished;
+}
+
+PingReply::Error PingSweepReply::error() const
+{
+    return m_error;
+}
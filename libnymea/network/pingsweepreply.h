@@ -0,0 +1,83 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2021, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef PINGSWEEPREPLY_H
+#define PINGSWEEPREPLY_H
+
+#include <QHash>
+#include <QTimer>
+#include <QObject>
+#include <QVector>
+#include <QHostAddress>
+#include <QElapsedTimer>
+
+#include "libnymea.h"
+#include "pingreply.h"
+
+class LIBNYMEA_EXPORT PingSweepReply : public QObject
+{
+    Q_OBJECT
+
+    friend class Ping;
+
+public:
+    explicit PingSweepReply(QObject *parent = nullptr);
+
+    QList<QHostAddress> targetAddresses() const;
+    quint16 requestId() const;
+
+    int sentCount() const;
+    QList<QHostAddress> respondedAddresses() const;
+    double duration(const QHostAddress &address) const;
+
+    bool isFinished() const;
+    PingReply::Error error() const;
+
+signals:
+    void hostResponded(const QHostAddress &address, double duration);
+    void finished();
+
+private:
+    QList<QHostAddress> m_targetAddresses;
+    quint16 m_requestId = 0;
+    int m_nextTarget = 0;
+
+    // Send time of each target in ns since the start of the sweep, indexed by the sequence number
+    QElapsedTimer m_elapsedTimer;
+    QVector<qint64> m_sendTimes;
+    QHash<QHostAddress, double> m_durations;
+
+    QTimer *m_timer = nullptr;
+    bool m_finished = false;
+    PingReply::Error m_error = PingReply::ErrorNoError;
+
+};
+
+#endif // PINGSWEEPREPLY_H
@@ -40,6 +40,10 @@
     settings of the system. The different settings are represented ba the \l{SettingsRole} and
     can be used everywhere in the project.
 
+    All NymeaSettings of a role share one cached QSettings instance, which is parsed only once
+    per process. Constructing a NymeaSettings is cheap and access is thread safe. Changes are
+    written to disk when a NymeaSettings gets destroyed or sync() is called.
+
 */
 
 /*! \enum NymeaSettings::SettingsRole
@@ -50,7 +54,7 @@
     \value SettingsRoleDevices
         This role will create the \b{things.conf} file and is used to store the configured \l{Device}{Devices}.
     \value SettingsRoleRules
-        This role will create the \b{rules.conf} file and is used to store the configured \l{nymeaserver::Rule}{Rules}.
+        This role will create the \b{rules.conf} file which was used to store the configured \l{nymeaserver::Rule}{Rules} in earlier versions. The rules are migrated to the \l{nymeaserver::RuleStore} on startup.
     \value SettingsRolePlugins
         This role will create the \b{plugins.conf} file and is used to store the \l{DevicePlugin}{Plugin} configurations.
     \value SettingsRoleGlobal
@@ -78,6 +82,50 @@
 #include <QCoreApplication>
 #include <QDir>
 #include <QDebug>
+#include <QEvent>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+
+// QSettings syncs on its own from the event loop of its thread, that would bypass the lock.
+// Cached instances only sync at the explicit sync points instead.
+class CachedSettings : public QSettings
+{
+public:
+    CachedSettings(const QString &fileName) : QSettings(fileName, QSettings::IniFormat) { }
+
+protected:
+    bool event(QEvent *event) override {
+        if (event->type() == QEvent::UpdateRequest) {
+            return true;
+        }
+        return QSettings::event(event);
+    }
+};
+
+class SettingsCache
+{
+public:
+    ~SettingsCache() {
+        qDeleteAll(settings);
+    }
+
+    QSettings *settingsFor(const QString &fileName) {
+        QMutexLocker locker(&mutex);
+        QSettings *cached = settings.value(fileName);
+        if (!cached) {
+            cached = new CachedSettings(fileName);
+            settings.insert(fileName, cached);
+        }
+        return cached;
+    }
+
+    QMutex mutex;
+    QHash<QString, QSettings*> settings;
+    NymeaSettings::ChangeHandler changeHandler;
+};
+
+Q_GLOBAL_STATIC(SettingsCache, settingsCache)
 
 /*! Constructs a \l{NymeaSettings} instance with the given \a role and \a parent. */
 NymeaSettings::NymeaSettings(const SettingsRole &role, QObject *parent):
@@ -133,14 +181,13 @@ NymeaSettings::NymeaSettings(const SettingsRole &role, QObject *parent):
         fileName = "modbusrtu.conf";
         break;
     }
-    m_settings = new QSettings(basePath + settingsPrefix + fileName, QSettings::IniFormat, this);
+    m_settings = settingsCache()->settingsFor(basePath + settingsPrefix + fileName);
 }
 
-/*! Destructor of the NymeaSettings.*/
+/*! Destructor of the NymeaSettings. Writes pending changes to disk. */
 NymeaSettings::~NymeaSettings()
 {
-    m_settings->sync();
-    delete m_settings;
+    sync();
 }
 
 /*! Returns the \l{SettingsRole} of this \l{NymeaSettings}.*/
@@ -207,78 +254,142 @@ QString NymeaSettings::storagePath()
     return path;
 }
 
+/*! Sets the \a handler called for every change made through any NymeaSettings, e.g. to replicate the
+    configuration. The handler is called from the thread making the change, after the change has been made.
+    Changes of a role are reported in the order they are made. */
+void NymeaSettings::setChangeHandler(const ChangeHandler &handler)
+{
+    QMutexLocker locker(&settingsCache()->mutex);
+    settingsCache()->changeHandler = handler;
+}
+
 /*! Return a list of all settings keys.*/
 QStringList NymeaSettings::allKeys() const
 {
-    return m_settings->allKeys();
+    QMutexLocker locker(&settingsCache()->mutex);
+    m_settings->beginGroup(prefix());
+    QStringList keys = m_settings->allKeys();
+    m_settings->endGroup();
+    return keys;
 }
 
 /*! Adds \a prefix to the current group and starts writing an array of size size. If size is -1 (the default),
  * it is automatically determined based on the indexes of the entries written. */
 void NymeaSettings::beginWriteArray(const QString &prefix)
 {
-    m_settings->beginWriteArray(prefix);
+    // Same as QSettings: the size is written on endArray(), even for empty arrays
+    remove(prefix + "/size");
+    Group group;
+    group.name = prefix;
+    group.array = true;
+    group.writeArray = true;
+    group.size = 0;
+    m_groups.append(group);
 }
 
 /*! Sets the current array index to \a i. */
 void NymeaSettings::setArrayIndex(int i)
 {
-    m_settings->setArrayIndex(i);
+    if (m_groups.isEmpty() || !m_groups.last().array) {
+        qWarning() << "NymeaSettings::setArrayIndex: Missing beginArray()";
+        return;
+    }
+    Group &group = m_groups.last();
+    group.index = qMax(i, 0);
+    if (group.writeArray) {
+        group.size = qMax(group.size, group.index + 1);
+    }
 }
 
 /*! Adds \a prefix to the current group and starts reading from an array. Returns the size of the array.*/
 int NymeaSettings::beginReadArray(const QString &prefix)
 {
-    return m_settings->beginReadArray(prefix);
+    int size = value(prefix + "/size").toInt();
+    Group group;
+    group.name = prefix;
+    group.array = true;
+    group.size = size;
+    m_groups.append(group);
+    return size;
 }
 
 /*! End an array. */
 void NymeaSettings::endArray()
 {
-    m_settings->endArray();
+    if (m_groups.isEmpty() || !m_groups.last().array) {
+        qWarning() << "NymeaSettings::endArray: Expected endGroup() instead";
+        return;
+    }
+    Group group = m_groups.takeLast();
+    if (group.writeArray) {
+        setValue(group.name + "/size", group.size);
+    }
 }
 
 /*! Begins a new group with the given \a prefix.*/
 void NymeaSettings::beginGroup(const QString &prefix)
 {
-    m_settings->beginGroup(prefix);
+    Group group;
+    group.name = prefix;
+    m_groups.append(group);
 }
 
 /*! Returns a list of all key top-level groups that contain keys that can be read
  *  using the \l{NymeaSettings} object.*/
 QStringList NymeaSettings::childGroups() const
 {
-    return m_settings->childGroups();
+    QMutexLocker locker(&settingsCache()->mutex);
+    m_settings->beginGroup(prefix());
+    QStringList groups = m_settings->childGroups();
+    m_settings->endGroup();
+    return groups;
 }
 
 /*! Returns a list of all top-level keys that can be read using the \l{NymeaSettings} object.*/
 QStringList NymeaSettings::childKeys() const
 {
-    return m_settings->childKeys();
+    QMutexLocker locker(&settingsCache()->mutex);
+    m_settings->beginGroup(prefix());
+    QStringList keys = m_settings->childKeys();
+    m_settings->endGroup();
+    return keys;
 }
 
 /*! Removes all entries in the primary location associated to this \l{NymeaSettings} object.*/
 void NymeaSettings::clear()
 {
-    m_settings->clear();
+    ChangeHandler handler;
+    {
+        QMutexLocker locker(&settingsCache()->mutex);
+        m_settings->clear();
+        handler = settingsCache()->changeHandler;
+    }
+    if (handler) {
+        handler(m_role, ChangeClear, QString(), QVariant());
+    }
 }
 
 /*! Returns true if there exists a setting called \a key; returns false otherwise. */
 bool NymeaSettings::contains(const QString &key) const
 {
-    return m_settings->contains(key);
+    QMutexLocker locker(&settingsCache()->mutex);
+    return m_settings->contains(this->key(key));
 }
 
 /*! Resets the group to what it was before the corresponding beginGroup() call. */
 void NymeaSettings::endGroup()
 {
-    m_settings->endGroup();
+    if (m_groups.isEmpty() || m_groups.last().array) {
+        qWarning() << "NymeaSettings::endGroup: No matching beginGroup()";
+        return;
+    }
+    m_groups.removeLast();
 }
 
 /*! Returns the current group. */
 QString NymeaSettings::group() const
 {
-    return m_settings->group();
+    return prefix();
 }
 
 /*! Returns the path where settings written using this \l{NymeaSettings} object are stored. */
@@ -290,24 +401,69 @@ QString NymeaSettings::fileName() const
 /*! Returns true if settings can be written using this \l{NymeaSettings} object; returns false otherwise. */
 bool NymeaSettings::isWritable() const
 {
+    QMutexLocker locker(&settingsCache()->mutex);
     return m_settings->isWritable();
 }
 
 /*! Removes the setting key and any sub-settings of \a key. */
 void NymeaSettings::remove(const QString &key)
 {
-    m_settings->remove(key);
+    ChangeHandler handler;
+    {
+        QMutexLocker locker(&settingsCache()->mutex);
+        m_settings->beginGroup(prefix());
+        m_settings->remove(key);
+        m_settings->endGroup();
+        handler = settingsCache()->changeHandler;
+    }
+    if (handler) {
+        handler(m_role, ChangeRemove, key.isEmpty() ? prefix() : this->key(key), QVariant());
+    }
 }
 
 /*! Sets the \a value of setting \a key to value. If the \a key already exists, the previous value is overwritten. */
 void NymeaSettings::setValue(const QString &key, const QVariant &value)
 {
-    m_settings->setValue(key, value);
+    ChangeHandler handler;
+    {
+        QMutexLocker locker(&settingsCache()->mutex);
+        m_settings->setValue(this->key(key), value);
+        handler = settingsCache()->changeHandler;
+    }
+    if (handler) {
+        handler(m_role, ChangeValue, this->key(key), value);
+    }
 }
 
 /*! Returns the value for setting \a key. If the setting doesn't exist, returns \a defaultValue. */
 QVariant NymeaSettings::value(const QString &key, const QVariant &defaultValue) const
 {
-    return m_settings->value(key, defaultValue);
+    QMutexLocker locker(&settingsCache()->mutex);
+    return m_settings->value(this->key(key), defaultValue);
 }
 
+/*! Writes pending changes to disk and reloads the file if it has been changed by another process. */
+void NymeaSettings::sync()
+{
+    QMutexLocker locker(&settingsCache()->mutex);
+    m_settings->sync();
+}
+
+QString NymeaSettings::prefix() const
+{
+    QStringList path;
+    foreach (const Group &group, m_groups) {
+        path.append(group.name);
+        // QSettings stores array entries 1-based
+        if (group.array && group.index >= 0) {
+            path.append(QString::number(group.index + 1));
+        }
+    }
+    return path.join('/');
+}
+
+QString NymeaSettings::key(const QString &key) const
+{
+    QString prefix = this->prefix();
+    return prefix.isEmpty() ? key : prefix + '/' + key;
+}
@@ -34,6 +34,8 @@
 #include <QObject>
 #include <QVariant>
 
+#include <functional>
+
 #include "libnymea.h"
 
 class QSettings;
@@ -57,6 +59,16 @@ public:
     };
     Q_ENUM(SettingsRole)
 
+    enum Change {
+        ChangeValue,
+        ChangeRemove,
+        ChangeClear
+    };
+    Q_ENUM(Change)
+
+    // Called with the full key of each change, from the thread making the change
+    typedef std::function<void(SettingsRole role, Change change, const QString &key, const QVariant &value)> ChangeHandler;
+
     explicit NymeaSettings(const SettingsRole &role = SettingsRoleNone, QObject *parent = nullptr);
     ~NymeaSettings();
 
@@ -67,6 +79,8 @@ public:
     static QString translationsPath();
     static QString storagePath();
 
+    static void setChangeHandler(const ChangeHandler &handler);
+
     // forwarded QSettings methods
     QStringList	allKeys() const;
     void beginWriteArray(const QString &prefix);
@@ -87,10 +101,25 @@ public:
     void setValue(const QString & key, const QVariant &value);
     QVariant value(const QString & key, const QVariant & defaultValue = QVariant()) const;
 
+    void sync();
+
 private:
+    // Group and array state of this handle, the QSettings instance is shared by all handles of a file
+    class Group {
+    public:
+        QString name;
+        bool array = false;
+        bool writeArray = false;
+        int index = -1;
+        int size = -1;
+    };
+
     QSettings *m_settings;
     SettingsRole m_role;
+    QList<Group> m_groups;
 
+    QString prefix() const;
+    QString key(const QString &key) const;
 };
 
 #endif // NYMEASETTINGS_H
@@ -110,7 +110,7 @@
 */
 
 /*! \fn void PluginTimer::currentTickChanged(const int &currentTick);
-    This signal will be emitted whenever the \a currentTick of this PluginTimer changed.
+    This signal will be emitted whenever the \a currentTick of this PluginTimer changed, at most once per second.
 
     \sa currentTick()
 */
@@ -46,69 +46,112 @@
 
 #include "actiontype.h"
 
+class ActionTypePrivate: public QSharedData
+{
+public:
+    ActionTypeId m_id;
+    QString m_name;
+    QString m_displayName;
+    int m_index = 0;
+    ParamTypes m_paramTypes;
+    bool m_coalesce = false;
+};
+
 /*! Constructs an \l{ActionType} with the given \a id. */
 ActionType::ActionType(const ActionTypeId &id):
-    m_id(id),
-    m_index(0)
+    d(new ActionTypePrivate)
+{
+    d->m_id = id;
+}
+
+ActionType::ActionType(const ActionType &other):
+    d(other.d)
+{
+
+}
+
+ActionType::~ActionType()
 {
 
 }
 
+ActionType &ActionType::operator=(const ActionType &other)
+{
+    d = other.d;
+    return *this;
+}
+
 /*! Returns the id of this \l{ActionType}. */
 ActionTypeId ActionType::id() const
 {
-    return m_id;
+    return d->m_id;
 }
 
 /*! Returns the name of this \l{ActionType}. */
 QString ActionType::name() const
 {
-    return m_name;
+    return d->m_name;
 }
 
 /*! Set the \a name for this \l{ActionType}. */
 void ActionType::setName(const QString &name)
 {
-    m_name = name;
+    d->m_name = name;
 }
 
 /*! Returns the display name of this \l{ActionType}. */
 QString ActionType::displayName() const
 {
-    return m_displayName;
+    return d->m_displayName;
 }
 
 /*! Set the \a displayName for this \l{ActionType}. This will be visible to the user. */
 void ActionType::setDisplayName(const QString &displayName)
 {
-    m_displayName = displayName;
+    d->m_displayName = displayName;
 }
 
 /*! Returns the index of this \l{ActionType}. The index of an \l{ActionType} indicates the order in the \l{DeviceClass}.
  *  This guarantees that a \l{Device} will look always the same (\l{Action} order). */
 int ActionType::index() const
 {
-    return m_index;
+    return d->m_index;
 }
 
 /*! Set the \a index of this \l{ActionType}. */
 void ActionType::setIndex(const int &index)
 {
-    m_index = index;
+    d->m_index = index;
 }
 
 /*! Returns the parameter description of this \l{ActionType}. \l{Action}{Actions} created
  *  from this \l{ActionType} must have their parameters matching to this template. */
 ParamTypes ActionType::paramTypes() const
 {
-    return m_paramTypes;
+    return d->m_paramTypes;
 }
 
 /*! Set the parameter description of this \l{ActionType}. \l{Action}{Actions} created
  *  from this \l{ActionType} must have their \a paramTypes matching to this template. */
 void ActionType::setParamTypes(const ParamTypes &paramTypes)
 {
-    m_paramTypes = paramTypes;
+    d->m_paramTypes = paramTypes;
+}
+
+/*! Returns true if \l{Action}{Actions} of this \l{ActionType} are coalesced. While an action of this type is
+ *  being executed on a thing, newer ones don't queue up behind it. Only the latest one is kept and executed
+ *  afterwards, the ones it replaces finish with \l{Thing::ThingErrorActionSuperseded}. This is meant for
+ *  actions setting a writable state, like a dimmer being dragged. */
+bool ActionType::coalesce() const
+{
+    return d->m_coalesce;
+}
+
+/*! Sets whether \l{Action}{Actions} of this \l{ActionType} are coalesced to \a coalesce. The plugin metadata
+ *  enables it with the \c coalesceActions property of a writable state type. */
+void ActionType::setCoalesce(bool coalesce)
+{
+    d->m_coalesce = coalesce;
 }
 
 /*! Returns a list of all valid properties a ActionType definition can have. */
@@ -36,6 +36,9 @@
 #include "paramtype.h"
 
 #include <QVariantList>
+#include <QSharedDataPointer>
+
+class ActionTypePrivate;
 
 class LIBNYMEA_EXPORT ActionType
 {
@@ -48,6 +51,9 @@ class LIBNYMEA_EXPORT ActionType
 
 public:
     ActionType(const ActionTypeId &id = ActionTypeId());
+    ActionType(const ActionType &other);
+    ~ActionType();
+    ActionType &operator=(const ActionType &other);
 
     ActionTypeId id() const;
 
@@ -63,15 +69,14 @@ public:
     ParamTypes paramTypes() const;
     void setParamTypes(const ParamTypes &paramTypes);
 
+    bool coalesce() const;
+    void setCoalesce(bool coalesce);
+
     static QStringList typeProperties();
     static QStringList mandatoryTypeProperties();
 
 private:
-    ActionTypeId m_id;
-    QString m_name;
-    QString m_displayName;
-    int m_index;
-    ParamTypes m_paramTypes;
+    QSharedDataPointer<ActionTypePrivate> d;
 };
 Q_DECLARE_METATYPE(ActionType)
 
@@ -40,90 +40,118 @@
 
 #include "eventtype.h"
 
-EventType::EventType()
+class EventTypePrivate: public QSharedData
+{
+public:
+    EventTypeId m_id;
+    QString m_name;
+    QString m_displayName;
+    int m_index = 0;
+    QList<ParamType> m_paramTypes;
+    bool m_logged = false;
+};
+
+EventType::EventType():
+    d(new EventTypePrivate)
 {
 
 }
 
 /*! Constructs a EventType object with the given \a id. */
 EventType::EventType(const EventTypeId &id):
-    m_id(id),
-    m_index(0)
+    d(new EventTypePrivate)
+{
+    d->m_id = id;
+}
+
+EventType::EventType(const EventType &other):
+    d(other.d)
+{
+
+}
+
+EventType::~EventType()
 {
 
 }
 
+EventType &EventType::operator=(const EventType &other)
+{
+    d = other.d;
+    return *this;
+}
+
 /*! Returns the id. */
 EventTypeId EventType::id() const
 {
-    return m_id;
+    return d->m_id;
 }
 
 /*! Returns the name of this EventType. */
 QString EventType::name() const
 {
-    return m_name;
+    return d->m_name;
 }
 
 /*! Set the name for this EventType to \a name. */
 void EventType::setName(const QString &name)
 {
-    m_name = name;
+    d->m_name = name;
 }
 
 /*! Returns the displayName of this EventType, e.g. "Temperature changed". */
 QString EventType::displayName() const
 {
-    return m_displayName;
+    return d->m_displayName;
 }
 
 /*! Set the displayName for this EventType to \a displayName, e.g. "Temperature changed". */
 void EventType::setDisplayName(const QString &displayName)
 {
-    m_displayName = displayName;
+    d->m_displayName = displayName;
 }
 
 /*! Returns the index of this \l{EventType}. The index of an \l{EventType} indicates the order in the \l{DeviceClass}.
  *  This guarantees that a \l{Device} will look always the same (\l{Event} order). */
 int EventType::index() const
 {
-    return m_index;
+    return d->m_index;
 }
 
 /*! Set the \a index of this \l{EventType}. */
 void EventType::setIndex(const int &index)
 {
-    m_index = index;
+    d->m_index = index;
 }
 
 /*! Holds a List describing possible parameters for a \l{Event} of this EventType.
  *  e.g. QList(ParamType("temperature", QVariant::Real)). */
 ParamTypes EventType::paramTypes() const
 {
-    return m_paramTypes;
+    return d->m_paramTypes;
 }
 
 /*! Set the parameter description for this EventType to \a paramTypes,
  *  e.g. QList<ParamType>() << ParamType("temperature", QVariant::Real)). */
 void EventType::setParamTypes(const ParamTypes &paramTypes)
 {
-    m_paramTypes = paramTypes;
+    d->m_paramTypes = paramTypes;
 }
 
 bool EventType::suggestLogging() const
 {
-    return m_logged;
+    return d->m_logged;
 }
 
 void EventType::setSuggestLogging(bool logged)
 {
-    m_logged = logged;
+    d->m_logged = logged;
 }
 
 /*! Returns true if this EventType has a valid id and name */
 bool EventType::isValid() const
 {
-    return !m_id.isNull() && !m_name.isEmpty();
+    return !d->m_id.isNull() && !d->m_name.isEmpty();
 }
 
 /*! Returns a list of all valid JSON properties a EventType JSON definition can have. */
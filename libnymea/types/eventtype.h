@@ -36,6 +36,9 @@
 #include "paramtype.h"
 
 #include <QVariantMap>
+#include <QSharedDataPointer>
+
+class EventTypePrivate;
 
 class LIBNYMEA_EXPORT EventType
 {
@@ -49,6 +52,9 @@ class LIBNYMEA_EXPORT EventType
 public:
     EventType();
     EventType(const EventTypeId &id);
+    EventType(const EventType &other);
+    ~EventType();
+    EventType &operator=(const EventType &other);
 
     EventTypeId id() const;
 
@@ -73,12 +79,7 @@ public:
     static QStringList mandatoryTypeProperties();
 
 private:
-    EventTypeId m_id;
-    QString m_name;
-    QString m_displayName;
-    int m_index;
-    QList<ParamType> m_paramTypes;
-    bool m_logged = false;
+    QSharedDataPointer<EventTypePrivate> d;
 };
 Q_DECLARE_METATYPE(EventType)
 
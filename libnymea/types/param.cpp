@@ -131,46 +131,60 @@ void ParamList::put(const QVariant &variant)
     append(variant.value<Param>());
 }
 
-/*! Returns true if this ParamList contains a Param with the given \a paramTypeId. */
-bool ParamList::hasParam(const ParamTypeId &paramTypeId) const
+/*! Returns the index of the Param with the given \a paramTypeId, or -1 if there is none. Use this instead of
+    hasParam() followed by paramValue() to look the param up only once. */
+int ParamList::paramIndex(const ParamTypeId &paramTypeId) const
 {
-    foreach (const Param &param, *this) {
-        if (param.paramTypeId() == paramTypeId)
-            return true;
+    // Param lists are short, a plain scan without copying the list beats any index
+    for (int i = 0; i < count(); i++) {
+        if (at(i).paramTypeId() == paramTypeId) {
+            return i;
+        }
     }
+    return -1;
+}
 
-    return false;
+/*! Returns true if this ParamList contains a Param with the given \a paramTypeId. */
+bool ParamList::hasParam(const ParamTypeId &paramTypeId) const
+{
+    return paramIndex(paramTypeId) >= 0;
 }
 
 /*! Returns the value of the Param with the given \a paramTypeId. */
 QVariant ParamList::paramValue(const ParamTypeId &paramTypeId) const
 {
-    foreach (const Param &param, *this) {
-        if (param.paramTypeId() == paramTypeId)
-            return param.value();
-
-    }
-
-    return QVariant();
+    int index = paramIndex(paramTypeId);
+    return index >= 0 ? at(index).value() : QVariant();
 }
 
 /*! Returns true if the value of a Param with the given \a paramTypeId could be set to the given \a value. */
 bool ParamList::setParamValue(const ParamTypeId &paramTypeId, const QVariant &value)
 {
-    for (int i = 0; i < count(); i++) {
-        if (this->operator [](i).paramTypeId() == paramTypeId) {
-            this->operator [](i).setValue(value);
-            return true;
-        }
+    int index = paramIndex(paramTypeId);
+    if (index < 0) {
+        return false;
     }
+    (*this)[index].setValue(value);
+    return true;
+}
 
-    return false;
+/*! Appends a Param with the given \a paramTypeId and \a value and returns a reference to this list, so params
+    can be built in place:
+
+    \code
+    ParamList params;
+    params.add(exampleTemperatureParamTypeId, 21.5).add(exampleHumidityParamTypeId, 40);
+    \endcode
+*/
+ParamList &ParamList::add(const ParamTypeId &paramTypeId, const QVariant &value)
+{
+    append(Param(paramTypeId, value));
+    return *this;
 }
 
 /*! Appends the given \a param to a ParamList. */
-ParamList ParamList::operator<<(const Param &param)
+ParamList &ParamList::operator<<(const Param &param)
 {
-    this->append(param);
-    m_ids.append(param.paramTypeId());
+    append(param);
     return *this;
 }
@@ -71,14 +71,12 @@ public:
     ParamList(std::initializer_list<Param> args):QList(args) {}
     Q_INVOKABLE QVariant get(int index);
     Q_INVOKABLE void put(const QVariant &variant);
+    int paramIndex(const ParamTypeId &paramTypeId) const;
     bool hasParam(const ParamTypeId &paramTypeId) const;
     QVariant paramValue(const ParamTypeId &paramTypeId) const;
     bool setParamValue(const ParamTypeId &paramTypeId, const QVariant &value);
-    ParamList operator<<(const Param &param);
-
-private:
-    QList<ParamTypeId> m_ids;
-
+    ParamList &add(const ParamTypeId &paramTypeId, const QVariant &value);
+    ParamList &operator<<(const Param &param);
 };
 Q_DECLARE_METATYPE(ParamList)
 QDebug operator<<(QDebug dbg, const ParamList &params);
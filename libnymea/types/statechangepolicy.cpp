@@ -0,0 +1,128 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+  \class StateChangePolicy
+  \brief Describes which changes of a \l{State} are worth announcing.
+
+  \ingroup nymea-types
+  \inmodule libnymea
+
+  A change of a numeric state smaller than the deadband is discarded. The deadband is the larger one of
+  the absolute deadband() and the relativeDeadband() fraction of the current value. Once maxInterval()
+  milliseconds passed since the last change, any change is taken again regardless of the deadband.
+  Changes following the last one within less than minInterval() milliseconds are held back and the latest
+  of them is applied once the interval has passed.
+
+  All values default to 0, which disables the respective limit.
+
+  \sa StateType, Thing
+*/
+
+#include "statechangepolicy.h"
+
+StateChangePolicy::StateChangePolicy()
+{
+
+}
+
+/*! Returns the absolute deadband. */
+double StateChangePolicy::deadband() const
+{
+    return m_deadband;
+}
+
+/*! Sets the absolute \a deadband. */
+void StateChangePolicy::setDeadband(double deadband)
+{
+    m_deadband = deadband;
+}
+
+/*! Returns the deadband relative to the current value, e.g. 0.01 for one percent. */
+double StateChangePolicy::relativeDeadband() const
+{
+    return m_relativeDeadband;
+}
+
+/*! Sets the deadband relative to the current value to \a relativeDeadband. */
+void StateChangePolicy::setRelativeDeadband(double relativeDeadband)
+{
+    m_relativeDeadband = relativeDeadband;
+}
+
+/*! Returns the minimum time between two changes in milliseconds. */
+uint StateChangePolicy::minInterval() const
+{
+    return m_minInterval;
+}
+
+/*! Sets the minimum time between two changes to \a minInterval milliseconds. */
+void StateChangePolicy::setMinInterval(uint minInterval)
+{
+    m_minInterval = minInterval;
+}
+
+/*! Returns the time in milliseconds after which the deadband is ignored. */
+uint StateChangePolicy::maxInterval() const
+{
+    return m_maxInterval;
+}
+
+/*! Sets the time after which the deadband is ignored to \a maxInterval milliseconds. */
+void StateChangePolicy::setMaxInterval(uint maxInterval)
+{
+    m_maxInterval = maxInterval;
+}
+
+/*! Returns true if no limit is set and every change is taken. */
+bool StateChangePolicy::isNull() const
+{
+    return qFuzzyIsNull(m_deadband) && qFuzzyIsNull(m_relativeDeadband) && m_minInterval == 0 && m_maxInterval == 0;
+}
+
+bool StateChangePolicy::operator==(const StateChangePolicy &other) const
+{
+    return qFuzzyCompare(1 + m_deadband, 1 + other.m_deadband)
+            && qFuzzyCompare(1 + m_relativeDeadband, 1 + other.m_relativeDeadband)
+            && m_minInterval == other.m_minInterval
+            && m_maxInterval == other.m_maxInterval;
+}
+
+bool StateChangePolicy::operator!=(const StateChangePolicy &other) const
+{
+    return !operator==(other);
+}
+
+QDebug operator<<(QDebug dbg, const StateChangePolicy &policy)
+{
+    dbg.nospace() << "StateChangePolicy(deadband: " << policy.deadband() << ", relativeDeadband: " << policy.relativeDeadband()
+                  << ", minInterval: " << policy.minInterval() << ", maxInterval: " << policy.maxInterval() << ")";
+    return dbg.space();
+}
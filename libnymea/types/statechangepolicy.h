@@ -0,0 +1,77 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef STATECHANGEPOLICY_H
+#define STATECHANGEPOLICY_H
+
+#include "libnymea.h"
+
+#include <QObject>
+#include <QDebug>
+
+class LIBNYMEA_EXPORT StateChangePolicy
+{
+    Q_GADGET
+    Q_PROPERTY(double deadband READ deadband WRITE setDeadband USER true)
+    Q_PROPERTY(double relativeDeadband READ relativeDeadband WRITE setRelativeDeadband USER true)
+    Q_PROPERTY(uint minInterval READ minInterval WRITE setMinInterval USER true)
+    Q_PROPERTY(uint maxInterval READ maxInterval WRITE setMaxInterval USER true)
+
+public:
+    StateChangePolicy();
+
+    double deadband() const;
+    void setDeadband(double deadband);
+
+    double relativeDeadband() const;
+    void setRelativeDeadband(double relativeDeadband);
+
+    uint minInterval() const;
+    void setMinInterval(uint minInterval);
+
+    uint maxInterval() const;
+    void setMaxInterval(uint maxInterval);
+
+    bool isNull() const;
+
+    bool operator==(const StateChangePolicy &other) const;
+    bool operator!=(const StateChangePolicy &other) const;
+
+private:
+    double m_deadband = 0;
+    double m_relativeDeadband = 0;
+    uint m_minInterval = 0;
+    uint m_maxInterval = 0;
+};
+Q_DECLARE_METATYPE(StateChangePolicy)
+
+QDebug operator<<(QDebug dbg, const StateChangePolicy &policy);
+
+#endif // STATECHANGEPOLICY_H
@@ -40,6 +40,10 @@
     A StateDescriptor uses either a \l{DeviceId}/\l{StateTypeId} pair to describe a \l{State} or
     a pair of strings describing the interface and interface action for a \l{State}.
 
+    Optionally, the described condition can be required to hold for a number of seconds before the
+    descriptor matches (\l{holdTime}), and a matching descriptor with a numeric ordering operator can be
+    kept matching until the value leaves the condition by more than the \l{hysteresis}.
+
     \sa State, nymeaserver::Rule
 
 */
@@ -172,6 +176,29 @@ void StateDescriptor::setOperatorType(Types::ValueOperator opertatorType)
     m_operatorType = opertatorType;
 }
 
+/*! Returns the number of seconds the described condition must hold before this \l{StateDescriptor} matches. */
+uint StateDescriptor::holdTime() const
+{
+    return m_holdTime;
+}
+
+void StateDescriptor::setHoldTime(uint holdTime)
+{
+    m_holdTime = holdTime;
+}
+
+/*! Returns the hysteresis of this \l{StateDescriptor}. Once matching, a descriptor with a greater or less
+    operator and a numeric value keeps matching until the state value is past the value by more than this. */
+double StateDescriptor::hysteresis() const
+{
+    return m_hysteresis;
+}
+
+void StateDescriptor::setHysteresis(double hysteresis)
+{
+    m_hysteresis = hysteresis;
+}
+
 /*! Compare this StateDescriptor to \a other.
  *  StateDescriptors are equal (returns true) if stateTypeId, stateValue and operatorType match. */
 bool StateDescriptor::operator ==(const StateDescriptor &other) const
@@ -181,7 +208,9 @@ bool StateDescriptor::operator ==(const StateDescriptor &other) const
             m_interface == other.interface() &&
             m_interfaceState == other.interfaceState() &&
             m_stateValue == other.stateValue() &&
-            m_operatorType == other.operatorType();
+            m_operatorType == other.operatorType() &&
+            m_holdTime == other.holdTime() &&
+            qFuzzyCompare(1.0 + m_hysteresis, 1.0 + other.hysteresis());
 }
 
 /*! Returns the true if this \l{StateDescriptor} is valid. A valid \l{StateDescriptor} must
@@ -200,6 +229,7 @@ QDebug operator<<(QDebug dbg, const StateDescriptor &stateDescriptor)
     dbg.nospace() << "StateDescriptor(ThingId:" << stateDescriptor.thingId().toString() << ", StateTypeId:"
                   << stateDescriptor.stateTypeId().toString() << ", Interface:" << stateDescriptor.interface()
                   << ", InterfaceState:" << stateDescriptor.interfaceState() << ", Operator:" << stateDescriptor.operatorType() << ", Value:" << stateDescriptor.stateValue()
-                  << ", ValueThing:" << stateDescriptor.valueThingId().toString() << ", ValueStateTypeId:" << stateDescriptor.valueStateTypeId().toString();
+                  << ", ValueThing:" << stateDescriptor.valueThingId().toString() << ", ValueStateTypeId:" << stateDescriptor.valueStateTypeId().toString()
+                  << ", HoldTime:" << stateDescriptor.holdTime() << ", Hysteresis:" << stateDescriptor.hysteresis();
     return dbg;
 }
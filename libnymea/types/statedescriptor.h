@@ -53,6 +53,8 @@ class LIBNYMEA_EXPORT StateDescriptor
     Q_PROPERTY(QUuid valueThingId READ valueThingId WRITE setValueThingId USER true)
     Q_PROPERTY(QUuid valueStateTypeId READ valueStateTypeId WRITE setValueStateTypeId USER true)
     Q_PROPERTY(Types::ValueOperator operator READ operatorType WRITE setOperatorType)
+    Q_PROPERTY(uint holdTime READ holdTime WRITE setHoldTime USER true)
+    Q_PROPERTY(double hysteresis READ hysteresis WRITE setHysteresis USER true)
 public:
     enum Type {
         TypeThing,
@@ -89,6 +91,12 @@ public:
     Types::ValueOperator operatorType() const;
     void setOperatorType(Types::ValueOperator opertatorType);
 
+    uint holdTime() const;
+    void setHoldTime(uint holdTime);
+
+    double hysteresis() const;
+    void setHysteresis(double hysteresis);
+
     Q_INVOKABLE bool isValid() const;
 
     bool operator ==(const StateDescriptor &other) const;
@@ -102,6 +110,8 @@ private:
     ThingId m_valueThingId;
     StateTypeId m_valueStateTypeId;
     Types::ValueOperator m_operatorType = Types::ValueOperatorEquals;
+    uint m_holdTime = 0;
+    double m_hysteresis = 0;
 };
 Q_DECLARE_METATYPE(StateDescriptor)
 
@@ -41,7 +41,29 @@
 
 #include "statetype.h"
 
-StateType::StateType()
+class StateTypePrivate: public QSharedData
+{
+public:
+    StateTypeId m_id;
+    QString m_name;
+    QString m_displayName;
+    int m_index = 0;
+    QVariant::Type m_type = QVariant::Invalid;
+    QVariant m_defaultValue;
+    QVariant m_minValue;
+    QVariant m_maxValue;
+    QVariantList m_possibleValues;
+    Types::Unit m_unit = Types::UnitNone;
+    Types::IOType m_ioType = Types::IOTypeNone;
+    bool m_writable = false;
+    bool m_cached = true;
+    bool m_logged = false;
+    Types::StateValueFilter m_filter = Types::StateValueFilterNone;
+    StateChangePolicy m_changePolicy;
+};
+
+StateType::StateType():
+    d(new StateTypePrivate)
 {
 
 }
@@ -50,188 +72,217 @@ StateType::StateType()
  *  When creating a \l{DevicePlugin} generate a new uuid for each StateType you define and
  *  hardcode it into the plugin json file. */
 StateType::StateType(const StateTypeId &id):
-    m_id(id)
+    d(new StateTypePrivate)
+{
+    d->m_id = id;
+}
+
+StateType::StateType(const StateType &other):
+    d(other.d)
+{
+
+}
+
+StateType::~StateType()
 {
 
 }
 
+StateType &StateType::operator=(const StateType &other)
+{
+    d = other.d;
+    return *this;
+}
+
 /*! Returns the id of the StateType. */
 StateTypeId StateType::id() const
 {
-    return m_id;
+    return d->m_id;
 }
 
 /*! Returns the name of the StateType. This is used internally, e.g. to match \l{Interfaces for DeviceClasses}{interfaces}. */
 QString StateType::name() const
 {
-    return m_name;
+    return d->m_name;
 }
 
 /*! Set the name of the StateType to \a name. This is used internally, e.g. to match \l{Interfaces for DeviceClasses}{interfaces}. */
 void StateType::setName(const QString &name)
 {
-    m_name = name;
+    d->m_name = name;
 }
 
 /*! Returns the displayName of the StateType. This is visible to the user (e.g. "Color temperature"). */
 QString StateType::displayName() const
 {
-    return m_displayName;
+    return d->m_displayName;
 }
 
 /*! Set the displayName of the StateType to \a displayName. This is visible to the user (e.g. "Color temperature"). */
 void StateType::setDisplayName(const QString &displayName)
 {
-    m_displayName = displayName;
+    d->m_displayName = displayName;
 }
 
 /*! Returns the index of this \l{StateType}. The index of an \l{StateType} indicates the order in the \l{DeviceClass}.
  *  This guarantees that a \l{Device} will look always the same (\l{State} order). */
 int StateType::index() const
 {
-    return m_index;
+    return d->m_index;
 }
 
 /*! Set the \a index of this \l{StateType}. */
 void StateType::setIndex(const int &index)
 {
-    m_index = index;
+    d->m_index = index;
 }
 
 /*! Returns the Type of the StateType (e.g. QVariant::Real). */
 QVariant::Type StateType::type() const
 {
-    return m_type;
+    return d->m_type;
 }
 
 /*! Set the type fo the StateType to \a type (e.g. QVariant::Real). */
 void StateType::setType(const QVariant::Type &type)
 {
-    m_type = type;
+    d->m_type = type;
 }
 
 /*! Returns the default value of this StateType (e.g. 21.5). */
 QVariant StateType::defaultValue() const
 {
-    return m_defaultValue;
+    return d->m_defaultValue;
 }
 
 /*! Set the default value of this StateType to \a defaultValue (e.g. 21.5). */
 void StateType::setDefaultValue(const QVariant &defaultValue)
 {
-    m_defaultValue = defaultValue;
+    d->m_defaultValue = defaultValue;
 }
 
 /*! Returns the minimum value of this StateType. If this value is not set, the QVariant will be invalid. */
 QVariant StateType::minValue() const
 {
-    return m_minValue;
+    return d->m_minValue;
 }
 
 /*! Set the minimum value of this StateType to \a minValue. If this value is not set,
  *  there is now lower limit. */
 void StateType::setMinValue(const QVariant &minValue)
 {
-    m_minValue = minValue;
+    d->m_minValue = minValue;
 }
 
 /*! Returns the maximum value of this StateType. If this value is not set, the QVariant will be invalid. */
 QVariant StateType::maxValue() const
 {
-    return m_maxValue;
+    return d->m_maxValue;
 }
 
 /*! Set the maximum value of this StateType to \a maxValue. If this value is not set,
  *  there is now upper limit. */
 void StateType::setMaxValue(const QVariant &maxValue)
 {
-    m_maxValue = maxValue;
+    d->m_maxValue = maxValue;
 }
 
 /*! Returns the list of possible values of this StateType. If the list is empty or invalid the \l{State} value can take every value. */
 QVariantList StateType::possibleValues() const
 {
-    return m_possibleValues;
+    return d->m_possibleValues;
 }
 
 /*! Set the list of possible values of this StateType to \a possibleValues. */
 void StateType::setPossibleValues(const QVariantList &possibleValues)
 {
-    m_possibleValues = possibleValues;
+    d->m_possibleValues = possibleValues;
 }
 
 /*! Returns the unit of this StateType. */
 Types::Unit StateType::unit() const
 {
-    return m_unit;
+    return d->m_unit;
 }
 
 /*! Sets the unit of this StateType to the given \a unit. */
 void StateType::setUnit(const Types::Unit &unit)
 {
-    m_unit = unit;
+    d->m_unit = unit;
 }
 
 /*! Returns the IO type of this StateType. */
 Types::IOType StateType::ioType() const
 {
-    return m_ioType;
+    return d->m_ioType;
 }
 
 /*! Sets the IO type of this StateType. */
 void StateType::setIOType(Types::IOType ioType)
 {
-    m_ioType = ioType;
+    d->m_ioType = ioType;
 }
 
 /*! Returns whether the StateType is writable or not. A writable StateType will have an according ActionType defined.*/
 bool StateType::writable() const
 {
-    return m_writable;
+    return d->m_writable;
 }
 
 /*! Sets the writable property to true */
 void StateType::setWritable(bool writable)
 {
-    m_writable = writable;
+    d->m_writable = writable;
 }
 
 /*! Returns true if this StateType is to be cached. This means, the last state value will be stored to disk upon shutdown and restored on reboot. If this is false, states will be initialized with the default value on each boot. By default all states are cached by the system. */
 bool StateType::cached() const
 {
-    return m_cached;
+    return d->m_cached;
 }
 
 /*! Sets whether this StateType should be \a cached or not. If a state value gets cached, the state will be initialized with the cached value on start.*/
 void StateType::setCached(bool cached)
 {
-    m_cached = cached;
+    d->m_cached = cached;
 }
 
 bool StateType::suggestLogging() const
 {
-    return m_logged;
+    return d->m_logged;
 }
 
 void StateType::setSuggestLogging(bool logged)
 {
-    m_logged = logged;
+    d->m_logged = logged;
 }
 
 Types::StateValueFilter StateType::filter() const
 {
-    return m_filter;
+    return d->m_filter;
 }
 
 void StateType::setFilter(Types::StateValueFilter filter)
 {
-    m_filter = filter;
+    d->m_filter = filter;
+}
+
+/*! Returns the default \l{StateChangePolicy} for states of this type. */
+StateChangePolicy StateType::changePolicy() const
+{
+    return d->m_changePolicy;
+}
+
+/*! Sets the default \l{StateChangePolicy} for states of this type to \a changePolicy. */
+void StateType::setChangePolicy(const StateChangePolicy &changePolicy)
+{
+    d->m_changePolicy = changePolicy;
 }
 
 /*! Returns true if this state type has an ID, a type and a name set. */
 bool StateType::isValid() const
 {
-    return !m_id.isNull() && m_type != QVariant::Invalid && !m_name.isEmpty();
+    return !d->m_id.isNull() && d->m_type != QVariant::Invalid && !d->m_name.isEmpty();
 }
 
 StateTypes::StateTypes(const QList<StateType> &other)
@@ -33,8 +33,12 @@
 
 #include "libnymea.h"
 #include "typeutils.h"
+#include "statechangepolicy.h"
 
 #include <QVariant>
+#include <QSharedDataPointer>
+
+class StateTypePrivate;
 
 class LIBNYMEA_EXPORT StateType
 {
@@ -54,6 +58,9 @@ class LIBNYMEA_EXPORT StateType
 public:
     StateType();
     StateType(const StateTypeId &id);
+    StateType(const StateType &other);
+    ~StateType();
+    StateType &operator=(const StateType &other);
 
     StateTypeId id() const;
 
@@ -99,24 +106,13 @@ public:
     Types::StateValueFilter filter() const;
     void setFilter(Types::StateValueFilter filter);
 
+    StateChangePolicy changePolicy() const;
+    void setChangePolicy(const StateChangePolicy &changePolicy);
+
     bool isValid() const;
 
 private:
-    StateTypeId m_id;
-    QString m_name;
-    QString m_displayName;
-    int m_index = 0;
-    QVariant::Type m_type = QVariant::Invalid;
-    QVariant m_defaultValue;
-    QVariant m_minValue;
-    QVariant m_maxValue;
-    QVariantList m_possibleValues;
-    Types::Unit m_unit = Types::UnitNone;
-    Types::IOType m_ioType = Types::IOTypeNone;
-    bool m_writable = false;
-    bool m_cached = true;
-    bool m_logged = false;
-    Types::StateValueFilter m_filter = Types::StateValueFilterNone;
+    QSharedDataPointer<StateTypePrivate> d;
 };
 Q_DECLARE_METATYPE(StateType)
 
@@ -72,107 +72,159 @@
 
 #include "thingclass.h"
 
+#include <QHash>
+
+class ThingClassPrivate: public QSharedData
+{
+public:
+    ThingClassId m_id;
+    VendorId m_vendorId;
+    PluginId m_pluginId;
+    QString m_name;
+    QString m_displayName;
+    bool m_browsable = false;
+    StateTypes m_stateTypes;
+    EventTypes m_eventTypes;
+    ActionTypes m_actionTypes;
+    ActionTypes m_browserItemActionTypes;
+    ParamTypes m_paramTypes;
+    ParamTypes m_settingsTypes;
+    ParamTypes m_discoveryParamTypes;
+    QList<ParamTypeId> m_discoveryKeyParamTypeIds;
+    ThingClass::CreateMethods m_createMethods = ThingClass::CreateMethodUser;
+    ThingClass::SetupMethod m_setupMethod = ThingClass::SetupMethodJustAdd;
+    QStringList m_interfaces;
+    QStringList m_providedInterfaces;
+
+    // Positions in the type lists by id, rebuilt whenever a list is set
+    QHash<StateTypeId, int> m_stateTypeIndexes;
+    QHash<EventTypeId, int> m_eventTypeIndexes;
+    QHash<ActionTypeId, int> m_actionTypeIndexes;
+};
+
+template <typename Id, typename List>
+static QHash<Id, int> indexTypes(const List &types)
+{
+    QHash<Id, int> indexes;
+    indexes.reserve(types.count());
+    for (int i = 0; i < types.count(); i++) {
+        indexes.insert(types.at(i).id(), i);
+    }
+    return indexes;
+}
+
 /*! Constructs a DeviceClass with the give \a pluginId ,\a vendorId and \a id .
     When implementing a plugin, create a DeviceClass for each device you support.
     Generate a new uuid (e.g. uuidgen) and hardode it into the plugin. The id
     should never change or it will appear as a new DeviceClass in the system. */
 ThingClass::ThingClass(const PluginId &pluginId, const VendorId &vendorId, const ThingClassId &id):
-    m_id(id),
-    m_vendorId(vendorId),
-    m_pluginId(pluginId),
-    m_createMethods(CreateMethodUser),
-    m_setupMethod(SetupMethodJustAdd)
+    d(new ThingClassPrivate)
+{
+    d->m_id = id;
+    d->m_vendorId = vendorId;
+    d->m_pluginId = pluginId;
+}
+
+ThingClass::ThingClass(const ThingClass &other):
+    d(other.d)
 {
 
 }
 
+ThingClass::~ThingClass()
+{
+
+}
+
+ThingClass &ThingClass::operator=(const ThingClass &other)
+{
+    d = other.d;
+    return *this;
+}
+
 /*! Returns the id of this \l{DeviceClass}. */
 ThingClassId ThingClass::id() const
 {
-    return m_id;
+    return d->m_id;
 }
 
 /*! Returns the VendorId for this \l{DeviceClass} */
 VendorId ThingClass::vendorId() const
 {
-    return m_vendorId;
+    return d->m_vendorId;
 }
 
 /*! Returns the pluginId this \l{DeviceClass} is managed by. */
 PluginId ThingClass::pluginId() const
 {
-    return m_pluginId;
+    return d->m_pluginId;
 }
 
 /*! Returns true if this \l{DeviceClass} id, vendorId and pluginId are valid uuids. */
 bool ThingClass::isValid() const
 {
-    return !m_id.isNull() && !m_vendorId.isNull() && !m_pluginId.isNull();
+    return !d->m_id.isNull() && !d->m_vendorId.isNull() && !d->m_pluginId.isNull();
 }
 
 /*! Returns the name of this \l{DeviceClass}. This is visible to the user. */
 QString ThingClass::name() const
 {
-    return m_name;
+    return d->m_name;
 }
 
 /*! Set the \a name of this \l{DeviceClass}. This is visible to the user. */
 void ThingClass::setName(const QString &name)
 {
-    m_name = name;
+    d->m_name = name;
 }
 
 /*! Returns the displayed name of this \l{DeviceClass}. This is visible to the user. */
 QString ThingClass::displayName() const
 {
-    return m_displayName;
+    return d->m_displayName;
 }
 
 /*! Set the \a displayName of this \l{DeviceClass}. This is visible to the user. */
 void ThingClass::setDisplayName(const QString &displayName)
 {
-    m_displayName = displayName;
+    d->m_displayName = displayName;
 }
 
 /*! Returns the statesTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their states matching to this template. */
 StateTypes ThingClass::stateTypes() const
 {
-    return m_stateTypes;
+    return d->m_stateTypes;
 }
 
 /*! Returns the \l{StateType} with the given \a stateTypeId of this \l{DeviceClass}.
  * If there is no matching \l{StateType}, an invalid \l{StateType} will be returned.*/
-StateType ThingClass::getStateType(const StateTypeId &stateTypeId)
+StateType ThingClass::getStateType(const StateTypeId &stateTypeId) const
 {
-    foreach (const StateType &stateType, m_stateTypes) {
-        if (stateType.id() == stateTypeId)
-            return stateType;
+    int index = d->m_stateTypeIndexes.value(stateTypeId, -1);
+    if (index < 0) {
+        return StateType(StateTypeId());
     }
-    return StateType(StateTypeId());
+    return d->m_stateTypes.at(index);
 }
 
 /*! Set the \a stateTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their states matching to this template. */
 void ThingClass::setStateTypes(const StateTypes &stateTypes)
 {
-    m_stateTypes = stateTypes;
+    d->m_stateTypes = stateTypes;
+    d->m_stateTypeIndexes = indexTypes<StateTypeId>(stateTypes);
 }
 
 /*! Returns true if this DeviceClass has a \l{StateType} with the given \a stateTypeId. */
 bool ThingClass::hasStateType(const StateTypeId &stateTypeId) const
 {
-    foreach (const StateType &stateType, m_stateTypes) {
-        if (stateType.id() == stateTypeId) {
-            return true;
-        }
-    }
-    return false;
+    return d->m_stateTypeIndexes.contains(stateTypeId);
 }
 
 bool ThingClass::hasStateType(const QString &stateTypeName) const
 {
-    foreach (const StateType &stateType, m_stateTypes) {
+    foreach (const StateType &stateType, d->m_stateTypes) {
         if (stateType.name() == stateTypeName) {
             return true;
         }
@@ -180,34 +232,37 @@ bool ThingClass::hasStateType(const QString &stateTypeName) const
     return false;
 }
 
+/*! Returns the position of the \l{StateType} with the given \a stateTypeId in stateTypes(), or -1 if this
+    DeviceClass has no such \l{StateType}. */
+int ThingClass::stateTypeIndex(const StateTypeId &stateTypeId) const
+{
+    return d->m_stateTypeIndexes.value(stateTypeId, -1);
+}
+
 /*! Returns the eventTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their events matching to this template. */
 EventTypes ThingClass::eventTypes() const
 {
-    return m_eventTypes;
+    return d->m_eventTypes;
 }
 
 /*! Set the \a eventTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their events matching to this template. */
 void ThingClass::setEventTypes(const EventTypes &eventTypes)
 {
-    m_eventTypes = eventTypes;
+    d->m_eventTypes = eventTypes;
+    d->m_eventTypeIndexes = indexTypes<EventTypeId>(eventTypes);
 }
 
 /*! Returns true if this DeviceClass has a \l{EventType} with the given \a eventTypeId. */
 bool ThingClass::hasEventType(const EventTypeId &eventTypeId) const
 {
-    foreach (const EventType &eventType, m_eventTypes) {
-        if (eventType.id() == eventTypeId) {
-            return true;
-        }
-    }
-    return false;
+    return d->m_eventTypeIndexes.contains(eventTypeId);
 }
 
 bool ThingClass::hasEventType(const QString &eventTypeName) const
 {
-    foreach (const EventType &eventType, m_eventTypes) {
+    foreach (const EventType &eventType, d->m_eventTypes) {
         if (eventType.name() == eventTypeName) {
             return true;
         }
@@ -215,34 +270,41 @@ bool ThingClass::hasEventType(const QString &eventTypeName) const
     return false;
 }
 
+/*! Returns the \l{EventType} with the given \a eventTypeId of this \l{DeviceClass}.
+ * If there is no matching \l{EventType}, an invalid \l{EventType} will be returned.*/
+EventType ThingClass::getEventType(const EventTypeId &eventTypeId) const
+{
+    int index = d->m_eventTypeIndexes.value(eventTypeId, -1);
+    if (index < 0) {
+        return EventType(EventTypeId());
+    }
+    return d->m_eventTypes.at(index);
+}
+
 /*! Returns the actionTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their actions matching to this template. */
 ActionTypes ThingClass::actionTypes() const
 {
-    return m_actionTypes;
+    return d->m_actionTypes;
 }
 
 /*! Set the \a actionTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their actions matching to this template. */
 void ThingClass::setActionTypes(const ActionTypes &actionTypes)
 {
-    m_actionTypes = actionTypes;
+    d->m_actionTypes = actionTypes;
+    d->m_actionTypeIndexes = indexTypes<ActionTypeId>(actionTypes);
 }
 
 /*! Returns true if this DeviceClass has a \l{ActionType} with the given \a actionTypeId. */
 bool ThingClass::hasActionType(const ActionTypeId &actionTypeId) const
 {
-    foreach (const ActionType &actionType, m_actionTypes) {
-        if (actionType.id() == actionTypeId) {
-            return true;
-        }
-    }
-    return false;
+    return d->m_actionTypeIndexes.contains(actionTypeId);
 }
 
 bool ThingClass::hasActionType(const QString &actionTypeName) const
 {
-    foreach (const ActionType &actionType, m_actionTypes) {
+    foreach (const ActionType &actionType, d->m_actionTypes) {
         if (actionType.name() == actionTypeName) {
             return true;
         }
@@ -250,24 +312,35 @@ bool ThingClass::hasActionType(const QString &actionTypeName) const
     return false;
 }
 
+/*! Returns the \l{ActionType} with the given \a actionTypeId of this \l{DeviceClass}.
+ * If there is no matching \l{ActionType}, an invalid \l{ActionType} will be returned.*/
+ActionType ThingClass::getActionType(const ActionTypeId &actionTypeId) const
+{
+    int index = d->m_actionTypeIndexes.value(actionTypeId, -1);
+    if (index < 0) {
+        return ActionType(ActionTypeId());
+    }
+    return d->m_actionTypes.at(index);
+}
+
 /*! Returns the browserItemActionTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} may set those actions to their browser items. */
 ActionTypes ThingClass::browserItemActionTypes() const
 {
-    return m_browserItemActionTypes;
+    return d->m_browserItemActionTypes;
 }
 
 /*! Set the \a browserActionTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} may set those actions to their browser items. */
 void ThingClass::setBrowserItemActionTypes(const ActionTypes &browserItemActionTypes)
 {
-    m_browserItemActionTypes = browserItemActionTypes;
+    d->m_browserItemActionTypes = browserItemActionTypes;
 }
 
 /*! Returns true if this DeviceClass has a \l{ActionType} with the given \a actionTypeId. */
 bool ThingClass::hasBrowserItemActionType(const ActionTypeId &actionTypeId)
 {
-    foreach (const ActionType &actionType, m_browserItemActionTypes) {
+    foreach (const ActionType &actionType, d->m_browserItemActionTypes) {
         if (actionType.id() == actionTypeId) {
             return true;
         }
@@ -279,73 +352,87 @@ bool ThingClass::hasBrowserItemActionType(const ActionTypeId &actionTypeId)
     from this \l{DeviceClass} must have their params matching to this template. */
 ParamTypes ThingClass::paramTypes() const
 {
-    return m_paramTypes;
+    return d->m_paramTypes;
 }
 
 /*! Set the \a paramsTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their params matching to this template. */
 void ThingClass::setParamTypes(const ParamTypes &params)
 {
-    m_paramTypes = params;
+    d->m_paramTypes = params;
 }
 
 /*! Returns the settings description of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their settings matching to this template. */
 ParamTypes ThingClass::settingsTypes() const
 {
-    return m_settingsTypes;
+    return d->m_settingsTypes;
 }
 
 /*! Set the \a settingsTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their settings matching to this template. */
 void ThingClass::setSettingsTypes(const ParamTypes &settingsTypes)
 {
-    m_settingsTypes = settingsTypes;
+    d->m_settingsTypes = settingsTypes;
 }
 
 /*! Returns the discovery params description of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their params matching to this template. */
 ParamTypes ThingClass::discoveryParamTypes() const
 {
-    return m_discoveryParamTypes;
+    return d->m_discoveryParamTypes;
 }
 /*! Set the \a params of this DeviceClass for the discovery. \{Device}{Devices} created
     from this \l{DeviceClass} must have their actions matching to this template. */
 void ThingClass::setDiscoveryParamTypes(const ParamTypes &params)
 {
-    m_discoveryParamTypes = params;
+    d->m_discoveryParamTypes = params;
+}
+
+/*! Returns the params identifying a discovered \l{ThingDescriptor} of this DeviceClass. Descriptors with the
+    same values for all of these params describe the same thing, even if found by different discovery
+    mechanisms, and only the first one is kept. If empty, all descriptors are kept. */
+QList<ParamTypeId> ThingClass::discoveryKeyParamTypeIds() const
+{
+    return d->m_discoveryKeyParamTypeIds;
+}
+
+/*! Set the \a paramTypeIds of the params identifying a discovered \l{ThingDescriptor} of this DeviceClass. */
+void ThingClass::setDiscoveryKeyParamTypeIds(const QList<ParamTypeId> &paramTypeIds)
+{
+    d->m_discoveryKeyParamTypeIds = paramTypeIds;
 }
 
 /*! Returns the \l{DeviceClass::CreateMethod}s of this \l{DeviceClass}.*/
 ThingClass::CreateMethods ThingClass::createMethods() const
 {
-    return m_createMethods;
+    return d->m_createMethods;
 }
 
 /*! Set the \a createMethods of this \l{DeviceClass}.
     \sa CreateMethod, */
 void ThingClass::setCreateMethods(ThingClass::CreateMethods createMethods)
 {
-    m_createMethods = createMethods;
+    d->m_createMethods = createMethods;
 }
 
 /*! Returns the \l{DeviceClass::SetupMethod} of this \l{DeviceClass}.*/
 ThingClass::SetupMethod ThingClass::setupMethod() const
 {
-    return m_setupMethod;
+    return d->m_setupMethod;
 }
 
 /*! Set the \a setupMethod of this \l{DeviceClass}.
     \sa SetupMethod, */
 void ThingClass::setSetupMethod(ThingClass::SetupMethod setupMethod)
 {
-    m_setupMethod = setupMethod;
+    d->m_setupMethod = setupMethod;
 }
 
 /*! Returns the \l{Interfaces for DeviceClasses}{interfaces} of this \l{DeviceClass}.*/
 QStringList ThingClass::interfaces() const
 {
-    return m_interfaces;
+    return d->m_interfaces;
 }
 
 /*! Set the \a interfaces of this \l{DeviceClass}.
@@ -354,7 +441,7 @@ QStringList ThingClass::interfaces() const
 */
 void ThingClass::setInterfaces(const QStringList &interfaces)
 {
-    m_interfaces = interfaces;
+    d->m_interfaces = interfaces;
 }
 
 /*! Returns the interfaces that a thing does not directly implement, but it may still cater for
@@ -363,7 +450,7 @@ void ThingClass::setInterfaces(const QStringList &interfaces)
  */
 QStringList ThingClass::providedInterfaces() const
 {
-    return m_providedInterfaces;
+    return d->m_providedInterfaces;
 }
 
 /*! Set the list of provided interfaces. This list should contain interfaces for things that
@@ -371,25 +458,25 @@ QStringList ThingClass::providedInterfaces() const
 */
 void ThingClass::setProvidedInterfaces(const QStringList &providedInterfaces)
 {
-    m_providedInterfaces = providedInterfaces;
+    d->m_providedInterfaces = providedInterfaces;
 }
 
 /*! Returns whether \l{Device}{Devices} created from this \l{DeviceClass} are browsable */
 bool ThingClass::browsable() const
 {
-    return m_browsable;
+    return d->m_browsable;
 }
 
 /*! Sets whether \l{Device}{Devices} created from this \l{DeviceClass} are browsable */
 void ThingClass::setBrowsable(bool browsable)
 {
-    m_browsable = browsable;
+    d->m_browsable = browsable;
 }
 
 /*! Compare this \a deviceClass to another. This is effectively the same as calling a.id() == b.id(). Returns true if the ids match.*/
 bool ThingClass::operator==(const ThingClass &deviceClass) const
 {
-    return m_id == deviceClass.id();
+    return d->m_id == deviceClass.id();
 }
 
 QDebug operator<<(QDebug &dbg, const ThingClass &deviceClass)
@@ -41,6 +41,9 @@
 
 #include <QList>
 #include <QUuid>
+#include <QSharedDataPointer>
+
+class ThingClassPrivate;
 
 class LIBNYMEA_EXPORT ThingClass
 {
@@ -84,6 +87,9 @@ public:
     Q_ENUM(SetupMethod)
 
     ThingClass(const PluginId &pluginId = PluginId(), const VendorId &vendorId = VendorId(), const ThingClassId &id = ThingClassId());
+    ThingClass(const ThingClass &other);
+    ~ThingClass();
+    ThingClass &operator=(const ThingClass &other);
 
     ThingClassId id() const;
     VendorId vendorId() const;
@@ -97,20 +103,23 @@ public:
     void setDisplayName(const QString &displayName);
 
     StateTypes stateTypes() const;
-    StateType getStateType(const StateTypeId &stateTypeId);
+    StateType getStateType(const StateTypeId &stateTypeId) const;
     void setStateTypes(const StateTypes &stateTypes);
     bool hasStateType(const StateTypeId &stateTypeId) const;
     bool hasStateType(const QString &stateTypeName) const;
+    int stateTypeIndex(const StateTypeId &stateTypeId) const;
 
     EventTypes eventTypes() const;
     void setEventTypes(const EventTypes &eventTypes);
     bool hasEventType(const EventTypeId &eventTypeId) const;
     bool hasEventType(const QString &eventTypeName) const;
+    EventType getEventType(const EventTypeId &eventTypeId) const;
 
     ActionTypes actionTypes() const;
     void setActionTypes(const ActionTypes &actionTypes);
     bool hasActionType(const ActionTypeId &actionTypeId) const;
     bool hasActionType(const QString &actionTypeName) const;
+    ActionType getActionType(const ActionTypeId &actionTypeId) const;
 
     bool browsable() const;
     void setBrowsable(bool browsable);
@@ -128,6 +137,9 @@ public:
     ParamTypes discoveryParamTypes() const;
     void setDiscoveryParamTypes(const ParamTypes &paramTypes);
 
+    QList<ParamTypeId> discoveryKeyParamTypeIds() const;
+    void setDiscoveryKeyParamTypeIds(const QList<ParamTypeId> &paramTypeIds);
+
     CreateMethods createMethods() const;
     void setCreateMethods(CreateMethods createMethods);
 
@@ -143,23 +155,7 @@ public:
     bool operator==(const ThingClass &device) const;
 
 private:
-    ThingClassId m_id;
-    VendorId m_vendorId;
-    PluginId m_pluginId;
-    QString m_name;
-    QString m_displayName;
-    bool m_browsable = false;
-    StateTypes m_stateTypes;
-    EventTypes m_eventTypes;
-    ActionTypes m_actionTypes;
-    ActionTypes m_browserItemActionTypes;
-    ParamTypes m_paramTypes;
-    ParamTypes m_settingsTypes;
-    ParamTypes m_discoveryParamTypes;
-    CreateMethods m_createMethods;
-    SetupMethod m_setupMethod;
-    QStringList m_interfaces;
-    QStringList m_providedInterfaces;
+    QSharedDataPointer<ThingClassPrivate> d;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(ThingClass::CreateMethods)
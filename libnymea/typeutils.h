@@ -36,6 +36,8 @@
 
 #include "libnymea.h"
 
+// Ids of different types convert into each other through their QUuid base, e.g. ParamTypeId(stateTypeId),
+// without going through their string representation. Ids are compared as binary uuids.
 #define DECLARE_TYPE_ID(type) class type##Id: public QUuid \
 { \
 public: \
@@ -43,7 +45,10 @@ public: \
     type##Id(): QUuid() {} \
     static type##Id create##type##Id() { return type##Id(QUuid::createUuid()); } \
     bool operator==(const type##Id &other) const { \
-        return toString() == other.toString(); \
+        return QUuid::operator==(other); \
+    } \
+    bool operator!=(const type##Id &other) const { \
+        return QUuid::operator!=(other); \
     } \
 }; \
 Q_DECLARE_METATYPE(type##Id);
@@ -179,7 +184,10 @@ public:
 
     enum StateValueFilter {
         StateValueFilterNone,
-        StateValueFilterAdaptive
+        StateValueFilterAdaptive,
+        StateValueFilterEma,
+        StateValueFilterMedian,
+        StateValueFilterKalman
     };
     Q_ENUM(StateValueFilter)
 };
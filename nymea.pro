@@ -5,10 +5,10 @@ NYMEA_VERSION_STRING=$$system('dpkg-parsechangelog | sed -n -e "s/^Version: //p"
 
 # define protocol versions
 JSON_PROTOCOL_VERSION_MAJOR=5
-JSON_PROTOCOL_VERSION_MINOR=8
+JSON_PROTOCOL_VERSION_MINOR=34
 JSON_PROTOCOL_VERSION="$${JSON_PROTOCOL_VERSION_MAJOR}.$${JSON_PROTOCOL_VERSION_MINOR}"
-LIBNYMEA_API_VERSION_MAJOR=7
-LIBNYMEA_API_VERSION_MINOR=3
+LIBNYMEA_API_VERSION_MAJOR=8
+LIBNYMEA_API_VERSION_MINOR=36
 LIBNYMEA_API_VERSION_PATCH=0
 LIBNYMEA_API_VERSION="$${LIBNYMEA_API_VERSION_MAJOR}.$${LIBNYMEA_API_VERSION_MINOR}.$${LIBNYMEA_API_VERSION_PATCH}"
 
@@ -24,10 +24,11 @@ piconly {
     message("Minimal build. Only libraries required to build nymea-plugins will be built.")
     SUBDIRS += libnymea tools
 } else {
-    SUBDIRS += libnymea server libnymea-core plugins tools
+    SUBDIRS += libnymea server pluginhost libnymea-core plugins tools
     libnymea-core.depends = libnymea
     plugins.depends = libnymea tools
     server.depends = libnymea libnymea-core plugins
+    pluginhost.depends = libnymea libnymea-core
 
     # Build tests
     disabletesting {
@@ -35,7 +36,7 @@ piconly {
     } else {
         message("Building nymea with tests")
         SUBDIRS += tests
-        tests.depends = libnymea libnymea-core
+        tests.depends = libnymea libnymea-core pluginhost
     }
 }
 
@@ -50,7 +51,7 @@ QMAKE_EXTRA_TARGETS += doc
 # Translations:
 # make lupdate to update .ts files
 CORE_TRANSLATIONS += $$files($${top_srcdir}/translations/*.ts, true)
-lupdate.commands = lupdate -no-obsolete -recursive $${top_srcdir}/libnymea $${top_srcdir}/libnymea-core $${top_srcdir}/server $${top_srcdir}/libnymea $${top_srcdir}/tools -ts $${CORE_TRANSLATIONS};
+lupdate.commands = lupdate -no-obsolete -recursive $${top_srcdir}/libnymea $${top_srcdir}/libnymea-core $${top_srcdir}/server $${top_srcdir}/pluginhost $${top_srcdir}/libnymea $${top_srcdir}/tools -ts $${CORE_TRANSLATIONS};
 lupdate.commands += make -C plugins/mock plugininfo;
 PLUGIN_TRANSLATIONS += $$files($${top_srcdir}/plugins/mock/translations/*.ts, true)
 lupdate.commands += lupdate -no-obsolete -recursive $${top_srcdir}/plugins/mock/ $${top_builddir}/plugins/mock/ -ts $${PLUGIN_TRANSLATIONS};
@@ -75,6 +76,12 @@ test.depends += lrelease
 test.commands = LD_LIBRARY_PATH=$$top_builddir/libnymea-core:$$top_builddir/libnymea:$$top_builddir/tests/testlib make check TESTRUNNER=\"dbus-test-runner --bus-type=both --task\"
 QMAKE_EXTRA_TARGETS += test
 
+# make benchmarks to run all benchmarks and write their results to benchmark-results.json.
+# Compare two runs with tests/benchmarks/compare-benchmarks.py
+benchmarks.depends = first
+benchmarks.commands = $$top_srcdir/tests/benchmarks/run-benchmarks.py --build-dir $$top_builddir --output $$top_builddir/benchmark-results.json
+QMAKE_EXTRA_TARGETS += benchmarks
+
 # Show doc files in project tree
 OTHER_FILES += doc/*.qdoc* \
                doc/tutorials/*.qdoc*
@@ -0,0 +1,76 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QLoggingCategory>
+
+#include "pluginhost.h"
+#include "loggingcategories.h"
+#include "version.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    application.setOrganizationName("nymea");
+    application.setApplicationName("nymea-pluginhost");
+    application.setApplicationVersion(NYMEA_VERSION_STRING);
+
+    // Only warnings by default, QT_LOGGING_RULES takes precedence
+    QLoggingCategory::setFilterRules("*.debug=false\n*.info=false");
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.setApplicationDescription(QCoreApplication::translate("nymea", "\nRuns a nymea integration plugin on behalf of nymead. This is started by nymead and not meant to be run manually.\n"));
+
+    QCommandLineOption socketOption({"s", "socket"}, QCoreApplication::translate("nymea", "The local socket nymead is listening on."), "socket");
+    parser.addOption(socketOption);
+    QCommandLineOption stateChannelOption({"state-channel"}, QCoreApplication::translate("nymea", "The key of the shared memory to write state changes to."), "key");
+    parser.addOption(stateChannelOption);
+    parser.addPositionalArgument("plugin", QCoreApplication::translate("nymea", "The plugin library to load."));
+
+    parser.process(application);
+
+    if (parser.positionalArguments().count() != 1 || !parser.isSet(socketOption)) {
+        parser.showHelp(1);
+    }
+
+    PluginHost host;
+    if (!host.loadPlugin(parser.positionalArguments().first())) {
+        return 1;
+    }
+    if (!host.connectToCore(parser.value(socketOption), parser.value(stateChannelOption))) {
+        return 1;
+    }
+
+    return application.exec();
+}
@@ -0,0 +1,418 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "pluginhost.h"
+#include "pluginhostthingmanager.h"
+
+#include "integrations/integrationplugin.h"
+#include "integrations/thingdiscoveryinfo.h"
+#include "integrations/thingpairinginfo.h"
+#include "integrations/thingsetupinfo.h"
+#include "integrations/thingactioninfo.h"
+#include "integrations/browseresult.h"
+#include "integrations/browseritemresult.h"
+#include "integrations/browseractioninfo.h"
+#include "integrations/browseritemactioninfo.h"
+
+#include <QCoreApplication>
+#include <QPointer>
+
+typedef PluginHostProtocol P;
+
+PluginHost::PluginHost(QObject *parent):
+    QObject(parent),
+    m_thingManager(new PluginHostThingManager(this))
+{
+
+}
+
+bool PluginHost::loadPlugin(const QString &fileName)
+{
+    m_plugin = m_thingManager->loadPlugin(fileName);
+    if (!m_plugin) {
+        return false;
+    }
+
+    connect(m_plugin, &IntegrationPlugin::emitEvent, this, [this](const Event &event){
+        if (m_handles.contains(event.thingId())) {
+            m_connection->send(P::MessageEventTriggered, P::encode(m_handles.value(event.thingId()), event.eventTypeId(), event.params()));
+        }
+    });
+    connect(m_plugin, &IntegrationPlugin::configValueChanged, this, [this](const ParamTypeId &paramTypeId, const QVariant &value){
+        if (!m_applyingCoreChange) {
+            m_connection->send(P::MessageConfigValueChanged, P::encode(paramTypeId, value));
+        }
+    });
+    connect(m_plugin, &IntegrationPlugin::autoThingsAppeared, this, [this](const ThingDescriptors &thingDescriptors){
+        m_connection->send(P::MessageAutoThingsAppeared, P::encode(thingDescriptors));
+    });
+    connect(m_plugin, &IntegrationPlugin::autoThingDisappeared, this, [this](const ThingId &thingId){
+        m_connection->send(P::MessageAutoThingDisappeared, P::encode(thingId));
+    });
+    connect(m_plugin, &IntegrationPlugin::browserItemsChanged, this, [this](const ThingId &thingId, const QString &itemId){
+        m_connection->send(P::MessageBrowserItemsChanged, P::encode(thingId, itemId));
+    });
+
+    qCDebug(dcPluginHost()) << "Loaded plugin" << m_plugin->pluginName() << "from" << fileName;
+    return true;
+}
+
+bool PluginHost::connectToCore(const QString &socketName, const QString &stateChannelKey)
+{
+    if (!stateChannelKey.isEmpty() && !m_stateChannel.attach(stateChannelKey)) {
+        qCWarning(dcPluginHost()) << "Unable to attach to the state channel" << stateChannelKey << m_stateChannel.errorString() << "Sending state changes on the socket.";
+    }
+
+    m_socket = new QLocalSocket(this);
+    m_socket->connectToServer(socketName);
+    if (!m_socket->waitForConnected(5000)) {
+        qCWarning(dcPluginHost()) << "Unable to connect to nymead on" << socketName << m_socket->errorString();
+        return false;
+    }
+
+    m_connection = new PluginHostConnection(m_socket, this);
+    connect(m_connection, &PluginHostConnection::messageReceived, this, &PluginHost::onMessageReceived);
+    connect(m_connection, &PluginHostConnection::disconnected, this, [](){
+        qCWarning(dcPluginHost()) << "Connection to nymead lost. Quitting.";
+        QCoreApplication::quit();
+    });
+
+    m_connection->send(P::MessageHello, P::encode(m_plugin->pluginId()));
+    return true;
+}
+
+void PluginHost::onMessageReceived(PluginHostProtocol::Message message, const QByteArray &payload)
+{
+    QDataStream stream(payload);
+    stream.setVersion(P::streamVersion);
+    quint32 requestId = 0;
+    quint32 handle = 0;
+
+    switch (message) {
+    case P::MessageInit: {
+        ParamList configuration;
+        QVariantMap apiKeys;
+        stream >> configuration >> apiKeys;
+        foreach (const QString &name, apiKeys.keys()) {
+            ApiKey apiKey;
+            QVariantMap properties = apiKeys.value(name).toMap();
+            foreach (const QString &key, properties.keys()) {
+                apiKey.insert(key, properties.value(key).toByteArray());
+            }
+            m_thingManager->apiKeyStorage()->insertKey(name, apiKey);
+        }
+        m_applyingCoreChange = true;
+        m_plugin->setConfiguration(configuration);
+        m_applyingCoreChange = false;
+        m_plugin->init();
+        break;
+    }
+    case P::MessageSetConfigValue: {
+        ParamTypeId paramTypeId; QVariant value;
+        stream >> paramTypeId >> value;
+        m_applyingCoreChange = true;
+        m_plugin->setConfigValue(paramTypeId, value);
+        m_applyingCoreChange = false;
+        break;
+    }
+    case P::MessageStartMonitoringAutoThings:
+        m_plugin->startMonitoringAutoThings();
+        break;
+    case P::MessageDiscoverThings: {
+        ThingClassId thingClassId; ParamList params;
+        stream >> requestId >> thingClassId >> params;
+        ThingDiscoveryInfo *info = new ThingDiscoveryInfo(thingClassId, params, m_thingManager);
+        addRequest(P::MessageDiscoveryFinished, requestId, info, [info](){ return P::encode(info->thingDescriptors()); });
+        m_plugin->discoverThings(info);
+        break;
+    }
+    case P::MessageStartPairing:
+    case P::MessageConfirmPairing: {
+        PairingTransactionId transactionId; ThingClassId thingClassId; ThingId thingId; QString name; ParamList params; ThingId parentId;
+        stream >> requestId >> transactionId >> thingClassId >> thingId >> name >> params >> parentId;
+        ThingPairingInfo *info = new ThingPairingInfo(transactionId, thingClassId, thingId, name, params, parentId, m_thingManager);
+        addRequest(P::MessagePairingFinished, requestId, info, [info](){ return P::encode(info->oAuthUrl()); });
+        if (message == P::MessageStartPairing) {
+            m_plugin->startPairing(info);
+        } else {
+            QString username; QString secret;
+            stream >> username >> secret;
+            m_plugin->confirmPairing(info, username, secret);
+        }
+        break;
+    }
+    case P::MessageSetupThing:
+        stream >> requestId >> handle;
+        setupThing(requestId, handle, stream);
+        break;
+    case P::MessagePostSetupThing: {
+        stream >> handle;
+        Thing *thing = m_things.value(handle);
+        if (thing) {
+            m_plugin->postSetupThing(thing);
+        }
+        break;
+    }
+    case P::MessageThingRemoved: {
+        stream >> handle;
+        Thing *thing = m_things.take(handle);
+        if (thing) {
+            m_handles.remove(thing->id());
+            m_stateLimits.remove(handle);
+            m_plugin->thingRemoved(thing);
+            m_thingManager->removeThing(thing);
+        }
+        break;
+    }
+    case P::MessageExecuteAction: {
+        ActionTypeId actionTypeId; ParamList params; qint32 triggeredBy;
+        stream >> requestId >> handle >> actionTypeId >> params >> triggeredBy;
+        Thing *thing = m_things.value(handle);
+        if (!thing) {
+            sendFailed(P::MessageActionFinished, requestId, Thing::ThingErrorThingNotFound);
+            break;
+        }
+        Action action(actionTypeId, thing->id(), static_cast<Action::TriggeredBy>(triggeredBy));
+        action.setParams(params);
+        ThingActionInfo *info = new ThingActionInfo(thing, action, m_thingManager);
+        addRequest(P::MessageActionFinished, requestId, info);
+        m_plugin->executeAction(info);
+        break;
+    }
+    case P::MessageBrowseThing: {
+        QString itemId; QLocale locale;
+        stream >> requestId >> handle >> itemId >> locale;
+        Thing *thing = m_things.value(handle);
+        if (!thing) {
+            sendFailed(P::MessageBrowseFinished, requestId, Thing::ThingErrorThingNotFound);
+            break;
+        }
+        BrowseResult *result = new BrowseResult(thing, m_thingManager, itemId, locale, this);
+        addRequest(P::MessageBrowseFinished, requestId, result, [result](){ return P::encode(result->cacheTimeout(), result->items()); });
+        m_plugin->browseThing(result);
+        break;
+    }
+    case P::MessageBrowserItem: {
+        QString itemId; QLocale locale;
+        stream >> requestId >> handle >> itemId >> locale;
+        Thing *thing = m_things.value(handle);
+        if (!thing) {
+            sendFailed(P::MessageBrowserItemFinished, requestId, Thing::ThingErrorThingNotFound);
+            break;
+        }
+        BrowserItemResult *result = new BrowserItemResult(thing, m_thingManager, itemId, locale, this);
+        addRequest(P::MessageBrowserItemFinished, requestId, result, [result](){ return P::encode(result->cacheTimeout(), result->item()); });
+        m_plugin->browserItem(result);
+        break;
+    }
+    case P::MessageExecuteBrowserItem: {
+        QString itemId;
+        stream >> requestId >> handle >> itemId;
+        Thing *thing = m_things.value(handle);
+        if (!thing) {
+            sendFailed(P::MessageBrowserActionFinished, requestId, Thing::ThingErrorThingNotFound);
+            break;
+        }
+        BrowserActionInfo *info = new BrowserActionInfo(thing, m_thingManager, BrowserAction(thing->id(), itemId), this);
+        addRequest(P::MessageBrowserActionFinished, requestId, info);
+        m_plugin->executeBrowserItem(info);
+        break;
+    }
+    case P::MessageExecuteBrowserItemAction: {
+        QString itemId; ActionTypeId actionTypeId; ParamList params;
+        stream >> requestId >> handle >> itemId >> actionTypeId >> params;
+        Thing *thing = m_things.value(handle);
+        if (!thing) {
+            sendFailed(P::MessageBrowserItemActionFinished, requestId, Thing::ThingErrorThingNotFound);
+            break;
+        }
+        BrowserItemActionInfo *info = new BrowserItemActionInfo(thing, m_thingManager, BrowserItemAction(thing->id(), itemId, actionTypeId, params), this);
+        addRequest(P::MessageBrowserItemActionFinished, requestId, info);
+        m_plugin->executeBrowserItemAction(info);
+        break;
+    }
+    case P::MessageAbort: {
+        stream >> requestId;
+        std::function<void()> abort = m_pendingRequests.take(requestId);
+        if (abort) {
+            abort();
+        }
+        break;
+    }
+    case P::MessageSetThingName: {
+        QString name;
+        stream >> handle >> name;
+        Thing *thing = m_things.value(handle);
+        if (thing) {
+            m_applyingCoreChange = true;
+            thing->setName(name);
+            m_applyingCoreChange = false;
+        }
+        break;
+    }
+    case P::MessageSetThingSetting: {
+        ParamTypeId paramTypeId; QVariant value;
+        stream >> handle >> paramTypeId >> value;
+        Thing *thing = m_things.value(handle);
+        if (thing) {
+            m_applyingCoreChange = true;
+            thing->setSettingValue(paramTypeId, value);
+            m_applyingCoreChange = false;
+        }
+        break;
+    }
+    default:
+        qCWarning(dcPluginHost()) << "Unexpected message" << message << "from nymead";
+        break;
+    }
+}
+
+void PluginHost::setupThing(quint32 requestId, quint32 handle, QDataStream &stream)
+{
+    ThingId thingId; ThingClassId thingClassId; QString name; ThingId parentId; bool autoCreated;
+    ParamList params; ParamList settings; States states;
+    stream >> thingId >> thingClassId >> name >> parentId >> autoCreated >> params >> settings >> states;
+
+    m_applyingCoreChange = true;
+    Thing *thing = m_thingManager->addThing(thingId, thingClassId, name, parentId, autoCreated, params, settings, states);
+    m_applyingCoreChange = false;
+    if (!thing) {
+        sendFailed(P::MessageSetupFinished, requestId, Thing::ThingErrorThingClassNotFound);
+        return;
+    }
+    if (!m_things.contains(handle)) {
+        m_things.insert(handle, thing);
+        m_handles.insert(thingId, handle);
+        watchThing(handle, thing);
+    }
+
+    ThingSetupInfo *info = new ThingSetupInfo(thing, m_thingManager);
+    connect(info, &ThingSetupInfo::finished, this, [this, info, thing, requestId](){
+        m_thingManager->setSetupStatus(thing, info->status(), info->displayMessage());
+        // Things set up again after a restart of the host don't get a separate post setup call
+        if (requestId == 0 && info->status() == Thing::ThingErrorNoError) {
+            m_plugin->postSetupThing(thing);
+        }
+    });
+    addRequest(P::MessageSetupFinished, requestId, info);
+    m_plugin->setupThing(info);
+}
+
+void PluginHost::watchThing(quint32 handle, Thing *thing)
+{
+    if (!m_stateIndexes.contains(thing->thingClassId())) {
+        QHash<StateTypeId, int> indexes;
+        States states = thing->states();
+        for (int i = 0; i < states.count(); i++) {
+            indexes.insert(states.at(i).stateTypeId(), i);
+        }
+        m_stateIndexes.insert(thing->thingClassId(), indexes);
+    }
+
+    connect(thing, &Thing::stateValueChanged, this, [this, handle, thing](const StateTypeId &stateTypeId){
+        sendStateChange(handle, thing, stateTypeId);
+    });
+    connect(thing, &Thing::stateValuesChanged, this, [this, handle, thing](const QList<StateTypeId> &stateTypeIds){
+        foreach (const StateTypeId &stateTypeId, stateTypeIds) {
+            sendStateChange(handle, thing, stateTypeId);
+        }
+    });
+    connect(thing, &Thing::nameChanged, this, [this, handle, thing](){
+        if (!m_applyingCoreChange) {
+            m_connection->send(P::MessageThingNameChanged, P::encode(handle, thing->name()));
+        }
+    });
+    connect(thing, &Thing::settingChanged, this, [this, handle](const ParamTypeId &paramTypeId, const QVariant &value){
+        if (!m_applyingCoreChange) {
+            m_connection->send(P::MessageThingSettingChanged, P::encode(handle, paramTypeId, value));
+        }
+    });
+    connect(thing, &Thing::eventTriggered, this, [this, handle](const Event &event){
+        m_connection->send(P::MessageEventTriggered, P::encode(handle, event.eventTypeId(), event.params()));
+    });
+}
+
+void PluginHost::sendStateChange(quint32 handle, Thing *thing, const StateTypeId &stateTypeId)
+{
+    int index = m_stateIndexes.value(thing->thingClassId()).value(stateTypeId, -1);
+    if (index < 0) {
+        return;
+    }
+    State state = thing->state(stateTypeId);
+
+    // Limits are only sent along when they changed
+    QVariant minValue; QVariant maxValue;
+    QPair<QVariant, QVariant> limits(state.minValue(), state.maxValue());
+    QHash<int, QPair<QVariant, QVariant>> &sentLimits = m_stateLimits[handle];
+    if (sentLimits.value(index) != limits) {
+        sentLimits.insert(index, limits);
+        minValue = limits.first;
+        maxValue = limits.second;
+    }
+
+    QByteArray record = P::encodeStateChange(handle, index, state.value(), minValue, maxValue);
+    bool wakeUp = false;
+    if (m_stateChannel.write(record, &wakeUp)) {
+        if (wakeUp) {
+            m_connection->send(P::MessageStatesAvailable);
+        }
+    } else {
+        m_connection->send(P::MessageStateChanged, record);
+    }
+}
+
+template <typename T>
+void PluginHost::addRequest(PluginHostProtocol::Message reply, quint32 requestId, T *info, const std::function<QByteArray()> &extra)
+{
+    // Timeouts are up to nymead, which asks to abort
+    QPointer<T> guard(info);
+    if (requestId > 0) {
+        m_pendingRequests.insert(requestId, [guard](){
+            if (guard) {
+                emit guard->aborted();
+                guard->finish(Thing::ThingErrorTimeout);
+            }
+        });
+    }
+
+    connect(info, &T::finished, this, [this, reply, requestId, info, extra](){
+        m_pendingRequests.remove(requestId);
+        QByteArray payload = P::encode(requestId, static_cast<qint32>(info->status()), info->displayMessage());
+        if (extra) {
+            payload.append(extra());
+        }
+        m_connection->send(reply, payload);
+    });
+}
+
+void PluginHost::sendFailed(PluginHostProtocol::Message reply, quint32 requestId, Thing::ThingError error)
+{
+    m_connection->send(reply, P::encode(requestId, static_cast<qint32>(error), QString()));
+}
@@ -0,0 +1,90 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef PLUGINHOST_H
+#define PLUGINHOST_H
+
+#include "integrations/pluginhost/pluginhostprotocol.h"
+#include "integrations/pluginhost/pluginhoststatechannel.h"
+
+#include <QObject>
+#include <QLocalSocket>
+
+#include <functional>
+
+class IntegrationPlugin;
+class PluginHostThingManager;
+
+/* Runs one integration plugin on behalf of nymead. Requests from nymead are turned into the infos the plugin
+   works with, the results as well as anything else the plugin and its things emit are sent back. */
+class PluginHost : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PluginHost(QObject *parent = nullptr);
+
+    bool loadPlugin(const QString &fileName);
+    bool connectToCore(const QString &socketName, const QString &stateChannelKey);
+
+private slots:
+    void onMessageReceived(PluginHostProtocol::Message message, const QByteArray &payload);
+
+private:
+    void setupThing(quint32 requestId, quint32 handle, QDataStream &stream);
+    void watchThing(quint32 handle, Thing *thing);
+    void sendStateChange(quint32 handle, Thing *thing, const StateTypeId &stateTypeId);
+
+    // Sends the reply once the info is finished, extra is appended to the status
+    template <typename T> void addRequest(PluginHostProtocol::Message reply, quint32 requestId, T *info, const std::function<QByteArray()> &extra = nullptr);
+    void sendFailed(PluginHostProtocol::Message reply, quint32 requestId, Thing::ThingError error);
+
+    PluginHostThingManager *m_thingManager = nullptr;
+    IntegrationPlugin *m_plugin = nullptr;
+
+    QLocalSocket *m_socket = nullptr;
+    PluginHostConnection *m_connection = nullptr;
+    PluginHostStateChannel m_stateChannel;
+
+    // Aborts the info of a pending request
+    QHash<quint32, std::function<void()>> m_pendingRequests;
+
+    QHash<quint32, Thing*> m_things;
+    QHash<ThingId, quint32> m_handles;
+
+    // Position of the states of a thing class in its things' states
+    QHash<ThingClassId, QHash<StateTypeId, int>> m_stateIndexes;
+    // The last sent min and max values per thing and state
+    QHash<quint32, QHash<int, QPair<QVariant, QVariant>>> m_stateLimits;
+
+    // Changes made by nymead aren't sent back
+    bool m_applyingCoreChange = false;
+};
+
+#endif // PLUGINHOST_H
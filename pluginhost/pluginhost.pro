@@ -0,0 +1,28 @@
+include(../nymea.pri)
+
+TARGET = nymea-pluginhost
+TEMPLATE = app
+
+INCLUDEPATH += ../libnymea ../libnymea-core $$top_builddir
+
+target.path = /usr/bin
+INSTALLS += target
+
+QT += sql xml websockets bluetooth dbus network
+
+CONFIG += link_pkgconfig
+PKGCONFIG += nymea-zigbee
+
+LIBS += -L$$top_builddir/libnymea/ -lnymea \
+        -L$$top_builddir/libnymea-core -lnymea-core \
+        -lnymea-remoteproxyclient
+
+SOURCES += main.cpp \
+    pluginhost.cpp \
+    pluginhosthardwaremanager.cpp \
+    pluginhostthingmanager.cpp
+
+HEADERS += \
+    pluginhost.h \
+    pluginhosthardwaremanager.h \
+    pluginhostthingmanager.h
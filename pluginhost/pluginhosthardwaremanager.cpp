@@ -0,0 +1,124 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "pluginhosthardwaremanager.h"
+
+#include "hardware/plugintimermanagerimplementation.h"
+#include "hardware/network/upnp/upnpdiscoveryimplementation.h"
+#include "hardware/network/networkaccessmanagerimpl.h"
+#include "hardware/network/coaphardwareresourceimplementation.h"
+#include "hardware/i2c/i2cmanagerimplementation.h"
+#include "network/networkdevicediscovery.h"
+
+using namespace nymeaserver;
+
+PluginHostHardwareManager::PluginHostHardwareManager(QObject *parent):
+    HardwareManager(parent)
+{
+    m_networkAccessManager = new QNetworkAccessManager(this);
+
+    m_pluginTimerManager = new PluginTimerManagerImplementation(this);
+    m_networkManager = new NetworkAccessManagerImpl(m_networkAccessManager, this);
+    m_upnpDiscovery = new UpnpDiscoveryImplementation(m_networkAccessManager, this);
+    m_i2cManager = new I2CManagerImplementation(this);
+    m_networkDeviceDiscovery = new NetworkDeviceDiscovery(this);
+    m_coapResource = new CoapHardwareResourceImplementation(this);
+
+    setResourceEnabled(m_pluginTimerManager, true);
+
+    if (m_networkManager->available())
+        setResourceEnabled(m_networkManager, true);
+
+    if (m_upnpDiscovery->available())
+        setResourceEnabled(m_upnpDiscovery, true);
+
+    if (m_coapResource->available())
+        setResourceEnabled(m_coapResource, true);
+}
+
+Radio433 *PluginHostHardwareManager::radio433()
+{
+    return nullptr;
+}
+
+PluginTimerManager *PluginHostHardwareManager::pluginTimerManager()
+{
+    return m_pluginTimerManager;
+}
+
+NetworkAccessManager *PluginHostHardwareManager::networkManager()
+{
+    return m_networkManager;
+}
+
+UpnpDiscovery *PluginHostHardwareManager::upnpDiscovery()
+{
+    return m_upnpDiscovery;
+}
+
+PlatformZeroConfController *PluginHostHardwareManager::zeroConfController()
+{
+    return nullptr;
+}
+
+BluetoothLowEnergyManager *PluginHostHardwareManager::bluetoothLowEnergyManager()
+{
+    return nullptr;
+}
+
+MqttProvider *PluginHostHardwareManager::mqttProvider()
+{
+    return nullptr;
+}
+
+I2CManager *PluginHostHardwareManager::i2cManager()
+{
+    return m_i2cManager;
+}
+
+ZigbeeHardwareResource *PluginHostHardwareManager::zigbeeResource()
+{
+    return nullptr;
+}
+
+ModbusRtuHardwareResource *PluginHostHardwareManager::modbusRtuResource()
+{
+    return nullptr;
+}
+
+NetworkDeviceDiscovery *PluginHostHardwareManager::networkDeviceDiscovery()
+{
+    return m_networkDeviceDiscovery;
+}
+
+CoapHardwareResource *PluginHostHardwareManager::coapResource()
+{
+    return m_coapResource;
+}
@@ -0,0 +1,71 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef PLUGINHOSTHARDWAREMANAGER_H
+#define PLUGINHOSTHARDWAREMANAGER_H
+
+#include "hardwaremanager.h"
+
+#include <QObject>
+#include <QNetworkAccessManager>
+
+/* The hardware resources a plugin host can provide on its own. Resources shared by all plugins
+   in nymead, like the radio, Bluetooth, MQTT, Zigbee, Modbus RTU and ZeroConf, are not available. */
+class PluginHostHardwareManager : public HardwareManager
+{
+    Q_OBJECT
+public:
+    explicit PluginHostHardwareManager(QObject *parent = nullptr);
+
+    Radio433 *radio433() override;
+    PluginTimerManager *pluginTimerManager() override;
+    NetworkAccessManager *networkManager() override;
+    UpnpDiscovery *upnpDiscovery() override;
+    PlatformZeroConfController *zeroConfController() override;
+    BluetoothLowEnergyManager *bluetoothLowEnergyManager() override;
+    MqttProvider *mqttProvider() override;
+    I2CManager *i2cManager() override;
+    ZigbeeHardwareResource *zigbeeResource() override;
+    ModbusRtuHardwareResource *modbusRtuResource() override;
+    NetworkDeviceDiscovery *networkDeviceDiscovery() override;
+    CoapHardwareResource *coapResource() override;
+
+private:
+    QNetworkAccessManager *m_networkAccessManager = nullptr;
+
+    PluginTimerManager *m_pluginTimerManager = nullptr;
+    NetworkAccessManager *m_networkManager = nullptr;
+    UpnpDiscovery *m_upnpDiscovery = nullptr;
+    I2CManager *m_i2cManager = nullptr;
+    NetworkDeviceDiscovery *m_networkDeviceDiscovery = nullptr;
+    CoapHardwareResource *m_coapResource = nullptr;
+};
+
+#endif // PLUGINHOSTHARDWAREMANAGER_H
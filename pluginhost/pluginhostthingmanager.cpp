@@ -0,0 +1,431 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "pluginhostthingmanager.h"
+#include "pluginhosthardwaremanager.h"
+#include "integrations/pluginhost/pluginhostprotocol.h"
+#include "integrations/timeoutwheel.h"
+
+#include <QPluginLoader>
+
+PluginHostThingManager::PluginHostThingManager(QObject *parent):
+    ThingManager(parent),
+    m_hardwareManager(new PluginHostHardwareManager(this)),
+    m_apiKeyStorage(new ApiKeyStorage(this)),
+    m_timeoutWheel(new TimeoutWheel(100, 512, this))
+{
+
+}
+
+IntegrationPlugin *PluginHostThingManager::loadPlugin(const QString &fileName)
+{
+    QPluginLoader loader(fileName);
+    loader.setLoadHints(QLibrary::ResolveAllSymbolsHint);
+
+    PluginMetadata metadata(loader.metaData().value("MetaData").toObject(), false, false);
+    if (!metadata.isValid()) {
+        foreach (const QString &error, metadata.validationErrors()) {
+            qCWarning(dcPluginHost()) << error;
+        }
+        return nullptr;
+    }
+
+    IntegrationPlugin *plugin = qobject_cast<IntegrationPlugin*>(loader.instance());
+    if (!plugin) {
+        qCWarning(dcPluginHost()) << "Error loading plugin" << fileName << loader.errorString();
+        return nullptr;
+    }
+
+    plugin->setParent(this);
+    plugin->setMetaData(metadata);
+    plugin->initPlugin(this, m_hardwareManager, m_apiKeyStorage);
+    m_plugin = plugin;
+    return plugin;
+}
+
+ApiKeyStorage *PluginHostThingManager::apiKeyStorage() const
+{
+    return m_apiKeyStorage;
+}
+
+Thing *PluginHostThingManager::addThing(const ThingId &thingId, const ThingClassId &thingClassId, const QString &name, const ThingId &parentId, bool autoCreated, const ParamList &params, const ParamList &settings, const States &states)
+{
+    Thing *thing = m_things.value(thingId);
+    if (thing) {
+        // Reconfiguring, the states are owned by the plugin
+        thing->setParams(params);
+        thing->setName(name);
+        thing->setSettings(settings);
+        return thing;
+    }
+
+    ThingClass thingClass = m_plugin->thingClass(thingClassId);
+    if (!thingClass.isValid()) {
+        return nullptr;
+    }
+
+    thing = new Thing(m_plugin->pluginId(), thingClass, thingId, this);
+    thing->setName(name);
+    thing->setParentId(parentId);
+    thing->m_autoCreated = autoCreated;
+    thing->setParams(params);
+    thing->setSettings(settings);
+
+    States thingStates;
+    foreach (const State &state, states) {
+        State thingState(state.stateTypeId(), thingId);
+        thingState.setValue(state.value());
+        thingState.setMinValue(state.minValue());
+        thingState.setMaxValue(state.maxValue());
+        thingStates.append(thingState);
+    }
+    thing->setStates(thingStates);
+
+    m_things.insert(thingId, thing);
+    return thing;
+}
+
+void PluginHostThingManager::removeThing(Thing *thing)
+{
+    m_things.remove(thing->id());
+    thing->deleteLater();
+}
+
+void PluginHostThingManager::setSetupStatus(Thing *thing, Thing::ThingError error, const QString &displayMessage)
+{
+    if (error == Thing::ThingErrorNoError) {
+        thing->setSetupStatus(Thing::ThingSetupStatusComplete, error);
+    } else {
+        thing->setSetupStatus(Thing::ThingSetupStatusFailed, error, displayMessage);
+    }
+}
+
+IntegrationPlugins PluginHostThingManager::plugins() const
+{
+    IntegrationPlugins plugins;
+    if (m_plugin) {
+        plugins.append(m_plugin);
+    }
+    return plugins;
+}
+
+IntegrationPlugin *PluginHostThingManager::plugin(const PluginId &pluginId) const
+{
+    return m_plugin && m_plugin->pluginId() == pluginId ? m_plugin : nullptr;
+}
+
+Thing::ThingError PluginHostThingManager::setPluginConfig(const PluginId &pluginId, const ParamList &pluginConfig)
+{
+    if (!plugin(pluginId)) {
+        return Thing::ThingErrorPluginNotFound;
+    }
+    return m_plugin->setConfiguration(pluginConfig);
+}
+
+Vendors PluginHostThingManager::supportedVendors() const
+{
+    return m_plugin ? m_plugin->supportedVendors() : Vendors();
+}
+
+Interfaces PluginHostThingManager::supportedInterfaces() const
+{
+    return Interfaces();
+}
+
+ThingClasses PluginHostThingManager::supportedThings(const VendorId &vendorId) const
+{
+    ThingClasses ret;
+    if (m_plugin) {
+        foreach (const ThingClass &thingClass, m_plugin->supportedThings()) {
+            if (vendorId.isNull() || thingClass.vendorId() == vendorId) {
+                ret.append(thingClass);
+            }
+        }
+    }
+    return ret;
+}
+
+ThingClass PluginHostThingManager::findThingClass(const ThingClassId &thingClassId) const
+{
+    return m_plugin ? m_plugin->thingClass(thingClassId) : ThingClass();
+}
+
+Things PluginHostThingManager::configuredThings() const
+{
+    return m_things.values();
+}
+
+Thing *PluginHostThingManager::findConfiguredThing(const ThingId &id) const
+{
+    return m_things.value(id);
+}
+
+Things PluginHostThingManager::findConfiguredThings(const ThingClassId &thingClassId) const
+{
+    return configuredThings().filterByThingClassId(thingClassId);
+}
+
+Things PluginHostThingManager::findConfiguredThings(const QString &interface) const
+{
+    return configuredThings().filterByInterface(interface);
+}
+
+Things PluginHostThingManager::findChilds(const ThingId &id) const
+{
+    return configuredThings().filterByParentId(id);
+}
+
+ThingDiscoveryInfo *PluginHostThingManager::discoverThings(const ThingClassId &thingClassId, const ParamList &params)
+{
+    Q_UNUSED(thingClassId)
+    Q_UNUSED(params)
+    return nullptr;
+}
+
+ThingSetupInfo *PluginHostThingManager::addConfiguredThing(const ThingClassId &thingClassId, const ParamList &params, const QString &name)
+{
+    Q_UNUSED(thingClassId)
+    Q_UNUSED(params)
+    Q_UNUSED(name)
+    return nullptr;
+}
+
+ThingSetupInfo *PluginHostThingManager::addConfiguredThing(const ThingDescriptorId &thingDescriptorId, const ParamList &params, const QString &name)
+{
+    Q_UNUSED(thingDescriptorId)
+    Q_UNUSED(params)
+    Q_UNUSED(name)
+    return nullptr;
+}
+
+ThingSetupInfo *PluginHostThingManager::reconfigureThing(const ThingId &thingId, const ParamList &params, const QString &name)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(params)
+    Q_UNUSED(name)
+    return nullptr;
+}
+
+ThingSetupInfo *PluginHostThingManager::reconfigureThing(const ThingDescriptorId &thingDescriptorId, const ParamList &params, const QString &name)
+{
+    Q_UNUSED(thingDescriptorId)
+    Q_UNUSED(params)
+    Q_UNUSED(name)
+    return nullptr;
+}
+
+ThingPairingInfo *PluginHostThingManager::pairThing(const ThingClassId &thingClassId, const ParamList &params, const QString &name)
+{
+    Q_UNUSED(thingClassId)
+    Q_UNUSED(params)
+    Q_UNUSED(name)
+    return nullptr;
+}
+
+ThingPairingInfo *PluginHostThingManager::pairThing(const ThingDescriptorId &thingDescriptorId, const ParamList &params, const QString &name)
+{
+    Q_UNUSED(thingDescriptorId)
+    Q_UNUSED(params)
+    Q_UNUSED(name)
+    return nullptr;
+}
+
+ThingPairingInfo *PluginHostThingManager::pairThing(const ThingId &thingId, const ParamList &params, const QString &name)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(params)
+    Q_UNUSED(name)
+    return nullptr;
+}
+
+ThingPairingInfo *PluginHostThingManager::confirmPairing(const PairingTransactionId &pairingTransactionId, const QString &username, const QString &secret)
+{
+    Q_UNUSED(pairingTransactionId)
+    Q_UNUSED(username)
+    Q_UNUSED(secret)
+    return nullptr;
+}
+
+Thing::ThingError PluginHostThingManager::editThing(const ThingId &thingId, const QString &name)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(name)
+    return Thing::ThingErrorUnsupportedFeature;
+}
+
+Thing::ThingError PluginHostThingManager::setThingSettings(const ThingId &thingId, const ParamList &settings)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(settings)
+    return Thing::ThingErrorUnsupportedFeature;
+}
+
+Thing::ThingError PluginHostThingManager::setEventLogging(const ThingId &thingId, const EventTypeId &eventTypeId, bool enabled)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(eventTypeId)
+    Q_UNUSED(enabled)
+    return Thing::ThingErrorUnsupportedFeature;
+}
+
+Thing::ThingError PluginHostThingManager::setStateFilter(const ThingId &thingId, const StateTypeId &stateTypeId, Types::StateValueFilter filter)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(stateTypeId)
+    Q_UNUSED(filter)
+    return Thing::ThingErrorUnsupportedFeature;
+}
+
+Thing::ThingError PluginHostThingManager::setStateChangePolicy(const ThingId &thingId, const StateTypeId &stateTypeId, const StateChangePolicy &policy)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(stateTypeId)
+    Q_UNUSED(policy)
+    return Thing::ThingErrorUnsupportedFeature;
+}
+
+Thing::ThingError PluginHostThingManager::removeConfiguredThing(const ThingId &thingId)
+{
+    Q_UNUSED(thingId)
+    return Thing::ThingErrorUnsupportedFeature;
+}
+
+ThingActionInfo *PluginHostThingManager::executeAction(const Action &action)
+{
+    Q_UNUSED(action)
+    return nullptr;
+}
+
+QList<ThingActionInfo *> PluginHostThingManager::executeActions(const QList<Action> &actions)
+{
+    Q_UNUSED(actions)
+    return QList<ThingActionInfo *>();
+}
+
+BrowseResult *PluginHostThingManager::browseThing(const ThingId &thingId, const QString &itemId, const QLocale &locale)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(itemId)
+    Q_UNUSED(locale)
+    return nullptr;
+}
+
+BrowserItemResult *PluginHostThingManager::browserItemDetails(const ThingId &thingId, const QString &itemId, const QLocale &locale)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(itemId)
+    Q_UNUSED(locale)
+    return nullptr;
+}
+
+BrowserActionInfo *PluginHostThingManager::executeBrowserItem(const BrowserAction &browserAction)
+{
+    Q_UNUSED(browserAction)
+    return nullptr;
+}
+
+BrowserItemActionInfo *PluginHostThingManager::executeBrowserItemAction(const BrowserItemAction &browserItemAction)
+{
+    Q_UNUSED(browserItemAction)
+    return nullptr;
+}
+
+IOConnections PluginHostThingManager::ioConnections(const ThingId &thingId) const
+{
+    Q_UNUSED(thingId)
+    return IOConnections();
+}
+
+Thing::ThingError PluginHostThingManager::disconnectIO(const IOConnectionId &ioConnectionId)
+{
+    Q_UNUSED(ioConnectionId)
+    return Thing::ThingErrorUnsupportedFeature;
+}
+
+// Translations are done by nymead, the host always works with the untranslated strings
+QString PluginHostThingManager::translate(const PluginId &pluginId, const QString &string, const QLocale &locale)
+{
+    Q_UNUSED(pluginId)
+    Q_UNUSED(locale)
+    return string;
+}
+
+ParamType PluginHostThingManager::translateParamType(const PluginId &pluginId, const ParamType &paramType, const QLocale &locale)
+{
+    Q_UNUSED(pluginId)
+    Q_UNUSED(locale)
+    return paramType;
+}
+
+StateType PluginHostThingManager::translateStateType(const PluginId &pluginId, const StateType &stateType, const QLocale &locale)
+{
+    Q_UNUSED(pluginId)
+    Q_UNUSED(locale)
+    return stateType;
+}
+
+EventType PluginHostThingManager::translateEventType(const PluginId &pluginId, const EventType &eventType, const QLocale &locale)
+{
+    Q_UNUSED(pluginId)
+    Q_UNUSED(locale)
+    return eventType;
+}
+
+ActionType PluginHostThingManager::translateActionType(const PluginId &pluginId, const ActionType &actionType, const QLocale &locale)
+{
+    Q_UNUSED(pluginId)
+    Q_UNUSED(locale)
+    return actionType;
+}
+
+ThingClass PluginHostThingManager::translateThingClass(const ThingClass &thingClass, const QLocale &locale)
+{
+    Q_UNUSED(locale)
+    return thingClass;
+}
+
+Vendor PluginHostThingManager::translateVendor(const Vendor &vendor, const QLocale &locale)
+{
+    Q_UNUSED(locale)
+    return vendor;
+}
+
+TimeoutWheel *PluginHostThingManager::timeoutWheel() const
+{
+    return m_timeoutWheel;
+}
+
+IOConnectionResult PluginHostThingManager::connectIO(const IOConnection &connection)
+{
+    Q_UNUSED(connection)
+    IOConnectionResult result;
+    result.error = Thing::ThingErrorUnsupportedFeature;
+    return result;
+}
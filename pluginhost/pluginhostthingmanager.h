@@ -0,0 +1,129 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef PLUGINHOSTTHINGMANAGER_H
+#define PLUGINHOSTTHINGMANAGER_H
+
+#include "integrations/thingmanager.h"
+#include "network/apikeys/apikeystorage.h"
+
+#include <QObject>
+#include <QHash>
+
+class PluginHostHardwareManager;
+
+/* The thing manager of a plugin host. It holds the one plugin and mirrors of its things as set up by
+   nymead. Everything the plugin can't do from within a plugin host fails with ThingErrorUnsupportedFeature. */
+class PluginHostThingManager : public ThingManager
+{
+    Q_OBJECT
+public:
+    explicit PluginHostThingManager(QObject *parent = nullptr);
+
+    IntegrationPlugin *loadPlugin(const QString &fileName);
+    ApiKeyStorage *apiKeyStorage() const;
+
+    Thing *addThing(const ThingId &thingId, const ThingClassId &thingClassId, const QString &name, const ThingId &parentId,
+                    bool autoCreated, const ParamList &params, const ParamList &settings, const States &states);
+    void removeThing(Thing *thing);
+    void setSetupStatus(Thing *thing, Thing::ThingError error, const QString &displayMessage);
+
+    IntegrationPlugins plugins() const override;
+    IntegrationPlugin* plugin(const PluginId &pluginId) const override;
+    Thing::ThingError setPluginConfig(const PluginId &pluginId, const ParamList &pluginConfig) override;
+
+    Vendors supportedVendors() const override;
+    Interfaces supportedInterfaces() const override;
+    ThingClasses supportedThings(const VendorId &vendorId = VendorId()) const override;
+
+    ThingClass findThingClass(const ThingClassId &thingClassId) const override;
+
+    Things configuredThings() const override;
+    Thing* findConfiguredThing(const ThingId &id) const override;
+    Things findConfiguredThings(const ThingClassId &thingClassId) const override;
+    Things findConfiguredThings(const QString &interface) const override;
+    Things findChilds(const ThingId &id) const override;
+
+    ThingDiscoveryInfo* discoverThings(const ThingClassId &thingClassId, const ParamList &params) override;
+
+    ThingSetupInfo* addConfiguredThing(const ThingClassId &thingClassId, const ParamList &params, const QString &name = QString()) override;
+    ThingSetupInfo* addConfiguredThing(const ThingDescriptorId &thingDescriptorId, const ParamList &params = ParamList(), const QString &name = QString()) override;
+
+    ThingSetupInfo* reconfigureThing(const ThingId &thingId, const ParamList &params, const QString &name = QString()) override;
+    ThingSetupInfo* reconfigureThing(const ThingDescriptorId &thingDescriptorId, const ParamList &params = ParamList(), const QString &name = QString()) override;
+
+    ThingPairingInfo* pairThing(const ThingClassId &thingClassId, const ParamList &params, const QString &name = QString()) override;
+    ThingPairingInfo* pairThing(const ThingDescriptorId &thingDescriptorId, const ParamList &params = ParamList(), const QString &name = QString()) override;
+    ThingPairingInfo* pairThing(const ThingId &thingId, const ParamList &params, const QString &name = QString()) override;
+    ThingPairingInfo* confirmPairing(const PairingTransactionId &pairingTransactionId, const QString &username = QString(), const QString &secret = QString()) override;
+
+    Thing::ThingError editThing(const ThingId &thingId, const QString &name) override;
+    Thing::ThingError setThingSettings(const ThingId &thingId, const ParamList &settings) override;
+
+    Thing::ThingError setEventLogging(const ThingId &thingId, const EventTypeId &eventTypeId, bool enabled) override;
+    Thing::ThingError setStateFilter(const ThingId &thingId, const StateTypeId &stateTypeId, Types::StateValueFilter filter) override;
+    Thing::ThingError setStateChangePolicy(const ThingId &thingId, const StateTypeId &stateTypeId, const StateChangePolicy &policy) override;
+
+    Thing::ThingError removeConfiguredThing(const ThingId &thingId) override;
+
+    ThingActionInfo* executeAction(const Action &action) override;
+    QList<ThingActionInfo*> executeActions(const QList<Action> &actions) override;
+
+    BrowseResult* browseThing(const ThingId &thingId, const QString &itemId, const QLocale &locale) override;
+    BrowserItemResult* browserItemDetails(const ThingId &thingId, const QString &itemId, const QLocale &locale) override;
+    BrowserActionInfo* executeBrowserItem(const BrowserAction &browserAction) override;
+    BrowserItemActionInfo* executeBrowserItemAction(const BrowserItemAction &browserItemAction) override;
+
+    IOConnections ioConnections(const ThingId &thingId = ThingId()) const override;
+    Thing::ThingError disconnectIO(const IOConnectionId &ioConnectionId) override;
+
+    QString translate(const PluginId &pluginId, const QString &string, const QLocale &locale) override;
+    ParamType translateParamType(const PluginId &pluginId, const ParamType &paramType, const QLocale &locale) override;
+    StateType translateStateType(const PluginId &pluginId, const StateType &stateType, const QLocale &locale) override;
+    EventType translateEventType(const PluginId &pluginId, const EventType &eventType, const QLocale &locale) override;
+    ActionType translateActionType(const PluginId &pluginId, const ActionType &actionType, const QLocale &locale) override;
+    ThingClass translateThingClass(const ThingClass &thingClass, const QLocale &locale) override;
+    Vendor translateVendor(const Vendor &vendor, const QLocale &locale) override;
+
+    TimeoutWheel *timeoutWheel() const override;
+
+protected:
+    IOConnectionResult connectIO(const IOConnection &connection) override;
+
+private:
+    PluginHostHardwareManager *m_hardwareManager = nullptr;
+    ApiKeyStorage *m_apiKeyStorage = nullptr;
+    TimeoutWheel *m_timeoutWheel = nullptr;
+
+    IntegrationPlugin *m_plugin = nullptr;
+    QHash<ThingId, Thing*> m_things;
+};
+
+#endif // PLUGINHOSTTHINGMANAGER_H
@@ -43,6 +43,9 @@
 #include <QRegExp>
 #include <QStringList>
 
+#include <chrono>
+#include <climits>
+
 HttpDaemon::HttpDaemon(Thing *thing, IntegrationPlugin *parent):
     QTcpServer(parent), disabled(false), m_plugin(parent), m_thing(thing)
 {
@@ -50,6 +53,9 @@ HttpDaemon::HttpDaemon(Thing *thing, IntegrationPlugin *parent):
     portMap.insert(mockThingClassId, mockThingHttpportParamTypeId);
     portMap.insert(autoMockThingClassId, autoMockThingHttpportParamTypeId);
     listen(QHostAddress::Any, thing->paramValue(portMap.value(thing->thingClassId())).toInt());
+
+    m_generatorTimer.setInterval(5);
+    connect(&m_generatorTimer, &QTimer::timeout, this, &HttpDaemon::generateStates);
 }
 
 HttpDaemon::~HttpDaemon()
@@ -108,6 +114,17 @@ void HttpDaemon::readClient()
             emit setState(stateTypeId, stateValue);
         } else if (url.path() == "/generateevent") {
             emit triggerEvent(EventTypeId(query.queryItemValue("eventtypeid")));
+        } else if (url.path() == "/generatestates") {
+            m_generatorRate = query.queryItemValue("rate").toInt();
+            m_generatorCount = query.queryItemValue("count").toInt();
+            m_generated = 0;
+            qCDebug(dcMock()) << "Generating" << m_generatorCount << "state changes at" << m_generatorRate << "per second";
+            m_generatorClock.start();
+            if (m_generatorRate > 0 && m_generatorCount > 0) {
+                m_generatorTimer.start();
+            } else {
+                m_generatorTimer.stop();
+            }
         } else if (url.path() == "/actionhistory") {
             qCDebug(dcMock()) << "Get action history called";
 
@@ -149,6 +166,26 @@ void HttpDaemon::discardClient()
     socket->deleteLater();
 }
 
+// The values are the microseconds of the monotonic clock, wrapping after about 35 minutes. That way a benchmark
+// running in the same process can tell how long it took the state change to reach it.
+void HttpDaemon::generateStates()
+{
+    int due = qMin<qint64>(m_generatorCount, m_generatorClock.elapsed() * m_generatorRate / 1000);
+    while (m_generated < due) {
+        qint64 now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        int value = static_cast<int>(now % INT_MAX);
+        if (value == m_lastGeneratedValue) {
+            value = (value + 1) % INT_MAX;
+        }
+        m_lastGeneratedValue = value;
+        m_generated++;
+        emit setState(mockIntStateTypeId, value);
+    }
+    if (m_generated >= m_generatorCount) {
+        m_generatorTimer.stop();
+    }
+}
+
 QString HttpDaemon::generateHeader()
 {
     QString contentHeader(
@@ -36,6 +36,8 @@
 #include <QTcpServer>
 #include <QUuid>
 #include <QDateTime>
+#include <QTimer>
+#include <QElapsedTimer>
 
 class Thing;
 class IntegrationPlugin;
@@ -59,6 +61,7 @@ signals:
 private slots:
     void readClient();
     void discardClient();
+    void generateStates();
 
 private:
     QString generateHeader();
@@ -71,6 +74,14 @@ private:
     Thing *m_thing;
 
     QList<QPair<ActionTypeId, QDateTime> > m_actionList;
+
+    // Changes of the int state generated at a fixed rate, for benchmarks
+    QTimer m_generatorTimer;
+    QElapsedTimer m_generatorClock;
+    int m_generatorRate = 0;
+    int m_generatorCount = 0;
+    int m_generated = 0;
+    int m_lastGeneratedValue = -1;
 };
 
 #endif // HTTPDAEMON_H
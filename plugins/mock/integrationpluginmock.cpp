@@ -30,6 +30,7 @@
 
 #include "integrationpluginmock.h"
 #include "httpdaemon.h"
+#include "loadgenerator.h"
 
 #include "types/mediabrowseritem.h"
 #include "integrations/thing.h"
@@ -126,6 +127,18 @@ void IntegrationPluginMock::discoverThings(ThingDiscoveryInfo *info)
         return;
     }
 
+    if (info->thingClassId() == loadGeneratorMockThingClassId) {
+        int resultCount = info->params().paramValue(loadGeneratorMockDiscoveryResultCountParamTypeId).toInt();
+        qCDebug(dcMock()) << "Discovering" << resultCount << "load generators";
+        QTimer::singleShot(0, info, [info, resultCount](){
+            for (int i = 0; i < resultCount; i++) {
+                info->addThingDescriptor(ThingDescriptor(loadGeneratorMockThingClassId, QString("Load Generator %1 (Discovered)").arg(i + 1)));
+            }
+            info->finish(Thing::ThingErrorNoError);
+        });
+        return;
+    }
+
     qCWarning(dcMock()) << "Cannot discover for ThingClassId" << info->thingClassId();
     info->finish(Thing::ThingErrorThingNotFound);
 }
@@ -273,6 +286,14 @@ void IntegrationPluginMock::setupThing(ThingSetupInfo *info)
         return;
     }
 
+    if (info->thing()->thingClassId() == loadGeneratorMockThingClassId) {
+        delete m_loadGenerators.take(info->thing());
+        m_loadGenerators.insert(info->thing(), new LoadGenerator(info->thing(), this));
+        qCDebug(dcMock()) << "Load generator mock setup complete";
+        info->finish(Thing::ThingErrorNoError);
+        return;
+    }
+
     qCWarning(dcMock()) << "Unhandled thing class" << info->thing()->thingClass();
     info->finish(Thing::ThingErrorThingClassNotFound);
 }
@@ -296,6 +317,7 @@ void IntegrationPluginMock::thingRemoved(Thing *thing)
 {
     qCDebug(dcMock()) << "Thing removed" << thing->name();
     delete m_daemons.take(thing);
+    delete m_loadGenerators.take(thing);
 }
 
 void IntegrationPluginMock::startMonitoringAutoThings()
@@ -596,16 +618,17 @@ void IntegrationPluginMock::executeAction(ThingActionInfo *info)
             return;
         }
 
-        if (info->action().actionTypeId() == mockPowerActionTypeId) {
-            qCDebug(dcMock()) << "Setting power to" << info->action().param(mockPowerActionPowerParamTypeId).value().toBool();
-            info->thing()->setStateValue(mockPowerStateTypeId, info->action().param(mockPowerActionPowerParamTypeId).value().toBool());
+        if (mockPowerAction.matches(info->action())) {
+            bool power = mockPowerActionPowerParam.value(info->action().params());
+            qCDebug(dcMock()) << "Setting power to" << power;
+            mockPowerState.set(info->thing(), power);
         }
 
-        if (info->action().actionTypeId() == mockBatteryLevelActionTypeId) {
-            int newLevel = info->action().param(mockBatteryLevelActionBatteryLevelParamTypeId).value().toInt();
+        if (mockBatteryLevelAction.matches(info->action())) {
+            int newLevel = mockBatteryLevelActionBatteryLevelParam.value(info->action().params());
             qCDebug(dcMock()) << "Setting battery level to" << newLevel;
-            info->thing()->setStateValue(mockBatteryLevelStateTypeId, newLevel);
-            info->thing()->setStateValue(mockBatteryCriticalStateTypeId, newLevel < 10);
+            mockBatteryLevelState.set(info->thing(), newLevel);
+            mockBatteryCriticalState.set(info->thing(), newLevel < 10);
         }
 
         if (info->action().actionTypeId() == mockSignalStrengthActionTypeId) {
@@ -615,11 +638,11 @@ void IntegrationPluginMock::executeAction(ThingActionInfo *info)
             info->thing()->setStateValue(mockConnectedStateTypeId, newStrength != 0);
         }
 
-        if (info->action().actionTypeId() == mockUpdateStatusActionTypeId) {
-            QString newUpdateStatus = info->action().param(mockUpdateStatusActionUpdateStatusParamTypeId).value().toString();
+        if (mockUpdateStatusAction.matches(info->action())) {
+            QString newUpdateStatus = mockUpdateStatusActionUpdateStatusParam.value(info->action().params());
             qCDebug(dcMock()) << "Setting update status to" << newUpdateStatus;
-            info->thing()->setStateValue(mockUpdateStatusStateTypeId, newUpdateStatus);
-            info->thing()->setStateValue(mockAvailableVersionStateTypeId, newUpdateStatus == "available" ? "2.0" : "1.0");
+            mockUpdateStatusState.set(info->thing(), newUpdateStatus);
+            mockAvailableVersionState.set(info->thing(), QString(newUpdateStatus == "available" ? "2.0" : "1.0"));
         }
         m_daemons.value(info->thing())->actionExecuted(info->action().actionTypeId());
         info->finish(Thing::ThingErrorNoError);
@@ -656,20 +679,20 @@ void IntegrationPluginMock::executeAction(ThingActionInfo *info)
             info->thing()->setStateValue(pushButtonMockColorStateTypeId, colorString);
             info->finish(Thing::ThingErrorNoError);
             return;
-        } else if (info->action().actionTypeId() == pushButtonMockPercentageActionTypeId) {
-            info->thing()->setStateValue(pushButtonMockPercentageStateTypeId, info->action().param(pushButtonMockPercentageActionPercentageParamTypeId).value().toInt());
+        } else if (pushButtonMockPercentageAction.matches(info->action())) {
+            pushButtonMockPercentageState.set(info->thing(), pushButtonMockPercentageActionPercentageParam.value(info->action().params()));
             info->finish(Thing::ThingErrorNoError);
             return;
-        } else if (info->action().actionTypeId() == pushButtonMockAllowedValuesActionTypeId) {
-            info->thing()->setStateValue(pushButtonMockAllowedValuesStateTypeId, info->action().param(pushButtonMockAllowedValuesActionAllowedValuesParamTypeId).value().toString());
+        } else if (pushButtonMockAllowedValuesAction.matches(info->action())) {
+            pushButtonMockAllowedValuesState.set(info->thing(), pushButtonMockAllowedValuesActionAllowedValuesParam.value(info->action().params()));
             info->finish(Thing::ThingErrorNoError);
             return;
-        } else if (info->action().actionTypeId() == pushButtonMockDoubleActionTypeId) {
-            info->thing()->setStateValue(pushButtonMockDoubleStateTypeId, info->action().param(pushButtonMockDoubleActionDoubleParamTypeId).value().toDouble());
+        } else if (pushButtonMockDoubleAction.matches(info->action())) {
+            pushButtonMockDoubleState.set(info->thing(), pushButtonMockDoubleActionDoubleParam.value(info->action().params()));
             info->finish(Thing::ThingErrorNoError);
             return;
-        } else if (info->action().actionTypeId() == pushButtonMockBoolActionTypeId) {
-            info->thing()->setStateValue(pushButtonMockBoolStateTypeId, info->action().param(pushButtonMockBoolActionBoolParamTypeId).value().toBool());
+        } else if (pushButtonMockBoolAction.matches(info->action())) {
+            pushButtonMockBoolState.set(info->thing(), pushButtonMockBoolActionBoolParam.value(info->action().params()));
             info->finish(Thing::ThingErrorNoError);
             return;
         } else if (info->action().actionTypeId() == pushButtonMockTimeoutActionTypeId) {
@@ -763,7 +786,7 @@ void IntegrationPluginMock::executeAction(ThingActionInfo *info)
     if (info->thing()->thingClassId() == virtualIoLightMockThingClassId) {
         if (info->action().actionTypeId() == virtualIoLightMockPowerActionTypeId) {
             qCDebug(dcMock()) << "ExecuteAction for virtual light power action with param" << info->action().param(virtualIoLightMockPowerActionPowerParamTypeId).value();
-            info->thing()->setStateValue(virtualIoLightMockPowerStateTypeId, info->action().param(virtualIoLightMockPowerActionPowerParamTypeId).value());
+            virtualIoLightMockPowerState.set(info->thing(), virtualIoLightMockPowerActionPowerParam.value(info->action().params()));
             info->finish(Thing::ThingErrorNoError);
             return;
         }
@@ -812,6 +835,15 @@ void IntegrationPluginMock::executeAction(ThingActionInfo *info)
         }
     }
 
+    if (info->thing()->thingClassId() == loadGeneratorMockThingClassId) {
+        if (info->action().actionTypeId() == loadGeneratorMockWorkActionTypeId) {
+            QTimer::singleShot(m_loadGenerators.value(info->thing())->actionLatency(), info, [info](){
+                info->finish(Thing::ThingErrorNoError);
+            });
+            return;
+        }
+    }
+
     qCWarning(dcMock()) << "Unhandled executeAction call in mock plugin!";
 }
 
@@ -973,6 +1005,11 @@ void IntegrationPluginMock::generateDiscoveredDevices(ThingDiscoveryInfo *info)
             }
         }
         info->addThingDescriptor(d2);
+
+        // Found again, as if by another discovery mechanism. Dropped as a duplicate by the discovery info.
+        ThingDescriptor d3(mockThingClassId, "Mock Device 1 (Discovered again)", "55555");
+        d3.setParams(ParamList() << Param(mockThingHttpportParamTypeId, "55555"));
+        info->addThingDescriptor(d3);
     }
 
     info->finish(Thing::ThingErrorNoError);
@@ -36,6 +36,7 @@
 #include <QProcess>
 
 class HttpDaemon;
+class LoadGenerator;
 
 class IntegrationPluginMock : public IntegrationPlugin
 {
@@ -101,6 +102,7 @@ private:
     };
 
     QHash<Thing*, HttpDaemon*> m_daemons;
+    QHash<Thing*, LoadGenerator*> m_loadGenerators;
     QList<QPair<Action, Thing*> > m_asyncActions;
 
     int m_discoveredDeviceCount;
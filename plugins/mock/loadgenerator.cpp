@@ -0,0 +1,111 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#include "loadgenerator.h"
+#include "extern-plugininfo.h"
+
+#include "integrations/thing.h"
+
+#include <cmath>
+
+static const QList<StateTypeId> valueStateTypeIds = {
+    loadGeneratorMockValue1StateTypeId,
+    loadGeneratorMockValue2StateTypeId,
+    loadGeneratorMockValue3StateTypeId,
+    loadGeneratorMockValue4StateTypeId,
+    loadGeneratorMockValue5StateTypeId
+};
+
+LoadGenerator::LoadGenerator(Thing *thing, QObject *parent):
+    QObject(parent),
+    m_thing(thing)
+{
+    connect(&m_stateTimer, &QTimer::timeout, this, &LoadGenerator::changeStates);
+    connect(&m_burstTimer, &QTimer::timeout, this, &LoadGenerator::emitBurst);
+    connect(thing, &Thing::settingChanged, this, &LoadGenerator::onSettingChanged);
+
+    onSettingChanged(loadGeneratorMockSettingsStateIntervalParamTypeId);
+    onSettingChanged(loadGeneratorMockSettingsEventBurstIntervalParamTypeId);
+}
+
+int LoadGenerator::actionLatency() const
+{
+    int minLatency = m_thing->setting(loadGeneratorMockSettingsActionLatencyMinParamTypeId).toInt();
+    int maxLatency = qMax(minLatency, m_thing->setting(loadGeneratorMockSettingsActionLatencyMaxParamTypeId).toInt());
+    if (maxLatency == minLatency) {
+        return minLatency;
+    }
+
+    if (m_thing->setting(loadGeneratorMockSettingsActionLatencyDistributionParamTypeId).toString() == "exponential") {
+        // Most actions finish close to the minimum, with a long tail up to the maximum
+        double mean = (maxLatency - minLatency) / 4.0;
+        double random = static_cast<double>(qrand()) / (static_cast<double>(RAND_MAX) + 1);
+        return qMin(maxLatency, minLatency + static_cast<int>(-mean * std::log(1 - random)));
+    }
+    return minLatency + qrand() % (maxLatency - minLatency + 1);
+}
+
+void LoadGenerator::onSettingChanged(const ParamTypeId &settingTypeId)
+{
+    if (settingTypeId == loadGeneratorMockSettingsStateIntervalParamTypeId) {
+        int interval = m_thing->setting(loadGeneratorMockSettingsStateIntervalParamTypeId).toInt();
+        qCDebug(dcMock()) << "Changing states of" << m_thing->name() << "every" << interval << "ms";
+        if (interval > 0) {
+            m_stateTimer.start(interval);
+        } else {
+            m_stateTimer.stop();
+        }
+    }
+    if (settingTypeId == loadGeneratorMockSettingsEventBurstIntervalParamTypeId) {
+        int interval = m_thing->setting(loadGeneratorMockSettingsEventBurstIntervalParamTypeId).toInt();
+        qCDebug(dcMock()) << "Emitting event bursts of" << m_thing->name() << "every" << interval << "ms";
+        if (interval > 0) {
+            m_burstTimer.start(interval);
+        } else {
+            m_burstTimer.stop();
+        }
+    }
+}
+
+void LoadGenerator::changeStates()
+{
+    int count = qBound(1, m_thing->setting(loadGeneratorMockSettingsStateCountParamTypeId).toInt(), valueStateTypeIds.count());
+    for (int i = 0; i < count; i++) {
+        const StateTypeId &stateTypeId = valueStateTypeIds.at(i);
+        m_thing->setStateValue(stateTypeId, m_thing->stateValue(stateTypeId).toInt() + 1);
+    }
+}
+
+void LoadGenerator::emitBurst()
+{
+    int size = m_thing->setting(loadGeneratorMockSettingsEventBurstSizeParamTypeId).toInt();
+    for (int i = 0; i < size; i++) {
+        m_thing->emitEvent(loadGeneratorMockBurstEventTypeId, ParamList() << Param(loadGeneratorMockBurstEventIndexParamTypeId, m_burstIndex++));
+    }
+}
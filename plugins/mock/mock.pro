@@ -8,8 +8,10 @@ OTHER_FILES += integrationpluginmock.json
 
 SOURCES += \
     integrationpluginmock.cpp \
-    httpdaemon.cpp
+    httpdaemon.cpp \
+    loadgenerator.cpp
 
 HEADERS += \
     integrationpluginmock.h \
-    httpdaemon.h
+    httpdaemon.h \
+    loadgenerator.h
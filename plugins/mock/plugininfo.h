@@ -10,11 +10,12 @@
 #define PLUGININFO_H
 
 #include "typeutils.h"
+#include "integrations/pluginaccessors.h"
 
 #include <QLoggingCategory>
 #include <QObject>
 
-extern "C" const QString libnymea_api_version() { return QString("7.2.0");}
+extern "C" const QString libnymea_api_version() { return QString("8.36.0");}
 
 Q_DECLARE_LOGGING_CATEGORY(dcMock)
 Q_LOGGING_CATEGORY(dcMock, "Mock")
@@ -337,8 +338,369 @@ EventTypeId virtualIoTemperatureSensorMockTemperatureEventTypeId = EventTypeId("
 ParamTypeId virtualIoTemperatureSensorMockTemperatureEventTemperatureParamTypeId = ParamTypeId("{db9cc518-1012-47e2-8212-6e616fed07a6}");
 ActionTypeId virtualIoTemperatureSensorMockInputActionTypeId = ActionTypeId("{fd341f72-6d9a-4812-9f66-47197c48a935}");
 ParamTypeId virtualIoTemperatureSensorMockInputActionInputParamTypeId = ParamTypeId("{fd341f72-6d9a-4812-9f66-47197c48a935}");
+ThingClassId loadGeneratorMockThingClassId = ThingClassId("{7096c9cd-1b47-4e5e-8b63-7a20320b9015}");
+ParamTypeId loadGeneratorMockSettingsStateIntervalParamTypeId = ParamTypeId("{bc0881bf-d6aa-4d80-b562-4042a61dfeb9}");
+ParamTypeId loadGeneratorMockSettingsStateCountParamTypeId = ParamTypeId("{2636b699-a8a2-46e0-913e-821162cace1c}");
+ParamTypeId loadGeneratorMockSettingsEventBurstIntervalParamTypeId = ParamTypeId("{adc08903-3b2f-43d8-b3a7-5affbb50f9c0}");
+ParamTypeId loadGeneratorMockSettingsEventBurstSizeParamTypeId = ParamTypeId("{a5a5d6f0-69f4-46a5-a9fe-3653b7043252}");
+ParamTypeId loadGeneratorMockSettingsActionLatencyMinParamTypeId = ParamTypeId("{8992549d-5551-4dfe-80b9-472d87571b3c}");
+ParamTypeId loadGeneratorMockSettingsActionLatencyMaxParamTypeId = ParamTypeId("{830c40af-7c67-4d8b-8b2e-6e6c943de024}");
+ParamTypeId loadGeneratorMockSettingsActionLatencyDistributionParamTypeId = ParamTypeId("{eaf9eda7-7f86-484e-a660-b81283f6d19e}");
+ParamTypeId loadGeneratorMockDiscoveryResultCountParamTypeId = ParamTypeId("{e9cc7c17-6dc9-402c-8982-605cd1fba698}");
+StateTypeId loadGeneratorMockValue1StateTypeId = StateTypeId("{b81c8baf-3cce-4819-a7bd-a7f23cc29b82}");
+StateTypeId loadGeneratorMockValue2StateTypeId = StateTypeId("{b82b2d79-b7c3-4dbc-9c65-e89d8b35c92e}");
+StateTypeId loadGeneratorMockValue3StateTypeId = StateTypeId("{f893e409-45a5-4c5f-af23-40905fdf2101}");
+StateTypeId loadGeneratorMockValue4StateTypeId = StateTypeId("{35245c28-9578-4d28-a2e7-ec7af96030eb}");
+StateTypeId loadGeneratorMockValue5StateTypeId = StateTypeId("{9de7a917-75b4-400b-b14c-c781f6710f24}");
+EventTypeId loadGeneratorMockValue1EventTypeId = EventTypeId("{b81c8baf-3cce-4819-a7bd-a7f23cc29b82}");
+ParamTypeId loadGeneratorMockValue1EventValue1ParamTypeId = ParamTypeId("{b81c8baf-3cce-4819-a7bd-a7f23cc29b82}");
+EventTypeId loadGeneratorMockValue2EventTypeId = EventTypeId("{b82b2d79-b7c3-4dbc-9c65-e89d8b35c92e}");
+ParamTypeId loadGeneratorMockValue2EventValue2ParamTypeId = ParamTypeId("{b82b2d79-b7c3-4dbc-9c65-e89d8b35c92e}");
+EventTypeId loadGeneratorMockValue3EventTypeId = EventTypeId("{f893e409-45a5-4c5f-af23-40905fdf2101}");
+ParamTypeId loadGeneratorMockValue3EventValue3ParamTypeId = ParamTypeId("{f893e409-45a5-4c5f-af23-40905fdf2101}");
+EventTypeId loadGeneratorMockValue4EventTypeId = EventTypeId("{35245c28-9578-4d28-a2e7-ec7af96030eb}");
+ParamTypeId loadGeneratorMockValue4EventValue4ParamTypeId = ParamTypeId("{35245c28-9578-4d28-a2e7-ec7af96030eb}");
+EventTypeId loadGeneratorMockValue5EventTypeId = EventTypeId("{9de7a917-75b4-400b-b14c-c781f6710f24}");
+ParamTypeId loadGeneratorMockValue5EventValue5ParamTypeId = ParamTypeId("{9de7a917-75b4-400b-b14c-c781f6710f24}");
+EventTypeId loadGeneratorMockBurstEventTypeId = EventTypeId("{0045c5d8-bec2-45e9-bbd3-0b5467eb0b99}");
+ParamTypeId loadGeneratorMockBurstEventIndexParamTypeId = ParamTypeId("{b5f57f8a-291f-4842-9b7d-664f787c81db}");
+ActionTypeId loadGeneratorMockWorkActionTypeId = ActionTypeId("{446027e8-639c-4de8-b346-fb24e490e568}");
+
+#ifndef PLUGININFO_ACCESSORS
+#define PLUGININFO_ACCESSORS
+constexpr ParamAccessor<int> mockPluginConfigParamIntParam(QUuid(0xe1f72121, 0xa426, 0x45e2, 0xb4, 0x75, 0x82, 0x62, 0xb5, 0xcd, 0xf1, 0x3));
+constexpr ParamAccessor<bool> mockPluginConfigParamBoolParam(QUuid(0xc75723b6, 0xea4f, 0x4982, 0x97, 0x51, 0x6c, 0x5e, 0x39, 0xc8, 0x81, 0x45));
+constexpr ParamAccessor<int> mockThingHttpportParam(QUuid(0xd4f06047, 0x125e, 0x4479, 0x98, 0x10, 0xb5, 0x4c, 0x18, 0x99, 0x17, 0xf5));
+constexpr ParamAccessor<bool> mockThingAsyncParam(QUuid(0xf2977061, 0x4dd0, 0x4ef5, 0x85, 0xaa, 0x3b, 0x71, 0x34, 0x74, 0x3b, 0xe3));
+constexpr ParamAccessor<bool> mockThingBrokenParam(QUuid(0xae8f8901, 0xf2c1, 0x42a5, 0x81, 0x11, 0x6d, 0x2f, 0xc8, 0xe4, 0xc1, 0xe4));
+constexpr ParamAccessor<int> mockSettingsSetting1Param(QUuid(0x367f7ba4, 0x5039, 0x47be, 0xab, 0xd8, 0x59, 0xcc, 0x8e, 0xaf, 0x4b, 0x9a));
+constexpr ParamAccessor<int> mockSettingsIntStateWithLimitsMinValueParam(QUuid(0x9c34c881, 0xe825, 0x4f27, 0xbb, 0x5c, 0xdb, 0x86, 0x8b, 0xc6, 0xf, 0xb1));
+constexpr ParamAccessor<int> mockSettingsIntStateWithLimitsMaxValueParam(QUuid(0x984e7ae0, 0x6de7, 0x447e, 0xbc, 0x4d, 0x5a, 0xfd, 0xe8, 0xa0, 0xf, 0x27));
+constexpr ParamAccessor<int> mockDiscoveryResultCountParam(QUuid(0xd222adb4, 0x2f9c, 0x4c3f, 0x86, 0x55, 0x76, 0x40, 0xd, 0xf, 0xb6, 0xce));
+constexpr StateAccessor<int> mockIntState(QUuid(0x80baec19, 0x54de, 0x4948, 0xac, 0x46, 0x31, 0xea, 0xbf, 0xac, 0xeb, 0x83), 0);
+constexpr StateAccessor<int> mockIntWithLimitsState(QUuid(0x5aa479bd, 0x537a, 0x4716, 0x98, 0x52, 0x52, 0xf6, 0xee, 0xc5, 0x87, 0x22), 1);
+constexpr StateAccessor<bool> mockBoolState(QUuid(0x9dd6a97c, 0xdfd1, 0x43dc, 0xac, 0xbd, 0x36, 0x79, 0x32, 0x74, 0x23, 0x10), 2);
+constexpr StateAccessor<double> mockDoubleState(QUuid(0x7cac53ee, 0x7048, 0x4dc9, 0xb0, 0x0, 0x7b, 0x58, 0x53, 0x90, 0xf3, 0x4c), 3);
+constexpr StateAccessor<int> mockBatteryLevelState(QUuid(0x6c8ab9a6, 0x164, 0x4795, 0xb8, 0x29, 0xf4, 0x39, 0x4f, 0xe4, 0xed, 0xc4), 4);
+constexpr StateAccessor<bool> mockBatteryCriticalState(QUuid(0x580bc611, 0x1a55, 0x41f3, 0x99, 0x6f, 0x8d, 0x3c, 0xcf, 0x54, 0x3d, 0xb3), 5);
+constexpr StateAccessor<bool> mockPowerState(QUuid(0x64aed0d, 0xda4c, 0x49d4, 0xb2, 0x36, 0x60, 0xf9, 0x7e, 0x98, 0xff, 0x84), 6);
+constexpr StateAccessor<bool> mockConnectedState(QUuid(0x9860d105, 0x2bd9, 0x4651, 0x9b, 0xc9, 0x13, 0xff, 0x4b, 0x90, 0x39, 0xa7), 7);
+constexpr StateAccessor<uint> mockSignalStrengthState(QUuid(0x2a0213bf, 0x4af3, 0x4384, 0x90, 0x4e, 0x33, 0x76, 0x34, 0x8a, 0x59, 0x7e), 8);
+constexpr StateAccessor<QString> mockUpdateStatusState(QUuid(0xebc41327, 0x53d5, 0x40c2, 0x8e, 0x7b, 0x11, 0x64, 0xa8, 0xff, 0x35, 0x9e), 9);
+constexpr StateAccessor<QString> mockCurrentVersionState(QUuid(0x9f2e1e5d, 0x3f1f, 0x4794, 0xac, 0xa3, 0x4e, 0x5, 0xb7, 0xa4, 0x88, 0x42), 10);
+constexpr StateAccessor<QString> mockAvailableVersionState(QUuid(0x60d7947, 0x2b70, 0x4a2b, 0xb3, 0x3b, 0xa3, 0x57, 0x7f, 0x71, 0xfa, 0xeb), 11);
+constexpr EventAccessor mockIntEvent(QUuid(0x80baec19, 0x54de, 0x4948, 0xac, 0x46, 0x31, 0xea, 0xbf, 0xac, 0xeb, 0x83));
+constexpr ParamAccessor<int> mockIntEventIntParam(QUuid(0x80baec19, 0x54de, 0x4948, 0xac, 0x46, 0x31, 0xea, 0xbf, 0xac, 0xeb, 0x83));
+constexpr EventAccessor mockIntWithLimitsEvent(QUuid(0x5aa479bd, 0x537a, 0x4716, 0x98, 0x52, 0x52, 0xf6, 0xee, 0xc5, 0x87, 0x22));
+constexpr ParamAccessor<int> mockIntWithLimitsEventIntWithLimitsParam(QUuid(0x5aa479bd, 0x537a, 0x4716, 0x98, 0x52, 0x52, 0xf6, 0xee, 0xc5, 0x87, 0x22));
+constexpr EventAccessor mockBoolEvent(QUuid(0x9dd6a97c, 0xdfd1, 0x43dc, 0xac, 0xbd, 0x36, 0x79, 0x32, 0x74, 0x23, 0x10));
+constexpr ParamAccessor<bool> mockBoolEventBoolParam(QUuid(0x9dd6a97c, 0xdfd1, 0x43dc, 0xac, 0xbd, 0x36, 0x79, 0x32, 0x74, 0x23, 0x10));
+constexpr EventAccessor mockDoubleEvent(QUuid(0x7cac53ee, 0x7048, 0x4dc9, 0xb0, 0x0, 0x7b, 0x58, 0x53, 0x90, 0xf3, 0x4c));
+constexpr ParamAccessor<double> mockDoubleEventDoubleParam(QUuid(0x7cac53ee, 0x7048, 0x4dc9, 0xb0, 0x0, 0x7b, 0x58, 0x53, 0x90, 0xf3, 0x4c));
+constexpr EventAccessor mockBatteryLevelEvent(QUuid(0x6c8ab9a6, 0x164, 0x4795, 0xb8, 0x29, 0xf4, 0x39, 0x4f, 0xe4, 0xed, 0xc4));
+constexpr ParamAccessor<int> mockBatteryLevelEventBatteryLevelParam(QUuid(0x6c8ab9a6, 0x164, 0x4795, 0xb8, 0x29, 0xf4, 0x39, 0x4f, 0xe4, 0xed, 0xc4));
+constexpr EventAccessor mockBatteryCriticalEvent(QUuid(0x580bc611, 0x1a55, 0x41f3, 0x99, 0x6f, 0x8d, 0x3c, 0xcf, 0x54, 0x3d, 0xb3));
+constexpr ParamAccessor<bool> mockBatteryCriticalEventBatteryCriticalParam(QUuid(0x580bc611, 0x1a55, 0x41f3, 0x99, 0x6f, 0x8d, 0x3c, 0xcf, 0x54, 0x3d, 0xb3));
+constexpr EventAccessor mockPowerEvent(QUuid(0x64aed0d, 0xda4c, 0x49d4, 0xb2, 0x36, 0x60, 0xf9, 0x7e, 0x98, 0xff, 0x84));
+constexpr ParamAccessor<bool> mockPowerEventPowerParam(QUuid(0x64aed0d, 0xda4c, 0x49d4, 0xb2, 0x36, 0x60, 0xf9, 0x7e, 0x98, 0xff, 0x84));
+constexpr EventAccessor mockConnectedEvent(QUuid(0x9860d105, 0x2bd9, 0x4651, 0x9b, 0xc9, 0x13, 0xff, 0x4b, 0x90, 0x39, 0xa7));
+constexpr ParamAccessor<bool> mockConnectedEventConnectedParam(QUuid(0x9860d105, 0x2bd9, 0x4651, 0x9b, 0xc9, 0x13, 0xff, 0x4b, 0x90, 0x39, 0xa7));
+constexpr EventAccessor mockSignalStrengthEvent(QUuid(0x2a0213bf, 0x4af3, 0x4384, 0x90, 0x4e, 0x33, 0x76, 0x34, 0x8a, 0x59, 0x7e));
+constexpr ParamAccessor<uint> mockSignalStrengthEventSignalStrengthParam(QUuid(0x2a0213bf, 0x4af3, 0x4384, 0x90, 0x4e, 0x33, 0x76, 0x34, 0x8a, 0x59, 0x7e));
+constexpr EventAccessor mockUpdateStatusEvent(QUuid(0xebc41327, 0x53d5, 0x40c2, 0x8e, 0x7b, 0x11, 0x64, 0xa8, 0xff, 0x35, 0x9e));
+constexpr ParamAccessor<QString> mockUpdateStatusEventUpdateStatusParam(QUuid(0xebc41327, 0x53d5, 0x40c2, 0x8e, 0x7b, 0x11, 0x64, 0xa8, 0xff, 0x35, 0x9e));
+constexpr EventAccessor mockCurrentVersionEvent(QUuid(0x9f2e1e5d, 0x3f1f, 0x4794, 0xac, 0xa3, 0x4e, 0x5, 0xb7, 0xa4, 0x88, 0x42));
+constexpr ParamAccessor<QString> mockCurrentVersionEventCurrentVersionParam(QUuid(0x9f2e1e5d, 0x3f1f, 0x4794, 0xac, 0xa3, 0x4e, 0x5, 0xb7, 0xa4, 0x88, 0x42));
+constexpr EventAccessor mockAvailableVersionEvent(QUuid(0x60d7947, 0x2b70, 0x4a2b, 0xb3, 0x3b, 0xa3, 0x57, 0x7f, 0x71, 0xfa, 0xeb));
+constexpr ParamAccessor<QString> mockAvailableVersionEventAvailableVersionParam(QUuid(0x60d7947, 0x2b70, 0x4a2b, 0xb3, 0x3b, 0xa3, 0x57, 0x7f, 0x71, 0xfa, 0xeb));
+constexpr EventAccessor mockEvent1Event(QUuid(0x45bf3752, 0xfc6, 0x46b9, 0x89, 0xfd, 0xff, 0xd8, 0x78, 0xb5, 0xb2, 0x2b));
+constexpr EventAccessor mockEvent2Event(QUuid(0x863d5920, 0xb1cf, 0x4eb9, 0x88, 0xbd, 0x8f, 0x7b, 0x85, 0x83, 0xb1, 0xcf));
+constexpr ParamAccessor<int> mockEvent2EventIntParamParam(QUuid(0x550e16d, 0x60b9, 0x4ba5, 0x83, 0xf4, 0x4d, 0x3c, 0xee, 0x65, 0x61, 0x21));
+constexpr ActionAccessor mockIntWithLimitsAction(QUuid(0x5aa479bd, 0x537a, 0x4716, 0x98, 0x52, 0x52, 0xf6, 0xee, 0xc5, 0x87, 0x22));
+constexpr ParamAccessor<int> mockIntWithLimitsActionIntWithLimitsParam(QUuid(0x5aa479bd, 0x537a, 0x4716, 0x98, 0x52, 0x52, 0xf6, 0xee, 0xc5, 0x87, 0x22));
+constexpr ActionAccessor mockBatteryLevelAction(QUuid(0x6c8ab9a6, 0x164, 0x4795, 0xb8, 0x29, 0xf4, 0x39, 0x4f, 0xe4, 0xed, 0xc4));
+constexpr ParamAccessor<int> mockBatteryLevelActionBatteryLevelParam(QUuid(0x6c8ab9a6, 0x164, 0x4795, 0xb8, 0x29, 0xf4, 0x39, 0x4f, 0xe4, 0xed, 0xc4));
+constexpr ActionAccessor mockPowerAction(QUuid(0x64aed0d, 0xda4c, 0x49d4, 0xb2, 0x36, 0x60, 0xf9, 0x7e, 0x98, 0xff, 0x84));
+constexpr ParamAccessor<bool> mockPowerActionPowerParam(QUuid(0x64aed0d, 0xda4c, 0x49d4, 0xb2, 0x36, 0x60, 0xf9, 0x7e, 0x98, 0xff, 0x84));
+constexpr ActionAccessor mockSignalStrengthAction(QUuid(0x2a0213bf, 0x4af3, 0x4384, 0x90, 0x4e, 0x33, 0x76, 0x34, 0x8a, 0x59, 0x7e));
+constexpr ParamAccessor<uint> mockSignalStrengthActionSignalStrengthParam(QUuid(0x2a0213bf, 0x4af3, 0x4384, 0x90, 0x4e, 0x33, 0x76, 0x34, 0x8a, 0x59, 0x7e));
+constexpr ActionAccessor mockUpdateStatusAction(QUuid(0xebc41327, 0x53d5, 0x40c2, 0x8e, 0x7b, 0x11, 0x64, 0xa8, 0xff, 0x35, 0x9e));
+constexpr ParamAccessor<QString> mockUpdateStatusActionUpdateStatusParam(QUuid(0xebc41327, 0x53d5, 0x40c2, 0x8e, 0x7b, 0x11, 0x64, 0xa8, 0xff, 0x35, 0x9e));
+constexpr ActionAccessor mockWithParamsAction(QUuid(0xdea0f4e1, 0x65e3, 0x4981, 0x8e, 0xaa, 0x27, 0x1, 0xc5, 0x3a, 0x91, 0x85));
+constexpr ParamAccessor<int> mockWithParamsActionParam1Param(QUuid(0xa2d3a256, 0xa551, 0x4712, 0xa6, 0x5b, 0xec, 0xd5, 0xa4, 0x36, 0xa1, 0xcb));
+constexpr ParamAccessor<bool> mockWithParamsActionParam2Param(QUuid(0x304a4899, 0x18be, 0x4e3b, 0x94, 0xf4, 0xd0, 0x3b, 0xe5, 0x2f, 0x32, 0x33));
+constexpr ActionAccessor mockWithoutParamsAction(QUuid(0xdefd3ed6, 0x1a0d, 0x400b, 0x88, 0x79, 0xa0, 0x20, 0x2c, 0xf3, 0x99, 0x35));
+constexpr ActionAccessor mockAsyncAction(QUuid(0xfbae06d3, 0x7666, 0x483e, 0xa3, 0x9e, 0xec, 0x50, 0xfe, 0x89, 0x5, 0x4e));
+constexpr ActionAccessor mockFailingAction(QUuid(0xdf3cf33d, 0x26d5, 0x4577, 0x91, 0x32, 0x98, 0x23, 0xbd, 0x33, 0xfa, 0xd0));
+constexpr ActionAccessor mockAsyncFailingAction(QUuid(0xbfe89a1d, 0x3497, 0x4121, 0x83, 0x18, 0xe7, 0x7c, 0x37, 0x53, 0x72, 0x19));
+constexpr ActionAccessor mockPerformUpdateAction(QUuid(0xf2b847dd, 0xab40, 0x4278, 0x94, 0xb, 0x36, 0x15, 0xf1, 0xd7, 0xdf, 0xd3));
+constexpr ParamAccessor<int> autoMockThingHttpportParam(QUuid(0xbfeb0613, 0xdab6, 0x408c, 0xaa, 0x27, 0xc3, 0x62, 0xc9, 0x21, 0xd0, 0xd1));
+constexpr ParamAccessor<bool> autoMockThingAsyncParam(QUuid(0xa5c4315f, 0x624, 0x4971, 0x87, 0xc1, 0x4b, 0xbf, 0xbf, 0xdb, 0xd1, 0x6e));
+constexpr ParamAccessor<bool> autoMockThingBrokenParam(QUuid(0x66179395, 0xef7a, 0x4013, 0x9f, 0xc6, 0x20, 0x84, 0x10, 0x4e, 0xea, 0x9));
+constexpr ParamAccessor<int> autoMockSettingsMockSettingParam(QUuid(0xda0b9106, 0x3cf, 0x4631, 0x87, 0xe9, 0x26, 0xad, 0xe3, 0x36, 0x1, 0x82));
+constexpr StateAccessor<int> autoMockIntState(QUuid(0x74b24296, 0xba0b, 0x4fbd, 0x87, 0xf3, 0x1b, 0x9, 0xa8, 0xbc, 0x3e, 0x8c), 0);
+constexpr StateAccessor<bool> autoMockBoolValueState(QUuid(0x978b0ba5, 0xd008, 0x41bd, 0xb6, 0x3d, 0xa3, 0xbd, 0x23, 0xcb, 0x64, 0x69), 1);
+constexpr EventAccessor autoMockIntEvent(QUuid(0x74b24296, 0xba0b, 0x4fbd, 0x87, 0xf3, 0x1b, 0x9, 0xa8, 0xbc, 0x3e, 0x8c));
+constexpr ParamAccessor<int> autoMockIntEventIntParam(QUuid(0x74b24296, 0xba0b, 0x4fbd, 0x87, 0xf3, 0x1b, 0x9, 0xa8, 0xbc, 0x3e, 0x8c));
+constexpr EventAccessor autoMockBoolValueEvent(QUuid(0x978b0ba5, 0xd008, 0x41bd, 0xb6, 0x3d, 0xa3, 0xbd, 0x23, 0xcb, 0x64, 0x69));
+constexpr ParamAccessor<bool> autoMockBoolValueEventBoolValueParam(QUuid(0x978b0ba5, 0xd008, 0x41bd, 0xb6, 0x3d, 0xa3, 0xbd, 0x23, 0xcb, 0x64, 0x69));
+constexpr EventAccessor autoMockEvent1Event(QUuid(0xf81fca, 0x26f1, 0x4a84, 0xaa, 0x2b, 0x4c, 0x6a, 0x3d, 0x95, 0x3e, 0xc6));
+constexpr EventAccessor autoMockEvent2Event(QUuid(0x6e27922d, 0xaa9d, 0x44d1, 0xb9, 0xb4, 0x9f, 0xaf, 0x31, 0xb6, 0xbd, 0x97));
+constexpr ParamAccessor<int> autoMockEvent2EventIntParamParam(QUuid(0x12ed5a15, 0x96b4, 0x4381, 0x9d, 0x9c, 0xa2, 0x48, 0x75, 0x28, 0x3d, 0x4f));
+constexpr ActionAccessor autoMockWithParamsAction(QUuid(0x7cd8d5f, 0x2f65, 0x4955, 0xb1, 0xf9, 0x5, 0xd7, 0xf4, 0xda, 0x48, 0x8a));
+constexpr ParamAccessor<int> autoMockWithParamsActionMockActionParam1Param(QUuid(0xb8126ba6, 0x3a54, 0x45a3, 0xbe, 0x4d, 0x63, 0xfe, 0xb0, 0xdd, 0xb7, 0x7b));
+constexpr ParamAccessor<bool> autoMockWithParamsActionMockActionParam2Param(QUuid(0xdf41ba71, 0xe43b, 0x4854, 0x91, 0xd1, 0xb1, 0x9d, 0x80, 0x66, 0xd4, 0xf9));
+constexpr ActionAccessor autoMockMockActionNoParmsAction(QUuid(0xef518d53, 0x50e2, 0x4ca5, 0xa4, 0xb1, 0xe9, 0xa8, 0xb9, 0x30, 0x9d, 0x44));
+constexpr ActionAccessor autoMockMockActionAsyncAction(QUuid(0x5f27a9f2, 0x59cd, 0x4a15, 0x98, 0xbd, 0x6e, 0xd6, 0xe1, 0xb, 0xc6, 0xed));
+constexpr ActionAccessor autoMockMockActionBrokenAction(QUuid(0x58a61de4, 0x472c, 0x4775, 0x8f, 0xe8, 0x58, 0x3a, 0x9c, 0x83, 0xfc, 0xf1));
+constexpr ActionAccessor autoMockMockActionAsyncBrokenAction(QUuid(0x17ad52dd, 0xef2f, 0x4947, 0x9b, 0x73, 0x5b, 0xf6, 0xe1, 0x72, 0xa9, 0xd0));
+constexpr ParamAccessor<int> pushButtonMockDiscoveryResultCountParam(QUuid(0xc40dbc59, 0x4bba, 0x4871, 0x9b, 0x8e, 0xbb, 0xd8, 0xd5, 0xd9, 0x19, 0x3b));
+constexpr StateAccessor<QVariant> pushButtonMockColorState(QUuid(0x20dc7c22, 0xc50e, 0x42db, 0x83, 0x7c, 0x2b, 0xbc, 0xed, 0x93, 0x9f, 0x8e), 0);
+constexpr StateAccessor<int> pushButtonMockPercentageState(QUuid(0x72981c04, 0x267a, 0x4ba0, 0xa5, 0x9e, 0x99, 0x21, 0xd2, 0xf3, 0xaf, 0x9c), 1);
+constexpr StateAccessor<QString> pushButtonMockAllowedValuesState(QUuid(0x5f63f9c, 0xf61e, 0x4dcf, 0xad, 0x55, 0x3f, 0x13, 0xfd, 0xe2, 0x76, 0x5b), 2);
+constexpr StateAccessor<double> pushButtonMockDoubleState(QUuid(0x53cd7c55, 0x49b7, 0x441b, 0xb9, 0x70, 0x90, 0x48, 0xf2, 0xf, 0xe, 0x2c), 3);
+constexpr StateAccessor<bool> pushButtonMockBoolState(QUuid(0xe680f7a4, 0xb39e, 0x46da, 0xbe, 0x41, 0xfa, 0x31, 0x70, 0xfe, 0x37, 0x68), 4);
+constexpr EventAccessor pushButtonMockColorEvent(QUuid(0x20dc7c22, 0xc50e, 0x42db, 0x83, 0x7c, 0x2b, 0xbc, 0xed, 0x93, 0x9f, 0x8e));
+constexpr ParamAccessor<QVariant> pushButtonMockColorEventColorParam(QUuid(0x20dc7c22, 0xc50e, 0x42db, 0x83, 0x7c, 0x2b, 0xbc, 0xed, 0x93, 0x9f, 0x8e));
+constexpr EventAccessor pushButtonMockPercentageEvent(QUuid(0x72981c04, 0x267a, 0x4ba0, 0xa5, 0x9e, 0x99, 0x21, 0xd2, 0xf3, 0xaf, 0x9c));
+constexpr ParamAccessor<int> pushButtonMockPercentageEventPercentageParam(QUuid(0x72981c04, 0x267a, 0x4ba0, 0xa5, 0x9e, 0x99, 0x21, 0xd2, 0xf3, 0xaf, 0x9c));
+constexpr EventAccessor pushButtonMockAllowedValuesEvent(QUuid(0x5f63f9c, 0xf61e, 0x4dcf, 0xad, 0x55, 0x3f, 0x13, 0xfd, 0xe2, 0x76, 0x5b));
+constexpr ParamAccessor<QString> pushButtonMockAllowedValuesEventAllowedValuesParam(QUuid(0x5f63f9c, 0xf61e, 0x4dcf, 0xad, 0x55, 0x3f, 0x13, 0xfd, 0xe2, 0x76, 0x5b));
+constexpr EventAccessor pushButtonMockDoubleEvent(QUuid(0x53cd7c55, 0x49b7, 0x441b, 0xb9, 0x70, 0x90, 0x48, 0xf2, 0xf, 0xe, 0x2c));
+constexpr ParamAccessor<double> pushButtonMockDoubleEventDoubleParam(QUuid(0x53cd7c55, 0x49b7, 0x441b, 0xb9, 0x70, 0x90, 0x48, 0xf2, 0xf, 0xe, 0x2c));
+constexpr EventAccessor pushButtonMockBoolEvent(QUuid(0xe680f7a4, 0xb39e, 0x46da, 0xbe, 0x41, 0xfa, 0x31, 0x70, 0xfe, 0x37, 0x68));
+constexpr ParamAccessor<bool> pushButtonMockBoolEventBoolParam(QUuid(0xe680f7a4, 0xb39e, 0x46da, 0xbe, 0x41, 0xfa, 0x31, 0x70, 0xfe, 0x37, 0x68));
+constexpr ActionAccessor pushButtonMockColorAction(QUuid(0x20dc7c22, 0xc50e, 0x42db, 0x83, 0x7c, 0x2b, 0xbc, 0xed, 0x93, 0x9f, 0x8e));
+constexpr ParamAccessor<QVariant> pushButtonMockColorActionColorParam(QUuid(0x20dc7c22, 0xc50e, 0x42db, 0x83, 0x7c, 0x2b, 0xbc, 0xed, 0x93, 0x9f, 0x8e));
+constexpr ActionAccessor pushButtonMockPercentageAction(QUuid(0x72981c04, 0x267a, 0x4ba0, 0xa5, 0x9e, 0x99, 0x21, 0xd2, 0xf3, 0xaf, 0x9c));
+constexpr ParamAccessor<int> pushButtonMockPercentageActionPercentageParam(QUuid(0x72981c04, 0x267a, 0x4ba0, 0xa5, 0x9e, 0x99, 0x21, 0xd2, 0xf3, 0xaf, 0x9c));
+constexpr ActionAccessor pushButtonMockAllowedValuesAction(QUuid(0x5f63f9c, 0xf61e, 0x4dcf, 0xad, 0x55, 0x3f, 0x13, 0xfd, 0xe2, 0x76, 0x5b));
+constexpr ParamAccessor<QString> pushButtonMockAllowedValuesActionAllowedValuesParam(QUuid(0x5f63f9c, 0xf61e, 0x4dcf, 0xad, 0x55, 0x3f, 0x13, 0xfd, 0xe2, 0x76, 0x5b));
+constexpr ActionAccessor pushButtonMockDoubleAction(QUuid(0x53cd7c55, 0x49b7, 0x441b, 0xb9, 0x70, 0x90, 0x48, 0xf2, 0xf, 0xe, 0x2c));
+constexpr ParamAccessor<double> pushButtonMockDoubleActionDoubleParam(QUuid(0x53cd7c55, 0x49b7, 0x441b, 0xb9, 0x70, 0x90, 0x48, 0xf2, 0xf, 0xe, 0x2c));
+constexpr ActionAccessor pushButtonMockBoolAction(QUuid(0xe680f7a4, 0xb39e, 0x46da, 0xbe, 0x41, 0xfa, 0x31, 0x70, 0xfe, 0x37, 0x68));
+constexpr ParamAccessor<bool> pushButtonMockBoolActionBoolParam(QUuid(0xe680f7a4, 0xb39e, 0x46da, 0xbe, 0x41, 0xfa, 0x31, 0x70, 0xfe, 0x37, 0x68));
+constexpr ActionAccessor pushButtonMockTimeoutAction(QUuid(0x54646e7c, 0xbc54, 0x4895, 0x81, 0xa2, 0x59, 0xd, 0x72, 0xd1, 0x20, 0xf9));
+constexpr ParamAccessor<QString> displayPinMockThingPinParam(QUuid(0xda820e07, 0x22dc, 0x4173, 0x9c, 0x7, 0x2f, 0x49, 0xa4, 0xe2, 0x65, 0xf9));
+constexpr ParamAccessor<int> displayPinMockDiscoveryResultCountParam(QUuid(0x35f6e4ba, 0x28ad, 0x4152, 0xa5, 0x8d, 0xec, 0x26, 0x0, 0x66, 0x7b, 0xcf));
+constexpr StateAccessor<QVariant> displayPinMockColorState(QUuid(0x3e161294, 0x8a0d, 0x4384, 0x96, 0x76, 0x69, 0x59, 0xe0, 0x8c, 0xc2, 0xfa), 0);
+constexpr StateAccessor<int> displayPinMockPercentageState(QUuid(0x527f0687, 0xb28, 0x4c26, 0x85, 0x2c, 0x25, 0xb8, 0xf8, 0x3e, 0x47, 0x97), 1);
+constexpr StateAccessor<QString> displayPinMockAllowedValuesState(QUuid(0xb463c5ae, 0x4d55, 0x402f, 0x84, 0x80, 0xa5, 0xcd, 0xb4, 0x85, 0xc1, 0x43), 2);
+constexpr StateAccessor<double> displayPinMockDoubleState(QUuid(0x17635624, 0x7c19, 0x4bae, 0x84, 0x29, 0x2f, 0x7a, 0xa5, 0xd2, 0xf8, 0x43), 3);
+constexpr StateAccessor<bool> displayPinMockBoolState(QUuid(0x7ffe514f, 0x7999, 0x4998, 0x83, 0x50, 0xe, 0x73, 0xe2, 0x22, 0xa8, 0xc4), 4);
+constexpr EventAccessor displayPinMockColorEvent(QUuid(0x3e161294, 0x8a0d, 0x4384, 0x96, 0x76, 0x69, 0x59, 0xe0, 0x8c, 0xc2, 0xfa));
+constexpr ParamAccessor<QVariant> displayPinMockColorEventColorParam(QUuid(0x3e161294, 0x8a0d, 0x4384, 0x96, 0x76, 0x69, 0x59, 0xe0, 0x8c, 0xc2, 0xfa));
+constexpr EventAccessor displayPinMockPercentageEvent(QUuid(0x527f0687, 0xb28, 0x4c26, 0x85, 0x2c, 0x25, 0xb8, 0xf8, 0x3e, 0x47, 0x97));
+constexpr ParamAccessor<int> displayPinMockPercentageEventPercentageParam(QUuid(0x527f0687, 0xb28, 0x4c26, 0x85, 0x2c, 0x25, 0xb8, 0xf8, 0x3e, 0x47, 0x97));
+constexpr EventAccessor displayPinMockAllowedValuesEvent(QUuid(0xb463c5ae, 0x4d55, 0x402f, 0x84, 0x80, 0xa5, 0xcd, 0xb4, 0x85, 0xc1, 0x43));
+constexpr ParamAccessor<QString> displayPinMockAllowedValuesEventAllowedValuesParam(QUuid(0xb463c5ae, 0x4d55, 0x402f, 0x84, 0x80, 0xa5, 0xcd, 0xb4, 0x85, 0xc1, 0x43));
+constexpr EventAccessor displayPinMockDoubleEvent(QUuid(0x17635624, 0x7c19, 0x4bae, 0x84, 0x29, 0x2f, 0x7a, 0xa5, 0xd2, 0xf8, 0x43));
+constexpr ParamAccessor<double> displayPinMockDoubleEventDoubleParam(QUuid(0x17635624, 0x7c19, 0x4bae, 0x84, 0x29, 0x2f, 0x7a, 0xa5, 0xd2, 0xf8, 0x43));
+constexpr EventAccessor displayPinMockBoolEvent(QUuid(0x7ffe514f, 0x7999, 0x4998, 0x83, 0x50, 0xe, 0x73, 0xe2, 0x22, 0xa8, 0xc4));
+constexpr ParamAccessor<bool> displayPinMockBoolEventBoolParam(QUuid(0x7ffe514f, 0x7999, 0x4998, 0x83, 0x50, 0xe, 0x73, 0xe2, 0x22, 0xa8, 0xc4));
+constexpr ActionAccessor displayPinMockColorAction(QUuid(0x3e161294, 0x8a0d, 0x4384, 0x96, 0x76, 0x69, 0x59, 0xe0, 0x8c, 0xc2, 0xfa));
+constexpr ParamAccessor<QVariant> displayPinMockColorActionColorParam(QUuid(0x3e161294, 0x8a0d, 0x4384, 0x96, 0x76, 0x69, 0x59, 0xe0, 0x8c, 0xc2, 0xfa));
+constexpr ActionAccessor displayPinMockPercentageAction(QUuid(0x527f0687, 0xb28, 0x4c26, 0x85, 0x2c, 0x25, 0xb8, 0xf8, 0x3e, 0x47, 0x97));
+constexpr ParamAccessor<int> displayPinMockPercentageActionPercentageParam(QUuid(0x527f0687, 0xb28, 0x4c26, 0x85, 0x2c, 0x25, 0xb8, 0xf8, 0x3e, 0x47, 0x97));
+constexpr ActionAccessor displayPinMockAllowedValuesAction(QUuid(0xb463c5ae, 0x4d55, 0x402f, 0x84, 0x80, 0xa5, 0xcd, 0xb4, 0x85, 0xc1, 0x43));
+constexpr ParamAccessor<QString> displayPinMockAllowedValuesActionAllowedValuesParam(QUuid(0xb463c5ae, 0x4d55, 0x402f, 0x84, 0x80, 0xa5, 0xcd, 0xb4, 0x85, 0xc1, 0x43));
+constexpr ActionAccessor displayPinMockDoubleAction(QUuid(0x17635624, 0x7c19, 0x4bae, 0x84, 0x29, 0x2f, 0x7a, 0xa5, 0xd2, 0xf8, 0x43));
+constexpr ParamAccessor<double> displayPinMockDoubleActionDoubleParam(QUuid(0x17635624, 0x7c19, 0x4bae, 0x84, 0x29, 0x2f, 0x7a, 0xa5, 0xd2, 0xf8, 0x43));
+constexpr ActionAccessor displayPinMockBoolAction(QUuid(0x7ffe514f, 0x7999, 0x4998, 0x83, 0x50, 0xe, 0x73, 0xe2, 0x22, 0xa8, 0xc4));
+constexpr ParamAccessor<bool> displayPinMockBoolActionBoolParam(QUuid(0x7ffe514f, 0x7999, 0x4998, 0x83, 0x50, 0xe, 0x73, 0xe2, 0x22, 0xa8, 0xc4));
+constexpr ActionAccessor displayPinMockTimeoutAction(QUuid(0x854a0a4a, 0x803f, 0x4b7f, 0x9d, 0xce, 0xb0, 0x77, 0x94, 0xf9, 0x1, 0x1b));
+constexpr StateAccessor<bool> parentMockBoolValueState(QUuid(0xd24ede5f, 0x4064, 0x4898, 0xbb, 0x84, 0xcf, 0xb5, 0x33, 0xb1, 0xfb, 0xc0), 0);
+constexpr EventAccessor parentMockBoolValueEvent(QUuid(0xd24ede5f, 0x4064, 0x4898, 0xbb, 0x84, 0xcf, 0xb5, 0x33, 0xb1, 0xfb, 0xc0));
+constexpr ParamAccessor<bool> parentMockBoolValueEventBoolValueParam(QUuid(0xd24ede5f, 0x4064, 0x4898, 0xbb, 0x84, 0xcf, 0xb5, 0x33, 0xb1, 0xfb, 0xc0));
+constexpr ActionAccessor parentMockBoolValueAction(QUuid(0xd24ede5f, 0x4064, 0x4898, 0xbb, 0x84, 0xcf, 0xb5, 0x33, 0xb1, 0xfb, 0xc0));
+constexpr ParamAccessor<bool> parentMockBoolValueActionBoolValueParam(QUuid(0xd24ede5f, 0x4064, 0x4898, 0xbb, 0x84, 0xcf, 0xb5, 0x33, 0xb1, 0xfb, 0xc0));
+constexpr StateAccessor<bool> childMockBoolValueState(QUuid(0x80ba1449, 0xb485, 0x47d4, 0xa0, 0x67, 0x6b, 0xf3, 0x6, 0xe2, 0xa5, 0x68), 0);
+constexpr EventAccessor childMockBoolValueEvent(QUuid(0x80ba1449, 0xb485, 0x47d4, 0xa0, 0x67, 0x6b, 0xf3, 0x6, 0xe2, 0xa5, 0x68));
+constexpr ParamAccessor<bool> childMockBoolValueEventBoolValueParam(QUuid(0x80ba1449, 0xb485, 0x47d4, 0xa0, 0x67, 0x6b, 0xf3, 0x6, 0xe2, 0xa5, 0x68));
+constexpr ActionAccessor childMockBoolValueAction(QUuid(0x80ba1449, 0xb485, 0x47d4, 0xa0, 0x67, 0x6b, 0xf3, 0x6, 0xe2, 0xa5, 0x68));
+constexpr ParamAccessor<bool> childMockBoolValueActionBoolValueParam(QUuid(0x80ba1449, 0xb485, 0x47d4, 0xa0, 0x67, 0x6b, 0xf3, 0x6, 0xe2, 0xa5, 0x68));
+constexpr ParamAccessor<QString> inputTypeMockThingTextLineParam(QUuid(0xe6acf0c7, 0x4b8e, 0x4296, 0xac, 0x62, 0x85, 0x5d, 0x20, 0xde, 0xb8, 0x16));
+constexpr ParamAccessor<QString> inputTypeMockThingTextAreaParam(QUuid(0x716f0994, 0xbc01, 0x42b0, 0xb6, 0x4d, 0x59, 0x23, 0x6f, 0x73, 0x20, 0xd2));
+constexpr ParamAccessor<QString> inputTypeMockThingPasswordParam(QUuid(0xe5c0d14b, 0xc9f1, 0x4aca, 0xa5, 0x6e, 0x85, 0xbf, 0xa6, 0x97, 0x71, 0x50));
+constexpr ParamAccessor<QString> inputTypeMockThingSearchParam(QUuid(0x22add8c9, 0xee4f, 0x43ad, 0x89, 0x31, 0x58, 0xe9, 0x99, 0x31, 0x3a, 0xc3));
+constexpr ParamAccessor<QString> inputTypeMockThingMailParam(QUuid(0xa8494faf, 0x3a0f, 0x4cf3, 0x84, 0xb7, 0x4b, 0x39, 0x14, 0x8a, 0x83, 0x8d));
+constexpr ParamAccessor<QString> inputTypeMockThingIp4Param(QUuid(0x9e5f86a0, 0x4bb3, 0x4892, 0xbf, 0xf8, 0x3f, 0xc4, 0x3, 0x2a, 0xf6, 0xe2));
+constexpr ParamAccessor<QString> inputTypeMockThingIp6Param(QUuid(0x43bf3832, 0xdd48, 0x4090, 0xa8, 0x36, 0x65, 0x6e, 0x8b, 0x60, 0x21, 0x6e));
+constexpr ParamAccessor<QString> inputTypeMockThingUrlParam(QUuid(0xfa67229f, 0xfcef, 0x496f, 0xb6, 0x71, 0x59, 0xa4, 0xb4, 0x8f, 0x3a, 0xb5));
+constexpr ParamAccessor<QString> inputTypeMockThingMacParam(QUuid(0xe93db587, 0x7919, 0x48f3, 0x8c, 0x88, 0x16, 0x51, 0xde, 0x63, 0xc7, 0x65));
+constexpr StateAccessor<bool> inputTypeMockBoolState(QUuid(0x3bad3a09, 0x5826, 0x4ed7, 0xa8, 0x32, 0x10, 0xe3, 0xe2, 0xee, 0x2a, 0x7d), 0);
+constexpr StateAccessor<bool> inputTypeMockWritableBoolState(QUuid(0xa7c11774, 0xf31f, 0x4d64, 0x99, 0xd1, 0xe0, 0xae, 0x5f, 0xb3, 0x5a, 0x5c), 1);
+constexpr StateAccessor<int> inputTypeMockIntState(QUuid(0xd0fc56ae, 0x5791, 0x4e91, 0xb7, 0x6c, 0xda, 0xdf, 0xbc, 0x7e, 0x7d, 0xbb), 2);
+constexpr StateAccessor<int> inputTypeMockWritableIntState(QUuid(0x857a8422, 0x983c, 0x47d6, 0xa1, 0x5f, 0xd8, 0x45, 0xb, 0x31, 0x62, 0xf7), 3);
+constexpr StateAccessor<int> inputTypeMockWritableIntMinMaxState(QUuid(0x86a107bc, 0x510a, 0x4d38, 0xbf, 0xeb, 0xa, 0x9c, 0x2b, 0x6d, 0x8d, 0x87), 4);
+constexpr StateAccessor<uint> inputTypeMockUintState(QUuid(0x19e74fcc, 0xbfd5, 0x491f, 0x8e, 0xb6, 0xaf, 0x12, 0x8e, 0x8f, 0x11, 0x62), 5);
+constexpr StateAccessor<uint> inputTypeMockWritableUIntState(QUuid(0x563e9c4c, 0x5198, 0x400a, 0x9f, 0x6c, 0x35, 0x8f, 0x47, 0x52, 0xaf, 0x58), 6);
+constexpr StateAccessor<uint> inputTypeMockWritableUIntMinMaxState(QUuid(0x79238998, 0xeaab, 0x4d71, 0xb4, 0x6, 0x5d, 0x78, 0xf1, 0x74, 0x97, 0x51), 7);
+constexpr StateAccessor<double> inputTypeMockDoubleState(QUuid(0xf7d2063d, 0x959e, 0x46ac, 0x85, 0x68, 0x8b, 0x99, 0x72, 0x2d, 0x3b, 0x22), 8);
+constexpr StateAccessor<double> inputTypeMockWritableDoubleState(QUuid(0x8e2eb91b, 0xd60b, 0x4461, 0x9a, 0x50, 0xd7, 0xb8, 0xad, 0x26, 0x31, 0x70), 9);
+constexpr StateAccessor<double> inputTypeMockWritableDoubleMinMaxState(QUuid(0xd3425e, 0x1da6, 0x4748, 0x89, 0x6, 0x45, 0x55, 0xce, 0xef, 0xb1, 0x36), 10);
+constexpr StateAccessor<QString> inputTypeMockStringState(QUuid(0x27f69ca9, 0xa321, 0x40ff, 0xbf, 0xee, 0x4b, 0x2, 0x72, 0xa6, 0x71, 0xb4), 11);
+constexpr StateAccessor<QString> inputTypeMockWritableStringState(QUuid(0xef511043, 0xbd1a, 0x4a5f, 0x98, 0x4c, 0x22, 0x2b, 0x7d, 0xa4, 0x3f, 0x38), 12);
+constexpr StateAccessor<QString> inputTypeMockWritableStringSelectionState(QUuid(0x209d7afc, 0x6fe9, 0x4fe9, 0x93, 0x9b, 0xe4, 0x72, 0xea, 0xa, 0xd6, 0x39), 13);
+constexpr StateAccessor<QVariant> inputTypeMockColorState(QUuid(0x4507d5c6, 0xb692, 0x4bd6, 0x87, 0xf2, 0x0, 0x36, 0x4b, 0xc0, 0xcb, 0x4d), 14);
+constexpr StateAccessor<QVariant> inputTypeMockWritableColorState(QUuid(0x455f4f68, 0x3cb0, 0x4e8a, 0xa7, 0x7, 0x62, 0xe4, 0xa2, 0xa8, 0x3, 0x5c), 15);
+constexpr StateAccessor<QVariant> inputTypeMockTimeState(QUuid(0x8250c71e, 0x59bc, 0x41ab, 0xb5, 0x76, 0x99, 0xfc, 0xfc, 0x34, 0xe8, 0xd1), 16);
+constexpr StateAccessor<QVariant> inputTypeMockWritableTimeState(QUuid(0xd64c8b3f, 0xca7d, 0x47f6, 0xb2, 0x71, 0x86, 0x7f, 0xfd, 0x80, 0xa4, 0xd4), 17);
+constexpr StateAccessor<int> inputTypeMockTimestampIntState(QUuid(0x2c91b5ef, 0xc2d1, 0x4367, 0xbc, 0x65, 0x5a, 0x13, 0xab, 0xf6, 0x96, 0x41), 18);
+constexpr StateAccessor<int> inputTypeMockWritableTimestampIntState(QUuid(0x88b6746a, 0xb009, 0x4df6, 0x89, 0x86, 0xd7, 0x88, 0x4f, 0xfd, 0x94, 0xb2), 19);
+constexpr StateAccessor<uint> inputTypeMockTimestampUIntState(QUuid(0x6c9a96e8, 0xd48, 0x4f42, 0x89, 0x67, 0x84, 0x83, 0x58, 0xfd, 0x7f, 0x79), 20);
+constexpr StateAccessor<uint> inputTypeMockWritableTimestampUIntState(QUuid(0x45d0069a, 0x63ac, 0x4265, 0x81, 0x70, 0x81, 0x52, 0x77, 0x86, 0x8, 0xee), 21);
+constexpr EventAccessor inputTypeMockBoolEvent(QUuid(0x3bad3a09, 0x5826, 0x4ed7, 0xa8, 0x32, 0x10, 0xe3, 0xe2, 0xee, 0x2a, 0x7d));
+constexpr ParamAccessor<bool> inputTypeMockBoolEventBoolParam(QUuid(0x3bad3a09, 0x5826, 0x4ed7, 0xa8, 0x32, 0x10, 0xe3, 0xe2, 0xee, 0x2a, 0x7d));
+constexpr EventAccessor inputTypeMockWritableBoolEvent(QUuid(0xa7c11774, 0xf31f, 0x4d64, 0x99, 0xd1, 0xe0, 0xae, 0x5f, 0xb3, 0x5a, 0x5c));
+constexpr ParamAccessor<bool> inputTypeMockWritableBoolEventWritableBoolParam(QUuid(0xa7c11774, 0xf31f, 0x4d64, 0x99, 0xd1, 0xe0, 0xae, 0x5f, 0xb3, 0x5a, 0x5c));
+constexpr EventAccessor inputTypeMockIntEvent(QUuid(0xd0fc56ae, 0x5791, 0x4e91, 0xb7, 0x6c, 0xda, 0xdf, 0xbc, 0x7e, 0x7d, 0xbb));
+constexpr ParamAccessor<int> inputTypeMockIntEventIntParam(QUuid(0xd0fc56ae, 0x5791, 0x4e91, 0xb7, 0x6c, 0xda, 0xdf, 0xbc, 0x7e, 0x7d, 0xbb));
+constexpr EventAccessor inputTypeMockWritableIntEvent(QUuid(0x857a8422, 0x983c, 0x47d6, 0xa1, 0x5f, 0xd8, 0x45, 0xb, 0x31, 0x62, 0xf7));
+constexpr ParamAccessor<int> inputTypeMockWritableIntEventWritableIntParam(QUuid(0x857a8422, 0x983c, 0x47d6, 0xa1, 0x5f, 0xd8, 0x45, 0xb, 0x31, 0x62, 0xf7));
+constexpr EventAccessor inputTypeMockWritableIntMinMaxEvent(QUuid(0x86a107bc, 0x510a, 0x4d38, 0xbf, 0xeb, 0xa, 0x9c, 0x2b, 0x6d, 0x8d, 0x87));
+constexpr ParamAccessor<int> inputTypeMockWritableIntMinMaxEventWritableIntMinMaxParam(QUuid(0x86a107bc, 0x510a, 0x4d38, 0xbf, 0xeb, 0xa, 0x9c, 0x2b, 0x6d, 0x8d, 0x87));
+constexpr EventAccessor inputTypeMockUintEvent(QUuid(0x19e74fcc, 0xbfd5, 0x491f, 0x8e, 0xb6, 0xaf, 0x12, 0x8e, 0x8f, 0x11, 0x62));
+constexpr ParamAccessor<uint> inputTypeMockUintEventUintParam(QUuid(0x19e74fcc, 0xbfd5, 0x491f, 0x8e, 0xb6, 0xaf, 0x12, 0x8e, 0x8f, 0x11, 0x62));
+constexpr EventAccessor inputTypeMockWritableUIntEvent(QUuid(0x563e9c4c, 0x5198, 0x400a, 0x9f, 0x6c, 0x35, 0x8f, 0x47, 0x52, 0xaf, 0x58));
+constexpr ParamAccessor<uint> inputTypeMockWritableUIntEventWritableUIntParam(QUuid(0x563e9c4c, 0x5198, 0x400a, 0x9f, 0x6c, 0x35, 0x8f, 0x47, 0x52, 0xaf, 0x58));
+constexpr EventAccessor inputTypeMockWritableUIntMinMaxEvent(QUuid(0x79238998, 0xeaab, 0x4d71, 0xb4, 0x6, 0x5d, 0x78, 0xf1, 0x74, 0x97, 0x51));
+constexpr ParamAccessor<uint> inputTypeMockWritableUIntMinMaxEventWritableUIntMinMaxParam(QUuid(0x79238998, 0xeaab, 0x4d71, 0xb4, 0x6, 0x5d, 0x78, 0xf1, 0x74, 0x97, 0x51));
+constexpr EventAccessor inputTypeMockDoubleEvent(QUuid(0xf7d2063d, 0x959e, 0x46ac, 0x85, 0x68, 0x8b, 0x99, 0x72, 0x2d, 0x3b, 0x22));
+constexpr ParamAccessor<double> inputTypeMockDoubleEventDoubleParam(QUuid(0xf7d2063d, 0x959e, 0x46ac, 0x85, 0x68, 0x8b, 0x99, 0x72, 0x2d, 0x3b, 0x22));
+constexpr EventAccessor inputTypeMockWritableDoubleEvent(QUuid(0x8e2eb91b, 0xd60b, 0x4461, 0x9a, 0x50, 0xd7, 0xb8, 0xad, 0x26, 0x31, 0x70));
+constexpr ParamAccessor<double> inputTypeMockWritableDoubleEventWritableDoubleParam(QUuid(0x8e2eb91b, 0xd60b, 0x4461, 0x9a, 0x50, 0xd7, 0xb8, 0xad, 0x26, 0x31, 0x70));
+constexpr EventAccessor inputTypeMockWritableDoubleMinMaxEvent(QUuid(0xd3425e, 0x1da6, 0x4748, 0x89, 0x6, 0x45, 0x55, 0xce, 0xef, 0xb1, 0x36));
+constexpr ParamAccessor<double> inputTypeMockWritableDoubleMinMaxEventWritableDoubleMinMaxParam(QUuid(0xd3425e, 0x1da6, 0x4748, 0x89, 0x6, 0x45, 0x55, 0xce, 0xef, 0xb1, 0x36));
+constexpr EventAccessor inputTypeMockStringEvent(QUuid(0x27f69ca9, 0xa321, 0x40ff, 0xbf, 0xee, 0x4b, 0x2, 0x72, 0xa6, 0x71, 0xb4));
+constexpr ParamAccessor<QString> inputTypeMockStringEventStringParam(QUuid(0x27f69ca9, 0xa321, 0x40ff, 0xbf, 0xee, 0x4b, 0x2, 0x72, 0xa6, 0x71, 0xb4));
+constexpr EventAccessor inputTypeMockWritableStringEvent(QUuid(0xef511043, 0xbd1a, 0x4a5f, 0x98, 0x4c, 0x22, 0x2b, 0x7d, 0xa4, 0x3f, 0x38));
+constexpr ParamAccessor<QString> inputTypeMockWritableStringEventWritableStringParam(QUuid(0xef511043, 0xbd1a, 0x4a5f, 0x98, 0x4c, 0x22, 0x2b, 0x7d, 0xa4, 0x3f, 0x38));
+constexpr EventAccessor inputTypeMockWritableStringSelectionEvent(QUuid(0x209d7afc, 0x6fe9, 0x4fe9, 0x93, 0x9b, 0xe4, 0x72, 0xea, 0xa, 0xd6, 0x39));
+constexpr ParamAccessor<QString> inputTypeMockWritableStringSelectionEventWritableStringSelectionParam(QUuid(0x209d7afc, 0x6fe9, 0x4fe9, 0x93, 0x9b, 0xe4, 0x72, 0xea, 0xa, 0xd6, 0x39));
+constexpr EventAccessor inputTypeMockColorEvent(QUuid(0x4507d5c6, 0xb692, 0x4bd6, 0x87, 0xf2, 0x0, 0x36, 0x4b, 0xc0, 0xcb, 0x4d));
+constexpr ParamAccessor<QVariant> inputTypeMockColorEventColorParam(QUuid(0x4507d5c6, 0xb692, 0x4bd6, 0x87, 0xf2, 0x0, 0x36, 0x4b, 0xc0, 0xcb, 0x4d));
+constexpr EventAccessor inputTypeMockWritableColorEvent(QUuid(0x455f4f68, 0x3cb0, 0x4e8a, 0xa7, 0x7, 0x62, 0xe4, 0xa2, 0xa8, 0x3, 0x5c));
+constexpr ParamAccessor<QVariant> inputTypeMockWritableColorEventWritableColorParam(QUuid(0x455f4f68, 0x3cb0, 0x4e8a, 0xa7, 0x7, 0x62, 0xe4, 0xa2, 0xa8, 0x3, 0x5c));
+constexpr EventAccessor inputTypeMockTimeEvent(QUuid(0x8250c71e, 0x59bc, 0x41ab, 0xb5, 0x76, 0x99, 0xfc, 0xfc, 0x34, 0xe8, 0xd1));
+constexpr ParamAccessor<QVariant> inputTypeMockTimeEventTimeParam(QUuid(0x8250c71e, 0x59bc, 0x41ab, 0xb5, 0x76, 0x99, 0xfc, 0xfc, 0x34, 0xe8, 0xd1));
+constexpr EventAccessor inputTypeMockWritableTimeEvent(QUuid(0xd64c8b3f, 0xca7d, 0x47f6, 0xb2, 0x71, 0x86, 0x7f, 0xfd, 0x80, 0xa4, 0xd4));
+constexpr ParamAccessor<QVariant> inputTypeMockWritableTimeEventWritableTimeParam(QUuid(0xd64c8b3f, 0xca7d, 0x47f6, 0xb2, 0x71, 0x86, 0x7f, 0xfd, 0x80, 0xa4, 0xd4));
+constexpr EventAccessor inputTypeMockTimestampIntEvent(QUuid(0x2c91b5ef, 0xc2d1, 0x4367, 0xbc, 0x65, 0x5a, 0x13, 0xab, 0xf6, 0x96, 0x41));
+constexpr ParamAccessor<int> inputTypeMockTimestampIntEventTimestampIntParam(QUuid(0x2c91b5ef, 0xc2d1, 0x4367, 0xbc, 0x65, 0x5a, 0x13, 0xab, 0xf6, 0x96, 0x41));
+constexpr EventAccessor inputTypeMockWritableTimestampIntEvent(QUuid(0x88b6746a, 0xb009, 0x4df6, 0x89, 0x86, 0xd7, 0x88, 0x4f, 0xfd, 0x94, 0xb2));
+constexpr ParamAccessor<int> inputTypeMockWritableTimestampIntEventWritableTimestampIntParam(QUuid(0x88b6746a, 0xb009, 0x4df6, 0x89, 0x86, 0xd7, 0x88, 0x4f, 0xfd, 0x94, 0xb2));
+constexpr EventAccessor inputTypeMockTimestampUIntEvent(QUuid(0x6c9a96e8, 0xd48, 0x4f42, 0x89, 0x67, 0x84, 0x83, 0x58, 0xfd, 0x7f, 0x79));
+constexpr ParamAccessor<uint> inputTypeMockTimestampUIntEventTimestampUIntParam(QUuid(0x6c9a96e8, 0xd48, 0x4f42, 0x89, 0x67, 0x84, 0x83, 0x58, 0xfd, 0x7f, 0x79));
+constexpr EventAccessor inputTypeMockWritableTimestampUIntEvent(QUuid(0x45d0069a, 0x63ac, 0x4265, 0x81, 0x70, 0x81, 0x52, 0x77, 0x86, 0x8, 0xee));
+constexpr ParamAccessor<uint> inputTypeMockWritableTimestampUIntEventWritableTimestampUIntParam(QUuid(0x45d0069a, 0x63ac, 0x4265, 0x81, 0x70, 0x81, 0x52, 0x77, 0x86, 0x8, 0xee));
+constexpr ActionAccessor inputTypeMockWritableBoolAction(QUuid(0xa7c11774, 0xf31f, 0x4d64, 0x99, 0xd1, 0xe0, 0xae, 0x5f, 0xb3, 0x5a, 0x5c));
+constexpr ParamAccessor<bool> inputTypeMockWritableBoolActionWritableBoolParam(QUuid(0xa7c11774, 0xf31f, 0x4d64, 0x99, 0xd1, 0xe0, 0xae, 0x5f, 0xb3, 0x5a, 0x5c));
+constexpr ActionAccessor inputTypeMockWritableIntAction(QUuid(0x857a8422, 0x983c, 0x47d6, 0xa1, 0x5f, 0xd8, 0x45, 0xb, 0x31, 0x62, 0xf7));
+constexpr ParamAccessor<int> inputTypeMockWritableIntActionWritableIntParam(QUuid(0x857a8422, 0x983c, 0x47d6, 0xa1, 0x5f, 0xd8, 0x45, 0xb, 0x31, 0x62, 0xf7));
+constexpr ActionAccessor inputTypeMockWritableIntMinMaxAction(QUuid(0x86a107bc, 0x510a, 0x4d38, 0xbf, 0xeb, 0xa, 0x9c, 0x2b, 0x6d, 0x8d, 0x87));
+constexpr ParamAccessor<int> inputTypeMockWritableIntMinMaxActionWritableIntMinMaxParam(QUuid(0x86a107bc, 0x510a, 0x4d38, 0xbf, 0xeb, 0xa, 0x9c, 0x2b, 0x6d, 0x8d, 0x87));
+constexpr ActionAccessor inputTypeMockWritableUIntAction(QUuid(0x563e9c4c, 0x5198, 0x400a, 0x9f, 0x6c, 0x35, 0x8f, 0x47, 0x52, 0xaf, 0x58));
+constexpr ParamAccessor<uint> inputTypeMockWritableUIntActionWritableUIntParam(QUuid(0x563e9c4c, 0x5198, 0x400a, 0x9f, 0x6c, 0x35, 0x8f, 0x47, 0x52, 0xaf, 0x58));
+constexpr ActionAccessor inputTypeMockWritableUIntMinMaxAction(QUuid(0x79238998, 0xeaab, 0x4d71, 0xb4, 0x6, 0x5d, 0x78, 0xf1, 0x74, 0x97, 0x51));
+constexpr ParamAccessor<uint> inputTypeMockWritableUIntMinMaxActionWritableUIntMinMaxParam(QUuid(0x79238998, 0xeaab, 0x4d71, 0xb4, 0x6, 0x5d, 0x78, 0xf1, 0x74, 0x97, 0x51));
+constexpr ActionAccessor inputTypeMockWritableDoubleAction(QUuid(0x8e2eb91b, 0xd60b, 0x4461, 0x9a, 0x50, 0xd7, 0xb8, 0xad, 0x26, 0x31, 0x70));
+constexpr ParamAccessor<double> inputTypeMockWritableDoubleActionWritableDoubleParam(QUuid(0x8e2eb91b, 0xd60b, 0x4461, 0x9a, 0x50, 0xd7, 0xb8, 0xad, 0x26, 0x31, 0x70));
+constexpr ActionAccessor inputTypeMockWritableDoubleMinMaxAction(QUuid(0xd3425e, 0x1da6, 0x4748, 0x89, 0x6, 0x45, 0x55, 0xce, 0xef, 0xb1, 0x36));
+constexpr ParamAccessor<double> inputTypeMockWritableDoubleMinMaxActionWritableDoubleMinMaxParam(QUuid(0xd3425e, 0x1da6, 0x4748, 0x89, 0x6, 0x45, 0x55, 0xce, 0xef, 0xb1, 0x36));
+constexpr ActionAccessor inputTypeMockWritableStringAction(QUuid(0xef511043, 0xbd1a, 0x4a5f, 0x98, 0x4c, 0x22, 0x2b, 0x7d, 0xa4, 0x3f, 0x38));
+constexpr ParamAccessor<QString> inputTypeMockWritableStringActionWritableStringParam(QUuid(0xef511043, 0xbd1a, 0x4a5f, 0x98, 0x4c, 0x22, 0x2b, 0x7d, 0xa4, 0x3f, 0x38));
+constexpr ActionAccessor inputTypeMockWritableStringSelectionAction(QUuid(0x209d7afc, 0x6fe9, 0x4fe9, 0x93, 0x9b, 0xe4, 0x72, 0xea, 0xa, 0xd6, 0x39));
+constexpr ParamAccessor<QString> inputTypeMockWritableStringSelectionActionWritableStringSelectionParam(QUuid(0x209d7afc, 0x6fe9, 0x4fe9, 0x93, 0x9b, 0xe4, 0x72, 0xea, 0xa, 0xd6, 0x39));
+constexpr ActionAccessor inputTypeMockWritableColorAction(QUuid(0x455f4f68, 0x3cb0, 0x4e8a, 0xa7, 0x7, 0x62, 0xe4, 0xa2, 0xa8, 0x3, 0x5c));
+constexpr ParamAccessor<QVariant> inputTypeMockWritableColorActionWritableColorParam(QUuid(0x455f4f68, 0x3cb0, 0x4e8a, 0xa7, 0x7, 0x62, 0xe4, 0xa2, 0xa8, 0x3, 0x5c));
+constexpr ActionAccessor inputTypeMockWritableTimeAction(QUuid(0xd64c8b3f, 0xca7d, 0x47f6, 0xb2, 0x71, 0x86, 0x7f, 0xfd, 0x80, 0xa4, 0xd4));
+constexpr ParamAccessor<QVariant> inputTypeMockWritableTimeActionWritableTimeParam(QUuid(0xd64c8b3f, 0xca7d, 0x47f6, 0xb2, 0x71, 0x86, 0x7f, 0xfd, 0x80, 0xa4, 0xd4));
+constexpr ActionAccessor inputTypeMockWritableTimestampIntAction(QUuid(0x88b6746a, 0xb009, 0x4df6, 0x89, 0x86, 0xd7, 0x88, 0x4f, 0xfd, 0x94, 0xb2));
+constexpr ParamAccessor<int> inputTypeMockWritableTimestampIntActionWritableTimestampIntParam(QUuid(0x88b6746a, 0xb009, 0x4df6, 0x89, 0x86, 0xd7, 0x88, 0x4f, 0xfd, 0x94, 0xb2));
+constexpr ActionAccessor inputTypeMockWritableTimestampUIntAction(QUuid(0x45d0069a, 0x63ac, 0x4265, 0x81, 0x70, 0x81, 0x52, 0x77, 0x86, 0x8, 0xee));
+constexpr ParamAccessor<uint> inputTypeMockWritableTimestampUIntActionWritableTimestampUIntParam(QUuid(0x45d0069a, 0x63ac, 0x4265, 0x81, 0x70, 0x81, 0x52, 0x77, 0x86, 0x8, 0xee));
+constexpr StateAccessor<bool> genericIoMockDigitalInput1State(QUuid(0x7165c12, 0x4d53, 0x45c0, 0x8b, 0xf1, 0x34, 0x61, 0x84, 0x43, 0xb7, 0x6), 0);
+constexpr StateAccessor<bool> genericIoMockDigitalInput2State(QUuid(0xa4362ba, 0xa086, 0x4540, 0x84, 0xba, 0x10, 0x7e, 0xf7, 0xb9, 0x9e, 0xd8), 1);
+constexpr StateAccessor<bool> genericIoMockDigitalOutput1State(QUuid(0xd6fcdb52, 0xf7c3, 0x423b, 0xb9, 0xf5, 0x1e, 0x29, 0xf1, 0x64, 0xc4, 0x2e), 2);
+constexpr StateAccessor<bool> genericIoMockDigitalOutput2State(QUuid(0x35de8b68, 0xcf3, 0x4850, 0xa2, 0x7d, 0xcf, 0x9c, 0x4a, 0x26, 0x92, 0x1f), 3);
+constexpr StateAccessor<double> genericIoMockAnalogInput1State(QUuid(0xac56977c, 0xcbba, 0x47c6, 0xa8, 0x27, 0x57, 0x35, 0xd8, 0xb0, 0xae, 0xd6), 4);
+constexpr StateAccessor<double> genericIoMockAnalogInput2State(QUuid(0x8e07e57e, 0xba4e, 0x42df, 0x81, 0xee, 0x5b, 0x72, 0xed, 0x7, 0x45, 0x32), 5);
+constexpr StateAccessor<double> genericIoMockAnalogOutput1State(QUuid(0x70cf053e, 0x4abc, 0x4d88, 0x8e, 0x1e, 0x2b, 0xd9, 0xa6, 0x22, 0x56, 0xc7), 6);
+constexpr StateAccessor<double> genericIoMockAnalogOutput2State(QUuid(0xe40bcf7d, 0x47b8, 0x41fa, 0xb2, 0x13, 0x36, 0x52, 0xa9, 0x5, 0xb3, 0x76), 7);
+constexpr EventAccessor genericIoMockDigitalInput1Event(QUuid(0x7165c12, 0x4d53, 0x45c0, 0x8b, 0xf1, 0x34, 0x61, 0x84, 0x43, 0xb7, 0x6));
+constexpr ParamAccessor<bool> genericIoMockDigitalInput1EventDigitalInput1Param(QUuid(0x7165c12, 0x4d53, 0x45c0, 0x8b, 0xf1, 0x34, 0x61, 0x84, 0x43, 0xb7, 0x6));
+constexpr EventAccessor genericIoMockDigitalInput2Event(QUuid(0xa4362ba, 0xa086, 0x4540, 0x84, 0xba, 0x10, 0x7e, 0xf7, 0xb9, 0x9e, 0xd8));
+constexpr ParamAccessor<bool> genericIoMockDigitalInput2EventDigitalInput2Param(QUuid(0xa4362ba, 0xa086, 0x4540, 0x84, 0xba, 0x10, 0x7e, 0xf7, 0xb9, 0x9e, 0xd8));
+constexpr EventAccessor genericIoMockDigitalOutput1Event(QUuid(0xd6fcdb52, 0xf7c3, 0x423b, 0xb9, 0xf5, 0x1e, 0x29, 0xf1, 0x64, 0xc4, 0x2e));
+constexpr ParamAccessor<bool> genericIoMockDigitalOutput1EventDigitalOutput1Param(QUuid(0xd6fcdb52, 0xf7c3, 0x423b, 0xb9, 0xf5, 0x1e, 0x29, 0xf1, 0x64, 0xc4, 0x2e));
+constexpr EventAccessor genericIoMockDigitalOutput2Event(QUuid(0x35de8b68, 0xcf3, 0x4850, 0xa2, 0x7d, 0xcf, 0x9c, 0x4a, 0x26, 0x92, 0x1f));
+constexpr ParamAccessor<bool> genericIoMockDigitalOutput2EventDigitalOutput2Param(QUuid(0x35de8b68, 0xcf3, 0x4850, 0xa2, 0x7d, 0xcf, 0x9c, 0x4a, 0x26, 0x92, 0x1f));
+constexpr EventAccessor genericIoMockAnalogInput1Event(QUuid(0xac56977c, 0xcbba, 0x47c6, 0xa8, 0x27, 0x57, 0x35, 0xd8, 0xb0, 0xae, 0xd6));
+constexpr ParamAccessor<double> genericIoMockAnalogInput1EventAnalogInput1Param(QUuid(0xac56977c, 0xcbba, 0x47c6, 0xa8, 0x27, 0x57, 0x35, 0xd8, 0xb0, 0xae, 0xd6));
+constexpr EventAccessor genericIoMockAnalogInput2Event(QUuid(0x8e07e57e, 0xba4e, 0x42df, 0x81, 0xee, 0x5b, 0x72, 0xed, 0x7, 0x45, 0x32));
+constexpr ParamAccessor<double> genericIoMockAnalogInput2EventAnalogInput2Param(QUuid(0x8e07e57e, 0xba4e, 0x42df, 0x81, 0xee, 0x5b, 0x72, 0xed, 0x7, 0x45, 0x32));
+constexpr EventAccessor genericIoMockAnalogOutput1Event(QUuid(0x70cf053e, 0x4abc, 0x4d88, 0x8e, 0x1e, 0x2b, 0xd9, 0xa6, 0x22, 0x56, 0xc7));
+constexpr ParamAccessor<double> genericIoMockAnalogOutput1EventAnalogOutput1Param(QUuid(0x70cf053e, 0x4abc, 0x4d88, 0x8e, 0x1e, 0x2b, 0xd9, 0xa6, 0x22, 0x56, 0xc7));
+constexpr EventAccessor genericIoMockAnalogOutput2Event(QUuid(0xe40bcf7d, 0x47b8, 0x41fa, 0xb2, 0x13, 0x36, 0x52, 0xa9, 0x5, 0xb3, 0x76));
+constexpr ParamAccessor<double> genericIoMockAnalogOutput2EventAnalogOutput2Param(QUuid(0xe40bcf7d, 0x47b8, 0x41fa, 0xb2, 0x13, 0x36, 0x52, 0xa9, 0x5, 0xb3, 0x76));
+constexpr ActionAccessor genericIoMockDigitalOutput1Action(QUuid(0xd6fcdb52, 0xf7c3, 0x423b, 0xb9, 0xf5, 0x1e, 0x29, 0xf1, 0x64, 0xc4, 0x2e));
+constexpr ParamAccessor<bool> genericIoMockDigitalOutput1ActionDigitalOutput1Param(QUuid(0xd6fcdb52, 0xf7c3, 0x423b, 0xb9, 0xf5, 0x1e, 0x29, 0xf1, 0x64, 0xc4, 0x2e));
+constexpr ActionAccessor genericIoMockDigitalOutput2Action(QUuid(0x35de8b68, 0xcf3, 0x4850, 0xa2, 0x7d, 0xcf, 0x9c, 0x4a, 0x26, 0x92, 0x1f));
+constexpr ParamAccessor<bool> genericIoMockDigitalOutput2ActionDigitalOutput2Param(QUuid(0x35de8b68, 0xcf3, 0x4850, 0xa2, 0x7d, 0xcf, 0x9c, 0x4a, 0x26, 0x92, 0x1f));
+constexpr ActionAccessor genericIoMockAnalogInput1Action(QUuid(0xac56977c, 0xcbba, 0x47c6, 0xa8, 0x27, 0x57, 0x35, 0xd8, 0xb0, 0xae, 0xd6));
+constexpr ParamAccessor<double> genericIoMockAnalogInput1ActionAnalogInput1Param(QUuid(0xac56977c, 0xcbba, 0x47c6, 0xa8, 0x27, 0x57, 0x35, 0xd8, 0xb0, 0xae, 0xd6));
+constexpr ActionAccessor genericIoMockAnalogOutput1Action(QUuid(0x70cf053e, 0x4abc, 0x4d88, 0x8e, 0x1e, 0x2b, 0xd9, 0xa6, 0x22, 0x56, 0xc7));
+constexpr ParamAccessor<double> genericIoMockAnalogOutput1ActionAnalogOutput1Param(QUuid(0x70cf053e, 0x4abc, 0x4d88, 0x8e, 0x1e, 0x2b, 0xd9, 0xa6, 0x22, 0x56, 0xc7));
+constexpr ActionAccessor genericIoMockAnalogOutput2Action(QUuid(0xe40bcf7d, 0x47b8, 0x41fa, 0xb2, 0x13, 0x36, 0x52, 0xa9, 0x5, 0xb3, 0x76));
+constexpr ParamAccessor<double> genericIoMockAnalogOutput2ActionAnalogOutput2Param(QUuid(0xe40bcf7d, 0x47b8, 0x41fa, 0xb2, 0x13, 0x36, 0x52, 0xa9, 0x5, 0xb3, 0x76));
+constexpr StateAccessor<bool> virtualIoLightMockPowerState(QUuid(0xd1917b3d, 0x1530, 0x4cf9, 0x90, 0xf7, 0x26, 0x3e, 0xe8, 0x8e, 0x71, 0x4b), 0);
+constexpr EventAccessor virtualIoLightMockPowerEvent(QUuid(0xd1917b3d, 0x1530, 0x4cf9, 0x90, 0xf7, 0x26, 0x3e, 0xe8, 0x8e, 0x71, 0x4b));
+constexpr ParamAccessor<bool> virtualIoLightMockPowerEventPowerParam(QUuid(0xd1917b3d, 0x1530, 0x4cf9, 0x90, 0xf7, 0x26, 0x3e, 0xe8, 0x8e, 0x71, 0x4b));
+constexpr ActionAccessor virtualIoLightMockPowerAction(QUuid(0xd1917b3d, 0x1530, 0x4cf9, 0x90, 0xf7, 0x26, 0x3e, 0xe8, 0x8e, 0x71, 0x4b));
+constexpr ParamAccessor<bool> virtualIoLightMockPowerActionPowerParam(QUuid(0xd1917b3d, 0x1530, 0x4cf9, 0x90, 0xf7, 0x26, 0x3e, 0xe8, 0x8e, 0x71, 0x4b));
+constexpr ParamAccessor<double> virtualIoTemperatureSensorMockSettingsMinTempParam(QUuid(0x803cddbf, 0x94c7, 0x4f35, 0xbc, 0x7a, 0x18, 0x69, 0x8b, 0x3, 0xb9, 0x42));
+constexpr ParamAccessor<double> virtualIoTemperatureSensorMockSettingsMaxTempParam(QUuid(0x7077c56f, 0xc35b, 0x4252, 0x8c, 0x15, 0x8f, 0xb5, 0x49, 0xbe, 0x4, 0xce));
+constexpr StateAccessor<double> virtualIoTemperatureSensorMockInputState(QUuid(0xfd341f72, 0x6d9a, 0x4812, 0x9f, 0x66, 0x47, 0x19, 0x7c, 0x48, 0xa9, 0x35), 0);
+constexpr StateAccessor<double> virtualIoTemperatureSensorMockTemperatureState(QUuid(0xdb9cc518, 0x1012, 0x47e2, 0x82, 0x12, 0x6e, 0x61, 0x6f, 0xed, 0x7, 0xa6), 1);
+constexpr EventAccessor virtualIoTemperatureSensorMockInputEvent(QUuid(0xfd341f72, 0x6d9a, 0x4812, 0x9f, 0x66, 0x47, 0x19, 0x7c, 0x48, 0xa9, 0x35));
+constexpr ParamAccessor<double> virtualIoTemperatureSensorMockInputEventInputParam(QUuid(0xfd341f72, 0x6d9a, 0x4812, 0x9f, 0x66, 0x47, 0x19, 0x7c, 0x48, 0xa9, 0x35));
+constexpr EventAccessor virtualIoTemperatureSensorMockTemperatureEvent(QUuid(0xdb9cc518, 0x1012, 0x47e2, 0x82, 0x12, 0x6e, 0x61, 0x6f, 0xed, 0x7, 0xa6));
+constexpr ParamAccessor<double> virtualIoTemperatureSensorMockTemperatureEventTemperatureParam(QUuid(0xdb9cc518, 0x1012, 0x47e2, 0x82, 0x12, 0x6e, 0x61, 0x6f, 0xed, 0x7, 0xa6));
+constexpr ActionAccessor virtualIoTemperatureSensorMockInputAction(QUuid(0xfd341f72, 0x6d9a, 0x4812, 0x9f, 0x66, 0x47, 0x19, 0x7c, 0x48, 0xa9, 0x35));
+constexpr ParamAccessor<double> virtualIoTemperatureSensorMockInputActionInputParam(QUuid(0xfd341f72, 0x6d9a, 0x4812, 0x9f, 0x66, 0x47, 0x19, 0x7c, 0x48, 0xa9, 0x35));
+constexpr ParamAccessor<int> loadGeneratorMockSettingsStateIntervalParam(QUuid(0xbc0881bf, 0xd6aa, 0x4d80, 0xb5, 0x62, 0x40, 0x42, 0xa6, 0x1d, 0xfe, 0xb9));
+constexpr ParamAccessor<int> loadGeneratorMockSettingsStateCountParam(QUuid(0x2636b699, 0xa8a2, 0x46e0, 0x91, 0x3e, 0x82, 0x11, 0x62, 0xca, 0xce, 0x1c));
+constexpr ParamAccessor<int> loadGeneratorMockSettingsEventBurstIntervalParam(QUuid(0xadc08903, 0x3b2f, 0x43d8, 0xb3, 0xa7, 0x5a, 0xff, 0xbb, 0x50, 0xf9, 0xc0));
+constexpr ParamAccessor<int> loadGeneratorMockSettingsEventBurstSizeParam(QUuid(0xa5a5d6f0, 0x69f4, 0x46a5, 0xa9, 0xfe, 0x36, 0x53, 0xb7, 0x4, 0x32, 0x52));
+constexpr ParamAccessor<int> loadGeneratorMockSettingsActionLatencyMinParam(QUuid(0x8992549d, 0x5551, 0x4dfe, 0x80, 0xb9, 0x47, 0x2d, 0x87, 0x57, 0x1b, 0x3c));
+constexpr ParamAccessor<int> loadGeneratorMockSettingsActionLatencyMaxParam(QUuid(0x830c40af, 0x7c67, 0x4d8b, 0x8b, 0x2e, 0x6e, 0x6c, 0x94, 0x3d, 0xe0, 0x24));
+constexpr ParamAccessor<QString> loadGeneratorMockSettingsActionLatencyDistributionParam(QUuid(0xeaf9eda7, 0x7f86, 0x484e, 0xa6, 0x60, 0xb8, 0x12, 0x83, 0xf6, 0xd1, 0x9e));
+constexpr ParamAccessor<int> loadGeneratorMockDiscoveryResultCountParam(QUuid(0xe9cc7c17, 0x6dc9, 0x402c, 0x89, 0x82, 0x60, 0x5c, 0xd1, 0xfb, 0xa6, 0x98));
+constexpr StateAccessor<int> loadGeneratorMockValue1State(QUuid(0xb81c8baf, 0x3cce, 0x4819, 0xa7, 0xbd, 0xa7, 0xf2, 0x3c, 0xc2, 0x9b, 0x82), 0);
+constexpr StateAccessor<int> loadGeneratorMockValue2State(QUuid(0xb82b2d79, 0xb7c3, 0x4dbc, 0x9c, 0x65, 0xe8, 0x9d, 0x8b, 0x35, 0xc9, 0x2e), 1);
+constexpr StateAccessor<int> loadGeneratorMockValue3State(QUuid(0xf893e409, 0x45a5, 0x4c5f, 0xaf, 0x23, 0x40, 0x90, 0x5f, 0xdf, 0x21, 0x1), 2);
+constexpr StateAccessor<int> loadGeneratorMockValue4State(QUuid(0x35245c28, 0x9578, 0x4d28, 0xa2, 0xe7, 0xec, 0x7a, 0xf9, 0x60, 0x30, 0xeb), 3);
+constexpr StateAccessor<int> loadGeneratorMockValue5State(QUuid(0x9de7a917, 0x75b4, 0x400b, 0xb1, 0x4c, 0xc7, 0x81, 0xf6, 0x71, 0xf, 0x24), 4);
+constexpr EventAccessor loadGeneratorMockValue1Event(QUuid(0xb81c8baf, 0x3cce, 0x4819, 0xa7, 0xbd, 0xa7, 0xf2, 0x3c, 0xc2, 0x9b, 0x82));
+constexpr ParamAccessor<int> loadGeneratorMockValue1EventValue1Param(QUuid(0xb81c8baf, 0x3cce, 0x4819, 0xa7, 0xbd, 0xa7, 0xf2, 0x3c, 0xc2, 0x9b, 0x82));
+constexpr EventAccessor loadGeneratorMockValue2Event(QUuid(0xb82b2d79, 0xb7c3, 0x4dbc, 0x9c, 0x65, 0xe8, 0x9d, 0x8b, 0x35, 0xc9, 0x2e));
+constexpr ParamAccessor<int> loadGeneratorMockValue2EventValue2Param(QUuid(0xb82b2d79, 0xb7c3, 0x4dbc, 0x9c, 0x65, 0xe8, 0x9d, 0x8b, 0x35, 0xc9, 0x2e));
+constexpr EventAccessor loadGeneratorMockValue3Event(QUuid(0xf893e409, 0x45a5, 0x4c5f, 0xaf, 0x23, 0x40, 0x90, 0x5f, 0xdf, 0x21, 0x1));
+constexpr ParamAccessor<int> loadGeneratorMockValue3EventValue3Param(QUuid(0xf893e409, 0x45a5, 0x4c5f, 0xaf, 0x23, 0x40, 0x90, 0x5f, 0xdf, 0x21, 0x1));
+constexpr EventAccessor loadGeneratorMockValue4Event(QUuid(0x35245c28, 0x9578, 0x4d28, 0xa2, 0xe7, 0xec, 0x7a, 0xf9, 0x60, 0x30, 0xeb));
+constexpr ParamAccessor<int> loadGeneratorMockValue4EventValue4Param(QUuid(0x35245c28, 0x9578, 0x4d28, 0xa2, 0xe7, 0xec, 0x7a, 0xf9, 0x60, 0x30, 0xeb));
+constexpr EventAccessor loadGeneratorMockValue5Event(QUuid(0x9de7a917, 0x75b4, 0x400b, 0xb1, 0x4c, 0xc7, 0x81, 0xf6, 0x71, 0xf, 0x24));
+constexpr ParamAccessor<int> loadGeneratorMockValue5EventValue5Param(QUuid(0x9de7a917, 0x75b4, 0x400b, 0xb1, 0x4c, 0xc7, 0x81, 0xf6, 0x71, 0xf, 0x24));
+constexpr EventAccessor loadGeneratorMockBurstEvent(QUuid(0x45c5d8, 0xbec2, 0x45e9, 0xbb, 0xd3, 0xb, 0x54, 0x67, 0xeb, 0xb, 0x99));
+constexpr ParamAccessor<int> loadGeneratorMockBurstEventIndexParam(QUuid(0xb5f57f8a, 0x291f, 0x4842, 0x9b, 0x7d, 0x66, 0x4f, 0x78, 0x7c, 0x81, 0xdb));
+constexpr ActionAccessor loadGeneratorMockWorkAction(QUuid(0x446027e8, 0x639c, 0x4de8, 0xb3, 0x46, 0xfb, 0x24, 0xe4, 0x90, 0xe5, 0x68));
+#endif // PLUGININFO_ACCESSORS
 
 const QString translations[] {
+    //: The name of the ParamType (ThingClass: loadGeneratorMock, Type: settings, ID: {eaf9eda7-7f86-484e-a660-b81283f6d19e})
+    QT_TRANSLATE_NOOP("mock", "Action latency distribution"),
+
     //: The name of the Browser Item ActionType ({00b8f0a8-99ca-4aa4-833d-59eb8d4d6de3}) of ThingClass mock
     QT_TRANSLATE_NOOP("mock", "Add to favorites"),
 
@@ -417,6 +779,12 @@ const QString translations[] {
     //: The name of the EventType ({3bad3a09-5826-4ed7-a832-10e3e2ee2a7d}) of ThingClass inputTypeMock
     QT_TRANSLATE_NOOP("mock", "Bool changed"),
 
+    //: The name of the EventType ({0045c5d8-bec2-45e9-bbd3-0b5467eb0b99}) of ThingClass loadGeneratorMock
+    QT_TRANSLATE_NOOP("mock", "Burst event"),
+
+    //: The name of the ParamType (ThingClass: loadGeneratorMock, Type: settings, ID: {2636b699-a8a2-46e0-913e-821162cace1c})
+    QT_TRANSLATE_NOOP("mock", "Changing states"),
+
     //: The name of the ParamType (ThingClass: inputTypeMock, EventType: color, ID: {4507d5c6-b692-4bd6-87f2-00364bc0cb4d})
     QT_TRANSLATE_NOOP("mock", "Color"),
 
@@ -543,6 +911,12 @@ const QString translations[] {
     //: The name of the EventType ({5aa479bd-537a-4716-9852-52f6eec58722}) of ThingClass mock
     QT_TRANSLATE_NOOP("mock", "Dummy int state with limits changed"),
 
+    //: The name of the ParamType (ThingClass: loadGeneratorMock, Type: settings, ID: {adc08903-3b2f-43d8-b3a7-5affbb50f9c0})
+    QT_TRANSLATE_NOOP("mock", "Event burst interval"),
+
+    //: The name of the ParamType (ThingClass: loadGeneratorMock, Type: settings, ID: {a5a5d6f0-69f4-46a5-a9fe-3653b7043252})
+    QT_TRANSLATE_NOOP("mock", "Events per burst"),
+
     //: The name of the ParamType (ThingClass: mock, EventType: currentVersion, ID: {9f2e1e5d-3f1f-4794-aca3-4e05b7a48842})
     QT_TRANSLATE_NOOP("mock", "Firmware version"),
 
@@ -567,6 +941,9 @@ const QString translations[] {
     //: The name of the ParamType (ThingClass: inputTypeMock, Type: thing, ID: {43bf3832-dd48-4090-a836-656e8b60216e})
     QT_TRANSLATE_NOOP("mock", "IPv6 address"),
 
+    //: The name of the ParamType (ThingClass: loadGeneratorMock, EventType: burst, ID: {b5f57f8a-291f-4842-9b7d-664f787c81db})
+    QT_TRANSLATE_NOOP("mock", "Index"),
+
     //: The name of the ParamType (ThingClass: virtualIoTemperatureSensorMock, ActionType: input, ID: {fd341f72-6d9a-4812-9f66-47197c48a935})
     QT_TRANSLATE_NOOP("mock", "Input"),
 
@@ -588,18 +965,27 @@ const QString translations[] {
     //: The name of the EventType ({d0fc56ae-5791-4e91-b76c-dadfbc7e7dbb}) of ThingClass inputTypeMock
     QT_TRANSLATE_NOOP("mock", "Int changed"),
 
+    //: The name of the ThingClass ({7096c9cd-1b47-4e5e-8b63-7a20320b9015})
+    QT_TRANSLATE_NOOP("mock", "Load Generator (Mock)"),
+
     //: The name of the ParamType (ThingClass: inputTypeMock, Type: thing, ID: {e93db587-7919-48f3-8c88-1651de63c765})
     QT_TRANSLATE_NOOP("mock", "Mac address"),
 
     //: The name of the ParamType (ThingClass: inputTypeMock, Type: thing, ID: {a8494faf-3a0f-4cf3-84b7-4b39148a838d})
     QT_TRANSLATE_NOOP("mock", "Mail address"),
 
+    //: The name of the ParamType (ThingClass: loadGeneratorMock, Type: settings, ID: {830c40af-7c67-4d8b-8b2e-6e6c943de024})
+    QT_TRANSLATE_NOOP("mock", "Maximum action latency"),
+
     //: The name of the ParamType (ThingClass: virtualIoTemperatureSensorMock, Type: settings, ID: {7077c56f-c35b-4252-8c15-8fb549be04ce})
     QT_TRANSLATE_NOOP("mock", "Maximum temperature"),
 
     //: The name of the ParamType (ThingClass: mock, Type: settings, ID: {984e7ae0-6de7-447e-bc4d-5afde8a00f27})
     QT_TRANSLATE_NOOP("mock", "Maximum value for int with limits"),
 
+    //: The name of the ParamType (ThingClass: loadGeneratorMock, Type: settings, ID: {8992549d-5551-4dfe-80b9-472d87571b3c})
+    QT_TRANSLATE_NOOP("mock", "Minimum action latency"),
+
     //: The name of the ParamType (ThingClass: virtualIoTemperatureSensorMock, Type: settings, ID: {803cddbf-94c7-4f35-bc7a-18698b03b942})
     QT_TRANSLATE_NOOP("mock", "Minimum temperature"),
 
@@ -702,6 +1088,9 @@ const QString translations[] {
     //: The name of the Browser Item ActionType ({da6faef8-2816-430e-93bb-57e8f9582d29}) of ThingClass mock
     QT_TRANSLATE_NOOP("mock", "Remove from favorites"),
 
+    //: The name of the ParamType (ThingClass: loadGeneratorMock, Type: discovery, ID: {e9cc7c17-6dc9-402c-8982-605cd1fba698})
+    QT_TRANSLATE_NOOP("mock", "Result count"),
+
     //: The name of the ParamType (ThingClass: mock, Type: discovery, ID: {d222adb4-2f9c-4c3f-8655-76400d0fb6ce})
     QT_TRANSLATE_NOOP("mock", "Result count"),
 
@@ -831,6 +1220,9 @@ const QString translations[] {
     //: The name of the EventType ({2a0213bf-4af3-4384-904e-3376348a597e}) of ThingClass mock
     QT_TRANSLATE_NOOP("mock", "Signal strength changed"),
 
+    //: The name of the ParamType (ThingClass: loadGeneratorMock, Type: settings, ID: {bc0881bf-d6aa-4d80-b562-4042a61dfeb9})
+    QT_TRANSLATE_NOOP("mock", "State change interval"),
+
     //: The name of the ParamType (ThingClass: inputTypeMock, EventType: string, ID: {27f69ca9-a321-40ff-bfee-4b0272a671b4})
     QT_TRANSLATE_NOOP("mock", "String"),
 
@@ -915,6 +1307,54 @@ const QString translations[] {
     //: The name of the EventType ({ebc41327-53d5-40c2-8e7b-1164a8ff359e}) of ThingClass mock
     QT_TRANSLATE_NOOP("mock", "Update status changed"),
 
+    //: The name of the ParamType (ThingClass: loadGeneratorMock, EventType: value1, ID: {b81c8baf-3cce-4819-a7bd-a7f23cc29b82})
+    QT_TRANSLATE_NOOP("mock", "Value 1"),
+
+    //: The name of the StateType ({b81c8baf-3cce-4819-a7bd-a7f23cc29b82}) of ThingClass loadGeneratorMock
+    QT_TRANSLATE_NOOP("mock", "Value 1"),
+
+    //: The name of the EventType ({b81c8baf-3cce-4819-a7bd-a7f23cc29b82}) of ThingClass loadGeneratorMock
+    QT_TRANSLATE_NOOP("mock", "Value 1 changed"),
+
+    //: The name of the ParamType (ThingClass: loadGeneratorMock, EventType: value2, ID: {b82b2d79-b7c3-4dbc-9c65-e89d8b35c92e})
+    QT_TRANSLATE_NOOP("mock", "Value 2"),
+
+    //: The name of the StateType ({b82b2d79-b7c3-4dbc-9c65-e89d8b35c92e}) of ThingClass loadGeneratorMock
+    QT_TRANSLATE_NOOP("mock", "Value 2"),
+
+    //: The name of the EventType ({b82b2d79-b7c3-4dbc-9c65-e89d8b35c92e}) of ThingClass loadGeneratorMock
+    QT_TRANSLATE_NOOP("mock", "Value 2 changed"),
+
+    //: The name of the ParamType (ThingClass: loadGeneratorMock, EventType: value3, ID: {f893e409-45a5-4c5f-af23-40905fdf2101})
+    QT_TRANSLATE_NOOP("mock", "Value 3"),
+
+    //: The name of the StateType ({f893e409-45a5-4c5f-af23-40905fdf2101}) of ThingClass loadGeneratorMock
+    QT_TRANSLATE_NOOP("mock", "Value 3"),
+
+    //: The name of the EventType ({f893e409-45a5-4c5f-af23-40905fdf2101}) of ThingClass loadGeneratorMock
+    QT_TRANSLATE_NOOP("mock", "Value 3 changed"),
+
+    //: The name of the ParamType (ThingClass: loadGeneratorMock, EventType: value4, ID: {35245c28-9578-4d28-a2e7-ec7af96030eb})
+    QT_TRANSLATE_NOOP("mock", "Value 4"),
+
+    //: The name of the StateType ({35245c28-9578-4d28-a2e7-ec7af96030eb}) of ThingClass loadGeneratorMock
+    QT_TRANSLATE_NOOP("mock", "Value 4"),
+
+    //: The name of the EventType ({35245c28-9578-4d28-a2e7-ec7af96030eb}) of ThingClass loadGeneratorMock
+    QT_TRANSLATE_NOOP("mock", "Value 4 changed"),
+
+    //: The name of the ParamType (ThingClass: loadGeneratorMock, EventType: value5, ID: {9de7a917-75b4-400b-b14c-c781f6710f24})
+    QT_TRANSLATE_NOOP("mock", "Value 5"),
+
+    //: The name of the StateType ({9de7a917-75b4-400b-b14c-c781f6710f24}) of ThingClass loadGeneratorMock
+    QT_TRANSLATE_NOOP("mock", "Value 5"),
+
+    //: The name of the EventType ({9de7a917-75b4-400b-b14c-c781f6710f24}) of ThingClass loadGeneratorMock
+    QT_TRANSLATE_NOOP("mock", "Value 5 changed"),
+
+    //: The name of the ActionType ({446027e8-639c-4de8-b346-fb24e490e568}) of ThingClass loadGeneratorMock
+    QT_TRANSLATE_NOOP("mock", "Work"),
+
     //: The name of the ParamType (ThingClass: inputTypeMock, ActionType: writableBool, ID: {a7c11774-f31f-4d64-99d1-e0ae5fb35a5c})
     QT_TRANSLATE_NOOP("mock", "Writable Bool"),
 
@@ -125,7 +125,7 @@ def timerTriggered():
             logger.log("Emitting event 1 for", thing.name)
             thing.emitEvent(pyMockDiscoveryPairingEvent1EventTypeId, [nymea.Param(pyMockDiscoveryPairingEvent1EventParam1ParamTypeId, "Im an event")])
             logger.log("Setting state 1 for", thing.name, "Old value is:", thing.stateValue(pyMockDiscoveryPairingState1StateTypeId))
-            thing.setStateValue(pyMockDiscoveryPairingState1StateTypeId, thing.stateValue(pyMockDiscoveryPairingState1StateTypeId) + 1)
+            thing.setStateValues({pyMockDiscoveryPairingState1StateTypeId: thing.stateValue(pyMockDiscoveryPairingState1StateTypeId) + 1})
 
 
 # If the plugin supports things with actions, nymea will call this to run actions
@@ -43,10 +43,12 @@
 #include <QString>
 #include <QFile>
 #include <QDir>
+#include <QScopedPointer>
 
 #include "stdio.h"
 #include "unistd.h"
 #include "nymeacore.h"
+#include "replication/replicationstandby.h"
 #include "nymeaservice.h"
 #include "nymeasettings.h"
 #include "nymeadbusservice.h"
@@ -120,6 +122,9 @@ int main(int argc, char *argv[])
     QCommandLineOption noColorOption({"c", "no-colors"}, QCoreApplication::translate("nymea", "Log output is colorized by default. Use this option to disable colors."));
     parser.addOption(noColorOption);
 
+    QCommandLineOption logDropPolicyOption({"log-drop-policy"}, QCoreApplication::translate("nymea", "What to do if log messages are produced faster than they can be written. \"drop\" (default) drops new messages, \"block\" makes the logging thread wait."), "drop|block");
+    parser.addOption(logDropPolicyOption);
+
     QCommandLineOption dbusOption(QStringList() << "session", QCoreApplication::translate("nymea", "If specified, all D-Bus interfaces will be bound to the session bus instead of the system bus."));
     parser.addOption(dbusOption);
 
@@ -132,7 +137,8 @@ int main(int argc, char *argv[])
     parser.process(application);
 
     // Open the logfile, if any specified
-    if (!initLogging(parser.value(logOption), !parser.isSet(noColorOption))) {
+    LogDropPolicy logDropPolicy = parser.value(logDropPolicyOption) == "block" ? LogDropPolicyBlock : LogDropPolicyDropNewest;
+    if (!initLogging(parser.value(logOption), !parser.isSet(noColorOption), logDropPolicy)) {
         qWarning() << "Error opening log file" << parser.value(logOption);
         return 1;
     }
@@ -218,9 +224,17 @@ int main(int argc, char *argv[])
             qCInfo(dcApplication) << "Snap app common :" << qgetenv("SNAP_COMMON");
         }
 
-        // create core instance
-        NymeaCore::instance()->init(parser.values(interfacesOption));
+        QScopedPointer<ReplicationStandby> standby;
+        if (ReplicationStandby::configured()) {
+            // A hot standby only follows its primary. It is promoted by removing the primary
+            // from the Replication section of nymead.conf and restarting it.
+            standby.reset(new ReplicationStandby());
+        } else {
+            // create core instance
+            NymeaCore::instance()->init(parser.values(interfacesOption));
+        }
         int ret = application.exec();
+        standby.reset();
         closeLogFile();
         return ret;
     }
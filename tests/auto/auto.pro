@@ -4,25 +4,36 @@ SUBDIRS = \
         actions \
         configurations \
         devices \
+        eventqueue \
         events \
+        experiences \
+        federation \
         integrations \
         ioconnections \
         jsonrpc \
         logging \
+        logsink \
         loggingdirect \
         loggingloading \
         mqttbroker \
+        nymeaasync \
+        pluginhost \
+        pluginhostprotocol \
         plugins \
         pythonplugins \
+        radio433 \
+        replication \
         rules \
         scripts \
         states \
         tags \
+        thingstatecache \
         timemanager \
         userloading \
         usermanager \
         versioning \
         webserver \
         websocketserver \
+        workerthread \
         #coap \ # temporary removed until fixed
 
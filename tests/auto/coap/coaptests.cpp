@@ -132,6 +132,104 @@ void CoapTests::invalidScheme()
     QCOMPARE(reply->error(), CoapReply::InvalidUrlSchemeError);
 }
 
+void CoapTests::pduView()
+{
+    CoapPdu pdu;
+    pdu.setMessageType(CoapPdu::Confirmable);
+    pdu.setStatusCode(CoapPdu::Content);
+    pdu.setMessageId(4242);
+    pdu.setToken(QByteArray::fromHex("cafe01"));
+    pdu.addOption(CoapOption::Observe, QByteArray::fromHex("0102"));
+    pdu.addOption(CoapOption::ContentFormat, QByteArray(1, (char)CoapPdu::ApplicationJson));
+    pdu.addOption(CoapOption::Block2, CoapPduBlock::createBlock(3, 2, true));
+    pdu.setPayload("{\"nymea\": \"awesome\"}");
+
+    QByteArray data = pdu.pack();
+    CoapPduView view(data);
+    QVERIFY(view.isValid());
+    QCOMPARE(view.version(), (quint8)1);
+    QCOMPARE(view.messageType(), CoapPdu::Confirmable);
+    QCOMPARE(view.statusCode(), CoapPdu::Content);
+    QCOMPARE(view.messageId(), (quint16)4242);
+    QCOMPARE(view.token(), QByteArray::fromHex("cafe01"));
+    QVERIFY(view.hasOption(CoapOption::Observe));
+    QVERIFY(!view.hasOption(CoapOption::Block1));
+    QCOMPARE(view.optionValue(CoapOption::Observe), (quint32)0x0102);
+    QCOMPARE(view.contentType(), CoapPdu::ApplicationJson);
+    QCOMPARE(view.block().blockNumber(), 3);
+    QVERIFY(view.block().moreFlag());
+    QCOMPARE(view.options().count(), 3);
+    QCOMPARE(view.payload(), QByteArray("{\"nymea\": \"awesome\"}"));
+
+    // The full parser has to produce the same result
+    CoapPdu parsedPdu(data);
+    QVERIFY(parsedPdu.isValid());
+    QCOMPARE(parsedPdu.messageId(), view.messageId());
+    QCOMPARE(parsedPdu.token(), view.token());
+    QCOMPARE(parsedPdu.contentType(), view.contentType());
+    QCOMPARE(parsedPdu.options().count(), view.options().count());
+    QCOMPARE(parsedPdu.payload(), view.payload());
+}
+
+void CoapTests::pduViewInvalid()
+{
+    CoapPdu pdu;
+    pdu.setMessageId(1);
+    pdu.setToken(QByteArray::fromHex("0102"));
+    pdu.addOption(CoapOption::UriPath, "hello");
+    QByteArray data = pdu.pack();
+
+    // Message shorter than the header
+    QCOMPARE(CoapPduView(data.left(3)).error(), CoapPdu::InvalidPduSizeError);
+
+    // Token exceeding the message
+    QCOMPARE(CoapPduView(data.left(5)).error(), CoapPdu::InvalidPduSizeError);
+
+    // Option data exceeding the message
+    CoapPduView truncatedView(data.left(data.size() - 1));
+    QCOMPARE(truncatedView.error(), CoapPdu::InvalidOptionLengthError);
+    QVERIFY(!truncatedView.hasOption(CoapOption::UriPath));
+
+    // Payload marker without payload
+    QCOMPARE(CoapPduView(data + QByteArray(1, (char)0xff)).error(), CoapPdu::InvalidPduSizeError);
+
+    // Reserved option delta
+    QByteArray reserved = data.left(6);
+    reserved.append((char)0xf0);
+    QCOMPARE(CoapPduView(reserved).error(), CoapPdu::InvalidOptionDeltaError);
+}
+
+void CoapTests::blockOption_data()
+{
+    QTest::addColumn<int>("blockNumber");
+    QTest::addColumn<int>("blockSize");
+    QTest::addColumn<bool>("moreFlag");
+    QTest::addColumn<int>("length");
+
+    QTest::newRow("first block") << 0 << 64 << true << 1;
+    QTest::newRow("last short block") << 15 << 16 << false << 1;
+    QTest::newRow("two bytes") << 16 << 1024 << true << 2;
+    QTest::newRow("two bytes max") << 4095 << 256 << false << 2;
+    QTest::newRow("three bytes") << 4096 << 512 << true << 3;
+    QTest::newRow("three bytes max") << 1048575 << 32 << true << 3;
+}
+
+void CoapTests::blockOption()
+{
+    QFETCH(int, blockNumber);
+    QFETCH(int, blockSize);
+    QFETCH(bool, moreFlag);
+    QFETCH(int, length);
+
+    QByteArray data = CoapPduBlock::createBlock(blockNumber, CoapPduBlock::sizeExponent(blockSize), moreFlag);
+    QCOMPARE(data.length(), length);
+
+    CoapPduBlock block(data);
+    QCOMPARE(block.blockNumber(), blockNumber);
+    QCOMPARE(block.blockSize(), blockSize);
+    QCOMPARE(block.moreFlag(), moreFlag);
+}
+
 void CoapTests::ping()
 {
     CoapRequest request;
@@ -428,6 +526,35 @@ void CoapTests::largeDownload()
     reply->deleteLater();
 }
 
+void CoapTests::streamedDownload()
+{
+    CoapRequest request(QUrl("coap://coap.me:5683/large"));
+    request.setStreamingEnabled(true);
+    request.setBlockSize(256);
+    request.setPipelineDepth(4);
+
+    CoapReply *reply = m_coap->get(request);
+    QSignalSpy finishedSpy(reply, &CoapReply::finished);
+
+    QByteArray data;
+    int blocks = 0;
+    connect(reply, &CoapReply::readyRead, this, [reply, &data, &blocks](){
+        data.append(reply->readAll());
+        blocks++;
+    });
+
+    finishedSpy.wait(20000);
+    QVERIFY2(finishedSpy.count() > 0, "Did not get a response.");
+    QCOMPARE(reply->statusCode(), CoapPdu::Content);
+    QCOMPARE(reply->error(), CoapReply::NoError);
+    QVERIFY2(blocks > 1, "Payload has not been streamed.");
+    QCOMPARE(data.size(), 1700);
+    QCOMPARE(reply->bytesReceived(), (qint64)1700);
+    QVERIFY(reply->payload().isEmpty());
+
+    reply->deleteLater();
+}
+
 void CoapTests::largeCreate()
 {
     CoapRequest request(QUrl("coap://coap.me:5683/large-create"));
@@ -523,6 +650,63 @@ void CoapTests::multipleCalls()
     qDeleteAll(replies);
 }
 
+void CoapTests::parallelCalls()
+{
+    QSignalSpy spy(m_coap, SIGNAL(replyFinished(CoapReply*)));
+
+    m_coap->setNStart(4);
+
+    QList<CoapReply *> replies;
+    replies.append(m_coap->get(CoapRequest(QUrl("coap://coap.me:5683/hello"))));
+    replies.append(m_coap->get(CoapRequest(QUrl("coap://coap.me:5683/separate"))));
+    replies.append(m_coap->get(CoapRequest(QUrl("coap://coap.me:5683/large"))));
+    replies.append(m_coap->get(CoapRequest(QUrl("coap://coap.me:5683/query?nymea=awesome"))));
+    replies.append(m_coap->ping(CoapRequest(QUrl("coap://coap.me"))));
+
+    for (int i = 0; i < 10 && spy.count() < replies.count(); i++)
+        spy.wait(2000);
+
+    m_coap->setNStart(1);
+
+    QCOMPARE(spy.count(), replies.count());
+
+    foreach (CoapReply *reply, replies) {
+        QCOMPARE(reply->messageType(), CoapPdu::Acknowledgement);
+        QCOMPARE(reply->error(), CoapReply::NoError);
+    }
+
+    QCOMPARE(replies.at(0)->payload(), QByteArray("world"));
+
+    qDeleteAll(replies);
+}
+
+void CoapTests::responseCache()
+{
+    m_coap->setResponseCacheEnabled(true);
+
+    QSignalSpy spy(m_coap, SIGNAL(replyFinished(CoapReply*)));
+    CoapReply *reply = m_coap->get(CoapRequest(QUrl("coap://coap.me/hello")));
+    spy.wait();
+    QVERIFY2(spy.count() > 0, "Did not get a response.");
+    QCOMPARE(reply->error(), CoapReply::NoError);
+    QCOMPARE(reply->payload(), QByteArray("world"));
+    quint32 maxAge = reply->maxAge();
+    reply->deleteLater();
+
+    // The second request has to be answered from the cache without a round trip
+    spy.clear();
+    CoapReply *cachedReply = m_coap->get(CoapRequest(QUrl("coap://coap.me/hello")));
+    QVERIFY(!cachedReply->isFinished());
+    QVERIFY(spy.wait(100));
+    QCOMPARE(cachedReply->error(), CoapReply::NoError);
+    QCOMPARE(cachedReply->statusCode(), CoapPdu::Content);
+    QCOMPARE(cachedReply->payload(), QByteArray("world"));
+    QVERIFY(cachedReply->maxAge() <= maxAge);
+    cachedReply->deleteLater();
+
+    m_coap->setResponseCacheEnabled(false);
+}
+
 void CoapTests::coreLinkParser()
 {
     CoapRequest request(QUrl("coap://coap.me/.well-known/core"));
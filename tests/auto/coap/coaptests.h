@@ -31,6 +31,7 @@
 
 #include "coap/coap.h"
 #include "coap/coappdu.h"
+#include "coap/coappduview.h"
 #include "coap/coapreply.h"
 #include "coap/corelinkparser.h"
 
@@ -51,6 +52,12 @@ private slots:
 
     void invalidScheme();
 
+    void pduView();
+    void pduViewInvalid();
+
+    void blockOption_data();
+    void blockOption();
+
     void ping();
     void hello();
     void broken();
@@ -73,10 +80,13 @@ private slots:
     void jsonMessage();
 
     void largeDownload();
+    void streamedDownload();
     void largeCreate();
     void largeUpdate();
 
     void multipleCalls();
+    void parallelCalls();
+    void responseCache();
 
     void coreLinkParser();
 
@@ -32,9 +32,43 @@
 #include "nymeacore.h"
 #include "nymeasettings.h"
 #include "servers/mocktcpserver.h"
+#include "servermanager.h"
+#include "platform/platform.h"
+#include "platform/platformzeroconfcontroller.h"
+#include "network/zeroconf/zeroconfservicepublisher.h"
 
 using namespace nymeaserver;
 
+// Records the calls of the server manager, the first failingRegistrations registrations fail
+class MockZeroConfServicePublisher: public ZeroConfServicePublisher
+{
+public:
+    explicit MockZeroConfServicePublisher(QObject *parent = nullptr): ZeroConfServicePublisher(parent) {}
+
+    bool registerService(const QString &name, const QHostAddress &hostAddress, const quint16 &port, const QString &serviceType, const QHash<QString, QString> &txtRecords) override {
+        Q_UNUSED(hostAddress)
+        Q_UNUSED(port)
+        Q_UNUSED(serviceType)
+        if (failingRegistrations > 0) {
+            failingRegistrations--;
+            failed.append(name);
+            return false;
+        }
+        registered.append(name);
+        serverNames.insert(name, txtRecords.value("name"));
+        return true;
+    }
+    void unregisterService(const QString &id) override {
+        unregistered.append(id);
+    }
+
+    int failingRegistrations = 0;
+    QStringList registered;
+    QStringList unregistered;
+    QStringList failed;
+    QHash<QString, QString> serverNames;
+};
+
 class TestConfigurations: public NymeaTestBase
 {
     Q_OBJECT
@@ -51,6 +85,7 @@ private slots:
     void getConfigurations();
 
     void testServerName();
+    void testZeroConfServerName();
     void testLanguages();
 
     void testDebugServerConfiguration();
@@ -150,6 +185,54 @@ void TestConfigurations::testServerName()
     disableNotifications();
 }
 
+void TestConfigurations::testZeroConfServerName()
+{
+    ServerManager *serverManager = NymeaCore::instance()->serverManager();
+    MockZeroConfServicePublisher *publisher = new MockZeroConfServicePublisher(this);
+    serverManager->setZeroConfServicePublisher(publisher);
+
+    // All services are registered with the new publisher at once
+    QTRY_VERIFY(!publisher->registered.isEmpty());
+    QStringList services = publisher->registered;
+    services.sort();
+    QVERIFY(publisher->unregistered.isEmpty());
+
+    // Renaming the server changes the txt records of every service, each is updated exactly once
+    publisher->registered.clear();
+    QString serverName = QString("ZeroConf test %1").arg(QUuid::createUuid().toString());
+    QVariantMap params;
+    params.insert("serverName", serverName);
+    verifyConfigurationError(injectAndWait("Configuration.SetServerName", params));
+
+    QTRY_COMPARE(publisher->registered.count(), services.count());
+    QTest::qWait(500);
+    QStringList registered = publisher->registered;
+    registered.sort();
+    QStringList unregistered = publisher->unregistered;
+    unregistered.sort();
+    QCOMPARE(registered, services);
+    QCOMPARE(unregistered, services);
+    foreach (const QString &service, services) {
+        QCOMPARE(publisher->serverNames.value(service), serverName);
+    }
+
+    // A failed registration is retried later
+    publisher->registered.clear();
+    publisher->unregistered.clear();
+    publisher->failingRegistrations = 1;
+    serverName = QString("ZeroConf test %1").arg(QUuid::createUuid().toString());
+    params.insert("serverName", serverName);
+    verifyConfigurationError(injectAndWait("Configuration.SetServerName", params));
+
+    QTRY_COMPARE_WITH_TIMEOUT(publisher->registered.count(), services.count(), 5000);
+    QCOMPARE(publisher->failed.count(), 1);
+    QVERIFY(services.contains(publisher->failed.first()));
+    QCOMPARE(publisher->unregistered.count(), services.count());
+
+    serverManager->setZeroConfServicePublisher(NymeaCore::instance()->platform()->zeroConfController()->servicePublisher());
+    publisher->deleteLater();
+}
+
 void TestConfigurations::testLanguages()
 {
     enableNotifications({"Configuration"});
@@ -0,0 +1,6 @@
+TARGET = testeventqueue
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testeventqueue.cpp
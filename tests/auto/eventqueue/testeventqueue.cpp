@@ -0,0 +1,253 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "eventqueue.h"
+
+#include <QtTest>
+
+using namespace nymeaserver;
+
+class TestEventQueue: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestEventQueue(QObject *parent = nullptr);
+
+private:
+    ThingId m_thingId = ThingId::createThingId();
+    ThingId m_otherThingId = ThingId::createThingId();
+    EventTypeId m_eventTypeId = EventTypeId::createEventTypeId();
+    EventTypeId m_stateTypeId = EventTypeId::createEventTypeId();
+    EventTypeId m_otherStateTypeId = EventTypeId::createEventTypeId();
+
+    QList<Event> m_delivered;
+    // Time each delivery takes, in ms, taken from the front for every event delivered
+    QList<int> m_deliveryTimes;
+
+    Event stateChangeEvent(const ThingId &thingId, const EventTypeId &stateTypeId, int value) const;
+    void occupySlice(EventQueue *queue);
+
+private slots:
+    void onEventReady(const Event &event);
+
+    void deliverDirectly();
+    void sliceBudget();
+    void userLanePriority();
+    void prioritizeQueuedEvents();
+    void coalesceStateChanges();
+    void nestedEvents();
+};
+
+TestEventQueue::TestEventQueue(QObject *parent):
+    QObject(parent)
+{
+}
+
+Event TestEventQueue::stateChangeEvent(const ThingId &thingId, const EventTypeId &stateTypeId, int value) const
+{
+    return Event(stateTypeId, thingId, ParamList() << Param(ParamTypeId(stateTypeId.toString()), value), true);
+}
+
+// Delivers an event taking longer than the slice budget, so the following ones get queued
+void TestEventQueue::occupySlice(EventQueue *queue)
+{
+    m_deliveryTimes.prepend(50);
+    queue->enqueue(Event(m_eventTypeId, m_thingId));
+    m_delivered.clear();
+}
+
+void TestEventQueue::onEventReady(const Event &event)
+{
+    m_delivered.append(event);
+    if (!m_deliveryTimes.isEmpty()) {
+        QTest::qSleep(m_deliveryTimes.takeFirst());
+    }
+}
+
+void TestEventQueue::deliverDirectly()
+{
+    EventQueue queue(10);
+    connect(&queue, &EventQueue::eventReady, this, &TestEventQueue::onEventReady);
+    m_delivered.clear();
+
+    queue.enqueue(Event(m_eventTypeId, m_thingId));
+    QCOMPARE(m_delivered.count(), 1);
+    QCOMPARE(queue.depth(), 0);
+    QCOMPARE(queue.statistics().value("deliveredDirectly").toInt(), 1);
+}
+
+void TestEventQueue::sliceBudget()
+{
+    EventQueue queue(10);
+    connect(&queue, &EventQueue::eventReady, this, &TestEventQueue::onEventReady);
+    m_delivered.clear();
+
+    // Each of them uses up a whole slice
+    m_deliveryTimes = {20, 20, 20, 20, 20};
+    for (int i = 0; i < 5; i++) {
+        queue.enqueue(Event(m_eventTypeId, m_thingId));
+    }
+    QCOMPARE(m_delivered.count(), 1);
+    QCOMPARE(queue.depth(), 4);
+
+    // Other work gets its turn before the queue is drained
+    int deliveredBefore = -1;
+    QTimer::singleShot(0, this, [this, &deliveredBefore](){
+        deliveredBefore = m_delivered.count();
+    });
+    QTRY_COMPARE(m_delivered.count(), 5);
+    QVERIFY(deliveredBefore >= 1);
+    QVERIFY(deliveredBefore < 5);
+    QCOMPARE(queue.depth(), 0);
+
+    QVariantMap statistics = queue.statistics();
+    QCOMPARE(statistics.value("deliveredQueued").toInt(), 4);
+    QVERIFY(statistics.value("slices").toInt() >= 4);
+    QCOMPARE(statistics.value("sliceBudget").toInt(), 10);
+}
+
+void TestEventQueue::userLanePriority()
+{
+    EventQueue queue(10);
+    connect(&queue, &EventQueue::eventReady, this, &TestEventQueue::onEventReady);
+    occupySlice(&queue);
+
+    for (int i = 0; i < 3; i++) {
+        queue.enqueue(Event(m_eventTypeId, m_thingId));
+    }
+    // Action executed by the user, its feedback overtakes the queued events
+    queue.onActionExecuted(Action(ActionTypeId::createActionTypeId(), m_otherThingId, Action::TriggeredByUser), Thing::ThingErrorNoError);
+    queue.enqueue(Event(m_eventTypeId, m_otherThingId));
+    QCOMPARE(queue.statistics().value("userLaneDepth").toInt(), 1);
+
+    QTRY_COMPARE(m_delivered.count(), 4);
+    QCOMPARE(m_delivered.first().thingId(), m_otherThingId);
+    for (int i = 1; i < 4; i++) {
+        QCOMPARE(m_delivered.at(i).thingId(), m_thingId);
+    }
+
+    // Actions executed by rules don't change the order
+    EventQueue ruleQueue(10);
+    connect(&ruleQueue, &EventQueue::eventReady, this, &TestEventQueue::onEventReady);
+    occupySlice(&ruleQueue);
+    ThingId ruleThingId = ThingId::createThingId();
+    ruleQueue.enqueue(Event(m_eventTypeId, m_thingId));
+    ruleQueue.onActionExecuted(Action(ActionTypeId::createActionTypeId(), ruleThingId, Action::TriggeredByRule), Thing::ThingErrorNoError);
+    ruleQueue.enqueue(Event(m_eventTypeId, ruleThingId));
+    QCOMPARE(ruleQueue.statistics().value("userLaneDepth").toInt(), 0);
+    QTRY_COMPARE(m_delivered.count(), 2);
+    QCOMPARE(m_delivered.first().thingId(), m_thingId);
+    QCOMPARE(m_delivered.last().thingId(), ruleThingId);
+}
+
+void TestEventQueue::prioritizeQueuedEvents()
+{
+    EventQueue queue(10);
+    connect(&queue, &EventQueue::eventReady, this, &TestEventQueue::onEventReady);
+    occupySlice(&queue);
+
+    queue.enqueue(Event(m_eventTypeId, m_thingId));
+    queue.enqueue(Event(m_eventTypeId, m_otherThingId));
+    queue.enqueue(Event(m_eventTypeId, m_thingId));
+    queue.enqueue(Event(m_eventTypeId, m_otherThingId));
+
+    // The events already queued for the thing move ahead, in their order
+    queue.onActionExecuted(Action(ActionTypeId::createActionTypeId(), m_otherThingId, Action::TriggeredByUser), Thing::ThingErrorNoError);
+    QCOMPARE(queue.statistics().value("prioritized").toInt(), 2);
+
+    QTRY_COMPARE(m_delivered.count(), 4);
+    QCOMPARE(m_delivered.at(0).thingId(), m_otherThingId);
+    QCOMPARE(m_delivered.at(1).thingId(), m_otherThingId);
+    QCOMPARE(m_delivered.at(2).thingId(), m_thingId);
+    QCOMPARE(m_delivered.at(3).thingId(), m_thingId);
+    QCOMPARE(queue.depth(), 0);
+}
+
+void TestEventQueue::coalesceStateChanges()
+{
+    EventQueue queue(10);
+    connect(&queue, &EventQueue::eventReady, this, &TestEventQueue::onEventReady);
+    occupySlice(&queue);
+
+    queue.enqueue(stateChangeEvent(m_thingId, m_stateTypeId, 1));
+    queue.enqueue(stateChangeEvent(m_thingId, m_otherStateTypeId, 10));
+    queue.enqueue(stateChangeEvent(m_thingId, m_stateTypeId, 2));
+    queue.enqueue(stateChangeEvent(m_otherThingId, m_stateTypeId, 20));
+    queue.enqueue(stateChangeEvent(m_thingId, m_stateTypeId, 3));
+    // Plain events are never superseded
+    queue.enqueue(Event(m_eventTypeId, m_thingId));
+    queue.enqueue(Event(m_eventTypeId, m_thingId));
+    QCOMPARE(queue.depth(), 5);
+    QCOMPARE(queue.statistics().value("coalesced").toInt(), 2);
+
+    QTRY_COMPARE(queue.depth(), 0);
+    QCOMPARE(m_delivered.count(), 5);
+    QCOMPARE(m_delivered.at(0).thingId(), m_thingId);
+    QCOMPARE(m_delivered.at(0).eventTypeId(), m_otherStateTypeId);
+    QCOMPARE(m_delivered.at(1).thingId(), m_otherThingId);
+    QCOMPARE(m_delivered.at(1).params().first().value().toInt(), 20);
+    // Only the latest value is delivered, in the place of the latest change
+    QCOMPARE(m_delivered.at(2).thingId(), m_thingId);
+    QCOMPARE(m_delivered.at(2).eventTypeId(), m_stateTypeId);
+    QCOMPARE(m_delivered.at(2).params().first().value().toInt(), 3);
+    QCOMPARE(m_delivered.at(3).eventTypeId(), m_eventTypeId);
+    QCOMPARE(m_delivered.at(4).eventTypeId(), m_eventTypeId);
+
+    // Once delivered, the next change of the state is queued again
+    queue.enqueue(stateChangeEvent(m_thingId, m_stateTypeId, 4));
+    QTRY_COMPARE(m_delivered.count(), 6);
+    QCOMPARE(m_delivered.last().params().first().value().toInt(), 4);
+    QCOMPARE(queue.statistics().value("coalesced").toInt(), 2);
+}
+
+void TestEventQueue::nestedEvents()
+{
+    EventQueue queue(10);
+    m_delivered.clear();
+
+    // Events caused by an event, e.g. by rule actions, are delivered right away, even with the slice used up
+    bool nested = false;
+    connect(&queue, &EventQueue::eventReady, this, [this, &queue, &nested](const Event &event){
+        m_delivered.append(event);
+        if (!nested) {
+            nested = true;
+            QTest::qSleep(20);
+            queue.enqueue(Event(m_eventTypeId, m_otherThingId));
+        }
+    });
+    queue.enqueue(Event(m_eventTypeId, m_thingId));
+    QCOMPARE(m_delivered.count(), 2);
+    QCOMPARE(m_delivered.last().thingId(), m_otherThingId);
+    QCOMPARE(queue.depth(), 0);
+}
+
+#include "testeventqueue.moc"
+QTEST_MAIN(TestEventQueue)
@@ -0,0 +1,6 @@
+TARGET = testexperiences
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testexperiences.cpp
@@ -0,0 +1,94 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+
+class TestExperiences: public NymeaTestBase
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void lazyExperience();
+
+private:
+    QVariantMap helloExperiences();
+    bool introspectContains(const QString &method);
+};
+
+void TestExperiences::initTestCase()
+{
+    // The mock experience plugin is built next to the tests
+    qputenv("NYMEA_EXPERIENCE_PLUGINS_PATH", QString(QCoreApplication::applicationDirPath() + "/../../tools/experiencepluginmock").toUtf8());
+    NymeaTestBase::initTestCase();
+}
+
+QVariantMap TestExperiences::helloExperiences()
+{
+    QVariantMap experiences;
+    QVariant response = injectAndWait("JSONRPC.Hello");
+    foreach (const QVariant &experience, response.toMap().value("params").toMap().value("experiences").toList()) {
+        experiences.insert(experience.toMap().value("name").toString(), experience.toMap().value("version"));
+    }
+    return experiences;
+}
+
+bool TestExperiences::introspectContains(const QString &method)
+{
+    QVariant response = injectAndWait("JSONRPC.Introspect");
+    return response.toMap().value("params").toMap().value("methods").toMap().contains(method);
+}
+
+void TestExperiences::lazyExperience()
+{
+    // Announced in the handshake, but not loaded yet
+    QVariantMap experiences = helloExperiences();
+    QVERIFY2(experiences.contains("ExperienceMock"), "The mock experience plugin has not been found");
+    QCOMPARE(experiences.value("ExperienceMock").toString(), QString("0.1"));
+    QVERIFY(!introspectContains("ExperienceMock.Ping"));
+
+    // The first call loads the plugin and is handled by it
+    QVariant response = injectAndWait("ExperienceMock.Ping");
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+    QCOMPARE(response.toMap().value("params").toMap().value("pings").toInt(), 1);
+
+    QVERIFY(introspectContains("ExperienceMock.Ping"));
+    experiences = helloExperiences();
+    QCOMPARE(experiences.value("ExperienceMock").toString(), QString("0.1"));
+
+    // Later calls go to the same handler without loading the plugin again
+    response = injectAndWait("ExperienceMock.Ping");
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+    QCOMPARE(response.toMap().value("params").toMap().value("pings").toInt(), 2);
+}
+
+#include "testexperiences.moc"
+QTEST_MAIN(TestExperiences)
@@ -0,0 +1,6 @@
+TARGET = testfederation
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testfederation.cpp
@@ -0,0 +1,394 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+#include "nymeacore.h"
+#include "nymeasettings.h"
+#include "servermanager.h"
+#include "integrations/thingmanagerimplementation.h"
+#include "federation/federationpeer.h"
+#include "federation/federationintegrationplugin.h"
+
+#include <QCryptographicHash>
+#include <QSslCertificate>
+
+using namespace nymeaserver;
+
+// A second nymea core can't run in this process, so the peers connect back to the core under test.
+// It plays the remote instance, the things it mirrors are the mock things created by NymeaTestBase.
+class TestFederation: public NymeaTestBase
+{
+    Q_OBJECT
+
+private:
+    quint16 m_port = 0;
+
+    QUrl peerUrl() const;
+    QByteArray certificateDigest() const;
+    void setMockState(const StateTypeId &stateTypeId, const QVariant &value);
+    void restartTcpServer();
+    Thing *findMirror(const PluginId &pluginId, const ThingId &remoteThingId) const;
+
+private slots:
+    void initTestCase();
+    void cleanup();
+
+    void trustOnFirstUse();
+    void pinnedCertificate();
+    void changedCertificate();
+
+    void fullSync();
+    void stateUpdates();
+    void deltaSyncAfterReconnect();
+    void fullSyncOutsideJournal();
+
+    void mirrorThings();
+};
+
+QUrl TestFederation::peerUrl() const
+{
+    return QUrl(QString("nymeas://127.0.0.1:%1").arg(m_port));
+}
+
+QByteArray TestFederation::certificateDigest() const
+{
+    return NymeaCore::instance()->serverManager()->sslConfiguration().localCertificate().digest(QCryptographicHash::Sha256).toHex();
+}
+
+void TestFederation::setMockState(const StateTypeId &stateTypeId, const QVariant &value)
+{
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(value.toString())));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    QVERIFY(spy.wait());
+}
+
+void TestFederation::restartTcpServer()
+{
+    // Applying the configuration again restarts the server, which drops all clients
+    ServerConfiguration config = NymeaCore::instance()->configuration()->tcpServerConfigurations().value("federationtest");
+    NymeaCore::instance()->configuration()->setTcpServerConfiguration(config);
+}
+
+Thing *TestFederation::findMirror(const PluginId &pluginId, const ThingId &remoteThingId) const
+{
+    foreach (Thing *thing, NymeaCore::instance()->thingManager()->configuredThings()) {
+        if (thing->pluginId() == pluginId && ThingId(thing->params().first().value().toString()) == remoteThingId) {
+            return thing;
+        }
+    }
+    return nullptr;
+}
+
+void TestFederation::initTestCase()
+{
+    NymeaTestBase::initTestCase();
+    qRegisterMetaType<ThingId>();
+    qRegisterMetaType<QList<ThingId>>();
+    qRegisterMetaType<QHash<StateTypeId, QVariant>>();
+    QLoggingCategory::setFilterRules("*.debug=false\n"
+                                     "Tests.debug=true\n"
+                                     "Federation.debug=true");
+
+    m_port = static_cast<quint16>(20000 + (qrand() % 10000));
+    ServerConfiguration config;
+    config.id = "federationtest";
+    config.address = QHostAddress("127.0.0.1");
+    config.port = m_port;
+    config.sslEnabled = true;
+    config.authenticationEnabled = true;
+    NymeaCore::instance()->configuration()->setTcpServerConfiguration(config);
+}
+
+void TestFederation::cleanup()
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.remove("FederationCertificates");
+
+    NymeaTestBase::cleanup();
+}
+
+void TestFederation::trustOnFirstUse()
+{
+    FederationPeer peer(peerUrl(), m_apiToken);
+    QSignalSpy identifiedSpy(&peer, &FederationPeer::identified);
+    peer.start();
+    QVERIFY(identifiedSpy.wait());
+
+    QCOMPARE(identifiedSpy.first().at(0).toUuid(), NymeaCore::instance()->configuration()->serverUuid());
+    QCOMPARE(identifiedSpy.first().at(1).toString(), NymeaCore::instance()->configuration()->serverName());
+    QVERIFY(peer.connected());
+
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("FederationCertificates");
+    QCOMPARE(settings.value(peerUrl().authority()).toByteArray(), certificateDigest());
+}
+
+void TestFederation::pinnedCertificate()
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("FederationCertificates");
+    settings.setValue(peerUrl().authority(), certificateDigest());
+    settings.endGroup();
+
+    FederationPeer peer(peerUrl(), m_apiToken);
+    QSignalSpy connectedSpy(&peer, &FederationPeer::connectedChanged);
+    peer.start();
+    QVERIFY(connectedSpy.wait());
+    QCOMPARE(connectedSpy.first().at(0).toBool(), true);
+}
+
+void TestFederation::changedCertificate()
+{
+    QByteArray otherDigest = QCryptographicHash::hash("another certificate", QCryptographicHash::Sha256).toHex();
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("FederationCertificates");
+    settings.setValue(peerUrl().authority(), otherDigest);
+    settings.endGroup();
+
+    FederationPeer peer(peerUrl(), m_apiToken);
+    QSignalSpy identifiedSpy(&peer, &FederationPeer::identified);
+    peer.start();
+
+    // Refused, also when trying again after a second
+    QVERIFY(!identifiedSpy.wait(3000));
+    QVERIFY(!peer.connected());
+    QVERIFY(peer.statistics().value("reconnects").toInt() > 0);
+
+    // The pin is kept, only the user may drop it
+    settings.beginGroup("FederationCertificates");
+    QCOMPARE(settings.value(peerUrl().authority()).toByteArray(), otherDigest);
+}
+
+void TestFederation::fullSync()
+{
+    FederationPeer peer(peerUrl(), m_apiToken);
+    QSignalSpy classesSpy(&peer, &FederationPeer::thingClassesReceived);
+    QSignalSpy syncedSpy(&peer, &FederationPeer::synced);
+    peer.start();
+    QVERIFY(syncedSpy.wait());
+
+    QVariantMap statistics = peer.statistics();
+    QCOMPARE(statistics.value("fullSyncs").toInt(), 1);
+    QCOMPARE(statistics.value("deltaSyncs").toInt(), 0);
+    QVERIFY(statistics.value("revision").toULongLong() > 0);
+    QCOMPARE(statistics.value("things").toInt(), NymeaCore::instance()->thingManager()->configuredThings().count());
+
+    Thing *mock = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    FederationPeer::RemoteThing remote = peer.thing(m_mockThingId);
+    QCOMPARE(remote.thingClassId, mockThingClassId);
+    QCOMPARE(remote.name, mock->name());
+    QCOMPARE(remote.states.value(mockIntStateTypeId), mock->stateValue(mockIntStateTypeId));
+
+    // None of the classes is known yet, so all of them are requested, each one once
+    QSet<QString> receivedIds;
+    foreach (const QList<QVariant> &arguments, classesSpy) {
+        foreach (const QVariant &thingClass, arguments.at(0).toList()) {
+            QString id = thingClass.toMap().value("id").toString();
+            QVERIFY2(!receivedIds.contains(id), "Thing class received twice");
+            receivedIds.insert(id);
+        }
+    }
+    QVERIFY(receivedIds.contains(mockThingClassId.toString()));
+
+    // Only things of known classes are announced
+    QVERIFY(syncedSpy.first().at(0).value<QList<ThingId>>().isEmpty());
+    peer.addKnownThingClasses({mockThingClassId});
+    QVERIFY(peer.thingIds().contains(m_mockThingId));
+}
+
+void TestFederation::stateUpdates()
+{
+    FederationPeer peer(peerUrl(), m_apiToken);
+    peer.addKnownThingClasses({mockThingClassId});
+    QSignalSpy syncedSpy(&peer, &FederationPeer::synced);
+    peer.start();
+    QVERIFY(syncedSpy.wait());
+    quint64 revision = peer.statistics().value("revision").toULongLong();
+
+    QSignalSpy statesSpy(&peer, &FederationPeer::statesChanged);
+    int value = peer.thing(m_mockThingId).states.value(mockIntStateTypeId).toInt() + 1;
+    setMockState(mockIntStateTypeId, value);
+    QTRY_VERIFY(!statesSpy.isEmpty());
+
+    QCOMPARE(statesSpy.first().at(0).value<ThingId>(), m_mockThingId);
+    QHash<StateTypeId, QVariant> values = statesSpy.first().at(1).value<QHash<StateTypeId, QVariant>>();
+    QCOMPARE(values.value(mockIntStateTypeId).toInt(), value);
+    QCOMPARE(peer.thing(m_mockThingId).states.value(mockIntStateTypeId).toInt(), value);
+
+    // Notifications don't move the revision, only syncs do
+    QCOMPARE(peer.statistics().value("revision").toULongLong(), revision);
+}
+
+void TestFederation::deltaSyncAfterReconnect()
+{
+    FederationPeer peer(peerUrl(), m_apiToken);
+    peer.addKnownThingClasses({mockThingClassId});
+    QSignalSpy syncedSpy(&peer, &FederationPeer::synced);
+    peer.start();
+    QVERIFY(syncedSpy.wait());
+    quint64 revision = peer.statistics().value("revision").toULongLong();
+
+    // Change a state while the peer is gone
+    QSignalSpy connectedSpy(&peer, &FederationPeer::connectedChanged);
+    restartTcpServer();
+    QTRY_VERIFY(!connectedSpy.isEmpty());
+    QCOMPARE(connectedSpy.takeFirst().at(0).toBool(), false);
+    int value = peer.thing(m_mockThingId).states.value(mockIntStateTypeId).toInt() + 1;
+    setMockState(mockIntStateTypeId, value);
+
+    QSignalSpy statesSpy(&peer, &FederationPeer::statesChanged);
+    QTRY_VERIFY_WITH_TIMEOUT(peer.connected(), 10000);
+    QTRY_COMPARE(peer.statistics().value("deltaSyncs").toInt(), 1);
+
+    QVariantMap statistics = peer.statistics();
+    QCOMPARE(statistics.value("fullSyncs").toInt(), 1);
+    QVERIFY(statistics.value("reconnects").toInt() >= 1);
+    QVERIFY(statistics.value("revision").toULongLong() > revision);
+
+    // Only the changed state is passed on, as a state change of the known thing
+    QCOMPARE(statesSpy.count(), 1);
+    QCOMPARE(statesSpy.first().at(0).value<ThingId>(), m_mockThingId);
+    QCOMPARE(statesSpy.first().at(1).value<QHash<StateTypeId, QVariant>>().value(mockIntStateTypeId).toInt(), value);
+    QCOMPARE(peer.thing(m_mockThingId).states.value(mockIntStateTypeId).toInt(), value);
+    QCOMPARE(syncedSpy.count(), 1);
+}
+
+void TestFederation::fullSyncOutsideJournal()
+{
+    // A revision the peer doesn't know, e.g. because it has been restarted in the meantime,
+    // is answered with all things
+    QVariantMap params;
+    params.insert("sinceRevision", 1);
+    QVariant response = injectAndWait("Integrations.GetChanges", params);
+    QVariantMap reply = response.toMap().value("params").toMap();
+    QCOMPARE(reply.value("full").toBool(), true);
+    QCOMPARE(reply.value("things").toList().count(), NymeaCore::instance()->thingManager()->configuredThings().count());
+
+    params.insert("sinceRevision", reply.value("revision"));
+    response = injectAndWait("Integrations.GetChanges", params);
+    reply = response.toMap().value("params").toMap();
+    QCOMPARE(reply.value("full").toBool(), false);
+    QVERIFY(reply.value("things").toList().isEmpty());
+    QVERIFY(reply.value("states").toList().isEmpty());
+    QVERIFY(reply.value("removedThingIds").toList().isEmpty());
+}
+
+void TestFederation::mirrorThings()
+{
+    FederationPeer *peer = new FederationPeer(peerUrl(), m_apiToken, this);
+    QSignalSpy classesSpy(peer, &FederationPeer::thingClassesReceived);
+    QSignalSpy syncedSpy(peer, &FederationPeer::synced);
+    peer->start();
+    QVERIFY(syncedSpy.wait());
+
+    QVariantList thingClasses;
+    foreach (const QList<QVariant> &arguments, classesSpy) {
+        foreach (const QVariant &thingClass, arguments.at(0).toList()) {
+            if (!FederationIntegrationPlugin::isMirroredThingClass(thingClass.toMap())) {
+                thingClasses.append(thingClass);
+            }
+        }
+    }
+
+    // The core mirrors itself, so the plugin gets an id of its own
+    QUuid peerUuid = QUuid::createUuid();
+    FederationIntegrationPlugin *plugin = new FederationIntegrationPlugin(peerUuid, "Test peer", thingClasses);
+    QVERIFY2(plugin->metadata().isValid(), plugin->metadata().validationErrors().join(", ").toUtf8().constData());
+    QVERIFY(plugin->remoteThingClassIds().contains(mockThingClassId));
+
+    ThingManagerImplementation *thingManager = static_cast<ThingManagerImplementation*>(NymeaCore::instance()->thingManager());
+    thingManager->registerStaticPlugin(plugin);
+    QCOMPARE(thingManager->plugin(FederationIntegrationPlugin::pluginIdForPeer(peerUuid)), static_cast<IntegrationPlugin*>(plugin));
+
+    // Mirrors appear as auto things with the id of the original as param
+    plugin->setPeer(peer);
+    plugin->startMonitoringAutoThings();
+    QTRY_VERIFY(findMirror(plugin->pluginId(), m_mockThingId));
+    Thing *mirror = findMirror(plugin->pluginId(), m_mockThingId);
+    Thing *mock = thingManager->findConfiguredThing(m_mockThingId);
+    QCOMPARE(mirror->name(), mock->name());
+    QCOMPARE(mirror->stateValue(mockIntStateTypeId), mock->stateValue(mockIntStateTypeId));
+
+    // States follow the original
+    int value = mock->stateValue(mockIntStateTypeId).toInt() + 1;
+    setMockState(mockIntStateTypeId, value);
+    QTRY_COMPARE(mirror->stateValue(mockIntStateTypeId).toInt(), value);
+
+    // Actions are executed on the original
+    bool power = !mock->stateValue(mockPowerStateTypeId).toBool();
+    QVariantMap param;
+    param.insert("paramTypeId", mockPowerStateTypeId.toString());
+    param.insert("value", power);
+    QVariantMap actionParams;
+    actionParams.insert("thingId", mirror->id().toString());
+    actionParams.insert("actionTypeId", mockPowerStateTypeId.toString());
+    actionParams.insert("params", QVariantList({param}));
+    QVariant response = injectAndWait("Integrations.ExecuteAction", actionParams);
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    QCOMPARE(mock->stateValue(mockPowerStateTypeId).toBool(), power);
+    QTRY_COMPARE(mirror->stateValue(mockPowerStateTypeId).toBool(), power);
+
+    // Things added on the peer are mirrored, things removed there are removed here
+    QVariantMap httpPortParam;
+    httpPortParam.insert("paramTypeId", mockThingHttpportParamTypeId.toString());
+    httpPortParam.insert("value", m_mockThing2Port);
+    QVariantMap params;
+    params.insert("name", "Federated mock");
+    params.insert("thingClassId", mockThingClassId.toString());
+    params.insert("thingParams", QVariantList({httpPortParam}));
+    response = injectAndWait("Integrations.AddThing", params);
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    ThingId addedThingId = ThingId(response.toMap().value("params").toMap().value("thingId").toString());
+    QTRY_VERIFY(findMirror(plugin->pluginId(), addedThingId));
+    QCOMPARE(findMirror(plugin->pluginId(), addedThingId)->name(), QString("Federated mock"));
+
+    response = injectAndWait("Integrations.RemoveThing", {{"thingId", addedThingId.toString()}});
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    QTRY_VERIFY(!findMirror(plugin->pluginId(), addedThingId));
+
+    // Without the peer, actions fail instead of waiting for it
+    peer->stop();
+    QTRY_VERIFY(!peer->connected());
+    response = injectAndWait("Integrations.ExecuteAction", actionParams);
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorHardwareNotAvailable));
+
+    // The mirror stays until the peer says otherwise
+    QVERIFY(findMirror(plugin->pluginId(), m_mockThingId));
+    response = injectAndWait("Integrations.RemoveThing", {{"thingId", mirror->id().toString()}});
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+
+    delete peer;
+}
+
+#include "testfederation.moc"
+QTEST_MAIN(TestFederation)
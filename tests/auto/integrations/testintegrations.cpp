@@ -34,10 +34,16 @@
 
 #include "integrations/thingdiscoveryinfo.h"
 #include "integrations/thingsetupinfo.h"
+#include "integrations/thingactioninfo.h"
+#include "integrations/timeoutwheel.h"
+#include "integrations/browsercache.h"
+#include "integrations/thingstatesnapshots.h"
 
 #include "servers/mocktcpserver.h"
 #include "jsonrpc/integrationshandler.h"
 
+#include <thread>
+
 using namespace nymeaserver;
 
 class TestIntegrations : public NymeaTestBase
@@ -79,6 +85,8 @@ private slots:
 
     void getThings();
 
+    void getChanges();
+
     void getThing_data();
     void getThing();
 
@@ -86,6 +94,7 @@ private slots:
 
     void discoverThings_data();
     void discoverThings();
+    void discoverThingsStreamed();
 
     void addPushButtonThings_data();
     void addPushButtonThings();
@@ -110,6 +119,8 @@ private slots:
     void getStateValues_data();
     void getStateValues();
 
+    void thingStateSnapshots();
+
     void editThings_data();
     void editThings();
 
@@ -136,6 +147,12 @@ private slots:
     void executeAction_data();
     void executeAction();
 
+    void coalesceActions();
+
+    void timeoutWheel();
+
+    void browserCache();
+
     void triggerEvent();
     void triggerStateChangeEvent();
 
@@ -294,8 +311,8 @@ void TestIntegrations::getThingClasses_data()
     QTest::addColumn<QList<ThingClassId>>("thingClassIds");
     QTest::addColumn<int>("resultCount");
 
-    QTest::newRow("vendor nymea") << nymeaVendorId << QList<ThingClassId>() << 17;
-    QTest::newRow("no filter") << VendorId() << QList<ThingClassId>() << 17;
+    QTest::newRow("vendor nymea") << nymeaVendorId << QList<ThingClassId>() << 18;
+    QTest::newRow("no filter") << VendorId() << QList<ThingClassId>() << 18;
     QTest::newRow("invalid vendor") << VendorId("93e7d361-8025-4354-b17e-b68406c800bc") << QList<ThingClassId>() << 0;
     QTest::newRow("mockThingClassId") << VendorId() << (QList<ThingClassId>() << mockThingClassId) << 1;
     QTest::newRow("invalid thingClassId") << VendorId() << (QList<ThingClassId>() << ThingClassId("6c78ec28-09b6-476d-ac27-1d6966a45c57")) << 0;
@@ -563,6 +580,72 @@ void TestIntegrations::getThings()
     QCOMPARE(things.count(), 3); // There should be: one auto created mock, one created in NymeaTestBase::initTestcase() and one created in TestIntegrations::initTestCase()
 }
 
+void TestIntegrations::getChanges()
+{
+    QVariant response = injectAndWait("Integrations.GetThings");
+    quint64 revision = response.toMap().value("params").toMap().value("revision").toULongLong();
+    QVERIFY(revision > 0);
+
+    // Nothing changed yet
+    QVariantMap params;
+    params.insert("sinceRevision", revision);
+    response = injectAndWait("Integrations.GetChanges", params);
+    QVariantMap changes = response.toMap().value("params").toMap();
+    QCOMPARE(changes.value("full").toBool(), false);
+    QCOMPARE(changes.value("revision").toULongLong(), revision);
+    QCOMPARE(changes.value("things").toList().count(), 0);
+    QCOMPARE(changes.value("states").toList().count(), 0);
+
+    // Change a state
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QSignalSpy stateSpy(NymeaCore::instance(), &NymeaCore::thingStateChanged);
+    QNetworkAccessManager nam;
+    int port = thing->paramValue(mockThingHttpportParamTypeId).toInt();
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(port).arg(mockIntStateTypeId.toString()).arg(77)));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
+    stateSpy.wait();
+    QVERIFY(stateSpy.count() > 0);
+
+    response = injectAndWait("Integrations.GetChanges", params);
+    changes = response.toMap().value("params").toMap();
+    QCOMPARE(changes.value("full").toBool(), false);
+    QVERIFY(changes.value("revision").toULongLong() > revision);
+    QCOMPARE(changes.value("things").toList().count(), 0);
+    bool found = false;
+    foreach (const QVariant &state, changes.value("states").toList()) {
+        if (state.toMap().value("stateTypeId").toUuid() == mockIntStateTypeId) {
+            QCOMPARE(state.toMap().value("thingId").toUuid(), QUuid(m_mockThingId));
+            QCOMPARE(state.toMap().value("value").toInt(), 77);
+            found = true;
+        }
+    }
+    QVERIFY2(found, "State change not contained in GetChanges");
+
+    // GetThings packed the thing before the change, it must have the new value now
+    response = injectAndWait("Integrations.GetThings");
+    found = false;
+    foreach (const QVariant &thingVariant, response.toMap().value("params").toMap().value("things").toList()) {
+        if (thingVariant.toMap().value("id").toUuid() != m_mockThingId) {
+            continue;
+        }
+        foreach (const QVariant &state, thingVariant.toMap().value("states").toList()) {
+            if (state.toMap().value("stateTypeId").toUuid() == mockIntStateTypeId) {
+                QCOMPARE(state.toMap().value("value").toInt(), 77);
+                found = true;
+            }
+        }
+    }
+    QVERIFY2(found, "State change not contained in GetThings");
+
+    // Unknown revisions fall back to a full snapshot
+    params.insert("sinceRevision", 1);
+    response = injectAndWait("Integrations.GetChanges", params);
+    changes = response.toMap().value("params").toMap();
+    QCOMPARE(changes.value("full").toBool(), true);
+    QCOMPARE(changes.value("things").toList().count(), NymeaCore::instance()->thingManager()->configuredThings().count());
+}
+
 void TestIntegrations::getThing_data()
 {
     QTest::addColumn<ThingId>("thingId");
@@ -705,6 +788,31 @@ void TestIntegrations::discoverThings()
     }
 }
 
+void TestIntegrations::discoverThingsStreamed()
+{
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    QVariantMap params;
+    params.insert("thingClassId", mockThingClassId);
+    params.insert("streamResults", true);
+    QVariant response = injectAndWait("Integrations.DiscoverThings", params);
+    verifyThingError(response);
+
+    // The mock finds the first thing twice, the duplicate is dropped
+    QVariantList descriptors = response.toMap().value("params").toMap().value("thingDescriptors").toList();
+    QCOMPARE(descriptors.count(), 2);
+
+    QVariantList notifications = checkNotifications(clientSpy, "Integrations.DiscoveryResultsAdded");
+    QVariantList streamedDescriptors;
+    foreach (const QVariant &notification, notifications) {
+        QVariantMap notificationParams = notification.toMap().value("params").toMap();
+        QCOMPARE(notificationParams.value("thingClassId").toUuid(), QUuid(mockThingClassId));
+        streamedDescriptors.append(notificationParams.value("thingDescriptors").toList());
+    }
+    QCOMPARE(streamedDescriptors.count(), 2);
+    QCOMPARE(streamedDescriptors.first().toMap().value("id"), descriptors.first().toMap().value("id"));
+}
+
 void TestIntegrations::addPushButtonThings_data()
 {
     QTest::addColumn<ThingClassId>("thingClassId");
@@ -1052,6 +1160,48 @@ void TestIntegrations::getStateValues()
     }
 }
 
+void TestIntegrations::thingStateSnapshots()
+{
+    ThingStateSnapshots *snapshots = NymeaCore::instance()->thingStateSnapshots();
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    int originalValue = thing->stateValue(mockIntStateTypeId).toInt();
+    ThingStateSnapshotPtr before = snapshots->current();
+    QVERIFY(before->contains(m_mockThingId));
+    QCOMPARE(before->stateValue(m_mockThingId, mockIntStateTypeId).toInt(), originalValue);
+
+    QSignalSpy stateSpy(NymeaCore::instance(), &NymeaCore::thingStateChanged);
+    QNetworkAccessManager nam;
+    int port = thing->paramValue(mockThingHttpportParamTypeId).toInt();
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(port).arg(mockIntStateTypeId.toString()).arg(originalValue + 1)));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
+    QVERIFY(stateSpy.wait());
+
+    // Published once control returns to the event loop, earlier snapshots don't change
+    QTRY_COMPARE(snapshots->current()->stateValue(m_mockThingId, mockIntStateTypeId).toInt(), originalValue + 1);
+    QVERIFY(snapshots->current()->epoch() > before->epoch());
+    QCOMPARE(before->stateValue(m_mockThingId, mockIntStateTypeId).toInt(), originalValue);
+
+    // Readers in other threads don't need the core thread
+    QVariant value;
+    ThingId thingId = m_mockThingId;
+    std::thread reader([snapshots, thingId, &value](){
+        value = snapshots->current()->stateValue(thingId, mockIntStateTypeId);
+    });
+    reader.join();
+    QCOMPARE(value.toInt(), originalValue + 1);
+
+    bool found = true;
+    snapshots->current()->stateValue(ThingId::createThingId(), mockIntStateTypeId, &found);
+    QVERIFY(!found);
+
+    stateSpy.clear();
+    request.setUrl(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(port).arg(mockIntStateTypeId.toString()).arg(originalValue)));
+    reply = nam.get(request);
+    connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
+    QVERIFY(stateSpy.wait());
+}
+
 void TestIntegrations::editThings_data()
 {
     QTest::addColumn<QString>("name");
@@ -1082,6 +1232,9 @@ void TestIntegrations::editThings()
     verifyThingError(response);
     ThingId thingId = ThingId(response.toMap().value("params").toMap().value("thingId").toString());
 
+    // Have the thing packed with its original name once
+    injectAndWait("Integrations.GetThings");
+
     // edit thing
     params.clear();
     params.insert("thingId", thingId);
@@ -2029,6 +2182,94 @@ void TestIntegrations::executeAction()
 
 }
 
+void TestIntegrations::coalesceActions()
+{
+    // The battery level action is coalesced. The first one is in flight until its reply is delivered,
+    // the second one waits for it and gets replaced by the third one.
+    QHash<int, Thing::ThingError> results;
+    for (int level = 10; level <= 30; level += 10) {
+        Action action(mockBatteryLevelActionTypeId, m_mockThingId);
+        action.setParams(ParamList() << Param(mockBatteryLevelActionBatteryLevelParamTypeId, level));
+        ThingActionInfo *info = NymeaCore::instance()->thingManager()->executeAction(action);
+        connect(info, &ThingActionInfo::finished, this, [info, level, &results](){
+            results.insert(level, info->status());
+        });
+    }
+
+    QTRY_COMPARE(results.count(), 3);
+    QCOMPARE(results.value(10), Thing::ThingErrorNoError);
+    QCOMPARE(results.value(20), Thing::ThingErrorActionSuperseded);
+    QCOMPARE(results.value(30), Thing::ThingErrorNoError);
+
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QCOMPARE(thing->stateValue(mockBatteryLevelStateTypeId).toInt(), 30);
+}
+
+void TestIntegrations::timeoutWheel()
+{
+    // A small wheel, so the longest timeout has to wait for several rounds
+    TimeoutWheel wheel(10, 8);
+    QObject shortTimeout, cancelledTimeout, longTimeout;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    QHash<QString, qint64> fired;
+    wheel.schedule(&shortTimeout, 30, [&](){ fired.insert("short", elapsed.elapsed()); });
+    wheel.schedule(&cancelledTimeout, 50, [&](){ fired.insert("cancelled", elapsed.elapsed()); });
+    wheel.schedule(&longTimeout, 250, [&](){ fired.insert("long", elapsed.elapsed()); });
+    QCOMPARE(wheel.count(), 3);
+
+    wheel.cancel(&cancelledTimeout);
+    QCOMPARE(wheel.count(), 2);
+
+    QTRY_COMPARE(wheel.count(), 0);
+    QCOMPARE(fired.count(), 2);
+    QVERIFY(!fired.contains("cancelled"));
+    QVERIFY2(fired.value("short") >= 30, "Timeouts must not fire early");
+    QVERIFY2(fired.value("long") >= 250, "Timeouts must not fire early");
+}
+
+void TestIntegrations::browserCache()
+{
+    BrowserCache cache(3);
+    ThingId thingId = ThingId::createThingId();
+    QLocale english("en_US");
+    QLocale german("de_DE");
+    BrowserItems items;
+    items.append(BrowserItem("001", "Folder", true));
+    items.append(BrowserItem("002", "File", false, true));
+
+    BrowserItems cached;
+    QVERIFY(!cache.lookup(BrowserCache::KindItems, thingId, QString(), english, &cached));
+
+    cache.insert(BrowserCache::KindItems, thingId, QString(), english, items, 0);
+    QVERIFY2(!cache.contains(BrowserCache::KindItems, thingId, QString(), english), "Results without cache timeout must not be cached");
+
+    cache.insert(BrowserCache::KindItems, thingId, QString(), english, items, 60);
+    QVERIFY(cache.lookup(BrowserCache::KindItems, thingId, QString(), english, &cached));
+    QCOMPARE(cached.count(), 2);
+    QVERIFY(!cache.contains(BrowserCache::KindItems, thingId, QString(), german));
+    QVERIFY(!cache.contains(BrowserCache::KindDetails, thingId, QString(), english));
+
+    // Invalidating an item drops its listing and details in all locales, but nothing else
+    cache.insert(BrowserCache::KindItems, thingId, "001", english, items, 60);
+    cache.insert(BrowserCache::KindDetails, thingId, "001", german, BrowserItems() << items.first(), 60);
+    QCOMPARE(cache.count(), 3);
+    cache.invalidate(thingId, "001");
+    QCOMPARE(cache.count(), 1);
+    QVERIFY(cache.contains(BrowserCache::KindItems, thingId, QString(), english));
+
+    // When full, the entries expiring next make room
+    cache.insert(BrowserCache::KindItems, thingId, "001", english, items, 10);
+    cache.insert(BrowserCache::KindItems, thingId, "002", english, items, 120);
+    cache.insert(BrowserCache::KindItems, thingId, "003", english, items, 120);
+    QCOMPARE(cache.count(), 3);
+    QVERIFY(!cache.contains(BrowserCache::KindItems, thingId, "001", english));
+    QVERIFY(cache.contains(BrowserCache::KindItems, thingId, "003", english));
+
+    cache.invalidate(thingId);
+    QCOMPARE(cache.count(), 0);
+}
+
 void TestIntegrations::triggerEvent()
 {
     enableNotifications({"Integrations"});
@@ -35,6 +35,12 @@
 #include "servers/mocktcpserver.h"
 #include "usermanager/usermanager.h"
 #include "nymeadbusservice.h"
+#include "jsonrpc/jsonwriter.h"
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+#include <QCborValue>
+#include <QCborMap>
+#endif
 
 using namespace nymeaserver;
 
@@ -58,6 +64,11 @@ private slots:
 
     void testHandshakeLocale();
 
+    void testHandshakeEncoding();
+    void testHandshakeCompression();
+
+    void batchRequest();
+
     void testInitialSetup();
 
     void testRevokeToken();
@@ -66,6 +77,11 @@ private slots:
     void testBasicCall();
 
     void introspect();
+    void introspectCacheHash();
+
+    void performanceCounters();
+
+    void startupReport();
 
     void enableDisableNotifications_legacy_data();
     void enableDisableNotifications_legacy();
@@ -76,6 +92,10 @@ private slots:
 
     void stateChangeEmitsNotifications();
 
+    void stateFilterLimitsNotifications();
+
+    void stateChangesCoalesced();
+
     void pluginConfigChangeEmitsNotification();
 
     /*
@@ -118,6 +138,8 @@ private slots:
 
     void testGarbageData();
 
+    void testJsonWriter();
+
 private:
     QStringList extractRefs(const QVariant &variant);
 
@@ -234,6 +256,133 @@ void TestJSONRPC::testHandshakeLocale()
     QVERIFY(found);
 }
 
+void TestJSONRPC::testHandshakeEncoding()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5,12,0)
+    QSKIP("CBOR requires Qt 5.12");
+#else
+    QUuid newClientId = QUuid::createUuid();
+    m_mockTcpServer->clientConnected(newClientId);
+    qApp->processEvents();
+
+    // The reply to Hello is still JSON
+    QVariantMap params;
+    params.insert("encoding", "EncodingCbor");
+    QVariantMap handShake = injectAndWait("JSONRPC.Hello", params, newClientId).toMap();
+    QCOMPARE(handShake.value("status").toString(), QString("success"));
+    QCOMPARE(handShake.value("params").toMap().value("encoding").toString(), QString("EncodingCbor"));
+
+    // From now on, both directions use CBOR
+    QSignalSpy spy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+    QCborMap call;
+    call.insert(QString("id"), 42);
+    call.insert(QString("method"), QString("JSONRPC.Version"));
+    call.insert(QString("token"), QString::fromUtf8(m_apiToken));
+    QByteArray data = call.toCborValue().toCbor();
+
+    // Fragmented data must be reassembled
+    m_mockTcpServer->injectData(newClientId, data.left(5));
+    m_mockTcpServer->injectData(newClientId, data.mid(5));
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.first().at(0).toUuid(), newClientId);
+
+    QCborParserError error;
+    QVariantMap response = QCborValue::fromCbor(spy.first().at(1).toByteArray(), &error).toVariant().toMap();
+    QCOMPARE(error.error, QCborError::NoError);
+    QCOMPARE(response.value("id").toInt(), 42);
+    QCOMPARE(response.value("status").toString(), QString("success"));
+    QCOMPARE(response.value("params").toMap().value("version").toString(), QString(NYMEA_VERSION_STRING));
+
+    emit m_mockTcpServer->clientDisconnected(newClientId);
+#endif
+}
+
+void TestJSONRPC::batchRequest()
+{
+    QVariantList calls;
+    QVariantMap call;
+    call.insert("id", 1);
+    call.insert("method", "JSONRPC.Version");
+    call.insert("token", m_apiToken);
+    calls.append(call);
+    call.insert("id", 2);
+    call.insert("method", "Integrations.GetThings");
+    calls.append(call);
+    call.insert("id", 3);
+    call.insert("method", "JSONRPC.NoSuchMethod");
+    calls.append(call);
+
+    QSignalSpy spy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+    m_mockTcpServer->injectData(m_clientId, QJsonDocument::fromVariant(calls).toJson(QJsonDocument::Compact) + '\n');
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+
+    // All replies come back in one message
+    QCOMPARE(spy.count(), 1);
+    QJsonParseError error;
+    QJsonDocument jsonDoc = QJsonDocument::fromJson(spy.first().at(1).toByteArray(), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QVERIFY2(jsonDoc.isArray(), "Batch reply should be an array");
+
+    QHash<int, QVariantMap> replies;
+    foreach (const QVariant &reply, jsonDoc.toVariant().toList()) {
+        replies.insert(reply.toMap().value("id").toInt(), reply.toMap());
+    }
+    QCOMPARE(replies.count(), 3);
+    QCOMPARE(replies.value(1).value("status").toString(), QString("success"));
+    QCOMPARE(replies.value(1).value("params").toMap().value("version").toString(), QString(NYMEA_VERSION_STRING));
+    QCOMPARE(replies.value(2).value("status").toString(), QString("success"));
+    QCOMPARE(replies.value(3).value("status").toString(), QString("error"));
+}
+
+void TestJSONRPC::testHandshakeCompression()
+{
+    QUuid newClientId = QUuid::createUuid();
+    m_mockTcpServer->clientConnected(newClientId);
+    qApp->processEvents();
+
+    QVariantMap params;
+    params.insert("compression", "CompressionZlib");
+    QVariantMap handShake = injectAndWait("JSONRPC.Hello", params, newClientId).toMap();
+    QCOMPARE(handShake.value("status").toString(), QString("success"));
+    QCOMPARE(handShake.value("params").toMap().value("compression").toString(), QString("CompressionZlib"));
+
+    QSignalSpy spy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    // Small replies are not compressed
+    m_mockTcpServer->injectData(newClientId, "{\"id\": 1, \"method\": \"JSONRPC.KeepAlive\", \"params\": {\"sessionId\": \"test\"}, \"token\": \"" + m_apiToken + "\"}\n");
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(spy.first().at(1).toByteArray().startsWith('{'));
+
+    // The introspection is large enough
+    spy.clear();
+    m_mockTcpServer->injectData(newClientId, "{\"id\": 2, \"method\": \"JSONRPC.Introspect\", \"token\": \"" + m_apiToken + "\"}\n");
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    QByteArray frame = spy.first().at(1).toByteArray();
+    QCOMPARE(frame.at(0), '\0');
+    quint32 size = (static_cast<quint8>(frame.at(1)) << 24) | (static_cast<quint8>(frame.at(2)) << 16) | (static_cast<quint8>(frame.at(3)) << 8) | static_cast<quint8>(frame.at(4));
+    QCOMPARE(static_cast<int>(size), frame.size() - 5);
+
+    QJsonParseError error;
+    QVariantMap response = QJsonDocument::fromJson(qUncompress(frame.mid(5)), &error).toVariant().toMap();
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(response.value("id").toInt(), 2);
+    QCOMPARE(response.value("status").toString(), QString("success"));
+    QVERIFY(response.value("params").toMap().contains("methods"));
+
+    emit m_mockTcpServer->clientDisconnected(newClientId);
+}
+
 void TestJSONRPC::testInitialSetup()
 {
     foreach (const QString &user, NymeaCore::instance()->userManager()->users()) {
@@ -652,6 +801,53 @@ void TestJSONRPC::introspect()
     }
 }
 
+void TestJSONRPC::introspectCacheHash()
+{
+    QVariantMap handShake = injectAndWait("JSONRPC.Hello").toMap();
+    QString hash;
+    foreach (const QVariant &cacheHashVariant, handShake.value("params").toMap().value("cacheHashes").toList()) {
+        if (cacheHashVariant.toMap().value("method").toString() == "JSONRPC.Introspect") {
+            hash = cacheHashVariant.toMap().value("hash").toString();
+        }
+    }
+    QVERIFY2(!hash.isEmpty(), "Hello should announce a cache hash for JSONRPC.Introspect");
+
+    // The second reply comes from the cache
+    QVariantMap first = injectAndWait("JSONRPC.Introspect").toMap();
+    QVariantMap second = injectAndWait("JSONRPC.Introspect").toMap();
+    QCOMPARE(first.value("status").toString(), QString("success"));
+    QCOMPARE(first.value("params"), second.value("params"));
+}
+
+void TestJSONRPC::performanceCounters()
+{
+    injectAndWait("JSONRPC.Version");
+
+    QVariantMap response = injectAndWait("System.GetPerformanceCounters").toMap();
+    QCOMPARE(response.value("status").toString(), QString("success"));
+    QVariantMap counters = response.value("params").toMap();
+
+    QVariantMap parse = counters.value("stages").toMap().value("parse").toMap();
+    QVERIFY2(parse.value("count").toInt() > 0, "Parsing the previous calls should have been counted");
+    QVERIFY(parse.value("p50Us").toULongLong() <= parse.value("maxUs").toULongLong());
+
+    QVariantMap version = counters.value("methods").toMap().value("JSONRPC.Version").toMap();
+    QVERIFY2(version.value("count").toInt() > 0, "JSONRPC.Version should have been counted");
+    QCOMPARE(version.value("timeouts").toInt(), 0);
+}
+
+void TestJSONRPC::startupReport()
+{
+    QVariantMap response = injectAndWait("System.GetStartupReport").toMap();
+    QCOMPARE(response.value("status").toString(), QString("success"));
+    QVariantMap report = response.value("params").toMap();
+
+    QVERIFY2(report.value("finished").toBool(), "The mock things should have been set up by now");
+    QVERIFY(report.value("phases").toMap().contains("Thing manager"));
+    QVERIFY2(report.value("plugins").toMap().count() > 0, "Loading the mock plugins should have been traced");
+    QVERIFY(QFile::exists(report.value("traceFile").toString()));
+}
+
 void TestJSONRPC::enableDisableNotifications_legacy_data()
 {
     QTest::addColumn<QString>("enabled");
@@ -970,6 +1166,103 @@ void TestJSONRPC::stateChangeEmitsNotifications()
     QCOMPARE(response.toMap().value("params").toMap().value("value").toInt(), newVal);
 }
 
+void TestJSONRPC::stateFilterLimitsNotifications()
+{
+    enableNotifications({"Integrations"});
+
+    QNetworkAccessManager nam;
+    QUuid stateTypeId("80baec19-54de-4948-ac46-31eabfaceb83");
+
+    // Only interested in another state of the mock
+    QVariantMap params;
+    params.insert("thingIds", QVariantList() << m_mockThingId.toString());
+    params.insert("stateTypeIds", QVariantList() << QUuid::createUuid().toString());
+    QVariant response = injectAndWait("JSONRPC.SetStateFilter", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("thingIds").toList().count(), 1);
+
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(23)));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    clientSpy.wait(500);
+    QVERIFY2(checkNotifications(clientSpy, "Integrations.StateChanged").isEmpty(), "Got a filtered Integrations.StateChanged notification.");
+
+    // Now the thing matches and any state is accepted
+    params.clear();
+    params.insert("thingIds", QVariantList() << m_mockThingId.toString());
+    response = injectAndWait("JSONRPC.SetStateFilter", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("stateTypeIds").toList().count(), 0);
+
+    clientSpy.clear();
+    request.setUrl(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(24)));
+    reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    while (checkNotifications(clientSpy, "Integrations.StateChanged").isEmpty() && clientSpy.wait()) { }
+    QVariantList stateChangedVariants = checkNotifications(clientSpy, "Integrations.StateChanged");
+    QVERIFY2(!stateChangedVariants.isEmpty(), "Did not get Integrations.StateChanged notification.");
+    QCOMPARE(stateChangedVariants.first().toMap().value("params").toMap().value("thingId").toUuid(), QUuid(m_mockThingId));
+
+    // Remove the filter again
+    response = injectAndWait("JSONRPC.SetStateFilter", QVariantMap());
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+    QCOMPARE(response.toMap().value("params").toMap().value("thingIds").toList().count(), 0);
+
+    QCOMPARE(disableNotifications(), true);
+}
+
+void TestJSONRPC::stateChangesCoalesced()
+{
+    enableNotifications({"Integrations"});
+
+    QNetworkAccessManager nam;
+    QUuid stateTypeId("80baec19-54de-4948-ac46-31eabfaceb83");
+
+    QVariantMap params;
+    params.insert("interval", 500);
+    QVariant response = injectAndWait("JSONRPC.SetNotificationInterval", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("interval").toInt(), 500);
+
+    // Multiple changes within the interval end up in one notification with the latest value
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+    for (int i = 60; i <= 62; i++) {
+        QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(i)));
+        QNetworkReply *reply = nam.get(request);
+        QSignalSpy replySpy(reply, SIGNAL(finished()));
+        replySpy.wait();
+        reply->deleteLater();
+    }
+    while (checkNotifications(clientSpy, "Integrations.StateChanged").isEmpty() && clientSpy.wait()) { }
+    QTest::qWait(600);
+    QVariantList stateChangedVariants;
+    foreach (const QVariant &notification, checkNotifications(clientSpy, "Integrations.StateChanged")) {
+        if (notification.toMap().value("params").toMap().value("stateTypeId").toUuid() == stateTypeId) {
+            stateChangedVariants.append(notification);
+        }
+    }
+    QCOMPARE(stateChangedVariants.count(), 1);
+    QCOMPARE(stateChangedVariants.first().toMap().value("params").toMap().value("value").toInt(), 62);
+
+    params.insert("interval", 0);
+    injectAndWait("JSONRPC.SetNotificationInterval", params);
+
+    // A lagging client is switched to coalescing until it catches up
+    m_mockTcpServer->setPendingBytes(m_clientId, 1024 * 1024);
+    clientSpy.clear();
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(63)));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    clientSpy.wait(500);
+    QVERIFY2(checkNotifications(clientSpy, "Integrations.StateChanged").isEmpty(), "Lagging client got a state change right away.");
+
+    m_mockTcpServer->setPendingBytes(m_clientId, 0);
+    while (checkNotifications(clientSpy, "Integrations.StateChanged").isEmpty() && clientSpy.wait()) { }
+    stateChangedVariants = checkNotifications(clientSpy, "Integrations.StateChanged");
+    QVERIFY2(!stateChangedVariants.isEmpty(), "Did not get Integrations.StateChanged notification after catching up.");
+    QCOMPARE(stateChangedVariants.last().toMap().value("params").toMap().value("value").toInt(), 63);
+
+    QCOMPARE(disableNotifications(), true);
+}
+
 void TestJSONRPC::pluginConfigChangeEmitsNotification()
 {
     QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
@@ -1302,6 +1595,11 @@ void TestJSONRPC::testDataFragmentation_data()
     packets.append("C.Hello\"}\n");
     QTest::newRow("3 packets") << packets;
 
+    packets.clear();
+    packets.append("{\"id\": 555, \"method\": \"JSONRPC.Hello\", \"params\": {\"locale\": \"en_US\"}");
+    packets.append("}");
+    QTest::newRow("split after nested object") << packets;
+
     packets.clear();
     packets.append("{\"id\": 555, \"method\": \"JSONRPC.Hello\"}\n{\"id\": 5556, \"metho");
     QTest::newRow("next packet start appended") << packets;
@@ -1340,6 +1638,54 @@ void TestJSONRPC::testGarbageData()
     QCOMPARE(spy.count(), 1);
 }
 
+void TestJSONRPC::testJsonWriter()
+{
+    QVariantMap nested;
+    nested.insert("empty", QVariantList());
+    nested.insert("strings", QStringList() << "a" << "b");
+    nested.insert("uuid", QUuid::createUuid());
+
+    QVariantMap message;
+    message.insert("escapes", QString("quote \" backslash \\ newline \n tab \t bell \a"));
+    message.insert("unicode", QString::fromUtf8("Gr\xc3\xbc\xc3\x9f" "e \xe2\x82\xac"));
+    message.insert("int", -42);
+    message.insert("uint", 42u);
+    message.insert("double", 0.1);
+    message.insert("bool", true);
+    message.insert("null", QVariant());
+    message.insert("list", QVariantList() << 1 << "two" << nested);
+    message.insert("nested", nested);
+
+    // Same document as QJsonDocument writes it
+    QByteArray json = JsonWriter::toJson(message);
+    QJsonParseError error;
+    QJsonDocument jsonDoc = QJsonDocument::fromJson(json, &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(jsonDoc, QJsonDocument::fromVariant(message));
+
+    // Fragments are embedded as they are
+    message.insert("fragment", QVariant::fromValue(JsonFragment(JsonWriter::toJson(nested))));
+    jsonDoc = QJsonDocument::fromJson(JsonWriter::toJson(message), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(jsonDoc.toVariant().toMap().value("fragment"), QJsonDocument::fromVariant(nested).toVariant());
+    QCOMPARE(JsonWriter::resolveFragments(message).toMap().value("fragment"), QJsonDocument::fromVariant(nested).toVariant());
+
+    // Tokens written one by one
+    QByteArray tokens;
+    JsonWriter writer(&tokens);
+    writer.beginObject();
+    writer.writeKey("a");
+    writer.beginArray();
+    writer.writeInteger(1);
+    writer.writeDouble(qQNaN());
+    writer.writeString("x");
+    writer.endArray();
+    writer.writeKey("b");
+    writer.writeBool(false);
+    writer.endObject();
+    QCOMPARE(tokens, QByteArray("{\"a\":[1,null,\"x\"],\"b\":false}"));
+}
+
 #include "testjsonrpc.moc"
 
 QTEST_MAIN(TestJSONRPC)
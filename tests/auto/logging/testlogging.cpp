@@ -31,6 +31,7 @@
 #include "nymeatestbase.h"
 #include "nymeacore.h"
 #include "nymeasettings.h"
+#include "nymeaconfiguration.h"
 #include "logging/logvaluetool.h"
 #include "servers/mocktcpserver.h"
 
@@ -84,6 +85,10 @@ private slots:
 
     void testLimits();
 
+    void logEntrySamples();
+    void stateRateLimit();
+    void stateHistory();
+
     // this has to be the last test
     void removeThing();
 };
@@ -741,6 +746,164 @@ void TestLogging::testLimits()
     response = injectAndWait("Logging.GetLogEntries", params).toMap();
     QCOMPARE(response.value("params").toMap().value("count").toInt(), 10);
     QCOMPARE(response.value("params").toMap().value("logEntries").toList().count(), 10);
+
+    // Page through all entries using the cursor, should return 20, 20 and 10 entries
+    QList<int> pageSizes;
+    qlonglong lastTimestamp = QDateTime::currentDateTime().addSecs(1).toMSecsSinceEpoch();
+    params.clear();
+    params.insert("limit", 20);
+    do {
+        response = injectAndWait("Logging.GetLogEntries", params).toMap();
+        verifyLoggingError(response);
+        QVariantList entries = response.value("params").toMap().value("logEntries").toList();
+        pageSizes.append(entries.count());
+        foreach (const QVariant &entry, entries) {
+            QVERIFY(entry.toMap().value("timestamp").toLongLong() <= lastTimestamp);
+            lastTimestamp = entry.toMap().value("timestamp").toLongLong();
+        }
+        params.insert("cursor", response.value("params").toMap().value("nextCursor"));
+    } while (response.value("params").toMap().contains("nextCursor") && pageSizes.count() < 10);
+    QCOMPARE(pageSizes, QList<int>() << 20 << 20 << 10);
+
+    // Invalid cursor
+    params.clear();
+    params.insert("limit", 20);
+    params.insert("cursor", "foobar");
+    response = injectAndWait("Logging.GetLogEntries", params).toMap();
+    verifyLoggingError(response, Logging::LoggingErrorInvalidFilterParameter);
+}
+
+void TestLogging::logEntrySamples()
+{
+    clearLoggingDatabase();
+    waitForDBSync();
+
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QVERIFY2(thing, "There needs to be a configured mock thing for this test");
+    int port = thing->paramValue(mockThingHttpportParamTypeId).toInt();
+
+    QDateTime startDate = QDateTime::currentDateTime().addSecs(-1);
+
+    QNetworkAccessManager nam;
+    foreach (int value, QList<int>() << 11 << 33 << 22) {
+        QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(port).arg(mockIntStateTypeId.toString()).arg(value)));
+        QNetworkReply *reply = nam.get(request);
+        QSignalSpy finishedSpy(reply, &QNetworkReply::finished);
+        finishedSpy.wait();
+        reply->deleteLater();
+    }
+    waitForDBSync();
+
+    QVariantMap params;
+    params.insert("thingId", m_mockThingId);
+    params.insert("stateTypeId", mockIntStateTypeId);
+    params.insert("startDate", startDate.toTime_t());
+    params.insert("endDate", QDateTime::currentDateTime().addSecs(1).toTime_t());
+    params.insert("sampleCount", 1);
+    QVariant response = injectAndWait("Logging.GetLogEntrySamples", params);
+    verifyLoggingError(response);
+
+    QVariantList samples = response.toMap().value("params").toMap().value("logEntrySamples").toList();
+    QCOMPARE(samples.count(), 1);
+    QVariantMap sample = samples.first().toMap();
+    QCOMPARE(sample.value("count").toInt(), 3);
+    QCOMPARE(sample.value("min").toDouble(), 11.0);
+    QCOMPARE(sample.value("max").toDouble(), 33.0);
+    QCOMPARE(sample.value("avg").toDouble(), 22.0);
+    QCOMPARE(sample.value("last").toInt(), 22);
+
+    // Non numeric states can't be sampled
+    params.insert("stateTypeId", mockBoolStateTypeId);
+    response = injectAndWait("Logging.GetLogEntrySamples", params);
+    verifyLoggingError(response, Logging::LoggingErrorInvalidFilterParameter);
+
+    // Invalid sample count
+    params.insert("stateTypeId", mockIntStateTypeId);
+    params.insert("sampleCount", 0);
+    response = injectAndWait("Logging.GetLogEntrySamples", params);
+    verifyLoggingError(response, Logging::LoggingErrorInvalidFilterParameter);
+}
+
+void TestLogging::stateRateLimit()
+{
+    clearLoggingDatabase();
+    waitForDBSync();
+
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QVERIFY2(thing, "There needs to be a configured mock thing for this test");
+    int port = thing->paramValue(mockThingHttpportParamTypeId).toInt();
+
+    NymeaCore::instance()->logEngine()->setStateRateLimit(m_mockThingId, mockIntStateTypeId, 500, 5);
+
+    // 10 gets written, 12 is within the deadband, 20 is superseded by 30 within the interval
+    QNetworkAccessManager nam;
+    foreach (int value, QList<int>() << 10 << 12 << 20 << 30) {
+        QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(port).arg(mockIntStateTypeId.toString()).arg(value)));
+        QNetworkReply *reply = nam.get(request);
+        QSignalSpy finishedSpy(reply, &QNetworkReply::finished);
+        finishedSpy.wait();
+        reply->deleteLater();
+    }
+
+    NymeaCore::instance()->logEngine()->setStateRateLimit(m_mockThingId, mockIntStateTypeId, 0, 0);
+
+    QVariantMap params;
+    params.insert("thingIds", QVariantList() << m_mockThingId);
+    params.insert("typeIds", QVariantList() << mockIntStateTypeId);
+
+    QVariantList logEntries;
+    QDateTime timeout = QDateTime::currentDateTime().addSecs(5);
+    while (logEntries.count() < 2 && QDateTime::currentDateTime() < timeout) {
+        QTest::qWait(100);
+        waitForDBSync();
+        QVariant response = injectAndWait("Logging.GetLogEntries", params);
+        verifyLoggingError(response);
+        logEntries = response.toMap().value("params").toMap().value("logEntries").toList();
+    }
+
+    QCOMPARE(logEntries.count(), 2);
+    // Newest first
+    QCOMPARE(logEntries.at(0).toMap().value("value").toInt(), 30);
+    QCOMPARE(logEntries.at(1).toMap().value("value").toInt(), 10);
+}
+
+void TestLogging::stateHistory()
+{
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QVERIFY2(thing, "There needs to be a configured mock thing for this test");
+    int port = thing->paramValue(mockThingHttpportParamTypeId).toInt();
+
+    NymeaCore::instance()->logEngine()->setStateHistorySize(3);
+
+    // Only the last 3 values are kept
+    QNetworkAccessManager nam;
+    foreach (int value, QList<int>() << 41 << 42 << 43 << 44) {
+        QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(port).arg(mockIntStateTypeId.toString()).arg(value)));
+        QNetworkReply *reply = nam.get(request);
+        QSignalSpy finishedSpy(reply, &QNetworkReply::finished);
+        finishedSpy.wait();
+        reply->deleteLater();
+    }
+
+    QVariantMap params;
+    params.insert("thingId", m_mockThingId);
+    params.insert("stateTypeId", mockIntStateTypeId);
+    QVariant response = injectAndWait("Integrations.GetStateHistory", params);
+    verifyThingError(response);
+
+    QVariantList history = response.toMap().value("params").toMap().value("history").toList();
+    QCOMPARE(history.count(), 3);
+    // Oldest first
+    QCOMPARE(history.at(0).toMap().value("value").toInt(), 42);
+    QCOMPARE(history.at(1).toMap().value("value").toInt(), 43);
+    QCOMPARE(history.at(2).toMap().value("value").toInt(), 44);
+    QVERIFY(history.at(0).toMap().value("timestamp").toLongLong() <= history.at(2).toMap().value("timestamp").toLongLong());
+
+    params.insert("stateTypeId", StateTypeId::createStateTypeId());
+    response = injectAndWait("Integrations.GetStateHistory", params);
+    verifyThingError(response, Thing::ThingErrorStateTypeNotFound);
+
+    NymeaCore::instance()->logEngine()->setStateHistorySize(NymeaCore::instance()->configuration()->logStateHistorySize());
 }
 
 void TestLogging::removeThing()
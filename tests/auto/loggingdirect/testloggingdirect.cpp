@@ -31,6 +31,8 @@
 #include <QtTest>
 
 #include "logging/logengine.h"
+#include "logging/logsegmentstorage.h"
+#include "logging/logcolumncache.h"
 
 using namespace nymeaserver;
 
@@ -41,6 +43,15 @@ public:
     TestLoggingDirect(QObject* parent = nullptr);
 
 private slots:
+    void batchedInserts_data();
+    void batchedInserts();
+
+    void segmentStorage();
+    void segmentSeriesIds();
+    void segmentSeriesFiles();
+    void segmentStorageThread();
+    void columnCache();
+
     void benchmarkDB_data();
     void benchmarkDB();
 
@@ -56,6 +67,256 @@ TestLoggingDirect::TestLoggingDirect(QObject *parent): QObject(parent)
     QCoreApplication::instance()->setOrganizationName("nymea-test");
 }
 
+void TestLoggingDirect::batchedInserts_data()
+{
+    QTest::addColumn<int>("batchSize");
+    QTest::addColumn<int>("batchInterval");
+
+    QTest::newRow("no batching") << 1 << 0;
+    QTest::newRow("batch 100") << 100 << 0;
+    QTest::newRow("batch 100, 50ms window") << 100 << 50;
+}
+
+void TestLoggingDirect::batchedInserts()
+{
+    QFETCH(int, batchSize);
+    QFETCH(int, batchInterval);
+
+    engine->setMaxLogEntries(20000, 10);
+    engine->clearDatabase();
+    engine->setBatchingParameters(batchSize, batchInterval);
+
+    QSignalSpy addedSpy(engine, &LogEngine::logEntryAdded);
+    int count = 500;
+    for (int i = 0; i < count; i++) {
+        engine->logSystemEvent(QDateTime::currentDateTime(), i % 2 == 0);
+    }
+
+    QTRY_COMPARE_WITH_TIMEOUT(addedSpy.count(), count, 10000);
+
+    LogEntriesFetchJob *job = engine->fetchLogEntries();
+    QSignalSpy fetchSpy(job, &LogEntriesFetchJob::finished);
+    fetchSpy.wait();
+    QCOMPARE(job->results().count(), count);
+
+    engine->setBatchingParameters(100, 0);
+}
+
+void TestLoggingDirect::segmentStorage()
+{
+    LogSegmentStorage storage("/tmp/nymea-test/nymea-segments", 3600, 30);
+    QVERIFY(storage.init());
+    storage.clear();
+
+    ThingId thingId = ThingId::createThingId();
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+    QDateTime start = QDateTime::currentDateTime().addSecs(-100);
+
+    // Two buckets of 50 seconds
+    for (int i = 0; i < 100; i++) {
+        storage.appendStateValue(thingId, stateTypeId, start.addSecs(i), i);
+    }
+    // Another series in the same segments must not show up
+    storage.appendStateValue(ThingId::createThingId(), stateTypeId, start.addSecs(10), 1000);
+
+    LogEntrySamples samples = storage.fetchStateSamples(thingId, stateTypeId, start, start.addSecs(100), 2);
+    QCOMPARE(samples.count(), 2);
+    QCOMPARE(samples.at(0).count(), 50);
+    QCOMPARE(samples.at(0).min(), 0.0);
+    QCOMPARE(samples.at(0).max(), 49.0);
+    QCOMPARE(samples.at(0).avg(), 24.5);
+    QCOMPARE(samples.at(1).last().toDouble(), 99.0);
+
+    // Values are still there after reopening
+    LogSegmentStorage reopened("/tmp/nymea-test/nymea-segments", 3600, 30);
+    QVERIFY(reopened.init());
+    QCOMPARE(reopened.fetchStateSamples(thingId, stateTypeId, start, start.addSecs(100), 1).first().count(), 100);
+
+    // Expired segments are deleted as a whole
+    int segmentCount = storage.segments().count();
+    storage.appendStateValue(thingId, stateTypeId, QDateTime::currentDateTime().addDays(-40), 1);
+    QCOMPARE(storage.segments().count(), segmentCount + 1);
+    storage.applyRetention();
+    QCOMPARE(storage.segments().count(), segmentCount);
+
+    storage.removeThing(thingId);
+    QVERIFY(storage.fetchStateSamples(thingId, stateTypeId, start, start.addSecs(100), 1).isEmpty());
+}
+
+void TestLoggingDirect::segmentSeriesIds()
+{
+    LogSegmentStorage storage("/tmp/nymea-test/nymea-segments", 3600, 30);
+    QVERIFY(storage.init());
+    storage.clear();
+
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+    QDateTime start = QDateTime::currentDateTime().addSecs(-100);
+    ThingId keptThingId = ThingId::createThingId();
+    ThingId removedThingId = ThingId::createThingId();
+    storage.appendStateValue(keptThingId, stateTypeId, start, 1);
+    storage.appendStateValue(removedThingId, stateTypeId, start.addSecs(1), 2);
+
+    // The records of a removed thing outlive its series, so its id must not be handed out again,
+    // not even after reopening the storage
+    storage.removeThing(removedThingId);
+    QVERIFY(storage.fetchStateSamples(removedThingId, stateTypeId, start, start.addSecs(100), 1).isEmpty());
+    QCOMPARE(storage.fetchStateSamples(keptThingId, stateTypeId, start, start.addSecs(100), 1).count(), 1);
+    LogSegmentStorage reopened("/tmp/nymea-test/nymea-segments", 3600, 30);
+    QVERIFY(reopened.init());
+    ThingId newThingId = ThingId::createThingId();
+    reopened.appendStateValue(newThingId, stateTypeId, start.addSecs(2), 3);
+
+    LogEntrySamples samples = reopened.fetchStateSamples(newThingId, stateTypeId, start, start.addSecs(100), 1);
+    QCOMPARE(samples.count(), 1);
+    QCOMPARE(samples.first().count(), 1);
+    QCOMPARE(samples.first().last().toDouble(), 3.0);
+    QCOMPARE(reopened.fetchStateSamples(keptThingId, stateTypeId, start, start.addSecs(100), 1).first().count(), 1);
+}
+
+void TestLoggingDirect::segmentSeriesFiles()
+{
+    QString path = "/tmp/nymea-test/nymea-segments";
+    LogSegmentStorage storage(path, 3600, 30);
+    QVERIFY(storage.init());
+    storage.clear();
+
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+    QDateTime start = QDateTime::currentDateTime().addSecs(-100);
+    ThingId firstThingId = ThingId::createThingId();
+    ThingId secondThingId = ThingId::createThingId();
+    storage.appendStateValue(firstThingId, stateTypeId, start, 1);
+    storage.appendStateValue(secondThingId, stateTypeId, start, 2);
+    storage.appendStateValue(firstThingId, stateTypeId, start.addSecs(1), 3);
+
+    // One segment per series, a fetch only reads the one of its series
+    QStringList segments = storage.segments();
+    QCOMPARE(segments.count(), 2);
+    foreach (const QString &segment, segments) {
+        QCOMPARE(segment.split('.').count(), 3);
+    }
+    LogEntrySamples samples = storage.fetchStateSamples(firstThingId, stateTypeId, start, start.addSecs(100), 1);
+    QCOMPARE(samples.count(), 1);
+    QCOMPARE(samples.first().count(), 2);
+    QCOMPARE(samples.first().last().toDouble(), 3.0);
+
+    // Removing a thing deletes its segments
+    storage.removeThing(secondThingId);
+    QCOMPARE(storage.segments().count(), 1);
+
+    // Segments holding all series, as written by earlier versions, are still read
+    struct Record {
+        qint64 timestamp;
+        quint32 seriesId;
+        quint32 reserved;
+        double value;
+    };
+    ThingId legacyThingId = ThingId::createThingId();
+    storage.clear();
+    QFile index(QDir(path).filePath("series.idx"));
+    QVERIFY(index.open(QFile::WriteOnly | QFile::Text));
+    index.write(QString("next 3\n1 %1 %2\n2 %3 %2\n").arg(legacyThingId.toString()).arg(stateTypeId.toString()).arg(firstThingId.toString()).toUtf8());
+    index.close();
+    qint64 partition = start.toMSecsSinceEpoch() - start.toMSecsSinceEpoch() % (3600 * 1000);
+    QFile legacySegment(QDir(path).filePath(QString("%1.seg").arg(partition)));
+    QVERIFY(legacySegment.open(QFile::WriteOnly));
+    QList<Record> records = {{start.toMSecsSinceEpoch(), 1, 0, 10}, {start.toMSecsSinceEpoch(), 2, 0, 20}, {start.addSecs(1).toMSecsSinceEpoch(), 1, 0, 30}};
+    foreach (const Record &record, records) {
+        legacySegment.write(reinterpret_cast<const char*>(&record), sizeof(Record));
+    }
+    legacySegment.close();
+
+    LogSegmentStorage reopened(path, 3600, 30);
+    QVERIFY(reopened.init());
+    reopened.appendStateValue(legacyThingId, stateTypeId, start.addSecs(2), 40);
+    samples = reopened.fetchStateSamples(legacyThingId, stateTypeId, start, start.addSecs(100), 1);
+    QCOMPARE(samples.count(), 1);
+    QCOMPARE(samples.first().count(), 3);
+    QCOMPARE(samples.first().min(), 10.0);
+    QCOMPARE(samples.first().last().toDouble(), 40.0);
+}
+
+void TestLoggingDirect::segmentStorageThread()
+{
+    QTRY_VERIFY(!engine->initializing());
+    engine->setStateStorageBackend(new LogSegmentStorage("/tmp/nymea-test/nymea-segments", 3600, 30));
+    QVERIFY(engine->stateStorageBackend());
+    QVERIFY(engine->stateStorageBackend()->thread() != QThread::currentThread());
+
+    ThingId thingId = ThingId::createThingId();
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+    QDateTime start = QDateTime::currentDateTime().addSecs(-100);
+    for (int i = 0; i < 10; i++) {
+        LogEntry entry(start.addSecs(i), Logging::LoggingLevelInfo, Logging::LoggingSourceStates);
+        entry.setThingId(thingId);
+        entry.setTypeId(stateTypeId);
+        entry.setValue(i);
+        engine->appendReplicatedEntry(entry);
+    }
+
+    // Fetched in the thread of the storage, after the values appended before
+    LogEntrySamplesFetchJob *job = engine->fetchLogEntrySamples(thingId, stateTypeId, start, start.addSecs(100), 1);
+    QSignalSpy fetchSpy(job, &LogEntrySamplesFetchJob::finished);
+    QVERIFY(fetchSpy.wait());
+    QCOMPARE(job->results().count(), 1);
+    QCOMPARE(job->results().first().count(), 10);
+    QCOMPARE(job->results().first().last().toDouble(), 9.0);
+
+    // Replacing the storage finishes pending requests
+    job = engine->fetchLogEntrySamples(thingId, stateTypeId, start, start.addSecs(100), 1);
+    QSignalSpy pendingSpy(job, &LogEntrySamplesFetchJob::finished);
+    engine->setStateStorageBackend(nullptr);
+    QCOMPARE(pendingSpy.count(), 1);
+    QVERIFY(!engine->stateStorageBackend());
+}
+
+void TestLoggingDirect::columnCache()
+{
+    QVERIFY(LogColumnCache::isCachedUnit(Types::UnitWatt));
+    QVERIFY(!LogColumnCache::isCachedUnit(Types::UnitDegreeCelsius));
+
+    LogColumnCache cache(3600);
+    ThingId thingId = ThingId::createThingId();
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+    QDateTime start = QDateTime::currentDateTime().addMSecs(1000);
+    QVERIFY(!cache.covers(thingId, stateTypeId, start));
+
+    // Enough values to span several chunks, in two buckets
+    for (int i = 0; i < 10000; i++) {
+        cache.append(thingId, stateTypeId, start.addMSecs(i), i % 100);
+    }
+    // Out of order values end up in their bucket
+    cache.append(thingId, stateTypeId, start.addMSecs(2500), 1000);
+    cache.append(ThingId::createThingId(), stateTypeId, start.addMSecs(10), 5000);
+    QCOMPARE(cache.valueCount(), 10002);
+
+    QVERIFY(cache.covers(thingId, stateTypeId, start));
+    QVERIFY(!cache.covers(thingId, stateTypeId, start.addSecs(-2)));
+
+    LogEntrySamples samples = cache.samples(thingId, stateTypeId, start, start.addMSecs(10000), 2);
+    QCOMPARE(samples.count(), 2);
+    QCOMPARE(samples.at(0).timestamp(), start);
+    QCOMPARE(samples.at(0).count(), 5001);
+    QCOMPARE(samples.at(0).min(), 0.0);
+    QCOMPARE(samples.at(0).max(), 1000.0);
+    QCOMPARE(samples.at(0).avg(), (50 * 4950 + 1000) / 5001.0);
+    QCOMPARE(samples.at(0).last().toDouble(), 99.0);
+    QCOMPARE(samples.at(1).count(), 5000);
+    QCOMPARE(samples.at(1).avg(), 49.5);
+    QCOMPARE(samples.at(1).last().toDouble(), 99.0);
+
+    // Ranges within a chunk
+    samples = cache.samples(thingId, stateTypeId, start.addMSecs(5), start.addMSecs(8), 1);
+    QCOMPARE(samples.count(), 1);
+    QCOMPARE(samples.first().count(), 3);
+    QCOMPARE(samples.first().min(), 5.0);
+    QCOMPARE(samples.first().max(), 7.0);
+    QCOMPARE(samples.first().last().toDouble(), 7.0);
+
+    cache.removeThing(thingId);
+    QVERIFY(!cache.covers(thingId, stateTypeId, start));
+    QVERIFY(cache.samples(thingId, stateTypeId, start, start.addMSecs(10000), 1).isEmpty());
+}
+
 void TestLoggingDirect::benchmarkDB_data() {
     QTest::addColumn<int>("prefill");
     QTest::addColumn<int>("maxSize");
@@ -33,6 +33,9 @@
 #include "logging/logengine.h"
 #include "logging/logvaluetool.h"
 
+#include <QSqlDatabase>
+#include <QSqlQuery>
+
 using namespace nymeaserver;
 
 class TestLoggingLoading: public QObject
@@ -46,6 +49,9 @@ protected slots:
 
 private slots:
     void testLogfileRotation();
+    void testMigration5to6();
+    void testInitializationBuffer();
+    void testInitializationStateHistory();
 };
 
 TestLoggingLoading::TestLoggingLoading(QObject *parent): QObject(parent)
@@ -89,5 +95,185 @@ void TestLoggingLoading::testLogfileRotation()
     QVERIFY(QFile(rotatedDbName).remove());
 }
 
+void TestLoggingLoading::testMigration5to6()
+{
+    QString temporaryDbName = "/tmp/nymea-test/nymead-v5.sqlite";
+    if (QFile::exists(temporaryDbName))
+        QVERIFY(QFile(temporaryDbName).remove());
+
+    QUuid thingId = QUuid::createUuid();
+    QUuid numericTypeId = QUuid::createUuid();
+    QUuid stringTypeId = QUuid::createUuid();
+
+    // A schema 5 database stores the uuids as strings and all values in the value column
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "v5");
+        db.setDatabaseName(temporaryDbName);
+        QVERIFY(db.open());
+        QStringList statements;
+        statements << "CREATE TABLE metadata (`key` VARCHAR(10), data VARCHAR(40));"
+                   << "INSERT INTO metadata (`key`, data) VALUES('version', '5');"
+                   << "CREATE TABLE entries (timestamp BIGINT, loggingLevel INT, sourceType INT, typeId VARCHAR(38), thingId VARCHAR(38), "
+                      "value VARCHAR(100), loggingEventType INT, active BOOL, errorCode INT);"
+                   << "CREATE INDEX idx_entries_thingId_typeId_timestamp ON entries (thingId, typeId, timestamp);";
+        foreach (const QString &statement, statements) {
+            QSqlQuery query = db.exec(statement);
+            QVERIFY2(!query.lastError().isValid(), query.lastError().text().toUtf8().constData());
+        }
+        QSqlQuery insert(db);
+        insert.prepare("INSERT INTO entries (timestamp, loggingLevel, sourceType, typeId, thingId, value, loggingEventType, active, errorCode) VALUES (?, 0, ?, ?, ?, ?, 0, 0, 0);");
+        QVariantList rows = {
+            QVariantList({1000, Logging::LoggingSourceStates, numericTypeId.toString(), thingId.toString(), "21.5"}),
+            QVariantList({2000, Logging::LoggingSourceStates, numericTypeId.toString(), thingId.toString(), "42"}),
+            QVariantList({3000, Logging::LoggingSourceStates, stringTypeId.toString(), thingId.toString(), "on"}),
+            // Doesn't convert back to the same string, so it must stay a string
+            QVariantList({4000, Logging::LoggingSourceStates, stringTypeId.toString(), thingId.toString(), "007"})
+        };
+        foreach (const QVariant &row, rows) {
+            foreach (const QVariant &value, row.toList()) {
+                insert.addBindValue(value);
+            }
+            QVERIFY2(insert.exec(), insert.lastError().text().toUtf8().constData());
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("v5");
+
+    LogEngine *logEngine = new LogEngine("QSQLITE", temporaryDbName);
+    QTRY_VERIFY(!logEngine->initializing());
+    delete logEngine;
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "v6");
+        db.setDatabaseName(temporaryDbName);
+        QVERIFY(db.open());
+
+        QSqlQuery versionQuery = db.exec("SELECT data FROM metadata WHERE `key` = 'version';");
+        QVERIFY(versionQuery.next());
+        QCOMPARE(versionQuery.value("data").toInt(), 6);
+        QVERIFY(!db.tables().contains("_entries_v5"));
+
+        QSqlQuery uuidsQuery = db.exec("SELECT COUNT(*) FROM uuids;");
+        QVERIFY(uuidsQuery.next());
+        QCOMPARE(uuidsQuery.value(0).toInt(), 3);
+
+        // The order, the interned uuids and the split into numeric and string values are kept
+        QSqlQuery entriesQuery = db.exec("SELECT entries.timestamp, types.uuid AS typeId, things.uuid AS thingId, entries.value, entries.numericValue "
+                                         "FROM entries LEFT JOIN uuids AS types ON types.id = entries.typeId LEFT JOIN uuids AS things ON things.id = entries.thingId "
+                                         "ORDER BY entries.timestamp ASC;");
+        QList<QVariantList> entries;
+        while (entriesQuery.next()) {
+            entries.append({entriesQuery.value("timestamp"), entriesQuery.value("typeId"), entriesQuery.value("thingId"),
+                            entriesQuery.value("value"), entriesQuery.value("numericValue")});
+        }
+        QCOMPARE(entries.count(), 4);
+        foreach (const QVariantList &entry, entries) {
+            QCOMPARE(QUuid(entry.at(2).toString()), thingId);
+        }
+        QCOMPARE(QUuid(entries.at(0).at(1).toString()), numericTypeId);
+        QVERIFY(entries.at(0).at(3).isNull());
+        QCOMPARE(entries.at(0).at(4).toDouble(), 21.5);
+        QCOMPARE(entries.at(1).at(4).toInt(), 42);
+        QCOMPARE(QUuid(entries.at(2).at(1).toString()), stringTypeId);
+        QCOMPARE(entries.at(2).at(3).toString(), QString("on"));
+        QVERIFY(entries.at(2).at(4).isNull());
+        QCOMPARE(entries.at(3).at(3).toString(), QString("007"));
+        QVERIFY(entries.at(3).at(4).isNull());
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("v6");
+
+    QVERIFY(QFile(temporaryDbName).remove());
+}
+
+void TestLoggingLoading::testInitializationBuffer()
+{
+    QString temporaryDbName = "/tmp/nymea-test/nymead-initbuffer.sqlite";
+    QFile::remove(temporaryDbName);
+    QFile::remove(temporaryDbName + "-wal");
+    QFile::remove(temporaryDbName + "-shm");
+
+    // The database is opened in the background, until the event loop picks up the result entries are kept in memory
+    LogEngine *logEngine = new LogEngine("QSQLITE", temporaryDbName);
+    QVERIFY(logEngine->initializing());
+    QSignalSpy addedSpy(logEngine, &LogEngine::logEntryAdded);
+
+    // Only the most recent entries fit into the buffer
+    QDateTime start = QDateTime::fromMSecsSinceEpoch(QDateTime::currentMSecsSinceEpoch() / 1000 * 1000);
+    int count = 1005;
+    for (int i = 0; i < count; i++) {
+        logEngine->logSystemEvent(start.addSecs(i), i % 2 == 0);
+    }
+    LogEntriesFetchJob *earlyJob = logEngine->fetchLogEntries();
+    QSignalSpy earlyFetchSpy(earlyJob, &LogEntriesFetchJob::finished);
+    QVERIFY(logEngine->initializing());
+    QCOMPARE(addedSpy.count(), 0);
+
+    // Requests made in the meantime are answered once the database is ready
+    QVERIFY(earlyFetchSpy.wait());
+    QVERIFY(!logEngine->initializing());
+
+    QTRY_COMPARE_WITH_TIMEOUT(addedSpy.count(), 1000, 10000);
+    QTRY_VERIFY(!logEngine->jobsRunning());
+    LogEntriesFetchJob *job = logEngine->fetchLogEntries();
+    QSignalSpy fetchSpy(job, &LogEntriesFetchJob::finished);
+    QVERIFY(fetchSpy.wait());
+    QList<LogEntry> entries = job->results();
+    QCOMPARE(entries.count(), 1000);
+    QDateTime oldest = entries.first().timestamp();
+    QDateTime newest = entries.first().timestamp();
+    foreach (const LogEntry &entry, entries) {
+        oldest = qMin(oldest, entry.timestamp());
+        newest = qMax(newest, entry.timestamp());
+    }
+    QCOMPARE(oldest, start.addSecs(count - 1000));
+    QCOMPARE(newest, start.addSecs(count - 1));
+
+    delete logEngine;
+    QVERIFY(QFile(temporaryDbName).remove());
+}
+
+void TestLoggingLoading::testInitializationStateHistory()
+{
+    QString temporaryDbName = "/tmp/nymea-test/nymead-initstatehistory.sqlite";
+    QFile::remove(temporaryDbName);
+    QFile::remove(temporaryDbName + "-wal");
+    QFile::remove(temporaryDbName + "-shm");
+
+    LogEngine *logEngine = new LogEngine("QSQLITE", temporaryDbName);
+    logEngine->setStateHistorySize(5);
+    QVERIFY(logEngine->initializing());
+    QSignalSpy addedSpy(logEngine, &LogEngine::logEntryAdded);
+
+    ThingId thingId = ThingId::createThingId();
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+    QDateTime start = QDateTime::fromMSecsSinceEpoch(QDateTime::currentMSecsSinceEpoch() / 1000 * 1000);
+    for (int i = 0; i < 3; i++) {
+        LogEntry entry(start.addSecs(i), Logging::LoggingLevelInfo, Logging::LoggingSourceStates);
+        entry.setThingId(thingId);
+        entry.setTypeId(stateTypeId);
+        entry.setValue(i);
+        logEngine->appendReplicatedEntry(entry);
+    }
+
+    // The history is available right away, while the database is still being loaded
+    QVERIFY(logEngine->initializing());
+    QList<QPair<QDateTime, QVariant>> history = logEngine->stateHistory(thingId, stateTypeId);
+    QCOMPARE(history.count(), 3);
+
+    // Writing the buffered entries to the database must not add them to the history once more
+    QTRY_VERIFY(!logEngine->initializing());
+    QTRY_COMPARE_WITH_TIMEOUT(addedSpy.count(), 3, 10000);
+    history = logEngine->stateHistory(thingId, stateTypeId);
+    QCOMPARE(history.count(), 3);
+    for (int i = 0; i < 3; i++) {
+        QCOMPARE(history.at(i).first, start.addSecs(i));
+        QCOMPARE(history.at(i).second.toInt(), i);
+    }
+
+    delete logEngine;
+    QVERIFY(QFile(temporaryDbName).remove());
+}
+
 #include "testloggingloading.moc"
 QTEST_MAIN(TestLoggingLoading)
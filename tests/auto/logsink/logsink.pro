@@ -0,0 +1,6 @@
+TARGET = testlogsink
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testlogsink.cpp
@@ -0,0 +1,287 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "logsink.h"
+
+#include <QtTest>
+#include <QSemaphore>
+
+static QMutex s_recordsMutex;
+static QVector<LogRecord> s_records;
+static QSemaphore s_writerGate;
+static QAtomicInt s_gateWriter;
+static QAtomicInt s_writerEntered;
+
+static void collectRecords(const QVector<LogRecord> &records)
+{
+    s_writerEntered.storeRelease(1);
+    if (s_gateWriter.loadAcquire()) {
+        s_writerGate.acquire();
+    }
+    QMutexLocker locker(&s_recordsMutex);
+    s_records.append(records);
+}
+
+class PostingThread: public QThread
+{
+public:
+    PostingThread(LogSink *sink, const QString &name, int count):
+        m_sink(sink), m_name(name), m_count(count) { }
+
+    int accepted() const { return m_accepted; }
+
+protected:
+    void run() override {
+        for (int i = 0; i < m_count; i++) {
+            if (m_sink->post(QtDebugMsg, "test", QString("%1:%2").arg(m_name).arg(i))) {
+                m_accepted++;
+            }
+        }
+    }
+
+private:
+    LogSink *m_sink = nullptr;
+    QString m_name;
+    int m_count = 0;
+    int m_accepted = 0;
+};
+
+class TestLogSink: public QObject
+{
+    Q_OBJECT
+
+private:
+    void startSink(LogSink *sink);
+    int droppedMessages() const;
+    QList<int> sequence(const QString &name) const;
+
+private slots:
+    void init();
+    void cleanup();
+
+    void perThreadOrdering();
+    void dropNewest();
+    void blockPolicy();
+    void stopFlushesQueue();
+    void stopWaitsForPostsInFlight();
+    void consecutiveSinks();
+};
+
+// Posts a first record until the sink thread accepts it
+void TestLogSink::startSink(LogSink *sink)
+{
+    sink->start();
+    while (!sink->post(QtDebugMsg, "test", "start")) {
+        QThread::msleep(1);
+    }
+}
+
+int TestLogSink::droppedMessages() const
+{
+    int dropped = 0;
+    QRegExp regExp("Log buffer overrun, dropped (\\d+) messages");
+    foreach (const LogRecord &record, s_records) {
+        if (regExp.exactMatch(record.message)) {
+            dropped += regExp.cap(1).toInt();
+        }
+    }
+    return dropped;
+}
+
+QList<int> TestLogSink::sequence(const QString &name) const
+{
+    QList<int> sequence;
+    foreach (const LogRecord &record, s_records) {
+        if (record.message.startsWith(name + ":")) {
+            sequence.append(record.message.section(':', 1).toInt());
+        }
+    }
+    return sequence;
+}
+
+void TestLogSink::init()
+{
+    s_records.clear();
+    s_gateWriter.storeRelease(0);
+    s_writerEntered.storeRelease(0);
+    s_writerGate.acquire(s_writerGate.available());
+}
+
+void TestLogSink::cleanup()
+{
+    s_gateWriter.storeRelease(0);
+    s_writerGate.release(100);
+}
+
+void TestLogSink::perThreadOrdering()
+{
+    LogSink sink(collectRecords);
+    sink.setDropPolicy(LogDropPolicyBlock);
+    startSink(&sink);
+
+    QList<PostingThread *> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.append(new PostingThread(&sink, QString("thread%1").arg(i), 5000));
+    }
+    foreach (PostingThread *thread, threads) {
+        thread->start();
+    }
+    foreach (PostingThread *thread, threads) {
+        QVERIFY(thread->wait(10000));
+    }
+    sink.stop();
+
+    // Records of one thread are written in the order they have been posted, none got lost
+    QCOMPARE(droppedMessages(), 0);
+    for (int i = 0; i < threads.count(); i++) {
+        QList<int> sequence = this->sequence(QString("thread%1").arg(i));
+        QCOMPARE(sequence.count(), 5000);
+        for (int j = 0; j < sequence.count(); j++) {
+            QCOMPARE(sequence.at(j), j);
+        }
+    }
+    qDeleteAll(threads);
+}
+
+void TestLogSink::dropNewest()
+{
+    LogSink sink(collectRecords);
+    s_gateWriter.storeRelease(1);
+    startSink(&sink);
+
+    // Hold the sink thread in the writer, the buffer of this thread can't be drained meanwhile
+    QTRY_VERIFY(s_writerEntered.loadAcquire());
+
+    for (int i = 0; i < 3000; i++) {
+        QVERIFY(sink.post(QtDebugMsg, "test", QString("main:%1").arg(i)));
+    }
+
+    s_gateWriter.storeRelease(0);
+    s_writerGate.release(100);
+    sink.stop();
+
+    // The oldest records fill the buffer, the newest ones are dropped and reported
+    QList<int> sequence = this->sequence("main");
+    QCOMPARE(sequence.count(), 1024);
+    QCOMPARE(sequence.first(), 0);
+    QCOMPARE(sequence.last(), 1023);
+    QCOMPARE(droppedMessages(), 3000 - 1024);
+}
+
+void TestLogSink::blockPolicy()
+{
+    LogSink sink(collectRecords);
+    sink.setDropPolicy(LogDropPolicyBlock);
+    s_gateWriter.storeRelease(1);
+    startSink(&sink);
+    QTRY_VERIFY(s_writerEntered.loadAcquire());
+
+    PostingThread thread(&sink, "blocked", 3000);
+    thread.start();
+
+    // The posting thread waits for the sink as long as the writer is held
+    QVERIFY(!thread.wait(200));
+
+    s_gateWriter.storeRelease(0);
+    s_writerGate.release(100);
+    QVERIFY(thread.wait(10000));
+    sink.stop();
+
+    QCOMPARE(thread.accepted(), 3000);
+    QCOMPARE(sequence("blocked").count(), 3000);
+    QCOMPARE(droppedMessages(), 0);
+}
+
+void TestLogSink::stopFlushesQueue()
+{
+    LogSink sink(collectRecords);
+    startSink(&sink);
+
+    for (int i = 0; i < 100; i++) {
+        QVERIFY(sink.post(QtWarningMsg, "test", QString("main:%1").arg(i)));
+    }
+    sink.stop();
+
+    QVERIFY(!sink.isRunning());
+    QCOMPARE(sequence("main").count(), 100);
+
+    // Once stopped, callers have to write the messages themselves
+    QVERIFY(!sink.post(QtWarningMsg, "test", "main:100"));
+    QCOMPARE(sequence("main").count(), 100);
+}
+
+void TestLogSink::stopWaitsForPostsInFlight()
+{
+    LogSink sink(collectRecords);
+    startSink(&sink);
+
+    QList<PostingThread *> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.append(new PostingThread(&sink, QString("thread%1").arg(i), 20000));
+    }
+    foreach (PostingThread *thread, threads) {
+        thread->start();
+    }
+    QThread::msleep(20);
+    sink.stop();
+    foreach (PostingThread *thread, threads) {
+        QVERIFY(thread->wait(10000));
+    }
+
+    // Every post which got accepted has either been written or reported as dropped
+    int accepted = 0;
+    int written = 0;
+    for (int i = 0; i < threads.count(); i++) {
+        accepted += threads.at(i)->accepted();
+        written += sequence(QString("thread%1").arg(i)).count();
+    }
+    QCOMPARE(written + droppedMessages(), accepted);
+    qDeleteAll(threads);
+}
+
+void TestLogSink::consecutiveSinks()
+{
+    // One thread posting to two sinks, one after the other. Likely created at the same address,
+    // the second one must not pick up the buffer the thread still caches for the first one.
+    for (int i = 0; i < 2; i++) {
+        s_records.clear();
+        QScopedPointer<LogSink> sink(new LogSink(collectRecords));
+        startSink(sink.data());
+        QVERIFY(sink->post(QtDebugMsg, "test", QString("main:%1").arg(i)));
+        sink->stop();
+
+        QVERIFY(!s_records.isEmpty());
+        QCOMPARE(s_records.first().message, QString("start"));
+        QCOMPARE(sequence("main"), QList<int>() << i);
+    }
+}
+
+#include "testlogsink.moc"
+QTEST_MAIN(TestLogSink)
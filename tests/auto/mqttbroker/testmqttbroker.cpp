@@ -32,6 +32,7 @@
 #include "nymeacore.h"
 #include "servers/mqttbroker.h"
 #include "servers/mocktcpserver.h"
+#include "network/mqtt/mqtttopictrie.h"
 
 #include <mqttclient.h>
 
@@ -57,6 +58,13 @@ private slots:
 
     void testSubscribePolicy_data();
     void testSubscribePolicy();
+
+    void testTopicTrie_data();
+    void testTopicTrie();
+
+    void testRetainedMessages();
+
+    void testSlowClient();
 };
 
 void TestMqttBroker::initTestCase()
@@ -448,6 +456,134 @@ void TestMqttBroker::testSubscribePolicy()
     QCOMPARE(clientSubscribedSpy.count(), (allowed ? 1 : 0));
 }
 
+void TestMqttBroker::testTopicTrie_data()
+{
+    QTest::addColumn<QStringList>("topicFilters");
+    QTest::addColumn<QString>("topic");
+    QTest::addColumn<int>("matches");
+
+    QTest::newRow("#, /") << (QStringList() << "#") << "/" << 1;
+    QTest::newRow("a, b") << (QStringList() << "a") << "b" << 0;
+    QTest::newRow("a b, b") << (QStringList() << "a" << "b") << "b" << 1;
+    QTest::newRow("/a/#, /a/b/c") << (QStringList() << "/a/#") << "/a/b/c" << 1;
+    QTest::newRow("/a/#, /a") << (QStringList() << "/a/#") << "/a" << 1;
+    QTest::newRow("/a/#, /b/a/c") << (QStringList() << "/a/#") << "/b/a/c" << 0;
+    QTest::newRow("/+/b/#, /a/b") << (QStringList() << "/+/b/#") << "/a/b" << 1;
+    QTest::newRow("/+/b/#, /b") << (QStringList() << "/+/b/#") << "/b" << 0;
+    QTest::newRow("a/+, a") << (QStringList() << "a/+") << "a" << 0;
+    QTest::newRow("a/+ a/# a/b, a/b") << (QStringList() << "a/+" << "a/#" << "a/b") << "a/b" << 3;
+    QTest::newRow("#, $SYS/broker") << (QStringList() << "#") << "$SYS/broker" << 0;
+    QTest::newRow("+/broker, $SYS/broker") << (QStringList() << "+/broker") << "$SYS/broker" << 0;
+    QTest::newRow("$SYS/#, $SYS/broker") << (QStringList() << "$SYS/#") << "$SYS/broker" << 1;
+    QTest::newRow("a/#/b invalid, a/x/b") << (QStringList() << "a/#/b") << "a/x/b" << 0;
+    QTest::newRow("a/b+ invalid, a/b+") << (QStringList() << "a/b+") << "a/b+" << 0;
+}
+
+void TestMqttBroker::testTopicTrie()
+{
+    QFETCH(QStringList, topicFilters);
+    QFETCH(QString, topic);
+    QFETCH(int, matches);
+
+    MqttTopicTrie<QString> trie;
+    foreach (const QString &topicFilter, topicFilters) {
+        trie.insert(topicFilter, topicFilter);
+    }
+
+    QCOMPARE(trie.match(topic).count(), matches);
+
+    // Removing all filters has to leave an empty trie
+    foreach (const QString &topicFilter, topicFilters) {
+        trie.remove(topicFilter, topicFilter);
+    }
+    QVERIFY(trie.isEmpty());
+    QCOMPARE(trie.match(topic).count(), 0);
+}
+
+void TestMqttBroker::testRetainedMessages()
+{
+    MqttBroker *broker = NymeaCore::instance()->serverManager()->mqttBroker();
+
+    QList<QPair<QString, QByteArray> > messages;
+    messages << qMakePair(QString("retained/a/state"), QByteArray("1"));
+    messages << qMakePair(QString("retained/b/state"), QByteArray("2"));
+    messages << qMakePair(QString("retained/a/state"), QByteArray("3"));
+    broker->publish(messages, true);
+
+    QHash<QString, QByteArray> retained = broker->retainedMessages("retained/#");
+    QCOMPARE(retained.count(), 2);
+    QCOMPARE(retained.value("retained/a/state"), QByteArray("3"));
+    QCOMPARE(retained.value("retained/b/state"), QByteArray("2"));
+
+    QCOMPARE(broker->retainedMessages("retained/+/state").count(), 2);
+    QCOMPARE(broker->retainedMessages("retained/b/state").count(), 1);
+    QCOMPARE(broker->retainedMessages("retained/c/state").count(), 0);
+
+    // An empty retained payload clears the retained message
+    broker->publish("retained/a/state", QByteArray(), true);
+    QCOMPARE(broker->retainedMessages("retained/#").count(), 1);
+    broker->publish("retained/b/state", QByteArray(), true);
+    QCOMPARE(broker->retainedMessages("retained/#").count(), 0);
+}
+
+void TestMqttBroker::testSlowClient()
+{
+    MqttBroker *broker = NymeaCore::instance()->serverManager()->mqttBroker();
+
+    MqttPolicy policy;
+    policy.clientId = "slowclient";
+    policy.username = "testuser";
+    policy.password = "testpassword";
+    policy.allowedSubscribeTopicFilters = QStringList() << "#";
+    NymeaCore::instance()->configuration()->updateMqttPolicy(policy);
+
+    QSignalSpy clientSubscribedSpy(broker, &MqttBroker::clientSubscribed);
+
+    MqttClient* mqttClient = new MqttClient("slowclient", this);
+    mqttClient->setUsername("testuser");
+    mqttClient->setPassword("testpassword");
+    mqttClient->setAutoReconnect(false);
+    QSignalSpy connectedSpy(mqttClient, &MqttClient::connected);
+    mqttClient->connectToHost("127.0.0.1", 1883);
+    QVERIFY2(connectedSpy.count() == 1 || connectedSpy.wait(), "Mqtt client didn't connect");
+
+    mqttClient->subscribe("slow/#");
+    QVERIFY(clientSubscribedSpy.count() == 1 || clientSubscribedSpy.wait());
+
+    // Two messages fit into the limit, the rest is dropped for the QoS 0 subscriber
+    int outboundLimit = broker->clientOutboundLimit();
+    broker->setClientOutboundLimit(100);
+    QList<QPair<QString, QByteArray> > messages;
+    for (int i = 0; i < 10; i++) {
+        messages << qMakePair(QString("slow/%1").arg(i), QByteArray(50, 'x'));
+    }
+    broker->publish(messages);
+    QTest::qWait(100);
+    broker->setClientOutboundLimit(outboundLimit);
+
+    QVariant response = injectAndWait("Configuration.GetMqttStatistics");
+    QVariantMap clientStatistics;
+    foreach (const QVariant &client, response.toMap().value("params").toMap().value("clients").toList()) {
+        if (client.toMap().value("clientId").toString() == "slowclient") {
+            clientStatistics = client.toMap();
+        }
+    }
+    QCOMPARE(clientStatistics.value("messagesOut").toInt(), 2);
+    QCOMPARE(clientStatistics.value("bytesOut").toInt(), 100);
+    QCOMPARE(clientStatistics.value("messagesDropped").toInt(), 8);
+
+    bool slowTopicFound = false;
+    foreach (const QVariant &topic, response.toMap().value("params").toMap().value("topics").toList()) {
+        if (topic.toMap().value("topicPrefix").toString() == "slow") {
+            slowTopicFound = true;
+        }
+    }
+    QVERIFY(slowTopicFound);
+
+    mqttClient->disconnectFromHost();
+    mqttClient->deleteLater();
+}
+
 
 #include "testmqttbroker.moc"
 QTEST_MAIN(TestMqttBroker)
@@ -0,0 +1,10 @@
+TARGET = testnymeaasync
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+# The awaitables are only available to code built with coroutine support. Qt 5 headers trigger a few
+# deprecation warnings in C++20 which must not fail the build with -Werror.
+QMAKE_CXXFLAGS += -std=c++20 -Wno-deprecated -Wno-deprecated-enum-enum-conversion
+
+SOURCES += testnymeaasync.cpp
@@ -0,0 +1,213 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "integrations/nymeaasync.h"
+
+#include <QtTest>
+
+class AsyncReply: public QObject
+{
+    Q_OBJECT
+public:
+    bool isFinished() const { return m_finished; }
+    void finish() { m_finished = true; emit finished(); }
+
+signals:
+    void finished();
+    void progress(int percentage);
+    void timeout();
+
+private:
+    bool m_finished = false;
+};
+
+class TestNymeaAsync: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void finishedSignal();
+    void alreadyFinished();
+    void emittedSignal();
+    void timeoutSignal();
+    void destroyedWithoutSignal();
+    void delay();
+    void delayContextDestroyed();
+};
+
+void TestNymeaAsync::initTestCase()
+{
+#if !defined(__cpp_impl_coroutine) || __cpp_impl_coroutine < 201902L
+    QSKIP("The compiler has no coroutine support");
+#endif
+}
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+class ScopeFlag
+{
+public:
+    explicit ScopeFlag(bool *flag): m_flag(flag) {}
+    ~ScopeFlag() { *m_flag = true; }
+private:
+    bool *m_flag;
+};
+
+static NymeaAsync::Task waitForFinished(AsyncReply *reply, AsyncReply **result, bool *resumed)
+{
+    *result = co_await NymeaAsync::finished(reply);
+    *resumed = true;
+}
+
+static NymeaAsync::Task waitForProgress(AsyncReply *reply, bool *resumed)
+{
+    co_await NymeaAsync::emitted(reply, &AsyncReply::progress);
+    *resumed = true;
+}
+
+static NymeaAsync::Task waitForTimeouts(AsyncReply *timer, int count, int *timeouts)
+{
+    for (int i = 0; i < count; i++) {
+        co_await NymeaAsync::timeout(timer);
+        (*timeouts)++;
+    }
+}
+
+static NymeaAsync::Task waitForDelay(QObject *context, int msec, bool *resumed, bool *frameDestroyed)
+{
+    ScopeFlag scopeFlag(frameDestroyed);
+    co_await NymeaAsync::delay(context, msec);
+    *resumed = true;
+}
+
+void TestNymeaAsync::finishedSignal()
+{
+    AsyncReply reply;
+    AsyncReply *result = nullptr;
+    bool resumed = false;
+    waitForFinished(&reply, &result, &resumed);
+    QVERIFY(!resumed);
+
+    reply.finish();
+    QVERIFY(resumed);
+    QCOMPARE(result, &reply);
+}
+
+void TestNymeaAsync::alreadyFinished()
+{
+    AsyncReply reply;
+    reply.finish();
+    AsyncReply *result = nullptr;
+    bool resumed = false;
+    waitForFinished(&reply, &result, &resumed);
+    QVERIFY(resumed);
+    QCOMPARE(result, &reply);
+}
+
+void TestNymeaAsync::emittedSignal()
+{
+    AsyncReply reply;
+    bool resumed = false;
+    waitForProgress(&reply, &resumed);
+    reply.finish();
+    QVERIFY(!resumed);
+
+    emit reply.progress(50);
+    QVERIFY(resumed);
+}
+
+void TestNymeaAsync::timeoutSignal()
+{
+    AsyncReply timer;
+    int timeouts = 0;
+    waitForTimeouts(&timer, 2, &timeouts);
+    emit timer.timeout();
+    QCOMPARE(timeouts, 1);
+    emit timer.timeout();
+    QCOMPARE(timeouts, 2);
+
+    // The coroutine has returned, nothing is connected anymore
+    emit timer.timeout();
+    QCOMPARE(timeouts, 2);
+}
+
+void TestNymeaAsync::destroyedWithoutSignal()
+{
+    AsyncReply *reply = new AsyncReply();
+    AsyncReply *result = reply;
+    bool resumed = false;
+    waitForFinished(reply, &result, &resumed);
+    delete reply;
+    QVERIFY(resumed);
+    QCOMPARE(result, static_cast<AsyncReply*>(nullptr));
+}
+
+void TestNymeaAsync::delay()
+{
+    QObject context;
+    bool resumed = false;
+    bool frameDestroyed = false;
+    waitForDelay(&context, 50, &resumed, &frameDestroyed);
+    QVERIFY(!resumed);
+
+    QTRY_VERIFY(resumed);
+    QVERIFY(frameDestroyed);
+}
+
+void TestNymeaAsync::delayContextDestroyed()
+{
+    QObject *context = new QObject();
+    bool resumed = false;
+    bool frameDestroyed = false;
+    waitForDelay(context, 10, &resumed, &frameDestroyed);
+    QVERIFY(!frameDestroyed);
+
+    delete context;
+    QVERIFY(frameDestroyed);
+    QTest::qWait(50);
+    QVERIFY(!resumed);
+}
+
+#else
+
+void TestNymeaAsync::finishedSignal() {}
+void TestNymeaAsync::alreadyFinished() {}
+void TestNymeaAsync::emittedSignal() {}
+void TestNymeaAsync::timeoutSignal() {}
+void TestNymeaAsync::destroyedWithoutSignal() {}
+void TestNymeaAsync::delay() {}
+void TestNymeaAsync::delayContextDestroyed() {}
+
+#endif
+
+#include "testnymeaasync.moc"
+QTEST_MAIN(TestNymeaAsync)
@@ -0,0 +1,6 @@
+TARGET = testpluginhost
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testpluginhost.cpp
@@ -0,0 +1,218 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+#include "nymeacore.h"
+#include "integrations/thingmanagerimplementation.h"
+#include "integrations/pluginhostintegrationplugin.h"
+#include "integrations/thingactioninfo.h"
+
+#include <QTcpServer>
+
+#include <signal.h>
+
+using namespace nymeaserver;
+
+// Runs the mock plugin in a nymea-pluginhost process instead of nymead
+class TestPluginHost: public NymeaTestBase
+{
+    Q_OBJECT
+
+private:
+    PluginHostIntegrationPlugin *hostedMock() const;
+    void setMockState(const StateTypeId &stateTypeId, const QVariant &value);
+    QVariant executePowerAction(bool power);
+
+private slots:
+    void initTestCase();
+
+    void setupThing();
+    void executeAction();
+    void stateChanges();
+    void autoThings();
+    void removeThing();
+    void hostCrash();
+};
+
+PluginHostIntegrationPlugin *TestPluginHost::hostedMock() const
+{
+    return qobject_cast<PluginHostIntegrationPlugin*>(NymeaCore::instance()->thingManager()->plugin(mockPluginId));
+}
+
+void TestPluginHost::setMockState(const StateTypeId &stateTypeId, const QVariant &value)
+{
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(value.toString())));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    QVERIFY(spy.wait());
+    QCOMPARE(reply->error(), QNetworkReply::NoError);
+}
+
+QVariant TestPluginHost::executePowerAction(bool power)
+{
+    QVariantMap param;
+    param.insert("paramTypeId", mockPowerActionPowerParamTypeId.toString());
+    param.insert("value", power);
+    QVariantMap params;
+    params.insert("thingId", m_mockThingId.toString());
+    params.insert("actionTypeId", mockPowerActionTypeId.toString());
+    params.insert("params", QVariantList({param}));
+    return injectAndWait("Integrations.ExecuteAction", params);
+}
+
+void TestPluginHost::initTestCase()
+{
+    QVariantMap settings;
+    settings.insert("PluginHost/plugins", QStringList({"mock"}));
+    NymeaTestBase::initTestCase("*.debug=false\nTests.debug=true\nPluginHost.debug=true", settings);
+    qRegisterMetaType<StateTypeId>();
+}
+
+void TestPluginHost::setupThing()
+{
+    // The mock has been set up by NymeaTestBase already, through the proxy
+    PluginHostIntegrationPlugin *plugin = hostedMock();
+    QVERIFY2(plugin, "The mock plugin is not running in a plugin host");
+    QVERIFY(plugin->hostProcessId() > 0);
+    QVERIFY(plugin->hostProcessId() != QCoreApplication::applicationPid());
+
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QVERIFY(thing);
+    QCOMPARE(thing->setupStatus(), Thing::ThingSetupStatusComplete);
+    QCOMPARE(thing->paramValue(mockThingHttpportParamTypeId).toInt(), m_mockThing1Port);
+}
+
+void TestPluginHost::executeAction()
+{
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    bool power = !thing->stateValue(mockPowerStateTypeId).toBool();
+
+    QVariant response = executePowerAction(power);
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    // The state is set by the plugin in the host before it finishes the action
+    QTRY_COMPARE(thing->stateValue(mockPowerStateTypeId).toBool(), power);
+
+    QVariantMap params;
+    params.insert("thingId", m_mockThingId.toString());
+    params.insert("actionTypeId", mockFailingActionTypeId.toString());
+    response = injectAndWait("Integrations.ExecuteAction", params);
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorSetupFailed));
+}
+
+void TestPluginHost::stateChanges()
+{
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QSignalSpy stateSpy(thing, &Thing::stateValueChanged);
+
+    int value = thing->stateValue(mockIntStateTypeId).toInt() + 1;
+    setMockState(mockIntStateTypeId, value);
+    QTRY_COMPARE(thing->stateValue(mockIntStateTypeId).toInt(), value);
+
+    // A burst of changes arrives in order
+    for (int i = 1; i <= 20; i++) {
+        setMockState(mockIntStateTypeId, value + i);
+    }
+    QTRY_COMPARE(thing->stateValue(mockIntStateTypeId).toInt(), value + 20);
+    int previous = value - 1;
+    foreach (const QList<QVariant> &arguments, stateSpy) {
+        if (arguments.at(0).value<StateTypeId>() == mockIntStateTypeId) {
+            QVERIFY(arguments.at(1).toInt() > previous);
+            previous = arguments.at(1).toInt();
+        }
+    }
+    QCOMPARE(previous, value + 20);
+}
+
+void TestPluginHost::autoThings()
+{
+    // Auto things are announced by the plugin in the host
+    QTRY_VERIFY(!NymeaCore::instance()->thingManager()->findConfiguredThings(autoMockThingClassId).isEmpty());
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThings(autoMockThingClassId).first();
+    QTRY_COMPARE(thing->setupStatus(), Thing::ThingSetupStatusComplete);
+}
+
+void TestPluginHost::removeThing()
+{
+    QVariantMap httpPortParam;
+    httpPortParam.insert("paramTypeId", mockThingHttpportParamTypeId.toString());
+    httpPortParam.insert("value", m_mockThing2Port);
+    QVariantMap params;
+    params.insert("name", "Hosted mock");
+    params.insert("thingClassId", mockThingClassId.toString());
+    params.insert("thingParams", QVariantList({httpPortParam}));
+    QVariant response = injectAndWait("Integrations.AddThing", params);
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    ThingId thingId = ThingId(response.toMap().value("params").toMap().value("thingId").toString());
+
+    response = injectAndWait("Integrations.RemoveThing", {{"thingId", thingId.toString()}});
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    QVERIFY(!NymeaCore::instance()->thingManager()->findConfiguredThing(thingId));
+
+    // The host has released the thing, so its HTTP port is free again
+    QTcpServer server;
+    QTRY_VERIFY(server.listen(QHostAddress::Any, static_cast<quint16>(m_mockThing2Port)));
+}
+
+void TestPluginHost::hostCrash()
+{
+    PluginHostIntegrationPlugin *plugin = hostedMock();
+    qint64 pid = plugin->hostProcessId();
+    QVERIFY(pid > 0);
+
+    // An action in progress when the host goes away fails instead of timing out
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    ThingActionInfo *info = NymeaCore::instance()->thingManager()->executeAction(Action(mockAsyncActionTypeId, m_mockThingId));
+    QSignalSpy finishedSpy(info, &ThingActionInfo::finished);
+
+    QCOMPARE(::kill(static_cast<pid_t>(pid), SIGKILL), 0);
+    QTRY_COMPARE(finishedSpy.count(), 1);
+    QCOMPARE(info->status(), Thing::ThingErrorHardwareFailure);
+    QCOMPARE(plugin->hostProcessId(), 0);
+
+    // Restarted after a while, the thing is set up again in the new host
+    QTRY_VERIFY_WITH_TIMEOUT(plugin->hostProcessId() > 0, 15000);
+    QVERIFY(plugin->hostProcessId() != pid);
+    QCOMPARE(thing->setupStatus(), Thing::ThingSetupStatusComplete);
+
+    // Actions sent before the new host is ready wait for it
+    bool power = !thing->stateValue(mockPowerStateTypeId).toBool();
+    QVariant response = executePowerAction(power);
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    QTRY_COMPARE(thing->stateValue(mockPowerStateTypeId).toBool(), power);
+
+    int value = thing->stateValue(mockIntStateTypeId).toInt() + 1;
+    setMockState(mockIntStateTypeId, value);
+    QTRY_COMPARE(thing->stateValue(mockIntStateTypeId).toInt(), value);
+}
+
+#include "testpluginhost.moc"
+QTEST_MAIN(TestPluginHost)
@@ -0,0 +1,6 @@
+TARGET = testpluginhostprotocol
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testpluginhostprotocol.cpp
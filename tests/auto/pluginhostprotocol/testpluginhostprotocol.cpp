@@ -0,0 +1,513 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "integrations/pluginhost/pluginhostprotocol.h"
+#include "integrations/pluginhost/pluginhoststatechannel.h"
+
+#include <QtTest>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSharedMemory>
+
+typedef PluginHostProtocol P;
+
+Q_DECLARE_METATYPE(PluginHostProtocol::Message)
+
+class TestPluginHostProtocol: public QObject
+{
+    Q_OBJECT
+
+private:
+    QLocalServer *m_server = nullptr;
+    QLocalSocket *m_hostSocket = nullptr;
+    QLocalSocket *m_coreSocket = nullptr;
+
+    static QString channelKey();
+    static QByteArray frame(P::Message message, const QByteArray &payload);
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void stateChange_data();
+    void stateChange();
+    void truncatedStateChange();
+    void payload();
+    void thingDescriptors();
+    void browserItem();
+
+    void sendAndReceive();
+    void splitFrames();
+    void coalescedFrames();
+    void invalidFrameLength();
+
+    void channelReadsInOrder();
+    void channelWakesUpOnce();
+    void channelWrapsAround();
+    void channelFull();
+    void channelCapacity();
+    void channelAttach();
+    void channelCorrupted();
+};
+
+QString TestPluginHostProtocol::channelKey()
+{
+    return "nymea-test-" + QUuid::createUuid().toString().remove('{').remove('}');
+}
+
+QByteArray TestPluginHostProtocol::frame(P::Message message, const QByteArray &payload)
+{
+    QByteArray frame;
+    QDataStream stream(&frame, QIODevice::WriteOnly);
+    stream << static_cast<quint32>(payload.size() + 1) << static_cast<quint8>(message);
+    return frame + payload;
+}
+
+void TestPluginHostProtocol::initTestCase()
+{
+    qRegisterMetaType<PluginHostProtocol::Message>();
+}
+
+void TestPluginHostProtocol::init()
+{
+    // A socket pair like the one between nymead and a plugin host
+    m_server = new QLocalServer(this);
+    QVERIFY(m_server->listen(channelKey()));
+    m_hostSocket = new QLocalSocket(this);
+    m_hostSocket->connectToServer(m_server->fullServerName());
+    QVERIFY(m_hostSocket->waitForConnected());
+    QVERIFY(m_server->waitForNewConnection(1000));
+    m_coreSocket = m_server->nextPendingConnection();
+    QVERIFY(m_coreSocket);
+}
+
+void TestPluginHostProtocol::cleanup()
+{
+    delete m_hostSocket;
+    m_hostSocket = nullptr;
+    delete m_server;
+    m_server = nullptr;
+    m_coreSocket = nullptr;
+}
+
+void TestPluginHostProtocol::stateChange_data()
+{
+    QTest::addColumn<QVariant>("value");
+    QTest::addColumn<QVariant>("minValue");
+    QTest::addColumn<QVariant>("maxValue");
+
+    QTest::newRow("int") << QVariant(42) << QVariant() << QVariant();
+    QTest::newRow("string") << QVariant("playing") << QVariant() << QVariant();
+    QTest::newRow("double with limits") << QVariant(21.5) << QVariant(5.0) << QVariant(30.0);
+    QTest::newRow("only a minimum") << QVariant(3) << QVariant(1) << QVariant();
+}
+
+void TestPluginHostProtocol::stateChange()
+{
+    QFETCH(QVariant, value);
+    QFETCH(QVariant, minValue);
+    QFETCH(QVariant, maxValue);
+
+    QByteArray record = P::encodeStateChange(7, 3, value, minValue, maxValue);
+
+    quint32 handle = 0; int stateIndex = 0; QVariant decodedValue; QVariant decodedMinValue; QVariant decodedMaxValue;
+    QVERIFY(P::decodeStateChange(record, &handle, &stateIndex, &decodedValue, &decodedMinValue, &decodedMaxValue));
+    QCOMPARE(handle, 7u);
+    QCOMPARE(stateIndex, 3);
+    QCOMPARE(decodedValue, value);
+    QCOMPARE(decodedMinValue, minValue);
+    QCOMPARE(decodedMaxValue, maxValue);
+
+    // Records without limits don't carry them
+    if (!minValue.isValid() && !maxValue.isValid()) {
+        QVERIFY(record.size() < P::encodeStateChange(7, 3, value, QVariant(0), QVariant(0)).size());
+    }
+}
+
+void TestPluginHostProtocol::truncatedStateChange()
+{
+    QByteArray record = P::encodeStateChange(1, 0, QVariant("a value"), QVariant(), QVariant());
+
+    quint32 handle = 0; int stateIndex = 0; QVariant value; QVariant minValue; QVariant maxValue;
+    QVERIFY(!P::decodeStateChange(record.left(record.size() - 2), &handle, &stateIndex, &value, &minValue, &maxValue));
+    QVERIFY(!P::decodeStateChange(QByteArray(), &handle, &stateIndex, &value, &minValue, &maxValue));
+}
+
+void TestPluginHostProtocol::payload()
+{
+    ParamList params;
+    params << Param(ParamTypeId::createParamTypeId(), 5) << Param(ParamTypeId::createParamTypeId(), "text");
+    ThingId thingId = ThingId::createThingId();
+    QByteArray payload = P::encode(quint32(12), thingId, QString("Living room"), params);
+
+    QDataStream stream(payload);
+    stream.setVersion(P::streamVersion);
+    quint32 requestId; ThingId decodedThingId; QString name; ParamList decodedParams;
+    stream >> requestId >> decodedThingId >> name >> decodedParams;
+    QCOMPARE(stream.status(), QDataStream::Ok);
+    QVERIFY(stream.atEnd());
+    QCOMPARE(requestId, 12u);
+    QCOMPARE(decodedThingId, thingId);
+    QCOMPARE(name, QString("Living room"));
+    QCOMPARE(decodedParams.count(), 2);
+    for (int i = 0; i < params.count(); i++) {
+        QCOMPARE(decodedParams.at(i).paramTypeId(), params.at(i).paramTypeId());
+        QCOMPARE(decodedParams.at(i).value(), params.at(i).value());
+    }
+
+    // The host receives states without their thing, they're assigned to the thing they're sent with
+    State state(StateTypeId::createStateTypeId(), thingId);
+    state.setValue(20);
+    state.setMinValue(10);
+    state.setMaxValue(30);
+    payload = P::encode(state);
+    QDataStream stateStream(payload);
+    stateStream.setVersion(P::streamVersion);
+    State decodedState;
+    stateStream >> decodedState;
+    QCOMPARE(decodedState.stateTypeId(), state.stateTypeId());
+    QCOMPARE(decodedState.value(), state.value());
+    QCOMPARE(decodedState.minValue(), state.minValue());
+    QCOMPARE(decodedState.maxValue(), state.maxValue());
+}
+
+void TestPluginHostProtocol::thingDescriptors()
+{
+    ThingDescriptor descriptor(ThingDescriptorId::createThingDescriptorId(), ThingClassId::createThingClassId(), "Lamp", "Kitchen", ThingId::createThingId());
+    descriptor.setThingId(ThingId::createThingId());
+    descriptor.setParams(ParamList() << Param(ParamTypeId::createParamTypeId(), "192.168.0.2"));
+    QByteArray payload = P::encode(ThingDescriptors() << descriptor << ThingDescriptor(ThingClassId::createThingClassId(), "Plain"));
+
+    QDataStream stream(payload);
+    stream.setVersion(P::streamVersion);
+    ThingDescriptors decoded;
+    stream >> decoded;
+    QCOMPARE(stream.status(), QDataStream::Ok);
+    QCOMPARE(decoded.count(), 2);
+    QCOMPARE(decoded.first().id(), descriptor.id());
+    QCOMPARE(decoded.first().thingClassId(), descriptor.thingClassId());
+    QCOMPARE(decoded.first().thingId(), descriptor.thingId());
+    QCOMPARE(decoded.first().title(), descriptor.title());
+    QCOMPARE(decoded.first().description(), descriptor.description());
+    QCOMPARE(decoded.first().parentId(), descriptor.parentId());
+    QCOMPARE(decoded.first().params().count(), 1);
+    QCOMPARE(decoded.first().params().first().value(), QVariant("192.168.0.2"));
+    QCOMPARE(decoded.last().title(), QString("Plain"));
+    QVERIFY(decoded.last().thingId().isNull());
+}
+
+void TestPluginHostProtocol::browserItem()
+{
+    BrowserItem item("album-1", "Album", true, false);
+    item.setDescription("12 tracks");
+    item.setDisabled(true);
+    item.setIcon(BrowserItem::BrowserIconMusic);
+    item.setThumbnail("http://localhost/cover.png");
+    item.setActionTypeIds({ActionTypeId::createActionTypeId()});
+    QByteArray payload = P::encode(item);
+
+    QDataStream stream(payload);
+    stream.setVersion(P::streamVersion);
+    BrowserItem decoded;
+    stream >> decoded;
+    QCOMPARE(stream.status(), QDataStream::Ok);
+    QCOMPARE(decoded.id(), item.id());
+    QCOMPARE(decoded.displayName(), item.displayName());
+    QCOMPARE(decoded.description(), item.description());
+    QCOMPARE(decoded.browsable(), item.browsable());
+    QCOMPARE(decoded.executable(), item.executable());
+    QCOMPARE(decoded.disabled(), item.disabled());
+    QCOMPARE(decoded.icon(), item.icon());
+    QCOMPARE(decoded.thumbnail(), item.thumbnail());
+    QCOMPARE(decoded.actionTypeIds(), item.actionTypeIds());
+}
+
+void TestPluginHostProtocol::sendAndReceive()
+{
+    PluginHostConnection host(m_hostSocket);
+    PluginHostConnection core(m_coreSocket);
+    QSignalSpy coreSpy(&core, &PluginHostConnection::messageReceived);
+    QSignalSpy hostSpy(&host, &PluginHostConnection::messageReceived);
+
+    host.send(P::MessageHello, P::encode(PluginId::createPluginId()));
+    host.send(P::MessageStatesAvailable);
+    QTRY_COMPARE(coreSpy.count(), 2);
+    QCOMPARE(coreSpy.at(0).at(0).value<P::Message>(), P::MessageHello);
+    QCOMPARE(coreSpy.at(1).at(0).value<P::Message>(), P::MessageStatesAvailable);
+    QVERIFY(coreSpy.at(1).at(1).toByteArray().isEmpty());
+
+    QByteArray payload = P::encode(quint32(1), QString("A message"));
+    core.send(P::MessageSetThingName, payload);
+    QTRY_COMPARE(hostSpy.count(), 1);
+    QCOMPARE(hostSpy.first().at(0).value<P::Message>(), P::MessageSetThingName);
+    QCOMPARE(hostSpy.first().at(1).toByteArray(), payload);
+}
+
+void TestPluginHostProtocol::splitFrames()
+{
+    PluginHostConnection core(m_coreSocket);
+    QSignalSpy spy(&core, &PluginHostConnection::messageReceived);
+
+    QByteArray payload(100000, 'x');
+    QByteArray data = frame(P::MessageStateChanged, payload);
+
+    // Byte by byte for the header, in chunks for the rest
+    for (int i = 0; i < 5; i++) {
+        m_hostSocket->write(data.mid(i, 1));
+        m_hostSocket->flush();
+        QTest::qWait(10);
+        QCOMPARE(spy.count(), 0);
+    }
+    m_hostSocket->write(data.mid(5, 50000));
+    m_hostSocket->flush();
+    QTest::qWait(10);
+    QCOMPARE(spy.count(), 0);
+    m_hostSocket->write(data.mid(50005));
+    QTRY_COMPARE(spy.count(), 1);
+    QCOMPARE(spy.first().at(0).value<P::Message>(), P::MessageStateChanged);
+    QCOMPARE(spy.first().at(1).toByteArray(), payload);
+}
+
+void TestPluginHostProtocol::coalescedFrames()
+{
+    PluginHostConnection core(m_coreSocket);
+    QSignalSpy spy(&core, &PluginHostConnection::messageReceived);
+
+    QByteArray data;
+    for (quint32 i = 0; i < 100; i++) {
+        data.append(frame(P::MessageActionFinished, P::encode(i, qint32(0), QString())));
+    }
+    m_hostSocket->write(data);
+    QTRY_COMPARE(spy.count(), 100);
+    for (quint32 i = 0; i < 100; i++) {
+        QDataStream stream(spy.at(static_cast<int>(i)).at(1).toByteArray());
+        stream.setVersion(P::streamVersion);
+        quint32 requestId;
+        stream >> requestId;
+        QCOMPARE(requestId, i);
+    }
+}
+
+void TestPluginHostProtocol::invalidFrameLength()
+{
+    PluginHostConnection core(m_coreSocket);
+    QSignalSpy messageSpy(&core, &PluginHostConnection::messageReceived);
+    QSignalSpy disconnectedSpy(m_hostSocket, &QLocalSocket::disconnected);
+
+    // A zero length frame can't even hold the message type, the stream is broken
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << quint32(0) << quint8(P::MessageHello);
+    m_hostSocket->write(data);
+    QVERIFY(disconnectedSpy.wait());
+    QCOMPARE(messageSpy.count(), 0);
+}
+
+void TestPluginHostProtocol::channelReadsInOrder()
+{
+    QString key = channelKey();
+    PluginHostStateChannel core;
+    QVERIFY2(core.create(key), core.errorString().toUtf8().constData());
+    PluginHostStateChannel host;
+    QVERIFY2(host.attach(key), host.errorString().toUtf8().constData());
+    QVERIFY(core.isValid());
+    QVERIFY(host.isValid());
+    QCOMPARE(host.key(), core.key());
+
+    QByteArray record;
+    QVERIFY(!core.read(&record));
+
+    bool wakeUp = false;
+    for (int i = 0; i < 100; i++) {
+        QVERIFY(host.write(P::encodeStateChange(static_cast<quint32>(i), i % 10, i, QVariant(), QVariant()), &wakeUp));
+    }
+    for (int i = 0; i < 100; i++) {
+        QVERIFY(core.read(&record));
+        quint32 handle; int stateIndex; QVariant value; QVariant minValue; QVariant maxValue;
+        QVERIFY(P::decodeStateChange(record, &handle, &stateIndex, &value, &minValue, &maxValue));
+        QCOMPARE(handle, static_cast<quint32>(i));
+        QCOMPARE(stateIndex, i % 10);
+        QCOMPARE(value.toInt(), i);
+    }
+    QVERIFY(!core.read(&record));
+}
+
+void TestPluginHostProtocol::channelWakesUpOnce()
+{
+    QString key = channelKey();
+    PluginHostStateChannel core;
+    QVERIFY(core.create(key));
+    PluginHostStateChannel host;
+    QVERIFY(host.attach(key));
+
+    // Only the first record of a burst wakes up the core
+    bool wakeUp = false;
+    QVERIFY(host.write("1", &wakeUp));
+    QVERIFY(wakeUp);
+    QVERIFY(host.write("2", &wakeUp));
+    QVERIFY(!wakeUp);
+
+    // The core clears the wake up before draining, so a record written while draining wakes it up again
+    core.clearWakeUp();
+    QByteArray record;
+    QVERIFY(core.read(&record));
+    QVERIFY(host.write("3", &wakeUp));
+    QVERIFY(wakeUp);
+    QVERIFY(core.read(&record));
+    QCOMPARE(record, QByteArray("2"));
+    QVERIFY(core.read(&record));
+    QCOMPARE(record, QByteArray("3"));
+}
+
+void TestPluginHostProtocol::channelWrapsAround()
+{
+    QString key = channelKey();
+    PluginHostStateChannel core;
+    QVERIFY(core.create(key, 64));
+    PluginHostStateChannel host;
+    QVERIFY(host.attach(key));
+
+    // Record sizes not dividing the capacity make records and size fields span the end of the ring
+    bool wakeUp = false;
+    QByteArray record;
+    for (int i = 0; i < 1000; i++) {
+        QByteArray written = QByteArray::number(i).repeated(1 + i % 7);
+        QVERIFY(host.write(written, &wakeUp));
+        QVERIFY(core.read(&record));
+        QCOMPARE(record, written);
+    }
+    QVERIFY(!core.read(&record));
+}
+
+void TestPluginHostProtocol::channelFull()
+{
+    QString key = channelKey();
+    PluginHostStateChannel core;
+    QVERIFY(core.create(key, 1024));
+    PluginHostStateChannel host;
+    QVERIFY(host.attach(key));
+
+    // The writer never blocks, it is told to send the record on the socket instead
+    bool wakeUp = false;
+    int written = 0;
+    while (host.write(QByteArray(60, 'a'), &wakeUp)) {
+        written++;
+    }
+    QCOMPARE(written, 1024 / 64);
+    QVERIFY(!host.write("b", &wakeUp));
+
+    QByteArray record;
+    QVERIFY(core.read(&record));
+    QVERIFY(host.write(QByteArray(60, 'c'), &wakeUp));
+    QVERIFY(!host.write("d", &wakeUp));
+
+    int read = 0;
+    while (core.read(&record)) {
+        read++;
+    }
+    QCOMPARE(read, written);
+    QCOMPARE(record, QByteArray(60, 'c'));
+}
+
+void TestPluginHostProtocol::channelCapacity()
+{
+    // Rounded up to a power of two
+    QString key = channelKey();
+    PluginHostStateChannel core;
+    QVERIFY(core.create(key, 100));
+    PluginHostStateChannel host;
+    QVERIFY(host.attach(key));
+
+    bool wakeUp = false;
+    for (int i = 0; i < 4; i++) {
+        QVERIFY(host.write(QByteArray(28, 'a'), &wakeUp));
+    }
+    QVERIFY(!host.write(QByteArray(), &wakeUp));
+}
+
+void TestPluginHostProtocol::channelAttach()
+{
+    PluginHostStateChannel host;
+    QVERIFY(!host.attach(channelKey()));
+    QVERIFY(!host.isValid());
+    bool wakeUp = true;
+    QVERIFY(!host.write("lost", &wakeUp));
+    QVERIFY(!wakeUp);
+
+    // A restarted host attaches again to the channel of the core
+    QString key = channelKey();
+    PluginHostStateChannel core;
+    QVERIFY(core.create(key));
+    PluginHostStateChannel *crashedHost = new PluginHostStateChannel();
+    QVERIFY(crashedHost->attach(key));
+    QVERIFY(crashedHost->write("before", &wakeUp));
+    delete crashedHost;
+
+    QVERIFY(host.attach(key));
+    QVERIFY(host.write("after", &wakeUp));
+    QByteArray record;
+    QVERIFY(core.read(&record));
+    QCOMPARE(record, QByteArray("before"));
+    QVERIFY(core.read(&record));
+    QCOMPARE(record, QByteArray("after"));
+}
+
+void TestPluginHostProtocol::channelCorrupted()
+{
+    QString key = channelKey();
+    PluginHostStateChannel core;
+    QVERIFY(core.create(key, 256));
+    PluginHostStateChannel host;
+    QVERIFY(host.attach(key));
+
+    bool wakeUp = false;
+    QVERIFY(host.write("first", &wakeUp));
+    QVERIFY(host.write("second", &wakeUp));
+
+    // Overwrite the size of the first record with more than has been written. The header
+    // holds head, tail, the wake up flag and the capacity, the data follows it.
+    QSharedMemory memory(key);
+    QVERIFY(memory.attach());
+    quint32 size = 1000;
+    memcpy(static_cast<char*>(memory.data()) + 4 * sizeof(quint32), &size, sizeof(quint32));
+    memory.detach();
+
+    // Everything written so far is dropped, the channel stays usable
+    QByteArray record;
+    QVERIFY(!core.read(&record));
+    QVERIFY(!core.read(&record));
+    QVERIFY(host.write("third", &wakeUp));
+    QVERIFY(core.read(&record));
+    QCOMPARE(record, QByteArray("third"));
+}
+
+#include "testpluginhostprotocol.moc"
+QTEST_MAIN(TestPluginHostProtocol)
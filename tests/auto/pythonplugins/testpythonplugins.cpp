@@ -56,6 +56,8 @@ private slots:
     void setupAndRemoveThing();
     void testDiscoverPairAndRemoveThing();
 
+    void testPluginStatistics();
+
 
 };
 
@@ -142,5 +144,23 @@ void TestPythonPlugins::testDiscoverPairAndRemoveThing()
     verifyThingError(response, Thing::ThingErrorNoError);
 }
 
+void TestPythonPlugins::testPluginStatistics()
+{
+    // Things have been set up by the previous tests, so setupThing must have been accounted
+    QVariant response = injectAndWait("Integrations.GetPluginStatistics");
+    QVariantMap plugins = response.toMap().value("params").toMap().value("plugins").toMap();
+
+    QVariantMap pyMockStatistics;
+    foreach (const QVariant &plugin, plugins) {
+        if (plugin.toMap().value("runtime").toString() == "python" && plugin.toMap().value("name").toString() == "pyMock") {
+            pyMockStatistics = plugin.toMap();
+        }
+    }
+    QVERIFY2(!pyMockStatistics.isEmpty(), "pyMock plugin not found in statistics");
+    QVariantMap setupThing = pyMockStatistics.value("calls").toMap().value("setupThing").toMap();
+    QVERIFY(setupThing.value("count").toInt() > 0);
+    QVERIFY(setupThing.value("wallTimeUs").toLongLong() >= setupThing.value("maxWallTimeUs").toLongLong());
+}
+
 #include "testpythonplugins.moc"
 QTEST_MAIN(TestPythonPlugins)
@@ -0,0 +1,247 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "hardware/radio433/radio433receiver.h"
+#include "hardware/radio433/radio433transmitter.h"
+#include "hardware/gpiochipline.h"
+
+#include <QtTest>
+
+using namespace nymeaserver;
+
+typedef Radio433RingBuffer<int, 64> TestRingBuffer;
+
+class RingBufferProducer: public QThread
+{
+public:
+    RingBufferProducer(TestRingBuffer *buffer, int count): m_buffer(buffer), m_count(count) {}
+
+protected:
+    void run() override {
+        for (int i = 0; i < m_count; i++) {
+            m_buffer->push(i);
+        }
+    }
+
+private:
+    TestRingBuffer *m_buffer;
+    int m_count;
+};
+
+class TestRadio433: public QObject
+{
+    Q_OBJECT
+
+private:
+    // A sync pulse followed by the given data pulses, each a multiple of the base pulse
+    static QList<int> frame(int syncLength, int pulse, int count);
+
+private slots:
+    void ringBuffer();
+    void ringBufferThreads();
+
+    void decodeProtocol48();
+    void decodeProtocol64();
+    void decodeNoise();
+    void decodeTolerance();
+    void decodeReset();
+
+    void gpioChipUnavailable();
+    void transmitterUnavailable();
+};
+
+QList<int> TestRadio433::frame(int syncLength, int pulse, int count)
+{
+    QList<int> timings;
+    timings.append(syncLength);
+    for (int i = 0; i < count; i++) {
+        timings.append(i % 3 == 0 ? 3 * pulse : pulse);
+    }
+    return timings;
+}
+
+void TestRadio433::ringBuffer()
+{
+    TestRingBuffer buffer;
+    int value = -1;
+    QVERIFY(!buffer.pop(&value));
+
+    // One slot stays free to tell a full buffer from an empty one
+    for (int i = 0; i < 63; i++) {
+        QVERIFY(buffer.push(i));
+    }
+    QVERIFY(!buffer.push(63));
+    QVERIFY(!buffer.push(64));
+    QCOMPARE(buffer.takeDropped(), 2);
+    QCOMPARE(buffer.takeDropped(), 0);
+
+    for (int i = 0; i < 63; i++) {
+        QVERIFY(buffer.pop(&value));
+        QCOMPARE(value, i);
+    }
+    QVERIFY(!buffer.pop(&value));
+
+    // Wraps around
+    for (int i = 0; i < 100; i++) {
+        QVERIFY(buffer.push(i));
+        QVERIFY(buffer.pop(&value));
+        QCOMPARE(value, i);
+    }
+}
+
+void TestRadio433::ringBufferThreads()
+{
+    TestRingBuffer buffer;
+    int count = 200000;
+    RingBufferProducer producer(&buffer, count);
+    producer.start();
+
+    // Values may get dropped while the buffer is full, but never reordered or duplicated
+    int received = 0;
+    int last = -1;
+    int value;
+    while (true) {
+        bool running = producer.isRunning();
+        while (buffer.pop(&value)) {
+            QVERIFY(value > last);
+            last = value;
+            received++;
+        }
+        if (!running) {
+            break;
+        }
+    }
+    QCOMPARE(received + buffer.takeDropped(), count);
+}
+
+void TestRadio433::decodeProtocol48()
+{
+    Radio433PulseDecoder decoder;
+    QList<int> timings = frame(31 * 350, 350, 48);
+    foreach (int timing, timings) {
+        QVERIFY(!decoder.addTiming(timing));
+    }
+
+    // The frame is complete once the sync pulse of the next one arrives
+    QVERIFY(decoder.addTiming(31 * 350));
+    QCOMPARE(decoder.takeFrame(), timings);
+    QVERIFY(decoder.takeFrame().isEmpty());
+}
+
+void TestRadio433::decodeProtocol64()
+{
+    Radio433PulseDecoder decoder;
+    QList<int> timings = frame(10 * 500, 500, 64);
+    for (int i = 0; i < timings.count() - 1; i++) {
+        QVERIFY(!decoder.addTiming(timings.at(i)));
+    }
+
+    // 64 bit frames are complete with the last data pulse
+    QVERIFY(decoder.addTiming(timings.last()));
+    QCOMPARE(decoder.takeFrame(), timings);
+}
+
+void TestRadio433::decodeNoise()
+{
+    Radio433PulseDecoder decoder;
+    QList<int> timings = frame(31 * 350, 350, 48);
+    timings.insert(20, 10);
+    foreach (int timing, timings) {
+        QVERIFY(!decoder.addTiming(timing));
+    }
+    QVERIFY(!decoder.addTiming(31 * 350));
+    QVERIFY(decoder.takeFrame().isEmpty());
+
+    // The following frame is received again
+    foreach (int timing, frame(31 * 350, 350, 48).mid(1)) {
+        QVERIFY(!decoder.addTiming(timing));
+    }
+    QVERIFY(decoder.addTiming(31 * 350));
+    QCOMPARE(decoder.takeFrame().count(), 49);
+}
+
+void TestRadio433::decodeTolerance()
+{
+    QList<int> timings = frame(31 * 350, 350, 48);
+    timings[10] = 350 + 100;
+
+    Radio433PulseDecoder decoder;
+    foreach (int timing, timings) {
+        decoder.addTiming(timing);
+    }
+    QVERIFY(decoder.addTiming(31 * 350));
+    QCOMPARE(decoder.takeFrame(), timings);
+
+    Radio433PulseDecoder strictDecoder;
+    strictDecoder.setTolerance(50);
+    foreach (int timing, timings) {
+        strictDecoder.addTiming(timing);
+    }
+    QVERIFY(!strictDecoder.addTiming(31 * 350));
+    QVERIFY(strictDecoder.takeFrame().isEmpty());
+}
+
+void TestRadio433::decodeReset()
+{
+    Radio433PulseDecoder decoder;
+    QList<int> timings = frame(31 * 350, 350, 48);
+    foreach (int timing, timings.mid(0, 30)) {
+        decoder.addTiming(timing);
+    }
+
+    // Like after dropped edges, the partial frame is gone
+    decoder.reset();
+    foreach (int timing, timings.mid(30)) {
+        QVERIFY(!decoder.addTiming(timing));
+    }
+    QVERIFY(!decoder.addTiming(31 * 350));
+}
+
+void TestRadio433::gpioChipUnavailable()
+{
+    GpioChipLine line("gpiochip-nymea-test", 27);
+    QVERIFY(!line.requestEdgeEvents());
+    QVERIFY(!line.isValid());
+    QVERIFY(!line.requestOutput());
+    QVERIFY(!line.isValid());
+    QVERIFY(line.waitForEvents(10).isEmpty());
+}
+
+void TestRadio433::transmitterUnavailable()
+{
+    // Without a GPIO the data is dropped instead of being sent to a line which was never requested
+    Radio433Trasmitter transmitter;
+    QVERIFY(!transmitter.available());
+    transmitter.sendData(350, {1, 31, 1, 3}, 2);
+    QVERIFY(!transmitter.isRunning());
+}
+
+#include "testradio433.moc"
+QTEST_MAIN(TestRadio433)
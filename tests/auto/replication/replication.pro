@@ -0,0 +1,6 @@
+TARGET = testreplication
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testreplication.cpp
@@ -0,0 +1,600 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+#include "nymeacore.h"
+#include "nymeasettings.h"
+#include "servermanager.h"
+#include "servers/tcpserver.h"
+#include "replication/replicationprotocol.h"
+#include "replication/replicationprimary.h"
+#include "replication/replicationstandby.h"
+
+using namespace nymeaserver;
+
+// One end of a replication connection, driven by the test
+class TestPeer: public QObject
+{
+    Q_OBJECT
+public:
+    TestPeer(QSslSocket *socket, QObject *parent = nullptr):
+        QObject(parent),
+        connection(new ReplicationConnection(socket, this))
+    {
+        connect(connection, &ReplicationConnection::messageReceived, this, [this](const ReplicationMessage &message){
+            messages.append(message);
+        });
+        connect(connection, &ReplicationConnection::disconnected, this, [this](){
+            disconnected = true;
+        });
+    }
+
+    // Takes the first message of the given type, dropping everything received before it
+    bool waitForMessage(ReplicationMessage::Type type, ReplicationMessage *message = nullptr, int timeout = 5000)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        forever {
+            while (!messages.isEmpty()) {
+                ReplicationMessage received = messages.takeFirst();
+                if (received.type == type) {
+                    if (message) {
+                        *message = received;
+                    }
+                    return true;
+                }
+            }
+            if (disconnected || timer.elapsed() > timeout) {
+                return false;
+            }
+            QTest::qWait(10);
+        }
+    }
+
+    bool waitForDisconnected(int timeout = 5000)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        while (!disconnected && timer.elapsed() < timeout) {
+            QTest::qWait(10);
+        }
+        return disconnected;
+    }
+
+    ReplicationConnection *connection = nullptr;
+    QList<ReplicationMessage> messages;
+    bool disconnected = false;
+};
+
+class TestReplication: public NymeaTestBase
+{
+    Q_OBJECT
+
+private:
+    QByteArray m_secret = "replication-test-secret";
+    quint16 m_primaryPort = 0;
+    ReplicationPrimary *m_primary = nullptr;
+
+    void startPrimary(int backlogSize = 100000);
+    TestPeer *connectStandby();
+    bool authenticate(TestPeer *peer, const QByteArray &secret, const QUuid &epoch = QUuid(), quint64 sequence = 0, quint64 term = 0);
+    static QByteArray frame(const ReplicationMessage &message);
+
+    // A primary talking to a ReplicationStandby, answering the hello with the given secret and term
+    void runFakePrimary(const QByteArray &secret, quint64 term, bool *applied, bool *disconnected);
+
+private slots:
+    void initTestCase();
+    void cleanup();
+
+    void framing();
+    void oversizedFrame();
+    void malformedFrame();
+
+    void handshake();
+    void handshakeWrongSecret();
+    void handshakePlainConnection();
+
+    void backlogCatchUp();
+    void backlogNotCovering();
+
+    void standbyAppliesRecords();
+    void standbyRejectsSpoofedPrimary();
+    void standbyRejectsSupersededPrimary();
+
+    void promotedStandbyServesNextTerm();
+    void supersededPrimaryStopsReplicating();
+};
+
+void TestReplication::initTestCase()
+{
+    NymeaTestBase::initTestCase();
+    QLoggingCategory::setFilterRules("*.debug=false\n"
+                                     "Tests.debug=true\n"
+                                     "Replication.debug=true");
+    m_primaryPort = static_cast<quint16>(20000 + (qrand() % 10000));
+}
+
+void TestReplication::cleanup()
+{
+    delete m_primary;
+    m_primary = nullptr;
+
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.remove("Replication");
+    settings.remove("ReplicationTest");
+    QFile::remove(ReplicationStandby::positionFileName());
+    QFile::remove(NymeaSettings::storagePath() + "/replication-term");
+
+    NymeaTestBase::cleanup();
+}
+
+void TestReplication::startPrimary(int backlogSize)
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Replication");
+    settings.setValue("listenAddress", QString("127.0.0.1:%1").arg(m_primaryPort));
+    settings.setValue("secret", QString::fromUtf8(m_secret));
+    settings.setValue("backlogSize", backlogSize);
+    settings.endGroup();
+
+    NymeaCore *core = NymeaCore::instance();
+    m_primary = new ReplicationPrimary(core->configuration(), core->serverManager()->sslConfiguration(), core->thingManager(), core->ruleEngine(), core->logEngine(), this);
+    QVERIFY(m_primary->enabled());
+}
+
+TestPeer *TestReplication::connectStandby()
+{
+    QSslSocket *socket = new QSslSocket();
+    connect(socket, static_cast<void(QSslSocket::*)(const QList<QSslError> &)>(&QSslSocket::sslErrors), socket, [socket](){
+        socket->ignoreSslErrors();
+    });
+    TestPeer *peer = new TestPeer(socket, this);
+    socket->connectToHostEncrypted("127.0.0.1", m_primaryPort);
+    return peer;
+}
+
+bool TestReplication::authenticate(TestPeer *peer, const QByteArray &secret, const QUuid &epoch, quint64 sequence, quint64 term)
+{
+    ReplicationMessage challenge;
+    if (!peer->waitForMessage(ReplicationMessage::TypeChallenge, &challenge)) {
+        return false;
+    }
+    QSslCertificate certificate = peer->connection->socket()->peerCertificate();
+    QByteArray nonce = ReplicationConnection::createNonce();
+    QByteArray proof = ReplicationConnection::authenticate(secret, ReplicationConnection::RoleStandby, challenge.arguments.value(0).toByteArray(), certificate);
+    peer->connection->send(ReplicationMessage(ReplicationMessage::TypeHello, {proof, nonce, epoch, sequence, term}));
+
+    // The primary has to prove the knowledge of the secret in return
+    ReplicationMessage welcome;
+    if (!peer->waitForMessage(ReplicationMessage::TypeWelcome, &welcome)) {
+        return false;
+    }
+    QByteArray expected = ReplicationConnection::authenticate(secret, ReplicationConnection::RolePrimary, nonce, certificate);
+    return ReplicationConnection::verify(expected, welcome.arguments.value(0).toByteArray());
+}
+
+QByteArray TestReplication::frame(const ReplicationMessage &message)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << static_cast<quint8>(message.type) << message.arguments << message.records;
+
+    QByteArray frame;
+    QDataStream frameStream(&frame, QIODevice::WriteOnly);
+    frameStream << static_cast<quint32>(payload.size());
+    frame.append(payload);
+    return frame;
+}
+
+void TestReplication::framing()
+{
+    SslServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    TestPeer *peer = nullptr;
+    connect(&server, &SslServer::socketDescriptorAvailable, this, [&peer](qintptr socketDescriptor){
+        QSslSocket *socket = new QSslSocket();
+        socket->setSocketDescriptor(socketDescriptor);
+        peer = new TestPeer(socket);
+    });
+
+    QSslSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QTRY_VERIFY(peer != nullptr);
+    QScopedPointer<TestPeer> peerGuard(peer);
+
+    ReplicationMessage records(ReplicationMessage::TypeRecords);
+    ReplicationRecord record(ReplicationRecord::TypeSettingChanged, {static_cast<int>(NymeaSettings::SettingsRoleGlobal), "ReplicationTest/value", 42});
+    record.sequence = 7;
+    records.records.append(record);
+    record.sequence = 8;
+    record.type = ReplicationRecord::TypeRulesCleared;
+    record.arguments.clear();
+    records.records.append(record);
+    ReplicationMessage heartbeat(ReplicationMessage::TypeHeartbeat, {8});
+
+    // A partial frame is held back until the rest arrives, several frames in one chunk are all delivered
+    QByteArray data = frame(records) + frame(heartbeat);
+    client.write(data.left(3));
+    QVERIFY(client.waitForBytesWritten());
+    QTest::qWait(100);
+    QVERIFY(peer->messages.isEmpty());
+
+    client.write(data.mid(3));
+    QTRY_COMPARE(peer->messages.count(), 2);
+
+    ReplicationMessage received = peer->messages.at(0);
+    QCOMPARE(received.type, ReplicationMessage::TypeRecords);
+    QCOMPARE(received.records.count(), 2);
+    QCOMPARE(received.records.at(0).sequence, 7ull);
+    QCOMPARE(received.records.at(0).type, ReplicationRecord::TypeSettingChanged);
+    QCOMPARE(received.records.at(0).arguments, records.records.at(0).arguments);
+    QCOMPARE(received.records.at(1).sequence, 8ull);
+    QCOMPARE(received.records.at(1).type, ReplicationRecord::TypeRulesCleared);
+    QCOMPARE(peer->messages.at(1).type, ReplicationMessage::TypeHeartbeat);
+    QCOMPARE(peer->messages.at(1).arguments.value(0).toInt(), 8);
+    QVERIFY(!peer->disconnected);
+}
+
+void TestReplication::oversizedFrame()
+{
+    SslServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    TestPeer *peer = nullptr;
+    connect(&server, &SslServer::socketDescriptorAvailable, this, [&peer](qintptr socketDescriptor){
+        QSslSocket *socket = new QSslSocket();
+        socket->setSocketDescriptor(socketDescriptor);
+        peer = new TestPeer(socket);
+    });
+
+    QSslSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QTRY_VERIFY(peer != nullptr);
+    QScopedPointer<TestPeer> peerGuard(peer);
+
+    QByteArray size;
+    QDataStream stream(&size, QIODevice::WriteOnly);
+    stream << static_cast<quint32>(0xffffffff);
+    client.write(size);
+
+    QVERIFY(peer->waitForDisconnected());
+    QVERIFY(peer->messages.isEmpty());
+}
+
+void TestReplication::malformedFrame()
+{
+    SslServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    TestPeer *peer = nullptr;
+    connect(&server, &SslServer::socketDescriptorAvailable, this, [&peer](qintptr socketDescriptor){
+        QSslSocket *socket = new QSslSocket();
+        socket->setSocketDescriptor(socketDescriptor);
+        peer = new TestPeer(socket);
+    });
+
+    QSslSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QTRY_VERIFY(peer != nullptr);
+    QScopedPointer<TestPeer> peerGuard(peer);
+
+    // A frame holding the message type only, the arguments are missing
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << static_cast<quint32>(1) << static_cast<quint8>(ReplicationMessage::TypeHeartbeat);
+    client.write(data);
+
+    QVERIFY(peer->waitForDisconnected());
+    QVERIFY(peer->messages.isEmpty());
+}
+
+void TestReplication::handshake()
+{
+    startPrimary();
+
+    TestPeer *peer = connectStandby();
+    QVERIFY(authenticate(peer, m_secret));
+    QVERIFY(peer->connection->socket()->isEncrypted());
+
+    // A new standby gets a snapshot, without the local replication configuration of the primary
+    ReplicationMessage snapshotBegin;
+    QVERIFY(peer->waitForMessage(ReplicationMessage::TypeSnapshotBegin, &snapshotBegin));
+    QVERIFY(!snapshotBegin.arguments.value(0).toUuid().isNull());
+    QList<ReplicationRecord> records;
+    bool complete = false;
+    QElapsedTimer timer;
+    timer.start();
+    while (!complete && timer.elapsed() < 5000) {
+        if (peer->messages.isEmpty()) {
+            QVERIFY(!peer->disconnected);
+            QTest::qWait(10);
+            continue;
+        }
+        ReplicationMessage message = peer->messages.takeFirst();
+        if (message.type == ReplicationMessage::TypeSnapshotEnd) {
+            complete = true;
+        } else {
+            records.append(message.records);
+        }
+    }
+    QVERIFY(complete);
+    QVERIFY(!records.isEmpty());
+    foreach (const ReplicationRecord &record, records) {
+        QCOMPARE(record.sequence, 0ull);
+        if (record.type == ReplicationRecord::TypeSettingChanged) {
+            QVERIFY2(!record.arguments.value(1).toString().startsWith("Replication/"), record.arguments.value(1).toString().toUtf8());
+        }
+    }
+    delete peer;
+}
+
+void TestReplication::handshakeWrongSecret()
+{
+    startPrimary();
+
+    TestPeer *peer = connectStandby();
+    QVERIFY(!authenticate(peer, "wrong-secret"));
+    QVERIFY(peer->waitForDisconnected());
+
+    // Nothing but the challenge has been sent
+    QVERIFY(peer->messages.isEmpty());
+    QTRY_VERIFY(m_primary->statistics().value("standbys").toList().isEmpty());
+    delete peer;
+}
+
+void TestReplication::handshakePlainConnection()
+{
+    startPrimary();
+
+    // A peer not speaking TLS never gets to see a challenge
+    QSslSocket *socket = new QSslSocket();
+    TestPeer *peer = new TestPeer(socket, this);
+    socket->connectToHost("127.0.0.1", m_primaryPort);
+    QVERIFY(socket->waitForConnected());
+    peer->connection->send(ReplicationMessage(ReplicationMessage::TypeHello, {QByteArray(), QByteArray(), QUuid(), 0, 0}));
+    QVERIFY(peer->waitForDisconnected(15000));
+    QVERIFY(peer->messages.isEmpty());
+    delete peer;
+}
+
+void TestReplication::backlogCatchUp()
+{
+    startPrimary();
+
+    TestPeer *peer = connectStandby();
+    QVERIFY(authenticate(peer, m_secret));
+    ReplicationMessage snapshotBegin;
+    QVERIFY(peer->waitForMessage(ReplicationMessage::TypeSnapshotBegin, &snapshotBegin));
+    ReplicationMessage snapshotEnd;
+    QVERIFY(peer->waitForMessage(ReplicationMessage::TypeSnapshotEnd, &snapshotEnd));
+    QUuid epoch = snapshotBegin.arguments.value(0).toUuid();
+    quint64 sequence = snapshotEnd.arguments.value(0).toULongLong();
+    delete peer;
+
+    // Changes made while the standby is away are sent from the backlog when it comes back
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.setValue("ReplicationTest/value", 42);
+    QTRY_VERIFY(m_primary->statistics().value("sequence").toULongLong() > sequence);
+
+    peer = connectStandby();
+    QVERIFY(authenticate(peer, m_secret, epoch, sequence));
+
+    bool found = false;
+    QElapsedTimer timer;
+    timer.start();
+    while (!found && timer.elapsed() < 5000) {
+        ReplicationMessage message;
+        if (!peer->waitForMessage(ReplicationMessage::TypeRecords, &message)) {
+            break;
+        }
+        foreach (const ReplicationRecord &record, message.records) {
+            QVERIFY(record.sequence > sequence);
+            if (record.type == ReplicationRecord::TypeSettingChanged && record.arguments.value(1).toString() == "ReplicationTest/value") {
+                QCOMPARE(record.arguments.value(2).toInt(), 42);
+                found = true;
+            }
+        }
+    }
+    QVERIFY(found);
+    QCOMPARE(m_primary->statistics().value("snapshotsSent").toInt(), 1);
+    delete peer;
+}
+
+void TestReplication::backlogNotCovering()
+{
+    startPrimary(2);
+
+    TestPeer *peer = connectStandby();
+    QVERIFY(authenticate(peer, m_secret));
+    ReplicationMessage snapshotBegin;
+    QVERIFY(peer->waitForMessage(ReplicationMessage::TypeSnapshotBegin, &snapshotBegin));
+    ReplicationMessage snapshotEnd;
+    QVERIFY(peer->waitForMessage(ReplicationMessage::TypeSnapshotEnd, &snapshotEnd));
+    delete peer;
+
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    for (int i = 0; i < 5; i++) {
+        settings.setValue("ReplicationTest/value", i);
+        QTest::qWait(10);
+    }
+    QTRY_VERIFY(m_primary->statistics().value("sequence").toULongLong() >= snapshotEnd.arguments.value(0).toULongLong() + 5);
+
+    // The backlog lost records the standby is missing, it starts over with a snapshot
+    peer = connectStandby();
+    QVERIFY(authenticate(peer, m_secret, snapshotBegin.arguments.value(0).toUuid(), snapshotEnd.arguments.value(0).toULongLong()));
+    QVERIFY(peer->waitForMessage(ReplicationMessage::TypeSnapshotBegin));
+    QCOMPARE(m_primary->statistics().value("snapshotsSent").toInt(), 2);
+    delete peer;
+}
+
+void TestReplication::runFakePrimary(const QByteArray &secret, quint64 term, bool *applied, bool *disconnected)
+{
+    SslServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QSslConfiguration sslConfiguration = NymeaCore::instance()->serverManager()->sslConfiguration();
+    TestPeer *peer = nullptr;
+    connect(&server, &SslServer::socketDescriptorAvailable, this, [&peer, sslConfiguration](qintptr socketDescriptor){
+        // Reconnection attempts of a standby which closed the connection are refused
+        if (peer) {
+            QTcpSocket socket;
+            socket.setSocketDescriptor(socketDescriptor);
+            socket.abort();
+            return;
+        }
+        QSslSocket *socket = new QSslSocket();
+        socket->setSocketDescriptor(socketDescriptor);
+        socket->setSslConfiguration(sslConfiguration);
+        peer = new TestPeer(socket);
+        socket->startServerEncryption();
+    });
+
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Replication");
+    settings.setValue("primary", QString("127.0.0.1:%1").arg(server.serverPort()));
+    settings.setValue("secret", QString::fromUtf8(m_secret));
+    settings.endGroup();
+
+    ReplicationStandby *standby = new ReplicationStandby();
+    QTRY_VERIFY(peer != nullptr);
+    QScopedPointer<TestPeer> peerGuard(peer);
+    QTRY_VERIFY(peer->connection->socket()->isEncrypted());
+
+    QByteArray nonce = ReplicationConnection::createNonce();
+    peer->connection->send(ReplicationMessage(ReplicationMessage::TypeChallenge, {nonce}));
+    ReplicationMessage hello;
+    QVERIFY(peer->waitForMessage(ReplicationMessage::TypeHello, &hello));
+
+    // The standby proves to know the secret
+    QByteArray expected = ReplicationConnection::authenticate(m_secret, ReplicationConnection::RoleStandby, nonce, sslConfiguration.localCertificate());
+    QVERIFY(ReplicationConnection::verify(expected, hello.arguments.value(0).toByteArray()));
+
+    QByteArray proof = ReplicationConnection::authenticate(secret, ReplicationConnection::RolePrimary, hello.arguments.value(1).toByteArray(), sslConfiguration.localCertificate());
+    peer->connection->send(ReplicationMessage(ReplicationMessage::TypeWelcome, {proof, term}));
+
+    ReplicationMessage records(ReplicationMessage::TypeRecords);
+    ReplicationRecord record(ReplicationRecord::TypeSettingChanged, {static_cast<int>(NymeaSettings::SettingsRoleGlobal), "ReplicationTest/applied", true});
+    record.sequence = 1;
+    records.records.append(record);
+    peer->connection->send(records);
+    peer->connection->send(ReplicationMessage(ReplicationMessage::TypeHeartbeat, {1}));
+
+    // An accepted primary gets the heartbeat acknowledged
+    ReplicationMessage ack;
+    bool acked = peer->waitForMessage(ReplicationMessage::TypeAck, &ack, 2000);
+    *disconnected = peer->disconnected;
+    *applied = acked && ack.arguments.value(0).toULongLong() == 1
+            && NymeaSettings(NymeaSettings::SettingsRoleGlobal).value("ReplicationTest/applied").toBool();
+    delete standby;
+}
+
+void TestReplication::standbyAppliesRecords()
+{
+    bool applied = false;
+    bool disconnected = false;
+    runFakePrimary(m_secret, 0, &applied, &disconnected);
+    QVERIFY(applied);
+    QVERIFY(!disconnected);
+
+    // The position is kept for continuing after a restart
+    QUuid epoch;
+    quint64 sequence = 0;
+    quint64 term = 0;
+    QVERIFY(ReplicationStandby::readPosition(&epoch, &sequence, &term));
+    QCOMPARE(sequence, 1ull);
+}
+
+void TestReplication::standbyRejectsSpoofedPrimary()
+{
+    bool applied = true;
+    bool disconnected = false;
+    runFakePrimary("wrong-secret", 0, &applied, &disconnected);
+    QVERIFY(!applied);
+    QVERIFY(disconnected);
+    QVERIFY(!NymeaSettings(NymeaSettings::SettingsRoleGlobal).contains("ReplicationTest/applied"));
+}
+
+void TestReplication::standbyRejectsSupersededPrimary()
+{
+    // This standby has followed a primary of term 3 already
+    QDir().mkpath(NymeaSettings::storagePath());
+    QFile positionFile(ReplicationStandby::positionFileName());
+    QVERIFY(positionFile.open(QFile::WriteOnly | QFile::Truncate));
+    positionFile.write(QUuid::createUuid().toByteArray() + " 0 3");
+    positionFile.close();
+
+    bool applied = true;
+    bool disconnected = false;
+    runFakePrimary(m_secret, 2, &applied, &disconnected);
+    QVERIFY(!applied);
+    QVERIFY(disconnected);
+    QVERIFY(!NymeaSettings(NymeaSettings::SettingsRoleGlobal).contains("ReplicationTest/applied"));
+}
+
+void TestReplication::promotedStandbyServesNextTerm()
+{
+    // This instance has been a standby of a primary of term 4
+    QDir().mkpath(NymeaSettings::storagePath());
+    QFile positionFile(ReplicationStandby::positionFileName());
+    QVERIFY(positionFile.open(QFile::WriteOnly | QFile::Truncate));
+    positionFile.write(QUuid::createUuid().toByteArray() + " 10 4");
+    positionFile.close();
+
+    startPrimary();
+    QCOMPARE(m_primary->statistics().value("term").toULongLong(), 5ull);
+    QVERIFY(!QFile::exists(ReplicationStandby::positionFileName()));
+
+    // The term is kept across restarts
+    delete m_primary;
+    m_primary = nullptr;
+    startPrimary();
+    QCOMPARE(m_primary->statistics().value("term").toULongLong(), 5ull);
+}
+
+void TestReplication::supersededPrimaryStopsReplicating()
+{
+    startPrimary();
+    QCOMPARE(m_primary->statistics().value("term").toULongLong(), 0ull);
+
+    // A standby which followed a newer primary connects
+    TestPeer *peer = connectStandby();
+    QVERIFY(!authenticate(peer, m_secret, QUuid::createUuid(), 0, 1));
+    QVERIFY(peer->waitForDisconnected());
+    delete peer;
+
+    QVERIFY(m_primary->statistics().value("fenced").toBool());
+
+    // Nobody is accepted anymore
+    QSslSocket socket;
+    socket.connectToHost("127.0.0.1", m_primaryPort);
+    QVERIFY(!socket.waitForConnected(2000));
+}
+
+#include "testreplication.moc"
+QTEST_MAIN(TestReplication)
@@ -80,6 +80,8 @@ private slots:
     void editRules_data();
     void editRules();
 
+    void addEditRulesBatch();
+
     void executeRuleActions_data();
     void executeRuleActions();
 
@@ -136,6 +138,8 @@ private slots:
 
     void testScene();
 
+    void testStateHoldTime();
+
     void testHousekeeping_data();
     void testHousekeeping();
 };
@@ -1015,6 +1019,77 @@ void TestRules::editRules()
     QVERIFY2(rules.count() == 0, "There should be no rules.");
 }
 
+void TestRules::addEditRulesBatch()
+{
+    QVariantMap validAction;
+    validAction.insert("actionTypeId", mockWithoutParamsActionTypeId);
+    validAction.insert("thingId", m_mockThingId);
+    QVariantMap invalidAction;
+    invalidAction.insert("actionTypeId", ActionTypeId::createActionTypeId());
+    invalidAction.insert("thingId", m_mockThingId);
+
+    QVariantMap rule1;
+    rule1.insert("name", "Batch rule 1");
+    rule1.insert("eventDescriptors", QVariantList() << createEventDescriptor(m_mockThingId, mockEvent1EventTypeId));
+    rule1.insert("actions", QVariantList() << validAction);
+    QVariantMap rule2;
+    rule2.insert("name", "Batch rule 2");
+    rule2.insert("eventDescriptors", QVariantList() << createEventDescriptor(m_mockThingId, mockEvent1EventTypeId));
+    rule2.insert("actions", QVariantList() << invalidAction);
+
+    // One invalid rule prevents the whole batch from being added
+    QVariantMap params;
+    params.insert("rules", QVariantList() << rule1 << rule2);
+    QVariant response = injectAndWait("Rules.AddRules", params);
+    verifyRuleError(response, RuleEngine::RuleErrorActionTypeNotFound);
+    QCOMPARE(response.toMap().value("params").toMap().value("failedIndex").toInt(), 1);
+
+    response = injectAndWait("Rules.GetRules");
+    QCOMPARE(response.toMap().value("params").toMap().value("ruleDescriptions").toList().count(), 0);
+
+    rule2.insert("actions", QVariantList() << validAction);
+    params.insert("rules", QVariantList() << rule1 << rule2);
+    QSignalSpy notificationSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+    response = injectAndWait("Rules.AddRules", params);
+    verifyRuleError(response);
+    QVariantList ruleIds = response.toMap().value("params").toMap().value("ruleIds").toList();
+    QCOMPARE(ruleIds.count(), 2);
+
+    QVariantList notifications = checkNotifications(notificationSpy, "Rules.RulesAdded");
+    QCOMPARE(notifications.count(), 1);
+    QCOMPARE(notifications.first().toMap().value("params").toMap().value("rules").toList().count(), 2);
+    QCOMPARE(checkNotifications(notificationSpy, "Rules.RuleAdded").count(), 0);
+
+    // Edit both, again rejecting the batch if one of them is unknown
+    rule1.insert("id", ruleIds.at(0));
+    rule1.insert("name", "Batch rule 1 edited");
+    rule2.insert("id", RuleId::createRuleId());
+    rule2.insert("name", "Batch rule 2 edited");
+    params.insert("rules", QVariantList() << rule1 << rule2);
+    response = injectAndWait("Rules.EditRules", params);
+    verifyRuleError(response, RuleEngine::RuleErrorRuleNotFound);
+    QCOMPARE(response.toMap().value("params").toMap().value("failedIndex").toInt(), 1);
+
+    rule2.insert("id", ruleIds.at(1));
+    params.insert("rules", QVariantList() << rule1 << rule2);
+    response = injectAndWait("Rules.EditRules", params);
+    verifyRuleError(response);
+    QVariantList editedRules = response.toMap().value("params").toMap().value("rules").toList();
+    QCOMPARE(editedRules.count(), 2);
+    QCOMPARE(editedRules.at(0).toMap().value("name").toString(), QString("Batch rule 1 edited"));
+    QCOMPARE(editedRules.at(1).toMap().value("name").toString(), QString("Batch rule 2 edited"));
+
+    // The edited rules survive a restart
+    restartServer();
+    foreach (const QVariant &ruleId, ruleIds) {
+        QVariantMap detailsParams;
+        detailsParams.insert("ruleId", ruleId);
+        response = injectAndWait("Rules.GetRuleDetails", detailsParams);
+        verifyRuleError(response);
+        QVERIFY(response.toMap().value("params").toMap().value("rule").toMap().value("name").toString().endsWith("edited"));
+    }
+}
+
 void TestRules::executeRuleActions_data()
 {
     QTest::addColumn<QVariantMap>("params");
@@ -3262,6 +3337,92 @@ void TestRules::testScene()
     verifyRuleNotExecuted();
 }
 
+void TestRules::testStateHoldTime()
+{
+    NymeaCore::instance()->timeManager()->stopTimer();
+    QDateTime now = QDateTime::currentDateTime();
+    NymeaCore::instance()->timeManager()->setTime(now);
+
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+
+    // set int state to 10 initially
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockIntStateTypeId.toString()).arg(10)));
+    QNetworkReply *reply = nam.get(request);
+    spy.wait();
+    QCOMPARE(spy.count(), 1);
+    reply->deleteLater();
+
+    // Add a rule which requires the state to stay >= 50 for a minute, releasing only below 40
+    QVariantMap stateDescriptor;
+    stateDescriptor.insert("thingId", m_mockThingId);
+    stateDescriptor.insert("operator", enumValueName(Types::ValueOperatorGreaterOrEqual));
+    stateDescriptor.insert("stateTypeId", mockIntStateTypeId);
+    stateDescriptor.insert("value", 50);
+    stateDescriptor.insert("holdTime", 60);
+    stateDescriptor.insert("hysteresis", 10);
+    QVariantMap stateEvaluator;
+    stateEvaluator.insert("stateDescriptor", stateDescriptor);
+
+    QVariantMap action;
+    action.insert("actionTypeId", mockWithoutParamsActionTypeId);
+    action.insert("thingId", m_mockThingId);
+
+    QVariantMap addRuleParams;
+    addRuleParams.insert("name", "TestHoldTime");
+    addRuleParams.insert("stateEvaluator", stateEvaluator);
+    addRuleParams.insert("actions", QVariantList() << action);
+    QVariant response = injectAndWait("Rules.AddRule", addRuleParams);
+    verifyRuleError(response);
+    RuleId ruleId = RuleId(response.toMap().value("params").toMap().value("ruleId").toString());
+
+    // Cross the threshold, the rule must not fire before the hold time passed
+    spy.clear();
+    request.setUrl(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockIntStateTypeId.toString()).arg(60)));
+    reply = nam.get(request);
+    spy.wait();
+    QCOMPARE(spy.count(), 1);
+    reply->deleteLater();
+
+    verifyRuleNotExecuted();
+
+    NymeaCore::instance()->timeManager()->setTime(now.addSecs(30));
+    verifyRuleNotExecuted();
+
+    NymeaCore::instance()->timeManager()->setTime(now.addSecs(61));
+    verifyRuleExecuted(mockWithoutParamsActionTypeId);
+
+    cleanupMockHistory();
+
+    // Dropping within the hysteresis band keeps the rule active
+    spy.clear();
+    request.setUrl(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockIntStateTypeId.toString()).arg(45)));
+    reply = nam.get(request);
+    spy.wait();
+    QCOMPARE(spy.count(), 1);
+    reply->deleteLater();
+
+    QVariantMap params;
+    params.insert("ruleId", ruleId);
+    response = injectAndWait("Rules.GetRuleDetails", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("rule").toMap().value("active").toBool(), true);
+    verifyRuleNotExecuted();
+
+    // Dropping below the band releases it
+    spy.clear();
+    request.setUrl(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockIntStateTypeId.toString()).arg(30)));
+    reply = nam.get(request);
+    spy.wait();
+    QCOMPARE(spy.count(), 1);
+    reply->deleteLater();
+
+    response = injectAndWait("Rules.GetRuleDetails", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("rule").toMap().value("active").toBool(), false);
+
+    response = injectAndWait("Rules.RemoveRule", params);
+    verifyRuleError(response);
+}
+
 void TestRules::testHousekeeping_data()
 {
     QTest::addColumn<bool>("testAction");
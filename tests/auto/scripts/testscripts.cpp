@@ -36,6 +36,7 @@
 #include "scriptengine/scriptengine.h"
 
 #include <QtQml/qqml.h>
+#include <QDir>
 
 using namespace nymeaserver;
 
@@ -73,6 +74,12 @@ private slots:
 
     void testInterfaceEvent();
     void testInterfaceAction();
+
+    void testIsolatedScript();
+
+    void testStateGroup();
+
+    void testScriptCache();
 };
 
 
@@ -460,6 +467,102 @@ void TestScripts::testInterfaceAction()
 
 }
 
+void TestScripts::testIsolatedScript()
+{
+    // Turns power off again whenever it has been turned on, running in its own thread
+    QString script = QString("import QtQuick 2.0\n"
+                            "import nymea 1.0\n"
+                            "Item {\n"
+                            "    ThingState {\n"
+                            "        id: powerState\n"
+                            "        thingId: \"%1\"\n"
+                            "        stateTypeId: \"%2\"\n"
+                            "    }\n"
+                            "    ThingEvent {\n"
+                            "        thingId: \"%1\"\n"
+                            "        eventTypeId: \"%3\"\n"
+                            "        onTriggered: {\n"
+                            "            if (powerState.value === true) {\n"
+                            "                powerState.value = false\n"
+                            "            }\n"
+                            "        }\n"
+                            "    }\n"
+                            "}\n").arg(m_mockThingId.toString()).arg(mockPowerStateTypeId.toString()).arg(mockPowerEventTypeId.toString());
+
+    qCDebug(dcTests()) << "Adding script:\n" << qUtf8Printable(script);
+    ScriptEngine::AddScriptReply reply = NymeaCore::instance()->scriptEngine()->addScript("TestIsolated", script.toUtf8(), true);
+    QCOMPARE(reply.scriptError, ScriptEngine::ScriptErrorNoError);
+    QCOMPARE(NymeaCore::instance()->scriptEngine()->scripts().first().isolated(), true);
+
+    QSignalSpy spy(NymeaCore::instance()->thingManager(), &ThingManager::thingStateChanged);
+
+    Action action(mockPowerActionTypeId, m_mockThingId);
+    action.setParams(ParamList() << Param(mockPowerActionPowerParamTypeId, true));
+    NymeaCore::instance()->thingManager()->executeAction(action);
+
+    QTRY_VERIFY_WITH_TIMEOUT(spy.count() >= 2, 5000);
+    QCOMPARE(spy.first().at(2).toBool(), true);
+    QCOMPARE(spy.last().at(2).toBool(), false);
+}
+
+void TestScripts::testStateGroup()
+{
+    QString script = QString("import QtQuick 2.0\n"
+                            "import nymea 1.0\n"
+                            "Item {\n"
+                            "    ThingStateGroup {\n"
+                            "        ThingState {\n"
+                            "            thingId: \"%1\"\n"
+                            "            stateTypeId: \"%2\"\n"
+                            "        }\n"
+                            "        ThingState {\n"
+                            "            thingId: \"%1\"\n"
+                            "            stateTypeId: \"%3\"\n"
+                            "        }\n"
+                            "        onTriggered: console.log(\"Changed states: \" + changedStates.length)\n"
+                            "    }\n"
+                            "}\n").arg(m_mockThingId.toString()).arg(mockPowerStateTypeId.toString()).arg(mockBatteryLevelStateTypeId.toString());
+
+    qCDebug(dcTests()) << "Adding script:\n" << qUtf8Printable(script);
+    ScriptEngine::AddScriptReply reply = NymeaCore::instance()->scriptEngine()->addScript("TestStateGroup", script.toUtf8());
+    QCOMPARE(reply.scriptError, ScriptEngine::ScriptErrorNoError);
+
+    QSignalSpy spy(NymeaCore::instance()->scriptEngine(), &ScriptEngine::scriptConsoleMessage);
+
+    // Both changes happen within the same event loop iteration and are delivered together
+    Action powerAction(mockPowerActionTypeId, m_mockThingId);
+    powerAction.setParams(ParamList() << Param(mockPowerActionPowerParamTypeId, true));
+    NymeaCore::instance()->thingManager()->executeAction(powerAction);
+    Action batteryAction(mockBatteryLevelActionTypeId, m_mockThingId);
+    batteryAction.setParams(ParamList() << Param(mockBatteryLevelActionBatteryLevelParamTypeId, 42));
+    NymeaCore::instance()->thingManager()->executeAction(batteryAction);
+
+    QTRY_COMPARE(spy.count(), 1);
+    QVERIFY(spy.first().at(2).toString().endsWith("Changed states: 2"));
+}
+
+void TestScripts::testScriptCache()
+{
+    QString script = "import QtQuick 2.0\nItem {\n}\n";
+    ScriptEngine::AddScriptReply reply = NymeaCore::instance()->scriptEngine()->addScript("TestCache", script.toUtf8());
+    QCOMPARE(reply.scriptError, ScriptEngine::ScriptErrorNoError);
+
+    QDir cacheDir(NymeaSettings::storagePath() + "/scripts/cache/");
+    QString basename = reply.script.id().toString().remove(QRegExp("[{}]"));
+    QStringList entries = cacheDir.entryList({basename + ".*.qml"}, QDir::Files);
+    QCOMPARE(entries.count(), 1);
+
+    // Editing the script replaces the cached copy keyed by the old content
+    QString editedScript = "import QtQuick 2.0\nItem {\n    property int foo: 1\n}\n";
+    ScriptEngine::EditScriptReply editReply = NymeaCore::instance()->scriptEngine()->editScript(reply.script.id(), editedScript.toUtf8());
+    QCOMPARE(editReply.scriptError, ScriptEngine::ScriptErrorNoError);
+    QStringList editedEntries = cacheDir.entryList({basename + ".*.qml"}, QDir::Files);
+    QCOMPARE(editedEntries.count(), 1);
+    QVERIFY(editedEntries.first() != entries.first());
+
+    QCOMPARE(NymeaCore::instance()->scriptEngine()->removeScript(reply.script.id()), ScriptEngine::ScriptErrorNoError);
+    QCOMPARE(cacheDir.entryList({basename + ".*"}, QDir::Files).count(), 0);
+}
 
 #include "testscripts.moc"
 QTEST_MAIN(TestScripts)
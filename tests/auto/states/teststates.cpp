@@ -31,6 +31,8 @@
 #include "nymeatestbase.h"
 #include "nymeacore.h"
 #include "jsonrpc/devicehandler.h"
+#include "integrations/thingstatecache.h"
+#include "nymeasettings.h"
 
 using namespace nymeaserver;
 
@@ -44,9 +46,34 @@ private slots:
     void getStateValue_data();
     void getStateValue();
 
+    void stateAccessors();
+    void eventAccessors();
+    void actionAccessors();
+
     void save_load_states();
+    void migrateLegacyStates();
+    void corruptStateCache();
+
+private:
+    int mockIntStateValue();
+    static void removeStateCache();
 };
 
+int TestStates::mockIntStateValue()
+{
+    QVariantMap params;
+    params.insert("deviceId", m_mockThingId);
+    params.insert("stateTypeId", mockIntStateTypeId);
+    QVariant response = injectAndWait("Devices.GetStateValue", params);
+    return response.toMap().value("params").toMap().value("value").toInt();
+}
+
+void TestStates::removeStateCache()
+{
+    QFile::remove(ThingStateCache::defaultFileName());
+    QFile::remove(ThingStateCache::journalFileName(ThingStateCache::defaultFileName()));
+}
+
 void TestStates::getStateTypes()
 {
     QVariantMap params;
@@ -86,6 +113,80 @@ void TestStates::getStateValue()
     verifyError(response, "deviceError", enumValueName(error));
 }
 
+void TestStates::stateAccessors()
+{
+    ThingClass mockThingClass = NymeaCore::instance()->thingManager()->findThingClass(mockThingClassId);
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QVERIFY(thing);
+
+    // The generated index is the position of the state in the thing class
+    QCOMPARE(mockIntState.stateTypeId(), mockIntStateTypeId);
+    QCOMPARE(mockThingClass.stateTypes().at(mockIntState.index()).id(), mockIntStateTypeId);
+    QCOMPARE(mockThingClass.stateTypes().at(mockPowerState.index()).id(), mockPowerStateTypeId);
+    QCOMPARE(mockThingClass.stateTypes().at(mockBatteryLevelState.index()).id(), mockBatteryLevelStateTypeId);
+    QCOMPARE(mockThingClass.stateTypes().at(mockUpdateStatusState.index()).id(), mockUpdateStatusStateTypeId);
+
+    int newIntValue = thing->stateValue(mockIntStateTypeId).toInt() + 1;
+    mockIntState.set(thing, newIntValue);
+    QCOMPARE(thing->stateValue(mockIntStateTypeId).toInt(), newIntValue);
+    QCOMPARE(mockIntState.value(thing), newIntValue);
+    QCOMPARE(mockIntStateValue(), newIntValue);
+
+    bool newBoolValue = !thing->stateValue(mockBoolStateTypeId).toBool();
+    thing->setStateValue(mockBoolStateTypeId, newBoolValue);
+    QCOMPARE(mockBoolState.value(thing), newBoolValue);
+}
+
+void TestStates::eventAccessors()
+{
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QVERIFY(thing);
+
+    QList<Event> events;
+    QMetaObject::Connection connection = connect(thing, &Thing::eventTriggered, this, [&events](const Event &event){
+        events.append(event);
+    });
+
+    QCOMPARE(mockEvent2Event.eventTypeId(), mockEvent2EventTypeId);
+    mockEvent2Event.emitEvent(thing, ParamList() << mockEvent2EventIntParamParam.param(42));
+    disconnect(connection);
+
+    QCOMPARE(events.count(), 1);
+    QCOMPARE(events.first().eventTypeId(), mockEvent2EventTypeId);
+    QCOMPARE(events.first().thingId(), m_mockThingId);
+    QCOMPARE(mockEvent2EventIntParamParam.value(events.first().params()), 42);
+}
+
+void TestStates::actionAccessors()
+{
+    Param param = mockPowerActionPowerParam.param(true);
+    QCOMPARE(param.paramTypeId(), mockPowerActionPowerParamTypeId);
+    QCOMPARE(param.value(), QVariant(true));
+    QCOMPARE(mockPowerActionPowerParam.value(ParamList() << param), true);
+
+    Action action(mockPowerActionTypeId, m_mockThingId);
+    action.setParams(ParamList() << param);
+    QCOMPARE(mockPowerAction.actionTypeId(), mockPowerActionTypeId);
+    QVERIFY(mockPowerAction.matches(action));
+    QVERIFY(!mockBatteryLevelAction.matches(action));
+
+    // The mock plugin handles the power action with the accessors
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QVERIFY(thing);
+    foreach (bool power, QList<bool>() << true << false) {
+        QVariantMap actionParam;
+        actionParam.insert("paramTypeId", mockPowerActionPowerParamTypeId);
+        actionParam.insert("value", power);
+        QVariantMap params;
+        params.insert("actionTypeId", mockPowerActionTypeId);
+        params.insert("deviceId", m_mockThingId);
+        params.insert("params", QVariantList() << actionParam);
+        QVariant response = injectAndWait("Actions.ExecuteAction", params);
+        verifyError(response, "deviceError", enumValueName(Device::DeviceErrorNoError));
+        QCOMPARE(mockPowerState.value(thing), power);
+    }
+}
+
 void TestStates::save_load_states()
 {
     ThingClass mockDeviceClass = NymeaCore::instance()->thingManager()->findThingClass(mockThingClassId);
@@ -140,5 +241,63 @@ void TestStates::save_load_states()
     QCOMPARE(response.toMap().value("params").toMap().value("value").toBool(), mockDeviceClass.getStateType(mockBoolStateTypeId).defaultValue().toBool());
 }
 
+void TestStates::migrateLegacyStates()
+{
+    ThingClass mockThingClass = NymeaCore::instance()->thingManager()->findThingClass(mockThingClassId);
+    int legacyValue = mockThingClass.getStateType(mockIntStateTypeId).defaultValue().toInt() + 5;
+
+    // Earlier versions kept the states in thingstates.conf, the snapshot didn't exist yet
+    restartServer([this, legacyValue](){
+        removeStateCache();
+        NymeaSettings settings(NymeaSettings::SettingsRoleThingStates);
+        settings.clear();
+        settings.beginGroup(m_mockThingId.toString());
+        settings.beginGroup(mockIntStateTypeId.toString());
+        settings.setValue("value", legacyValue);
+        settings.endGroup();
+        settings.endGroup();
+        settings.sync();
+    });
+    QCOMPARE(mockIntStateValue(), legacyValue);
+
+    // The migrated states are in the snapshot now, thingstates.conf is not needed anymore
+    restartServer([](){
+        QVERIFY(QFile::exists(ThingStateCache::defaultFileName()));
+        NymeaSettings settings(NymeaSettings::SettingsRoleThingStates);
+        settings.clear();
+        settings.sync();
+    });
+    QCOMPARE(mockIntStateValue(), legacyValue);
+}
+
+void TestStates::corruptStateCache()
+{
+    ThingClass mockThingClass = NymeaCore::instance()->thingManager()->findThingClass(mockThingClassId);
+    int defaultValue = mockThingClass.getStateType(mockIntStateTypeId).defaultValue().toInt();
+
+    // A snapshot cut short, e.g. by a full disk, is ignored and the states start from their defaults
+    restartServer([](){
+        QFile file(ThingStateCache::defaultFileName());
+        QVERIFY(file.open(QFile::ReadWrite));
+        QVERIFY(file.resize(file.size() / 2));
+    });
+    QCOMPARE(mockIntStateValue(), defaultValue);
+    QVERIFY(NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId));
+
+    // The same goes for a file which isn't a snapshot at all
+    restartServer([](){
+        removeStateCache();
+        QFile file(ThingStateCache::defaultFileName());
+        QVERIFY(file.open(QFile::WriteOnly));
+        file.write(QByteArray(256, 'x'));
+    });
+    QCOMPARE(mockIntStateValue(), defaultValue);
+    QVERIFY(NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId));
+
+    // Once the broken file has been replaced the states are cached again
+    restartServer();
+    QVERIFY(ThingStateCache(ThingStateCache::defaultFileName()).open());
+}
+
 #include "teststates.moc"
 QTEST_MAIN(TestStates)
@@ -0,0 +1,331 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "integrations/thingstatecache.h"
+#include "nymeasettings.h"
+
+#include <QtTest>
+
+class TestThingStateCache: public QObject
+{
+    Q_OBJECT
+
+private:
+    QString m_fileName = "/tmp/nymea-test/testthingstates.cache";
+
+    static ThingStateCache::ThingStates states(int value);
+    void removeFiles();
+
+private slots:
+    void initTestCase();
+    void init();
+
+    void writeSnapshot();
+    void appendChanges();
+    void removeThings();
+    void compactJournal();
+    void outdatedJournal();
+    void truncatedJournal();
+    void truncatedSnapshot();
+    void corruptSnapshot();
+    void legacySettings();
+};
+
+ThingStateCache::ThingStates TestThingStateCache::states(int value)
+{
+    ThingStateCache::CachedState state;
+    state.value = value;
+    state.minValue = 0;
+    state.maxValue = 100;
+    ThingStateCache::ThingStates states;
+    states.insert(StateTypeId("{a0d4a43e-9ebb-4a43-b0a4-ab7bd1ca7e3d}"), state);
+    return states;
+}
+
+void TestThingStateCache::removeFiles()
+{
+    QFile::remove(m_fileName);
+    QFile::remove(ThingStateCache::journalFileName(m_fileName));
+}
+
+void TestThingStateCache::initTestCase()
+{
+    // Important for settings
+    QCoreApplication::instance()->setOrganizationName("nymea-test");
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+}
+
+void TestThingStateCache::init()
+{
+    removeFiles();
+}
+
+void TestThingStateCache::writeSnapshot()
+{
+    ThingStateCache::Snapshot snapshot;
+    ThingId thingId = ThingId::createThingId();
+    snapshot.insert(thingId, states(42));
+    QVERIFY(ThingStateCache::write(m_fileName, snapshot));
+
+    ThingStateCache cache(m_fileName);
+    QVERIFY(cache.open());
+    QCOMPARE(cache.thingIds(), QList<ThingId>({thingId}));
+    ThingStateCache::CachedState state = cache.states(thingId).values().first();
+    QCOMPARE(state.value.toInt(), 42);
+    QCOMPARE(state.minValue.toInt(), 0);
+    QCOMPARE(state.maxValue.toInt(), 100);
+}
+
+void TestThingStateCache::appendChanges()
+{
+    ThingStateCache::Snapshot snapshot;
+    ThingId changedThingId = ThingId::createThingId();
+    ThingId unchangedThingId = ThingId::createThingId();
+    snapshot.insert(changedThingId, states(1));
+    snapshot.insert(unchangedThingId, states(2));
+    QVERIFY(ThingStateCache::write(m_fileName, snapshot));
+    QByteArray snapshotData;
+    {
+        QFile file(m_fileName);
+        QVERIFY(file.open(QFile::ReadOnly));
+        snapshotData = file.readAll();
+    }
+
+    // Only the journal grows, the snapshot stays untouched
+    qint64 journalSize = QFileInfo(ThingStateCache::journalFileName(m_fileName)).size();
+    for (int i = 0; i < 10; i++) {
+        snapshot.insert(changedThingId, states(10 + i));
+        QVERIFY(ThingStateCache::writeChanges(m_fileName, snapshot, {changedThingId}, {}));
+    }
+    ThingId addedThingId = ThingId::createThingId();
+    snapshot.insert(addedThingId, states(3));
+    QVERIFY(ThingStateCache::writeChanges(m_fileName, snapshot, {addedThingId}, {}));
+    QVERIFY(QFileInfo(ThingStateCache::journalFileName(m_fileName)).size() > journalSize);
+    {
+        QFile file(m_fileName);
+        QVERIFY(file.open(QFile::ReadOnly));
+        QCOMPARE(file.readAll(), snapshotData);
+    }
+
+    ThingStateCache cache(m_fileName);
+    QVERIFY(cache.open());
+    QCOMPARE(cache.thingIds().count(), 3);
+    QCOMPARE(cache.states(changedThingId).values().first().value.toInt(), 19);
+    QCOMPARE(cache.states(unchangedThingId).values().first().value.toInt(), 2);
+    QCOMPARE(cache.states(addedThingId).values().first().value.toInt(), 3);
+    QVERIFY(!cache.journalTruncated());
+}
+
+void TestThingStateCache::removeThings()
+{
+    ThingStateCache::Snapshot snapshot;
+    ThingId keptThingId = ThingId::createThingId();
+    ThingId removedThingId = ThingId::createThingId();
+    snapshot.insert(keptThingId, states(1));
+    snapshot.insert(removedThingId, states(2));
+    QVERIFY(ThingStateCache::write(m_fileName, snapshot));
+
+    snapshot.remove(removedThingId);
+    QVERIFY(ThingStateCache::writeChanges(m_fileName, snapshot, {}, {removedThingId}));
+
+    ThingStateCache cache(m_fileName);
+    QVERIFY(cache.open());
+    QCOMPARE(cache.thingIds(), QList<ThingId>({keptThingId}));
+    QVERIFY(cache.states(removedThingId).isEmpty());
+
+    // A thing coming back after its removal is found again
+    snapshot.insert(removedThingId, states(5));
+    QVERIFY(ThingStateCache::writeChanges(m_fileName, snapshot, {removedThingId}, {}));
+    QVERIFY(cache.open());
+    QCOMPARE(cache.thingIds().count(), 2);
+    QCOMPARE(cache.states(removedThingId).values().first().value.toInt(), 5);
+}
+
+void TestThingStateCache::compactJournal()
+{
+    ThingStateCache::Snapshot snapshot;
+    ThingId thingId = ThingId::createThingId();
+    snapshot.insert(thingId, states(0));
+    QVERIFY(ThingStateCache::write(m_fileName, snapshot));
+    QString journalFileName = ThingStateCache::journalFileName(m_fileName);
+    qint64 emptyJournalSize = QFileInfo(journalFileName).size();
+
+    // Once the journal outgrows the snapshot, a new snapshot replaces both
+    qint64 largestJournalSize = 0;
+    int i = 0;
+    for (; i < 10000; i++) {
+        snapshot.insert(thingId, states(i));
+        QVERIFY(ThingStateCache::writeChanges(m_fileName, snapshot, {thingId}, {}));
+        qint64 journalSize = QFileInfo(journalFileName).size();
+        if (journalSize < largestJournalSize) {
+            break;
+        }
+        largestJournalSize = journalSize;
+    }
+    QVERIFY2(i < 10000, "The journal has never been compacted");
+    QCOMPARE(QFileInfo(journalFileName).size(), emptyJournalSize);
+
+    ThingStateCache cache(m_fileName);
+    QVERIFY(cache.open());
+    QCOMPARE(cache.states(thingId).values().first().value.toInt(), i);
+}
+
+void TestThingStateCache::outdatedJournal()
+{
+    ThingStateCache::Snapshot snapshot;
+    ThingId thingId = ThingId::createThingId();
+    snapshot.insert(thingId, states(1));
+    QVERIFY(ThingStateCache::write(m_fileName, snapshot));
+    snapshot.insert(thingId, states(2));
+    QVERIFY(ThingStateCache::writeChanges(m_fileName, snapshot, {thingId}, {}));
+
+    // A compaction interrupted after writing the new snapshot leaves the old journal behind
+    QString journalFileName = ThingStateCache::journalFileName(m_fileName);
+    QVERIFY(QFile::copy(journalFileName, journalFileName + ".old"));
+    snapshot.insert(thingId, states(3));
+    QVERIFY(ThingStateCache::write(m_fileName, snapshot));
+    QVERIFY(QFile::remove(journalFileName));
+    QVERIFY(QFile::rename(journalFileName + ".old", journalFileName));
+
+    ThingStateCache cache(m_fileName);
+    QVERIFY(cache.open());
+    QCOMPARE(cache.states(thingId).values().first().value.toInt(), 3);
+
+    // Changes are never appended to it, the next write starts over with a complete snapshot
+    snapshot.insert(thingId, states(4));
+    QVERIFY(ThingStateCache::writeChanges(m_fileName, snapshot, {thingId}, {}));
+    QVERIFY(cache.open());
+    QCOMPARE(cache.states(thingId).values().first().value.toInt(), 4);
+}
+
+void TestThingStateCache::truncatedJournal()
+{
+    ThingStateCache::Snapshot snapshot;
+    ThingId thingId = ThingId::createThingId();
+    snapshot.insert(thingId, states(1));
+    QVERIFY(ThingStateCache::write(m_fileName, snapshot));
+    snapshot.insert(thingId, states(2));
+    QVERIFY(ThingStateCache::writeChanges(m_fileName, snapshot, {thingId}, {}));
+    snapshot.insert(thingId, states(3));
+    QVERIFY(ThingStateCache::writeChanges(m_fileName, snapshot, {thingId}, {}));
+
+    // Power loss while appending the last change
+    QFile journal(ThingStateCache::journalFileName(m_fileName));
+    QVERIFY(journal.open(QFile::ReadWrite));
+    QVERIFY(journal.resize(journal.size() - 5));
+    journal.close();
+
+    ThingStateCache cache(m_fileName);
+    QVERIFY(cache.open());
+    QVERIFY(cache.journalTruncated());
+    QCOMPARE(cache.states(thingId).values().first().value.toInt(), 2);
+}
+
+void TestThingStateCache::truncatedSnapshot()
+{
+    ThingStateCache::Snapshot snapshot;
+    for (int i = 0; i < 10; i++) {
+        snapshot.insert(ThingId::createThingId(), states(i));
+    }
+    QVERIFY(ThingStateCache::write(m_fileName, snapshot));
+
+    QFile file(m_fileName);
+    QVERIFY(file.open(QFile::ReadWrite));
+    QVERIFY(file.resize(file.size() - 10));
+    file.close();
+
+    ThingStateCache cache(m_fileName);
+    QVERIFY(!cache.open());
+    QVERIFY(!cache.isOpen());
+    QVERIFY(cache.thingIds().isEmpty());
+
+    // The thing manager writes a complete snapshot whenever the cache failed to open
+    QVERIFY(ThingStateCache::write(m_fileName, snapshot));
+    QVERIFY(cache.open());
+    QCOMPARE(cache.thingIds().count(), 10);
+}
+
+void TestThingStateCache::corruptSnapshot()
+{
+    QFile file(m_fileName);
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.write(QByteArray(1024, 'x'));
+    file.close();
+
+    ThingStateCache cache(m_fileName);
+    QVERIFY(!cache.open());
+
+    // An empty file is not a snapshot either
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    file.close();
+    QVERIFY(!cache.open());
+}
+
+void TestThingStateCache::legacySettings()
+{
+    ThingId thingId = ThingId::createThingId();
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+    StateTypeId oldStateTypeId = StateTypeId::createStateTypeId();
+
+    NymeaSettings settings(NymeaSettings::SettingsRoleThingStates);
+    settings.clear();
+    settings.beginGroup(thingId.toString());
+    settings.beginGroup(stateTypeId.toString());
+    settings.setValue("value", 21);
+    settings.setValue("minValue", 5);
+    settings.setValue("maxValue", 30);
+    settings.endGroup();
+    // Before 0.30 only the value was stored, straight under the thing
+    settings.setValue(oldStateTypeId.toString(), "on");
+    settings.endGroup();
+    settings.sync();
+
+    ThingStateCache::Snapshot snapshot = ThingStateCache::loadLegacySettings();
+    QCOMPARE(snapshot.keys(), QList<ThingId>({thingId}));
+    ThingStateCache::ThingStates thingStates = snapshot.value(thingId);
+    QCOMPARE(thingStates.count(), 2);
+    QCOMPARE(thingStates.value(stateTypeId).value.toInt(), 21);
+    QCOMPARE(thingStates.value(stateTypeId).minValue.toInt(), 5);
+    QCOMPARE(thingStates.value(stateTypeId).maxValue.toInt(), 30);
+    QVERIFY(thingStates.value(stateTypeId).hasLimits);
+    QCOMPARE(thingStates.value(oldStateTypeId).value.toString(), QString("on"));
+    QVERIFY(!thingStates.value(oldStateTypeId).hasLimits);
+
+    // The migrated states survive a round trip through the snapshot
+    QVERIFY(ThingStateCache::write(m_fileName, snapshot));
+    ThingStateCache cache(m_fileName);
+    QVERIFY(cache.open());
+    QCOMPARE(cache.states(thingId).value(stateTypeId).value.toInt(), 21);
+
+    settings.clear();
+}
+
+#include "testthingstatecache.moc"
+QTEST_MAIN(TestThingStateCache)
@@ -0,0 +1,6 @@
+TARGET = testthingstatecache
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testthingstatecache.cpp
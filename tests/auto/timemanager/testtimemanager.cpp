@@ -31,6 +31,8 @@
 #include "nymeatestbase.h"
 #include "nymeacore.h"
 #include "servers/mocktcpserver.h"
+#include "time/deadlinescheduler.h"
+#include "ruleengine/ruleengine.h"
 
 #include "platform/platform.h"
 #include "platform/platformsystemcontroller.h"
@@ -114,6 +116,10 @@ private slots:
 
     void testEnableDisableTimeRule();
 
+    void testDeadlineScheduler();
+
+    void testParallelTimeEvaluation();
+
 private:
     void initTimeManager();
 
@@ -2024,6 +2030,39 @@ void TestTimeManager::testEnableDisableTimeRule()
     verifyRuleError(response);
 }
 
+void TestTimeManager::testDeadlineScheduler()
+{
+    DeadlineScheduler scheduler;
+    QStringList fired;
+    QHash<QString, qint64> firedAt;
+    auto callback = [&](const QString &name) {
+        return [&, name]() {
+            fired.append(name);
+            firedAt.insert(name, scheduler.now());
+        };
+    };
+
+    // "b" may wait for "a", both run in one wake up
+    scheduler.scheduleIn(200, this, callback("a"));
+    scheduler.scheduleIn(100, this, callback("b"), 300);
+    int cancelled = scheduler.scheduleIn(50, this, callback("c"));
+    scheduler.scheduleIn(400, this, callback("d"));
+    QObject *context = new QObject(this);
+    scheduler.scheduleIn(50, context, callback("e"));
+    delete context;
+
+    QVERIFY(scheduler.isScheduled(cancelled));
+    scheduler.cancel(cancelled);
+    QVERIFY(!scheduler.isScheduled(cancelled));
+
+    QTRY_COMPARE(fired.count(), 3);
+    QCOMPARE(fired, QStringList() << "b" << "a" << "d");
+    QVERIFY(firedAt.value("a") - firedAt.value("b") < 50);
+    QVERIFY(firedAt.value("b") >= 200);
+    QVERIFY(firedAt.value("a") >= 200);
+    QVERIFY(firedAt.value("d") >= 400);
+}
+
 void TestTimeManager::initTimeManager()
 {
     cleanupMockHistory();
@@ -2264,5 +2303,73 @@ QVariantMap TestTimeManager::createTimeDescriptorCalendar(const QVariantList &ca
     return timeDescriptorCalendar;
 }
 
+// Time descriptors are evaluated on the thread pool once there are enough rules. Compares an engine evaluating
+// every rule in a partition of its own with one evaluating all of them serially.
+void TestTimeManager::testParallelTimeEvaluation()
+{
+    removeAllRules();
+
+    // Calendar items around now, some of them active, and time events firing within the next hour
+    QTime now = QTime::currentTime();
+    for (int i = 0; i < 40; i++) {
+        TimeDescriptor timeDescriptor;
+        if (i % 2 == 0) {
+            CalendarItem calendarItem;
+            calendarItem.setStartTime(now.addSecs((3 * i - 31) * 60));
+            calendarItem.setDuration(11);
+            calendarItem.setRepeatingOption(RepeatingOption(RepeatingOption::RepeatingModeDaily));
+            timeDescriptor.setCalendarItems(CalendarItems(QList<CalendarItem>() << calendarItem));
+        } else {
+            TimeEventItem timeEventItem;
+            timeEventItem.setTime(now.addSecs(i * 60));
+            timeEventItem.setRepeatingOption(RepeatingOption(RepeatingOption::RepeatingModeDaily));
+            timeDescriptor.setTimeEventItems(TimeEventItems(QList<TimeEventItem>() << timeEventItem));
+        }
+        Rule rule;
+        rule.setId(RuleId::createRuleId());
+        rule.setName(QString("Time rule %1").arg(i));
+        rule.setTimeDescriptor(timeDescriptor);
+        rule.setActions(RuleActions(QList<RuleAction>() << RuleAction(mockWithoutParamsActionTypeId, m_mockThingId)));
+        QCOMPARE(NymeaCore::instance()->ruleEngine()->addRule(rule), RuleEngine::RuleErrorNoError);
+    }
+
+    // Both load the rules stored by the running engine
+    qunsetenv("NYMEA_RULE_ENGINE_PARTITION_SIZE");
+    RuleEngine serialEngine;
+    qputenv("NYMEA_RULE_ENGINE_PARTITION_SIZE", "1");
+    RuleEngine parallelEngine;
+    qunsetenv("NYMEA_RULE_ENGINE_PARTITION_SIZE");
+    serialEngine.init();
+    parallelEngine.init();
+
+    QCOMPARE(parallelEngine.ruleIds(), serialEngine.ruleIds());
+    QCOMPARE(serialEngine.ruleIds().count(), 40);
+    int timeActive = 0;
+    foreach (const RuleId &ruleId, serialEngine.ruleIds()) {
+        QCOMPARE(parallelEngine.ruleState(ruleId).timeActive, serialEngine.ruleState(ruleId).timeActive);
+        timeActive += serialEngine.ruleState(ruleId).timeActive ? 1 : 0;
+    }
+    QVERIFY(timeActive > 0);
+
+    // Minute ticks for the next hour, the rules and their order must match on every tick
+    QDateTime dateTime = QDateTime::currentDateTime();
+    dateTime.setTime(QTime(dateTime.time().hour(), dateTime.time().minute()));
+    int changes = 0;
+    for (int minute = 0; minute < 60; minute++) {
+        QDateTime tick = dateTime.addSecs(minute * 60);
+        QList<RuleId> serialRules = serialEngine.evaluateTime(tick);
+        QList<RuleId> parallelRules = parallelEngine.evaluateTime(tick);
+        QCOMPARE(parallelRules, serialRules);
+        changes += serialRules.count();
+        foreach (const RuleId &ruleId, serialEngine.ruleIds()) {
+            QCOMPARE(parallelEngine.ruleState(ruleId).timeActive, serialEngine.ruleState(ruleId).timeActive);
+            QCOMPARE(parallelEngine.ruleState(ruleId).active, serialEngine.ruleState(ruleId).active);
+        }
+    }
+    QVERIFY(changes > 0);
+
+    removeAllRules();
+}
+
 #include "testtimemanager.moc"
 QTEST_MAIN(TestTimeManager)
@@ -30,6 +30,7 @@
 
 #include "nymeatestbase.h"
 #include "nymeacore.h"
+#include "servers/timeoutwheel.h"
 
 #include <QXmlReader>
 
@@ -48,6 +49,8 @@ private slots:
 
     void multiPackageMessage();
 
+    void pipelinedRequests();
+
     void checkAllowedMethodCall_data();
     void checkAllowedMethodCall();
 
@@ -57,13 +60,23 @@ private slots:
     void getFiles_data();
     void getFiles();
 
+    void getCachedFile();
+    void getStreamedFile();
+
     void getServerDescription();
 
+    void apiStateValues();
+    void apiExecuteAction();
+    void apiEventStream();
+
     void getIcons_data();
     void getIcons();
 
     void getDebugServer_data();
     void getDebugServer();
+    void getDebugMemory();
+
+    void timeoutWheel();
 
 public slots:
     void onSslErrors(const QList<QSslError> &) {
@@ -194,6 +207,54 @@ void TestWebserver::multiPackageMessage()
     socket->deleteLater();
 }
 
+void TestWebserver::pipelinedRequests()
+{
+    QSslSocket *socket = new QSslSocket(this);
+    typedef void (QSslSocket:: *sslErrorsSignal)(const QList<QSslError> &);
+    connect(socket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &TestWebserver::onSslErrors);
+    socket->connectToHostEncrypted("127.0.0.1", 3333);
+    QSignalSpy encryptedSpy(socket, SIGNAL(encrypted()));
+    bool encrypted = encryptedSpy.wait();
+    QVERIFY2(encrypted, "could not created encrypted webserver connection.");
+
+    // Two complete requests and the beginning of a third one in one package
+    QByteArray requestData;
+    requestData.append("GET /server.xml HTTP/1.1\r\n");
+    requestData.append("User-Agent: nymea webserver test\r\n\r\n");
+    requestData.append("PUT / HTTP/1.1\r\n");
+    requestData.append("User-Agent: nymea webserver test\r\n");
+    requestData.append("Content-Length: 5\r\n\r\n");
+    requestData.append("helloGET /server.xml HT");
+
+    quint64 count = socket->write(requestData);
+    QVERIFY2(count > 0, "could not write to webserver.");
+
+    QByteArray data;
+    QSignalSpy clientSpy(socket, SIGNAL(readyRead()));
+    while (data.count("HTTP/1.1 ") < 2 && clientSpy.wait(1000)) {
+        data.append(socket->readAll());
+    }
+    QCOMPARE(data.count("HTTP/1.1 200 Ok"), 1);
+    QCOMPARE(data.count("HTTP/1.1 501 Not Implemented"), 1);
+    QVERIFY2(data.indexOf("HTTP/1.1 200 Ok") < data.indexOf("HTTP/1.1 501"), "replies are not in request order");
+
+    // Complete the third request and close the connection with it
+    data.clear();
+    socket->write("TP/1.1\r\nUser-Agent: nymea webserver test\r\nConnection: close\r\n\r\n");
+    QSignalSpy disconnectedSpy(socket, SIGNAL(disconnected()));
+    while (disconnectedSpy.isEmpty() && clientSpy.wait(1000)) {
+        data.append(socket->readAll());
+    }
+    data.append(socket->readAll());
+    QVERIFY(data.startsWith("HTTP/1.1 200 Ok"));
+    QVERIFY(data.contains("Connection: close"));
+    if (disconnectedSpy.isEmpty())
+        disconnectedSpy.wait(1000);
+    QCOMPARE(disconnectedSpy.count(), 1);
+
+    socket->deleteLater();
+}
+
 void TestWebserver::checkAllowedMethodCall_data()
 {
     QTest::addColumn<QString>("method");
@@ -367,6 +428,110 @@ void TestWebserver::getFiles()
     reply->deleteLater();
 }
 
+void TestWebserver::getCachedFile()
+{
+    QString fileName = QCoreApplication::applicationDirPath() + "/cachetest.0123abcd.js";
+    QFile file(fileName);
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    file.write("console.log(\"cached\");");
+    file.close();
+
+    QNetworkAccessManager nam;
+    connect(&nam, &QNetworkAccessManager::sslErrors, [this, &nam](QNetworkReply* reply, const QList<QSslError> &) {
+        reply->ignoreSslErrors();
+    });
+    QSignalSpy clientSpy(&nam, SIGNAL(finished(QNetworkReply*)));
+
+    QNetworkRequest request;
+    request.setUrl(QUrl("https://localhost:3333/cachetest.0123abcd.js"));
+    QNetworkReply *reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QCOMPARE(reply->readAll(), QByteArray("console.log(\"cached\");"));
+    QVERIFY(reply->rawHeader("Cache-Control").contains("immutable"));
+    QByteArray etag = reply->rawHeader("ETag");
+    QVERIFY(!etag.isEmpty());
+    reply->deleteLater();
+
+    // A conditional request for the same version must not transfer the file again
+    clientSpy.clear();
+    request.setRawHeader("If-None-Match", etag);
+    reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 304);
+    reply->deleteLater();
+
+    // Modifying the file invalidates the cached copy
+    QTest::qWait(1100);
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    file.write("console.log(\"changed\");");
+    file.close();
+
+    clientSpy.clear();
+    reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QCOMPARE(reply->readAll(), QByteArray("console.log(\"changed\");"));
+    QVERIFY(reply->rawHeader("ETag") != etag);
+    reply->deleteLater();
+
+    QFile::remove(fileName);
+}
+
+void TestWebserver::getStreamedFile()
+{
+    // Bigger than what the webserver keeps in memory
+    QByteArray content;
+    for (int i = 0; content.size() < 6 * 1024 * 1024; i++) {
+        content.append(QByteArray::number(i).rightJustified(16, '0'));
+    }
+
+    QString fileName = QCoreApplication::applicationDirPath() + "/streamtest.bin";
+    QFile file(fileName);
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    file.write(content);
+    file.close();
+
+    QNetworkAccessManager nam;
+    connect(&nam, &QNetworkAccessManager::sslErrors, [this, &nam](QNetworkReply* reply, const QList<QSslError> &) {
+        reply->ignoreSslErrors();
+    });
+    QSignalSpy clientSpy(&nam, SIGNAL(finished(QNetworkReply*)));
+
+    QNetworkRequest request;
+    request.setUrl(QUrl("https://localhost:3333/streamtest.bin"));
+    QNetworkReply *reply = nam.get(request);
+    clientSpy.wait(20000);
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QCOMPARE(reply->rawHeader("Accept-Ranges"), QByteArray("bytes"));
+    QCOMPARE(reply->readAll(), content);
+    reply->deleteLater();
+
+    clientSpy.clear();
+    request.setRawHeader("Range", "bytes=1000-1999");
+    reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 206);
+    QCOMPARE(reply->rawHeader("Content-Range"), QByteArray("bytes 1000-1999/") + QByteArray::number(content.size()));
+    QCOMPARE(reply->readAll(), content.mid(1000, 1000));
+    reply->deleteLater();
+
+    clientSpy.clear();
+    request.setRawHeader("Range", "bytes=" + QByteArray::number(content.size()) + "-");
+    reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 416);
+    reply->deleteLater();
+
+    QFile::remove(fileName);
+}
+
 void TestWebserver::getServerDescription()
 {
     QNetworkAccessManager nam;
@@ -382,13 +547,203 @@ void TestWebserver::getServerDescription()
     clientSpy.wait();
     QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
 
+    QByteArray data = reply->readAll();
     QXmlSimpleReader xmlReader; QXmlInputSource xmlSource;
-    xmlSource.setData(reply->readAll());
+    xmlSource.setData(data);
     QVERIFY(xmlReader.parse(xmlSource));
+    QByteArray etag = reply->rawHeader("ETag");
+    QVERIFY(!etag.isEmpty());
+    reply->deleteLater();
+
+    // The cached document is revalidated without sending it again
+    clientSpy.clear();
+    request.setRawHeader("If-None-Match", etag);
+    reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 304);
+    reply->deleteLater();
+
+    // Renaming the server invalidates the cached document
+    QString serverName = NymeaCore::instance()->configuration()->serverName();
+    NymeaCore::instance()->configuration()->setServerName("nymea renamed");
+
+    clientSpy.clear();
+    reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QVERIFY(reply->readAll().contains("<friendlyName>nymea renamed</friendlyName>"));
+    QVERIFY(reply->rawHeader("ETag") != etag);
+    reply->deleteLater();
+
+    NymeaCore::instance()->configuration()->setServerName(serverName);
+}
+
+void TestWebserver::apiStateValues()
+{
+    QNetworkAccessManager nam;
+    connect(&nam, &QNetworkAccessManager::sslErrors, [this, &nam](QNetworkReply* reply, const QList<QSslError> &) {
+        reply->ignoreSslErrors();
+    });
+    QSignalSpy clientSpy(&nam, SIGNAL(finished(QNetworkReply*)));
+
+    // Requests without a token are rejected
+    QNetworkRequest request(QUrl(QString("https://localhost:3333/api/v1/things/%1/states").arg(m_mockThingId.toString())));
+    QNetworkReply *reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 401);
+    reply->deleteLater();
+
+    request.setRawHeader("Authorization", "Bearer " + m_apiToken);
+    clientSpy.clear();
+    reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QVariantMap data = QJsonDocument::fromJson(reply->readAll()).toVariant().toMap();
+    QCOMPARE(data.value("thingError").toString(), QString("ThingErrorNoError"));
+    QVERIFY(!data.value("values").toList().isEmpty());
+    QByteArray etag = reply->rawHeader("ETag");
+    QVERIFY(!etag.isEmpty());
+    reply->deleteLater();
+
+    // Unchanged states are not sent again
+    request.setRawHeader("If-None-Match", etag);
+    clientSpy.clear();
+    reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 304);
+    reply->deleteLater();
+
+    // Change a state on the mock
+    int value = QDateTime::currentMSecsSinceEpoch() % 1000;
+    QNetworkRequest setStateRequest(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockIntStateTypeId.toString()).arg(value)));
+    clientSpy.clear();
+    reply = nam.get(setStateRequest);
+    clientSpy.wait();
+    reply->deleteLater();
+
+    QNetworkRequest stateRequest(QUrl(QString("https://localhost:3333/api/v1/things/%1/states/%2").arg(m_mockThingId.toString()).arg(mockIntStateTypeId.toString())));
+    stateRequest.setRawHeader("Authorization", "Bearer " + m_apiToken);
+    stateRequest.setRawHeader("If-None-Match", etag);
+    clientSpy.clear();
+    reply = nam.get(stateRequest);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    data = QJsonDocument::fromJson(reply->readAll()).toVariant().toMap();
+    QCOMPARE(data.value("value").toInt(), value);
+    QVERIFY(reply->rawHeader("ETag") != etag);
+    reply->deleteLater();
 
+    // Unknown things
+    QNetworkRequest unknownRequest(QUrl(QString("https://localhost:3333/api/v1/things/%1/states").arg(QUuid::createUuid().toString())));
+    unknownRequest.setRawHeader("Authorization", "Bearer " + m_apiToken);
+    clientSpy.clear();
+    reply = nam.get(unknownRequest);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 404);
     reply->deleteLater();
 }
 
+void TestWebserver::apiExecuteAction()
+{
+    QNetworkAccessManager nam;
+    connect(&nam, &QNetworkAccessManager::sslErrors, [this, &nam](QNetworkReply* reply, const QList<QSslError> &) {
+        reply->ignoreSslErrors();
+    });
+    QSignalSpy clientSpy(&nam, SIGNAL(finished(QNetworkReply*)));
+
+    QNetworkRequest request(QUrl(QString("https://localhost:3333/api/v1/things/%1/actions/%2").arg(m_mockThingId.toString()).arg(mockPowerActionTypeId.toString())));
+    request.setRawHeader("Authorization", "Bearer " + m_apiToken);
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+
+    // Actions can't be read
+    QNetworkReply *reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 405);
+    reply->deleteLater();
+
+    QVariantMap param;
+    param.insert("paramTypeId", mockPowerActionPowerParamTypeId);
+    param.insert("value", true);
+    clientSpy.clear();
+    reply = nam.post(request, QJsonDocument::fromVariant(QVariantList() << param).toJson());
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QVariantMap data = QJsonDocument::fromJson(reply->readAll()).toVariant().toMap();
+    QCOMPARE(data.value("thingError").toString(), QString("ThingErrorNoError"));
+    reply->deleteLater();
+
+    // The body needs to be a list of params
+    clientSpy.clear();
+    reply = nam.post(request, "{\"power\": true}");
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 400);
+    reply->deleteLater();
+}
+
+void TestWebserver::apiEventStream()
+{
+    QSslSocket *socket = new QSslSocket(this);
+    typedef void (QSslSocket:: *sslErrorsSignal)(const QList<QSslError> &);
+    connect(socket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &TestWebserver::onSslErrors);
+    socket->connectToHostEncrypted("127.0.0.1", 3333);
+    QSignalSpy encryptedSpy(socket, SIGNAL(encrypted()));
+    bool encrypted = encryptedSpy.wait();
+    QVERIFY2(encrypted, "could not created encrypted webserver connection.");
+
+    // Only subscribe to the int state of the mock
+    QByteArray requestData;
+    requestData.append(QString("GET /api/v1/events?thingId=%1&stateTypeId=%2&token=%3 HTTP/1.1\r\n").arg(m_mockThingId.toString().remove(QRegExp("[{}]"))).arg(mockIntStateTypeId.toString().remove(QRegExp("[{}]"))).arg(QString(m_apiToken)).toUtf8());
+    requestData.append("User-Agent: nymea webserver test\r\n\r\n");
+    QVERIFY2(socket->write(requestData) > 0, "could not write to webserver.");
+
+    QByteArray data;
+    QSignalSpy clientSpy(socket, SIGNAL(readyRead()));
+    while (!data.contains("retry:") && clientSpy.wait(1000)) {
+        data.append(socket->readAll());
+    }
+    QVERIFY(data.startsWith("HTTP/1.1 200 Ok"));
+    QVERIFY(data.contains("Content-Type: text/event-stream"));
+    QVERIFY(data.contains("Transfer-Encoding: chunked"));
+
+    // Change the int state on the mock and wait for the event
+    int value = QDateTime::currentMSecsSinceEpoch() % 1000 + 1000;
+    QNetworkAccessManager nam;
+    QSignalSpy setStateSpy(&nam, SIGNAL(finished(QNetworkReply*)));
+    QNetworkReply *reply = nam.get(QNetworkRequest(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockIntStateTypeId.toString()).arg(value))));
+    setStateSpy.wait();
+    reply->deleteLater();
+
+    data.clear();
+    while (!data.contains("\n\n") && clientSpy.wait(1000)) {
+        data.append(socket->readAll());
+    }
+    QVERIFY2(data.contains("event: Integrations.StateChanged"), data);
+    QVERIFY2(data.contains(QString("\"value\":%1").arg(value).toUtf8()), data);
+    QVERIFY(data.contains(mockIntStateTypeId.toString().remove(QRegExp("[{}]")).toUtf8()));
+
+    // Changes of other states are filtered
+    data.clear();
+    setStateSpy.clear();
+    reply = nam.get(QNetworkRequest(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockBoolStateTypeId.toString()).arg(value % 2 == 0 ? "true" : "false"))));
+    setStateSpy.wait();
+    reply->deleteLater();
+    clientSpy.wait(500);
+    data.append(socket->readAll());
+    QVERIFY2(!data.contains("Integrations.StateChanged"), data);
+
+    socket->deleteLater();
+}
+
 void TestWebserver::getIcons_data()
 {
     QTest::addColumn<QString>("query");
@@ -634,5 +989,69 @@ void TestWebserver::getDebugServer()
     QCOMPARE(statusCode, expectedStatusCode);
 }
 
+void TestWebserver::getDebugMemory()
+{
+    QVariantMap params;
+    params.insert("enabled", true);
+    QVariant response = injectAndWait("Configuration.SetDebugServerEnabled", params);
+    verifyError(response, "configurationError", "ConfigurationErrorNoError");
+
+    QNetworkAccessManager nam;
+    connect(&nam, &QNetworkAccessManager::sslErrors, [](QNetworkReply* reply, const QList<QSslError> &) {
+        reply->ignoreSslErrors();
+    });
+    QSignalSpy clientSpy(&nam, SIGNAL(finished(QNetworkReply*)));
+
+    QNetworkReply *reply = nam.get(QNetworkRequest(QUrl("https://localhost:3333/debug/memory")));
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+
+    QJsonParseError error;
+    QVariantMap statistics = QJsonDocument::fromJson(reply->readAll(), &error).toVariant().toMap();
+    reply->deleteLater();
+    QCOMPARE(error.error, QJsonParseError::NoError);
+
+    foreach (const QString &key, QStringList() << "timestamp" << "rss" << "peakRss" << "allocator" << "snapshotInterval" << "snapshots" << "subsystems") {
+        QVERIFY2(statistics.contains(key), QString("Missing key %1").arg(key).toUtf8());
+    }
+    QVERIFY(statistics.value("rss").toLongLong() > 0);
+    QVERIFY(statistics.value("peakRss").toLongLong() >= statistics.value("rss").toLongLong());
+    QVariantMap subsystems = statistics.value("subsystems").toMap();
+    foreach (const QString &key, QStringList() << "things" << "states" << "rules" << "queuedEvents") {
+        QVERIFY2(subsystems.contains(key), QString("Missing subsystem %1").arg(key).toUtf8());
+    }
+    QVERIFY(subsystems.value("things").toInt() > 0);
+}
+
+void TestWebserver::timeoutWheel()
+{
+    TimeoutWheel wheel(10, 8);
+
+    int expired = 0;
+    int restartedExpired = 0;
+    int removedExpired = 0;
+    wheel.add(30, [&expired](){ expired++; });
+    quint64 restarted = wheel.add(200, [&restartedExpired](){ restartedExpired++; });
+    quint64 removed = wheel.add(30, [&removedExpired](){ removedExpired++; });
+    // Further away than a round of the wheel
+    int farExpired = 0;
+    wheel.add(150, [&farExpired](){ farExpired++; });
+    QCOMPARE(wheel.count(), 4);
+
+    wheel.remove(removed);
+    QTRY_COMPARE(expired, 1);
+    QTest::qWait(100);
+    wheel.restart(restarted);
+    QElapsedTimer restartTime;
+    restartTime.start();
+    QCOMPARE(restartedExpired, 0);
+    QTRY_COMPARE(restartedExpired, 1);
+    QVERIFY(restartTime.elapsed() >= 190);
+    QTRY_COMPARE(farExpired, 1);
+    QCOMPARE(removedExpired, 0);
+    QCOMPARE(wheel.count(), 0);
+}
+
 #include "testwebserver.moc"
 QTEST_MAIN(TestWebserver)
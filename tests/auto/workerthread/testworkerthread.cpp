@@ -0,0 +1,349 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+#include "nymeacore.h"
+#include "integrations/thingmanagerimplementation.h"
+#include "integrations/integrationplugin.h"
+#include "integrations/thingsetupinfo.h"
+#include "integrations/thingactioninfo.h"
+
+#include <QJsonDocument>
+#include <QAtomicPointer>
+#include <QAtomicInt>
+
+using namespace nymeaserver;
+
+static const PluginId workerMockPluginId = PluginId("b60b40af-c54d-45d2-a9e9-4d11254e81bc");
+static const VendorId workerMockVendorId = VendorId("8ac54937-2e21-4157-9a2f-7dcfa7808324");
+static const ThingClassId workerMockThingClassId = ThingClassId("4fefe25d-27d3-42a4-92be-a7d4a4a49090");
+static const StateTypeId workerMockPowerStateTypeId = StateTypeId("f313a7bc-0f97-4f44-abe9-d8cac2ed9e1a");
+static const StateTypeId workerMockCounterStateTypeId = StateTypeId("bb086c20-8c1c-441d-b719-cff49b70937d");
+
+// Thread the last worker thread mock has been deleted in
+static QAtomicPointer<QThread> s_workerMockDeletedIn;
+
+// A plugin asking for a worker thread. It records the threads it gets called in and checks that
+// the things read back what it has just written.
+class WorkerThreadMockPlugin: public IntegrationPlugin
+{
+    Q_OBJECT
+
+public:
+    WorkerThreadMockPlugin();
+    ~WorkerThreadMockPlugin() override;
+
+    void init() override;
+    void setupThing(ThingSetupInfo *info) override;
+    void executeAction(ThingActionInfo *info) override;
+    void thingRemoved(Thing *thing) override;
+
+    // Counts the counter state of the thing from one value to another in the plugin thread
+    void countTo(Thing *thing, int from, int to);
+    // Sets all the given states at once in the plugin thread
+    void setStates(Thing *thing, const QHash<StateTypeId, QVariant> &values);
+
+    QAtomicPointer<QThread> initThread;
+    QAtomicPointer<QThread> setupThread;
+    QAtomicPointer<QThread> actionThread;
+    QAtomicPointer<QThread> removedThread;
+    QAtomicInt readBackErrors;
+
+private:
+    void setAndReadBack(Thing *thing, const StateTypeId &stateTypeId, const QVariant &value);
+};
+
+WorkerThreadMockPlugin::WorkerThreadMockPlugin()
+{
+    QByteArray json = R"({
+        "id": "b60b40af-c54d-45d2-a9e9-4d11254e81bc",
+        "name": "workerThreadMock",
+        "displayName": "Worker thread mock",
+        "workerThread": true,
+        "vendors": [
+            {
+                "id": "8ac54937-2e21-4157-9a2f-7dcfa7808324",
+                "name": "nymea",
+                "displayName": "nymea",
+                "thingClasses": [
+                    {
+                        "id": "4fefe25d-27d3-42a4-92be-a7d4a4a49090",
+                        "name": "workerThreadMock",
+                        "displayName": "Worker thread mock",
+                        "createMethods": ["user"],
+                        "paramTypes": [],
+                        "stateTypes": [
+                            {
+                                "id": "f313a7bc-0f97-4f44-abe9-d8cac2ed9e1a",
+                                "name": "power",
+                                "displayName": "Power",
+                                "displayNameEvent": "Power changed",
+                                "displayNameAction": "Set power",
+                                "type": "bool",
+                                "defaultValue": false,
+                                "writable": true
+                            },
+                            {
+                                "id": "bb086c20-8c1c-441d-b719-cff49b70937d",
+                                "name": "counter",
+                                "displayName": "Counter",
+                                "displayNameEvent": "Counter changed",
+                                "type": "int",
+                                "defaultValue": 0
+                            }
+                        ]
+                    }
+                ]
+            }
+        ]
+    })";
+    setMetaData(PluginMetadata(QJsonDocument::fromJson(json).object(), true, false));
+}
+
+WorkerThreadMockPlugin::~WorkerThreadMockPlugin()
+{
+    s_workerMockDeletedIn.store(QThread::currentThread());
+}
+
+void WorkerThreadMockPlugin::init()
+{
+    initThread.store(QThread::currentThread());
+}
+
+void WorkerThreadMockPlugin::setupThing(ThingSetupInfo *info)
+{
+    setupThread.store(QThread::currentThread());
+    setAndReadBack(info->thing(), workerMockCounterStateTypeId, 1);
+    info->finish(Thing::ThingErrorNoError);
+}
+
+void WorkerThreadMockPlugin::executeAction(ThingActionInfo *info)
+{
+    actionThread.store(QThread::currentThread());
+    setAndReadBack(info->thing(), workerMockPowerStateTypeId, info->action().paramValue(workerMockPowerStateTypeId));
+    info->finish(Thing::ThingErrorNoError);
+}
+
+void WorkerThreadMockPlugin::thingRemoved(Thing *thing)
+{
+    Q_UNUSED(thing)
+    removedThread.store(QThread::currentThread());
+}
+
+void WorkerThreadMockPlugin::countTo(Thing *thing, int from, int to)
+{
+    QTimer::singleShot(0, this, [this, thing, from, to](){
+        for (int i = from; i <= to; i++) {
+            setAndReadBack(thing, workerMockCounterStateTypeId, i);
+        }
+    });
+}
+
+void WorkerThreadMockPlugin::setStates(Thing *thing, const QHash<StateTypeId, QVariant> &values)
+{
+    QTimer::singleShot(0, this, [this, thing, values](){
+        thing->setStateValues(values);
+        foreach (const StateTypeId &stateTypeId, values.keys()) {
+            if (thing->stateValue(stateTypeId) != values.value(stateTypeId)) {
+                readBackErrors.ref();
+            }
+        }
+    });
+}
+
+void WorkerThreadMockPlugin::setAndReadBack(Thing *thing, const StateTypeId &stateTypeId, const QVariant &value)
+{
+    thing->setStateValue(stateTypeId, value);
+    if (thing->stateValue(stateTypeId) != value) {
+        qCWarning(dcTests()) << "Reading back" << stateTypeId << "returned" << thing->stateValue(stateTypeId) << "instead of" << value;
+        readBackErrors.ref();
+    }
+}
+
+class TestWorkerThread: public NymeaTestBase
+{
+    Q_OBJECT
+
+private:
+    WorkerThreadMockPlugin *m_plugin = nullptr;
+    ThingId m_thingId;
+
+    Thing *workerThing() const;
+
+private slots:
+    void initTestCase();
+
+    void setupThing();
+    void executeAction();
+    void stateUpdates();
+    void batchedStateUpdates();
+    void removeThing();
+    void shutdown();
+};
+
+Thing *TestWorkerThread::workerThing() const
+{
+    return NymeaCore::instance()->thingManager()->findConfiguredThing(m_thingId);
+}
+
+void TestWorkerThread::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\nTests.debug=true\nThingManager.debug=true");
+    qRegisterMetaType<StateTypeId>();
+    qRegisterMetaType<QList<StateTypeId>>();
+
+    m_plugin = new WorkerThreadMockPlugin();
+    QVERIFY2(m_plugin->metadata().isValid(), m_plugin->metadata().validationErrors().join(", ").toUtf8().constData());
+    QVERIFY(m_plugin->metadata().workerThread());
+
+    ThingManagerImplementation *thingManager = static_cast<ThingManagerImplementation*>(NymeaCore::instance()->thingManager());
+    thingManager->registerStaticPlugin(m_plugin);
+    QCOMPARE(thingManager->plugin(workerMockPluginId), static_cast<IntegrationPlugin*>(m_plugin));
+
+    // The plugin has been moved to a running thread of its own and initialized there
+    QVERIFY(m_plugin->thread() != QCoreApplication::instance()->thread());
+    QVERIFY(m_plugin->thread()->isRunning());
+    QTRY_COMPARE(m_plugin->initThread.load(), m_plugin->thread());
+}
+
+void TestWorkerThread::setupThing()
+{
+    QVariantMap params;
+    params.insert("name", "Worker thread mock");
+    params.insert("thingClassId", workerMockThingClassId.toString());
+    QVariant response = injectAndWait("Integrations.AddThing", params);
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    m_thingId = ThingId(response.toMap().value("params").toMap().value("thingId").toString());
+
+    Thing *thing = workerThing();
+    QVERIFY(thing);
+    QCOMPARE(thing->setupStatus(), Thing::ThingSetupStatusComplete);
+    QCOMPARE(m_plugin->setupThread.load(), m_plugin->thread());
+    QTRY_COMPARE(thing->stateValue(workerMockCounterStateTypeId).toInt(), 1);
+    QCOMPARE(m_plugin->readBackErrors.load(), 0);
+}
+
+void TestWorkerThread::executeAction()
+{
+    Thing *thing = workerThing();
+    QVERIFY(thing);
+
+    // Signals of things are emitted in the core thread only, whatever thread changed them
+    QList<QThread*> signalThreads;
+    connect(thing, &Thing::stateValueChanged, this, [&signalThreads](){
+        signalThreads.append(QThread::currentThread());
+    });
+    QSignalSpy stateSpy(thing, &Thing::stateValueChanged);
+
+    QVariantMap param;
+    param.insert("paramTypeId", workerMockPowerStateTypeId.toString());
+    param.insert("value", true);
+    QVariantMap params;
+    params.insert("thingId", m_thingId.toString());
+    params.insert("actionTypeId", workerMockPowerStateTypeId.toString());
+    params.insert("params", QVariantList({param}));
+    QVariant response = injectAndWait("Integrations.ExecuteAction", params);
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+
+    QCOMPARE(m_plugin->actionThread.load(), m_plugin->thread());
+    QCOMPARE(thing->stateValue(workerMockPowerStateTypeId).toBool(), true);
+    QTRY_COMPARE(stateSpy.count(), 1);
+    QCOMPARE(stateSpy.first().at(0).value<StateTypeId>(), workerMockPowerStateTypeId);
+    QCOMPARE(stateSpy.first().at(1).toBool(), true);
+    QCOMPARE(signalThreads, QList<QThread*>({QCoreApplication::instance()->thread()}));
+    QCOMPARE(m_plugin->readBackErrors.load(), 0);
+
+    disconnect(thing, &Thing::stateValueChanged, this, nullptr);
+}
+
+void TestWorkerThread::stateUpdates()
+{
+    Thing *thing = workerThing();
+    QVERIFY(thing);
+    QSignalSpy stateSpy(thing, &Thing::stateValueChanged);
+
+    // Each value is read back right away in the plugin thread and no intermediate value gets lost
+    m_plugin->countTo(thing, 2, 100);
+    QTRY_COMPARE(stateSpy.count(), 99);
+    for (int i = 0; i < stateSpy.count(); i++) {
+        QCOMPARE(stateSpy.at(i).at(0).value<StateTypeId>(), workerMockCounterStateTypeId);
+        QCOMPARE(stateSpy.at(i).at(1).toInt(), i + 2);
+    }
+    QCOMPARE(thing->stateValue(workerMockCounterStateTypeId).toInt(), 100);
+    QCOMPARE(m_plugin->readBackErrors.load(), 0);
+}
+
+void TestWorkerThread::batchedStateUpdates()
+{
+    Thing *thing = workerThing();
+    QVERIFY(thing);
+    QSignalSpy stateSpy(thing, &Thing::stateValueChanged);
+    QSignalSpy statesSpy(thing, &Thing::stateValuesChanged);
+
+    QHash<StateTypeId, QVariant> values;
+    values.insert(workerMockPowerStateTypeId, false);
+    values.insert(workerMockCounterStateTypeId, 200);
+    m_plugin->setStates(thing, values);
+
+    QTRY_COMPARE(statesSpy.count(), 1);
+    QCOMPARE(stateSpy.count(), 0);
+    QList<StateTypeId> stateTypeIds = statesSpy.first().at(0).value<QList<StateTypeId>>();
+    QCOMPARE(stateTypeIds.count(), 2);
+    QVERIFY(stateTypeIds.contains(workerMockPowerStateTypeId));
+    QVERIFY(stateTypeIds.contains(workerMockCounterStateTypeId));
+    QCOMPARE(thing->stateValue(workerMockPowerStateTypeId).toBool(), false);
+    QCOMPARE(thing->stateValue(workerMockCounterStateTypeId).toInt(), 200);
+    QCOMPARE(m_plugin->readBackErrors.load(), 0);
+}
+
+void TestWorkerThread::removeThing()
+{
+    QVariant response = injectAndWait("Integrations.RemoveThing", {{"thingId", m_thingId.toString()}});
+    verifyError(response, "thingError", enumValueName(Thing::ThingErrorNoError));
+    QVERIFY(!workerThing());
+    QTRY_COMPARE(m_plugin->removedThread.load(), m_plugin->thread());
+}
+
+void TestWorkerThread::shutdown()
+{
+    // Shutting down deletes the plugin in its own thread and stops the thread
+    QThread *pluginThread = m_plugin->thread();
+    QSignalSpy finishedSpy(pluginThread, &QThread::finished);
+    restartServer();
+    QCOMPARE(s_workerMockDeletedIn.load(), pluginThread);
+    QCOMPARE(finishedSpy.count(), 1);
+    m_plugin = nullptr;
+
+    // The plugin was registered by the test, the restarted core doesn't know it
+    QVERIFY(!NymeaCore::instance()->thingManager()->plugin(workerMockPluginId));
+}
+
+#include "testworkerthread.moc"
+QTEST_MAIN(TestWorkerThread)
@@ -0,0 +1,6 @@
+TARGET = testworkerthread
+
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+SOURCES += testworkerthread.cpp
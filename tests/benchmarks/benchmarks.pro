@@ -0,0 +1,12 @@
+TEMPLATE = subdirs
+
+SUBDIRS = \
+        clientscaling \
+        coap \
+        hardware \
+        mqttbroker \
+        networkdiscovery \
+        persistence \
+        scripts \
+        throughput \
+        webserver \
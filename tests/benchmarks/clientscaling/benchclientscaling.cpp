@@ -0,0 +1,241 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#include "nymeatestbase.h"
+#include "benchmarkresults.h"
+
+#include "nymeacore.h"
+#include "integrations/thingmanager.h"
+
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QNetworkAccessManager>
+#include <QWebSocket>
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+
+using namespace nymeaserver;
+
+static const int benchPort = 4470;
+static const int benchMockPort = 21900;
+static const int benchStateChanges = 20;
+
+// Same clock as the state values generated by the mock
+static int monotonicMicroseconds()
+{
+    qint64 now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    return static_cast<int>(now % INT_MAX);
+}
+
+// Measures how nymead scales with the number of concurrent JSON-RPC clients. Each row connects N WebSocket
+// clients, all of them subscribed to the Integrations notifications, and reports the memory held per client
+// and the latency of a state change notification until it arrived at each of the clients. Clients and
+// server share the process, so the RSS per client includes the client side socket, which is small compared
+// to the server side state. Needs about 2 file descriptors per client, run with "./benchclientscaling".
+class BenchClientScaling: public NymeaTestBase
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+
+    void benchmarkClients_data();
+    void benchmarkClients();
+
+private:
+    void addClients(int count);
+    void removeAll();
+
+    ThingId m_thingId;
+    QList<QWebSocket*> m_sockets;
+};
+
+void BenchClientScaling::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\n*.info=false\n*.warning=false\n"
+                                "Tests.debug=true\n");
+
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    ServerConfiguration config;
+    config.id = "benchclientscaling";
+    config.address = QHostAddress("127.0.0.1");
+    config.port = benchPort;
+    config.sslEnabled = false;
+    config.authenticationEnabled = false;
+    NymeaCore::instance()->configuration()->setWebSocketServerConfiguration(config);
+
+    QVariantMap httpPortParam;
+    httpPortParam.insert("paramTypeId", mockThingHttpportParamTypeId);
+    httpPortParam.insert("value", benchMockPort);
+    QVariantMap params;
+    params.insert("thingClassId", mockThingClassId);
+    params.insert("name", "Client scaling mock");
+    params.insert("thingParams", QVariantList() << httpPortParam);
+    QVariant response = injectAndWait("Integrations.AddThing", params);
+    m_thingId = response.toMap().value("params").toMap().value("thingId").toUuid();
+    QVERIFY2(!m_thingId.isNull(), "Creating mock failed");
+}
+
+void BenchClientScaling::cleanup()
+{
+    removeAll();
+    NymeaTestBase::cleanup();
+}
+
+// Connects the clients in parallel, each one says hello and subscribes to the Integrations notifications
+void BenchClientScaling::addClients(int count)
+{
+    int ready = 0;
+    for (int i = 0; i < count; i++) {
+        QWebSocket *socket = new QWebSocket("nymea benchmark", QWebSocketProtocol::Version13, this);
+        connect(socket, &QWebSocket::connected, socket, [socket](){
+            socket->sendTextMessage("{\"id\":0, \"method\":\"JSONRPC.Hello\"}");
+            socket->sendTextMessage("{\"id\":1, \"method\":\"JSONRPC.SetNotificationStatus\", \"params\":{\"namespaces\":[\"Integrations\"]}}");
+        });
+        connect(socket, &QWebSocket::textMessageReceived, socket, [&ready](const QString &message){
+            QVariantMap reply = QJsonDocument::fromJson(message.toUtf8()).toVariant().toMap();
+            if (reply.value("id").toInt() == 1 && reply.value("status").toString() == "success") {
+                ready++;
+            }
+        });
+        socket->open(QUrl(QString("ws://127.0.0.1:%1").arg(benchPort)));
+        m_sockets.append(socket);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    while (ready < count && timer.elapsed() < 30000) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    }
+    foreach (QWebSocket *socket, m_sockets) {
+        disconnect(socket, &QWebSocket::connected, socket, nullptr);
+        disconnect(socket, &QWebSocket::textMessageReceived, socket, nullptr);
+    }
+    qCDebug(dcTests()).nospace() << "Connected " << ready << " of " << count << " clients in " << timer.elapsed() << " ms";
+    QVERIFY2(ready == count, qPrintable(QString("Only %1 of %2 clients completed the handshake").arg(ready).arg(count)));
+}
+
+void BenchClientScaling::removeAll()
+{
+    foreach (QWebSocket *socket, m_sockets) {
+        socket->abort();
+        socket->deleteLater();
+    }
+    m_sockets.clear();
+    // Let the server side notice the disconnects
+    QTest::qWait(500);
+}
+
+void BenchClientScaling::benchmarkClients_data()
+{
+    QTest::addColumn<int>("clients");
+
+    QTest::newRow("100 clients") << 100;
+    QTest::newRow("500 clients") << 500;
+    QTest::newRow("2000 clients") << 2000;
+}
+
+void BenchClientScaling::benchmarkClients()
+{
+    QFETCH(int, clients);
+
+    qint64 rssStart = BenchmarkResults::residentSetSize();
+    addClients(clients);
+    // Settle allocations of the connect phase before measuring
+    QTest::qWait(200);
+    qint64 rss = BenchmarkResults::residentSetSize();
+
+    int notifications = 0;
+    QVector<int> latencies;
+    latencies.reserve(benchStateChanges * clients);
+    foreach (QWebSocket *socket, m_sockets) {
+        connect(socket, &QWebSocket::textMessageReceived, socket, [&notifications, &latencies](const QString &message){
+            QVariantMap notification = QJsonDocument::fromJson(message.toUtf8()).toVariant().toMap();
+            if (notification.value("notification").toString() != "Integrations.StateChanged") {
+                return;
+            }
+            QVariantMap params = notification.value("params").toMap();
+            if (params.value("stateTypeId").toUuid() != mockIntStateTypeId) {
+                return;
+            }
+            notifications++;
+            int latency = monotonicMicroseconds() - params.value("value").toInt();
+            latencies.append(latency < 0 ? latency + INT_MAX : latency);
+        });
+    }
+
+    // A slow rate so each change fans out to all clients before the next one is generated
+    QNetworkAccessManager nam;
+    QNetworkReply *reply = nam.get(QNetworkRequest(QUrl(QString("http://localhost:%1/generatestates?rate=10&count=%2").arg(benchMockPort).arg(benchStateChanges))));
+    connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
+
+    QElapsedTimer timer;
+    timer.start();
+    while (notifications < benchStateChanges * clients && timer.elapsed() < benchStateChanges * 100 + 10000) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    }
+
+    foreach (QWebSocket *socket, m_sockets) {
+        disconnect(socket, &QWebSocket::textMessageReceived, socket, nullptr);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        return latencies.isEmpty() ? 0 : latencies.at(qMin(latencies.count() - 1, static_cast<int>(latencies.count() * p)));
+    };
+
+    qint64 rssPerClient = (rss - rssStart) / clients;
+    qCDebug(dcTests()).nospace() << "RSS " << rss / 1024 << " kB, " << rssPerClient << " bytes per client";
+    qCDebug(dcTests()).nospace() << "Received " << notifications << " of " << benchStateChanges * clients << " notifications, latency p50 "
+                                 << percentile(0.5) << " us, p90 " << percentile(0.9) << " us, p99 " << percentile(0.99)
+                                 << " us, max " << percentile(1) << " us";
+
+    QVariantMap metrics;
+    metrics.insert("rss", rss);
+    metrics.insert("rssPerClient", rssPerClient);
+    metrics.insert("latencyP50", percentile(0.5) / 1000.0);
+    metrics.insert("latencyP90", percentile(0.9) / 1000.0);
+    metrics.insert("latencyP99", percentile(0.99) / 1000.0);
+    BenchmarkResults::record(metrics);
+
+    QVERIFY2(notifications == benchStateChanges * clients, qPrintable(QString("Only %1 of %2 notifications arrived").arg(notifications).arg(benchStateChanges * clients)));
+    QTest::setBenchmarkResult(rssPerClient, QTest::BytesAllocated);
+}
+
+#include "benchclientscaling.moc"
+QTEST_MAIN(BenchClientScaling)
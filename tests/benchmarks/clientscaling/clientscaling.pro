@@ -0,0 +1,10 @@
+include(../../../nymea.pri)
+include(../../auto/autotests.pri)
+
+# Benchmarks are run on demand, not as part of make check
+CONFIG -= testcase
+
+QT += websockets
+
+TARGET = benchclientscaling
+SOURCES += benchclientscaling.cpp
@@ -0,0 +1,402 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "coap/coap.h"
+#include "coap/coappdu.h"
+#include "coap/coapreply.h"
+#include "benchmarkresults.h"
+
+#include <QtTest>
+#include <QThread>
+#include <QUdpSocket>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QAtomicInt>
+
+#include <algorithm>
+#include <functional>
+
+// Shared by the server and the client thread to measure the latency of notifications
+static QElapsedTimer s_clock;
+
+static QByteArray encodeUint(quint32 value)
+{
+    QByteArray data;
+    while (value > 0) {
+        data.prepend(static_cast<char>(value & 0xff));
+        value >>= 8;
+    }
+    return data;
+}
+
+// A minimal CoAP server running in its own thread. It serves "/hello", a 64 KiB "/large"
+// resource in blocks of the requested size and observable "/obs/<n>" resources which send a
+// non-confirmable notification to each observer every millisecond, carrying the send time.
+class BenchCoapServer: public QObject
+{
+    Q_OBJECT
+public:
+    BenchCoapServer();
+
+    quint16 port() const { return m_port; }
+    int largePayloadSize() const { return m_largePayload.size(); }
+    int notificationsSent() const { return m_notificationsSent.load(); }
+
+public slots:
+    void start();
+    void clearObservers();
+
+private slots:
+    void onReadyRead();
+    void sendNotifications();
+
+private:
+    class Observer {
+    public:
+        QHostAddress address;
+        quint16 port = 0;
+        QByteArray token;
+        quint32 sequence = 2;
+    };
+
+    QUdpSocket *m_socket = nullptr;
+    QTimer *m_notificationTimer = nullptr;
+    quint16 m_port = 0;
+    quint16 m_messageId = 1;
+    QByteArray m_largePayload;
+    QList<Observer> m_observers;
+    QAtomicInt m_notificationsSent;
+};
+
+BenchCoapServer::BenchCoapServer()
+{
+    m_socket = new QUdpSocket(this);
+    m_socket->bind(QHostAddress::LocalHost, 0);
+    m_port = m_socket->localPort();
+    connect(m_socket, &QUdpSocket::readyRead, this, &BenchCoapServer::onReadyRead);
+
+    while (m_largePayload.size() < 64 * 1024) {
+        m_largePayload.append("The quick brown fox jumps over the lazy dog.\n");
+    }
+    m_largePayload.truncate(64 * 1024);
+}
+
+void BenchCoapServer::start()
+{
+    m_notificationTimer = new QTimer(this);
+    m_notificationTimer->setInterval(1);
+    connect(m_notificationTimer, &QTimer::timeout, this, &BenchCoapServer::sendNotifications);
+}
+
+void BenchCoapServer::clearObservers()
+{
+    m_notificationTimer->stop();
+    m_observers.clear();
+    m_notificationsSent.store(0);
+}
+
+void BenchCoapServer::onReadyRead()
+{
+    QByteArray data;
+    QHostAddress address;
+    quint16 port;
+    while (m_socket->hasPendingDatagrams()) {
+        data.resize(m_socket->pendingDatagramSize());
+        m_socket->readDatagram(data.data(), data.size(), &address, &port);
+
+        CoapPdu request(data);
+        if (!request.isValid() || (request.messageType() != CoapPdu::Confirmable && request.messageType() != CoapPdu::NonConfirmable)) {
+            continue;
+        }
+
+        QStringList path;
+        CoapPduBlock block;
+        bool blockRequested = false;
+        bool observe = false;
+        foreach (const CoapOption &option, request.options()) {
+            if (option.option() == CoapOption::UriPath) {
+                path.append(QString::fromUtf8(option.data()));
+            } else if (option.option() == CoapOption::Block2) {
+                block = CoapPduBlock(option.data());
+                blockRequested = true;
+            } else if (option.option() == CoapOption::Observe) {
+                observe = option.data().isEmpty() || option.data() == QByteArray(1, 0);
+            }
+        }
+
+        CoapPdu response;
+        response.setMessageType(request.messageType() == CoapPdu::Confirmable ? CoapPdu::Acknowledgement : CoapPdu::NonConfirmable);
+        response.setMessageId(request.messageType() == CoapPdu::Confirmable ? request.messageId() : m_messageId++);
+        response.setToken(request.token());
+        response.setStatusCode(CoapPdu::Content);
+
+        QString resource = path.join('/');
+        if (resource == "hello") {
+            response.setPayload("world");
+        } else if (resource == "large") {
+            int blockSize = blockRequested ? block.blockSize() : 64;
+            int offset = block.blockNumber() * blockSize;
+            bool more = offset + blockSize < m_largePayload.size();
+            response.addOption(CoapOption::Block2, CoapPduBlock::createBlock(block.blockNumber(), CoapPduBlock::sizeExponent(blockSize), more));
+            response.setPayload(m_largePayload.mid(offset, blockSize));
+        } else if (resource.startsWith("obs/")) {
+            if (observe) {
+                Observer observer;
+                observer.address = address;
+                observer.port = port;
+                observer.token = request.token();
+                m_observers.append(observer);
+                response.addOption(CoapOption::Observe, encodeUint(1));
+                if (!m_notificationTimer->isActive()) {
+                    m_notificationTimer->start();
+                }
+            }
+            response.setPayload(QByteArray::number(s_clock.nsecsElapsed()));
+        } else {
+            response.setStatusCode(CoapPdu::NotFound);
+        }
+
+        m_socket->writeDatagram(response.pack(), address, port);
+    }
+}
+
+void BenchCoapServer::sendNotifications()
+{
+    for (int i = 0; i < m_observers.count(); i++) {
+        Observer &observer = m_observers[i];
+        CoapPdu notification;
+        notification.setMessageType(CoapPdu::NonConfirmable);
+        notification.setStatusCode(CoapPdu::Content);
+        notification.setMessageId(m_messageId++);
+        notification.setToken(observer.token);
+        notification.addOption(CoapOption::Observe, encodeUint(observer.sequence++));
+        notification.setPayload(QByteArray::number(s_clock.nsecsElapsed()));
+        m_socket->writeDatagram(notification.pack(), observer.address, observer.port);
+        m_notificationsSent.ref();
+    }
+}
+
+// Measures throughput and latency of the Coap client against a local server: plain GET requests
+// with several confirmable requests in flight (NSTART), blockwise downloads with different block
+// sizes and pipeline depths, and notifications of observed resources. The duration of each run
+// defaults to 3 seconds and can be changed with NYMEA_BENCH_DURATION (in seconds).
+class BenchCoap: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void benchmarkRequests_data();
+    void benchmarkRequests();
+
+    void benchmarkNotifications_data();
+    void benchmarkNotifications();
+
+private:
+    int duration() const;
+    void report(const QString &unit, QVector<qint64> latencies, qint64 elapsed, const QString &extra = QString());
+
+    QThread m_serverThread;
+    BenchCoapServer *m_server = nullptr;
+};
+
+void BenchCoap::initTestCase()
+{
+    s_clock.start();
+    m_server = new BenchCoapServer();
+    m_server->moveToThread(&m_serverThread);
+    connect(&m_serverThread, &QThread::started, m_server, &BenchCoapServer::start);
+    connect(&m_serverThread, &QThread::finished, m_server, &QObject::deleteLater);
+    m_serverThread.start();
+}
+
+void BenchCoap::cleanupTestCase()
+{
+    m_serverThread.quit();
+    m_serverThread.wait();
+}
+
+int BenchCoap::duration() const
+{
+    return qEnvironmentVariableIsSet("NYMEA_BENCH_DURATION") ? qEnvironmentVariableIntValue("NYMEA_BENCH_DURATION") * 1000 : 3000;
+}
+
+void BenchCoap::report(const QString &unit, QVector<qint64> latencies, qint64 elapsed, const QString &extra)
+{
+    std::sort(latencies.begin(), latencies.end());
+    double perSecond = latencies.count() * 1000.0 / qMax(elapsed, static_cast<qint64>(1));
+    double p50 = latencies.at(latencies.count() / 2) / 1000000.0;
+    double p99 = latencies.at(qMin(latencies.count() - 1, latencies.count() * 99 / 100)) / 1000000.0;
+
+    qDebug().noquote() << QString("%1: %2 %3/s, p50 %4 ms, p99 %5 ms%6")
+                          .arg(QTest::currentDataTag())
+                          .arg(perSecond, 0, 'f', 0)
+                          .arg(unit)
+                          .arg(p50, 0, 'f', 3)
+                          .arg(p99, 0, 'f', 3)
+                          .arg(extra);
+
+    QVariantMap metrics;
+    metrics.insert("throughput", perSecond);
+    metrics.insert("latencyP50", p50);
+    metrics.insert("latencyP99", p99);
+    BenchmarkResults::record(metrics);
+
+    QTest::setBenchmarkResult(perSecond, QTest::Events);
+}
+
+void BenchCoap::benchmarkRequests_data()
+{
+    QTest::addColumn<QString>("resource");
+    QTest::addColumn<int>("concurrency");
+    QTest::addColumn<int>("blockSize");
+    QTest::addColumn<int>("pipelineDepth");
+
+    QTest::newRow("get, 1 in flight") << QString("hello") << 1 << 64 << 1;
+    QTest::newRow("get, 8 in flight") << QString("hello") << 8 << 64 << 1;
+    QTest::newRow("get, 32 in flight") << QString("hello") << 32 << 64 << 1;
+    QTest::newRow("64 KiB, 64 byte blocks") << QString("large") << 1 << 64 << 1;
+    QTest::newRow("64 KiB, 1024 byte blocks") << QString("large") << 1 << 1024 << 1;
+    QTest::newRow("64 KiB, 1024 byte blocks, pipeline 4") << QString("large") << 1 << 1024 << 4;
+    QTest::newRow("64 KiB, 1024 byte blocks, pipeline 4, 4 in flight") << QString("large") << 4 << 1024 << 4;
+}
+
+void BenchCoap::benchmarkRequests()
+{
+    QFETCH(QString, resource);
+    QFETCH(int, concurrency);
+    QFETCH(int, blockSize);
+    QFETCH(int, pipelineDepth);
+
+    Coap coap(nullptr, 0);
+    coap.setNStart(QHostAddress::LocalHost, m_server->port(), concurrency);
+
+    QUrl url(QString("coap://127.0.0.1:%1/%2").arg(m_server->port()).arg(resource));
+    int expectedSize = resource == "large" ? m_server->largePayloadSize() : 5;
+
+    QVector<qint64> latencies;
+    int errors = 0;
+    int activeClients = concurrency;
+    QElapsedTimer runTimer;
+    QEventLoop loop;
+
+    // Each client sends its next request as soon as the previous one has finished
+    std::function<void()> sendRequest;
+    sendRequest = [&]() {
+        if (runTimer.elapsed() >= duration()) {
+            if (--activeClients == 0) {
+                loop.quit();
+            }
+            return;
+        }
+        CoapRequest request(url);
+        request.setBlockSize(blockSize);
+        request.setPipelineDepth(pipelineDepth);
+        qint64 start = s_clock.nsecsElapsed();
+        CoapReply *reply = coap.get(request);
+        connect(reply, &CoapReply::finished, this, [&, reply, start]() {
+            if (reply->error() != CoapReply::NoError || reply->statusCode() != CoapPdu::Content || reply->payload().size() != expectedSize) {
+                errors++;
+            } else {
+                latencies.append(s_clock.nsecsElapsed() - start);
+            }
+            reply->deleteLater();
+            QTimer::singleShot(0, this, sendRequest);
+        });
+    };
+
+    runTimer.start();
+    for (int i = 0; i < concurrency; i++) {
+        sendRequest();
+    }
+    QTimer::singleShot(duration() + 20000, &loop, &QEventLoop::quit);
+    loop.exec();
+    qint64 elapsed = runTimer.elapsed();
+
+    QVERIFY2(activeClients == 0, "Requests did not finish in time");
+    QVERIFY2(!latencies.isEmpty(), "No request succeeded");
+    report("requests", latencies, elapsed, QString(", %1 errors").arg(errors));
+    QCOMPARE(errors, 0);
+}
+
+void BenchCoap::benchmarkNotifications_data()
+{
+    QTest::addColumn<int>("observers");
+
+    QTest::newRow("1 observed resource") << 1;
+    QTest::newRow("16 observed resources") << 16;
+}
+
+void BenchCoap::benchmarkNotifications()
+{
+    QFETCH(int, observers);
+
+    Coap coap(nullptr, 0);
+    coap.setNStart(QHostAddress::LocalHost, m_server->port(), observers);
+
+    QVector<qint64> latencies;
+    connect(&coap, &Coap::notificationReceived, this, [&latencies](const CoapObserveResource &resource, const int &notificationNumber, const QByteArray &payload) {
+        Q_UNUSED(resource)
+        Q_UNUSED(notificationNumber)
+        latencies.append(s_clock.nsecsElapsed() - payload.toLongLong());
+    });
+
+    int registered = 0;
+    for (int i = 0; i < observers; i++) {
+        CoapReply *reply = coap.enableResourceNotifications(CoapRequest(QUrl(QString("coap://127.0.0.1:%1/obs/%2").arg(m_server->port()).arg(i))));
+        connect(reply, &CoapReply::finished, this, [&registered, reply]() {
+            if (reply->error() == CoapReply::NoError) {
+                registered++;
+            }
+            reply->deleteLater();
+        });
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(registered, observers, 10000);
+
+    latencies.clear();
+    QElapsedTimer runTimer;
+    runTimer.start();
+    QTest::qWait(duration());
+    QMetaObject::invokeMethod(m_server, "clearObservers", Qt::BlockingQueuedConnection);
+    qint64 elapsed = runTimer.elapsed();
+    int sent = m_server->notificationsSent();
+
+    // Let the notifications still in flight arrive
+    QTest::qWait(100);
+
+    QVERIFY2(!latencies.isEmpty(), "No notification received");
+    report("notifications", latencies, elapsed, QString(", %1 of %2 sent received").arg(latencies.count()).arg(sent));
+}
+
+#include "benchcoap.moc"
+QTEST_MAIN(BenchCoap)
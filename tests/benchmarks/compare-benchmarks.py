@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+
+# Compares two result files written by run-benchmarks.py.
+#
+#   compare-benchmarks.py base.json new.json [--threshold 5]
+#
+# Prints the relative change of every metric present in both files. Throughput style metrics are
+# better when higher, everything else (latencies, durations, RSS, CPU time, ...) when lower.
+# Exits with 1 if any metric got worse by more than the threshold percentage.
+
+import argparse
+import json
+import sys
+
+HIGHER_IS_BETTER_METRICS = ["throughput", "readings", "responded"]
+HIGHER_IS_BETTER_RESULT_METRICS = ["Events"]
+
+
+def higher_is_better(name, metrics):
+    if name in HIGHER_IS_BETTER_METRICS or name.endswith("PerSecond"):
+        return True
+    if name == "result":
+        return metrics.get("resultMetric") in HIGHER_IS_BETTER_RESULT_METRICS
+    return False
+
+
+def load(file_name):
+    with open(file_name) as input_file:
+        document = json.load(input_file)
+    results = {}
+    for result in document.get("results", []):
+        results[(result["benchmark"], result["function"], result["tag"])] = result["metrics"]
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two nymea benchmark result files.")
+    parser.add_argument("base", help="The result file to compare against")
+    parser.add_argument("new", help="The result file to compare")
+    parser.add_argument("--threshold", type=float, default=5.0, help="Regression threshold in percent")
+    args = parser.parse_args()
+
+    base = load(args.base)
+    new = load(args.new)
+    regressions = 0
+
+    for key in sorted(set(base) & set(new)):
+        base_metrics = base[key]
+        new_metrics = new[key]
+        lines = []
+        for name in sorted(set(base_metrics) & set(new_metrics)):
+            base_value = base_metrics[name]
+            new_value = new_metrics[name]
+            if isinstance(base_value, bool) or not isinstance(base_value, (int, float)) \
+                    or not isinstance(new_value, (int, float)):
+                continue
+            if base_value == 0:
+                continue
+            change = (new_value - base_value) * 100.0 / abs(base_value)
+            worse = -change if higher_is_better(name, new_metrics) else change
+            marker = ""
+            if worse > args.threshold:
+                marker = "  REGRESSION"
+                regressions += 1
+            elif worse < -args.threshold:
+                marker = "  improved"
+            lines.append("    %-24s %14.3f -> %14.3f  %+7.1f%%%s" % (name, base_value, new_value, change, marker))
+        if lines:
+            print("%s::%s %s" % key)
+            print("\n".join(lines))
+
+    for key in sorted(set(base) - set(new)):
+        print("%s::%s %s  missing in %s" % (key + (args.new,)))
+    for key in sorted(set(new) - set(base)):
+        print("%s::%s %s  new in %s" % (key + (args.new,)))
+
+    if regressions:
+        print("%d metric(s) regressed by more than %.1f%%" % (regressions, args.threshold))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
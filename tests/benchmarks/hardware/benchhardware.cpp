@@ -0,0 +1,440 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#include "hardware/i2c/i2cdevice.h"
+#include "hardware/i2c/i2cmanagerimplementation.h"
+#include "hardware/modbus/modbusrtureply.h"
+#include "benchmarkresults.h"
+
+#ifdef WITH_QTSERIALBUS
+#include "hardware/modbus/modbusrtumasterimpl.h"
+#endif
+
+#include <QtTest>
+#include <QDir>
+#include <QSocketNotifier>
+#include <QElapsedTimer>
+
+#include <pty.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+using namespace nymeaserver;
+
+// Consumed CPU time of the process in microseconds
+static qint64 cpuTime()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ll + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static double percentile(QList<double> values, int percent)
+{
+    if (values.isEmpty())
+        return 0;
+
+    std::sort(values.begin(), values.end());
+    return values.at(qMin(values.count() - 1, values.count() * percent / 100));
+}
+
+// Modbus RTU slave simulator on the master side of a pseudo terminal. The serial port side is used
+// by the ModbusRtuMasterImpl. Every slave address is answered, every register contains its own address.
+class BenchModbusSlave: public QObject
+{
+    Q_OBJECT
+public:
+    explicit BenchModbusSlave(QObject *parent = nullptr);
+    ~BenchModbusSlave() override;
+
+    bool isValid() const { return m_masterFd >= 0; }
+    QString serialPort() const { return m_serialPort; }
+    int frames() const { return m_frames; }
+
+private slots:
+    void onReadyRead();
+
+private:
+    int m_masterFd = -1;
+    int m_slaveFd = -1;
+    QString m_serialPort;
+    QSocketNotifier *m_notifier = nullptr;
+    QByteArray m_buffer;
+    int m_frames = 0;
+
+    static quint16 crc(const QByteArray &data);
+    void respond(const QByteArray &request);
+};
+
+BenchModbusSlave::BenchModbusSlave(QObject *parent) :
+    QObject(parent)
+{
+    char name[256];
+    if (openpty(&m_masterFd, &m_slaveFd, name, nullptr, nullptr) < 0) {
+        m_masterFd = -1;
+        return;
+    }
+    m_serialPort = QString::fromLatin1(name);
+
+    struct termios settings;
+    tcgetattr(m_masterFd, &settings);
+    cfmakeraw(&settings);
+    tcsetattr(m_masterFd, TCSANOW, &settings);
+    fcntl(m_masterFd, F_SETFL, fcntl(m_masterFd, F_GETFL) | O_NONBLOCK);
+
+    m_notifier = new QSocketNotifier(m_masterFd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &BenchModbusSlave::onReadyRead);
+}
+
+BenchModbusSlave::~BenchModbusSlave()
+{
+    if (m_masterFd >= 0) {
+        close(m_masterFd);
+        close(m_slaveFd);
+    }
+}
+
+void BenchModbusSlave::onReadyRead()
+{
+    char data[512];
+    ssize_t size = 0;
+    while ((size = read(m_masterFd, data, sizeof(data))) > 0) {
+        m_buffer.append(data, static_cast<int>(size));
+    }
+
+    while (m_buffer.size() >= 8) {
+        quint8 functionCode = static_cast<quint8>(m_buffer.at(1));
+        int length = 8;
+        if (functionCode == 0x0f || functionCode == 0x10) {
+            length = 9 + static_cast<quint8>(m_buffer.at(6));
+        } else if (functionCode < 0x01 || functionCode > 0x06) {
+            m_buffer.clear();
+            return;
+        }
+        if (m_buffer.size() < length)
+            return;
+
+        QByteArray request = m_buffer.left(length);
+        m_buffer.remove(0, length);
+        quint16 checksum = static_cast<quint8>(request.at(length - 2)) | static_cast<quint8>(request.at(length - 1)) << 8;
+        if (crc(request.left(length - 2)) != checksum) {
+            m_buffer.clear();
+            return;
+        }
+        m_frames++;
+        respond(request);
+    }
+}
+
+quint16 BenchModbusSlave::crc(const QByteArray &data)
+{
+    quint16 crc = 0xffff;
+    for (int i = 0; i < data.size(); i++) {
+        crc ^= static_cast<quint8>(data.at(i));
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xa001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+void BenchModbusSlave::respond(const QByteArray &request)
+{
+    quint8 functionCode = static_cast<quint8>(request.at(1));
+    quint16 start = static_cast<quint8>(request.at(2)) << 8 | static_cast<quint8>(request.at(3));
+    quint16 count = static_cast<quint8>(request.at(4)) << 8 | static_cast<quint8>(request.at(5));
+
+    QByteArray response = request.left(2);
+    switch (functionCode) {
+    case 0x01:
+    case 0x02: {
+        // Every odd bit is set
+        QByteArray bits((count + 7) / 8, 0);
+        for (int i = 0; i < count; i++) {
+            if ((start + i) % 2)
+                bits[i / 8] = static_cast<char>(bits.at(i / 8) | (1 << (i % 8)));
+        }
+        response.append(static_cast<char>(bits.size()));
+        response.append(bits);
+        break;
+    }
+    case 0x03:
+    case 0x04:
+        response.append(static_cast<char>(count * 2));
+        for (int i = 0; i < count; i++) {
+            response.append(static_cast<char>((start + i) >> 8));
+            response.append(static_cast<char>((start + i) & 0xff));
+        }
+        break;
+    case 0x05:
+    case 0x06:
+    case 0x0f:
+    case 0x10:
+        response = request.left(6);
+        break;
+    }
+
+    quint16 checksum = crc(response);
+    response.append(static_cast<char>(checksum & 0xff));
+    response.append(static_cast<char>(checksum >> 8));
+    if (write(m_masterFd, response.constData(), static_cast<size_t>(response.size())) != response.size()) {
+        qWarning() << "Could not write the simulated Modbus response";
+    }
+}
+
+// Reads a word register of a simulated chip through SMBus, the i2c-stub does not support plain I2C transfers
+class BenchI2CDevice: public I2CDevice
+{
+    Q_OBJECT
+public:
+    explicit BenchI2CDevice(const QString &portName, int address, QObject *parent = nullptr) :
+        I2CDevice(portName, address, parent) { }
+
+    QByteArray readData(int fileDescriptor) override {
+        union i2c_smbus_data data;
+        struct i2c_smbus_ioctl_data args;
+        args.read_write = I2C_SMBUS_READ;
+        args.command = 0x00;
+        args.size = I2C_SMBUS_WORD_DATA;
+        args.data = &data;
+        if (ioctl(fileDescriptor, I2C_SMBUS, &args) < 0)
+            return QByteArray();
+
+        return QByteArray(reinterpret_cast<const char *>(&data.word), 2);
+    }
+};
+
+// Measures the hardware resources against simulated buses: the Modbus RTU master including its request
+// scheduler against a slave simulator on a pseudo terminal, and the I2C manager against the i2c-stub
+// kernel module. The I2C benchmark needs the simulated bus from simulate-i2c.sh ("sudo ./simulate-i2c.sh up")
+// and is skipped without it. The Zigbee resource needs a coordinator adapter, nymea-zigbee has no simulated
+// backend to run it against.
+class BenchHardware: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void benchmarkModbusRtu_data();
+    void benchmarkModbusRtu();
+
+    void benchmarkI2C_data();
+    void benchmarkI2C();
+
+private:
+    QString stubI2CPort() const;
+};
+
+void BenchHardware::benchmarkModbusRtu_data()
+{
+    QTest::addColumn<int>("requests");
+    QTest::addColumn<int>("slaves");
+    QTest::addColumn<bool>("burst");
+
+    QTest::newRow("sequential, 1 slave") << 500 << 1 << false;
+    QTest::newRow("sequential, 8 slaves") << 500 << 8 << false;
+    QTest::newRow("burst, 1 slave") << 500 << 1 << true;
+    QTest::newRow("burst, 8 slaves") << 500 << 8 << true;
+}
+
+void BenchHardware::benchmarkModbusRtu()
+{
+#ifndef WITH_QTSERIALBUS
+    QSKIP("Modbus RTU is not supported without QtSerialBus.");
+#else
+    QFETCH(int, requests);
+    QFETCH(int, slaves);
+    QFETCH(bool, burst);
+
+    BenchModbusSlave slave;
+    QVERIFY2(slave.isValid(), "Could not open a pseudo terminal");
+
+    ModbusRtuMasterImpl master(QUuid::createUuid(), slave.serialPort(), 115200, QSerialPort::NoParity, QSerialPort::Data8, QSerialPort::OneStop, 0, 500);
+    QVERIFY2(master.connectDevice(), "Could not connect to the simulated slave");
+    QTRY_VERIFY(master.connected());
+
+    QList<double> latencies;
+    int finished = 0;
+    int failed = 0;
+    int issued = 0;
+
+    // Every request reads 4 registers adjacent to the ones of the previous request on the same slave,
+    // bursts can be merged by the scheduler, sequential requests can't.
+    std::function<void()> issueRequest = [&](){
+        int slaveAddress = 1 + issued % slaves;
+        int registerAddress = (issued / slaves) * 4 % 2000;
+        issued++;
+
+        QElapsedTimer *requestTimer = new QElapsedTimer();
+        requestTimer->start();
+        ModbusRtuReply *reply = master.readHoldingRegister(slaveAddress, registerAddress, 4);
+        connect(reply, &ModbusRtuReply::finished, this, [&, reply, requestTimer, registerAddress](){
+            latencies.append(requestTimer->nsecsElapsed() / 1000000.0);
+            delete requestTimer;
+            if (reply->error() != ModbusRtuReply::NoError || reply->result().value(0) != registerAddress)
+                failed++;
+
+            finished++;
+            if (!burst && issued < requests)
+                issueRequest();
+        });
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 cpuStart = cpuTime();
+    if (burst) {
+        while (issued < requests)
+            issueRequest();
+    } else {
+        issueRequest();
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(finished, requests, 60000);
+    qint64 elapsed = timer.elapsed();
+    qint64 cpu = cpuTime() - cpuStart;
+
+    QCOMPARE(failed, 0);
+    qDebug().noquote() << QString("%1: %2 ms, %3 requests/s in %4 frames, latency p50 %5 ms, p99 %6 ms, %7 us CPU per request, %8 coalesced")
+                          .arg(QTest::currentDataTag())
+                          .arg(elapsed)
+                          .arg(requests * 1000.0 / qMax<qint64>(elapsed, 1), 0, 'f', 0)
+                          .arg(slave.frames())
+                          .arg(percentile(latencies, 50), 0, 'f', 2)
+                          .arg(percentile(latencies, 99), 0, 'f', 2)
+                          .arg(cpu / requests)
+                          .arg(master.statistics().counters().coalescedReads);
+
+    QVariantMap metrics;
+    metrics.insert("duration", elapsed);
+    metrics.insert("throughput", requests * 1000.0 / qMax<qint64>(elapsed, 1));
+    metrics.insert("latencyP50", percentile(latencies, 50));
+    metrics.insert("latencyP99", percentile(latencies, 99));
+    metrics.insert("cpuPerRequest", cpu / requests);
+    BenchmarkResults::record(metrics);
+
+    master.disconnectDevice();
+    QTest::setBenchmarkResult(elapsed, QTest::WalltimeMilliseconds);
+#endif
+}
+
+QString BenchHardware::stubI2CPort() const
+{
+    foreach (const QString &adapter, QDir("/sys/class/i2c-adapter/").entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QFile nameFile("/sys/class/i2c-adapter/" + adapter + "/name");
+        if (nameFile.open(QFile::ReadOnly) && nameFile.readAll().trimmed() == "SMBus stub driver") {
+            return adapter;
+        }
+    }
+    return QString();
+}
+
+void BenchHardware::benchmarkI2C_data()
+{
+    QTest::addColumn<int>("devices");
+    QTest::addColumn<int>("interval");
+
+    QTest::newRow("1 device, 100 ms") << 1 << 100;
+    QTest::newRow("8 devices, 100 ms") << 8 << 100;
+    QTest::newRow("8 devices, 10 ms") << 8 << 10;
+}
+
+void BenchHardware::benchmarkI2C()
+{
+    QFETCH(int, devices);
+    QFETCH(int, interval);
+
+    QString portName = stubI2CPort();
+    if (portName.isEmpty())
+        QSKIP("The simulated I2C bus is not available. Run simulate-i2c.sh up as root.");
+
+    I2CManagerImplementation manager;
+    QList<BenchI2CDevice *> i2cDevices;
+    QHash<I2CDevice *, QElapsedTimer> lastReadings;
+    QList<double> periods;
+    int readings = 0;
+    int failed = 0;
+
+    for (int i = 0; i < devices; i++) {
+        BenchI2CDevice *device = new BenchI2CDevice(portName, 0x20 + i, this);
+        QVERIFY2(manager.open(device), "Could not open the simulated I2C bus");
+        connect(device, &I2CDevice::readingAvailable, this, [&, device](const QByteArray &data){
+            readings++;
+            if (data.size() != 2)
+                failed++;
+
+            if (lastReadings.contains(device))
+                periods.append(lastReadings.value(device).nsecsElapsed() / 1000000.0);
+
+            lastReadings[device].start();
+        });
+        i2cDevices.append(device);
+    }
+
+    // Run for 3 seconds
+    const int duration = 3000;
+    qint64 cpuStart = cpuTime();
+    foreach (BenchI2CDevice *device, i2cDevices) {
+        QVERIFY(manager.startReading(device, interval));
+    }
+    QTest::qWait(duration);
+    qint64 cpu = cpuTime() - cpuStart;
+
+    foreach (BenchI2CDevice *device, i2cDevices) {
+        manager.stopReading(device);
+        manager.close(device);
+        delete device;
+    }
+
+    int expected = devices * (duration / interval);
+    QCOMPARE(failed, 0);
+    QVERIFY2(readings > 0, "No readings received from the simulated chips");
+    qDebug().noquote() << QString("%1: %2 of %3 expected readings, period p50 %4 ms, p99 %5 ms, %6 us CPU per reading")
+                          .arg(QTest::currentDataTag())
+                          .arg(readings)
+                          .arg(expected)
+                          .arg(percentile(periods, 50), 0, 'f', 2)
+                          .arg(percentile(periods, 99), 0, 'f', 2)
+                          .arg(cpu / readings);
+
+    QVariantMap metrics;
+    metrics.insert("readings", readings);
+    metrics.insert("periodP50", percentile(periods, 50));
+    metrics.insert("periodP99", percentile(periods, 99));
+    metrics.insert("cpuPerReading", cpu / readings);
+    BenchmarkResults::record(metrics);
+
+    QTest::setBenchmarkResult(readings, QTest::Events);
+}
+
+#include "benchhardware.moc"
+QTEST_MAIN(BenchHardware)
@@ -0,0 +1,11 @@
+include(../../../nymea.pri)
+include(../../auto/autotests.pri)
+
+# Benchmarks are run on demand, not as part of make check
+CONFIG -= testcase
+
+TARGET = benchhardware
+SOURCES += benchhardware.cpp
+
+# openpty() for the simulated Modbus RTU slave
+LIBS += -lutil
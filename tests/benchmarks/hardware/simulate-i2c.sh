@@ -0,0 +1,39 @@
+#!/bin/bash
+
+# Simulated I2C bus for benchhardware. Loads the i2c-stub kernel module, which provides an SMBus adapter
+# named "SMBus stub driver" with simulated chips at the given addresses, and makes its device node
+# accessible for the user running the benchmark.
+#
+# up [user]   load the stub with chips at 0x20 - 0x27, the device node is handed to user ($SUDO_USER by default)
+# down        unload the stub
+
+ADDRESSES=0x20,0x21,0x22,0x23,0x24,0x25,0x26,0x27
+
+usage() {
+  echo "usage: $0 up [user]|down"
+  exit 1
+}
+
+if [ "$(id -u)" -ne 0 ]; then
+  echo "$0 needs to be run as root"
+  exit 1
+fi
+
+case "$1" in
+  up)
+    modprobe i2c-dev || exit 1
+    modprobe i2c-stub chip_addr=${ADDRESSES} || exit 1
+    for adapter in /sys/class/i2c-adapter/*; do
+      if [ "$(cat ${adapter}/name)" == "SMBus stub driver" ]; then
+        chown ${2:-${SUDO_USER:-root}} /dev/$(basename ${adapter})
+        echo "Simulated I2C bus: /dev/$(basename ${adapter})"
+      fi
+    done
+    ;;
+  down)
+    modprobe -r i2c-stub
+    ;;
+  *)
+    usage
+    ;;
+esac
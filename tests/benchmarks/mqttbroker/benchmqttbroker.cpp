@@ -0,0 +1,209 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "nymeatestbase.h"
+#include "benchmarkresults.h"
+
+#include "nymeacore.h"
+#include "servers/mqttbroker.h"
+#include "hardware/network/mqtt/mqttproviderimplementation.h"
+
+#include <mqttclient.h>
+
+#include <QElapsedTimer>
+#include <QEventLoop>
+
+#include <algorithm>
+
+using namespace nymeaserver;
+
+// Measures throughput and latency of the MqttBroker routing between MQTT clients and plugin channels
+// of the MqttProviderImplementation. Each client publishes its next message as soon as the previous
+// one arrived on the other side. Clients, broker and channels share the event loop, so the numbers
+// are the round trip cost of both sides. The duration of each run defaults to 3 seconds and can be
+// changed with NYMEA_BENCH_DURATION (in seconds), e.g. "NYMEA_BENCH_DURATION=10 ./benchmqttbroker".
+class BenchMqttBroker: public NymeaTestBase
+{
+    Q_OBJECT
+
+    enum Direction {
+        DirectionClientToPlugin,
+        DirectionPluginToClient
+    };
+
+private slots:
+    void initTestCase();
+
+    void benchmarkRouting_data();
+    void benchmarkRouting();
+
+private:
+    MqttProviderImplementation *m_provider = nullptr;
+};
+
+void BenchMqttBroker::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\n*.info=false\n*.warning=false\n"
+                                "Tests.debug=true\n");
+
+    m_provider = new MqttProviderImplementation(NymeaCore::instance()->serverManager()->mqttBroker(), this);
+}
+
+void BenchMqttBroker::benchmarkRouting_data()
+{
+    QTest::addColumn<int>("direction");
+    QTest::addColumn<int>("clients");
+
+    QTest::newRow("client to plugin, 1 client") << static_cast<int>(DirectionClientToPlugin) << 1;
+    QTest::newRow("client to plugin, 16 clients") << static_cast<int>(DirectionClientToPlugin) << 16;
+    QTest::newRow("client to plugin, 64 clients") << static_cast<int>(DirectionClientToPlugin) << 64;
+    QTest::newRow("plugin to client, 1 client") << static_cast<int>(DirectionPluginToClient) << 1;
+    QTest::newRow("plugin to client, 16 clients") << static_cast<int>(DirectionPluginToClient) << 16;
+    QTest::newRow("plugin to client, 64 clients") << static_cast<int>(DirectionPluginToClient) << 64;
+}
+
+void BenchMqttBroker::benchmarkRouting()
+{
+    QFETCH(int, direction);
+    QFETCH(int, clients);
+
+    int duration = qEnvironmentVariableIsSet("NYMEA_BENCH_DURATION") ? qEnvironmentVariableIntValue("NYMEA_BENCH_DURATION") * 1000 : 3000;
+
+    // Measure the plain routing, without the slow client limits
+    MqttBroker *broker = NymeaCore::instance()->serverManager()->mqttBroker();
+    int outboundLimit = broker->clientOutboundLimit();
+    broker->setClientOutboundLimit(0);
+    quint64 droppedBefore = broker->droppedPublishes();
+
+    QList<MqttChannel *> channels;
+    QList<MqttClient *> mqttClients;
+    int connected = 0;
+    for (int i = 0; i < clients; i++) {
+        MqttChannel *channel = m_provider->createChannel(QHostAddress::LocalHost, QStringList() << QString("bench/%1").arg(i));
+        QVERIFY2(channel, "Could not create MQTT channel");
+        channels.append(channel);
+
+        MqttClient *mqttClient = new MqttClient(channel->clientId(), this);
+        mqttClient->setUsername(channel->username());
+        mqttClient->setPassword(channel->password());
+        mqttClient->setAutoReconnect(false);
+        connect(mqttClient, &MqttClient::connected, this, [&connected](){ connected++; });
+        mqttClient->connectToHost(channel->serverAddress().toString(), channel->serverPort());
+        mqttClients.append(mqttClient);
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(connected, clients, 10000);
+
+    if (direction == DirectionPluginToClient) {
+        QSignalSpy subscribedSpy(broker, &MqttBroker::clientSubscribed);
+        for (int i = 0; i < clients; i++) {
+            mqttClients.at(i)->subscribe(QString("bench/%1/command").arg(i));
+        }
+        QTRY_COMPARE_WITH_TIMEOUT(subscribedSpy.count(), clients, 10000);
+    }
+
+    QVector<qint64> latencies;
+    int activeClients = clients;
+    QElapsedTimer runTimer;
+    QEventLoop loop;
+
+    for (int i = 0; i < clients; i++) {
+        // The payload carries the send time, the receiving side sends the next message
+        auto received = [&, i](const QByteArray &payload) {
+            latencies.append(runTimer.nsecsElapsed() - payload.toLongLong());
+            if (runTimer.elapsed() >= duration) {
+                if (--activeClients == 0) {
+                    loop.quit();
+                }
+                return;
+            }
+            if (direction == DirectionClientToPlugin) {
+                mqttClients.at(i)->publish(QString("bench/%1/state").arg(i), QByteArray::number(runTimer.nsecsElapsed()));
+            } else {
+                channels.at(i)->publish(QString("bench/%1/command").arg(i), QByteArray::number(runTimer.nsecsElapsed()));
+            }
+        };
+
+        if (direction == DirectionClientToPlugin) {
+            connect(channels.at(i), &MqttChannel::publishReceived, this, [received](MqttChannel *, const QString &, const QByteArray &payload){ received(payload); });
+        } else {
+            connect(mqttClients.at(i), &MqttClient::publishReceived, this, [received](const QString &, const QByteArray &payload){ received(payload); });
+        }
+    }
+
+    runTimer.start();
+    for (int i = 0; i < clients; i++) {
+        if (direction == DirectionClientToPlugin) {
+            mqttClients.at(i)->publish(QString("bench/%1/state").arg(i), QByteArray::number(runTimer.nsecsElapsed()));
+        } else {
+            channels.at(i)->publish(QString("bench/%1/command").arg(i), QByteArray::number(runTimer.nsecsElapsed()));
+        }
+    }
+    QTimer::singleShot(duration + 10000, &loop, &QEventLoop::quit);
+    loop.exec();
+    qint64 elapsed = runTimer.elapsed();
+    bool finished = activeClients == 0;
+
+    foreach (MqttClient *mqttClient, mqttClients) {
+        mqttClient->disconnectFromHost();
+        mqttClient->deleteLater();
+    }
+    foreach (MqttChannel *channel, channels) {
+        m_provider->releaseChannel(channel);
+    }
+    broker->setClientOutboundLimit(outboundLimit);
+
+    QVERIFY2(finished, "Messages got lost");
+    QVERIFY2(!latencies.isEmpty(), "No message arrived");
+
+    std::sort(latencies.begin(), latencies.end());
+    double messagesPerSecond = latencies.count() * 1000.0 / qMax(elapsed, static_cast<qint64>(1));
+    double p50 = latencies.at(latencies.count() / 2) / 1000000.0;
+    double p99 = latencies.at(qMin(latencies.count() - 1, latencies.count() * 99 / 100)) / 1000000.0;
+
+    qCDebug(dcTests()).noquote() << QString("%1: %2 messages/s, p50 %3 ms, p99 %4 ms, %5 dropped by the broker")
+                                    .arg(QTest::currentDataTag())
+                                    .arg(messagesPerSecond, 0, 'f', 0)
+                                    .arg(p50, 0, 'f', 3)
+                                    .arg(p99, 0, 'f', 3)
+                                    .arg(broker->droppedPublishes() - droppedBefore);
+
+    QVariantMap metrics;
+    metrics.insert("throughput", messagesPerSecond);
+    metrics.insert("latencyP50", p50);
+    metrics.insert("latencyP99", p99);
+    metrics.insert("dropped", broker->droppedPublishes() - droppedBefore);
+    BenchmarkResults::record(metrics);
+
+    QTest::setBenchmarkResult(messagesPerSecond, QTest::Events);
+}
+
+#include "benchmqttbroker.moc"
+QTEST_MAIN(BenchMqttBroker)
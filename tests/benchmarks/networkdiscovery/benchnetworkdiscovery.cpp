@@ -0,0 +1,466 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeasettings.h"
+#include "network/ping.h"
+#include "network/networkutils.h"
+#include "benchmarkresults.h"
+#include "network/macaddressdatabase.h"
+#include "network/networkdevicediscovery.h"
+#include "hardware/network/upnp/upnpdiscoveryimplementation.h"
+
+#include <QtTest>
+#include <QSqlQuery>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUdpSocket>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+
+using namespace nymeaserver;
+
+// Answers SSDP searches with a number of simulated root devices and serves their descriptions
+// from a local HTTP server, counting the description requests.
+class BenchSsdpResponder: public QObject
+{
+    Q_OBJECT
+public:
+    explicit BenchSsdpResponder(int devices, QObject *parent = nullptr);
+
+    bool isListening() const { return m_listening; }
+    int searchRequests() const { return m_searchRequests; }
+    int descriptionRequests() const { return m_descriptionRequests; }
+
+private slots:
+    void onReadyRead();
+    void onNewConnection();
+
+private:
+    QUdpSocket *m_socket = nullptr;
+    QTcpServer *m_server = nullptr;
+    int m_devices = 0;
+    bool m_listening = false;
+    int m_searchRequests = 0;
+    int m_descriptionRequests = 0;
+};
+
+BenchSsdpResponder::BenchSsdpResponder(int devices, QObject *parent) :
+    QObject(parent),
+    m_devices(devices)
+{
+    m_server = new QTcpServer(this);
+    connect(m_server, &QTcpServer::newConnection, this, &BenchSsdpResponder::onNewConnection);
+
+    m_socket = new QUdpSocket(this);
+    connect(m_socket, &QUdpSocket::readyRead, this, &BenchSsdpResponder::onReadyRead);
+    m_listening = m_server->listen(QHostAddress::LocalHost)
+            && m_socket->bind(QHostAddress::AnyIPv4, 1900, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint)
+            && m_socket->joinMulticastGroup(QHostAddress("239.255.255.250"));
+}
+
+void BenchSsdpResponder::onReadyRead()
+{
+    while (m_socket->hasPendingDatagrams()) {
+        QByteArray data;
+        QHostAddress address;
+        quint16 port;
+        data.resize(static_cast<int>(m_socket->pendingDatagramSize()));
+        m_socket->readDatagram(data.data(), data.size(), &address, &port);
+        if (!data.startsWith("M-SEARCH"))
+            continue;
+
+        m_searchRequests++;
+        for (int i = 0; i < m_devices; i++) {
+            QByteArray response = "HTTP/1.1 200 OK\r\n"
+                                  "CACHE-CONTROL: max-age=1800\r\n"
+                                  "EXT:\r\n"
+                                  "LOCATION: http://127.0.0.1:" + QByteArray::number(m_server->serverPort()) + "/" + QByteArray::number(i) + ".xml\r\n"
+                                  "SERVER: nymea bench UPnP/1.1\r\n"
+                                  "ST: upnp:rootdevice\r\n"
+                                  "USN: uuid:bench-" + QByteArray::number(i) + "::upnp:rootdevice\r\n"
+                                  "\r\n";
+            m_socket->writeDatagram(response, address, port);
+        }
+    }
+}
+
+void BenchSsdpResponder::onNewConnection()
+{
+    while (m_server->hasPendingConnections()) {
+        QTcpSocket *socket = m_server->nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, this, [=](){
+            QByteArray request = socket->readAll();
+            if (!request.startsWith("GET /"))
+                return;
+
+            m_descriptionRequests++;
+            QByteArray device = request.mid(5, request.indexOf(".xml") - 5);
+            QByteArray description = "<?xml version=\"1.0\"?>\n"
+                                     "<root xmlns=\"urn:schemas-upnp-org:device-1-0\">\n"
+                                     "<specVersion><major>1</major><minor>1</minor></specVersion>\n"
+                                     "<device>\n"
+                                     "<deviceType>urn:schemas-upnp-org:device:Basic:1</deviceType>\n"
+                                     "<friendlyName>Bench device " + device + "</friendlyName>\n"
+                                     "<manufacturer>nymea</manufacturer>\n"
+                                     "<modelName>Bench</modelName>\n"
+                                     "<UDN>uuid:bench-" + device + "</UDN>\n"
+                                     "</device>\n"
+                                     "</root>\n";
+            socket->write("HTTP/1.1 200 OK\r\n"
+                          "Content-Type: text/xml\r\n"
+                          "Content-Length: " + QByteArray::number(description.length()) + "\r\n"
+                          "Connection: close\r\n"
+                          "\r\n" + description);
+            socket->disconnectFromHost();
+        });
+    }
+}
+
+// Measures the network discoveries against simulated hosts: the ping sweep and the end-to-end network
+// device discovery for a /24 and a /22 network, MAC vendor lookups in a generated OUI table and UPnP
+// discoveries of simulated devices. The networks are provided by simulate-hosts.sh, which needs to be
+// run as root ("sudo ./simulate-hosts.sh up"), the benchmark itself needs the CAP_NET_RAW capability.
+// Without the simulated networks the ping and discovery benchmarks are skipped.
+class BenchNetworkDiscovery: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void benchmarkSweep_data();
+    void benchmarkSweep();
+
+    void benchmarkDiscovery();
+
+    void benchmarkVendorLookup_data();
+    void benchmarkVendorLookup();
+
+    void benchmarkUpnpDiscovery_data();
+    void benchmarkUpnpDiscovery();
+
+private:
+    QList<QHostAddress> networkAddresses(const QString &network) const;
+    bool createOuiDatabase(const QString &fileName, int prefixes) const;
+
+    QTemporaryDir m_dataDir;
+};
+
+void BenchNetworkDiscovery::initTestCase()
+{
+    // Keep the network device cache away from the system
+    QCoreApplication::setOrganizationName("nymea-test");
+    QVERIFY(m_dataDir.isValid());
+}
+
+QList<QHostAddress> BenchNetworkDiscovery::networkAddresses(const QString &network) const
+{
+    QPair<QHostAddress, int> subnet = QHostAddress::parseSubnet(network);
+    quint32 start = subnet.first.toIPv4Address();
+    quint32 size = 1u << (32 - subnet.second);
+    QList<QHostAddress> addresses;
+    for (quint32 i = 1; i < size - 1; i++) {
+        addresses.append(QHostAddress(start + i));
+    }
+    return addresses;
+}
+
+bool BenchNetworkDiscovery::createOuiDatabase(const QString &fileName, int prefixes) const
+{
+    // Same layout as the mac-addresses.db: 24, 28 and 36 bit prefixes as hex strings
+    bool success = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), "bench-oui");
+        db.setDatabaseName(fileName);
+        if (db.open()) {
+            db.exec("CREATE TABLE companyNames (companyName TEXT);");
+            db.exec("CREATE TABLE oui (oui TEXT, companyNameIndex INTEGER);");
+            db.transaction();
+            QSqlQuery companyQuery(db);
+            companyQuery.prepare("INSERT INTO companyNames (rowid, companyName) VALUES (?, ?);");
+            QSqlQuery ouiQuery(db);
+            ouiQuery.prepare("INSERT INTO oui (oui, companyNameIndex) VALUES (?, ?);");
+            for (int i = 0; i < prefixes; i++) {
+                companyQuery.addBindValue(i + 1);
+                companyQuery.addBindValue(QString("Bench company %1").arg(i));
+                companyQuery.exec();
+
+                // Mostly 24 bit prefixes, every 10th one a longer 28 or 36 bit prefix
+                int digits = i % 10 == 0 ? (i % 20 == 0 ? 9 : 7) : 6;
+                quint64 prefix = (static_cast<quint64>(i) * 2654435761u) & ((1ull << (digits * 4)) - 1);
+                ouiQuery.addBindValue(QString("%1").arg(prefix, digits, 16, QChar('0')).toUpper());
+                ouiQuery.addBindValue(i + 1);
+                ouiQuery.exec();
+            }
+            success = db.commit();
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase("bench-oui");
+    return success;
+}
+
+void BenchNetworkDiscovery::benchmarkSweep_data()
+{
+    QTest::addColumn<QString>("network");
+    QTest::addColumn<int>("rate");
+
+    QTest::newRow("/24, 2000 pps") << "10.124.0.0/24" << 2000;
+    QTest::newRow("/24, 10000 pps") << "10.124.0.0/24" << 10000;
+    QTest::newRow("/22, 2000 pps") << "10.122.0.0/22" << 2000;
+    QTest::newRow("/22, 10000 pps") << "10.122.0.0/22" << 10000;
+}
+
+void BenchNetworkDiscovery::benchmarkSweep()
+{
+    QFETCH(QString, network);
+    QFETCH(int, rate);
+
+    QList<QHostAddress> addresses = networkAddresses(network);
+    if (!NetworkUtils::getInterfaceForHostaddress(addresses.first()).isValid())
+        QSKIP("The simulated network is not available. Run simulate-hosts.sh up as root.");
+
+    Ping ping;
+    if (!ping.available())
+        QSKIP("Ping is not available, the CAP_NET_RAW capability is required.");
+
+    ping.setSweepRate(rate);
+
+    QElapsedTimer timer;
+    timer.start();
+    PingSweepReply *reply = ping.sweep(addresses);
+    QSignalSpy finishedSpy(reply, &PingSweepReply::finished);
+    QVERIFY(finishedSpy.wait(30000));
+    qint64 elapsed = timer.elapsed();
+
+    QVERIFY2(reply->error() == PingReply::ErrorNoError, "The ping sweep failed");
+    QVERIFY2(!reply->respondedAddresses().isEmpty(), "No simulated host responded");
+
+    QList<double> durations;
+    foreach (const QHostAddress &address, reply->respondedAddresses()) {
+        durations.append(reply->duration(address));
+    }
+    std::sort(durations.begin(), durations.end());
+
+    qDebug().noquote() << QString("%1: %2 ms, %3 packets sent, %4 of %5 hosts responded, p50 %6 ms, p99 %7 ms")
+                          .arg(QTest::currentDataTag())
+                          .arg(elapsed)
+                          .arg(reply->sentCount())
+                          .arg(reply->respondedAddresses().count())
+                          .arg(addresses.count())
+                          .arg(durations.at(durations.count() / 2), 0, 'f', 3)
+                          .arg(durations.at(qMin(durations.count() - 1, durations.count() * 99 / 100)), 0, 'f', 3);
+
+    QVariantMap metrics;
+    metrics.insert("duration", elapsed);
+    metrics.insert("latencyP50", durations.at(durations.count() / 2));
+    metrics.insert("latencyP99", durations.at(qMin(durations.count() - 1, durations.count() * 99 / 100)));
+    metrics.insert("responded", reply->respondedAddresses().count());
+    BenchmarkResults::record(metrics);
+
+    QTest::setBenchmarkResult(elapsed, QTest::WalltimeMilliseconds);
+}
+
+void BenchNetworkDiscovery::benchmarkDiscovery()
+{
+    QList<QHostAddress> addresses24 = networkAddresses("10.124.0.0/24");
+    QList<QHostAddress> addresses22 = networkAddresses("10.122.0.0/22");
+    if (!NetworkUtils::getInterfaceForHostaddress(addresses24.first()).isValid() || !NetworkUtils::getInterfaceForHostaddress(addresses22.first()).isValid())
+        QSKIP("The simulated networks are not available. Run simulate-hosts.sh up as root.");
+
+    QFile::remove(NymeaSettings::storagePath() + "/networkdevices.conf");
+    NetworkDeviceDiscovery discovery;
+    if (!discovery.available())
+        QSKIP("The network device discovery is not available, the CAP_NET_RAW capability is required.");
+
+    // Fresh discovery of all local networks, including the simulated ones
+    QElapsedTimer timer;
+    timer.start();
+    NetworkDeviceDiscoveryReply *reply = discovery.discover(true);
+    QSignalSpy finishedSpy(reply, &NetworkDeviceDiscoveryReply::finished);
+    QVERIFY(finishedSpy.wait(60000));
+    qint64 elapsed = timer.elapsed();
+
+    int found24 = 0;
+    int found22 = 0;
+    int withMacAddress = 0;
+    foreach (const NetworkDeviceInfo &networkDeviceInfo, reply->networkDeviceInfos()) {
+        if (networkDeviceInfo.address().isInSubnet(QHostAddress::parseSubnet("10.124.0.0/24")))
+            found24++;
+
+        if (networkDeviceInfo.address().isInSubnet(QHostAddress::parseSubnet("10.122.0.0/22")))
+            found22++;
+
+        if (!networkDeviceInfo.macAddress().isEmpty())
+            withMacAddress++;
+    }
+
+    // The next discovery is answered by the cache
+    QElapsedTimer cacheTimer;
+    cacheTimer.start();
+    NetworkDeviceDiscoveryReply *cachedReply = discovery.discover();
+    QSignalSpy cachedSpy(cachedReply, &NetworkDeviceDiscoveryReply::finished);
+    QVERIFY(cachedSpy.wait(60000));
+    qint64 cacheElapsed = cacheTimer.elapsed();
+
+    QVERIFY2(found24 > 0 && found22 > 0, "No simulated host discovered");
+    qDebug().noquote() << QString("fresh discovery: %1 ms, %2 devices (%3 in the /24, %4 in the /22, %5 with MAC address), cached discovery: %6 ms")
+                          .arg(elapsed)
+                          .arg(reply->networkDeviceInfos().count())
+                          .arg(found24)
+                          .arg(found22)
+                          .arg(withMacAddress)
+                          .arg(cacheElapsed);
+    QTest::setBenchmarkResult(elapsed, QTest::WalltimeMilliseconds);
+}
+
+void BenchNetworkDiscovery::benchmarkVendorLookup_data()
+{
+    QTest::addColumn<int>("lookups");
+
+    QTest::newRow("254 lookups (/24)") << 254;
+    QTest::newRow("1022 lookups (/22)") << 1022;
+}
+
+void BenchNetworkDiscovery::benchmarkVendorLookup()
+{
+    QFETCH(int, lookups);
+
+    // About the size of the IEEE registry
+    QString databaseName = m_dataDir.filePath(QString("mac-addresses-%1.db").arg(lookups));
+    QVERIFY2(createOuiDatabase(databaseName, 40000), "Could not create the OUI database");
+
+    QElapsedTimer timer;
+    timer.start();
+    MacAddressDatabase database(databaseName);
+    QVERIFY(database.available());
+
+    // The first reply waits for the table to be loaded
+    int finished = 0;
+    int resolved = 0;
+    qint64 loadTime = 0;
+    for (int i = 0; i < lookups; i++) {
+        quint64 macAddress = (static_cast<quint64>(i) * 2654435761u) & 0xffffff;
+        QString macAddressString = QString("%1:00:00:%2").arg(macAddress, 6, 16, QChar('0')).arg(i % 256, 2, 16, QChar('0'));
+        macAddressString.insert(2, ':').insert(5, ':');
+        MacAddressDatabaseReply *reply = database.lookupMacAddress(macAddressString);
+        connect(reply, &MacAddressDatabaseReply::finished, this, [&, reply](){
+            if (finished++ == 0)
+                loadTime = timer.elapsed();
+
+            if (!reply->manufacturer().isEmpty())
+                resolved++;
+        });
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(finished, lookups, 30000);
+    qint64 elapsed = timer.elapsed();
+
+    // Lookups once the table is loaded
+    QElapsedTimer lookupTimer;
+    lookupTimer.start();
+    finished = 0;
+    for (int i = 0; i < lookups; i++) {
+        MacAddressDatabaseReply *reply = database.lookupMacAddress(QString("00:00:%1:00:00:01").arg(i % 256, 2, 16, QChar('0')));
+        connect(reply, &MacAddressDatabaseReply::finished, this, [&](){ finished++; });
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(finished, lookups, 30000);
+    qint64 lookupElapsed = lookupTimer.nsecsElapsed();
+
+    qDebug().noquote() << QString("%1: %2 ms including loading the table (first result after %3 ms), %4 resolved, %5 us per lookup with the table loaded")
+                          .arg(QTest::currentDataTag())
+                          .arg(elapsed)
+                          .arg(loadTime)
+                          .arg(resolved)
+                          .arg(lookupElapsed / 1000.0 / lookups, 0, 'f', 2);
+    QTest::setBenchmarkResult(elapsed, QTest::WalltimeMilliseconds);
+}
+
+void BenchNetworkDiscovery::benchmarkUpnpDiscovery_data()
+{
+    QTest::addColumn<int>("devices");
+
+    QTest::newRow("16 devices") << 16;
+    QTest::newRow("64 devices") << 64;
+    QTest::newRow("256 devices") << 256;
+}
+
+void BenchNetworkDiscovery::benchmarkUpnpDiscovery()
+{
+    QFETCH(int, devices);
+
+    // The responder has to bind before the discovery, the last socket bound on the port receives the responses
+    BenchSsdpResponder responder(devices);
+    if (!responder.isListening())
+        QSKIP("Could not bind the SSDP port.");
+
+    QNetworkAccessManager networkAccessManager;
+    UpnpDiscoveryImplementation upnpDiscovery(&networkAccessManager);
+    if (!upnpDiscovery.enable())
+        QSKIP("The UPnP discovery is not available on this system.");
+
+    QElapsedTimer timer;
+    timer.start();
+    UpnpDiscoveryReply *reply = upnpDiscovery.discoverDevices("upnp:rootdevice", QString(), 3000);
+    QSignalSpy finishedSpy(reply, &UpnpDiscoveryReply::finished);
+    QVERIFY(finishedSpy.wait(10000));
+    qint64 elapsed = timer.elapsed();
+
+    int found = 0;
+    foreach (const UpnpDeviceDescriptor &deviceDescriptor, reply->deviceDescriptors()) {
+        if (deviceDescriptor.uuid().startsWith("uuid:bench-"))
+            found++;
+    }
+    if (responder.searchRequests() > 0 && found == 0)
+        QSKIP("The SSDP responses did not arrive, another process might be bound to the SSDP port.");
+
+    // Searching again within the cache time is served from the cache, without fetching descriptions again
+    QElapsedTimer cacheTimer;
+    cacheTimer.start();
+    UpnpDiscoveryReply *cachedReply = upnpDiscovery.discoverDevices("upnp:rootdevice", QString(), 3000);
+    QSignalSpy cachedSpy(cachedReply, &UpnpDiscoveryReply::finished);
+    QVERIFY(cachedSpy.wait(10000));
+    qint64 cacheElapsed = cacheTimer.nsecsElapsed();
+
+    QCOMPARE(found, devices);
+    QCOMPARE(responder.descriptionRequests(), devices);
+
+    qDebug().noquote() << QString("%1: %2 of %3 devices described in %4 ms (3000 ms search timeout), %5 description requests, cached discovery: %6 ms")
+                          .arg(QTest::currentDataTag())
+                          .arg(found)
+                          .arg(devices)
+                          .arg(elapsed)
+                          .arg(responder.descriptionRequests())
+                          .arg(cacheElapsed / 1000000.0, 0, 'f', 3);
+    QTest::setBenchmarkResult(cacheElapsed / 1000000.0, QTest::WalltimeMilliseconds);
+}
+
+#include "benchnetworkdiscovery.moc"
+QTEST_MAIN(BenchNetworkDiscovery)
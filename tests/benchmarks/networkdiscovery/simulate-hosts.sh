@@ -0,0 +1,62 @@
+#!/bin/bash
+
+# Simulated hosts for benchnetworkdiscovery. Creates the network namespace nymea-bench connected with
+# one veth pair per benchmark network. The namespace side carries the addresses of the simulated hosts,
+# the kernel answers ARP and ping requests for all of them.
+#
+#   10.124.0.0/24   nbench24 <-> nbench24p   hosts 10.124.0.2 - 10.124.0.254
+#   10.122.0.0/22   nbench22 <-> nbench22p   hosts 10.122.0.2 - 10.122.3.254
+#
+# Every ${STEP} address is a host, 1 by default (all of them).
+
+NAMESPACE=nymea-bench
+STEP=${STEP:-1}
+
+usage() {
+  echo "usage: $0 up|down"
+  exit 1
+}
+
+add_network() {
+  local name=$1 prefix=$2 blocks=$3 size=$4
+
+  ip link add ${name} type veth peer name ${name}p
+  ip link set ${name}p netns ${NAMESPACE}
+  ip addr add ${prefix}.0.1/${size} dev ${name}
+  ip link set ${name} up
+  ip netns exec ${NAMESPACE} ip link set ${name}p up
+
+  local count=0
+  for ((block = 0; block < blocks; block++)); do
+    for ((host = 1; host < 255; host++)); do
+      if [ ${block} -eq 0 ] && [ ${host} -eq 1 ]; then
+        continue
+      fi
+      count=$((count + 1))
+      if [ $((count % STEP)) -eq 0 ]; then
+        echo "addr add ${prefix}.${block}.${host}/${size} dev ${name}p"
+      fi
+    done
+  done | ip netns exec ${NAMESPACE} ip -batch -
+}
+
+if [ "$(id -u)" -ne 0 ]; then
+  echo "$0 needs to be run as root"
+  exit 1
+fi
+
+case "$1" in
+  up)
+    ip netns add ${NAMESPACE} || exit 1
+    add_network nbench24 10.124 1 24
+    add_network nbench22 10.122 4 22
+    ;;
+  down)
+    ip link del nbench24 2>/dev/null
+    ip link del nbench22 2>/dev/null
+    ip netns del ${NAMESPACE}
+    ;;
+  *)
+    usage
+    ;;
+esac
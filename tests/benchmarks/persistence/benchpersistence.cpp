@@ -0,0 +1,393 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+#include "benchmarkresults.h"
+
+#include "nymeacore.h"
+#include "nymeasettings.h"
+#include "integrations/thingstatecache.h"
+#include "ruleengine/ruleengine.h"
+#include "ruleengine/rulestore.h"
+#include "tagging/tagsstorage.h"
+
+#include <QDir>
+#include <QFile>
+#include <QElapsedTimer>
+
+using namespace nymeaserver;
+
+// Measures how loading and storing the configuration scales with the number of things, rules and tags, and how
+// many bytes each change writes to disk. Bytes are taken from the wchar counter in /proc/self/io, which counts all
+// writes of the process, so keep logging off while running this. Run with e.g. "./benchpersistence -tickcounter".
+class BenchPersistence: public NymeaTestBase
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+
+    void benchmarkStartup_data();
+    void benchmarkStartup();
+
+    void benchmarkRuleEngineInit_data();
+    void benchmarkRuleEngineInit();
+
+    void benchmarkTagsStorageInit_data();
+    void benchmarkTagsStorageInit();
+
+    void benchmarkEditThing_data();
+    void benchmarkEditThing();
+
+    void benchmarkSaveRule_data();
+    void benchmarkSaveRule();
+
+    void benchmarkStateChange_data();
+    void benchmarkStateChange();
+
+private:
+    void addThings(int count);
+    void addRules(int count);
+    void addTags(int count);
+    void removeAll();
+    void flush();
+
+    static void addDataRows();
+    static qint64 bytesWritten();
+    static qint64 fileSize(const QString &path);
+
+    QList<ThingId> m_things;
+    QList<RuleId> m_rules;
+};
+
+void BenchPersistence::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\n*.info=false\n*.warning=false\n"
+                                "Tests.debug=true\n");
+}
+
+void BenchPersistence::cleanup()
+{
+    removeAll();
+    NymeaTestBase::cleanup();
+}
+
+void BenchPersistence::addThings(int count)
+{
+    for (int i = 0; i < count; i++) {
+        QVariantMap params;
+        params.insert("thingClassId", virtualIoLightMockThingClassId);
+        params.insert("name", QString("Benchmark light %1").arg(i));
+        QVariant response = injectAndWait("Integrations.AddThing", params);
+        ThingId thingId = response.toMap().value("params").toMap().value("thingId").toUuid();
+        QVERIFY2(!thingId.isNull(), "Creating virtual light failed");
+        m_things.append(thingId);
+    }
+}
+
+// One rule per thing, switching the thing whenever it gets switched. Added in one batch like a backup restore.
+void BenchPersistence::addRules(int count)
+{
+    QList<Rule> rules;
+    for (int i = 0; i < count; i++) {
+        ThingId thingId = m_things.at(i % m_things.count());
+        RuleAction action(virtualIoLightMockPowerActionTypeId, thingId, RuleActionParams() << RuleActionParam(virtualIoLightMockPowerActionPowerParamTypeId, true));
+        Rule rule;
+        rule.setId(RuleId::createRuleId());
+        rule.setName(QString("Benchmark rule %1").arg(i));
+        rule.setEventDescriptors(QList<EventDescriptor>() << EventDescriptor(EventTypeId(virtualIoLightMockPowerStateTypeId), thingId));
+        rule.setActions(QList<RuleAction>() << action);
+        rules.append(rule);
+        m_rules.append(rule.id());
+    }
+    QCOMPARE(NymeaCore::instance()->ruleEngine()->addRules(rules), RuleEngine::RuleErrorNoError);
+}
+
+void BenchPersistence::addTags(int count)
+{
+    for (int i = 0; i < count; i++) {
+        Tag tag(m_things.at(i % m_things.count()), "benchmark", QString("tag-%1").arg(i), "value");
+        QCOMPARE(NymeaCore::instance()->tagsStorage()->addTag(tag), TagsStorage::TagErrorNoError);
+    }
+}
+
+void BenchPersistence::removeAll()
+{
+    foreach (const RuleId &ruleId, m_rules) {
+        NymeaCore::instance()->ruleEngine()->removeRule(ruleId);
+    }
+    m_rules.clear();
+    // Tags of a thing go along with it
+    foreach (const ThingId &thingId, m_things) {
+        NymeaCore::instance()->thingManager()->removeConfiguredThing(thingId);
+    }
+    m_things.clear();
+    flush();
+}
+
+// Lets the deferred writes of the thing configuration and the tags happen
+void BenchPersistence::flush()
+{
+    QCoreApplication::processEvents();
+    QCoreApplication::processEvents();
+}
+
+void BenchPersistence::addDataRows()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+    QTest::newRow("500") << 500;
+}
+
+qint64 BenchPersistence::bytesWritten()
+{
+    QFile io("/proc/self/io");
+    if (!io.open(QFile::ReadOnly)) {
+        return 0;
+    }
+    foreach (const QByteArray &line, io.readAll().split('\n')) {
+        if (line.startsWith("wchar:")) {
+            return line.mid(6).trimmed().toLongLong();
+        }
+    }
+    return 0;
+}
+
+qint64 BenchPersistence::fileSize(const QString &path)
+{
+    QFileInfo info(path);
+    if (!info.isDir()) {
+        return info.size();
+    }
+    qint64 size = 0;
+    foreach (const QFileInfo &entry, QDir(path).entryInfoList(QDir::Files)) {
+        size += entry.size();
+    }
+    return size;
+}
+
+void BenchPersistence::benchmarkStartup_data()
+{
+    addDataRows();
+}
+
+// The whole restart, thing loading from things.conf included. Rules and tags are added for every thing.
+void BenchPersistence::benchmarkStartup()
+{
+    QFETCH(int, count);
+
+    addThings(count);
+    addRules(count);
+    addTags(count);
+    flush();
+
+    qCDebug(dcTests()) << "Configuration on disk with" << count << "things, rules and tags:"
+                       << "things" << fileSize(NymeaSettings(NymeaSettings::SettingsRoleThings).fileName())
+                       << "rules" << fileSize(RuleStore::defaultPath())
+                       << "tags" << fileSize(NymeaSettings(NymeaSettings::SettingsRoleTags).fileName())
+                       << "states" << fileSize(ThingStateCache::defaultFileName()) << "bytes";
+
+    QElapsedTimer timer;
+    timer.start();
+    restartServer();
+    qint64 elapsed = timer.elapsed();
+    QCOMPARE(NymeaCore::instance()->thingManager()->findConfiguredThings(virtualIoLightMockThingClassId).count(), count);
+
+    QVariantMap metrics;
+    metrics.insert("duration", elapsed);
+    metrics.insert("latencyP50", elapsed);
+    metrics.insert("latencyP90", elapsed);
+    metrics.insert("latencyP99", elapsed);
+    BenchmarkResults::record(metrics);
+
+    QTest::setBenchmarkResult(elapsed, QTest::WalltimeMilliseconds);
+}
+
+void BenchPersistence::benchmarkRuleEngineInit_data()
+{
+    addDataRows();
+}
+
+void BenchPersistence::benchmarkRuleEngineInit()
+{
+    QFETCH(int, count);
+
+    addThings(1);
+    addRules(count);
+
+    // A second engine loading the rules of the running one
+    QVector<qint64> latencies;
+    QElapsedTimer timer;
+    QBENCHMARK {
+        timer.start();
+        RuleEngine ruleEngine;
+        ruleEngine.init();
+        latencies.append(timer.nsecsElapsed());
+        QCOMPARE(ruleEngine.ruleIds().count(), count);
+    }
+    BenchmarkResults::recordLatencies(latencies);
+}
+
+void BenchPersistence::benchmarkTagsStorageInit_data()
+{
+    addDataRows();
+}
+
+// Note that tags.conf is shared with the running instance and is parsed from memory, not read from disk again
+void BenchPersistence::benchmarkTagsStorageInit()
+{
+    QFETCH(int, count);
+
+    addThings(1);
+    addTags(count);
+    flush();
+
+    QVector<qint64> latencies;
+    QElapsedTimer timer;
+    QBENCHMARK {
+        timer.start();
+        TagsStorage tagsStorage(NymeaCore::instance()->thingManager(), NymeaCore::instance()->ruleEngine());
+        latencies.append(timer.nsecsElapsed());
+        QCOMPARE(tagsStorage.tags().count(), count);
+    }
+    BenchmarkResults::recordLatencies(latencies);
+}
+
+void BenchPersistence::benchmarkEditThing_data()
+{
+    addDataRows();
+}
+
+void BenchPersistence::benchmarkEditThing()
+{
+    QFETCH(int, count);
+
+    addThings(count);
+    flush();
+
+    const int edits = 20;
+    qint64 before = bytesWritten();
+    for (int i = 0; i < edits; i++) {
+        NymeaCore::instance()->thingManager()->editThing(m_things.first(), QString("Renamed %1").arg(i));
+        flush();
+    }
+    qint64 bytesPerEdit = (bytesWritten() - before) / edits;
+    qCDebug(dcTests()) << "Bytes written per thing edit with" << count << "things:" << bytesPerEdit;
+
+    int i = 0;
+    QVector<qint64> latencies;
+    QElapsedTimer timer;
+    QBENCHMARK {
+        timer.start();
+        NymeaCore::instance()->thingManager()->editThing(m_things.first(), QString("Renamed %1").arg(i++));
+        flush();
+        latencies.append(timer.nsecsElapsed());
+    }
+
+    QVariantMap metrics;
+    metrics.insert("bytesPerEdit", bytesPerEdit);
+    BenchmarkResults::recordLatencies(latencies, metrics);
+}
+
+void BenchPersistence::benchmarkSaveRule_data()
+{
+    addDataRows();
+}
+
+void BenchPersistence::benchmarkSaveRule()
+{
+    QFETCH(int, count);
+
+    addThings(1);
+    addRules(count);
+
+    const int edits = 20;
+    Rule rule = NymeaCore::instance()->ruleEngine()->findRule(m_rules.first());
+    qint64 before = bytesWritten();
+    for (int i = 0; i < edits; i++) {
+        rule.setName(QString("Renamed %1").arg(i));
+        QCOMPARE(NymeaCore::instance()->ruleEngine()->editRule(rule), RuleEngine::RuleErrorNoError);
+    }
+    qint64 bytesPerEdit = (bytesWritten() - before) / edits;
+    qCDebug(dcTests()) << "Bytes written per rule edit with" << count << "rules:" << bytesPerEdit;
+
+    int i = 0;
+    QVector<qint64> latencies;
+    QElapsedTimer timer;
+    QBENCHMARK {
+        rule.setName(QString("Renamed %1").arg(i++));
+        timer.start();
+        NymeaCore::instance()->ruleEngine()->editRule(rule);
+        latencies.append(timer.nsecsElapsed());
+    }
+
+    QVariantMap metrics;
+    metrics.insert("bytesPerEdit", bytesPerEdit);
+    BenchmarkResults::recordLatencies(latencies, metrics);
+}
+
+void BenchPersistence::benchmarkStateChange_data()
+{
+    addDataRows();
+}
+
+// The state cache is written in the background once a minute, so a state change itself doesn't write anything.
+// A flush appends the changed things to the journal, only compacting it rewrites the whole snapshot.
+void BenchPersistence::benchmarkStateChange()
+{
+    QFETCH(int, count);
+
+    addThings(count);
+    restartServer();
+    qCDebug(dcTests()) << "State cache size with" << count << "things:" << fileSize(ThingStateCache::defaultFileName()) << "bytes";
+
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_things.first());
+    QVERIFY(thing);
+
+    bool power = false;
+    QVector<qint64> latencies;
+    QElapsedTimer timer;
+    QBENCHMARK {
+        power = !power;
+        timer.start();
+        thing->setStateValue(virtualIoLightMockPowerStateTypeId, power);
+        latencies.append(timer.nsecsElapsed());
+    }
+
+    QVariantMap metrics;
+    metrics.insert("stateCacheSize", fileSize(ThingStateCache::defaultFileName()));
+    BenchmarkResults::recordLatencies(latencies, metrics);
+}
+
+#include "benchpersistence.moc"
+QTEST_MAIN(BenchPersistence)
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+
+# Runs the benchmarks of a nymea build and writes their results to one JSON file.
+#
+#   run-benchmarks.py --build-dir <top build dir> --output results.json [--only throughput webserver]
+#
+# Every benchmark runs its fixed data rows against the mock plugin. The results contain the value
+# reported to QtTest by each data row, plus the metrics recorded with BenchmarkResults::record()
+# (throughput, latency percentiles, RSS, ...). Benchmarks requiring a simulated environment skip
+# their data rows if it isn't set up, see simulate-hosts.sh and simulate-i2c.sh.
+#
+# Compare two result files with compare-benchmarks.py.
+
+import argparse
+import datetime
+import json
+import os
+import platform
+import shutil
+import subprocess
+import sys
+import tempfile
+import xml.etree.ElementTree as ElementTree
+
+BENCHMARKS = [
+    ("throughput", "benchthroughput"),
+    ("clientscaling", "benchclientscaling"),
+    ("webserver", "benchwebserver"),
+    ("scripts", "benchscripts"),
+    ("coap", "benchcoap"),
+    ("mqttbroker", "benchmqttbroker"),
+    ("networkdiscovery", "benchnetworkdiscovery"),
+    ("hardware", "benchhardware"),
+    ("persistence", "benchpersistence"),
+]
+
+
+def parse_qtest_xml(file_name, benchmark):
+    results = {}
+    skipped = []
+    try:
+        root = ElementTree.parse(file_name).getroot()
+    except (ElementTree.ParseError, OSError) as error:
+        print("Could not parse the results of %s: %s" % (benchmark, error), file=sys.stderr)
+        return results, skipped
+
+    for function in root.iter("TestFunction"):
+        function_name = function.get("name")
+        for result in function.iter("BenchmarkResult"):
+            iterations = max(int(result.get("iterations", "1")), 1)
+            key = (benchmark, function_name, result.get("tag", ""))
+            results[key] = {
+                "result": float(result.get("value")) / iterations,
+                "resultMetric": result.get("metric"),
+            }
+        for incident in function.iter("Incident"):
+            if incident.get("type") == "skip":
+                tag = incident.findtext("DataTag", default="")
+                skipped.append("%s::%s %s" % (benchmark, function_name, tag))
+    return results, skipped
+
+
+def run_benchmark(build_dir, directory, binary, records_file):
+    executable = os.path.join(build_dir, "tests", "benchmarks", directory, binary)
+    if not os.path.exists(executable):
+        print("Skipping %s, %s has not been built" % (directory, executable), file=sys.stderr)
+        return None
+
+    xml_file = records_file + "." + binary + ".xml"
+    arguments = [executable, "-o", xml_file + ",xml", "-o", "-,txt"]
+    if shutil.which("dbus-test-runner"):
+        command = ["dbus-test-runner", "--bus-type=both", "--task", executable]
+        for argument in arguments[1:]:
+            command += ["--parameter", argument]
+    else:
+        command = arguments
+
+    environment = dict(os.environ)
+    library_paths = [os.path.join(build_dir, path) for path in ("libnymea", "libnymea-core", "tests/testlib")]
+    if environment.get("LD_LIBRARY_PATH"):
+        library_paths.append(environment["LD_LIBRARY_PATH"])
+    environment["LD_LIBRARY_PATH"] = ":".join(library_paths)
+    environment["NYMEA_BENCHMARK_RESULTS"] = records_file
+
+    print("Running %s" % binary, file=sys.stderr)
+    exit_code = subprocess.call(command, cwd=os.path.dirname(executable), env=environment)
+    results, skipped = parse_qtest_xml(xml_file, binary)
+    if os.path.exists(xml_file):
+        os.remove(xml_file)
+    return exit_code, results, skipped
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Run the nymea benchmarks and write the results as JSON.")
+    parser.add_argument("--build-dir", default=".", help="The top level build directory")
+    parser.add_argument("--output", default="benchmark-results.json", help="The result file to write")
+    parser.add_argument("--only", nargs="*", help="Only run the given benchmarks, e.g. throughput webserver")
+    args = parser.parse_args()
+
+    build_dir = os.path.abspath(args.build_dir)
+    records_fd, records_file = tempfile.mkstemp(prefix="nymea-benchmarks-", suffix=".jsonl")
+    os.close(records_fd)
+    results = {}
+    skipped = []
+    failed = []
+
+    for directory, binary in BENCHMARKS:
+        if args.only and directory not in args.only:
+            continue
+        run = run_benchmark(build_dir, directory, binary, records_file)
+        if run is None:
+            continue
+        exit_code, benchmark_results, benchmark_skipped = run
+        if exit_code != 0:
+            failed.append(binary)
+        skipped += benchmark_skipped
+        for key, values in benchmark_results.items():
+            results.setdefault(key, {}).update(values)
+
+    if os.path.exists(records_file):
+        with open(records_file) as records:
+            for line in records:
+                record = json.loads(line)
+                key = (record["benchmark"], record["function"], record["tag"])
+                results.setdefault(key, {}).update(record["metrics"])
+        os.remove(records_file)
+
+    document = {
+        "date": datetime.datetime.now(datetime.timezone.utc).isoformat(),
+        "host": platform.node(),
+        "machine": platform.machine(),
+        "failed": failed,
+        "skipped": skipped,
+        "results": [
+            {"benchmark": key[0], "function": key[1], "tag": key[2], "metrics": results[key]}
+            for key in sorted(results)
+        ],
+    }
+    with open(args.output, "w") as output:
+        json.dump(document, output, indent=2, sort_keys=True)
+    print("Wrote %d results to %s" % (len(results), args.output), file=sys.stderr)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
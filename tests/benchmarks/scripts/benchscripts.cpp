@@ -0,0 +1,273 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "nymeatestbase.h"
+#include "benchmarkresults.h"
+
+#include "nymeacore.h"
+#include "scriptengine/scriptengine.h"
+
+#include <QElapsedTimer>
+
+using namespace nymeaserver;
+
+// Measures how the ScriptEngine scales with the number of scripts and script items. Run with e.g.
+// "./benchscripts -tickcounter" or "-callgrind" for more stable numbers than wall time.
+class BenchScripts: public NymeaTestBase
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+
+    void benchmarkStateDelivery_data();
+    void benchmarkStateDelivery();
+
+    void benchmarkEventDelivery_data();
+    void benchmarkEventDelivery();
+
+    void benchmarkScriptLoad_data();
+    void benchmarkScriptLoad();
+
+    void benchmarkScriptMemory_data();
+    void benchmarkScriptMemory();
+
+private:
+    QString stateScript(int states, int unrelatedStates) const;
+    QString eventScript(int events) const;
+    void addScripts(int count, const QString &content, QVector<qint64> *latencies = nullptr);
+    void removeScripts();
+    void togglePower();
+
+    bool m_power = false;
+};
+
+void BenchScripts::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\n*.info=false\n*.warning=false\n"
+                                "Tests.debug=true\n");
+}
+
+void BenchScripts::cleanup()
+{
+    removeScripts();
+    NymeaTestBase::cleanup();
+}
+
+// A script with the given number of ThingStates on the mock power state, and ThingStates on another state
+// which must not be bothered by power changes.
+QString BenchScripts::stateScript(int states, int unrelatedStates) const
+{
+    QString script = "import QtQuick 2.0\nimport nymea 1.0\nItem {\n    property int changes: 0\n";
+    for (int i = 0; i < states; i++) {
+        script += QString("    ThingState {\n"
+                          "        thingId: \"%1\"\n"
+                          "        stateTypeId: \"%2\"\n"
+                          "        onValueChanged: changes++\n"
+                          "    }\n").arg(m_mockThingId.toString()).arg(mockPowerStateTypeId.toString());
+    }
+    for (int i = 0; i < unrelatedStates; i++) {
+        script += QString("    ThingState {\n"
+                          "        thingId: \"%1\"\n"
+                          "        stateTypeId: \"%2\"\n"
+                          "        onValueChanged: changes++\n"
+                          "    }\n").arg(m_mockThingId.toString()).arg(mockBatteryLevelStateTypeId.toString());
+    }
+    script += "}\n";
+    return script;
+}
+
+QString BenchScripts::eventScript(int events) const
+{
+    QString script = "import QtQuick 2.0\nimport nymea 1.0\nItem {\n    property int events: 0\n";
+    for (int i = 0; i < events; i++) {
+        script += QString("    ThingEvent {\n"
+                          "        thingId: \"%1\"\n"
+                          "        eventTypeId: \"%2\"\n"
+                          "        onTriggered: events++\n"
+                          "    }\n").arg(m_mockThingId.toString()).arg(mockPowerEventTypeId.toString());
+    }
+    script += "}\n";
+    return script;
+}
+
+void BenchScripts::addScripts(int count, const QString &content, QVector<qint64> *latencies)
+{
+    QElapsedTimer timer;
+    for (int i = 0; i < count; i++) {
+        timer.start();
+        ScriptEngine::AddScriptReply reply = NymeaCore::instance()->scriptEngine()->addScript(QString("Benchmark %1").arg(i), content.toUtf8());
+        if (latencies) {
+            latencies->append(timer.nsecsElapsed());
+        }
+        QCOMPARE(reply.scriptError, ScriptEngine::ScriptErrorNoError);
+    }
+}
+
+void BenchScripts::removeScripts()
+{
+    foreach (const Script &script, NymeaCore::instance()->scriptEngine()->scripts()) {
+        NymeaCore::instance()->scriptEngine()->removeScript(script.id());
+    }
+}
+
+void BenchScripts::togglePower()
+{
+    // Plain script items are notified synchronously, so this covers the whole dispatch
+    m_power = !m_power;
+    Action action(mockPowerActionTypeId, m_mockThingId);
+    action.setParams(ParamList() << Param(mockPowerActionPowerParamTypeId, m_power));
+    NymeaCore::instance()->thingManager()->executeAction(action);
+}
+
+void BenchScripts::benchmarkStateDelivery_data()
+{
+    QTest::addColumn<int>("scripts");
+    QTest::addColumn<int>("states");
+    QTest::addColumn<int>("unrelatedStates");
+
+    QTest::newRow("1 script, 1 state") << 1 << 1 << 0;
+    QTest::newRow("1 script, 30 states") << 1 << 30 << 0;
+    QTest::newRow("10 scripts, 1 state, 10 unrelated") << 10 << 1 << 10;
+    QTest::newRow("80 scripts, 1 state") << 80 << 1 << 0;
+    QTest::newRow("80 scripts, 1 state, 10 unrelated") << 80 << 1 << 10;
+    QTest::newRow("80 scripts, 10 states") << 80 << 10 << 0;
+}
+
+void BenchScripts::benchmarkStateDelivery()
+{
+    QFETCH(int, scripts);
+    QFETCH(int, states);
+    QFETCH(int, unrelatedStates);
+
+    addScripts(scripts, stateScript(states, unrelatedStates));
+
+    QVector<qint64> latencies;
+    QElapsedTimer timer;
+    QBENCHMARK {
+        timer.start();
+        togglePower();
+        latencies.append(timer.nsecsElapsed());
+    }
+    BenchmarkResults::recordLatencies(latencies);
+}
+
+void BenchScripts::benchmarkEventDelivery_data()
+{
+    QTest::addColumn<int>("scripts");
+    QTest::addColumn<int>("events");
+
+    QTest::newRow("1 script, 1 event") << 1 << 1;
+    QTest::newRow("10 scripts, 10 events") << 10 << 10;
+    QTest::newRow("80 scripts, 1 event") << 80 << 1;
+}
+
+void BenchScripts::benchmarkEventDelivery()
+{
+    QFETCH(int, scripts);
+    QFETCH(int, events);
+
+    addScripts(scripts, eventScript(events));
+
+    // The mock emits the power event along with the state change
+    QVector<qint64> latencies;
+    QElapsedTimer timer;
+    QBENCHMARK {
+        timer.start();
+        togglePower();
+        latencies.append(timer.nsecsElapsed());
+    }
+    BenchmarkResults::recordLatencies(latencies);
+}
+
+void BenchScripts::benchmarkScriptLoad_data()
+{
+    QTest::addColumn<int>("states");
+
+    QTest::newRow("1 state") << 1;
+    QTest::newRow("30 states") << 30;
+    QTest::newRow("100 states") << 100;
+}
+
+void BenchScripts::benchmarkScriptLoad()
+{
+    QFETCH(int, states);
+
+    QString content = stateScript(states, 0);
+
+    // Includes writing the script to disk, keeping in mind that this is what users wait for when adding scripts
+    QVector<qint64> latencies;
+    QElapsedTimer timer;
+    QBENCHMARK {
+        timer.start();
+        ScriptEngine::AddScriptReply reply = NymeaCore::instance()->scriptEngine()->addScript("Benchmark", content.toUtf8());
+        QCOMPARE(reply.scriptError, ScriptEngine::ScriptErrorNoError);
+        NymeaCore::instance()->scriptEngine()->removeScript(reply.script.id());
+        latencies.append(timer.nsecsElapsed());
+    }
+    BenchmarkResults::recordLatencies(latencies);
+}
+
+void BenchScripts::benchmarkScriptMemory_data()
+{
+    QTest::addColumn<int>("states");
+
+    QTest::newRow("1 state") << 1;
+    QTest::newRow("30 states") << 30;
+}
+
+void BenchScripts::benchmarkScriptMemory()
+{
+    QFETCH(int, states);
+
+    const int scripts = 50;
+
+    // Warm up so the first script doesn't account for the QML engine and imports
+    addScripts(1, stateScript(states, 0));
+    removeScripts();
+
+    QVector<qint64> latencies;
+    qint64 before = BenchmarkResults::residentSetSize();
+    addScripts(scripts, stateScript(states, 0), &latencies);
+    qint64 after = BenchmarkResults::residentSetSize();
+
+    qCDebug(dcTests()) << "Resident memory per script with" << states << "states:" << (after - before) / scripts << "bytes";
+
+    QVariantMap metrics;
+    metrics.insert("rss", after);
+    metrics.insert("rssPerScript", (after - before) / scripts);
+    BenchmarkResults::recordLatencies(latencies, metrics);
+    QTest::setBenchmarkResult((after - before) / scripts, QTest::BytesAllocated);
+}
+
+#include "benchscripts.moc"
+QTEST_MAIN(BenchScripts)
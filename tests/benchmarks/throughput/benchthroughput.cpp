@@ -0,0 +1,291 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#include "nymeatestbase.h"
+#include "benchmarkresults.h"
+
+#include "nymeacore.h"
+#include "servers/mocktcpserver.h"
+#include "integrations/thingmanager.h"
+#include "ruleengine/ruleengine.h"
+
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QNetworkAccessManager>
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+
+using namespace nymeaserver;
+
+static const int benchDuration = 5000;
+static const int benchFirstPort = 21000;
+
+static qint64 cpuTime()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// Same clock as the state values generated by the mock
+static int monotonicMicroseconds()
+{
+    qint64 now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    return static_cast<int>(now % INT_MAX);
+}
+
+// Measures how many state changes, events and actions per second nymead sustains end to end. The mock things
+// generate changes of their int state at a fixed rate, each one triggering the rules on it and a notification
+// to every connected JSON-RPC client. The latency is taken from the generation of a change until the
+// notification leaves the JSON-RPC server. This is the yardstick for performance work on the core, run
+// with "./benchthroughput" and compare the numbers logged for each row.
+class BenchThroughput: public NymeaTestBase
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+
+    void benchmarkThroughput_data();
+    void benchmarkThroughput();
+
+private:
+    void addThings(int count);
+    void addRules(int count);
+    void addClients(int count);
+    void removeAll();
+
+    QList<ThingId> m_things;
+    QList<RuleId> m_rules;
+    QList<QUuid> m_clients;
+};
+
+void BenchThroughput::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\n*.info=false\n*.warning=false\n"
+                                "Tests.debug=true\n");
+}
+
+void BenchThroughput::cleanup()
+{
+    removeAll();
+    NymeaTestBase::cleanup();
+}
+
+void BenchThroughput::addThings(int count)
+{
+    for (int i = 0; i < count; i++) {
+        QVariantMap httpPortParam;
+        httpPortParam.insert("paramTypeId", mockThingHttpportParamTypeId);
+        httpPortParam.insert("value", benchFirstPort + i);
+        QVariantMap params;
+        params.insert("thingClassId", mockThingClassId);
+        params.insert("name", QString("Benchmark mock %1").arg(i));
+        params.insert("thingParams", QVariantList() << httpPortParam);
+        QVariant response = injectAndWait("Integrations.AddThing", params);
+        ThingId thingId = response.toMap().value("params").toMap().value("thingId").toUuid();
+        QVERIFY2(!thingId.isNull(), "Creating mock failed");
+        m_things.append(thingId);
+    }
+}
+
+// Rules executing an action on every generated change of the thing
+void BenchThroughput::addRules(int count)
+{
+    QList<Rule> rules;
+    for (int i = 0; i < count; i++) {
+        ThingId thingId = m_things.at(i % m_things.count());
+        Rule rule;
+        rule.setId(RuleId::createRuleId());
+        rule.setName(QString("Benchmark rule %1").arg(i));
+        rule.setEventDescriptors(QList<EventDescriptor>() << EventDescriptor(mockIntEventTypeId, thingId));
+        rule.setActions(QList<RuleAction>() << RuleAction(mockWithoutParamsActionTypeId, thingId));
+        rules.append(rule);
+        m_rules.append(rule.id());
+    }
+    QCOMPARE(NymeaCore::instance()->ruleEngine()->addRules(rules), RuleEngine::RuleErrorNoError);
+}
+
+void BenchThroughput::addClients(int count)
+{
+    for (int i = 0; i < count; i++) {
+        QUuid clientId = QUuid::createUuid();
+        m_mockTcpServer->clientConnected(clientId);
+        qApp->processEvents();
+        injectAndWait("JSONRPC.Hello", QVariantMap(), clientId);
+        QVariantMap params;
+        params.insert("namespaces", QVariantList() << "Integrations");
+        QVariant response = injectAndWait("JSONRPC.SetNotificationStatus", params, clientId);
+        QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+        m_clients.append(clientId);
+    }
+}
+
+void BenchThroughput::removeAll()
+{
+    foreach (const QUuid &clientId, m_clients) {
+        emit m_mockTcpServer->clientDisconnected(clientId);
+    }
+    m_clients.clear();
+    foreach (const RuleId &ruleId, m_rules) {
+        NymeaCore::instance()->ruleEngine()->removeRule(ruleId);
+    }
+    m_rules.clear();
+    foreach (const ThingId &thingId, m_things) {
+        NymeaCore::instance()->thingManager()->removeConfiguredThing(thingId);
+    }
+    m_things.clear();
+    QCoreApplication::processEvents();
+}
+
+void BenchThroughput::benchmarkThroughput_data()
+{
+    QTest::addColumn<int>("things");
+    QTest::addColumn<int>("rate");
+    QTest::addColumn<int>("rules");
+    QTest::addColumn<int>("clients");
+
+    QTest::newRow("10 things, 1000/s") << 10 << 1000 << 0 << 1;
+    QTest::newRow("10 things, 1000/s, 10 clients") << 10 << 1000 << 0 << 10;
+    QTest::newRow("100 things, 5000/s") << 100 << 5000 << 0 << 1;
+    QTest::newRow("100 things, 5000/s, 100 rules") << 100 << 5000 << 100 << 1;
+    QTest::newRow("100 things, 5000/s, 100 rules, 10 clients") << 100 << 5000 << 100 << 10;
+    QTest::newRow("500 things, 10000/s, 500 rules, 10 clients") << 500 << 10000 << 500 << 10;
+}
+
+void BenchThroughput::benchmarkThroughput()
+{
+    QFETCH(int, things);
+    QFETCH(int, rate);
+    QFETCH(int, rules);
+    QFETCH(int, clients);
+
+    addThings(things);
+    addRules(rules);
+    addClients(clients);
+
+    int changesPerThing = rate / things * benchDuration / 1000;
+    int expectedChanges = changesPerThing * things;
+
+    int stateChanges = 0;
+    int events = 0;
+    int actions = 0;
+    int notifications = 0;
+    QVector<int> latencies;
+    latencies.reserve(expectedChanges * clients);
+
+    QList<QMetaObject::Connection> connections;
+    connections << connect(NymeaCore::instance()->thingManager(), &ThingManager::thingStateChanged, this, [&stateChanges](Thing *, const StateTypeId &stateTypeId){
+        if (stateTypeId == mockIntStateTypeId) {
+            stateChanges++;
+        }
+    });
+    connections << connect(NymeaCore::instance()->thingManager(), &ThingManager::eventTriggered, this, [&events](){
+        events++;
+    });
+    connections << connect(NymeaCore::instance()->thingManager(), &ThingManager::actionExecuted, this, [&actions](){
+        actions++;
+    });
+    connections << connect(m_mockTcpServer, &MockTcpServer::outgoingData, this, [this, &notifications, &latencies](const QUuid &clientId, const QByteArray &data){
+        if (!m_clients.contains(clientId)) {
+            return;
+        }
+        QVariantMap params = QJsonDocument::fromJson(data).toVariant().toMap().value("params").toMap();
+        if (params.value("stateTypeId").toUuid() != mockIntStateTypeId) {
+            return;
+        }
+        notifications++;
+        int latency = monotonicMicroseconds() - params.value("value").toInt();
+        latencies.append(latency < 0 ? latency + INT_MAX : latency);
+    });
+
+    qint64 cpuStart = cpuTime();
+    qint64 rssStart = BenchmarkResults::residentSetSize();
+    QElapsedTimer timer;
+    timer.start();
+
+    // All things start generating at about the same time
+    QNetworkAccessManager nam;
+    foreach (const ThingId &thingId, m_things) {
+        Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(thingId);
+        QNetworkRequest request(QUrl(QString("http://localhost:%1/generatestates?rate=%2&count=%3")
+                                     .arg(thing->paramValue(mockThingHttpportParamTypeId).toInt())
+                                     .arg(rate / things).arg(changesPerThing)));
+        QNetworkReply *reply = nam.get(request);
+        connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
+    }
+
+    // Give the core some time to catch up, but don't wait forever if it can't keep up
+    while (notifications < expectedChanges * clients && timer.elapsed() < benchDuration * 2) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    }
+    qint64 elapsed = timer.elapsed();
+    qint64 cpu = cpuTime() - cpuStart;
+    qint64 rss = BenchmarkResults::residentSetSize();
+
+    foreach (const QMetaObject::Connection &connection, connections) {
+        disconnect(connection);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        return latencies.isEmpty() ? 0 : latencies.at(qMin(latencies.count() - 1, static_cast<int>(latencies.count() * p)));
+    };
+
+    qCDebug(dcTests()).nospace() << "Generated " << expectedChanges << " state changes in " << elapsed << " ms: "
+                                 << stateChanges * 1000 / elapsed << " state changes/s, "
+                                 << events * 1000 / elapsed << " events/s, "
+                                 << actions * 1000 / elapsed << " actions/s, "
+                                 << notifications * 1000 / elapsed << " notifications/s";
+    qCDebug(dcTests()).nospace() << "Latency p50 " << percentile(0.5) << " us, p90 " << percentile(0.9) << " us, p99 "
+                                 << percentile(0.99) << " us, max " << percentile(1) << " us";
+    qCDebug(dcTests()).nospace() << "CPU " << cpu * 100 / (elapsed * 1000) << " %, RSS " << rss / 1024 << " kB (" << (rss - rssStart) / 1024 << " kB during the run)";
+
+    QVariantMap metrics;
+    metrics.insert("throughput", stateChanges * 1000.0 / elapsed);
+    metrics.insert("eventsPerSecond", events * 1000.0 / elapsed);
+    metrics.insert("actionsPerSecond", actions * 1000.0 / elapsed);
+    metrics.insert("notificationsPerSecond", notifications * 1000.0 / elapsed);
+    metrics.insert("latencyP50", percentile(0.5) / 1000.0);
+    metrics.insert("latencyP90", percentile(0.9) / 1000.0);
+    metrics.insert("latencyP99", percentile(0.99) / 1000.0);
+    metrics.insert("cpu", cpu * 100.0 / (elapsed * 1000));
+    metrics.insert("rss", rss);
+    BenchmarkResults::record(metrics);
+
+    QVERIFY2(stateChanges == expectedChanges, qPrintable(QString("Only %1 of %2 state changes arrived").arg(stateChanges).arg(expectedChanges)));
+    QTest::setBenchmarkResult(stateChanges * 1000.0 / elapsed, QTest::Events);
+}
+
+#include "benchthroughput.moc"
+QTEST_MAIN(BenchThroughput)
@@ -0,0 +1,8 @@
+include(../../../nymea.pri)
+include(../../auto/autotests.pri)
+
+# Benchmarks are run on demand, not as part of make check
+CONFIG -= testcase
+
+TARGET = benchthroughput
+SOURCES += benchthroughput.cpp
@@ -0,0 +1,389 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "nymeatestbase.h"
+#include "benchmarkresults.h"
+
+#include "nymeacore.h"
+
+#include <QFile>
+#include <QThread>
+#include <QTcpSocket>
+#include <QWebSocket>
+#include <QElapsedTimer>
+#include <QEventLoop>
+
+#include <algorithm>
+
+using namespace nymeaserver;
+
+static const quint16 benchWebServerPort = 3380;
+static const quint16 benchWebSocketServerPort = 4480;
+
+// Drives a number of keep-alive clients in its own thread, each sending the next request as soon as
+// the previous reply is complete, and records the latency of every request.
+class LoadGenerator: public QObject
+{
+    Q_OBJECT
+public:
+    enum Protocol {
+        ProtocolHttp,
+        ProtocolWebSocket
+    };
+
+    // Written in the thread of the generator, to be read once it has finished
+    class Result {
+    public:
+        QVector<qint64> latencies;
+        int errors = 0;
+        qint64 elapsed = 0;
+    };
+
+    LoadGenerator(Protocol protocol, const QByteArray &request, int clients, int duration, Result *result):
+        m_protocol(protocol), m_request(request), m_clients(clients), m_duration(duration), m_result(result) { }
+
+public slots:
+    void start();
+
+signals:
+    void finished();
+
+private:
+    class HttpClient {
+    public:
+        QByteArray buffer;
+        QElapsedTimer timer;
+    };
+    class WebSocketClient {
+    public:
+        int commandId = 0;
+        QElapsedTimer timer;
+    };
+
+    void sendHttpRequest(QTcpSocket *socket);
+    void processHttpData(QTcpSocket *socket);
+    void sendWebSocketRequest(QWebSocket *socket);
+    void processWebSocketMessage(QWebSocket *socket, const QString &message);
+    void clientDone();
+    bool running() const { return m_runTimer.elapsed() < m_duration; }
+
+    Protocol m_protocol;
+    QByteArray m_request;
+    int m_clients;
+    int m_duration;
+    Result *m_result;
+    int m_activeClients = 0;
+    QElapsedTimer m_runTimer;
+    QHash<QTcpSocket *, HttpClient> m_httpClients;
+    QHash<QWebSocket *, WebSocketClient> m_webSocketClients;
+};
+
+void LoadGenerator::start()
+{
+    m_runTimer.start();
+    m_activeClients = m_clients;
+    for (int i = 0; i < m_clients; i++) {
+        if (m_protocol == ProtocolHttp) {
+            QTcpSocket *socket = new QTcpSocket(this);
+            m_httpClients.insert(socket, HttpClient());
+            connect(socket, &QTcpSocket::connected, this, [this, socket](){ sendHttpRequest(socket); });
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket](){ processHttpData(socket); });
+            connect(socket, &QTcpSocket::disconnected, this, [this, socket](){
+                if (running()) {
+                    m_result->errors++;
+                }
+                clientDone();
+                socket->deleteLater();
+            });
+            socket->connectToHost(QHostAddress::LocalHost, benchWebServerPort);
+        } else {
+            QWebSocket *socket = new QWebSocket("bench", QWebSocketProtocol::VersionLatest, this);
+            m_webSocketClients.insert(socket, WebSocketClient());
+            connect(socket, &QWebSocket::connected, this, [socket](){
+                socket->sendTextMessage("{\"id\": 0, \"method\": \"JSONRPC.Hello\"}");
+            });
+            connect(socket, &QWebSocket::textMessageReceived, this, [this, socket](const QString &message){ processWebSocketMessage(socket, message); });
+            connect(socket, &QWebSocket::disconnected, this, [this, socket](){
+                if (running()) {
+                    m_result->errors++;
+                }
+                clientDone();
+                socket->deleteLater();
+            });
+            socket->open(QUrl(QString("ws://127.0.0.1:%1").arg(benchWebSocketServerPort)));
+        }
+    }
+}
+
+void LoadGenerator::sendHttpRequest(QTcpSocket *socket)
+{
+    if (!running()) {
+        socket->disconnectFromHost();
+        return;
+    }
+    HttpClient &client = m_httpClients[socket];
+    client.buffer.clear();
+    client.timer.start();
+    socket->write("GET " + m_request + " HTTP/1.1\r\nHost: 127.0.0.1\r\nUser-Agent: nymea benchmark\r\n\r\n");
+}
+
+void LoadGenerator::processHttpData(QTcpSocket *socket)
+{
+    HttpClient &client = m_httpClients[socket];
+    client.buffer.append(socket->readAll());
+
+    int headerEnd = client.buffer.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        return;
+    }
+    QByteArray header = client.buffer.left(headerEnd).toLower();
+    int lengthIndex = header.indexOf("content-length:");
+    if (lengthIndex < 0) {
+        // Only fixed size replies are benchmarked
+        m_result->errors++;
+        socket->disconnectFromHost();
+        return;
+    }
+    qint64 contentLength = header.mid(lengthIndex + 15, header.indexOf("\r\n", lengthIndex) - lengthIndex - 15).trimmed().toLongLong();
+    if (client.buffer.size() < headerEnd + 4 + contentLength) {
+        return;
+    }
+
+    if (!client.buffer.startsWith("HTTP/1.1 200") && !client.buffer.startsWith("HTTP/1.1 304")) {
+        m_result->errors++;
+    }
+    m_result->latencies.append(client.timer.nsecsElapsed());
+    sendHttpRequest(socket);
+}
+
+void LoadGenerator::sendWebSocketRequest(QWebSocket *socket)
+{
+    if (!running()) {
+        socket->close();
+        return;
+    }
+    WebSocketClient &client = m_webSocketClients[socket];
+    client.commandId++;
+    client.timer.start();
+    QByteArray request = m_request;
+    socket->sendTextMessage(QString(request.replace("%id", QByteArray::number(client.commandId))));
+}
+
+void LoadGenerator::processWebSocketMessage(QWebSocket *socket, const QString &message)
+{
+    QVariantMap reply = QJsonDocument::fromJson(message.toUtf8()).toVariant().toMap();
+    if (reply.contains("notification")) {
+        return;
+    }
+    WebSocketClient &client = m_webSocketClients[socket];
+    if (reply.value("id").toInt() != client.commandId) {
+        m_result->errors++;
+        return;
+    }
+    if (client.commandId > 0) {
+        if (reply.value("status").toString() != "success") {
+            m_result->errors++;
+        }
+        m_result->latencies.append(client.timer.nsecsElapsed());
+    }
+    sendWebSocketRequest(socket);
+}
+
+void LoadGenerator::clientDone()
+{
+    if (--m_activeClients == 0) {
+        m_result->elapsed = m_runTimer.elapsed();
+        emit finished();
+    }
+}
+
+// Measures throughput, latency and memory of the HTTP path of the WebServer and of JSON-RPC over
+// WebSocket under load from concurrent keep-alive clients. The duration of each run defaults to 3 seconds
+// and can be changed with NYMEA_BENCH_DURATION (in seconds), e.g. "NYMEA_BENCH_DURATION=10 ./benchwebserver".
+class BenchWebserver: public NymeaTestBase
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void benchmarkLoad_data();
+    void benchmarkLoad();
+
+private:
+    void writePublicFile(const QString &fileName, int size);
+
+    QStringList m_publicFiles;
+};
+
+void BenchWebserver::initTestCase()
+{
+    NymeaTestBase::initTestCase("*.debug=false\n*.info=false\n*.warning=false\n"
+                                "Tests.debug=true\n");
+
+    // In tests the web server serves the application directory
+    writePublicFile("bench-small.html", 2 * 1024);
+    writePublicFile("bench-app.0123abcd.js", 200 * 1024);
+    writePublicFile("bench-large.bin", 1024 * 1024);
+
+    WebServerConfiguration webServerConfig;
+    webServerConfig.id = "bench";
+    webServerConfig.address = QHostAddress("127.0.0.1");
+    webServerConfig.port = benchWebServerPort;
+    webServerConfig.sslEnabled = false;
+    webServerConfig.authenticationEnabled = false;
+    webServerConfig.restServerEnabled = true;
+    NymeaCore::instance()->configuration()->setWebServerConfiguration(webServerConfig);
+
+    ServerConfiguration webSocketServerConfig;
+    webSocketServerConfig.id = "bench";
+    webSocketServerConfig.address = QHostAddress("127.0.0.1");
+    webSocketServerConfig.port = benchWebSocketServerPort;
+    webSocketServerConfig.sslEnabled = false;
+    webSocketServerConfig.authenticationEnabled = false;
+    NymeaCore::instance()->configuration()->setWebSocketServerConfiguration(webSocketServerConfig);
+}
+
+void BenchWebserver::cleanupTestCase()
+{
+    foreach (const QString &fileName, m_publicFiles) {
+        QFile::remove(fileName);
+    }
+    NymeaTestBase::cleanupTestCase();
+}
+
+void BenchWebserver::writePublicFile(const QString &fileName, int size)
+{
+    QFile file(QCoreApplication::applicationDirPath() + "/" + fileName);
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    QByteArray line = "The quick brown fox jumps over the lazy dog.\n";
+    while (file.size() < size) {
+        file.write(line);
+    }
+    m_publicFiles.append(file.fileName());
+}
+
+void BenchWebserver::benchmarkLoad_data()
+{
+    QTest::addColumn<int>("protocol");
+    QTest::addColumn<QByteArray>("request");
+    QTest::addColumn<int>("clients");
+
+    QByteArray stateValues = QString("{\"id\": %id, \"method\": \"Integrations.GetStateValues\", \"params\": {\"thingId\": \"%1\"}}").arg(m_mockThingId.toString()).toUtf8();
+    QByteArray restStateValues = QString("/api/v1/things/%1/states").arg(m_mockThingId.toString().remove(QRegExp("[{}]"))).toUtf8();
+
+    QTest::newRow("static 2 KiB, 1 client") << static_cast<int>(LoadGenerator::ProtocolHttp) << QByteArray("/bench-small.html") << 1;
+    QTest::newRow("static 2 KiB, 16 clients") << static_cast<int>(LoadGenerator::ProtocolHttp) << QByteArray("/bench-small.html") << 16;
+    QTest::newRow("static 200 KiB, 16 clients") << static_cast<int>(LoadGenerator::ProtocolHttp) << QByteArray("/bench-app.0123abcd.js") << 16;
+    QTest::newRow("static 1 MiB, 4 clients") << static_cast<int>(LoadGenerator::ProtocolHttp) << QByteArray("/bench-large.bin") << 4;
+    QTest::newRow("server.xml, 16 clients") << static_cast<int>(LoadGenerator::ProtocolHttp) << QByteArray("/server.xml") << 16;
+    QTest::newRow("REST states, 16 clients") << static_cast<int>(LoadGenerator::ProtocolHttp) << restStateValues << 16;
+    QTest::newRow("JSON-RPC states, 1 client") << static_cast<int>(LoadGenerator::ProtocolWebSocket) << stateValues << 1;
+    QTest::newRow("JSON-RPC states, 16 clients") << static_cast<int>(LoadGenerator::ProtocolWebSocket) << stateValues << 16;
+}
+
+void BenchWebserver::benchmarkLoad()
+{
+    QFETCH(int, protocol);
+    QFETCH(QByteArray, request);
+    QFETCH(int, clients);
+
+    int duration = qEnvironmentVariableIsSet("NYMEA_BENCH_DURATION") ? qEnvironmentVariableIntValue("NYMEA_BENCH_DURATION") * 1000 : 3000;
+
+    // The server runs in this thread, the clients in their own
+    LoadGenerator::Result result;
+    QThread clientThread;
+    LoadGenerator *generator = new LoadGenerator(static_cast<LoadGenerator::Protocol>(protocol), request, clients, duration, &result);
+    generator->moveToThread(&clientThread);
+    connect(&clientThread, &QThread::started, generator, &LoadGenerator::start);
+    connect(generator, &LoadGenerator::finished, &clientThread, &QThread::quit);
+    connect(&clientThread, &QThread::finished, generator, &QObject::deleteLater);
+
+    QList<qint64> rssSamples;
+    rssSamples.append(BenchmarkResults::residentSetSize());
+    QTimer rssTimer;
+    rssTimer.setInterval(250);
+    connect(&rssTimer, &QTimer::timeout, this, [&rssSamples](){ rssSamples.append(BenchmarkResults::residentSetSize()); });
+    rssTimer.start();
+
+    QEventLoop loop;
+    connect(&clientThread, &QThread::finished, &loop, &QEventLoop::quit, Qt::QueuedConnection);
+    QTimer::singleShot(duration + 10000, &loop, &QEventLoop::quit);
+    clientThread.start();
+    loop.exec();
+    rssTimer.stop();
+    rssSamples.append(BenchmarkResults::residentSetSize());
+    bool finished = clientThread.isFinished();
+    clientThread.quit();
+    clientThread.wait();
+    QVERIFY2(finished, "Load generator did not finish in time");
+
+    QVector<qint64> latencies = result.latencies;
+    QVERIFY2(!latencies.isEmpty(), "No request succeeded");
+    std::sort(latencies.begin(), latencies.end());
+    double requestsPerSecond = latencies.count() * 1000.0 / qMax(result.elapsed, static_cast<qint64>(1));
+    double p50 = latencies.at(latencies.count() / 2) / 1000000.0;
+    double p99 = latencies.at(qMin(latencies.count() - 1, latencies.count() * 99 / 100)) / 1000000.0;
+    qint64 maxRss = *std::max_element(rssSamples.constBegin(), rssSamples.constEnd());
+
+    QStringList rssSeries;
+    foreach (qint64 sample, rssSamples) {
+        rssSeries.append(QString::number(sample / 1024));
+    }
+
+    qCDebug(dcTests()).noquote() << QString("%1: %2 requests/s, p50 %3 ms, p99 %4 ms, %5 errors")
+                                    .arg(QTest::currentDataTag())
+                                    .arg(requestsPerSecond, 0, 'f', 0)
+                                    .arg(p50, 0, 'f', 3)
+                                    .arg(p99, 0, 'f', 3)
+                                    .arg(result.errors);
+    qCDebug(dcTests()).noquote() << QString("%1: RSS %2 -> %3 KiB, max %4 KiB. Over time (KiB): %5")
+                                    .arg(QTest::currentDataTag())
+                                    .arg(rssSamples.first() / 1024)
+                                    .arg(rssSamples.last() / 1024)
+                                    .arg(maxRss / 1024)
+                                    .arg(rssSeries.join(' '));
+
+    QVariantMap metrics;
+    metrics.insert("throughput", requestsPerSecond);
+    metrics.insert("latencyP50", p50);
+    metrics.insert("latencyP99", p99);
+    metrics.insert("rss", maxRss);
+    metrics.insert("errors", result.errors);
+    BenchmarkResults::record(metrics);
+
+    QCOMPARE(result.errors, 0);
+    QTest::setBenchmarkResult(requestsPerSecond, QTest::Events);
+}
+
+#include "benchwebserver.moc"
+QTEST_MAIN(BenchWebserver)
@@ -0,0 +1,100 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "benchmarkresults.h"
+
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QFile>
+#include <QTest>
+
+#include <algorithm>
+#include <numeric>
+#include <unistd.h>
+
+void BenchmarkResults::record(const QVariantMap &metrics)
+{
+    QString fileName = QString::fromLocal8Bit(qgetenv("NYMEA_BENCHMARK_RESULTS"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    QVariantMap allMetrics = metrics;
+    if (!allMetrics.contains("rss")) {
+        allMetrics.insert("rss", residentSetSize());
+    }
+
+    QVariantMap result;
+    result.insert("benchmark", QCoreApplication::applicationName());
+    result.insert("function", QString::fromUtf8(QTest::currentTestFunction()));
+    result.insert("tag", QString::fromUtf8(QTest::currentDataTag()));
+    result.insert("metrics", allMetrics);
+
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Append)) {
+        qWarning() << "Could not open benchmark results file" << fileName << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument::fromVariant(result).toJson(QJsonDocument::Compact) + '\n');
+}
+
+void BenchmarkResults::recordLatencies(QVector<qint64> latencies, const QVariantMap &metrics)
+{
+    if (latencies.isEmpty()) {
+        record(metrics);
+        return;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        return latencies.at(qMin(latencies.count() - 1, static_cast<int>(latencies.count() * p))) / 1000000.0;
+    };
+
+    QVariantMap allMetrics = metrics;
+    if (!allMetrics.contains("throughput")) {
+        qint64 total = std::accumulate(latencies.constBegin(), latencies.constEnd(), static_cast<qint64>(0));
+        allMetrics.insert("throughput", latencies.count() * 1000000000.0 / qMax(total, static_cast<qint64>(1)));
+    }
+    allMetrics.insert("latencyP50", percentile(0.5));
+    allMetrics.insert("latencyP90", percentile(0.9));
+    allMetrics.insert("latencyP99", percentile(0.99));
+    record(allMetrics);
+}
+
+qint64 BenchmarkResults::residentSetSize()
+{
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QFile::ReadOnly)) {
+        return 0;
+    }
+    // Counted in pages, whose size depends on the system
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    return fields.count() > 1 ? fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE) : 0;
+}
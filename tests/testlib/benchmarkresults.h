@@ -0,0 +1,53 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BENCHMARKRESULTS_H
+#define BENCHMARKRESULTS_H
+
+#include <QVariantMap>
+#include <QVector>
+
+// Machine readable benchmark results. When NYMEA_BENCHMARK_RESULTS is set, every recorded result is
+// appended to that file as one JSON object per line:
+//   {"benchmark": "benchthroughput", "function": "...", "tag": "...", "metrics": {...}}
+// Metrics use these names where they apply: "throughput" in operations per second, "latencyP50",
+// "latencyP90", "latencyP99" in milliseconds and "rss" in bytes. The rss is added if not given.
+class BenchmarkResults
+{
+public:
+    static void record(const QVariantMap &metrics);
+    // Records the latency percentiles of the given operation durations in nanoseconds along with the given metrics.
+    // The throughput is derived from the durations unless given, assuming the operations ran one after another.
+    static void recordLatencies(QVector<qint64> latencies, const QVariantMap &metrics = QVariantMap());
+
+    static qint64 residentSetSize();
+};
+
+#endif // BENCHMARKRESULTS_H
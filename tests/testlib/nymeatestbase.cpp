@@ -31,6 +31,7 @@
 #include "nymeatestbase.h"
 #include "nymeacore.h"
 #include "nymeasettings.h"
+#include "ruleengine/rulestore.h"
 #include "servers/mocktcpserver.h"
 #include "usermanager/usermanager.h"
 
@@ -53,13 +54,14 @@ NymeaTestBase::NymeaTestBase(QObject *parent) :
     QCoreApplication::instance()->setOrganizationName("nymea-test");
 }
 
-void NymeaTestBase::initTestCase(const QString &loggingRules)
+void NymeaTestBase::initTestCase(const QString &loggingRules, const QVariantMap &settings)
 {
     qCDebug(dcTests) << "NymeaTestBase starting.";
 
     // If testcase asserts cleanup won't do. Lets clear any previous test run settings leftovers
     NymeaSettings rulesSettings(NymeaSettings::SettingsRoleRules);
     rulesSettings.clear();
+    QDir(RuleStore::defaultPath()).removeRecursively();
     NymeaSettings thingSettings(NymeaSettings::SettingsRoleThings);
     thingSettings.clear();
     NymeaSettings pluginSettings(NymeaSettings::SettingsRolePlugins);
@@ -70,6 +72,10 @@ void NymeaTestBase::initTestCase(const QString &loggingRules)
     // Reset to default settings
     NymeaSettings nymeadSettings(NymeaSettings::SettingsRoleGlobal);
     nymeadSettings.clear();
+    foreach (const QString &key, settings.keys()) {
+        nymeadSettings.setValue(key, settings.value(key));
+    }
+    nymeadSettings.sync();
 
     if (loggingRules.isEmpty()) {
         QLoggingCategory::setFilterRules("*.debug=false\nApplication.debug=true\nTests.debug=true\nMock.debug=true");
@@ -415,11 +421,14 @@ void NymeaTestBase::waitForDBSync()
     }
 }
 
-void NymeaTestBase::restartServer()
+void NymeaTestBase::restartServer(const std::function<void()> &whileStopped)
 {
     // Destroy and recreate the core instance...
     qCDebug(dcTests()) << "Tearing down server instance";
     NymeaCore::instance()->destroy();
+    if (whileStopped) {
+        whileStopped();
+    }
     qCDebug(dcTests()) << "Restarting server instance";
     NymeaCore::instance()->init();
     QSignalSpy coreSpy(NymeaCore::instance(), SIGNAL(initialized()));
@@ -36,6 +36,8 @@
 #include <QNetworkRequest>
 #include <QNetworkReply>
 
+#include <functional>
+
 Q_DECLARE_LOGGING_CATEGORY(dcTests)
 
 #include "../plugins/mock/extern-plugininfo.h"
@@ -50,7 +52,8 @@ public:
     explicit NymeaTestBase(QObject *parent = nullptr);
 
 protected slots:
-    void initTestCase(const QString &loggingRules = QString());
+    // settings are written to nymead.conf before the core starts, keyed by "group/key"
+    void initTestCase(const QString &loggingRules = QString(), const QVariantMap &settings = QVariantMap());
     void cleanupTestCase();
     void cleanup();
 
@@ -122,7 +125,8 @@ protected:
     }
 
     void waitForDBSync();
-    void restartServer();
+    // Calls whileStopped, if given, after the server has been torn down and before it starts again
+    void restartServer(const std::function<void()> &whileStopped = nullptr);
     void clearLoggingDatabase();
 
 private:
@@ -23,8 +23,10 @@ LIBS += -L$$top_builddir/libnymea/ -lnymea \
         -L$$top_builddir/libnymea-core/ -lnymea-core \
         -lssl -lcrypto -lnymea-remoteproxyclient
 
-HEADERS += nymeatestbase.h
-SOURCES += nymeatestbase.cpp
+HEADERS += nymeatestbase.h \
+           benchmarkresults.h
+SOURCES += nymeatestbase.cpp \
+           benchmarkresults.cpp
 
 target.path = $$[QT_INSTALL_LIBS]
 INSTALLS += target
@@ -1,5 +1,8 @@
 TEMPLATE = subdirs
 
-SUBDIRS = testlib auto tools/simplepushbuttonhandler
+experiencepluginmock.subdir = tools/experiencepluginmock
 
-auto.depends += testlib
+SUBDIRS = testlib auto benchmarks tools/simplepushbuttonhandler experiencepluginmock
+
+auto.depends += testlib experiencepluginmock
+benchmarks.depends += testlib
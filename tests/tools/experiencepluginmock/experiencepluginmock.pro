@@ -0,0 +1,19 @@
+include(../../../nymea.pri)
+
+TEMPLATE = lib
+CONFIG += plugin
+
+TARGET = $$qtLibraryTarget(nymea_experiencepluginmock)
+
+INCLUDEPATH += $$top_srcdir/libnymea
+LIBS += -L$$top_builddir/libnymea/ -lnymea
+
+OTHER_FILES += experiencepluginmock.json
+
+SOURCES += \
+    experiencepluginmock.cpp \
+    experiencemockhandler.cpp
+
+HEADERS += \
+    experiencepluginmock.h \
+    experiencemockhandler.h
@@ -43,6 +43,24 @@ PluginInfoCompiler::PluginInfoCompiler()
 
 }
 
+// C++ type of the accessor for values of the given type. Anything more exotic is handled as plain QVariant,
+// as plugininfo.h doesn't pull in e.g. QtGui for QColor.
+static QString accessorType(QVariant::Type type)
+{
+    switch (type) {
+    case QVariant::Bool:
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+    case QVariant::Double:
+    case QVariant::String:
+        return QVariant::typeToName(type);
+    default:
+        return "QVariant";
+    }
+}
+
 int PluginInfoCompiler::compile(const QString &inputFile, const QString &outputFile, const QString outputFileExtern, const QString &translationsPath, bool strictMode)
 {
     // First, process the input json...
@@ -170,8 +188,10 @@ int PluginInfoCompiler::compile(const QString &inputFile, const QString &outputF
     writeExtern();
 
     write("#include \"typeutils.h\"");
+    write("#include \"integrations/pluginaccessors.h\"");
     write();
     writeExtern("#include \"typeutils.h\"");
+    writeExtern("#include \"integrations/pluginaccessors.h\"");
     writeExtern();
 
     write("#include <QLoggingCategory>");
@@ -198,6 +218,9 @@ int PluginInfoCompiler::compile(const QString &inputFile, const QString &outputF
     write();
     writeExtern();
 
+    // Typed accessors, defined in both files as they are constexpr
+    writeAccessors();
+
     // And the translations
     write(QString("const QString translations[] {"));
     for (auto i = m_translationStrings.begin(); i != m_translationStrings.end();) {
@@ -251,6 +274,8 @@ void PluginInfoCompiler::writeParams(const ParamTypes &paramTypes, const QString
         write(QString("ParamTypeId %1 = ParamTypeId(\"%2\");").arg(variableName).arg(paramType.id().toString()));
         m_translationStrings.insert(paramType.displayName(), QString("The name of the ParamType (ThingClass: %1, %2Type: %3, ID: %4)").arg(thingClassName).arg(typeClass).arg(typeName).arg(paramType.id().toString()));
         writeExtern(QString("extern ParamTypeId %1;").arg(variableName));
+
+        addAccessor(QString("ParamAccessor<%1>").arg(accessorType(paramType.type())), variableName.left(variableName.length() - QString("TypeId").length()), paramType.id());
     }
 }
 
@@ -293,7 +318,8 @@ void PluginInfoCompiler::writeThingClass(const ThingClass &thingClass)
 
 void PluginInfoCompiler::writeStateTypes(const StateTypes &stateTypes, const QString &thingClassName)
 {
-    foreach (const StateType &stateType, stateTypes) {
+    for (int i = 0; i < stateTypes.count(); i++) {
+        const StateType &stateType = stateTypes.at(i);
         QString variableName = QString("%1%2StateTypeId").arg(thingClassName, stateType.name()[0].toUpper() + stateType.name().right(stateType.name().length() - 1));
         if (m_variableNames.contains(variableName)) {
             qWarning().nospace() << "Error: Duplicate name " << variableName << " for StateType " << stateType.name() << " in ThingClass " << thingClassName << ". Skipping entry.";
@@ -303,6 +329,9 @@ void PluginInfoCompiler::writeStateTypes(const StateTypes &stateTypes, const QSt
         write(QString("StateTypeId %1 = StateTypeId(\"%2\");").arg(variableName).arg(stateType.id().toString()));
         m_translationStrings.insert(stateType.displayName(), QString("The name of the StateType (%1) of ThingClass %2").arg(stateType.id().toString()).arg(thingClassName));
         writeExtern(QString("extern StateTypeId %1;").arg(variableName));
+
+        // The index is the position of the state in the thing class, which is also its position in the thing
+        addAccessor(QString("StateAccessor<%1>").arg(accessorType(stateType.type())), variableName.left(variableName.length() - QString("TypeId").length()), stateType.id(), i);
     }
 }
 
@@ -319,6 +348,8 @@ void PluginInfoCompiler::writeEventTypes(const EventTypes &eventTypes, const QSt
         m_translationStrings.insert(eventType.displayName(), QString("The name of the EventType (%1) of ThingClass %2").arg(eventType.id().toString()).arg(thingClassName));
         writeExtern(QString("extern EventTypeId %1;").arg(variableName));
 
+        addAccessor("EventAccessor", variableName.left(variableName.length() - QString("TypeId").length()), eventType.id());
+
         writeParams(eventType.paramTypes(), thingClassName, "Event", eventType.name());
     }
 }
@@ -336,6 +367,8 @@ void PluginInfoCompiler::writeActionTypes(const ActionTypes &actionTypes, const
         m_translationStrings.insert(actionType.displayName(), QString("The name of the ActionType (%1) of ThingClass %2").arg(actionType.id().toString()).arg(thingClassName));
         writeExtern(QString("extern ActionTypeId %1;").arg(variableName));
 
+        addAccessor("ActionAccessor", variableName.left(variableName.length() - QString("TypeId").length()), actionType.id());
+
         writeParams(actionType.paramTypes(), thingClassName, "Action", actionType.name());
     }    
 }
@@ -357,6 +390,43 @@ void PluginInfoCompiler::writeBrowserItemActionTypes(const ActionTypes &actionTy
     }
 }
 
+void PluginInfoCompiler::writeAccessors()
+{
+    write("#ifndef PLUGININFO_ACCESSORS");
+    write("#define PLUGININFO_ACCESSORS");
+    writeExtern("#ifndef PLUGININFO_ACCESSORS");
+    writeExtern("#define PLUGININFO_ACCESSORS");
+    foreach (const QString &accessor, m_accessors) {
+        write(accessor);
+        writeExtern(accessor);
+    }
+    write("#endif // PLUGININFO_ACCESSORS");
+    write();
+    writeExtern("#endif // PLUGININFO_ACCESSORS");
+    writeExtern();
+}
+
+void PluginInfoCompiler::addAccessor(const QString &type, const QString &name, const QUuid &id, int index)
+{
+    if (m_variableNames.contains(name)) {
+        qWarning().nospace() << "Error: Duplicate name " << name << " for accessor of " << id << ". Skipping entry.";
+        return;
+    }
+    m_variableNames.append(name);
+
+    QString uuid = QString("QUuid(0x%1, 0x%2, 0x%3").arg(id.data1, 0, 16).arg(id.data2, 0, 16).arg(id.data3, 0, 16);
+    for (int i = 0; i < 8; i++) {
+        uuid.append(QString(", 0x%1").arg(static_cast<uint>(id.data4[i]), 0, 16));
+    }
+    uuid.append(")");
+
+    if (index >= 0) {
+        m_accessors.append(QString("constexpr %1 %2(%3, %4);").arg(type, name, uuid).arg(index));
+    } else {
+        m_accessors.append(QString("constexpr %1 %2(%3);").arg(type, name, uuid));
+    }
+}
+
 void PluginInfoCompiler::write(const QString &line)
 {
     if (m_outputFile.isOpen()) {
@@ -55,12 +55,16 @@ private:
     void writeActionTypes(const ActionTypes &actionTypes, const QString &thingClassName);
     void writeBrowserItemActionTypes(const ActionTypes &actionTypes, const QString &thingClassName);
 
+    void writeAccessors();
+    void addAccessor(const QString &type, const QString &name, const QUuid &id, int index = -1);
+
     void write(const QString &line = QString());
     void writeExtern(const QString &line = QString());
 
     QMultiMap<QString, QString> m_translationStrings;
 
     QStringList m_variableNames;
+    QStringList m_accessors;
 
     QFile m_outputFile;
     QFile m_outputFileExtern;